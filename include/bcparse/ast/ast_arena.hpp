@@ -0,0 +1,88 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <cstddef>
+#include <new>
+
+namespace bcparse {
+  // memory for the AST of one compilation: nodes and their reference
+  // counts are bumped out of chunks, and the chunks are freed together
+  // when the arena goes, instead of node by node. the nodes' destructors
+  // still run as their last reference drops, so an arena has to outlive
+  // every node in it: make it before the CompilationUnit and everything
+  // else that holds nodes. nodes made while no arena is in scope, on this
+  // thread, go to the heap as before.
+  class AstArena {
+  public:
+    static const size_t CHUNK_SIZE = 64 * 1024;
+
+    AstArena();
+    AstArena(const AstArena &other) = delete;
+    ~AstArena();
+
+    void *allocate(size_t size, size_t align);
+
+    // the arena nodes made on this thread go to, or NULL
+    static AstArena *current();
+
+    // makes `arena` current on this thread while it lives
+    class Scope {
+    public:
+      Scope(AstArena *arena);
+      Scope(const Scope &other) = delete;
+      ~Scope();
+
+    private:
+      AstArena *m_previous;
+    };
+
+  private:
+    std::vector<char*> m_chunks;
+    char *m_pos;
+    char *m_end;
+  };
+
+  // an allocator for std::allocate_shared, from the arena current when it
+  // was made. deallocating arena memory does nothing.
+  template <typename T>
+  class AstArenaAllocator {
+  public:
+    typedef T value_type;
+
+    AstArenaAllocator() : m_arena(AstArena::current()) {}
+
+    template <typename U>
+    AstArenaAllocator(const AstArenaAllocator<U> &other) : m_arena(other.getArena()) {}
+
+    inline AstArena *getArena() const { return m_arena; }
+
+    inline T *allocate(size_t n) {
+      if (m_arena == nullptr) {
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+      }
+
+      return static_cast<T*>(m_arena->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    inline void deallocate(T *ptr, size_t) {
+      if (m_arena == nullptr) {
+        ::operator delete(ptr);
+      }
+    }
+
+    template <typename U>
+    inline bool operator==(const AstArenaAllocator<U> &other) const { return m_arena == other.getArena(); }
+    template <typename U>
+    inline bool operator!=(const AstArenaAllocator<U> &other) const { return m_arena != other.getArena(); }
+
+  private:
+    AstArena *m_arena;
+  };
+
+  // a new node, in one allocation with its reference count
+  template <typename T, typename... Args>
+  inline std::shared_ptr<T> makeNode(Args &&...args) {
+    return std::allocate_shared<T>(AstArenaAllocator<T>(), std::forward<Args>(args)...);
+  }
+}
@@ -13,6 +13,8 @@ using Pointer = std::shared_ptr<T>;
 namespace bcparse {
   class AstBinOpStatement : public AstStatement {
   public:
+    static const AstKind nodeKind = AstKind::BinOp;
+
     static const std::vector<std::string> binaryOperations;
 
     AstBinOpStatement(const std::string &opName,
@@ -33,12 +35,12 @@ namespace bcparse {
     Pointer<AstExpression> m_right;
 
     inline Pointer<AstBinOpStatement> CloneImpl() const {
-      return Pointer<AstBinOpStatement>(new AstBinOpStatement(
+      return makeNode<AstBinOpStatement>(
         m_opName,
         cloneAstNode(m_left),
         cloneAstNode(m_right),
         m_location
-      ));
+      );
     }
   };
 }
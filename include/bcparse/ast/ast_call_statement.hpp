@@ -13,7 +13,14 @@ using Pointer = std::shared_ptr<T>;
 namespace bcparse {
   class AstCallStatement : public AstStatement {
   public:
+    static const AstKind nodeKind = AstKind::Call;
+
+    AstCallStatement(std::vector<Pointer<AstExpression>> args,
+      const SourceLocation &location);
+    // a call that stores its result to `result` rather than leaving it in
+    // $r[0], as getfield does. $r[0] may be overwritten all the same.
     AstCallStatement(std::vector<Pointer<AstExpression>> args,
+      const Pointer<AstExpression> &result,
       const SourceLocation &location);
     virtual ~AstCallStatement() = default;
 
@@ -25,12 +32,26 @@ namespace bcparse {
 
   private:
     std::vector<Pointer<AstExpression>> m_args;
+    Pointer<AstExpression> m_result; // or nullptr, for $r[0]
+
+    // the mov of $r[0] to m_result, for a call that cannot store there itself
+    void buildResult(AstVisitor *visitor, Module *mod, BytecodeChunk *out);
+
+    // true when the call can read every argument where it is, with a
+    // constant loaded into $r[i] for argument i, and none read from a
+    // register such a load writes to
+    bool canPassAsOperands() const;
+
+    // true when every argument can be moved straight into $r[1] .. $r[n]
+    // without reading a register another argument is written to
+    bool canPassInRegisters() const;
 
     inline Pointer<AstCallStatement> CloneImpl() const {
-      return Pointer<AstCallStatement>(new AstCallStatement(
+      return makeNode<AstCallStatement>(
         cloneAllAstNodes(m_args),
+        cloneAstNode(m_result),
         m_location
-      ));
+      );
     }
   };
 }
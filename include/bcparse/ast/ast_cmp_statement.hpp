@@ -13,6 +13,8 @@ using Pointer = std::shared_ptr<T>;
 namespace bcparse {
   class AstCmpStatement : public AstStatement {
   public:
+    static const AstKind nodeKind = AstKind::Cmp;
+
     AstCmpStatement(Pointer<AstExpression> left,
       Pointer<AstExpression> right,
       const SourceLocation &location);
@@ -29,11 +31,11 @@ namespace bcparse {
     Pointer<AstExpression> m_right;
 
     inline Pointer<AstCmpStatement> CloneImpl() const {
-      return Pointer<AstCmpStatement>(new AstCmpStatement(
+      return makeNode<AstCmpStatement>(
         cloneAstNode(m_left),
         cloneAstNode(m_right),
         m_location
-      ));
+      );
     }
   };
 }
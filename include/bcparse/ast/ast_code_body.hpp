@@ -26,6 +26,7 @@ namespace bcparse {
   protected:
     AstCodeBody(const std::vector<Token> &tokens,
       const SourceLocation &location,
+      AstKind kind,
       bool variableMode);
 
     std::vector<Token> m_tokens;
@@ -36,10 +37,10 @@ namespace bcparse {
 
   private:
     inline Pointer<AstCodeBody> CloneImpl() const {
-      return Pointer<AstCodeBody>(new AstCodeBody(
+      return makeNode<AstCodeBody>(
         m_tokens,
         m_location
-      ));
+      );
     }
   };
 }
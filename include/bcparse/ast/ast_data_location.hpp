@@ -8,12 +8,15 @@
 namespace bcparse {
   class AstDataLocation : public AstExpression {
   public:
+    static const AstKind nodeKind = AstKind::DataLocation;
+
     AstDataLocation(const std::string &ident,
       const Pointer<AstIntegerLiteral> &offset,
       const SourceLocation &location);
     virtual ~AstDataLocation() = default;
 
     inline const std::string &getIdent() const { return m_ident; }
+    inline const Pointer<AstIntegerLiteral> &getOffset() const { return m_offset; }
 
     virtual void visit(AstVisitor *visitor, Module *mod) override;
     virtual void build(AstVisitor *visitor, Module *mod, BytecodeChunk *out) override;
@@ -29,11 +32,11 @@ namespace bcparse {
     int m_storagePath;
 
     inline Pointer<AstDataLocation> CloneImpl() const {
-      return Pointer<AstDataLocation>(new AstDataLocation(
+      return makeNode<AstDataLocation>(
         m_ident,
         cloneAstNode(m_offset),
         m_location
-      ));
+      );
     }
   };
 }
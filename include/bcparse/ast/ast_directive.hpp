@@ -31,6 +31,9 @@ namespace bcparse {
     virtual void optimize(AstVisitor *visitor, Module *mod) = 0;
 
     void visitArguments(AstVisitor *visitor, Module *mod);
+    // binds `name` in the closest scope that declared it with @var, or as
+    // a global if none did
+    void setVariable(AstVisitor *visitor, const std::string &name, const Pointer<AstExpression> &value);
 
     std::vector<Pointer<AstExpression>> m_arguments;
     std::vector<Token> m_tokens;
@@ -39,12 +42,16 @@ namespace bcparse {
 
   class AstDirective : public AstStatement {
   public:
+    static const AstKind nodeKind = AstKind::Directive;
+
     AstDirective(const std::string &name,
       const std::vector<Pointer<AstExpression>> &arguments,
       const std::vector<Token> &tokens,
       const SourceLocation &location);
     virtual ~AstDirective() override;
 
+    inline const std::string &getName() const { return m_name; }
+
     virtual void visit(AstVisitor *visitor, Module *mod) override;
     virtual void build(AstVisitor *visitor, Module *mod, BytecodeChunk *out) override;
     virtual void optimize(AstVisitor *visitor, Module *mod) override;
@@ -61,12 +68,12 @@ namespace bcparse {
     AstDirectiveImpl *m_impl;
 
     inline Pointer<AstDirective> CloneImpl() const {
-      return Pointer<AstDirective>(new AstDirective(
+      return makeNode<AstDirective>(
         m_name,
-        m_arguments,
+        cloneAllAstNodes(m_arguments),
         m_tokens,
         m_location
-      ));
+      );
     }
   };
 }
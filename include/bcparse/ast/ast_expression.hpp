@@ -11,8 +11,10 @@ namespace bcparse {
   class AstExpression : public AstStatement {
   public:
     static std::string nodeToString(AstVisitor *visitor, AstExpression *node);
+    // integer and float literals, which instructions can take as an inline 8 byte immediate
+    static bool isImmediate(AstExpression *node);
 
-    AstExpression(const SourceLocation &location);
+    AstExpression(const SourceLocation &location, AstKind kind);
 
     virtual AstExpression *getValueOf();
     virtual AstExpression *getDeepValueOf();
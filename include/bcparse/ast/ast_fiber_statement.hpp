@@ -0,0 +1,54 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+
+#include <bcparse/ast/ast_statement.hpp>
+#include <bcparse/ast/ast_expression.hpp>
+
+template <typename T>
+using Pointer = std::shared_ptr<T>;
+
+namespace bcparse {
+  // spawn <dst> <label>, yield, join <fiber> and halt
+  class AstFiberStatement : public AstStatement {
+  public:
+    static const AstKind nodeKind = AstKind::Fiber;
+
+    enum class Kind {
+      Spawn = 0, // the new fiber's id to `left`; it starts at the label `right`
+      Yield = 1,
+      Join = 2, // waits for the fiber `left` to end; its $r[0] to $r[0]
+      Halt = 3 // ends the running fiber, or the program on the main one
+    };
+
+    AstFiberStatement(Kind kind,
+      Pointer<AstExpression> left,
+      Pointer<AstExpression> right,
+      const SourceLocation &location);
+    virtual ~AstFiberStatement() = default;
+
+    inline Kind getKind() const { return m_kind; }
+
+    virtual void visit(AstVisitor *visitor, Module *mod) override;
+    virtual void build(AstVisitor *visitor, Module *mod, BytecodeChunk *out) override;
+    virtual void optimize(AstVisitor *visitor, Module *mod) override;
+
+    virtual Pointer<AstStatement> clone() const override;
+
+  private:
+    Kind m_kind;
+    Pointer<AstExpression> m_left; // nullptr for yield and halt
+    Pointer<AstExpression> m_right; // only for spawn
+
+    inline Pointer<AstFiberStatement> CloneImpl() const {
+      return makeNode<AstFiberStatement>(
+        m_kind,
+        cloneAstNode(m_left),
+        cloneAstNode(m_right),
+        m_location
+      );
+    }
+  };
+}
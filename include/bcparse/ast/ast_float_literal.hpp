@@ -8,6 +8,8 @@ using Pointer = std::shared_ptr<T>;
 namespace bcparse {
   class AstFloatLiteral : public AstExpression {
   public:
+    static const AstKind nodeKind = AstKind::FloatLiteral;
+
     AstFloatLiteral(double value, const SourceLocation &location);
     virtual ~AstFloatLiteral() = default;
 
@@ -25,10 +27,10 @@ namespace bcparse {
     double m_value;
 
     inline Pointer<AstFloatLiteral> CloneImpl() const {
-      return Pointer<AstFloatLiteral>(new AstFloatLiteral(
+      return makeNode<AstFloatLiteral>(
         m_value,
         m_location
-      ));
+      );
     }
   };
 }
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+
+#include <bcparse/ast/ast_statement.hpp>
+#include <bcparse/ast/ast_expression.hpp>
+
+template <typename T>
+using Pointer = std::shared_ptr<T>;
+
+namespace bcparse {
+  // fcall <label> and ret [<args>]: a script function's call and return,
+  // with a frame on the stack, see Op_FCall
+  class AstFrameStatement : public AstStatement {
+  public:
+    static const AstKind nodeKind = AstKind::Frame;
+
+    enum class Kind {
+      Call = 0, // calls the function at the label `arg`
+      Return = 1 // returns, popping `arg` arguments, none if nullptr
+    };
+
+    AstFrameStatement(Kind kind,
+      Pointer<AstExpression> arg,
+      const SourceLocation &location);
+    virtual ~AstFrameStatement() = default;
+
+    inline Kind getKind() const { return m_kind; }
+
+    virtual void visit(AstVisitor *visitor, Module *mod) override;
+    virtual void build(AstVisitor *visitor, Module *mod, BytecodeChunk *out) override;
+    virtual void optimize(AstVisitor *visitor, Module *mod) override;
+
+    virtual Pointer<AstStatement> clone() const override;
+
+  private:
+    Kind m_kind;
+    Pointer<AstExpression> m_arg;
+    size_t m_numArgs; // of a return, once visited
+
+    inline Pointer<AstFrameStatement> CloneImpl() const {
+      return makeNode<AstFrameStatement>(
+        m_kind,
+        cloneAstNode(m_arg),
+        m_location
+      );
+    }
+  };
+}
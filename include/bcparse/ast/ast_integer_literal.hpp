@@ -8,6 +8,8 @@ using Pointer = std::shared_ptr<T>;
 namespace bcparse {
   class AstIntegerLiteral : public AstExpression {
   public:
+    static const AstKind nodeKind = AstKind::IntegerLiteral;
+
     AstIntegerLiteral(int64_t value, const SourceLocation &location);
     virtual ~AstIntegerLiteral() = default;
 
@@ -25,10 +27,10 @@ namespace bcparse {
     int64_t m_value;
 
     inline Pointer<AstIntegerLiteral> CloneImpl() const {
-      return Pointer<AstIntegerLiteral>(new AstIntegerLiteral(
+      return makeNode<AstIntegerLiteral>(
         m_value,
         m_location
-      ));
+      );
     }
   };
 }
@@ -5,6 +5,8 @@
 namespace bcparse {
   class AstInterpolation : public AstCodeBody {
   public:
+    static const AstKind nodeKind = AstKind::Interpolation;
+
     AstInterpolation(const std::vector<Token> &tokens,
       const SourceLocation &location);
     virtual ~AstInterpolation();
@@ -30,10 +32,10 @@ namespace bcparse {
     void setInterpValue(AstExpression *value, bool owned);
 
     inline Pointer<AstInterpolation> CloneImpl() const {
-      return Pointer<AstInterpolation>(new AstInterpolation(
+      return makeNode<AstInterpolation>(
         m_tokens,
         m_location
-      ));
+      );
     }
   };
 }
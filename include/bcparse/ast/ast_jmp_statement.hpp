@@ -13,6 +13,8 @@ using Pointer = std::shared_ptr<T>;
 namespace bcparse {
   class AstJmpStatement : public AstStatement {
   public:
+    static const AstKind nodeKind = AstKind::Jmp;
+
     enum class JumpMode {
       None = 0,
       JumpIfEqual = 1,
@@ -42,11 +44,11 @@ namespace bcparse {
     Pointer<AstExpression> m_pointee;
 
     inline Pointer<AstJmpStatement> CloneImpl() const {
-      return Pointer<AstJmpStatement>(new AstJmpStatement(
+      return makeNode<AstJmpStatement>(
         cloneAstNode(m_arg),
         m_jumpMode,
         m_location
-      ));
+      );
     }
   };
 }
@@ -6,6 +6,8 @@
 namespace bcparse {
   class AstLabel : public AstExpression {
   public:
+    static const AstKind nodeKind = AstKind::Label;
+
     AstLabel(const std::string &name,
       const Pointer<AstDataLocation> &dataLocation,
       const SourceLocation &location);
@@ -29,11 +31,11 @@ namespace bcparse {
     Pointer<AstDataLocation> m_dataLocation;
 
     inline Pointer<AstLabel> CloneImpl() const {
-      return Pointer<AstLabel>(new AstLabel(
+      return makeNode<AstLabel>(
         m_name,
         cloneAstNode(m_dataLocation),
         m_location
-      ));
+      );
     }
   };
 }
@@ -6,12 +6,15 @@
 namespace bcparse {
   class AstLabelDecl : public AstStatement {
   public:
+    static const AstKind nodeKind = AstKind::LabelDecl;
+
     AstLabelDecl(const std::string &name,
       Pointer<AstLabel> astLabel,
       const SourceLocation &location);
     virtual ~AstLabelDecl() = default;
 
     const std::string &getName() const { return m_name; }
+    const Pointer<AstLabel> &getAstLabel() const { return m_astLabel; }
 
     virtual void visit(AstVisitor *visitor, Module *mod) override;
     virtual void build(AstVisitor *visitor, Module *mod, BytecodeChunk *out) override;
@@ -24,11 +27,11 @@ namespace bcparse {
     Pointer<AstLabel> m_astLabel;
 
     inline Pointer<AstLabelDecl> CloneImpl() const {
-      return Pointer<AstLabelDecl>(new AstLabelDecl(
+      return makeNode<AstLabelDecl>(
         m_name,
         cloneAstNode(m_astLabel),
         m_location
-      ));
+      );
     }
   };
 }
@@ -13,6 +13,8 @@ using Pointer = std::shared_ptr<T>;
 namespace bcparse {
   class AstMovStatement : public AstStatement {
   public:
+    static const AstKind nodeKind = AstKind::Mov;
+
     AstMovStatement(Pointer<AstExpression> left,
       Pointer<AstExpression> right,
       const SourceLocation &location);
@@ -29,11 +31,11 @@ namespace bcparse {
     Pointer<AstExpression> m_right;
 
     inline Pointer<AstMovStatement> CloneImpl() const {
-      return Pointer<AstMovStatement>(new AstMovStatement(
+      return makeNode<AstMovStatement>(
         cloneAstNode(m_left),
         cloneAstNode(m_right),
         m_location
-      ));
+      );
     }
   };
 }
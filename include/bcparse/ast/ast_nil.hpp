@@ -5,6 +5,8 @@
 namespace bcparse {
   class AstNil : public AstExpression {
   public:
+    static const AstKind nodeKind = AstKind::Nil;
+
     AstNil(const SourceLocation &location);
     virtual ~AstNil() = default;
 
@@ -18,9 +20,9 @@ namespace bcparse {
 
   private:
     inline Pointer<AstNil> CloneImpl() const {
-      return Pointer<AstNil>(new AstNil(
+      return makeNode<AstNil>(
         m_location
-      ));
+      );
     }
   };
 }
@@ -11,6 +11,8 @@ using Pointer = std::shared_ptr<T>;
 namespace bcparse {
   class AstPopStatement : public AstStatement {
   public:
+    static const AstKind nodeKind = AstKind::Pop;
+
     AstPopStatement(size_t amt,
       const SourceLocation &location);
     virtual ~AstPopStatement() = default;
@@ -25,10 +27,10 @@ namespace bcparse {
     size_t m_amt;
 
     inline Pointer<AstPopStatement> CloneImpl() const {
-      return Pointer<AstPopStatement>(new AstPopStatement(
+      return makeNode<AstPopStatement>(
         m_amt,
         m_location
-      ));
+      );
     }
   };
 }
@@ -13,6 +13,8 @@ using Pointer = std::shared_ptr<T>;
 namespace bcparse {
   class AstPrintStatement : public AstStatement {
   public:
+    static const AstKind nodeKind = AstKind::Print;
+
     AstPrintStatement(std::vector<Pointer<AstExpression>> args,
       const SourceLocation &location);
     virtual ~AstPrintStatement() = default;
@@ -27,10 +29,10 @@ namespace bcparse {
     std::vector<Pointer<AstExpression>> m_args;
 
     inline Pointer<AstPrintStatement> CloneImpl() const {
-      return Pointer<AstPrintStatement>(new AstPrintStatement(
+      return makeNode<AstPrintStatement>(
         cloneAllAstNodes(m_args),
         m_location
-      ));
+      );
     }
   };
 }
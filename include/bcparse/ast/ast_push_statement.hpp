@@ -13,6 +13,8 @@ using Pointer = std::shared_ptr<T>;
 namespace bcparse {
   class AstPushStatement : public AstStatement {
   public:
+    static const AstKind nodeKind = AstKind::Push;
+
     AstPushStatement(Pointer<AstExpression> arg, // could be an expression or a data location
       const SourceLocation &location);
     virtual ~AstPushStatement() = default;
@@ -27,10 +29,10 @@ namespace bcparse {
     Pointer<AstExpression> m_arg;
 
     inline Pointer<AstPushStatement> CloneImpl() const {
-      return Pointer<AstPushStatement>(new AstPushStatement(
+      return makeNode<AstPushStatement>(
         cloneAstNode(m_arg),
         m_location
-      ));
+      );
     }
   };
 }
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+
+#include <bcparse/ast/ast_statement.hpp>
+#include <bcparse/ast/ast_expression.hpp>
+#include <bcparse/ast/ast_jmp_statement.hpp>
+
+template <typename T>
+using Pointer = std::shared_ptr<T>;
+
+namespace bcparse {
+  // set<cc> <dst> and select<cc> <dst> <a> <b>, with cc one of e, ne, g
+  // and ge as for the jumps: 1 or 0, or `a` or `b`, to `dst` by whether
+  // the condition holds for the last `cmp`
+  class AstSelectStatement : public AstStatement {
+  public:
+    static const AstKind nodeKind = AstKind::Select;
+
+    AstSelectStatement(AstJmpStatement::JumpMode condition,
+      Pointer<AstExpression> dst,
+      Pointer<AstExpression> a,
+      Pointer<AstExpression> b,
+      const SourceLocation &location);
+    virtual ~AstSelectStatement() = default;
+
+    virtual void visit(AstVisitor *visitor, Module *mod) override;
+    virtual void build(AstVisitor *visitor, Module *mod, BytecodeChunk *out) override;
+    virtual void optimize(AstVisitor *visitor, Module *mod) override;
+
+    virtual Pointer<AstStatement> clone() const override;
+
+  private:
+    AstJmpStatement::JumpMode m_condition;
+    Pointer<AstExpression> m_dst;
+    Pointer<AstExpression> m_a; // nullptr for set<cc>
+    Pointer<AstExpression> m_b; // nullptr for set<cc>
+
+    inline Pointer<AstSelectStatement> CloneImpl() const {
+      return makeNode<AstSelectStatement>(
+        m_condition,
+        cloneAstNode(m_dst),
+        cloneAstNode(m_a),
+        cloneAstNode(m_b),
+        m_location
+      );
+    }
+  };
+}
@@ -5,6 +5,8 @@
 
 #include <shared/source_location.hpp>
 
+#include <bcparse/ast/ast_arena.hpp>
+
 template <typename T>
 using Pointer = std::shared_ptr<T>;
 
@@ -19,14 +21,45 @@ namespace bcparse {
   class Module;
   class BytecodeChunk;
 
+  // what a node is, set by its constructor, so that a pass can test for a
+  // type with astCast or switch over them without a dynamic_cast
+  enum class AstKind {
+    BinOp,
+    Call,
+    Cmp,
+    CodeBody,
+    DataLocation,
+    Directive,
+    Fiber,
+    FloatLiteral,
+    Frame,
+    IntegerLiteral,
+    Interpolation,
+    Jmp,
+    Label,
+    LabelDecl,
+    Mov,
+    Nil,
+    Pop,
+    Print,
+    Push,
+    Select,
+    StringLiteral,
+    Symbol,
+    Unset,
+    Variable
+  };
+
   class AstStatement {
   public:
-    AstStatement(const SourceLocation &location);
+    AstStatement(const SourceLocation &location, AstKind kind);
     virtual ~AstStatement() = default;
 
     inline SourceLocation &getLocation() { return m_location; }
     inline const SourceLocation &getLocation() const { return m_location; }
 
+    inline AstKind getKind() const { return m_kind; }
+
     virtual void visit(AstVisitor *visitor, Module *mod) = 0;
     virtual void build(AstVisitor *visitor, Module *mod, BytecodeChunk *out) = 0;
     virtual void optimize(AstVisitor *visitor, Module *mod) = 0;
@@ -36,8 +69,18 @@ namespace bcparse {
 
   protected:
     SourceLocation m_location;
+
+  private:
+    AstKind m_kind;
   };
 
+  // `node` as a T, or NULL if it is some other kind of node. T is a class
+  // with a nodeKind, which only those without subclasses have.
+  template <typename T>
+  inline T *astCast(AstStatement *node) {
+    return node != nullptr && node->getKind() == T::nodeKind ? static_cast<T*>(node) : nullptr;
+  }
+
   template <typename T>
   typename enable_if<is_base_of<AstStatement, T>::value, Pointer<T>>::type
   cloneAstNode(const Pointer<T> &stmt) {
@@ -5,10 +5,15 @@
 namespace bcparse {
   class AstStringLiteral : public AstExpression {
   public:
-    AstStringLiteral(const std::string &value, const SourceLocation &location);
+    static const AstKind nodeKind = AstKind::StringLiteral;
+
+    // `align`, if not 0, is what its constant is aligned to, see
+    // DataStorage::setAlignment
+    AstStringLiteral(const std::string &value, const SourceLocation &location, size_t align = 0);
     virtual ~AstStringLiteral() = default;
 
     const std::string &getValue() const { return m_value; }
+    size_t getAlign() const { return m_align; }
 
     virtual void visit(AstVisitor *visitor, Module *mod) override;
     virtual void build(AstVisitor *visitor, Module *mod, BytecodeChunk *out) override;
@@ -20,13 +25,15 @@ namespace bcparse {
 
   protected:
     std::string m_value;
+    size_t m_align;
 
   private:
     inline Pointer<AstStringLiteral> CloneImpl() const {
-      return Pointer<AstStringLiteral>(new AstStringLiteral(
+      return makeNode<AstStringLiteral>(
         m_value,
-        m_location
-      ));
+        m_location,
+        m_align
+      );
     }
   };
 }
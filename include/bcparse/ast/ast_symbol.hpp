@@ -9,6 +9,8 @@
 namespace bcparse {
   class AstSymbol : public AstExpression {
   public:
+    static const AstKind nodeKind = AstKind::Symbol;
+
     AstSymbol(const std::string &name, const SourceLocation &location);
     virtual ~AstSymbol() = default;
 
@@ -24,10 +26,10 @@ namespace bcparse {
     std::string m_name;
 
     inline Pointer<AstSymbol> CloneImpl() const {
-      return Pointer<AstSymbol>(new AstSymbol(
+      return makeNode<AstSymbol>(
         m_name,
         m_location
-      ));
+      );
     }
   };
 }
@@ -5,6 +5,8 @@
 namespace bcparse {
   class AstUnset : public AstExpression {
   public:
+    static const AstKind nodeKind = AstKind::Unset;
+
     AstUnset(const SourceLocation &location);
     virtual ~AstUnset() = default;
 
@@ -17,9 +19,9 @@ namespace bcparse {
 
   private:
     inline Pointer<AstUnset> CloneImpl() const {
-      return Pointer<AstUnset>(new AstUnset(
+      return makeNode<AstUnset>(
         m_location
-      ));
+      );
     }
   };
 }
@@ -5,6 +5,8 @@
 namespace bcparse {
   class AstVariable : public AstExpression {
   public:
+    static const AstKind nodeKind = AstKind::Variable;
+
     AstVariable(const std::string &name, const SourceLocation &location);
     virtual ~AstVariable() = default;
 
@@ -27,10 +29,10 @@ namespace bcparse {
     Pointer<AstExpression> m_value;
 
     inline Pointer<AstVariable> CloneImpl() const {
-      return Pointer<AstVariable>(new AstVariable(
+      return makeNode<AstVariable>(
         m_name,
         m_location
-      ));
+      );
     }
   };
 }
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <bcparse/ast/ast_directive.hpp>
+
+namespace bcparse {
+  // @embed name "path" [align]: the bytes of the file at `path`, relative
+  // to the source, as a string constant bound to `name`, and their count
+  // as an integer bound to `name`_size. the constant is read-only and
+  // needs no copy or read at startup: the vm points into the mapped .bin
+  // (see BIN_CONST_IN_PLACE), at a multiple of `align` -- a power of two
+  // up to BIN_CONST_ALIGN -- if given. it ends with a NUL, not counted.
+  class AstEmbedDirective : public AstDirectiveImpl {
+    friend class AstDirective;
+  protected:
+    AstEmbedDirective(const std::vector<Pointer<AstExpression>> &arguments,
+      const std::vector<Token> &tokens,
+      const SourceLocation &location);
+    virtual ~AstEmbedDirective() override;
+
+    virtual void visit(AstVisitor *visitor, Module *mod) override;
+    virtual void build(AstVisitor *visitor, Module *mod, BytecodeChunk *out) override;
+    virtual void optimize(AstVisitor *visitor, Module *mod) override;
+  };
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <bcparse/ast/ast_directive.hpp>
+
+namespace bcparse {
+  // @eval name { expr } -- evaluates expr at compile time (see
+  // ConstEvaluator) and binds name to the result as @set would, so that
+  // #{name} is an immediate, or static data for a string.
+  class AstEvalDirective : public AstDirectiveImpl {
+    friend class AstDirective;
+  protected:
+    AstEvalDirective(const std::vector<Pointer<AstExpression>> &arguments,
+      const std::vector<Token> &tokens,
+      const SourceLocation &location);
+    virtual ~AstEvalDirective() override;
+
+    virtual void visit(AstVisitor *visitor, Module *mod) override;
+    virtual void build(AstVisitor *visitor, Module *mod, BytecodeChunk *out) override;
+    virtual void optimize(AstVisitor *visitor, Module *mod) override;
+  };
+}
@@ -8,7 +8,8 @@ namespace bcparse {
   protected:
     AstIncludeDirective(const std::vector<Pointer<AstExpression>> &arguments,
       const std::vector<Token> &tokens,
-      const SourceLocation &location);
+      const SourceLocation &location,
+      bool once = false);
     virtual ~AstIncludeDirective() override;
 
     virtual void visit(AstVisitor *visitor, Module *mod) override;
@@ -16,6 +17,8 @@ namespace bcparse {
     virtual void optimize(AstVisitor *visitor, Module *mod) override;
 
   private:
+    bool m_once; // @include_once: nothing if the file was included before
+    std::string m_path; // canonical, once visited
     AstIterator *m_iterator;
     CompilationUnit *m_compilationUnit;
   };
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <bcparse/ast/ast_directive.hpp>
+
+#include <bcparse/emit/emit.hpp>
+
+namespace bcparse {
+  class AstCodeBody;
+
+  // @inline { ... } -- the calls in the body, and the functions defined
+  // in it, are inlined wherever they can be, whatever their size.
+  // @noinline { ... } -- they never are. a hint nested in the body
+  // wins over this one. see BytecodeChunk::inlineCalls.
+  class AstInlineDirective : public AstDirectiveImpl {
+    friend class AstDirective;
+  protected:
+    AstInlineDirective(const std::vector<Pointer<AstExpression>> &arguments,
+      const std::vector<Token> &tokens,
+      const SourceLocation &location,
+      InlineHint hint);
+    virtual ~AstInlineDirective() override;
+
+    virtual void visit(AstVisitor *visitor, Module *mod) override;
+    virtual void build(AstVisitor *visitor, Module *mod, BytecodeChunk *out) override;
+    virtual void optimize(AstVisitor *visitor, Module *mod) override;
+
+  private:
+    Pointer<AstCodeBody> m_body;
+    InlineHint m_hint;
+  };
+}
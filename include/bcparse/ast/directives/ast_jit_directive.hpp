@@ -0,0 +1,29 @@
+#pragma once
+
+#include <bcparse/ast/ast_directive.hpp>
+
+namespace bcparse {
+  class AstCodeBody;
+
+  // @jit { ... } -- wraps the body in OP_JIT markers, so the VM may
+  // compile it to native code. the compiled region is stored in a new
+  // static data slot.
+  // @jit n { ... } -- also memoizes it: the body must be a pure function
+  // of the top n stack values, leaving its result in $r[0].
+  class AstJitDirective : public AstDirectiveImpl {
+    friend class AstDirective;
+  protected:
+    AstJitDirective(const std::vector<Pointer<AstExpression>> &arguments,
+      const std::vector<Token> &tokens,
+      const SourceLocation &location);
+    virtual ~AstJitDirective() override;
+
+    virtual void visit(AstVisitor *visitor, Module *mod) override;
+    virtual void build(AstVisitor *visitor, Module *mod, BytecodeChunk *out) override;
+    virtual void optimize(AstVisitor *visitor, Module *mod) override;
+
+  private:
+    Pointer<AstCodeBody> m_body;
+    uint8_t m_memoArgs;
+  };
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <bcparse/ast/ast_directive.hpp>
+
+namespace bcparse {
+  // @export name -- the label `name` is bound to is one other objects
+  // can jump to and call, by that name, once linked with bclink.
+  // @extern name -- binds `name` to a label another object exports, so
+  // that it can be jumped to and called here. see SymbolMarker.
+  class AstLinkDirective : public AstDirectiveImpl {
+    friend class AstDirective;
+  protected:
+    AstLinkDirective(const std::vector<Pointer<AstExpression>> &arguments,
+      const std::vector<Token> &tokens,
+      const SourceLocation &location,
+      bool exported);
+    virtual ~AstLinkDirective() override;
+
+    virtual void visit(AstVisitor *visitor, Module *mod) override;
+    virtual void build(AstVisitor *visitor, Module *mod, BytecodeChunk *out) override;
+    virtual void optimize(AstVisitor *visitor, Module *mod) override;
+
+  private:
+    std::string m_name;
+    Pointer<AstExpression> m_bound; // what `m_name` is bound to
+    AstExpression *m_target; // the label or its $s[] slot, or NULL
+    bool m_exported;
+  };
+}
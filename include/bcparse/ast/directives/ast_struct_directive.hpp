@@ -0,0 +1,28 @@
+#pragma once
+
+#include <bcparse/ast/ast_directive.hpp>
+
+namespace bcparse {
+  // @struct name { field ... }: a record of fixed layout, its fields
+  // numbered in order. binds `name`_`field` to the slot of each and
+  // `name`_size to their count, so that
+  //
+  //   call #{structCreate} #{point_size}
+  //   setslot $r[0] #{point_x} 1
+  //   getslot $r[1] $r[0] #{point_x}
+  //
+  // reach a field by a constant index, with nothing looked up at runtime.
+  // fields are separated by newlines or commas.
+  class AstStructDirective : public AstDirectiveImpl {
+    friend class AstDirective;
+  protected:
+    AstStructDirective(const std::vector<Pointer<AstExpression>> &arguments,
+      const std::vector<Token> &tokens,
+      const SourceLocation &location);
+    virtual ~AstStructDirective() override;
+
+    virtual void visit(AstVisitor *visitor, Module *mod) override;
+    virtual void build(AstVisitor *visitor, Module *mod, BytecodeChunk *out) override;
+    virtual void optimize(AstVisitor *visitor, Module *mod) override;
+  };
+}
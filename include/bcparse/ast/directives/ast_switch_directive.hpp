@@ -0,0 +1,28 @@
+#pragma once
+
+#include <bcparse/ast/ast_directive.hpp>
+
+namespace bcparse {
+  // @switch src low default case... -- a jump to the case `src - low`
+  // of the labels after the default, or to the default if `src` is
+  // outside low .. low + count - 1, in one instruction whatever the
+  // count. `src` holds an int; `low` must be known when compiling, and
+  // the cases must be labels of this source.
+  class AstSwitchDirective : public AstDirectiveImpl {
+    friend class AstDirective;
+  protected:
+    static const size_t maxCases = 65535;
+
+    AstSwitchDirective(const std::vector<Pointer<AstExpression>> &arguments,
+      const std::vector<Token> &tokens,
+      const SourceLocation &location);
+    virtual ~AstSwitchDirective() override;
+
+    virtual void visit(AstVisitor *visitor, Module *mod) override;
+    virtual void build(AstVisitor *visitor, Module *mod, BytecodeChunk *out) override;
+    virtual void optimize(AstVisitor *visitor, Module *mod) override;
+
+  private:
+    int64_t m_low;
+  };
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <bcparse/ast/ast_directive.hpp>
+
+namespace bcparse {
+  class AstCodeBody;
+  // @try_region handler { ... } -- a throw in the body, or in a function
+  // it calls, goes on at the label `handler`, see TryMarker. the body
+  // runs as it would without it. lib/try.bb8 builds @try and @catch on it.
+  class AstTryDirective : public AstDirectiveImpl {
+    friend class AstDirective;
+  protected:
+    AstTryDirective(const std::vector<Pointer<AstExpression>> &arguments,
+      const std::vector<Token> &tokens,
+      const SourceLocation &location);
+    virtual ~AstTryDirective() override;
+
+    virtual void visit(AstVisitor *visitor, Module *mod) override;
+    virtual void build(AstVisitor *visitor, Module *mod, BytecodeChunk *out) override;
+    virtual void optimize(AstVisitor *visitor, Module *mod) override;
+
+  private:
+    Pointer<AstCodeBody> m_body;
+    AstExpression *m_handler; // the label, or its slot: owned by the argument
+  };
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <bcparse/ast/ast_directive.hpp>
+
+#include <memory>
+
+namespace bcparse {
+  class AstIterator;
+  class CompilationUnit;
+
+  // @unroll n { ... } -- the body n times over, with no compare or jump
+  // between the copies. n must be known when compiling (a literal, or a
+  // name bound by @set or @eval).
+  // @unroll n i { ... } -- also binds i to the number of each copy, from
+  // 0, so that #{i} in it is a constant to fold.
+  class AstUnrollDirective : public AstDirectiveImpl {
+    friend class AstDirective;
+  protected:
+    static const int64_t maxCount = 1024;
+
+    AstUnrollDirective(const std::vector<Pointer<AstExpression>> &arguments,
+      const std::vector<Token> &tokens,
+      const SourceLocation &location);
+    virtual ~AstUnrollDirective() override;
+
+    virtual void visit(AstVisitor *visitor, Module *mod) override;
+    virtual void build(AstVisitor *visitor, Module *mod, BytecodeChunk *out) override;
+    virtual void optimize(AstVisitor *visitor, Module *mod) override;
+
+  private:
+    // one of each per copy, the iterators destroyed first
+    std::vector<std::unique_ptr<CompilationUnit>> m_compilationUnits;
+    std::vector<std::unique_ptr<AstIterator>> m_iterators;
+  };
+}
@@ -31,6 +31,8 @@ namespace bcparse {
     inline Pointer<AstStatement> &last() { return m_list.back(); }
     inline const Pointer<AstStatement> &last() const { return m_list.back(); }
 
+    inline const std::vector<Pointer<AstStatement>> &getStatements() const { return m_list; }
+
   private:
     size_t m_position;
     std::vector<Pointer<AstStatement>> m_list;
@@ -5,17 +5,25 @@
 #include <bcparse/token.hpp>
 #include <bcparse/macro.hpp>
 
-#include <map>
+#include <unordered_map>
 #include <string>
 #include <vector>
 #include <memory>
+#include <cstdint>
 
 template <typename T>
 using Pointer = std::shared_ptr<T>;
 
 namespace bcparse {
+  // names bound in a scope, keyed by their interned string (see
+  // SymbolTable), so a lookup hashes a pointer at each level of the chain
+  // of parents instead of comparing strings. what a lookup found up the
+  // chain is remembered in the scope it started from, until anything is
+  // bound again on this thread.
   class BoundVariables {
   public:
+    using Map = std::unordered_map<const std::string*, Pointer<AstExpression>>;
+
     BoundVariables();
     BoundVariables(const BoundVariables &other);
 
@@ -23,16 +31,23 @@ namespace bcparse {
     BoundVariables *getParent();
 
     Pointer<AstExpression> get(const std::string &name, bool bubbles = true);
+    Pointer<AstExpression> get(const std::string *name, bool bubbles = true);
     void set(const std::string &name, const Pointer<AstExpression> &value);
 
     void defineMacro(const std::string &name, const std::vector<Token> &body);
     Macro *lookupMacro(const std::string &name);
 
-    std::map<std::string, Pointer<AstExpression>> &getMap() { return m_map; }
+    Map &getMap() { return m_map; }
 
   private:
+    struct Resolved {
+      uint64_t generation = 0;
+      Pointer<AstExpression> value;
+    };
+
     BoundVariables *m_parent;
-    std::map<std::string, Pointer<AstExpression>> m_map;
-    std::map<std::string, std::shared_ptr<Macro>> m_macros;
+    Map m_map;
+    std::unordered_map<const std::string*, std::shared_ptr<Macro>> m_macros;
+    std::unordered_map<const std::string*, Resolved> m_resolved;
   };
 }
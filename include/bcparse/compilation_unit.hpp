@@ -2,16 +2,34 @@
 
 #include <bcparse/error_list.hpp>
 #include <bcparse/bound_variables.hpp>
+#include <bcparse/token.hpp>
 
 #include <bcparse/emit/register_usage.hpp>
 #include <bcparse/emit/relative_stack_offset.hpp>
 #include <bcparse/emit/data_storage.hpp>
 
 #include <map>
+#include <set>
 #include <string>
 #include <memory>
+#include <vector>
+#include <cstdint>
 
 namespace bcparse {
+  // a file lexed for @include, keyed by its canonical path. later includes
+  // of it parse its tokens again instead of reading and lexing it, while
+  // its mtime is the same.
+  struct IncludedFile {
+    int64_t mtime; // in nanoseconds
+    std::vector<Token> tokens;
+  };
+
+  // files lexed by earlier compilations in the same process, by canonical
+  // path, as `bcparse --daemon` keeps them
+  using WarmFiles = std::map<std::string, IncludedFile>;
+
+  class TokenCache;
+
   class CompilationUnit {
   public:
     CompilationUnit(DataStorage *dataStorage);
@@ -21,6 +39,11 @@ namespace bcparse {
     inline void setVariableMode(bool variableMode) { m_variableMode = variableMode; }
     inline bool isVariableMode() const { return m_variableMode; }
 
+    // --flat: the output has no BIN_SECTION_TRIES, so no @try_region.
+    // nested units take it from the one they are in.
+    inline void setFlat(bool flat) { m_flat = flat; }
+    inline bool isFlat() const { return m_flat; }
+
     inline ErrorList &getErrorList() { return m_errorList; }
     inline const ErrorList &getErrorList() const { return m_errorList; }
 
@@ -36,12 +59,33 @@ namespace bcparse {
     inline DataStorage *getDataStorage() { return m_dataStorage; }
     inline const DataStorage *getDataStorage() const { return m_dataStorage; }
 
+    // NULL unless compiling with --cache
+    inline TokenCache *getTokenCache() const { return m_tokenCache; }
+    inline void setTokenCache(TokenCache *tokenCache) { m_tokenCache = tokenCache; }
+
+    // NULL unless compiling in a --daemon
+    inline WarmFiles *getWarmFiles() const { return m_warmFiles; }
+    inline void setWarmFiles(WarmFiles *warmFiles) { m_warmFiles = warmFiles; }
+
+    inline std::map<std::string, IncludedFile> &getIncludedFiles() { return m_includedFiles; }
+    inline const std::map<std::string, IncludedFile> &getIncludedFiles() const { return m_includedFiles; }
+
+    // canonical paths of the files @embed read, which it depends on as
+    // it does on those it includes
+    inline std::set<std::string> &getEmbeddedFiles() { return m_embeddedFiles; }
+    inline const std::set<std::string> &getEmbeddedFiles() const { return m_embeddedFiles; }
+
     private:
       ErrorList m_errorList;
       BoundVariables m_boundGlobals;
       RegisterUsage m_registerUsage;
       RelativeStackOffset m_relativeStackOffset;
       DataStorage *m_dataStorage;
+      std::map<std::string, IncludedFile> m_includedFiles;
+      std::set<std::string> m_embeddedFiles;
+      TokenCache *m_tokenCache;
+      WarmFiles *m_warmFiles;
       bool m_variableMode;
+      bool m_flat;
   };
 }
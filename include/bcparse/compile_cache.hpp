@@ -0,0 +1,50 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace bcparse {
+  // outputs kept in a directory across compilations, and across machines
+  // that share it (bcparse --compile-cache <dir>, or BB8_COMPILE_CACHE),
+  // in the manner of ccache's direct mode. the source's hash, with that of
+  // the compiler itself (which holds the builtin table) and of the options
+  // that change the output, names a manifest: the files the source
+  // included or embedded when it was compiled, relative to it, and their
+  // hashes. if each still hashes the same, the output stored under all of
+  // those hashes is copied out, and nothing is lexed, parsed or emitted.
+  // macros are defined by the files that hold them, so their hashes cover
+  // the macro definitions an output used.
+  //
+  // a manifest holds the files of the last compilation of its source that
+  // was stored. entries are written to a temporary file and renamed into
+  // place, so the directory can be on a filesystem the machines of a build
+  // farm share. bump COMPILE_CACHE_VERSION when what is stored changes.
+  class CompileCache {
+  public:
+    static const uint32_t COMPILE_CACHE_VERSION = 1;
+
+    // `options` are those that change the output, with the contents of
+    // the files they name
+    CompileCache(const std::string &dir, const std::string &options);
+    CompileCache(const CompileCache &other) = delete;
+
+    // writes what was stored for `source` to `outPath`, and the canonical
+    // path of each file it included or embedded to `includes`. false if
+    // nothing was, or a file it was compiled from changed since.
+    bool fetch(const std::string &source, const std::string &outPath, std::vector<std::string> &includes) const;
+    // stores `outPath`, compiled from `source` and `includes`, canonical
+    // paths. nothing is stored if one cannot be read.
+    void store(const std::string &source, const std::string &outPath, const std::vector<std::string> &includes) const;
+
+  private:
+    std::string m_dir;
+    uint64_t m_base; // the compiler and the options
+
+    // the manifest's key, and the directory of the source
+    bool manifestKey(const std::string &source, uint64_t &key, std::string &dir) const;
+    std::string entryPath(uint64_t key, const char *extension) const;
+    // a name of its own for writing `path`, from any thread of any machine
+    static std::string tempPath(const std::string &path);
+  };
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <iostream>
+#include <cstdint>
+#include <cstddef>
+
+namespace bcparse {
+  // what `bcparse --stats` and `--time-phases` report of a compilation:
+  // where its time went and how much it made. collected only while a
+  // Scope for it is current on the thread, so a compilation without
+  // either flag only checks for one.
+  struct CompileStats {
+    enum Phase {
+      PHASE_NONE, // outside of the others: reading files, setting up
+      PHASE_LEX,
+      PHASE_PARSE,
+      PHASE_ANALYZE,
+      PHASE_COMPILE,
+      PHASE_OPTIMIZE, // register allocation and BytecodeChunk::peephole
+      PHASE_EMIT,
+      NUM_PHASES
+    };
+
+    // an @include'd file, over every @include of it
+    struct Include {
+      size_t count = 0;
+      size_t tokens = 0;
+      uint64_t nanos = 0; // lexing, parsing, analyzing and compiling it
+    };
+
+    uint64_t phaseNanos[NUM_PHASES] = { };
+    std::map<std::string, Include> includes; // by canonical path
+    std::map<std::string, size_t> macroInstantiations; // by name
+    size_t tokensLexed = 0;
+    size_t astNodes = 0;
+    size_t staticData = 0; // entries of the DataStorage, labels included
+    size_t codeSize = 0; // bytes
+    size_t outputSize = 0; // bytes
+    int cached = -1; // with --compile-cache, whether the output was fetched from it (1) or compiled (0)
+
+    // the stats collected into on this thread, or NULL
+    static CompileStats *current();
+
+    // makes `stats` current on this thread while it lives
+    class Scope {
+    public:
+      Scope(CompileStats *stats);
+      Scope(const Scope &other) = delete;
+      ~Scope();
+
+    private:
+      CompileStats *m_previous;
+    };
+
+    // charges the time it lives to `phase`, taking it from the phase it
+    // interrupts, so that the phases add up to the whole compilation
+    class Timer {
+    public:
+      Timer(Phase phase);
+      Timer(const Timer &other) = delete;
+      ~Timer();
+
+    private:
+      CompileStats *m_stats;
+      Phase m_previous;
+    };
+
+    // adds the nanoseconds it lives to `*nanos`, phases within it
+    // included. nothing if `nanos` is NULL.
+    class Stopwatch {
+    public:
+      Stopwatch(uint64_t *nanos);
+      Stopwatch(const Stopwatch &other) = delete;
+      ~Stopwatch();
+
+    private:
+      uint64_t *m_nanos;
+      uint64_t m_start;
+    };
+
+    // the phase times with `times`, the counts with `counts`, as a JSON
+    // object or as text
+    void write(std::ostream &os, bool times, bool counts, bool json) const;
+
+    // `s` as the body of a JSON string
+    static std::string jsonEscape(const std::string &s);
+
+  private:
+    Phase m_phase = PHASE_NONE;
+    uint64_t m_since = 0; // when m_phase was last charged
+
+    void charge(uint64_t now);
+  };
+}
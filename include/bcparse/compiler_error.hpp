@@ -3,6 +3,7 @@
 #include <string>
 #include <sstream>
 #include <map>
+#include <vector>
 
 #include <shared/source_location.hpp>
 
@@ -117,6 +118,9 @@ namespace bcparse {
     Msg_module_name_begins_lowercase
   };
 
+  // a record of the message and its arguments, which are only put
+  // together into text when it is asked for, so that the errors of a
+  // failing build that are never written out cost little
   class CompilerError {
     static const std::map<ErrorMessage, std::string> error_message_strings;
 
@@ -128,13 +132,9 @@ namespace bcparse {
       const Args &...args)
         : m_level(level),
           m_msg(msg),
-          m_location(location) {
-      if (m_msg == Msg_custom_error) {
-        makeMessage(args...);
-      } else {
-        std::string msg_str = error_message_strings.at(m_msg);
-        makeMessage(msg_str.c_str(), args...);
-      }
+          m_location(location),
+          m_args { toArg(args)... },
+          m_formatted(false) {
     }
 
     CompilerError(const CompilerError &other);
@@ -143,40 +143,27 @@ namespace bcparse {
     inline ErrorLevel getLevel() const { return m_level; }
     inline ErrorMessage getMessage() const { return m_msg; }
     inline const SourceLocation &getLocation() const { return m_location; }
-    inline const std::string &getText() const { return m_text; }
+    const std::string &getText() const;
 
     bool operator<(const CompilerError &other) const;
 
   private:
-    void makeMessage(const char *format) { m_text += format; }
+    static inline std::string toArg(const std::string &value) { return value; }
+    static inline std::string toArg(const char *value) { return value; }
 
+    template <typename T>
+    static std::string toArg(const T &value) {
+      std::stringstream sstream;
+      sstream << value;
 
-    template <typename ... Args>
-    void makeMessage(Args && ... args) {
-      makeMessage(args...);
-    }
-
-    template <typename T, typename ... Args>
-    void makeMessage(const char *format, T value, Args && ... args) {
-      for (; *format; format++) {
-        if (*format == '%') {
-          std::stringstream sstream;
-          sstream << value;
-
-          m_text += sstream.str();
-
-          makeMessage(format + 1, args...);
-
-          return;
-        }
-
-        m_text += *format;
-      }
+      return sstream.str();
     }
 
     ErrorLevel m_level;
     ErrorMessage m_msg;
     SourceLocation m_location;
-    std::string m_text;
+    std::vector<std::string> m_args; // the format first, for Msg_custom_error
+    mutable std::string m_text;
+    mutable bool m_formatted;
   };
 }
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <bcparse/token.hpp>
+
+#include <shared/source_location.hpp>
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+template <typename T>
+using Pointer = std::shared_ptr<T>;
+
+namespace bcparse {
+  class AstExpression;
+  class CompilationUnit;
+
+  // evaluates the body of an @eval at compile time. the body is one
+  // expression in prefix form, `op arg...`, where an argument is a
+  // literal, a name bound to one (by @set, @eval or a macro argument) or
+  // a parenthesized `(op arg...)`:
+  //
+  //   add sub mul div mod neg min max     integers, or floats if either is
+  //   and or xor not shl shr              integers
+  //   eq ne lt le gt ge                   1 or 0
+  //   if c a b                            a if c is not 0, else b
+  //   let name value body                 body with name bound to value
+  //   cat s...  len s  at s i             strings, at gives the byte at i
+  //   substr s i n  repeat s n  chr n  str n
+  //   table n i body                      a string of n bytes, byte i the
+  //                                       value of body with i bound
+  //   fold i from to acc init body        body for each i in [from, to),
+  //                                       with acc its last value
+  //
+  // it has no effects but its result, and stops with an error rather
+  // than run past a fixed number of steps or build too large a string.
+  class ConstEvaluator {
+  public:
+    static const size_t maxSteps = 1 << 20;
+    static const size_t maxLength = 1 << 20;
+
+    ConstEvaluator(CompilationUnit *unit,
+      const std::vector<Token> &tokens,
+      const SourceLocation &location);
+    ConstEvaluator(const ConstEvaluator &other) = delete;
+
+    // an integer, float or string literal, or NULL if it failed, with
+    // the errors added to the unit's error list
+    Pointer<AstExpression> evaluate();
+
+  private:
+    struct Constant {
+      enum Kind { Int, Float, String } kind;
+      int64_t i;
+      double f;
+      std::string s;
+
+      Constant() : kind(Int), i(0), f(0.0) {}
+    };
+
+    struct Local {
+      std::string name;
+      Constant value;
+    };
+
+    bool evalTerm(Constant &out);
+    bool evalCall(const Token &op, Constant &out);
+    bool evalLoop(const Token &op, Constant &out);
+    bool evalOp(const Token &op, const std::vector<Constant> &args, Constant &out);
+    bool skipTerm();
+
+    bool lookup(const Token &name, Constant &out);
+    bool readName(std::string &out);
+    bool expectArgs(const Token &op, const std::vector<Constant> &args, size_t count, const char *kinds);
+    bool atEnd() const;
+    bool error(const SourceLocation &location, const std::string &message);
+
+    CompilationUnit *m_unit;
+    std::vector<Token> m_tokens;
+    SourceLocation m_location;
+    size_t m_pos;
+    size_t m_steps;
+    std::vector<Local> m_locals;
+  };
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace bcparse {
+  // what an output was built from (bcparse --build): the source and each
+  // file it included, with a hash of their contents (str_util::fnv1a), and
+  // the options that change the output. kept next to it, as <output>.d:
+  //
+  //   bb8deps <version>
+  //   options <options>
+  //   <hash> <path>
+  //   ...
+  //
+  // macros are defined by the files that hold them, so their hashes cover
+  // the macro definitions an output used.
+  class DependencyFile {
+  public:
+    static const uint32_t DEPENDENCY_FILE_VERSION = 1;
+
+    DependencyFile(const std::string &options);
+    DependencyFile(const DependencyFile &other) = delete;
+
+    // hashes the file as it is now. false if it cannot be read.
+    bool add(const std::string &path);
+
+    // false if it cannot be written
+    bool write(const std::string &path) const;
+
+    // true if the file at `path` was written with the same options and
+    // version, and every file it lists still hashes the same
+    static bool isUpToDate(const std::string &path, const std::string &options);
+
+    // the hash of the file's contents. false if it cannot be read.
+    static bool hashFile(const std::string &path, uint64_t &out);
+
+  private:
+    struct Entry {
+      uint64_t hash;
+      std::string path;
+    };
+
+    std::string m_options;
+    std::vector<Entry> m_entries;
+  };
+}
@@ -1,5 +1,12 @@
 #pragma once
 
+#include <bcparse/emit/obj_loc.hpp>
+
+#include <shared/source_location.hpp>
+
+#include <vector>
+#include <memory>
+#include <string>
 #include <cstdint>
 #include <cstddef>
 
@@ -14,14 +21,34 @@ namespace bcparse {
     LabelPosition_t position;
   };
 
+  // where code came from: the statement that built it, then the one that
+  // statement was expanded from (a macro call, an @include or an
+  // @unroll), and so on out to the source file being compiled. -g writes
+  // them out as BIN_SECTION_LINES.
+  struct SourceTrace {
+    SourceLocation location;
+    std::string directive; // the name of the directive at `location`, if it is one
+    std::shared_ptr<const SourceTrace> caller;
+  };
+
   class Buildable {
   public:
     virtual ~Buildable() = default;
 
+    // set by the Compiler on each instruction a statement builds. one set
+    // on a chunk covers the leaves in it without their own.
+    inline const std::shared_ptr<const SourceTrace> &getTrace() const { return m_trace; }
+    inline void setTrace(const std::shared_ptr<const SourceTrace> &trace) { m_trace = trace; }
+
     virtual void accept(BytecodeStream *bs);
     virtual void debugPrint(BytecodeStream *bs, Formatter *f);
+    // appends the data locations it reads or writes to `out`, which
+    // BytecodeChunk's passes look at and may rewrite. false if it does
+    // not know them.
+    virtual bool getObjLocs(std::vector<ObjLoc*> &out);
 
   private:
     size_t m_loc;
+    std::shared_ptr<const SourceTrace> m_trace;
   };
 }
@@ -8,6 +8,7 @@
 
 namespace bcparse {
   class BytecodeStream;
+  class Profile;
 
   class BytecodeChunk : public Buildable {
   public:
@@ -20,9 +21,110 @@ namespace bcparse {
     void accept(BytecodeStream *bs) override;
     void debugPrint(BytecodeStream *bs, Formatter *f) override;
 
+    // within each run of instructions between labels and jumps, follows the
+    // integers loaded into registers and $l[] slots: `add`/`sub`/`mul` on
+    // known values become loads, a `mov` of one a load, a conditional jump
+    // after a known `cmp` is dropped or made unconditional, and a load
+    // overwritten before anything reads it is dropped.
+    void foldConstants();
+
+    // within each run of instructions between labels and jumps, follows
+    // the objects createObject makes through registers and the slots the
+    // run pushes. one that only ever has its members read and written,
+    // and is held nowhere once the run ends, is made scratch instead (see
+    // vm/scratch.h), with one release of the run's after the last of them
+    // is dropped. anything else done with it, any other call, or access
+    // to the stack the run cannot follow, leaves it on the heap.
+    void scratchObjects();
+
+    // an object createObject makes and pushes, whose members the
+    // setObjectMember calls right after set from static data, is made by
+    // one call of createFromTemplate instead, with a template of those
+    // members in static data (see BUILTIN_TEMPLATE_MAX). only where $r[0]
+    // is written before it is read after them, as the last one left the
+    // value in it. where some of the members it sets, through registers
+    // loaded in between, are not static data, it is made by
+    // createObjectSized instead, with room for all of them.
+    void objectTemplates();
+
+    // a builtin's result is a reference of its own in $r[0]. when the
+    // instruction after the call pushes it, and nothing reads $r[0] before
+    // it is next written, the push becomes a take (see OP_TAKE), which
+    // hands the reference on instead of claiming another. a mov of it is
+    // dropped for the call's result operand (see Op_Call::setResult), as
+    // is a mov of any call's result to another register.
+    void takeResults();
+
+    // drops what cannot run: instructions no path from the start of the
+    // chunk reaches, through fallthrough and the labels reachable code
+    // refers to, labels nothing kept refers to, and static data nothing
+    // kept refers to. does nothing if an instruction does not tell its
+    // operands or reads $pc, as code could then be reached some other way.
+    void eliminateDeadCode();
+
+    // points each jump at where the jumps it lands on end up, and turns
+    // a `je`/`jne` over an unconditional jump into the opposite jump,
+    // to the latter's target.
+    void threadJumps();
+
+    // a loop ending in a jump back to a test at its top, `cmp` and a
+    // `je`/`jne` out of it with only loads and movs before, gets a copy
+    // of the test at its bottom instead, with the opposite jump back
+    // into the body: one taken jump per iteration rather than two.
+    void rotateLoops();
+
+    // copies the body of a function in place of an `fcall` to it, up to
+    // the `ret` no jump in it goes past, with returns falling through to
+    // a pop of the arguments. only a body that keeps to its arguments and
+    // registers, leaving the stack as it found it, is copied, and only
+    // when the call or the function asks for it with @inline, it is the
+    // only call, or the body is small: a few instructions, more for each
+    // argument pushed as a constant (which the copy then loads as one),
+    // twice as many in a loop. never with @noinline.
+    void inlineCalls();
+
+    // numbers the conditional jumps and calls in order, the sites a
+    // profile counts, and gives each what `profile` counted for it, if
+    // there is one. the numbering is the same for the same source.
+    void numberSites(const Profile *profile);
+
+    // moves the code a profiled `je`/`jne` jumps over to the end of the
+    // chunk when the jump is taken most of the time, so that the hot
+    // path falls through: the jump, inverted, goes to the moved block,
+    // which jumps back after it. does nothing with jit regions or code
+    // that reads $pc.
+    void layoutBlocks();
+
+    // inlines calls, folds constants, threads jumps, rotates loops,
+    // eliminates dead code, lays out blocks, then rewrites the flattened
+    // sequence: drops `mov x, x`, a jump to a label right after it, a
+    // push undone by the next pop and `pop 0`, merges consecutive pops,
+    // then converts small branches to selects and fuses compares with the
+    // jumps that follow them. a label in between blocks all but the jump.
+    void peephole();
+
+    // turns a conditional jump over a lone mov, or over one to the same
+    // location a jump past the other arm skips, into a select of either
+    // value (see Op_Select), and a pair of integer loads of 0 and 1 into a
+    // setcc (see Op_SetCc): no branch for what `@if` builds of them. only
+    // where nothing else lands on the arm after the jump.
+    void ifConvert();
+
+    // replaces `cmp` directly followed by `je`/`jne`/`jg`/`jge` with Op_CmpJmp
+    void fuseCompareJumps();
+
+    // points jumps to a label at its address, rather than through its
+    // $d slot, and leaves the slot of a label only jumped to unloaded.
+    // jumps through any other location stay as they are.
+    void directJumps();
+
     LabelId_t generateLabel();
 
+    // the instructions of this chunk and the ones nested in it, in order
+    void collectLeaves(std::vector<std::unique_ptr<Buildable>*> &out);
+
   private:
+
     std::vector<LabelInfo> m_labels;
     std::deque<std::unique_ptr<Buildable>> m_buildables;
   };
@@ -1,6 +1,13 @@
 #pragma once
 
 #include <bcparse/emit/obj_loc.hpp>
+#include <bcparse/emit/operand.hpp>
+#include <bcparse/emit/buildable.hpp>
+#include <bcparse/emit/size_report.hpp>
+
+#include <shared/bin_format.h>
+
+#include <common/my_assert.hpp>
 
 #include <vector>
 #include <map>
@@ -10,51 +17,350 @@
 namespace bcparse {
   class BytecodeStream {
   public:
+    BytecodeStream(bool sectioned = false, bool compact = false, bool segmented = false, bool relocatable = false)
+      : m_sectioned(sectioned),
+        m_compact(compact),
+        m_segmented(sectioned && segmented),
+        m_relocatable(sectioned && !compact && !segmented && relocatable),
+        m_sizing(false),
+        m_report(nullptr),
+        m_operandDepth(0),
+        m_length(0),
+        m_instructionOffset(0) {
+      if (m_segmented) {
+        m_segmentSection.push_back({ 0, 0, 0 });
+      }
+    }
+
     void acceptString(const char *str) {
       // do not copy NUL byte
-      size_t length = std::strlen(str);
-      m_data.insert(m_data.end(), str, str + length);
+      acceptRaw(str, std::strlen(str));
     }
 
     void acceptInstruction(uint8_t opcode, uint8_t flags = 0) {
       uint8_t payload = opcode;
+      m_instructionOffset = streamOffset();
+
+      if (m_report != nullptr && !m_sizing) {
+        m_report->instruction(opcode, m_instructionOffset);
+      }
+
       payload <<= 3;
       payload |= flags;
       acceptBytes(payload);
+
+      if (m_segmented) {
+        ++m_segmentSection.back().count;
+      }
+    }
+
+    // the instruction just begun is site `id`, see bin_site_t. nothing
+    // for Site::none.
+    void acceptSite(uint32_t id, bool inverted) {
+      if (!m_sizing && m_sectioned && id != UINT32_MAX) {
+        m_siteSection.push_back({ (uint64_t)m_instructionOffset, id, inverted ? (uint32_t)BIN_SITE_INVERTED : 0 });
+      }
+    }
+
+    // what is built next came from `trace`, up to the next call. see
+    // BIN_SECTION_LINES.
+    void acceptTrace(const std::shared_ptr<const SourceTrace> &trace) {
+      if (m_report != nullptr && !m_sizing) {
+        m_report->trace(trace.get());
+      }
+
+      if (m_sizing || !m_sectioned) {
+        return;
+      }
+
+      const uint32_t index = internTrace(trace.get());
+
+      // what was traced here before built nothing
+      if (!m_lineRanges.empty() && m_lineRanges.back().offset == streamOffset()) {
+        m_lineRanges.pop_back();
+      }
+
+      if (m_lineRanges.empty() || m_lineRanges.back().trace != index) {
+        m_lineRanges.push_back({ (uint64_t)streamOffset(), index, 0 });
+      }
+    }
+
+    // at a label: the code runs on from here as a new segment, unless the
+    // current one is still empty. a label per segment keeps code that is
+    // only jumped over, like a function's body, out of the segments that
+    // run. see BIN_SECTION_SEGMENTS.
+    void acceptSegmentBoundary() {
+      if (m_segmented && m_segmentSection.back().count != 0) {
+        m_segmentSection.push_back({ (uint64_t)streamOffset(), 0, 0 });
+      }
+    }
+
+    // appends `size` bytes, or only counts them when sizing
+    void acceptRaw(const void *bytes, size_t size) {
+      if (!m_sizing) {
+        m_data.insert(m_data.end(), (const uint8_t*)bytes, (const uint8_t*)bytes + size);
+      }
+
+      m_length += size;
     }
 
     template <typename T> void acceptBytes(const T &t) {
-      char bytes[sizeof(t)];
-      std::memcpy(&bytes[0], &t, sizeof(t));
-      m_data.insert(m_data.end(), &bytes[0], &bytes[0] + sizeof(t));
+      acceptRaw(&t, sizeof(t));
     }
 
     template <typename T> void acceptVector(const std::vector<T> &t) {
-      m_data.insert(m_data.end(), t.begin(), t.end());
+      acceptRaw(t.data(), t.size() * sizeof(T));
+    }
+
+    void acceptVarint(uint64_t value) {
+      while (value >= 0x80) {
+        acceptBytes((uint8_t)(value | 0x80));
+        value >>= 7;
+      }
+
+      acceptBytes((uint8_t)value);
+    }
+
+    // a pool index, count or size: its `sizeof(T)` bytes, or a ULEB128 in
+    // compact code
+    template <typename T> void acceptUint(const T &t) {
+      OperandTally tally(this, SizeReport::OPERAND_COUNT);
+
+      if (m_compact) {
+        acceptVarint((uint64_t)t);
+      } else {
+        acceptBytes(t);
+      }
     }
 
     void acceptObjLoc(const ObjLoc &objLoc) {
+      OperandTally tally(this, operandKind(objLoc));
+
+      if (objLoc.getDataStoreLocation() == ObjLoc::DataStoreLocation::CodeLabel) {
+        acceptCodeLabel(objLoc.getLocation());
+        return;
+      }
+
       uint8_t at = (uint8_t)objLoc.getDataStoreLocation();
-      at |= (objLoc.getLocation() < 0) ? 0x8 : 0xC; // neg = relative
+      uint32_t loc;
 
-      uint32_t payload = (abs(objLoc.getLocation()) << 4) | (at & 0xF);
+      if (objLoc.getDataStoreLocation() == ObjLoc::DataStoreLocation::StaticDataStore && !objLoc.isRelative()) {
+        acceptReloc(BIN_RELOC_DATA);
+      }
 
-      acceptBytes(payload);
+      if (objLoc.getDataStoreLocation() == ObjLoc::DataStoreLocation::FrameDataStore) {
+        // neither relative nor absolute, the offset zigzag encoded
+        loc = ((uint32_t)objLoc.getLocation() << 1) ^ (uint32_t)(objLoc.getLocation() >> 31);
+      } else {
+        at |= (objLoc.getLocation() < 0) ? 0x8 : 0xC; // neg = relative
+        at &= 0xF;
+
+        loc = abs(objLoc.getLocation());
+      }
+
+      if (!m_compact) {
+        acceptBytes((uint32_t)((loc << 4) | at));
+      } else if (at == 0xF && loc < 0x80) {
+        acceptBytes((uint8_t)(0x80 | loc)); // absolute register
+      } else if (loc < 7) {
+        acceptBytes((uint8_t)(((loc + 1) << 4) | at));
+      } else {
+        acceptBytes(at);
+        acceptVarint(loc);
+      }
+    }
+
+    // the index of a constant pool entry, as a u32 or a ULEB128
+    void acceptPoolIndex(size_t poolIndex) {
+      OperandTally tally(this, SizeReport::OPERAND_POOL_INDEX);
+
+      acceptReloc(BIN_RELOC_POOL);
+      acceptUint((uint32_t)poolIndex);
+    }
+
+    // the field about to be written changes when linked, see BIN_SECTION_RELOCS
+    void acceptReloc(uint32_t kind) {
+      if (m_relocatable && !m_sizing) {
+        m_relocSection.push_back({ (uint64_t)streamOffset(), kind, 0 });
+      }
+    }
+
+    // `doubleImmediate` when the vm reads an 8 byte immediate as a double,
+    // which compact code keeps as is. see BIN_CODE_COMPACT.
+    void acceptImmediate(const Value &value, bool doubleImmediate) {
+      OperandTally tally(this, SizeReport::OPERAND_IMMEDIATE);
+
+      if (m_compact && !doubleImmediate && value.getSize() == sizeof(uint64_t)) {
+        uint64_t u64;
+        std::memcpy(&u64, value.getBytes(), sizeof(u64));
+
+        acceptVarint((u64 << 1) ^ (0 - (u64 >> 63))); // zigzag
+      } else {
+        acceptRaw(value.getBytes(), value.getSize());
+      }
+    }
+
+    // a direct jump target: the distance from the jump to the label,
+    // zigzag encoded as the location of an AT_CODE obj_loc_t. it takes
+    // the same space whatever the distance, as the sizing pass does not
+    // know it yet: compact code has the long form, its ULEB128 padded out
+    // to the 4 bytes a 28 bit location can take.
+    void acceptCodeLabel(size_t labelId) {
+      OperandTally tally(this, SizeReport::OPERAND_JUMP);
+      uint64_t loc = 0;
+
+      if (!m_sizing) {
+        auto it = m_labelAddressMap.find(labelId);
+
+        ASSERT_MSG(it != m_labelAddressMap.end(), "direct jump to a label that was not sized");
+
+        const uint64_t distance = (uint64_t)it->second - (uint64_t)m_instructionOffset;
+        loc = (distance << 1) ^ (0 - (distance >> 63));
+
+        ASSERT_MSG(loc <= 0x0FFFFFFF, "direct jump out of range");
+      }
+
+      if (m_compact) {
+        acceptBytes((uint8_t)0x4); // AT_CODE
+
+        for (size_t i = 0; i < sizeof(uint32_t); i++) {
+          acceptBytes((uint8_t)(((loc >> (7 * i)) & 0x7F) | (i + 1 < sizeof(uint32_t) ? 0x80 : 0)));
+        }
+      } else {
+        acceptBytes((uint32_t)((loc << 4) | 0x4));
+      }
+    }
+
+    void acceptOperand(const Operand &operand, bool doubleImmediate = false) {
+      if (operand.isImmediate()) {
+        acceptImmediate(operand.getImmediate(), doubleImmediate);
+      } else {
+        acceptObjLoc(operand.getObjLoc());
+      }
     }
 
     inline std::vector<uint8_t> &getData() { return m_data; }
     inline const std::vector<uint8_t> &getData() const { return m_data; }
-    inline std::map<size_t, size_t> &getLabelOffsetMap() { return m_labelOffsetMap; }
-    inline const std::map<size_t, size_t> &getLabelOffsetMap() const { return m_labelOffsetMap; }
     inline std::map<size_t, size_t> &getLabelAddressMap() { return m_labelAddressMap; }
     inline const std::map<size_t, size_t> &getLabelAddressMap() const { return m_labelAddressMap; }
-    inline const size_t streamOffset() const { return m_data.size(); }
+    inline const size_t streamOffset() const { return m_length; }
+
+    // a sizing stream keeps none of the code, only its length and where
+    // the labels are. building into one first lets the real stream start
+    // out with both, see preallocate.
+    inline bool isSizing() const { return m_sizing; }
+    inline void setSizing(bool sizing) { m_sizing = sizing; }
+
+    // what --report-size is told of the code as it is written, or NULL.
+    // a sizing stream tells it nothing.
+    inline SizeReport *getReport() const { return m_sizing ? nullptr : m_report; }
+    inline void setReport(SizeReport *report) { m_report = report; }
+
+    // to build the same code `sizing` was built from: reserves its length
+    // up front, so the code is written without reallocating, and takes
+    // its label addresses, so jumps and label loads ahead of a label can
+    // be written out as they are reached.
+    void preallocate(const BytecodeStream &sizing) {
+      m_data.reserve(sizing.streamOffset());
+      m_labelAddressMap = sizing.getLabelAddressMap();
+    }
+
+    // with a sectioned stream, DataStorage and LabelMarker collect static
+    // data and label addresses into tables rather than emitting loads, and
+    // `m_data` is only the code. see Emitter::emit.
+    inline bool isSectioned() const { return m_sectioned; }
+    // operands and immediates are variable length, see BIN_CODE_COMPACT.
+    // only a sectioned stream can be: it marks its code section so.
+    inline bool isCompact() const { return m_compact; }
+    // a sectioned stream split at its labels, with a BIN_SECTION_SEGMENTS
+    inline bool isSegmented() const { return m_segmented; }
+    // an object for bclink: a sectioned stream, neither compact nor
+    // segmented, with BIN_SECTION_SYMBOLS and BIN_SECTION_RELOCS
+    inline bool isRelocatable() const { return m_relocatable; }
+    inline std::vector<uint8_t> &getConstSection() { return m_constSection; }
+    inline std::vector<bin_data_t> &getDataSection() { return m_dataSection; }
+    inline std::vector<bin_label_t> &getLabelSection() { return m_labelSection; }
+    inline std::vector<uint8_t> &getDebugSection() { return m_debugSection; }
+    inline std::vector<bin_segment_t> &getSegmentSection() { return m_segmentSection; }
+    inline std::vector<bin_site_t> &getSiteSection() { return m_siteSection; }
+    inline std::vector<uint8_t> &getSymbolSection() { return m_symbolSection; }
+    inline std::vector<bin_reloc_t> &getRelocSection() { return m_relocSection; }
+    inline std::vector<uint8_t> &getImportSection() { return m_importSection; }
+    inline std::vector<bin_try_t> &getTrySection() { return m_trySection; }
+    // where each @try_region still open began, innermost last
+    inline std::vector<uint64_t> &getTryStarts() { return m_tryStarts; }
+    std::vector<uint8_t> getLineSection() const;
 
   private:
+    // charges the bytes an operand takes, unless it is written as part
+    // of another (a count in a pool index, a jump in an obj_loc), to the
+    // SizeReport
+    class OperandTally {
+    public:
+      OperandTally(BytecodeStream *bs, SizeReport::Operand kind)
+        : m_bs(bs),
+          m_kind(kind),
+          m_start(bs->m_length) {
+        ++m_bs->m_operandDepth;
+      }
+
+      OperandTally(const OperandTally &other) = delete;
+
+      ~OperandTally() {
+        if (--m_bs->m_operandDepth == 0 && m_bs->getReport() != nullptr) {
+          m_bs->m_report->operand(m_kind, m_bs->m_length - m_start);
+        }
+      }
+
+    private:
+      BytecodeStream *m_bs;
+      SizeReport::Operand m_kind;
+      size_t m_start;
+    };
+
+    static SizeReport::Operand operandKind(const ObjLoc &objLoc) {
+      switch (objLoc.getDataStoreLocation()) {
+        case ObjLoc::DataStoreLocation::VMDataStore: return SizeReport::OPERAND_VM;
+        case ObjLoc::DataStoreLocation::StaticDataStore: return SizeReport::OPERAND_STATIC;
+        case ObjLoc::DataStoreLocation::LocalDataStore: return SizeReport::OPERAND_LOCAL;
+        case ObjLoc::DataStoreLocation::CodeLabel: return SizeReport::OPERAND_JUMP;
+        case ObjLoc::DataStoreLocation::FrameDataStore: return SizeReport::OPERAND_FRAME;
+        default: return SizeReport::OPERAND_REGISTER;
+      }
+    }
+
+    bool m_sectioned;
+    bool m_compact;
+    bool m_segmented;
+    bool m_relocatable;
+    bool m_sizing;
+    SizeReport *m_report;
+    int m_operandDepth;
+    std::vector<uint8_t> m_constSection;
+    std::vector<bin_data_t> m_dataSection;
+    std::vector<bin_label_t> m_labelSection;
+    std::vector<uint8_t> m_debugSection;
+    std::vector<bin_segment_t> m_segmentSection;
+    std::vector<bin_site_t> m_siteSection;
+    std::vector<uint8_t> m_symbolSection;
+    std::vector<bin_reloc_t> m_relocSection;
+    std::vector<uint8_t> m_importSection;
+    std::vector<bin_try_t> m_trySection;
+    std::vector<uint64_t> m_tryStarts;
+    std::vector<bin_line_t> m_lineRanges;
+    std::vector<bin_trace_t> m_traces;
+    std::map<const SourceTrace*, uint32_t> m_traceIndices;
+    std::vector<char> m_traceStrings;
+    std::map<std::string, uint32_t> m_traceStringOffsets;
+
+    uint32_t internTrace(const SourceTrace *trace);
+    uint32_t internTraceString(const std::string &str);
+
     std::vector<uint8_t> m_data;
-    // map from label ID to starting index of uint64_t in m_data
-    std::map<size_t, size_t> m_labelOffsetMap;
+    size_t m_length; // of the code, in m_data unless sizing
     // map from label ID to finalized address
     std::map<size_t, size_t> m_labelAddressMap;
+
+    size_t m_instructionOffset; // of the last instruction begun
   };
 }
@@ -6,6 +6,9 @@
 
 #include <vector>
 #include <set>
+#include <map>
+#include <string>
+#include <unordered_map>
 #include <memory>
 
 namespace bcparse {
@@ -13,6 +16,16 @@ namespace bcparse {
     static const int STATIC_DATA_OFFSET;
 
   public:
+    // a function of an extension module, which the vm stores to the slot
+    // once it has found it, see BIN_SECTION_IMPORTS
+    struct Import {
+      std::string module;
+      std::string name;
+      std::string signature;
+      size_t numArgs; // of the signature
+      bool variadic;
+    };
+
     DataStorage();
     DataStorage(const DataStorage &other);
     virtual ~DataStorage() = default;
@@ -21,16 +34,52 @@ namespace bcparse {
     inline const std::vector<Value> &getValues() const { return m_values; }
 
     size_t addLabel(); // returns index/id
+    size_t addImport(const Import &import); // returns index/id
     size_t addStaticData(const Value &value, bool cache = true); // returns index/id
+    size_t addConstant(const Value &value); // returns constant pool index
+    // constants holding `value` start at a multiple of `align`, a power of
+    // two up to BIN_CONST_ALIGN, in a sectioned stream. the largest asked
+    // for holds.
+    void setAlignment(const Value &value, size_t align);
     size_t getSize() const { return m_values.size(); }
+    // whether `slot` is that of a label
+    inline bool isLabel(size_t slot) const { return m_labelOffsets.count(slot) != 0; }
+    // the import stored to `slot`, or NULL if it holds something else
+    const Import *getImport(size_t slot) const;
+    // the value `slot` is loaded with, or NULL for a label, an import or
+    // a slot that is not static data
+    const Value *getStaticData(size_t slot) const;
+
+    // only the slots in `slots` are written out, the others being
+    // unreferenced once dead code is gone
+    void retainStaticData(const std::set<size_t> &slots);
+    // `slot` is not written out either
+    void releaseStaticData(size_t slot);
 
     virtual void accept(BytecodeStream *bs) override;
     virtual void debugPrint(BytecodeStream *bs, Formatter *f) override;
 
   private:
+    bool isRetained(size_t slot) const;
+
+    // the constant pool, static data and labels as tables, for a sectioned stream
+    void acceptSections(BytecodeStream *bs, const std::vector<size_t> &poolIndices);
+
     std::vector<Value> m_values;
     std::set<size_t> m_labelOffsets; // vector of indices of m_values.
+    std::map<size_t, Import> m_imports; // by slot, only ever written as BIN_SECTION_IMPORTS
+    std::vector<Value> m_constants; // read-only raw data, shared instead of copied on load
+    // the first index of each value, for deduplicating in constant time.
+    // labels' placeholders are left out, as they are not cached.
+    std::unordered_map<Value, size_t, Value::Hasher> m_valueIndex;
+    std::unordered_map<Value, size_t, Value::Hasher> m_constantIndex;
+    std::unordered_map<Value, size_t, Value::Hasher> m_alignments;
 
+    std::vector<std::unique_ptr<Op_Const>> m_opConsts;
     std::vector<std::unique_ptr<Op_Load>> m_opLoads;
+    bool m_sectioned; // as the stream last accepted into
+    bool m_retainAll;
+    std::set<size_t> m_retained; // slots, unless m_retainAll
+
   };
 }
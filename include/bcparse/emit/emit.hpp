@@ -4,6 +4,8 @@
 #include <bcparse/emit/bytecode_stream.hpp>
 #include <bcparse/emit/bytecode_chunk.hpp>
 #include <bcparse/emit/value.hpp>
+#include <bcparse/emit/operand.hpp>
+#include <bcparse/emit/profile.hpp>
 
 namespace bcparse {
   class Op_NoOp : public Buildable {
@@ -14,19 +16,46 @@ namespace bcparse {
 
     virtual void accept(BytecodeStream *bs) override;
     virtual void debugPrint(BytecodeStream *bs, Formatter *f) override;
+    virtual bool getObjLocs(std::vector<ObjLoc*> &out) override;
+  };
+
+  // constant pool entry, referenced by index from Op_Load / Op_PushConst
+  class Op_Const : public Buildable {
+  public:
+    Op_Const(size_t index, const Value &value);
+    Op_Const(const Op_Const &other) = delete;
+    virtual ~Op_Const() = default;
+
+    virtual void accept(BytecodeStream *bs) override;
+    virtual void debugPrint(BytecodeStream *bs, Formatter *f) override;
+    virtual bool getObjLocs(std::vector<ObjLoc*> &out) override;
+
+  private:
+    size_t m_index;
+    Value m_value;
   };
 
   class Op_Load : public Buildable {
   public:
+    static const size_t noPoolIndex;
+
     Op_Load(const ObjLoc &objLoc, const Value &value);
+    // loads a reference to constant pool entry `poolIndex`, which holds `value`
+    Op_Load(const ObjLoc &objLoc, size_t poolIndex, const Value &value);
     Op_Load(const Op_Load &other) = delete;
     virtual ~Op_Load() = default;
 
+    inline const ObjLoc &getObjLoc() const { return m_objLoc; }
+    inline size_t getPoolIndex() const { return m_poolIndex; }
+    inline const Value &getValue() const { return m_value; }
+
     virtual void accept(BytecodeStream *bs) override;
     virtual void debugPrint(BytecodeStream *bs, Formatter *f) override;
+    virtual bool getObjLocs(std::vector<ObjLoc*> &out) override;
 
   private:
     ObjLoc m_objLoc;
+    size_t m_poolIndex;
     Value m_value;
   };
 
@@ -36,8 +65,12 @@ namespace bcparse {
     Op_Mov(const Op_Mov &other) = delete;
     virtual ~Op_Mov() = default;
 
+    inline const ObjLoc &getLeft() const { return m_left; }
+    inline const ObjLoc &getRight() const { return m_right; }
+
     virtual void accept(BytecodeStream *bs) override;
     virtual void debugPrint(BytecodeStream *bs, Formatter *f) override;
+    virtual bool getObjLocs(std::vector<ObjLoc*> &out) override;
 
   private:
     ObjLoc m_left;
@@ -50,23 +83,38 @@ namespace bcparse {
     Op_Push(const Op_Push &other) = delete;
     virtual ~Op_Push() = default;
 
+    inline const ObjLoc &getArg() const { return m_arg; }
+    // built as a `take`: the reference `arg` holds goes to the new slot,
+    // and `arg` is left as none. see BytecodeChunk::takeResults.
+    inline bool isTake() const { return m_take; }
+    inline void setTake(bool take) { m_take = take; }
+
     virtual void accept(BytecodeStream *bs) override;
     virtual void debugPrint(BytecodeStream *bs, Formatter *f) override;
+    virtual bool getObjLocs(std::vector<ObjLoc*> &out) override;
 
   private:
     ObjLoc m_arg;
+    bool m_take;
   };
 
   class Op_PushConst : public Buildable {
   public:
     Op_PushConst(const Value &arg);
+    // pushes a reference to constant pool entry `poolIndex`, which holds `arg`
+    Op_PushConst(size_t poolIndex, const Value &arg);
     Op_PushConst(const Op_PushConst &other) = delete;
     virtual ~Op_PushConst() = default;
 
+    inline size_t getPoolIndex() const { return m_poolIndex; }
+    inline const Value &getValue() const { return m_arg; }
+
     virtual void accept(BytecodeStream *bs) override;
     virtual void debugPrint(BytecodeStream *bs, Formatter *f) override;
+    virtual bool getObjLocs(std::vector<ObjLoc*> &out) override;
 
   private:
+    size_t m_poolIndex;
     Value m_arg;
   };
 
@@ -76,8 +124,11 @@ namespace bcparse {
     Op_Pop(const Op_Pop &other) = delete;
     virtual ~Op_Pop() = default;
 
+    inline size_t getAmount() const { return m_amt; }
+
     virtual void accept(BytecodeStream *bs) override;
     virtual void debugPrint(BytecodeStream *bs, Formatter *f) override;
+    virtual bool getObjLocs(std::vector<ObjLoc*> &out) override;
 
   private:
     size_t m_amt;
@@ -97,25 +148,56 @@ namespace bcparse {
     Op_Jmp(const Op_Jmp &other) = delete;
     virtual ~Op_Jmp() = default;
 
+    inline const ObjLoc &getObjLoc() const { return m_objLoc; }
+    inline Flags getFlags() const { return m_flags; }
+    inline const Site &getSite() const { return m_site; }
+    inline void setSite(const Site &site) { m_site = site; }
+
     virtual void accept(BytecodeStream *bs) override;
     virtual void debugPrint(BytecodeStream *bs, Formatter *f) override;
+    virtual bool getObjLocs(std::vector<ObjLoc*> &out) override;
 
   private:
     ObjLoc m_objLoc;
     Flags m_flags;
+    Site m_site;
   };
 
   class Op_Call : public Buildable {
   public:
-    Op_Call(const ObjLoc &objLoc);
+    enum class Flags {
+      None = 0,
+      RegisterArgs = 1, // arguments in $r[1] .. $r[n] instead of on the stack
+      OperandArgs = 2 // arguments read where they are, see getArgs
+    };
+
+    Op_Call(const ObjLoc &objLoc, Flags flags = Flags::None);
+    // with Flags::OperandArgs, at most CALL_MAX_OPERANDS of them
+    Op_Call(const ObjLoc &objLoc, const std::vector<ObjLoc> &args);
     Op_Call(const Op_Call &other) = delete;
     virtual ~Op_Call() = default;
 
+    inline const ObjLoc &getObjLoc() const { return m_objLoc; }
+    inline Flags getFlags() const { return m_flags; }
+    inline const std::vector<ObjLoc> &getArgs() const { return m_args; }
+
+    // where the result goes, $r[0] unless set. anywhere but a register, it
+    // is stored with the reference the callee returned, as a take would
+    // (see Op_Push::isTake), so only a builtin's result may go there.
+    inline bool hasResult() const { return m_hasResult; }
+    inline const ObjLoc &getResult() const { return m_result; }
+    void setResult(const ObjLoc &result);
+
     virtual void accept(BytecodeStream *bs) override;
     virtual void debugPrint(BytecodeStream *bs, Formatter *f) override;
+    virtual bool getObjLocs(std::vector<ObjLoc*> &out) override;
 
   private:
     ObjLoc m_objLoc;
+    Flags m_flags;
+    std::vector<ObjLoc> m_args;
+    bool m_hasResult;
+    ObjLoc m_result;
   };
 
   class Op_Cmp : public Buildable {
@@ -127,168 +209,317 @@ namespace bcparse {
       Float = 3
     };
 
-    Op_Cmp(const ObjLoc &left, const ObjLoc &right);
+    Op_Cmp(const ObjLoc &left, const Operand &right);
     Op_Cmp(const Op_Jmp &other) = delete;
     virtual ~Op_Cmp() = default;
 
+    inline const ObjLoc &getLeft() const { return m_left; }
+    inline const Operand &getRight() const { return m_right; }
+
     virtual void accept(BytecodeStream *bs) override;
     virtual void debugPrint(BytecodeStream *bs, Formatter *f) override;
+    virtual bool getObjLocs(std::vector<ObjLoc*> &out) override;
 
   private:
     ObjLoc m_left;
-    ObjLoc m_right;
+    Operand m_right;
+  };
+
+  // cmp directly followed by a conditional jmp, fused into one instruction.
+  // built by BytecodeChunk::peephole, not by the AST.
+  class Op_CmpJmp : public Buildable {
+  public:
+    Op_CmpJmp(const ObjLoc &left,
+      const Operand &right,
+      const ObjLoc &target,
+      Op_Jmp::Flags flags);
+    Op_CmpJmp(const Op_CmpJmp &other) = delete;
+    virtual ~Op_CmpJmp() = default;
+
+    inline const ObjLoc &getLeft() const { return m_left; }
+    inline const Operand &getRight() const { return m_right; }
+    inline const ObjLoc &getTarget() const { return m_target; }
+    inline Op_Jmp::Flags getFlags() const { return m_flags; }
+    inline const Site &getSite() const { return m_site; }
+    inline void setSite(const Site &site) { m_site = site; }
+
+    virtual void accept(BytecodeStream *bs) override;
+    virtual void debugPrint(BytecodeStream *bs, Formatter *f) override;
+    virtual bool getObjLocs(std::vector<ObjLoc*> &out) override;
+
+  private:
+    ObjLoc m_left;
+    Operand m_right;
+    ObjLoc m_target;
+    Op_Jmp::Flags m_flags;
+    Site m_site;
+  };
+
+  // 1 to `dst` if `flags` holds for the compare flags, otherwise 0, as
+  // an int. the opposite with `negated`. a mov with MOV_FLAGS_SET.
+  class Op_SetCc : public Buildable {
+  public:
+    Op_SetCc(const ObjLoc &dst, Op_Jmp::Flags flags, bool negated = false);
+    Op_SetCc(const Op_SetCc &other) = delete;
+    virtual ~Op_SetCc() = default;
+
+    inline const ObjLoc &getDst() const { return m_dst; }
+    inline Op_Jmp::Flags getFlags() const { return m_flags; }
+    inline bool isNegated() const { return m_negated; }
+
+    virtual void accept(BytecodeStream *bs) override;
+    virtual void debugPrint(BytecodeStream *bs, Formatter *f) override;
+    virtual bool getObjLocs(std::vector<ObjLoc*> &out) override;
+
+  private:
+    ObjLoc m_dst;
+    Op_Jmp::Flags m_flags;
+    bool m_negated;
+  };
+
+  // a mov of `a` to `dst` if `flags` holds for the compare flags,
+  // otherwise of `b`. a mov with MOV_FLAGS_SELECT.
+  class Op_Select : public Buildable {
+  public:
+    Op_Select(const ObjLoc &dst, const ObjLoc &a, const ObjLoc &b, Op_Jmp::Flags flags);
+    Op_Select(const Op_Select &other) = delete;
+    virtual ~Op_Select() = default;
+
+    inline const ObjLoc &getDst() const { return m_dst; }
+    inline const ObjLoc &getA() const { return m_a; }
+    inline const ObjLoc &getB() const { return m_b; }
+    inline Op_Jmp::Flags getFlags() const { return m_flags; }
+
+    virtual void accept(BytecodeStream *bs) override;
+    virtual void debugPrint(BytecodeStream *bs, Formatter *f) override;
+    virtual bool getObjLocs(std::vector<ObjLoc*> &out) override;
+
+  private:
+    ObjLoc m_dst;
+    ObjLoc m_a;
+    ObjLoc m_b;
+    Op_Jmp::Flags m_flags;
+  };
+
+  // a jump to the label of case `src - low`, or to `def` if there is no
+  // such case, through a table of direct jumps: a jmp with
+  // JUMP_FLAGS_TABLE. each case is a label of this chunk.
+  class Op_Switch : public Buildable {
+  public:
+    Op_Switch(const ObjLoc &src, int64_t low, const std::vector<ObjLoc> &cases, const ObjLoc &def);
+    Op_Switch(const Op_Switch &other) = delete;
+    virtual ~Op_Switch() = default;
+
+    inline const ObjLoc &getSrc() const { return m_src; }
+    inline int64_t getLow() const { return m_low; }
+    inline const std::vector<ObjLoc> &getCases() const { return m_cases; }
+    inline const ObjLoc &getDefault() const { return m_default; }
+
+    virtual void accept(BytecodeStream *bs) override;
+    virtual void debugPrint(BytecodeStream *bs, Formatter *f) override;
+    virtual bool getObjLocs(std::vector<ObjLoc*> &out) override;
+
+  private:
+    ObjLoc m_src;
+    int64_t m_low;
+    std::vector<ObjLoc> m_cases;
+    ObjLoc m_default;
   };
 
   class Op_Add : public Buildable {
   public:
     Op_Add(const ObjLoc &left,
-      const ObjLoc &right,
+      const Operand &right,
       Op_Cmp::Flags flags);
     Op_Add(const Op_Add &other) = delete;
     virtual ~Op_Add() = default;
 
+    inline const ObjLoc &getLeft() const { return m_left; }
+    inline const Operand &getRight() const { return m_right; }
+    inline Op_Cmp::Flags getFlags() const { return m_flags; }
+
     virtual void accept(BytecodeStream *bs) override;
     virtual void debugPrint(BytecodeStream *bs, Formatter *f) override;
+    virtual bool getObjLocs(std::vector<ObjLoc*> &out) override;
 
   private:
     ObjLoc m_left;
-    ObjLoc m_right;
+    Operand m_right;
     Op_Cmp::Flags m_flags;
   };
 
   class Op_Sub : public Buildable {
   public:
     Op_Sub(const ObjLoc &left,
-      const ObjLoc &right,
+      const Operand &right,
       Op_Cmp::Flags flags);
     Op_Sub(const Op_Sub &other) = delete;
     virtual ~Op_Sub() = default;
 
+    inline const ObjLoc &getLeft() const { return m_left; }
+    inline const Operand &getRight() const { return m_right; }
+    inline Op_Cmp::Flags getFlags() const { return m_flags; }
+
     virtual void accept(BytecodeStream *bs) override;
     virtual void debugPrint(BytecodeStream *bs, Formatter *f) override;
+    virtual bool getObjLocs(std::vector<ObjLoc*> &out) override;
 
   private:
     ObjLoc m_left;
-    ObjLoc m_right;
+    Operand m_right;
     Op_Cmp::Flags m_flags;
   };
 
   class Op_Mul : public Buildable {
   public:
     Op_Mul(const ObjLoc &left,
-      const ObjLoc &right,
+      const Operand &right,
       Op_Cmp::Flags flags);
     Op_Mul(const Op_Mul &other) = delete;
     virtual ~Op_Mul() = default;
 
+    inline const ObjLoc &getLeft() const { return m_left; }
+    inline const Operand &getRight() const { return m_right; }
+    inline Op_Cmp::Flags getFlags() const { return m_flags; }
+
     virtual void accept(BytecodeStream *bs) override;
     virtual void debugPrint(BytecodeStream *bs, Formatter *f) override;
+    virtual bool getObjLocs(std::vector<ObjLoc*> &out) override;
 
   private:
     ObjLoc m_left;
-    ObjLoc m_right;
+    Operand m_right;
     Op_Cmp::Flags m_flags;
   };
 
   class Op_Div : public Buildable {
   public:
     Op_Div(const ObjLoc &left,
-      const ObjLoc &right,
+      const Operand &right,
       Op_Cmp::Flags flags);
     Op_Div(const Op_Div &other) = delete;
     virtual ~Op_Div() = default;
 
+    inline const ObjLoc &getLeft() const { return m_left; }
+    inline const Operand &getRight() const { return m_right; }
+    inline Op_Cmp::Flags getFlags() const { return m_flags; }
+
     virtual void accept(BytecodeStream *bs) override;
     virtual void debugPrint(BytecodeStream *bs, Formatter *f) override;
+    virtual bool getObjLocs(std::vector<ObjLoc*> &out) override;
 
   private:
     ObjLoc m_left;
-    ObjLoc m_right;
+    Operand m_right;
     Op_Cmp::Flags m_flags;
   };
 
   class Op_Mod : public Buildable {
   public:
-    Op_Mod(const ObjLoc &left, const ObjLoc &right);
+    Op_Mod(const ObjLoc &left, const Operand &right);
     Op_Mod(const Op_Mod &other) = delete;
     virtual ~Op_Mod() = default;
 
+    inline const ObjLoc &getLeft() const { return m_left; }
+    inline const Operand &getRight() const { return m_right; }
+
     virtual void accept(BytecodeStream *bs) override;
     virtual void debugPrint(BytecodeStream *bs, Formatter *f) override;
+    virtual bool getObjLocs(std::vector<ObjLoc*> &out) override;
 
   private:
     ObjLoc m_left;
-    ObjLoc m_right;
+    Operand m_right;
   };
 
   class Op_Xor : public Buildable {
   public:
-    Op_Xor(const ObjLoc &left, const ObjLoc &right);
+    Op_Xor(const ObjLoc &left, const Operand &right);
     Op_Xor(const Op_Xor &other) = delete;
     virtual ~Op_Xor() = default;
 
+    inline const ObjLoc &getLeft() const { return m_left; }
+    inline const Operand &getRight() const { return m_right; }
+
     virtual void accept(BytecodeStream *bs) override;
     virtual void debugPrint(BytecodeStream *bs, Formatter *f) override;
+    virtual bool getObjLocs(std::vector<ObjLoc*> &out) override;
 
   private:
     ObjLoc m_left;
-    ObjLoc m_right;
+    Operand m_right;
   };
 
   class Op_And : public Buildable {
   public:
-    Op_And(const ObjLoc &left, const ObjLoc &right);
+    Op_And(const ObjLoc &left, const Operand &right);
     Op_And(const Op_And &other) = delete;
     virtual ~Op_And() = default;
 
+    inline const ObjLoc &getLeft() const { return m_left; }
+    inline const Operand &getRight() const { return m_right; }
+
     virtual void accept(BytecodeStream *bs) override;
     virtual void debugPrint(BytecodeStream *bs, Formatter *f) override;
+    virtual bool getObjLocs(std::vector<ObjLoc*> &out) override;
 
   private:
     ObjLoc m_left;
-    ObjLoc m_right;
+    Operand m_right;
   };
 
   class Op_Or : public Buildable {
   public:
-    Op_Or(const ObjLoc &left, const ObjLoc &right);
+    Op_Or(const ObjLoc &left, const Operand &right);
     Op_Or(const Op_Or &other) = delete;
     virtual ~Op_Or() = default;
 
+    inline const ObjLoc &getLeft() const { return m_left; }
+    inline const Operand &getRight() const { return m_right; }
+
     virtual void accept(BytecodeStream *bs) override;
     virtual void debugPrint(BytecodeStream *bs, Formatter *f) override;
+    virtual bool getObjLocs(std::vector<ObjLoc*> &out) override;
 
   private:
     ObjLoc m_left;
-    ObjLoc m_right;
+    Operand m_right;
   };
 
   class Op_Shl : public Buildable {
   public:
-    Op_Shl(const ObjLoc &left, const ObjLoc &right);
+    Op_Shl(const ObjLoc &left, const Operand &right);
     Op_Shl(const Op_Shl &other) = delete;
     virtual ~Op_Shl() = default;
 
+    inline const ObjLoc &getLeft() const { return m_left; }
+    inline const Operand &getRight() const { return m_right; }
+
     virtual void accept(BytecodeStream *bs) override;
     virtual void debugPrint(BytecodeStream *bs, Formatter *f) override;
+    virtual bool getObjLocs(std::vector<ObjLoc*> &out) override;
 
   private:
     ObjLoc m_left;
-    ObjLoc m_right;
+    Operand m_right;
   };
 
   class Op_Shr : public Buildable {
   public:
-    Op_Shr(const ObjLoc &left, const ObjLoc &right);
+    Op_Shr(const ObjLoc &left, const Operand &right);
     Op_Shr(const Op_Shr &other) = delete;
     virtual ~Op_Shr() = default;
 
+    inline const ObjLoc &getLeft() const { return m_left; }
+    inline const Operand &getRight() const { return m_right; }
+
     virtual void accept(BytecodeStream *bs) override;
     virtual void debugPrint(BytecodeStream *bs, Formatter *f) override;
+    virtual bool getObjLocs(std::vector<ObjLoc*> &out) override;
 
   private:
     ObjLoc m_left;
-    ObjLoc m_right;
+    Operand m_right;
   };
 
   class Op_Print : public Buildable {
@@ -297,8 +528,11 @@ namespace bcparse {
     Op_Print(const Op_Print &other) = delete;
     virtual ~Op_Print() = default;
 
+    inline const ObjLoc &getObjLoc() const { return m_objLoc; }
+
     virtual void accept(BytecodeStream *bs) override;
     virtual void debugPrint(BytecodeStream *bs, Formatter *f) override;
+    virtual bool getObjLocs(std::vector<ObjLoc*> &out) override;
 
   private:
     ObjLoc m_objLoc;
@@ -312,20 +546,196 @@ namespace bcparse {
 
     virtual void accept(BytecodeStream *bs) override;
     virtual void debugPrint(BytecodeStream *bs, Formatter *f) override;
+    virtual bool getObjLocs(std::vector<ObjLoc*> &out) override;
+  };
+
+  // a new fiber, its id stored to `dst`, starting at `target`
+  class Op_Spawn : public Buildable {
+  public:
+    Op_Spawn(const ObjLoc &dst, const ObjLoc &target);
+    Op_Spawn(const Op_Spawn &other) = delete;
+    virtual ~Op_Spawn() = default;
+
+    virtual void accept(BytecodeStream *bs) override;
+    virtual void debugPrint(BytecodeStream *bs, Formatter *f) override;
+    virtual bool getObjLocs(std::vector<ObjLoc*> &out) override;
+
+  private:
+    ObjLoc m_dst;
+    ObjLoc m_target;
+  };
+
+  class Op_Yield : public Buildable {
+  public:
+    Op_Yield();
+    Op_Yield(const Op_Yield &other) = delete;
+    virtual ~Op_Yield() = default;
+
+    virtual void accept(BytecodeStream *bs) override;
+    virtual void debugPrint(BytecodeStream *bs, Formatter *f) override;
+    virtual bool getObjLocs(std::vector<ObjLoc*> &out) override;
+  };
+
+  class Op_Join : public Buildable {
+  public:
+    Op_Join(const ObjLoc &objLoc);
+    Op_Join(const Op_Join &other) = delete;
+    virtual ~Op_Join() = default;
+
+    virtual void accept(BytecodeStream *bs) override;
+    virtual void debugPrint(BytecodeStream *bs, Formatter *f) override;
+    virtual bool getObjLocs(std::vector<ObjLoc*> &out) override;
+
+  private:
+    ObjLoc m_objLoc;
+  };
+
+  // what @inline and @noinline ask of a call or a function, see
+  // BytecodeChunk::inlineCalls
+  enum class InlineHint {
+    None = 0,
+    Inline = 1,
+    NoInline = 2
+  };
+
+  // calls the function at `target` with a frame of its own: pushes where
+  // it returns to and the caller's frame pointer, $f[-2] and $f[-1] in
+  // the callee, and points $f[0] past them. see Op_Ret.
+  class Op_FCall : public Buildable {
+  public:
+    Op_FCall(const ObjLoc &target, InlineHint hint = InlineHint::None);
+    Op_FCall(const Op_FCall &other) = delete;
+    virtual ~Op_FCall() = default;
+
+    inline const ObjLoc &getTarget() const { return m_target; }
+    inline InlineHint getHint() const { return m_hint; }
+    inline void setHint(InlineHint hint) { m_hint = hint; }
+    inline const Site &getSite() const { return m_site; }
+    inline void setSite(const Site &site) { m_site = site; }
+
+    virtual void accept(BytecodeStream *bs) override;
+    virtual void debugPrint(BytecodeStream *bs, Formatter *f) override;
+    virtual bool getObjLocs(std::vector<ObjLoc*> &out) override;
+
+  private:
+    ObjLoc m_target;
+    InlineHint m_hint;
+    Site m_site;
+  };
+
+  // returns from the function Op_FCall called, popping its frame and then
+  // `numArgs` values the caller pushed before the call. the hint of the
+  // return ending a function is the function's.
+  class Op_Ret : public Buildable {
+  public:
+    Op_Ret(size_t numArgs, InlineHint hint = InlineHint::None);
+    Op_Ret(const Op_Ret &other) = delete;
+    virtual ~Op_Ret() = default;
+
+    inline size_t getNumArgs() const { return m_numArgs; }
+    inline InlineHint getHint() const { return m_hint; }
+    inline void setHint(InlineHint hint) { m_hint = hint; }
+
+    virtual void accept(BytecodeStream *bs) override;
+    virtual void debugPrint(BytecodeStream *bs, Formatter *f) override;
+    virtual bool getObjLocs(std::vector<ObjLoc*> &out) override;
+
+  private:
+    size_t m_numArgs;
+    InlineHint m_hint;
+  };
+
+  // marks a region the VM may compile to native code, see @jit
+  class Op_Jit : public Buildable {
+  public:
+    enum class Flags {
+      Begin = 1, // followed by the location the compiled region is stored in
+      End = 2
+    };
+
+    Op_Jit(Flags flags);
+    // memoArgs != 0: memoize the region on that many stack values (JIT_FLAG_MEMOIZE)
+    Op_Jit(Flags flags, const ObjLoc &objLoc, uint8_t memoArgs = 0);
+    Op_Jit(const Op_Jit &other) = delete;
+    virtual ~Op_Jit() = default;
+
+    virtual void accept(BytecodeStream *bs) override;
+    virtual void debugPrint(BytecodeStream *bs, Formatter *f) override;
+    virtual bool getObjLocs(std::vector<ObjLoc*> &out) override;
+
+  private:
+    Flags m_flags;
+    ObjLoc m_objLoc;
+    uint8_t m_memoArgs;
   };
 
   class LabelMarker : public Buildable {
   public:
-    LabelMarker(size_t labelId);
+    LabelMarker(size_t labelId, const std::string &name = "");
     LabelMarker(const LabelMarker &other) = delete;
-    virtual ~LabelMarker() override;
+    virtual ~LabelMarker() = default;
+
+    inline size_t getLabelId() const { return m_labelId; }
+    // whether the address is stored to the label's $d slot. not if only
+    // direct jumps go to the label, see BytecodeChunk::directJumps.
+    inline bool isLoaded() const { return m_loaded; }
+    inline void setLoaded(bool loaded) { m_loaded = loaded; }
 
     virtual void accept(BytecodeStream *bs) override;
     virtual void debugPrint(BytecodeStream *bs, Formatter *f) override;
+    virtual bool getObjLocs(std::vector<ObjLoc*> &out) override;
 
   private:
     size_t m_labelId;
+    std::string m_name; // for BIN_SECTION_DEBUG
+    bool m_loaded;
+  };
 
-    Op_Load *m_opLoad;
+  // the bounds of a @try_region: written to BIN_SECTION_TRIES, with the
+  // address of the handler label, in a sectioned stream. a flat stream has
+  // no table, so AstTryDirective refuses --flat. emits no code.
+  class TryMarker : public Buildable {
+  public:
+    enum class Flags {
+      Begin = 1,
+      End = 2
+    };
+
+    TryMarker(Flags flags, size_t handlerId);
+    TryMarker(const TryMarker &other) = delete;
+    virtual ~TryMarker() = default;
+
+    inline Flags getFlags() const { return m_flags; }
+
+    virtual void accept(BytecodeStream *bs) override;
+    virtual void debugPrint(BytecodeStream *bs, Formatter *f) override;
+    virtual bool getObjLocs(std::vector<ObjLoc*> &out) override;
+
+  private:
+    Flags m_flags;
+    ObjLoc m_handler; // the label's slot, so the handler is kept
+  };
+
+  // a label named for bclink, from @export or @extern: written to
+  // BIN_SECTION_SYMBOLS in an object, and an exported one in a sectioned
+  // program too. an exported label is kept, and its code with it, even if
+  // nothing here uses it.
+  class SymbolMarker : public Buildable {
+  public:
+    SymbolMarker(size_t labelId, const std::string &name, bool exported);
+    SymbolMarker(const SymbolMarker &other) = delete;
+    virtual ~SymbolMarker() = default;
+
+    inline size_t getLabelId() const { return m_objLoc.getLocation(); }
+    inline bool isExported() const { return m_exported; }
+
+    virtual void accept(BytecodeStream *bs) override;
+    virtual void debugPrint(BytecodeStream *bs, Formatter *f) override;
+    virtual bool getObjLocs(std::vector<ObjLoc*> &out) override;
+
+  private:
+    ObjLoc m_objLoc; // the label's slot
+    std::string m_name;
+    bool m_exported;
   };
 }
@@ -1,18 +1,46 @@
 #pragma once
 
 #include <ostream>
+#include <vector>
+#include <cstdint>
 
 namespace bcparse {
   class BytecodeChunk;
+  class BytecodeStream;
   class Formatter;
+  class Profile;
+  class SizeReport;
 
   class Emitter {
   public:
-    Emitter(BytecodeChunk *chunk);
+    enum class Format {
+      Sectioned, // a container, see shared/bin_format.h
+      Flat // one instruction stream, whose loads set up the static data
+    };
+
+    Emitter(BytecodeChunk *chunk, Format format = Format::Sectioned, bool debugInfo = false, bool compact = true,
+      bool compress = false, bool segmented = false, bool peephole = true, const Profile *profile = nullptr,
+      bool object = false);
 
     void emit(std::ostream *os, Formatter *f);
 
+    // told what the output is made of as it is emitted, see --report-size
+    inline void setReport(SizeReport *report) { m_report = report; }
+
   private:
+    void emitSections(std::ostream *os, BytecodeStream &bs);
+
     BytecodeChunk *m_chunk;
+    Format m_format;
+    bool m_debugInfo; // write BIN_SECTION_DEBUG, SITES and LINES, with Format::Sectioned
+    bool m_compact; // BIN_CODE_COMPACT operands, with Format::Sectioned
+    bool m_compress; // a BIN_CODE_LZ4 code section, with Format::Sectioned
+    bool m_segmented; // write BIN_SECTION_SEGMENTS, with Format::Sectioned
+    bool m_peephole; // run BytecodeChunk::peephole before building
+    const Profile *m_profile; // counts from a run, for BytecodeChunk::numberSites, or NULL
+    // an object for bclink, see BytecodeStream::isRelocatable: sectioned,
+    // and neither compact, compressed nor segmented whatever was asked
+    bool m_object;
+    SizeReport *m_report;
   };
 }
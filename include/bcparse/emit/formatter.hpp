@@ -1,13 +1,14 @@
 #pragma once
 
 #include <ostream>
-#include <sstream>
 #include <string>
 
 namespace bcparse {
+  // writes each line to `out` as it is appended, so that a listing of
+  // any size costs no more memory than a line of it
   class Formatter {
   public:
-    Formatter();
+    explicit Formatter(std::ostream *out);
 
     void increaseIndent();
     void decreaseIndent();
@@ -17,12 +18,10 @@ namespace bcparse {
 
     void append(const std::string &str);
 
-    std::string toString() const;
-
   private:
     int m_lineNo;
 
     int m_indentation;
-    std::stringstream m_buf;
+    std::ostream *m_out;
   };
 }
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace bcparse {
+  namespace lz4 {
+    // `size` bytes at `src` as one block in the LZ4 block format, appended
+    // to `out`. greedy, with a single hash table entry per position: the
+    // code is small, so ratio matters more than speed, but neither much.
+    void compressBlock(const uint8_t *src, size_t size, std::vector<uint8_t> &out);
+  }
+}
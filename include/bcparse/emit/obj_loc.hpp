@@ -11,7 +11,17 @@ namespace bcparse {
       VMDataStore = 0x0,
       StaticDataStore = 0x1,
       LocalDataStore = 0x2,
-      RegisterDataStore = 0x3
+      RegisterDataStore = 0x3,
+      // $t[]: a temporary, mapped onto a register or a static slot by
+      // RegisterAllocator before building. never written to a stream.
+      VirtualRegister = 0x4,
+      // the address of label `location`, for a jump to go to directly
+      // rather than through the label's $d slot. written as a code offset
+      // relative to the jump, see BytecodeStream::acceptCodeLabel.
+      CodeLabel = 0x5,
+      // $f[]: a stack slot relative to the frame pointer of the running
+      // function, see Op_FCall. `location` is signed either way.
+      FrameDataStore = 0x6
     };
 
     ObjLoc()
@@ -34,6 +44,15 @@ namespace bcparse {
 
     inline bool isRelative() const { return m_location < 0; }
 
+    inline bool operator==(const ObjLoc &other) const {
+      return m_location == other.m_location &&
+        m_dataStoreLocation == other.m_dataStoreLocation;
+    }
+
+    inline bool operator!=(const ObjLoc &other) const {
+      return !operator==(other);
+    }
+
     inline std::string toString() const {
       std::stringstream ss;
 
@@ -53,6 +72,15 @@ namespace bcparse {
         case DataStoreLocation::RegisterDataStore:
           ss << "$R";
           break;
+        case DataStoreLocation::VirtualRegister:
+          ss << "$T";
+          break;
+        case DataStoreLocation::CodeLabel:
+          ss << "$C";
+          break;
+        case DataStoreLocation::FrameDataStore:
+          ss << "$F";
+          break;
       }
 
       ss << "[" << m_location << "]";
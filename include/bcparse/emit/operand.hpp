@@ -0,0 +1,46 @@
+#pragma once
+
+#include <bcparse/emit/obj_loc.hpp>
+#include <bcparse/emit/value.hpp>
+
+#include <string>
+
+namespace bcparse {
+  // an instruction operand: either a data location, or an 8 byte
+  // immediate written inline after the instruction.
+  class Operand {
+  public:
+    Operand(const ObjLoc &objLoc)
+      : m_objLoc(objLoc),
+        m_isImmediate(false) {
+    }
+
+    explicit Operand(const Value &immediate)
+      : m_immediate(immediate),
+        m_isImmediate(true) {
+    }
+
+    Operand(const Operand &other)
+      : m_objLoc(other.m_objLoc),
+        m_immediate(other.m_immediate),
+        m_isImmediate(other.m_isImmediate) {
+    }
+
+    inline bool isImmediate() const { return m_isImmediate; }
+    inline const ObjLoc &getObjLoc() const { return m_objLoc; }
+    inline ObjLoc &getObjLoc() { return m_objLoc; }
+    inline const Value &getImmediate() const { return m_immediate; }
+
+    // flag bit set on the instruction when the right operand is immediate (CMP_FLAG_IMM_R)
+    inline uint8_t getFlags() const { return m_isImmediate ? 0x4 : 0x0; }
+
+    inline std::string toString() const {
+      return m_isImmediate ? m_immediate.toString() : m_objLoc.toString();
+    }
+
+  private:
+    ObjLoc m_objLoc;
+    Value m_immediate;
+    bool m_isImmediate;
+  };
+}
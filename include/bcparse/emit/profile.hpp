@@ -0,0 +1,62 @@
+#pragma once
+
+#include <string>
+#include <map>
+#include <cstdint>
+
+namespace bcparse {
+  // a conditional jump or call numbered for profiling, see bin_site_t and
+  // BytecodeChunk::numberSites, and what a profile says of it. a copy of
+  // an instruction, or one that replaces it, keeps its site.
+  struct Site {
+    static const uint32_t none = UINT32_MAX;
+
+    uint32_t id;
+    // jumps when the one numbered did not, see BIN_SITE_INVERTED
+    bool inverted;
+    // `count` and `taken` are from a profile, where a site that did not
+    // run has none
+    bool profiled;
+    uint64_t count; // times it ran
+    uint64_t taken; // of those, times it jumped
+
+    Site()
+      : id(none),
+        inverted(false),
+        profiled(false),
+        count(0),
+        taken(0) {
+    }
+
+    // the site of a jump on the opposite condition, to the same place
+    Site invert() const {
+      Site site(*this);
+      site.inverted = !inverted;
+      site.taken = count - taken;
+
+      return site;
+    }
+  };
+
+  // the counts of a profile `vm --profile-out` wrote, see PROFILE_HEADER
+  class Profile {
+  public:
+    Profile() = default;
+    Profile(const Profile &other) = delete;
+
+    // false, with `error` set, if `path` cannot be read or is not a profile
+    bool read(const std::string &path, std::string &error);
+
+    // the counts of `site`, by its id. a site the profile does not have
+    // did not run.
+    void apply(Site &site) const;
+
+  private:
+    struct Counts {
+      uint64_t count;
+      uint64_t taken;
+    };
+
+    std::map<uint32_t, Counts> m_counts;
+  };
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <bcparse/emit/buildable.hpp>
+#include <bcparse/emit/obj_loc.hpp>
+#include <bcparse/emit/register_usage.hpp>
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+namespace bcparse {
+  class BytecodeChunk;
+  class DataStorage;
+
+  // maps the temporaries ($t[n]) of a chunk onto the registers the program
+  // does not name itself, and onto static slots once those run out.
+  //
+  // a temporary is live from where it is written to where it is last read,
+  // along every path of the control flow: jumps to labels, and for jumps
+  // through a location, calls and spawns of something other than a label,
+  // every label whose address the program takes. a halt returns after
+  // every call. two temporaries that are not live at once share a register.
+  // temporaries are handed out in the order they first appear, each
+  // taking the lowest register none of those it is live with holds.
+  class RegisterAllocator {
+  public:
+    RegisterAllocator(BytecodeChunk *chunk);
+    RegisterAllocator(const RegisterAllocator &other) = delete;
+
+    void allocate();
+
+  private:
+    typedef std::vector<uint64_t> Set; // of temporaries, by index
+
+    void collect();
+    void buildSuccessors();
+    void computeLiveness();
+    void buildInterference();
+    void assign();
+
+    inline bool has(const Set &set, size_t t) const { return (set[t / 64] >> (t % 64)) & 1; }
+    inline void add(Set &set, size_t t) { set[t / 64] |= (uint64_t)1 << (t % 64); }
+
+    BytecodeChunk *m_chunk;
+    DataStorage *m_dataStorage;
+
+    std::vector<Buildable*> m_code;
+    std::vector<std::vector<ObjLoc*>> m_objLocs; // of each of m_code
+    bool m_known; // every instruction told its operands
+
+    std::vector<int> m_temporaries; // $t[] numbers, by first appearance
+    std::vector<int> m_defs; // the temporary each instruction writes without reading, or -1
+    std::vector<Set> m_uses;
+    std::vector<std::vector<size_t>> m_successors;
+    std::vector<Set> m_liveOut;
+    Set m_liveIn0; // at the start
+    std::vector<Set> m_interference; // of each temporary
+    bool m_registerUsed[RegisterUsage::numRegisters]; // named by the program
+  };
+}
@@ -1,13 +1,24 @@
 #pragma once
 
+#include <shared/config.h>
+
+#include <common/my_assert.hpp>
+
 namespace bcparse {
   class RegisterUsage {
   public:
+    static constexpr int numRegisters = NUM_REGISTERS;
+
     RegisterUsage() : m_value(0) {}
     RegisterUsage(const RegisterUsage &other) : m_value(other.m_value) {}
 
     inline int current() const { return m_value; }
-    inline int inc() { return ++m_value; }
+
+    inline int inc() {
+      ASSERT_MSG(m_value + 1 < numRegisters, "out of registers");
+      return ++m_value;
+    }
+
     inline int dec() { return --m_value; }
 
   private:
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <map>
+#include <set>
+#include <vector>
+#include <string>
+#include <iostream>
+#include <cstdint>
+#include <cstddef>
+
+namespace bcparse {
+  struct SourceTrace;
+
+  // what `bcparse --report-size` breaks an output down into: its code by
+  // opcode, by operand encoding and by the file and the directives it was
+  // built from; its static data by type; what its labels cost; and its
+  // sections. filled in by the BytecodeStream that writes the output, see
+  // BytecodeStream::setReport, never by the sizing one.
+  class SizeReport {
+  public:
+    // what an operand is, see BytecodeStream::acceptOperand
+    enum Operand {
+      OPERAND_REGISTER, // $r[]
+      OPERAND_LOCAL, // $L[], the stack
+      OPERAND_FRAME, // $f[]
+      OPERAND_STATIC, // $d[]
+      OPERAND_VM, // $VM[]
+      OPERAND_JUMP, // a direct jump target
+      OPERAND_IMMEDIATE,
+      OPERAND_POOL_INDEX,
+      OPERAND_COUNT, // a count or size, see BytecodeStream::acceptUint
+      NUM_OPERANDS
+    };
+
+    struct Tally {
+      size_t count = 0;
+      size_t bytes = 0;
+    };
+
+    // an instruction with `opcode` begins at `offset`, which ends the one
+    // before it: an instruction is charged every byte up to the next
+    void instruction(uint8_t opcode, size_t offset);
+    // ends the last instruction, at the end of the code
+    void finish(size_t codeSize);
+
+    // an operand of `bytes`, by its encoding's length too
+    void operand(Operand kind, size_t bytes);
+
+    // what is built next came from `trace` (NULL: from no statement), as
+    // BytecodeStream::acceptTrace
+    void trace(const SourceTrace *trace);
+
+    // a static data entry: as a table entry in a sectioned output, or the
+    // loads of the preamble in a flat one, see DataStorage::accept
+    void staticData(const std::string &type, size_t bytes);
+    // what a label's address takes to set up: its bin_label_t, or its load
+    void label(size_t bytes);
+
+    void section(const std::string &name, size_t bytes);
+
+    void write(std::ostream &os, bool json) const;
+
+  private:
+    std::map<uint8_t, Tally> m_opcodes;
+    std::map<size_t, Tally> m_operands[NUM_OPERANDS]; // by encoded length
+    // the code built from statements in each file, and from each
+    // directive: a macro's bytes include those of the macros it expands
+    // to, and its count is of the distinct statements that invoked it
+    std::map<std::string, Tally> m_files;
+    std::map<std::string, Tally> m_directives;
+    std::set<const SourceTrace*> m_invocations;
+    std::map<std::string, Tally> m_staticData; // by type
+    Tally m_labels;
+    std::vector<std::pair<std::string, size_t>> m_sections; // in the order written
+
+    const SourceTrace *m_current = nullptr; // as of the last call to trace
+    const SourceTrace *m_trace = nullptr; // as of m_start
+    int m_opcode = -1; // of the instruction begun at m_start, -1 before one
+    size_t m_start = 0;
+
+    void charge(size_t end);
+  };
+}
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <vector>
+#include <memory>
+#include <cstdint>
 #include <string>
 #include <cstring>
 #include <sstream>
@@ -10,43 +12,40 @@ namespace bcparse {
   public:
     static const Value none();
 
-    Value(std::nullptr_t = nullptr) {
-      m_valueType = ValueType::ValueTypeNull;
+    Value(std::nullptr_t = nullptr)
+      : m_valueType(ValueType::ValueTypeNull) {
     }
 
-    Value(const Value &other)
-      : m_valueType(other.m_valueType),
-        m_rawBytes(other.m_rawBytes) {
+    explicit Value(int64_t i64)
+      : m_valueType(ValueType::ValueTypeI64) {
+      setInline(&i64, sizeof(i64));
     }
 
-    explicit Value(int64_t i64) {
-      m_valueType = ValueType::ValueTypeI64;
-      m_rawBytes.resize(sizeof(i64));
-      std::memcpy(m_rawBytes.data(), &i64, sizeof(i64));
+    explicit Value(uint64_t u64)
+      : m_valueType(ValueType::ValueTypeU64) {
+      setInline(&u64, sizeof(u64));
     }
 
-    explicit Value(uint64_t u64) {
-      m_valueType = ValueType::ValueTypeU64;
-      m_rawBytes.resize(sizeof(u64));
-      std::memcpy(m_rawBytes.data(), &u64, sizeof(u64));
+    explicit Value(double f64)
+      : m_valueType(ValueType::ValueTypeF64) {
+      setInline(&f64, sizeof(f64));
     }
 
-    explicit Value(double f64) {
-      m_valueType = ValueType::ValueTypeF64;
-      m_rawBytes.resize(sizeof(f64));
-      std::memcpy(m_rawBytes.data(), &f64, sizeof(f64));
+    explicit Value(bool b)
+      : m_valueType(ValueType::ValueTypeBoolean) {
+      uint8_t u8 = (uint8_t)b;
+      setInline(&u8, sizeof(u8));
     }
 
-    explicit Value(bool b) {
-      uint8_t u8 = (uint8_t)b;
-      m_valueType = ValueType::ValueTypeBoolean;
-      m_rawBytes.resize(sizeof(u8));
-      std::memcpy(m_rawBytes.data(), &u8, sizeof(u8));
+    // raw data is immutable, and shared by the copies
+    explicit Value(const std::vector<uint8_t> &data)
+      : m_valueType(ValueType::ValueTypeRawData),
+        m_raw(std::make_shared<const std::vector<uint8_t>>(data)) {
     }
 
-    explicit Value(const std::vector<uint8_t> &data) {
-      m_valueType = ValueType::ValueTypeRawData;
-      m_rawBytes = data;
+    explicit Value(std::vector<uint8_t> &&data)
+      : m_valueType(ValueType::ValueTypeRawData),
+        m_raw(std::make_shared<const std::vector<uint8_t>>(std::move(data))) {
     }
 
     enum class ValueType {
@@ -61,19 +60,43 @@ namespace bcparse {
     };
 
     inline ValueType getValueType() const { return m_valueType; }
-    inline const std::vector<uint8_t> &getRawBytes() const { return m_rawBytes; }
+    // the value's bytes, as the bytecode has them: 8 of an i64, u64 or f64,
+    // 1 of a boolean, none of null
+    inline const uint8_t *getBytes() const { return m_raw ? m_raw->data() : m_inline; }
+    inline size_t getSize() const { return m_raw ? m_raw->size() : m_size; }
 
     inline bool operator==(const Value &other) const {
       return m_valueType == other.m_valueType &&
-        m_rawBytes == other.m_rawBytes;
+        getSize() == other.getSize() &&
+        (m_raw == other.m_raw || std::memcmp(getBytes(), other.getBytes(), getSize()) == 0);
     }
 
     inline bool operator!=(const Value &other) const {
       return !operator==(other);
     }
 
+    // FNV-1a over the type and the bytes, consistent with operator==
+    inline size_t hash() const {
+      uint64_t h = 0xCBF29CE484222325ull ^ (uint64_t)m_valueType;
+
+      const uint8_t *bytes = getBytes();
+
+      for (size_t i = 0; i < getSize(); i++) {
+        h = (h ^ bytes[i]) * 0x100000001B3ull;
+      }
+
+      return (size_t)h;
+    }
+
+    struct Hasher {
+      inline size_t operator()(const Value &value) const { return value.hash(); }
+    };
+
     inline std::string toString() const {
       std::stringstream ss;
+      int64_t i64;
+      uint64_t u64;
+      double f64;
 
       switch (m_valueType) {
         case ValueType::ValueTypeNull:
@@ -81,29 +104,32 @@ namespace bcparse {
           break;
         case ValueType::ValueTypeI64:
           ss << "I64(";
-          ss << *((int64_t*)&m_rawBytes[0]);
+          std::memcpy(&i64, m_inline, sizeof(i64));
+          ss << i64;
           ss << ")";
           break;
         case ValueType::ValueTypeU64:
           ss << "U64(";
-          ss << *((uint64_t*)&m_rawBytes[0]);
+          std::memcpy(&u64, m_inline, sizeof(u64));
+          ss << u64;
           ss << ")";
           break;
         case ValueType::ValueTypeF64:
           ss << "F64(";
-          ss << *((double*)&m_rawBytes[0]);
+          std::memcpy(&f64, m_inline, sizeof(f64));
+          ss << f64;
           ss << ")";
           break;
         case ValueType::ValueTypeBoolean:
           ss << "BOOL(";
-          ss << (m_rawBytes[0] ? "true" : "false");
+          ss << (m_inline[0] ? "true" : "false");
           ss << ")";
           break;
         case ValueType::ValueTypeRawData:
           ss << "RAW(";
-          ss << m_rawBytes.size();
+          ss << m_raw->size();
           ss << ", \"";
-          for (uint8_t b : m_rawBytes) {
+          for (uint8_t b : *m_raw) {
             if (b == '\t') {
               ss << "\\t";
             } else if (b == '\n') {
@@ -126,7 +152,16 @@ namespace bcparse {
     }
 
   private:
+    inline void setInline(const void *bytes, size_t size) {
+      std::memcpy(m_inline, bytes, size);
+      m_size = (uint8_t)size;
+    }
+
     ValueType m_valueType;
-    std::vector<uint8_t> m_rawBytes;
+    // scalars are kept here rather than on the heap: literals are copied
+    // into data storage, loads and pushes
+    uint8_t m_size = 0;
+    uint8_t m_inline[sizeof(uint64_t)] = { };
+    std::shared_ptr<const std::vector<uint8_t>> m_raw;
   };
 }
@@ -8,19 +8,36 @@
 #include <bcparse/compiler_error.hpp>
 
 namespace bcparse {
+  // the errors of a compilation unit, kept in the order they are written
+  // out in as they are added, so that those of the units nested in it
+  // merge in without sorting them all again
   class ErrorList {
   public:
     ErrorList();
     ErrorList(const ErrorList &other);
 
-    inline void addError(const CompilerError &error) { m_errors.push_back(error); }
-    inline void clearErrors() { m_errors.clear(); }
-    inline void sortErrors() { std::sort(m_errors.begin(), m_errors.end()); }
+    void addError(const CompilerError &error);
+    // those of `other`, a unit nested in this one
+    void addErrors(const ErrorList &other);
+    void clearErrors();
     inline const std::vector<CompilerError> &getErrors() const { return m_errors; }
 
-    bool hasFatalErrors() const;
+    // every error added, those dropped past the limit included, for
+    // seeing whether something added any
+    inline size_t getCount() const { return m_count; }
+
+    // stops keeping errors once `maxFatal` of them are fatal, 0 for never
+    inline void setMaxFatal(size_t maxFatal) { m_maxFatal = maxFatal; }
+    // whether the limit was reached, after which there is no use going on
+    inline bool isFull() const { return m_maxFatal != 0 && m_numFatal >= m_maxFatal; }
+
+    inline bool hasFatalErrors() const { return m_numFatal != 0; }
     std::ostream &writeOutput(std::ostream &os) const; // @TODO make UTF8 compatible
 
+  private:
     std::vector<CompilerError> m_errors;
+    size_t m_count;
+    size_t m_numFatal;
+    size_t m_maxFatal;
   };
 }
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace bcparse {
+  // a function of an extension module, see shared/extension.h
+  struct ExtensionFunction {
+    std::string name;
+    std::string signature;
+    // of the signature: the arguments a call passes, and whether it may
+    // pass more after them ("...")
+    size_t numArgs;
+    bool variadic;
+  };
+
+  // the table of an extension module `bcparse --extension` reads. the
+  // module is loaded only for as long as that takes: nothing of it runs
+  // at compile time but bb8_extension.
+  class Extension {
+  public:
+    Extension() = default;
+    Extension(const Extension &other) = default;
+
+    // false, with `error` set, if `path` cannot be loaded, has no table
+    // of BB8_EXTENSION_VERSION or a function of it a malformed signature
+    bool read(const std::string &path, std::string &error);
+
+    inline const std::string &getName() const { return m_name; }
+    inline const std::vector<ExtensionFunction> &getFunctions() const { return m_functions; }
+
+    // false for a signature that is not "<type>(<type>,...)", see
+    // shared/extension.h. otherwise `numArgs` and `variadic` of it.
+    static bool parseSignature(const std::string &signature, size_t &numArgs, bool &variadic);
+
+  private:
+    std::string m_name;
+    std::vector<ExtensionFunction> m_functions;
+  };
+}
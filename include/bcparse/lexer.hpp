@@ -4,13 +4,14 @@
 
 #include <bcparse/source_stream.hpp>
 #include <bcparse/token.hpp>
+#include <bcparse/token_stream.hpp>
 
 namespace bcparse {
   class SourceStream;
   class TokenStream;
   class CompilationUnit;
 
-  class Lexer {
+  class Lexer : public TokenSource {
   public:
     Lexer(const SourceStream &sourceStream,
       TokenStream *tokenStream,
@@ -19,8 +20,13 @@ namespace bcparse {
     inline SourceLocation &getSourceLocation() { return m_sourceLocation; }
     inline const SourceLocation &getSourceLocation() const { return m_sourceLocation; }
 
+    // all of the tokens at once
     void analyze();
 
+    // the tokens up to the next one, or two with the newline ending a
+    // statement, for a TokenStream that pulls from this
+    virtual bool pull() override;
+
   private:
     bool expectChar(utf::u32char ch, bool read = false, int *posChange = nullptr);
 
@@ -41,6 +47,7 @@ namespace bcparse {
     SourceLocation m_sourceLocation;
     TokenStream *m_tokenStream;
     CompilationUnit *m_compilationUnit;
+    bool m_started; // past the whitespace at the start
 
   };
 }
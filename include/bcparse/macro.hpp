@@ -4,18 +4,31 @@
 
 #include <string>
 #include <vector>
+#include <memory>
 
 namespace bcparse {
+  class AstIterator;
+
   class Macro {
   public:
     Macro(const std::string &name, const std::vector<Token> &body);
     Macro(const Macro &other);
+    ~Macro();
 
     inline const std::string &getName() const { return m_name; }
     inline const std::vector<Token> &getBody() const { return m_body; }
 
+    // the body parsed once, by the first instantiation, which later ones
+    // clone (see AstUserDefinedDirective). NULL before, or if it did not
+    // parse without errors, in which case each instantiation parses it.
+    inline const AstIterator *getTemplate() const { return m_template.get(); }
+    inline bool isTemplateParsed() const { return m_templateParsed; }
+    void setTemplate(AstIterator *tmpl);
+
   private:
     std::string m_name;
     std::vector<Token> m_body;
+    std::unique_ptr<AstIterator> m_template;
+    bool m_templateParsed;
   };
 }
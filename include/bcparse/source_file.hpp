@@ -6,7 +6,13 @@
 namespace bcparse {
   class SourceFile {
   public:
+    // a buffer of `size` bytes for the caller to fill, not zeroed
     SourceFile(const std::string &filepath, size_t size);
+    // the file at `filepath`, mapped read-only where it can be, for a lexer
+    // that only reads it: no buffer to zero and copy into. read into one
+    // otherwise (an empty file, or one mmap refuses); isOpen() is false if
+    // it cannot be opened at all.
+    explicit SourceFile(const std::string &filepath);
     SourceFile(const SourceFile &other) = delete;
     ~SourceFile();
 
@@ -19,6 +25,9 @@ namespace bcparse {
     inline char *getBuffer() const { return m_buffer; }
     inline size_t getSize() const { return m_size; }
     inline void setSize(size_t size) { m_size = size; }
+    inline bool isOpen() const { return m_open; }
+    // a mapped buffer is not to be written to
+    inline bool isMapped() const { return m_mapped; }
     
     void readIntoBuffer(const char *data, size_t size);
 
@@ -27,5 +36,7 @@ namespace bcparse {
     char *m_buffer;
     size_t m_position;
     size_t m_size;
+    bool m_open;
+    bool m_mapped;
   };
 }
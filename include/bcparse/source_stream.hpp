@@ -14,15 +14,47 @@ namespace bcparse {
 
       inline SourceFile *getFile() const { return m_file; }
       inline size_t getPosition() const { return m_position; }
-      bool hasNext() const;
-      utf::u32char peek() const;
-      utf::u32char next();
-      utf::u32char next(int &posChange);
+      inline bool hasNext() const { return m_position < m_size; }
+
+      // an ASCII character is returned as it is, anything else is decoded
+      inline utf::u32char peek() const {
+        if (m_position < m_size && (unsigned char)m_buffer[m_position] < 0x80) {
+          return (utf::u32char)m_buffer[m_position];
+        }
+
+        return peekMultibyte();
+      }
+
+      inline utf::u32char next() {
+        int tmp;
+        return next(tmp);
+      }
+
+      inline utf::u32char next(int &posChange) {
+        if (m_position < m_size && (unsigned char)m_buffer[m_position] < 0x80) {
+          posChange = 1;
+          return (utf::u32char)m_buffer[m_position++];
+        }
+
+        return nextMultibyte(posChange);
+      }
+
+      // the bytes from the position on, for the lexer to scan runs of ASCII
+      // characters straight over them, and skip them with advance()
+      inline const char *getCursor() const { return m_buffer + m_position; }
+      inline size_t getRemaining() const { return m_size - m_position; }
+      inline void advance(size_t n) { m_position += n; }
+
       void goBack(int n = 1);
       void read(char *ptr, size_t numBytes);
 
   private:
       SourceFile *m_file;
+      const char *m_buffer;
+      size_t m_size;
       size_t m_position;
+
+      utf::u32char peekMultibyte() const;
+      utf::u32char nextMultibyte(int &posChange);
   };
 }
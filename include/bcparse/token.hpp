@@ -41,7 +41,7 @@ namespace bcparse {
     Token(const Token &other);
 
     inline TokenClass getTokenClass() const { return m_tokenClass; }
-    inline const std::string &getValue() const { return m_value; }
+    inline const std::string &getValue() const { return *m_value; }
     inline const SourceLocation &getLocation() const { return m_location; }
     inline bool empty() const { return m_tokenClass == TK_EMPTY; }
 
@@ -58,7 +58,7 @@ namespace bcparse {
 
   private:
     TokenClass m_tokenClass;
-    std::string m_value;
+    const std::string *m_value; // interned, see shared/symbol_table.hpp
     SourceLocation m_location;
   };
 }
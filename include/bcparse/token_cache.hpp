@@ -0,0 +1,35 @@
+#pragma once
+
+#include <bcparse/token.hpp>
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace bcparse {
+  // lexed files kept in a directory across compilations, for the libraries
+  // many sources @include (bcparse --cache <dir>). an entry is named after
+  // a hash of the file's contents (str_util::fnv1a), so an edited file
+  // misses, and the same file at another path hits. bump
+  // TOKEN_CACHE_VERSION when the lexer changes what it produces.
+  class TokenCache {
+  public:
+    static const uint32_t TOKEN_CACHE_VERSION = 1;
+
+    TokenCache(const std::string &dir);
+    TokenCache(const TokenCache &other) = delete;
+
+    // the tokens stored for contents of `size` bytes hashing to `key`, with
+    // `filename` in their locations. false if there are none.
+    bool load(uint64_t key, size_t size, const std::string &filename, std::vector<Token> &out) const;
+    // written to a temporary file and renamed over the entry, so a
+    // concurrent compile reads either nothing or a whole entry
+    void store(uint64_t key, size_t size, const std::vector<Token> &tokens) const;
+
+  private:
+    std::string m_dir;
+
+    std::string entryPath(uint64_t key) const;
+  };
+}
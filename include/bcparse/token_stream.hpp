@@ -18,35 +18,68 @@ namespace bcparse {
     }
   };
 
+  // where a TokenStream gets its tokens as they are asked for, rather
+  // than having them all pushed up front
+  class TokenSource {
+  public:
+    virtual ~TokenSource() = default;
+
+    // pushes the next tokens, if any, onto the stream. false once there
+    // are no more
+    virtual bool pull() = 0;
+  };
+
+  // the tokens of a file, all pushed before parsing, or pulled from a
+  // TokenSource as the parser peeks ahead. a pulled stream keeps only
+  // the tokens from a few before its position on, so that the tokens of
+  // a file are never all in memory at once: getTokens() then has only
+  // those, and rewind() goes back at most `lookbehind` tokens.
   class TokenStream {
   public:
+    static const size_t lookbehind = 16;
+
     TokenStream(const TokenStreamInfo &info);
     TokenStream(const TokenStream &other) = delete;
 
-    inline Token peek(int n = 0) const {
+    inline Token peek(int n = 0) {
         size_t pos = m_position + n;
-        if (pos >= m_tokens.size()) {
+        if (!fill(pos)) {
             return Token::EMPTY;
         }
-        return m_tokens[pos];
+        return m_tokens[pos - m_offset];
     }
 
     inline void push(const Token &token) { m_tokens.push_back(token); }
-    inline bool hasNext() const { return m_position < m_tokens.size(); }
-    inline Token next() { ASSERT(m_position < m_tokens.size()); return m_tokens[m_position++]; }
-    inline Token rewind() { ASSERT(m_position > 0); return m_tokens[--m_position]; }
+    inline bool hasNext() { return fill(m_position); }
+    Token next();
+    inline Token rewind() { ASSERT(m_position > m_offset); m_position--; return m_tokens[m_position - m_offset]; }
     inline Token last() const { ASSERT(!m_tokens.empty()); return m_tokens.back(); }
-    inline size_t getSize() const { return m_tokens.size(); }
+    inline size_t getSize() const { return m_offset + m_tokens.size(); }
     inline size_t getPosition() const { return m_position; }
     inline const std::vector<Token> &getTokens() const { return m_tokens; }
     inline const TokenStreamInfo &getInfo() const { return m_info; }
-    inline void setPosition(size_t position) { m_position = position; }
-    inline bool eof() const { return m_position >= m_tokens.size(); }
+    inline void setPosition(size_t position) { ASSERT(position >= m_offset); m_position = position; }
+    inline void setSource(TokenSource *source) { m_source = source; }
+    inline bool eof() { return !hasNext(); }
 
     std::vector<Token> m_tokens;
     size_t m_position;
 
   private:
+    // whether the token at `pos` is there, pulling up to it if need be
+    inline bool fill(size_t pos) {
+      while (pos - m_offset >= m_tokens.size()) {
+        if (m_source == nullptr || !m_source->pull()) {
+          m_source = nullptr;
+          return false;
+        }
+      }
+
+      return true;
+    }
+
     TokenStreamInfo m_info;
+    TokenSource *m_source;
+    size_t m_offset; // the position of m_tokens[0]
   };
 }
@@ -7,6 +7,7 @@
 #include <sstream>
 #include <cctype>
 #include <locale>
+#include <cstdint>
 
 namespace str_util {
 
@@ -111,4 +112,15 @@ inline std::string escape_string(const std::string &str) {
     return ss.str();
 }
 
+// FNV-1a, over the contents of a file or the like
+inline uint64_t fnv1a(const char *data, size_t size) {
+    uint64_t h = 0xCBF29CE484222325ull;
+
+    for (size_t i = 0; i < size; i++) {
+        h = (h ^ (uint8_t)data[i]) * 0x100000001B3ull;
+    }
+
+    return h;
+}
+
 } // str_util
@@ -0,0 +1,263 @@
+#ifndef BIN_FORMAT_H
+#define BIN_FORMAT_H
+
+#include <stdint.h>
+
+// the sectioned .bin container, written by bcparse and read by the vm.
+// a file that does not start with BIN_MAGIC is a flat instruction stream,
+// which sets up its own static data with the loads at its beginning.
+//
+// a container is a bin_header_t, `numSections` bin_section_t and then the
+// contents of each section at its offset, 8 byte aligned (BIN_SECTION_CONST
+// with BIN_CONST_IN_PLACE: BIN_CONST_ALIGN byte aligned). integers are
+// stored in the byte order of the machine, as in the instruction stream.
+
+// the first byte is OP_PLACEHOLDER_25 with all flags set, which bcparse
+// never emits at the start of a flat stream
+#define BIN_MAGIC "\xCF" "BB8"
+#define BIN_MAGIC_SIZE 4
+#define BIN_VERSION 8 // 8 added BIN_CONST_IN_PLACE, 7 moved static data to slot 256, 6 added BIN_SECTION_TRIES, 5 BIN_SECTION_IMPORTS, 4 OP_FCALL, OP_RET and $f[], 3 direct jumps, 2 bin_section_t.flags; all older are still read
+#define BIN_ALIGN 8
+
+typedef struct bin_header {
+  uint8_t magic[BIN_MAGIC_SIZE];
+  uint16_t version;
+  uint16_t numSections;
+} bin_header_t;
+
+enum BIN_SECTIONS {
+  // the instructions. jump targets, and so label addresses, are offsets into it.
+  // a jump's target may be an obj_loc_t with the archtype AT_CODE (0x4):
+  // its location is then the zigzag encoded distance in bytes from the
+  // start of the jump to where it goes, rather than a slot holding that.
+  BIN_SECTION_CODE = 1,
+  // constant pool entries, each a u64 size and the bytes, or with
+  // BIN_CONST_IN_PLACE, see bin_const_t. CONST_FLAGS_POOL indices count
+  // these before any OP_CONST in the code.
+  BIN_SECTION_CONST = 2,
+  // bin_data_t, stored to $d before the code runs
+  BIN_SECTION_DATA = 3,
+  // bin_label_t, stored to $d after the static data
+  BIN_SECTION_LABELS = 4,
+  // optional, never loaded: per label a u64 code offset, u32 name length
+  // and the name
+  BIN_SECTION_DEBUG = 5,
+  // optional, bin_segment_t: the code split into segments, each decoded
+  // the first time it is entered rather than all of it up front
+  BIN_SECTION_SEGMENTS = 6,
+  // optional, never loaded: bin_site_t, the conditional jumps and calls
+  // a profile counts, see PROFILE_HEADER
+  BIN_SECTION_SITES = 7,
+  // in an object (`bcparse --object`), for bclink: per symbol a
+  // bin_symbol_t and its name. optional in a program, never loaded: the
+  // labels it @exports, the entry points of a host, see embed_entry
+  BIN_SECTION_SYMBOLS = 8,
+  // in an object, for bclink: bin_reloc_t, the fields of the code that
+  // change when objects are linked together
+  BIN_SECTION_RELOCS = 9,
+  // optional, never loaded: where in the source the code came from, see
+  // bin_lines_t
+  BIN_SECTION_LINES = 10,
+  // per function of an extension module the program calls (see
+  // shared/extension.h), a bin_import_t and its strings: stored to $d
+  // with the static data, once the vm has found the function
+  BIN_SECTION_IMPORTS = 11,
+  // optional, bin_try_t: the code a thrown exception is caught in, see
+  // runtime_throwException. nothing of it runs unless something is thrown.
+  BIN_SECTION_TRIES = 12
+};
+
+// flags of BIN_SECTION_CODE
+enum BIN_CODE_FLAGS {
+  // operands and immediates are variable length, see BIN_CODE_COMPACT below
+  BIN_CODE_COMPACT = 0x1,
+  // the section is compressed, see BIN_CODE_LZ4 below
+  BIN_CODE_LZ4 = 0x2
+};
+
+// flags of BIN_SECTION_CONST
+enum BIN_CONST_FLAGS {
+  // entries are laid out for the vm to point into the file rather than
+  // copy them out, see bin_const_t
+  BIN_CONST_IN_PLACE = 0x1
+};
+
+// the most an entry of BIN_SECTION_CONST may be aligned to, and what the
+// section is aligned to in the file with BIN_CONST_IN_PLACE
+#define BIN_CONST_ALIGN 64
+
+// with BIN_CONST_IN_PLACE, an entry of BIN_SECTION_CONST is a bin_const_t,
+// `padding` zero bytes, its `size` bytes and a NUL. the bytes start at a
+// multiple of `align` from the start of the section, so of the file once
+// it is mapped; `align` is kept so bclink can lay them out again.
+typedef struct bin_const {
+  uint64_t size;
+  uint32_t align; // a power of two up to BIN_CONST_ALIGN, or 0 for none
+  uint32_t padding;
+} bin_const_t;
+
+// with BIN_CODE_COMPACT, the fields of an instruction after its opcode
+// byte are encoded as:
+//
+//  - an obj_loc_t, as one byte `1rrrrrrr` for the absolute register $r[r],
+//    r < 128; `0lllaaaa` with lll != 0 for location lll - 1 with the
+//    archtype_t `aaaa`; or `0000aaaa` and then the location as a ULEB128.
+//  - an 8 byte immediate the vm reads as a double (CONST_FLAGS_F64, and
+//    a binop or cmp with CMP_FLAG_F64_R) as its 8 bytes, as before.
+//  - any other 8 byte immediate as the ULEB128 of its zigzag encoding
+//    ((i << 1) ^ (i >> 63)), so small integers of either sign are short.
+//  - the pool index of a load or push, a pop count, a raw data or
+//    constant size and a memoized jit's count of arguments as a ULEB128.
+//
+// booleans and raw data bytes are unchanged.
+
+// with BIN_CODE_LZ4, the section is the u64 size of the code, then its
+// BIN_LZ4_BLOCK_SIZE byte blocks in order, the last one shorter. a block
+// is a u32 header and the header's size in bytes: with BIN_LZ4_STORED set
+// in it, the block as is, otherwise compressed in the LZ4 block format.
+// blocks are independent, so the code can be decompressed one at a time.
+#define BIN_LZ4_BLOCK_SIZE (64 * 1024)
+#define BIN_LZ4_STORED 0x80000000u
+
+typedef struct bin_section {
+  uint32_t kind; // BIN_SECTIONS; unknown kinds are skipped
+  uint32_t flags; // for BIN_SECTION_CODE, BIN_CODE_FLAGS; otherwise 0
+  uint64_t offset; // from the start of the file
+  uint64_t size; // in bytes
+} bin_section_t;
+
+// a static data slot: `type` is a CONST_FLAGS value and `data` the 8 byte
+// immediate the corresponding load would have, or the index of a
+// BIN_SECTION_CONST entry for CONST_FLAGS_POOL
+typedef struct bin_data {
+  uint32_t slot; // absolute $d index
+  uint8_t type;
+  uint8_t reserved[3];
+  uint64_t data;
+} bin_data_t;
+
+// a $d slot holding the address of a label, as a u64
+typedef struct bin_label {
+  uint32_t slot; // absolute $d index
+  uint32_t reserved;
+  uint64_t offset; // into BIN_SECTION_CODE
+} bin_label_t;
+
+// a try region: a throw from an instruction in [start, end) of the code,
+// or from a function called there, goes on at `handler`. regions are in
+// the order they end, so of those around an instruction the innermost
+// comes first.
+typedef struct bin_try {
+  uint64_t start; // into BIN_SECTION_CODE, at an instruction
+  uint64_t end; // one past the region's last byte
+  uint64_t handler; // into BIN_SECTION_CODE, at an instruction
+} bin_try_t;
+
+// a segment of the code, from `offset` to the next segment's (or the end
+// of the code), holding `count` instructions. segments are in order of
+// offset, and the first is at 0. code with segments has no OP_CONST: its
+// pool is the BIN_SECTION_CONST entries alone.
+typedef struct bin_segment {
+  uint64_t offset; // into BIN_SECTION_CODE, at an instruction
+  uint32_t count;
+  uint32_t reserved;
+} bin_segment_t;
+
+// a conditional jump or call, numbered by bcparse in the order it builds
+// them, before optimizing: the same source gets the same numbers whatever
+// the options, so a profile of one build can be used to compile another.
+// copies of one, as inlining makes, share its number.
+typedef struct bin_site {
+  uint64_t offset; // into BIN_SECTION_CODE, of the instruction
+  uint32_t site;
+  uint32_t flags; // BIN_SITE_FLAGS
+} bin_site_t;
+
+enum BIN_SITE_FLAGS {
+  // the jump there has the opposite condition of the one numbered, and
+  // is counted as taken when that one would not have been
+  BIN_SITE_INVERTED = 0x1
+};
+
+// BIN_SECTION_LINES is a bin_lines_t, then `numRanges` bin_line_t,
+// `numTraces` bin_trace_t and the strings they refer to, each NUL
+// terminated. a range of the code runs from its offset to the next
+// range's, or the end of the code, and was built by the statement of its
+// trace. a trace's caller is the statement it was expanded from, a macro
+// call, @include or @unroll, whose own caller is the one that was in
+// turn expanded from, out to the file compiled.
+typedef struct bin_lines {
+  uint32_t numRanges;
+  uint32_t numTraces;
+} bin_lines_t;
+
+typedef struct bin_line {
+  uint64_t offset; // into BIN_SECTION_CODE; ranges are in order of it
+  uint32_t trace; // index of a bin_trace_t, BIN_LINE_UNKNOWN if there is none
+  uint32_t reserved;
+} bin_line_t;
+
+// a range of code nothing says the source of, as bclink gives that of an
+// object compiled without -g
+#define BIN_LINE_UNKNOWN UINT32_MAX
+
+typedef struct bin_trace {
+  uint32_t file; // offset into the strings
+  uint32_t directive; // offset into the strings, of "" if the statement is not one
+  uint32_t line; // from 1
+  uint32_t column; // from 1
+  uint32_t caller; // index of a bin_trace_t plus 1, or 0 for none
+  uint32_t reserved;
+} bin_trace_t;
+
+// an object is a container whose code is not BIN_CODE_COMPACT, so that
+// the fields bin_reloc_t points at are of a fixed size, and has no
+// segments. bclink lays the objects' code out one after the other, the
+// first one's at the start, and gives each object's static data, label
+// slots and pool entries places of their own in the linked program: a
+// constant or data slot the objects have in common once, the slot of a
+// symbol an object only refers to the one of the object exporting it.
+
+// a label named for linking: `@export` of a label in the object, or the
+// `@extern` slot of one some other object exports. `nameLength` bytes of
+// name follow it.
+typedef struct bin_symbol {
+  uint64_t offset; // into BIN_SECTION_CODE, with BIN_SYMBOL_EXPORT
+  uint32_t slot; // the label's absolute $d index
+  uint16_t flags; // BIN_SYMBOL_FLAGS
+  uint16_t nameLength;
+} bin_symbol_t;
+
+enum BIN_SYMBOL_FLAGS {
+  BIN_SYMBOL_EXPORT = 0x1 // defined here, otherwise only referred to
+};
+
+typedef struct bin_reloc {
+  uint64_t offset; // into BIN_SECTION_CODE, of the field
+  uint32_t kind; // BIN_RELOC_KINDS
+  uint32_t reserved;
+} bin_reloc_t;
+
+enum BIN_RELOC_KINDS {
+  BIN_RELOC_DATA = 1, // a u32 obj_loc_t of an absolute $d slot
+  BIN_RELOC_POOL = 2 // a u32 index into the constant pool
+};
+
+// a $d slot holding a function of an extension module, by the module's
+// name and its own. `moduleLength`, `nameLength` and `signatureLength`
+// bytes of each, with no NUL, follow it.
+typedef struct bin_import {
+  uint32_t slot; // absolute $d index
+  uint16_t moduleLength;
+  uint16_t nameLength;
+  uint16_t signatureLength;
+  uint16_t reserved[3];
+} bin_import_t;
+
+// a profile, which `vm --profile-out` writes and `bcparse --profile-use`
+// reads, is text: PROFILE_HEADER on a line, then `<site> <count> <taken>`
+// on a line for each site that ran: how many times, and how many of those
+// it jumped (0 for a call).
+#define PROFILE_HEADER "bb8-profile 1"
+
+#endif
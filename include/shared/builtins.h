@@ -6,6 +6,94 @@ enum BUILTIN_C_FUNCTIONS {
   BUILTIN_SYSTEM_GET_OBJECT_MEMBER = 1,
   BUILTIN_SYSTEM_SET_OBJECT_MEMBER = 2,
 
+  BUILTIN_SYSTEM_ARRAY_CREATE = 3,
+  BUILTIN_SYSTEM_ARRAY_CREATE_INT = 4,
+  BUILTIN_SYSTEM_ARRAY_CREATE_FLOAT = 5,
+  BUILTIN_SYSTEM_ARRAY_GET_INDEX = 6,
+  BUILTIN_SYSTEM_ARRAY_SET_INDEX = 7,
+  BUILTIN_SYSTEM_ARRAY_PUSH = 8,
+  BUILTIN_SYSTEM_ARRAY_SIZE = 9,
+
+  BUILTIN_SYSTEM_SCAN_FIND = 10,
+  BUILTIN_SYSTEM_SCAN_SKIP = 11,
+
+  BUILTIN_SYSTEM_VEC_ADD = 12,
+  BUILTIN_SYSTEM_VEC_MUL = 13,
+  BUILTIN_SYSTEM_VEC_FMA = 14,
+  BUILTIN_SYSTEM_VEC_DOT = 15,
+  BUILTIN_SYSTEM_VEC_SUM = 16,
+  BUILTIN_SYSTEM_VEC_MIN = 17,
+  BUILTIN_SYSTEM_VEC_MAX = 18,
+
+  BUILTIN_SYSTEM_MAP_CREATE = 19,
+  BUILTIN_SYSTEM_MAP_GET = 20,
+  BUILTIN_SYSTEM_MAP_SET = 21,
+  BUILTIN_SYSTEM_MAP_HAS = 22,
+  BUILTIN_SYSTEM_MAP_REMOVE = 23,
+  BUILTIN_SYSTEM_MAP_SIZE = 24,
+  BUILTIN_SYSTEM_MAP_KEYS = 25,
+
+  BUILTIN_SYSTEM_SNAPSHOT = 26,
+  BUILTIN_SYSTEM_FLUSH = 27,
+
+  BUILTIN_SYSTEM_STREAM_OPEN = 28,
+  BUILTIN_SYSTEM_STREAM_READ_INTO = 29,
+  BUILTIN_SYSTEM_STREAM_READ_LINE = 30,
+  BUILTIN_SYSTEM_STREAM_MAP = 31,
+  BUILTIN_SYSTEM_STREAM_SIZE = 32,
+  BUILTIN_SYSTEM_STREAM_CLOSE = 33,
+
+  BUILTIN_SYSTEM_AIO_READ = 34,
+  BUILTIN_SYSTEM_AIO_WRITE = 35,
+  BUILTIN_SYSTEM_AIO_POLL = 36,
+  BUILTIN_SYSTEM_AIO_WAIT = 37,
+
+  BUILTIN_SYSTEM_INPUT = 38,
+
+  BUILTIN_SYSTEM_TASK_SPAWN = 39,
+  BUILTIN_SYSTEM_TASK_JOIN = 40,
+  BUILTIN_SYSTEM_TASK_DONE = 41,
+
+  BUILTIN_SYSTEM_CHAN_CREATE = 42,
+  BUILTIN_SYSTEM_CHAN_SEND = 43,
+  BUILTIN_SYSTEM_CHAN_RECV = 44,
+  BUILTIN_SYSTEM_CHAN_CLOSE = 45,
+
+  BUILTIN_SYSTEM_SHARE = 46,
+
+  BUILTIN_SYSTEM_PARALLEL_MAP = 47,
+  BUILTIN_SYSTEM_PARALLEL_REDUCE = 48,
+
+  BUILTIN_SYSTEM_TRACE_DUMP = 49,
+
+  // not bound to a name: bcparse calls these in place of createObject
+  // for objects that do not escape their block, see vm/scratch.h
+  BUILTIN_SYSTEM_CREATE_SCRATCH_OBJECT = 50,
+  BUILTIN_SYSTEM_SCRATCH_RELEASE = 51,
+  // in place of createObject and the setObjectMember calls after it, see
+  // BUILTIN_TEMPLATE_MAX
+  BUILTIN_SYSTEM_CREATE_FROM_TEMPLATE = 52,
+
+  // createObject with room for a number of members. bcparse calls it in
+  // place of createObject for an @object body it cannot make a template of
+  BUILTIN_SYSTEM_CREATE_OBJECT_SIZED = 53,
+
+  BUILTIN_SYSTEM_STR_BUILDER = 54,
+  BUILTIN_SYSTEM_STR_APPEND = 55,
+  BUILTIN_SYSTEM_STR_BUILD = 56,
+  BUILTIN_SYSTEM_STR_SLICE = 57,
+  BUILTIN_SYSTEM_STR_COPY = 58,
+  BUILTIN_SYSTEM_PARSE_INT = 59,
+  BUILTIN_SYSTEM_PARSE_DOUBLE = 60,
+  BUILTIN_SYSTEM_FORMAT_INT = 61,
+  BUILTIN_SYSTEM_FORMAT_DOUBLE = 62,
+  BUILTIN_SYSTEM_THROW = 63,
+
+  // host0 .. host31: native functions of a program embedding the vm,
+  // see embed_register
+  BUILTIN_HOST_FIRST = 96,
+  BUILTIN_HOST_COUNT = 32,
+
   BUILTIN_SYSTEM_C_EXIT = 64,
   BUILTIN_SYSTEM_C_FMOD = 65,
   BUILTIN_SYSTEM_C_STRLEN = 66,
@@ -14,7 +102,101 @@ enum BUILTIN_C_FUNCTIONS {
   BUILTIN_SYSTEM_C_FCLOSE = 68,
   BUILTIN_SYSTEM_C_FREAD = 69,
   BUILTIN_SYSTEM_C_FWRITE = 70,
-  BUILTIN_SYSTEM_C_FSEEK = 71
+  BUILTIN_SYSTEM_C_FSEEK = 71,
+
+  BUILTIN_SYSTEM_C_MEMCPY = 72,
+  BUILTIN_SYSTEM_C_MEMSET = 73,
+  BUILTIN_SYSTEM_C_MEMCHR = 74,
+  BUILTIN_SYSTEM_C_MEMCMP = 75,
+
+  // @arena, see lib/arena.bb8 and vm/arena.h
+  BUILTIN_SYSTEM_ARENA_BEGIN = 76,
+  BUILTIN_SYSTEM_ARENA_END = 77,
+
+  BUILTIN_SYSTEM_HEAP_CENSUS = 78,
+
+  BUILTIN_SYSTEM_TABLE_CREATE = 79,
+  BUILTIN_SYSTEM_TABLE_APPEND = 80,
+  BUILTIN_SYSTEM_TABLE_GET = 81,
+  BUILTIN_SYSTEM_TABLE_SET = 82,
+  BUILTIN_SYSTEM_TABLE_ROW = 83,
+  BUILTIN_SYSTEM_TABLE_SIZE = 84,
+
+  BUILTIN_SYSTEM_SERIALIZE = 85,
+  BUILTIN_SYSTEM_DESERIALIZE = 86,
+
+  BUILTIN_SYSTEM_PARSE_JSON = 87,
+  BUILTIN_SYSTEM_STRINGIFY_JSON = 88,
+
+  BUILTIN_SYSTEM_REGEX_COMPILE = 89,
+  BUILTIN_SYSTEM_REGEX_MATCH = 90,
+  BUILTIN_SYSTEM_REGEX_FIND = 91,
+
+  BUILTIN_SYSTEM_SORT = 92,
+  BUILTIN_SYSTEM_SORT_BY = 93,
+
+  BUILTIN_SYSTEM_HASH64 = 94,
+  BUILTIN_SYSTEM_CRC32C = 95,
+
+  // past the host slots, up to STATIC_DATA_RESERVED (256). programs
+  // before bin version 7 keep their own data from 128, and call none of
+  // these.
+  BUILTIN_SYSTEM_HASH_CREATE = 128,
+  BUILTIN_SYSTEM_HASH_UPDATE = 129,
+  BUILTIN_SYSTEM_HASH_DIGEST = 130,
+
+  BUILTIN_SYSTEM_CLOCK_NS = 131,
+  BUILTIN_SYSTEM_BENCH_BEGIN = 132,
+  BUILTIN_SYSTEM_BENCH_STEP = 133,
+
+  BUILTIN_SYSTEM_PARALLEL_FOR = 134,
+
+  BUILTIN_SYSTEM_CACHE_CREATE = 135,
+  BUILTIN_SYSTEM_CACHE_GET = 136,
+  BUILTIN_SYSTEM_CACHE_SET = 137,
+  BUILTIN_SYSTEM_CACHE_REMOVE = 138,
+  BUILTIN_SYSTEM_CACHE_SIZE = 139,
+  BUILTIN_SYSTEM_CACHE_EVICTIONS = 140,
+
+  BUILTIN_SYSTEM_SOCK_LISTEN = 141,
+  BUILTIN_SYSTEM_SOCK_CONNECT = 142,
+  BUILTIN_SYSTEM_SOCK_ACCEPT = 143,
+  BUILTIN_SYSTEM_SOCK_READ = 144,
+  BUILTIN_SYSTEM_SOCK_WRITE = 145,
+  BUILTIN_SYSTEM_SOCK_SEND_FILE = 146,
+  BUILTIN_SYSTEM_SOCK_WAIT = 147,
+  BUILTIN_SYSTEM_SOCK_CLOSE = 148,
+
+  BUILTIN_SYSTEM_STREQ = 149,
+  BUILTIN_SYSTEM_STR_INTERN = 150,
+
+  BUILTIN_SYSTEM_OBJECT_KEYS = 151,
+  BUILTIN_SYSTEM_OBJECT_VALUES = 152,
+  BUILTIN_SYSTEM_OBJECT_FOR_EACH = 153,
+  BUILTIN_SYSTEM_OBJECT_CLONE = 154,
+  BUILTIN_SYSTEM_OBJECT_ASSIGN = 155,
+
+  BUILTIN_SYSTEM_STRUCT_CREATE = 156,
+  BUILTIN_SYSTEM_GET_SLOT = 157,
+  BUILTIN_SYSTEM_SET_SLOT = 158,
+
+  // the slots below which the builtins are; a program's own start here,
+  // see STATIC_DATA_RESERVED
+  BUILTIN_RESERVED = 256
+};
+
+// character classes for scanFind / scanSkip
+enum BUILTIN_SCAN_CLASSES {
+  BUILTIN_SCAN_SPACE = 0, // ' ', '\t' .. '\r'
+  BUILTIN_SCAN_DIGIT = 1, // '0' .. '9'
+  BUILTIN_SCAN_IDENT = 2, // letters, digits and '_'
+  BUILTIN_SCAN_STRING_END = 3 // '"', '\\' and '\n'
 };
 
+// the static data createFromTemplate(template) is passed, the members of
+// the object it makes in order: a u32 count, then for each member the
+// u32 slots of static data holding its key and its value. bcparse writes
+// one for an object whose members are all set from static data.
+#define BUILTIN_TEMPLATE_MAX 32 // SHAPE_MAX_MEMBERS
+
 #endif
@@ -0,0 +1,17 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+// build configuration shared by bcparse and the vm.
+// bytecode is only portable between builds that agree on these.
+
+// size of the register file, $r[0] .. $r[NUM_REGISTERS - 1].
+// set with -DBB8_NUM_REGISTERS=<n>.
+#ifndef NUM_REGISTERS
+#define NUM_REGISTERS 16
+#endif
+
+// arguments an OP_CALL may take at operands of its own, rather than in
+// registers or on the stack (CALL_FLAGS_OPERANDS)
+#define CALL_MAX_OPERANDS 8
+
+#endif
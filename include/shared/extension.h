@@ -0,0 +1,50 @@
+#ifndef EXTENSION_H
+#define EXTENSION_H
+
+#include <stdint.h>
+
+// a native extension module: a shared library exporting a function named
+// BB8_EXTENSION_SYMBOL, of type bb8_extension_entry_t, that returns its
+// table. bcparse --extension reads the table to bind each function's name
+// to a $d slot of its own, and records the binding in BIN_SECTION_IMPORTS;
+// vm --extension loads the module into a registry that program_create
+// resolves the program's imports from. neither keeps slot numbers of its
+// own in step with the other, as for the builtins of shared/builtins.h.
+//
+//   static value_t dot(runtime_t *rt, args_t *args) { ... }
+//
+//   static const bb8_extension_function_t functions[] = {
+//     { "dot", "f64(ptr,ptr,i64)", (void*)dot }
+//   };
+//   static const bb8_extension_t extension = {
+//     BB8_EXTENSION_VERSION, "kernels", functions, 1
+//   };
+//
+//   const bb8_extension_t *bb8_extension(void) { return &extension; }
+//
+// in the program, `call #{dot}, ...` as for a builtin.
+
+#define BB8_EXTENSION_VERSION 1
+#define BB8_EXTENSION_SYMBOL "bb8_extension"
+
+// a function's signature is "<result>(<argument>,...)" of the types i64,
+// u64, f64, bool, ptr and any, with "..." last for any number more, as
+// "i64(ptr,...)". bcparse checks the arguments of each call against it;
+// the vm checks that the module it loads has the signature the program
+// was compiled for.
+typedef struct bb8_extension_function {
+  const char *name;
+  const char *signature;
+  void *fn; // a native_function_t, see vm/types.h
+} bb8_extension_function_t;
+
+typedef struct bb8_extension {
+  uint32_t version; // BB8_EXTENSION_VERSION
+  const char *name; // of the module, which imports are bound by
+  const bb8_extension_function_t *functions;
+  uint32_t numFunctions;
+} bb8_extension_t;
+
+typedef const bb8_extension_t *(*bb8_extension_entry_t)(void);
+
+#endif
@@ -2,6 +2,8 @@
 
 #include <string>
 
+#include <shared/symbol_table.hpp>
+
 class SourceLocation {
 public:
   static const SourceLocation eof;
@@ -14,8 +16,10 @@ public:
   inline int &getLine() { return m_line; }
   inline int getColumn() const { return m_column; }
   inline int &getColumn() { return m_column; }
-  inline const std::string &getFileName() const { return m_filename; }
-  inline void setFileName(const std::string &filename) { m_filename = filename; }
+  // interned (see symbol_table.hpp). NULL only in a static copied before
+  // the one it copies was made.
+  inline const std::string &getFileName() const { return m_filename != nullptr ? *m_filename : noFileName(); }
+  inline void setFileName(const std::string &filename) { m_filename = SymbolTable::intern(filename); }
 
   bool operator<(const SourceLocation &other) const;
   bool operator==(const SourceLocation &other) const;
@@ -25,5 +29,7 @@ public:
 private:
   int m_line;
   int m_column;
-  std::string m_filename;
+  const std::string *m_filename;
+
+  static const std::string &noFileName();
 };
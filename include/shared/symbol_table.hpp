@@ -0,0 +1,13 @@
+#pragma once
+
+#include <string>
+
+// strings kept once for the whole process: token values and file names.
+// what refers to an interned string holds a pointer to its one copy, so
+// copying it copies no characters, and two interned strings are equal
+// exactly when their pointers are. they are never freed. safe to use from
+// any thread, as bcparse --build compiles on several.
+class SymbolTable {
+public:
+  static const std::string *intern(const std::string &value);
+};
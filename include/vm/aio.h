@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+  #include <sys/uio.h>
+  #define AIO_IOVEC 1
+#endif
+
+#include <vm/types.h>
+#include <vm/value.h>
+
+// reads and writes that run while the program goes on: a request is
+// submitted, and later polled for or waited on. all of them are positional
+// (pread and pwrite), so they neither use nor move a FILE's position.
+//
+// on linux they go through an io_uring, set up with raw syscalls. where
+// that is not available, or with BB8_AIO=threads in the environment, a
+// pool of AIO_THREADS threads runs them instead.
+#define AIO_RING_ENTRIES 256 // the most requests in flight on an io_uring
+#define AIO_THREADS 4
+
+typedef struct aio aio_t;
+
+typedef enum {
+  AIO_READ = 0,
+  AIO_WRITE = 1
+} aio_op_t;
+
+typedef struct aio_request {
+  aio_t *aio;
+  aio_op_t op;
+  int fd;
+  void *data; // `size` bytes, a refcounted buffer or borrowed
+  size_t size;
+  int64_t position;
+  refcounted_t claim; // on `data`, while the request holds it; or NULL
+#if AIO_IOVEC
+  struct iovec iov; // `data` and `size`, read by the io_uring while in flight
+#endif
+
+  atomic_bool done;
+  int64_t result; // bytes transferred, -1 on error; set before `done`
+
+  struct aio_request *next; // in the thread pool's queue
+} aio_request_t;
+
+// NULL if neither backend can be started
+aio_t *aio_create();
+// waits for every request still in flight
+void aio_destroy(aio_t *aio);
+// which backend is in use, "io_uring" or "threads"
+const char *aio_backend(aio_t *aio);
+
+// a request for `size` bytes at `data`, filled in by the caller's
+// aio_submit; `claim` is claimed until the request is destroyed
+aio_request_t *aio_request(aio_t *aio, aio_op_t op, int fd, void *data, size_t size, int64_t position,
+                           refcounted_t claim);
+// waits for the request if it is still in flight
+void aio_requestDestroy(aio_request_t *req);
+
+void aio_submit(aio_request_t *req);
+// whether the request is done, without waiting
+bool aio_poll(aio_request_t *req);
+// its result, once it is done
+int64_t aio_wait(aio_request_t *req);
+
+// a new heap node holding an aio_request_t, which it owns. defined next
+// to value_createObject, in value.c.
+value_t value_createAio(runtime_t *rt, heap_t *heap, aio_request_t *req);
+
+// a native_function_t used as the dtor_ptr on heap node
+void aio_destructor(runtime_t *rt, args_t *args);
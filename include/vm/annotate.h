@@ -0,0 +1,17 @@
+#pragma once
+
+#include <vm/interpreter.h>
+
+#include <stdbool.h>
+#include <stdio.h>
+
+// vm --annotate: the program's code, one instruction to a line with its
+// operands, under the named labels of BIN_SECTION_DEBUG (bcparse -g) and
+// the source lines of BIN_SECTION_LINES that built it, each with what the
+// instruction profile at `path` says of it (see
+// INTERPRETER_INSTRUCTIONS_HEADER): the times it ran, its share of the
+// time and, for a conditional jump, how often it jumped. the source is
+// read from the files the lines section names, as they are now.
+// the code of `it` is decoded in full for it. false, after printing why,
+// if the profile cannot be read or was taken of other code.
+bool annotate_write(interpreter_t *it, const char *path, FILE *f);
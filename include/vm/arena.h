@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include <vm/types.h>
+#include <vm/heap.h>
+
+// request-local allocation, for @arena { ... } (see lib/arena.bb8):
+// BUILTIN_SYSTEM_ARENA_BEGIN opens an arena, and while one is open the
+// objects, arrays and maps the program creates take their nodes from the
+// heap's slabs but are kept here, at the depth of the innermost arena,
+// rather than linked into the nursery. BUILTIN_SYSTEM_ARENA_END closes it
+// and destroys them right away; no collection sweeps them, nor counts
+// them towards one, so they cost the collector nothing but marking
+// through the live ones, as for vm/scratch.h.
+//
+// what escapes is kept: heap_writeBarrier takes whatever is stored into
+// a node of a lower depth (the heap's being 0) down to that one, with
+// the arena nodes it references (see heap_escapeBegin), and closing an
+// arena takes what the roots hold down to the enclosing one. a node left
+// at depth 0 is linked into the nursery then; one at an enclosing
+// arena's depth is left to that arena.
+// a throw out of the scope skips its end: the arena stays open until the
+// next end closes it, with whatever was allocated meanwhile.
+#define ARENA_MAX_DEPTH 32
+
+typedef struct arena {
+  heap_node_t **nodes; // of every open arena, the innermost's last
+  size_t len;
+  size_t size;
+  size_t starts[ARENA_MAX_DEPTH]; // where each open arena's nodes start
+  uint8_t depth; // arenas open
+} arena_t;
+
+void arena_init(arena_t *arena);
+void arena_destroy(runtime_t *rt, arena_t *arena);
+
+// opens an arena inside the innermost one. false if ARENA_MAX_DEPTH are
+// open already.
+bool arena_begin(arena_t *arena);
+// a node for a new value in the innermost arena, as heap_alloc
+heap_value_t *arena_alloc(arena_t *arena, heap_t *heap);
+// closes the innermost arena: what the roots of `rt` hold escapes, and
+// its nodes that did not are destroyed. returns their number.
+size_t arena_end(runtime_t *rt, arena_t *arena);
+// closes every arena, destroying every node without looking for escapes:
+// for a runtime nothing refers to any more, see runtime_reset
+void arena_clear(runtime_t *rt, arena_t *arena);
+// clears the marks a collection left on the nodes, as the sweep does for
+// those in the heap; with the heap locked
+void arena_unmark(arena_t *arena);
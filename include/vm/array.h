@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include <vm/types.h>
+#include <vm/value.h>
+
+#define ARRAY_INITIAL_CAPACITY (8)
+
+typedef enum {
+  ARRAY_VALUES = 0, // value_t elements, traced by the collector
+  ARRAY_I64 = 1, // unboxed int64_t
+  ARRAY_F64 = 2, // unboxed double
+  ARRAY_BYTES = 3 // uint8_t, the text of a string builder, see strBuilder
+} ARRAY_KIND;
+
+// a growable array: `size` elements stored contiguously in `data`, which
+// has room for `capacity` of them and doubles in size when full. a typed
+// array keeps its numbers unboxed, converting on the way in and out.
+typedef struct {
+  ARRAY_KIND kind;
+  size_t size;
+  size_t capacity;
+  void *data;
+  heap_t *heap; // the array and its elements, see array_create
+} array_t;
+
+// the bytes each element of an array of `kind` takes
+size_t array_elementSize(ARRAY_KIND kind);
+
+// allocated through heap_allocBlock, from the heap holding the array
+array_t *array_create(heap_t *heap, ARRAY_KIND kind, size_t capacity);
+void array_destroy(array_t *array);
+// heap_mark on every element, for ARRAY_VALUES
+void array_mark(array_t *array, heap_t *heap);
+
+// a new heap node holding an array_t, with room for `capacity` elements.
+// defined next to value_createObject, in value.c.
+value_t value_createArray(runtime_t *rt, heap_t *heap, ARRAY_KIND kind, size_t capacity);
+
+// a native_function_t used as the dtor_ptr on heap node
+void array_destructor(runtime_t *rt, args_t *args);
+
+// grows the array to `size` elements, the new ones zero (TYPE_NONE for
+// ARRAY_VALUES). false if out of memory; the array is left as it was.
+bool array_resize(array_t *array, size_t size);
+// element `index` copied into `out`, boxed if the array is typed; false
+// if it is out of range
+bool array_get(runtime_t *rt, array_t *array, size_t index, value_t *out);
+// appends `count` elements of the array's kind, copied as they are.
+// false if out of memory; the array is left as it was.
+bool array_append(array_t *array, const void *elements, size_t count);
+// stores a copy of `value` at `index`, growing the array first if `index`
+// is past the end. false if out of memory.
+bool array_set(runtime_t *rt, array_t *array, size_t index, value_t *value);
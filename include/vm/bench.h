@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include <vm/types.h>
+
+// calibrated timing of a piece of a program, for the benchBegin and
+// benchStep builtins that lib/bench.bb8's @bench is built on. the piece
+// runs in batches, each as many times over as benchStep says:
+// - three batches of 1, 1 and 2 runs, counted (see runtime_countBegin);
+//   the difference of the last two is the instructions one run takes
+// - warmup: batches doubling from 1 until they took BENCH_WARMUP_PART of
+//   the target time, for compiled code and caches to settle; the last
+//   one gives the time a run takes
+// - BENCH_ROUNDS timed batches, sized to take the target time between
+//   them: BB8_BENCH_MS milliseconds, or BENCH_DEFAULT_MS
+// then a line goes to the program's output: the mean and the best round's
+// time a run takes, its instructions and the runs timed. the time and the
+// instructions include those of the loop around the piece.
+#define BENCH_ROUNDS 5
+#define BENCH_DEFAULT_MS 500
+#define BENCH_WARMUP_PART 5 // of the target time, 1/5
+#define BENCH_MAGIC 0x68636E6562ULL
+
+typedef struct bench {
+  uint64_t magic; // BENCH_MAGIC, for benchStep to check
+  int phase;
+  int round;
+  uint64_t batch; // runs in the batch going on
+  uint64_t started; // runtime_nowNs when it began
+  uint64_t targetNs;
+  uint64_t warmupNs; // taken so far
+  uint64_t counted[2]; // runtime_t.counted before the last two counted batches
+  int64_t instructions; // per run, -1 if unknown
+  uint64_t runs; // timed
+  uint64_t timedNs;
+  double bestNs; // per run, of the best round
+  uint32_t nameLen;
+  char name[]; // nameLen bytes, unterminated
+} bench_t;
+
+// the bytes a bench named by `len` bytes takes
+static inline size_t bench_size(size_t len) {
+  return sizeof(bench_t) + len;
+}
+
+void bench_init(bench_t *b, const char *name, size_t len);
+// the runs of the next batch, 0 once it is done and the line is written
+uint64_t bench_step(runtime_t *rt, bench_t *b);
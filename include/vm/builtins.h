@@ -0,0 +1,722 @@
+#pragma once
+
+#include <vm/runtime.h>
+#include <vm/value.h>
+#include <vm/types.h>
+#include <vm/code.h>
+#include <vm/object.h>
+#include <vm/array.h>
+#include <vm/heap.h>
+#include <vm/interpreter.h>
+#include <shared/builtins.h>
+
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+
+// native functions bound to the BUILTIN_C_FUNCTIONS slots of static data
+value_t _System_createObject(runtime_t *r, args_t *args);
+// createObjectSized(capacity): createObject, with room for that many
+// members, see object_createWithCapacity
+value_t _System_createObjectSized(runtime_t *r, args_t *args);
+value_t _System_getObjectMember(runtime_t *r, args_t *args);
+value_t _System_setObjectMember(runtime_t *r, args_t *args);
+value_t _System_createScratchObject(runtime_t *r, args_t *args);
+value_t _System_scratchRelease(runtime_t *r, args_t *args);
+// createFromTemplate(template): a new object with the members a template
+// of static data lists, see BUILTIN_TEMPLATE_MAX
+value_t _System_createFromTemplate(runtime_t *r, args_t *args);
+// arenaBegin() and arenaEnd(): open and close an arena for what the
+// program creates in between, see vm/arena.h
+value_t _System_arenaBegin(runtime_t *r, args_t *args);
+value_t _System_arenaEnd(runtime_t *r, args_t *args);
+
+value_t _System_arrayCreate(runtime_t *r, args_t *args);
+value_t _System_arrayCreateInt(runtime_t *r, args_t *args);
+value_t _System_arrayCreateFloat(runtime_t *r, args_t *args);
+value_t _System_arrayGetIndex(runtime_t *r, args_t *args);
+value_t _System_arraySetIndex(runtime_t *r, args_t *args);
+value_t _System_arrayPush(runtime_t *r, args_t *args);
+value_t _System_arraySize(runtime_t *r, args_t *args);
+
+// records of fixed layout, see @struct: structCreate(n) is an array of n
+// values, all none; getSlot(record, i) and setSlot(record, i, value) are
+// arrayGetIndex and arraySetIndex with `i` in range, which bcparse has as
+// a constant, so neither looks anything up. a record does not grow: a
+// slot out of range throws.
+value_t _System_structCreate(runtime_t *r, args_t *args);
+value_t _System_getSlot(runtime_t *r, args_t *args);
+value_t _System_setSlot(runtime_t *r, args_t *args);
+
+// text built up in place, in an array of ARRAY_BYTES that doubles as it
+// fills, so that building a string of n bytes copies O(n) of them.
+// strBuilder(capacity) returns a builder; strAppend(builder, value)
+// appends a string, another builder, or a scalar as OP_PRINT writes it,
+// and returns the length so far. strBuild(builder) is a copy of the text
+// as a string. strlen, fwrite and print take a builder for its text as
+// it is, and the array builtins its bytes. a capacity that is missing,
+// not an int or negative is BUILTINS_BUILDER_CAPACITY, and one past
+// BUILTINS_BUILDER_CAPACITY_MAX is that: the builder grows from there.
+#define BUILTINS_BUILDER_CAPACITY 64
+#define BUILTINS_BUILDER_CAPACITY_MAX ((int64_t)1 << 24)
+value_t _System_strBuilder(runtime_t *r, args_t *args);
+value_t _System_strAppend(runtime_t *r, args_t *args);
+value_t _System_strBuild(runtime_t *r, args_t *args);
+
+// strSlice(str, offset, length): `length` bytes of a string from `offset`,
+// none if the range is not within it. of a refcounted buffer, or a slice
+// of one, a slice that holds the buffer rather than a copy (see
+// value_setSlice); strCopy(slice) is a string of its own with the same
+// bytes, terminated. other values are returned by strCopy as they are.
+value_t _System_strSlice(runtime_t *r, args_t *args);
+value_t _System_strCopy(runtime_t *r, args_t *args);
+
+// strIntern(str): the runtime's canonical copy of a string, see
+// vm/intern.h. streq(a, b): whether two strings have the same bytes; the
+// same pointer is equal, two canonical copies that differ are not, both
+// without looking at the bytes, which otherwise are compared, lengths
+// first. false if either is not a string.
+value_t _System_strIntern(runtime_t *r, args_t *args);
+value_t _System_streq(runtime_t *r, args_t *args);
+
+// scanFind(src, offset, n, class) / scanSkip(src, offset, n, class): the
+// offset of the first byte in [offset, offset + n) that is / is not in the
+// BUILTIN_SCAN_CLASSES class, -1 if there is none or the range is invalid
+value_t _System_scanFind(runtime_t *r, args_t *args);
+value_t _System_scanSkip(runtime_t *r, args_t *args);
+
+// parseInt(src, offset, n) / parseDouble(src, offset, n): the number that
+// is all of [offset, offset + n) of a string or slice (see scan_parseInt),
+// none if it is not one or the range is invalid. formatInt(dst, offset,
+// value) / formatDouble(dst, offset, value) write the value as OP_PRINT
+// does into a writable buffer at `offset`, unterminated, and return the
+// number of bytes written: -1 if they do not fit, when nothing is.
+value_t _System_parseInt(runtime_t *r, args_t *args);
+value_t _System_parseDouble(runtime_t *r, args_t *args);
+value_t _System_formatInt(runtime_t *r, args_t *args);
+value_t _System_formatDouble(runtime_t *r, args_t *args);
+
+// throw(value): throws the value, which the handler of the try region it
+// is caught in finds in $r[0], see runtime_throwException. if nothing
+// catches it, the program stops with it written to stderr. the object,
+// array and map builtins throw a string saying why where they fail in a
+// try region; outside of one they return none, as they always have.
+value_t _System_throw(runtime_t *r, args_t *args);
+
+// over ARRAY_I64 / ARRAY_F64 arrays of one kind and size. vecAdd(dst, a, b),
+// vecMul(dst, a, b) and vecFma(dst, a, b, c) store elementwise into dst,
+// resizing it, and give the size or -1; vecDot(a, b), vecSum(a), vecMin(a)
+// and vecMax(a) give a number of the arrays' kind, none on a mismatch or,
+// for min and max, an empty array.
+value_t _System_vecAdd(runtime_t *r, args_t *args);
+value_t _System_vecMul(runtime_t *r, args_t *args);
+value_t _System_vecFma(runtime_t *r, args_t *args);
+value_t _System_vecDot(runtime_t *r, args_t *args);
+value_t _System_vecSum(runtime_t *r, args_t *args);
+value_t _System_vecMin(runtime_t *r, args_t *args);
+value_t _System_vecMax(runtime_t *r, args_t *args);
+
+// string-keyed maps, compared by contents: mapGet(map, key),
+// mapSet(map, key, value), mapHas(map, key), mapRemove(map, key),
+// mapSize(map) and mapKeys(map), an array of the keys
+value_t _System_mapCreate(runtime_t *r, args_t *args);
+value_t _System_mapGet(runtime_t *r, args_t *args);
+value_t _System_mapSet(runtime_t *r, args_t *args);
+value_t _System_mapHas(runtime_t *r, args_t *args);
+value_t _System_mapRemove(runtime_t *r, args_t *args);
+value_t _System_mapSize(runtime_t *r, args_t *args);
+value_t _System_mapKeys(runtime_t *r, args_t *args);
+
+// iterating an object's members, in the order they were put, see
+// object_entries: objectKeys(obj) and objectValues(obj) are arrays of
+// them, empty for what is not an object, and objectForEach(obj, fn) calls
+// a native function with each key and value in turn, the members the
+// object had when it was called, and returns the object. a label cannot
+// be called from a builtin; a program loops over objectKeys instead, see
+// @members in lib/object.bb8.
+value_t _System_objectKeys(runtime_t *r, args_t *args);
+value_t _System_objectValues(runtime_t *r, args_t *args);
+value_t _System_objectForEach(runtime_t *r, args_t *args);
+
+// objectClone(obj) is a shallow copy of an object, see object_clone;
+// objectAssign(obj, src) sets each member of `src` on `obj`, in order, and
+// returns `obj`. both copy the members in one pass, without a call per
+// member, and claim the buffers they refer to as setObjectMember does.
+value_t _System_objectClone(runtime_t *r, args_t *args);
+value_t _System_objectAssign(runtime_t *r, args_t *args);
+
+// bounded caches for memoizing, see vm/cache.h: cacheCreate(maxEntries,
+// maxBytes, weak), either limit 0 for none, weak true or a nonzero int;
+// cacheGet(cache, key), none on a miss; cacheSet(cache, key, value),
+// cacheRemove(cache, key), cacheSize(cache) and cacheEvictions(cache),
+// the entries evicted or dropped so far
+value_t _System_cacheCreate(runtime_t *r, args_t *args);
+value_t _System_cacheGet(runtime_t *r, args_t *args);
+value_t _System_cacheSet(runtime_t *r, args_t *args);
+value_t _System_cacheRemove(runtime_t *r, args_t *args);
+value_t _System_cacheSize(runtime_t *r, args_t *args);
+value_t _System_cacheEvictions(runtime_t *r, args_t *args);
+
+// record tables: many records of one set of members kept as columns, a
+// typed array to a member. a table is an object of the records' shape
+// whose members are the columns, ARRAY_I64 for a member that was an int
+// in the record it was made from, ARRAY_F64 for a double and ARRAY_VALUES
+// for the rest, so `getfield col table "offset"` fetches a column once
+// for arrayGetIndex or the vec builtins to walk.
+// tableCreate(record, capacity) is an empty table with the members of
+// `record`, an object of a shape (see vm/shape.h). tableAppend(table,
+// record) adds a row from the record's members, none for those it lacks,
+// and gives the new size; tableGet(table, row, key), tableSet(table, row,
+// key, value) and tableRow(table, row), a new record of the row, read and
+// write them in place. tableSize(table) is the rows in the table.
+value_t _System_tableCreate(runtime_t *r, args_t *args);
+value_t _System_tableAppend(runtime_t *r, args_t *args);
+value_t _System_tableGet(runtime_t *r, args_t *args);
+value_t _System_tableSet(runtime_t *r, args_t *args);
+value_t _System_tableRow(runtime_t *r, args_t *args);
+value_t _System_tableSize(runtime_t *r, args_t *args);
+
+// serialize(value) is a refcounted buffer holding `value` and all it
+// reaches, see vm/serial.h: one to write to a file, or to send through a
+// channel (after `share`, without a copy). deserialize(buffer) builds it
+// again, on this runtime's heap; none, after throwing, if the buffer was
+// not made by serialize.
+value_t _System_serialize(runtime_t *r, args_t *args);
+value_t _System_deserialize(runtime_t *r, args_t *args);
+
+// parseJson(text) is the value of a JSON text, see vm/json.h: none, after
+// throwing, if it is not valid. short strings in it are slices of `text`
+// when that is a refcounted buffer. stringifyJson(builder, value) appends
+// `value` as JSON to a string builder, see strBuilder, and gives its new
+// size, or -1 after throwing if it is nested too deep (a cycle).
+value_t _System_parseJson(runtime_t *r, args_t *args);
+value_t _System_stringifyJson(runtime_t *r, args_t *args);
+
+// regular expressions, see vm/regex.h. regexCompile(pattern) compiles a
+// pattern into the runtime's cache and gives its interned text, which
+// the others find there the fastest; they compile a pattern they are
+// given the first time. regexMatch(pattern, src, offset, n) is the length
+// of the longest match at `offset`, regexFind(pattern, src, offset, n)
+// the offset of the leftmost match in [offset, offset + n), of a string,
+// slice, buffer or mapped file; -1 if there is none or the range is
+// invalid. ^ and $ are the ends of the range. a malformed pattern is
+// thrown.
+value_t _System_regexCompile(runtime_t *r, args_t *args);
+value_t _System_regexMatch(runtime_t *r, args_t *args);
+value_t _System_regexFind(runtime_t *r, args_t *args);
+
+// sort(array) sorts an array of any kind in place, see vm/sort.h, and
+// gives it back: typed arrays by radix sort, values by the order of
+// sort_compare (none, booleans, numbers, strings, the rest). sortBy(array,
+// key) sorts an array of values by a key for each element, stably. `key`
+// is a member name, read from each element that is an object (none for the
+// rest); a native function, called on each element here; or a label,
+// run on each element on the task pool as parallelMap runs it, so objects
+// reach it as none -- it suits arrays of numbers and strings. the keys are
+// taken once, before sorting, rather than a comparison called each time.
+value_t _System_sort(runtime_t *r, args_t *args);
+value_t _System_sortBy(runtime_t *r, args_t *args);
+
+// hash64(src, offset, n) is the 64-bit hash of n bytes of a string, slice,
+// buffer or mapped file, that of maps and interned strings: wyhash, see
+// hashString64. crc32c(src, offset, n, crc) their CRC-32C, continuing from
+// `crc` (0 to start), by the SSE4.2 or ARMv8 instructions where there are
+// any. hashCreate() makes a hasher, a buffer that hashUpdate(h, src,
+// offset, n) gives bytes to in pieces, giving back `h`, and hashDigest(h)
+// the hash64 of all it was given. an invalid range is thrown.
+value_t _System_hash64(runtime_t *r, args_t *args);
+value_t _System_crc32c(runtime_t *r, args_t *args);
+value_t _System_hashCreate(runtime_t *r, args_t *args);
+value_t _System_hashUpdate(runtime_t *r, args_t *args);
+value_t _System_hashDigest(runtime_t *r, args_t *args);
+
+// clockNs() is CLOCK_MONOTONIC in nanoseconds. benchBegin(name) makes a
+// bench, a buffer, and benchStep(bench) the runs of its next batch, 0
+// once it is done and has written its line; see vm/bench.h, and
+// lib/bench.bb8's @bench, which runs a piece of code by them.
+value_t _System_clockNs(runtime_t *r, args_t *args);
+value_t _System_benchBegin(runtime_t *r, args_t *args);
+value_t _System_benchStep(runtime_t *r, args_t *args);
+
+// snapshot(): under vm --snapshot, saves the program's state and exits;
+// false otherwise, and true once the state is restored, or in a process
+// forked there under vm --prefork. see vm/snapshot.h.
+value_t _System_snapshot(runtime_t *r, args_t *args);
+// flush(): writes out what OP_PRINT has buffered, see vm/output.h
+value_t _System_flush(runtime_t *r, args_t *args);
+// traceDump(): under vm --trace-ring, writes the last instructions run to
+// stderr and returns true, see interpreter_writeRing; false otherwise
+value_t _System_traceDump(runtime_t *r, args_t *args);
+// heapCensus(graph): writes what the heap holds to stderr, see
+// runtime_heapCensus, and the object graph to the file `graph` names,
+// if it is a string. false if that cannot be written.
+value_t _System_heapCensus(runtime_t *r, args_t *args);
+
+// files read in constant memory, see vm/stream.h. streamOpen(path) is a
+// stream, or none if the file cannot be opened.
+// streamReadInto(stream, buffer, offset) fills a refcounted buffer from
+// `offset` to its end and returns the bytes read, 0 at the end of the file.
+// streamReadLine(stream) is the next line, NUL terminated, and
+// streamMap(stream) the whole file: both are borrowed from the stream,
+// the line until the next read and the mapping until the stream is closed
+// or collected. either is none if there is nothing to return.
+// streamSize(stream) is -1 for a pipe.
+value_t _System_streamOpen(runtime_t *r, args_t *args);
+value_t _System_streamReadInto(runtime_t *r, args_t *args);
+value_t _System_streamReadLine(runtime_t *r, args_t *args);
+value_t _System_streamMap(runtime_t *r, args_t *args);
+value_t _System_streamSize(runtime_t *r, args_t *args);
+value_t _System_streamClose(runtime_t *r, args_t *args);
+
+// reads and writes that run in the background, see vm/aio.h. the file is
+// a FILE pointer or a stream; positions are from its start.
+// aioRead(file, buffer, position) fills a whole refcounted buffer and
+// aioWrite(file, buffer, length, position) writes `length` bytes of one
+// (or of a constant); both return a request, none if it cannot be made.
+// aioPoll(request) is whether it is done, and aioWait(request) waits for
+// it: the bytes read or written, fewer only at the end of the file, or -1.
+value_t _System_aioRead(runtime_t *r, args_t *args);
+value_t _System_aioWrite(runtime_t *r, args_t *args);
+value_t _System_aioPoll(runtime_t *r, args_t *args);
+value_t _System_aioWait(runtime_t *r, args_t *args);
+
+// non-blocking sockets, see vm/net.h and lib/net.bb8. sockListen(addr,
+// backlog) and sockConnect(addr), addr "host:port" or "unix:path", give a
+// socket or none; sockAccept(listener) a connection, none if none is
+// pending. sockRead(socket, buffer, offset, length), sockWrite(socket,
+// data, offset, length) from raw data or a string builder, and
+// sockSendFile(socket, file, offset, length) give the bytes moved, 0 at
+// the end (reads), -1 on an error or NET_AGAIN. sockWait(socket, "read" or
+// "write") parks the fiber until then, for the yield that follows, or
+// waits. sockClose(socket).
+value_t _System_sockListen(runtime_t *r, args_t *args);
+value_t _System_sockConnect(runtime_t *r, args_t *args);
+value_t _System_sockAccept(runtime_t *r, args_t *args);
+value_t _System_sockRead(runtime_t *r, args_t *args);
+value_t _System_sockWrite(runtime_t *r, args_t *args);
+value_t _System_sockSendFile(runtime_t *r, args_t *args);
+value_t _System_sockWait(runtime_t *r, args_t *args);
+value_t _System_sockClose(runtime_t *r, args_t *args);
+
+// input(): under vm --workers, the line of the input list the job was
+// started for, a constant that lives as long as the job; none otherwise
+value_t _System_input(runtime_t *r, args_t *args);
+
+// code run on a pool of threads, see vm/task.h. taskSpawn(label, arg)
+// starts the code at `label` with `arg` in $r[1], and returns its future,
+// none if it cannot be started. taskJoin(future) waits for the task to
+// halt, and returns its $r[0]; a string stays valid while the future does.
+// taskDone(future) is whether it halted.
+value_t _System_taskSpawn(runtime_t *r, args_t *args);
+value_t _System_taskJoin(runtime_t *r, args_t *args);
+value_t _System_taskDone(runtime_t *r, args_t *args);
+
+// bounded queues between runtimes, see vm/channel.h. chanCreate(capacity)
+// returns a channel. chanSend(ch, value) waits for room, and is false once
+// the channel is closed; chanRecv(ch) waits for a value, and is none once
+// it is closed and empty. chanClose(ch) closes it.
+value_t _System_chanCreate(runtime_t *r, args_t *args);
+value_t _System_chanSend(runtime_t *r, args_t *args);
+value_t _System_chanRecv(runtime_t *r, args_t *args);
+value_t _System_chanClose(runtime_t *r, args_t *args);
+
+// share(buffer): makes a refcounted buffer immutable, and shared by the
+// runtimes it is sent to rather than copied, see vm/rc.h; returns it.
+// other values are returned as they are.
+value_t _System_share(runtime_t *r, args_t *args);
+
+// data parallel loops on the task pool, see vm/task.h. parallelMap(array,
+// fn) returns a new array of fn(element), of the array's kind;
+// parallelReduce(array, fn, init) folds fn(acc, element) over it from
+// init. fn is a label or a native function. none if the pool cannot be
+// used from this thread.
+value_t _System_parallelMap(runtime_t *r, args_t *args);
+value_t _System_parallelReduce(runtime_t *r, args_t *args);
+// parallelFor(start, end, fn, reduction) calls fn(i) for each int i in
+// [start, end) on the task pool; reduction is "sum", "count", or "none"
+// or none, see vm/task.h. returns the reduction's result, none for none.
+// see lib/parallel.bb8.
+value_t _System_parallelFor(runtime_t *r, args_t *args);
+
+value_t _System_C_exit(runtime_t *r, args_t *args);
+value_t _System_C_fmod(runtime_t *r, args_t *args);
+value_t _System_C_strlen(runtime_t *r, args_t *args);
+
+value_t _System_C_fopen(runtime_t *r, args_t *args);
+value_t _System_C_fclose(runtime_t *r, args_t *args);
+value_t _System_C_fread(runtime_t *r, args_t *args);
+value_t _System_C_fwrite(runtime_t *r, args_t *args);
+value_t _System_C_fseek(runtime_t *r, args_t *args);
+
+// over raw data with offsets: memcpy(dst, dstOffset, src, srcOffset, n),
+// memset(dst, offset, byte, n), memchr(src, offset, byte, n) and
+// memcmp(a, aOffset, b, bOffset, n). a range outside a refcounted buffer,
+// or a write to a constant or inline value, gives -1; memchr gives the
+// offset of the byte, -1 if it is not found.
+value_t _System_C_memcpy(runtime_t *r, args_t *args);
+value_t _System_C_memset(runtime_t *r, args_t *args);
+value_t _System_C_memchr(runtime_t *r, args_t *args);
+value_t _System_C_memcmp(runtime_t *r, args_t *args);
+
+// stores every builtin into its $d slot, and the runtime's host functions
+void builtins_register(runtime_t *rt);
+// the BUILTIN_C_FUNCTIONS slot `fn` is bound to, -1 if it is no builtin
+int builtins_slotOf(native_function_t fn);
+// the builtin bound to `slot`, NULL if there is none
+native_function_t builtins_function(uint32_t slot);
+// the name bcparse gives the builtin `fn`, NULL if it is no builtin
+const char *builtins_name(native_function_t fn);
+
+// getObjectMember / setObjectMember for a call site whose cache missed:
+// does what the builtin does, and caches the object's shape on `ins` if
+// it has one. false if the target is not an object, or the member is not
+// found, leaving the call to the builtin itself.
+bool builtins_getMemberMiss(runtime_t *rt, instruction_t *ins, bool registers, value_t **operands, value_t *result);
+bool builtins_setMemberMiss(runtime_t *rt, instruction_t *ins, bool registers, value_t **operands, value_t *result);
+
+// createFromTemplate for a call site whose cache missed: makes the object
+// as the builtin does, and caches its shape and the template on `ins`
+bool builtins_templateMiss(runtime_t *rt, instruction_t *ins, bool registers, value_t **operands, value_t *result);
+
+// u32 `index` of a template, see BUILTIN_TEMPLATE_MAX
+static inline uint32_t builtins_templateWord(const void *tmpl, size_t index) {
+  uint32_t word;
+
+  memcpy(&word, (const char*)tmpl + index * sizeof(word), sizeof(word));
+
+  return word;
+}
+
+// argument `index` of an OP_CALL, as args_getArg would see it. `operands`
+// are those of CALL_FLAGS_OPERANDS, resolved, or NULL.
+static inline value_t *builtins_arg(runtime_t *rt, bool registers, value_t **operands, size_t index) {
+  storage_t *stack = &rt->dt->storage[AT_LOCAL];
+
+  if (operands != NULL) {
+    return operands[index];
+  }
+
+  return registers
+    ? &rt->dt->storage[AT_REG].data[1 + index]
+    : &stack->data[*stack->lenVal - 1 - index];
+}
+
+// the object an OP_CALL passes as its first argument, NULL if it is not one
+static inline object_t *builtins_argObject(runtime_t *rt, bool registers, value_t **operands) {
+  value_t *target = builtins_arg(rt, registers, operands, 0);
+
+  if (!VALUE_IS(target, TYPE_POINTER, FLAG_OBJECT)) {
+    return NULL;
+  }
+
+  return (object_t*)target->data.hv->ptr;
+}
+
+// the array an OP_CALL passes as its first argument, NULL if it is not one
+static inline array_t *builtins_argArray(runtime_t *rt, bool registers, value_t **operands) {
+  value_t *target = builtins_arg(rt, registers, operands, 0);
+
+  if (!VALUE_IS(target, TYPE_POINTER, FLAG_OBJECT | FLAG_ARRAY)) {
+    return NULL;
+  }
+
+  return (array_t*)target->data.hv->ptr;
+}
+
+// whether the key argument is the constant the call site's cache was filled
+// with; the type is compared too, since the bits of an inline string could
+// look like any pointer
+static inline bool builtins_cachedKey(runtime_t *rt, instruction_t *ins, bool registers, value_t **operands) {
+  value_t *key = builtins_arg(rt, registers, operands, 1);
+
+  return VALUE_IS(key, TYPE_POINTER, FLAG_CONST) && (object_key_t)key->data.raw == ins->member.key;
+}
+
+// the object of a member access whose call site's cache holds its shape
+// and key, NULL on a miss
+static inline object_t *builtins_memberHit(runtime_t *rt, instruction_t *ins, bool registers, value_t **operands) {
+  object_t *object = builtins_argObject(rt, registers, operands);
+
+  if (object == NULL || object->shape != ins->member.shape || object->shape == NULL
+      || !builtins_cachedKey(rt, ins, registers, operands)) {
+    return NULL;
+  }
+
+  return object;
+}
+
+// getObjectMember of a cache hit: an index
+static inline void builtins_getCached(runtime_t *rt, instruction_t *ins, object_t *object, value_t *result) {
+  value_t v;
+
+  VALUE_SET_META(&v, TYPE_NONE, FLAG_NONE);
+  value_copyValue(rt, &v, &object->slots[ins->member.slot]);
+  *result = v;
+}
+
+// setObjectMember of a cache hit. a hit that adds the member moves the
+// object to the cached next shape without a lookup.
+static inline void builtins_setCached(runtime_t *rt, instruction_t *ins, object_t *object, bool registers, value_t **operands, value_t *result) {
+  value_t v;
+
+  // as in _System_setObjectMember
+  ++rt->epoch;
+
+  VALUE_SET_META(&v, TYPE_NONE, FLAG_NONE);
+  value_copyValue(rt, &v, builtins_arg(rt, registers, operands, 2));
+
+  if (ins->member.next != object->shape) {
+    object_addSlot(object, ins->member.next, &v);
+  } else {
+    object->slots[ins->member.slot] = v;
+  }
+
+  heap_writeBarrier(rt->heap, builtins_arg(rt, registers, operands, 0)->data.hv, &v);
+  *result = v;
+}
+
+// getObjectMember through the call site's cache: a shape compare and an index
+static inline bool builtins_getMember(runtime_t *rt, instruction_t *ins, bool registers, value_t **operands, value_t *result) {
+  object_t *object = builtins_memberHit(rt, ins, registers, operands);
+
+  if (object == NULL) {
+    return builtins_getMemberMiss(rt, ins, registers, operands, result);
+  }
+
+  builtins_getCached(rt, ins, object, result);
+
+  return true;
+}
+
+// setObjectMember through the call site's cache
+static inline bool builtins_setMember(runtime_t *rt, instruction_t *ins, bool registers, value_t **operands, value_t *result) {
+  object_t *object = builtins_memberHit(rt, ins, registers, operands);
+
+  if (object == NULL) {
+    return builtins_setMemberMiss(rt, ins, registers, operands, result);
+  }
+
+  builtins_setCached(rt, ins, object, registers, operands, result);
+
+  return true;
+}
+
+// CODE_OP_GETFIELD / CODE_OP_SETFIELD with `callee`, `operands` and
+// `result` resolved as for builtins_callOperands: a cache hit of the
+// builtin the instruction was decoded for. false for anything else, which
+// is left to the OP_CALL. the result is stored as builtins_callOperands
+// would.
+static inline bool builtins_field(runtime_t *rt, instruction_t *ins, value_t *callee, value_t **operands, value_t *result) {
+  bool get = ins->opcode == CODE_OP_GETFIELD;
+  object_t *object;
+  value_t v;
+
+  if (!VALUE_IS(callee, TYPE_FUNCTION, FLAG_NONE)
+      || callee->data.fn != (get ? _System_getObjectMember : _System_setObjectMember)
+      || (object = builtins_memberHit(rt, ins, false, operands)) == NULL) {
+    return false;
+  }
+
+  if (get) {
+    builtins_getCached(rt, ins, object, &v);
+  } else {
+    builtins_setCached(rt, ins, object, false, operands, &v);
+  }
+
+  if ((ins->flags & CALL_FLAGS_RESULT) && (ins->right.at & 0x3) != AT_REG) {
+    value_release(rt, result);
+  }
+
+  *result = v;
+
+  return true;
+}
+
+// createFromTemplate through the call site's cache: one allocation of an
+// object of the cached shape, its slots copied from the template's values
+static inline bool builtins_fromTemplate(runtime_t *rt, instruction_t *ins, bool registers, value_t **operands, value_t *result) {
+  value_t *tmpl = builtins_arg(rt, registers, operands, 0);
+  value_t *data = rt->dt->storage[AT_DATA].data;
+  object_t *object;
+  value_t v;
+
+  if (ins->member.shape == NULL || !VALUE_IS(tmpl, TYPE_POINTER, FLAG_CONST)
+      || (object_key_t)tmpl->data.raw != ins->member.key) {
+    return builtins_templateMiss(rt, ins, registers, operands, result);
+  }
+
+  v = value_createShapedObject(rt, rt->heap, ins->member.shape);
+  object = (object_t*)v.data.hv->ptr;
+
+  // the object is new, so no write barrier but incremental marking's
+  for (uint32_t i = 0; i < ins->member.shape->count; i++) {
+    VALUE_SET_META(&object->slots[i], TYPE_NONE, FLAG_NONE);
+    value_copyValue(rt, &object->slots[i], &data[builtins_templateWord(ins->member.key, 2 + 2 * i)]);
+
+    if (rt->heap->marking) {
+      heap_shade(rt->heap, &object->slots[i]);
+    }
+  }
+
+  *result = v;
+
+  return true;
+}
+
+// arrayGetIndex / arraySetIndex on an array and an index in range; the
+// rest (growing the array included) is left to the builtins
+static inline bool builtins_arrayGetIndex(runtime_t *rt, bool registers, value_t **operands, value_t *result) {
+  array_t *array = builtins_argArray(rt, registers, operands);
+  value_t v;
+
+  if (array == NULL || builtins_arg(rt, registers, operands, 1)->data.u64 >= array->size) {
+    return false;
+  }
+
+  VALUE_SET_META(&v, TYPE_NONE, FLAG_NONE);
+  array_get(rt, array, builtins_arg(rt, registers, operands, 1)->data.u64, &v);
+  *result = v;
+
+  return true;
+}
+
+static inline bool builtins_arraySetIndex(runtime_t *rt, bool registers, value_t **operands, value_t *result) {
+  array_t *array = builtins_argArray(rt, registers, operands);
+  value_t *value = builtins_arg(rt, registers, operands, 2);
+  value_t v;
+
+  if (array == NULL || builtins_arg(rt, registers, operands, 1)->data.u64 >= array->size) {
+    return false;
+  }
+
+  // as in _System_arraySetIndex
+  ++rt->epoch;
+
+  array_set(rt, array, builtins_arg(rt, registers, operands, 1)->data.u64, value);
+  heap_writeBarrier(rt->heap, builtins_arg(rt, registers, operands, 0)->data.hv, value);
+
+  VALUE_SET_META(&v, TYPE_NONE, FLAG_NONE);
+  value_copyValue(rt, &v, value);
+  *result = v;
+
+  return true;
+}
+
+// strlen of a string, bounded by a slice's length, or the length of a
+// string builder's text
+static inline int64_t builtins_strlen(value_t *v) {
+  if (VALUE_IS(v, TYPE_POINTER, FLAG_OBJECT | FLAG_ARRAY) && ((array_t*)v->data.hv->ptr)->kind == ARRAY_BYTES) {
+    return (int64_t)((array_t*)v->data.hv->ptr)->size;
+  }
+
+  if (VALUE_IS_SLICE(v)) {
+    return (int64_t)strnlen((const char*)value_getRawPointer(v), VALUE_SLICE_LENGTH(v));
+  }
+
+  return (int64_t)strlen((const char*)value_getRawPointer(v));
+}
+
+// OP_CALL fast path for the leaf builtins: when `callee` is one of them,
+// its result is computed right here from the argument slots, without an
+// args_t or an indirect call, and stored raw into `result`. member
+// accesses go through the inline cache on `ins`.
+// element accesses skip the call as long as the index is in range.
+// returns false for any other callee, which goes through value_invoke.
+// shared by the interpreter and both JIT backends, so all three agree.
+static inline bool builtins_callDirect(runtime_t *rt, instruction_t *ins, value_t *callee, bool registers, value_t **operands, value_t *result) {
+  if (!VALUE_IS(callee, TYPE_FUNCTION, FLAG_NONE)) {
+    return false;
+  }
+
+  if (callee->data.fn == _System_getObjectMember) {
+    return builtins_getMember(rt, ins, registers, operands, result);
+  }
+
+  if (callee->data.fn == _System_setObjectMember) {
+    return builtins_setMember(rt, ins, registers, operands, result);
+  }
+
+  if (callee->data.fn == _System_createFromTemplate) {
+    return builtins_fromTemplate(rt, ins, registers, operands, result);
+  }
+
+  if (callee->data.fn == _System_createScratchObject && rt->fibers == NULL) {
+    *result = scratch_alloc(&rt->scratch, rt->heap);
+
+    return true;
+  }
+
+  // the result is unused, $r[0] is left as it was
+  if (callee->data.fn == _System_scratchRelease) {
+    scratch_release(&rt->scratch);
+
+    return true;
+  }
+
+  // a record's slots are array elements, see structCreate
+  if (callee->data.fn == _System_arrayGetIndex || callee->data.fn == _System_getSlot) {
+    return builtins_arrayGetIndex(rt, registers, operands, result);
+  }
+
+  if (callee->data.fn == _System_arraySetIndex || callee->data.fn == _System_setSlot) {
+    return builtins_arraySetIndex(rt, registers, operands, result);
+  }
+
+  if (callee->data.fn == _System_C_fmod) {
+    result->data.dbl = fmod(builtins_arg(rt, registers, operands, 0)->data.dbl, builtins_arg(rt, registers, operands, 1)->data.dbl);
+    VALUE_SET_META(result, TYPE_DOUBLE, FLAG_NONE);
+
+    return true;
+  }
+
+  if (callee->data.fn == _System_C_strlen) {
+    result->data.i64 = builtins_strlen(builtins_arg(rt, registers, operands, 0));
+    VALUE_SET_META(result, TYPE_INT, FLAG_NONE);
+
+    return true;
+  }
+
+  return false;
+}
+
+// an OP_CALL with CALL_FLAGS_OPERANDS or CALL_FLAGS_RESULT, once `callee`,
+// `operands` (NULL without CALL_FLAGS_OPERANDS) and `result` ($r[0]
+// without CALL_FLAGS_RESULT) are resolved. a result that goes anywhere
+// but a register is stored with its own reference, over what was there.
+static inline void builtins_callOperands(runtime_t *rt, instruction_t *ins, value_t *callee, value_t **operands, value_t *result) {
+  bool registers = (ins->flags & CALL_FLAGS_REGISTER_ARGS) != 0;
+  bool owning = (ins->flags & CALL_FLAGS_RESULT) && (ins->right.at & 0x3) != AT_REG;
+  value_t v;
+  value_t *out = owning ? &v : result;
+
+  VALUE_SET_META(&v, TYPE_NONE, FLAG_NONE);
+
+  if (!builtins_callDirect(rt, ins, callee, registers, operands, out)) {
+    args_t args = {
+      &rt->dt->storage[AT_LOCAL], registers ? &rt->dt->storage[AT_REG].data[1] : NULL, NULL, operands
+    };
+
+    *out = callee->data.fn(rt, &args);
+  }
+
+  if (owning) {
+    value_release(rt, result);
+    *result = v;
+  }
+}
+
+// builtins_callOperands for compiled code, which resolves the operands
+// without checks. a native that reads past the arguments it is passed
+// finds none there, as it would in the registers or on the stack.
+static inline void builtins_callResolved(runtime_t *rt, instruction_t *ins) {
+  value_t none, *operands[CALL_MAX_OPERANDS];
+
+  VALUE_SET_META(&none, TYPE_NONE, FLAG_NONE);
+
+  for (uint64_t i = 0; i < CALL_MAX_OPERANDS; i++) {
+    operands[i] = i < ins->imm.call.count ? CODE_OPERAND_VALUE(ins->imm.call.args[i]) : &none;
+  }
+
+  builtins_callOperands(rt, ins, CODE_OPERAND_VALUE(ins->left), (ins->flags & CALL_FLAGS_OPERANDS) ? operands : NULL,
+    (ins->flags & CALL_FLAGS_RESULT) ? CODE_OPERAND_VALUE(ins->right) : &rt->dt->storage[AT_REG].data[0]);
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include <vm/types.h>
+#include <vm/value.h>
+#include <vm/map.h>
+
+// bounded caches keyed by string contents, for memoizing: `cacheCreate
+// entries, bytes, weak` makes one that holds at most `entries` entries and
+// `bytes` bytes of keys and refcounted strings (0: no limit), past which
+// the entries used least lately go. eviction is CLOCK: an entry's bit is
+// set when it is read or written, and the hand goes round the slots,
+// clearing the bits it finds set, up to an entry whose bit is clear.
+//
+// a weak cache does not keep the heap objects it holds alive: heap_trace
+// passes over its values, and cache_sweep, at the end of the marking of
+// every collection, drops the entries whose object was not marked. other
+// values are held as a map holds them.
+#define CACHE_INITIAL_SLOTS 16
+#define CACHE_NO_SLOT UINT32_MAX
+
+typedef struct runtime runtime_t;
+
+typedef struct cache_slot {
+  const char *key; // the index's copy, see cache_put; NULL while free
+  size_t len;
+  value_t value;
+  size_t bytes; // counted against maxBytes
+  uint32_t next; // the next free slot, while free
+  bool referenced; // CLOCK's bit
+} cache_slot_t;
+
+typedef struct cache {
+  map_t *index; // each key's slot, as an int
+  cache_slot_t *slots;
+  size_t numSlots;
+  size_t size; // entries
+  size_t bytes;
+  size_t maxEntries; // 0: no limit
+  size_t maxBytes; // 0: no limit
+  size_t hand;
+  uint32_t free; // the first free slot, CACHE_NO_SLOT if none
+  bool weak;
+  uint64_t evictions; // entries evicted or, being weak, dropped
+  heap_t *heap; // the cache, its slots and index, see cache_create
+  heap_value_t *node; // the heap node holding it
+  struct cache *nextWeak; // in heap_t.weak
+} cache_t;
+
+// allocated through heap_allocBlock, from the heap holding `node`; a weak
+// cache is linked into the heap's, for cache_sweep
+cache_t *cache_create(heap_t *heap, heap_value_t *node, size_t maxEntries, size_t maxBytes, bool weak);
+void cache_destroy(cache_t *cache);
+// heap_mark on every value, unless the cache is weak
+void cache_mark(cache_t *cache, heap_t *heap);
+
+// a new heap node holding a cache_t, defined next to value_createMap
+value_t value_createCache(runtime_t *rt, heap_t *heap, size_t maxEntries, size_t maxBytes, bool weak);
+
+// a native_function_t used as the dtor_ptr on heap node
+void cache_destructor(runtime_t *rt, args_t *args);
+
+// the value stored for `key`, NULL if there is none
+value_t *cache_get(cache_t *cache, const char *key, size_t len);
+// stores a copy of `value` for `key`, evicting what it must. an entry
+// larger than maxBytes alone is not stored. false if out of memory.
+bool cache_put(runtime_t *rt, cache_t *cache, const char *key, size_t len, value_t *value);
+// false if there was no such key
+bool cache_remove(runtime_t *rt, cache_t *cache, const char *key, size_t len);
+
+// with the marking done and the heap locked, before the sweep: drops from
+// the heap's weak caches the entries whose object is dead. a minor
+// collection only marks the nursery, so only young objects can be.
+void cache_sweep(runtime_t *rt, heap_t *heap);
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include <vm/types.h>
+
+// vm --trace-calls: how many times each native function was called by
+// OP_CALL, and how long the calls took, in log-linear histograms (HDR
+// style): exact up to CALLS_LINEAR ns, then CALLS_SUB_BUCKETS buckets per
+// power of two, so any value is known to within 1/CALLS_SUB_BUCKETS.
+// per runtime, and not synchronized: calls come from the one interpreter
+// thread.
+#define CALLS_LINEAR 16
+#define CALLS_SUB_BITS 3
+#define CALLS_SUB_BUCKETS (1 << CALLS_SUB_BITS)
+#define CALLS_BUCKETS (CALLS_LINEAR + (64 - 4) * CALLS_SUB_BUCKETS)
+
+// open addressing by function; builtins and compiled regions together
+// stay far below it
+#define CALLS_MAX_FUNCTIONS 256
+
+typedef struct calls_function {
+  native_function_t fn; // NULL for an unused entry
+  uint64_t count;
+  uint64_t nanos;
+  uint64_t max;
+  uint32_t buckets[CALLS_BUCKETS];
+} calls_function_t;
+
+typedef struct calls {
+  calls_function_t functions[CALLS_MAX_FUNCTIONS];
+  uint64_t dropped; // calls of functions past CALLS_MAX_FUNCTIONS
+} calls_t;
+
+calls_t *calls_create(void);
+void calls_destroy(calls_t *calls);
+
+// a call of `fn` that took `nanos`
+void calls_record(calls_t *calls, native_function_t fn, uint64_t nanos);
+
+// the functions called, most time first, each with its count, total and
+// mean time, and the 50th, 90th and 99th percentiles and the maximum, as
+// a table or a JSON object. builtins go by the names bcparse gives them.
+void calls_write(const calls_t *calls, FILE *f, bool json);
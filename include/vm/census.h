@@ -0,0 +1,26 @@
+#pragma once
+
+#include <vm/runtime.h>
+
+#include <stdio.h>
+
+// the report of runtime_heapCensus, with the heap locked and no mutator
+// running: the nodes of both generations, grouped by what they are -- an
+// object by its shape (its member names), or as a dictionary once it left
+// shapes behind, an array by its element kind, a map, and the rest by
+// kind -- with the bytes each group takes and what it retains; how full
+// the objects' slots and member tables and the maps' entries are; the
+// refcounted buffers the heap and the roots hold, by the code that made
+// them (see rc_alloc); and the roots holding the most.
+//
+// what a node retains is itself, and the buffers and the nodes found
+// first from it, walking from the roots ($d, $l, $r and the fibers not
+// running) depth first. that is a spanning tree of the graph rather than
+// its dominators: a node two others reference is charged to the one
+// walked first. nodes not reached are garbage the collector has yet to
+// sweep. arena and scratch nodes are not in the heap's lists, and count
+// once reached only.
+//
+// with `graph`, it also gets the nodes reached and their references, as
+// a Graphviz digraph: a box for each root holding a node.
+void census_write(runtime_t *r, FILE *f, FILE *graph);
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include <vm/types.h>
+#include <vm/value.h>
+
+// channels: bounded queues of values between runtimes, e.g the ones tasks
+// run on (see task.h), which share no heap. `chanCreate n` makes one that
+// holds up to n values, rounded up to a power of two (two at least);
+// `chanSend ch, v` waits while it is full, `chanRecv ch` while it is
+// empty. a channel goes from one runtime to another as a task's argument
+// or result, or through another channel.
+//
+// the ring is Vyukov's bounded MPMC queue: each cell has a sequence number
+// saying whether it is the turn of a sender or a receiver, and which lap,
+// so any number of both claim cells with one CAS on their end's index, take
+// no lock, and only touch the cell they claimed.
+//
+// a value is moved into the ring as a copy that refers to nothing on the
+// sender's runtime: scalars, inline data, constants and shared buffers
+// (see rc.h) as they are, another refcounted buffer as a new one, which
+// the receiver takes over, and a channel as a reference. objects, arrays
+// and the like arrive as none.
+//
+// after `chanClose ch` sends fail, and receives return none once the
+// values sent before are taken. close from the sending side, after its
+// last send. a waiting thread yields CHANNEL_SPINS times, then sleeps on
+// the channel until a value moves, reaching runtime_safepoint between
+// waits. it blocks its thread: stages talking through channels need a
+// pool thread each (BB8_TASK_WORKERS), as a join that runs one of them
+// nested cannot go on until it returns.
+#define CHANNEL_SPINS 64
+#define CHANNEL_SLEEP_MS 1 // between safepoints, while sleeping
+#define CHANNEL_MAX_CAP ((size_t)1 << 20)
+
+typedef struct runtime runtime_t;
+
+typedef struct channel_cell {
+  atomic_size_t seq; // see channel_send
+  value_t value; // owns the buffer it refers to, if refcounted
+  struct channel *channel; // a channel sent through this one, referenced; `value` is none
+} channel_cell_t;
+
+typedef struct channel {
+  atomic_uint refs; // heap nodes on any runtime, and the cells holding it
+  channel_cell_t *cells;
+  size_t mask; // capacity - 1
+
+  // the two ends are written by different threads, a cache line apart
+  _Alignas(64) atomic_size_t sendPos;
+  _Alignas(64) atomic_size_t recvPos;
+
+  _Alignas(64) atomic_bool closed;
+  atomic_size_t moves; // values sent and received so far, see channel_wait
+  atomic_size_t sleepers;
+  pthread_mutex_t lock; // for sleeping on `cond`
+  pthread_cond_t cond;
+} channel_t;
+
+// holding up to `capacity` values, rounded up to a power of two, from 2
+// to CHANNEL_MAX_CAP; referenced once, by the caller
+channel_t *channel_create(size_t capacity);
+channel_t *channel_retain(channel_t *ch);
+// the last reference releases what is still in the ring
+void channel_release(channel_t *ch);
+
+// copies `v` into the ring, waiting while it is full. false if the channel
+// is closed.
+bool channel_send(runtime_t *rt, channel_t *ch, const value_t *v);
+// the oldest value in the ring, waiting while it is empty, onto the heap
+// of `rt`; a refcounted buffer is owned by `out`. false, and none, once the
+// channel is closed and empty.
+bool channel_recv(runtime_t *rt, channel_t *ch, value_t *out);
+void channel_close(channel_t *ch);
+
+// a new heap node for `ch`, taking over a reference the caller holds.
+// defined next to value_createObject, in value.c.
+value_t value_createChannel(runtime_t *rt, heap_t *heap, channel_t *ch);
+
+// a native_function_t used as the dtor_ptr on heap node
+void channel_destructor(runtime_t *rt, args_t *args);
@@ -0,0 +1,318 @@
+#pragma once
+
+#include <vm/obj_loc.h>
+#include <vm/datatable.h>
+#include <vm/shape.h>
+#include <vm/image.h>
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+typedef uint8_t ubyte_t;
+
+// decoder-internal opcodes, past the 5 bit bytecode range.
+// add..div decode to `CODE_OP_<op>_I64 + (flags & 0x7)`, in CMP_FLAG order,
+// so each operand type and immediate form gets its own handler.
+// cmp and the bitwise ops only get a separate immediate form.
+enum CODE_OPS {
+  CODE_OP_ADD_I64 = 32,
+  CODE_OP_ADD_F64_L,
+  CODE_OP_ADD_F64_R,
+  CODE_OP_ADD_F64_LR,
+  CODE_OP_ADD_I64_IMM,
+  CODE_OP_ADD_F64_L_IMM,
+  CODE_OP_ADD_F64_R_IMM,
+  CODE_OP_ADD_F64_LR_IMM,
+
+  CODE_OP_SUB_I64,
+  CODE_OP_SUB_F64_L,
+  CODE_OP_SUB_F64_R,
+  CODE_OP_SUB_F64_LR,
+  CODE_OP_SUB_I64_IMM,
+  CODE_OP_SUB_F64_L_IMM,
+  CODE_OP_SUB_F64_R_IMM,
+  CODE_OP_SUB_F64_LR_IMM,
+
+  CODE_OP_MUL_I64,
+  CODE_OP_MUL_F64_L,
+  CODE_OP_MUL_F64_R,
+  CODE_OP_MUL_F64_LR,
+  CODE_OP_MUL_I64_IMM,
+  CODE_OP_MUL_F64_L_IMM,
+  CODE_OP_MUL_F64_R_IMM,
+  CODE_OP_MUL_F64_LR_IMM,
+
+  CODE_OP_DIV_I64,
+  CODE_OP_DIV_F64_L,
+  CODE_OP_DIV_F64_R,
+  CODE_OP_DIV_F64_LR,
+  CODE_OP_DIV_I64_IMM,
+  CODE_OP_DIV_F64_L_IMM,
+  CODE_OP_DIV_F64_R_IMM,
+  CODE_OP_DIV_F64_LR_IMM,
+
+  CODE_OP_MOD_I64,
+  CODE_OP_MOD_I64_IMM,
+
+  CODE_OP_CMP_IMM,
+  CODE_OP_XOR_IMM,
+  CODE_OP_AND_IMM,
+  CODE_OP_OR_IMM,
+  CODE_OP_SHL_IMM,
+  CODE_OP_SHR_IMM,
+  // getfield / setfield: an OP_CALL of getObjectMember or setObjectMember
+  // with its object and key (and value) as operands, see code_decodeOne.
+  // a hit of the member cache runs in the handler; anything else as the call.
+  CODE_OP_GETFIELD,
+  CODE_OP_SETFIELD,
+  // an OP_MOV with MOV_FLAGS_SET or MOV_FLAGS_SELECT, its flags the
+  // JUMP_FLAGS condition. a negated select has its operands swapped, a
+  // negated setcc `imm.b` set.
+  CODE_OP_SETCC,
+  CODE_OP_SELECT,
+  // an OP_JMP with JUMP_FLAGS_TABLE: its cases in `imm.table`, its default
+  // the target
+  CODE_OP_SWITCH,
+  CODE_OP_SEGMENT, // the first instruction of a segment not decoded yet, see code_ensure
+
+  // quickened handlers, never an `opcode`: one of the generic handlers
+  // points `handler` at one of these the first time it runs, see
+  // interpreter_quicken. the _ABS forms have absolute operands (see
+  // CODE_OPERAND_ABSOLUTE), read through `base` alone.
+  CODE_OP_ADD_I64_ABS,
+  CODE_OP_ADD_I64_ABS_IMM,
+  CODE_OP_SUB_I64_ABS,
+  CODE_OP_SUB_I64_ABS_IMM,
+  CODE_OP_MUL_I64_ABS,
+  CODE_OP_MUL_I64_ABS_IMM,
+  CODE_OP_DIV_I64_ABS,
+  CODE_OP_DIV_I64_ABS_IMM,
+  CODE_OP_CMP_I64_ABS,
+  CODE_OP_CMP_I64_ABS_IMM,
+  CODE_OP_CMPJ_ABS,
+  CODE_OP_CMPJ_ABS_IMM,
+  CODE_OP_MOV_ABS, // to a register
+  // guarded on the values: a mov or loadi4 over, and of, values that own
+  // nothing, stored inline with no release or claim. on a mismatch the
+  // instruction goes back to its generic handler for good.
+  CODE_OP_MOV_SCALAR,
+  CODE_OP_LOAD_I64_SCALAR,
+  // not an `opcode` either, but decoded as the handler: an add or sub of
+  // an immediate to $sp, the stack's length, which the unchecked
+  // interpreter keeps in a register too, see INTERPRETER_SET_DEPTH
+  CODE_OP_STACK_IMM,
+
+  CODE_OP_COUNT
+};
+
+// an obj_loc_t resolved against the datatable at decode time.
+// the value lives at `base[*len - off]`. absolute operands point `base`
+// at the value itself and `len` at a constant zero, so only relative
+// (stack) operands depend on the current storage length.
+// an operand the instruction does not have is left zeroed (base == NULL).
+typedef struct operand {
+  value_t *base;
+  const uint64_t *len;
+  uint32_t off;
+  uint32_t cap; // `*len - off` must be below this to be in bounds
+  loc_28_t loc; // as encoded
+  archtype_t at;
+} operand_t;
+
+// an OP_CALL, or one decoded to a handler of its own
+#define CODE_IS_CALL(op) ((op) == OP_CALL || (op) == CODE_OP_GETFIELD || (op) == CODE_OP_SETFIELD)
+
+#define CODE_OPERAND_VALUE(o) (&(o).base[*(o).len - (o).off])
+
+// an absolute operand in range, whose value is at `base` itself
+#define CODE_OPERAND_ABSOLUTE(o) (((o).at & AT_ABS) == AT_ABS && (o).cap == 1)
+
+// the signed offset from VM_FRAME_POINTER of an AT_FRAME location,
+// resolved to `base` and `off` against it like a relative operand
+#define CODE_FRAME_SLOT(loc) ((int64_t)(((uint64_t)(loc) >> 1) ^ (0 - ((uint64_t)(loc) & 1))))
+
+// a jump whose target is the byte offset in `target.loc` (AT_CODE),
+// rather than the value of its target operand
+#define CODE_DIRECT_JUMP(ins) ((ins)->target.at == AT_CODE)
+
+
+// the last byte offset a jump site went to, and the instruction it resolved to
+typedef struct jump_cache {
+  uint64_t offset;
+  uint32_t index;
+} jump_cache_t;
+
+// inline cache of an OP_CALL to getObjectMember or setObjectMember: the
+// shape the object had and the member key, for the slot the member is
+// at. `next` is the shape afterwards -- `shape` itself unless the call
+// added the member. of a call to createFromTemplate, `shape` is that of
+// the objects it makes and `key` the template. see builtins_callDirect.
+typedef struct member_cache {
+  shape_t *shape; // NULL if nothing is cached
+  object_key_t key;
+  shape_t *next;
+  uint32_t slot;
+} member_cache_t;
+
+// the cases of a switch, in the order of the values from `low` on: the
+// byte offset each goes to, UINT32_MAX (the halt) if it is before the code.
+// `count` fits the u16 it is encoded as.
+typedef struct code_table {
+  int64_t low;
+  uint32_t count;
+  uint32_t offsets[];
+} code_table_t;
+
+// fixed-width instruction, built once at load time from the .bin byte stream
+typedef struct instruction {
+  uint8_t opcode; // OP_* or, after decoding, CODE_OP_*
+  uint8_t flags;
+  uint8_t handler; // what the interpreter dispatches on: `opcode`, or a quickened form of it
+  bool quickened; // the generic handler has run it, and quickened it if it could
+  uint32_t offset; // byte offset of this instruction in the bytecode
+
+  operand_t left;
+  operand_t right;
+  operand_t target; // jump target location
+
+  union {
+    int64_t i64;
+    uint64_t u64;
+    double dbl;
+    bool b;
+    struct {
+      const ubyte_t *data; // points into the bytecode buffer, or the constant pool
+      uint64_t size;
+    } raw;
+    struct {
+      operand_t *args; // of an OP_CALL with CALL_FLAGS_OPERANDS, owned by the code
+      uint64_t count;
+    } call;
+    code_table_t *table; // of a CODE_OP_SWITCH, owned by the code
+  } imm;
+
+  union {
+    jump_cache_t cache; // jumps
+    member_cache_t member; // calls
+  };
+  uint32_t hits; // backward jumps that reached this instruction, see jit_loop
+
+  // type feedback, see code_seen: what the left operand held when the
+  // instruction ran, and the right operand (the slot written, for push)
+  uint8_t seen[2];
+} instruction_t;
+
+// a value value_destroy would release or free
+#define CODE_VALUE_OWNED(v) \
+  (VALUE_HAS((v), TYPE_POINTER, FLAG_REFCOUNTED) || VALUE_HAS((v), TYPE_POINTER, FLAG_MALLOC))
+
+// set in a feedback byte for a pointer with FLAG_MALLOC or FLAG_REFCOUNTED
+#define CODE_SEEN_OWNED 0x80
+
+// `1 << type` of a value, or'd with CODE_SEEN_OWNED if it may own memory.
+// the unchecked interpreter accumulates these into instruction_t.seen for
+// the JIT; a site that never ran has seen nothing (0).
+static inline uint8_t code_seen(const value_t *v) {
+  uint32_t m = VALUE_META(v);
+
+  // FLAG_MALLOC and FLAG_REFCOUNTED are bits 11 and 12, moved down to bit 7
+  return (uint8_t)((1u << (m & 0x7)) | (((m >> 4) | (m >> 5)) & CODE_SEEN_OWNED));
+}
+
+#define CODE_INVALID_INDEX UINT32_MAX
+
+// an OP_CONST entry, copied into the pool with a terminating NUL
+// so it can be handed to natives as a C string
+typedef struct code_const {
+  const ubyte_t *data;
+  uint64_t size; // excluding the NUL
+} code_const_t;
+
+// a BIN_SECTION_SEGMENTS entry: its instructions are decoded the first
+// time one of them is needed. until then the first is a CODE_OP_SEGMENT,
+// and the rest are zeroed (and not yet backed by memory).
+typedef struct code_segment {
+  uint64_t offset; // of its first instruction
+  uint64_t end; // one past its last byte
+  uint32_t first; // index of its first instruction
+  uint32_t count;
+  bool loaded;
+  // its CONST_FLAGS_RAWDATA immediates, terminated as in the code's pool
+  ubyte_t *pool;
+  size_t poolSize;
+} code_segment_t;
+
+typedef struct code {
+  instruction_t *instructions;
+  size_t count; // includes the terminating halt
+  size_t len; // length of the source bytecode
+  // byte offset -> instruction index + 1, len + 1 entries. 0 where no
+  // instruction starts, or none is decoded yet; see code_indexAt.
+  uint32_t *offsetMap;
+
+  // the program decoded, which holds the image and outlives the code
+  const struct program *program;
+
+  // read-only constant pool, referenced by CONST_FLAGS_POOL loads and
+  // pushes: the program's BIN_SECTION_CONST entries, shared with it, then
+  // any OP_CONST in the code. those, and CONST_FLAGS_RAWDATA immediates,
+  // are copied into `pool` in order, so they are terminated too.
+  ubyte_t *pool;
+  size_t poolSize;
+  code_const_t *constants; // the program's, if there is no OP_CONST
+  uint32_t numConstants;
+
+  // the image's label slots, stored before the code runs (see program_load).
+  // a flat stream has none: its labels are u64 loads at the beginning.
+  const bin_label_t *labels; // the program's
+  size_t numLabels;
+
+  uint64_t storageCount[4]; // slots in each storage of the datatable decoded against
+
+  // with segments, what they are decoded from: the image's code, and the
+  // datatable operands are resolved against. neither may go away first.
+  code_segment_t *segments;
+  size_t numSegments;
+  const ubyte_t *bc;
+  bool compact;
+  datatable_t *dt;
+} code_t;
+
+// number of slots in the storage `at` refers to
+static inline uint64_t code_storageCount(const code_t *code, archtype_t at) {
+  return code->storageCount[at & 0x3];
+}
+
+// decodes the code section of the program's image, resolving operands
+// against the storages of `dt`. the program must outlive the returned
+// code_t, as raw data immediates point into it. with BIN_SECTION_SEGMENTS, only the
+// tables are set up here, and each segment is decoded on first use.
+// CONST_FLAGS_RAWDATA immediates point into the pool, and
+// CONST_FLAGS_POOL immediates are resolved to their pool entry, or to
+// NULL / 0 if the index is out of range.
+code_t *code_decode(datatable_t *dt, const struct program *program);
+void code_destroy(code_t *code);
+
+// maps a byte offset (e.g a label value from static data) to an instruction index.
+// offsets past the end, or not on an instruction boundary, map to the terminating halt.
+uint32_t code_indexOf(code_t *code, uint64_t offset);
+// as code_indexOf, but CODE_INVALID_INDEX for those offsets.
+// both decode the segment holding `offset` if it is not yet.
+uint32_t code_indexAt(code_t *code, uint64_t offset);
+// without decoding: CODE_INVALID_INDEX too if the segment is not decoded
+static inline uint32_t code_decodedIndexAt(const code_t *code, uint64_t offset) {
+  // 0, for none, wraps around to CODE_INVALID_INDEX
+  return offset <= code->len ? code->offsetMap[offset] - 1 : CODE_INVALID_INDEX;
+}
+
+// decodes the segments holding instructions [first, end) that are not
+// yet, so they can be read directly. does nothing without segments.
+void code_ensure(code_t *code, uint32_t first, uint32_t end);
+
+// a position in the pool for `data`, a raw data immediate or constant,
+// that code_poolData maps back to it -- in this process or, for the same
+// image, another one. false if `data` is not in the pool.
+bool code_poolOffset(const code_t *code, const ubyte_t *data, uint64_t *offset);
+// NULL if `offset` is past the pool
+const ubyte_t *code_poolData(code_t *code, uint64_t offset);
@@ -2,6 +2,7 @@
 
 #include <vm/value.h>
 #include <vm/obj_loc.h>
+#include <shared/config.h>
 
 #include <stdint.h>
 
@@ -11,26 +12,61 @@
 #define DEFAULT_STACK_SIZE_MB 20 // in MB
 #define STACK_SIZE_BYTES (MB_TO_BYTES(DEFAULT_STACK_SIZE_MB) - (MB_TO_BYTES(DEFAULT_STACK_SIZE_MB) % sizeof(value_t)))
 
+// number of value_t slots in each storage. $d and $l default to these,
+// see datatable_create.
+#define VM_DATA_COUNT 32
+#define STATIC_DATA_COUNT (STATIC_DATA_SIZE_BYTES / sizeof(value_t))
+#define STACK_COUNT (STACK_SIZE_BYTES / sizeof(value_t))
+
+#define STATIC_DATA_RESERVED 256 // initial $d length, slots for builtin functions
+#define DATATABLE_KEEP_BYTES (256 * 1024) // of $d and of $l, see datatable_reset
+
 #define VM_DATA(datatable, index) (datatable->storage[AT_VM].data[index])
 #define VM_PROGRAM_COUNTER(datatable) (VM_DATA(datatable, 0).data.u64)
 #define VM_DATA_POINTER(datatable) (VM_DATA(datatable, 1 + AT_VM).data.u64)
 #define VM_STATIC_DATA_POINTER(datatable) (VM_DATA(datatable, 1 + AT_DATA).data.u64)
 #define VM_STACK_POINTER(datatable) (VM_DATA(datatable, 1 + AT_LOCAL).data.u64)
 #define VM_REG_POINTER(datatable) (VM_DATA(datatable, 1 + AT_REG).data.u64)
-
-#define NUM_REGISTERS 4
+// stack length on entry to the running function, after OP_FCALL pushed
+// its return offset and the caller's frame pointer. 0 outside of one.
+#define VM_FRAME_POINTER_SLOT 5
+#define VM_FRAME_POINTER(datatable) (VM_DATA(datatable, VM_FRAME_POINTER_SLOT).data.u64)
 
 typedef struct storage {
   value_t *data;
   uint64_t *lenVal;
+  uint64_t count; // slots in `data`
 } storage_t;
 
 typedef struct datatable {
   storage_t storage[4];
 } datatable_t;
 
-datatable_t *datatable_create();
+// $d and $l are reserved with `staticDataCount` and `stackCount` slots.
+// where mmap is available, pages are only backed (zeroed) once touched,
+// so a large reservation costs nothing until it is used, and a guard page
+// after each faults instead of running into other memory. the buffers
+// never move, see code_decode.
+datatable_t *datatable_create(size_t staticDataCount, size_t stackCount);
 void datatable_destroy(runtime_t *rt, datatable_t *dt);
-void datatable_markTable(storage_t *s);
-void datatable_mark(datatable_t *dt);
+// releases every value as datatable_destroy does, and leaves the storages
+// as datatable_create did, at the same addresses. the cost follows the
+// pages of $d and $l touched since they were created, see datatable_clear;
+// up to DATATABLE_KEEP_BYTES of each stay backed, for the next run.
+void datatable_reset(runtime_t *rt, datatable_t *dt);
+// bytes of storage `at` backed by memory. for mapped $d and $l these are
+// the pages touched so far, which are never given back, so it is their peak.
+size_t datatable_residentBytes(const datatable_t *dt, archtype_t at);
+// asks for transparent huge pages behind $d and $l, which are large enough
+// that walking them otherwise costs a TLB miss every 4 KB. the pages are
+// still only faulted in as touched, 2 MB at a time; false where the
+// system has no such pages.
+bool datatable_useHugePages(datatable_t *dt);
+// pushes the objects referenced from the first `len` slots of `s` onto the
+// mark stack; the program keeps running afterwards, so nothing is
+// modified but the marks
+void datatable_markTable(storage_t *s, size_t len, heap_t *heap);
+// marks everything reachable from the roots for heap_sweep: $d and $l up
+// to their lengths, and every register
+void datatable_mark(datatable_t *dt, heap_t *heap);
 value_t *datatable_getValue(datatable_t *dt, loc_28_t loc, archtype_t at);
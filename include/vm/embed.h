@@ -0,0 +1,66 @@
+#pragma once
+
+#include <vm/runtime.h>
+#include <vm/interpreter.h>
+#include <vm/program.h>
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+// the vm as a library: a program loaded once with program_create, run on
+// any number of instances, each a runtime with its builtins, its collector
+// thread and an interpreter of the program. an instance is used from the
+// thread that created it, which stays attached to its runtime (see
+// runtime_attach) until embed_destroy; instances on different threads run
+// side by side.
+//
+// an entry point is a label, @exported so that it is kept, whose code takes its arguments in $r[1] ..
+// $r[n], leaves its result in $r[0] and ends in a halt, as a task body
+// does (see vm/task.h). OP_HALT returns to the host rather than exiting.
+//
+// a program compiled with bcparse --extension needs the modules loaded,
+// with extension_load, before program_create.
+//
+//   program_t *program = program_create(data, len, &error);
+//   embed_t *e = embed_create(program);
+//   uint64_t sum;
+//   value_t args[2] = { value_fromInt(1), value_fromInt(2) };
+//
+//   embed_register(e, 0, myFunction); // `call #{host0}` in the program
+//   embed_entry(program, "sum", &sum); // `@export sum` in the program
+//   value_t result = embed_call(e, sum, args, 2);
+typedef struct embed {
+  runtime_t *rt;
+  interpreter_t *it;
+  pthread_t gcThread;
+} embed_t;
+
+// an instance of `program`, taking a reference to it. its prints go to
+// stdout, as rt->output says.
+embed_t *embed_create(program_t *program);
+// stops the collector, and frees the instance and its runtime
+void embed_destroy(embed_t *e);
+// as if the instance were new, see interpreter_reset, keeping the
+// decoded and compiled code and the host functions
+void embed_reset(embed_t *e);
+
+// binds host function `index`, below BUILTIN_HOST_COUNT, to `fn`: the
+// program calls it as #{host<index>}, like a builtin, and so do the tasks
+// it spawns from then on. false for an index out of range.
+bool embed_register(embed_t *e, uint32_t index, native_function_t fn);
+
+// the code offset of the label `name`: one the program @exports, or any
+// label of a program compiled with bcparse -g (BIN_SECTION_DEBUG). false
+// if there is no such label.
+bool embed_entry(const program_t *program, const char *name, uint64_t *offset);
+
+// runs the program from its start, as the vm does, after any calls
+void embed_run(embed_t *e);
+// runs the entry point at `offset` on the `count` arguments, at most
+// NUM_REGISTERS - 1, and returns its $r[0]. registers own nothing, so
+// the arguments and the result are borrowed: a refcounted argument must
+// be held by the caller for the call, and the result is valid until the
+// next call or reset. the stack is emptied before and after.
+value_t embed_call(embed_t *e, uint64_t offset, const value_t *args, size_t count);
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// vm --trace-gc: a timeline of allocations and collections, written as
+// Chrome trace events (chrome://tracing, Perfetto). every thread records
+// into a ring of its own, which only it writes, so recording takes no
+// lock; a full ring drops its oldest events. the rings are read by
+// events_write, once the threads are done or the process exits.
+#define EVENTS_RING_SIZE (1 << 18) // events per thread, a power of two
+
+// allocations are written as a count per thread for each window this long
+#define EVENTS_WINDOW_NS 100000
+
+typedef enum events_kind {
+  EVENTS_ALLOC, // heap_alloc
+  EVENTS_RC_ALLOC, // rc_alloc, `value` bytes
+  EVENTS_GC_WAIT, // from a collection being requested until the mutators stopped
+  EVENTS_GC_MARK, // `value` 1 for a full collection, 0 for a minor one
+  EVENTS_GC_MARK_STEP, // `value` roots pushed, or at most that many nodes traced, see runtime_setGcBudget
+  EVENTS_GC_SWEEP, // `value` nodes found dead
+  EVENTS_GC_FINALIZE, // `value` nodes destroyed
+  EVENTS_GC_COMPACT // `value` objects moved, see heap_compact
+} events_kind_t;
+
+typedef struct events_event {
+  uint64_t start; // CLOCK_MONOTONIC, ns
+  uint64_t nanos; // 0 for an instant
+  uint64_t value;
+  events_kind_t kind;
+} events_event_t;
+
+// set by events_start, before the threads to be traced are
+extern bool events_enabled;
+
+// turns recording on, process-wide
+void events_start(void);
+
+// on the calling thread, which checked events_enabled first; its ring is
+// made with the first one
+void events_record(events_kind_t kind, uint64_t start, uint64_t nanos, uint64_t value);
+// the same, an instant now
+void events_instant(events_kind_t kind, uint64_t value);
+// how the calling thread is shown, instead of its number; `name` must
+// outlive events_write
+void events_nameThread(const char *name);
+
+// every thread's events to `path` as a JSON trace. false, after printing
+// why, if it cannot be written.
+bool events_write(const char *path);
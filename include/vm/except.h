@@ -3,6 +3,8 @@
 #include <vm/object.h>
 #include <vm/value.h>
 
+// what runtime_throwException throws: `argument` is what the handler finds
+// in $r[0], taken over from the code that throws it, as a call's result is
 typedef struct {
   object_t *base;
   value_t argument;
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include <vm/types.h>
+#include <shared/extension.h>
+
+// the extension modules of the process (see shared/extension.h), which
+// program_create resolves the imports of a program from. loaded once,
+// before the programs that import from them, and never unloaded: their
+// functions are in the static data of the runtimes running those.
+
+// loads the module at `path` and registers its functions under its name.
+// loading it again does nothing. false, with `*error` set, if it cannot
+// be loaded, is not an extension of BB8_EXTENSION_VERSION or has the
+// name of another one.
+bool extension_load(const char *path, const char **error);
+
+// the function `name` of the module `module`, each `*Len` bytes, and its
+// signature in `*signature`; NULL if no loaded module has it
+native_function_t extension_find(const char *module, size_t moduleLen, const char *name, size_t nameLen,
+  const char **signature);
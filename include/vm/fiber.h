@@ -0,0 +1,90 @@
+#pragma once
+
+#include <vm/value.h>
+#include <vm/heap.h>
+#include <vm/datatable.h>
+#include <shared/config.h>
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// green threads of one runtime, see OP_SPAWN, OP_YIELD and OP_JOIN. the
+// fibers take turns on the interpreter's thread, switching only at those
+// instructions, and the scheduler is the interpreter itself: a yield or a
+// join that waits goes on with the fiber at the front of the run queue.
+//
+// decoded operands and compiled code point into the one datatable, so the
+// running fiber's stack and registers are always the ones there. the others
+// keep theirs in a segment of their own, sized to what they hold, and a
+// switch moves the two fibers' values out and in.
+// the fiber the program starts on is the main fiber, FIBERS_MAIN.
+#define FIBERS_MAIN 0
+
+typedef enum {
+  FIBER_RUNNABLE = 0, // running, or in the run queue
+  FIBER_WAITING = 1, // in the waiters of the fiber it joins
+  FIBER_DONE = 2, // `result` is set, until the fiber is joined
+  FIBER_IO = 3 // parked on the socket in `io`, see vm/net.h
+} fiber_state_t;
+
+typedef struct fiber {
+  int64_t id;
+  fiber_state_t state;
+
+  // while it is not running: where it goes on, and its compare flags
+  uint64_t pc;
+  uint8_t flags;
+
+  value_t regs[NUM_REGISTERS];
+  value_t *stack; // $l[0] .. $l[stackLen - 1]
+  size_t stackLen;
+  size_t stackCap;
+  uint64_t framePointer; // VM_FRAME_POINTER into `stack`
+
+  value_t result; // its $r[0] when it ended; not claimed, as registers are not
+  value_t io; // the socket it is parked on, while FIBER_IO; not claimed either
+
+  struct fiber *waiters; // waiting for it to end
+  struct fiber *next; // in the run queue, or in the waiters of the one it joins
+} fiber_t;
+
+typedef struct fibers {
+  fiber_t **all; // by id; NULL once joined
+  size_t count;
+  size_t cap;
+  size_t live; // fibers not joined yet, the running one included
+
+  fiber_t *current;
+  fiber_t *head; // the run queue, without `current`
+  fiber_t *tail;
+} fibers_t;
+
+// with the main fiber running
+fibers_t *fibers_create();
+// releases what the fibers that are not running hold; the running one's
+// stack is in the datatable, which releases it
+void fibers_destroy(runtime_t *rt, fibers_t *fibers);
+
+// a new fiber at the back of the run queue, to start at `pc` with a copy
+// of `regs` and an empty stack
+fiber_t *fibers_spawn(fibers_t *fibers, const value_t *regs, uint64_t pc);
+// NULL if there is no such fiber, or it was joined already
+fiber_t *fibers_get(fibers_t *fibers, int64_t id);
+// drops a fiber that is done, once its result is taken
+void fibers_free(fibers_t *fibers, fiber_t *fiber);
+
+void fibers_enqueue(fibers_t *fibers, fiber_t *fiber);
+// takes the fiber at the front of the run queue, NULL if it is empty
+fiber_t *fibers_dequeue(fibers_t *fibers);
+
+// moves the running fiber's stack and registers out of `dt`, to go on at
+// `pc` later, and `next`'s in. `next` becomes the current fiber.
+void fibers_switch(fibers_t *fibers, datatable_t *dt, fiber_t *next, uint64_t pc, uint8_t flags);
+// the running fiber has ended: releases its stack in `dt`, keeps its $r[0]
+// as the result, and moves the fibers waiting for it to the run queue
+void fibers_finish(runtime_t *rt, fibers_t *fibers, datatable_t *dt);
+
+// marks what the fibers that are not running hold, for a collection: the
+// datatable has the running one's
+void fibers_mark(fibers_t *fibers, heap_t *heap);
@@ -2,15 +2,33 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <stdbool.h>
+#include <pthread.h>
 
 #include <vm/types.h>
+#include <vm/slab.h>
+#include <vm/shape.h>
 
 typedef struct heap_value {
   void *ptr;
   native_function_t dtor_ptr;
   uint8_t flags;
+  uint8_t kind; // what `ptr` is, a HEAP_KIND; see heap_mark
+  uint8_t arena; // the depth of the @arena holding it, 0 in the heap, see vm/arena.h
 } heap_value_t;
 
+typedef enum {
+  HEAP_KIND_OBJECT = 0, // object_t
+  HEAP_KIND_ARRAY = 1, // array_t
+  HEAP_KIND_MAP = 2, // map_t
+  HEAP_KIND_STREAM = 3, // stream_t
+  HEAP_KIND_AIO = 4, // aio_request_t
+  HEAP_KIND_TASK = 5, // task_t
+  HEAP_KIND_CHANNEL = 6, // channel_t
+  HEAP_KIND_CACHE = 7, // cache_t
+  HEAP_KIND_SOCKET = 8 // net_socket_t
+} HEAP_KIND;
+
 struct heap_node;
 typedef struct heap_node heap_node_t;
 
@@ -20,19 +38,226 @@ struct heap_node {
   heap_node_t *next;
 };
 
-heap_node_t *heap_node_create();
-void heap_node_destroy(runtime_t *rt, heap_node_t *node);
+// blocks above SLAB_MAX_SIZE, up to HEAP_POOL_MAX_SIZE -- grown member
+// tables, object slots and array storage -- come from malloc in
+// power-of-two classes, and are recycled rather than freed: a freed one
+// goes onto the thread's buffer, as slab blocks do, up to twice
+// HEAP_POOL_BATCH of a class, and past that, or on heap_flush, onto the
+// heap's own list, which keeps up to HEAP_POOL_HELD and refills the
+// buffers HEAP_POOL_BATCH at a time. so a rehash, or a sweep on the
+// collector thread, feeds the next allocation of that class. heap_compact
+// frees what the heap's lists hold.
+#define HEAP_POOL_CLASSES 5 // 512 bytes to 8 KB
+#define HEAP_POOL_MAX_SIZE ((size_t)SLAB_MAX_SIZE << HEAP_POOL_CLASSES)
+#define HEAP_POOL_BATCH 8
+#define HEAP_POOL_HELD 64
 
+// the heap has two generations, both linked lists of nodes, newest first.
+// new nodes go into the nursery (`young`); a minor collection marks from
+// the roots and the remembered set only, never tracing into old nodes,
+// and sweeps just the nursery. survivors are promoted by splicing them
+// onto the old list, so its cost follows the nursery, not the heap.
+// nodes do not move: values point at their heap_value_t directly. what
+// an object node points to may, see heap_compact.
 typedef struct heap {
-  heap_node_t *head;
-  size_t size;
+  heap_node_t *head; // old nodes
+  heap_node_t *young; // the nursery
+  size_t size; // nodes in both lists, see heap_flush
+  size_t youngSize; // of those, in the nursery
+  slab_allocator_t slab; // the objects nodes hold
+  slab_allocator_t nodes; // apart, as they never move
+  pthread_mutex_t lock; // recursive; guards everything in here
+
+  heap_value_t **markStack; // marked nodes whose references are not traced yet, see heap_mark
+  size_t markLen;
+  size_t markSize;
+  bool minor; // marking for a minor collection, see heap_markRemembered
+  bool marking; // marking incrementally, see heap_markBegin
+  heap_value_t *markArray; // an array heap_markStep traces in chunks, NULL if none
+  size_t markArrayAt; // the index it goes on from
+  struct heap_markers *markers; // helpers for heap_markDrain, NULL until it needs them
+  bool escaping; // heap_mark lowers arena depths instead, see heap_escapeBegin
+  uint8_t escapeDepth; // to this one
+  size_t escapeBase; // the mark stack's length when it began
+
+  heap_value_t **remembered; // old objects that may reference young ones
+  size_t rememberedLen;
+  size_t rememberedSize;
+
+  void *pool[HEAP_POOL_CLASSES]; // blocks of each pool class, linked through their first word
+  uint32_t numPooled[HEAP_POOL_CLASSES];
+
+  shape_t *shapes; // root of the shapes of this heap's objects, see object_put
+  struct cache *weak; // the weak caches, linked through nextWeak, see cache_sweep
+
+  heap_node_t *sweeping; // the newest old node heap_sweepStep has yet to sweep, NULL if none
+  heap_node_t *sweepingYoung; // the same, in the nursery
+  heap_node_t *dead; // unlinked by a sweep, not finalized yet; chained through `prev`
+  size_t deadSize;
+
+  size_t allocated; // nodes ever linked in, see heap_flush
+  size_t finalized; // nodes ever destroyed by heap_finalize
 } heap_t;
 
+// allocation is thread-local: each thread takes blocks from the slab in
+// batches of HEAP_TLAB_BATCH into its own buffer, and links the nodes it
+// allocates into a private list, so heap_alloc only locks the heap once
+// per batch. a thread's nodes are linked into the heap (and become
+// visible to heap_sweep) when the batch is refilled, or on heap_flush.
+// a thread buffers for one heap at a time; allocating from another heap
+// flushes it first.
+#define HEAP_TLAB_BATCH 32
+
+// sweeping only unlinks dead nodes onto `dead`; heap_finalize runs their
+// destructors and frees them afterwards, taking HEAP_FINALIZE_BATCH nodes
+// per lock. a destructor only touches its own node's memory, so this can
+// run while the mutators do, e.g on the collector thread after a pause.
+#define HEAP_FINALIZE_BATCH 256
+
+// heap_markStep traces an array of more values than HEAP_MARK_CHUNK a
+// chunk of that many at a time, so one slice does not trace a large one
+// whole.
+#define HEAP_MARK_CHUNK 256
+
+// heap_sweepStep sweeps the old generation HEAP_SWEEP_BATCH nodes per
+// lock, so the mutators can allocate and go through the write barrier
+// meanwhile.
+#define HEAP_SWEEP_BATCH 1024
+
+// a full collection compacts the heap once at least
+// HEAP_COMPACT_FREE_PERCENT of its object slabs' bytes are free, and it
+// has HEAP_COMPACT_MIN_SLABS of them or more. the objects in the slabs
+// less than half used, with their slots and member tables, move out into
+// new slabs, oldest first, and their nodes are pointed at them; the slabs
+// left empty go back to the system. arrays, maps and the rest stay where
+// they are, and keep their slabs.
+#define HEAP_COMPACT_FREE_PERCENT 50
+#define HEAP_COMPACT_MIN_SLABS 16
+
+// heap_markDrain traces a heap of HEAP_MARK_PARALLEL_MIN nodes or more on
+// several threads: the calling one, and helpers the heap starts the first
+// time, BB8_GC_MARKERS in all (the online cpus, up to HEAP_MAX_MARKERS, by
+// default). each has a mark stack of its own; one that has more than
+// HEAP_MARK_SHARE entries while others ran dry gives up the bottom half,
+// nearest the roots, for them to steal. marks are set atomically, so each
+// node is traced by one of them only. the drain ends once they are all out
+// of work.
+#define HEAP_MARK_PARALLEL_MIN 32768
+#define HEAP_MAX_MARKERS 8
+#define HEAP_MARK_SHARE 64
+
+heap_node_t *heap_node_create(heap_t *heap);
+void heap_node_destroy(runtime_t *rt, heap_t *heap, heap_node_t *node);
+
 heap_t *heap_create();
 void heap_destroy(runtime_t *rt, heap_t *heap);
+// what the heap's slabs are charged to from now on, see vm/quota.h
+void heap_setQuota(heap_t *heap, quota_t *quota);
 
 heap_value_t *heap_alloc(runtime_t *rt, heap_t *heap);
+
+// marking, with the heap locked: heap_mark sets FLAG_MARKED on the node
+// `value` points to, if it is an object not marked yet, and pushes it on
+// the mark stack. heap_markDrain then traces the stack until it is empty,
+// marking whatever the objects on it reference, so deep object graphs
+// need no recursion. neither writes to anything but the marks.
+void heap_mark(heap_t *heap, value_t *value);
+void heap_markDrain(heap_t *heap);
+// queues every node not marked in both generations for heap_finalize, and
+// clears the marks on the rest, promoting the nursery's. heap_sweep,
+// heap_sweepBegin and heap_sweepYoung first drop the weak cache entries
+// of objects that are dead, see cache_sweep.
 void heap_sweep(runtime_t *rt, heap_t *heap);
 
-void heap_lock();
-void heap_unlock();
+// incremental marking, for a full collection in slices that the mutators
+// run between: heap_markBegin, with the heap locked, starts it. from then
+// on heap_markDrain leaves what heap_mark pushes for heap_markStep to
+// trace, `count` nodes (or array chunks) at a time, with the heap locked;
+// it returns false once the stack is empty, with nothing traced for a
+// `count` of 0. meanwhile new nodes are allocated marked, into
+// the old generation (they are not collected before the next full
+// collection), and
+// heap_writeBarrier marks whatever is stored, so an object already traced
+// never holds one that is not marked. roots are not behind the barrier:
+// heap_markEnd goes back to draining at once, for the roots to be marked
+// again and the stack drained before the sweep.
+void heap_markBegin(heap_t *heap);
+bool heap_markStep(heap_t *heap, size_t count);
+void heap_markEnd(heap_t *heap);
+// heap_writeBarrier's part for incremental marking, alone, for the values
+// a new object is made with: heap_mark on `value`, while marking
+void heap_shade(heap_t *heap, value_t *value);
+// heap_sweep in two parts, for an incremental collection: heap_sweepBegin
+// drops the dead objects from the remembered set, and leaves both
+// generations to heap_sweepStep, which sweeps `count` of their nodes per
+// call, with the heap locked, and returns false once they are all swept.
+// the mutators may run in between. the nursery is not promoted, only
+// rid of its dead. the nodes not swept yet are still marked, so the heap
+// is swept to the end before it is marked again.
+void heap_sweepBegin(runtime_t *rt, heap_t *heap);
+bool heap_sweepStep(runtime_t *rt, heap_t *heap, size_t count);
+// escapes out of @arena scopes (see vm/arena.h), with the heap locked:
+// between heap_escapeBegin and heap_escapeEnd, heap_mark sets the arena
+// depth of the node `value` points to, and of the arena nodes it
+// references in turn, to `depth`, where it is deeper. nothing is marked,
+// and no node of that depth or a lower one is traced: what the heap
+// references escaped when it was stored. the mark stack is only pushed
+// on above what incremental marking left on it.
+void heap_escapeBegin(heap_t *heap, uint8_t depth);
+void heap_escapeEnd(heap_t *heap);
+// links a node of an arena that escaped to the heap into the nursery,
+// with the heap locked
+void heap_adopt(heap_t *heap, heap_node_t *node);
+// destroys every node, without marking: for a heap nothing refers to
+// any more, e.g after datatable_reset (see runtime_reset). the slabs are
+// kept, their blocks back on the free lists.
+void heap_clear(runtime_t *rt, heap_t *heap);
+// in the child of a fork taken with no collection running: the parallel
+// marking helpers were not carried over, so they are forgotten, to be
+// started again when a drain needs them
+void heap_afterFork(heap_t *heap);
+// destroys the queued dead nodes, in batches. called without the lock, or
+// with it held by the calling thread.
+void heap_finalize(runtime_t *rt, heap_t *heap);
+
+// whether heap_compact would move anything, with the heap locked: it is
+// fragmented past HEAP_COMPACT_FREE_PERCENT, with the finalized nodes'
+// blocks back in the slabs
+bool heap_shouldCompact(heap_t *heap);
+// with the heap locked, after a full sweep and heap_finalize, and no
+// thread but the caller's with blocks buffered (see heap_flush): moves the
+// objects out of the sparse slabs, and frees those left empty. returns
+// the number of objects moved.
+size_t heap_compact(heap_t *heap);
+// for heap_compact, see object_relocate: `ptr`, a block of `size`, copied
+// into a new slab and freed, if its slab is being evacuated. otherwise, or
+// out of memory, `ptr` itself.
+void *heap_relocateBlock(heap_t *heap, void *ptr, size_t size);
+
+// starts marking for a minor collection: heap_mark leaves old nodes out,
+// and the members of every remembered object are pushed as roots
+void heap_markRemembered(heap_t *heap);
+// ends a minor collection: queues the nursery nodes not marked for
+// heap_finalize, promotes the rest and empties the remembered set
+void heap_sweepYoung(runtime_t *rt, heap_t *heap);
+
+// called after `value` is stored into the object at `owner`; an old
+// object that now references a young one goes into the remembered set.
+// while marking incrementally, `value` is marked too, see heap_markBegin.
+// a node of a deeper arena than `owner` escapes to its depth, see
+// heap_escapeBegin.
+void heap_writeBarrier(heap_t *heap, heap_value_t *owner, value_t *value);
+
+// slab blocks for what a heap value points to (objects, member tables),
+// through the calling thread's buffer; larger ones from the pool, see
+// HEAP_POOL_CLASSES, or past it from malloc, charged to the slabs' quota
+void *heap_allocBlock(heap_t *heap, size_t size);
+void heap_freeBlock(heap_t *heap, void *ptr, size_t size);
+
+// links the calling thread's nodes into `heap` and returns its unused
+// blocks. a thread that allocated from a heap calls this before another
+// thread sweeps or destroys it, e.g when it stops running the runtime.
+void heap_flush(heap_t *heap);
+
+void heap_lock(heap_t *heap);
+void heap_unlock(heap_t *heap);
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <shared/bin_format.h>
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+typedef uint8_t ubyte_t;
+
+// the sections of a loaded .bin, see shared/bin_format.h. they all point
+// into the file's bytes, which are borrowed, but for compressed code,
+// which is decompressed into `codeBuffer`. a flat stream is all code.
+// table entries may be unaligned, so they are copied out with memcpy.
+typedef struct image {
+  const ubyte_t *file;
+  size_t fileLen;
+
+  const ubyte_t *code;
+  size_t codeLen;
+  bool compact; // BIN_CODE_COMPACT is set on the code; never for a flat stream
+  ubyte_t *codeBuffer; // owned, `code` if it was BIN_CODE_LZ4; otherwise NULL
+  const ubyte_t *constants; // BIN_SECTION_CONST, `constantsLen` bytes
+  size_t constantsLen;
+  bool constantsInPlace; // BIN_CONST_IN_PLACE is set on it
+  const ubyte_t *data; // `numData` bin_data_t
+  size_t numData;
+  const ubyte_t *labels; // `numLabels` bin_label_t
+  size_t numLabels;
+  const ubyte_t *debug; // BIN_SECTION_DEBUG, if there is one
+  size_t debugLen;
+  const ubyte_t *segments; // `numSegments` bin_segment_t, if there are any
+  size_t numSegments;
+  const ubyte_t *sites; // `numSites` bin_site_t, if there are any
+  size_t numSites;
+  const ubyte_t *lines; // BIN_SECTION_LINES, if there is one
+  size_t linesLen;
+  const ubyte_t *symbols; // BIN_SECTION_SYMBOLS, if there is one
+  size_t symbolsLen;
+  const ubyte_t *imports; // BIN_SECTION_IMPORTS, if there is one
+  size_t importsLen;
+  const ubyte_t *tries; // `numTries` bin_try_t, if there are any
+  size_t numTries;
+} image_t;
+
+// splits `len` bytes of `file` into sections, decompressing the code if
+// it is compressed. returns false, with `*error` set to the reason, for a
+// container of another version, whose sections run past the end of the
+// file or whose code does not decompress.
+bool image_open(const ubyte_t *file, size_t len, image_t *out, const char **error);
+// frees the decompressed code, if any
+void image_close(image_t *image);
+
+// the i'th entry of the DATA, LABELS, SEGMENTS, SITES or TRIES table
+bin_data_t image_data(const image_t *image, size_t i);
+bin_label_t image_label(const image_t *image, size_t i);
+bin_segment_t image_segment(const image_t *image, size_t i);
+bin_site_t image_site(const image_t *image, size_t i);
+bin_try_t image_try(const image_t *image, size_t i);
+// the innermost try region the instruction ending at `offset` is in --
+// as a return offset or VM_PROGRAM_COUNTER during a call, is where the
+// call is -- into `*out`. false if there is none.
+bool image_findTry(const image_t *image, uint64_t offset, bin_try_t *out);
+// the entry of BIN_SECTION_DEBUG at `*pos`, which starts at 0, moving
+// `*pos` to the next: a label's code offset, and its name, `*nameLen`
+// bytes with no NUL. false past the last one, or without the section.
+bool image_debugLabel(const image_t *image, size_t *pos, uint64_t *offset, const char **name, uint32_t *nameLen);
+// the same for BIN_SECTION_SYMBOLS: the entry, and its name,
+// `entry->nameLength` bytes with no NUL
+bool image_symbol(const image_t *image, size_t *pos, bin_symbol_t *entry, const char **name);
+// the same for BIN_SECTION_IMPORTS: the entry, and the names of the
+// module and the function and its signature, of the lengths it says
+bool image_import(const image_t *image, size_t *pos, bin_import_t *entry, const char **module, const char **name,
+  const char **signature);
+
+// where in the source the code at `offset` came from, as
+// "<file>:<line>:<column>" and then ", from @<directive> at <file>:..."
+// for each macro call, @include or @unroll it was expanded from, written
+// to `buf` like snprintf, truncated to `size`. 0, writing nothing, without
+// a BIN_SECTION_LINES that says. the section is only read here, so a
+// program pays nothing for it until this is called.
+size_t image_formatSource(const image_t *image, uint64_t offset, char *buf, size_t size);
+
+// the deepest macro calls, @includes and @unrolls image_formatSourceFrames writes
+#define IMAGE_MAX_FRAMES 64
+
+// the same, as a stack of frames for a flame graph: outermost first, each
+// "@<directive> <file>:<line>" or "<file>:<line>", separated by ';'
+size_t image_formatSourceFrames(const image_t *image, uint64_t offset, char *buf, size_t size);
+
+// the innermost of those: the file and line the statement that built the
+// code at `offset` is at. `*file` points into the section. false, setting
+// neither, without a BIN_SECTION_LINES that says.
+bool image_sourceLine(const image_t *image, uint64_t offset, const char **file, uint32_t *line);
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+// canonical copies of strings, one per distinct content, so strings can be
+// compared by pointer -- object member keys are (see runtime_memberKey).
+// the copies are owned by the table and live until intern_destroy.
+// not synchronized, but for intern_owns.
+//
+// the copies of short strings are carved from chunks, so whether a pointer
+// is one takes a look at the chunks' ranges; longer ones, and those past
+// the last chunk, are allocated on their own.
+#define INTERN_INITIAL_SIZE 64 // a power of two
+#define INTERN_CHUNK_SIZE (64 * 1024)
+#define INTERN_CHUNKED_MAX 1024 // the longest copy carved from a chunk, with its NUL
+#define INTERN_MAX_CHUNKS 256
+
+typedef struct intern_entry {
+  uint64_t hash;
+  const char *str; // NULL if the entry is free
+  size_t len;
+  bool chunked; // carved from a chunk rather than allocated
+} intern_entry_t;
+
+typedef struct intern_table {
+  intern_entry_t *entries;
+  size_t tableSize;
+  size_t size;
+
+  char *chunks[INTERN_MAX_CHUNKS];
+  atomic_size_t numChunks; // stored after the chunk, for intern_owns
+  size_t chunkUsed; // of the last one
+} intern_table_t;
+
+void intern_init(intern_table_t *table);
+void intern_destroy(intern_table_t *table);
+
+// the canonical, NUL-terminated copy of `len` bytes at `str`
+const char *intern_get(intern_table_t *table, const char *str, size_t len);
+
+// whether `str` is a copy carved from one of the table's chunks: two of
+// those are the same string exactly when they are the same pointer. safe
+// to call while another thread interns; false for the copies allocated on
+// their own, which only makes comparing them slower.
+bool intern_owns(const intern_table_t *table, const char *str);
@@ -1,18 +1,133 @@
 #pragma once
 
 #include <vm/runtime.h>
+#include <vm/code.h>
+#include <vm/verify.h>
+#include <vm/image.h>
 
 #include <stdint.h>
 #include <stddef.h>
+#include <stdio.h>
 
 typedef uint8_t ubyte_t;
 typedef struct interpreter interpreter_t;
 
+// with interpreter_profileOpcodes: the times each opcode ran with each
+// flags byte, and each opcode ran right after another
+typedef struct interpreter_opcodes {
+  uint64_t counts[CODE_OP_COUNT][256];
+  uint64_t pairs[CODE_OP_COUNT][CODE_OP_COUNT]; // by the one before, then the one after
+  uint16_t last; // the opcode that ran last, CODE_OP_COUNT before the first
+} interpreter_opcodes_t;
+
+// with interpreter_profileBlocks(it, true): a builtin a block called,
+// and the time spent in it
+typedef struct interpreter_block_call {
+  native_function_t fn;
+  uint64_t count;
+  uint64_t nanos;
+  struct interpreter_block_call *next;
+} interpreter_block_call_t;
+
+// with interpreter_profileBlocks: the code from a label, or the start of
+// the code, up to the next label, and the time spent in it
+typedef struct interpreter_block {
+  uint64_t offset; // into the code
+  uint64_t end;
+  const char *name; // of the label, `nameLen` bytes from BIN_SECTION_DEBUG; NULL without one
+  uint32_t nameLen;
+  uint64_t entries; // times it was jumped or fallen into
+  uint64_t nanos; // calls included
+  interpreter_block_call_t *calls;
+} interpreter_block_t;
+
+typedef struct interpreter_blocks {
+  interpreter_block_t *blocks; // in order of offset
+  size_t numBlocks;
+  interpreter_block_t *current; // where the last instruction was
+  uint64_t since; // when time was last charged to `current`
+  bool calls; // time the builtins called from each block
+} interpreter_blocks_t;
+
+// with interpreter_profileSamples: one place the program was found at,
+// and how many times
+typedef struct interpreter_sample {
+  uint64_t offset; // of the block it was in, plus one; 0 for an unused entry
+  native_function_t fn; // the builtin it was in, or NULL
+  bool native; // in compiled code
+  uint64_t count;
+} interpreter_sample_t;
+
+// open addressing over (offset, fn, native); filled from a signal
+// handler, so it never grows
+#define INTERPRETER_MAX_SAMPLES 4096
+
+typedef struct interpreter_samples {
+  interpreter_sample_t entries[INTERPRETER_MAX_SAMPLES];
+  uint64_t dropped; // taken with the table full
+} interpreter_samples_t;
+
+// with interpreter_profileInstructions: per instruction, by index, the
+// times it ran and the time from its start to the next one's -- that of
+// the builtins and compiled code it called included
+typedef struct interpreter_instructions {
+  uint64_t *counts;
+  uint64_t *nanos;
+  uint32_t last; // the one being timed, CODE_INVALID_INDEX before the first
+  uint64_t since; // when it started
+} interpreter_instructions_t;
+
+// with interpreter_traceRing: the last `mask + 1` instructions run, one
+// word each, see INTERPRETER_RING_ENTRY, overwritten oldest first.
+// `next` counts every instruction recorded.
+typedef struct interpreter_ring {
+  uint64_t *entries;
+  uint64_t mask;
+  uint64_t next;
+} interpreter_ring_t;
+
+// an instruction as the ring holds it: its offset, then its opcode,
+// flags, and the archtypes of its left and right operands, a byte each
+#define INTERPRETER_RING_ENTRY(ins) \
+  ((uint64_t)(ins)->offset | ((uint64_t)(ins)->opcode << 32) | ((uint64_t)(ins)->flags << 40) \
+    | ((uint64_t)(ins)->left.at << 48) | ((uint64_t)(ins)->right.at << 56))
+
+typedef struct interpreter_entry {
+  uint64_t pc;
+  VERIFY_RESULT verify;
+} interpreter_entry_t;
+
 struct interpreter {
   size_t pc;
   size_t len;
   uint8_t flags;
-  ubyte_t *bc;
+  struct program *program; // the .bin, of which the interpreter holds a reference
+  const image_t *image; // the program's
+  const ubyte_t *bc; // its code section, `len` bytes
+  code_t *code; // decoded from `bc` at load time
+  VERIFY_RESULT verify; // verify_code() of `code`
+  uint32_t verifyOffset; // offending instruction, if `verify` != VERIFY_OK
+  struct jit *jit; // compiled OP_JIT regions and hot loops
+  uint32_t hotLoop; // jit_hotThreshold()
+  bool tracing; // jit_tracing(): hot loops are recorded as traces
+  struct jit_trace *trace; // being recorded, see interpreter_recordTrace
+  bool haltExits; // OP_HALT exits the process; cleared for jobs under vm --workers, which return instead
+  bool remeter; // interpreter_runUnmetered returned for the metered loop to go on
+  struct interpreter_entry *entries; // verify_entry() of each offset interpreter_runEntry started at
+  size_t numEntries;
+  uint64_t *profile; // with interpreter_profile, per instruction the times it ran and jumped; otherwise NULL
+  struct interpreter_opcodes *opcodes; // with interpreter_profileOpcodes; otherwise NULL
+  struct interpreter_blocks *blocks; // with interpreter_profileBlocks; otherwise NULL
+  struct interpreter_samples *samples; // with interpreter_profileSamples; otherwise NULL
+  struct interpreter_ring *ring; // with interpreter_traceRing; otherwise NULL
+  struct interpreter_instructions *instructions; // with interpreter_profileInstructions; otherwise NULL
+  // where the program is, for interpreter_sample, which may read them
+  // from a signal handler at any time: the instruction the last taken
+  // jump or call went to, the builtin being called, and whether compiled
+  // code is running. kept by every loop but the recording one.
+  instruction_t *volatile sampleAt;
+  volatile native_function_t sampleFn;
+  volatile bool sampleNative;
   runtime_t *rt;
 };
 
@@ -27,7 +142,47 @@ enum JUMP_FLAGS {
   JUMP_FLAGS_JE = 0x1,
   JUMP_FLAGS_JNE = 0x2,
   JUMP_FLAGS_JG = 0x3,
-  JUMP_FLAGS_JGE = 0x4
+  JUMP_FLAGS_JGE = 0x4,
+  // switch: the left operand, an 8 byte immediate `low` and a u16 case
+  // count come before the target, the default, and that many AT_CODE
+  // targets follow it. goes to case `v - low` of the left operand's int
+  // `v` if there is one, otherwise to the default.
+  JUMP_FLAGS_TABLE = 0x5
+};
+
+enum CALL_FLAGS {
+  CALL_FLAGS_NONE = 0x0, // arguments on the stack
+  CALL_FLAGS_REGISTER_ARGS = 0x1, // arguments in $r[1] .. $r[n]
+  CALL_FLAGS_OPERANDS = 0x2, // arguments at the operands following the callee, read where they are
+  // the result goes to the right operand instead of $r[0]: as to $r[0]
+  // if it is a register, otherwise over what it held, with the result's
+  // reference (see OP_TAKE)
+  CALL_FLAGS_RESULT = 0x4
+};
+
+// a mov with flags other than none is followed by a u8 JUMP_FLAGS
+// condition, which holds for the last compare as for OP_CMPJ
+enum MOV_FLAGS {
+  MOV_FLAGS_NONE = 0x0,
+  MOV_FLAGS_SET = 0x1, // setcc: an int, 1 if the condition holds, otherwise 0, to the left operand
+  MOV_FLAGS_SELECT = 0x2, // select: the right operand if the condition holds, otherwise the one after it, to the left
+  MOV_FLAGS_NOT = 0x4 // with either: the condition negated
+};
+
+enum TAKE_FLAGS {
+  TAKE_FLAGS_MOV = 0x0, // to the left operand
+  TAKE_FLAGS_PUSH = 0x1 // to a new slot on top of the stack, the right operand only
+};
+
+enum JIT_FLAGS {
+  JIT_FLAG_BEGIN = 0x1, // followed by the $d location the compiled region is stored in
+  JIT_FLAG_END = 0x2,
+  JIT_FLAG_MEMOIZE = 0x4 // with BEGIN: a u8 argument count comes first, see jit_memoLookup
+};
+
+enum HALT_FLAGS {
+  HALT_FLAGS_NONE = 0x0, // exit the process
+  HALT_FLAGS_RETURN = 0x1 // return from interpreter_run (end of buffer)
 };
 
 enum CONST_FLAGS {
@@ -37,8 +192,8 @@ enum CONST_FLAGS {
   CONST_FLAGS_U64 = 0x3,
   CONST_FLAGS_F64 = 0x4,
   CONST_FLAGS_BOOL = 0x5,
-  // empty
-  CONST_FLAGS_RAWDATA = 0x7
+  CONST_FLAGS_POOL = 0x6, // u32 index of an OP_CONST entry; shared, never copied
+  CONST_FLAGS_RAWDATA = 0x7 // u64 size and the bytes; borrowed from the pool like CONST_FLAGS_POOL
 };
 
 enum CMP_FLAG {
@@ -46,6 +201,7 @@ enum CMP_FLAG {
   CMP_FLAG_F64_L = 0x1, // compare .data.f64 to .data
   CMP_FLAG_F64_R = 0x2, // compare .data to .data.f64
   CMP_FLAG_F64_LR = 0x3, // compare .data.f64 to .data.f64
+  CMP_FLAG_IMM_R = 0x4, // cmp, binops: right operand is an inline 8 byte immediate, not an obj_loc_t
 };
 
 //static size_t LOAD_CONST_SIZES[] = { 0, sizeof(int64_t), sizeof(uint64_t), sizeof(double), sizeof(bool) };
@@ -57,7 +213,8 @@ enum INSTRUCTIONS { // max: 32 values
 
   OP_LOAD = 1, // load value into register
 
-  OP_MOV = 2, // move data from one place to another
+  OP_MOV = 2, // move data from one place to another; setcc and select with MOV_FLAGS
+  OP_TAKE = 3, // mov or push, see TAKE_FLAGS, handing over the right operand's reference: it is left as none
 
   OP_CMP = 4, // compare and set compare flag
 
@@ -86,24 +243,131 @@ enum INSTRUCTIONS { // max: 32 values
 
   OP_CALL = 20,
   OP_PRINT = 21,
-  OP_PLACEHOLDER_22 = 22,
-  OP_PLACEHOLDER_23 = 23,
-  OP_PLACEHOLDER_24 = 24,
-  OP_PLACEHOLDER_25 = 25,
-  OP_PLACEHOLDER_26 = 26,
-  OP_PLACEHOLDER_27 = 27,
-  OP_PLACEHOLDER_28 = 28,
-  OP_PLACEHOLDER_29 = 29,
+  OP_CMPJ = 22, // fused cmp + conditional jmp, flags hold the JUMP_FLAGS condition
+  OP_CMPJ_IMM = 23, // OP_CMPJ with an inline 8 byte immediate as the right operand
+  OP_CONST = 24, // constant pool entry: u64 size, then the bytes. no-op when executed
+  // ===== fibers, see vm/fiber.h
+  OP_SPAWN = 25, // new fiber at the label held in the target, with a copy of the registers; its id to the left operand
+  OP_YIELD = 26, // lets the next runnable fiber run
+  OP_JOIN = 27, // waits for the fiber whose id is in the left operand to end; its $r[0] to $r[0]
+  // ===== script functions: a frame on the stack, see VM_FRAME_POINTER
+  OP_FCALL = 28, // pushes the return offset and the frame pointer, points the frame pointer past them and jumps to the target
+  OP_RET = 29, // pops the frame, then a u16 count of arguments, and returns to the offset the frame was called from
   OP_JIT = 30,
 
   OP_HALT = 31, // exit program
 };
 
-interpreter_t *interpreter_create(runtime_t *rt, ubyte_t *data, size_t len);
+// loads a .bin, a container or a flat stream (see shared/bin_format.h),
+// into a program of its own (see interpreter_createShared).
+// executes `data` in place: it is not copied (compressed code is
+// decompressed, see image_open), and must stay valid (and unchanged) until
+// interpreter_destroy. it may be a read-only mapping.
+// returns NULL, after printing why, if `data` is a malformed container.
+interpreter_t *interpreter_create(runtime_t *rt, const ubyte_t *data, size_t len);
+// runs `program` on `rt`, taking a reference to it: decodes its code
+// against the storages of `rt`, and stores its static data and labels
+// to $d. any number of runtimes may share one program.
+interpreter_t *interpreter_createShared(runtime_t *rt, struct program *program);
 void interpreter_destroy(interpreter_t *it);
+// gets `it` ready to run its program again from the start, as if on a new
+// runtime, see runtime_reset. the
+// decoded code, its caches and feedback, and compiled code are kept. called
+// on the thread attached to the runtime, between runs.
+void interpreter_reset(interpreter_t *it);
 void interpreter_peek(interpreter_t *it, size_t size, void *out);
 void interpreter_seek(interpreter_t *it, size_t loc);
 void interpreter_read(interpreter_t *it, size_t size, void *out);
 bool interpreter_atEnd(interpreter_t *it);
 
+// each of these three catches what is thrown while it runs, see
+// runtime_throwException, going on at the handler. that runs unchecked
+// where the code did, and the depth the region was entered with is known.
 void interpreter_run(interpreter_t *it);
+// continues at VM_PROGRAM_COUNTER where compiled code that ran the program
+// from its entry left off (see jit_aotMain). that state is one the program
+// reached itself, so verified code still runs unchecked.
+void interpreter_resume(interpreter_t *it);
+// runs from byte offset `pc` with an empty stack until OP_HALT returns
+// (see haltExits): the body of a task, see vm/task.h. unchecked if the code
+// there passes verify_entry, which is done once for each `pc`.
+void interpreter_runEntry(interpreter_t *it, uint64_t pc);
+
+// counts from now on how many times each instruction runs, and each jump
+// is taken, for interpreter_writeProfile. the code then always runs
+// checked, which is never compiled.
+void interpreter_profile(interpreter_t *it);
+// writes the counts of the sites in the program's BIN_SECTION_SITES to
+// `path`, see PROFILE_HEADER. false, after printing why, if the program
+// has none or the file cannot be written.
+bool interpreter_writeProfile(interpreter_t *it, const char *path);
+
+// counts from now on how many times each opcode runs, by its flags, and
+// how many times each runs right after another, for
+// interpreter_writeOpcodes. the code then always runs in the profiled
+// instance of the interpreter loop, which is checked and never compiled;
+// the others are built without the counting.
+void interpreter_profileOpcodes(interpreter_t *it);
+// writes the opcodes and then the pairs of opcodes counted, most run
+// first, to `f`
+void interpreter_writeOpcodes(interpreter_t *it, FILE *f);
+
+// times from now on the code between one label and the next, with
+// CLOCK_MONOTONIC at each change of block, and with `calls` the builtins
+// each block calls, for interpreter_writeBlocks. runs the profiled loop,
+// as interpreter_profileOpcodes does. the labels are those of
+// BIN_SECTION_LABELS and, named, BIN_SECTION_DEBUG (bcparse -g), and the
+// targets of direct jumps are taken as labels too.
+void interpreter_profileBlocks(interpreter_t *it, bool calls);
+// writes the blocks that ran, most time first, each with the source it
+// came from if the program has a BIN_SECTION_LINES, and with `calls` the
+// builtins it called under it, to `f`
+void interpreter_writeBlocks(interpreter_t *it, FILE *f);
+
+// collects from now on the samples interpreter_sample takes, for
+// interpreter_writeSamples. unlike the other profiles, the code runs as it
+// would otherwise, unchecked and compiled: where it is is only known to
+// the block, the last taken jump or call, and compiled code as a whole.
+void interpreter_profileSamples(interpreter_t *it);
+// counts where the program is now. async-signal-safe, meant to be called
+// from a profiling timer's handler; nothing without
+// interpreter_profileSamples.
+void interpreter_sample(interpreter_t *it);
+// writes the samples in the collapsed stack format of flamegraph.pl and
+// speedscope to `f`, one line of frames separated by ';' and the count:
+// the source and the macro calls it came from if the program has a
+// BIN_SECTION_LINES, its offset if not, then the builtin or "[compiled]"
+void interpreter_writeSamples(interpreter_t *it, FILE *f);
+
+// an instruction profile, which interpreter_writeInstructions writes and
+// vm --annotate reads (see vm/annotate.h), is text:
+// INTERPRETER_INSTRUCTIONS_HEADER and the length of the code it was taken
+// of on a line, then `<offset> <count> <taken> <nanos>` on a line for each
+// instruction that ran: how many times, how many of those it jumped (0
+// but for jumps), and the time until the next instruction started.
+#define INTERPRETER_INSTRUCTIONS_HEADER "bb8-instructions 1"
+
+// counts and times from now on each instruction that runs, with
+// CLOCK_MONOTONIC at every one, and each jump taken as
+// interpreter_profile does, for interpreter_writeInstructions. runs the
+// profiled loop, as interpreter_profileOpcodes does.
+void interpreter_profileInstructions(interpreter_t *it);
+// writes them to `path`, see INTERPRETER_INSTRUCTIONS_HEADER. false, after
+// printing why, if the file cannot be written.
+bool interpreter_writeInstructions(interpreter_t *it, const char *path);
+
+// the name interpreter_writeOpcodes gives an opcode, OP_* or CODE_OP_*;
+// "?" for none
+const char *interpreter_opcodeName(uint16_t opcode);
+
+// records from now on the last `size` instructions run, rounded up to a
+// power of two, for interpreter_writeRing: one store per instruction,
+// though in the profiled loop, as interpreter_profileOpcodes runs, so
+// nothing is compiled while it is on. the runtime's `traced`, for the
+// traceDump builtin.
+void interpreter_traceRing(interpreter_t *it, size_t size);
+// writes the instructions in the ring, oldest first, each with its
+// operands' archtypes, the label it is under if the program has a
+// BIN_SECTION_DEBUG (bcparse -g) and its source if it has a
+// BIN_SECTION_LINES, to `f`. nothing without interpreter_traceRing.
+void interpreter_writeRing(const interpreter_t *it, FILE *f);
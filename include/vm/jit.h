@@ -5,460 +5,141 @@ typedef struct runtime runtime_t;
 #include <vm/interpreter.h>
 
 #include <stdint.h>
-#include <assert.h>
-
-static char buf[1024 * 16];
-
-#define BB8_JIT_BUFFER_SIZE 1024*1024 // 1MB
-
-#define C_(...) \
-  do {\
-    snprintf(buf, 1024 * 16, ##__VA_ARGS__); \
-    strcat(bb8_jitStream, buf); \
-  } while (0)
-
-#define C_SRC_HEADER \
-  "#include <vm/value.h>\n" \
-  "#include <vm/datatable.h>\n" \
-  "#include <vm/runtime.h>\n\n" \
-  "#define DECODE(loc) datatable_getValue(rt, loc >> 4, loc & 0xF)\n\n" \
-  "int main(int argc, char *argv[]) {\n" \
-  "runtime_t *rt = runtime_create();\n"
-
-void jit_run(interpreter_t *it) {
-  uint8_t data, opcode, flags, cache[64];
-  runtime_t *rt = it->rt;
-
-  char bb8_jitStream[BB8_JIT_BUFFER_SIZE];
-  memset(bb8_jitStream, '\0', BB8_JIT_BUFFER_SIZE);
-  strcat(bb8_jitStream, C_SRC_HEADER);
-
-  while (!interpreter_atEnd(it)) {
-    size_t pcBefore = it->pc;
-
-    C_("\n_lbl_%zu: {\n", pcBefore);
-
-    interpreter_read(it, sizeof(data), &data);
-
-    opcode = data >> 3;
-    flags = data & 0x7;
-
-    switch (opcode) {
-      case OP_NOOP: break;
-      case OP_LOAD: { // load
-        obj_loc_t o;
-        interpreter_read(it, sizeof(o), &o);
-
-        loc_28_t loc;
-        archtype_t at;
-        obj_loc_parse(o, &loc, &at);
-
-        C_("value_t *v = DECODE(%#lx);\n", o);
-
-        switch (flags) {
-          case CONST_FLAGS_NONE: // ??
-            break;
-          case CONST_FLAGS_NULL: // loadnull
-            C_("v->data.raw = NULL;\nv->metadata = TYPE_POINTER;\n");
-            break;
-          case CONST_FLAGS_I64: { // loadi4
-            interpreter_read(it, sizeof(int64_t), cache);
-            C_("value_setInt(rt, v, %d);\n", *((int64_t*)cache));
-
-            break;
-          }
-          case CONST_FLAGS_U64: { // loadu4
-            interpreter_read(it, sizeof(uint64_t), cache);
-            C_("value_setUint(rt, v, %d);\n", *((uint64_t*)cache));
-
-            break;
-          }
-          case CONST_FLAGS_F64: { // loadd
-            interpreter_read(it, sizeof(double), cache);
-            C_("value_setDouble(rt, v, %0.f);\n", *((double*)cache));
-
-            break;
-          }
-          case CONST_FLAGS_BOOL: { // loadb
-            interpreter_read(it, sizeof(uint8_t), cache);
-            C_("value_setDouble(rt, v, %d);\n", (bool)cache[0]);
-
-            break;
-          }
-          case CONST_FLAGS_RAWDATA: { // loaddata
-            interpreter_read(it, sizeof(uint64_t), cache);
-            uint64_t sz = *((uint64_t*)cache);
-
-            void *data = malloc(sz);
-            interpreter_read(it, sz, data);
-
-            C_("void *data = malloc(%d);\n", sz);
-            C_("static unsigned char _data_%d[%zu] = {\n", it->pc, sz);
-
-            while (sz) {
-              C_("  %#lx", ((unsigned char*)data)[sz - 1]);
-
-              if (sz > 1) {
-                C_(", ");
-              }
-
-              C_("\n");
-
-              --sz;
-            }
-
-            C_("};\n");
-            C_("memcpy(data, _data_%d, sizeof(_data_%d));\n", it->pc, it->pc);
-            C_("value_setRefCounted(rt, v, data);\n");
-
-            free(data);
-
-            break;
-          }
-        }
-
-        break;
-      }
-
-      case OP_MOV: { // mov
-        obj_loc_t o_left;
-        obj_loc_t o_right;
-        loc_28_t loc;
-        archtype_t at;
-
-        interpreter_read(it, sizeof(o_left), &o_left);
-        obj_loc_parse(o_left, &loc, &at);
-
-        interpreter_read(it, sizeof(o_right), &o_right);
-
-        if (at & AT_REG) {
-          C_("*DECODE(%#lx) = *DECODE(%#lx);\n", o_left, o_right);
-        } else {
-          C_("value_copyValue(rt, DECODE(%#lx), DECODE(%#lx));\n", o_left, o_right);
-        }
-
-        break;
-      }
-
-      case OP_CMP: { // cmp
-        obj_loc_t left, right;
-
-        interpreter_read(it, sizeof(left), &left);
-        interpreter_read(it, sizeof(right), &right);
-
-        C_("value_t *left = DECODE(%#lx), *right = DECODE(%#lx)", left, right);
-        C_("union { int i; double d; } cacheval;\n");
-
-        switch (flags) {
-          case CMP_FLAG_F64_L: // cmpdl
-            C_("cacheval.d = left->data.dbl - right->data.i64;\n"
-              "it->flags = ((0 < cacheval.d) - (cacheval.d < 0)) + 1;\n");
-            break;
-          case CMP_FLAG_F64_R: // cmpdr
-            C_("cacheval.d = left->data.i64 - right->data.dbl;\n"
-              "it->flags = ((0 < cacheval.d) - (cacheval.d < 0)) + 1;\n");
-            break;
-          case CMP_FLAG_F64_LR: // cmpd
-            C_("cacheval.d = left->data.dbl - right->data.dbl;\n"
-              "it->flags = ((0 < cacheval.d) - (cacheval.d < 0)) + 1;\n");
-            break;
-          default: // cmp
-            C_("cacheval.i = left->data.i64 - right->data.i64;\n"
-              "it->flags = ((0 < cacheval.i) - (cacheval.i < 0)) + 1;\n");
-            break;
-        }
-
-        break;
-      }
-
-      case OP_JMP: { // jmp
-        value_t *v;
-
-        obj_loc_t o;
-        loc_28_t loc;
-        archtype_t at;
-
-        interpreter_read(it, sizeof(o), &o);
-        obj_loc_parse(o, &loc, &at);
-
-        C_("value_t *jmpLoc_%zu = DECODE(%#lx);\n", o);
-
-        char jmpEndLabelName[64] = { '\0' };
-        snprintf(jmpEndLabelName, 64, "_jmp_%zu_end", it->pc);
-
-        switch (flags) {
-          case JUMP_FLAGS_JE: // je
-            C_("\nif (~it->flags & INTERPRETER_FLAGS_EQUAL) goto %s;\n\n", jmpEndLabelName);
-            break;
-          case JUMP_FLAGS_JNE: // jne
-            C_("\nif (it->flags & INTERPRETER_FLAGS_EQUAL) goto %s;\n\n", jmpEndLabelName);
-            break;
-          case JUMP_FLAGS_JG: // jg
-            C_("\nif (~it->flags & INTERPRETER_FLAGS_GREATER) goto %s;\n\n", jmpEndLabelName);
-            break;
-          case JUMP_FLAGS_JGE: // jge
-            C_("\nif (~it->flags & (INTERPRETER_FLAGS_GREATER | INTERPRETER_FLAGS_EQUAL)) goto %s;\n\n", jmpEndLabelName);
-            break;
-        }
-
-        C_("\ngoto *((void*)value_getUint(jmpLoc_%zu));\n", o); // Need computed GOTO
-        //printf("goto _lbl_%zu;\n", value_getUint(v));
-        C_("\n%s:\n", jmpEndLabelName);
-
-        break;
-      }
-
-      case OP_PUSH: { // push
-        C_("storage_t *stack = &rt->dt->storage[AT_LOCAL];\n");
-
-        switch (flags) {
-          case CONST_FLAGS_NONE: { // push -- load value_t to push to stack
-            obj_loc_t o;
-            loc_28_t loc;
-            archtype_t at;
-
-            interpreter_read(it, sizeof(o), &o);
-            obj_loc_parse(o, &loc, &at);
-
-            C_("value_copyValue(rt, stack->data[stack->len], DECODE(%#lx));\n", o);
-
-            break;
-          }
-          // shortcuts for pushing constants directly, rather than using multiple instructions
-          // @TODO: make these values be copied from a constant pool, rather than by recreating.
-          case CONST_FLAGS_NULL: { // pushnull
-            C_("value_t *v = &stack->data[stack->len];\n");
-            C_("v->data.raw = NULL;\n");
-            C_("v->metadata = TYPE_POINTER;\n");
-
-            break;
-          }
-          case CONST_FLAGS_I64: { // pushi4
-            interpreter_read(it, sizeof(int64_t), cache);
-            C_("value_setInt(rt, &stack->data[stack->len], %d);\n", *((int64_t*)cache));
-
-            break;
-          }
-          case CONST_FLAGS_U64: { // pushu4
-            interpreter_read(it, sizeof(uint64_t), cache);
-            C_("value_setUint(rt, &stack->data[stack->len], %d);\n", *((uint64_t*)cache));
-
-            break;
-          }
-          case CONST_FLAGS_F64: { // pushd
-            interpreter_read(it, sizeof(double), cache);
-            C_("value_setDouble(rt, &stack->data[stack->len], %0.f);\n", *((double*)cache));
-
-            break;
-          }
-          case CONST_FLAGS_BOOL: { // pushb
-            interpreter_read(it, sizeof(uint8_t), cache);
-            C_("value_setDouble(rt, &stack->data[stack->len], %d);\n", (bool)cache[0]);
-
-            break;
-          }
-          case CONST_FLAGS_RAWDATA: { // pushdata
-            interpreter_read(it, sizeof(uint64_t), cache);
-            uint64_t sz = *((uint64_t*)cache);
-
-            void *data = malloc(sz); // managed by refcounter
-            C_("void *data = malloc(%d); /* RC */\n", sz);
-
-            interpreter_read(it, sz, data);
-
-            C_("value_setRefCounted(rt, &stack->data[stack->len], data);\n");
-
-            free(data);
-
-            break;
-          }
-        }
-
-        C_("++stack->len;\n");
-
-        break;
-      }
-
-      case OP_POP: {
-        interpreter_read(it, sizeof(uint16_t), cache);
-        uint16_t sz = *((uint16_t*)cache);
-
-        //rt->dt->storage[AT_LOCAL].len -= sz;
-        C_("storage_t *s = &rt->dt->storage[AT_LOCAL];\n");
-        C_("uint16_t sz = %d;\n", sz);
-        C_("while (sz--) {\n");
-        C_("  value_destroy(rt, &s->data[--s->len]);\n");
-        C_("}\n");
-
-        break;
-      }
-
-      case OP_ADD:
-      case OP_SUB:
-      case OP_MUL:
-      case OP_DIV:
-      case OP_MOD: {
-        obj_loc_t o;
-        loc_28_t loc;
-        archtype_t at;
-
-        interpreter_read(it, sizeof(o), &o);
-        obj_loc_parse(o, &loc, &at);
-
-        C_("value_t *left = DECODE(%#lx);\n", o);
-
-        interpreter_read(it, sizeof(o), &o);
-        obj_loc_parse(o, &loc, &at);
-
-        C_("value_t *right = DECODE(%#lx);\n", o);
-
-        switch (opcode) {
-          case OP_ADD:
-            switch (flags) {
-              case CMP_FLAG_F64_L:  C_("left->data.dbl = left->data.dbl + right->data.i64;\n"); break;
-              case CMP_FLAG_F64_R:  C_("left->data.i64 = left->data.i64 + right->data.dbl;\n"); break;
-              case CMP_FLAG_F64_LR: C_("left->data.dbl = left->data.dbl + right->data.dbl;\n"); break;
-              default:              C_("left->data.i64 = left->data.i64 + right->data.i64;\n"); break;
-            }
-            break;
-          case OP_SUB:
-            switch (flags) {
-              case CMP_FLAG_F64_L:  C_("left->data.dbl = left->data.dbl - right->data.i64;\n"); break;
-              case CMP_FLAG_F64_R:  C_("left->data.i64 = left->data.i64 - right->data.dbl;\n"); break;
-              case CMP_FLAG_F64_LR: C_("left->data.dbl = left->data.dbl - right->data.dbl;\n"); break;
-              default:              C_("left->data.i64 = left->data.i64 - right->data.i64;\n"); break;
-            }
-            break;
-          case OP_MUL:
-            switch (flags) {
-              case CMP_FLAG_F64_L:  C_("left->data.dbl = left->data.dbl * right->data.i64;\n"); break;
-              case CMP_FLAG_F64_R:  C_("left->data.i64 = left->data.i64 * right->data.dbl;\n"); break;
-              case CMP_FLAG_F64_LR: C_("left->data.dbl = left->data.dbl * right->data.dbl;\n"); break;
-              default:              C_("left->data.i64 = left->data.i64 * right->data.i64;\n"); break;
-            }
-            break;
-          // @TODO: div by zero catch?
-          case OP_DIV:
-            switch (flags) {
-              case CMP_FLAG_F64_L:  C_("left->data.dbl = left->data.dbl / right->data.i64;\n"); break;
-              case CMP_FLAG_F64_R:  C_("left->data.i64 = left->data.i64 / right->data.dbl;\n"); break;
-              case CMP_FLAG_F64_LR: C_("left->data.dbl = left->data.dbl / right->data.dbl;\n"); break;
-              default:              C_("left->data.i64 = left->data.i64 / right->data.i64;\n"); break;
-            }
-            break;
-          case OP_MOD:
-            C_("left->data.i64 = left->data.i64 % right->data.i64;\n");
-            break;
-        }
-
-        break;
-      }
-
-      case OP_XOR:
-      case OP_AND:
-      case OP_OR:
-      case OP_SHL:
-      case OP_SHR: {
-        obj_loc_t o;
-        loc_28_t loc;
-        archtype_t at;
-
-        interpreter_read(it, sizeof(o), &o);
-        obj_loc_parse(o, &loc, &at);
-
-        C_("value_t *left = DECODE(%#lx);\n", o);
-
-        interpreter_read(it, sizeof(o), &o);
-        obj_loc_parse(o, &loc, &at);
-
-        C_("value_t *right = DECODE(%#lx);\n", o);
-
-        switch (opcode) {
-          case OP_XOR: C_("left->data.i64 = left->data.i64 ^ right->data.i64;\n"); break;
-          case OP_AND: C_("left->data.i64 = left->data.i64 & right->data.i64;\n"); break;
-          case OP_OR:  C_("left->data.i64 = left->data.i64 | right->data.i64;\n"); break;
-          case OP_SHL: C_("left->data.i64 = left->data.i64 << right->data.i64;\n"); break;
-          case OP_SHR: C_("left->data.i64 = left->data.i64 >> right->data.i64;\n"); break;
-        }
-
-        break;
-      }
-
-      case OP_NEG: {
-        obj_loc_t o;
-        loc_28_t loc;
-        archtype_t at;
-
-        interpreter_read(it, sizeof(o), &o);
-        obj_loc_parse(o, &loc, &at);
-
-        switch (flags) {
-          case CMP_FLAG_F64_L:  C_("DECODE(%#lx)->data.dbl *= -1;\n", o); break;
-          default:              C_("DECODE(%#lx)->data.i64 *= -1;\n", o); break;
-        }
-
-        break;
-      }
-
-      case OP_NOT: {
-        obj_loc_t o;
-        loc_28_t loc;
-        archtype_t at;
-
-        interpreter_read(it, sizeof(o), &o);
-        obj_loc_parse(o, &loc, &at);
-
-        C_("DECODE(%#lx)->data.i64 = ~DECODE(%#lx)->data.i64;\n", o, o);
-
-        break;
-      }
-
-      case OP_CALL: {
-        obj_loc_t o;
-        loc_28_t loc;
-        archtype_t at;
-
-        interpreter_read(it, sizeof(o), &o);
-        obj_loc_parse(o, &loc, &at);
-
-        C_("rt->dt->storage[AT_REG].data[0] = value_invoke(rt, DECODE(%#lx));\n", o);
-
-        // @NOTE: reason we are NOT doing value_copyValue() here, is because we want the register value to inherit
-        // all responsibilities of `result` here ... including refcounts, free() obligations...
-
-        break;
-      }
-
-      // ...
-
-      case OP_JIT: {
-        assert(false && "OP_JIT called from within JIT function");
-
-        // move value_t to static data that holds jitFunction
-
-        break;
-      }
-
-      case OP_HALT:
-        C_("\n\nputs(\"Program Terminated\");\n\n");
-        break;
-    }
-
-    C_("}\n\n");
-  }
-
-  strcat(bb8_jitStream, "\nruntime_destroy(rt);\n");
-  strcat(bb8_jitStream, "return 0;\n}\n");
-
-  // TODO: run compiler?
-  FILE *fptr = fopen("_tmp_jit.c", "w");
-  if (fptr == NULL) {
-    puts("Failed to open tmp file");
-    exit(1);
-  }
-
-  fputs(bb8_jitStream, fptr);
-  fclose(fptr);
-}
-
-#undef C_
+#include <stdbool.h>
+
+// a JIT_FLAG_BEGIN .. JIT_FLAG_END region is compiled by one of two backends:
+// - on x86-64, and on AArch64 with BB8_JIT_A64, machine code templates
+//   (see vm/jit_native.h), with no compile latency
+// - otherwise, or if the region uses something the templates do not cover,
+//   translated to C, built into a shared object with the system C compiler
+//   and loaded with dlopen.
+// the compiled function runs the region's instructions natively against
+// the datatable and returns (as a u64) the byte offset the interpreter
+// resumes at: the instruction after JIT_FLAG_END, a jump target outside
+// the region, or a halt.
+//
+// compiled code does no bounds checking, so regions are only compiled
+// for verified programs (see verify_code); otherwise they are interpreted.
+//
+// both backends specialize on the type feedback the interpreter has
+// gathered (instruction_t.seen): loads, pushes and movs into slots that
+// never owned memory skip value_destroy / value_copyValue, and the C
+// backend keeps registers used only as numbers in unboxed locals. each
+// specialization is guarded; a failed guard returns to the interpreter
+// at the instruction it protects, which is always a safe place to resume.
+//
+// environment:
+//   BB8_JIT_CC -- C compiler to invoke, default `cc`
+//   BB8_JIT_CACHE -- directory C-compiled regions are kept in across runs,
+//     keyed by vm build and region source; default $XDG_CACHE_HOME/bb8-jit
+//     or ~/.cache/bb8-jit, 0 = no cache
+//   BB8_JIT=0 -- never compile, interpret all regions
+//   BB8_JIT=native / BB8_JIT=c -- only use the given backend
+//   BB8_JIT_HOT -- backward jumps before a loop is compiled, 0 = never
+//   BB8_JIT_TRACE=1 -- compile hot loops from recorded traces, see jit_trace_t,
+//     and report the regions that could not be compiled to stderr
+
+// shared between the interpreter and a compiled region.
+// passed in args_t._rawData; NULL when the function is called directly.
+typedef struct jit_frame {
+  uint8_t flags; // compare flags, as interpreter_t.flags
+} jit_frame_t;
+
+typedef struct jit jit_t;
+
+jit_t *jit_create(code_t *code);
+void jit_destroy(jit_t *jit);
+
+// returns the native function for the region opened by `begin`
+// (an OP_JIT | JIT_FLAG_BEGIN instruction of the jit's code),
+// compiling it the first time. NULL if the region cannot be compiled,
+// or with BB8_JIT=0.
+native_function_t jit_region(jit_t *jit, const instruction_t *begin);
+
+// tiering: a label reached by more than jit_hotThreshold() backward jumps
+// is the header of a hot loop. the loop -- the header up to the jump
+// back to it -- is compiled by jit_loop, and the interpreter enters it
+// at the header the next time round, with no other state to transfer.
+#define JIT_HOT_THRESHOLD 1000
+
+// BB8_JIT_HOT, or JIT_HOT_THRESHOLD. 0 (also with BB8_JIT=0) disables tiering.
+uint32_t jit_hotThreshold(void);
+
+// returns the native function for the loop from `header` to the backward
+// jump `latch`, compiling it the first time. NULL if it cannot be compiled.
+native_function_t jit_loop(jit_t *jit, const instruction_t *header, const instruction_t *latch);
+
+// trace recording (BB8_JIT_TRACE=1): rather than compiling a hot loop's
+// whole code range, the interpreter records the instructions one
+// iteration actually runs, from the header round to the jump back to it,
+// and jit_traceCompile turns that path into a straight-line C loop.
+// every branch on it is guarded to go the way it went while recording,
+// with a side exit to the interpreter otherwise, and calls to the leaf
+// builtins are inlined behind a check of the callee.
+// recording gives up at a halt, at an OP_JIT marker or after
+// JIT_TRACE_MAX instructions; the loop is then compiled by jit_loop.
+#define JIT_TRACE_MAX 512
+
+typedef struct jit_trace {
+  uint32_t header; // instruction index the trace starts and loops back at
+  uint32_t len;
+  bool complete; // ended by a jump back to the header
+  uint32_t path[JIT_TRACE_MAX]; // instruction indices, in the order they ran
+} jit_trace_t;
+
+// BB8_JIT_TRACE is set (and not 0), and the C backend is available
+bool jit_tracing(void);
+
+// the compiled trace of the loop at `header`. returns NULL, with `record`
+// set, if none has been recorded yet; `record` is false after a trace
+// failed to record or compile.
+native_function_t jit_traceLookup(jit_t *jit, const instruction_t *header, bool *record);
+
+// compiles a recorded trace, remembering the result (or failure) for its
+// header. NULL if it is incomplete or cannot be compiled.
+native_function_t jit_traceCompile(jit_t *jit, const jit_trace_t *trace);
+
+// memoized regions (JIT_FLAG_MEMOIZE): a compiled region treated as a
+// pure function of the top `n` stack values, with $r[0] as its result --
+// nothing else it does is repeated on a hit. results are kept per region,
+// in JIT_MEMO_SETS sets of JIT_MEMO_WAYS entries with the least recently
+// used one evicted, keyed by the arguments' contents, or their identity
+// (value_getID) for pointers. refcounted arguments and results are claimed
+// while in the table. an entry with a pointer argument is dropped once a
+// native has written through a pointer since (runtime_t.epoch).
+// regions with more than JIT_MEMO_MAX_ARGS arguments just run.
+#define JIT_MEMO_MAX_ARGS 4
+#define JIT_MEMO_SETS 64
+#define JIT_MEMO_WAYS 4
+
+// on a hit, sets `result` (a register, so not claimed) to the memoized $r[0]
+// and returns the instruction after the region. NULL on a miss.
+instruction_t *jit_memoLookup(jit_t *jit, runtime_t *rt, const instruction_t *begin, value_t *result);
+
+// after a miss: records `result` for the arguments jit_memoLookup was
+// called with, if the region ran to its end marker (`next` is the marker
+// or the instruction after it) rather than jumping out or halting.
+void jit_memoStore(jit_t *jit, runtime_t *rt, const instruction_t *begin, const instruction_t *next, value_t *result);
+// drops every memoized result, before the code runs again on a reset
+// runtime (see interpreter_reset): pointer arguments are keyed by identity,
+// which new objects may reuse. compiled code is kept.
+void jit_reset(jit_t *jit, runtime_t *rt);
+
+// ahead-of-time compilation (--aot, --genc): writes the whole program,
+// translated as one region, to `cPath` -- a complete translation unit
+// with the bytecode embedded and a main() calling jit_aotMain. unless
+// `exePath` is NULL, it is then built into that executable against the
+// static libvm, with BB8_JIT_CC -- with the BB8_AOT_LTO build option, an
+// optimized copy of it, with link-time optimization across the two, so
+// the runtime functions the program calls are inlined into it as the
+// compiler sees fit. as compiled code does no bounds checks,
+// a program that fails verify_code is embedded to be interpreted instead.
+// returns false, with a message on stderr, if any step fails.
+bool jit_aot(interpreter_t *it, const char *cPath, const char *exePath);
+
+// main() of an ahead-of-time compiled program: sets up a runtime like the
+// vm driver does, builtins included, points `*instructions` at the decoded
+// `bc` and runs `region` from the start. wherever it leaves off (a failed
+// guard, a memoized region, the final halt) the interpreter takes over.
+// with a NULL `region`, the whole program is interpreted.
+int jit_aotMain(native_function_t region, const instruction_t **instructions, const ubyte_t *bc, size_t len);
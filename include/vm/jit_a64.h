@@ -0,0 +1,18 @@
+#pragma once
+
+#include <vm/jit_native.h>
+
+// the AArch64 template backend, see vm/jit_native.h. Apple platforms only
+// map code executable with MAP_JIT, so their regions go to the C backend.
+// it is opt-in (the BB8_JIT_A64 CMake option) until ctest runs it on an
+// AArch64 host or under qemu-aarch64; without it BB8_JIT=native on
+// AArch64 compiles regions with the C backend.
+#if defined(BB8_JIT_A64) && defined(__aarch64__) && defined(__unix__) && !defined(__APPLE__)
+  #define JIT_A64 1
+#else
+  #define JIT_A64 0
+#endif
+
+// returns NULL as well if there is no AArch64 support
+native_function_t jit_a64_compile(const code_t *code, uint32_t first, uint32_t end,
+                                  uint32_t exitOffset, jit_native_region_t *out);
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <vm/code.h>
+#include <vm/types.h>
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// template backends for OP_JIT regions: each instruction is emitted as a
+// fixed sequence of machine code into an mmap'd buffer, skipping the C
+// compiler jit.c otherwise goes through. there is one per architecture,
+// behind the same interface -- x86-64 (vm/jit_x64.h) and AArch64
+// (vm/jit_a64.h) -- and jit_native_backend picks the one for the machine
+// the vm runs on.
+// handlers work on the value_t slots in the datatable directly, or call
+// the runtime for anything touching refcounts (load, push, mov to $d/$l).
+// where the type feedback says a slot never owned memory, those store in
+// place too, behind a guard that returns to the interpreter if it does.
+// calls, and the field accesses with their inline caches, go through
+// jit_native_call.
+//
+// the region is split into basic blocks at label addresses -- the
+// offsets bcparse loads as u64 labels. a jump looks up its byte offset in
+// a table of block entries; any other offset, or one outside the region,
+// returns it to the interpreter.
+
+typedef struct jit_native_region {
+  void *mem; // executable code
+  size_t size;
+  void **table; // byte offset -> block entry, code->len + 1 entries
+} jit_native_region_t;
+
+// compiles instructions [first, end) of `code`, resuming the interpreter at
+// `exitOffset` when the end is reached. returns NULL if the region uses an
+// instruction without a template (floating point, print, ...); `out` is
+// only filled in on success.
+typedef native_function_t (*jit_native_compile_t)(const code_t *code, uint32_t first, uint32_t end,
+                                                  uint32_t exitOffset, jit_native_region_t *out);
+
+typedef struct jit_native_backend {
+  const char *name; // "x64", "a64"
+  jit_native_compile_t compile;
+} jit_native_backend_t;
+
+// the backend for the architecture the vm runs on, NULL if there is none
+const jit_native_backend_t *jit_native_backend(void);
+void jit_native_free(jit_native_region_t *region);
+
+// shared by the backends
+
+// block entries: the start of the region, and every label address and
+// direct jump target in it, indexed from `first`
+bool *jit_native_findBlocks(const code_t *code, uint32_t first, uint32_t end);
+// maps the `len` bytes of machine code at `data` executable, and fills in
+// `table` (code->len + 1 entries, which the code was emitted against):
+// block i (see `blocks`) at `native[i - first]`, every other offset at
+// `exitAt`. the region takes the table; false, with it left to the
+// caller, if the code cannot be mapped.
+bool jit_native_install(const code_t *code, uint32_t first, uint32_t end,
+                        const uint8_t *data, size_t len, const uint32_t *native,
+                        const bool *blocks, size_t exitAt, void **table, jit_native_region_t *out);
+// OP_POP of `sz` values
+void jit_native_pop(runtime_t *rt, uint64_t sz);
+// OP_CALL, CODE_OP_GETFIELD and CODE_OP_SETFIELD, as the interpreter runs them
+void jit_native_call(runtime_t *rt, const instruction_t *ins);
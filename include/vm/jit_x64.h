@@ -0,0 +1,14 @@
+#pragma once
+
+#include <vm/jit_native.h>
+
+// the x86-64 template backend, see vm/jit_native.h
+#if defined(__x86_64__) && (defined(__unix__) || defined(__APPLE__))
+  #define JIT_X64 1
+#else
+  #define JIT_X64 0
+#endif
+
+// returns NULL as well if there is no x86-64 support
+native_function_t jit_x64_compile(const code_t *code, uint32_t first, uint32_t end,
+                                  uint32_t exitOffset, jit_native_region_t *out);
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include <vm/types.h>
+#include <vm/value.h>
+#include <vm/array.h>
+
+// JSON to and from the runtime's values, for the parseJson and
+// stringifyJson builtins. objects become objects (keys interned, so
+// getfield finds them), arrays ARRAY_VALUES arrays, strings strings,
+// numbers ints where they are integers that fit and doubles otherwise,
+// true and false booleans and null none.
+//
+// parsing is in two stages, as simdjson's: the first finds every quote,
+// bracket, colon and comma outside strings, and where each number or
+// literal starts, 64 bytes at a time with SSE2 or NEON where available --
+// carrying backslash runs and whether it is in a string from one block to
+// the next -- into an index of offsets. the second walks the index: it
+// counts the members of each object and array first, for them to be made
+// at their size, then builds the values with no recursion, up to
+// JSON_MAX_DEPTH deep. strings without escapes are slices of the input
+// (see value_setSlice) when it is a refcounted buffer and they are short
+// enough, so the input should not be written to after; the rest are
+// copied. strings are not checked for valid utf-8, and numbers are read
+// as parseInt and parseDouble read them, which take a few forms JSON does
+// not (01, 1.).
+#define JSON_MAX_DEPTH 1024
+
+// the value of the JSON text in `len` bytes at `data`, into `out`. `rc`
+// is the refcounted buffer holding them, `base` bytes in, for strings to
+// be slices of, or NULL to copy every string. false, with `out` none, if
+// the text is not valid JSON or is nested too deep.
+bool json_parse(runtime_t *rt, const uint8_t *data, size_t len, refcounted_t rc, uint32_t base, value_t *out);
+
+// appends `v` as JSON to the ARRAY_BYTES array `builder` (see strBuilder):
+// maps as objects, typed arrays as arrays of numbers, string builders as
+// strings, and none, natives, non-finite doubles and what cannot be
+// written (streams and the like) as null. false if `v` is nested deeper
+// than JSON_MAX_DEPTH, as a cycle is, or memory runs out; the builder has
+// part of the text then.
+bool json_write(runtime_t *rt, array_t *builder, value_t *v);
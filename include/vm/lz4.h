@@ -0,0 +1,11 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// decompresses one block in the LZ4 block format, of `srcLen` bytes at
+// `src`, to `dst`, which has room for `dstCap` bytes. `*dstLen` is set to
+// the bytes written. returns false for a malformed block, or one that
+// does not fit in `dstCap`; nothing is read or written out of bounds.
+bool lz4_decompressBlock(const uint8_t *src, size_t srcLen, uint8_t *dst, size_t dstCap, size_t *dstLen);
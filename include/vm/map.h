@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include <vm/types.h>
+#include <vm/value.h>
+
+#define MAP_GROUP 16 // control bytes probed at once
+#define MAP_INITIAL_CAPACITY (MAP_GROUP)
+#define MAP_EMPTY 0x80
+#define MAP_DELETED 0xFE
+
+typedef struct {
+  uint64_t hash;
+  char *key; // the map's own copy, NUL terminated
+  size_t len;
+  value_t value;
+} map_entry_t;
+
+// a hash table keyed by string contents, laid out like a SwissTable:
+// each entry has a control byte, MAP_EMPTY, MAP_DELETED or the low 7 bits
+// of its key's hash. a lookup starts at the group of MAP_GROUP entries the
+// rest of the hash picks, compares the 7 bits against all 16 control bytes
+// at once (with SSE2 or NEON where available), and only compares keys on
+// a match. groups are probed quadratically until one has an empty entry.
+typedef struct {
+  uint8_t *ctrl;
+  map_entry_t *entries;
+  size_t capacity; // entries, a power of two multiple of MAP_GROUP
+  size_t size; // live entries
+  size_t used; // live and deleted entries; the table is rebuilt at 7/8
+  heap_t *heap; // the map, its tables and keys, see map_create
+} map_t;
+
+// allocated through heap_allocBlock, from the heap holding the map
+map_t *map_create(heap_t *heap);
+void map_destroy(map_t *map);
+// heap_mark on every value
+void map_mark(map_t *map, heap_t *heap);
+
+// a new heap node holding a map_t. defined next to value_createObject,
+// in value.c.
+value_t value_createMap(runtime_t *rt, heap_t *heap);
+
+// a native_function_t used as the dtor_ptr on heap node
+void map_destructor(runtime_t *rt, args_t *args);
+
+// the value stored for `key`, NULL if there is none
+value_t *map_get(map_t *map, const char *key, size_t len);
+// stores a copy of `value` for `key`. false if out of memory.
+bool map_set(runtime_t *rt, map_t *map, const char *key, size_t len, value_t *value);
+// false if there was no such key
+bool map_remove(runtime_t *rt, map_t *map, const char *key, size_t len);
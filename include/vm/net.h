@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include <vm/types.h>
+#include <vm/value.h>
+
+// sockets, TCP or Unix, none of whose calls block: a read, write or accept
+// that would gives NET_AGAIN (none for an accept), and the program waits
+// for the socket with sockWait and a yield, see lib/net.bb8.
+//
+// with fibers, sockWait parks the running one (FIBER_IO) and the yield
+// goes on with another; when the run queue is empty the scheduler waits
+// on the net_t, an epoll set on linux and poll() elsewhere, for a parked
+// fiber's socket to be ready. without fibers, or when the running one is
+// the only fiber, sockWait waits for the socket itself.
+//
+// waits are cut into NET_WAIT_MS slices, between which the thread reaches
+// a safepoint, as channel waits do.
+#define NET_AGAIN (-2)
+#define NET_WAIT_MS 10
+#define NET_BACKLOG 128 // for sockListen without one
+
+typedef struct fiber fiber_t;
+typedef struct fibers fibers_t;
+
+typedef struct net_socket {
+  int fd; // -1 once closed
+  bool listening;
+  bool waitWrite; // what `waiter` waits for
+  fiber_t *waiter; // parked on it, or NULL
+} net_socket_t;
+
+typedef struct net {
+  int epfd; // -1 where there is no epoll; the parked fibers are polled
+  fiber_t *parked; // those parked, where there is no epoll, by `next`
+  size_t numParked;
+} net_t;
+
+// `addr` is "unix:path" for a Unix socket, or "host:port" for TCP, where
+// an empty host or "*" is any address. NULL if it cannot be bound or
+// connected to. a connect may still be going on: the socket is writable
+// once it is done.
+net_socket_t *net_listen(const char *addr, size_t len, int backlog);
+net_socket_t *net_connect(const char *addr, size_t len);
+// a connection taken from a listening socket, NULL if none is pending
+net_socket_t *net_accept(net_socket_t *listener);
+
+// bytes moved, 0 at the end of the stream (reads), -1 on an error, or
+// NET_AGAIN
+int64_t net_read(net_socket_t *s, void *dst, size_t size);
+int64_t net_write(net_socket_t *s, const void *src, size_t size);
+// `size` bytes of file `fd` from `offset`, without them passing through
+// the program: sendfile(2) where there is one, pread and write elsewhere
+int64_t net_sendFile(net_socket_t *s, int fd, int64_t offset, size_t size);
+
+// closes the descriptor; a fiber parked on the socket is woken, and finds
+// it closed. safe to call more than once.
+void net_close(runtime_t *rt, net_socket_t *s);
+
+// a new heap node holding a net_socket_t, which it owns. defined next to
+// value_createObject, in value.c.
+value_t value_createSocket(runtime_t *rt, heap_t *heap, net_socket_t *s);
+
+// a native_function_t used as the dtor_ptr on heap node
+void net_destructor(runtime_t *rt, args_t *args);
+
+// waits on the thread until the socket is readable, or writable
+void net_wait(runtime_t *rt, net_socket_t *s, bool write);
+
+net_t *net_create();
+void net_destroy(net_t *net);
+// parks the running fiber on `socket` until it is readable, or writable;
+// the fiber keeps the socket alive meanwhile. false if it cannot be.
+bool net_park(net_t *net, fibers_t *fibers, value_t *socket, bool write);
+// moves the parked fibers whose sockets are ready to the run queue, having
+// waited up to `timeoutMs` (-1: until one is) for any to be; how many
+size_t net_poll(runtime_t *rt, net_t *net, fibers_t *fibers, int timeoutMs);
@@ -8,6 +8,16 @@ typedef enum {
   AT_LOCAL = 0x2,
   AT_REG = 0x3,
 
+  // not a storage: the target of a direct jump, a code offset. see
+  // BIN_SECTION_CODE.
+  AT_CODE = 0x4,
+
+  // $f[]: a slot of the stack relative to the frame pointer, see
+  // OP_FCALL. its location is the zigzag encoded signed offset from
+  // VM_FRAME_POINTER, so $f[-1] is below the frame and $f[0] its first
+  // local. written as is, neither relative nor absolute.
+  AT_FRAME = 0x4 | AT_LOCAL,
+
   AT_REL = 0x8,
   AT_ABS = 0xC
 } ARCHETYPE;
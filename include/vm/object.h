@@ -7,11 +7,15 @@
 
 #include <vm/types.h>
 #include <vm/value.h>
+#include <vm/shape.h>
 
-typedef char * object_key_t;
-
+#define OBJECT_INITIAL_SLOTS (4)
+// slots kept in the object's own block, after the object_t, for the first
+// ones it gets, so a small object is one block: 0 or OBJECT_INITIAL_SLOTS
+#define OBJECT_INLINE_SLOTS OBJECT_INITIAL_SLOTS
 #define OBJECT_INITIAL_SIZE (8)
 #define OBJECT_MAX_CHAIN_LENGTH (8)
+#define OBJECT_EMPTY (-1) // an index slot with no member
 #define OBJECT_MISSING -3
 #define OBJECT_FULL -2
 #define OBJECT_OMEM -1
@@ -23,16 +27,71 @@ typedef struct {
   value_t value;
 } object_member_t;
 
-typedef struct {
-  size_t tableSize;
-  size_t size;
+// an object starts out shaped: its members are in `slots`, at the index
+// `shape` gives each of them. past SHAPE_MAX_MEMBERS members, or once
+// one is removed, it turns into a hash table of `members` instead, and
+// `shape` is NULL. the hash functions are for that mode only.
+//
+// the table is laid out as CPython's dicts are: `members` is dense, in the
+// order they were put, a removed one left as a hole (`used` false) until
+// the next rehash, and after it, in the same block, the index: tableSize
+// open-addressed positions in `members`, OBJECT_EMPTY where there is none.
+// there is room for tableSize / 2 members, so iterating touches only
+// those, in order, and the table is smaller than one of whole members.
+struct object {
+  size_t tableSize; // of the index
+  size_t size; // live members
+  size_t numMembers; // in `members`, holes included
   object_member_t *members;
-} object_t;
+  heap_t *heap; // the object and its member table, see object_create
+
+  shape_t *shape;
+  value_t *slots;
+  uint32_t numSlots; // allocated, at least shape->count
+  uint32_t capacity; // members it was created for, see object_createWithCapacity
+};
+
+// the object's block, with its inline slots
+#define OBJECT_BLOCK_SIZE (sizeof(object_t) + OBJECT_INLINE_SLOTS * sizeof(value_t))
+
+// whether `slots` are the object's inline ones, see OBJECT_INLINE_SLOTS
+static inline bool object_slotsInline(const object_t *object) {
+  return OBJECT_INLINE_SLOTS != 0 && object->slots == (value_t*)(object + 1);
+}
+
+// the block of a member table of `tableSize`, see object_t
+static inline size_t object_tableBytes(size_t tableSize) {
+  return tableSize / 2 * sizeof(object_member_t) + tableSize * sizeof(int32_t);
+}
+
+static inline int32_t *object_index(const object_t *object) {
+  return (int32_t*)(object->members + object->tableSize / 2);
+}
+
+// the members it has, in either mode
+static inline size_t object_size(const object_t *object) {
+  return object->shape != NULL ? object->shape->count : object->size;
+}
 
 uint32_t object_hashInt(object_t *object, object_key_t key);
 
-object_t *object_create();
+// allocated through heap_allocBlock, from the heap holding the object
+object_t *object_create(heap_t *heap);
+// an object with room for `capacity` members: its slots, and past
+// SHAPE_MAX_MEMBERS the hash table it moves to, sized so that adding
+// that many neither grows them nor rehashes
+object_t *object_createWithCapacity(heap_t *heap, uint32_t capacity);
+// an object of `shape`, a shape of the heap's tree, with room for its
+// members. the caller stores each of them to its slot.
+object_t *object_createShaped(heap_t *heap, shape_t *shape);
 void object_destroy(object_t *object);
+// heap_mark on every member
+void object_mark(object_t *object, heap_t *heap);
+
+// for heap_compact: moves the object, its slots and its member table
+// out of the slabs being evacuated, see heap_relocateBlock. returns where
+// the object is now, for its node to point to.
+object_t *object_relocate(object_t *object);
 
 // a native_function_t used as the dtor_ptr on heap node
 void object_destructor(runtime_t *rt, args_t *args);
@@ -44,3 +103,20 @@ int object_getPtr(object_t *object, object_key_t key, value_t **out);
 int object_get(object_t *object, object_key_t key, value_t *out);
 int object_remove(object_t *object, object_key_t key);
 
+// a shallow copy of `object` in `heap`, its values copied as they are: of a
+// shaped one of the same heap, an object of the same shape whose slots are
+// one memcpy; of a hash table, one with a copy of its table's block
+object_t *object_clone(heap_t *heap, object_t *object);
+// puts each member of `src` into `object`, in the order they were put, the
+// values copied as they are: the slots in one memcpy when both have the
+// same shape
+int object_assign(object_t *object, object_t *src);
+
+// the keys and values of the members, in the order they were put, into
+// `keys` and `values`, object_size(object) of each; either may be NULL
+void object_entries(object_t *object, object_key_t *keys, value_t *values);
+
+// stores `key` in a shaped object that has no such member yet, moving it
+// to `next`, the child of its shape that adds `key`
+void object_addSlot(object_t *object, shape_t *next, value_t *value);
+
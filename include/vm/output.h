@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include <vm/types.h>
+
+// the runtime's buffer for OP_PRINT, so a print is a few stores instead of
+// a printf call, which parses its format and takes the stdio lock each
+// time. the buffer is written to `fp` when it fills up, at OP_HALT, when
+// the runtime is destroyed, at exit and on the `flush` builtin.
+// not synchronized: prints come from the one interpreter thread.
+#define OUTPUT_BUFFER_SIZE (64 * 1024)
+
+typedef enum output_mode {
+  // flushed only at the points above
+  OUTPUT_MODE_BLOCK = 0,
+  // flushed after every value as well. OP_PRINT writes no separators, so
+  // each print is treated as a line.
+  OUTPUT_MODE_LINE = 1
+} output_mode_t;
+
+typedef struct output {
+  FILE *fp;
+  output_mode_t mode;
+  char *buf; // OUTPUT_BUFFER_SIZE bytes
+  size_t len;
+  struct output *next; // in the list flushed at exit, see output_init
+} output_t;
+
+// line buffered if `fp` is a terminal, as stdio would be
+void output_init(output_t *out, FILE *fp);
+// flushes and releases the buffer
+void output_destroy(output_t *out);
+
+// writes out what is buffered, and fflushes `fp`
+void output_flush(output_t *out);
+
+// room for any number or other scalar the format functions write
+#define OUTPUT_NUMBER_MAX 32
+
+// the text OP_PRINT writes for a number, into `buf` of OUTPUT_NUMBER_MAX
+// bytes, unterminated: returns its length. output_formatDouble writes the
+// shortest form that reads back as the same double: integral values
+// without a fraction, "nan" and "inf" for the rest of the non-finite.
+size_t output_formatInt(char *buf, int64_t i64);
+size_t output_formatUint(char *buf, uint64_t u64);
+size_t output_formatDouble(char *buf, double dbl);
+// of none, a boolean or a number, as above; 0 for a pointer
+size_t output_formatScalar(char *buf, value_t *v);
+
+void output_write(output_t *out, const char *str, size_t len);
+void output_writeInt(output_t *out, int64_t i64);
+void output_writeUint(output_t *out, uint64_t u64);
+// as output_formatDouble
+void output_writeDouble(output_t *out, double dbl);
+// lowercase hex with a 0x prefix, "null" for NULL
+void output_writePointer(output_t *out, const void *ptr);
+
+// what OP_PRINT writes for `v`: the text of a string builder, and a
+// pointer for any other pointer
+void output_writeValue(output_t *out, value_t *v);
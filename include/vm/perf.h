@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+// vm --perf-counters and vmbench --perf-counters: hardware counters of
+// the calling thread, user space only, through perf_event_open on Linux.
+// each counter is opened on its own, so one the CPU or the kernel does
+// not offer leaves the others; when the kernel multiplexes them, the
+// counts are scaled up by the time each one ran.
+typedef enum {
+  PERF_CYCLES,
+  PERF_INSTRUCTIONS,
+  PERF_BRANCH_MISSES,
+  PERF_L1D_MISSES, // loads
+  PERF_LLC_MISSES,
+  PERF_COUNTERS
+} perf_counter_t;
+
+typedef struct perf {
+  int fds[PERF_COUNTERS]; // -1 for one that could not be opened
+  uint64_t counts[PERF_COUNTERS]; // between perf_start and perf_stop, added up over each pair
+} perf_t;
+
+// the counters, not counting yet. NULL, after printing why to stderr,
+// if none of them could be opened, or off Linux.
+perf_t *perf_open(void);
+void perf_close(perf_t *perf);
+
+void perf_start(perf_t *perf);
+void perf_stop(perf_t *perf);
+
+// the counts, IPC and misses per thousand instructions, and per bytecode
+// instruction if `bytecodes` is not 0, as a table
+void perf_write(const perf_t *perf, FILE *f, uint64_t bytecodes);
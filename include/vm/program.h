@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vm/image.h>
+#include <vm/code.h>
+#include <vm/value.h>
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+typedef uint8_t ubyte_t;
+typedef struct runtime runtime_t;
+
+// a value the program stores to $d before it runs: a DATA entry, a label or an import
+typedef struct program_static {
+  uint64_t slot;
+  value_t value; // never owns memory, so it is copied as is
+} program_static_t;
+
+// a .bin loaded once, for any number of runtimes on any threads: the
+// image, the pool of its BIN_SECTION_CONST entries and the values
+// program_load stores to $d. immutable once created, and refcounted --
+// each interpreter running it holds a reference.
+//
+// the decoded instructions are not part of it: their operands point into
+// one runtime's storages, and they hold its inline caches and feedback.
+typedef struct program {
+  atomic_uint refs;
+  image_t image; // the file's bytes are borrowed, and must outlive the program
+
+  // the entries, each terminated with a NUL: the section itself with
+  // BIN_CONST_IN_PLACE, otherwise a copy the program owns
+  ubyte_t *pool;
+  size_t poolSize;
+  code_const_t *constants; // into `pool`, by CONST_FLAGS_POOL index
+  uint32_t numConstants;
+
+  bin_label_t *labels; // the LABELS table, aligned
+  size_t numLabels;
+
+  // the DATA table, the LABELS table and then the IMPORTS, in the order
+  // they are stored
+  program_static_t *statics;
+  size_t numStatics;
+} program_t;
+
+// with one reference, held by the caller. NULL, with `*error` set, if the
+// file is not a valid image (see image_open) or imports a function no
+// module loaded with extension_load has with the signature it was
+// compiled for. such an error is valid until the next call on the thread.
+program_t *program_create(const ubyte_t *file, size_t len, const char **error);
+program_t *program_retain(program_t *program);
+// frees the program with the last reference
+void program_release(program_t *program);
+
+// stores the static data, then the label addresses, to $d of `rt`. this
+// is the work the loads at the beginning of a flat stream do when they
+// run. entries whose slot is past the end of $d are skipped, as are pool
+// entries whose index is out of range.
+void program_load(const program_t *program, runtime_t *rt);
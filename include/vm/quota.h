@@ -0,0 +1,102 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+// per-runtime memory accounting, so the runtimes of a worker pool can be
+// limited one by one, see runtime_setMemoryLimit. what a runtime's heap
+// takes from the system -- its slabs, and the blocks too large for one --
+// and the refcounted buffers made for it are charged to its quota when
+// they are allocated and credited when they are freed. a charge is an
+// atomic add: slabs are taken SLAB_BYTES at a time, under the heap lock
+// already, and buffers are one malloc each anyway.
+//
+// past `soft`, the quota is `pressed`, which the collector takes as a
+// reason for a full collection, and a heap_compact to give back the slabs
+// it empties. past `hard`, a buffer is not allocated (rc_alloc returns
+// NULL, and the builtin throws), while the heap, which cannot fail an
+// allocation, goes over and sets `exceeded`: the interpreter throws at the
+// next tick, see runtime_checkMemory.
+//
+// quotas live in a fixed table, each buffer's header holding its index,
+// so a buffer that outlives its runtime (a shared one, say) is credited
+// to the right one: a slot is only given out again once it was released
+// and nothing is charged to it any more.
+#define QUOTA_MAX 4096 // slot 0 is none, see rc_header_t
+
+typedef struct quota {
+  atomic_size_t used; // bytes
+  size_t soft; // 0: no limit
+  size_t hard;
+  atomic_bool pressed; // went past `soft` since the collector last looked
+  atomic_bool exceeded; // went past `hard` since the interpreter last looked
+  bool live; // between quota_acquire and quota_release, under the table's lock
+} quota_t;
+
+extern quota_t quotas[QUOTA_MAX];
+
+// a slot with no limits, NULL if every one is taken
+quota_t *quota_acquire();
+void quota_release(quota_t *q);
+
+static inline uint32_t quota_id(const quota_t *q) {
+  return q != NULL ? (uint32_t)(q - quotas) : 0;
+}
+
+// what a quota takes past its soft limit, see above
+static inline void quota_crossed(quota_t *q, size_t before, size_t after) {
+  if (q->soft != 0 && before < q->soft && after >= q->soft) {
+    atomic_store_explicit(&q->pressed, true, memory_order_relaxed);
+  }
+}
+
+// charges `bytes`, unless that would take it past the hard limit: false
+// then, with nothing charged
+static inline bool quota_charge(quota_t *q, size_t bytes) {
+  size_t before;
+
+  if (q == NULL) {
+    return true;
+  }
+
+  before = atomic_fetch_add_explicit(&q->used, bytes, memory_order_relaxed);
+
+  if (q->hard != 0 && before + bytes > q->hard) {
+    atomic_fetch_sub_explicit(&q->used, bytes, memory_order_relaxed);
+    return false;
+  }
+
+  quota_crossed(q, before, before + bytes);
+
+  return true;
+}
+
+// charges `bytes` for what is allocated regardless; past the hard limit,
+// `exceeded` is set
+static inline void quota_force(quota_t *q, size_t bytes) {
+  size_t before;
+
+  if (q == NULL) {
+    return;
+  }
+
+  before = atomic_fetch_add_explicit(&q->used, bytes, memory_order_relaxed);
+
+  if (q->hard != 0 && before + bytes > q->hard) {
+    atomic_store_explicit(&q->exceeded, true, memory_order_relaxed);
+  }
+
+  quota_crossed(q, before, before + bytes);
+}
+
+static inline void quota_credit(quota_t *q, size_t bytes) {
+  if (q != NULL) {
+    atomic_fetch_sub_explicit(&q->used, bytes, memory_order_relaxed);
+  }
+}
+
+static inline size_t quota_used(quota_t *q) {
+  return q != NULL ? atomic_load_explicit(&q->used, memory_order_relaxed) : 0;
+}
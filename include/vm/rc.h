@@ -3,39 +3,102 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <assert.h>
+
+#include <vm/quota.h>
 
-typedef void * rcmap_key_t;
 typedef void * refcounted_t;
 
-//! https://github.com/petewarden/c_hashmap/blob/master/hashmap.c
-
-#define RC_INITIAL_SIZE (256)
-#define RC_MAX_CHAIN_LENGTH (8)
-#define RC_MAP_MISSING -3
-#define RC_MAP_FULL -2
-#define RC_MAP_OMEM -1
-#define RC_MAP_OK 0
-
-typedef struct {
-  rcmap_key_t key;
-  bool used;
-  size_t count; // payload
-} rcentry_t;
-
-typedef struct {
-  size_t tableSize;
-  size_t size;
-  rcentry_t *data;
-} rcmap_t;
-
-uint32_t rcmap_hashInt(rcmap_t *map, rcmap_key_t key);
-
-rcmap_t *rcmap_create();
-void rcmap_destroy(rcmap_t *map);
-
-int rcmap_hash(rcmap_t *map, rcmap_key_t key);
-int rcmap_rehash(rcmap_t *map);
-int rcmap_put(rcmap_t *map, rcmap_key_t key, size_t count);
-int rcmap_getPtr(rcmap_t *map, rcmap_key_t key, size_t **out);
-int rcmap_get(rcmap_t *map, rcmap_key_t key, size_t *out);
-int rcmap_remove(rcmap_t *map, rcmap_key_t key);
+// a refcounted payload (see FLAG_REFCOUNTED) is preceded by its header,
+// so claiming or releasing a reference is an increment or a decrement in
+// place. a header is 16 bytes, keeping the payload aligned like malloc's.
+//
+// a buffer belongs to the runtime that made it, and its count is a plain
+// one. rc_share makes it immutable and shared instead: from then on the
+// count is changed atomically, so any thread may hold references, and
+// nothing writes into the payload (see builtins_range). that is how a
+// large read-only input goes to every task or channel receiver without a
+// copy.
+//
+// each header also records where the buffer was made, for
+// runtime_heapCensus: the code offset of the builtin's call, see
+// runtime_site, 0 if not known, and the quota it is charged to, see
+// vm/quota.h, which a shared buffer stays charged to until it is freed.
+typedef struct rc_header {
+  uint32_t count; // references; the payload is freed when this drops to 0
+  uint32_t site;
+  uint64_t size : 51; // of the payload, in bytes
+  uint64_t quota : 12; // index into quotas, 0 if none
+  uint64_t shared : 1; // set by rc_share, never cleared
+} rc_header_t;
+
+#define RC_HEADER(rc) ((rc_header_t*)(rc) - 1)
+
+// `size` bytes with no references yet, uninitialized, made at `site` and
+// charged, with the header, to `quota` (NULL for none); NULL if out of
+// memory, or past the quota's hard limit
+refcounted_t rc_alloc(quota_t *quota, size_t size, uint32_t site);
+// the same, charged by quota_force, for a caller that cannot fail: past
+// the hard limit, the quota is `exceeded` instead
+refcounted_t rc_allocOver(quota_t *quota, size_t size, uint32_t site);
+// buffers rc_alloc returned so far, in the whole process
+size_t rc_allocated();
+
+static inline refcounted_t rc_claim(refcounted_t rc) {
+  rc_header_t *header = RC_HEADER(rc);
+
+  if (header->shared) {
+    __atomic_fetch_add(&header->count, 1, __ATOMIC_RELAXED);
+  } else {
+    ++header->count;
+  }
+
+  return rc;
+}
+
+static inline void rc_release(refcounted_t rc) {
+  rc_header_t *header = RC_HEADER(rc);
+  uint32_t count;
+
+  if (header->shared) {
+    // the last reference sees the others' reads done
+    count = __atomic_fetch_sub(&header->count, 1, __ATOMIC_ACQ_REL);
+  } else {
+    count = header->count--;
+  }
+
+  assert(count > 0);
+
+  if (count == 1) {
+    if (header->quota != 0) {
+      quota_credit(&quotas[header->quota], sizeof(rc_header_t) + header->size);
+    }
+
+    free(header);
+  }
+}
+
+static inline size_t rc_size(refcounted_t rc) {
+  return RC_HEADER(rc)->size;
+}
+
+// what it is charged to, NULL if nothing
+static inline quota_t *rc_quota(refcounted_t rc) {
+  return RC_HEADER(rc)->quota != 0 ? &quotas[RC_HEADER(rc)->quota] : NULL;
+}
+
+static inline uint32_t rc_site(refcounted_t rc) {
+  return RC_HEADER(rc)->site;
+}
+
+static inline bool rc_isShared(refcounted_t rc) {
+  return RC_HEADER(rc)->shared;
+}
+
+// makes `rc` immutable and shared, see rc_header_t. called by the thread
+// that holds every reference, before another one can see the buffer; a
+// buffer an aio read is filling cannot be shared.
+static inline refcounted_t rc_share(refcounted_t rc) {
+  RC_HEADER(rc)->shared = 1;
+  return rc;
+}
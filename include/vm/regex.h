@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include <vm/types.h>
+
+// regular expressions, for the regexCompile, regexMatch and regexFind
+// builtins, matched in time linear in the text as RE2 does. a pattern is
+// compiled to a Thompson NFA, which is run as a DFA built lazily: a state,
+// a set of the NFA's, is made the first time it is reached and kept, with
+// its transitions a byte class at a time, for the next match. patterns are
+// compiled once per runtime, cached by their interned text.
+//
+// the syntax is the common part of POSIX extended and Perl's: literals,
+// `.` (any byte but a newline), [classes] with ranges and [^negation], the
+// escapes \d \w \s and their negations, \t \n \r \f \v, \xHH and escaped
+// punctuation, groups, (?:groups), `|`, `*`, `+`, `?`, and {m}, {m,} and
+// {m,n} up to REGEX_MAX_REPEAT. ^ and $ are the start and end of the text
+// matched. it is bytes that are matched: a multibyte utf-8 character in a
+// pattern is a sequence of them, and `.` one byte. there are no captures
+// or backreferences, which a DFA cannot follow, and matches are
+// leftmost-longest (POSIX), so a lazy quantifier is as the greedy one.
+#define REGEX_MAX_REPEAT 1000
+#define REGEX_MAX_DEPTH 256 // groups and quantifiers nested
+#define REGEX_MAX_INSTRUCTIONS 65536
+// the states a DFA keeps; past this, they are dropped and built again as
+// they are reached
+#define REGEX_MAX_STATES 2048
+
+typedef struct regexp regexp_t;
+typedef struct regexes regexes_t;
+
+regexes_t *regex_createCache();
+void regex_destroyCache(regexes_t *cache);
+
+// the compiled form of the `len` bytes at `pattern`, from the runtime's
+// cache, compiled into it the first time. NULL, with `*error` a constant
+// saying why, if the pattern is malformed; that is cached too. the text
+// interned by runtime_intern is the fastest to look up.
+regexp_t *regex_get(runtime_t *rt, const char *pattern, size_t len, const char **error);
+// the pattern's interned text
+const char *regex_pattern(const regexp_t *re);
+
+// the length of the longest match at the start of the `len` bytes at `s`,
+// -1 if there is none
+int64_t regex_match(regexp_t *re, const uint8_t *s, size_t len);
+// the offset of the leftmost match in them, -1 if there is none. as RE2
+// does it: a DFA whose states keep the threads started at each byte apart,
+// earliest first, finds where the leftmost-longest match ends, and one of
+// the pattern backwards, run back from there, where it starts.
+int64_t regex_find(regexp_t *re, const uint8_t *s, size_t len);
@@ -4,21 +4,314 @@
 #include <vm/heap.h>
 #include <vm/rc.h>
 #include <vm/except.h>
+#include <vm/image.h>
+#include <vm/intern.h>
+#include <vm/output.h>
+#include <vm/scratch.h>
+#include <vm/arena.h>
+
+#include <shared/builtins.h>
+
+#include <pthread.h>
+#include <setjmp.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+// background collection, see runtime_collector: the collector thread
+// wakes every RUNTIME_GC_INTERVAL_MS, and stops the mutators at a
+// safepoint for a collection when
+// - the old generation holds at least `gcThreshold` nodes: a full one.
+//   the threshold is reset to twice the surviving nodes, and never goes
+//   below RUNTIME_GC_MIN_NODES.
+// - otherwise, the nursery holds at least RUNTIME_GC_NURSERY_NODES: a
+//   minor one, see heap_markRemembered.
+// the dead nodes are finalized on the collector thread once the mutators
+// run again, see heap_finalize. after a full collection, if that leaves
+// the heap fragmented, it stops them once more for heap_compact.
+//
+// a runtime with a memory limit also collects, in full, and compacts once
+// its quota went past the soft limit, see runtime_setMemoryLimit.
+//
+// with a budget set (see runtime_setGcBudget), a full collection stops
+// them for about that long at a time instead: once to push the roots,
+// then for slices of incremental marking (see heap_markBegin), one every
+// budget, until nothing is left to trace. a last pause marks the roots
+// again and traces what the write barrier marked meanwhile; both
+// generations are swept with the mutators running. no minor collection
+// runs until then, what is allocated meanwhile going to the old one. nor
+// does heap_compact, at all.
+#define RUNTIME_GC_INTERVAL_MS 10
+#define RUNTIME_GC_MIN_NODES 4096
+#define RUNTIME_GC_NURSERY_NODES 4096
+// nodes traced between looks at the clock, in a slice of marking
+#define RUNTIME_GC_MARK_BATCH 256
+// ticks at most between looks at the quota, with a hard memory limit
+#define RUNTIME_MEMORY_SLICE 1024
 
 typedef struct runtime runtime_t;
 
+// where runtime_throwException goes on: set up by interpreter_run, and
+// each run nested in it, around the code it runs
+typedef struct runtime_catch {
+  jmp_buf env;
+  struct runtime_catch *previous; // of the run this one is nested in
+  const image_t *image; // whose try regions it catches in
+  // set by the throw: what was thrown, the region catching it and the
+  // frame the region is in -- its frame pointer, and the stack length
+  // and the offset after the call it was at
+  exception_t exception;
+  bin_try_t region;
+  uint64_t fp;
+  uint64_t top;
+  uint64_t pc;
+} runtime_catch_t;
+
+// where a run that cannot go on ends -- a runtime error, an exception
+// nothing caught, or a call of `exit` -- when a host runs programs for
+// others on the runtime, as vm --serve does: see runtime_fatal
+#define RUNTIME_FATAL_MESSAGE 512
+
+typedef struct runtime_fatal {
+  jmp_buf env;
+  int status; // what the process would have exited with
+  char message[RUNTIME_FATAL_MESSAGE]; // what it would have printed to stderr; "" for `exit`
+} runtime_fatal_t;
+
 struct runtime {
   datatable_t *dt;
   heap_t *heap;
-  rcmap_t *rc;
+
+  uint32_t epoch; // bumped whenever a native writes through a pointer, see jit_memoLookup
+
+  pthread_mutex_t gcLock; // guards the fields below, other than gcRequested
+  pthread_cond_t gcCond; // signalled whenever any of them changes
+  atomic_bool gcRequested; // set while the collector waits for, or runs with, the mutators stopped
+  bool gcStop; // runtime_stopCollector was called
+  uint32_t gcMutators; // threads between runtime_attach and runtime_detach
+  uint32_t gcParked; // of those, the ones waiting in runtime_park
+  size_t gcThreshold;
+  uint64_t gcBudgetNs; // 0, or a full collection is incremental, see runtime_setGcBudget
+
+  pthread_mutex_t internLock; // guards `interned`, which any mutator may add to
+  intern_table_t interned;
+
+  const struct snapshot *snapshot; // set for vm --snapshot, see _System_snapshot
+  const char *input; // the job being run under vm --workers, see _System_input
+
+  output_t output; // for OP_PRINT, to stdout
+  struct aio *aio; // started by the first asynchronous read or write, see vm/aio.h
+  struct fibers *fibers; // created by the first OP_SPAWN, see vm/fiber.h
+  struct net *net; // created by the first fiber parked on a socket, see vm/net.h
+  struct program *program; // the one interpreted on it, which tasks run too
+  scratch_t scratch; // objects that do not outlive their basic block, see vm/scratch.h
+  arena_t arena; // the @arena scopes open, see vm/arena.h
+  struct tasks *tasks; // started by the first taskSpawn, see vm/task.h
+  struct regexes *regexes; // made by the first pattern matched, see vm/regex.h
+  struct calls *calls; // with vm --trace-calls, the OP_CALLs timed, see vm/calls.h; otherwise NULL
+  struct interpreter *traced; // with vm --trace-ring, whose ring _System_traceDump writes; otherwise NULL
+  runtime_catch_t *catcher; // of the innermost interpreter_run, NULL outside of one
+  runtime_fatal_t *fatal; // set by the host around a run, see runtime_fatal; NULL to exit
+  native_function_t hosts[BUILTIN_HOST_COUNT]; // stored by builtins_register, see embed_register
+
+  // the execution budget, see runtime_setBudget
+  uint64_t budget;
+  uint64_t slice;
+  int64_t fuel; // ticks left until runtime_refuel, counted down by the interpreter
+  int64_t fuelStart; // what `fuel` was given
+  uint64_t used; // ticks this run, as of the last runtime_refuel
+  bool exhausted; // the run was stopped with the budget used up
+
+  quota_t *quota; // what its memory is charged to, see runtime_setMemoryLimit; NULL if none was left
+  bool overLimit; // the run was stopped past the hard memory limit
+
+  // instructions run while counting, see runtime_countBegin
+  int counting; // runtime_countBegin less runtime_countEnd
+  uint64_t counted;
+  const void *countFrom; // the instruction_t the interpreter went on at last
+
+  // collections so far, guarded by the heap lock, see runtime_getStats
+  size_t gcFullCount;
+  size_t gcMinorCount;
+  uint64_t gcPauseTotalNs;
+  uint64_t gcPauseMaxNs;
 };
 
+// a snapshot of the runtime's memory use, see runtime_getStats
+typedef struct runtime_stats {
+  size_t nodesAllocated; // heap nodes (objects) ever allocated
+  size_t nodesLive; // in both generations, as of the last flush
+  size_t nodesYoung; // of those, in the nursery
+  size_t nodesFinalized; // destroyed by heap_finalize
+  size_t nodesPending; // swept, waiting for heap_finalize
+  size_t slabBytes; // reserved for nodes and objects
+
+  size_t gcFullCount;
+  size_t gcMinorCount;
+  // time the mutators were stopped for, including reaching a safepoint
+  uint64_t gcPauseTotalNs;
+  uint64_t gcPauseMaxNs;
+
+  size_t stackResidentBytes; // see datatable_residentBytes
+  size_t staticDataResidentBytes;
+
+  size_t memoryUsed; // charged to the runtime's quota, see runtime_setMemoryLimit
+  size_t memorySoft;
+  size_t memoryHard;
+
+  size_t rcAllocated; // refcounted buffers, process-wide, see rc_allocated
+  size_t internedStrings;
+  size_t internTableSize; // entries; the load factor is internedStrings / this
+} runtime_stats_t;
+
+// with the default STATIC_DATA_COUNT and STACK_COUNT slots
 runtime_t *runtime_create();
+// with room for `staticDataCount` $d and `stackCount` $l slots, see datatable_create
+runtime_t *runtime_createSized(size_t staticDataCount, size_t stackCount);
 void runtime_destroy(runtime_t *r);
+// takes the runtime back to its state once `program` was loaded on it
+// (NULL for none), for another run: releases the datatable's values and
+// fibers, destroys every heap node without a collection (see heap_clear)
+// and every scratch object, and stores the builtins and the program's
+// static data to $d again. the cost follows what the last run used, not
+// the size of the storages. interned strings, the task pool, the output
+// and the budget are kept, the ticks used starting again from none.
+// called on the thread attached to the runtime, between runs.
+void runtime_reset(runtime_t *r, const struct program *program);
+
+// execution budgets: the interpreter counts a tick at every taken jump and
+// every OP_CALL, so any loop ticks. a run, until runtime_reset, may take
+// `budget` ticks (0: no limit); past that it stops, and interpreter_run
+// returns with `exhausted` set, or the process exits where OP_HALT would
+// (see interpreter_t.haltExits). a fiber that ran `slice` ticks (0: no
+// limit) yields to the next runnable one, as with OP_YIELD. compiled code
+// does not tick, so a runtime with either limit compiles neither OP_JIT
+// regions nor hot loops. tasks run on runtimes of their own, unlimited.
+void runtime_setBudget(runtime_t *r, uint64_t budget, uint64_t slice);
+// called by the interpreter once `fuel` runs out: counts the ticks, and
+// gives it the next slice. false once the budget is used up.
+bool runtime_refuel(runtime_t *r);
+static inline bool runtime_isBudgeted(const runtime_t *r) {
+  return r->budget != 0 || r->slice != 0;
+}
+
+// memory limits, in bytes (0: none), on what the runtime's heap and
+// buffers take, see vm/quota.h. past `soft`, the collector runs a full
+// collection and compacts the heap. past `hard`, an allocation of a
+// buffer fails, its builtin throwing, and once the heap itself went past,
+// the interpreter throws "memory limit exceeded" within
+// RUNTIME_MEMORY_SLICE ticks (see runtime_checkMemory); a run that does
+// not catch it stops, with `overLimit` set, as one out of budget does. so
+// a runtime with a hard limit is metered, and compiles nothing. tasks run
+// on runtimes of their own, unlimited. set between runs, as the budget,
+// whose ticks used it starts again from none. false if the runtime has
+// no quota.
+bool runtime_setMemoryLimit(runtime_t *r, size_t soft, size_t hard);
+static inline bool runtime_isMemoryLimited(const runtime_t *r) {
+  return r->quota != NULL && r->quota->hard != 0;
+}
+// called by the interpreter at a tick, with VM_PROGRAM_COUNTER there,
+// once the quota's `exceeded` is set: clears it and throws, going on at
+// the handler. returns if nothing catches it, with `overLimit` set, for
+// the run to stop.
+void runtime_checkMemory(runtime_t *r);
+
+// counts from now on, into `counted`, the instructions the interpreter
+// runs, for the benchStep builtin: fuel is given one tick at a time, so
+// the interpreter stops at each, and adds the instructions from where it
+// went on at the last one, none of them a taken jump or a call. the count
+// is only right as a difference of two taken at the same instruction.
+// nested calls count once; runtime_reset ends them all.
+void runtime_countBegin(runtime_t *r);
+void runtime_countEnd(runtime_t *r);
+
+// compiled code neither ticks nor times its calls, so it is only run
+// without a budget or a hard memory limit, without `calls` and while not
+// counting
+static inline bool runtime_compiles(const runtime_t *r) {
+  return !runtime_isBudgeted(r) && !runtime_isMemoryLimited(r) && r->calls == NULL && r->counting == 0;
+}
 
+// CLOCK_MONOTONIC, in nanoseconds
+uint64_t runtime_nowNs();
+
+// marks, sweeps and finalizes right away; the caller makes sure no mutator runs
 void runtime_gc(runtime_t *r);
+// the same, for the nursery only -- unless incremental marking is under
+// way, which it then ends with a full collection
+void runtime_gcMinor(runtime_t *r);
+// `budgetNs` (0: none, the default) for the collector to keep its pauses
+// for a full collection to, by marking incrementally; a pause still takes
+// as long as the mutators need to reach a safepoint, and at least one
+// RUNTIME_GC_MARK_BATCH. the last one, and those of minor collections,
+// grow with the roots and the nursery rather than the heap.
+void runtime_setGcBudget(runtime_t *r, uint64_t budgetNs);
+
+// a thread runs code on the runtime's data between these two calls, and
+// reaches runtime_safepoint regularly while it does. attaching can be done
+// on the thread's behalf before it starts, and waits out a collection
+// that is running; detaching is done by the thread.
+void runtime_attach(runtime_t *r);
+void runtime_detach(runtime_t *r);
+// waits there while a collection is requested or running
+void runtime_park(runtime_t *r);
+
+// the interpreter calls this at taken jumps and at OP_CALL; the values it
+// holds are all in the datatable there, which is where marking starts.
+// compiled regions and traces call it at OP_CALL only.
+static inline void runtime_safepoint(runtime_t *r) {
+  if (atomic_load_explicit(&r->gcRequested, memory_order_relaxed)) {
+    runtime_park(r);
+  }
+}
+
+// the collector loop, run on its own thread until runtime_stopCollector
+void runtime_collector(runtime_t *r);
+void runtime_stopCollector(runtime_t *r);
+// in the child of a fork taken by an attached thread once the collector
+// thread was stopped and joined: no thread but the caller's was carried
+// over, so the collector's state starts again from none attached, for a
+// new collector thread. the old generation is left for the next full
+// collection to mark once it doubled, as marking writes to every node,
+// copying the pages the child still shares with its parent.
+void runtime_afterFork(runtime_t *r);
+
+// the canonical copy of `len` bytes at `str`, valid until runtime_destroy.
+// object member keys are compared by pointer, so the builtins pass keys
+// through here first.
+const char *runtime_intern(runtime_t *r, const char *str, size_t len);
+
+void runtime_getStats(runtime_t *r, runtime_stats_t *out);
+
+// what the heap holds, written to `f`, see vm/census.h; with a
+// `graphPath`, the object graph as well, to that file. the caller is
+// either the one mutator, which then is not running, as in a builtin, or
+// (`stop`) a thread that is not attached, for which the mutators are
+// stopped at a safepoint meanwhile, as for a collection. false, after
+// printing why, if the graph cannot be written.
+bool runtime_heapCensus(runtime_t *r, FILE *f, const char *graphPath, bool stop);
 
-void runtime_throwException(runtime_t *r, exception_t *e);
+// the allocation site of a buffer a builtin makes, see rc_alloc: the
+// offset after the OP_CALL, which the interpreter writes back before it
+static inline uint32_t runtime_site(const runtime_t *r) {
+  return (uint32_t)VM_PROGRAM_COUNTER(r->dt);
+}
 
-refcounted_t runtime_claim(runtime_t *rt, rcmap_key_t key);
-void runtime_release(runtime_t *rt, refcounted_t rc);
+// table based exceptions: code in a try region (see BIN_SECTION_TRIES)
+// runs as any other until something is thrown. then the region around
+// the call being made is looked up, and, if there is none, the region
+// around the call of its function, out through the frames. once one is
+// found this does not return: the interpreter pops the frames above the
+// region's, releases the values on the stack back to the depth it was
+// entered with, moves the exception's argument to $r[0] and goes on at
+// the handler. false, having changed nothing, if nothing catches it --
+// nor outside of interpreter_run, as in the region an aot program starts
+// with.
+bool runtime_throwException(runtime_t *r, exception_t *e);
+// ends the run for good, the output flushed first: with `fatal` set,
+// longjmps there with `status` and the message, which `fmt` (NULL for
+// none) formats; otherwise prints the message to stderr and exits with
+// `status`. the run is left where it was, on the runtime and any
+// interpreter running on it, so a host destroys them rather than run on
+// them again.
+void runtime_fatal(runtime_t *r, int status, const char *fmt, ...);
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include <shared/builtins.h>
+
+// byte scanning for tokenizers: the index of the first of `len` bytes that
+// is (`match`) or is not (!`match`) in the character class `cls`, one of
+// BUILTIN_SCAN_CLASSES; `len` if there is none. the classes are ASCII
+// only, as the ASCII fast path of bcparse's SourceStream::peek: bytes of a
+// multibyte utf-8 sequence are in none of them.
+// 16 bytes are tested at a time with SSE2 or NEON, where available.
+size_t scan_find(const uint8_t *data, size_t len, int cls, bool match);
+
+// whether `c` is in the class, as scan_find tests it
+static inline bool scan_inClass(uint8_t c, int cls) {
+  switch (cls) {
+    case BUILTIN_SCAN_SPACE: return c == ' ' || (uint8_t)(c - '\t') <= '\r' - '\t';
+    case BUILTIN_SCAN_DIGIT: return (uint8_t)(c - '0') <= 9;
+    case BUILTIN_SCAN_IDENT: return (uint8_t)(c - '0') <= 9 || (uint8_t)((c | 0x20) - 'a') <= 25 || c == '_';
+    case BUILTIN_SCAN_STRING_END: return c == '"' || c == '\\' || c == '\n';
+    default: return false;
+  }
+}
+
+// number parsing for tokenizers, of all `len` bytes: false, with `*out`
+// untouched, if they are not exactly one number. scan_parseInt takes an
+// optional sign and decimal digits, and fails on overflow rather than
+// wrapping. scan_parseDouble takes what strtod does in decimal, "inf" and
+// "nan" as OP_PRINT writes them, but no hex or leading space. both read
+// eight digits at a time where they can; a double of at most 19
+// significant digits and a small exponent is exact in one multiply or
+// divide (Clinger's fast path), and the rest goes to strtod.
+bool scan_parseInt(const uint8_t *data, size_t len, int64_t *out);
+bool scan_parseDouble(const uint8_t *data, size_t len, double *out);
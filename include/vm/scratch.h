@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include <vm/types.h>
+#include <vm/heap.h>
+
+// objects bcparse proved not to escape the basic block creating them (see
+// BytecodeChunk::scratchObjects): BUILTIN_SYSTEM_CREATE_SCRATCH_OBJECT
+// allocates them here instead of on the heap, and
+// BUILTIN_SYSTEM_SCRATCH_RELEASE, once all of the block's are dead, frees
+// every one at once. the collector never sweeps them, but marks through
+// the live ones like any other object, so what their members reference
+// stays alive. the nodes are kept for reuse, and only ever freed with the
+// runtime, so a register still pointing at a released one points at a
+// node without an object, which heap_mark skips.
+// one per runtime; with fibers running, objects go to the heap instead.
+typedef struct scratch {
+  heap_value_t **nodes;
+  size_t len; // in use, since the last scratch_release
+  size_t size;
+} scratch_t;
+
+void scratch_init(scratch_t *scratch);
+void scratch_destroy(scratch_t *scratch);
+
+// an empty object, as value_createObject
+value_t scratch_alloc(scratch_t *scratch, heap_t *heap);
+// destroys every object allocated since the last call
+void scratch_release(scratch_t *scratch);
+// clears the marks a collection left on the nodes, as the sweep does for
+// those in the heap; with the heap locked
+void scratch_unmark(scratch_t *scratch);
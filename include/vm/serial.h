@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include <vm/types.h>
+#include <vm/value.h>
+#include <vm/rc.h>
+
+typedef uint8_t ubyte_t;
+
+// a value and everything it reaches as bytes that refer to nothing in the
+// runtime, for the `serialize` and `deserialize` builtins: to keep a cache
+// on disk, or to move a parsed structure through a channel (see channel.h)
+// as one buffer rather than member by member. unlike a snapshot (see
+// snapshot.h), it is not tied to the program: constants are copied out.
+//
+// objects, arrays, maps and refcounted buffers are written once each, in
+// the order a breadth-first walk finds them, and referred to by index
+// after that, so sharing and cycles come back as they were. the graph is
+// walked twice, once to size the output and once to fill it, so it is
+// written into one buffer with no reallocation; typed arrays are copied
+// as they are. member names are written once too, and referred to by
+// index in every object after the first that has them.
+//
+// layout, unaligned, in the byte order of the machine: the header, the
+// value, then the contents of each node in index order. a value is a
+// SERIAL_TAGS byte and what it says follows; object members are a key
+// (a u32 index, then a u32 length and the name if it is a new one) and a
+// value, map entries a u32 length, the key and a value.
+//
+// natives other than builtins, raw pointers, and streams, asynchronous
+// requests, tasks and channels are written as none.
+#define SERIAL_MAGIC "BB8V"
+#define SERIAL_VERSION 1
+
+enum SERIAL_TAGS {
+  SERIAL_NONE = 0,
+  SERIAL_BITS = 1, // a u32 metadata and the u64 data: scalars and inline data
+  SERIAL_BYTES = 2, // a u32 length and the bytes: constants and slices, copied
+  SERIAL_BUFFER = 3, // a refcounted buffer, new: a u64 size and the bytes
+  SERIAL_NODE = 4, // a node, new: its HEAP_KIND, ARRAY_KIND and a u64 count
+  SERIAL_REF = 5, // a u64 index of a buffer or node written before
+  SERIAL_BUILTIN = 6 // a u32 BUILTIN_C_FUNCTIONS slot
+};
+
+typedef struct serial_header {
+  uint8_t magic[4];
+  uint32_t version;
+  uint64_t numItems; // buffers and nodes
+  uint64_t numKeys;
+} serial_header_t;
+
+// a new buffer (from rc_alloc, not claimed yet) holding `v`; NULL if out
+// of memory
+refcounted_t serial_write(runtime_t *rt, value_t *v);
+
+// the value `len` bytes at `data` hold, built on the runtime's heap, into
+// `out`. false, with `out` none, if they are not what serial_write made;
+// the nodes built up to there are left to the collector.
+bool serial_read(runtime_t *rt, const ubyte_t *data, size_t len, value_t *out);
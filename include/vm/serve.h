@@ -0,0 +1,83 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+  #define SERVE_SUPPORTED 1
+#else
+  #define SERVE_SUPPORTED 0
+#endif
+
+#include <vm/output.h>
+
+// vm --serve: a server that runs programs for clients, each request on a
+// connection of its own. a request is a line, "<name> [input]", the input
+// being what `input` returns; the reply is what the program prints, then
+// the connection is closed. "put <hash> <size>" sends a program to keep
+// and run as "#<hash>", see serve_worker.
+//
+// anyone who can connect can run code, so by default the server listens
+// on a Unix socket or on a loopback address only: listening on any other
+// takes `remote` (--allow-remote). a <name> is a file under `root`
+// (--root), a relative path that may not leave it; without a root, only
+// programs sent with "put" are run.
+//
+// a run that ends on a runtime error, an exception nothing caught or a
+// call of `exit` ends its request, with "error: <name>: ..." after what it
+// printed, and not the server, see runtime_fatal. a task it started runs
+// on a runtime of its own, on another thread, and a task's failure still
+// ends the process.
+#define SERVE_MAX_REQUEST 4096 // bytes of a request line, with the newline
+#define SERVE_BACKLOG 64
+#define SERVE_MAX_PROGRAM ((size_t)1 << 30) // bytes of a program sent with "put"
+// milliseconds a request line may take to arrive, and each read of a
+// program sent with "put" may wait, before the connection is dropped
+#define SERVE_TIMEOUT_MS 10000
+
+typedef struct server server_t;
+
+// how each worker's runtime is set up, as --input's are: see
+// runtime_setBudget, runtime_setGcBudget and runtime_setMemoryLimit
+typedef struct serve_options {
+  output_mode_t outputMode;
+  uint64_t budget;
+  uint64_t slice;
+  uint64_t gcBudget; // nanoseconds
+  uint64_t memorySoft;
+  uint64_t memoryHard;
+  bool hugePages;
+  const char *root; // the directory <name>s are in, or NULL
+  bool remote; // listen on addresses other than loopback ones
+} serve_options_t;
+
+// listening on `addr`, a Unix socket or "host:port" for TCP, where an
+// empty host or "*" is any address. NULL, with a message, if it cannot
+// be bound, or if it is not a loopback address and `options->remote` is
+// not set.
+server_t *serve_open(const char *addr, const serve_options_t *options);
+// a worker, the body of a thread: takes connections until accept fails,
+// serving one at a time on a runtime of its own. the caller starts as
+// many as it wants, pinned as it wants.
+void *serve_worker(void *server);
+// once the workers are done: closes the socket and frees the programs
+void serve_close(server_t *server);
+
+// vm --input <list> --nodes <addr,...>: the jobs run on servers instead
+// of here, sent the program with "put". as for listening, the nodes must
+// be Unix sockets or loopback addresses unless `remote` (--allow-remote)
+// is set: the coordinator would otherwise hand a program, and the jobs'
+// input, to whoever answers at the address.
+typedef struct serve_nodes {
+  const char *addrs; // comma-separated, each as serve_open takes it
+  size_t perNode; // connections to each, --workers
+  bool remote;
+  bool stats; // what each node ran and took, to stderr
+} serve_nodes_t;
+
+// runs `program` once for each of the `numJobs` lines of `jobs`, each
+// node's replies written to stdout, and their failures to stderr by the
+// job's line, as --input workers would. false if some were not run: a
+// node that is not allowed, or every node having failed.
+bool serve_coordinate(const void *program, size_t len, const char **jobs, size_t numJobs, const serve_nodes_t *nodes);
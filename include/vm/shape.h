@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// keys are compared by pointer, not by content: equal names have to be
+// the same string, which runtime_intern makes them.
+typedef char * object_key_t;
+
+// the layout objects share (a hidden class): which member is stored at
+// which index of an object's dense slot array. shapes form a tree from an
+// empty root, a child adding one member to its parent, so objects that
+// get the same members in the same order end up with the same shape and
+// a call site can cache (shape, slot) for a member. shapes are never
+// freed before the tree is: see shape_destroyTree.
+#define SHAPE_MAX_MEMBERS 32 // objects with more switch to a hash table
+
+typedef struct shape shape_t;
+
+struct shape {
+  shape_t *parent; // NULL for the root
+  object_key_t key; // the member this shape adds to its parent
+  uint32_t slot; // where that member is, parent->count
+  uint32_t count; // members in the shape
+  shape_t *children; // published with release stores, see shape_findChild
+  shape_t *sibling;
+};
+
+shape_t *shape_createRoot(void);
+void shape_destroyTree(shape_t *root);
+
+// slot of `key` in `shape`, -1 if it has no such member
+int32_t shape_lookup(const shape_t *shape, object_key_t key);
+
+// the child of `shape` that adds `key`, NULL if there is none yet.
+// safe to call while another thread adds children.
+shape_t *shape_findChild(shape_t *shape, object_key_t key);
+// creates that child; the caller serializes additions to one tree
+shape_t *shape_addChild(shape_t *shape, object_key_t key);
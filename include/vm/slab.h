@@ -0,0 +1,83 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include <vm/quota.h>
+
+// size-class allocator for the small, fixed-size blocks the heap is made
+// of: heap nodes, objects and their initial member tables.
+// blocks are carved out of SLAB_BYTES slabs, and freed blocks go onto a
+// free list per class that later allocations take from first, so nodes
+// swept by heap_sweep are reused in place. slabs are only returned to
+// the system by slab_destroy, and by slab_endEvacuation once empty.
+// requests above SLAB_MAX_SIZE go to malloc / free.
+// not synchronized; a heap takes from its slab under heap_lock, in
+// batches for each thread's buffer (see HEAP_TLAB_BATCH).
+// slabs are aligned to SLAB_BYTES, so a block's slab, and the count of
+// blocks handed out of it, is found from the block's address.
+// the slabs, and the blocks from malloc, are charged to `quota`, if set,
+// by quota_force: the heap does not fail an allocation.
+#define SLAB_MIN_SIZE 32
+#define SLAB_MAX_SIZE 256
+#define SLAB_CLASSES 4 // 32, 64, 128, 256
+#define SLAB_BYTES 16384
+
+typedef struct slab slab_t;
+
+// class of a block of `size` bytes, SLAB_CLASSES if it is too big
+static inline unsigned slab_classOf(size_t size) {
+  unsigned c = 0;
+  size_t blockSize = SLAB_MIN_SIZE;
+
+  while (c < SLAB_CLASSES && blockSize < size) {
+    blockSize <<= 1;
+    ++c;
+  }
+
+  return c;
+}
+
+static inline size_t slab_classSize(unsigned c) {
+  return (size_t)SLAB_MIN_SIZE << c;
+}
+
+typedef struct slab_allocator {
+  void *free[SLAB_CLASSES]; // next free block of each class, linked through its first word
+  slab_t *slabs;
+  size_t numSlabs; // SLAB_BYTES each
+  size_t usedBytes; // of the blocks handed out, by their class's size
+  quota_t *quota; // NULL for none; kept by slab_destroy
+
+  // set aside between slab_beginEvacuation and slab_endEvacuation: the
+  // free blocks of the slabs being evacuated, and those of the others
+  void *evacuated[SLAB_CLASSES];
+  void *kept[SLAB_CLASSES];
+} slab_allocator_t;
+
+void slab_init(slab_allocator_t *a);
+void slab_destroy(slab_allocator_t *a);
+
+// uninitialized; NULL if out of memory
+void *slab_alloc(slab_allocator_t *a, size_t size);
+// zeroed, like calloc
+void *slab_calloc(slab_allocator_t *a, size_t size);
+// `size` must be the one the block was allocated with
+void slab_free(slab_allocator_t *a, void *ptr, size_t size);
+
+// the share of the slabs' bytes not handed out, in percent
+unsigned slab_freePercent(const slab_allocator_t *a);
+
+// compaction, see heap_compact. evacuating starts with the slabs less
+// than half used: the free blocks of those, and the ones freed into them
+// until slab_endEvacuation, are set aside, and so are the free blocks of
+// the rest. what is allocated meanwhile is carved out of new slabs, in
+// the order it is asked for, for the caller to move blocks into.
+void slab_beginEvacuation(slab_allocator_t *a);
+// whether `ptr`, a block of `size`, is in a slab being evacuated
+bool slab_isEvacuating(const void *ptr, size_t size);
+// frees the slabs being evacuated that no block is left in, and puts the
+// free blocks set aside back, after what is left of the new slabs'.
+// returns the number of slabs freed.
+size_t slab_endEvacuation(slab_allocator_t *a);
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <vm/image.h>
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+typedef uint8_t ubyte_t;
+typedef struct runtime runtime_t;
+struct code;
+
+// the state of a program at a marked point, saved to a file so another
+// process can continue from there instead of redoing the setup before it:
+// vm --snapshot runs the program until it calls the `snapshot` builtin,
+// writes the file and exits; vm --restore loads the same program, maps the
+// file and resumes right after that call, which then returns true.
+// (without either flag, the call returns false and the program goes on.)
+// vm --prefork forks there instead, each child going on as if restored.
+//
+// saved are the four storages ($d up to its last touched slot, $l up to
+// the stack pointer) and, by value, everything on the heap they reach:
+// objects, arrays, maps and refcounted buffers, keeping their sharing.
+// constant pool pointers are saved as pool offsets and builtins by slot.
+// what only makes sense in the one process is saved as null -- natives
+// that are not builtins (compiled regions are set again when their OP_JIT
+// runs) and raw pointers, streams and asynchronous requests, such as open
+// files -- with a warning for the latter. the compare flags are not saved.
+#define SNAPSHOT_MAGIC "BB8S"
+#define SNAPSHOT_VERSION 1
+
+typedef struct snapshot {
+  const char *path; // written by the `snapshot` builtin; NULL unless --snapshot
+  void (*fork)(runtime_t *rt); // called by it instead, under vm --prefork; returns in each child
+  const image_t *image; // the program, which a snapshot is only good for
+  const struct code *code; // decoded from it
+} snapshot_t;
+
+// false, with `*error` set, if the file could not be written or the
+// program has spawned fibers that were not joined yet
+bool snapshot_write(runtime_t *rt, const snapshot_t *snapshot, const char **error);
+
+// restores the state saved in `len` bytes at `data` into `rt`, which has
+// just loaded the program of `snapshot` (see interpreter_create), and
+// places VM_PROGRAM_COUNTER after the call that saved it, with true as
+// the call's result in $r[0]. false, with `*error` set, if the file is
+// not a snapshot of this program or is malformed, in which case the state
+// may be partially restored.
+bool snapshot_restore(runtime_t *rt, const snapshot_t *snapshot, const ubyte_t *data, size_t len,
+                      const char **error);
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include <vm/types.h>
+#include <vm/value.h>
+#include <vm/array.h>
+
+// sorting arrays in place, for the sort and sortBy builtins. typed arrays
+// are radix sorted: their numbers are turned into unsigned integers that
+// order as they do (a double's bits with the sign flipped, or all of them
+// for a negative one), sorted a byte at a time from the lowest, skipping
+// the bytes every element shares, and turned back. ARRAY_BYTES is counted.
+// ARRAY_VALUES, and what is shorter than SORT_RADIX_MIN, is sorted by
+// pattern-defeating quicksort (pdqsort): quicksort that takes its pivot
+// from the median of three or of nine, finishes in linear time on input
+// already sorted or in few runs, and turns to heapsort on input that
+// keeps making bad pivots, so it is never worse than n log n.
+#define SORT_RADIX_MIN 256
+// elements from which a radix sort's passes are split over threads, each
+// counting and moving its part; there are BB8_SORT_THREADS of them, or as
+// many as there are processors, up to SORT_MAX_THREADS
+#define SORT_PARALLEL_MIN (1 << 20)
+#define SORT_MAX_THREADS 16
+
+// the order values are sorted in: none, then booleans (false first), then
+// numbers of any type by their value, doubles' NaN after the rest, then
+// strings bytewise, then everything else by its address. -1, 0 or 1.
+int sort_compare(value_t *a, value_t *b);
+
+// sorts the elements of `array`, of any kind. a radix sort that cannot
+// have the memory it moves elements into is pdqsort instead, which needs
+// none.
+void sort_array(array_t *array);
+
+// sorts the ARRAY_VALUES `array` by `keys`, the key of each of its
+// elements in order, as sort_compare orders them. stable: elements with
+// equal keys keep their order. false if out of memory; the array is left
+// as it was.
+bool sort_byKeys(array_t *array, value_t *keys);
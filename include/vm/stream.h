@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include <vm/types.h>
+#include <vm/value.h>
+
+// a file read through one reusable buffer, so memory stays constant however
+// large the file is. the FILE is unbuffered: stdio would only add a copy.
+#define STREAM_BUFFER_SIZE (64 * 1024)
+#define STREAM_ALIGN 64 // of the buffer, which the vectorized scans read
+
+typedef struct {
+  FILE *fp; // NULL once closed
+  uint8_t *buf; // `capacity` bytes, and one more for stream_readLine's NUL
+  size_t capacity; // grows only for a line longer than it
+  size_t pos; // the next unread byte in `buf`
+  size_t len; // bytes in `buf`
+  bool eof;
+  void *map; // the file, once stream_map made a mapping of it
+  size_t mapLen;
+} stream_t;
+
+// NULL if the file cannot be opened
+stream_t *stream_open(const char *path);
+// closes the file and releases the buffer and the mapping; reads give
+// nothing afterwards. safe to call more than once.
+void stream_close(stream_t *stream);
+
+// a new heap node holding a stream_t, which it owns. defined next to
+// value_createObject, in value.c.
+value_t value_createStream(runtime_t *rt, heap_t *heap, stream_t *stream);
+
+// a native_function_t used as the dtor_ptr on heap node
+void stream_destructor(runtime_t *rt, args_t *args);
+
+// up to `size` bytes into `dst`: what is buffered, then straight from the
+// file. less than `size` only at the end of the file.
+size_t stream_read(stream_t *stream, void *dst, size_t size);
+
+// the next line, without its '\n', or NULL past the last. it is
+// terminated in place in the buffer rather than copied, so it is only
+// good until the next read from the stream.
+const char *stream_readLine(stream_t *stream, size_t *len);
+
+// the whole file, mapped read-only, or NULL if it cannot be mapped (it is
+// not a regular file, or the platform has no mmap). owned by the stream.
+const void *stream_map(stream_t *stream, size_t *len);
+
+// in bytes, -1 if unknown (e.g a pipe)
+int64_t stream_size(stream_t *stream);
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#include <vm/types.h>
+#include <vm/value.h>
+#include <vm/array.h>
+
+// tasks: code of the program run in parallel with it, on a pool of
+// threads. `taskSpawn label, arg` queues the code at `label` with `arg` in
+// $r[1], and returns a future; `taskJoin future` waits for the task to
+// halt and returns its $r[0]; `taskDone future` polls.
+//
+// a runtime is single threaded, so each pool thread runs its tasks on
+// runtimes of its own, sharing the program. only values that refer to
+// neither runtime's heap cross between them: scalars, constants, strings,
+// which are copied unless they are shared (see rc.h), and channels (see
+// channel.h). shared buffers and channels are referenced by the task.
+// objects, arrays and the like arrive as none.
+// the static data a task stores to stays on the runtime it ran on.
+//
+// each thread has a Chase-Lev deque of the tasks it spawned: it pushes
+// and takes at the bottom, others steal from the top. a spawn goes to the
+// spawning thread's deque, and an idle thread steals one at random, so
+// divide and conquer spreads over the pool by itself. a join waiting for
+// a task runs others meanwhile: the awaited task itself if nobody has
+// taken it, otherwise its own tasks, then stolen ones. those run on a
+// runtime one level deeper, where their own joins can do the same, down
+// to TASKS_MAX_DEPTH levels; past that a join only waits.
+//
+// the thread that spawns first is the pool's first worker, and the pool
+// has BB8_TASK_WORKERS threads in all (the number of online cpus by
+// default). it is stopped when that runtime is destroyed; queued tasks
+// that did not start by then never run.
+//
+// `parallelMap array, fn` and `parallelReduce array, fn, init` cut the
+// array into slices of TASKS_SLICE_MIN elements or more, at most
+// TASKS_SLICES_PER_WORKER for each thread, and run each slice as a task,
+// calling `fn` once per element on the runtime the slice runs on. `fn` is
+// a label, whose code is called like a task's (its arguments from $r[1]
+// on, the result in $r[0] when it halts), or a native function. elements
+// and results cross as task arguments do.
+//
+// `parallelFor start, end, fn, reduction` calls `fn` on each int of
+// [start, end) the same way, cut into slices of one index or more, as
+// many as parallelMap's at most: a loop's body may take long for each.
+// the results are added up by `reduction`: "sum", of those that are
+// numbers, an int unless one was a double; "count", of those that are
+// true or nonzero; or none, for nothing. lib/parallel.bb8's @parallel_for
+// outlines a body into such a label.
+#define TASKS_MAX_DEPTH 32
+#define TASKS_MAX_WORKERS 64
+#define TASKS_STEAL_ROUNDS 64 // attempts at each victim before an idle thread sleeps
+#define TASKS_DEQUE_INITIAL_CAP 64
+#define TASKS_SLICE_MIN 256
+#define TASKS_SLICES_PER_WORKER 4
+
+typedef struct runtime runtime_t;
+typedef struct tasks tasks_t;
+typedef struct task_slice task_slice_t;
+struct channel;
+
+typedef enum tasks_reduction {
+  TASKS_REDUCE_NONE = 0,
+  TASKS_REDUCE_SUM = 1,
+  TASKS_REDUCE_COUNT = 2
+} tasks_reduction_t;
+
+typedef enum task_state {
+  TASK_QUEUED = 0, // in a deque, not started
+  TASK_RUNNING = 1,
+  TASK_DONE = 2 // `result` is set
+} task_state_t;
+
+// a value copied between runtimes, see task_t
+typedef struct task_value {
+  value_t value;
+  char *copy; // a string's bytes, NUL terminated, which `value` borrows; or NULL
+  size_t size; // of `copy`, without the NUL
+  struct channel *channel; // referenced, `value` is none: each runtime gets a node for it
+} task_value_t;
+
+typedef struct task {
+  atomic_int state; // a task_state_t; TASK_QUEUED -> TASK_RUNNING by whoever runs it
+  atomic_uint refs; // its future, and the deque until it is taken out
+
+  uint64_t pc; // where it starts
+  task_value_t arg; // $r[1], on the runtime it runs on
+  task_value_t result; // its $r[0] when it halted
+  task_slice_t *slice; // for parallelMap and parallelReduce, else NULL
+} task_t;
+
+// queues a task to run the code at `pc` with `arg`, starting the pool of
+// `rt` if this is its first. NULL if the calling thread is not one of the
+// pool's, which only spawns from the thread that started it and its own.
+task_t *tasks_spawn(runtime_t *rt, uint64_t pc, value_t *arg);
+bool tasks_done(task_t *task);
+// waits for the task, running others meanwhile; the result is borrowed
+// from the task, and stays valid while it is referenced. a channel gets a
+// new node on the heap of `rt`. `rt` is the
+// runtime the join runs on, which reaches runtime_safepoint while it waits.
+value_t tasks_join(runtime_t *rt, task_t *task);
+// `out` is a new array of `fn` called on each element of `in`, of the same
+// kind. false if the pool cannot be used from this thread.
+bool tasks_map(runtime_t *rt, array_t *in, const value_t *fn, value_t *out);
+// `out` is `fn` folded over `in` starting from `init`: each slice is folded
+// from its first element, with the accumulator as the first argument and
+// the element as the second, then the slices' results in order, so `fn`
+// has to be associative. false if the pool cannot be used from this thread.
+bool tasks_reduce(runtime_t *rt, array_t *in, const value_t *fn, const value_t *init, value_t *out);
+// `out` is the results of `fn` called on each int in [start, end), added
+// up by `reduction`; none for TASKS_REDUCE_NONE. false if the pool cannot
+// be used from this thread.
+bool tasks_for(runtime_t *rt, int64_t start, int64_t end, const value_t *fn, tasks_reduction_t reduction,
+               value_t *out);
+// stops the pool's threads, once they finish the tasks they are running,
+// and destroys their runtimes
+void tasks_destroy(tasks_t *tasks);
+
+// a new heap node holding a reference to `task`, its future. defined next
+// to value_createObject, in value.c.
+value_t value_createTask(runtime_t *rt, heap_t *heap, task_t *task);
+
+// a native_function_t used as the dtor_ptr on heap node
+void task_destructor(runtime_t *rt, args_t *args);
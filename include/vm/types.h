@@ -4,12 +4,15 @@ typedef struct runtime runtime_t;
 typedef struct value value_t;
 typedef struct heap_value heap_value_t;
 typedef struct heap heap_t;
+typedef struct object object_t;
 
 typedef struct storage storage_t;
 
 typedef struct args {
   storage_t *_stack;
+  value_t *_registers; // $r[1] when arguments are passed in registers, else NULL
   void *_rawData;
+  value_t **_operands; // each argument, with CALL_FLAGS_OPERANDS, else NULL
 } args_t;
 
 typedef uint32_t metadata_t;
@@ -1,5 +1,57 @@
 #pragma once
 
 #include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
 
 uint32_t hash6432shift(uint64_t key);
+
+// FNV-1a over `size` bytes, continuing from `hash` (HASH_BYTES_INIT to start)
+#define HASH_BYTES_INIT 0xCBF29CE484222325ULL
+uint64_t hashBytes64(const void *data, size_t size, uint64_t hash);
+
+// wyhash (its final version, with seed 0): 16 bytes per multiply-fold,
+// in three independent lanes of 48-byte blocks on longer input, and well
+// mixed in every bit, where FNV-1a takes a multiply per byte and mixes its
+// low bits poorly. the content hash of maps, interned strings and hash64.
+uint64_t hashString64(const void *data, size_t size);
+
+// hashString64 of the bytes given to hashstream_update in turn, for input
+// that comes in pieces. whole 48-byte blocks go into the lanes as they
+// are complete; the bytes past the last of them are held back, with the
+// 16 before them, for hashString64 finishes on those.
+#define HASHSTREAM_MAGIC 0x6D61657274736877ULL
+typedef struct hashstream {
+  uint64_t magic; // HASHSTREAM_MAGIC, for the hashCreate builtin to check
+  uint64_t lanes[3];
+  uint64_t size; // given so far
+  uint32_t pending; // bytes held back, after the 16 before them
+  uint8_t buffer[16 + 48];
+} hashstream_t;
+
+void hashstream_init(hashstream_t *h);
+void hashstream_update(hashstream_t *h, const void *data, size_t size);
+// the hash of what was given so far; more can be given after
+uint64_t hashstream_digest(const hashstream_t *h);
+
+// CRC-32C (Castagnoli) of `size` bytes, continuing from `crc` (0 to
+// start). with the SSE4.2 or ARMv8 CRC instructions, taken as three
+// interleaved streams and combined on longer input where the processor
+// has them, else eight bytes at a time from tables.
+uint32_t hashCrc32c(uint32_t crc, const void *data, size_t size);
+
+// pointers given an index, as a walk of the heap finds them (see
+// snapshot.c and serial.c): open addressing, with 0 for a free entry.
+// zeroed to start.
+typedef struct idmap {
+  uintptr_t *keys;
+  uint64_t *ids;
+  size_t size; // a power of two
+  size_t count;
+} idmap_t;
+
+// the index of `ptr`, with `*added` set if it is new and given `next`
+uint64_t idmap_id(idmap_t *t, const void *ptr, uint64_t next, bool *added);
+// forgets every pointer, keeping the memory
+void idmap_clear(idmap_t *t);
+void idmap_destroy(idmap_t *t);
@@ -2,8 +2,10 @@
 
 #include <vm/rc.h>
 #include <vm/types.h>
+#include <vm/shape.h>
 
 #include <stdint.h>
+#include <stddef.h>
 #include <stdbool.h>
 
 typedef enum {
@@ -22,9 +24,26 @@ typedef enum {
   FLAG_OBJECT = 0x2,
   FLAG_EXCEPTION = 0x4,
   FLAG_MALLOC = 0x8, // raw pointer that needs free() call
-  FLAG_REFCOUNTED = 0x10
+  FLAG_REFCOUNTED = 0x10,
+  FLAG_CONST = 0x20, // borrowed from the constant pool -- immutable, never freed; copy it to write
+  FLAG_OLD = 0x40, // heap node that survived a collection, see heap_sweepYoung
+  FLAG_REMEMBERED = 0x80, // old heap node in the remembered set, see heap_writeBarrier
+  FLAG_INLINE = 0x100, // bytes stored in the value itself, see value_setData
+  FLAG_ARRAY = 0x200, // with FLAG_OBJECT: the heap node holds an array_t, see value_createArray
+  FLAG_MAP = 0x400, // with FLAG_OBJECT: the heap node holds a map_t, see value_createMap
+  FLAG_STREAM = 0x800, // with FLAG_OBJECT: the heap node holds a stream_t, see value_createStream
+  FLAG_AIO = 0x1000, // with FLAG_OBJECT: the heap node holds an aio_request_t, see value_createAio
+  FLAG_TASK = 0x2000, // with FLAG_OBJECT: the heap node holds a task_t, see value_createTask
+  FLAG_CHANNEL = 0x4000, // with FLAG_OBJECT: the heap node holds a channel_t, see value_createChannel
+  FLAG_SLICE = 0x8000, // with FLAG_REFCOUNTED: part of the buffer, see value_setSlice
+  FLAG_CACHE = 0x8000, // with FLAG_OBJECT, the same bit: the heap node holds a cache_t, see value_createCache
+  FLAG_SOCKET = 0x1800 // with FLAG_OBJECT, FLAG_STREAM and FLAG_AIO both: a net_socket_t, see value_createSocket
 } VALUE_FLAGS;
 
+// raw data shorter than this is kept inline (with a NUL after it) by
+// value_setData, rather than in a refcounted buffer
+#define VALUE_INLINE_SIZE 8
+
 typedef struct value {
   union {
     int64_t i64;
@@ -37,11 +56,58 @@ typedef struct value {
     refcounted_t rc;
   } data;
 
-  metadata_t metadata;
+  metadata_t metadata; // see VALUE_METADATA
+  uint32_t aux; // a slice's offset, see value_setSlice; in what was padding
 } value_t;
 
+// the type is in the low 8 bits of `metadata`, the flags in the 16 above
+// and a slice's length in the 8 above them.
+// everything else goes through these rather than the field's bits, so the
+// encoding is spelled out here only.
+//
+// this is an accessor layer, not a choice of representation: a value_t
+// is 16 bytes, and there is no NaN-boxed 8-byte build. integer opcodes
+// work on all 64 bits of data.i64, and programs rely on that width, which
+// a tag in the payload would take from them; the 16 flags, a slice's
+// length and `aux` would not fit beside a pointer either. outside
+// value.c, `metadata` and `aux` are read and written only through the
+// macros here. the native backends address the fields at
+// VALUE_DATA_OFFSET and VALUE_META_OFFSET, and a slot at
+// index << VALUE_SIZE_LOG2.
+#define VALUE_DATA_OFFSET offsetof(value_t, data)
+#define VALUE_META_OFFSET offsetof(value_t, metadata)
+#define VALUE_SIZE_LOG2 4
+_Static_assert(sizeof(value_t) == (size_t)1 << VALUE_SIZE_LOG2, "value_t is 16 bytes, see VALUE_SIZE_LOG2");
+
+#define VALUE_METADATA(type, flags) ((metadata_t)(type) | ((metadata_t)(flags) << 8))
+#define VALUE_META(v) ((v)->metadata)
+#define VALUE_TYPE_OF(v) ((VALUE_TYPE)((v)->metadata & 0xFF))
+#define VALUE_SET_META(v, type, flags) ((v)->metadata = VALUE_METADATA(type, flags))
+// exactly `type` with `flags`
+#define VALUE_IS(v, type, flags) ((v)->metadata == VALUE_METADATA(type, flags))
+// `type` with every flag in `flags` set (and possibly others)
+#define VALUE_HAS(v, type, flags) \
+  (((v)->metadata & VALUE_METADATA(type, flags)) == VALUE_METADATA(type, flags))
+
 void value_destroy(runtime_t *rt, value_t *value);
+
+// set on values that may own memory; only pointers get either flag
+#define VALUE_OWNING_FLAGS VALUE_METADATA(TYPE_NONE, FLAG_REFCOUNTED | FLAG_MALLOC)
+// whether `v` may own memory, which value_destroy would free
+#define VALUE_OWNS(v) ((VALUE_META(v) & VALUE_OWNING_FLAGS) != 0)
+
+// value_destroy, skipped after a single test for the values that cannot
+// own anything: scalars, objects, constants and inline data
+static inline void value_release(runtime_t *rt, value_t *value) {
+  if (VALUE_OWNS(value)) {
+    value_destroy(rt, value);
+  }
+}
 void value_copyValue(runtime_t *rt, value_t *v, value_t *other);
+// as value_copyValue, but `v` takes the reference `other` holds rather
+// than claiming one of its own, and `other` is left as none. nothing if
+// both are the same slot.
+void value_moveValue(runtime_t *rt, value_t *v, value_t *other);
 void value_setInt(runtime_t *rt, value_t *v, int64_t i64);
 int64_t value_getInt(value_t *v);
 value_t value_fromInt(int64_t i64);
@@ -55,11 +121,35 @@ void value_setBoolean(runtime_t *rt, value_t *v, bool b);
 bool value_getBoolean(value_t *v);
 value_t value_fromBoolean(bool b);
 value_t value_createObject(runtime_t *rt, heap_t *heap);
+// see object_createWithCapacity
+value_t value_createObjectWithCapacity(runtime_t *rt, heap_t *heap, uint32_t capacity);
+// an object of `shape`, see object_createShaped
+value_t value_createShapedObject(runtime_t *rt, heap_t *heap, shape_t *shape);
+// a shallow copy of `object`, see object_clone
+value_t value_createObjectClone(runtime_t *rt, heap_t *heap, object_t *object);
 heap_value_t *value_getHeapNode(value_t *value);
 void *value_getRawPointer(value_t *value);
 void value_setRawPointer(runtime_t *rt, value_t *v, void *raw, VALUE_FLAGS flags);
 value_t value_fromRawPointer(void *raw, VALUE_FLAGS flags);
+// claims `ptr`, which comes from rc_alloc
 void value_setRefCounted(runtime_t *rt, value_t *v, void *ptr);
+// a slice holds the buffer it is part of, in `data` as the buffer itself
+// would be, so copies and releases of it count references to the buffer
+// as they would for the whole. value_getRawPointer points at the part.
+// the part starts at `aux` and is up to VALUE_SLICE_MAX bytes long,
+// which leaves a slice of a string no larger than the value.
+#define VALUE_SLICE_MAX 255
+#define VALUE_IS_SLICE(v) VALUE_HAS(v, TYPE_POINTER, FLAG_REFCOUNTED | FLAG_SLICE)
+#define VALUE_SLICE_LENGTH(v) ((size_t)((v)->metadata >> 24))
+#define VALUE_SLICE_OFFSET(v) ((size_t)(v)->aux)
+// a slice of `length` bytes at `offset` into the refcounted buffer `rc`,
+// claimed. the range must be within the buffer, and `length` at most
+// VALUE_SLICE_MAX.
+void value_setSlice(runtime_t *rt, value_t *v, refcounted_t rc, uint32_t offset, size_t length);
+// a private copy of `size` bytes: inline if there is room, refcounted
+// otherwise. value_getRawPointer on an inline value points into the value
+// itself, so it is only good while the value stays where it is.
+void value_setData(runtime_t *rt, value_t *v, const void *data, size_t size);
 value_t value_fromFunction(native_function_t fn);
 void value_setFunction(runtime_t *rt, value_t *v, native_function_t fn);
 VALUE_TYPE value_getType(value_t *value);
@@ -68,3 +158,11 @@ VALUE_FLAGS value_getFlags(value_t *value);
 void value_setFlag(value_t *value, VALUE_FLAGS flag, int state);
 uintptr_t value_getID(value_t *value);
 value_t value_invoke(runtime_t *r, value_t *value);
+// arguments are in $r[1] .. $r[n] rather than on the stack (CALL_FLAGS_REGISTER_ARGS)
+value_t value_invokeWithRegisters(runtime_t *r, value_t *value);
+// argument `index` of a native call, 0 being the first operand, $r[1] or
+// the top of the stack
+value_t *args_getArg(args_t *args, size_t index);
+// whether args_getArg(args, index) is there to read: an operand past those
+// passed reads as none, but one on the stack may be past its bottom
+bool args_hasArg(args_t *args, size_t index);
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// numeric kernels over the unboxed elements of ARRAY_I64 / ARRAY_F64
+// arrays, for the vec* builtins. with GCC or clang they work on 32 bytes
+// at a time through vector extensions, which compile to SSE / AVX / NEON
+// instructions as the target allows, even in a debug build; the tail, or
+// everything on other compilers, is a scalar loop.
+// the reductions keep one partial result per lane, so a double sum is
+// not necessarily the same as adding the elements in order.
+
+// elementwise over `n` elements; `dst` may be one of the operands.
+// fma is a * b + c.
+void vector_addI64(int64_t *dst, const int64_t *a, const int64_t *b, size_t n);
+void vector_mulI64(int64_t *dst, const int64_t *a, const int64_t *b, size_t n);
+void vector_fmaI64(int64_t *dst, const int64_t *a, const int64_t *b, const int64_t *c, size_t n);
+int64_t vector_dotI64(const int64_t *a, const int64_t *b, size_t n);
+int64_t vector_sumI64(const int64_t *a, size_t n);
+// `n` must not be 0
+int64_t vector_minI64(const int64_t *a, size_t n);
+int64_t vector_maxI64(const int64_t *a, size_t n);
+
+void vector_addF64(double *dst, const double *a, const double *b, size_t n);
+void vector_mulF64(double *dst, const double *a, const double *b, size_t n);
+void vector_fmaF64(double *dst, const double *a, const double *b, const double *c, size_t n);
+double vector_dotF64(const double *a, const double *b, size_t n);
+double vector_sumF64(const double *a, size_t n);
+double vector_minF64(const double *a, size_t n);
+double vector_maxF64(const double *a, size_t n);
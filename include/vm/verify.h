@@ -0,0 +1,37 @@
+#pragma once
+
+#include <vm/code.h>
+
+#include <stdint.h>
+
+// load-time proof that a decoded program, started at offset 0 with
+// an empty stack, can run without the interpreter's bounds checks:
+// - every operand resolves inside its storage, for every stack depth
+//   the instruction can be reached with
+// - the stack depth at each instruction is the same along all paths,
+//   and stays below the stack's slot count
+// - every jump goes through a label slot -- an absolute $d location
+//   loaded once with a u64 before the first branch, and never written
+//   again by reachable code -- that holds an instruction boundary.
+// - the handler of a try region, an instruction boundary too, is reached
+//   with the depth the region is entered with, see interpreter_catch
+// native functions are assumed to leave the stack depth unchanged.
+typedef enum {
+  VERIFY_OK = 0,
+  VERIFY_BAD_OPERAND, // obj_loc_t out of range for its storage
+  VERIFY_BAD_JUMP, // target not a label slot, or not an instruction boundary
+  VERIFY_STACK_OVERFLOW,
+  VERIFY_STACK_UNDERFLOW,
+  VERIFY_STACK_MISMATCH, // paths reach an instruction with different depths
+  VERIFY_DYNAMIC_STACK // storage lengths ($vm[1] .. $vm[4]) written directly, or frames (OP_FCALL, OP_RET, $f[])
+} VERIFY_RESULT;
+
+// on failure, `*failOffset` (if not NULL) is set to the byte offset of
+// the offending instruction.
+// only code reached from offset 0 is proven, and decoded from its segments
+VERIFY_RESULT verify_code(code_t *code, uint32_t *failOffset);
+// the same proof for code started at byte offset `offset`, with an empty
+// stack and only the image's LABELS table in place -- the body of a task,
+// see vm/task.h. VERIFY_BAD_JUMP if no instruction starts there.
+VERIFY_RESULT verify_entry(code_t *code, uint64_t offset, uint32_t *failOffset);
+const char *verify_resultString(VERIFY_RESULT result);
@@ -0,0 +1,573 @@
+// bclink: links the objects `bcparse --object` writes into one program
+// for the vm. see BIN_SECTION_SYMBOLS and BIN_SECTION_RELOCS.
+
+#include <shared/bin_format.h>
+
+#include <common/clarg.hpp>
+
+#include <vector>
+#include <string>
+#include <utility>
+#include <map>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+using Result = std::pair<bool, std::string>;
+
+// the vm's builtins take the $d slots below this, see STATIC_DATA_RESERVED.
+// they are the same in every object. objects before version 7 have their
+// own data from 128, and call none of the builtins past the host slots.
+static const uint32_t firstStaticSlot = 256;
+static const uint32_t firstStaticSlotV6 = 128;
+
+struct Symbol {
+  std::string name;
+  bin_symbol_t entry;
+};
+
+struct Object {
+  std::string path;
+  std::vector<uint8_t> code;
+  std::vector<std::vector<uint8_t>> constants;
+  std::vector<uint32_t> constantAligns; // each one's bin_const_t.align
+  std::vector<bin_data_t> data;
+  std::vector<bin_label_t> labels;
+  std::vector<Symbol> symbols;
+  std::vector<bin_reloc_t> relocs;
+  std::vector<bin_try_t> tries;
+  std::vector<uint8_t> debug;
+  std::vector<bin_line_t> lineRanges;
+  std::vector<bin_trace_t> traces;
+  std::vector<uint8_t> traceStrings;
+  bool relocatable = false; // has BIN_SECTION_RELOCS
+  uint32_t firstSlot = firstStaticSlot; // where its own $d slots start
+
+  uint64_t codeBase = 0; // where its code starts in the program
+  std::map<uint32_t, uint32_t> slots; // its $d slots to the program's
+  std::vector<uint32_t> pool; // its pool indices to the program's
+};
+
+template <typename T>
+static std::vector<T> readTable(const uint8_t *data, size_t size) {
+  std::vector<T> out(size / sizeof(T));
+
+  if (!out.empty()) {
+    std::memcpy(out.data(), data, out.size() * sizeof(T));
+  }
+
+  return out;
+}
+
+static Result readObject(const std::string &path, Object &out) {
+  std::ifstream in(path, std::ios::in | std::ios::binary);
+
+  if (!in.is_open()) {
+    return { false, "Could not open file: " + path };
+  }
+
+  const std::vector<uint8_t> file((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  const std::string invalid = path + ": not an object";
+  bin_header_t header;
+
+  if (file.size() < sizeof(header)) {
+    return { false, invalid };
+  }
+
+  std::memcpy(&header, file.data(), sizeof(header));
+
+  if (std::memcmp(header.magic, BIN_MAGIC, BIN_MAGIC_SIZE) != 0 || header.version == 0 ||
+      header.version > BIN_VERSION ||
+      file.size() < sizeof(header) + header.numSections * sizeof(bin_section_t)) {
+    return { false, invalid };
+  }
+
+  out.path = path;
+  out.firstSlot = header.version <= 6 ? firstStaticSlotV6 : firstStaticSlot;
+
+  for (size_t i = 0; i < header.numSections; i++) {
+    bin_section_t section;
+    std::memcpy(&section, file.data() + sizeof(header) + i * sizeof(bin_section_t), sizeof(section));
+
+    if (section.offset > file.size() || section.size > file.size() - section.offset) {
+      return { false, invalid };
+    }
+
+    const uint8_t *data = file.data() + section.offset;
+
+    switch (section.kind) {
+      case BIN_SECTION_CODE:
+        // relocations patch fields of a fixed size
+        if (section.flags != 0) {
+          return { false, path + ": compact or compressed code, not an object" };
+        }
+
+        out.code.assign(data, data + section.size);
+        break;
+      case BIN_SECTION_CONST:
+        for (size_t pos = 0; pos < section.size;) {
+          bin_const_t entry = { };
+
+          if (section.flags & BIN_CONST_IN_PLACE) {
+            if (section.size - pos < sizeof(entry)) {
+              return { false, invalid };
+            }
+
+            std::memcpy(&entry, data + pos, sizeof(entry));
+            pos += sizeof(entry);
+
+            // the padding, and the NUL after the bytes
+            if (entry.padding > section.size - pos || entry.size >= section.size - pos - entry.padding) {
+              return { false, invalid };
+            }
+
+            pos += entry.padding;
+          } else {
+            if (section.size - pos < sizeof(entry.size)) {
+              return { false, invalid };
+            }
+
+            std::memcpy(&entry.size, data + pos, sizeof(entry.size));
+            pos += sizeof(entry.size);
+
+            if (entry.size > section.size - pos) {
+              return { false, invalid };
+            }
+          }
+
+          out.constants.emplace_back(data + pos, data + pos + entry.size);
+          out.constantAligns.push_back(entry.align);
+          pos += entry.size + ((section.flags & BIN_CONST_IN_PLACE) ? 1 : 0);
+        }
+
+        break;
+      case BIN_SECTION_DATA:
+        out.data = readTable<bin_data_t>(data, section.size);
+        break;
+      case BIN_SECTION_LABELS:
+        out.labels = readTable<bin_label_t>(data, section.size);
+        break;
+      case BIN_SECTION_TRIES:
+        out.tries = readTable<bin_try_t>(data, section.size);
+        break;
+      case BIN_SECTION_DEBUG:
+        out.debug.assign(data, data + section.size);
+        break;
+      case BIN_SECTION_LINES: {
+        bin_lines_t lines;
+
+        if (section.size < sizeof(lines)) {
+          return { false, invalid };
+        }
+
+        std::memcpy(&lines, data, sizeof(lines));
+
+        const size_t rangesSize = (size_t)lines.numRanges * sizeof(bin_line_t);
+        const size_t tracesSize = (size_t)lines.numTraces * sizeof(bin_trace_t);
+
+        if (rangesSize + tracesSize > section.size - sizeof(lines)) {
+          return { false, invalid };
+        }
+
+        out.lineRanges = readTable<bin_line_t>(data + sizeof(lines), rangesSize);
+        out.traces = readTable<bin_trace_t>(data + sizeof(lines) + rangesSize, tracesSize);
+        out.traceStrings.assign(data + sizeof(lines) + rangesSize + tracesSize, data + section.size);
+        break;
+      }
+      case BIN_SECTION_SYMBOLS:
+        for (size_t pos = 0; pos < section.size;) {
+          Symbol symbol;
+
+          if (section.size - pos < sizeof(symbol.entry)) {
+            return { false, invalid };
+          }
+
+          std::memcpy(&symbol.entry, data + pos, sizeof(symbol.entry));
+          pos += sizeof(symbol.entry);
+
+          if (symbol.entry.nameLength > section.size - pos) {
+            return { false, invalid };
+          }
+
+          symbol.name.assign((const char*)data + pos, symbol.entry.nameLength);
+          pos += symbol.entry.nameLength;
+
+          out.symbols.push_back(symbol);
+        }
+
+        break;
+      case BIN_SECTION_RELOCS:
+        out.relocs = readTable<bin_reloc_t>(data, section.size);
+        out.relocatable = true;
+        break;
+      default:
+        // segments and sites do not survive linking
+        break;
+    }
+  }
+
+  if (!out.relocatable) {
+    return { false, path + ": not an object, compile it with --object" };
+  }
+
+  for (const bin_reloc_t &reloc : out.relocs) {
+    if (reloc.offset > out.code.size() || out.code.size() - reloc.offset < sizeof(uint32_t)) {
+      return { false, invalid };
+    }
+  }
+
+  return { true, "" };
+}
+
+// the objects' code one after the other, the first one's where the
+// program starts, with their static data and constants merged
+class Linker {
+public:
+  Linker() : m_nextSlot(firstStaticSlot) {}
+
+  Result link(std::vector<Object> &objects) {
+    std::map<std::string, uint32_t> exported; // name to the program's slot
+
+    for (Object &object : objects) {
+      place(object);
+
+      for (const Symbol &symbol : object.symbols) {
+        if (!(symbol.entry.flags & BIN_SYMBOL_EXPORT)) {
+          continue;
+        }
+
+        if (exported.count(symbol.name)) {
+          return { false, object.path + ": '" + symbol.name + "' is exported by another object as well" };
+        }
+
+        // usually the slot of a label already, if it is only read
+        const bool placed = object.slots.count(symbol.entry.slot) != 0;
+        const uint32_t slot = mapSlot(object, symbol.entry.slot);
+
+        if (!placed) {
+          m_labels.push_back({ slot, 0, object.codeBase + symbol.entry.offset });
+        }
+
+        exported[symbol.name] = slot;
+      }
+    }
+
+    for (Object &object : objects) {
+      for (const Symbol &symbol : object.symbols) {
+        if (symbol.entry.flags & BIN_SYMBOL_EXPORT) {
+          continue;
+        }
+
+        auto it = exported.find(symbol.name);
+
+        if (it == exported.end()) {
+          return { false, object.path + ": '" + symbol.name + "' is not exported by any object" };
+        }
+
+        object.slots[symbol.entry.slot] = it->second;
+      }
+    }
+
+    for (Object &object : objects) {
+      Result r = relocate(object);
+
+      if (!r.first) {
+        return r;
+      }
+    }
+
+    return { true, "" };
+  }
+
+  void write(std::ostream &os) const {
+    std::vector<uint8_t> constants;
+
+    // laid out in place, as bcparse lays them out
+    for (size_t i = 0; i < m_constants.size(); i++) {
+      bin_const_t entry = { };
+      entry.size = m_constants[i].size();
+      entry.align = m_constantAligns[i];
+
+      if (entry.align > 1) {
+        entry.padding = (uint32_t)((entry.align - (constants.size() + sizeof(entry)) % entry.align) % entry.align);
+      }
+
+      constants.insert(constants.end(), (const uint8_t*)&entry, (const uint8_t*)&entry + sizeof(entry));
+      constants.resize(constants.size() + entry.padding);
+      constants.insert(constants.end(), m_constants[i].begin(), m_constants[i].end());
+      constants.push_back(0);
+    }
+
+    struct Section {
+      uint32_t kind;
+      const void *data;
+      size_t size;
+      uint32_t flags;
+    };
+
+    std::vector<Section> sections = {
+      { BIN_SECTION_CODE, m_code.data(), m_code.size() },
+      { BIN_SECTION_CONST, constants.data(), constants.size(), BIN_CONST_IN_PLACE },
+      { BIN_SECTION_DATA, m_data.data(), m_data.size() * sizeof(bin_data_t) },
+      { BIN_SECTION_LABELS, m_labels.data(), m_labels.size() * sizeof(bin_label_t) }
+    };
+
+    if (!m_tries.empty()) {
+      sections.push_back({ BIN_SECTION_TRIES, m_tries.data(), m_tries.size() * sizeof(bin_try_t) });
+    }
+
+    if (!m_debug.empty()) {
+      sections.push_back({ BIN_SECTION_DEBUG, m_debug.data(), m_debug.size() });
+    }
+
+    std::vector<uint8_t> lines;
+
+    if (!m_lineRanges.empty()) {
+      const bin_lines_t header = { (uint32_t)m_lineRanges.size(), (uint32_t)m_traces.size() };
+
+      lines.insert(lines.end(), (const uint8_t*)&header, (const uint8_t*)&header + sizeof(header));
+      lines.insert(lines.end(), (const uint8_t*)m_lineRanges.data(),
+        (const uint8_t*)m_lineRanges.data() + m_lineRanges.size() * sizeof(bin_line_t));
+      lines.insert(lines.end(), (const uint8_t*)m_traces.data(),
+        (const uint8_t*)m_traces.data() + m_traces.size() * sizeof(bin_trace_t));
+      lines.insert(lines.end(), m_traceStrings.begin(), m_traceStrings.end());
+
+      sections.push_back({ BIN_SECTION_LINES, lines.data(), lines.size() });
+    }
+
+    bin_header_t header = { };
+    std::memcpy(header.magic, BIN_MAGIC, BIN_MAGIC_SIZE);
+    header.version = BIN_VERSION;
+    header.numSections = (uint16_t)sections.size();
+
+    std::vector<uint8_t> out;
+    out.insert(out.end(), (const uint8_t*)&header, (const uint8_t*)&header + sizeof(header));
+    out.resize(sizeof(header) + sections.size() * sizeof(bin_section_t));
+
+    for (size_t i = 0; i < sections.size(); i++) {
+      bin_section_t s = { };
+      const size_t align = sections[i].kind == BIN_SECTION_CONST ? BIN_CONST_ALIGN : BIN_ALIGN;
+
+      s.kind = sections[i].kind;
+      s.flags = sections[i].flags;
+      s.offset = (out.size() + align - 1) / align * align;
+      s.size = sections[i].size;
+
+      out.resize(s.offset);
+      out.insert(out.end(), (const uint8_t*)sections[i].data, (const uint8_t*)sections[i].data + s.size);
+
+      std::memcpy(&out[sizeof(header) + i * sizeof(bin_section_t)], &s, sizeof(s));
+    }
+
+    os.write((const char*)out.data(), out.size());
+  }
+
+private:
+  // the object's code, constants, static data and labels in the program
+  void place(Object &object) {
+    object.codeBase = m_code.size();
+    m_code.insert(m_code.end(), object.code.begin(), object.code.end());
+
+    for (size_t i = 0; i < object.constants.size(); i++) {
+      const std::vector<uint8_t> &bytes = object.constants[i];
+      auto it = m_constantIndex.find(bytes);
+
+      if (it == m_constantIndex.end()) {
+        it = m_constantIndex.emplace(bytes, (uint32_t)m_constants.size()).first;
+        m_constants.push_back(bytes);
+        m_constantAligns.push_back(0);
+      }
+
+      // the most any object asks for
+      m_constantAligns[it->second] = std::max(m_constantAligns[it->second], object.constantAligns[i]);
+
+      object.pool.push_back(it->second);
+    }
+
+    // bcparse only gives constants static slots of their own, never
+    // written to, so one slot serves every object with the same value
+    for (bin_data_t entry : object.data) {
+      if (entry.type == 0x6 && entry.data < object.pool.size()) { // CONST_FLAGS_POOL
+        entry.data = object.pool[entry.data];
+      }
+
+      const std::pair<uint8_t, uint64_t> key(entry.type, entry.data);
+      auto it = m_dataIndex.find(key);
+
+      if (it == m_dataIndex.end()) {
+        it = m_dataIndex.emplace(key, m_nextSlot++).first;
+
+        bin_data_t placed = entry;
+        placed.slot = it->second;
+        m_data.push_back(placed);
+      }
+
+      object.slots[entry.slot] = it->second;
+    }
+
+    for (const bin_label_t &label : object.labels) {
+      m_labels.push_back({ mapSlot(object, label.slot), 0, object.codeBase + label.offset });
+    }
+
+    // an object's regions are all within its code, so innermost first still
+    for (const bin_try_t &region : object.tries) {
+      m_tries.push_back({ object.codeBase + region.start, object.codeBase + region.end, object.codeBase + region.handler });
+    }
+
+    for (size_t pos = 0; pos + sizeof(uint64_t) + sizeof(uint32_t) <= object.debug.size();) {
+      uint64_t offset;
+      uint32_t length;
+
+      std::memcpy(&offset, &object.debug[pos], sizeof(offset));
+      std::memcpy(&length, &object.debug[pos + sizeof(offset)], sizeof(length));
+
+      const size_t end = std::min(object.debug.size(), pos + sizeof(offset) + sizeof(length) + length);
+
+      offset += object.codeBase;
+      m_debug.insert(m_debug.end(), (const uint8_t*)&offset, (const uint8_t*)&offset + sizeof(offset));
+      m_debug.insert(m_debug.end(), object.debug.begin() + pos + sizeof(offset), object.debug.begin() + end);
+
+      pos = end;
+    }
+
+    // the traces, and the strings they refer to, after the last object's
+    const uint32_t traceBase = (uint32_t)m_traces.size();
+    const uint32_t stringBase = (uint32_t)m_traceStrings.size();
+
+    for (bin_trace_t trace : object.traces) {
+      trace.file += stringBase;
+      trace.directive += stringBase;
+      trace.caller += trace.caller != 0 ? traceBase : 0;
+      m_traces.push_back(trace);
+    }
+
+    m_traceStrings.insert(m_traceStrings.end(), object.traceStrings.begin(), object.traceStrings.end());
+
+    // the last object's last range would otherwise run on into this one
+    if (object.lineRanges.empty() && !m_lineRanges.empty()) {
+      m_lineRanges.push_back({ object.codeBase, BIN_LINE_UNKNOWN, 0 });
+    }
+
+    for (bin_line_t range : object.lineRanges) {
+      range.offset += object.codeBase;
+      range.trace += range.trace != BIN_LINE_UNKNOWN ? traceBase : 0;
+      m_lineRanges.push_back(range);
+    }
+  }
+
+  // the program's slot for one of the object's, a new one the first time
+  uint32_t mapSlot(Object &object, uint32_t slot) {
+    if (slot < object.firstSlot) {
+      return slot;
+    }
+
+    auto it = object.slots.find(slot);
+
+    if (it == object.slots.end()) {
+      it = object.slots.emplace(slot, m_nextSlot++).first;
+    }
+
+    return it->second;
+  }
+
+  Result relocate(Object &object) {
+    for (const bin_reloc_t &reloc : object.relocs) {
+      uint8_t *field = &m_code[object.codeBase + reloc.offset];
+      uint32_t value;
+
+      std::memcpy(&value, field, sizeof(value));
+
+      switch (reloc.kind) {
+        case BIN_RELOC_DATA:
+          // the archtype, absolute, in the low 4 bits
+          value = (mapSlot(object, value >> 4) << 4) | (value & 0xF);
+          break;
+        case BIN_RELOC_POOL:
+          if (value >= object.pool.size()) {
+            return { false, object.path + ": pool index out of range" };
+          }
+
+          value = object.pool[value];
+          break;
+        default:
+          return { false, object.path + ": unknown relocation" };
+      }
+
+      std::memcpy(field, &value, sizeof(value));
+    }
+
+    return { true, "" };
+  }
+
+  std::vector<uint8_t> m_code;
+  std::vector<std::vector<uint8_t>> m_constants;
+  std::vector<uint32_t> m_constantAligns;
+  std::map<std::vector<uint8_t>, uint32_t> m_constantIndex;
+  std::vector<bin_data_t> m_data;
+  std::map<std::pair<uint8_t, uint64_t>, uint32_t> m_dataIndex;
+  std::vector<bin_label_t> m_labels;
+  std::vector<bin_try_t> m_tries;
+  std::vector<uint8_t> m_debug;
+  std::vector<bin_line_t> m_lineRanges;
+  std::vector<bin_trace_t> m_traces;
+  std::vector<uint8_t> m_traceStrings;
+  uint32_t m_nextSlot;
+};
+
+Result handleArgs(int argc, char *argv[]) {
+  const char *outFilename = Clarg::get(argv, argv + argc, "-o");
+  std::vector<Object> objects;
+
+  for (int i = 1; i < argc; i++) {
+    if (std::string(argv[i]) == "-o") {
+      i++; // its value
+      continue;
+    }
+
+    objects.emplace_back();
+
+    Result r = readObject(argv[i], objects.back());
+
+    if (!r.first) {
+      return r;
+    }
+  }
+
+  if (outFilename == nullptr || objects.empty()) {
+    return { false, std::string("Invalid arguments: expected `") + argv[0] + " -o <output> <object>...`, "
+      "the first object's code being where the program starts" };
+  }
+
+  Linker linker;
+  Result r = linker.link(objects);
+
+  if (!r.first) {
+    return r;
+  }
+
+  std::ofstream of(outFilename, std::ios::out | std::ios::binary);
+
+  if (!of.is_open()) {
+    return { false, std::string("Could not write to output file: ") + outFilename };
+  }
+
+  linker.write(of);
+
+  std::cout << "Linked to " << outFilename << "\n";
+
+  return { true, "" };
+}
+
+int main(int argc, char *argv[]) {
+  Result r = handleArgs(argc, argv);
+
+  if (!r.first) {
+    std::cout << r.second << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
@@ -1,6 +1,7 @@
 #include <bcparse/analyzer.hpp>
 #include <bcparse/ast_iterator.hpp>
 #include <bcparse/compilation_unit.hpp>
+#include <bcparse/compile_stats.hpp>
 
 #include <common/my_assert.hpp>
 
@@ -14,7 +15,10 @@ namespace bcparse {
   }
 
   void Analyzer::analyze() {
-    while (m_iterator->hasNext()) {
+    CompileStats::Timer timer(CompileStats::PHASE_ANALYZE);
+
+    // past the limit of errors, the rest would only add more
+    while (m_iterator->hasNext() && !m_compilationUnit->getErrorList().isFull()) {
       auto node = m_iterator->next();
       ASSERT(node != nullptr);
 
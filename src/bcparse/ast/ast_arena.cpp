@@ -0,0 +1,54 @@
+#include <bcparse/ast/ast_arena.hpp>
+
+#include <cstdlib>
+#include <cstdint>
+
+namespace bcparse {
+  static thread_local AstArena *currentArena = nullptr;
+
+  AstArena::AstArena()
+    : m_pos(nullptr),
+      m_end(nullptr) {
+  }
+
+  AstArena::~AstArena() {
+    for (char *chunk : m_chunks) {
+      std::free(chunk);
+    }
+  }
+
+  void *AstArena::allocate(size_t size, size_t align) {
+    uintptr_t pos = ((uintptr_t)m_pos + align - 1) & ~(uintptr_t)(align - 1);
+
+    if (m_pos == nullptr || pos + size > (uintptr_t)m_end) {
+      // a node larger than a chunk gets one of its own
+      const size_t chunkSize = size + align > CHUNK_SIZE ? size + align : CHUNK_SIZE;
+      char *chunk = (char*)std::malloc(chunkSize);
+
+      if (chunk == nullptr) {
+        throw std::bad_alloc();
+      }
+
+      m_chunks.push_back(chunk);
+      m_end = chunk + chunkSize;
+      pos = ((uintptr_t)chunk + align - 1) & ~(uintptr_t)(align - 1);
+    }
+
+    m_pos = (char*)(pos + size);
+
+    return (void*)pos;
+  }
+
+  AstArena *AstArena::current() {
+    return currentArena;
+  }
+
+  AstArena::Scope::Scope(AstArena *arena)
+    : m_previous(currentArena) {
+    currentArena = arena;
+  }
+
+  AstArena::Scope::~Scope() {
+    currentArena = m_previous;
+  }
+}
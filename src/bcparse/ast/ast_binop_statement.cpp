@@ -38,7 +38,7 @@ namespace bcparse {
     Pointer<AstExpression> left,
     Pointer<AstExpression> right,
     const SourceLocation &location)
-    : AstStatement(location),
+    : AstStatement(location, nodeKind),
       m_opName(opName),
       m_left(left),
       m_right(right) {
@@ -70,14 +70,26 @@ namespace bcparse {
     ASSERT(m_left != nullptr);
     ASSERT(m_right != nullptr);
 
+    // the mnemonic, then any float flags; `or` is the only two letter one
+    const std::string substr = m_opName.substr(0, 3);
+    const std::string flagsStr = m_opName.size() > 3 ? m_opName.substr(3) : "";
+
     m_left->build(visitor, mod, out);
-    visitor->getCompilationUnit()->getRegisterUsage().inc();
 
-    m_right->build(visitor, mod, out);
-    visitor->getCompilationUnit()->getRegisterUsage().dec();
+    // a literal right-hand side is encoded inline,
+    // rather than loaded into a register first
+    const bool isImmediate = AstExpression::isImmediate(m_right.get());
 
-    const std::string substr = m_opName.substr(0, 3);
-    const std::string flagsStr = m_opName.substr(3);
+    if (!isImmediate) {
+      visitor->getCompilationUnit()->getRegisterUsage().inc();
+
+      m_right->build(visitor, mod, out);
+      visitor->getCompilationUnit()->getRegisterUsage().dec();
+    }
+
+    const Operand right = isImmediate
+      ? Operand(m_right->getRuntimeValue())
+      : Operand(m_right->getObjLoc());
 
     Op_Cmp::Flags flags = Op_Cmp::Flags::None;
 
@@ -92,56 +104,56 @@ namespace bcparse {
     if (substr == "add") {
       out->append(std::unique_ptr<Op_Add>(new Op_Add(
         m_left->getObjLoc(),
-        m_right->getObjLoc(),
+        right,
         flags
       )));
     } else if (substr == "sub") {
       out->append(std::unique_ptr<Op_Sub>(new Op_Sub(
         m_left->getObjLoc(),
-        m_right->getObjLoc(),
+        right,
         flags
       )));
     } else if (substr == "mul") {
       out->append(std::unique_ptr<Op_Mul>(new Op_Mul(
         m_left->getObjLoc(),
-        m_right->getObjLoc(),
+        right,
         flags
       )));
     } else if (substr == "div") {
       out->append(std::unique_ptr<Op_Div>(new Op_Div(
         m_left->getObjLoc(),
-        m_right->getObjLoc(),
+        right,
         flags
       )));
     } else if (substr == "mod") {
       out->append(std::unique_ptr<Op_Mod>(new Op_Mod(
         m_left->getObjLoc(),
-        m_right->getObjLoc()
+        right
       )));
     } else if (substr == "xor") {
       out->append(std::unique_ptr<Op_Xor>(new Op_Xor(
         m_left->getObjLoc(),
-        m_right->getObjLoc()
+        right
       )));
     } else if (substr == "and") {
       out->append(std::unique_ptr<Op_And>(new Op_And(
         m_left->getObjLoc(),
-        m_right->getObjLoc()
+        right
       )));
     } else if (substr == "or") {
       out->append(std::unique_ptr<Op_Or>(new Op_Or(
         m_left->getObjLoc(),
-        m_right->getObjLoc()
+        right
       )));
     } else if (substr == "shl") {
       out->append(std::unique_ptr<Op_Shl>(new Op_Shl(
         m_left->getObjLoc(),
-        m_right->getObjLoc()
+        right
       )));
     } else if (substr == "shr") {
       out->append(std::unique_ptr<Op_Shr>(new Op_Shr(
         m_left->getObjLoc(),
-        m_right->getObjLoc()
+        right
       )));
     }
   }
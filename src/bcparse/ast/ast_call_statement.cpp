@@ -3,26 +3,76 @@
 #include <bcparse/ast/ast_pop_statement.hpp>
 #include <bcparse/ast/ast_variable.hpp>
 #include <bcparse/ast/ast_label.hpp>
+#include <bcparse/ast/ast_data_location.hpp>
+#include <bcparse/ast/ast_string_literal.hpp>
 
 #include <bcparse/ast_visitor.hpp>
 #include <bcparse/compilation_unit.hpp>
 #include <bcparse/emit/emit.hpp>
 
+#include <shared/config.h>
+
 #include <common/my_assert.hpp>
 
 namespace bcparse {
   AstCallStatement::AstCallStatement(std::vector<Pointer<AstExpression>> args,
     const SourceLocation &location)
-    : AstStatement(location),
+    : AstStatement(location, nodeKind),
       m_args(args) {
   }
 
+  AstCallStatement::AstCallStatement(std::vector<Pointer<AstExpression>> args,
+    const Pointer<AstExpression> &result,
+    const SourceLocation &location)
+    : AstStatement(location, nodeKind),
+      m_args(args),
+      m_result(result) {
+  }
+
   void AstCallStatement::visit(AstVisitor *visitor, Module *mod) {
     for (auto &arg : m_args) {
       ASSERT(arg != nullptr);
 
       arg->visit(visitor, mod);
     }
+
+    if (m_result != nullptr) {
+      m_result->visit(visitor, mod);
+    }
+
+    // a function of an extension module takes what its signature says
+    AstDataLocation *callee = astCast<AstDataLocation>(m_args[0]->getDeepValueOf());
+
+    if (callee == nullptr || callee->getIdent() != "s" || callee->getOffset() == nullptr) {
+      return;
+    }
+
+    const DataStorage::Import *import = visitor->getCompilationUnit()->getDataStorage()->getImport(
+      (size_t)callee->getOffset()->getValue()
+    );
+    const size_t argc = m_args.size() - 1;
+
+    if (import == nullptr) {
+      return;
+    }
+
+    if (argc > import->numArgs && !import->variadic) {
+      visitor->getCompilationUnit()->getErrorList().addError(CompilerError(
+        LEVEL_ERROR,
+        Msg_too_many_args,
+        m_location,
+        std::to_string(import->numArgs),
+        std::to_string(argc)
+      ));
+    } else if (argc < import->numArgs) {
+      visitor->getCompilationUnit()->getErrorList().addError(CompilerError(
+        LEVEL_ERROR,
+        Msg_too_few_args,
+        m_location,
+        std::to_string(import->numArgs),
+        std::to_string(argc)
+      ));
+    }
   }
 
   void AstCallStatement::build(AstVisitor *visitor, Module *mod, BytecodeChunk *out) {
@@ -32,6 +82,78 @@ namespace bcparse {
     ASSERT(first_arg != nullptr);
 
     first_arg->build(visitor, mod, out);
+
+    if (canPassAsOperands()) {
+      std::vector<ObjLoc> args;
+
+      for (size_t i = 1; i < m_args.size(); i++) {
+        auto &arg = m_args[i];
+        ASSERT(arg != nullptr);
+
+        if (AstExpression::isImmediate(arg.get())) {
+          const ObjLoc reg(i, ObjLoc::DataStoreLocation::RegisterDataStore);
+
+          out->append(std::unique_ptr<Op_Load>(new Op_Load(
+            reg,
+            arg->getRuntimeValue()
+          )));
+
+          args.push_back(reg);
+        } else {
+          arg->build(visitor, mod, out);
+
+          args.push_back(arg->getObjLoc());
+        }
+      }
+
+      std::unique_ptr<Op_Call> call(new Op_Call(
+        first_arg->getObjLoc(),
+        args
+      ));
+
+      if (m_result != nullptr) {
+        m_result->build(visitor, mod, out);
+
+        call->setResult(m_result->getObjLoc());
+      }
+
+      out->append(std::move(call));
+
+      return;
+    }
+
+    if (canPassInRegisters()) {
+      for (size_t i = 1; i < m_args.size(); i++) {
+        auto &arg = m_args[i];
+        ASSERT(arg != nullptr);
+
+        const ObjLoc reg(i, ObjLoc::DataStoreLocation::RegisterDataStore);
+
+        if (AstExpression::isImmediate(arg.get())) {
+          out->append(std::unique_ptr<Op_Load>(new Op_Load(
+            reg,
+            arg->getRuntimeValue()
+          )));
+        } else {
+          arg->build(visitor, mod, out);
+
+          out->append(std::unique_ptr<Op_Mov>(new Op_Mov(
+            reg,
+            arg->getObjLoc()
+          )));
+        }
+      }
+
+      out->append(std::unique_ptr<Op_Call>(new Op_Call(
+        first_arg->getObjLoc(),
+        Op_Call::Flags::RegisterArgs
+      )));
+
+      buildResult(visitor, mod, out);
+
+      return;
+    }
+
     visitor->getCompilationUnit()->getRegisterUsage().inc();
 
     for (int i = m_args.size() - 1; i >= 1; i--) {
@@ -56,6 +178,91 @@ namespace bcparse {
     if (m_args.size() > 1) {
       AstPopStatement(m_args.size() - 1, m_location).build(visitor, mod, out);
     }
+
+    buildResult(visitor, mod, out);
+  }
+
+  void AstCallStatement::buildResult(AstVisitor *visitor, Module *mod, BytecodeChunk *out) {
+    if (m_result == nullptr) {
+      return;
+    }
+
+    m_result->build(visitor, mod, out);
+
+    out->append(std::unique_ptr<Op_Mov>(new Op_Mov(
+      m_result->getObjLoc(),
+      ObjLoc(0, ObjLoc::DataStoreLocation::RegisterDataStore)
+    )));
+  }
+
+  bool AstCallStatement::canPassAsOperands() const {
+    const size_t argc = m_args.size() - 1;
+    bool loads = false, registers = false;
+
+    if (argc == 0 || argc > CALL_MAX_OPERANDS) {
+      return false;
+    }
+
+    for (size_t i = 0; i < m_args.size(); i++) {
+      AstExpression *value = m_args[i]->getDeepValueOf();
+
+      if (value == nullptr) {
+        return false;
+      }
+
+      if (auto asLoc = astCast<AstDataLocation>(value)) {
+        registers = registers || asLoc->getIdent() == "r";
+        continue;
+      }
+
+      // the callee itself must be a data location
+      if (i == 0) {
+        return false;
+      }
+
+      if (AstExpression::isImmediate(value)) {
+        loads = true;
+      } else if (astCast<AstStringLiteral>(value) == nullptr) {
+        return false;
+      }
+    }
+
+    return !(loads && registers);
+  }
+
+  bool AstCallStatement::canPassInRegisters() const {
+    const size_t argc = m_args.size() - 1;
+
+    if (argc == 0 || argc >= (size_t)RegisterUsage::numRegisters) {
+      return false;
+    }
+
+    for (size_t i = 0; i < m_args.size(); i++) {
+      AstExpression *value = m_args[i]->getDeepValueOf();
+
+      if (value == nullptr) {
+        return false;
+      }
+
+      if (auto asLoc = astCast<AstDataLocation>(value)) {
+        if (asLoc->getIdent() == "r") {
+          return false;
+        }
+
+        continue;
+      }
+
+      // the callee itself must be a data location
+      if (i == 0) {
+        return false;
+      }
+
+      if (!AstExpression::isImmediate(value) && astCast<AstStringLiteral>(value) == nullptr) {
+        return false;
+      }
+    }
+
+    return true;
   }
 
   void AstCallStatement::optimize(AstVisitor *visitor, Module *mod) {
@@ -64,6 +271,10 @@ namespace bcparse {
 
       arg->optimize(visitor, mod);
     }
+
+    if (m_result != nullptr) {
+      m_result->optimize(visitor, mod);
+    }
   }
 
   Pointer<AstStatement> AstCallStatement::clone() const {
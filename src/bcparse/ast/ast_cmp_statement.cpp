@@ -12,7 +12,7 @@ namespace bcparse {
   AstCmpStatement::AstCmpStatement(Pointer<AstExpression> left,
     Pointer<AstExpression> right,
     const SourceLocation &location)
-    : AstStatement(location),
+    : AstStatement(location, nodeKind),
       m_left(left),
       m_right(right) {
   }
@@ -36,20 +36,25 @@ namespace bcparse {
     //   m_left->getRuntimeValue()
     // )));
 
-    visitor->getCompilationUnit()->getRegisterUsage().inc();
+    // a literal right-hand side is encoded inline
+    const bool isImmediate = AstExpression::isImmediate(m_right.get());
 
-    m_right->build(visitor, mod, out);
+    if (!isImmediate) {
+      visitor->getCompilationUnit()->getRegisterUsage().inc();
 
-    // out->append(std::unique_ptr<Op_Load>(new Op_Load(
-    //   m_right->getObjLoc(),
-    //   m_right->getRuntimeValue()
-    // )));
+      m_right->build(visitor, mod, out);
+
+      // out->append(std::unique_ptr<Op_Load>(new Op_Load(
+      //   m_right->getObjLoc(),
+      //   m_right->getRuntimeValue()
+      // )));
 
-    visitor->getCompilationUnit()->getRegisterUsage().dec();
+      visitor->getCompilationUnit()->getRegisterUsage().dec();
+    }
 
     out->append(std::unique_ptr<Op_Cmp>(new Op_Cmp(
       m_left->getObjLoc(),
-      m_right->getObjLoc()
+      isImmediate ? Operand(m_right->getRuntimeValue()) : Operand(m_right->getObjLoc())
     )));
   }
 
@@ -17,17 +17,18 @@
 namespace bcparse {
   AstCodeBody::AstCodeBody(const std::vector<Token> &tokens,
     const SourceLocation &location)
-    : AstExpression(location),
-      m_tokens(tokens),
-      m_iterator(nullptr),
-      m_compilationUnit(nullptr),
-      m_variableMode(false) {
+    : AstCodeBody(tokens, location, AstKind::CodeBody, false) {
   }
+
   AstCodeBody::AstCodeBody(const std::vector<Token> &tokens,
     const SourceLocation &location,
+    AstKind kind,
     bool variableMode)
-    : AstCodeBody(tokens, location) {
-    m_variableMode = variableMode;
+    : AstExpression(location, kind),
+      m_tokens(tokens),
+      m_iterator(nullptr),
+      m_compilationUnit(nullptr),
+      m_variableMode(variableMode) {
   }
 
   AstCodeBody::~AstCodeBody() {
@@ -56,6 +57,7 @@ namespace bcparse {
     ASSERT(m_compilationUnit == nullptr);
     m_compilationUnit = new CompilationUnit(visitor->getCompilationUnit()->getDataStorage());
     m_compilationUnit->setVariableMode(m_variableMode);
+    m_compilationUnit->setFlat(visitor->getCompilationUnit()->isFlat());
 
     m_compilationUnit->getBoundGlobals().setParent(
       &visitor->getCompilationUnit()->getBoundGlobals());
@@ -69,9 +71,7 @@ namespace bcparse {
     Analyzer analyzer(m_iterator, m_compilationUnit);
     analyzer.analyze();
 
-    for (auto &error : m_compilationUnit->getErrorList().getErrors()) {
-      visitor->getCompilationUnit()->getErrorList().addError(error);
-    }
+    visitor->getCompilationUnit()->getErrorList().addErrors(m_compilationUnit->getErrorList());
   }
 
   void AstCodeBody::build(AstVisitor *visitor, Module *mod, BytecodeChunk *out) {
@@ -11,7 +11,7 @@ namespace bcparse {
   AstDataLocation::AstDataLocation(const std::string &ident,
     const Pointer<AstIntegerLiteral> &offset,
     const SourceLocation &location)
-    : AstExpression(location),
+    : AstExpression(location, nodeKind),
       m_ident(ident),
       m_offset(offset),
       m_storagePath(-1) {
@@ -29,12 +29,19 @@ namespace bcparse {
       m_storagePath = (int)ObjLoc::DataStoreLocation::RegisterDataStore;
     } else if (m_ident == "s") {
       m_storagePath = (int)ObjLoc::DataStoreLocation::StaticDataStore;
+    } else if (m_ident == "t") {
+      m_storagePath = (int)ObjLoc::DataStoreLocation::VirtualRegister;
+    } else if (m_ident == "f") {
+      m_storagePath = (int)ObjLoc::DataStoreLocation::FrameDataStore;
     } else if (m_ident == "pc") {
       m_storagePath = (int)ObjLoc::DataStoreLocation::VMDataStore;
       specialDataValue = 0;
     } else if (m_ident == "sp") {
       m_storagePath = (int)ObjLoc::DataStoreLocation::VMDataStore;
       specialDataValue = 3;
+    } else if (m_ident == "fp") {
+      m_storagePath = (int)ObjLoc::DataStoreLocation::VMDataStore;
+      specialDataValue = 5;
     }
 
     if (specialDataValue != -1) {
@@ -47,10 +54,10 @@ namespace bcparse {
           m_ident
         ));
       } else {
-        m_offset.reset(new AstIntegerLiteral(
+        m_offset = makeNode<AstIntegerLiteral>(
           specialDataValue,
           m_location
-        ));
+        );
       }
     }
 
@@ -72,6 +79,23 @@ namespace bcparse {
         m_location,
         "No value provided for data location"
       ));
+    } else if (m_storagePath == (int)ObjLoc::DataStoreLocation::RegisterDataStore
+      && (m_offset->getValue() < 0 || m_offset->getValue() >= RegisterUsage::numRegisters)) {
+      visitor->getCompilationUnit()->getErrorList().addError(CompilerError(
+        LEVEL_ERROR,
+        Msg_custom_error,
+        m_location,
+        "Register index out of range: %",
+        std::to_string(m_offset->getValue())
+      ));
+    } else if (m_storagePath == (int)ObjLoc::DataStoreLocation::VirtualRegister && m_offset->getValue() < 0) {
+      visitor->getCompilationUnit()->getErrorList().addError(CompilerError(
+        LEVEL_ERROR,
+        Msg_custom_error,
+        m_location,
+        "Temporary index out of range: %",
+        std::to_string(m_offset->getValue())
+      ));
     }
   }
 
@@ -81,7 +105,8 @@ namespace bcparse {
 
     int offsetValue = m_offset->getValue();
 
-    if (offsetValue < 0) { // relative
+    // $f[] is relative to the frame, which pushes do not move
+    if (offsetValue < 0 && m_storagePath != (int)ObjLoc::DataStoreLocation::FrameDataStore) { // relative
       // for function arguments, they're passed in reverse order,
       // so $l[-1] 123 needs to become
       //    $l[-2] 123 as 123 would be pushed to stack first
@@ -3,9 +3,18 @@
 #include <bcparse/ast/directives/ast_macro_directive.hpp>
 #include <bcparse/ast/directives/ast_var_directive.hpp>
 #include <bcparse/ast/directives/ast_set_directive.hpp>
+#include <bcparse/ast/directives/ast_eval_directive.hpp>
 #include <bcparse/ast/directives/ast_debug_directive.hpp>
 #include <bcparse/ast/directives/ast_user_defined_directive.hpp>
 #include <bcparse/ast/directives/ast_include_directive.hpp>
+#include <bcparse/ast/directives/ast_embed_directive.hpp>
+#include <bcparse/ast/directives/ast_struct_directive.hpp>
+#include <bcparse/ast/directives/ast_jit_directive.hpp>
+#include <bcparse/ast/directives/ast_unroll_directive.hpp>
+#include <bcparse/ast/directives/ast_inline_directive.hpp>
+#include <bcparse/ast/directives/ast_link_directive.hpp>
+#include <bcparse/ast/directives/ast_try_directive.hpp>
+#include <bcparse/ast/directives/ast_switch_directive.hpp>
 
 #include <bcparse/emit/bytecode_chunk.hpp>
 
@@ -37,12 +46,34 @@ namespace bcparse {
     }
   }
 
+  void AstDirectiveImpl::setVariable(AstVisitor *visitor, const std::string &name, const Pointer<AstExpression> &value) {
+    Pointer<AstExpression> var;
+    BoundVariables *boundVariables = &visitor->getCompilationUnit()->getBoundGlobals();
+    BoundVariables *varScope = boundVariables;
+
+    while (true) {
+      if (var == nullptr) {
+        var = boundVariables->get(name, false);
+
+        varScope = boundVariables;
+      }
+
+      boundVariables = boundVariables->getParent();
+
+      if (boundVariables == nullptr) {
+        break;
+      }
+    }
+
+    varScope->set(name, value);
+  }
+
 
   AstDirective::AstDirective(const std::string &name,
     const std::vector<Pointer<AstExpression>> &arguments,
     const std::vector<Token> &tokens,
     const SourceLocation &location)
-    : AstStatement(location),
+    : AstStatement(location, nodeKind),
       m_name(name),
       m_arguments(arguments),
       m_tokens(tokens),
@@ -65,10 +96,34 @@ namespace bcparse {
       m_impl = new AstVarDirective(m_arguments, m_tokens, m_location);
     } else if (m_name == "set") {
       m_impl = new AstSetDirective(m_arguments, m_tokens, m_location);
+    } else if (m_name == "eval") {
+      m_impl = new AstEvalDirective(m_arguments, m_tokens, m_location);
     } else if (m_name == "debug") {
       m_impl = new AstDebugDirective(m_arguments, m_tokens, m_location);
     } else if (m_name == "include") {
       m_impl = new AstIncludeDirective(m_arguments, m_tokens, m_location);
+    } else if (m_name == "include_once") {
+      m_impl = new AstIncludeDirective(m_arguments, m_tokens, m_location, true);
+    } else if (m_name == "embed") {
+      m_impl = new AstEmbedDirective(m_arguments, m_tokens, m_location);
+    } else if (m_name == "struct") {
+      m_impl = new AstStructDirective(m_arguments, m_tokens, m_location);
+    } else if (m_name == "jit") {
+      m_impl = new AstJitDirective(m_arguments, m_tokens, m_location);
+    } else if (m_name == "try_region") {
+      m_impl = new AstTryDirective(m_arguments, m_tokens, m_location);
+    } else if (m_name == "switch") {
+      m_impl = new AstSwitchDirective(m_arguments, m_tokens, m_location);
+    } else if (m_name == "unroll") {
+      m_impl = new AstUnrollDirective(m_arguments, m_tokens, m_location);
+    } else if (m_name == "inline") {
+      m_impl = new AstInlineDirective(m_arguments, m_tokens, m_location, InlineHint::Inline);
+    } else if (m_name == "noinline") {
+      m_impl = new AstInlineDirective(m_arguments, m_tokens, m_location, InlineHint::NoInline);
+    } else if (m_name == "export") {
+      m_impl = new AstLinkDirective(m_arguments, m_tokens, m_location, true);
+    } else if (m_name == "extern") {
+      m_impl = new AstLinkDirective(m_arguments, m_tokens, m_location, false);
     } else if (visitor->getCompilationUnit()->getBoundGlobals().lookupMacro(m_name)) {
       m_impl = new AstUserDefinedDirective(m_name, m_arguments, m_tokens, m_location);
     }
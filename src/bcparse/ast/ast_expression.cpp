@@ -1,6 +1,8 @@
 #include <bcparse/ast/ast_expression.hpp>
 #include <bcparse/ast/ast_symbol.hpp>
 #include <bcparse/ast/ast_variable.hpp>
+#include <bcparse/ast/ast_integer_literal.hpp>
+#include <bcparse/ast/ast_float_literal.hpp>
 
 #include <bcparse/ast_visitor.hpp>
 #include <bcparse/bound_variables.hpp>
@@ -16,12 +18,12 @@ namespace bcparse {
 
     if (node == nullptr || node->getValueOf() == nullptr) {
       ss << "nullptr";
-    } else if (auto asSym = dynamic_cast<AstSymbol*>(node->getValueOf())) {
+    } else if (auto asSym = astCast<AstSymbol>(node->getValueOf())) {
       if (asSym->getName() == "vars") {
         // if currently in global scope, set the var as a global.
         // if not, bubble up to the scope highest enough to not reach global
         BoundVariables *root = &visitor->getCompilationUnit()->getBoundGlobals();
-        std::vector<std::map<std::string, Pointer<AstExpression>>*> allBound;
+        std::vector<BoundVariables::Map*> allBound;
 
         while (root->getParent() != nullptr) {
           allBound.push_back(&root->getMap());
@@ -33,12 +35,19 @@ namespace bcparse {
         for (size_t i = 0; i < allBound.size(); i++) {
           ss << "\n";
 
-          for (auto it : *allBound[i]) {
+          // by name, as the scope does not keep them in order
+          std::map<std::string, AstExpression*> sorted;
+
+          for (auto &it : *allBound[i]) {
+            sorted[*it.first] = it.second.get();
+          }
+
+          for (auto it : sorted) {
             for (int j = 0; j < i; j++) {
               ss << "  ";
             }
 
-            ss << it.first << ": " << nodeToString(visitor, it.second.get()) << "\n";
+            ss << it.first << ": " << nodeToString(visitor, it.second) << "\n";
           }
         }
       } else {
@@ -53,8 +62,18 @@ namespace bcparse {
     return ss.str();
   }
 
-  AstExpression::AstExpression(const SourceLocation &location)
-    : AstStatement(location) {
+  bool AstExpression::isImmediate(AstExpression *node) {
+    if (node == nullptr || node->getValueOf() == nullptr) {
+      return false;
+    }
+
+    const AstKind kind = node->getValueOf()->getKind();
+
+    return kind == AstKind::IntegerLiteral || kind == AstKind::FloatLiteral;
+  }
+
+  AstExpression::AstExpression(const SourceLocation &location, AstKind kind)
+    : AstStatement(location, kind) {
   }
 
   AstExpression *AstExpression::getValueOf() {
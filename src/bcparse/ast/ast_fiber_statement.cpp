@@ -0,0 +1,81 @@
+#include <bcparse/ast/ast_fiber_statement.hpp>
+#include <bcparse/ast/ast_variable.hpp>
+#include <bcparse/ast/ast_label.hpp>
+
+#include <bcparse/ast_visitor.hpp>
+#include <bcparse/compilation_unit.hpp>
+#include <bcparse/emit/emit.hpp>
+
+#include <common/my_assert.hpp>
+
+namespace bcparse {
+  AstFiberStatement::AstFiberStatement(Kind kind,
+    Pointer<AstExpression> left,
+    Pointer<AstExpression> right,
+    const SourceLocation &location)
+    : AstStatement(location, nodeKind),
+      m_kind(kind),
+      m_left(left),
+      m_right(right) {
+  }
+
+  void AstFiberStatement::visit(AstVisitor *visitor, Module *mod) {
+    if (m_left != nullptr) {
+      m_left->visit(visitor, mod);
+    }
+
+    if (m_right != nullptr) {
+      m_right->visit(visitor, mod);
+    }
+  }
+
+  void AstFiberStatement::build(AstVisitor *visitor, Module *mod, BytecodeChunk *out) {
+    switch (m_kind) {
+      case Kind::Spawn:
+        ASSERT(m_left != nullptr);
+        ASSERT(m_right != nullptr);
+
+        m_left->build(visitor, mod, out);
+        m_right->build(visitor, mod, out);
+
+        out->append(std::unique_ptr<Op_Spawn>(new Op_Spawn(
+          m_left->getObjLoc(),
+          m_right->getObjLoc()
+        )));
+
+        break;
+      case Kind::Yield:
+        out->append(std::unique_ptr<Op_Yield>(new Op_Yield()));
+
+        break;
+      case Kind::Join:
+        ASSERT(m_left != nullptr);
+
+        m_left->build(visitor, mod, out);
+
+        out->append(std::unique_ptr<Op_Join>(new Op_Join(
+          m_left->getObjLoc()
+        )));
+
+        break;
+      case Kind::Halt:
+        out->append(std::unique_ptr<Op_Halt>(new Op_Halt()));
+
+        break;
+    }
+  }
+
+  void AstFiberStatement::optimize(AstVisitor *visitor, Module *mod) {
+    if (m_left != nullptr) {
+      m_left->optimize(visitor, mod);
+    }
+
+    if (m_right != nullptr) {
+      m_right->optimize(visitor, mod);
+    }
+  }
+
+  Pointer<AstStatement> AstFiberStatement::clone() const {
+    return CloneImpl();
+  }
+}
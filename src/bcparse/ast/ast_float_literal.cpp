@@ -10,7 +10,7 @@
 namespace bcparse {
   AstFloatLiteral::AstFloatLiteral(double value,
     const SourceLocation &location)
-    : AstExpression(location),
+    : AstExpression(location, nodeKind),
       m_value(value) {
   }
 
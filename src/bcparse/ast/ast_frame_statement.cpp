@@ -0,0 +1,83 @@
+#include <bcparse/ast/ast_frame_statement.hpp>
+#include <bcparse/ast/ast_integer_literal.hpp>
+
+#include <bcparse/ast_visitor.hpp>
+#include <bcparse/compilation_unit.hpp>
+#include <bcparse/emit/emit.hpp>
+
+#include <common/my_assert.hpp>
+
+#include <cstdint>
+
+namespace bcparse {
+  AstFrameStatement::AstFrameStatement(Kind kind,
+    Pointer<AstExpression> arg,
+    const SourceLocation &location)
+    : AstStatement(location, nodeKind),
+      m_kind(kind),
+      m_arg(arg),
+      m_numArgs(0) {
+  }
+
+  void AstFrameStatement::visit(AstVisitor *visitor, Module *mod) {
+    if (m_arg == nullptr) {
+      return;
+    }
+
+    m_arg->visit(visitor, mod);
+
+    if (m_kind == Kind::Return) {
+      AstIntegerLiteral *numArgs = nullptr;
+
+      if (AstExpression *deepValue = m_arg->getDeepValueOf()) {
+        numArgs = astCast<AstIntegerLiteral>(deepValue);
+      }
+
+      // the count is encoded in 16 bits, as a pop's
+      if (numArgs == nullptr || numArgs->getValue() < 0 || numArgs->getValue() > UINT16_MAX) {
+        visitor->getCompilationUnit()->getErrorList().addError(CompilerError(
+          LEVEL_ERROR,
+          Msg_custom_error,
+          m_arg->getLocation(),
+          "ret (args) must be an integer from 0 to %",
+          UINT16_MAX
+        ));
+
+        return;
+      }
+
+      m_numArgs = (size_t)numArgs->getValue();
+    }
+  }
+
+  void AstFrameStatement::build(AstVisitor *visitor, Module *mod, BytecodeChunk *out) {
+    switch (m_kind) {
+      case Kind::Call:
+        ASSERT(m_arg != nullptr);
+
+        m_arg->build(visitor, mod, out);
+
+        out->append(std::unique_ptr<Op_FCall>(new Op_FCall(
+          m_arg->getObjLoc()
+        )));
+
+        break;
+      case Kind::Return:
+        out->append(std::unique_ptr<Op_Ret>(new Op_Ret(
+          m_numArgs
+        )));
+
+        break;
+    }
+  }
+
+  void AstFrameStatement::optimize(AstVisitor *visitor, Module *mod) {
+    if (m_arg != nullptr) {
+      m_arg->optimize(visitor, mod);
+    }
+  }
+
+  Pointer<AstStatement> AstFrameStatement::clone() const {
+    return CloneImpl();
+  }
+}
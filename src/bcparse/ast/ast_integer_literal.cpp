@@ -10,7 +10,7 @@
 namespace bcparse {
   AstIntegerLiteral::AstIntegerLiteral(int64_t value,
     const SourceLocation &location)
-    : AstExpression(location),
+    : AstExpression(location, nodeKind),
       m_value(value) {
   }
 
@@ -16,7 +16,7 @@
 namespace bcparse {
   AstInterpolation::AstInterpolation(const std::vector<Token> &tokens,
     const SourceLocation &location)
-    : AstCodeBody(tokens, location, true) {
+    : AstCodeBody(tokens, location, nodeKind, true) {
     m_container.owned = false;
     m_container.value = nullptr;
   }
@@ -39,9 +39,9 @@ namespace bcparse {
         setInterpValue(getInterpValue(), false);
 
         // extract value of variables/symbols
-        if (auto asVar = dynamic_cast<AstVariable*>(m_container.value)) {
+        if (auto asVar = astCast<AstVariable>(m_container.value)) {
           setInterpValue(asVar->getValueOf(), false);
-        } else if (auto asSym = dynamic_cast<AstSymbol*>(m_container.value)) {
+        } else if (auto asSym = astCast<AstSymbol>(m_container.value)) {
           setInterpValue(new AstVariable(asSym->getName(), m_location), true);
 
           m_container.value->visit(visitor, mod);
@@ -103,7 +103,7 @@ namespace bcparse {
   }
 
   AstExpression *AstInterpolation::getInterpValue() {
-    if (auto asInterp = dynamic_cast<AstInterpolation*>(m_container.value)) {
+    if (auto asInterp = astCast<AstInterpolation>(m_container.value)) {
       return asInterp->getInterpValue();
     }
 
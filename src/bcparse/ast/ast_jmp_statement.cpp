@@ -12,7 +12,7 @@ namespace bcparse {
   AstJmpStatement::AstJmpStatement(Pointer<AstExpression> arg,
     JumpMode jumpMode,
     const SourceLocation &location)
-    : AstStatement(location),
+    : AstStatement(location, nodeKind),
       m_arg(arg),
       m_jumpMode(jumpMode),
       m_pointee(nullptr) {
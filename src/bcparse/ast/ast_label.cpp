@@ -12,21 +12,21 @@ namespace bcparse {
   AstLabel::AstLabel(const std::string &name,
     const Pointer<AstDataLocation> &dataLocation,
     const SourceLocation &location)
-    : AstExpression(location),
+    : AstExpression(location, nodeKind),
       m_name(name),
       m_dataLocation(dataLocation) {
   }
 
   void AstLabel::visit(AstVisitor *visitor, Module *mod) {
     if (m_dataLocation == nullptr) {
-      m_dataLocation = std::shared_ptr<AstDataLocation>(new AstDataLocation(
+      m_dataLocation = makeNode<AstDataLocation>(
         "s", // static
-        Pointer<AstIntegerLiteral>(new AstIntegerLiteral(
+        makeNode<AstIntegerLiteral>(
           visitor->getCompilationUnit()->getDataStorage()->addLabel(),
           m_location
-        )),
+        ),
         m_location
-      ));
+      );
     }
 
     m_dataLocation->visit(visitor, mod);
@@ -11,7 +11,7 @@ namespace bcparse {
   AstLabelDecl::AstLabelDecl(const std::string &name,
     Pointer<AstLabel> astLabel,
     const SourceLocation &location)
-    : AstStatement(location),
+    : AstStatement(location, nodeKind),
       m_name(name),
       m_astLabel(astLabel) {
   }
@@ -39,7 +39,8 @@ namespace bcparse {
     m_astLabel->build(visitor, mod, out);
 
     out->append(std::unique_ptr<LabelMarker>(new LabelMarker(
-      m_astLabel->getObjLoc().getLocation()
+      m_astLabel->getObjLoc().getLocation(),
+      m_name
     )));
   }
 
@@ -12,7 +12,7 @@ namespace bcparse {
   AstMovStatement::AstMovStatement(Pointer<AstExpression> left,
     Pointer<AstExpression> right,
     const SourceLocation &location)
-    : AstStatement(location),
+    : AstStatement(location, nodeKind),
       m_left(left),
       m_right(right) {
   }
@@ -30,6 +30,17 @@ namespace bcparse {
     ASSERT(m_right != nullptr);
 
     m_left->build(visitor, mod, out);
+
+    if (AstExpression::isImmediate(m_right.get())) {
+      // load the literal straight into the destination
+      out->append(std::unique_ptr<Op_Load>(new Op_Load(
+        m_left->getObjLoc(),
+        m_right->getRuntimeValue()
+      )));
+
+      return;
+    }
+
     m_right->build(visitor, mod, out);
 
     out->append(std::unique_ptr<Op_Mov>(new Op_Mov(
@@ -9,7 +9,7 @@
 
 namespace bcparse {
   AstNil::AstNil(const SourceLocation &location)
-    : AstExpression(location) {
+    : AstExpression(location, nodeKind) {
   }
 
   void AstNil::visit(AstVisitor *visitor, Module *mod) {
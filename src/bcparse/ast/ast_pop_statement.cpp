@@ -10,7 +10,7 @@
 namespace bcparse {
   AstPopStatement::AstPopStatement(size_t amt,
     const SourceLocation &location)
-    : AstStatement(location),
+    : AstStatement(location, nodeKind),
       m_amt(amt) {
   }
 
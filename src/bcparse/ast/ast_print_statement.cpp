@@ -9,7 +9,7 @@
 namespace bcparse {
   AstPrintStatement::AstPrintStatement(std::vector<Pointer<AstExpression>> args,
     const SourceLocation &location)
-    : AstStatement(location),
+    : AstStatement(location, nodeKind),
       m_args(args) {
   }
 
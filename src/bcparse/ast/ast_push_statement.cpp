@@ -1,6 +1,7 @@
 #include <bcparse/ast/ast_push_statement.hpp>
 #include <bcparse/ast/ast_data_location.hpp>
 #include <bcparse/ast/ast_label.hpp>
+#include <bcparse/ast/ast_string_literal.hpp>
 
 #include <bcparse/ast_visitor.hpp>
 #include <bcparse/compilation_unit.hpp>
@@ -11,7 +12,7 @@
 namespace bcparse {
   AstPushStatement::AstPushStatement(Pointer<AstExpression> arg,
     const SourceLocation &location)
-    : AstStatement(location),
+    : AstStatement(location, nodeKind),
       m_arg(arg) {
   }
 
@@ -24,23 +25,37 @@ namespace bcparse {
   void AstPushStatement::build(AstVisitor *visitor, Module *mod, BytecodeChunk *out) {
     ASSERT(m_arg != nullptr);
 
-    // create temporary bytecode chunk,
-    // so we can discard in case of the expression being a constant,
-    // which we can directly push to the stack.
-    std::unique_ptr<BytecodeChunk> tmp(new BytecodeChunk);
-
-    m_arg->build(visitor, mod, tmp.get());
-
     AstExpression *deepValue = m_arg->getDeepValueOf();
     ASSERT(deepValue != nullptr);
 
-    // if (deepValue->getRuntimeValue() != Value::none()) {
-    //   out->append(std::unique_ptr<Op_PushConst>(new Op_PushConst(
-    //     m_arg->getRuntimeValue()
-    //   )));
+    // constants are pushed directly: numbers inline,
+    // strings as a reference to their constant pool entry
+    if (AstExpression::isImmediate(m_arg.get())) {
+      out->append(std::unique_ptr<Op_PushConst>(new Op_PushConst(
+        m_arg->getValueOf()->getRuntimeValue()
+      )));
+
+      return;
+    }
+
+    if (auto asString = astCast<AstStringLiteral>(m_arg->getValueOf())) {
+      const Value value = asString->getRuntimeValue();
 
-    //   return;
-    // }
+      if (asString->getAlign() != 0) {
+        visitor->getCompilationUnit()->getDataStorage()->setAlignment(value, asString->getAlign());
+      }
+
+      out->append(std::unique_ptr<Op_PushConst>(new Op_PushConst(
+        visitor->getCompilationUnit()->getDataStorage()->addConstant(value),
+        value
+      )));
+
+      return;
+    }
+
+    std::unique_ptr<BytecodeChunk> tmp(new BytecodeChunk);
+
+    m_arg->build(visitor, mod, tmp.get());
 
     tmp->append(std::unique_ptr<Op_Push>(new Op_Push(
       deepValue->getObjLoc()
@@ -0,0 +1,74 @@
+#include <bcparse/ast/ast_select_statement.hpp>
+
+#include <bcparse/ast_visitor.hpp>
+#include <bcparse/compilation_unit.hpp>
+#include <bcparse/emit/emit.hpp>
+
+#include <common/my_assert.hpp>
+
+namespace bcparse {
+  AstSelectStatement::AstSelectStatement(AstJmpStatement::JumpMode condition,
+    Pointer<AstExpression> dst,
+    Pointer<AstExpression> a,
+    Pointer<AstExpression> b,
+    const SourceLocation &location)
+    : AstStatement(location, nodeKind),
+      m_condition(condition),
+      m_dst(dst),
+      m_a(a),
+      m_b(b) {
+  }
+
+  void AstSelectStatement::visit(AstVisitor *visitor, Module *mod) {
+    ASSERT(m_dst != nullptr);
+
+    m_dst->visit(visitor, mod);
+
+    if (m_a != nullptr) {
+      ASSERT(m_b != nullptr);
+
+      m_a->visit(visitor, mod);
+      m_b->visit(visitor, mod);
+    }
+  }
+
+  void AstSelectStatement::build(AstVisitor *visitor, Module *mod, BytecodeChunk *out) {
+    ASSERT(m_dst != nullptr);
+
+    m_dst->build(visitor, mod, out);
+
+    if (m_a == nullptr) {
+      out->append(std::unique_ptr<Op_SetCc>(new Op_SetCc(
+        m_dst->getObjLoc(),
+        static_cast<Op_Jmp::Flags>(m_condition)
+      )));
+
+      return;
+    }
+
+    m_a->build(visitor, mod, out);
+    m_b->build(visitor, mod, out);
+
+    out->append(std::unique_ptr<Op_Select>(new Op_Select(
+      m_dst->getObjLoc(),
+      m_a->getObjLoc(),
+      m_b->getObjLoc(),
+      static_cast<Op_Jmp::Flags>(m_condition)
+    )));
+  }
+
+  void AstSelectStatement::optimize(AstVisitor *visitor, Module *mod) {
+    ASSERT(m_dst != nullptr);
+
+    m_dst->optimize(visitor, mod);
+
+    if (m_a != nullptr) {
+      m_a->optimize(visitor, mod);
+      m_b->optimize(visitor, mod);
+    }
+  }
+
+  Pointer<AstStatement> AstSelectStatement::clone() const {
+    return CloneImpl();
+  }
+}
@@ -1,8 +1,13 @@
 #include <bcparse/ast/ast_statement.hpp>
+#include <bcparse/compile_stats.hpp>
 
 namespace bcparse {
-  AstStatement::AstStatement(const SourceLocation &location)
-    : m_location(location) {
+  AstStatement::AstStatement(const SourceLocation &location, AstKind kind)
+    : m_location(location),
+      m_kind(kind) {
+    if (CompileStats *stats = CompileStats::current()) {
+      stats->astNodes++;
+    }
   }
 
   bool AstStatement::isHoisted() const {
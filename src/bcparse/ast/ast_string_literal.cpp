@@ -9,18 +9,23 @@
 
 namespace bcparse {
   AstStringLiteral::AstStringLiteral(const std::string &value,
-    const SourceLocation &location)
-    : AstExpression(location),
-      m_value(value) {
+    const SourceLocation &location,
+    size_t align)
+    : AstExpression(location, nodeKind),
+      m_value(value),
+      m_align(align) {
   }
 
   void AstStringLiteral::visit(AstVisitor *visitor, Module *mod) {
   }
 
   void AstStringLiteral::build(AstVisitor *visitor, Module *mod, BytecodeChunk *out) {
-    size_t id = visitor->getCompilationUnit()->getDataStorage()->addStaticData(
-      getRuntimeValue()
-    );
+    DataStorage *dataStorage = visitor->getCompilationUnit()->getDataStorage();
+    size_t id = dataStorage->addStaticData(getRuntimeValue());
+
+    if (m_align != 0) {
+      dataStorage->setAlignment(getRuntimeValue(), m_align);
+    }
 
     m_objLoc = ObjLoc(id, ObjLoc::DataStoreLocation::StaticDataStore);
   }
@@ -10,7 +10,7 @@
 namespace bcparse {
   AstSymbol::AstSymbol(const std::string &name,
     const SourceLocation &location)
-    : AstExpression(location),
+    : AstExpression(location, nodeKind),
       m_name(name) {
   }
 
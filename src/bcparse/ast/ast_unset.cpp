@@ -9,7 +9,7 @@
 
 namespace bcparse {
   AstUnset::AstUnset(const SourceLocation &location)
-    : AstExpression(location) {
+    : AstExpression(location, nodeKind) {
   }
 
   void AstUnset::visit(AstVisitor *visitor, Module *mod) {
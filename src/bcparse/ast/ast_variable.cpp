@@ -13,7 +13,7 @@
 namespace bcparse {
   AstVariable::AstVariable(const std::string &name,
     const SourceLocation &location)
-    : AstExpression(location),
+    : AstExpression(location, nodeKind),
       m_name(name),
       m_value(nullptr) {
   }
@@ -24,7 +24,7 @@ namespace bcparse {
 
       // put it in this class as well so that error messages
       // display the correct usage location
-      if (dynamic_cast<AstUnset*>(m_value.get())) {
+      if (astCast<AstUnset>(m_value.get())) {
         visitor->getCompilationUnit()->getErrorList().addError(CompilerError(
           LEVEL_ERROR,
           Msg_custom_error,
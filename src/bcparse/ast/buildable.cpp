@@ -10,4 +10,8 @@ namespace bcparse {
   void Buildable::debugPrint(BytecodeStream *bs, Formatter *f) {
     f->setLineNo(m_loc);
   }
+
+  bool Buildable::getObjLocs(std::vector<ObjLoc*> &out) {
+    return false;
+  }
 }
@@ -0,0 +1,137 @@
+#include <bcparse/ast/directives/ast_embed_directive.hpp>
+
+#include <bcparse/ast/ast_symbol.hpp>
+#include <bcparse/ast/ast_string_literal.hpp>
+#include <bcparse/ast/ast_integer_literal.hpp>
+
+#include <bcparse/ast_visitor.hpp>
+#include <bcparse/compilation_unit.hpp>
+
+#include <shared/bin_format.h>
+
+#include <fstream>
+#include <iterator>
+
+#include <limits.h>
+#include <stdlib.h>
+
+namespace bcparse {
+  AstEmbedDirective::AstEmbedDirective(const std::vector<Pointer<AstExpression>> &arguments,
+    const std::vector<Token> &tokens,
+    const SourceLocation &location)
+    : AstDirectiveImpl(arguments, tokens, location) {
+  }
+
+  AstEmbedDirective::~AstEmbedDirective() {
+  }
+
+  void AstEmbedDirective::visit(AstVisitor *visitor, Module *mod) {
+    AstSymbol *nameArg = nullptr;
+    AstStringLiteral *pathArg = nullptr;
+    AstIntegerLiteral *alignArg = nullptr;
+    int64_t align = 0;
+
+    if (m_arguments.size() != 2 && m_arguments.size() != 3) {
+      visitor->getCompilationUnit()->getErrorList().addError(CompilerError(
+        LEVEL_ERROR,
+        Msg_custom_error,
+        m_location,
+        "@embed requires arguments (name, path[, align])"
+      ));
+
+      return;
+    }
+
+    visitArguments(visitor, mod);
+
+    if (AstExpression *deepValue = m_arguments[0]->getDeepValueOf()) {
+      nameArg = astCast<AstSymbol>(deepValue);
+    }
+
+    if (AstExpression *deepValue = m_arguments[1]->getDeepValueOf()) {
+      pathArg = astCast<AstStringLiteral>(deepValue);
+    }
+
+    if (m_arguments.size() == 3) {
+      if (AstExpression *deepValue = m_arguments[2]->getDeepValueOf()) {
+        alignArg = astCast<AstIntegerLiteral>(deepValue);
+      }
+
+      align = alignArg != nullptr ? alignArg->getValue() : -1;
+    }
+
+    if (nameArg == nullptr) {
+      visitor->getCompilationUnit()->getErrorList().addError(CompilerError(
+        LEVEL_ERROR,
+        Msg_custom_error,
+        m_arguments[0]->getLocation(),
+        "@embed (name) must be an identifier"
+      ));
+    }
+
+    if (pathArg == nullptr) {
+      visitor->getCompilationUnit()->getErrorList().addError(CompilerError(
+        LEVEL_ERROR,
+        Msg_custom_error,
+        m_arguments[1]->getLocation(),
+        "@embed (path) must be a string"
+      ));
+    }
+
+    // a power of two, which the pool can place it at
+    if (align < 0 || align > BIN_CONST_ALIGN || (align & (align - 1)) != 0) {
+      visitor->getCompilationUnit()->getErrorList().addError(CompilerError(
+        LEVEL_ERROR,
+        Msg_custom_error,
+        m_arguments[2]->getLocation(),
+        "@embed (align) must be a power of two up to %",
+        std::to_string(BIN_CONST_ALIGN)
+      ));
+
+      return;
+    }
+
+    if (nameArg == nullptr || pathArg == nullptr) {
+      return;
+    }
+
+    // relative to the source, as @include's
+    std::string currentDir;
+    const size_t index = m_location.getFileName().find_last_of("/\\");
+    if (index != std::string::npos) {
+      currentDir = m_location.getFileName().substr(0, index) + "/";
+    }
+
+    const std::string pathValue = currentDir + pathArg->getValue();
+
+    char realPath[PATH_MAX];
+    std::ifstream file(pathValue, std::ios::in | std::ios::binary);
+
+    if (!file.is_open() || realpath(pathValue.c_str(), realPath) == nullptr) {
+      visitor->getCompilationUnit()->getErrorList().addError(CompilerError(
+        LEVEL_ERROR,
+        Msg_custom_error,
+        m_location,
+        "'%': path not found",
+        pathValue
+      ));
+
+      return;
+    }
+
+    const std::string bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    visitor->getCompilationUnit()->getEmbeddedFiles().insert(realPath);
+
+    setVariable(visitor, nameArg->getName(),
+      makeNode<AstStringLiteral>(bytes, m_location, (size_t)align));
+    setVariable(visitor, nameArg->getName() + "_size",
+      makeNode<AstIntegerLiteral>((int64_t)bytes.size(), m_location));
+  }
+
+  void AstEmbedDirective::build(AstVisitor *visitor, Module *mod, BytecodeChunk *out) {
+  }
+
+  void AstEmbedDirective::optimize(AstVisitor *visitor, Module *mod) {
+  }
+}
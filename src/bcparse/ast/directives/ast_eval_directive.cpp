@@ -0,0 +1,64 @@
+#include <bcparse/ast/directives/ast_eval_directive.hpp>
+
+#include <bcparse/ast/ast_symbol.hpp>
+
+#include <bcparse/ast_visitor.hpp>
+#include <bcparse/compilation_unit.hpp>
+#include <bcparse/const_evaluator.hpp>
+
+namespace bcparse {
+  AstEvalDirective::AstEvalDirective(const std::vector<Pointer<AstExpression>> &arguments,
+    const std::vector<Token> &tokens,
+    const SourceLocation &location)
+    : AstDirectiveImpl(arguments, tokens, location) {
+  }
+
+  AstEvalDirective::~AstEvalDirective() {
+  }
+
+  void AstEvalDirective::visit(AstVisitor *visitor, Module *mod) {
+    AstSymbol *nameArg = nullptr;
+
+    if (m_arguments.size() != 1) {
+      visitor->getCompilationUnit()->getErrorList().addError(CompilerError(
+        LEVEL_ERROR,
+        Msg_custom_error,
+        m_location,
+        "@eval requires arguments (key) { expression }"
+      ));
+
+      return;
+    }
+
+    if (auto nameArgExpr = m_arguments[0].get()) {
+      nameArgExpr->visit(visitor, mod);
+
+      if (AstExpression *deepValue = nameArgExpr->getDeepValueOf()) {
+        nameArg = astCast<AstSymbol>(deepValue);
+      }
+    }
+
+    if (nameArg == nullptr) {
+      visitor->getCompilationUnit()->getErrorList().addError(CompilerError(
+        LEVEL_ERROR,
+        Msg_custom_error,
+        m_location,
+        "@eval (key) must be an identifier"
+      ));
+
+      return;
+    }
+
+    ConstEvaluator evaluator(visitor->getCompilationUnit(), m_tokens, m_location);
+
+    if (Pointer<AstExpression> value = evaluator.evaluate()) {
+      setVariable(visitor, nameArg->getName(), value);
+    }
+  }
+
+  void AstEvalDirective::build(AstVisitor *visitor, Module *mod, BytecodeChunk *out) {
+  }
+
+  void AstEvalDirective::optimize(AstVisitor *visitor, Module *mod) {
+  }
+}
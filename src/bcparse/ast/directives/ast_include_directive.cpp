@@ -12,16 +12,23 @@
 #include <bcparse/source_file.hpp>
 #include <bcparse/source_stream.hpp>
 #include <bcparse/compilation_unit.hpp>
+#include <bcparse/token_cache.hpp>
+#include <bcparse/compile_stats.hpp>
 
 #include <common/str_util.hpp>
 
-#include <fstream>
+
+#include <sys/stat.h>
+#include <limits.h>
+#include <stdlib.h>
 
 namespace bcparse {
   AstIncludeDirective::AstIncludeDirective(const std::vector<Pointer<AstExpression>> &arguments,
     const std::vector<Token> &tokens,
-    const SourceLocation &location)
+    const SourceLocation &location,
+    bool once)
     : AstDirectiveImpl(arguments, tokens, location),
+      m_once(once),
       m_iterator(nullptr),
       m_compilationUnit(nullptr) {
   }
@@ -53,7 +60,7 @@ namespace bcparse {
         pathArgExpr->visit(visitor, mod);
 
         if ((deepValue = pathArgExpr->getDeepValueOf()) != nullptr) {
-          pathArg = dynamic_cast<AstStringLiteral*>(deepValue);
+          pathArg = astCast<AstStringLiteral>(deepValue);
         }
       }
 
@@ -83,17 +90,10 @@ namespace bcparse {
 
         const std::string pathValue = currentDir + pathArg->getValue();
 
-            // parse path into vector
-        std::vector<std::string> path_vec = str_util::split_path(pathValue);
-        // canonicalize the vector
-        path_vec = str_util::canonicalize_path(path_vec);
-        // put it back into a string
-        const std::string canon_path = str_util::path_to_str(path_vec);
-
-        std::ifstream file;
-        file.open(pathValue, std::ios::in | std::ios::ate);
+        struct stat st;
+        char realPath[PATH_MAX];
 
-        if (!file.is_open()) {
+        if (stat(pathValue.c_str(), &st) != 0 || realpath(pathValue.c_str(), realPath) == nullptr) {
           visitor->getCompilationUnit()->getErrorList().addError(CompilerError(
             LEVEL_ERROR,
             Msg_custom_error,
@@ -105,19 +105,93 @@ namespace bcparse {
           return;
         }
 
-        // get number of bytes
-        size_t max = file.tellg();
-        // seek to beginning
-        file.seekg(0, std::ios::beg);
-        // load stream into file buffer
-        SourceFile sourceFile(pathValue, max);
-        file.read(sourceFile.getBuffer(), max);
+        const std::string canon_path(realPath);
+        const int64_t mtime = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+
+        auto &includedFiles = visitor->getCompilationUnit()->getIncludedFiles();
+        auto it = includedFiles.find(canon_path);
+
+        if (it != includedFiles.end() && m_once) {
+          return;
+        }
+
+        m_path = canon_path;
+
+        CompileStats::Include *included = nullptr;
+
+        if (CompileStats *stats = CompileStats::current()) {
+          included = &stats->includes[canon_path];
+          included->count++;
+        }
+
+        CompileStats::Stopwatch stopwatch(included != nullptr ? &included->nanos : nullptr);
 
-        SourceStream sourceStream(&sourceFile);
         TokenStream tokenStream(TokenStreamInfo { pathValue });
 
+        // a --daemon keeps them from the compilations before this one
+        WarmFiles *warmFiles = visitor->getCompilationUnit()->getWarmFiles();
+        WarmFiles::iterator warm;
+
+        if (it != includedFiles.end() && it->second.mtime == mtime) {
+          tokenStream.m_tokens = it->second.tokens;
+        } else if (warmFiles != nullptr
+            && (warm = warmFiles->find(canon_path)) != warmFiles->end()
+            && warm->second.mtime == mtime) {
+          tokenStream.m_tokens = warm->second.tokens;
+          includedFiles[canon_path] = warm->second;
+        } else {
+          // mapped, not copied: the lexer only reads it
+          SourceFile sourceFile(pathValue);
+
+          if (!sourceFile.isOpen()) {
+            visitor->getCompilationUnit()->getErrorList().addError(CompilerError(
+              LEVEL_ERROR,
+              Msg_custom_error,
+              m_location,
+              "'%': path not found",
+              pathValue
+            ));
+
+            return;
+          }
+
+          const size_t max = sourceFile.getSize();
+
+          TokenCache *tokenCache = visitor->getCompilationUnit()->getTokenCache();
+          uint64_t key = 0;
+
+          if (tokenCache != nullptr) {
+            key = str_util::fnv1a(sourceFile.getBuffer(), max);
+          }
+
+          const size_t numErrors = visitor->getCompilationUnit()->getErrorList().getCount();
+
+          if (tokenCache == nullptr || !tokenCache->load(key, max, pathValue, tokenStream.m_tokens)) {
+            SourceStream sourceStream(&sourceFile);
+
+            Lexer lexer(sourceStream, &tokenStream, visitor->getCompilationUnit());
+            lexer.analyze();
+
+            // errors are reported by lexing it again, next time
+            if (tokenCache != nullptr && visitor->getCompilationUnit()->getErrorList().getCount() == numErrors) {
+              tokenCache->store(key, max, tokenStream.getTokens());
+            }
+          }
+
+          includedFiles[canon_path] = IncludedFile { mtime, tokenStream.getTokens() };
+
+          if (warmFiles != nullptr && visitor->getCompilationUnit()->getErrorList().getCount() == numErrors) {
+            (*warmFiles)[canon_path] = includedFiles[canon_path];
+          }
+        }
+
+        if (included != nullptr) {
+          included->tokens += tokenStream.getTokens().size();
+        }
+
         ASSERT(m_compilationUnit == nullptr);
         m_compilationUnit = new CompilationUnit(visitor->getCompilationUnit()->getDataStorage());
+        m_compilationUnit->setFlat(visitor->getCompilationUnit()->isFlat());
 
         // m_compilationUnit->getBoundGlobals().setParent(
         //   &visitor->getCompilationUnit()->getBoundGlobals());
@@ -125,9 +199,6 @@ namespace bcparse {
         ASSERT(m_iterator == nullptr);
         m_iterator = new AstIterator;
 
-        Lexer lexer(sourceStream, &tokenStream, visitor->getCompilationUnit());
-        lexer.analyze();
-
         Parser parser(m_iterator, &tokenStream, visitor->getCompilationUnit());
         parser.parse();
 
@@ -143,7 +214,13 @@ namespace bcparse {
   }
 
   void AstIncludeDirective::build(AstVisitor *visitor, Module *mod, BytecodeChunk *out) {
-    ASSERT(m_iterator != nullptr);
+    if (m_iterator == nullptr) {
+      return; // included before, with @include_once
+    }
+
+    CompileStats *stats = CompileStats::current();
+    CompileStats::Stopwatch stopwatch(stats != nullptr ? &stats->includes[m_path].nanos : nullptr);
+
     m_iterator->resetPosition();
 
     Compiler compiler(m_iterator, visitor->getCompilationUnit());
@@ -0,0 +1,66 @@
+#include <bcparse/ast/directives/ast_inline_directive.hpp>
+
+#include <bcparse/ast/ast_code_body.hpp>
+
+#include <bcparse/emit/bytecode_chunk.hpp>
+
+#include <bcparse/ast_visitor.hpp>
+#include <bcparse/compilation_unit.hpp>
+
+#include <common/my_assert.hpp>
+
+namespace bcparse {
+
+  AstInlineDirective::AstInlineDirective(const std::vector<Pointer<AstExpression>> &arguments,
+    const std::vector<Token> &tokens,
+    const SourceLocation &location,
+    InlineHint hint)
+    : AstDirectiveImpl(arguments, tokens, location),
+      m_hint(hint) {
+  }
+
+  AstInlineDirective::~AstInlineDirective() {
+  }
+
+  void AstInlineDirective::visit(AstVisitor *visitor, Module *mod) {
+    if (!m_arguments.empty()) {
+      visitor->getCompilationUnit()->getErrorList().addError(CompilerError(
+        LEVEL_ERROR,
+        Msg_custom_error,
+        m_location,
+        "@% takes no arguments",
+        m_hint == InlineHint::Inline ? "inline" : "noinline"
+      ));
+    }
+
+    m_body = makeNode<AstCodeBody>(m_tokens, m_location);
+    m_body->visit(visitor, mod);
+  }
+
+  void AstInlineDirective::build(AstVisitor *visitor, Module *mod, BytecodeChunk *out) {
+    ASSERT(m_body != nullptr);
+
+    std::unique_ptr<BytecodeChunk> chunk(new BytecodeChunk);
+    m_body->build(visitor, mod, chunk.get());
+
+    std::vector<std::unique_ptr<Buildable>*> leaves;
+    chunk->collectLeaves(leaves);
+
+    for (auto leaf : leaves) {
+      if (auto asFCall = dynamic_cast<Op_FCall*>(leaf->get())) {
+        if (asFCall->getHint() == InlineHint::None) {
+          asFCall->setHint(m_hint);
+        }
+      } else if (auto asRet = dynamic_cast<Op_Ret*>(leaf->get())) {
+        if (asRet->getHint() == InlineHint::None) {
+          asRet->setHint(m_hint);
+        }
+      }
+    }
+
+    out->append(std::move(chunk));
+  }
+
+  void AstInlineDirective::optimize(AstVisitor *visitor, Module *mod) {
+  }
+}
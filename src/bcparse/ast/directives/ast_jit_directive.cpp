@@ -0,0 +1,78 @@
+#include <bcparse/ast/directives/ast_jit_directive.hpp>
+
+#include <bcparse/ast/ast_code_body.hpp>
+#include <bcparse/ast/ast_integer_literal.hpp>
+
+#include <bcparse/emit/emit.hpp>
+#include <bcparse/emit/bytecode_chunk.hpp>
+
+#include <bcparse/ast_visitor.hpp>
+#include <bcparse/compilation_unit.hpp>
+
+#include <common/my_assert.hpp>
+
+namespace bcparse {
+
+  AstJitDirective::AstJitDirective(const std::vector<Pointer<AstExpression>> &arguments,
+    const std::vector<Token> &tokens,
+    const SourceLocation &location)
+    : AstDirectiveImpl(arguments, tokens, location),
+      m_memoArgs(0) {
+  }
+
+  AstJitDirective::~AstJitDirective() {
+  }
+
+  void AstJitDirective::visit(AstVisitor *visitor, Module *mod) {
+    if (m_arguments.size() > 1) {
+      visitor->getCompilationUnit()->getErrorList().addError(CompilerError(
+        LEVEL_ERROR,
+        Msg_custom_error,
+        m_location,
+        "@jit takes at most one argument (number of arguments to memoize on)"
+      ));
+    } else if (m_arguments.size() == 1) {
+      AstIntegerLiteral *numArgs = nullptr;
+
+      if (auto arg = m_arguments[0].get()) {
+        arg->visit(visitor, mod);
+
+        numArgs = astCast<AstIntegerLiteral>(arg->getDeepValueOf() != nullptr ? arg->getDeepValueOf() : arg);
+      }
+
+      if (numArgs == nullptr || numArgs->getValue() < 1 || numArgs->getValue() > 255) {
+        visitor->getCompilationUnit()->getErrorList().addError(CompilerError(
+          LEVEL_ERROR,
+          Msg_custom_error,
+          m_location,
+          "@jit (arguments) must be an integer from 1 to 255"
+        ));
+      } else {
+        m_memoArgs = (uint8_t)numArgs->getValue();
+      }
+    }
+
+    m_body = makeNode<AstCodeBody>(m_tokens, m_location);
+    m_body->visit(visitor, mod);
+  }
+
+  void AstJitDirective::build(AstVisitor *visitor, Module *mod, BytecodeChunk *out) {
+    ASSERT(m_body != nullptr);
+
+    // not cached, each region gets its own slot
+    size_t id = visitor->getCompilationUnit()->getDataStorage()->addStaticData(
+      Value((uint64_t)0),
+      false
+    );
+
+    out->append(std::unique_ptr<Op_Jit>(new Op_Jit(Op_Jit::Flags::Begin,
+      ObjLoc(id, ObjLoc::DataStoreLocation::StaticDataStore), m_memoArgs)));
+
+    m_body->build(visitor, mod, out);
+
+    out->append(std::unique_ptr<Op_Jit>(new Op_Jit(Op_Jit::Flags::End)));
+  }
+
+  void AstJitDirective::optimize(AstVisitor *visitor, Module *mod) {
+  }
+}
@@ -0,0 +1,118 @@
+#include <bcparse/ast/directives/ast_link_directive.hpp>
+
+#include <bcparse/ast/ast_label.hpp>
+#include <bcparse/ast/ast_data_location.hpp>
+#include <bcparse/ast/ast_symbol.hpp>
+
+#include <bcparse/emit/bytecode_chunk.hpp>
+#include <bcparse/emit/emit.hpp>
+
+#include <bcparse/ast_visitor.hpp>
+#include <bcparse/compilation_unit.hpp>
+
+#include <common/my_assert.hpp>
+
+namespace bcparse {
+  AstLinkDirective::AstLinkDirective(const std::vector<Pointer<AstExpression>> &arguments,
+    const std::vector<Token> &tokens,
+    const SourceLocation &location,
+    bool exported)
+    : AstDirectiveImpl(arguments, tokens, location),
+      m_target(nullptr),
+      m_exported(exported) {
+  }
+
+  AstLinkDirective::~AstLinkDirective() {
+  }
+
+  void AstLinkDirective::visit(AstVisitor *visitor, Module *mod) {
+    const char *directive = m_exported ? "export" : "extern";
+    AstSymbol *nameArg = nullptr;
+
+    if (m_arguments.size() == 1) {
+      nameArg = astCast<AstSymbol>(m_arguments[0].get());
+    }
+
+    if (nameArg == nullptr) {
+      visitor->getCompilationUnit()->getErrorList().addError(CompilerError(
+        LEVEL_ERROR,
+        Msg_custom_error,
+        m_location,
+        "@% requires one argument, the name of a label",
+        directive
+      ));
+
+      return;
+    }
+
+    m_name = nameArg->getName();
+
+    Pointer<AstExpression> bound = visitor->getCompilationUnit()->getBoundGlobals().get(m_name);
+
+    if (m_exported) {
+      // bound to the label itself, or, as with @function, to its slot
+      if (bound != nullptr) {
+        bound->visit(visitor, mod);
+        m_bound = bound;
+        m_target = bound->getDeepValueOf();
+
+        auto asDataLocation = astCast<AstDataLocation>(m_target);
+
+        if (astCast<AstLabel>(m_target) == nullptr &&
+            (asDataLocation == nullptr || asDataLocation->getIdent() != "s")) {
+          m_target = nullptr;
+        }
+      }
+
+      if (m_target == nullptr) {
+        visitor->getCompilationUnit()->getErrorList().addError(CompilerError(
+          LEVEL_ERROR,
+          Msg_custom_error,
+          m_location,
+          "@export: '%' is not a label",
+          m_name
+        ));
+      }
+
+      return;
+    }
+
+    if (bound != nullptr) {
+      visitor->getCompilationUnit()->getErrorList().addError(CompilerError(
+        LEVEL_ERROR,
+        Msg_custom_error,
+        m_location,
+        "@extern: '%' is already declared",
+        m_name
+      ));
+
+      return;
+    }
+
+    // a label with a slot, but no marker: bclink stores the address
+    Pointer<AstLabel> label = makeNode<AstLabel>(m_name, nullptr, m_location);
+    label->visit(visitor, mod);
+
+    setVariable(visitor, m_name, label);
+
+    m_bound = label;
+    m_target = label.get();
+  }
+
+  void AstLinkDirective::build(AstVisitor *visitor, Module *mod, BytecodeChunk *out) {
+    if (m_target == nullptr) {
+      return;
+    }
+
+    m_target->build(visitor, mod, out);
+
+    out->append(std::unique_ptr<SymbolMarker>(new SymbolMarker(
+      m_target->getObjLoc().getLocation(),
+      m_name,
+      m_exported
+    )));
+  }
+
+  void AstLinkDirective::optimize(AstVisitor *visitor, Module *mod) {
+  }
+}
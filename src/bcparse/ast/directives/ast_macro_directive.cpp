@@ -16,7 +16,7 @@ namespace bcparse {
   }
 
   void AstMacroDirective::visit(AstVisitor *visitor, Module *mod) {
-    const size_t numErrors = visitor->getCompilationUnit()->getErrorList().m_errors.size();
+    const size_t numErrors = visitor->getCompilationUnit()->getErrorList().getCount();
 
     AstSymbol *nameArg = nullptr;
 
@@ -34,7 +34,7 @@ namespace bcparse {
         nameArgExpr->visit(visitor, mod);
 
         if ((deepValue = nameArgExpr->getDeepValueOf()) != nullptr) {
-          nameArg = dynamic_cast<AstSymbol*>(deepValue);
+          nameArg = astCast<AstSymbol>(deepValue);
         }
       }
 
@@ -76,7 +76,7 @@ namespace bcparse {
       ));
     }
 
-    if (visitor->getCompilationUnit()->getErrorList().m_errors.size() > numErrors) return;
+    if (visitor->getCompilationUnit()->getErrorList().getCount() > numErrors) return;
 
     visitor->getCompilationUnit()->getBoundGlobals().defineMacro(nameArg->getName(), m_tokens);
   }
@@ -33,7 +33,7 @@ namespace bcparse {
         nameArgExpr->visit(visitor, mod);
 
         if ((deepValue = nameArgExpr->getDeepValueOf()) != nullptr) {
-          nameArg = dynamic_cast<AstSymbol*>(deepValue);
+          nameArg = astCast<AstSymbol>(deepValue);
         }
       }
 
@@ -74,29 +74,8 @@ namespace bcparse {
       }
 
       if (nameArg != nullptr && valueArg != nullptr) {
-        // if currently in global scope, set the var as a global.
-        // if not, bubble up to the scope highest enough to not reach global
-        Pointer<AstExpression> var;
-        BoundVariables *boundVariables = &visitor->getCompilationUnit()->getBoundGlobals();
-        BoundVariables *varScope = boundVariables;
-
-        // set in closest @var scope or in global scope if none found
-        while (true) {
-          if (var == nullptr) {
-            var = boundVariables->get(nameArg->getName(), false);
-
-            varScope = boundVariables;
-          }
-
-          boundVariables = boundVariables->getParent();
-
-          if (boundVariables == nullptr) {
-            break;
-          }
-        }
-
-        Pointer<AstExpression> clonedExpr = std::dynamic_pointer_cast<AstExpression>(valueArg->clone());
-        varScope->set(nameArg->getName(), clonedExpr);
+        setVariable(visitor, nameArg->getName(),
+          std::dynamic_pointer_cast<AstExpression>(valueArg->clone()));
       }
     }
   }
@@ -0,0 +1,107 @@
+#include <bcparse/ast/directives/ast_struct_directive.hpp>
+
+#include <bcparse/ast/ast_symbol.hpp>
+#include <bcparse/ast/ast_integer_literal.hpp>
+
+#include <bcparse/ast_visitor.hpp>
+#include <bcparse/compilation_unit.hpp>
+
+#include <set>
+
+namespace bcparse {
+  AstStructDirective::AstStructDirective(const std::vector<Pointer<AstExpression>> &arguments,
+    const std::vector<Token> &tokens,
+    const SourceLocation &location)
+    : AstDirectiveImpl(arguments, tokens, location) {
+  }
+
+  AstStructDirective::~AstStructDirective() {
+  }
+
+  void AstStructDirective::visit(AstVisitor *visitor, Module *mod) {
+    AstSymbol *nameArg = nullptr;
+
+    if (m_arguments.size() != 1) {
+      visitor->getCompilationUnit()->getErrorList().addError(CompilerError(
+        LEVEL_ERROR,
+        Msg_custom_error,
+        m_location,
+        "@struct requires arguments (name)"
+      ));
+
+      return;
+    }
+
+    visitArguments(visitor, mod);
+
+    if (AstExpression *deepValue = m_arguments[0]->getDeepValueOf()) {
+      nameArg = astCast<AstSymbol>(deepValue);
+    }
+
+    if (nameArg == nullptr) {
+      visitor->getCompilationUnit()->getErrorList().addError(CompilerError(
+        LEVEL_ERROR,
+        Msg_custom_error,
+        m_arguments[0]->getLocation(),
+        "@struct (name) must be an identifier"
+      ));
+
+      return;
+    }
+
+    std::set<std::string> fields;
+
+    for (const Token &token : m_tokens) {
+      if (token.getTokenClass() == Token::TK_NEWLINE || token.getTokenClass() == Token::TK_COMMA) {
+        continue;
+      }
+
+      if (token.getTokenClass() != Token::TK_IDENT) {
+        visitor->getCompilationUnit()->getErrorList().addError(CompilerError(
+          LEVEL_ERROR,
+          Msg_custom_error,
+          token.getLocation(),
+          "@struct field must be an identifier, got '%'",
+          token.getValue()
+        ));
+
+        continue;
+      }
+
+      if (!fields.insert(token.getValue()).second) {
+        visitor->getCompilationUnit()->getErrorList().addError(CompilerError(
+          LEVEL_ERROR,
+          Msg_custom_error,
+          token.getLocation(),
+          "@struct field '%' is declared twice",
+          token.getValue()
+        ));
+
+        continue;
+      }
+
+      setVariable(visitor, nameArg->getName() + "_" + token.getValue(),
+        makeNode<AstIntegerLiteral>((int64_t)(fields.size() - 1), token.getLocation()));
+    }
+
+    if (fields.empty()) {
+      visitor->getCompilationUnit()->getErrorList().addError(CompilerError(
+        LEVEL_ERROR,
+        Msg_custom_error,
+        m_location,
+        "@struct requires a body of fields"
+      ));
+
+      return;
+    }
+
+    setVariable(visitor, nameArg->getName() + "_size",
+      makeNode<AstIntegerLiteral>((int64_t)fields.size(), m_location));
+  }
+
+  void AstStructDirective::build(AstVisitor *visitor, Module *mod, BytecodeChunk *out) {
+  }
+
+  void AstStructDirective::optimize(AstVisitor *visitor, Module *mod) {
+  }
+}
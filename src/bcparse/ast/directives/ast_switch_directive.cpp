@@ -0,0 +1,101 @@
+#include <bcparse/ast/directives/ast_switch_directive.hpp>
+
+#include <bcparse/ast/ast_data_location.hpp>
+#include <bcparse/ast/ast_integer_literal.hpp>
+
+#include <bcparse/emit/emit.hpp>
+#include <bcparse/emit/bytecode_chunk.hpp>
+
+#include <bcparse/ast_visitor.hpp>
+#include <bcparse/compilation_unit.hpp>
+
+#include <common/my_assert.hpp>
+
+namespace bcparse {
+  const size_t AstSwitchDirective::maxCases;
+
+  AstSwitchDirective::AstSwitchDirective(const std::vector<Pointer<AstExpression>> &arguments,
+    const std::vector<Token> &tokens,
+    const SourceLocation &location)
+    : AstDirectiveImpl(arguments, tokens, location),
+      m_low(0) {
+  }
+
+  AstSwitchDirective::~AstSwitchDirective() {
+  }
+
+  void AstSwitchDirective::visit(AstVisitor *visitor, Module *mod) {
+    AstIntegerLiteral *lowArg = nullptr;
+
+    if (m_arguments.size() < 3 || m_arguments.size() - 3 > maxCases) {
+      visitor->getCompilationUnit()->getErrorList().addError(CompilerError(
+        LEVEL_ERROR,
+        Msg_custom_error,
+        m_location,
+        "@switch requires arguments (src, low, default) and at most % cases",
+        maxCases
+      ));
+
+      return;
+    }
+
+    visitArguments(visitor, mod);
+
+    if (AstExpression *deepValue = m_arguments[1]->getDeepValueOf()) {
+      lowArg = astCast<AstIntegerLiteral>(deepValue);
+    }
+
+    if (lowArg == nullptr) {
+      visitor->getCompilationUnit()->getErrorList().addError(CompilerError(
+        LEVEL_ERROR,
+        Msg_custom_error,
+        m_arguments[1]->getLocation(),
+        "@switch (low) must be an integer"
+      ));
+    } else {
+      m_low = lowArg->getValue();
+    }
+
+    // written as direct jumps, which only reach labels of this source
+    for (size_t i = 3; i < m_arguments.size(); i++) {
+      AstDataLocation *slot = astCast<AstDataLocation>(m_arguments[i]->getDeepValueOf());
+
+      if (slot == nullptr || slot->getIdent() != "s" || slot->getOffset() == nullptr
+          || !visitor->getCompilationUnit()->getDataStorage()->isLabel((size_t)slot->getOffset()->getValue())) {
+        visitor->getCompilationUnit()->getErrorList().addError(CompilerError(
+          LEVEL_ERROR,
+          Msg_custom_error,
+          m_arguments[i]->getLocation(),
+          "@switch (case) must be a label"
+        ));
+      }
+    }
+  }
+
+  void AstSwitchDirective::build(AstVisitor *visitor, Module *mod, BytecodeChunk *out) {
+    std::vector<ObjLoc> cases;
+
+    ASSERT(m_arguments.size() >= 3);
+
+    // `low` is an immediate, not loaded anywhere
+    for (size_t i = 0; i < m_arguments.size(); i++) {
+      if (i != 1) {
+        m_arguments[i]->build(visitor, mod, out);
+      }
+    }
+
+    for (size_t i = 3; i < m_arguments.size(); i++) {
+      cases.push_back(m_arguments[i]->getObjLoc());
+    }
+
+    out->append(std::unique_ptr<Op_Switch>(new Op_Switch(
+      m_arguments[0]->getObjLoc(),
+      m_low,
+      cases,
+      m_arguments[2]->getObjLoc()
+    )));
+  }
+
+  void AstSwitchDirective::optimize(AstVisitor *visitor, Module *mod) {
+  }
+}
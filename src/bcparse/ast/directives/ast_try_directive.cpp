@@ -0,0 +1,84 @@
+#include <bcparse/ast/directives/ast_try_directive.hpp>
+
+#include <bcparse/ast/ast_code_body.hpp>
+#include <bcparse/ast/ast_label.hpp>
+#include <bcparse/ast/ast_data_location.hpp>
+
+#include <bcparse/emit/emit.hpp>
+#include <bcparse/emit/bytecode_chunk.hpp>
+
+#include <bcparse/ast_visitor.hpp>
+#include <bcparse/compilation_unit.hpp>
+
+#include <common/my_assert.hpp>
+
+namespace bcparse {
+  AstTryDirective::AstTryDirective(const std::vector<Pointer<AstExpression>> &arguments,
+    const std::vector<Token> &tokens,
+    const SourceLocation &location)
+    : AstDirectiveImpl(arguments, tokens, location),
+      m_handler(nullptr) {
+  }
+
+  AstTryDirective::~AstTryDirective() {
+  }
+
+  void AstTryDirective::visit(AstVisitor *visitor, Module *mod) {
+    if (m_arguments.size() == 1 && m_arguments[0] != nullptr) {
+      m_arguments[0]->visit(visitor, mod);
+
+      // a label, or, interpolated, its slot
+      AstExpression *handler = m_arguments[0]->getDeepValueOf();
+      auto asDataLocation = astCast<AstDataLocation>(handler);
+
+      if (astCast<AstLabel>(handler) != nullptr ||
+          (asDataLocation != nullptr && asDataLocation->getIdent() == "s")) {
+        m_handler = handler;
+      }
+    }
+
+    if (m_handler == nullptr) {
+      visitor->getCompilationUnit()->getErrorList().addError(CompilerError(
+        LEVEL_ERROR,
+        Msg_custom_error,
+        m_location,
+        "@try_region requires one argument, the label of its handler"
+      ));
+    }
+
+    // a flat stream has no table for the region, so its handler would
+    // never run: see TryMarker
+    if (visitor->getCompilationUnit()->isFlat()) {
+      visitor->getCompilationUnit()->getErrorList().addError(CompilerError(
+        LEVEL_ERROR,
+        Msg_custom_error,
+        m_location,
+        "@try_region (and @try) needs a sectioned program, not --flat"
+      ));
+    }
+
+    m_body = makeNode<AstCodeBody>(m_tokens, m_location);
+    m_body->visit(visitor, mod);
+  }
+
+  void AstTryDirective::build(AstVisitor *visitor, Module *mod, BytecodeChunk *out) {
+    ASSERT(m_body != nullptr);
+
+    if (m_handler == nullptr) {
+      return;
+    }
+
+    m_handler->build(visitor, mod, out);
+
+    const size_t handler = m_handler->getObjLoc().getLocation();
+
+    out->append(std::unique_ptr<TryMarker>(new TryMarker(TryMarker::Flags::Begin, handler)));
+
+    m_body->build(visitor, mod, out);
+
+    out->append(std::unique_ptr<TryMarker>(new TryMarker(TryMarker::Flags::End, handler)));
+  }
+
+  void AstTryDirective::optimize(AstVisitor *visitor, Module *mod) {
+  }
+}
@@ -0,0 +1,143 @@
+#include <bcparse/ast/directives/ast_unroll_directive.hpp>
+
+#include <bcparse/ast/ast_symbol.hpp>
+#include <bcparse/ast/ast_label_decl.hpp>
+#include <bcparse/ast/ast_integer_literal.hpp>
+
+#include <bcparse/emit/bytecode_chunk.hpp>
+
+#include <bcparse/parser.hpp>
+#include <bcparse/analyzer.hpp>
+#include <bcparse/compiler.hpp>
+#include <bcparse/ast_visitor.hpp>
+#include <bcparse/ast_iterator.hpp>
+#include <bcparse/compilation_unit.hpp>
+
+namespace bcparse {
+  const int64_t AstUnrollDirective::maxCount;
+
+  AstUnrollDirective::AstUnrollDirective(const std::vector<Pointer<AstExpression>> &arguments,
+    const std::vector<Token> &tokens,
+    const SourceLocation &location)
+    : AstDirectiveImpl(arguments, tokens, location) {
+  }
+
+  AstUnrollDirective::~AstUnrollDirective() {
+  }
+
+  void AstUnrollDirective::visit(AstVisitor *visitor, Module *mod) {
+    AstIntegerLiteral *countArg = nullptr;
+    AstSymbol *indexArg = nullptr;
+
+    if (m_arguments.size() != 1 && m_arguments.size() != 2) {
+      visitor->getCompilationUnit()->getErrorList().addError(CompilerError(
+        LEVEL_ERROR,
+        Msg_custom_error,
+        m_location,
+        "@unroll requires arguments (count) or (count, index)"
+      ));
+
+      return;
+    }
+
+    visitArguments(visitor, mod);
+
+    if (AstExpression *deepValue = m_arguments[0]->getDeepValueOf()) {
+      countArg = astCast<AstIntegerLiteral>(deepValue);
+    }
+
+    if (countArg == nullptr || countArg->getValue() < 0 || countArg->getValue() > maxCount) {
+      visitor->getCompilationUnit()->getErrorList().addError(CompilerError(
+        LEVEL_ERROR,
+        Msg_custom_error,
+        m_arguments[0]->getLocation(),
+        "@unroll (count) must be an integer from 0 to %",
+        maxCount
+      ));
+
+      return;
+    }
+
+    if (m_arguments.size() == 2) {
+      if (AstExpression *deepValue = m_arguments[1]->getDeepValueOf()) {
+        indexArg = astCast<AstSymbol>(deepValue);
+      }
+
+      if (indexArg == nullptr) {
+        visitor->getCompilationUnit()->getErrorList().addError(CompilerError(
+          LEVEL_ERROR,
+          Msg_custom_error,
+          m_arguments[1]->getLocation(),
+          "@unroll (index) must be an identifier"
+        ));
+
+        return;
+      }
+    }
+
+    // parsed once, each copy a clone of it, as a macro's body is
+    AstIterator tmpl;
+
+    {
+      TokenStream tokenStream(TokenStreamInfo { m_location.getFileName() });
+      CompilationUnit tmp(visitor->getCompilationUnit()->getDataStorage());
+
+      tokenStream.m_tokens = m_tokens;
+
+      Parser parser(&tmpl, &tokenStream, &tmp);
+      parser.parse();
+
+      if (tmp.getErrorList().getCount() != 0) {
+        visitor->getCompilationUnit()->getErrorList().addErrors(tmp.getErrorList());
+
+        return;
+      }
+    }
+
+    for (int64_t i = 0; i < countArg->getValue(); i++) {
+      CompilationUnit *unit = new CompilationUnit(visitor->getCompilationUnit()->getDataStorage());
+      unit->setFlat(visitor->getCompilationUnit()->isFlat());
+      AstIterator *iterator = new AstIterator;
+
+      m_compilationUnits.emplace_back(unit);
+      m_iterators.emplace_back(iterator);
+
+      unit->getBoundGlobals().setParent(&visitor->getCompilationUnit()->getBoundGlobals());
+
+      if (indexArg != nullptr) {
+        unit->getBoundGlobals().set(indexArg->getName(), makeNode<AstIntegerLiteral>(i, m_location));
+      }
+
+      for (auto &stmt : tmpl.getStatements()) {
+        Pointer<AstStatement> clone = cloneAstNode(stmt);
+
+        // as the parser declares them, so each copy has labels of its own
+        if (auto labelDecl = astCast<AstLabelDecl>(clone.get())) {
+          unit->getBoundGlobals().set(labelDecl->getName(), labelDecl->getAstLabel());
+        }
+
+        iterator->push(clone);
+      }
+
+      Analyzer analyzer(iterator, unit);
+      analyzer.analyze();
+
+      visitor->getCompilationUnit()->getErrorList().addErrors(unit->getErrorList());
+    }
+  }
+
+  void AstUnrollDirective::build(AstVisitor *visitor, Module *mod, BytecodeChunk *out) {
+    for (size_t i = 0; i < m_iterators.size(); i++) {
+      m_iterators[i]->resetPosition();
+
+      Compiler compiler(m_iterators[i].get(), m_compilationUnits[i].get());
+
+      std::unique_ptr<BytecodeChunk> sub(new BytecodeChunk);
+      compiler.compile(sub.get(), false);
+      out->append(std::move(sub));
+    }
+  }
+
+  void AstUnrollDirective::optimize(AstVisitor *visitor, Module *mod) {
+  }
+}
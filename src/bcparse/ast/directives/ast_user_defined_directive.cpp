@@ -1,14 +1,17 @@
 #include <bcparse/ast/directives/ast_user_defined_directive.hpp>
 
 #include <bcparse/ast/ast_code_body.hpp>
+#include <bcparse/ast/ast_label_decl.hpp>
 
 #include <bcparse/lexer.hpp>
 #include <bcparse/parser.hpp>
 #include <bcparse/analyzer.hpp>
 #include <bcparse/compiler.hpp>
 #include <bcparse/ast_visitor.hpp>
+#include <bcparse/compile_stats.hpp>
 #include <bcparse/ast_iterator.hpp>
 #include <bcparse/compilation_unit.hpp>
+#include <bcparse/macro.hpp>
 
 namespace bcparse {
   AstUserDefinedDirective::AstUserDefinedDirective(const std::string &name,
@@ -32,7 +35,7 @@ namespace bcparse {
   }
 
   void AstUserDefinedDirective::visit(AstVisitor *visitor, Module *mod) {
-    // lookup macro data and instantiate it, re-parsing the body
+    // lookup macro data and instantiate it, cloning the parsed body
     Macro *macro = visitor->getCompilationUnit()->getBoundGlobals().lookupMacro(m_name);
 
     if (!macro) {
@@ -46,19 +49,38 @@ namespace bcparse {
       return;
     }
 
+    if (CompileStats *stats = CompileStats::current()) {
+      stats->macroInstantiations[m_name]++;
+    }
+
     std::stringstream filenameStream;
     filenameStream << m_location.getFileName();
     filenameStream << "@" << m_name;
     filenameStream << " (instantiated on line " << m_location.getLine() << ")";
 
-    TokenStream tokenStream(TokenStreamInfo { filenameStream.str() });
+    if (!macro->isTemplateParsed()) {
+      // nothing the parser does depends on the arguments, so the body is
+      // parsed on its own, into statements that are cloned and never visited
+      TokenStream tokenStream(TokenStreamInfo { filenameStream.str() });
+      CompilationUnit tmp(visitor->getCompilationUnit()->getDataStorage());
+      AstIterator *tmpl = new AstIterator;
+
+      tokenStream.m_tokens = macro->getBody();
 
-    for (auto &token : macro->getBody()) {
-      tokenStream.push(token);
+      Parser parser(tmpl, &tokenStream, &tmp);
+      parser.parse();
+
+      if (tmp.getErrorList().getCount() == 0) {
+        macro->setTemplate(tmpl);
+      } else {
+        delete tmpl;
+        macro->setTemplate(nullptr);
+      }
     }
 
     ASSERT(m_compilationUnit == nullptr);
     m_compilationUnit = new CompilationUnit(visitor->getCompilationUnit()->getDataStorage());
+    m_compilationUnit->setFlat(visitor->getCompilationUnit()->isFlat());
 
     m_compilationUnit->getBoundGlobals().setParent(
       &visitor->getCompilationUnit()->getBoundGlobals());
@@ -74,21 +96,36 @@ namespace bcparse {
       m_compilationUnit->getBoundGlobals().set(ss.str(), m_arguments[i]);
     }
 
-    m_compilationUnit->getBoundGlobals().set("body", Pointer<AstCodeBody>(
-      new AstCodeBody(m_tokens, m_location)));
+    m_compilationUnit->getBoundGlobals().set("body", makeNode<AstCodeBody>(m_tokens, m_location));
 
     ASSERT(m_iterator == nullptr);
     m_iterator = new AstIterator;
 
-    Parser parser(m_iterator, &tokenStream, m_compilationUnit);
-    parser.parse();
+    if (const AstIterator *tmpl = macro->getTemplate()) {
+      for (auto &stmt : tmpl->getStatements()) {
+        Pointer<AstStatement> clone = cloneAstNode(stmt);
+
+        // as the parser declares them
+        if (auto labelDecl = astCast<AstLabelDecl>(clone.get())) {
+          m_compilationUnit->getBoundGlobals().set(labelDecl->getName(), labelDecl->getAstLabel());
+        }
+
+        m_iterator->push(clone);
+      }
+    } else {
+      // reports the errors parsing it, in this instantiation
+      TokenStream tokenStream(TokenStreamInfo { filenameStream.str() });
+
+      tokenStream.m_tokens = macro->getBody();
+
+      Parser parser(m_iterator, &tokenStream, m_compilationUnit);
+      parser.parse();
+    }
 
     Analyzer analyzer(m_iterator, m_compilationUnit);
     analyzer.analyze();
 
-    for (auto &error : m_compilationUnit->getErrorList().getErrors()) {
-      visitor->getCompilationUnit()->getErrorList().addError(error);
-    }
+    visitor->getCompilationUnit()->getErrorList().addErrors(m_compilationUnit->getErrorList());
   }
 
   void AstUserDefinedDirective::build(AstVisitor *visitor, Module *mod, BytecodeChunk *out) {
@@ -36,7 +36,7 @@ namespace bcparse {
         nameArgExpr->visit(visitor, mod);
 
         if ((deepValue = nameArgExpr->getDeepValueOf()) != nullptr) {
-          nameArg = dynamic_cast<AstSymbol*>(deepValue);
+          nameArg = astCast<AstSymbol>(deepValue);
         }
       }
 
@@ -60,7 +60,7 @@ namespace bcparse {
       } else {
         // set in current scope
         visitor->getCompilationUnit()->getBoundGlobals().set(
-          nameArg->getName(), Pointer<AstUnset>(new AstUnset(m_location)));
+          nameArg->getName(), makeNode<AstUnset>(m_location));
       }
     }
   }
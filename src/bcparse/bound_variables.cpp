@@ -1,10 +1,17 @@
 #include <bcparse/bound_variables.hpp>
 
+#include <shared/symbol_table.hpp>
+
 #include <common/my_assert.hpp>
 
 #include <stdexcept>
 
 namespace bcparse {
+  // bumped by whatever changes a binding, which makes every resolution
+  // remembered before it stale. the scopes of one compilation are only
+  // used from the thread compiling it.
+  static thread_local uint64_t generation = 1;
+
   BoundVariables::BoundVariables()
     : m_parent(nullptr) {
   }
@@ -23,6 +30,7 @@ namespace bcparse {
     }
 
     m_parent = parent;
+    generation++;
   }
 
   BoundVariables *BoundVariables::getParent() {
@@ -30,38 +38,61 @@ namespace bcparse {
   }
 
   Pointer<AstExpression> BoundVariables::get(const std::string &name, bool bubbles) {
+    return get(SymbolTable::intern(name), bubbles);
+  }
+
+  Pointer<AstExpression> BoundVariables::get(const std::string *name, bool bubbles) {
     auto it = m_map.find(name);
 
-    if (it == m_map.end()) {
-      if (bubbles && m_parent != nullptr) {
-        return m_parent->get(name);
-      }
+    if (it != m_map.end()) {
+      return it->second;
+    }
 
+    if (!bubbles || m_parent == nullptr) {
       return nullptr;
     }
 
-    return it->second;
+    Resolved &resolved = m_resolved[name];
+
+    if (resolved.generation != generation) {
+      Pointer<AstExpression> value;
+
+      for (BoundVariables *scope = m_parent; scope != nullptr; scope = scope->m_parent) {
+        auto found = scope->m_map.find(name);
+
+        if (found != scope->m_map.end()) {
+          value = found->second;
+          break;
+        }
+      }
+
+      resolved.generation = generation;
+      resolved.value = value;
+    }
+
+    return resolved.value;
   }
 
   void BoundVariables::set(const std::string &name, const Pointer<AstExpression> &value) {
-    m_map[name] = value;
+    m_map[SymbolTable::intern(name)] = value;
+    generation++;
   }
 
   void BoundVariables::defineMacro(const std::string &name, const std::vector<Token> &body) {
-    m_macros[name] = std::unique_ptr<Macro>(new Macro(name, body));
+    m_macros[SymbolTable::intern(name)] = std::unique_ptr<Macro>(new Macro(name, body));
   }
 
   Macro *BoundVariables::lookupMacro(const std::string &name) {
-    auto it = m_macros.find(name);
+    const std::string *key = SymbolTable::intern(name);
 
-    if (it == m_macros.end()) {
-      if (m_parent) {
-        return m_parent->lookupMacro(name);
-      }
+    for (BoundVariables *scope = this; scope != nullptr; scope = scope->m_parent) {
+      auto it = scope->m_macros.find(key);
 
-      return nullptr;
+      if (it != scope->m_macros.end()) {
+        return it->second.get();
+      }
     }
 
-    return it->second.get();
+    return nullptr;
   }
 }
@@ -3,7 +3,10 @@
 namespace bcparse {
   CompilationUnit::CompilationUnit(DataStorage *dataStorage)
     : m_dataStorage(dataStorage),
-      m_variableMode(false) {
+      m_tokenCache(nullptr),
+      m_warmFiles(nullptr),
+      m_variableMode(false),
+      m_flat(false) {
   }
 
   CompilationUnit::~CompilationUnit() {
@@ -0,0 +1,243 @@
+#include <bcparse/compile_cache.hpp>
+#include <bcparse/dependency_file.hpp>
+
+#include <shared/bin_format.h>
+
+#include <common/str_util.hpp>
+
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cstdio>
+#include <climits>
+#include <cstdlib>
+#include <thread>
+
+#include <unistd.h>
+#include <sys/stat.h>
+
+namespace bcparse {
+  // fnv1a, going on from `h`
+  static uint64_t hashMore(uint64_t h, const std::string &str) {
+    for (size_t i = 0; i < str.size(); i++) {
+      h = (h ^ (uint8_t)str[i]) * 0x100000001B3ull;
+    }
+
+    return h;
+  }
+
+  static std::string hex(uint64_t value) {
+    std::stringstream ss;
+    ss << std::hex << std::setw(16) << std::setfill('0') << value;
+
+    return ss.str();
+  }
+
+  // the running compiler's executable, hashed once: another build of it
+  // may emit something else, or bind other builtins
+  static uint64_t compilerHash() {
+    static const uint64_t hash = []() {
+      uint64_t out;
+
+      if (!DependencyFile::hashFile("/proc/self/exe", out)) {
+        out = str_util::fnv1a(__DATE__ " " __TIME__, sizeof(__DATE__ " " __TIME__) - 1);
+      }
+
+      return out;
+    }();
+
+    return hash;
+  }
+
+  // `path` relative to the directory `from`, both canonical
+  static std::string relativePath(const std::string &from, const std::string &path) {
+    size_t common = 0;
+    std::string rel;
+
+    if (path.size() > from.size() && path.compare(0, from.size(), from) == 0 && path[from.size()] == '/') {
+      return path.substr(from.size() + 1);
+    }
+
+    // up to the last separator both have in the same place
+    for (size_t i = 0; i < from.size() && i < path.size() && from[i] == path[i]; i++) {
+      if (from[i] == '/') {
+        common = i + 1;
+      }
+    }
+
+
+    for (size_t i = common; i <= from.size(); i++) {
+      if (i == from.size() || from[i] == '/') {
+        rel += "../";
+      }
+    }
+
+    return rel + path.substr(common);
+  }
+
+  CompileCache::CompileCache(const std::string &dir, const std::string &options)
+    : m_dir(dir) {
+    // as TokenCache's: if it cannot be made, every lookup misses
+    mkdir(m_dir.c_str(), 0777);
+
+    std::stringstream ss;
+    ss << "bb8cache " << COMPILE_CACHE_VERSION << " bin " << BIN_VERSION
+       << " compiler " << hex(compilerHash()) << " options " << options;
+
+    m_base = hashMore(str_util::fnv1a("", 0), ss.str());
+  }
+
+  std::string CompileCache::entryPath(uint64_t key, const char *extension) const {
+    return m_dir + "/" + hex(key) + extension;
+  }
+
+  std::string CompileCache::tempPath(const std::string &path) {
+    char host[256] = "";
+    std::stringstream tmp;
+
+    gethostname(host, sizeof(host) - 1);
+    tmp << path << "." << host << "." << getpid() << "." << std::this_thread::get_id() << ".tmp";
+
+    return tmp.str();
+  }
+
+  bool CompileCache::manifestKey(const std::string &source, uint64_t &key, std::string &dir) const {
+    char realPath[PATH_MAX];
+    uint64_t hash;
+
+    if (realpath(source.c_str(), realPath) == nullptr || !DependencyFile::hashFile(realPath, hash)) {
+      return false;
+    }
+
+    dir = realPath;
+    dir.erase(dir.find_last_of('/'));
+
+    // by contents, not by path: the same source elsewhere hits
+    key = hashMore(m_base, "source " + hex(hash));
+
+    return true;
+  }
+
+  bool CompileCache::fetch(const std::string &source, const std::string &outPath, std::vector<std::string> &includes) const {
+    std::vector<std::string> found;
+    std::string dir, line;
+    uint64_t key;
+
+    if (!manifestKey(source, key, dir)) {
+      return false;
+    }
+
+    std::ifstream manifest(entryPath(key, ".bb8m"), std::ios::in);
+
+    if (!manifest.is_open()) {
+      return false;
+    }
+
+    if (!std::getline(manifest, line) || line != "bb8cache " + std::to_string(COMPILE_CACHE_VERSION)) {
+      return false;
+    }
+
+    uint64_t resultKey = key;
+
+    while (std::getline(manifest, line)) {
+      const size_t space = line.find(' ');
+      char realPath[PATH_MAX];
+      uint64_t expected, actual;
+
+      if (space == std::string::npos) {
+        return false;
+      }
+
+      std::stringstream ss(line.substr(0, space));
+      ss >> std::hex >> expected;
+
+      const std::string path = dir + "/" + line.substr(space + 1);
+
+      if (ss.fail() || !DependencyFile::hashFile(path, actual) || actual != expected
+          || realpath(path.c_str(), realPath) == nullptr) {
+        return false;
+      }
+
+      resultKey = hashMore(resultKey, line);
+      found.push_back(realPath);
+    }
+
+    std::ifstream result(entryPath(resultKey, ".bb8o"), std::ios::in | std::ios::binary);
+
+    if (!result.is_open()) {
+      return false;
+    }
+
+    std::ofstream of(outPath, std::ios::out | std::ios::binary | std::ios::trunc);
+
+    if (!of.is_open()) {
+      return false;
+    }
+
+    // an empty output is never stored, so one is a read that failed
+    if (result.peek() == EOF || !(of << result.rdbuf()) || !of.flush()) {
+      of.close();
+      std::remove(outPath.c_str());
+      return false;
+    }
+
+    includes.insert(includes.end(), found.begin(), found.end());
+
+    return true;
+  }
+
+  void CompileCache::store(const std::string &source, const std::string &outPath, const std::vector<std::string> &includes) const {
+    std::stringstream entries;
+    std::string dir;
+    uint64_t key;
+
+    if (!manifestKey(source, key, dir)) {
+      return;
+    }
+
+    uint64_t resultKey = key;
+
+    for (const std::string &include : includes) {
+      uint64_t hash;
+
+      if (!DependencyFile::hashFile(include, hash)) {
+        return;
+      }
+
+      const std::string line = hex(hash) + " " + relativePath(dir, include);
+
+      resultKey = hashMore(resultKey, line);
+      entries << line << "\n";
+    }
+
+    // the output first: a manifest is only there once what it names is
+    const std::string resultPath = entryPath(resultKey, ".bb8o");
+    const std::string manifestPath = entryPath(key, ".bb8m");
+    const std::string resultTemp = tempPath(resultPath);
+    const std::string manifestTemp = tempPath(manifestPath);
+
+    {
+      std::ifstream in(outPath, std::ios::in | std::ios::binary);
+      std::ofstream of(resultTemp, std::ios::out | std::ios::binary);
+
+      if (!in.is_open() || !of.is_open() || in.peek() == EOF || !(of << in.rdbuf()) || !of.flush()) {
+        std::remove(resultTemp.c_str());
+        return; // the cache is an optimization; compiling goes on without it
+      }
+    }
+
+    if (std::rename(resultTemp.c_str(), resultPath.c_str()) != 0) {
+      std::remove(resultTemp.c_str());
+      return;
+    }
+
+    std::ofstream of(manifestTemp, std::ios::out | std::ios::trunc);
+
+    of << "bb8cache " << COMPILE_CACHE_VERSION << "\n" << entries.str();
+    of.close();
+
+    if (!of || std::rename(manifestTemp.c_str(), manifestPath.c_str()) != 0) {
+      std::remove(manifestTemp.c_str());
+    }
+  }
+}
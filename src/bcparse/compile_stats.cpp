@@ -0,0 +1,212 @@
+#include <bcparse/compile_stats.hpp>
+
+#include <chrono>
+#include <iomanip>
+
+namespace bcparse {
+  static thread_local CompileStats *currentStats = nullptr;
+
+  static const char *const phaseNames[CompileStats::NUM_PHASES] = {
+    "other", "lex", "parse", "analyze", "compile", "optimize", "emit"
+  };
+
+  static uint64_t nowNanos() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()
+    ).count();
+  }
+
+  std::string CompileStats::jsonEscape(const std::string &s) {
+    std::string out;
+
+    for (char ch : s) {
+      if (ch == '"' || ch == '\\') {
+        out += '\\';
+        out += ch;
+      } else if ((unsigned char)ch < 0x20) {
+        static const char hex[] = "0123456789abcdef";
+
+        out += "\\u00";
+        out += hex[(ch >> 4) & 0xF];
+        out += hex[ch & 0xF];
+      } else {
+        out += ch;
+      }
+    }
+
+    return out;
+  }
+
+  static double millis(uint64_t nanos) {
+    return (double)nanos / 1e6;
+  }
+
+  CompileStats *CompileStats::current() {
+    return currentStats;
+  }
+
+  void CompileStats::charge(uint64_t now) {
+    phaseNanos[m_phase] += now - m_since;
+    m_since = now;
+  }
+
+  CompileStats::Scope::Scope(CompileStats *stats)
+    : m_previous(currentStats) {
+    currentStats = stats;
+
+    if (stats != nullptr && stats->m_since == 0) {
+      stats->m_since = nowNanos();
+    }
+  }
+
+  CompileStats::Scope::~Scope() {
+    if (currentStats != nullptr) {
+      currentStats->charge(nowNanos());
+    }
+
+    currentStats = m_previous;
+  }
+
+  CompileStats::Timer::Timer(Phase phase)
+    : m_stats(currentStats),
+      m_previous(PHASE_NONE) {
+    if (m_stats != nullptr) {
+      m_stats->charge(nowNanos());
+      m_previous = m_stats->m_phase;
+      m_stats->m_phase = phase;
+    }
+  }
+
+  CompileStats::Timer::~Timer() {
+    if (m_stats != nullptr) {
+      m_stats->charge(nowNanos());
+      m_stats->m_phase = m_previous;
+    }
+  }
+
+  CompileStats::Stopwatch::Stopwatch(uint64_t *nanos)
+    : m_nanos(nanos),
+      m_start(nanos != nullptr ? nowNanos() : 0) {
+  }
+
+  CompileStats::Stopwatch::~Stopwatch() {
+    if (m_nanos != nullptr) {
+      *m_nanos += nowNanos() - m_start;
+    }
+  }
+
+  void CompileStats::write(std::ostream &os, bool times, bool counts, bool json) const {
+    uint64_t total = 0;
+
+    for (uint64_t nanos : phaseNanos) {
+      total += nanos;
+    }
+
+    const std::ios::fmtflags flags = os.flags();
+    const std::streamsize precision = os.precision();
+
+    os << std::fixed << std::setprecision(3);
+
+    if (json) {
+      const char *sep = "";
+
+      os << "{";
+
+      if (times) {
+        os << "\"phases_ms\": {";
+
+        for (int i = 0; i < NUM_PHASES; i++) {
+          os << (i == 0 ? "" : ", ") << "\"" << phaseNames[i] << "\": " << millis(phaseNanos[i]);
+        }
+
+        os << ", \"total\": " << millis(total) << "}";
+        sep = ", ";
+      }
+
+      os << sep << "\"includes\": [";
+
+      for (auto it = includes.begin(); it != includes.end(); ++it) {
+        os << (it == includes.begin() ? "" : ", ")
+          << "{\"path\": \"" << jsonEscape(it->first) << "\", \"count\": " << it->second.count
+          << ", \"tokens\": " << it->second.tokens;
+
+        if (times) {
+          os << ", \"ms\": " << millis(it->second.nanos);
+        }
+
+        os << "}";
+      }
+
+      os << "]";
+
+      if (counts) {
+        os << ", \"macro_instantiations\": {";
+
+        for (auto it = macroInstantiations.begin(); it != macroInstantiations.end(); ++it) {
+          os << (it == macroInstantiations.begin() ? "" : ", ")
+            << "\"" << jsonEscape(it->first) << "\": " << it->second;
+        }
+
+        os << "}, \"tokens_lexed\": " << tokensLexed
+          << ", \"ast_nodes\": " << astNodes
+          << ", \"static_data\": " << staticData
+          << ", \"code_bytes\": " << codeSize
+          << ", \"output_bytes\": " << outputSize;
+
+        if (cached >= 0) {
+          os << ", \"cached\": " << (cached ? "true" : "false");
+        }
+      }
+
+      os << "}\n";
+    } else {
+      if (times) {
+        os << "phase             ms\n";
+
+        for (int i = 0; i < NUM_PHASES; i++) {
+          os << "  " << std::left << std::setw(10) << phaseNames[i] << std::right << std::setw(10) << millis(phaseNanos[i]) << "\n";
+        }
+
+        os << "  " << std::left << std::setw(10) << "total" << std::right << std::setw(10) << millis(total) << "\n";
+      }
+
+      if (!includes.empty()) {
+        os << "includes     count    tokens" << (times ? "        ms" : "") << "\n";
+
+        for (const auto &it : includes) {
+          os << "  " << it.first << "\n"
+            << "           " << std::setw(7) << it.second.count << std::setw(10) << it.second.tokens;
+
+          if (times) {
+            os << std::setw(10) << millis(it.second.nanos);
+          }
+
+          os << "\n";
+        }
+      }
+
+      if (counts) {
+        if (!macroInstantiations.empty()) {
+          os << "macro instantiations\n";
+
+          for (const auto &it : macroInstantiations) {
+            os << "  " << std::left << std::setw(20) << it.first << std::right << std::setw(8) << it.second << "\n";
+          }
+        }
+
+        os << "tokens lexed  " << std::setw(10) << tokensLexed << "\n"
+          << "ast nodes     " << std::setw(10) << astNodes << "\n"
+          << "static data   " << std::setw(10) << staticData << " entries\n"
+          << "code          " << std::setw(10) << codeSize << " bytes\n"
+          << "output        " << std::setw(10) << outputSize << " bytes\n";
+
+        if (cached >= 0) {
+          os << "compile cache " << std::setw(10) << (cached ? "hit" : "miss") << "\n";
+        }
+      }
+    }
+
+    os.flags(flags);
+    os.precision(precision);
+  }
+}
@@ -1,12 +1,22 @@
 #include <bcparse/compiler.hpp>
 #include <bcparse/ast_iterator.hpp>
 #include <bcparse/compilation_unit.hpp>
+#include <bcparse/compile_stats.hpp>
+
+#include <bcparse/ast/ast_directive.hpp>
 
 #include <bcparse/emit/bytecode_chunk.hpp>
 
 #include <common/my_assert.hpp>
 
 namespace bcparse {
+  namespace {
+    // the statement being built on this thread, which is where the
+    // statements a directive expands to, compiled while it builds, were
+    // expanded from
+    thread_local std::shared_ptr<const SourceTrace> currentTrace;
+  }
+
   Compiler::Compiler(AstIterator *iterator, CompilationUnit *compilationUnit)
     : AstVisitor(iterator, compilationUnit) {
   }
@@ -16,12 +26,35 @@ namespace bcparse {
   }
 
   void Compiler::compile(BytecodeChunk *top, bool buildStaticData) {
+    CompileStats::Timer timer(CompileStats::PHASE_COMPILE);
+
     while (m_iterator->hasNext()) {
       auto node = m_iterator->next();
       ASSERT(node != nullptr);
 
+      std::shared_ptr<SourceTrace> trace(new SourceTrace { node->getLocation(), "", currentTrace });
+
+      if (auto asDirective = astCast<AstDirective>(node.get())) {
+        trace->directive = asDirective->getName();
+      }
+
+      const std::shared_ptr<const SourceTrace> caller = currentTrace;
       std::unique_ptr<BytecodeChunk> chunk(new BytecodeChunk);
+
+      currentTrace = trace;
       node->build(this, nullptr, chunk.get());
+      currentTrace = caller;
+
+      // those a nested compile built have a trace of their own already
+      std::vector<std::unique_ptr<Buildable>*> leaves;
+      chunk->collectLeaves(leaves);
+
+      for (auto leaf : leaves) {
+        if ((*leaf)->getTrace() == nullptr) {
+          (*leaf)->setTrace(trace);
+        }
+      }
+
       top->append(std::move(chunk));
     }
 
@@ -103,7 +103,37 @@ namespace bcparse {
     : m_level(other.m_level),
       m_msg(other.m_msg),
       m_location(other.m_location),
-      m_text(other.m_text) {
+      m_args(other.m_args),
+      m_text(other.m_text),
+      m_formatted(other.m_formatted) {
+  }
+
+  const std::string &CompilerError::getText() const {
+    if (m_formatted) {
+      return m_text;
+    }
+
+    // each `%` takes the next argument; one past the last is left as is
+    size_t next = 0;
+    const char *format;
+
+    if (m_msg == Msg_custom_error) {
+      format = m_args.empty() ? "" : m_args[next++].c_str();
+    } else {
+      format = error_message_strings.at(m_msg).c_str();
+    }
+
+    for (; *format; format++) {
+      if (*format == '%' && next < m_args.size()) {
+        m_text += m_args[next++];
+      } else {
+        m_text += *format;
+      }
+    }
+
+    m_formatted = true;
+
+    return m_text;
   }
 
   bool CompilerError::operator<(const CompilerError &other) const {
@@ -0,0 +1,583 @@
+#include <bcparse/const_evaluator.hpp>
+
+#include <bcparse/ast/ast_integer_literal.hpp>
+#include <bcparse/ast/ast_float_literal.hpp>
+#include <bcparse/ast/ast_string_literal.hpp>
+
+#include <bcparse/compilation_unit.hpp>
+
+#include <sstream>
+#include <cmath>
+
+namespace bcparse {
+  ConstEvaluator::ConstEvaluator(CompilationUnit *unit,
+    const std::vector<Token> &tokens,
+    const SourceLocation &location)
+    : m_unit(unit),
+      m_location(location),
+      m_pos(0),
+      m_steps(0) {
+    // an expression may span lines
+    for (const Token &token : tokens) {
+      if (token.getTokenClass() != Token::TK_NEWLINE) {
+        m_tokens.push_back(token);
+      }
+    }
+  }
+
+  Pointer<AstExpression> ConstEvaluator::evaluate() {
+    Constant result;
+    bool ok;
+
+    if (m_tokens.empty()) {
+      error(m_location, "@eval requires an expression");
+
+      return nullptr;
+    }
+
+    // the outermost call needs no parentheses
+    if (m_tokens.size() > 1 && m_tokens[0].getTokenClass() == Token::TK_IDENT) {
+      const Token op = m_tokens[m_pos++];
+
+      ok = evalCall(op, result);
+    } else {
+      ok = evalTerm(result);
+    }
+
+    if (ok && !atEnd()) {
+      ok = error(m_tokens[m_pos].getLocation(), "unexpected `" + m_tokens[m_pos].getValue() + "` in @eval");
+    }
+
+    if (!ok) {
+      return nullptr;
+    }
+
+    switch (result.kind) {
+      case Constant::Int:
+        return makeNode<AstIntegerLiteral>(result.i, m_location);
+      case Constant::Float:
+        return makeNode<AstFloatLiteral>(result.f, m_location);
+      default:
+        return makeNode<AstStringLiteral>(result.s, m_location);
+    }
+  }
+
+  bool ConstEvaluator::evalTerm(Constant &out) {
+    if (++m_steps > maxSteps) {
+      std::stringstream ss;
+      ss << "@eval did not finish within " << maxSteps << " steps";
+
+      return error(m_location, ss.str());
+    }
+
+    if (atEnd()) {
+      return error(m_location, "@eval expression ends early");
+    }
+
+    const Token token = m_tokens[m_pos++];
+
+    switch (token.getTokenClass()) {
+      case Token::TK_INTEGER: {
+        std::istringstream ss(token.getValue());
+        out = Constant();
+        ss >> out.i;
+
+        return true;
+      }
+      case Token::TK_FLOAT: {
+        std::istringstream ss(token.getValue());
+        out = Constant();
+        out.kind = Constant::Float;
+        ss >> out.f;
+
+        return true;
+      }
+      case Token::TK_STRING:
+        out = Constant();
+        out.kind = Constant::String;
+        out.s = token.getValue();
+
+        return true;
+      case Token::TK_IDENT:
+        return lookup(token, out);
+      case Token::TK_OPEN_PARENTH: {
+        if (atEnd() || m_tokens[m_pos].getTokenClass() != Token::TK_IDENT) {
+          return error(token.getLocation(), "expected an operator after `(`");
+        }
+
+        const Token op = m_tokens[m_pos++];
+
+        if (!evalCall(op, out)) {
+          return false;
+        }
+
+        if (atEnd() || m_tokens[m_pos].getTokenClass() != Token::TK_CLOSE_PARENTH) {
+          return error(token.getLocation(), "expected `)` to close `(" + op.getValue() + "`");
+        }
+
+        m_pos++;
+
+        return true;
+      }
+      default:
+        return error(token.getLocation(), "unexpected `" + token.getValue() + "` in @eval");
+    }
+  }
+
+  bool ConstEvaluator::evalCall(const Token &op, Constant &out) {
+    const std::string &name = op.getValue();
+
+    // these evaluate only some of their arguments, or some more than once
+    if (name == "if") {
+      Constant cond;
+
+      if (!evalTerm(cond)) {
+        return false;
+      }
+
+      if (cond.kind == Constant::String) {
+        return error(op.getLocation(), "if (condition) must be a number");
+      }
+
+      if (cond.kind == Constant::Float ? cond.f != 0.0 : cond.i != 0) {
+        return evalTerm(out) && skipTerm();
+      }
+
+      return skipTerm() && evalTerm(out);
+    }
+
+    if (name == "let") {
+      Local local;
+
+      if (!readName(local.name) || !evalTerm(local.value)) {
+        return false;
+      }
+
+      m_locals.push_back(local);
+
+      const bool ok = evalTerm(out);
+
+      m_locals.pop_back();
+
+      return ok;
+    }
+
+    if (name == "table" || name == "fold") {
+      return evalLoop(op, out);
+    }
+
+    std::vector<Constant> args;
+
+    while (!atEnd() && m_tokens[m_pos].getTokenClass() != Token::TK_CLOSE_PARENTH) {
+      args.emplace_back();
+
+      if (!evalTerm(args.back())) {
+        return false;
+      }
+    }
+
+    return evalOp(op, args, out);
+  }
+
+  bool ConstEvaluator::evalLoop(const Token &op, Constant &out) {
+    Local index;
+    Constant from, to;
+    size_t slot, body;
+    bool ok = true;
+
+    if (op.getValue() == "table") {
+      if (!evalTerm(to) || !readName(index.name)) {
+        return false;
+      }
+
+      if (to.kind != Constant::Int || to.i < 0 || (uint64_t)to.i > maxLength) {
+        std::stringstream ss;
+        ss << "table (size) must be an integer from 0 to " << maxLength;
+
+        return error(op.getLocation(), ss.str());
+      }
+
+      out = Constant();
+      out.kind = Constant::String;
+      out.s.reserve(to.i);
+    } else {
+      Local acc;
+
+      if (!readName(index.name) || !evalTerm(from) || !evalTerm(to)
+        || !readName(acc.name) || !evalTerm(acc.value)) {
+        return false;
+      }
+
+      if (from.kind != Constant::Int || to.kind != Constant::Int) {
+        return error(op.getLocation(), "fold (from, to) must be integers");
+      }
+
+      out = acc.value;
+      m_locals.push_back(acc);
+    }
+
+    m_locals.push_back(index);
+    slot = m_locals.size() - 1;
+    body = m_pos;
+
+    for (int64_t i = op.getValue() == "table" ? 0 : from.i; ok && i < to.i; i++) {
+      Constant value;
+
+      m_locals[slot].value.i = i;
+      m_pos = body;
+
+      if (!(ok = evalTerm(value))) {
+        break;
+      }
+
+      if (op.getValue() == "fold") {
+        out = value;
+        m_locals[slot - 1].value = value;
+      } else if (value.kind != Constant::Int || value.i < 0 || value.i > 0xFF) {
+        ok = error(op.getLocation(), "table (body) must give a byte from 0 to 255");
+      } else {
+        out.s.push_back((char)value.i);
+      }
+    }
+
+    m_locals.resize(op.getValue() == "fold" ? slot - 1 : slot);
+    m_pos = body;
+
+    return ok && skipTerm();
+  }
+
+  bool ConstEvaluator::evalOp(const Token &op, const std::vector<Constant> &args, Constant &out) {
+    const std::string &name = op.getValue();
+
+    out = Constant();
+
+    if (name == "add" || name == "sub" || name == "mul" || name == "div" || name == "mod"
+      || name == "min" || name == "max") {
+      if (!expectArgs(op, args, 2, "nn")) {
+        return false;
+      }
+
+      if (args[0].kind == Constant::Float || args[1].kind == Constant::Float) {
+        const double a = args[0].kind == Constant::Float ? args[0].f : (double)args[0].i;
+        const double b = args[1].kind == Constant::Float ? args[1].f : (double)args[1].i;
+
+        out.kind = Constant::Float;
+
+        if (name == "add") out.f = a + b;
+        else if (name == "sub") out.f = a - b;
+        else if (name == "mul") out.f = a * b;
+        else if (name == "div") out.f = a / b;
+        else if (name == "mod") out.f = std::fmod(a, b);
+        else if (name == "min") out.f = a < b ? a : b;
+        else out.f = a > b ? a : b;
+
+        return true;
+      }
+
+      // wrapping, as the vm's integers do
+      const uint64_t a = (uint64_t)args[0].i;
+      const uint64_t b = (uint64_t)args[1].i;
+
+      if ((name == "div" || name == "mod") && b == 0) {
+        return error(op.getLocation(), "division by zero in @eval");
+      }
+
+      if (name == "add") out.i = (int64_t)(a + b);
+      else if (name == "sub") out.i = (int64_t)(a - b);
+      else if (name == "mul") out.i = (int64_t)(a * b);
+      else if (name == "div") out.i = args[1].i == -1 ? (int64_t)(0 - a) : args[0].i / args[1].i;
+      else if (name == "mod") out.i = args[1].i == -1 ? 0 : args[0].i % args[1].i;
+      else if (name == "min") out.i = args[0].i < args[1].i ? args[0].i : args[1].i;
+      else out.i = args[0].i > args[1].i ? args[0].i : args[1].i;
+
+      return true;
+    }
+
+    if (name == "neg") {
+      if (!expectArgs(op, args, 1, "n")) {
+        return false;
+      }
+
+      out.kind = args[0].kind;
+      out.f = -args[0].f;
+      out.i = (int64_t)(0 - (uint64_t)args[0].i);
+
+      return true;
+    }
+
+    if (name == "and" || name == "or" || name == "xor" || name == "shl" || name == "shr") {
+      if (!expectArgs(op, args, 2, "ii")) {
+        return false;
+      }
+
+      const uint64_t a = (uint64_t)args[0].i;
+      const uint64_t b = (uint64_t)args[1].i;
+
+      if (name == "and") out.i = (int64_t)(a & b);
+      else if (name == "or") out.i = (int64_t)(a | b);
+      else if (name == "xor") out.i = (int64_t)(a ^ b);
+      else if (name == "shl") out.i = (int64_t)(a << (b & 63));
+      else out.i = args[0].i >> (b & 63);
+
+      return true;
+    }
+
+    if (name == "not") {
+      if (!expectArgs(op, args, 1, "i")) {
+        return false;
+      }
+
+      out.i = ~args[0].i;
+
+      return true;
+    }
+
+    if (name == "eq" || name == "ne" || name == "lt" || name == "le" || name == "gt" || name == "ge") {
+      int cmp;
+
+      if (args.size() == 2 && args[0].kind == Constant::String && args[1].kind == Constant::String) {
+        cmp = args[0].s.compare(args[1].s);
+      } else if (!expectArgs(op, args, 2, "nn")) {
+        return false;
+      } else if (args[0].kind == Constant::Float || args[1].kind == Constant::Float) {
+        const double a = args[0].kind == Constant::Float ? args[0].f : (double)args[0].i;
+        const double b = args[1].kind == Constant::Float ? args[1].f : (double)args[1].i;
+
+        cmp = a < b ? -1 : (a > b ? 1 : 0);
+      } else {
+        cmp = args[0].i < args[1].i ? -1 : (args[0].i > args[1].i ? 1 : 0);
+      }
+
+      if (name == "eq") out.i = cmp == 0;
+      else if (name == "ne") out.i = cmp != 0;
+      else if (name == "lt") out.i = cmp < 0;
+      else if (name == "le") out.i = cmp <= 0;
+      else if (name == "gt") out.i = cmp > 0;
+      else out.i = cmp >= 0;
+
+      return true;
+    }
+
+    if (name == "cat") {
+      out.kind = Constant::String;
+
+      if (!expectArgs(op, args, args.size(), std::string(args.size(), 's').c_str())) {
+        return false;
+      }
+
+      for (const Constant &arg : args) {
+        if (out.s.size() + arg.s.size() > maxLength) {
+          return error(op.getLocation(), "string built by @eval is too long");
+        }
+
+        out.s += arg.s;
+      }
+
+      return true;
+    }
+
+    if (name == "len") {
+      if (!expectArgs(op, args, 1, "s")) {
+        return false;
+      }
+
+      out.i = (int64_t)args[0].s.size();
+
+      return true;
+    }
+
+    if (name == "at") {
+      if (!expectArgs(op, args, 2, "si")) {
+        return false;
+      }
+
+      if (args[1].i < 0 || (uint64_t)args[1].i >= args[0].s.size()) {
+        return error(op.getLocation(), "at (index) is out of range");
+      }
+
+      out.i = (uint8_t)args[0].s[args[1].i];
+
+      return true;
+    }
+
+    if (name == "substr") {
+      if (!expectArgs(op, args, 3, "sii")) {
+        return false;
+      }
+
+      if (args[1].i < 0 || args[2].i < 0 || (uint64_t)args[1].i + (uint64_t)args[2].i > args[0].s.size()) {
+        return error(op.getLocation(), "substr (start, length) is out of range");
+      }
+
+      out.kind = Constant::String;
+      out.s = args[0].s.substr(args[1].i, args[2].i);
+
+      return true;
+    }
+
+    if (name == "repeat") {
+      if (!expectArgs(op, args, 2, "si")) {
+        return false;
+      }
+
+      if (args[1].i < 0 || (args[0].s.size() != 0 && (uint64_t)args[1].i > maxLength / args[0].s.size())) {
+        return error(op.getLocation(), "string built by @eval is too long");
+      }
+
+      out.kind = Constant::String;
+
+      for (int64_t i = 0; i < args[1].i; i++) {
+        out.s += args[0].s;
+      }
+
+      return true;
+    }
+
+    if (name == "chr") {
+      if (!expectArgs(op, args, 1, "i")) {
+        return false;
+      }
+
+      if (args[0].i < 0 || args[0].i > 0xFF) {
+        return error(op.getLocation(), "chr (value) must be from 0 to 255");
+      }
+
+      out.kind = Constant::String;
+      out.s = std::string(1, (char)args[0].i);
+
+      return true;
+    }
+
+    if (name == "str") {
+      if (!expectArgs(op, args, 1, "n")) {
+        return false;
+      }
+
+      std::stringstream ss;
+
+      if (args[0].kind == Constant::Float) {
+        ss << args[0].f;
+      } else {
+        ss << args[0].i;
+      }
+
+      out.kind = Constant::String;
+      out.s = ss.str();
+
+      return true;
+    }
+
+    return error(op.getLocation(), "unknown @eval operator `" + name + "`");
+  }
+
+  bool ConstEvaluator::skipTerm() {
+    int depth = 0;
+
+    do {
+      if (atEnd()) {
+        return error(m_location, "@eval expression ends early");
+      }
+
+      const Token::TokenClass tokenClass = m_tokens[m_pos].getTokenClass();
+
+      if (tokenClass == Token::TK_OPEN_PARENTH) {
+        ++depth;
+      } else if (tokenClass == Token::TK_CLOSE_PARENTH && --depth < 0) {
+        return error(m_tokens[m_pos].getLocation(), "unexpected `)` in @eval");
+      }
+
+      m_pos++;
+    } while (depth != 0);
+
+    return true;
+  }
+
+  bool ConstEvaluator::lookup(const Token &name, Constant &out) {
+    for (auto it = m_locals.rbegin(); it != m_locals.rend(); ++it) {
+      if (it->name == name.getValue()) {
+        out = it->value;
+
+        return true;
+      }
+    }
+
+    Pointer<AstExpression> bound = m_unit->getBoundGlobals().get(name.getValue());
+
+    if (bound == nullptr) {
+      return error(name.getLocation(), "`" + name.getValue() + "` is not defined");
+    }
+
+    AstExpression *value = bound->getDeepValueOf() != nullptr ? bound->getDeepValueOf() : bound.get();
+
+    out = Constant();
+
+    switch (value->getKind()) {
+      case AstKind::IntegerLiteral:
+        out.i = static_cast<AstIntegerLiteral*>(value)->getValue();
+        return true;
+      case AstKind::FloatLiteral:
+        out.kind = Constant::Float;
+        out.f = static_cast<AstFloatLiteral*>(value)->getValue();
+        return true;
+      case AstKind::StringLiteral:
+        out.kind = Constant::String;
+        out.s = static_cast<AstStringLiteral*>(value)->getValue();
+        return true;
+      default:
+        return error(name.getLocation(), "`" + name.getValue() + "` is not a constant, got " + value->toString());
+    }
+  }
+
+  bool ConstEvaluator::readName(std::string &out) {
+    if (atEnd() || m_tokens[m_pos].getTokenClass() != Token::TK_IDENT) {
+      return error(atEnd() ? m_location : m_tokens[m_pos].getLocation(), "expected a name in @eval");
+    }
+
+    out = m_tokens[m_pos++].getValue();
+
+    return true;
+  }
+
+  bool ConstEvaluator::expectArgs(const Token &op, const std::vector<Constant> &args, size_t count, const char *kinds) {
+    static const char *const kindNames[] = { "an integer", "a number", "a string" };
+
+    if (args.size() != count) {
+      std::stringstream ss;
+      ss << op.getValue() << " takes " << count << " argument" << (count == 1 ? "" : "s")
+        << ", got " << args.size();
+
+      return error(op.getLocation(), ss.str());
+    }
+
+    for (size_t i = 0; i < count; i++) {
+      const Constant::Kind kind = args[i].kind;
+      const int expected = kinds[i] == 'i' ? 0 : (kinds[i] == 'n' ? 1 : 2);
+
+      if ((expected == 0 && kind != Constant::Int)
+        || (expected == 1 && kind == Constant::String)
+        || (expected == 2 && kind != Constant::String)) {
+        std::stringstream ss;
+        ss << op.getValue() << " (argument " << (i + 1) << ") must be " << kindNames[expected];
+
+        return error(op.getLocation(), ss.str());
+      }
+    }
+
+    return true;
+  }
+
+  bool ConstEvaluator::atEnd() const {
+    return m_pos >= m_tokens.size();
+  }
+
+  bool ConstEvaluator::error(const SourceLocation &location, const std::string &message) {
+    m_unit->getErrorList().addError(CompilerError(
+      LEVEL_ERROR,
+      Msg_custom_error,
+      location,
+      message.c_str()
+    ));
+
+    return false;
+  }
+}
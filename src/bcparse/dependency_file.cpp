@@ -0,0 +1,103 @@
+#include <bcparse/dependency_file.hpp>
+
+#include <common/str_util.hpp>
+
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+
+namespace bcparse {
+  DependencyFile::DependencyFile(const std::string &options)
+    : m_options(options) {
+  }
+
+  bool DependencyFile::hashFile(const std::string &path, uint64_t &out) {
+    std::ifstream file(path, std::ios::in | std::ios::binary | std::ios::ate);
+
+    if (!file.is_open()) {
+      return false;
+    }
+
+    const size_t size = file.tellg();
+    std::string buffer(size, '\0');
+
+    file.seekg(0, std::ios::beg);
+
+    if (size != 0 && !file.read(&buffer[0], size)) {
+      return false;
+    }
+
+    out = str_util::fnv1a(buffer.data(), size);
+
+    return true;
+  }
+
+  bool DependencyFile::add(const std::string &path) {
+    Entry entry { 0, path };
+
+    if (!hashFile(path, entry.hash)) {
+      return false;
+    }
+
+    m_entries.push_back(entry);
+
+    return true;
+  }
+
+  bool DependencyFile::write(const std::string &path) const {
+    std::ofstream of(path, std::ios::out | std::ios::trunc);
+
+    if (!of.is_open()) {
+      return false;
+    }
+
+    of << "bb8deps " << DEPENDENCY_FILE_VERSION << "\n";
+    of << "options " << m_options << "\n";
+
+    for (const Entry &entry : m_entries) {
+      of << std::hex << std::setw(16) << std::setfill('0') << entry.hash << std::dec;
+      of << " " << entry.path << "\n";
+    }
+
+    return (bool)of;
+  }
+
+  bool DependencyFile::isUpToDate(const std::string &path, const std::string &options) {
+    std::ifstream file(path, std::ios::in);
+    std::string line;
+    bool any = false;
+
+    if (!file.is_open()) {
+      return false;
+    }
+
+    if (!std::getline(file, line) || line != "bb8deps " + std::to_string(DEPENDENCY_FILE_VERSION)) {
+      return false;
+    }
+
+    if (!std::getline(file, line) || line != "options " + options) {
+      return false;
+    }
+
+    while (std::getline(file, line)) {
+      const size_t space = line.find(' ');
+      uint64_t expected, actual;
+
+      if (space == std::string::npos) {
+        return false;
+      }
+
+      std::stringstream ss(line.substr(0, space));
+      ss >> std::hex >> expected;
+
+      if (ss.fail() || !hashFile(line.substr(space + 1), actual) || actual != expected) {
+        return false;
+      }
+
+      any = true;
+    }
+
+    // at least the source itself
+    return any;
+  }
+}
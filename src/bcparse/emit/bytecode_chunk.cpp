@@ -1,6 +1,17 @@
 #include <bcparse/emit/bytecode_chunk.hpp>
 #include <bcparse/emit/bytecode_stream.hpp>
 #include <bcparse/emit/formatter.hpp>
+#include <bcparse/emit/emit.hpp>
+#include <bcparse/emit/data_storage.hpp>
+
+#include <shared/builtins.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <set>
+#include <utility>
 
 namespace bcparse {
   BytecodeChunk::BytecodeChunk() {
@@ -22,7 +33,13 @@ namespace bcparse {
     Buildable::accept(bs);
 
     for (const auto &b : m_buildables) {
-      b->accept(bs);
+      if (b != nullptr) {
+        if (b->getTrace() != nullptr) {
+          bs->acceptTrace(b->getTrace());
+        }
+
+        b->accept(bs);
+      }
     }
   }
 
@@ -32,12 +49,2212 @@ namespace bcparse {
     f->increaseIndent();
 
     for (const auto &b : m_buildables) {
-      b->debugPrint(bs, f);
+      if (b != nullptr) {
+        b->debugPrint(bs, f);
+      }
     }
 
     f->decreaseIndent();
   }
 
+  void BytecodeChunk::collectLeaves(std::vector<std::unique_ptr<Buildable>*> &out) {
+    for (auto &b : m_buildables) {
+      if (b == nullptr) {
+        continue;
+      }
+
+      if (auto asChunk = dynamic_cast<BytecodeChunk*>(b.get())) {
+        asChunk->collectLeaves(out);
+      } else {
+        out.push_back(&b);
+      }
+    }
+  }
+
+  namespace {
+    // points `leaf` at `replacement`, which takes over the trace of the
+    // instruction it replaces, so the debug map still places it
+    void replaceLeaf(std::unique_ptr<Buildable> &leaf, Buildable *replacement) {
+      if (leaf != nullptr) {
+        replacement->setTrace(leaf->getTrace());
+      }
+
+      leaf.reset(replacement);
+    }
+
+    // what foldConstants knows a location holds
+    struct KnownValue {
+      int64_t value;
+      std::unique_ptr<Buildable> *def; // the load that set it
+      bool read; // since the load, at runtime
+    };
+
+    class ConstantState {
+    public:
+      typedef std::pair<int, int> Key;
+
+      static bool isTracked(const ObjLoc &loc) {
+        return loc.getDataStoreLocation() == ObjLoc::DataStoreLocation::RegisterDataStore ||
+          loc.getDataStoreLocation() == ObjLoc::DataStoreLocation::LocalDataStore;
+      }
+
+      static Key keyOf(const ObjLoc &loc) {
+        return Key((int)loc.getDataStoreLocation(), loc.getLocation());
+      }
+
+      KnownValue *find(const ObjLoc &loc) {
+        auto it = m_values.find(keyOf(loc));
+        return it == m_values.end() ? nullptr : &it->second;
+      }
+
+      // marks what `loc` holds as used at runtime, so its load stays
+      void read(const ObjLoc &loc) {
+        if (KnownValue *known = find(loc)) {
+          known->read = true;
+        }
+      }
+
+      // `loc` is overwritten by something else than a known integer.
+      // relative and absolute $l[] slots may be the same, so a store to
+      // one forgets the other kind.
+      void forget(const ObjLoc &loc) {
+        if (loc.getDataStoreLocation() == ObjLoc::DataStoreLocation::VMDataStore) {
+          // may move the stack $l[] is relative to
+          clear();
+          return;
+        }
+
+        if (loc.getDataStoreLocation() == ObjLoc::DataStoreLocation::FrameDataStore) {
+          // may be any $l[] slot
+          for (auto it = m_values.begin(); it != m_values.end();) {
+            if (it->first.first == (int)ObjLoc::DataStoreLocation::LocalDataStore) {
+              it = m_values.erase(it);
+            } else {
+              ++it;
+            }
+          }
+
+          return;
+        }
+
+        if (!isTracked(loc)) {
+          return;
+        }
+
+        auto it = m_values.find(keyOf(loc));
+
+        if (it != m_values.end()) {
+          m_values.erase(it);
+        }
+
+        if (loc.getDataStoreLocation() == ObjLoc::DataStoreLocation::LocalDataStore) {
+          for (auto it = m_values.begin(); it != m_values.end();) {
+            if (it->first.first == (int)ObjLoc::DataStoreLocation::LocalDataStore &&
+                (it->first.second < 0) != loc.isRelative()) {
+              it = m_values.erase(it);
+            } else {
+              ++it;
+            }
+          }
+        }
+      }
+
+      // `loc` now holds `value`, set by the load at `def`
+      void set(const ObjLoc &loc, int64_t value, std::unique_ptr<Buildable> *def) {
+        if (KnownValue *known = find(loc)) {
+          if (!known->read && known->def != nullptr && *known->def != nullptr) {
+            known->def->reset();
+          }
+        }
+
+        forget(loc);
+        m_values[keyOf(loc)] = { value, def, false };
+      }
+
+      void clear() {
+        m_values.clear();
+      }
+
+    private:
+      std::map<Key, KnownValue> m_values;
+    };
+
+    bool asInteger(const Value &value, int64_t &out) {
+      if (value.getValueType() != Value::ValueType::ValueTypeI64 || value.getSize() != sizeof(out)) {
+        return false;
+      }
+
+      std::memcpy(&out, value.getBytes(), sizeof(out));
+
+      return true;
+    }
+
+    // the right operand of a binop or cmp, read as an integer, if known
+    bool knownOperand(ConstantState &state, const Operand &operand, int64_t &out) {
+      if (operand.isImmediate()) {
+        return asInteger(operand.getImmediate(), out);
+      }
+
+      if (KnownValue *known = state.find(operand.getObjLoc())) {
+        out = known->value;
+        return true;
+      }
+
+      return false;
+    }
+  }
+
+  void BytecodeChunk::foldConstants() {
+    std::vector<std::unique_ptr<Buildable>*> leaves;
+    collectLeaves(leaves);
+
+    ConstantState state;
+
+    // the flags of the last cmp, when both its sides were known, and the
+    // cmp itself, while every jump reading them has been resolved
+    bool knownFlags = false;
+    int64_t flagsLeft = 0, flagsRight = 0;
+    std::unique_ptr<Buildable> *unreadCmp = nullptr;
+
+    // what runs before may come from elsewhere, or set anything
+    auto endBlock = [&]() {
+      state.clear();
+      knownFlags = false;
+      unreadCmp = nullptr;
+    };
+
+    for (auto leaf : leaves) {
+      Buildable *b = leaf->get();
+
+      if (auto asLoad = dynamic_cast<Op_Load*>(b)) {
+        int64_t value;
+
+        if (asLoad->getPoolIndex() == Op_Load::noPoolIndex &&
+            ConstantState::isTracked(asLoad->getObjLoc()) &&
+            asInteger(asLoad->getValue(), value)) {
+          state.set(asLoad->getObjLoc(), value, leaf);
+        } else {
+          state.forget(asLoad->getObjLoc());
+        }
+
+        continue;
+      }
+
+      if (auto asMov = dynamic_cast<Op_Mov*>(b)) {
+        KnownValue *known = state.find(asMov->getRight());
+
+        if (known != nullptr && ConstantState::isTracked(asMov->getLeft())) {
+          const int64_t value = known->value;
+          const ObjLoc dst = asMov->getLeft();
+
+          replaceLeaf(*leaf, new Op_Load(dst, Value(value)));
+          state.set(dst, value, leaf);
+        } else {
+          state.read(asMov->getRight());
+          state.forget(asMov->getLeft());
+        }
+
+        continue;
+      }
+
+      Op_Add *asAdd = dynamic_cast<Op_Add*>(b);
+      Op_Sub *asSub = asAdd == nullptr ? dynamic_cast<Op_Sub*>(b) : nullptr;
+      Op_Mul *asMul = asAdd == nullptr && asSub == nullptr ? dynamic_cast<Op_Mul*>(b) : nullptr;
+
+      if (asAdd != nullptr || asSub != nullptr || asMul != nullptr) {
+        const ObjLoc &left = asAdd ? asAdd->getLeft() : asSub ? asSub->getLeft() : asMul->getLeft();
+        const Operand &right = asAdd ? asAdd->getRight() : asSub ? asSub->getRight() : asMul->getRight();
+        const Op_Cmp::Flags flags = asAdd ? asAdd->getFlags() : asSub ? asSub->getFlags() : asMul->getFlags();
+
+        KnownValue *known = state.find(left);
+        int64_t r;
+
+        if (known != nullptr && flags == Op_Cmp::Flags::None && knownOperand(state, right, r)) {
+          // wrapping, as the vm does
+          const uint64_t l = (uint64_t)known->value;
+          const int64_t value = (int64_t)(asAdd ? l + (uint64_t)r : asSub ? l - (uint64_t)r : l * (uint64_t)r);
+          const ObjLoc dst = left;
+
+          replaceLeaf(*leaf, new Op_Load(dst, Value(value)));
+          state.set(dst, value, leaf);
+        } else {
+          state.read(left);
+
+          if (!right.isImmediate()) {
+            state.read(right.getObjLoc());
+          }
+
+          state.forget(left);
+        }
+
+        continue;
+      }
+
+      if (auto asCmp = dynamic_cast<Op_Cmp*>(b)) {
+        KnownValue *known = state.find(asCmp->getLeft());
+        int64_t r;
+
+        // a cmp nothing read the flags of before this one is gone
+        if (unreadCmp != nullptr) {
+          unreadCmp->reset();
+          unreadCmp = nullptr;
+        }
+
+        state.read(asCmp->getLeft());
+
+        if (!asCmp->getRight().isImmediate()) {
+          state.read(asCmp->getRight().getObjLoc());
+        }
+
+        // a plain cmp sets the flags from the difference truncated to an
+        // int, which only agrees with comparing when it fits
+        knownFlags = known != nullptr && knownOperand(state, asCmp->getRight(), r) &&
+          (int64_t)(int32_t)((uint64_t)known->value - (uint64_t)r) == (int64_t)((uint64_t)known->value - (uint64_t)r);
+
+        if (knownFlags) {
+          flagsLeft = known->value;
+          flagsRight = r;
+          unreadCmp = leaf;
+        }
+
+        continue;
+      }
+
+      if (auto asJmp = dynamic_cast<Op_Jmp*>(b)) {
+        if (asJmp->getFlags() != Op_Jmp::Flags::None && knownFlags) {
+          bool taken = false;
+
+          switch (asJmp->getFlags()) {
+            case Op_Jmp::Flags::JumpIfEqual: taken = flagsLeft == flagsRight; break;
+            case Op_Jmp::Flags::JumpIfNotEqual: taken = flagsLeft != flagsRight; break;
+            case Op_Jmp::Flags::JumpIfGreater: taken = flagsLeft > flagsRight; break;
+            case Op_Jmp::Flags::JumpIfGreaterOrEqual: taken = flagsLeft >= flagsRight; break;
+            default: break;
+          }
+
+          if (!taken) {
+            leaf->reset();
+            continue;
+          }
+
+          // the target may read the flags, so the cmp stays
+          replaceLeaf(*leaf, new Op_Jmp(ObjLoc(asJmp->getObjLoc())));
+        }
+
+        endBlock();
+
+        continue;
+      }
+
+      if (auto asPrint = dynamic_cast<Op_Print*>(b)) {
+        state.read(asPrint->getObjLoc());
+
+        continue;
+      }
+
+      endBlock();
+    }
+  }
+
+  namespace {
+    // a createObject call scratchObjects follows
+    struct ScratchCandidate {
+      std::unique_ptr<Buildable> *create;
+      size_t dead; // the leaf after which nothing holds the object any more
+      bool escapes;
+    };
+  }
+
+  void BytecodeChunk::scratchObjects() {
+    std::vector<std::unique_ptr<Buildable>*> leaves;
+    collectLeaves(leaves);
+
+    // a register, or a stack slot by its position from where the block
+    // started, which pushes and pops move away from
+    typedef std::pair<bool, int64_t> Key;
+
+    std::vector<ScratchCandidate> candidates;
+    std::map<Key, size_t> holders; // to the candidate each holds
+    int64_t depth = 0;
+
+    auto keyOf = [&](const ObjLoc &loc, Key &key) {
+      if (loc.getDataStoreLocation() == ObjLoc::DataStoreLocation::RegisterDataStore) {
+        key = Key(false, loc.getLocation());
+        return true;
+      }
+
+      // $l[-1] is the slot pushed last
+      if (loc.getDataStoreLocation() == ObjLoc::DataStoreLocation::LocalDataStore && loc.isRelative()) {
+        key = Key(true, depth + loc.getLocation());
+        return true;
+      }
+
+      return false;
+    };
+
+    auto heldBy = [&](const ObjLoc &loc) {
+      Key key;
+
+      if (keyOf(loc, key)) {
+        auto it = holders.find(key);
+
+        if (it != holders.end()) {
+          return (int64_t)it->second;
+        }
+      }
+
+      return (int64_t)-1;
+    };
+
+    auto escape = [&](size_t c) {
+      candidates[c].escapes = true;
+
+      for (auto it = holders.begin(); it != holders.end();) {
+        if (it->second == c) {
+          it = holders.erase(it);
+        } else {
+          ++it;
+        }
+      }
+    };
+
+    // $f[] and absolute $l[] may be any stack slot, so whatever the block
+    // pushed may be read through them
+    auto readAliased = [&](const ObjLoc &loc) {
+      const bool aliased = loc.getDataStoreLocation() == ObjLoc::DataStoreLocation::FrameDataStore ||
+        (loc.getDataStoreLocation() == ObjLoc::DataStoreLocation::LocalDataStore && !loc.isRelative());
+
+      if (!aliased) {
+        return;
+      }
+
+      for (auto it = holders.begin(); it != holders.end();) {
+        if (it->first.first) {
+          escape(it->second);
+          it = holders.begin();
+        } else {
+          ++it;
+        }
+      }
+    };
+
+    // what `loc` held is gone, at leaf `at`. a store through $f[] or an
+    // absolute $l[] is not followed: the candidate there is taken to be
+    // held still, and escapes at the end of the block.
+    auto overwrite = [&](const Key &key, size_t at) {
+      auto it = holders.find(key);
+
+      if (it == holders.end()) {
+        return;
+      }
+
+      const size_t c = it->second;
+      holders.erase(it);
+
+      for (const auto &holder : holders) {
+        if (holder.second == c) {
+          return;
+        }
+      }
+
+      candidates[c].dead = at;
+    };
+
+    auto overwriteLoc = [&](const ObjLoc &loc, size_t at) {
+      Key key;
+
+      if (keyOf(loc, key)) {
+        overwrite(key, at);
+      }
+    };
+
+    // what is still held leaves the block; the rest was scratch all along
+    auto endBlock = [&]() {
+      size_t release = 0;
+      bool any = false;
+
+      for (const auto &holder : holders) {
+        candidates[holder.second].escapes = true;
+      }
+
+      for (const ScratchCandidate &candidate : candidates) {
+        if (candidate.escapes) {
+          continue;
+        }
+
+        const Op_Call::Flags flags = static_cast<Op_Call*>(candidate.create->get())->getFlags();
+
+        replaceLeaf(*candidate.create, new Op_Call(ObjLoc(BUILTIN_SYSTEM_CREATE_SCRATCH_OBJECT, ObjLoc::DataStoreLocation::StaticDataStore), flags));
+        release = std::max(release, candidate.dead);
+        any = true;
+      }
+
+      if (any) {
+        std::unique_ptr<BytecodeChunk> released(new BytecodeChunk);
+        released->append(std::move(*leaves[release]));
+        released->append(std::unique_ptr<Op_Call>(new Op_Call(ObjLoc(BUILTIN_SYSTEM_SCRATCH_RELEASE, ObjLoc::DataStoreLocation::StaticDataStore))));
+        *leaves[release] = std::move(released);
+      }
+
+      candidates.clear();
+      holders.clear();
+      depth = 0;
+    };
+
+    for (size_t i = 0; i < leaves.size(); i++) {
+      Buildable *b = leaves[i]->get();
+      std::vector<ObjLoc*> objLocs;
+      bool movesStack = false;
+
+      if (dynamic_cast<DataStorage*>(b) != nullptr || dynamic_cast<Op_Const*>(b) != nullptr ||
+          dynamic_cast<Op_NoOp*>(b) != nullptr) {
+        continue;
+      }
+
+      if (!b->getObjLocs(objLocs)) {
+        endBlock();
+        continue;
+      }
+
+      for (const ObjLoc *loc : objLocs) {
+        movesStack = movesStack || loc->getDataStoreLocation() == ObjLoc::DataStoreLocation::VMDataStore;
+      }
+
+      if (movesStack) {
+        endBlock();
+        continue;
+      }
+
+      if (auto asLoad = dynamic_cast<Op_Load*>(b)) {
+        overwriteLoc(asLoad->getObjLoc(), i);
+        continue;
+      }
+
+      if (auto asMov = dynamic_cast<Op_Mov*>(b)) {
+        const int64_t c = heldBy(asMov->getRight());
+        Key key;
+
+        if (asMov->getLeft() == asMov->getRight()) {
+          continue;
+        }
+
+        if (c < 0) {
+          readAliased(asMov->getRight());
+          overwriteLoc(asMov->getLeft(), i);
+        } else if (keyOf(asMov->getLeft(), key)) {
+          overwrite(key, i);
+          holders[key] = (size_t)c;
+        } else {
+          escape((size_t)c);
+        }
+
+        continue;
+      }
+
+      if (auto asPush = dynamic_cast<Op_Push*>(b)) {
+        const int64_t c = heldBy(asPush->getArg());
+
+        if (c < 0) {
+          readAliased(asPush->getArg());
+        } else {
+          holders[Key(true, depth)] = (size_t)c;
+        }
+
+        depth++;
+        continue;
+      }
+
+      if (dynamic_cast<Op_PushConst*>(b) != nullptr) {
+        depth++;
+        continue;
+      }
+
+      if (auto asPop = dynamic_cast<Op_Pop*>(b)) {
+        for (size_t k = 0; k < asPop->getAmount(); k++) {
+          overwrite(Key(true, depth - 1 - (int64_t)k), i);
+        }
+
+        depth -= (int64_t)asPop->getAmount();
+        continue;
+      }
+
+      if (auto asCall = dynamic_cast<Op_Call*>(b)) {
+        const ObjLoc &callee = asCall->getObjLoc();
+        const bool registers = asCall->getFlags() == Op_Call::Flags::RegisterArgs;
+        const bool operands = asCall->getFlags() == Op_Call::Flags::OperandArgs;
+        const bool builtin = callee.getDataStoreLocation() == ObjLoc::DataStoreLocation::StaticDataStore;
+        const ObjLoc result = asCall->hasResult() ? asCall->getResult() : ObjLoc(0, ObjLoc::DataStoreLocation::RegisterDataStore);
+        size_t numArgs = 0;
+
+        if (builtin && callee.getLocation() == BUILTIN_SYSTEM_CREATE_OBJECT && !operands && !asCall->hasResult()) {
+          overwriteLoc(ObjLoc(0, ObjLoc::DataStoreLocation::RegisterDataStore), i);
+          holders[Key(false, 0)] = candidates.size();
+          candidates.push_back({ leaves[i], i, false });
+          continue;
+        }
+
+        if (builtin && callee.getLocation() == BUILTIN_SYSTEM_GET_OBJECT_MEMBER) {
+          numArgs = 2;
+        } else if (builtin && callee.getLocation() == BUILTIN_SYSTEM_SET_OBJECT_MEMBER) {
+          numArgs = 3;
+        } else {
+          // anything else may keep what it is given, or run code that
+          // reaches it some other way
+          while (!holders.empty()) {
+            escape(holders.begin()->second);
+          }
+        }
+
+        // read where they are, so what the block pushed may be too
+        for (const ObjLoc &arg : asCall->getArgs()) {
+          readAliased(arg);
+        }
+
+        // the object a member is read from or written to stays where it
+        // is; the key and the value written may be kept
+        for (size_t k = 1; k < numArgs; k++) {
+          int64_t c = -1;
+
+          if (operands) {
+            c = k < asCall->getArgs().size() ? heldBy(asCall->getArgs()[k]) : -1;
+          } else if (registers) {
+            c = heldBy(ObjLoc((int)(1 + k), ObjLoc::DataStoreLocation::RegisterDataStore));
+          } else {
+            c = heldBy(ObjLoc(-1 - (int)k, ObjLoc::DataStoreLocation::LocalDataStore));
+          }
+
+          if (c >= 0) {
+            escape((size_t)c);
+          }
+        }
+
+        overwriteLoc(result, i);
+        continue;
+      }
+
+      // only compared, or written out
+      if (dynamic_cast<Op_Cmp*>(b) != nullptr || dynamic_cast<Op_Print*>(b) != nullptr) {
+        continue;
+      }
+
+      if (dynamic_cast<Op_Add*>(b) != nullptr || dynamic_cast<Op_Sub*>(b) != nullptr ||
+          dynamic_cast<Op_Mul*>(b) != nullptr || dynamic_cast<Op_Div*>(b) != nullptr ||
+          dynamic_cast<Op_Mod*>(b) != nullptr || dynamic_cast<Op_Xor*>(b) != nullptr ||
+          dynamic_cast<Op_And*>(b) != nullptr || dynamic_cast<Op_Or*>(b) != nullptr ||
+          dynamic_cast<Op_Shl*>(b) != nullptr || dynamic_cast<Op_Shr*>(b) != nullptr) {
+        // arithmetic on an object's address is nothing this follows
+        for (const ObjLoc *loc : objLocs) {
+          const int64_t c = heldBy(*loc);
+
+          if (c >= 0) {
+            escape((size_t)c);
+          }
+
+          readAliased(*loc);
+        }
+
+        continue;
+      }
+
+      // labels, jumps, calls of functions, fibers and anything else
+      endBlock();
+    }
+
+    endBlock();
+  }
+
+  namespace {
+    bool isResult(const ObjLoc &loc) {
+      return loc.getDataStoreLocation() == ObjLoc::DataStoreLocation::RegisterDataStore && loc.getLocation() == 0;
+    }
+
+    // whether a call of `callee` leaves $r[0] as it was: scratchRelease,
+    // arenaBegin and arenaEnd do
+    bool keepsResult(const ObjLoc &callee) {
+      return callee.getDataStoreLocation() == ObjLoc::DataStoreLocation::StaticDataStore &&
+        (callee.getLocation() == BUILTIN_SYSTEM_SCRATCH_RELEASE || callee.getLocation() == BUILTIN_SYSTEM_ARENA_BEGIN ||
+         callee.getLocation() == BUILTIN_SYSTEM_ARENA_END);
+    }
+
+    // whether what a call of `callee` leaves in $r[0] is a reference of
+    // its own. share hands back its argument, and those keepsResult is
+    // true of whatever $r[0] held; host and extension functions may
+    // return anything.
+    bool ownsResult(const ObjLoc &callee) {
+      return callee.getDataStoreLocation() == ObjLoc::DataStoreLocation::StaticDataStore &&
+        callee.getLocation() >= 0 && callee.getLocation() < BUILTIN_RESERVED &&
+        !(callee.getLocation() >= BUILTIN_HOST_FIRST && callee.getLocation() < BUILTIN_HOST_FIRST + BUILTIN_HOST_COUNT) &&
+        callee.getLocation() != BUILTIN_SYSTEM_SHARE && !keepsResult(callee);
+    }
+
+    // what a run of instructions passes over: data, constants, no-ops and
+    // instructions a pass dropped
+    bool isSkipped(const Buildable *b) {
+      return b == nullptr || dynamic_cast<const DataStorage*>(b) != nullptr || dynamic_cast<const Op_Const*>(b) != nullptr ||
+        dynamic_cast<const Op_NoOp*>(b) != nullptr;
+    }
+
+    // whether $r[0] is overwritten after leaf `from` before anything may
+    // read it. anything but a run of plain instructions may.
+    bool resultDeadAfter(const std::vector<std::unique_ptr<Buildable>*> &leaves, size_t from) {
+      for (size_t i = from + 1; i < leaves.size(); i++) {
+        Buildable *b = leaves[i]->get();
+        std::vector<ObjLoc*> objLocs;
+
+        if (isSkipped(b)) {
+          continue;
+        }
+
+        if (!b->getObjLocs(objLocs)) {
+          return false;
+        }
+
+        for (const ObjLoc *loc : objLocs) {
+          if (loc->getDataStoreLocation() == ObjLoc::DataStoreLocation::VMDataStore) {
+            return false;
+          }
+        }
+
+        if (auto asCall = dynamic_cast<Op_Call*>(b)) {
+          for (const ObjLoc &arg : asCall->getArgs()) {
+            if (isResult(arg)) {
+              return false;
+            }
+          }
+
+          if (asCall->hasResult() && isResult(asCall->getResult())) {
+            return true;
+          }
+
+          // a native one, which only sees its arguments
+          if (asCall->getObjLoc().getDataStoreLocation() != ObjLoc::DataStoreLocation::StaticDataStore) {
+            return false;
+          }
+
+          if (keepsResult(asCall->getObjLoc()) || asCall->hasResult()) {
+            continue;
+          }
+
+          return true;
+        }
+
+        if (auto asLoad = dynamic_cast<Op_Load*>(b)) {
+          if (isResult(asLoad->getObjLoc())) {
+            return true;
+          }
+
+          continue;
+        }
+
+        if (auto asMov = dynamic_cast<Op_Mov*>(b)) {
+          if (isResult(asMov->getRight())) {
+            return false;
+          }
+
+          if (isResult(asMov->getLeft())) {
+            return true;
+          }
+
+          continue;
+        }
+
+        const bool plain = dynamic_cast<Op_Push*>(b) != nullptr || dynamic_cast<Op_PushConst*>(b) != nullptr ||
+          dynamic_cast<Op_Pop*>(b) != nullptr || dynamic_cast<Op_Cmp*>(b) != nullptr ||
+          dynamic_cast<Op_Print*>(b) != nullptr ||
+          dynamic_cast<Op_Add*>(b) != nullptr || dynamic_cast<Op_Sub*>(b) != nullptr ||
+          dynamic_cast<Op_Mul*>(b) != nullptr || dynamic_cast<Op_Div*>(b) != nullptr ||
+          dynamic_cast<Op_Mod*>(b) != nullptr || dynamic_cast<Op_Xor*>(b) != nullptr ||
+          dynamic_cast<Op_And*>(b) != nullptr || dynamic_cast<Op_Or*>(b) != nullptr ||
+          dynamic_cast<Op_Shl*>(b) != nullptr || dynamic_cast<Op_Shr*>(b) != nullptr;
+
+        if (!plain) {
+          return false;
+        }
+
+        for (const ObjLoc *loc : objLocs) {
+          if (isResult(*loc)) {
+            return false;
+          }
+        }
+      }
+
+      // the end of the program
+      return true;
+    }
+  }
+
+  void BytecodeChunk::objectTemplates() {
+    std::vector<std::unique_ptr<Buildable>*> leaves;
+    DataStorage *storage = nullptr;
+    collectLeaves(leaves);
+
+    for (auto leaf : leaves) {
+      if ((storage = dynamic_cast<DataStorage*>(leaf->get())) != nullptr) {
+        break;
+      }
+    }
+
+    if (storage == nullptr) {
+      return;
+    }
+
+    auto isBuiltin = [](const ObjLoc &loc, int slot) {
+      return loc.getDataStoreLocation() == ObjLoc::DataStoreLocation::StaticDataStore && loc.getLocation() == slot;
+    };
+
+    auto isRegister = [](const ObjLoc &loc) {
+      return loc.getDataStoreLocation() == ObjLoc::DataStoreLocation::RegisterDataStore ||
+        loc.getDataStoreLocation() == ObjLoc::DataStoreLocation::VirtualRegister;
+    };
+
+    // the next leaf after `i` that is not skipped, leaves.size() if none
+    auto nextLeaf = [&](size_t i) {
+      do {
+        i++;
+      } while (i < leaves.size() && isSkipped(leaves[i]->get()));
+
+      return i;
+    };
+
+    for (size_t i = 0; i < leaves.size(); i++) {
+      auto asCall = dynamic_cast<Op_Call*>(leaves[i]->get());
+
+      if (asCall == nullptr || !isBuiltin(asCall->getObjLoc(), BUILTIN_SYSTEM_CREATE_OBJECT) ||
+          asCall->getFlags() != Op_Call::Flags::None || asCall->hasResult()) {
+        continue;
+      }
+
+      const size_t push = nextLeaf(i);
+      auto asPush = push < leaves.size() ? dynamic_cast<Op_Push*>(leaves[push]->get()) : nullptr;
+
+      if (asPush == nullptr || !isResult(asPush->getArg())) {
+        continue;
+      }
+
+      // `setfield $l[-1] key value`, of a key a string in static data.
+      // those whose values are static data too, with nothing between them,
+      // make the template; otherwise their number is the object's size.
+      std::vector<size_t> sets;
+      std::vector<uint32_t> words { 0 };
+      size_t members = 0;
+
+      for (size_t j = nextLeaf(push); j < leaves.size(); j = nextLeaf(j)) {
+        Buildable *b = leaves[j]->get();
+
+        // a value put in a register for a setfield after it
+        if (auto asLoad = dynamic_cast<Op_Load*>(b)) {
+          if (!isRegister(asLoad->getObjLoc())) {
+            break;
+          }
+
+          continue;
+        }
+
+        if (auto asMov = dynamic_cast<Op_Mov*>(b)) {
+          if (!isRegister(asMov->getLeft())) {
+            break;
+          }
+
+          continue;
+        }
+
+        auto asSet = dynamic_cast<Op_Call*>(b);
+
+        if (asSet == nullptr || !isBuiltin(asSet->getObjLoc(), BUILTIN_SYSTEM_SET_OBJECT_MEMBER) ||
+            asSet->getFlags() != Op_Call::Flags::OperandArgs || asSet->hasResult() || asSet->getArgs().size() != 3 ||
+            asSet->getArgs()[0] != ObjLoc(-1, ObjLoc::DataStoreLocation::LocalDataStore)) {
+          break;
+        }
+
+        const ObjLoc &key = asSet->getArgs()[1];
+        const ObjLoc &value = asSet->getArgs()[2];
+        const Value *keyData = key.getDataStoreLocation() == ObjLoc::DataStoreLocation::StaticDataStore
+          ? storage->getStaticData((size_t)key.getLocation()) : nullptr;
+
+        if (keyData == nullptr || keyData->getValueType() != Value::ValueType::ValueTypeRawData) {
+          break;
+        }
+
+        if (sets.size() == members && sets.size() < BUILTIN_TEMPLATE_MAX && j == nextLeaf(sets.empty() ? push : sets.back()) &&
+            value.getDataStoreLocation() == ObjLoc::DataStoreLocation::StaticDataStore &&
+            storage->getStaticData((size_t)value.getLocation()) != nullptr) {
+          sets.push_back(j);
+          words.push_back((uint32_t)key.getLocation());
+          words.push_back((uint32_t)value.getLocation());
+        }
+
+        members++;
+      }
+
+      // some member is not static: created with room for all of them,
+      // rather than growing its slots as they are added
+      if (members != sets.size()) {
+        if (members > 1) {
+          const size_t slot = storage->addStaticData(Value((int64_t)members));
+
+          replaceLeaf(*leaves[i], new Op_Call(
+            ObjLoc(BUILTIN_SYSTEM_CREATE_OBJECT_SIZED, ObjLoc::DataStoreLocation::StaticDataStore),
+            std::vector<ObjLoc> { ObjLoc((int)slot, ObjLoc::DataStoreLocation::StaticDataStore) }
+          ));
+        }
+
+        continue;
+      }
+
+      // the last setObjectMember left the value in $r[0], the template
+      // leaves the object
+      if (sets.empty() || !resultDeadAfter(leaves, sets.back())) {
+        continue;
+      }
+
+      words[0] = (uint32_t)sets.size();
+
+      const uint8_t *bytes = (const uint8_t*)words.data();
+      const size_t slot = storage->addStaticData(Value(std::vector<uint8_t>(bytes, bytes + words.size() * sizeof(uint32_t))));
+
+      replaceLeaf(*leaves[i], new Op_Call(
+        ObjLoc(BUILTIN_SYSTEM_CREATE_FROM_TEMPLATE, ObjLoc::DataStoreLocation::StaticDataStore),
+        std::vector<ObjLoc> { ObjLoc((int)slot, ObjLoc::DataStoreLocation::StaticDataStore) }
+      ));
+
+      for (size_t j : sets) {
+        leaves[j]->reset();
+      }
+
+      i = sets.back();
+    }
+  }
+
+  void BytecodeChunk::takeResults() {
+    std::vector<std::unique_ptr<Buildable>*> leaves;
+    collectLeaves(leaves);
+
+    for (size_t i = 0; i < leaves.size(); i++) {
+      auto asCall = dynamic_cast<Op_Call*>(leaves[i]->get());
+      size_t next = i + 1;
+
+      if (asCall == nullptr || asCall->hasResult() || keepsResult(asCall->getObjLoc())) {
+        continue;
+      }
+
+      while (next < leaves.size() && isSkipped(leaves[next]->get())) {
+        next++;
+      }
+
+      if (next == leaves.size()) {
+        break;
+      }
+
+      Buildable *b = leaves[next]->get();
+
+      if (auto asPush = dynamic_cast<Op_Push*>(b)) {
+        if (isResult(asPush->getArg()) && ownsResult(asCall->getObjLoc()) && resultDeadAfter(leaves, next)) {
+          asPush->setTake(true);
+        }
+      } else if (auto asMov = dynamic_cast<Op_Mov*>(b)) {
+        const ObjLoc::DataStoreLocation to = asMov->getLeft().getDataStoreLocation();
+
+        // registers hold copies that own nothing, so any result may be
+        // stored to one as to $r[0]
+        if (isResult(asMov->getRight()) && to != ObjLoc::DataStoreLocation::VMDataStore &&
+            (to == ObjLoc::DataStoreLocation::RegisterDataStore || ownsResult(asCall->getObjLoc())) &&
+            resultDeadAfter(leaves, next)) {
+          asCall->setResult(asMov->getLeft());
+          leaves[next]->reset();
+        }
+      }
+    }
+  }
+
+  void BytecodeChunk::eliminateDeadCode() {
+    std::vector<std::unique_ptr<Buildable>*> leaves;
+    collectLeaves(leaves);
+
+    std::vector<DataStorage*> dataStorages;
+    std::map<size_t, size_t> labels; // id to index in `leaves`
+    std::vector<std::vector<ObjLoc*>> objLocs(leaves.size());
+
+    for (size_t i = 0; i < leaves.size(); i++) {
+      Buildable *b = leaves[i]->get();
+
+      if (auto asDataStorage = dynamic_cast<DataStorage*>(b)) {
+        dataStorages.push_back(asDataStorage);
+        continue;
+      }
+
+      if (auto asLabel = dynamic_cast<LabelMarker*>(b)) {
+        labels[asLabel->getLabelId()] = i;
+      }
+
+      if (!b->getObjLocs(objLocs[i])) {
+        return;
+      }
+
+      for (const ObjLoc *loc : objLocs[i]) {
+        // $pc: an address that is not a label's
+        if (loc->getDataStoreLocation() == ObjLoc::DataStoreLocation::VMDataStore && loc->getLocation() == 0) {
+          return;
+        }
+      }
+    }
+
+    std::vector<bool> reachable(leaves.size(), false);
+    std::vector<size_t> pending = { 0 };
+
+    // what another object may use starts out reachable too
+    for (size_t i = 0; i < leaves.size(); i++) {
+      if (dynamic_cast<SymbolMarker*>(leaves[i]->get()) != nullptr) {
+        pending.push_back(i);
+      }
+    }
+
+    while (!pending.empty()) {
+      const size_t start = pending.back();
+      pending.pop_back();
+
+      for (size_t i = start; i < leaves.size() && !reachable[i]; i++) {
+        Buildable *b = leaves[i]->get();
+
+        reachable[i] = true;
+
+        for (const ObjLoc *loc : objLocs[i]) {
+          auto it = labels.find(loc->getLocation());
+
+          if (loc->getDataStoreLocation() == ObjLoc::DataStoreLocation::StaticDataStore && it != labels.end()) {
+            pending.push_back(it->second);
+          }
+        }
+
+        auto asJmp = dynamic_cast<Op_Jmp*>(b);
+
+        if (dynamic_cast<Op_Halt*>(b) != nullptr || dynamic_cast<Op_Ret*>(b) != nullptr ||
+            dynamic_cast<Op_Switch*>(b) != nullptr ||
+            (asJmp != nullptr && asJmp->getFlags() == Op_Jmp::Flags::None)) {
+          break;
+        }
+      }
+    }
+
+    std::set<size_t> used;
+
+    for (size_t i = 0; i < leaves.size(); i++) {
+      Buildable *b = leaves[i]->get();
+
+      if (dynamic_cast<DataStorage*>(b) != nullptr || dynamic_cast<LabelMarker*>(b) != nullptr) {
+        continue;
+      }
+
+      // a jit or try region's markers delimit it, wherever the code in it goes
+      if (!reachable[i] && dynamic_cast<Op_Jit*>(b) == nullptr && dynamic_cast<TryMarker*>(b) == nullptr) {
+        leaves[i]->reset();
+        continue;
+      }
+
+      for (const ObjLoc *loc : objLocs[i]) {
+        if (loc->getDataStoreLocation() == ObjLoc::DataStoreLocation::StaticDataStore) {
+          used.insert(loc->getLocation());
+        }
+      }
+    }
+
+    for (auto &label : labels) {
+      if (!used.count(label.first)) {
+        leaves[label.second]->reset();
+      }
+    }
+
+    for (DataStorage *dataStorage : dataStorages) {
+      dataStorage->retainStaticData(used);
+    }
+  }
+
+  namespace {
+    Op_Jmp::Flags invertJump(Op_Jmp::Flags flags) {
+      switch (flags) {
+        case Op_Jmp::Flags::JumpIfEqual: return Op_Jmp::Flags::JumpIfNotEqual;
+        case Op_Jmp::Flags::JumpIfNotEqual: return Op_Jmp::Flags::JumpIfEqual;
+        // there is no jl or jle
+        default: return Op_Jmp::Flags::None;
+      }
+    }
+
+    // a jump to a label, rather than through a location
+    Op_Jmp *asLabelJump(Buildable *b) {
+      auto asJmp = dynamic_cast<Op_Jmp*>(b);
+
+      if (asJmp == nullptr || asJmp->getObjLoc().getDataStoreLocation() != ObjLoc::DataStoreLocation::StaticDataStore) {
+        return nullptr;
+      }
+
+      return asJmp;
+    }
+  }
+
+  void BytecodeChunk::threadJumps() {
+    std::vector<std::unique_ptr<Buildable>*> leaves;
+    collectLeaves(leaves);
+
+    std::map<size_t, size_t> labels; // id to index in `leaves`
+
+    for (size_t i = 0; i < leaves.size(); i++) {
+      if (auto asLabel = dynamic_cast<LabelMarker*>(leaves[i]->get())) {
+        labels[asLabel->getLabelId()] = i;
+      }
+    }
+
+    // the first instruction at or after `i` that is not a label
+    auto skipLabels = [&](size_t i) {
+      while (i < leaves.size() && dynamic_cast<LabelMarker*>(leaves[i]->get()) != nullptr) {
+        i++;
+      }
+
+      return i;
+    };
+
+    // where going to `label` ends up through unconditional jumps,
+    // stopping at a cycle
+    auto finalTarget = [&](size_t label) {
+      std::set<size_t> seen;
+
+      while (seen.insert(label).second) {
+        auto it = labels.find(label);
+
+        if (it == labels.end()) {
+          break;
+        }
+
+        const size_t next = skipLabels(it->second);
+        Op_Jmp *asJmp = next < leaves.size() ? asLabelJump(leaves[next]->get()) : nullptr;
+
+        if (asJmp == nullptr || asJmp->getFlags() != Op_Jmp::Flags::None) {
+          break;
+        }
+
+        label = asJmp->getObjLoc().getLocation();
+      }
+
+      return label;
+    };
+
+    for (size_t i = 0; i < leaves.size(); i++) {
+      Op_Jmp *asJmp = asLabelJump(leaves[i]->get());
+
+      if (asJmp == nullptr || labels.find(asJmp->getObjLoc().getLocation()) == labels.end()) {
+        continue;
+      }
+
+      const size_t target = finalTarget(asJmp->getObjLoc().getLocation());
+
+      if (target != (size_t)asJmp->getObjLoc().getLocation()) {
+        Op_Jmp *threaded = new Op_Jmp(
+          ObjLoc(target, ObjLoc::DataStoreLocation::StaticDataStore),
+          asJmp->getFlags()
+        );
+
+        threaded->setSite(asJmp->getSite());
+        replaceLeaf(*leaves[i], threaded);
+      }
+    }
+
+    // je past the jmp right after it: jne to where the jmp goes
+    for (size_t i = 0; i + 1 < leaves.size(); i++) {
+      Op_Jmp *asCond = asLabelJump(leaves[i]->get());
+      Op_Jmp *asJmp = asLabelJump(leaves[i + 1]->get());
+
+      if (asCond == nullptr || asJmp == nullptr || asJmp->getFlags() != Op_Jmp::Flags::None ||
+          invertJump(asCond->getFlags()) == Op_Jmp::Flags::None) {
+        continue;
+      }
+
+      bool skipsJump = false;
+
+      for (size_t j = i + 2; j < leaves.size(); j++) {
+        auto asLabel = dynamic_cast<LabelMarker*>(leaves[j]->get());
+
+        if (asLabel == nullptr) {
+          break;
+        }
+
+        if (asLabel->getLabelId() == (size_t)asCond->getObjLoc().getLocation()) {
+          skipsJump = true;
+          break;
+        }
+      }
+
+      if (!skipsJump) {
+        continue;
+      }
+
+      Op_Jmp *inverted = new Op_Jmp(asJmp->getObjLoc(), invertJump(asCond->getFlags()));
+
+      inverted->setSite(asCond->getSite().invert());
+      replaceLeaf(*leaves[i], inverted);
+      leaves[i + 1]->reset();
+      leaves.erase(leaves.begin() + i + 1);
+
+      for (auto &label : labels) {
+        if (label.second > i) {
+          label.second--;
+        }
+      }
+    }
+  }
+
+  void BytecodeChunk::rotateLoops() {
+    std::vector<std::unique_ptr<Buildable>*> leaves;
+    collectLeaves(leaves);
+
+    DataStorage *dataStorage = nullptr;
+    std::map<size_t, size_t> labels; // id to index in `leaves`
+
+    for (size_t i = 0; i < leaves.size(); i++) {
+      if (auto asLabel = dynamic_cast<LabelMarker*>(leaves[i]->get())) {
+        labels[asLabel->getLabelId()] = i;
+      } else if (auto asDataStorage = dynamic_cast<DataStorage*>(leaves[i]->get())) {
+        dataStorage = asDataStorage;
+      }
+    }
+
+    // new labels need a slot
+    if (dataStorage == nullptr) {
+      return;
+    }
+
+    for (size_t j = 0; j < leaves.size(); j++) {
+      Op_Jmp *latch = asLabelJump(leaves[j]->get());
+
+      if (latch == nullptr || latch->getFlags() != Op_Jmp::Flags::None) {
+        continue;
+      }
+
+      auto header = labels.find(latch->getObjLoc().getLocation());
+
+      if (header == labels.end() || header->second >= j) {
+        continue;
+      }
+
+      // the test: loads and movs, a cmp, then the jump out
+      size_t first = header->second;
+
+      while (first < j && dynamic_cast<LabelMarker*>(leaves[first]->get()) != nullptr) {
+        first++;
+      }
+
+      size_t cmp = first;
+
+      while (cmp < j && (dynamic_cast<Op_Load*>(leaves[cmp]->get()) != nullptr ||
+          dynamic_cast<Op_Mov*>(leaves[cmp]->get()) != nullptr)) {
+        cmp++;
+      }
+
+      if (cmp + 2 > j || dynamic_cast<Op_Cmp*>(leaves[cmp]->get()) == nullptr) {
+        continue;
+      }
+
+      Op_Jmp *exit = asLabelJump(leaves[cmp + 1]->get());
+
+      if (exit == nullptr || invertJump(exit->getFlags()) == Op_Jmp::Flags::None) {
+        continue;
+      }
+
+      // the copy falls through to where the test jumps out to
+      bool exitsAfter = false;
+
+      for (size_t k = j + 1; k < leaves.size(); k++) {
+        auto asLabel = dynamic_cast<LabelMarker*>(leaves[k]->get());
+
+        if (asLabel == nullptr) {
+          break;
+        }
+
+        if (asLabel->getLabelId() == (size_t)exit->getObjLoc().getLocation()) {
+          exitsAfter = true;
+          break;
+        }
+      }
+
+      if (!exitsAfter) {
+        continue;
+      }
+
+      // the body starts after the test, labelled if it is not already
+      const size_t body = cmp + 2;
+      size_t bodyLabel;
+
+      if (auto asLabel = dynamic_cast<LabelMarker*>(leaves[body]->get())) {
+        bodyLabel = asLabel->getLabelId();
+      } else {
+        bodyLabel = dataStorage->addLabel();
+
+        std::unique_ptr<BytecodeChunk> labelled(new BytecodeChunk);
+        labelled->append(std::unique_ptr<LabelMarker>(new LabelMarker(bodyLabel)));
+        labelled->append(std::move(*leaves[body]));
+        *leaves[body] = std::move(labelled);
+      }
+
+      std::unique_ptr<BytecodeChunk> test(new BytecodeChunk);
+
+      for (size_t k = first; k < cmp; k++) {
+        if (auto asLoad = dynamic_cast<Op_Load*>(leaves[k]->get())) {
+          test->append(std::unique_ptr<Op_Load>(new Op_Load(asLoad->getObjLoc(), asLoad->getPoolIndex(), asLoad->getValue())));
+        } else if (auto asMov = dynamic_cast<Op_Mov*>(leaves[k]->get())) {
+          test->append(std::unique_ptr<Op_Mov>(new Op_Mov(asMov->getLeft(), asMov->getRight())));
+        }
+      }
+
+      auto asCmp = static_cast<Op_Cmp*>(leaves[cmp]->get());
+
+      // counted with the test at the top: together they run and exit
+      // as often as the test did before the loop was rotated
+      std::unique_ptr<Op_Jmp> latchJump(new Op_Jmp(
+        ObjLoc(bodyLabel, ObjLoc::DataStoreLocation::StaticDataStore),
+        invertJump(exit->getFlags())
+      ));
+      latchJump->setSite(exit->getSite().invert());
+
+      test->append(std::unique_ptr<Op_Cmp>(new Op_Cmp(asCmp->getLeft(), asCmp->getRight())));
+      test->append(std::move(latchJump));
+
+      replaceLeaf(*leaves[j], test.release());
+    }
+  }
+
+  namespace {
+    // the most instructions a function body may have to be inlined at a
+    // call site, more for each argument pushed as a constant, and twice
+    // that in a loop, or with a profile, at a call that ran at least
+    // 1/inlineHotShare as often as the hottest one
+    const size_t inlineBudget = 8;
+    const size_t inlineBudgetPerConstant = 4;
+    const uint64_t inlineHotShare = 16;
+
+    // a copy of instruction `b`, or NULL if a function body holding it is
+    // not inlined: it changes the stack, leaves the function some other
+    // way than returning, or is a kind inlineCalls does not know.
+    std::unique_ptr<Buildable> copyInstruction(Buildable *b) {
+      if (auto asLoad = dynamic_cast<Op_Load*>(b)) {
+        return std::unique_ptr<Buildable>(new Op_Load(asLoad->getObjLoc(), asLoad->getPoolIndex(), asLoad->getValue()));
+      } else if (auto asMov = dynamic_cast<Op_Mov*>(b)) {
+        return std::unique_ptr<Buildable>(new Op_Mov(asMov->getLeft(), asMov->getRight()));
+      } else if (auto asCmp = dynamic_cast<Op_Cmp*>(b)) {
+        return std::unique_ptr<Buildable>(new Op_Cmp(asCmp->getLeft(), asCmp->getRight()));
+      } else if (auto asJmp = asLabelJump(b)) {
+        std::unique_ptr<Op_Jmp> copy(new Op_Jmp(asJmp->getObjLoc(), asJmp->getFlags()));
+        copy->setSite(asJmp->getSite());
+
+        return std::move(copy);
+      } else if (auto asAdd = dynamic_cast<Op_Add*>(b)) {
+        return std::unique_ptr<Buildable>(new Op_Add(asAdd->getLeft(), asAdd->getRight(), asAdd->getFlags()));
+      } else if (auto asSub = dynamic_cast<Op_Sub*>(b)) {
+        return std::unique_ptr<Buildable>(new Op_Sub(asSub->getLeft(), asSub->getRight(), asSub->getFlags()));
+      } else if (auto asMul = dynamic_cast<Op_Mul*>(b)) {
+        return std::unique_ptr<Buildable>(new Op_Mul(asMul->getLeft(), asMul->getRight(), asMul->getFlags()));
+      } else if (auto asDiv = dynamic_cast<Op_Div*>(b)) {
+        return std::unique_ptr<Buildable>(new Op_Div(asDiv->getLeft(), asDiv->getRight(), asDiv->getFlags()));
+      } else if (auto asMod = dynamic_cast<Op_Mod*>(b)) {
+        return std::unique_ptr<Buildable>(new Op_Mod(asMod->getLeft(), asMod->getRight()));
+      } else if (auto asXor = dynamic_cast<Op_Xor*>(b)) {
+        return std::unique_ptr<Buildable>(new Op_Xor(asXor->getLeft(), asXor->getRight()));
+      } else if (auto asAnd = dynamic_cast<Op_And*>(b)) {
+        return std::unique_ptr<Buildable>(new Op_And(asAnd->getLeft(), asAnd->getRight()));
+      } else if (auto asOr = dynamic_cast<Op_Or*>(b)) {
+        return std::unique_ptr<Buildable>(new Op_Or(asOr->getLeft(), asOr->getRight()));
+      } else if (auto asShl = dynamic_cast<Op_Shl*>(b)) {
+        return std::unique_ptr<Buildable>(new Op_Shl(asShl->getLeft(), asShl->getRight()));
+      } else if (auto asShr = dynamic_cast<Op_Shr*>(b)) {
+        return std::unique_ptr<Buildable>(new Op_Shr(asShr->getLeft(), asShr->getRight()));
+      } else if (auto asPrint = dynamic_cast<Op_Print*>(b)) {
+        return std::unique_ptr<Buildable>(new Op_Print(asPrint->getObjLoc()));
+      } else if (auto asFCall = dynamic_cast<Op_FCall*>(b)) {
+        std::unique_ptr<Op_FCall> copy(new Op_FCall(asFCall->getTarget(), asFCall->getHint()));
+        copy->setSite(asFCall->getSite());
+
+        return std::move(copy);
+      } else if (dynamic_cast<Op_NoOp*>(b) != nullptr) {
+        return std::unique_ptr<Buildable>(new Op_NoOp);
+      }
+
+      return nullptr;
+    }
+
+    // where instruction `b`, one copyInstruction copies, stores its result
+    const ObjLoc *destinationOf(Buildable *b) {
+      if (auto asLoad = dynamic_cast<Op_Load*>(b)) return &asLoad->getObjLoc();
+      if (auto asMov = dynamic_cast<Op_Mov*>(b)) return &asMov->getLeft();
+      if (auto asAdd = dynamic_cast<Op_Add*>(b)) return &asAdd->getLeft();
+      if (auto asSub = dynamic_cast<Op_Sub*>(b)) return &asSub->getLeft();
+      if (auto asMul = dynamic_cast<Op_Mul*>(b)) return &asMul->getLeft();
+      if (auto asDiv = dynamic_cast<Op_Div*>(b)) return &asDiv->getLeft();
+      if (auto asMod = dynamic_cast<Op_Mod*>(b)) return &asMod->getLeft();
+      if (auto asXor = dynamic_cast<Op_Xor*>(b)) return &asXor->getLeft();
+      if (auto asAnd = dynamic_cast<Op_And*>(b)) return &asAnd->getLeft();
+      if (auto asOr = dynamic_cast<Op_Or*>(b)) return &asOr->getLeft();
+      if (auto asShl = dynamic_cast<Op_Shl*>(b)) return &asShl->getLeft();
+      if (auto asShr = dynamic_cast<Op_Shr*>(b)) return &asShr->getLeft();
+
+      return nullptr;
+    }
+
+    // what $f[] or relative $l[] slot `loc` of the callee is to the caller
+    // once the body is inlined, with no return address or saved frame
+    // pointer between them: $f[-3] and $l[-3] are its $l[-1]. false if it
+    // is one of those two, or a slot of the callee's own.
+    bool callerSlot(const ObjLoc &loc, ObjLoc &out) {
+      const bool isFrame = loc.getDataStoreLocation() == ObjLoc::DataStoreLocation::FrameDataStore;
+      const bool isRelative = loc.getDataStoreLocation() == ObjLoc::DataStoreLocation::LocalDataStore && loc.isRelative();
+
+      if (!isFrame && !isRelative) {
+        out = loc;
+        return true;
+      }
+
+      if (loc.getLocation() > -3) {
+        return false;
+      }
+
+      out = ObjLoc(loc.getLocation() + 2, ObjLoc::DataStoreLocation::LocalDataStore);
+
+      return true;
+    }
+  }
+
+  void BytecodeChunk::inlineCalls() {
+    std::vector<std::unique_ptr<Buildable>*> leaves;
+    collectLeaves(leaves);
+
+    DataStorage *dataStorage = nullptr;
+    std::map<size_t, size_t> labels; // id to index in `leaves`
+    std::map<size_t, size_t> calls; // label id to the calls to it
+    std::set<size_t> referenced; // labels something other than a call reads
+    std::vector<std::pair<size_t, size_t>> loops; // backward jump, from target to jump
+    uint64_t hottest = 0; // the most any profiled call ran
+
+    for (size_t i = 0; i < leaves.size(); i++) {
+      Buildable *b = leaves[i]->get();
+
+      if (auto asLabel = dynamic_cast<LabelMarker*>(b)) {
+        labels[asLabel->getLabelId()] = i;
+      } else if (auto asDataStorage = dynamic_cast<DataStorage*>(b)) {
+        dataStorage = asDataStorage;
+      }
+    }
+
+    // new labels need a slot
+    if (dataStorage == nullptr) {
+      return;
+    }
+
+    for (size_t i = 0; i < leaves.size(); i++) {
+      Buildable *b = leaves[i]->get();
+      std::vector<ObjLoc*> objLocs;
+
+      if (dynamic_cast<DataStorage*>(b) != nullptr) {
+        continue;
+      }
+
+      // code that may go anywhere could go into a body
+      if (!b->getObjLocs(objLocs)) {
+        return;
+      }
+
+      if (auto asFCall = dynamic_cast<Op_FCall*>(b)) {
+        if (asFCall->getTarget().getDataStoreLocation() == ObjLoc::DataStoreLocation::StaticDataStore) {
+          calls[asFCall->getTarget().getLocation()]++;
+        }
+
+        if (asFCall->getSite().profiled) {
+          hottest = std::max(hottest, asFCall->getSite().count);
+        }
+
+        continue;
+      }
+
+      for (const ObjLoc *loc : objLocs) {
+        if (loc->getDataStoreLocation() == ObjLoc::DataStoreLocation::StaticDataStore) {
+          referenced.insert(loc->getLocation());
+        } else if (loc->getDataStoreLocation() == ObjLoc::DataStoreLocation::VMDataStore && loc->getLocation() == 0) {
+          // $pc: an address that is not a label's
+          return;
+        }
+      }
+
+      if (Op_Jmp *asJmp = asLabelJump(b)) {
+        auto target = labels.find(asJmp->getObjLoc().getLocation());
+
+        if (target != labels.end() && target->second <= i) {
+          loops.push_back(std::make_pair(target->second, i));
+        }
+      }
+    }
+
+    for (size_t i = 0; i < leaves.size(); i++) {
+      auto call = dynamic_cast<Op_FCall*>(leaves[i]->get());
+
+      if (call == nullptr || call->getHint() == InlineHint::NoInline ||
+          call->getTarget().getDataStoreLocation() != ObjLoc::DataStoreLocation::StaticDataStore) {
+        continue;
+      }
+
+      const size_t target = call->getTarget().getLocation();
+      auto entry = labels.find(target);
+
+      if (entry == labels.end()) {
+        continue;
+      }
+
+      // the body: from the label to a return no jump before it goes past
+      std::vector<std::unique_ptr<Buildable>> body;
+      std::set<size_t> bodyLabels;
+      std::set<size_t> pending; // labels jumped forward to
+      size_t numArgs = 0, numRets = 0, cost = 0;
+      InlineHint hint = InlineHint::None;
+      bool complete = false;
+
+      for (size_t k = entry->second; k < leaves.size() && !complete; k++) {
+        Buildable *b = leaves[k]->get();
+
+        if (auto asLabel = dynamic_cast<LabelMarker*>(b)) {
+          bodyLabels.insert(asLabel->getLabelId());
+          pending.erase(asLabel->getLabelId());
+          body.push_back(std::unique_ptr<Buildable>(new LabelMarker(asLabel->getLabelId())));
+          continue;
+        }
+
+        if (auto asRet = dynamic_cast<Op_Ret*>(b)) {
+          if (numRets != 0 && asRet->getNumArgs() != numArgs) {
+            break;
+          }
+
+          if (asRet->getHint() == InlineHint::NoInline || hint == InlineHint::None) {
+            hint = asRet->getHint();
+          }
+
+          numArgs = asRet->getNumArgs();
+          numRets++;
+          complete = pending.empty();
+          body.push_back(std::unique_ptr<Buildable>(new Op_Ret(numArgs)));
+          continue;
+        }
+
+        std::unique_ptr<Buildable> copy = copyInstruction(b);
+
+        if (copy == nullptr) {
+          break;
+        }
+
+        copy->setTrace(b->getTrace());
+
+        if (Op_Jmp *asJmp = asLabelJump(copy.get())) {
+          const size_t jumpTarget = asJmp->getObjLoc().getLocation();
+
+          if (!bodyLabels.count(jumpTarget)) {
+            pending.insert(jumpTarget);
+          }
+        }
+
+        cost++;
+        body.push_back(std::move(copy));
+      }
+
+      if (!complete || hint == InlineHint::NoInline) {
+        continue;
+      }
+
+      // each return but the last becomes a jump to the end
+      cost += numRets - 1;
+
+      // the arguments pushed as constants right before the call, the
+      // last one first, and whether the body may change them
+      std::vector<int64_t> constants;
+      bool callsOut = false;
+      bool fits = true;
+
+      for (size_t k = i; k > 0 && constants.size() < numArgs; k--) {
+        auto asPushConst = dynamic_cast<Op_PushConst*>(leaves[k - 1]->get());
+        int64_t value;
+
+        if (asPushConst == nullptr || asPushConst->getPoolIndex() != Op_Load::noPoolIndex ||
+            !asInteger(asPushConst->getValue(), value)) {
+          break;
+        }
+
+        constants.push_back(value);
+      }
+
+      for (auto &b : body) {
+        std::vector<ObjLoc*> objLocs;
+        b->getObjLocs(objLocs);
+
+        callsOut = callsOut || dynamic_cast<Op_FCall*>(b.get()) != nullptr;
+
+        for (ObjLoc *loc : objLocs) {
+          ObjLoc mapped;
+
+          if (loc->getDataStoreLocation() == ObjLoc::DataStoreLocation::VMDataStore ||
+              !callerSlot(*loc, mapped)) {
+            fits = false;
+          } else if (loc->getDataStoreLocation() == ObjLoc::DataStoreLocation::StaticDataStore &&
+              bodyLabels.count(loc->getLocation()) &&
+              asLabelJump(b.get()) == nullptr && dynamic_cast<Op_FCall*>(b.get()) == nullptr) {
+            // the address of a label that is copied
+            fits = false;
+          }
+        }
+
+        if (const ObjLoc *dst = destinationOf(b.get())) {
+          ObjLoc mapped;
+
+          if (callerSlot(*dst, mapped) && mapped.getDataStoreLocation() == ObjLoc::DataStoreLocation::LocalDataStore &&
+              mapped.isRelative() && (size_t)-mapped.getLocation() <= constants.size()) {
+            constants.resize(-mapped.getLocation() - 1);
+          }
+        }
+      }
+
+      if (!fits) {
+        continue;
+      }
+
+      // a function it calls may write to the arguments, through its own frame
+      if (callsOut) {
+        constants.clear();
+      }
+
+      // a profile tells how hot the call is; without one, a loop around it does
+      const Site &site = call->getSite();
+      bool hot = false;
+
+      if (site.profiled) {
+        hot = site.count != 0 && site.count * inlineHotShare >= hottest;
+      } else {
+        for (auto &loop : loops) {
+          hot = hot || (loop.first <= i && i < loop.second);
+        }
+      }
+
+      size_t budget = inlineBudget + inlineBudgetPerConstant * constants.size();
+
+      if (hot) {
+        budget *= 2;
+      } else if (site.profiled && site.count == 0) {
+        // never ran
+        budget = 0;
+      }
+
+      const bool onlyCall = calls[target] == 1 && !referenced.count(target);
+
+      if (call->getHint() != InlineHint::Inline && hint != InlineHint::Inline &&
+          !onlyCall && cost > budget) {
+        continue;
+      }
+
+      // the copy, with labels of its own and returns falling through to
+      // the pop of the arguments
+      std::map<size_t, size_t> renamed;
+
+      for (size_t id : bodyLabels) {
+        renamed[id] = dataStorage->addLabel();
+      }
+
+      const size_t end = numRets > 1 ? dataStorage->addLabel() : 0;
+      std::unique_ptr<BytecodeChunk> inlined(new BytecodeChunk);
+
+      for (size_t k = 0; k < body.size(); k++) {
+        if (auto asLabel = dynamic_cast<LabelMarker*>(body[k].get())) {
+          inlined->append(std::unique_ptr<LabelMarker>(new LabelMarker(renamed[asLabel->getLabelId()])));
+          continue;
+        }
+
+        if (dynamic_cast<Op_Ret*>(body[k].get()) != nullptr) {
+          if (k + 1 < body.size()) {
+            inlined->append(std::unique_ptr<Op_Jmp>(new Op_Jmp(
+              ObjLoc(end, ObjLoc::DataStoreLocation::StaticDataStore)
+            )));
+          }
+
+          continue;
+        }
+
+        std::vector<ObjLoc*> objLocs;
+        body[k]->getObjLocs(objLocs);
+
+        const bool isJump = asLabelJump(body[k].get()) != nullptr;
+
+        for (ObjLoc *loc : objLocs) {
+          if (isJump && bodyLabels.count(loc->getLocation())) {
+            *loc = ObjLoc(renamed[loc->getLocation()], ObjLoc::DataStoreLocation::StaticDataStore);
+          } else {
+            callerSlot(ObjLoc(*loc), *loc);
+          }
+        }
+
+        // an argument known to be a constant is read as one, unless it
+        // is read as a float
+        auto constantArg = [&](const ObjLoc &loc, int64_t &out) {
+          if (loc.getDataStoreLocation() != ObjLoc::DataStoreLocation::LocalDataStore ||
+              !loc.isRelative() || (size_t)-loc.getLocation() > constants.size()) {
+            return false;
+          }
+
+          out = constants[-loc.getLocation() - 1];
+
+          return true;
+        };
+
+        Buildable *b = body[k].get();
+        int64_t value;
+
+        if (auto asMov = dynamic_cast<Op_Mov*>(b)) {
+          if (constantArg(asMov->getRight(), value)) {
+            replaceLeaf(body[k], new Op_Load(asMov->getLeft(), Value(value)));
+          }
+        } else if (auto asCmp = dynamic_cast<Op_Cmp*>(b)) {
+          if (!asCmp->getRight().isImmediate() && constantArg(asCmp->getRight().getObjLoc(), value)) {
+            replaceLeaf(body[k], new Op_Cmp(asCmp->getLeft(), Operand(Value(value))));
+          }
+        } else if (auto asAdd = dynamic_cast<Op_Add*>(b)) {
+          if (asAdd->getFlags() == Op_Cmp::Flags::None && !asAdd->getRight().isImmediate() &&
+              constantArg(asAdd->getRight().getObjLoc(), value)) {
+            replaceLeaf(body[k], new Op_Add(asAdd->getLeft(), Operand(Value(value)), asAdd->getFlags()));
+          }
+        } else if (auto asSub = dynamic_cast<Op_Sub*>(b)) {
+          if (asSub->getFlags() == Op_Cmp::Flags::None && !asSub->getRight().isImmediate() &&
+              constantArg(asSub->getRight().getObjLoc(), value)) {
+            replaceLeaf(body[k], new Op_Sub(asSub->getLeft(), Operand(Value(value)), asSub->getFlags()));
+          }
+        } else if (auto asMul = dynamic_cast<Op_Mul*>(b)) {
+          if (asMul->getFlags() == Op_Cmp::Flags::None && !asMul->getRight().isImmediate() &&
+              constantArg(asMul->getRight().getObjLoc(), value)) {
+            replaceLeaf(body[k], new Op_Mul(asMul->getLeft(), Operand(Value(value)), asMul->getFlags()));
+          }
+        }
+
+        inlined->append(std::move(body[k]));
+      }
+
+      if (numRets > 1) {
+        inlined->append(std::unique_ptr<LabelMarker>(new LabelMarker(end)));
+      }
+
+      if (numArgs != 0) {
+        inlined->append(std::unique_ptr<Op_Pop>(new Op_Pop(numArgs)));
+      }
+
+      replaceLeaf(*leaves[i], inlined.release());
+    }
+  }
+
+  void BytecodeChunk::numberSites(const Profile *profile) {
+    std::vector<std::unique_ptr<Buildable>*> leaves;
+    collectLeaves(leaves);
+
+    uint32_t id = 0;
+
+    for (auto leaf : leaves) {
+      auto asJmp = dynamic_cast<Op_Jmp*>(leaf->get());
+      auto asFCall = dynamic_cast<Op_FCall*>(leaf->get());
+
+      if ((asJmp == nullptr || asJmp->getFlags() == Op_Jmp::Flags::None) && asFCall == nullptr) {
+        continue;
+      }
+
+      Site site;
+      site.id = id++;
+
+      if (profile != nullptr) {
+        profile->apply(site);
+      }
+
+      if (asJmp != nullptr) {
+        asJmp->setSite(site);
+      } else {
+        asFCall->setSite(site);
+      }
+    }
+  }
+
+  void BytecodeChunk::layoutBlocks() {
+    std::vector<std::unique_ptr<Buildable>*> leaves;
+    collectLeaves(leaves);
+
+    DataStorage *dataStorage = nullptr;
+    std::map<size_t, size_t> labels; // id to index in `leaves`
+
+    for (size_t i = 0; i < leaves.size(); i++) {
+      Buildable *b = leaves[i]->get();
+      std::vector<ObjLoc*> objLocs;
+
+      if (auto asDataStorage = dynamic_cast<DataStorage*>(b)) {
+        dataStorage = asDataStorage;
+        continue;
+      }
+
+      if (auto asLabel = dynamic_cast<LabelMarker*>(b)) {
+        labels[asLabel->getLabelId()] = i;
+      }
+
+      // a jit region is compiled from where its code is, and a try
+      // region catches by where its code is
+      if (dynamic_cast<Op_Jit*>(b) != nullptr || dynamic_cast<TryMarker*>(b) != nullptr || !b->getObjLocs(objLocs)) {
+        return;
+      }
+
+      for (const ObjLoc *loc : objLocs) {
+        // $pc: an address that is not a label's
+        if (loc->getDataStoreLocation() == ObjLoc::DataStoreLocation::VMDataStore && loc->getLocation() == 0) {
+          return;
+        }
+      }
+    }
+
+    // new labels need a slot
+    if (dataStorage == nullptr) {
+      return;
+    }
+
+    std::unique_ptr<BytecodeChunk> cold(new BytecodeChunk);
+
+    for (size_t i = 0; i < leaves.size(); i++) {
+      Op_Jmp *asJmp = asLabelJump(leaves[i]->get());
+
+      if (asJmp == nullptr || invertJump(asJmp->getFlags()) == Op_Jmp::Flags::None) {
+        continue;
+      }
+
+      // mostly taken: what it jumps over rarely runs
+      const Site &site = asJmp->getSite();
+
+      if (!site.profiled || site.count == 0 || site.taken * 4 < site.count * 3) {
+        continue;
+      }
+
+      auto target = labels.find(asJmp->getObjLoc().getLocation());
+
+      if (target == labels.end() || target->second <= i + 1) {
+        continue;
+      }
+
+      const size_t end = target->second;
+      bool instructions = false, movable = true;
+
+      for (size_t k = i + 1; k < end; k++) {
+        Buildable *b = leaves[k]->get();
+
+        // already moved, or static data
+        movable = movable && b != nullptr && dynamic_cast<DataStorage*>(b) == nullptr;
+        instructions = instructions || (b != nullptr && dynamic_cast<LabelMarker*>(b) == nullptr);
+      }
+
+      if (!movable || !instructions) {
+        continue;
+      }
+
+      // the jump goes to the block instead, at the end, which then jumps
+      // back unless it already leaves some other way
+      const size_t entry = dataStorage->addLabel();
+      Buildable *last = leaves[end - 1]->get();
+      auto lastJmp = dynamic_cast<Op_Jmp*>(last);
+      const bool fallsThrough = dynamic_cast<Op_Halt*>(last) == nullptr && dynamic_cast<Op_Ret*>(last) == nullptr &&
+        (lastJmp == nullptr || lastJmp->getFlags() != Op_Jmp::Flags::None);
+
+      std::unique_ptr<Op_Jmp> inverted(new Op_Jmp(ObjLoc(entry, ObjLoc::DataStoreLocation::StaticDataStore),
+        invertJump(asJmp->getFlags())));
+      inverted->setSite(site.invert());
+
+      cold->append(std::unique_ptr<Buildable>(new LabelMarker(entry)));
+
+      for (size_t k = i + 1; k < end; k++) {
+        cold->append(std::move(*leaves[k]));
+      }
+
+      if (fallsThrough) {
+        cold->append(std::unique_ptr<Buildable>(new Op_Jmp(asJmp->getObjLoc())));
+      }
+
+      replaceLeaf(*leaves[i], inverted.release());
+      i = end;
+    }
+
+    // nothing falls into the moved blocks
+    if (!cold->m_buildables.empty()) {
+      append(std::unique_ptr<Buildable>(new Op_Halt));
+      append(std::move(cold));
+    }
+  }
+
+  void BytecodeChunk::peephole() {
+    inlineCalls();
+    foldConstants();
+    threadJumps();
+    rotateLoops();
+    eliminateDeadCode();
+    layoutBlocks();
+
+    std::vector<std::unique_ptr<Buildable>*> leaves;
+    collectLeaves(leaves);
+
+    // a jump to a label among the ones directly after it goes nowhere,
+    // whatever its condition
+    for (size_t i = 0; i < leaves.size(); i++) {
+      auto asJmp = dynamic_cast<Op_Jmp*>(leaves[i]->get());
+
+      if (asJmp == nullptr ||
+          asJmp->getObjLoc().getDataStoreLocation() != ObjLoc::DataStoreLocation::StaticDataStore) {
+        continue;
+      }
+
+      for (size_t j = i + 1; j < leaves.size(); j++) {
+        auto asLabel = dynamic_cast<LabelMarker*>(leaves[j]->get());
+
+        if (asLabel == nullptr) {
+          break;
+        }
+
+        if (asLabel->getLabelId() == (size_t)asJmp->getObjLoc().getLocation()) {
+          leaves[i]->reset();
+          break;
+        }
+      }
+    }
+
+    // the rest look at the last instructions kept, so that removing a pair
+    // lets the ones around it pair up in turn: push a, push b, pop 2
+    std::vector<std::unique_ptr<Buildable>*> kept;
+
+    for (auto leaf : leaves) {
+      if (*leaf == nullptr) {
+        continue;
+      }
+
+      kept.push_back(leaf);
+
+      while (!kept.empty()) {
+        std::unique_ptr<Buildable> &last = *kept.back();
+
+        if (auto asMov = dynamic_cast<Op_Mov*>(last.get())) {
+          if (asMov->getLeft() == asMov->getRight()) {
+            last.reset();
+            kept.pop_back();
+            continue;
+          }
+
+          break;
+        }
+
+        auto asPop = dynamic_cast<Op_Pop*>(last.get());
+
+        if (asPop == nullptr) {
+          break;
+        }
+
+        if (asPop->getAmount() == 0) {
+          last.reset();
+          kept.pop_back();
+          continue;
+        }
+
+        if (kept.size() < 2) {
+          break;
+        }
+
+        std::unique_ptr<Buildable> &prev = *kept[kept.size() - 2];
+
+        if (dynamic_cast<Op_Push*>(prev.get()) != nullptr || dynamic_cast<Op_PushConst*>(prev.get()) != nullptr) {
+          const size_t amt = asPop->getAmount() - 1;
+
+          prev.reset();
+          kept.erase(kept.end() - 2);
+          replaceLeaf(last, new Op_Pop(amt));
+          continue;
+        }
+
+        if (auto asPrevPop = dynamic_cast<Op_Pop*>(prev.get())) {
+          const size_t amt = asPrevPop->getAmount() + asPop->getAmount();
+
+          // the amount is encoded in 16 bits
+          if (amt > UINT16_MAX) {
+            break;
+          }
+
+          replaceLeaf(prev, new Op_Pop(amt));
+          last.reset();
+          kept.pop_back();
+          continue;
+        }
+
+        break;
+      }
+    }
+
+    ifConvert();
+    fuseCompareJumps();
+  }
+
+  void BytecodeChunk::ifConvert() {
+    std::vector<std::unique_ptr<Buildable>*> leaves;
+    collectLeaves(leaves);
+
+    std::map<size_t, size_t> refs; // label id to the number of operands naming it
+
+    for (auto leaf : leaves) {
+      std::vector<ObjLoc*> objLocs;
+
+      if (dynamic_cast<LabelMarker*>(leaf->get()) != nullptr || dynamic_cast<DataStorage*>(leaf->get()) != nullptr) {
+        continue;
+      }
+
+      // a label could be reached some way this does not see
+      if (!(*leaf)->getObjLocs(objLocs)) {
+        return;
+      }
+
+      for (const ObjLoc *loc : objLocs) {
+        if (loc->getDataStoreLocation() == ObjLoc::DataStoreLocation::StaticDataStore) {
+          refs[loc->getLocation()]++;
+        }
+      }
+    }
+
+    // past the labels from `j` on, whether `label` is one of them and the
+    // others are named by nothing
+    auto skipLabels = [&](size_t &j, size_t label, bool &only) {
+      bool found = false;
+
+      only = true;
+
+      for (; j < leaves.size(); j++) {
+        auto asLabel = dynamic_cast<LabelMarker*>(leaves[j]->get());
+
+        if (asLabel == nullptr) {
+          break;
+        }
+
+        found = found || asLabel->getLabelId() == label;
+        only = only && (asLabel->getLabelId() == label || refs[asLabel->getLabelId()] == 0);
+      }
+
+      return found;
+    };
+
+    // an arm of the branch: a mov, or a load of an integer
+    auto asArm = [](Buildable *b, const ObjLoc *&dst, const ObjLoc *&src, int64_t &value) {
+      if (auto asMov = dynamic_cast<Op_Mov*>(b)) {
+        dst = &asMov->getLeft();
+        src = &asMov->getRight();
+        return true;
+      }
+
+      auto asLoad = dynamic_cast<Op_Load*>(b);
+
+      if (asLoad != nullptr && asLoad->getPoolIndex() == Op_Load::noPoolIndex && asInteger(asLoad->getValue(), value)) {
+        dst = &asLoad->getObjLoc();
+        src = nullptr;
+        return true;
+      }
+
+      return false;
+    };
+
+    for (size_t i = 0; i + 2 < leaves.size(); i++) {
+      Op_Jmp *asCond = asLabelJump(leaves[i]->get());
+      const ObjLoc *thenDst, *thenSrc, *elseDst, *elseSrc;
+      int64_t thenValue = 0, elseValue = 0;
+      bool only;
+
+      // only this jump may land on what it skips to
+      if (asCond == nullptr || asCond->getFlags() == Op_Jmp::Flags::None ||
+          refs[asCond->getObjLoc().getLocation()] != 1 ||
+          !asArm(leaves[i + 1]->get(), thenDst, thenSrc, thenValue)) {
+        continue;
+      }
+
+      const Op_Jmp::Flags flags = asCond->getFlags();
+      const size_t skip = asCond->getObjLoc().getLocation();
+      Op_Jmp *asJmp = asLabelJump(leaves[i + 2]->get());
+      size_t j = i + 2;
+
+      // jcc skip; mov dst, x; skip: -- dst keeps its value if the jump is taken
+      if (asJmp == nullptr) {
+        if (thenSrc != nullptr && skipLabels(j, skip, only)) {
+          replaceLeaf(*leaves[i], new Op_Select(*thenDst, *thenDst, *thenSrc, flags));
+          leaves[i + 1]->reset();
+          i = j - 1;
+        }
+
+        continue;
+      }
+
+      // jcc skip; mov dst, x; jmp end; skip: mov dst, y; end:
+      j = i + 3;
+
+      if (asJmp->getFlags() != Op_Jmp::Flags::None || !skipLabels(j, skip, only) || !only || j >= leaves.size() ||
+          !asArm(leaves[j]->get(), elseDst, elseSrc, elseValue) || *elseDst != *thenDst) {
+        continue;
+      }
+
+      const size_t elseArm = j++;
+
+      if (!skipLabels(j, asJmp->getObjLoc().getLocation(), only)) {
+        continue;
+      }
+
+      Buildable *converted = nullptr;
+
+      if (thenSrc != nullptr && elseSrc != nullptr) {
+        converted = new Op_Select(*thenDst, *elseSrc, *thenSrc, flags);
+      } else if (thenSrc == nullptr && elseSrc == nullptr &&
+                 ((thenValue == 0 && elseValue == 1) || (thenValue == 1 && elseValue == 0))) {
+        converted = new Op_SetCc(*thenDst, flags, elseValue == 0);
+      }
+
+      if (converted == nullptr) {
+        continue;
+      }
+
+      replaceLeaf(*leaves[i], converted);
+      leaves[i + 1]->reset();
+      leaves[i + 2]->reset();
+      leaves[elseArm]->reset();
+      i = j - 1;
+    }
+  }
+
+  void BytecodeChunk::fuseCompareJumps() {
+    // every statement is built into its own chunk, so look at the
+    // flattened sequence. a label marker in between blocks the fusion.
+    std::vector<std::unique_ptr<Buildable>*> leaves;
+    collectLeaves(leaves);
+
+    for (size_t i = 1; i < leaves.size(); i++) {
+      auto asCmp = dynamic_cast<Op_Cmp*>(leaves[i - 1]->get());
+      auto asJmp = dynamic_cast<Op_Jmp*>(leaves[i]->get());
+
+      if (asCmp == nullptr || asJmp == nullptr || asJmp->getFlags() == Op_Jmp::Flags::None) {
+        continue;
+      }
+
+      Op_CmpJmp *fused = new Op_CmpJmp(
+        asCmp->getLeft(),
+        asCmp->getRight(),
+        asJmp->getObjLoc(),
+        asJmp->getFlags()
+      );
+
+      fused->setSite(asJmp->getSite());
+      replaceLeaf(*leaves[i - 1], fused);
+      leaves[i]->reset();
+
+      i++;
+    }
+  }
+
+  void BytecodeChunk::directJumps() {
+    std::vector<std::unique_ptr<Buildable>*> leaves;
+    collectLeaves(leaves);
+
+    std::vector<DataStorage*> dataStorages;
+    std::map<size_t, LabelMarker*> labels;
+
+    for (auto leaf : leaves) {
+      if (auto asLabel = dynamic_cast<LabelMarker*>(leaf->get())) {
+        labels[asLabel->getLabelId()] = asLabel;
+      } else if (auto asDataStorage = dynamic_cast<DataStorage*>(leaf->get())) {
+        dataStorages.push_back(asDataStorage);
+      }
+    }
+
+    auto isLabel = [&](const ObjLoc &loc) {
+      return loc.getDataStoreLocation() == ObjLoc::DataStoreLocation::StaticDataStore &&
+        labels.find(loc.getLocation()) != labels.end();
+    };
+
+    for (auto leaf : leaves) {
+      if (auto asJmp = dynamic_cast<Op_Jmp*>(leaf->get())) {
+        if (isLabel(asJmp->getObjLoc())) {
+          Op_Jmp *direct = new Op_Jmp(
+            ObjLoc(asJmp->getObjLoc().getLocation(), ObjLoc::DataStoreLocation::CodeLabel),
+            asJmp->getFlags()
+          );
+
+          direct->setSite(asJmp->getSite());
+          replaceLeaf(*leaf, direct);
+        }
+      } else if (auto asCmpJmp = dynamic_cast<Op_CmpJmp*>(leaf->get())) {
+        if (isLabel(asCmpJmp->getTarget())) {
+          Op_CmpJmp *direct = new Op_CmpJmp(
+            asCmpJmp->getLeft(),
+            asCmpJmp->getRight(),
+            ObjLoc(asCmpJmp->getTarget().getLocation(), ObjLoc::DataStoreLocation::CodeLabel),
+            asCmpJmp->getFlags()
+          );
+
+          direct->setSite(asCmpJmp->getSite());
+          replaceLeaf(*leaf, direct);
+        }
+      } else if (auto asSwitch = dynamic_cast<Op_Switch*>(leaf->get())) {
+        // the cases are written as direct jumps whatever they are here
+        std::vector<ObjLoc> cases;
+
+        for (const ObjLoc &loc : asSwitch->getCases()) {
+          cases.push_back(ObjLoc(loc.getLocation(), ObjLoc::DataStoreLocation::CodeLabel));
+        }
+
+        replaceLeaf(*leaf, new Op_Switch(
+          asSwitch->getSrc(),
+          asSwitch->getLow(),
+          cases,
+          isLabel(asSwitch->getDefault())
+            ? ObjLoc(asSwitch->getDefault().getLocation(), ObjLoc::DataStoreLocation::CodeLabel)
+            : asSwitch->getDefault()
+        ));
+      } else if (auto asFCall = dynamic_cast<Op_FCall*>(leaf->get())) {
+        if (isLabel(asFCall->getTarget())) {
+          Op_FCall *direct = new Op_FCall(
+            ObjLoc(asFCall->getTarget().getLocation(), ObjLoc::DataStoreLocation::CodeLabel),
+            asFCall->getHint()
+          );
+
+          direct->setSite(asFCall->getSite());
+          replaceLeaf(*leaf, direct);
+        }
+      }
+    }
+
+    // a label whose slot something still reads, a call or a computed
+    // jump, keeps its address there
+    std::set<size_t> read;
+
+    for (auto leaf : leaves) {
+      std::vector<ObjLoc*> objLocs;
+
+      if (*leaf == nullptr || dynamic_cast<DataStorage*>(leaf->get()) != nullptr) {
+        continue;
+      }
+
+      if (!(*leaf)->getObjLocs(objLocs)) {
+        return;
+      }
+
+      for (const ObjLoc *loc : objLocs) {
+        if (isLabel(*loc)) {
+          read.insert(loc->getLocation());
+        }
+      }
+    }
+
+    for (auto &label : labels) {
+      if (read.count(label.first)) {
+        continue;
+      }
+
+      label.second->setLoaded(false);
+
+      for (DataStorage *dataStorage : dataStorages) {
+        dataStorage->releaseStaticData(label.first);
+      }
+    }
+  }
+
   LabelId_t BytecodeChunk::generateLabel() {
     LabelId_t id = m_labels.size();
     m_labels.emplace_back();
@@ -0,0 +1,51 @@
+#include <bcparse/emit/bytecode_stream.hpp>
+
+namespace bcparse {
+  std::vector<uint8_t> BytecodeStream::getLineSection() const {
+    const bin_lines_t header = { (uint32_t)m_lineRanges.size(), (uint32_t)m_traces.size() };
+    std::vector<uint8_t> out;
+
+    out.insert(out.end(), (const uint8_t*)&header, (const uint8_t*)&header + sizeof(header));
+    out.insert(out.end(), (const uint8_t*)m_lineRanges.data(),
+      (const uint8_t*)m_lineRanges.data() + m_lineRanges.size() * sizeof(bin_line_t));
+    out.insert(out.end(), (const uint8_t*)m_traces.data(),
+      (const uint8_t*)m_traces.data() + m_traces.size() * sizeof(bin_trace_t));
+    out.insert(out.end(), m_traceStrings.begin(), m_traceStrings.end());
+
+    return out;
+  }
+
+  uint32_t BytecodeStream::internTrace(const SourceTrace *trace) {
+    auto it = m_traceIndices.find(trace);
+
+    if (it != m_traceIndices.end()) {
+      return it->second;
+    }
+
+    bin_trace_t entry = { };
+    entry.file = internTraceString(trace->location.getFileName());
+    entry.directive = internTraceString(trace->directive);
+    entry.line = (uint32_t)(trace->location.getLine() + 1);
+    entry.column = (uint32_t)(trace->location.getColumn() + 1);
+    entry.caller = trace->caller != nullptr ? internTrace(trace->caller.get()) + 1 : 0;
+
+    m_traces.push_back(entry);
+
+    return m_traceIndices[trace] = (uint32_t)(m_traces.size() - 1);
+  }
+
+  uint32_t BytecodeStream::internTraceString(const std::string &str) {
+    auto it = m_traceStringOffsets.find(str);
+
+    if (it != m_traceStringOffsets.end()) {
+      return it->second;
+    }
+
+    const uint32_t offset = (uint32_t)m_traceStrings.size();
+
+    m_traceStrings.insert(m_traceStrings.end(), str.begin(), str.end());
+    m_traceStrings.push_back('\0');
+
+    return m_traceStringOffsets[str] = offset;
+  }
+}
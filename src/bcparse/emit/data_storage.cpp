@@ -3,15 +3,41 @@
 #include <bcparse/emit/formatter.hpp>
 
 #include <algorithm>
+#include <cstring>
+#include <string>
 
 namespace bcparse {
-  const int DataStorage::STATIC_DATA_OFFSET = 128;
+  const int DataStorage::STATIC_DATA_OFFSET = 256;
 
-  DataStorage::DataStorage() {
+  // what --report-size tallies an entry of `value` as
+  static const char *reportedType(const Value &value) {
+    switch (value.getValueType()) {
+      case Value::ValueType::ValueTypeNull: return "null";
+      case Value::ValueType::ValueTypeI64: return "i64";
+      case Value::ValueType::ValueTypeU64: return "u64";
+      case Value::ValueType::ValueTypeF64: return "f64";
+      case Value::ValueType::ValueTypeBoolean: return "boolean";
+      case Value::ValueType::ValueTypeRawData: return "raw data";
+      default: return "none";
+    }
+  }
+
+  DataStorage::DataStorage()
+    : m_sectioned(false),
+      m_retainAll(true) {
   }
 
   DataStorage::DataStorage(const DataStorage &other)
-    : m_values(other.m_values) {
+    : m_values(other.m_values),
+      m_labelOffsets(other.m_labelOffsets),
+      m_imports(other.m_imports),
+      m_constants(other.m_constants),
+      m_valueIndex(other.m_valueIndex),
+      m_constantIndex(other.m_constantIndex),
+      m_alignments(other.m_alignments),
+      m_sectioned(false),
+      m_retainAll(other.m_retainAll),
+      m_retained(other.m_retained) {
   }
 
   size_t DataStorage::addLabel() {
@@ -22,42 +48,282 @@ namespace bcparse {
     return id;
   }
 
+  size_t DataStorage::addImport(const Import &import) {
+    size_t id = addStaticData(Value((uint64_t)0), false /* do not cache placeholder value */);
+
+    m_imports.emplace(id, import);
+
+    return id;
+  }
+
+  const DataStorage::Import *DataStorage::getImport(size_t slot) const {
+    auto it = m_imports.find(slot);
+
+    return it != m_imports.end() ? &it->second : nullptr;
+  }
+
+  const Value *DataStorage::getStaticData(size_t slot) const {
+    if (slot < STATIC_DATA_OFFSET || slot - STATIC_DATA_OFFSET >= m_values.size() ||
+        m_labelOffsets.count(slot) || m_imports.count(slot)) {
+      return nullptr;
+    }
+
+    return &m_values[slot - STATIC_DATA_OFFSET];
+  }
+
   size_t DataStorage::addStaticData(const Value &value, bool cache) {
+    size_t id;
+
     if (cache) {
-      auto it = std::find(m_values.begin(), m_values.end(), value);
+      auto it = m_valueIndex.find(value);
 
-      if (it != m_values.end()) {
-        return STATIC_DATA_OFFSET + (it - m_values.begin());
+      if (it != m_valueIndex.end()) {
+        id = STATIC_DATA_OFFSET + it->second;
+      } else {
+        m_valueIndex.emplace(value, m_values.size());
+        id = STATIC_DATA_OFFSET + m_values.size();
+        m_values.push_back(value);
       }
+    } else {
+      // add new value
+      id = STATIC_DATA_OFFSET + m_values.size();
+      m_values.push_back(value);
     }
 
-    // add new value
-    size_t id = STATIC_DATA_OFFSET + m_values.size();
-
-    m_values.push_back(value);
+    // added once dead code is gone, by a pass that refers to it
+    if (!m_retainAll) {
+      m_retained.insert(id);
+    }
 
     return id;
   }
 
+  size_t DataStorage::addConstant(const Value &value) {
+    auto it = m_constantIndex.find(value);
+
+    if (it != m_constantIndex.end()) {
+      return it->second;
+    }
+
+    m_constantIndex.emplace(value, m_constants.size());
+    m_constants.push_back(value);
+
+    return m_constants.size() - 1;
+  }
+
+  void DataStorage::setAlignment(const Value &value, size_t align) {
+    size_t &current = m_alignments[value];
+
+    current = std::max(current, align);
+  }
+
+  void DataStorage::retainStaticData(const std::set<size_t> &slots) {
+    m_retainAll = false;
+    m_retained = slots;
+  }
+
+  void DataStorage::releaseStaticData(size_t slot) {
+    if (m_retainAll) {
+      for (size_t i = 0; i < m_values.size(); i++) {
+        m_retained.insert(STATIC_DATA_OFFSET + i);
+      }
+
+      m_retainAll = false;
+    }
+
+    m_retained.erase(slot);
+  }
+
+  bool DataStorage::isRetained(size_t slot) const {
+    return m_retainAll || m_retained.count(slot) != 0;
+  }
+
   void DataStorage::accept(BytecodeStream *bs) {
     Buildable::accept(bs);
 
+    // raw data (string literals) is loaded as a reference into the
+    // constant pool, so copies of the slot share it rather than refcount it
+    std::vector<size_t> poolIndices;
+
     for (size_t i = 0; i < m_values.size(); i++) {
-      bs->getLabelOffsetMap()[i] = bs->streamOffset();
+      poolIndices.push_back(m_values[i].getValueType() == Value::ValueType::ValueTypeRawData && isRetained(STATIC_DATA_OFFSET + i)
+        ? addConstant(m_values[i])
+        : Op_Load::noPoolIndex);
+    }
+
+    SizeReport *report = bs->getReport();
+
+    m_sectioned = bs->isSectioned();
+    m_opConsts.clear();
+    m_opLoads.clear();
+
+    if (m_sectioned) {
+      acceptSections(bs, poolIndices);
+      return;
+    }
+
+    for (size_t i = 0; i < m_constants.size(); i++) {
+      const size_t start = bs->streamOffset();
+
+      m_opConsts.push_back(std::unique_ptr<Op_Const>(new Op_Const(i, m_constants[i])));
+      m_opConsts.back()->accept(bs);
+
+      if (report != nullptr) {
+        report->staticData("const", bs->streamOffset() - start);
+      }
+    }
+
+    for (size_t i = 0; i < m_values.size(); i++) {
+      // an import has nothing to load in a flat stream, which cannot have one
+      if (!isRetained(STATIC_DATA_OFFSET + i) || m_imports.count(STATIC_DATA_OFFSET + i)) {
+        continue;
+      }
+
+      // a label's address, once the sizing pass has placed it. the
+      // placeholder before that is a u64 all the same.
+      Value value = m_values[i];
+
+      if (m_labelOffsets.count(STATIC_DATA_OFFSET + i)) {
+        auto it = bs->getLabelAddressMap().find(STATIC_DATA_OFFSET + i);
+
+        if (it != bs->getLabelAddressMap().end()) {
+          value = Value((uint64_t)it->second);
+        }
+      }
 
       // @TODO assertion that it does not exceed max size
       m_opLoads.push_back(std::unique_ptr<Op_Load>(new Op_Load(
         ObjLoc(STATIC_DATA_OFFSET + i, ObjLoc::DataStoreLocation::StaticDataStore),
-        m_values[i]
+        poolIndices[i],
+        value
       )));
 
+      const size_t start = bs->streamOffset();
+
       m_opLoads.back()->accept(bs);
+
+      if (report == nullptr) {
+        continue;
+      }
+
+      if (m_labelOffsets.count(STATIC_DATA_OFFSET + i)) {
+        report->label(bs->streamOffset() - start);
+      } else {
+        report->staticData(reportedType(m_values[i]), bs->streamOffset() - start);
+      }
+    }
+  }
+
+  void DataStorage::acceptSections(BytecodeStream *bs, const std::vector<size_t> &poolIndices) {
+    SizeReport *report = bs->getReport();
+
+    // laid out in place (BIN_CONST_IN_PLACE), for the vm to point into
+    // the file rather than copy them out
+    for (const Value &value : m_constants) {
+      std::vector<uint8_t> &constants = bs->getConstSection();
+      auto it = m_alignments.find(value);
+      bin_const_t entry = { };
+      entry.size = value.getSize();
+      entry.align = it != m_alignments.end() ? (uint32_t)it->second : 0;
+
+      if (entry.align > 1) {
+        const size_t start = constants.size() + sizeof(entry);
+
+        entry.padding = (uint32_t)((entry.align - start % entry.align) % entry.align);
+      }
+
+      constants.insert(constants.end(), (const uint8_t*)&entry, (const uint8_t*)&entry + sizeof(entry));
+      constants.resize(constants.size() + entry.padding);
+      constants.insert(constants.end(), value.getBytes(), value.getBytes() + entry.size);
+      constants.push_back(0);
+
+      if (report != nullptr) {
+        report->staticData("const", sizeof(entry) + entry.padding + entry.size + 1);
+      }
+    }
+
+    for (auto &it : m_imports) {
+      if (!isRetained(it.first)) {
+        continue;
+      }
+
+      const Import &import = it.second;
+      bin_import_t entry = { };
+      entry.slot = (uint32_t)it.first;
+      entry.moduleLength = (uint16_t)import.module.size();
+      entry.nameLength = (uint16_t)import.name.size();
+      entry.signatureLength = (uint16_t)import.signature.size();
+
+      std::vector<uint8_t> &imports = bs->getImportSection();
+
+      imports.insert(imports.end(), (const uint8_t*)&entry, (const uint8_t*)&entry + sizeof(entry));
+      imports.insert(imports.end(), import.module.begin(), import.module.end());
+      imports.insert(imports.end(), import.name.begin(), import.name.end());
+      imports.insert(imports.end(), import.signature.begin(), import.signature.end());
+
+      if (report != nullptr) {
+        report->staticData("import", sizeof(entry) + import.module.size() + import.name.size() + import.signature.size());
+      }
+    }
+
+    for (size_t i = 0; i < m_values.size(); i++) {
+      // written by the label's LabelMarker, or as an import above
+      if (m_labelOffsets.count(STATIC_DATA_OFFSET + i) || m_imports.count(STATIC_DATA_OFFSET + i)
+          || !isRetained(STATIC_DATA_OFFSET + i)) {
+        continue;
+      }
+
+      bin_data_t entry = { };
+      entry.slot = (uint32_t)(STATIC_DATA_OFFSET + i);
+
+      if (poolIndices[i] != Op_Load::noPoolIndex) {
+        entry.type = 0x6; // CONST_FLAGS_POOL, as Op_Load
+        entry.data = poolIndices[i];
+      } else {
+        entry.type = (uint8_t)m_values[i].getValueType();
+        std::memcpy(&entry.data, m_values[i].getBytes(), std::min(m_values[i].getSize(), sizeof(entry.data)));
+      }
+
+      bs->getDataSection().push_back(entry);
+
+      if (report != nullptr) {
+        report->staticData(reportedType(m_values[i]), sizeof(entry));
+      }
     }
   }
 
   void DataStorage::debugPrint(BytecodeStream *bs, Formatter *f) {
     Buildable::debugPrint(bs, f);
 
+    if (m_sectioned) {
+      // not in the code, so without an offset
+      f->setLineNo(-1);
+
+      for (size_t i = 0; i < m_constants.size(); i++) {
+        f->append("Const(#" + std::to_string(i) + ", " + m_constants[i].toString() + ")");
+      }
+
+      for (size_t i = 0; i < m_values.size(); i++) {
+        const ObjLoc loc(STATIC_DATA_OFFSET + i, ObjLoc::DataStoreLocation::StaticDataStore);
+
+        if (!isRetained(STATIC_DATA_OFFSET + i) || m_labelOffsets.count(STATIC_DATA_OFFSET + i)) {
+          continue;
+        }
+
+        if (const Import *import = getImport(STATIC_DATA_OFFSET + i)) {
+          f->append("Import(" + loc.toString() + ", " + import->module + "." + import->name + " " + import->signature + ")");
+        } else {
+          f->append("Data(" + loc.toString() + ", " + m_values[i].toString() + ")");
+        }
+      }
+
+      return;
+    }
+
+    for (auto &opConst : m_opConsts) {
+      opConst->debugPrint(bs, f);
+    }
+
     for (auto &opLoad : m_opLoads) {
       opLoad->debugPrint(bs, f);
     }
@@ -1,19 +1,115 @@
 #include <bcparse/emit/emitter.hpp>
 #include <bcparse/emit/emit.hpp>
+#include <bcparse/emit/register_allocator.hpp>
 #include <bcparse/emit/formatter.hpp>
+#include <bcparse/emit/lz4.hpp>
+#include <bcparse/emit/size_report.hpp>
+#include <bcparse/compile_stats.hpp>
+
+#include <shared/bin_format.h>
+
+#include <algorithm>
+#include <cstring>
 
 namespace bcparse {
-  Emitter::Emitter(BytecodeChunk *chunk)
-    : m_chunk(chunk) {
+  Emitter::Emitter(BytecodeChunk *chunk, Format format, bool debugInfo, bool compact, bool compress, bool segmented,
+    bool peephole, const Profile *profile, bool object)
+    : m_chunk(chunk),
+      m_format(object ? Format::Sectioned : format),
+      m_debugInfo(debugInfo),
+      m_compact(compact && !object),
+      m_compress(compress && !object),
+      m_segmented(segmented && !object),
+      m_peephole(peephole),
+      m_profile(profile),
+      m_object(object),
+      m_report(nullptr) {
+  }
+
+  // see BIN_CODE_LZ4
+  static std::vector<uint8_t> compressCode(const std::vector<uint8_t> &code) {
+    const uint64_t size = code.size();
+    std::vector<uint8_t> out((const uint8_t*)&size, (const uint8_t*)&size + sizeof(size));
+    std::vector<uint8_t> block;
+
+    for (size_t pos = 0; pos < code.size(); pos += BIN_LZ4_BLOCK_SIZE) {
+      const size_t n = std::min(code.size() - pos, (size_t)BIN_LZ4_BLOCK_SIZE);
+      uint32_t header;
+
+      block.clear();
+      lz4::compressBlock(code.data() + pos, n, block);
+
+      // stored as is if it does not get smaller
+      if (block.size() >= n) {
+        block.assign(code.begin() + pos, code.begin() + pos + n);
+        header = (uint32_t)n | BIN_LZ4_STORED;
+      } else {
+        header = (uint32_t)block.size();
+      }
+
+      out.insert(out.end(), (const uint8_t*)&header, (const uint8_t*)&header + sizeof(header));
+      out.insert(out.end(), block.begin(), block.end());
+    }
+
+    return out;
   }
 
   void Emitter::emit(std::ostream *os, Formatter *f) {
-    BytecodeStream bs;
+    // a flat stream has no section to mark as compact
+    const bool sectioned = m_format == Format::Sectioned;
+    BytecodeStream sizing(sectioned, sectioned && m_compact, m_segmented, m_object);
+    BytecodeStream bs(sectioned, sectioned && m_compact, m_segmented, m_object);
     Op_Halt op_halt;
 
+    {
+      CompileStats::Timer timer(CompileStats::PHASE_OPTIMIZE);
+
+      // numbered before anything rewrites the chunk, so that a profile of
+      // one build of a source applies to the next
+      m_chunk->numberSites(m_profile);
+
+      // temporaries cannot be built, so this is not optional
+      RegisterAllocator allocator(m_chunk);
+      allocator.allocate();
+
+      if (m_peephole) {
+        m_chunk->peephole();
+        m_chunk->scratchObjects();
+        m_chunk->objectTemplates();
+        m_chunk->takeResults();
+      }
+      m_chunk->directJumps();
+    }
+
+    CompileStats::Timer timer(CompileStats::PHASE_EMIT);
+
+    // built twice: first only to size the code and place the labels, so
+    // that the second pass writes it out in order, into a buffer of its
+    // final size, with the address of every label it refers to known
+    sizing.setSizing(true);
+    m_chunk->accept(&sizing);
+    op_halt.accept(&sizing);
+
+    bs.preallocate(sizing);
+    bs.setReport(m_report);
     m_chunk->accept(&bs);
+
+    if (m_report != nullptr) {
+      m_report->trace(nullptr);
+    }
+
     op_halt.accept(&bs);
 
+    if (m_report != nullptr) {
+      m_report->finish(bs.streamOffset());
+    }
+
+    ASSERT(bs.streamOffset() == sizing.streamOffset());
+
+    if (CompileStats *stats = CompileStats::current()) {
+      stats->codeSize = bs.streamOffset();
+    }
+
     if (f != nullptr) {
       f->setLineNo(0);
 
@@ -21,6 +117,123 @@ namespace bcparse {
       op_halt.debugPrint(&bs, f);
     }
 
-    os->write((char*)&bs.getData()[0], bs.getData().size());
+    if (m_format == Format::Sectioned) {
+      emitSections(os, bs);
+    } else {
+      if (m_report != nullptr) {
+        m_report->section("code", bs.getData().size());
+      }
+
+      os->write((char*)&bs.getData()[0], bs.getData().size());
+    }
+  }
+
+  void Emitter::emitSections(std::ostream *os, BytecodeStream &bs) {
+    struct Section {
+      uint32_t kind;
+      const void *data;
+      size_t size;
+      uint32_t flags;
+    };
+
+    uint32_t codeFlags = bs.isCompact() ? (uint32_t)BIN_CODE_COMPACT : 0;
+    const std::vector<uint8_t> *code = &bs.getData();
+    std::vector<uint8_t> compressed;
+
+    if (m_compress) {
+      compressed = compressCode(bs.getData());
+      code = &compressed;
+      codeFlags |= BIN_CODE_LZ4;
+    }
+
+    std::vector<Section> sections = {
+      { BIN_SECTION_CODE, code->data(), code->size(), codeFlags },
+      { BIN_SECTION_CONST, bs.getConstSection().data(), bs.getConstSection().size(), BIN_CONST_IN_PLACE },
+      { BIN_SECTION_DATA, bs.getDataSection().data(), bs.getDataSection().size() * sizeof(bin_data_t) },
+      { BIN_SECTION_LABELS, bs.getLabelSection().data(), bs.getLabelSection().size() * sizeof(bin_label_t) }
+    };
+
+    if (bs.isSegmented()) {
+      sections.push_back({ BIN_SECTION_SEGMENTS, bs.getSegmentSection().data(),
+        bs.getSegmentSection().size() * sizeof(bin_segment_t) });
+    }
+
+    if (bs.isRelocatable()) {
+      sections.push_back({ BIN_SECTION_SYMBOLS, bs.getSymbolSection().data(), bs.getSymbolSection().size() });
+      sections.push_back({ BIN_SECTION_RELOCS, bs.getRelocSection().data(),
+        bs.getRelocSection().size() * sizeof(bin_reloc_t) });
+    } else if (!bs.getSymbolSection().empty()) {
+      sections.push_back({ BIN_SECTION_SYMBOLS, bs.getSymbolSection().data(), bs.getSymbolSection().size() });
+    }
+
+    if (!bs.getImportSection().empty()) {
+      sections.push_back({ BIN_SECTION_IMPORTS, bs.getImportSection().data(), bs.getImportSection().size() });
+    }
+
+    if (!bs.getTrySection().empty()) {
+      sections.push_back({ BIN_SECTION_TRIES, bs.getTrySection().data(),
+        bs.getTrySection().size() * sizeof(bin_try_t) });
+    }
+
+    std::vector<uint8_t> lines;
+
+    if (m_debugInfo) {
+      lines = bs.getLineSection();
+
+      sections.push_back({ BIN_SECTION_DEBUG, bs.getDebugSection().data(), bs.getDebugSection().size() });
+      sections.push_back({ BIN_SECTION_SITES, bs.getSiteSection().data(),
+        bs.getSiteSection().size() * sizeof(bin_site_t) });
+      sections.push_back({ BIN_SECTION_LINES, lines.data(), lines.size() });
+    }
+
+    if (m_report != nullptr) {
+      static const char *const names[] = {
+        "", "code", "const", "data", "labels", "debug", "segments", "sites", "symbols", "relocs", "lines", "imports", "tries"
+      };
+
+      m_report->section("header", sizeof(bin_header_t) + sections.size() * sizeof(bin_section_t));
+
+      for (const Section &section : sections) {
+        m_report->section(section.kind < sizeof(names) / sizeof(names[0]) ? std::string(names[section.kind]) : std::to_string(section.kind),
+          section.size);
+      }
+    }
+
+    bin_header_t header = { };
+    std::memcpy(header.magic, BIN_MAGIC, BIN_MAGIC_SIZE);
+    header.version = BIN_VERSION;
+    header.numSections = (uint16_t)sections.size();
+
+    size_t size = sizeof(header) + sections.size() * sizeof(bin_section_t);
+
+    // the constants are aligned within their section as they ask to be,
+    // so the section is as aligned in the file
+    auto alignOf = [](const Section &section) -> size_t {
+      return section.kind == BIN_SECTION_CONST ? BIN_CONST_ALIGN : BIN_ALIGN;
+    };
+
+    for (const Section &section : sections) {
+      size = (size + alignOf(section) - 1) / alignOf(section) * alignOf(section) + section.size;
+    }
+
+    std::vector<uint8_t> out;
+    out.reserve(size);
+    out.insert(out.end(), (const uint8_t*)&header, (const uint8_t*)&header + sizeof(header));
+    out.resize(sizeof(header) + sections.size() * sizeof(bin_section_t));
+
+    for (size_t i = 0; i < sections.size(); i++) {
+      bin_section_t s = { };
+      s.kind = sections[i].kind;
+      s.flags = sections[i].flags;
+      s.offset = (out.size() + alignOf(sections[i]) - 1) / alignOf(sections[i]) * alignOf(sections[i]);
+      s.size = sections[i].size;
+
+      out.resize(s.offset);
+      out.insert(out.end(), (const uint8_t*)sections[i].data, (const uint8_t*)sections[i].data + s.size);
+
+      std::memcpy(&out[sizeof(header) + i * sizeof(bin_section_t)], &s, sizeof(s));
+    }
+
+    os->write((char*)out.data(), out.size());
   }
 }
@@ -1,9 +1,12 @@
 #include <bcparse/emit/formatter.hpp>
 
+#include <cstring>
+
 namespace bcparse {
-  Formatter::Formatter()
+  Formatter::Formatter(std::ostream *out)
     : m_indentation(0),
-      m_lineNo(-1) {
+      m_lineNo(-1),
+      m_out(out) {
   }
 
   void Formatter::increaseIndent() {
@@ -31,17 +34,13 @@ namespace bcparse {
 
       border[fillLength - 1] = '\0';
 
-      m_buf << border;
+      *m_out << border;
     }
 
     for (int i = 0; i < m_indentation; i++) {
-      m_buf << "  ";
+      *m_out << "  ";
     }
 
-    m_buf << str << "\n";
-  }
-
-  std::string Formatter::toString() const {
-    return m_buf.str();
+    *m_out << str << "\n";
   }
 }
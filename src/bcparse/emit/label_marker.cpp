@@ -4,47 +4,52 @@
 #include <sstream>
 
 namespace bcparse {
-  LabelMarker::LabelMarker(size_t labelId)
+  LabelMarker::LabelMarker(size_t labelId, const std::string &name)
     : m_labelId(labelId),
-      m_opLoad(nullptr) {
-  }
-
-  LabelMarker::~LabelMarker() {
-    if (m_opLoad != nullptr) {
-      delete m_opLoad;
-      m_opLoad = nullptr;
-    }
+      m_name(name),
+      m_loaded(true) {
   }
 
   void LabelMarker::accept(BytecodeStream *bs) {
     Buildable::accept(bs);
 
+    // a jump target, so where a segment can begin
+    bs->acceptSegmentBoundary();
+
     const uint64_t address = bs->streamOffset();
-    const size_t offset = bs->getLabelOffsetMap()[m_labelId];
 
     bs->getLabelAddressMap()[m_labelId] = address;
 
-    // create sub-bytecode stream then overwrite data at `loc`
-    BytecodeStream sub;
-
-    m_opLoad = new Op_Load(
-      ObjLoc(m_labelId, ObjLoc::DataStoreLocation::StaticDataStore),
-      Value(address)
-    );
-
-    // load current stream offset into static data store
-    m_opLoad->accept(&sub);
-
-    for (size_t i = 0; i < sub.getData().size(); i++) {
-      bs->getData()[offset + i] = sub.getData()[i];
+    // in a flat stream, the load of the address into the label's slot
+    // is DataStorage's, which has it from the sizing pass
+    if (bs->isSectioned()) {
+      if (m_loaded) {
+        bin_label_t entry = { };
+        entry.slot = (uint32_t)m_labelId;
+        entry.offset = address;
+
+        bs->getLabelSection().push_back(entry);
+
+        if (SizeReport *report = bs->getReport()) {
+          report->label(sizeof(entry));
+        }
+      }
+
+      if (!m_name.empty()) {
+        const uint32_t length = m_name.size();
+        std::vector<uint8_t> &debug = bs->getDebugSection();
+
+        debug.insert(debug.end(), (const uint8_t*)&address, (const uint8_t*)&address + sizeof(address));
+        debug.insert(debug.end(), (const uint8_t*)&length, (const uint8_t*)&length + sizeof(length));
+        debug.insert(debug.end(), m_name.begin(), m_name.end());
+      }
     }
   }
 
   void LabelMarker::debugPrint(BytecodeStream *bs, Formatter *f) {
-    // Buildable::debugPrint(bs, f);
+  }
 
-    // if (m_opLoad != nullptr) {
-    //   m_opLoad->debugPrint(bs, f);
-    // }
+  bool LabelMarker::getObjLocs(std::vector<ObjLoc*> &out) {
+    return true;
   }
 }
@@ -0,0 +1,92 @@
+#include <bcparse/emit/lz4.hpp>
+
+#include <cstring>
+
+namespace bcparse {
+  namespace lz4 {
+    static const size_t minMatch = 4;
+    // the format wants the last 5 bytes to be literals, and the last match
+    // to begin 12 bytes before the end
+    static const size_t lastLiterals = 5;
+    static const size_t matchLimit = 12;
+    static const size_t maxOffset = 65535;
+    static const unsigned hashBits = 12;
+
+    static uint32_t read32(const uint8_t *p) {
+      uint32_t u32;
+      std::memcpy(&u32, p, sizeof(u32));
+      return u32;
+    }
+
+    static uint32_t hash(uint32_t sequence) {
+      return (sequence * 2654435761u) >> (32 - hashBits);
+    }
+
+    static void writeLength(size_t len, std::vector<uint8_t> &out) {
+      for (len -= 15; len >= 255; len -= 255) {
+        out.push_back(255);
+      }
+
+      out.push_back((uint8_t)len);
+    }
+
+    // `literals` bytes at `src`, then a match of `match` bytes at `offset`
+    // back, or none for the last sequence
+    static void writeSequence(const uint8_t *src, size_t literals, size_t offset, size_t match,
+                              std::vector<uint8_t> &out) {
+      const size_t matchCode = match != 0 ? match - minMatch : 0;
+
+      out.push_back((uint8_t)(((literals < 15 ? literals : 15) << 4) | (matchCode < 15 ? matchCode : 15)));
+
+      if (literals >= 15) {
+        writeLength(literals, out);
+      }
+
+      out.insert(out.end(), src, src + literals);
+
+      if (match == 0) {
+        return;
+      }
+
+      out.push_back((uint8_t)(offset & 0xFF));
+      out.push_back((uint8_t)(offset >> 8));
+
+      if (matchCode >= 15) {
+        writeLength(matchCode, out);
+      }
+    }
+
+    void compressBlock(const uint8_t *src, size_t size, std::vector<uint8_t> &out) {
+      // positions + 1, so 0 is none
+      std::vector<uint32_t> table(1 << hashBits, 0);
+      size_t anchor = 0, pos = 0;
+
+      while (size > matchLimit && pos < size - matchLimit) {
+        const uint32_t sequence = read32(src + pos);
+        const uint32_t h = hash(sequence);
+        const size_t candidate = table[h];
+
+        table[h] = (uint32_t)(pos + 1);
+
+        if (candidate == 0 || pos - (candidate - 1) > maxOffset || read32(src + candidate - 1) != sequence) {
+          pos++;
+          continue;
+        }
+
+        const size_t ref = candidate - 1;
+        size_t match = minMatch;
+
+        while (pos + match < size - lastLiterals && src[ref + match] == src[pos + match]) {
+          match++;
+        }
+
+        writeSequence(src + anchor, pos - anchor, pos - ref, match, out);
+
+        pos += match;
+        anchor = pos;
+      }
+
+      writeSequence(src + anchor, size - anchor, 0, 0, out);
+    }
+  }
+}
@@ -1,18 +1,50 @@
 #include <bcparse/emit/emit.hpp>
 #include <bcparse/emit/formatter.hpp>
 
+#include <shared/config.h>
+
+#include <common/my_assert.hpp>
+
 #include <sstream>
 
 namespace bcparse {
-  Op_Call::Op_Call(const ObjLoc &objLoc)
-    : m_objLoc(objLoc) {
+  Op_Call::Op_Call(const ObjLoc &objLoc, Flags flags)
+    : m_objLoc(objLoc),
+      m_flags(flags),
+      m_hasResult(false) {
+  }
+
+  Op_Call::Op_Call(const ObjLoc &objLoc, const std::vector<ObjLoc> &args)
+    : m_objLoc(objLoc),
+      m_flags(Flags::OperandArgs),
+      m_args(args),
+      m_hasResult(false) {
+    ASSERT(args.size() <= CALL_MAX_OPERANDS);
+  }
+
+  void Op_Call::setResult(const ObjLoc &result) {
+    m_hasResult = true;
+    m_result = result;
   }
 
   void Op_Call::accept(BytecodeStream *bs) {
     Buildable::accept(bs);
 
-    bs->acceptInstruction(0x14, 0);
+    // CALL_FLAGS_RESULT
+    bs->acceptInstruction(0x14, (uint8_t)m_flags | (m_hasResult ? 0x4 : 0x0));
     bs->acceptObjLoc(m_objLoc);
+
+    if (m_flags == Flags::OperandArgs) {
+      bs->acceptUint((uint8_t)m_args.size());
+
+      for (const ObjLoc &arg : m_args) {
+        bs->acceptObjLoc(arg);
+      }
+    }
+
+    if (m_hasResult) {
+      bs->acceptObjLoc(m_result);
+    }
   }
 
   void Op_Call::debugPrint(BytecodeStream *bs, Formatter *f) {
@@ -21,8 +53,33 @@ namespace bcparse {
     std::stringstream ss;
     ss << "Op_Call("
        << m_objLoc.toString()
-       << ")";
+       << ", "
+       << (uint32_t)m_flags;
+
+    for (const ObjLoc &arg : m_args) {
+      ss << ", " << arg.toString();
+    }
+
+    if (m_hasResult) {
+      ss << " -> " << m_result.toString();
+    }
+
+    ss << ")";
 
     f->append(ss.str());
   }
+
+  bool Op_Call::getObjLocs(std::vector<ObjLoc*> &out) {
+    out.push_back(&m_objLoc);
+
+    for (ObjLoc &arg : m_args) {
+      out.push_back(&arg);
+    }
+
+    if (m_hasResult) {
+      out.push_back(&m_result);
+    }
+
+    return true;
+  }
 }
@@ -2,7 +2,7 @@
 #include <bcparse/emit/formatter.hpp>
 
 namespace bcparse {
-  Op_Cmp::Op_Cmp(const ObjLoc &left, const ObjLoc &right)
+  Op_Cmp::Op_Cmp(const ObjLoc &left, const Operand &right)
     : m_left(left),
       m_right(right) {
   }
@@ -12,9 +12,9 @@ namespace bcparse {
 
     // TODO: flags!!
 
-    bs->acceptInstruction(0x4);
+    bs->acceptInstruction(0x4, m_right.getFlags());
     bs->acceptObjLoc(m_left);
-    bs->acceptObjLoc(m_right);
+    bs->acceptOperand(m_right);
   }
 
   void Op_Cmp::debugPrint(BytecodeStream *bs, Formatter *f) {
@@ -26,4 +26,14 @@ namespace bcparse {
       + m_right.toString()
       + ")");
   }
+
+  bool Op_Cmp::getObjLocs(std::vector<ObjLoc*> &out) {
+    out.push_back(&m_left);
+
+    if (!m_right.isImmediate()) {
+      out.push_back(&m_right.getObjLoc());
+    }
+
+    return true;
+  }
 }
@@ -0,0 +1,57 @@
+#include <bcparse/emit/emit.hpp>
+#include <bcparse/emit/formatter.hpp>
+
+#include <sstream>
+
+namespace bcparse {
+  Op_CmpJmp::Op_CmpJmp(const ObjLoc &left,
+    const Operand &right,
+    const ObjLoc &target,
+    Op_Jmp::Flags flags)
+    : m_left(left),
+      m_right(right),
+      m_target(target),
+      m_flags(flags) {
+  }
+
+  void Op_CmpJmp::accept(BytecodeStream *bs) {
+    Buildable::accept(bs);
+
+    // the flag bits hold the jump condition, so the
+    // immediate form is a separate opcode
+    bs->acceptInstruction(m_right.isImmediate() ? 0x17 : 0x16, (uint8_t)m_flags);
+    bs->acceptSite(m_site.id, m_site.inverted);
+    bs->acceptObjLoc(m_left);
+    bs->acceptOperand(m_right);
+    bs->acceptObjLoc(m_target);
+  }
+
+  void Op_CmpJmp::debugPrint(BytecodeStream *bs, Formatter *f) {
+    Buildable::debugPrint(bs, f);
+
+    std::stringstream ss;
+    ss << "Op_CmpJmp("
+       << m_left.toString()
+       << ", "
+       << m_right.toString()
+       << ", "
+       << m_target.toString()
+       << ", "
+       << (uint32_t)m_flags
+       << ")";
+
+    f->append(ss.str());
+  }
+
+  bool Op_CmpJmp::getObjLocs(std::vector<ObjLoc*> &out) {
+    out.push_back(&m_left);
+
+    if (!m_right.isImmediate()) {
+      out.push_back(&m_right.getObjLoc());
+    }
+
+    out.push_back(&m_target);
+
+    return true;
+  }
+}
@@ -0,0 +1,36 @@
+#include <bcparse/emit/emit.hpp>
+#include <bcparse/emit/formatter.hpp>
+
+#include <sstream>
+
+namespace bcparse {
+  Op_Const::Op_Const(size_t index, const Value &value)
+    : m_index(index),
+      m_value(value) {
+  }
+
+  void Op_Const::accept(BytecodeStream *bs) {
+    Buildable::accept(bs);
+
+    bs->acceptInstruction(0x18);
+    bs->acceptUint((uint64_t)m_value.getSize());
+    bs->acceptRaw(m_value.getBytes(), m_value.getSize());
+  }
+
+  void Op_Const::debugPrint(BytecodeStream *bs, Formatter *f) {
+    Buildable::debugPrint(bs, f);
+
+    std::stringstream ss;
+    ss << "Op_Const(#";
+    ss << m_index;
+    ss << ", ";
+    ss << m_value.toString();
+    ss << ")";
+
+    f->append(ss.str());
+  }
+
+  bool Op_Const::getObjLocs(std::vector<ObjLoc*> &out) {
+    return true;
+  }
+}
@@ -3,7 +3,7 @@
 
 namespace bcparse {
   Op_Div::Op_Div(const ObjLoc &left,
-    const ObjLoc &right,
+    const Operand &right,
     Op_Cmp::Flags flags)
     : m_left(left),
       m_right(right),
@@ -13,9 +13,9 @@ namespace bcparse {
   void Op_Div::accept(BytecodeStream *bs) {
     Buildable::accept(bs);
 
-    bs->acceptInstruction(0xB, (uint8_t)m_flags);
+    bs->acceptInstruction(0xB, (uint8_t)m_flags | m_right.getFlags());
     bs->acceptObjLoc(m_left);
-    bs->acceptObjLoc(m_right);
+    bs->acceptOperand(m_right, ((uint8_t)m_flags & (uint8_t)Op_Cmp::Flags::FloatRight) != 0);
   }
 
   void Op_Div::debugPrint(BytecodeStream *bs, Formatter *f) {
@@ -27,4 +27,14 @@ namespace bcparse {
       + m_right.toString()
       + ")");
   }
+
+  bool Op_Div::getObjLocs(std::vector<ObjLoc*> &out) {
+    out.push_back(&m_left);
+
+    if (!m_right.isImmediate()) {
+      out.push_back(&m_right.getObjLoc());
+    }
+
+    return true;
+  }
 }
@@ -0,0 +1,31 @@
+#include <bcparse/emit/emit.hpp>
+#include <bcparse/emit/formatter.hpp>
+
+namespace bcparse {
+  Op_FCall::Op_FCall(const ObjLoc &target, InlineHint hint)
+    : m_target(target),
+      m_hint(hint) {
+  }
+
+  void Op_FCall::accept(BytecodeStream *bs) {
+    Buildable::accept(bs);
+
+    bs->acceptInstruction(0x1C);
+    bs->acceptSite(m_site.id, m_site.inverted);
+    bs->acceptObjLoc(m_target);
+  }
+
+  void Op_FCall::debugPrint(BytecodeStream *bs, Formatter *f) {
+    Buildable::debugPrint(bs, f);
+
+    f->append(std::string("Op_FCall(")
+      + m_target.toString()
+      + ")");
+  }
+
+  bool Op_FCall::getObjLocs(std::vector<ObjLoc*> &out) {
+    out.push_back(&m_target);
+
+    return true;
+  }
+}
@@ -16,4 +16,8 @@ namespace bcparse {
 
     f->append("Op_Halt()");
   }
+
+  bool Op_Halt::getObjLocs(std::vector<ObjLoc*> &out) {
+    return true;
+  }
 }
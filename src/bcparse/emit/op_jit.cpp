@@ -0,0 +1,58 @@
+#include <bcparse/emit/emit.hpp>
+#include <bcparse/emit/formatter.hpp>
+
+#include <sstream>
+
+namespace bcparse {
+  Op_Jit::Op_Jit(Flags flags)
+    : m_flags(flags),
+      m_memoArgs(0) {
+  }
+
+  Op_Jit::Op_Jit(Flags flags, const ObjLoc &objLoc, uint8_t memoArgs)
+    : m_flags(flags),
+      m_objLoc(objLoc),
+      m_memoArgs(memoArgs) {
+  }
+
+  void Op_Jit::accept(BytecodeStream *bs) {
+    Buildable::accept(bs);
+
+    if (m_memoArgs != 0) {
+      bs->acceptInstruction(0x1E, (uint8_t)m_flags | 0x4);
+      bs->acceptUint(m_memoArgs);
+    } else {
+      bs->acceptInstruction(0x1E, (uint8_t)m_flags);
+    }
+
+    if (m_flags == Flags::Begin) {
+      bs->acceptObjLoc(m_objLoc);
+    }
+  }
+
+  void Op_Jit::debugPrint(BytecodeStream *bs, Formatter *f) {
+    Buildable::debugPrint(bs, f);
+
+    std::stringstream ss;
+    ss << "Op_Jit("
+       << (uint32_t)m_flags;
+
+    if (m_flags == Flags::Begin) {
+      ss << ", " << m_objLoc.toString();
+    }
+
+    if (m_memoArgs != 0) {
+      ss << ", memoize " << (uint32_t)m_memoArgs;
+    }
+
+    ss << ")";
+
+    f->append(ss.str());
+  }
+
+  bool Op_Jit::getObjLocs(std::vector<ObjLoc*> &out) {
+    out.push_back(&m_objLoc);
+
+    return true;
+  }
+}
@@ -13,6 +13,7 @@ namespace bcparse {
     Buildable::accept(bs);
 
     bs->acceptInstruction(0x5, (uint8_t)m_flags);
+    bs->acceptSite(m_site.id, m_site.inverted);
     bs->acceptObjLoc(m_objLoc);
   }
 
@@ -28,4 +29,10 @@ namespace bcparse {
 
     f->append(ss.str());
   }
+
+  bool Op_Jmp::getObjLocs(std::vector<ObjLoc*> &out) {
+    out.push_back(&m_objLoc);
+
+    return true;
+  }
 }
@@ -0,0 +1,29 @@
+#include <bcparse/emit/emit.hpp>
+#include <bcparse/emit/formatter.hpp>
+
+namespace bcparse {
+  Op_Join::Op_Join(const ObjLoc &objLoc)
+    : m_objLoc(objLoc) {
+  }
+
+  void Op_Join::accept(BytecodeStream *bs) {
+    Buildable::accept(bs);
+
+    bs->acceptInstruction(0x1B);
+    bs->acceptObjLoc(m_objLoc);
+  }
+
+  void Op_Join::debugPrint(BytecodeStream *bs, Formatter *f) {
+    Buildable::debugPrint(bs, f);
+
+    f->append(std::string("Op_Join(")
+      + m_objLoc.toString()
+      + ")");
+  }
+
+  bool Op_Join::getObjLocs(std::vector<ObjLoc*> &out) {
+    out.push_back(&m_objLoc);
+
+    return true;
+  }
+}
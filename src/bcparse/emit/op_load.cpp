@@ -1,34 +1,67 @@
 #include <bcparse/emit/emit.hpp>
 #include <bcparse/emit/formatter.hpp>
 
+#include <sstream>
+#include <limits>
+
 namespace bcparse {
+  const size_t Op_Load::noPoolIndex = std::numeric_limits<size_t>::max();
+
   Op_Load::Op_Load(const ObjLoc &objLoc, const Value &value)
     : m_objLoc(objLoc),
+      m_poolIndex(noPoolIndex),
+      m_value(value) {
+  }
+
+  Op_Load::Op_Load(const ObjLoc &objLoc, size_t poolIndex, const Value &value)
+    : m_objLoc(objLoc),
+      m_poolIndex(poolIndex),
       m_value(value) {
   }
 
   void Op_Load::accept(BytecodeStream *bs) {
     Buildable::accept(bs);
 
+    if (m_poolIndex != noPoolIndex) {
+      bs->acceptInstruction(0x1, 0x6);
+      bs->acceptObjLoc(m_objLoc);
+      bs->acceptPoolIndex(m_poolIndex);
+
+      return;
+    }
+
     bs->acceptInstruction(0x1, (uint8_t)m_value.getValueType());
     bs->acceptObjLoc(m_objLoc);
 
     if (m_value.getValueType() == Value::ValueType::ValueTypeRawData) {
-      bs->acceptBytes((uint64_t)m_value.getRawBytes().size());
-    }
-
-    for (uint8_t u8 : m_value.getRawBytes()) {
-      bs->acceptBytes(u8);
+      bs->acceptUint((uint64_t)m_value.getSize());
+      bs->acceptRaw(m_value.getBytes(), m_value.getSize());
+    } else {
+      bs->acceptImmediate(m_value, m_value.getValueType() == Value::ValueType::ValueTypeF64);
     }
   }
 
   void Op_Load::debugPrint(BytecodeStream *bs, Formatter *f) {
     Buildable::debugPrint(bs, f);
 
-    f->append(std::string("Op_Load(")
-      + m_objLoc.toString()
-      + ", "
-      + m_value.toString()
-      + ")");
+    std::stringstream ss;
+    ss << "Op_Load(";
+    ss << m_objLoc.toString();
+    ss << ", ";
+
+    if (m_poolIndex != noPoolIndex) {
+      ss << "#" << m_poolIndex << " ";
+    }
+
+    ss << m_value.toString();
+    ss << ")";
+
+    f->append(ss.str());
+  }
+
+  bool Op_Load::getObjLocs(std::vector<ObjLoc*> &out) {
+    out.push_back(&m_objLoc);
+
+    return true;
   }
 }
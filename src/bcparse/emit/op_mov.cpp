@@ -24,4 +24,12 @@ namespace bcparse {
       + m_right.toString()
       + ")");
   }
+
+  bool Op_Mov::getObjLocs(std::vector<ObjLoc*> &out) {
+    out.push_back(&m_left);
+
+    out.push_back(&m_right);
+
+    return true;
+  }
 }
@@ -16,4 +16,8 @@ namespace bcparse {
 
     f->append("Op_NoOp()");
   }
+
+  bool Op_NoOp::getObjLocs(std::vector<ObjLoc*> &out) {
+    return true;
+  }
 }
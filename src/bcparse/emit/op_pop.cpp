@@ -14,7 +14,7 @@ namespace bcparse {
     bs->acceptInstruction(0x7);
 
     // TODO: assert m_amt can fit in uint16_t
-    bs->acceptBytes((uint16_t)m_amt);
+    bs->acceptUint((uint16_t)m_amt);
   }
 
   void Op_Pop::debugPrint(BytecodeStream *bs, Formatter *f) {
@@ -27,4 +27,8 @@ namespace bcparse {
 
     f->append(ss.str());
   }
+
+  bool Op_Pop::getObjLocs(std::vector<ObjLoc*> &out) {
+    return true;
+  }
 }
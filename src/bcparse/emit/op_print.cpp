@@ -20,4 +20,10 @@ namespace bcparse {
       + m_objLoc.toString()
       + ")");
   }
+
+  bool Op_Print::getObjLocs(std::vector<ObjLoc*> &out) {
+    out.push_back(&m_objLoc);
+
+    return true;
+  }
 }
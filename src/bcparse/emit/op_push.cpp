@@ -3,13 +3,19 @@
 
 namespace bcparse {
   Op_Push::Op_Push(const ObjLoc &arg)
-    : m_arg(arg) {
+    : m_arg(arg),
+      m_take(false) {
   }
 
   void Op_Push::accept(BytecodeStream *bs) {
     Buildable::accept(bs);
 
-    bs->acceptInstruction(0x6, (uint8_t)Value::ValueType::ValueTypeNone);
+    if (m_take) {
+      bs->acceptInstruction(0x3, 0x1); // TAKE_FLAGS_PUSH
+    } else {
+      bs->acceptInstruction(0x6, (uint8_t)Value::ValueType::ValueTypeNone);
+    }
+
     bs->acceptObjLoc(m_arg);
   }
 
@@ -18,6 +24,12 @@ namespace bcparse {
 
     f->append(std::string("Op_Push(")
       + m_arg.toString()
-      + ")");
+      + (m_take ? ", take)" : ")"));
+  }
+
+  bool Op_Push::getObjLocs(std::vector<ObjLoc*> &out) {
+    out.push_back(&m_arg);
+
+    return true;
   }
 }
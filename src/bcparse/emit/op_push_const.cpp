@@ -1,30 +1,56 @@
 #include <bcparse/emit/emit.hpp>
 #include <bcparse/emit/formatter.hpp>
 
+#include <sstream>
+
 namespace bcparse {
   Op_PushConst::Op_PushConst(const Value &arg)
-    : m_arg(arg) {
+    : m_poolIndex(Op_Load::noPoolIndex),
+      m_arg(arg) {
+  }
+
+  Op_PushConst::Op_PushConst(size_t poolIndex, const Value &arg)
+    : m_poolIndex(poolIndex),
+      m_arg(arg) {
   }
 
   void Op_PushConst::accept(BytecodeStream *bs) {
     Buildable::accept(bs);
 
-    bs->acceptInstruction(0x6, (uint8_t)m_arg.getValueType());
+    if (m_poolIndex != Op_Load::noPoolIndex) {
+      bs->acceptInstruction(0x6, 0x6);
+      bs->acceptPoolIndex(m_poolIndex);
 
-    if (m_arg.getValueType() == Value::ValueType::ValueTypeRawData) {
-      bs->acceptBytes((uint64_t)m_arg.getRawBytes().size());
+      return;
     }
 
-    for (uint8_t u8 : m_arg.getRawBytes()) {
-      bs->acceptBytes(u8);
+    bs->acceptInstruction(0x6, (uint8_t)m_arg.getValueType());
+
+    if (m_arg.getValueType() == Value::ValueType::ValueTypeRawData) {
+      bs->acceptUint((uint64_t)m_arg.getSize());
+      bs->acceptRaw(m_arg.getBytes(), m_arg.getSize());
+    } else {
+      bs->acceptImmediate(m_arg, m_arg.getValueType() == Value::ValueType::ValueTypeF64);
     }
   }
 
   void Op_PushConst::debugPrint(BytecodeStream *bs, Formatter *f) {
     Buildable::debugPrint(bs, f);
 
-    f->append(std::string("Op_PushConst(")
-      + m_arg.toString()
-      + ")");
+    std::stringstream ss;
+    ss << "Op_PushConst(";
+
+    if (m_poolIndex != Op_Load::noPoolIndex) {
+      ss << "#" << m_poolIndex << " ";
+    }
+
+    ss << m_arg.toString();
+    ss << ")";
+
+    f->append(ss.str());
+  }
+
+  bool Op_PushConst::getObjLocs(std::vector<ObjLoc*> &out) {
+    return true;
   }
 }
@@ -0,0 +1,33 @@
+#include <bcparse/emit/emit.hpp>
+#include <bcparse/emit/formatter.hpp>
+
+#include <sstream>
+
+namespace bcparse {
+  Op_Ret::Op_Ret(size_t numArgs, InlineHint hint)
+    : m_numArgs(numArgs),
+      m_hint(hint) {
+  }
+
+  void Op_Ret::accept(BytecodeStream *bs) {
+    Buildable::accept(bs);
+
+    bs->acceptInstruction(0x1D);
+    bs->acceptUint((uint16_t)m_numArgs);
+  }
+
+  void Op_Ret::debugPrint(BytecodeStream *bs, Formatter *f) {
+    Buildable::debugPrint(bs, f);
+
+    std::stringstream ss;
+    ss << "Op_Ret(";
+    ss << m_numArgs;
+    ss << ")";
+
+    f->append(ss.str());
+  }
+
+  bool Op_Ret::getObjLocs(std::vector<ObjLoc*> &out) {
+    return true;
+  }
+}
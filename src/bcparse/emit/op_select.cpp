@@ -0,0 +1,49 @@
+#include <bcparse/emit/emit.hpp>
+#include <bcparse/emit/formatter.hpp>
+
+#include <sstream>
+
+namespace bcparse {
+  Op_Select::Op_Select(const ObjLoc &dst, const ObjLoc &a, const ObjLoc &b, Op_Jmp::Flags flags)
+    : m_dst(dst),
+      m_a(a),
+      m_b(b),
+      m_flags(flags) {
+  }
+
+  void Op_Select::accept(BytecodeStream *bs) {
+    Buildable::accept(bs);
+
+    // mov with MOV_FLAGS_SELECT, then the condition
+    bs->acceptInstruction(0x2, 0x2);
+    bs->acceptBytes((uint8_t)m_flags);
+    bs->acceptObjLoc(m_dst);
+    bs->acceptObjLoc(m_a);
+    bs->acceptObjLoc(m_b);
+  }
+
+  void Op_Select::debugPrint(BytecodeStream *bs, Formatter *f) {
+    Buildable::debugPrint(bs, f);
+
+    std::stringstream ss;
+    ss << "Op_Select("
+       << m_dst.toString()
+       << ", "
+       << m_a.toString()
+       << ", "
+       << m_b.toString()
+       << ", "
+       << (uint32_t)m_flags
+       << ")";
+
+    f->append(ss.str());
+  }
+
+  bool Op_Select::getObjLocs(std::vector<ObjLoc*> &out) {
+    out.push_back(&m_dst);
+    out.push_back(&m_a);
+    out.push_back(&m_b);
+
+    return true;
+  }
+}
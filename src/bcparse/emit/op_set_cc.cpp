@@ -0,0 +1,41 @@
+#include <bcparse/emit/emit.hpp>
+#include <bcparse/emit/formatter.hpp>
+
+#include <sstream>
+
+namespace bcparse {
+  Op_SetCc::Op_SetCc(const ObjLoc &dst, Op_Jmp::Flags flags, bool negated)
+    : m_dst(dst),
+      m_flags(flags),
+      m_negated(negated) {
+  }
+
+  void Op_SetCc::accept(BytecodeStream *bs) {
+    Buildable::accept(bs);
+
+    // mov, MOV_FLAGS_SET and MOV_FLAGS_NOT, then the condition
+    bs->acceptInstruction(0x2, m_negated ? 0x5 : 0x1);
+    bs->acceptBytes((uint8_t)m_flags);
+    bs->acceptObjLoc(m_dst);
+  }
+
+  void Op_SetCc::debugPrint(BytecodeStream *bs, Formatter *f) {
+    Buildable::debugPrint(bs, f);
+
+    std::stringstream ss;
+    ss << "Op_SetCc("
+       << m_dst.toString()
+       << ", "
+       << (m_negated ? "!" : "")
+       << (uint32_t)m_flags
+       << ")";
+
+    f->append(ss.str());
+  }
+
+  bool Op_SetCc::getObjLocs(std::vector<ObjLoc*> &out) {
+    out.push_back(&m_dst);
+
+    return true;
+  }
+}
@@ -2,7 +2,7 @@
 #include <bcparse/emit/formatter.hpp>
 
 namespace bcparse {
-  Op_Shl::Op_Shl(const ObjLoc &left, const ObjLoc &right)
+  Op_Shl::Op_Shl(const ObjLoc &left, const Operand &right)
     : m_left(left),
       m_right(right) {
   }
@@ -10,9 +10,9 @@ namespace bcparse {
   void Op_Shl::accept(BytecodeStream *bs) {
     Buildable::accept(bs);
 
-    bs->acceptInstruction(0x10);
+    bs->acceptInstruction(0x10, m_right.getFlags());
     bs->acceptObjLoc(m_left);
-    bs->acceptObjLoc(m_right);
+    bs->acceptOperand(m_right);
   }
 
   void Op_Shl::debugPrint(BytecodeStream *bs, Formatter *f) {
@@ -24,4 +24,14 @@ namespace bcparse {
       + m_right.toString()
       + ")");
   }
+
+  bool Op_Shl::getObjLocs(std::vector<ObjLoc*> &out) {
+    out.push_back(&m_left);
+
+    if (!m_right.isImmediate()) {
+      out.push_back(&m_right.getObjLoc());
+    }
+
+    return true;
+  }
 }
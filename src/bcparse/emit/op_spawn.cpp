@@ -0,0 +1,35 @@
+#include <bcparse/emit/emit.hpp>
+#include <bcparse/emit/formatter.hpp>
+
+namespace bcparse {
+  Op_Spawn::Op_Spawn(const ObjLoc &dst, const ObjLoc &target)
+    : m_dst(dst),
+      m_target(target) {
+  }
+
+  void Op_Spawn::accept(BytecodeStream *bs) {
+    Buildable::accept(bs);
+
+    bs->acceptInstruction(0x19);
+    bs->acceptObjLoc(m_dst);
+    bs->acceptObjLoc(m_target);
+  }
+
+  void Op_Spawn::debugPrint(BytecodeStream *bs, Formatter *f) {
+    Buildable::debugPrint(bs, f);
+
+    f->append(std::string("Op_Spawn(")
+      + m_dst.toString()
+      + ", "
+      + m_target.toString()
+      + ")");
+  }
+
+  bool Op_Spawn::getObjLocs(std::vector<ObjLoc*> &out) {
+    out.push_back(&m_dst);
+
+    out.push_back(&m_target);
+
+    return true;
+  }
+}
@@ -0,0 +1,60 @@
+#include <bcparse/emit/emit.hpp>
+#include <bcparse/emit/formatter.hpp>
+
+#include <sstream>
+
+namespace bcparse {
+  Op_Switch::Op_Switch(const ObjLoc &src, int64_t low, const std::vector<ObjLoc> &cases, const ObjLoc &def)
+    : m_src(src),
+      m_low(low),
+      m_cases(cases),
+      m_default(def) {
+  }
+
+  void Op_Switch::accept(BytecodeStream *bs) {
+    Buildable::accept(bs);
+
+    // jmp with JUMP_FLAGS_TABLE, the default as its target, then the
+    // cases. those are always direct, so there is nothing to relocate.
+    bs->acceptInstruction(0x5, 0x5);
+    bs->acceptObjLoc(m_src);
+    bs->acceptImmediate(Value(m_low), false);
+    bs->acceptUint((uint16_t)m_cases.size());
+    bs->acceptObjLoc(m_default);
+
+    for (const ObjLoc &loc : m_cases) {
+      bs->acceptCodeLabel(loc.getLocation());
+    }
+  }
+
+  void Op_Switch::debugPrint(BytecodeStream *bs, Formatter *f) {
+    Buildable::debugPrint(bs, f);
+
+    std::stringstream ss;
+    ss << "Op_Switch("
+       << m_src.toString()
+       << ", "
+       << m_low
+       << ", "
+       << m_default.toString();
+
+    for (const ObjLoc &loc : m_cases) {
+      ss << ", " << loc.toString();
+    }
+
+    ss << ")";
+
+    f->append(ss.str());
+  }
+
+  bool Op_Switch::getObjLocs(std::vector<ObjLoc*> &out) {
+    out.push_back(&m_src);
+    out.push_back(&m_default);
+
+    for (ObjLoc &loc : m_cases) {
+      out.push_back(&loc);
+    }
+
+    return true;
+  }
+}
@@ -0,0 +1,23 @@
+#include <bcparse/emit/emit.hpp>
+#include <bcparse/emit/formatter.hpp>
+
+namespace bcparse {
+  Op_Yield::Op_Yield() {
+  }
+
+  void Op_Yield::accept(BytecodeStream *bs) {
+    Buildable::accept(bs);
+
+    bs->acceptInstruction(0x1A);
+  }
+
+  void Op_Yield::debugPrint(BytecodeStream *bs, Formatter *f) {
+    Buildable::debugPrint(bs, f);
+
+    f->append("Op_Yield()");
+  }
+
+  bool Op_Yield::getObjLocs(std::vector<ObjLoc*> &out) {
+    return true;
+  }
+}
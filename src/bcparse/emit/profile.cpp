@@ -0,0 +1,54 @@
+#include <bcparse/emit/profile.hpp>
+
+#include <shared/bin_format.h>
+
+#include <fstream>
+#include <sstream>
+
+namespace bcparse {
+  bool Profile::read(const std::string &path, std::string &error) {
+    std::ifstream in(path);
+    std::string line;
+
+    if (!in.is_open()) {
+      error = "Could not read profile: " + path;
+      return false;
+    }
+
+    if (!std::getline(in, line) || line != PROFILE_HEADER) {
+      error = "Not a profile: " + path;
+      return false;
+    }
+
+    while (std::getline(in, line)) {
+      std::istringstream ss(line);
+      uint32_t id;
+      Counts counts;
+
+      if (line.empty()) {
+        continue;
+      }
+
+      if (!(ss >> id >> counts.count >> counts.taken) || counts.taken > counts.count) {
+        error = "Malformed profile line in " + path + ": " + line;
+        return false;
+      }
+
+      m_counts[id] = counts;
+    }
+
+    return true;
+  }
+
+  void Profile::apply(Site &site) const {
+    auto it = m_counts.find(site.id);
+
+    site.profiled = true;
+    site.count = it != m_counts.end() ? it->second.count : 0;
+    site.taken = it != m_counts.end() ? it->second.taken : 0;
+
+    if (site.inverted) {
+      site.taken = site.count - site.taken;
+    }
+  }
+}
@@ -0,0 +1,336 @@
+#include <bcparse/emit/register_allocator.hpp>
+#include <bcparse/emit/bytecode_chunk.hpp>
+#include <bcparse/emit/data_storage.hpp>
+#include <bcparse/emit/emit.hpp>
+
+#include <common/my_assert.hpp>
+
+#include <map>
+#include <algorithm>
+
+namespace bcparse {
+  RegisterAllocator::RegisterAllocator(BytecodeChunk *chunk)
+    : m_chunk(chunk),
+      m_dataStorage(nullptr),
+      m_known(true) {
+    std::fill(m_registerUsed, m_registerUsed + RegisterUsage::numRegisters, false);
+  }
+
+  void RegisterAllocator::allocate() {
+    collect();
+
+    if (m_temporaries.empty()) {
+      return;
+    }
+
+    if (m_known) {
+      buildSuccessors();
+      computeLiveness();
+    }
+
+    buildInterference();
+    assign();
+  }
+
+  void RegisterAllocator::collect() {
+    std::vector<std::unique_ptr<Buildable>*> leaves;
+    m_chunk->collectLeaves(leaves);
+
+    std::map<int, size_t> indices; // $t[] number to index in m_temporaries
+
+    for (auto leaf : leaves) {
+      Buildable *b = leaf->get();
+
+      if (auto asDataStorage = dynamic_cast<DataStorage*>(b)) {
+        m_dataStorage = asDataStorage;
+        continue;
+      }
+
+      m_code.push_back(b);
+      m_objLocs.emplace_back();
+
+      if (!b->getObjLocs(m_objLocs.back())) {
+        m_known = false;
+      }
+
+      for (const ObjLoc *loc : m_objLocs.back()) {
+        if (loc->getDataStoreLocation() == ObjLoc::DataStoreLocation::RegisterDataStore &&
+            loc->getLocation() >= 0 && loc->getLocation() < RegisterUsage::numRegisters) {
+          m_registerUsed[loc->getLocation()] = true;
+        } else if (loc->getDataStoreLocation() == ObjLoc::DataStoreLocation::VirtualRegister &&
+            indices.find(loc->getLocation()) == indices.end()) {
+          indices[loc->getLocation()] = m_temporaries.size();
+          m_temporaries.push_back(loc->getLocation());
+        }
+      }
+    }
+
+    const size_t words = (m_temporaries.size() + 63) / 64;
+
+    m_defs.assign(m_code.size(), -1);
+    m_uses.assign(m_code.size(), Set(words, 0));
+
+    for (size_t i = 0; i < m_code.size(); i++) {
+      Buildable *b = m_code[i];
+      const std::vector<ObjLoc*> &objLocs = m_objLocs[i];
+
+      // the first operand of these is written without being read
+      const bool writesFirst = dynamic_cast<Op_Load*>(b) != nullptr ||
+        dynamic_cast<Op_Mov*>(b) != nullptr ||
+        dynamic_cast<Op_Spawn*>(b) != nullptr;
+
+      for (size_t j = 0; j < objLocs.size(); j++) {
+        if (objLocs[j]->getDataStoreLocation() != ObjLoc::DataStoreLocation::VirtualRegister) {
+          continue;
+        }
+
+        const size_t t = indices[objLocs[j]->getLocation()];
+
+        if (j == 0 && writesFirst) {
+          m_defs[i] = (int)t;
+        } else {
+          add(m_uses[i], t);
+        }
+      }
+    }
+  }
+
+  void RegisterAllocator::buildSuccessors() {
+    std::map<size_t, size_t> labels; // id to index in m_code
+    std::vector<size_t> addressTaken;
+    std::vector<size_t> afterCalls;
+
+    for (size_t i = 0; i < m_code.size(); i++) {
+      if (auto asLabel = dynamic_cast<LabelMarker*>(m_code[i])) {
+        labels[asLabel->getLabelId()] = i;
+      }
+    }
+
+    auto labelAt = [&](const ObjLoc *loc) -> int {
+      if (loc->getDataStoreLocation() != ObjLoc::DataStoreLocation::StaticDataStore) {
+        return -1;
+      }
+
+      auto it = labels.find(loc->getLocation());
+
+      return it == labels.end() ? -1 : (int)it->second;
+    };
+
+    // the operand a jump, call or spawn goes to, which does not take the
+    // label's address
+    auto targetOf = [&](size_t i) -> ObjLoc* {
+      Buildable *b = m_code[i];
+      const std::vector<ObjLoc*> &objLocs = m_objLocs[i];
+
+      if (dynamic_cast<Op_Jmp*>(b) != nullptr || dynamic_cast<Op_Call*>(b) != nullptr ||
+          dynamic_cast<Op_FCall*>(b) != nullptr) {
+        return objLocs[0];
+      }
+
+      if (dynamic_cast<Op_Spawn*>(b) != nullptr || dynamic_cast<Op_CmpJmp*>(b) != nullptr) {
+        return objLocs.back();
+      }
+
+      return nullptr;
+    };
+
+    for (size_t i = 0; i < m_code.size(); i++) {
+      const ObjLoc *target = targetOf(i);
+
+      for (const ObjLoc *loc : m_objLocs[i]) {
+        const int label = labelAt(loc);
+
+        if (label != -1 && loc != target) {
+          addressTaken.push_back(label);
+        }
+      }
+
+      if ((dynamic_cast<Op_Call*>(m_code[i]) != nullptr || dynamic_cast<Op_FCall*>(m_code[i]) != nullptr) &&
+          i + 1 < m_code.size()) {
+        afterCalls.push_back(i + 1);
+      }
+    }
+
+    std::sort(addressTaken.begin(), addressTaken.end());
+    addressTaken.erase(std::unique(addressTaken.begin(), addressTaken.end()), addressTaken.end());
+
+    m_successors.assign(m_code.size(), std::vector<size_t>());
+
+    for (size_t i = 0; i < m_code.size(); i++) {
+      Buildable *b = m_code[i];
+      std::vector<size_t> &successors = m_successors[i];
+      bool fallsThrough = true;
+
+      if (dynamic_cast<Op_Halt*>(b) != nullptr || dynamic_cast<Op_Ret*>(b) != nullptr) {
+        // returns from whatever called it
+        successors = afterCalls;
+        fallsThrough = false;
+      } else if (const ObjLoc *target = targetOf(i)) {
+        const int label = labelAt(target);
+
+        if (label != -1) {
+          successors.push_back(label);
+        } else {
+          successors.insert(successors.end(), addressTaken.begin(), addressTaken.end());
+        }
+
+        auto asJmp = dynamic_cast<Op_Jmp*>(b);
+        fallsThrough = asJmp == nullptr || asJmp->getFlags() != Op_Jmp::Flags::None;
+      }
+
+      if (fallsThrough && i + 1 < m_code.size()) {
+        successors.push_back(i + 1);
+      }
+    }
+  }
+
+  void RegisterAllocator::computeLiveness() {
+    const size_t words = (m_temporaries.size() + 63) / 64;
+
+    std::vector<Set> liveIn(m_code.size(), Set(words, 0));
+    m_liveOut.assign(m_code.size(), Set(words, 0));
+
+    bool changed = true;
+
+    while (changed) {
+      changed = false;
+
+      for (size_t i = m_code.size(); i-- > 0;) {
+        Set &out = m_liveOut[i];
+
+        for (size_t s : m_successors[i]) {
+          for (size_t w = 0; w < words; w++) {
+            out[w] |= liveIn[s][w];
+          }
+        }
+
+        for (size_t w = 0; w < words; w++) {
+          uint64_t in = out[w];
+
+          if (m_defs[i] != -1 && (size_t)m_defs[i] / 64 == w) {
+            in &= ~((uint64_t)1 << (m_defs[i] % 64));
+          }
+
+          in |= m_uses[i][w];
+
+          if (in != liveIn[i][w]) {
+            liveIn[i][w] = in;
+            changed = true;
+          }
+        }
+      }
+    }
+
+    m_liveIn0 = m_code.empty() ? Set(words, 0) : liveIn[0];
+  }
+
+  void RegisterAllocator::buildInterference() {
+    const size_t count = m_temporaries.size();
+    const size_t words = (count + 63) / 64;
+
+    m_interference.assign(count, Set(words, 0));
+
+    auto interfere = [&](size_t a, size_t b) {
+      if (a != b) {
+        add(m_interference[a], b);
+        add(m_interference[b], a);
+      }
+    };
+
+    if (!m_known) {
+      // nothing to tell where they are live: none shares
+      for (size_t a = 0; a < count; a++) {
+        for (size_t b = a + 1; b < count; b++) {
+          interfere(a, b);
+        }
+      }
+
+      return;
+    }
+
+    for (size_t i = 0; i < m_code.size(); i++) {
+      if (m_defs[i] == -1) {
+        continue;
+      }
+
+      for (size_t t = 0; t < count; t++) {
+        if (has(m_liveOut[i], t)) {
+          interfere(m_defs[i], t);
+        }
+      }
+    }
+
+    // read before anything writes them
+    for (size_t a = 0; a < count; a++) {
+      for (size_t b = a + 1; b < count; b++) {
+        if (has(m_liveIn0, a) && has(m_liveIn0, b)) {
+          interfere(a, b);
+        }
+      }
+    }
+  }
+
+  void RegisterAllocator::assign() {
+    const size_t count = m_temporaries.size();
+
+    std::vector<ObjLoc> assigned(count);
+    std::vector<bool> done(count, false);
+    std::vector<int> spillSlots;
+
+    for (size_t t = 0; t < count; t++) {
+      std::vector<bool> taken(RegisterUsage::numRegisters, false);
+      std::vector<int> takenSlots;
+
+      for (size_t other = 0; other < count; other++) {
+        if (!done[other] || !has(m_interference[t], other)) {
+          continue;
+        }
+
+        if (assigned[other].getDataStoreLocation() == ObjLoc::DataStoreLocation::RegisterDataStore) {
+          taken[assigned[other].getLocation()] = true;
+        } else {
+          takenSlots.push_back(assigned[other].getLocation());
+        }
+      }
+
+      for (int r = 0; r < RegisterUsage::numRegisters; r++) {
+        if (!m_registerUsed[r] && !taken[r]) {
+          assigned[t] = ObjLoc(r, ObjLoc::DataStoreLocation::RegisterDataStore);
+          break;
+        }
+      }
+
+      if (assigned[t].getDataStoreLocation() != ObjLoc::DataStoreLocation::RegisterDataStore) {
+        for (int slot : spillSlots) {
+          if (std::find(takenSlots.begin(), takenSlots.end(), slot) == takenSlots.end()) {
+            assigned[t] = ObjLoc(slot, ObjLoc::DataStoreLocation::StaticDataStore);
+            break;
+          }
+        }
+      }
+
+      if (assigned[t].getDataStoreLocation() == ObjLoc::DataStoreLocation::NullDataStore) {
+        ASSERT_MSG(m_dataStorage != nullptr, "no static data to spill temporaries to");
+
+        spillSlots.push_back((int)m_dataStorage->addStaticData(Value(), false));
+        assigned[t] = ObjLoc(spillSlots.back(), ObjLoc::DataStoreLocation::StaticDataStore);
+      }
+
+      done[t] = true;
+    }
+
+    std::map<int, size_t> indices;
+
+    for (size_t t = 0; t < count; t++) {
+      indices[m_temporaries[t]] = t;
+    }
+
+    for (auto &objLocs : m_objLocs) {
+      for (ObjLoc *loc : objLocs) {
+        if (loc->getDataStoreLocation() == ObjLoc::DataStoreLocation::VirtualRegister) {
+          *loc = assigned[indices[loc->getLocation()]];
+        }
+      }
+    }
+  }
+}
@@ -0,0 +1,235 @@
+#include <bcparse/emit/size_report.hpp>
+#include <bcparse/emit/buildable.hpp>
+#include <bcparse/compile_stats.hpp>
+
+#include <iomanip>
+
+namespace bcparse {
+  // as vm/interpreter.h numbers them
+  static const char *const opcodeNames[32] = {
+    "noop", "load", "mov", "take", "cmp", "jmp", "push", "pop",
+    "add", "sub", "mul", "div", "mod", "xor", "and", "or",
+    "shl", "shr", "neg", "not", "call", "print", "cmpj", "cmpj.imm",
+    "const", "spawn", "yield", "join", "fcall", "ret", "jit", "halt"
+  };
+
+  static const char *const operandNames[SizeReport::NUM_OPERANDS] = {
+    "register", "local", "frame", "static", "vm", "jump", "immediate", "pool index", "count"
+  };
+
+  void SizeReport::instruction(uint8_t opcode, size_t offset) {
+    charge(offset);
+
+    m_opcode = opcode;
+    m_start = offset;
+    m_trace = m_current;
+  }
+
+  void SizeReport::finish(size_t codeSize) {
+    charge(codeSize);
+
+    m_opcode = -1;
+    m_start = codeSize;
+  }
+
+  void SizeReport::operand(Operand kind, size_t bytes) {
+    Tally &tally = m_operands[kind][bytes];
+
+    ++tally.count;
+    tally.bytes += bytes;
+  }
+
+  void SizeReport::trace(const SourceTrace *trace) {
+    m_current = trace;
+  }
+
+  void SizeReport::staticData(const std::string &type, size_t bytes) {
+    Tally &tally = m_staticData[type];
+
+    ++tally.count;
+    tally.bytes += bytes;
+  }
+
+  void SizeReport::label(size_t bytes) {
+    ++m_labels.count;
+    m_labels.bytes += bytes;
+  }
+
+  void SizeReport::section(const std::string &name, size_t bytes) {
+    m_sections.push_back({ name, bytes });
+  }
+
+  void SizeReport::charge(size_t end) {
+    if (m_opcode < 0 || end <= m_start) {
+      return;
+    }
+
+    const size_t bytes = end - m_start;
+    Tally &op = m_opcodes[(uint8_t)m_opcode];
+
+    ++op.count;
+    op.bytes += bytes;
+
+    if (m_trace == nullptr) {
+      Tally &file = m_files["(none)"];
+
+      ++file.count;
+      file.bytes += bytes;
+
+      return;
+    }
+
+    // the file of the statement itself; the directives of it and of each
+    // that expanded to it, each once
+    Tally &file = m_files[m_trace->location.getFileName()];
+
+    ++file.count;
+    file.bytes += bytes;
+
+    std::set<std::string> charged;
+
+    for (const SourceTrace *t = m_trace; t != nullptr; t = t->caller.get()) {
+      if (t->directive.empty() || !charged.insert(t->directive).second) {
+        continue;
+      }
+
+      Tally &directive = m_directives[t->directive];
+
+      if (m_invocations.insert(t).second) {
+        ++directive.count;
+      }
+
+      directive.bytes += bytes;
+    }
+  }
+
+  void SizeReport::write(std::ostream &os, bool json) const {
+    size_t codeBytes = 0;
+    size_t numInstructions = 0;
+
+    for (const auto &it : m_opcodes) {
+      codeBytes += it.second.bytes;
+      numInstructions += it.second.count;
+    }
+
+    auto percent = [codeBytes](size_t bytes) -> double {
+      return codeBytes != 0 ? 100.0 * (double)bytes / (double)codeBytes : 0.0;
+    };
+
+    const std::ios::fmtflags flags = os.flags();
+    const std::streamsize precision = os.precision();
+
+    os << std::fixed << std::setprecision(1);
+
+    if (json) {
+      auto tallies = [&os](const std::map<std::string, Tally> &map) {
+        os << "{";
+
+        for (auto it = map.begin(); it != map.end(); ++it) {
+          os << (it == map.begin() ? "" : ", ") << "\"" << CompileStats::jsonEscape(it->first)
+            << "\": {\"count\": " << it->second.count << ", \"bytes\": " << it->second.bytes << "}";
+        }
+
+        os << "}";
+      };
+
+      os << "{\"code_bytes\": " << codeBytes << ", \"instructions\": " << numInstructions << ", \"opcodes\": {";
+
+      for (auto it = m_opcodes.begin(); it != m_opcodes.end(); ++it) {
+        os << (it == m_opcodes.begin() ? "" : ", ") << "\"" << opcodeNames[it->first & 0x1F]
+          << "\": {\"count\": " << it->second.count << ", \"bytes\": " << it->second.bytes << "}";
+      }
+
+      os << "}, \"operands\": {";
+
+      for (int i = 0; i < NUM_OPERANDS; i++) {
+        os << (i == 0 ? "" : ", ") << "\"" << operandNames[i] << "\": {";
+
+        for (auto it = m_operands[i].begin(); it != m_operands[i].end(); ++it) {
+          os << (it == m_operands[i].begin() ? "" : ", ") << "\"" << it->first << "\": " << it->second.count;
+        }
+
+        os << "}";
+      }
+
+      os << "}, \"files\": ";
+      tallies(m_files);
+      os << ", \"directives\": ";
+      tallies(m_directives);
+      os << ", \"static_data\": ";
+      tallies(m_staticData);
+      os << ", \"labels\": {\"count\": " << m_labels.count << ", \"bytes\": " << m_labels.bytes << "}, \"sections\": {";
+
+      for (size_t i = 0; i < m_sections.size(); i++) {
+        os << (i == 0 ? "" : ", ") << "\"" << m_sections[i].first << "\": " << m_sections[i].second;
+      }
+
+      os << "}}\n";
+    } else {
+      auto row = [&os](const std::string &name, const Tally &tally, double share) {
+        os << "  " << std::left << std::setw(20) << name << std::right
+          << std::setw(8) << tally.count << std::setw(10) << tally.bytes;
+
+        if (share >= 0) {
+          os << std::setw(7) << share << "%";
+        }
+
+        os << "\n";
+      };
+
+      os << "code          " << std::setw(10) << codeBytes << " bytes, " << numInstructions << " instructions\n";
+
+      os << "opcodes                  count     bytes\n";
+
+      for (const auto &it : m_opcodes) {
+        row(opcodeNames[it.first & 0x1F], it.second, percent(it.second.bytes));
+      }
+
+      os << "operands                 count     bytes\n";
+
+      for (int i = 0; i < NUM_OPERANDS; i++) {
+        for (const auto &it : m_operands[i]) {
+          row(std::string(operandNames[i]) + " (" + std::to_string(it.first) + "B)", it.second, percent(it.second.bytes));
+        }
+      }
+
+      os << "code by file             count     bytes\n";
+
+      for (const auto &it : m_files) {
+        os << "  " << it.first << "\n";
+        row("", it.second, percent(it.second.bytes));
+      }
+
+      if (!m_directives.empty()) {
+        os << "code by directive        count     bytes  bytes/each\n";
+
+        for (const auto &it : m_directives) {
+          os << "  " << std::left << std::setw(20) << it.first << std::right
+            << std::setw(8) << it.second.count << std::setw(10) << it.second.bytes
+            << std::setw(12) << (it.second.count != 0 ? (double)it.second.bytes / (double)it.second.count : 0.0) << "\n";
+        }
+      }
+
+      if (!m_staticData.empty()) {
+        os << "static data              count     bytes\n";
+
+        for (const auto &it : m_staticData) {
+          row(it.first, it.second, -1);
+        }
+      }
+
+      os << "labels        " << std::setw(10) << m_labels.count << " entries, " << m_labels.bytes << " bytes\n";
+
+      if (!m_sections.empty()) {
+        os << "sections                 bytes\n";
+
+        for (const auto &it : m_sections) {
+          os << "  " << std::left << std::setw(20) << it.first << std::right << std::setw(8) << it.second << "\n";
+        }
+      }
+    }
+
+    os.flags(flags);
+    os.precision(precision);
+  }
+}
@@ -0,0 +1,47 @@
+#include <bcparse/emit/emit.hpp>
+#include <bcparse/emit/formatter.hpp>
+
+namespace bcparse {
+  SymbolMarker::SymbolMarker(size_t labelId, const std::string &name, bool exported)
+    : m_objLoc((int)labelId, ObjLoc::DataStoreLocation::StaticDataStore),
+      m_name(name),
+      m_exported(exported) {
+  }
+
+  void SymbolMarker::accept(BytecodeStream *bs) {
+    Buildable::accept(bs);
+
+    // a program keeps its exports, for a host embedding the vm to call
+    if (!bs->isRelocatable() && !(m_exported && bs->isSectioned())) {
+      return;
+    }
+
+    bin_symbol_t entry = { };
+    entry.slot = (uint32_t)m_objLoc.getLocation();
+    entry.flags = m_exported ? BIN_SYMBOL_EXPORT : 0;
+    entry.nameLength = (uint16_t)m_name.size();
+
+    if (m_exported) {
+      // placed by the sizing pass, wherever the label is
+      auto it = bs->getLabelAddressMap().find(m_objLoc.getLocation());
+
+      if (it != bs->getLabelAddressMap().end()) {
+        entry.offset = it->second;
+      }
+    }
+
+    std::vector<uint8_t> &symbols = bs->getSymbolSection();
+
+    symbols.insert(symbols.end(), (const uint8_t*)&entry, (const uint8_t*)&entry + sizeof(entry));
+    symbols.insert(symbols.end(), m_name.begin(), m_name.end());
+  }
+
+  void SymbolMarker::debugPrint(BytecodeStream *bs, Formatter *f) {
+  }
+
+  bool SymbolMarker::getObjLocs(std::vector<ObjLoc*> &out) {
+    out.push_back(&m_objLoc);
+
+    return true;
+  }
+}
@@ -0,0 +1,60 @@
+#include <bcparse/emit/emit.hpp>
+#include <bcparse/emit/formatter.hpp>
+
+#include <common/my_assert.hpp>
+
+#include <sstream>
+
+namespace bcparse {
+  TryMarker::TryMarker(Flags flags, size_t handlerId)
+    : m_flags(flags),
+      m_handler((int)handlerId, ObjLoc::DataStoreLocation::StaticDataStore) {
+  }
+
+  void TryMarker::accept(BytecodeStream *bs) {
+    Buildable::accept(bs);
+
+    if (!bs->isSectioned() || bs->isSizing()) {
+      return;
+    }
+
+    std::vector<uint64_t> &starts = bs->getTryStarts();
+
+    if (m_flags == Flags::Begin) {
+      starts.push_back(bs->streamOffset());
+      return;
+    }
+
+    ASSERT(!starts.empty());
+
+    // placed by the sizing pass, wherever the handler is
+    auto it = bs->getLabelAddressMap().find(m_handler.getLocation());
+    ASSERT_MSG(it != bs->getLabelAddressMap().end(), "handler of a try region was not sized");
+
+    // an inner region ends first, so comes first
+    bin_try_t entry = { };
+    entry.start = starts.back();
+    entry.end = bs->streamOffset();
+    entry.handler = it->second;
+
+    bs->getTrySection().push_back(entry);
+    starts.pop_back();
+  }
+
+  void TryMarker::debugPrint(BytecodeStream *bs, Formatter *f) {
+    Buildable::debugPrint(bs, f);
+
+    std::stringstream ss;
+    ss << (m_flags == Flags::Begin ? "TryBegin(" : "TryEnd(")
+       << m_handler.toString()
+       << ")";
+
+    f->append(ss.str());
+  }
+
+  bool TryMarker::getObjLocs(std::vector<ObjLoc*> &out) {
+    out.push_back(&m_handler);
+
+    return true;
+  }
+}
@@ -4,7 +4,6 @@ namespace bcparse {
   const Value Value::none() {
     Value v;
     v.m_valueType = ValueType::ValueTypeNone;
-    v.m_rawBytes.clear();
     return v;
   }
 }
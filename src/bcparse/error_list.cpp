@@ -1,4 +1,3 @@
-#include <unordered_set>
 #include <map>
 #include <fstream>
 
@@ -7,43 +6,93 @@
 #include <bcparse/error_list.hpp>
 
 namespace bcparse {
-  ErrorList::ErrorList() {
+  ErrorList::ErrorList()
+    : m_count(0),
+      m_numFatal(0),
+      m_maxFatal(0) {
   }
 
   ErrorList::ErrorList(const ErrorList &other)
-    : m_errors(other.m_errors) {
+    : m_errors(other.m_errors),
+      m_count(other.m_count),
+      m_numFatal(other.m_numFatal),
+      m_maxFatal(other.m_maxFatal) {
   }
 
-  bool ErrorList::hasFatalErrors() const {
-    if (!m_errors.empty()) {
-      for (const CompilerError &error : m_errors) {
-        if (error.getLevel() == LEVEL_ERROR) {
-          return true;
-        }
+  void ErrorList::addError(const CompilerError &error) {
+    m_count++;
+
+    if (isFull()) {
+      return;
+    }
+
+    if (error.getLevel() == LEVEL_ERROR) {
+      m_numFatal++;
+    }
+
+    // mostly in order already, as a unit is read from start to end
+    if (m_errors.empty() || !(error < m_errors.back())) {
+      m_errors.push_back(error);
+    } else {
+      m_errors.insert(std::upper_bound(m_errors.begin(), m_errors.end(), error), error);
+    }
+  }
+
+  void ErrorList::addErrors(const ErrorList &other) {
+    if (m_maxFatal != 0 && m_numFatal + other.m_numFatal > m_maxFatal) {
+      // one at a time, up to the limit
+      for (const CompilerError &error : other.m_errors) {
+        addError(error);
       }
+
+      m_count += other.m_count - other.m_errors.size();
+
+      return;
     }
 
-    return false;
+    const size_t mid = m_errors.size();
+
+    m_errors.insert(m_errors.end(), other.m_errors.begin(), other.m_errors.end());
+    m_count += other.m_count;
+    m_numFatal += other.m_numFatal;
+
+    if (mid != 0 && mid != m_errors.size() && m_errors[mid] < m_errors[mid - 1]) {
+      std::inplace_merge(m_errors.begin(), m_errors.begin() + mid, m_errors.end());
+    }
+  }
+
+  void ErrorList::clearErrors() {
+    m_errors.clear();
+    m_count = 0;
+    m_numFatal = 0;
   }
 
   std::ostream &ErrorList::writeOutput(std::ostream &os) const {
-    std::unordered_set<std::string> error_filenames;
-    std::vector<std::string> current_file_lines;
+    // the lines of each file, read once, so that an error can show the
+    // line it is on, even when the errors of two files are interleaved
+    std::map<std::string, std::vector<std::string>> file_lines;
+    const std::string *current_path = nullptr;
 
     for (const CompilerError &error : m_errors) {
       const std::string &path = error.getLocation().getFileName();
+      auto it = file_lines.find(path);
+
+      if (it == file_lines.end()) {
+        it = file_lines.emplace(path, std::vector<std::string>()).first;
 
-      if (error_filenames.insert(path).second) {
-        current_file_lines.clear();
-        // read lines into current_lines vector
-        // this is used so that we can print out the line that an error occured on
         std::ifstream is(path);
         if (is.is_open()) {
           std::string line;
           while (std::getline(is, line)) {
-            current_file_lines.push_back(line);
+            it->second.push_back(line);
           }
         }
+      }
+
+      const std::vector<std::string> &current_file_lines = it->second;
+
+      if (current_path == nullptr || *current_path != path) {
+        current_path = &it->first;
 
         auto split = str_util::split_path(path);
         std::string real_filename = !split.empty()
@@ -92,6 +141,16 @@ namespace bcparse {
       os << termcolor::reset << '\n';
     }
 
+    if (isFull()) {
+      os << termcolor::reset << "Stopped after " << m_numFatal << " errors";
+
+      if (m_count > m_errors.size()) {
+        os << " (" << (m_count - m_errors.size()) << " more not shown)";
+      }
+
+      os << '\n';
+    }
+
     return os;
   }
 }
@@ -0,0 +1,95 @@
+#include <bcparse/extension.hpp>
+
+#include <shared/extension.h>
+
+#include <algorithm>
+
+#include <dlfcn.h>
+
+namespace bcparse {
+  static const char *const signatureTypes[] = { "i64", "u64", "f64", "bool", "ptr", "any" };
+
+  static bool isSignatureType(const std::string &type) {
+    return std::find(std::begin(signatureTypes), std::end(signatureTypes), type) != std::end(signatureTypes);
+  }
+
+  bool Extension::parseSignature(const std::string &signature, size_t &numArgs, bool &variadic) {
+    const size_t open = signature.find('(');
+
+    numArgs = 0;
+    variadic = false;
+
+    if (open == std::string::npos || signature.back() != ')' || !isSignatureType(signature.substr(0, open))) {
+      return false;
+    }
+
+    const std::string args = signature.substr(open + 1, signature.size() - open - 2);
+
+    if (args.empty()) {
+      return true;
+    }
+
+    for (size_t start = 0; start <= args.size(); ) {
+      size_t end = args.find(',', start);
+
+      if (end == std::string::npos) {
+        end = args.size();
+      }
+
+      const std::string arg = args.substr(start, end - start);
+
+      // "..." only last
+      if (arg == "..." && end == args.size()) {
+        variadic = true;
+      } else if (isSignatureType(arg)) {
+        numArgs++;
+      } else {
+        return false;
+      }
+
+      start = end + 1;
+    }
+
+    return true;
+  }
+
+  bool Extension::read(const std::string &path, std::string &error) {
+    // lazily, as the vm's functions it calls are not in bcparse, and
+    // RTLD_LOCAL, so that its symbols do not resolve those of a later one
+    void *handle = dlopen(path.c_str(), RTLD_LAZY | RTLD_LOCAL);
+
+    if (handle == nullptr) {
+      error = "Could not load extension: " + std::string(dlerror());
+      return false;
+    }
+
+    bb8_extension_entry_t entry = (bb8_extension_entry_t)dlsym(handle, BB8_EXTENSION_SYMBOL);
+    const bb8_extension_t *table = entry != nullptr ? entry() : nullptr;
+    bool ok = true;
+
+    if (table == nullptr || table->version != BB8_EXTENSION_VERSION || table->name == nullptr) {
+      error = "Not an extension of version " + std::to_string(BB8_EXTENSION_VERSION) + ": " + path;
+      ok = false;
+    } else {
+      m_name = table->name;
+      m_functions.clear();
+
+      for (uint32_t i = 0; i < table->numFunctions && ok; i++) {
+        const bb8_extension_function_t &fn = table->functions[i];
+        ExtensionFunction function { fn.name != nullptr ? fn.name : "", fn.signature != nullptr ? fn.signature : "", 0, false };
+
+        if (function.name.empty() || !parseSignature(function.signature, function.numArgs, function.variadic)) {
+          error = "Malformed signature of '" + function.name + "' in extension " + path + ": '" + function.signature + "'";
+          ok = false;
+        }
+
+        m_functions.push_back(function);
+      }
+    }
+
+    // the strings were copied out
+    dlclose(handle);
+
+    return ok;
+  }
+}
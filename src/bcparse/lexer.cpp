@@ -2,23 +2,69 @@
 #include <bcparse/token_stream.hpp>
 #include <bcparse/compilation_unit.hpp>
 #include <bcparse/source_file.hpp>
+#include <bcparse/compile_stats.hpp>
 
 #include <common/my_assert.hpp>
 
 #include <array>
 #include <sstream>
+#include <cstring>
+#include <cstdint>
 
 using utf::u32char;
 using UStr = utf::Utf8String;
 
 namespace bcparse {
+  // classes of ASCII bytes, as utf::utf32_is* has them, for scanning runs
+  // of them straight over the buffer. bytes from 0x80 on are in none: the
+  // loops stop there, and decode the character through SourceStream.
+  enum CharClass : uint8_t {
+    CC_SPACE = 1 << 0,
+    CC_DIGIT = 1 << 1,
+    CC_ALPHA = 1 << 2,
+    CC_UNDERSCORE = 1 << 3,
+    CC_COLON = 1 << 4,
+
+    CC_DIRECTIVE = CC_DIGIT | CC_ALPHA | CC_UNDERSCORE,
+    CC_IDENT = CC_DIRECTIVE | CC_COLON
+  };
+
+  static const struct CharClasses {
+    uint8_t table[256];
+
+    CharClasses() : table() {
+      for (int ch = 0; ch < 0x80; ch++) {
+        table[ch] =
+          (utf::utf32_isspace((u32char)ch) ? CC_SPACE : 0) |
+          (utf::utf32_isdigit((u32char)ch) ? CC_DIGIT : 0) |
+          (utf::utf32_isalpha((u32char)ch) ? CC_ALPHA : 0) |
+          (ch == '_' ? CC_UNDERSCORE : 0) |
+          (ch == ':' ? CC_COLON : 0);
+      }
+    }
+  } charClasses;
+
+  // the number of bytes from the stream's position that are all in `mask`
+  static inline size_t scanRun(const SourceStream &stream, uint8_t mask) {
+    const unsigned char *bytes = (const unsigned char*)stream.getCursor();
+    const size_t remaining = stream.getRemaining();
+    size_t n = 0;
+
+    while (n < remaining && (charClasses.table[bytes[n]] & mask)) {
+      n++;
+    }
+
+    return n;
+  }
+
   Lexer::Lexer(const SourceStream &sourceStream,
     TokenStream *tokenStream,
     CompilationUnit *compilationUnit)
     : m_sourceStream(sourceStream),
       m_tokenStream(tokenStream),
       m_compilationUnit(compilationUnit),
-      m_sourceLocation(0, 0, sourceStream.getFile()->getFilePath()) {
+      m_sourceLocation(0, 0, sourceStream.getFile()->getFilePath()),
+      m_started(false) {
   }
 
   bool Lexer::expectChar(utf::u32char ch, bool read, int *posChange) {
@@ -52,57 +98,83 @@ namespace bcparse {
   }
 
   void Lexer::analyze() {
-    // skip initial whitespace
-    skipWhitespace();
+    while (pull()) {
+    }
+  }
+
+  bool Lexer::pull() {
+    CompileStats::Timer timer(CompileStats::PHASE_LEX);
+    CompileStats *stats = CompileStats::current();
+
+    if (!m_started) {
+      // skip initial whitespace
+      skipWhitespace();
+      m_started = true;
+    }
+
+    if (!m_sourceStream.hasNext() || m_sourceStream.peek() == '\0') {
+      return false;
+    }
 
-    while (m_sourceStream.hasNext() && m_sourceStream.peek() != '\0') {
-      Token token = nextToken();
+    Token token = nextToken();
 
-      if (!token.empty()) {
-        m_tokenStream->push(token);
+    if (!token.empty()) {
+      m_tokenStream->push(token);
+
+      if (stats != nullptr) {
+        stats->tokensLexed++;
       }
+    }
 
-      // skipWhitespace() returns true if there was a newline
-      const SourceLocation location = m_sourceLocation;
+    // skipWhitespace() returns true if there was a newline
+    const SourceLocation location = m_sourceLocation;
 
-      if (skipWhitespace()) {
-        // add the `newline` statement terminator if not a continuation token
-        if (token && token.getTokenClass() != Token::TK_NEWLINE) {
-          // skip whitespace before next token
-          skipWhitespace();
+    if (skipWhitespace()) {
+      // add the `newline` statement terminator if not a continuation token
+      if (token && token.getTokenClass() != Token::TK_NEWLINE) {
+        // skip whitespace before next token
+        skipWhitespace();
 
-          // check if next token is connected
-          if (m_sourceStream.hasNext() && m_sourceStream.peek() != '\0') {
-            auto peek = m_sourceStream.peek();
+        // check if next token is connected
+        if (m_sourceStream.hasNext() && m_sourceStream.peek() != '\0') {
+          auto peek = m_sourceStream.peek();
 
-            if (peek == '{' || peek == '.') {
-              // do not add newline
-              continue;
-            }
+          if (peek == '{' || peek == '.') {
+            // do not add newline
+            return true;
           }
+        }
 
-          // add newline
-          m_tokenStream->push(Token(Token::TK_NEWLINE, "\\n", location));
+        // add newline
+        m_tokenStream->push(Token(Token::TK_NEWLINE, "\\n", location));
+
+        if (stats != nullptr) {
+          stats->tokensLexed++;
         }
       }
     }
+
+    return true;
   }
 
   bool Lexer::skipWhitespace() {
+    // whitespace is all ASCII
+    const char *bytes = m_sourceStream.getCursor();
+    const size_t n = scanRun(m_sourceStream, CC_SPACE);
     bool hadNewline = false;
 
-    while (m_sourceStream.hasNext() && utf::utf32_isspace(m_sourceStream.peek())) {
-      int posChange = 0;
-
-      if (m_sourceStream.next(posChange) == '\n') {
+    for (size_t i = 0; i < n; i++) {
+      if (bytes[i] == '\n') {
         m_sourceLocation.getLine()++;
         m_sourceLocation.getColumn() = 0;
         hadNewline = true;
       } else {
-        m_sourceLocation.getColumn() += posChange;
+        m_sourceLocation.getColumn()++;
       }
     }
 
+    m_sourceStream.advance(n);
+
     return hadNewline;
   }
 
@@ -309,10 +381,12 @@ namespace bcparse {
     u32char ch = m_sourceStream.peek();
 
     while (m_sourceStream.hasNext() && utf::utf32_isdigit(ch)) {
-      int posChange = 0;
-      u32char nextCh = m_sourceStream.next(posChange);
-      value.append(utf::get_bytes(nextCh));
-      m_sourceLocation.getColumn() += posChange;
+      // the run of digits; only the character after it can be a '.'
+      const size_t n = scanRun(m_sourceStream, CC_DIGIT);
+
+      value.append(m_sourceStream.getCursor(), n);
+      m_sourceStream.advance(n);
+      m_sourceLocation.getColumn() += n;
 
       if (tokenClass != Token::TK_FLOAT) {
         if (m_sourceStream.hasNext()) {
@@ -387,12 +461,12 @@ namespace bcparse {
       m_sourceLocation.getColumn() += posChange;
     }
 
-    // read until newline or EOF is reached
-    while (m_sourceStream.hasNext() && m_sourceStream.peek() != '\n') {
-      int posChange = 0;
-      m_sourceStream.next(posChange);
-      m_sourceLocation.getColumn() += posChange;
-    }
+    // read until newline or EOF is reached; the column counts bytes
+    const char *end = (const char*)std::memchr(m_sourceStream.getCursor(), '\n', m_sourceStream.getRemaining());
+    const size_t n = end != nullptr ? end - m_sourceStream.getCursor() : m_sourceStream.getRemaining();
+
+    m_sourceStream.advance(n);
+    m_sourceLocation.getColumn() += n;
 
     return Token(Token::TK_NEWLINE, "\\n", location);
   }
@@ -403,22 +477,30 @@ namespace bcparse {
     // store the name in this string
     std::string value;
 
-    // the character as a utf-32 character
-    u32char ch = m_sourceStream.peek();
+    for (;;) {
+      const size_t n = scanRun(m_sourceStream, CC_IDENT);
+
+      value.append(m_sourceStream.getCursor(), n);
+      m_sourceStream.advance(n);
+      m_sourceLocation.getColumn() += n;
+
+      // the character as a utf-32 character, past the ASCII run
+      u32char ch = m_sourceStream.peek();
+
+      if (ch < 0x80 || !utf::utf32_isalpha(ch)) {
+        break;
+      }
 
-  while (utf::utf32_isdigit(ch) || utf::utf32_isalpha(ch) || ch == '_' || ch == ':') {
       int posChange = 0;
       ch = m_sourceStream.next(posChange);
       m_sourceLocation.getColumn() += posChange;
       // append the raw bytes
-      value.append(utf::get_bytes(ch));
-      // set ch to be the next character in the buffer
-      ch = m_sourceStream.peek();
+      value.append(utf::get_bytes(ch), posChange);
     }
 
     Token::TokenClass tokenType = Token::TK_IDENT;
 
-    if (value.back() == ':') {
+    if (!value.empty() && value.back() == ':') {
       tokenType = Token::TK_LABEL;
       value.pop_back();
     }
@@ -437,17 +519,25 @@ namespace bcparse {
     // store the name
     std::string value;
 
-    // the character as a utf-32 character
-    u32char ch = m_sourceStream.peek();
+    for (;;) {
+      const size_t n = scanRun(m_sourceStream, CC_DIRECTIVE);
+
+      value.append(m_sourceStream.getCursor(), n);
+      m_sourceStream.advance(n);
+      m_sourceLocation.getColumn() += n;
+
+      // the character as a utf-32 character, past the ASCII run
+      u32char ch = m_sourceStream.peek();
+
+      if (ch < 0x80 || !utf::utf32_isalpha(ch)) {
+        break;
+      }
 
-    while (utf::utf32_isdigit(ch) || ch == (u32char)('_') || utf::utf32_isalpha(ch)) {
       int posChange = 0;
       ch = m_sourceStream.next(posChange);
       m_sourceLocation.getColumn() += posChange;
       // append the raw bytes
-      value.append(utf::get_bytes(ch));
-      // set ch to be the next character in the buffer
-      ch = m_sourceStream.peek();
+      value.append(utf::get_bytes(ch), posChange);
     }
 
     return Token(Token::TK_DIRECTIVE, value, location);
@@ -1,13 +1,24 @@
 #include <bcparse/macro.hpp>
+#include <bcparse/ast_iterator.hpp>
 
 namespace bcparse {
   Macro::Macro(const std::string &name, const std::vector<Token> &body)
     : m_name(name),
-      m_body(body) {
+      m_body(body),
+      m_templateParsed(false) {
   }
 
   Macro::Macro(const Macro &other)
     : m_name(other.m_name),
-      m_body(other.m_body) {
+      m_body(other.m_body),
+      m_templateParsed(false) {
+  }
+
+  Macro::~Macro() {
+  }
+
+  void Macro::setTemplate(AstIterator *tmpl) {
+    m_template.reset(tmpl);
+    m_templateParsed = true;
   }
 }
@@ -2,12 +2,32 @@
 #include <string>
 #include <utility>
 #include <memory>
+#include <cstdio>
+#include <cstring>
+#include <climits>
+#include <cstdlib>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <cerrno>
+#include <csignal>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
 
 #include <bcparse/emit/bytecode_chunk.hpp>
 #include <bcparse/emit/formatter.hpp>
 
 #include <bcparse/lexer.hpp>
 #include <bcparse/compilation_unit.hpp>
+#include <bcparse/token_cache.hpp>
+#include <bcparse/compile_cache.hpp>
+#include <bcparse/compile_stats.hpp>
+#include <bcparse/dependency_file.hpp>
 #include <bcparse/source_file.hpp>
 #include <bcparse/token_stream.hpp>
 #include <bcparse/ast_iterator.hpp>
@@ -15,6 +35,9 @@
 #include <bcparse/analyzer.hpp>
 #include <bcparse/compiler.hpp>
 #include <bcparse/emit/emitter.hpp>
+#include <bcparse/emit/profile.hpp>
+#include <bcparse/emit/size_report.hpp>
+#include <bcparse/extension.hpp>
 #include <bcparse/ast/ast_data_location.hpp>
 #include <bcparse/ast/ast_integer_literal.hpp>
 
@@ -28,37 +51,32 @@ using namespace bcparse;
 using Result = std::pair<bool, std::string>;
 using UStr = utf::Utf8String;
 
+static const size_t daemonMaxRequest = 4096; // bytes of a request line, with the newline
+static const int daemonBacklog = 64;
+static const size_t defaultMaxErrors = 100; // fatal errors before giving up, without --max-errors
+
 namespace bcparse {
   class CompilerHelper {
   public:
     static Result buildSourceFile(UStr filename, CompilationUnit *unit, BytecodeChunk *out) {
       std::stringstream ss;
 
-      std::ifstream in_file(
-        filename.GetData(),
-        std::ios::in | std::ios::ate | std::ios::binary
-      );
+      // mapped, not copied: the lexer only reads it
+      SourceFile sourceFile(filename.GetData());
 
-      if (!in_file.is_open()) {
-        utf::cout << "Could not open file: " << filename << "\n";
+      if (!sourceFile.isOpen()) {
+        ss << "Could not open file: " << filename.GetData();
       } else {
-        // get number of bytes
-        size_t max = in_file.tellg();
-        // seek to beginning
-        in_file.seekg(0, std::ios::beg);
-        // load stream into file buffer
-        SourceFile sourceFile(filename.GetData(), max);
-        in_file.read(sourceFile.getBuffer(), max);
-        in_file.close();
-
         SourceStream sourceStream(&sourceFile);
 
         TokenStream tokenStream(TokenStreamInfo {
           std::string(filename.GetData())
         });
 
+        // the parser pulls tokens from the lexer as it goes, rather than
+        // the file's tokens all being read first
         Lexer lex(sourceStream, &tokenStream, unit);
-        lex.analyze();
+        tokenStream.setSource(&lex);
 
         AstIterator iterator;
         Parser parser(&iterator, &tokenStream, unit);
@@ -71,7 +89,6 @@ namespace bcparse {
         // SemanticAnalyzer semantic_analyzer(&ast_iterator, &compilation_unit);
         // semantic_analyzer.Analyze();
 
-        unit->getErrorList().sortErrors();
         unit->getErrorList().writeOutput(ss); // TODO make utf8 compatible
 
         if (!unit->getErrorList().hasFatalErrors()) {
@@ -109,51 +126,334 @@ namespace bcparse {
 void defineBuiltinFunction(CompilationUnit *unit, const std::string &name, BUILTIN_C_FUNCTIONS value) {
   unit->getBoundGlobals().set(
     name,
-    Pointer<AstDataLocation>(new AstDataLocation(
+    makeNode<AstDataLocation>(
       "s",
-      Pointer<AstIntegerLiteral>(new AstIntegerLiteral(
+      makeNode<AstIntegerLiteral>(
         value,
         SourceLocation::eof
-      )),
+      ),
       SourceLocation::eof
-    ))
+    )
   );
 }
 
-Result handleArgs(int argc, char *argv[]) {
-  if (argc != 2) {
-    return { false, std::string("Invalid arguments: expected `") + argv[0] + " <filename>`" };
+void defineBuiltinConstant(CompilationUnit *unit, const std::string &name, int value) {
+  unit->getBoundGlobals().set(
+    name,
+    makeNode<AstIntegerLiteral>(
+      value,
+      SourceLocation::eof
+    )
+  );
+}
+
+// binds the functions of the extension module at `path` as builtins,
+// each to a slot of its own that the vm stores it to, see BIN_SECTION_IMPORTS
+static Result defineExtension(CompilationUnit *unit, const std::string &path) {
+  Extension extension;
+  std::string error;
+
+  if (!extension.read(path, error)) {
+    return { false, error };
   }
 
-  Result parseResult;
+  for (const ExtensionFunction &fn : extension.getFunctions()) {
+    const size_t slot = unit->getDataStorage()->addImport(DataStorage::Import {
+      extension.getName(), fn.name, fn.signature, fn.numArgs, fn.variadic
+    });
+
+    unit->getBoundGlobals().set(
+      fn.name,
+      makeNode<AstDataLocation>(
+        "s",
+        makeNode<AstIntegerLiteral>(
+          slot,
+          SourceLocation::eof
+        ),
+        SourceLocation::eof
+      )
+    );
+  }
 
-  UStr inFilename, outFilename;
+  return { true, "" };
+}
 
-  if (Clarg::has(argv, argv + argc, "-c")) {
-    inFilename = Clarg::get(argv, argv + argc, "-c");
+// `opt` or `opt=<value>`: NULL when not given, otherwise the value,
+// empty without one
+static const char *valueOption(int argc, char *argv[], const char *opt) {
+  const size_t len = std::strlen(opt);
+
+  for (int i = 1; i < argc; i++) {
+    if (std::strncmp(argv[i], opt, len) != 0) {
+      continue;
+    }
+
+    if (argv[i][len] == '\0') {
+      return "";
+    }
+
+    if (argv[i][len] == '=') {
+      return argv[i] + len + 1;
+    }
   }
 
-  if (inFilename == "") {
-    inFilename = argv[argc - 1];
+  return nullptr;
+}
+
+// --emit-listing[=<file>]: NULL when not given, otherwise the file to
+// write the listing to, empty for stdout
+static const char *listingOption(int argc, char *argv[]) {
+  return valueOption(argc, argv, "--emit-listing");
+}
+
+// --time-phases[=json] and --stats[=json]: written to stderr once the
+// compilation is over, whether or not it failed, as one report
+class StatsReport {
+public:
+  StatsReport(int argc, char *argv[], const UStr &inFilename)
+    : m_inFilename(inFilename.GetData()) {
+    const char *times = valueOption(argc, argv, "--time-phases");
+    const char *counts = valueOption(argc, argv, "--stats");
+
+    m_times = times != nullptr;
+    m_counts = counts != nullptr;
+    m_json = (times != nullptr && std::strcmp(times, "json") == 0)
+      || (counts != nullptr && std::strcmp(counts, "json") == 0);
   }
 
-  if (Clarg::has(argv, argv + argc, "-o")) {
-    outFilename = Clarg::get(argv, argv + argc, "-o");
+  ~StatsReport() {
+    if (!m_times && !m_counts) {
+      return;
+    }
+
+    // in one write, as --build reports from several threads
+    std::stringstream ss;
+
+    if (!m_json) {
+      ss << m_inFilename << ":\n";
+    }
+
+    m_stats.write(ss, m_times, m_counts, m_json);
+    std::cerr << ss.str() << std::flush;
   }
 
-  if (outFilename == "") {
-    outFilename = (str_util::strip_extension(inFilename.GetData()) + ".bin").c_str();
+  // NULL unless asked for
+  inline CompileStats *getStats() { return m_times || m_counts ? &m_stats : nullptr; }
+
+private:
+  std::string m_inFilename;
+  CompileStats m_stats;
+  bool m_times;
+  bool m_counts;
+  bool m_json;
+};
+
+static std::string compileCacheOptions(int argc, char *argv[]);
+
+// compiles `inFilename` to `outFilename`. `listing`, if not NULL, is
+// where to write the listing of what was emitted, as listingOption gives
+// it. `includes`, if not NULL, gets the canonical path of each file it
+// included or embedded. `warmFiles`, if not NULL, is where a --daemon
+// keeps the tokens of included files across compilations.
+Result compileFile(int argc, char *argv[], const UStr &inFilename, const UStr &outFilename,
+  const char *listing, std::vector<std::string> *includes, WarmFiles *warmFiles) {
+  // reported last, after what is timed is over
+  StatsReport report(argc, argv, inFilename);
+  CompileStats::Scope statsScope(report.getStats());
+
+  // --compile-cache <dir>, or BB8_COMPILE_CACHE: the output of an earlier
+  // compilation of the same files, with the same compiler and options, on
+  // any machine that shares <dir>. not for a listing or a size report,
+  // which only compiling makes.
+  const char *reportSize = valueOption(argc, argv, "--report-size");
+  const char *compileCacheDir = Clarg::get(argv, argv + argc, "--compile-cache");
+  std::unique_ptr<CompileCache> compileCache;
+
+  if (compileCacheDir == nullptr) {
+    compileCacheDir = std::getenv("BB8_COMPILE_CACHE");
+  }
+
+  if (compileCacheDir != nullptr && *compileCacheDir != '\0' && listing == nullptr && reportSize == nullptr) {
+    std::vector<std::string> cached;
+
+    compileCache.reset(new CompileCache(compileCacheDir, compileCacheOptions(argc, argv)));
+
+    const bool hit = compileCache->fetch(inFilename.GetData(), outFilename.GetData(), cached);
+
+    if (CompileStats *stats = report.getStats()) {
+      stats->cached = hit;
+    }
+
+    if (hit) {
+      if (includes != nullptr) {
+        includes->insert(includes->end(), cached.begin(), cached.end());
+      }
+
+      return { true, "" };
+    }
   }
 
+  // first, so that it goes after everything holding nodes
+  AstArena arena;
+  AstArena::Scope arenaScope(&arena);
+
   BytecodeChunk chunk;
   DataStorage dataStorage;
   CompilationUnit unit(&dataStorage);
 
+  // --cache: included files' tokens kept in <dir> across compilations
+  std::unique_ptr<TokenCache> tokenCache;
+
+  if (char *cacheDir = Clarg::get(argv, argv + argc, "--cache")) {
+    tokenCache.reset(new TokenCache(cacheDir));
+    unit.setTokenCache(tokenCache.get());
+  }
+
+  unit.setWarmFiles(warmFiles);
+  // --object is sectioned even with --flat, see Emitter
+  unit.setFlat(Clarg::has(argv, argv + argc, "--flat") && !Clarg::has(argv, argv + argc, "--object"));
+
+  // --max-errors=<n>: stop reading after <n> fatal errors, 0 for never
+  const char *maxErrors = valueOption(argc, argv, "--max-errors");
+  unit.getErrorList().setMaxFatal(maxErrors != nullptr ? std::strtoul(maxErrors, nullptr, 10) : defaultMaxErrors);
+
   // bake in default c functions
   defineBuiltinFunction(&unit, "createObject", BUILTIN_SYSTEM_CREATE_OBJECT);
+  defineBuiltinFunction(&unit, "createObjectSized", BUILTIN_SYSTEM_CREATE_OBJECT_SIZED);
   defineBuiltinFunction(&unit, "getObjectMember", BUILTIN_SYSTEM_GET_OBJECT_MEMBER);
   defineBuiltinFunction(&unit, "setObjectMember", BUILTIN_SYSTEM_SET_OBJECT_MEMBER);
 
+  defineBuiltinFunction(&unit, "arrayCreate", BUILTIN_SYSTEM_ARRAY_CREATE);
+  defineBuiltinFunction(&unit, "arrayCreateInt", BUILTIN_SYSTEM_ARRAY_CREATE_INT);
+  defineBuiltinFunction(&unit, "arrayCreateFloat", BUILTIN_SYSTEM_ARRAY_CREATE_FLOAT);
+  defineBuiltinFunction(&unit, "arrayGetIndex", BUILTIN_SYSTEM_ARRAY_GET_INDEX);
+  defineBuiltinFunction(&unit, "arraySetIndex", BUILTIN_SYSTEM_ARRAY_SET_INDEX);
+  defineBuiltinFunction(&unit, "arrayPush", BUILTIN_SYSTEM_ARRAY_PUSH);
+  defineBuiltinFunction(&unit, "arraySize", BUILTIN_SYSTEM_ARRAY_SIZE);
+
+  defineBuiltinFunction(&unit, "strBuilder", BUILTIN_SYSTEM_STR_BUILDER);
+  defineBuiltinFunction(&unit, "strAppend", BUILTIN_SYSTEM_STR_APPEND);
+  defineBuiltinFunction(&unit, "strBuild", BUILTIN_SYSTEM_STR_BUILD);
+  defineBuiltinFunction(&unit, "strSlice", BUILTIN_SYSTEM_STR_SLICE);
+  defineBuiltinFunction(&unit, "strCopy", BUILTIN_SYSTEM_STR_COPY);
+
+  defineBuiltinFunction(&unit, "scanFind", BUILTIN_SYSTEM_SCAN_FIND);
+  defineBuiltinFunction(&unit, "scanSkip", BUILTIN_SYSTEM_SCAN_SKIP);
+  defineBuiltinFunction(&unit, "parseInt", BUILTIN_SYSTEM_PARSE_INT);
+  defineBuiltinFunction(&unit, "parseDouble", BUILTIN_SYSTEM_PARSE_DOUBLE);
+  defineBuiltinFunction(&unit, "formatInt", BUILTIN_SYSTEM_FORMAT_INT);
+  defineBuiltinFunction(&unit, "formatDouble", BUILTIN_SYSTEM_FORMAT_DOUBLE);
+  defineBuiltinFunction(&unit, "throw", BUILTIN_SYSTEM_THROW);
+  defineBuiltinFunction(&unit, "arenaBegin", BUILTIN_SYSTEM_ARENA_BEGIN);
+  defineBuiltinFunction(&unit, "arenaEnd", BUILTIN_SYSTEM_ARENA_END);
+  defineBuiltinConstant(&unit, "SCAN_SPACE", BUILTIN_SCAN_SPACE);
+  defineBuiltinConstant(&unit, "SCAN_DIGIT", BUILTIN_SCAN_DIGIT);
+  defineBuiltinConstant(&unit, "SCAN_IDENT", BUILTIN_SCAN_IDENT);
+  defineBuiltinConstant(&unit, "SCAN_STRING_END", BUILTIN_SCAN_STRING_END);
+
+  defineBuiltinFunction(&unit, "vecAdd", BUILTIN_SYSTEM_VEC_ADD);
+  defineBuiltinFunction(&unit, "vecMul", BUILTIN_SYSTEM_VEC_MUL);
+  defineBuiltinFunction(&unit, "vecFma", BUILTIN_SYSTEM_VEC_FMA);
+  defineBuiltinFunction(&unit, "vecDot", BUILTIN_SYSTEM_VEC_DOT);
+  defineBuiltinFunction(&unit, "vecSum", BUILTIN_SYSTEM_VEC_SUM);
+  defineBuiltinFunction(&unit, "vecMin", BUILTIN_SYSTEM_VEC_MIN);
+  defineBuiltinFunction(&unit, "vecMax", BUILTIN_SYSTEM_VEC_MAX);
+
+  defineBuiltinFunction(&unit, "mapCreate", BUILTIN_SYSTEM_MAP_CREATE);
+  defineBuiltinFunction(&unit, "mapGet", BUILTIN_SYSTEM_MAP_GET);
+  defineBuiltinFunction(&unit, "mapSet", BUILTIN_SYSTEM_MAP_SET);
+  defineBuiltinFunction(&unit, "mapHas", BUILTIN_SYSTEM_MAP_HAS);
+  defineBuiltinFunction(&unit, "mapRemove", BUILTIN_SYSTEM_MAP_REMOVE);
+  defineBuiltinFunction(&unit, "mapSize", BUILTIN_SYSTEM_MAP_SIZE);
+  defineBuiltinFunction(&unit, "mapKeys", BUILTIN_SYSTEM_MAP_KEYS);
+
+  defineBuiltinFunction(&unit, "tableCreate", BUILTIN_SYSTEM_TABLE_CREATE);
+  defineBuiltinFunction(&unit, "tableAppend", BUILTIN_SYSTEM_TABLE_APPEND);
+  defineBuiltinFunction(&unit, "tableGet", BUILTIN_SYSTEM_TABLE_GET);
+  defineBuiltinFunction(&unit, "tableSet", BUILTIN_SYSTEM_TABLE_SET);
+  defineBuiltinFunction(&unit, "tableRow", BUILTIN_SYSTEM_TABLE_ROW);
+  defineBuiltinFunction(&unit, "tableSize", BUILTIN_SYSTEM_TABLE_SIZE);
+
+  defineBuiltinFunction(&unit, "serialize", BUILTIN_SYSTEM_SERIALIZE);
+  defineBuiltinFunction(&unit, "deserialize", BUILTIN_SYSTEM_DESERIALIZE);
+  defineBuiltinFunction(&unit, "parseJson", BUILTIN_SYSTEM_PARSE_JSON);
+  defineBuiltinFunction(&unit, "stringifyJson", BUILTIN_SYSTEM_STRINGIFY_JSON);
+  defineBuiltinFunction(&unit, "regexCompile", BUILTIN_SYSTEM_REGEX_COMPILE);
+  defineBuiltinFunction(&unit, "regexMatch", BUILTIN_SYSTEM_REGEX_MATCH);
+  defineBuiltinFunction(&unit, "regexFind", BUILTIN_SYSTEM_REGEX_FIND);
+  defineBuiltinFunction(&unit, "sort", BUILTIN_SYSTEM_SORT);
+  defineBuiltinFunction(&unit, "sortBy", BUILTIN_SYSTEM_SORT_BY);
+  defineBuiltinFunction(&unit, "hash64", BUILTIN_SYSTEM_HASH64);
+  defineBuiltinFunction(&unit, "crc32c", BUILTIN_SYSTEM_CRC32C);
+  defineBuiltinFunction(&unit, "hashCreate", BUILTIN_SYSTEM_HASH_CREATE);
+  defineBuiltinFunction(&unit, "hashUpdate", BUILTIN_SYSTEM_HASH_UPDATE);
+  defineBuiltinFunction(&unit, "hashDigest", BUILTIN_SYSTEM_HASH_DIGEST);
+  defineBuiltinFunction(&unit, "clockNs", BUILTIN_SYSTEM_CLOCK_NS);
+  defineBuiltinFunction(&unit, "benchBegin", BUILTIN_SYSTEM_BENCH_BEGIN);
+  defineBuiltinFunction(&unit, "benchStep", BUILTIN_SYSTEM_BENCH_STEP);
+  defineBuiltinFunction(&unit, "parallelFor", BUILTIN_SYSTEM_PARALLEL_FOR);
+  defineBuiltinFunction(&unit, "cacheCreate", BUILTIN_SYSTEM_CACHE_CREATE);
+  defineBuiltinFunction(&unit, "cacheGet", BUILTIN_SYSTEM_CACHE_GET);
+  defineBuiltinFunction(&unit, "cacheSet", BUILTIN_SYSTEM_CACHE_SET);
+  defineBuiltinFunction(&unit, "cacheRemove", BUILTIN_SYSTEM_CACHE_REMOVE);
+  defineBuiltinFunction(&unit, "cacheSize", BUILTIN_SYSTEM_CACHE_SIZE);
+  defineBuiltinFunction(&unit, "cacheEvictions", BUILTIN_SYSTEM_CACHE_EVICTIONS);
+  defineBuiltinFunction(&unit, "sockListen", BUILTIN_SYSTEM_SOCK_LISTEN);
+  defineBuiltinFunction(&unit, "sockConnect", BUILTIN_SYSTEM_SOCK_CONNECT);
+  defineBuiltinFunction(&unit, "sockAccept", BUILTIN_SYSTEM_SOCK_ACCEPT);
+  defineBuiltinFunction(&unit, "sockRead", BUILTIN_SYSTEM_SOCK_READ);
+  defineBuiltinFunction(&unit, "sockWrite", BUILTIN_SYSTEM_SOCK_WRITE);
+  defineBuiltinFunction(&unit, "sockSendFile", BUILTIN_SYSTEM_SOCK_SEND_FILE);
+  defineBuiltinFunction(&unit, "sockWait", BUILTIN_SYSTEM_SOCK_WAIT);
+  defineBuiltinFunction(&unit, "sockClose", BUILTIN_SYSTEM_SOCK_CLOSE);
+  defineBuiltinFunction(&unit, "streq", BUILTIN_SYSTEM_STREQ);
+  defineBuiltinFunction(&unit, "strIntern", BUILTIN_SYSTEM_STR_INTERN);
+  defineBuiltinFunction(&unit, "objectKeys", BUILTIN_SYSTEM_OBJECT_KEYS);
+  defineBuiltinFunction(&unit, "objectValues", BUILTIN_SYSTEM_OBJECT_VALUES);
+  defineBuiltinFunction(&unit, "objectForEach", BUILTIN_SYSTEM_OBJECT_FOR_EACH);
+  defineBuiltinFunction(&unit, "objectClone", BUILTIN_SYSTEM_OBJECT_CLONE);
+  defineBuiltinFunction(&unit, "objectAssign", BUILTIN_SYSTEM_OBJECT_ASSIGN);
+  defineBuiltinFunction(&unit, "structCreate", BUILTIN_SYSTEM_STRUCT_CREATE);
+  defineBuiltinFunction(&unit, "getSlot", BUILTIN_SYSTEM_GET_SLOT);
+  defineBuiltinFunction(&unit, "setSlot", BUILTIN_SYSTEM_SET_SLOT);
+
+  defineBuiltinFunction(&unit, "snapshot", BUILTIN_SYSTEM_SNAPSHOT);
+  defineBuiltinFunction(&unit, "flush", BUILTIN_SYSTEM_FLUSH);
+  defineBuiltinFunction(&unit, "traceDump", BUILTIN_SYSTEM_TRACE_DUMP);
+  defineBuiltinFunction(&unit, "heapCensus", BUILTIN_SYSTEM_HEAP_CENSUS);
+
+  defineBuiltinFunction(&unit, "streamOpen", BUILTIN_SYSTEM_STREAM_OPEN);
+  defineBuiltinFunction(&unit, "streamReadInto", BUILTIN_SYSTEM_STREAM_READ_INTO);
+  defineBuiltinFunction(&unit, "streamReadLine", BUILTIN_SYSTEM_STREAM_READ_LINE);
+  defineBuiltinFunction(&unit, "streamMap", BUILTIN_SYSTEM_STREAM_MAP);
+  defineBuiltinFunction(&unit, "streamSize", BUILTIN_SYSTEM_STREAM_SIZE);
+  defineBuiltinFunction(&unit, "streamClose", BUILTIN_SYSTEM_STREAM_CLOSE);
+
+  defineBuiltinFunction(&unit, "aioRead", BUILTIN_SYSTEM_AIO_READ);
+  defineBuiltinFunction(&unit, "aioWrite", BUILTIN_SYSTEM_AIO_WRITE);
+  defineBuiltinFunction(&unit, "aioPoll", BUILTIN_SYSTEM_AIO_POLL);
+  defineBuiltinFunction(&unit, "aioWait", BUILTIN_SYSTEM_AIO_WAIT);
+
+  defineBuiltinFunction(&unit, "input", BUILTIN_SYSTEM_INPUT);
+
+  defineBuiltinFunction(&unit, "taskSpawn", BUILTIN_SYSTEM_TASK_SPAWN);
+  defineBuiltinFunction(&unit, "taskJoin", BUILTIN_SYSTEM_TASK_JOIN);
+  defineBuiltinFunction(&unit, "taskDone", BUILTIN_SYSTEM_TASK_DONE);
+
+  defineBuiltinFunction(&unit, "chanCreate", BUILTIN_SYSTEM_CHAN_CREATE);
+  defineBuiltinFunction(&unit, "chanSend", BUILTIN_SYSTEM_CHAN_SEND);
+  defineBuiltinFunction(&unit, "chanRecv", BUILTIN_SYSTEM_CHAN_RECV);
+  defineBuiltinFunction(&unit, "chanClose", BUILTIN_SYSTEM_CHAN_CLOSE);
+
+  defineBuiltinFunction(&unit, "share", BUILTIN_SYSTEM_SHARE);
+
+  defineBuiltinFunction(&unit, "parallelMap", BUILTIN_SYSTEM_PARALLEL_MAP);
+  defineBuiltinFunction(&unit, "parallelReduce", BUILTIN_SYSTEM_PARALLEL_REDUCE);
+
+  for (int i = 0; i < BUILTIN_HOST_COUNT; i++) {
+    defineBuiltinFunction(&unit, "host" + std::to_string(i), (BUILTIN_C_FUNCTIONS)(BUILTIN_HOST_FIRST + i));
+  }
+
   defineBuiltinFunction(&unit, "exit", BUILTIN_SYSTEM_C_EXIT);
   defineBuiltinFunction(&unit, "fmod", BUILTIN_SYSTEM_C_FMOD);
   defineBuiltinFunction(&unit, "strlen", BUILTIN_SYSTEM_C_STRLEN);
@@ -164,12 +464,76 @@ Result handleArgs(int argc, char *argv[]) {
   defineBuiltinFunction(&unit, "fwrite", BUILTIN_SYSTEM_C_FWRITE);
   defineBuiltinFunction(&unit, "fseek", BUILTIN_SYSTEM_C_FSEEK);
 
+  defineBuiltinFunction(&unit, "memcpy", BUILTIN_SYSTEM_C_MEMCPY);
+  defineBuiltinFunction(&unit, "memset", BUILTIN_SYSTEM_C_MEMSET);
+  defineBuiltinFunction(&unit, "memchr", BUILTIN_SYSTEM_C_MEMCHR);
+  defineBuiltinFunction(&unit, "memcmp", BUILTIN_SYSTEM_C_MEMCMP);
+
+  // --extension <path>, any number of times: the functions of a native
+  // module, after the builtins so that they may take a builtin's name
+  for (int i = 1; i + 1 < argc; i++) {
+    if (std::strcmp(argv[i], "--extension") != 0) {
+      continue;
+    }
+
+    if (Clarg::has(argv, argv + argc, "--flat") || Clarg::has(argv, argv + argc, "--object")) {
+      return { false, "--extension needs a sectioned program, not --flat or --object" };
+    }
+
+    Result r = defineExtension(&unit, argv[++i]);
+
+    if (!r.first) {
+      return r;
+    }
+  }
+
   Result r = CompilerHelper::buildSourceFile(inFilename, &unit, &chunk);
 
   if (!r.first) {
     return r;
   }
 
+  if (includes != nullptr) {
+    for (auto &it : unit.getIncludedFiles()) {
+      includes->push_back(it.first);
+    }
+
+    includes->insert(includes->end(), unit.getEmbeddedFiles().begin(), unit.getEmbeddedFiles().end());
+  }
+
+  // streamed out while emitting, so nothing is built for it unless asked
+  std::ofstream listingFile;
+  std::unique_ptr<Formatter> f;
+
+  if (listing != nullptr) {
+    std::ostream *listingStream = &utf::cout;
+
+    if (*listing != '\0') {
+      listingFile.open(listing, std::ios::out);
+
+      if (!listingFile.is_open()) {
+        return { false, std::string("Could not write to listing file: ") + listing };
+      }
+
+      listingStream = &listingFile;
+    }
+
+    f.reset(new Formatter(listingStream));
+  }
+
+  // --profile-use: what `vm --profile-out` counted in a run of a -g
+  // build of this source
+  Profile profile;
+  const char *profileFilename = Clarg::get(argv, argv + argc, "--profile-use");
+
+  if (profileFilename != nullptr) {
+    std::string error;
+
+    if (!profile.read(profileFilename, error)) {
+      return { false, error };
+    }
+  }
+
   std::ofstream of(outFilename.GetData(), std::ios::out | std::ios::binary);
 
   if (!of.is_open()) {
@@ -180,20 +544,461 @@ Result handleArgs(int argc, char *argv[]) {
     return { false, ss.str() };
   }
 
-  Formatter f;
+  // --flat: the pre-container format, all static data set up by loads.
+  // -g: label names, the sites a profile counts and where in the source
+  // each range of the code came from, in debug sections of the container.
+  // --no-compact: fixed size operands in the container's code, as a flat
+  // stream has them.
+  // --compress: the container's code compressed, for large programs.
+  // --segments: the container's code split at labels, so the vm decodes
+  // only the parts that run.
+  // --no-peephole: the instructions as written, without BytecodeChunk::peephole,
+  // scratchObjects, objectTemplates or takeResults.
+  // --profile-use <file>: lay out branches and inline calls by the counts in <file>.
+  // --object: an object for bclink, with the symbols of @export and @extern.
+  // --extension <path>: the functions of a native module, see shared/extension.h.
+  // --time-phases[=json], --stats[=json]: what the compilation took and
+  // made, on stderr, see StatsReport.
+  // --report-size[=json]: what the output is made of, on stderr, see SizeReport.
+  Emitter emitter(
+    &chunk,
+    Clarg::has(argv, argv + argc, "--flat") ? Emitter::Format::Flat : Emitter::Format::Sectioned,
+    Clarg::has(argv, argv + argc, "-g"),
+    !Clarg::has(argv, argv + argc, "--no-compact"),
+    Clarg::has(argv, argv + argc, "--compress"),
+    Clarg::has(argv, argv + argc, "--segments"),
+    !Clarg::has(argv, argv + argc, "--no-peephole"),
+    profileFilename != nullptr ? &profile : nullptr,
+    Clarg::has(argv, argv + argc, "--object")
+  );
+  SizeReport sizeReport;
+
+  if (reportSize != nullptr) {
+    emitter.setReport(&sizeReport);
+  }
+
+  emitter.emit(&of, f.get());
+
+  if (reportSize != nullptr) {
+    // in one write, as StatsReport's
+    const bool json = std::strcmp(reportSize, "json") == 0;
+    std::stringstream ss;
+
+    if (!json) {
+      ss << inFilename.GetData() << ":\n";
+    }
+
+    sizeReport.write(ss, json);
+    std::cerr << ss.str() << std::flush;
+  }
+
+  if (CompileStats *stats = report.getStats()) {
+    stats->staticData = dataStorage.getSize();
+    stats->outputSize = (size_t)of.tellp();
+  }
+
+  of.close();
+
+  if (compileCache != nullptr && of) {
+    std::vector<std::string> used;
+
+    for (auto &it : unit.getIncludedFiles()) {
+      used.push_back(it.first);
+    }
+
+    used.insert(used.end(), unit.getEmbeddedFiles().begin(), unit.getEmbeddedFiles().end());
+    compileCache->store(inFilename.GetData(), outFilename.GetData(), used);
+  }
+
+  return { true, "" };
+}
+
+// the options that change what an output is, for --build to compare
+static std::string outputOptions(int argc, char *argv[]) {
+  std::string options;
+
+  for (const char *opt : { "--flat", "-g", "--no-compact", "--compress", "--segments", "--no-peephole", "--object" }) {
+    if (Clarg::has(argv, argv + argc, opt)) {
+      options += options.empty() ? opt : std::string(" ") + opt;
+    }
+  }
+
+  // the modules, not what is in them: a rebuilt one whose table changed
+  // needs an explicit rebuild
+  for (int i = 1; i + 1 < argc; i++) {
+    if (std::strcmp(argv[i], "--extension") == 0) {
+      options += (options.empty() ? "--extension " : " --extension ") + std::string(argv[++i]);
+    }
+  }
+
+  return options;
+}
+
+// outputOptions, and the contents of the files options name, for
+// --compile-cache to key outputs by
+static std::string compileCacheOptions(int argc, char *argv[]) {
+  std::stringstream ss;
+
+  ss << outputOptions(argc, argv);
+
+  for (int i = 1; i + 1 < argc; i++) {
+    uint64_t hash;
+
+    if (std::strcmp(argv[i], "--extension") != 0 && std::strcmp(argv[i], "--profile-use") != 0) {
+      continue;
+    }
+
+    // one that cannot be read fails the compilation anyway
+    if (DependencyFile::hashFile(argv[++i], hash)) {
+      ss << " " << argv[i - 1] << "=" << std::hex << hash << std::dec;
+    }
+  }
+
+  return ss.str();
+}
+
+// what is added to an input's name, less its extension, to name its output
+static const char *outputExtension(int argc, char *argv[]) {
+  return Clarg::has(argv, argv + argc, "--object") ? ".o" : ".bin";
+}
+
+// an input of --build, and what became of it
+struct BuildJob {
+  enum State { PENDING, BUILT, UP_TO_DATE, FAILED };
+
+  std::string source;
+  State state;
+  std::string message;
+};
+
+static BuildJob buildOne(int argc, char *argv[], const std::string &options, const std::string &source) {
+  BuildJob job { source, BuildJob::PENDING, "" };
+  const UStr inFilename = job.source.c_str();
+  const UStr outFilename = (str_util::strip_extension(job.source) + outputExtension(argc, argv)).c_str();
+  const std::string depFilename = std::string(outFilename.GetData()) + ".d";
+
+  if (std::ifstream(outFilename.GetData()).good() && DependencyFile::isUpToDate(depFilename, options)) {
+    job.state = BuildJob::UP_TO_DATE;
+    job.message = std::string(outFilename.GetData()) + " is up to date";
+    return job;
+  }
+
+  std::vector<std::string> includes;
+  Result r = compileFile(argc, argv, inFilename, outFilename, nullptr, &includes, nullptr);
+
+  if (!r.first) {
+    job.state = BuildJob::FAILED;
+    job.message = job.source + ": " + r.second;
+    return job;
+  }
+
+  // canonical paths, as the includes have, so the record holds wherever
+  // the build runs from
+  DependencyFile deps(options);
+  char sourcePath[PATH_MAX];
+  bool complete = realpath(job.source.c_str(), sourcePath) != nullptr && deps.add(sourcePath);
 
-  Emitter emitter(&chunk);
-  emitter.emit(&of, &f);
+  for (const std::string &include : includes) {
+    complete = deps.add(include) && complete;
+  }
+
+  // without a complete record it is built again next time
+  if (!complete || !deps.write(depFilename)) {
+    std::remove(depFilename.c_str());
+  }
 
-  utf::cout << "AST:\n\n";
-  utf::cout << f.toString();
-  utf::cout << "\n\n";
+  job.state = BuildJob::BUILT;
+  job.message = std::string("Compiled to ") + outFilename.GetData();
+
+  return job;
+}
+
+// --build: each input to its .bin (.o with --object), skipping those
+// whose <output>.d says that nothing they were built from has changed
+// since. inputs compile on -j threads (the number of cpus by default),
+// each in a compilation of its own, and are reported in the order they
+// were given.
+Result handleBuild(int argc, char *argv[]) {
+  // a profile is of one program
+  if (Clarg::has(argv, argv + argc, "--profile-use")) {
+    return { false, "--profile-use does not apply to --build" };
+  }
 
-  utf::cout << "Compiled to " << outFilename.GetData() << "\n";
+  const std::string options = outputOptions(argc, argv);
+  std::vector<BuildJob> jobs;
+  size_t numThreads = std::thread::hardware_concurrency();
+
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+
+    if (arg == "--cache" || arg == "--compile-cache" || arg == "-o" || arg == "-j" || arg == "--extension") {
+      i++; // its value
+      continue;
+    }
+
+    if (arg.empty() || arg[0] == '-') {
+      continue;
+    }
+
+    jobs.push_back(BuildJob { arg, BuildJob::PENDING, "" });
+  }
+
+  if (char *j = Clarg::get(argv, argv + argc, "-j")) {
+    numThreads = std::strtoul(j, nullptr, 10);
+  }
+
+  numThreads = std::max<size_t>(1, std::min(numThreads, jobs.size()));
+
+  std::atomic<size_t> next(0);
+  std::mutex lock;
+  size_t reported = 0;
+
+  auto work = [&]() {
+    size_t index;
+
+    while ((index = next.fetch_add(1)) < jobs.size()) {
+      BuildJob job = buildOne(argc, argv, options, jobs[index].source);
+
+      // the reporting thread reads the state of the others' jobs
+      std::lock_guard<std::mutex> guard(lock);
+
+      jobs[index] = job;
+
+      while (reported < jobs.size() && jobs[reported].state != BuildJob::PENDING) {
+        utf::cout << jobs[reported++].message.c_str() << "\n";
+      }
+    }
+  };
+
+  std::vector<std::thread> threads;
+
+  for (size_t i = 1; i < numThreads; i++) {
+    threads.emplace_back(work);
+  }
+
+  work();
+
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+
+  size_t built = 0, skipped = 0, failed = 0;
+
+  for (const BuildJob &job : jobs) {
+    built += job.state == BuildJob::BUILT;
+    skipped += job.state == BuildJob::UP_TO_DATE;
+    failed += job.state == BuildJob::FAILED;
+  }
+
+  std::stringstream ss;
+  ss << built << " built, " << skipped << " up to date, " << failed << " failed";
+
+  if (failed != 0) {
+    return { false, ss.str() };
+  }
+
+  utf::cout << ss.str() << "\n";
 
   return { true, "" };
 }
 
+// one input, as `bcparse [options] <filename>` compiles it
+static Result handleCompile(int argc, char *argv[], WarmFiles *warmFiles) {
+  UStr inFilename, outFilename;
+
+  if (Clarg::has(argv, argv + argc, "-c")) {
+    inFilename = Clarg::get(argv, argv + argc, "-c");
+  }
+
+  if (inFilename == "") {
+    inFilename = argv[argc - 1];
+  }
+
+  if (Clarg::has(argv, argv + argc, "-o")) {
+    outFilename = Clarg::get(argv, argv + argc, "-o");
+  }
+
+  if (outFilename == "") {
+    outFilename = (str_util::strip_extension(inFilename.GetData()) + outputExtension(argc, argv)).c_str();
+  }
+
+  Result r = compileFile(argc, argv, inFilename, outFilename, listingOption(argc, argv), nullptr, warmFiles);
+
+  if (r.first) {
+    r.second = std::string("Compiled to ") + outFilename.GetData();
+  }
+
+  return r;
+}
+
+// the request on `fd`, up to its newline. false if the client sent
+// nothing, or too long a line.
+static bool daemonReadRequest(int fd, std::string &request) {
+  char buf[daemonMaxRequest];
+  size_t len = 0;
+
+  while (len < sizeof(buf)) {
+    ssize_t n = read(fd, buf + len, sizeof(buf) - len);
+
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+
+    if (n <= 0) {
+      break;
+    }
+
+    if (char *end = (char*)std::memchr(buf + len, '\n', (size_t)n)) {
+      request.assign(buf, end - buf);
+
+      if (!request.empty() && request.back() == '\r') {
+        request.pop_back();
+      }
+
+      return true;
+    }
+
+    len += (size_t)n;
+  }
+
+  request.assign(buf, len < sizeof(buf) ? len : 0);
+
+  return !request.empty();
+}
+
+// --daemon <socket>: listens on a unix socket for lines of
+// "[options] <filename>", compiling each as `bcparse [options] <filename>`
+// would and sending back what it would print, "error: " first if it
+// failed, then closing the connection. paths are taken from where the
+// daemon runs. requests are served one at a time, and the tokens of
+// included files stay in memory between them, lexed again only once
+// their mtime changes; each compilation still parses and analyzes them
+// in a unit of its own, as bindings and static data are per program.
+Result handleDaemon(int argc, char *argv[]) {
+  const char *path = Clarg::get(argv, argv + argc, "--daemon");
+  struct sockaddr_un addr = {};
+  int serverFd;
+
+  if (path == nullptr) {
+    return { false, "--daemon needs a socket path" };
+  }
+
+  if (std::strlen(path) >= sizeof(addr.sun_path)) {
+    return { false, std::string("Socket path too long: ") + path };
+  }
+
+  addr.sun_family = AF_UNIX;
+  std::strcpy(addr.sun_path, path);
+  unlink(path);
+
+  if ((serverFd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1
+      || bind(serverFd, (struct sockaddr*)&addr, sizeof(addr)) != 0
+      || listen(serverFd, daemonBacklog) != 0) {
+    return { false, std::string("Could not listen on ") + path + ": " + std::strerror(errno) };
+  }
+
+  // a client that leaves before its reply only fails a write
+  signal(SIGPIPE, SIG_IGN);
+
+  WarmFiles warmFiles;
+  std::string request;
+
+  for (;;) {
+    int fd = accept(serverFd, nullptr, nullptr);
+
+    if (fd == -1) {
+      if (errno == EINTR || errno == ECONNABORTED) {
+        continue;
+      }
+
+      break;
+    }
+
+    if (!daemonReadRequest(fd, request)) {
+      close(fd);
+      continue;
+    }
+
+    std::vector<std::string> args { argv[0] };
+    std::stringstream words(request);
+    std::string word;
+
+    while (words >> word) {
+      args.push_back(word);
+    }
+
+    std::vector<char*> requestArgv;
+
+    for (std::string &arg : args) {
+      requestArgv.push_back(&arg[0]);
+    }
+
+    requestArgv.push_back(nullptr);
+
+    const int requestArgc = (int)args.size();
+    char **first = requestArgv.data(), **last = first + requestArgc;
+    const char *listing = listingOption(requestArgc, first);
+    Result r;
+
+    if (requestArgc < 2) {
+      r = { false, "expected `[options] <filename>`" };
+    } else if (Clarg::has(first, last, "--build") || Clarg::has(first, last, "--daemon")) {
+      r = { false, "--build and --daemon are not requests" };
+    } else if (listing != nullptr && *listing == '\0') {
+      r = { false, "--emit-listing needs =<file> in a request" };
+    } else {
+      r = handleCompile(requestArgc, first, &warmFiles);
+    }
+
+    const std::string reply = (r.first ? "" : "error: ") + r.second + "\n";
+
+    for (size_t written = 0; written < reply.size();) {
+      ssize_t n = write(fd, reply.data() + written, reply.size() - written);
+
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+
+      if (n <= 0) {
+        break;
+      }
+
+      written += (size_t)n;
+    }
+
+    close(fd);
+  }
+
+  const std::string error = std::string("accept: ") + std::strerror(errno);
+
+  close(serverFd);
+  unlink(path);
+
+  return { false, error };
+}
+
+Result handleArgs(int argc, char *argv[]) {
+  if (argc < 2) {
+    return { false, std::string("Invalid arguments: expected `") + argv[0] + " [--flat] [-g] [--no-compact] [--compress] [--segments] [--no-peephole] [--profile-use <file>] [--object] [--extension <module>]... [--emit-listing[=<file>]] [--cache <dir>] [--compile-cache <dir>] [--max-errors=<n>] [--time-phases[=json]] [--stats[=json]] [--report-size[=json]] <filename>`, `" + argv[0] + " --build [-j <threads>] [options] <filename>...` or `" + argv[0] + " --daemon <socket>`" };
+  }
+
+  if (Clarg::has(argv, argv + argc, "--build")) {
+    return handleBuild(argc, argv);
+  }
+
+  if (Clarg::has(argv, argv + argc, "--daemon")) {
+    return handleDaemon(argc, argv);
+  }
+
+  Result r = handleCompile(argc, argv, nullptr);
+
+  if (r.first) {
+    utf::cout << r.second.c_str() << "\n";
+  }
+
+  return r;
+}
+
 int main(int argc, char *argv[]) {
   Result r = handleArgs(argc, argv);
 
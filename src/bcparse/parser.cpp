@@ -3,6 +3,7 @@
 #include <bcparse/analyzer.hpp>
 #include <bcparse/source_file.hpp>
 #include <bcparse/source_stream.hpp>
+#include <bcparse/compile_stats.hpp>
 
 #include <bcparse/ast/ast_directive.hpp>
 #include <bcparse/ast/ast_label_decl.hpp>
@@ -23,6 +24,11 @@
 #include <bcparse/ast/ast_binop_statement.hpp>
 #include <bcparse/ast/ast_print_statement.hpp>
 #include <bcparse/ast/ast_call_statement.hpp>
+#include <bcparse/ast/ast_fiber_statement.hpp>
+#include <bcparse/ast/ast_select_statement.hpp>
+#include <bcparse/ast/ast_frame_statement.hpp>
+
+#include <shared/builtins.h>
 
 #include <common/my_assert.hpp>
 
@@ -128,13 +134,16 @@ namespace bcparse {
   }
 
   void Parser::parse() {
+    CompileStats::Timer timer(CompileStats::PHASE_PARSE);
+
     skipStatementTerminators();
 
     // first pass; hoist macro definitions
     std::vector<Pointer<AstStatement>> hoisted;
     std::vector<Pointer<AstStatement>> otherStmts;
 
-    while (m_tokenStream->hasNext()) {
+    // past the limit of errors, so is the rest of the file unread
+    while (m_tokenStream->hasNext() && !m_compilationUnit->getErrorList().isFull()) {
       if (auto stmt = parseStatement()) {
         if (stmt->isHoisted()) {
           hoisted.push_back(stmt);
@@ -269,10 +278,10 @@ namespace bcparse {
 
   Pointer<AstVariable> Parser::parseVariable() {
     if (Token token = expect(Token::TK_IDENT, true)) {
-      return Pointer<AstVariable>(new AstVariable(
+      return makeNode<AstVariable>(
         token.getValue(),
         token.getLocation()
-      ));
+      );
     }
 
     return nullptr;
@@ -280,10 +289,10 @@ namespace bcparse {
 
   Pointer<AstSymbol> Parser::parseSymbol() {
     if (Token token = expect(Token::TK_IDENT, true)) {
-      return Pointer<AstSymbol>(new AstSymbol(
+      return makeNode<AstSymbol>(
         token.getValue(),
         token.getLocation()
-      ));
+      );
     }
 
     return nullptr;
@@ -295,10 +304,10 @@ namespace bcparse {
       int64_t value;
       ss >> value;
 
-      return Pointer<AstIntegerLiteral>(new AstIntegerLiteral(
+      return makeNode<AstIntegerLiteral>(
         value,
         token.getLocation()
-      ));
+      );
     }
 
     return nullptr;
@@ -310,10 +319,10 @@ namespace bcparse {
       double value;
       ss >> value;
 
-      return Pointer<AstFloatLiteral>(new AstFloatLiteral(
+      return makeNode<AstFloatLiteral>(
         value,
         token.getLocation()
-      ));
+      );
     }
 
     return nullptr;
@@ -321,10 +330,10 @@ namespace bcparse {
 
   Pointer<AstStringLiteral> Parser::parseStringLiteral() {
     if (Token token = expect(Token::TK_STRING, true)) {
-      return Pointer<AstStringLiteral>(new AstStringLiteral(
+      return makeNode<AstStringLiteral>(
         token.getValue(),
         token.getLocation()
-      ));
+      );
     }
 
     return nullptr;
@@ -367,12 +376,12 @@ namespace bcparse {
         }
       }
 
-      return Pointer<AstDirective>(new AstDirective(
+      return makeNode<AstDirective>(
         token.getValue(),
         arguments,
         tokens,
         token.getLocation()
-      ));
+      );
     }
 
     return nullptr;
@@ -389,11 +398,11 @@ namespace bcparse {
 
       m_compilationUnit->getBoundGlobals().set(token.getValue(), astLabel);
 
-      return Pointer<AstLabelDecl>(new AstLabelDecl(
+      return makeNode<AstLabelDecl>(
         token.getValue(),
         astLabel,
         token.getLocation()
-      ));
+      );
     }
 
     return nullptr;
@@ -409,6 +418,12 @@ namespace bcparse {
         { "jge", AstJmpStatement::JumpMode::JumpIfGreaterOrEqual },
       };
 
+      // set<cc> and select<cc>, cc as for the jumps
+      const bool select = token.getValue().compare(0, 6, "select") == 0;
+      const auto condition = select || token.getValue().compare(0, 3, "set") == 0
+        ? jumpModeStrings.find("j" + token.getValue().substr(select ? 6 : 3))
+        : jumpModeStrings.end();
+
       if (jumpModeStrings.find(token.getValue()) != jumpModeStrings.end()) {
         // m_tokenStream->next();
 
@@ -418,11 +433,32 @@ namespace bcparse {
           return nullptr;
         }
 
-        return Pointer<AstJmpStatement>(new AstJmpStatement(
+        return makeNode<AstJmpStatement>(
           expr,
           jumpModeStrings.find(token.getValue())->second,
           token.getLocation()
-        ));
+        );
+      } else if (condition != jumpModeStrings.end() && condition->second != AstJmpStatement::JumpMode::None) {
+        // set<cc> dst / select<cc> dst a b
+        Pointer<AstExpression> a, b;
+
+        auto dst = parseExpression();
+
+        if (!dst) {
+          return nullptr;
+        }
+
+        if (select && (!(a = parseExpression()) || !(b = parseExpression()))) {
+          return nullptr;
+        }
+
+        return makeNode<AstSelectStatement>(
+          condition->second,
+          dst,
+          a,
+          b,
+          token.getLocation()
+        );
       } else if (token.getValue() == "cmp") {
         // m_tokenStream->next();
 
@@ -438,11 +474,11 @@ namespace bcparse {
           return nullptr;
         }
 
-        return Pointer<AstCmpStatement>(new AstCmpStatement(
+        return makeNode<AstCmpStatement>(
           left,
           right,
           token.getLocation()
-        ));
+        );
       } else if (token.getValue() == "mov") {
         auto left = parseExpression();
 
@@ -456,11 +492,11 @@ namespace bcparse {
           return nullptr;
         }
 
-        return Pointer<AstMovStatement>(new AstMovStatement(
+        return makeNode<AstMovStatement>(
           left,
           right,
           token.getLocation()
-        ));
+        );
       } else if (token.getValue() == "push") {
         auto arg = parseExpression();
 
@@ -468,10 +504,10 @@ namespace bcparse {
           return nullptr;
         }
 
-        return Pointer<AstPushStatement>(new AstPushStatement(
+        return makeNode<AstPushStatement>(
           arg,
           token.getLocation()
-        ));
+        );
       } else if (token.getValue() == "pop") {
         size_t num = 1; // 'pop' by default pops 1 value from stack
 
@@ -486,10 +522,10 @@ namespace bcparse {
           num = arg->getValue();
         }
 
-        return Pointer<AstPopStatement>(new AstPopStatement(
+        return makeNode<AstPopStatement>(
           num,
           token.getLocation()
-        ));
+        );
       } else if (std::find(AstBinOpStatement::binaryOperations.begin(), AstBinOpStatement::binaryOperations.end(), token.getValue()) != AstBinOpStatement::binaryOperations.end()) {
         auto left = parseExpression();
 
@@ -503,12 +539,12 @@ namespace bcparse {
           return nullptr;
         }
 
-        return Pointer<AstBinOpStatement>(new AstBinOpStatement(
+        return makeNode<AstBinOpStatement>(
           token.getValue(),
           left,
           right,
           token.getLocation()
-        ));
+        );
       } else if (token.getValue() == "call") {
         std::vector<Pointer<AstExpression>> arguments;
 
@@ -522,10 +558,49 @@ namespace bcparse {
           }
         }
 
-        return Pointer<AstCallStatement>(new AstCallStatement(
+        return makeNode<AstCallStatement>(
           arguments,
           token.getLocation()
+        );
+      } else if (token.getValue() == "getfield" || token.getValue() == "setfield"
+          || token.getValue() == "getslot" || token.getValue() == "setslot") {
+        // getfield dst obj key / setfield obj key value: a call of
+        // getObjectMember / setObjectMember, see AstCallStatement.
+        // getslot dst record slot / setslot record slot value: of getSlot /
+        // setSlot, the slot a constant of @struct's
+        const bool get = token.getValue() == "getfield" || token.getValue() == "getslot";
+        const bool slot = token.getValue() == "getslot" || token.getValue() == "setslot";
+        const int builtin = slot
+          ? (get ? BUILTIN_SYSTEM_GET_SLOT : BUILTIN_SYSTEM_SET_SLOT)
+          : (get ? BUILTIN_SYSTEM_GET_OBJECT_MEMBER : BUILTIN_SYSTEM_SET_OBJECT_MEMBER);
+        std::vector<Pointer<AstExpression>> arguments;
+        Pointer<AstExpression> result;
+
+        arguments.push_back(makeNode<AstDataLocation>(
+          "s",
+          makeNode<AstIntegerLiteral>(builtin, token.getLocation()),
+          token.getLocation()
         ));
+
+        if (get && !(result = parseExpression())) {
+          return nullptr;
+        }
+
+        for (int i = 0; i < (get ? 2 : 3); i++) {
+          auto arg = parseExpression();
+
+          if (!arg) {
+            return nullptr;
+          }
+
+          arguments.push_back(arg);
+        }
+
+        return makeNode<AstCallStatement>(
+          arguments,
+          result,
+          token.getLocation()
+        );
       } else if (token.getValue() == "print") {
         std::vector<Pointer<AstExpression>> arguments;
 
@@ -539,10 +614,77 @@ namespace bcparse {
           }
         }
 
-        return Pointer<AstPrintStatement>(new AstPrintStatement(
+        return makeNode<AstPrintStatement>(
           arguments,
           token.getLocation()
-        ));
+        );
+      } else if (token.getValue() == "spawn") {
+        auto left = parseExpression();
+
+        if (!left) {
+          return nullptr;
+        }
+
+        auto right = parseExpression();
+
+        if (!right) {
+          return nullptr;
+        }
+
+        return makeNode<AstFiberStatement>(
+          AstFiberStatement::Kind::Spawn,
+          left,
+          right,
+          token.getLocation()
+        );
+      } else if (token.getValue() == "join") {
+        auto arg = parseExpression();
+
+        if (!arg) {
+          return nullptr;
+        }
+
+        return makeNode<AstFiberStatement>(
+          AstFiberStatement::Kind::Join,
+          arg,
+          nullptr,
+          token.getLocation()
+        );
+      } else if (token.getValue() == "yield" || token.getValue() == "halt") {
+        return makeNode<AstFiberStatement>(
+          token.getValue() == "yield" ? AstFiberStatement::Kind::Yield : AstFiberStatement::Kind::Halt,
+          nullptr,
+          nullptr,
+          token.getLocation()
+        );
+      } else if (token.getValue() == "fcall") {
+        auto arg = parseExpression();
+
+        if (!arg) {
+          return nullptr;
+        }
+
+        return makeNode<AstFrameStatement>(
+          AstFrameStatement::Kind::Call,
+          arg,
+          token.getLocation()
+        );
+      } else if (token.getValue() == "ret") {
+        Pointer<AstExpression> arg; // no arguments to pop by default
+
+        if (match(Token::TK_INTEGER) || match(Token::TK_INTERPOLATION)) {
+          arg = parseExpression();
+
+          if (!arg) {
+            return nullptr;
+          }
+        }
+
+        return makeNode<AstFrameStatement>(
+          AstFrameStatement::Kind::Return,
+          arg,
+          token.getLocation()
+        );
       } else if (m_variableMode) {
         m_tokenStream->rewind();
 
@@ -585,10 +727,10 @@ namespace bcparse {
 
     lexer.analyze();
 
-    return Pointer<AstInterpolation>(new AstInterpolation(
+    return makeNode<AstInterpolation>(
       tokenStream.getTokens(),
       token.getLocation()
-    ));
+    );
   }
 
   Pointer<AstDataLocation> Parser::parseDataLocation() {
@@ -619,10 +761,10 @@ namespace bcparse {
           int64_t num;
           numVal >> num;
 
-          offset.reset(new AstIntegerLiteral(
+          offset = makeNode<AstIntegerLiteral>(
             num,
             token.getLocation()
-          ));
+          );
 
           break;
         }
@@ -630,11 +772,11 @@ namespace bcparse {
         ident << ch;
       }
 
-      return Pointer<AstDataLocation>(new AstDataLocation(
+      return makeNode<AstDataLocation>(
         ident.str(),
         offset,
         token.getLocation()
-      ));
+      );
     }
 
     m_compilationUnit->getErrorList().addError(CompilerError(
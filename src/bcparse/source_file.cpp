@@ -5,22 +5,83 @@
 #include <stdexcept>
 #include <cstring>
 
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
 namespace bcparse {
   SourceFile::SourceFile(const std::string &filepath, size_t size)
     : m_filepath(filepath),
       m_position(0),
-      m_size(size) {
+      m_size(size),
+      m_open(true),
+      m_mapped(false) {
     m_buffer = new char[m_size];
-    std::memset(m_buffer, '\0', m_size);
+  }
+
+  SourceFile::SourceFile(const std::string &filepath)
+    : m_filepath(filepath),
+      m_buffer(nullptr),
+      m_position(0),
+      m_size(0),
+      m_open(false),
+      m_mapped(false) {
+    struct stat st;
+    int fd = open(filepath.c_str(), O_RDONLY);
+
+    if (fd < 0) {
+      return;
+    }
+
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+      close(fd);
+      return;
+    }
+
+    m_open = true;
+    m_size = (size_t)st.st_size;
+
+    if (m_size != 0) {
+      void *data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+      if (data != MAP_FAILED) {
+        // read from start to end, once
+        madvise(data, m_size, MADV_SEQUENTIAL);
+
+        m_buffer = (char*)data;
+        m_mapped = true;
+      } else {
+        size_t done = 0;
+        ssize_t n = 0;
+
+        m_buffer = new char[m_size];
+
+        while (done < m_size && (n = read(fd, m_buffer + done, m_size - done)) > 0) {
+          done += (size_t)n;
+        }
+
+        // shorter than it was: what was read
+        m_size = done;
+      }
+    }
+
+    close(fd);
   }
 
   SourceFile::~SourceFile() {
-    delete[] m_buffer;
+    if (m_mapped) {
+      munmap(m_buffer, m_size);
+    } else {
+      delete[] m_buffer;
+    }
   }
 
   SourceFile &SourceFile::operator>>(const std::string &str) {
     size_t length = str.length();
 
+    ASSERT(!m_mapped);
+
     // make sure we have enough space in the buffer
     if (m_position + length >= m_size) {
       throw std::out_of_range("not enough space in buffer");
@@ -34,6 +95,7 @@ namespace bcparse {
   }
 
   void SourceFile::readIntoBuffer(const char *data, size_t size) {
+    ASSERT(!m_mapped);
     ASSERT(m_size >= size);
     std::memcpy(m_buffer, data, size);
   }
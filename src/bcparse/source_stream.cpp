@@ -6,19 +6,19 @@
 namespace bcparse {
   SourceStream::SourceStream(SourceFile *file)
     : m_file(file),
+      m_buffer(file->getBuffer()),
+      m_size(file->getSize()),
       m_position(0) {
   }
 
   SourceStream::SourceStream(const SourceStream &other)
     : m_file(other.m_file),
+      m_buffer(other.m_buffer),
+      m_size(other.m_size),
       m_position(other.m_position) {
   }
 
-  bool SourceStream::hasNext() const {
-    return m_position < m_file->getSize();
-  }
-
-  utf::u32char SourceStream::peek() const {
+  utf::u32char SourceStream::peekMultibyte() const {
     size_t pos = m_position;
 
     if (pos >= m_file->getSize()) {
@@ -38,35 +38,31 @@ namespace bcparse {
     if (uc >= 0 && uc <= 127) {
       // 1-byte character
       bytes[0] = ch;
-    } else if ((uc & 0xE0) == 0xC0) {
+    } else if ((uc & 0xE0) == 0xC0 && pos + 2 <= m_size) {
       // 2-byte character
       bytes[0] = ch;
       bytes[1] = m_file->getBuffer()[pos + 1];
-    } else if ((uc & 0xF0) == 0xE0) {
+    } else if ((uc & 0xF0) == 0xE0 && pos + 3 <= m_size) {
       // 3-byte character
       bytes[0] = ch;
       bytes[1] = m_file->getBuffer()[pos + 1];
       bytes[2] = m_file->getBuffer()[pos + 2];
-    } else if ((uc & 0xF8) == 0xF0) {
+    } else if ((uc & 0xF8) == 0xF0 && pos + 4 <= m_size) {
       // 4-byte character
       bytes[0] = ch;
       bytes[1] = m_file->getBuffer()[pos + 1];
       bytes[2] = m_file->getBuffer()[pos + 2];
       bytes[3] = m_file->getBuffer()[pos + 3];
     } else {
-      // invalid utf-8
+      // invalid utf-8, or cut off by the end of the file: a mapped one
+      // has nothing past it to read
       u32_ch = (utf::u32char)('\0');
     }
 
     return u32_ch;
   }
 
-  utf::u32char SourceStream::next() {
-    int tmp;
-    return next(tmp);
-  }
-
-  utf::u32char SourceStream::next(int &posChange) {
+  utf::u32char SourceStream::nextMultibyte(int &posChange) {
     int posBefore = m_position;
 
     if (m_position >= m_file->getSize()) {
@@ -86,23 +82,24 @@ namespace bcparse {
     if (uc >= 0 && uc <= 127) {
       // 1-byte character
       bytes[0] = ch;
-    } else if ((uc & 0xE0) == 0xC0) {
+    } else if ((uc & 0xE0) == 0xC0 && m_position + 1 <= m_size) {
       // 2-byte character
       bytes[0] = ch;
       bytes[1] = m_file->getBuffer()[m_position++];
-    } else if ((uc & 0xF0) == 0xE0) {
+    } else if ((uc & 0xF0) == 0xE0 && m_position + 2 <= m_size) {
       // 3-byte character
       bytes[0] = ch;
       bytes[1] = m_file->getBuffer()[m_position++];
       bytes[2] = m_file->getBuffer()[m_position++];
-    } else if ((uc & 0xF8) == 0xF0) {
+    } else if ((uc & 0xF8) == 0xF0 && m_position + 3 <= m_size) {
       // 4-byte character
       bytes[0] = ch;
       bytes[1] = m_file->getBuffer()[m_position++];
       bytes[2] = m_file->getBuffer()[m_position++];
       bytes[3] = m_file->getBuffer()[m_position++];
     } else {
-      // invalid utf-8
+      // invalid utf-8, or cut off by the end of the file: a mapped one
+      // has nothing past it to read
       u32_ch = (utf::u32char)('\0');
     }
 
@@ -58,7 +58,7 @@ namespace bcparse {
 
   Token::Token(TokenClass tokenClass, const std::string &value, const SourceLocation &location)
     : m_tokenClass(tokenClass),
-      m_value(value),
+      m_value(SymbolTable::intern(value)),
       m_location(location) {
   }
 
@@ -0,0 +1,141 @@
+#include <bcparse/token_cache.hpp>
+
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cstring>
+#include <cstdio>
+#include <thread>
+
+#include <unistd.h>
+#include <sys/stat.h>
+
+namespace bcparse {
+  static const char TOKEN_CACHE_MAGIC[4] = { 'B', 'B', '8', 'T' };
+
+  // fields are little endian
+  template <typename T>
+  static void writeField(std::ostream &os, T value) {
+    for (size_t i = 0; i < sizeof(T); i++) {
+      os.put((char)(((uint64_t)value >> (8 * i)) & 0xFF));
+    }
+  }
+
+  template <typename T>
+  static bool readField(std::istream &is, T &value) {
+    uint64_t v = 0;
+
+    for (size_t i = 0; i < sizeof(T); i++) {
+      int ch = is.get();
+
+      if (ch == EOF) {
+        return false;
+      }
+
+      v |= (uint64_t)(uint8_t)ch << (8 * i);
+    }
+
+    value = (T)v;
+
+    return true;
+  }
+
+  TokenCache::TokenCache(const std::string &dir)
+    : m_dir(dir) {
+    // if it exists already, this fails, and so it does if it cannot be
+    // made; then nothing is stored, and every lookup misses
+    mkdir(m_dir.c_str(), 0777);
+  }
+
+  std::string TokenCache::entryPath(uint64_t key) const {
+    std::stringstream ss;
+    ss << m_dir << "/" << std::hex << std::setw(16) << std::setfill('0') << key << ".bb8t";
+
+    return ss.str();
+  }
+
+  bool TokenCache::load(uint64_t key, size_t size, const std::string &filename, std::vector<Token> &out) const {
+    std::ifstream in(entryPath(key), std::ios::in | std::ios::binary);
+    char magic[4];
+    uint32_t version, count;
+    uint64_t contentSize;
+    std::vector<Token> tokens;
+
+    if (!in.is_open()) {
+      return false;
+    }
+
+    if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, TOKEN_CACHE_MAGIC, sizeof(magic)) != 0) {
+      return false;
+    }
+
+    if (!readField(in, version) || version != TOKEN_CACHE_VERSION) {
+      return false;
+    }
+
+    // a collision of the hash would rarely be one of the size too
+    if (!readField(in, contentSize) || contentSize != size || !readField(in, count)) {
+      return false;
+    }
+
+    tokens.reserve(count);
+
+    for (uint32_t i = 0; i < count; i++) {
+      uint8_t tokenClass;
+      int32_t line, column;
+      uint32_t length;
+
+      if (!readField(in, tokenClass) || !readField(in, line) || !readField(in, column) || !readField(in, length)) {
+        return false;
+      }
+
+      std::string value(length, '\0');
+
+      if (length != 0 && !in.read(&value[0], length)) {
+        return false;
+      }
+
+      tokens.push_back(Token(
+        (Token::TokenClass)tokenClass,
+        value,
+        SourceLocation(line, column, filename)
+      ));
+    }
+
+    out = std::move(tokens);
+
+    return true;
+  }
+
+  void TokenCache::store(uint64_t key, size_t size, const std::vector<Token> &tokens) const {
+    const std::string path = entryPath(key);
+    std::stringstream tmp;
+    // unique to the writer, which may be one of --build's threads
+    tmp << path << "." << getpid() << "." << std::this_thread::get_id() << ".tmp";
+
+    std::ofstream of(tmp.str(), std::ios::out | std::ios::binary);
+
+    if (!of.is_open()) {
+      return; // the cache is an optimization; compiling goes on without it
+    }
+
+    of.write(TOKEN_CACHE_MAGIC, sizeof(TOKEN_CACHE_MAGIC));
+    writeField(of, TOKEN_CACHE_VERSION);
+    writeField(of, (uint64_t)size);
+    writeField(of, (uint32_t)tokens.size());
+
+    for (const Token &token : tokens) {
+      writeField(of, (uint8_t)token.getTokenClass());
+      writeField(of, (int32_t)token.getLocation().getLine());
+      writeField(of, (int32_t)token.getLocation().getColumn());
+      writeField(of, (uint32_t)token.getValue().size());
+      of.write(token.getValue().data(), token.getValue().size());
+    }
+
+    of.close();
+
+    if (!of || std::rename(tmp.str().c_str(), path.c_str()) != 0) {
+      std::remove(tmp.str().c_str());
+    }
+  }
+}
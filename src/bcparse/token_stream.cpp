@@ -1,8 +1,30 @@
 #include <bcparse/token_stream.hpp>
 
 namespace bcparse {
+  // how many tokens a pulled stream lets pile up behind its position
+  // before dropping them
+  static const size_t maxConsumed = 4096;
+
   TokenStream::TokenStream(const TokenStreamInfo &info)
     : m_position(0),
-      m_info(info) {
+      m_info(info),
+      m_source(nullptr),
+      m_offset(0) {
+  }
+
+  Token TokenStream::next() {
+    ASSERT(hasNext());
+
+    Token token = m_tokens[m_position++ - m_offset];
+
+    // a pushed stream is kept whole, for getTokens()
+    if (m_source != nullptr && m_position - m_offset >= maxConsumed + lookbehind) {
+      const size_t drop = m_position - m_offset - lookbehind;
+
+      m_tokens.erase(m_tokens.begin(), m_tokens.begin() + drop);
+      m_offset += drop;
+    }
+
+    return token;
   }
 }
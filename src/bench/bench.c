@@ -0,0 +1,943 @@
+// the runner of the `bench` target: runs compiled programs in process,
+// each on a runtime of its own, and reports how long a run takes.
+//
+//   vmbench [--runs <n>] [--warmup <n>] [--perf-counters]
+//           [--save <file> | --baseline <file> | --against <vmbench> [--rounds <n>]]
+//           [--threshold <percent>] <file>...
+//
+// a program is run `warmup` times first, for its caches, feedback and
+// compiled code, then timed `runs` times with interpreter_reset between
+// runs (the reset is not timed). what it prints is thrown away. the
+// instructions of a run are counted once more after that, with
+// interpreter_profileOpcodes, which runs everything in the interpreter;
+// instructions per second are that count over the median time, so that
+// compiled code shows as the instructions it stands in for.
+//
+// with --perf-counters, the hardware counters of the timed runs are
+// printed after each line, per bytecode instruction of that count.
+//
+// startup is timed too, `runs` times each: loading the program
+// (program_create), an instance of it (embed_create: the runtime, its
+// datatable, the decoding) and, once for all, datatable_create on its
+// own; and the peak resident set of the process is taken at the end.
+//
+// the regression gate: --save writes each sample taken -- of the times,
+// the instructions per second, the counters, the startup and the peak
+// RSS -- to <file> ("-" for stdout, the table left out), as a baseline.
+// --baseline compares a run with one; --against runs this build's
+// vmbench and another's, each with --save -, in `rounds` rounds, each
+// round running them one after the other, in turn first (ABBA), so that
+// drift of the machine falls on both. a change is the ratio of the
+// geometric means, with its 95% confidence interval: Welch's, on the log
+// of the samples, against a baseline; paired, on the log of the rounds'
+// ratios, A/B. a time or a resident set that is slower by more than
+// --threshold percent (BENCH_DEFAULT_THRESHOLD) with an interval all
+// above zero is a regression, and the exit status is a failure.
+
+#include <vm/embed.h>
+#include <vm/perf.h>
+#include <vm/datatable.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+  #define BENCH_POSIX 1
+  #include <unistd.h>
+  #include <sys/types.h>
+  #include <sys/wait.h>
+  #include <sys/resource.h>
+#else
+  #define BENCH_POSIX 0
+#endif
+
+#if defined(_WIN32)
+  #define BENCH_NULL_DEVICE "NUL"
+#else
+  #define BENCH_NULL_DEVICE "/dev/null"
+#endif
+
+#define BENCH_DEFAULT_RUNS 10
+#define BENCH_DEFAULT_WARMUP 2
+#define BENCH_DEFAULT_ROUNDS 6
+#define BENCH_DEFAULT_THRESHOLD 3.0 // percent
+#define BENCH_FORMAT "# vmbench 1" // the first line of a --save file
+
+static FILE *bench_sink = NULL;
+static bool bench_perf = false;
+
+// ===== samples =====
+
+typedef enum {
+  BENCH_NS, // lower is better, and gated
+  BENCH_KB, // likewise
+  BENCH_RATE, // higher is better
+  BENCH_COUNT, // lower is better
+  BENCH_UNITS
+} bench_unit_t;
+
+static const char *const bench_unitNames[BENCH_UNITS] = { "ns", "kb", "rate", "count" };
+
+static const char *const bench_counterNames[PERF_COUNTERS] = {
+  "cycles", "instructions", "branch-misses", "l1d-misses", "llc-misses"
+};
+
+// the samples of one thing measured: "<benchmark>" for its runs' times,
+// "<benchmark>.<what>" for the rest, see bench_run
+typedef struct bench_metric {
+  char name[96];
+  bench_unit_t unit;
+  double *values;
+  size_t count;
+} bench_metric_t;
+
+typedef struct bench_results {
+  bench_metric_t *metrics;
+  size_t count;
+  size_t cap;
+} bench_results_t;
+
+static bench_metric_t *bench_find(const bench_results_t *r, const char *name) {
+  for (size_t i = 0; i < r->count; i++) {
+    if (strcmp(r->metrics[i].name, name) == 0) {
+      return &r->metrics[i];
+    }
+  }
+
+  return NULL;
+}
+
+// a copy of the `count` values, as `name`
+static void bench_add(bench_results_t *r, const char *name, bench_unit_t unit, const double *values, size_t count) {
+  bench_metric_t *m;
+
+  if (r->count == r->cap) {
+    r->cap = r->cap != 0 ? r->cap * 2 : 64;
+    r->metrics = (bench_metric_t*)realloc(r->metrics, sizeof(bench_metric_t) * r->cap);
+  }
+
+  m = &r->metrics[r->count++];
+  snprintf(m->name, sizeof(m->name), "%s", name);
+  m->unit = unit;
+  m->count = count;
+  m->values = (double*)malloc(sizeof(double) * (count != 0 ? count : 1));
+  memcpy(m->values, values, sizeof(double) * count);
+}
+
+static void bench_freeResults(bench_results_t *r) {
+  for (size_t i = 0; i < r->count; i++) {
+    free(r->metrics[i].values);
+  }
+
+  free(r->metrics);
+  memset(r, 0, sizeof(*r));
+}
+
+// a line per metric: "<name> <unit> <count> <value>..."
+static void bench_write(const bench_results_t *r, FILE *f) {
+  fprintf(f, "%s\n", BENCH_FORMAT);
+
+  for (size_t i = 0; i < r->count; i++) {
+    const bench_metric_t *m = &r->metrics[i];
+
+    fprintf(f, "%s %s %zu", m->name, bench_unitNames[m->unit], m->count);
+
+    for (size_t j = 0; j < m->count; j++) {
+      fprintf(f, " %.17g", m->values[j]);
+    }
+
+    fprintf(f, "\n");
+  }
+}
+
+// what bench_write wrote, added to `r`. false, after printing why, if
+// it is not that
+static bool bench_load(FILE *f, const char *what, bench_results_t *r) {
+  char line[256];
+  double *values = NULL;
+  size_t cap = 0;
+  bool ok = fgets(line, sizeof(line), f) != NULL && strncmp(line, BENCH_FORMAT, strlen(BENCH_FORMAT)) == 0;
+
+  while (ok) {
+    char name[96], unit[16];
+    size_t count;
+    int u;
+
+    if (fscanf(f, "%95s %15s %zu", name, unit, &count) != 3) {
+      ok = feof(f);
+      break;
+    }
+
+    for (u = 0; u < BENCH_UNITS && strcmp(unit, bench_unitNames[u]) != 0; u++) {
+    }
+
+    if (u == BENCH_UNITS) {
+      ok = false;
+      break;
+    }
+
+    if (count > cap) {
+      cap = count;
+      values = (double*)realloc(values, sizeof(double) * cap);
+    }
+
+    for (size_t j = 0; j < count && ok; j++) {
+      ok = fscanf(f, "%lf", &values[j]) == 1;
+    }
+
+    if (ok) {
+      bench_add(r, name, (bench_unit_t)u, values, count);
+    }
+  }
+
+  if (!ok) {
+    fprintf(stderr, "%s: not a vmbench --save file\n", what);
+  }
+
+  free(values);
+
+  return ok;
+}
+
+// ===== running =====
+
+// an instance of the program, its prints thrown away
+static embed_t *bench_open(program_t *program) {
+  embed_t *e = embed_create(program);
+
+  e->rt->output.fp = bench_sink;
+  e->rt->output.mode = OUTPUT_MODE_BLOCK;
+
+  return e;
+}
+
+// the file's bytes, NULL after printing why if it cannot be read
+static uint8_t *bench_read(const char *path, size_t *len) {
+  FILE *f = fopen(path, "rb");
+  uint8_t *data = NULL;
+  long size;
+
+  if (f == NULL || fseek(f, 0, SEEK_END) != 0 || (size = ftell(f)) < 0 || fseek(f, 0, SEEK_SET) != 0
+      || (data = (uint8_t*)malloc((size_t)size + 1)) == NULL || fread(data, 1, (size_t)size, f) != (size_t)size) {
+    fprintf(stderr, "could not read %s\n", path);
+    free(data);
+    data = NULL;
+  }
+
+  if (f != NULL) {
+    fclose(f);
+  }
+
+  *len = data != NULL ? (size_t)size : 0;
+
+  return data;
+}
+
+static int bench_compare(const void *a, const void *b) {
+  uint64_t l = *(const uint64_t*)a, r = *(const uint64_t*)b;
+
+  return l < r ? -1 : (l > r);
+}
+
+static uint64_t bench_median(uint64_t *nanos, size_t count) {
+  qsort(nanos, count, sizeof(uint64_t), bench_compare);
+
+  return count % 2 != 0 ? nanos[count / 2] : (nanos[count / 2 - 1] + nanos[count / 2]) / 2;
+}
+
+// the file name without its directory and extension
+static void bench_name(const char *path, char *out, size_t size) {
+  const char *base = strrchr(path, '/');
+  size_t len;
+
+  base = base != NULL ? base + 1 : path;
+  len = strcspn(base, ".");
+
+  snprintf(out, size, "%.*s", (int)len, base);
+}
+
+static void bench_addNanos(bench_results_t *r, const char *name, const uint64_t *nanos, size_t count) {
+  double *values = (double*)malloc(sizeof(double) * count);
+
+  for (size_t i = 0; i < count; i++) {
+    values[i] = (double)nanos[i];
+  }
+
+  bench_add(r, name, BENCH_NS, values, count);
+  free(values);
+}
+
+// program_create and embed_create of the program, `runs` times each, as
+// "<name>.load" and "<name>.startup"; their medians to `load` and `startup`
+static void bench_startup(const char *name, const uint8_t *data, size_t len, size_t runs,
+                          bench_results_t *r, uint64_t *load, uint64_t *startup) {
+  uint64_t *nanos = (uint64_t*)malloc(sizeof(uint64_t) * runs);
+  char metric[96];
+
+  for (size_t i = 0; i < runs; i++) {
+    const char *error;
+    uint64_t start = runtime_nowNs();
+    program_t *program = program_create(data, len, &error);
+
+    nanos[i] = runtime_nowNs() - start;
+    program_release(program);
+  }
+
+  snprintf(metric, sizeof(metric), "%s.load", name);
+  bench_addNanos(r, metric, nanos, runs);
+  *load = bench_median(nanos, runs);
+
+  {
+    const char *error;
+    program_t *program = program_create(data, len, &error);
+
+    for (size_t i = 0; i < runs; i++) {
+      uint64_t start = runtime_nowNs();
+      embed_t *e = bench_open(program);
+
+      nanos[i] = runtime_nowNs() - start;
+      embed_destroy(e);
+    }
+
+    program_release(program);
+  }
+
+  snprintf(metric, sizeof(metric), "%s.startup", name);
+  bench_addNanos(r, metric, nanos, runs);
+  *startup = bench_median(nanos, runs);
+
+  free(nanos);
+}
+
+// runs the program at `path`, adds its samples to `r` and, if `table`,
+// prints a line of the table for it. false, after printing why, if it
+// cannot be loaded.
+static bool bench_run(const char *path, size_t runs, size_t warmup, bench_results_t *r, bool table) {
+  embed_t *e;
+  const char *error = NULL;
+  program_t *program;
+  uint64_t *nanos, instructions = 0, load, startup;
+  uint64_t (*counts)[PERF_COUNTERS] = NULL; // per timed run
+  perf_t *perf = NULL;
+  uint8_t *data;
+  double *values;
+  size_t len;
+  char name[64], metric[96];
+
+  if ((data = bench_read(path, &len)) == NULL) {
+    return false;
+  }
+
+  if ((program = program_create(data, len, &error)) == NULL) {
+    fprintf(stderr, "%s: %s\n", path, error);
+    free(data);
+    return false;
+  }
+
+  nanos = (uint64_t*)malloc(sizeof(uint64_t) * runs);
+  values = (double*)malloc(sizeof(double) * runs);
+  e = bench_open(program);
+
+  if (bench_perf && (perf = perf_open()) != NULL) {
+    counts = (uint64_t(*)[PERF_COUNTERS])malloc(sizeof(*counts) * runs);
+  }
+
+  for (size_t i = 0; i < warmup + runs; i++) {
+    uint64_t before[PERF_COUNTERS];
+    uint64_t start;
+
+    if (i != 0) {
+      embed_reset(e);
+    }
+
+    if (perf != NULL && i >= warmup) {
+      memcpy(before, perf->counts, sizeof(before));
+      perf_start(perf);
+    }
+
+    start = runtime_nowNs();
+    embed_run(e);
+
+    if (i >= warmup) {
+      nanos[i - warmup] = runtime_nowNs() - start;
+    }
+
+    if (perf != NULL && i >= warmup) {
+      perf_stop(perf);
+
+      for (int c = 0; c < PERF_COUNTERS; c++) {
+        counts[i - warmup][c] = perf->counts[c] - before[c];
+      }
+    }
+  }
+
+  embed_destroy(e);
+
+  // counted on a fresh runtime: the profiled loop is kept from then on
+  e = bench_open(program);
+  interpreter_profileOpcodes(e->it);
+  embed_run(e);
+
+  for (size_t op = 0; op < CODE_OP_COUNT; op++) {
+    for (size_t flags = 0; flags < 256; flags++) {
+      instructions += e->it->opcodes->counts[op][flags];
+    }
+  }
+
+  embed_destroy(e);
+  program_release(program);
+
+  bench_name(path, name, sizeof(name));
+  bench_addNanos(r, name, nanos, runs);
+
+  if (instructions != 0) {
+    for (size_t i = 0; i < runs; i++) {
+      values[i] = nanos[i] != 0 ? (double)instructions / ((double)nanos[i] / 1e9) : 0.0;
+    }
+
+    snprintf(metric, sizeof(metric), "%s.ips", name);
+    bench_add(r, metric, BENCH_RATE, values, runs);
+  }
+
+  for (int c = 0; counts != NULL && c < PERF_COUNTERS; c++) {
+    if (perf->fds[c] < 0) {
+      continue;
+    }
+
+    for (size_t i = 0; i < runs; i++) {
+      values[i] = (double)counts[i][c];
+    }
+
+    snprintf(metric, sizeof(metric), "%s.%s", name, bench_counterNames[c]);
+    bench_add(r, metric, BENCH_COUNT, values, runs);
+  }
+
+  bench_startup(name, data, len, runs, r, &load, &startup);
+
+  if (table) {
+    uint64_t median = bench_median(nanos, runs);
+    uint64_t p95 = nanos[(runs * 95 + 99) / 100 - 1];
+
+    printf("  %-16s %6zu %12.3f %12.3f %12.3f %14llu %12.1f %10.1f %10.1f\n", name, runs,
+      median / 1e6, p95 / 1e6, nanos[0] / 1e6, (unsigned long long)instructions,
+      median != 0 ? (double)instructions / ((double)median / 1e9) / 1e6 : 0.0,
+      load / 1e3, startup / 1e3);
+
+    if (perf != NULL) {
+      perf_write(perf, stdout, instructions * runs);
+    }
+  }
+
+  if (perf != NULL) {
+    perf_close(perf);
+  }
+
+  free(counts);
+  free(values);
+  free(nanos);
+  free(data);
+
+  return true;
+}
+
+// datatable_create and datatable_destroy at the default sizes, as a
+// runtime has them, `runs` times, as "datatable"; the median to `median`
+static void bench_datatable(size_t runs, bench_results_t *r, uint64_t *median) {
+  uint64_t *nanos = (uint64_t*)malloc(sizeof(uint64_t) * runs);
+  runtime_t *rt = runtime_create(); // for datatable_destroy
+
+  for (size_t i = 0; i < runs; i++) {
+    uint64_t start = runtime_nowNs();
+    datatable_t *dt = datatable_create(STATIC_DATA_COUNT, STACK_COUNT);
+
+    datatable_destroy(rt, dt);
+    nanos[i] = runtime_nowNs() - start;
+  }
+
+  runtime_destroy(rt);
+
+  bench_addNanos(r, "datatable", nanos, runs);
+  *median = bench_median(nanos, runs);
+  free(nanos);
+}
+
+// the process's peak resident set, as "peak-rss", in KB (0 where unknown)
+static long bench_peakRss(bench_results_t *r) {
+  long kb = 0;
+
+#if BENCH_POSIX
+  struct rusage usage;
+
+  if (getrusage(RUSAGE_SELF, &usage) == 0) {
+    kb = usage.ru_maxrss;
+#if defined(__APPLE__)
+    kb /= 1024; // bytes there
+#endif
+  }
+#endif
+
+  if (kb != 0) {
+    double value = (double)kb;
+
+    bench_add(r, "peak-rss", BENCH_KB, &value, 1);
+  }
+
+  return kb;
+}
+
+// ===== comparing =====
+
+// the 97.5th percentile of Student's t with `df` degrees of freedom
+static double bench_t975(double df) {
+  static const double table[30] = {
+    12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+    2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+    2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+  };
+
+  if (df < 1) {
+    return table[0];
+  }
+
+  return df <= 30 ? table[(int)df - 1] : 1.960 + 2.5 / df;
+}
+
+static bool bench_positive(const double *values, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    if (!(values[i] > 0)) {
+      return false;
+    }
+  }
+
+  return count != 0;
+}
+
+static void bench_logMoments(const double *values, size_t count, double *mean, double *var) {
+  double sum = 0, sq = 0;
+
+  for (size_t i = 0; i < count; i++) {
+    sum += log(values[i]);
+  }
+
+  *mean = sum / (double)count;
+
+  for (size_t i = 0; i < count; i++) {
+    sq += (log(values[i]) - *mean) * (log(values[i]) - *mean);
+  }
+
+  *var = count > 1 ? sq / (double)(count - 1) : 0.0;
+}
+
+// a metric as measured on each side: `base` and `new` are what is shown,
+// `diff` the mean log ratio with `half`, the half width of its interval
+// (< 0 for none)
+typedef struct bench_change {
+  double base;
+  double new;
+  double diff;
+  double half;
+} bench_change_t;
+
+// of a baseline's samples and a run's: Welch's interval
+static bool bench_unpaired(const bench_metric_t *a, const bench_metric_t *b, bench_change_t *out) {
+  double ma, va, mb, vb, se;
+
+  if (!bench_positive(a->values, a->count) || !bench_positive(b->values, b->count)) {
+    return false;
+  }
+
+  bench_logMoments(a->values, a->count, &ma, &va);
+  bench_logMoments(b->values, b->count, &mb, &vb);
+
+  out->base = exp(ma);
+  out->new = exp(mb);
+  out->diff = mb - ma;
+  out->half = -1;
+
+  if (a->count > 1 && b->count > 1 && (se = sqrt(va / a->count + vb / b->count)) > 0) {
+    const double qa = va / a->count, qb = vb / b->count;
+    const double df = (qa + qb) * (qa + qb) / (qa * qa / (a->count - 1) + qb * qb / (b->count - 1));
+
+    out->half = bench_t975(floor(df)) * se;
+  } else if (a->count > 1 && b->count > 1) {
+    out->half = 0;
+  }
+
+  return true;
+}
+
+// of rounds: the geometric mean of each side's samples in each, and the
+// paired interval of their log ratios
+static bool bench_paired(const double *base, const double *new, size_t rounds, bench_change_t *out) {
+  double mb, vb, mn, vn, sum = 0, sq = 0;
+
+  if (!bench_positive(base, rounds) || !bench_positive(new, rounds)) {
+    return false;
+  }
+
+  bench_logMoments(base, rounds, &mb, &vb);
+  bench_logMoments(new, rounds, &mn, &vn);
+
+  for (size_t i = 0; i < rounds; i++) {
+    sum += log(new[i] / base[i]);
+  }
+
+  out->base = exp(mb);
+  out->new = exp(mn);
+  out->diff = sum / (double)rounds;
+  out->half = -1;
+
+  if (rounds > 1) {
+    for (size_t i = 0; i < rounds; i++) {
+      double d = log(new[i] / base[i]) - out->diff;
+
+      sq += d * d;
+    }
+
+    out->half = bench_t975((double)(rounds - 1)) * sqrt(sq / (double)(rounds - 1) / (double)rounds);
+  }
+
+  return true;
+}
+
+static void bench_format(char *out, size_t size, bench_unit_t unit, double value) {
+  switch (unit) {
+    case BENCH_NS:
+      if (value >= 1e6) {
+        snprintf(out, size, "%.3f ms", value / 1e6);
+      } else {
+        snprintf(out, size, "%.1f us", value / 1e3);
+      }
+      break;
+    case BENCH_KB:
+      snprintf(out, size, "%.1f MB", value / 1024.0);
+      break;
+    case BENCH_RATE:
+      snprintf(out, size, "%.1f M/s", value / 1e6);
+      break;
+    default:
+      snprintf(out, size, "%.4g", value);
+      break;
+  }
+}
+
+// prints a line for the change of `m`; true if it is a regression
+static bool bench_report(const bench_metric_t *m, const bench_change_t *c, double threshold) {
+  const bool higherBetter = m->unit == BENCH_RATE;
+  const bool gated = m->unit == BENCH_NS || m->unit == BENCH_KB;
+  const double change = (exp(c->diff) - 1) * 100;
+  // positive when worse
+  const double worse = higherBetter ? -c->diff : c->diff;
+  const char *verdict = "";
+  char base[32], new[32], interval[48];
+  bool regression = false;
+
+  bench_format(base, sizeof(base), m->unit, c->base);
+  bench_format(new, sizeof(new), m->unit, c->new);
+
+  if (c->half >= 0) {
+    snprintf(interval, sizeof(interval), "[%+.1f%%, %+.1f%%]",
+      (exp(c->diff - c->half) - 1) * 100, (exp(c->diff + c->half) - 1) * 100);
+
+    if (worse - c->half > 0) {
+      verdict = "worse";
+      regression = gated && fabs(change) > threshold;
+    } else if (worse + c->half < 0) {
+      verdict = "better";
+    }
+  } else {
+    // one sample a side, the resident set against a baseline
+    snprintf(interval, sizeof(interval), "-");
+    regression = gated && worse > 0 && fabs(change) > threshold;
+    verdict = regression ? "worse" : "";
+  }
+
+  printf("  %-28s %14s %14s %+8.1f%% %-20s %s\n", m->name, base, new, change, interval,
+    regression ? "REGRESSION" : verdict);
+
+  return regression;
+}
+
+static void bench_reportHeader(const char *title) {
+  printf("%s\n  %-28s %14s %14s %9s %-20s\n", title, "metric", "base", "new", "change", "95% CI");
+}
+
+// a run against a --save file; true if there is no regression
+static bool bench_compareBaseline(const bench_results_t *base, const bench_results_t *run, double threshold) {
+  bool ok = true;
+
+  bench_reportHeader("against the baseline:");
+
+  for (size_t i = 0; i < run->count; i++) {
+    const bench_metric_t *m = &run->metrics[i];
+    const bench_metric_t *b = bench_find(base, m->name);
+    bench_change_t c;
+
+    if (b != NULL && bench_unpaired(b, m, &c)) {
+      ok = !bench_report(m, &c, threshold) && ok;
+    }
+  }
+
+  return ok;
+}
+
+#if BENCH_POSIX
+
+// runs `exe` with `args` and --save -, its samples to `r`. false, after
+// printing why, if it failed
+static bool bench_child(const char *exe, char **args, bench_results_t *r) {
+  int fds[2], status;
+  bool ok;
+  pid_t pid;
+  FILE *f;
+
+  if (pipe(fds) != 0 || (pid = fork()) < 0) {
+    perror(exe);
+    return false;
+  }
+
+  if (pid == 0) {
+    close(fds[0]);
+    dup2(fds[1], STDOUT_FILENO);
+    close(fds[1]);
+
+    args[0] = (char*)exe;
+    execv(exe, args);
+    _exit(127);
+  }
+
+  close(fds[1]);
+  f = fdopen(fds[0], "r");
+  ok = bench_load(f, exe, r);
+  fclose(f);
+
+  if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    fprintf(stderr, "%s: failed\n", exe);
+    ok = false;
+  }
+
+  return ok;
+}
+
+static double bench_geomean(const bench_metric_t *m) {
+  double mean, var;
+
+  if (!bench_positive(m->values, m->count)) {
+    return 0;
+  }
+
+  bench_logMoments(m->values, m->count, &mean, &var);
+
+  return exp(mean);
+}
+
+// this build (`self`) against the one of `other`, in `rounds` interleaved
+// rounds, each running both with `args`; true if there is no regression
+static bool bench_compareAgainst(const char *self, const char *other, char **args, size_t rounds, double threshold) {
+  bench_results_t *sides[2]; // base, new; a result per round
+  double *base, *new;
+  bool ok = true;
+
+  sides[0] = (bench_results_t*)calloc(rounds, sizeof(bench_results_t));
+  sides[1] = (bench_results_t*)calloc(rounds, sizeof(bench_results_t));
+
+  for (size_t i = 0; i < rounds && ok; i++) {
+    const int first = (int)(i % 2);
+
+    fprintf(stderr, "round %zu of %zu\n", i + 1, rounds);
+
+    ok = bench_child(first == 0 ? other : self, args, &sides[first][i])
+      && bench_child(first == 0 ? self : other, args, &sides[1 - first][i]);
+  }
+
+  base = (double*)malloc(sizeof(double) * rounds);
+  new = (double*)malloc(sizeof(double) * rounds);
+
+  if (ok) {
+    bench_reportHeader("A/B, geometric means of the rounds:");
+  }
+
+  for (size_t j = 0; ok && j < sides[1][0].count; j++) {
+    const bench_metric_t *m = &sides[1][0].metrics[j];
+    bench_change_t c;
+    bool all = true;
+
+    for (size_t i = 0; i < rounds && all; i++) {
+      const bench_metric_t *b = bench_find(&sides[0][i], m->name);
+      const bench_metric_t *n = bench_find(&sides[1][i], m->name);
+
+      if ((all = b != NULL && n != NULL)) {
+        base[i] = bench_geomean(b);
+        new[i] = bench_geomean(n);
+      }
+    }
+
+    if (all && bench_paired(base, new, rounds, &c)) {
+      ok = !bench_report(m, &c, threshold) && ok;
+    }
+  }
+
+  free(base);
+  free(new);
+
+  for (size_t i = 0; i < rounds; i++) {
+    bench_freeResults(&sides[0][i]);
+    bench_freeResults(&sides[1][i]);
+  }
+
+  free(sides[0]);
+  free(sides[1]);
+
+  return ok;
+}
+
+#endif
+
+static void bench_usage(const char *argv0) {
+  fprintf(stderr, "Arguments: %s [--runs <n>] [--warmup <n>] [--perf-counters] "
+    "[--save <file> | --baseline <file> | --against <vmbench> [--rounds <n>]] [--threshold <percent>] <file>...\n", argv0);
+}
+
+int main(int argc, char *argv[]) {
+  size_t runs = BENCH_DEFAULT_RUNS, warmup = BENCH_DEFAULT_WARMUP, rounds = BENCH_DEFAULT_ROUNDS;
+  double threshold = BENCH_DEFAULT_THRESHOLD;
+  const char *savePath = NULL, *baselinePath = NULL, *against = NULL;
+  bench_results_t results = { 0 };
+  uint64_t datatable;
+  long peakRss;
+  bool ok = true, table;
+  int first = 1;
+
+  for (; first < argc && strncmp(argv[first], "--", 2) == 0; first++) {
+    if (strcmp(argv[first], "--runs") == 0 && first + 1 < argc && atoi(argv[first + 1]) > 0) {
+      runs = (size_t)atoi(argv[++first]);
+    } else if (strcmp(argv[first], "--warmup") == 0 && first + 1 < argc) {
+      warmup = (size_t)atoi(argv[++first]);
+    } else if (strcmp(argv[first], "--perf-counters") == 0) {
+      bench_perf = true;
+    } else if (strcmp(argv[first], "--save") == 0 && first + 1 < argc) {
+      savePath = argv[++first];
+    } else if (strcmp(argv[first], "--baseline") == 0 && first + 1 < argc) {
+      baselinePath = argv[++first];
+    } else if (strcmp(argv[first], "--against") == 0 && first + 1 < argc) {
+      against = argv[++first];
+    } else if (strcmp(argv[first], "--rounds") == 0 && first + 1 < argc && atoi(argv[first + 1]) > 0) {
+      rounds = (size_t)atoi(argv[++first]);
+    } else if (strcmp(argv[first], "--threshold") == 0 && first + 1 < argc) {
+      threshold = atof(argv[++first]);
+    } else {
+      break;
+    }
+  }
+
+  if (first >= argc || strncmp(argv[first], "--", 2) == 0
+      || (savePath != NULL) + (baselinePath != NULL) + (against != NULL) > 1) {
+    bench_usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  if (against != NULL) {
+#if BENCH_POSIX
+    // the children's arguments: the options that apply to a run, then
+    // --save - and the files
+    char **args = (char**)calloc((size_t)argc + 8, sizeof(char*));
+    char self[4096], runsArg[32], warmupArg[32];
+    ssize_t len = readlink("/proc/self/exe", self, sizeof(self) - 1);
+    int n = 1;
+
+    if (len > 0) {
+      self[len] = '\0';
+    } else {
+      snprintf(self, sizeof(self), "%s", argv[0]);
+    }
+
+    snprintf(runsArg, sizeof(runsArg), "%zu", runs);
+    snprintf(warmupArg, sizeof(warmupArg), "%zu", warmup);
+
+    args[n++] = (char*)"--runs";
+    args[n++] = runsArg;
+    args[n++] = (char*)"--warmup";
+    args[n++] = warmupArg;
+
+    if (bench_perf) {
+      args[n++] = (char*)"--perf-counters";
+    }
+
+    args[n++] = (char*)"--save";
+    args[n++] = (char*)"-";
+
+    for (int i = first; i < argc; i++) {
+      args[n++] = argv[i];
+    }
+
+    ok = bench_compareAgainst(self, against, args, rounds, threshold);
+    free(args);
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+#else
+    fprintf(stderr, "--against: not on this platform\n");
+    return EXIT_FAILURE;
+#endif
+  }
+
+  if ((bench_sink = fopen(BENCH_NULL_DEVICE, "w")) == NULL) {
+    bench_sink = stdout;
+  }
+
+  // with --save -, stdout is the samples
+  table = savePath == NULL || strcmp(savePath, "-") != 0;
+
+  if (table) {
+    printf("  %-16s %6s %12s %12s %12s %14s %12s %10s %10s\n",
+      "benchmark", "runs", "median ms", "p95 ms", "min ms", "instructions", "Minstr/s", "load us", "start us");
+  }
+
+  for (int i = first; i < argc; i++) {
+    ok = bench_run(argv[i], runs, warmup, &results, table) && ok;
+    fflush(stdout);
+  }
+
+  bench_datatable(runs, &results, &datatable);
+  peakRss = bench_peakRss(&results);
+
+  if (table) {
+    printf("  datatable_create %.1f us, peak RSS %.1f MB\n", datatable / 1e3, peakRss / 1024.0);
+  }
+
+  if (savePath != NULL && ok) {
+    FILE *f = table ? fopen(savePath, "w") : stdout;
+
+    if (f == NULL) {
+      perror(savePath);
+      ok = false;
+    } else {
+      bench_write(&results, f);
+
+      if (f != stdout) {
+        fclose(f);
+      }
+    }
+  }
+
+  if (baselinePath != NULL && ok) {
+    bench_results_t base = { 0 };
+    FILE *f = fopen(baselinePath, "r");
+
+    if (f == NULL) {
+      perror(baselinePath);
+      ok = false;
+    } else {
+      ok = bench_load(f, baselinePath, &base) && bench_compareBaseline(&base, &results, threshold);
+      fclose(f);
+    }
+
+    bench_freeResults(&base);
+  }
+
+  bench_freeResults(&results);
+
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
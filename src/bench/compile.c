@@ -0,0 +1,280 @@
+// the runner of the `compilebench` target: generates .bb8 programs of
+// growing size, each stressing one part of the compiler, and times
+// bcparse on them.
+//
+//   bcparsebench [--runs <n>] [--sizes <n>,<n>...] [--dir <dir>] <bcparse>
+//
+// a program is compiled `runs` times in a child process; the median wall
+// time is reported along with the child's peak resident set. the
+// exponent is how the time grew against the size from the size before
+// it: about 1 for a linear cost, about 2 for a quadratic one. the
+// @include shape takes an eighth of each size, an @include standing
+// for a file's worth of work.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+#define COMPILE_DEFAULT_RUNS 3
+#define COMPILE_MAX_SIZES 16
+#define COMPILE_MAX_RUNS 64
+#define COMPILE_NESTING 4 // of the macro instantiations
+
+typedef struct compile_shape {
+  const char *name;
+  const char *unit; // what `size` counts
+  size_t divisor; // of the sizes given, for the shapes that cost more per unit
+  void (*generate)(FILE *f, const char *dir, size_t size);
+} compile_shape_t;
+
+static uint64_t compile_nowNs(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// ===== generators =====
+
+// labels, each jumped to from the one before: the label table and the
+// fixups of forward references
+static void compile_labels(FILE *f, const char *dir, size_t size) {
+  (void)dir;
+
+  for (size_t i = 0; i < size; i++) {
+    fprintf(f, "label%zu:\n  add $r[0] 1\n  jmp #{label%zu}\n", i, i + 1);
+  }
+
+  fprintf(f, "label%zu:\n  print $r[0]\n", size);
+}
+
+// distinct static strings, each put in the data storage
+static void compile_strings(FILE *f, const char *dir, size_t size) {
+  (void)dir;
+
+  for (size_t i = 0; i < size; i++) {
+    fprintf(f, "mov $r[1] \"string number %zu\"\n", i);
+  }
+}
+
+// instantiations of a macro within instantiations of it, each of which
+// is expanded on its own
+static void compile_macros(FILE *f, const char *dir, size_t size) {
+  (void)dir;
+
+  fprintf(f, "@macro step {\n  add $r[0] #{_0}\n  #{body}\n}\n\n");
+
+  for (size_t i = 0; i < size / COMPILE_NESTING; i++) {
+    for (size_t d = 0; d < COMPILE_NESTING; d++) {
+      fprintf(f, "%*s@step %zu {\n", (int)d * 2, "", d + 1);
+    }
+
+    fprintf(f, "%*ssub $r[0] 1\n", COMPILE_NESTING * 2, "");
+
+    for (size_t d = COMPILE_NESTING; d > 0; d--) {
+      fprintf(f, "%*s}\n", (int)(d - 1) * 2, "");
+    }
+  }
+}
+
+// @includes of the same file, instantiations of a macro defined once
+static void compile_includes(FILE *f, const char *dir, size_t size) {
+  char path[4096];
+  FILE *inc;
+
+  snprintf(path, sizeof(path), "%s/included.bb8", dir);
+
+  if ((inc = fopen(path, "w")) != NULL) {
+    for (size_t i = 0; i < 16; i++) {
+      fprintf(inc, "@twice {\n  add $r[0] %zu\n}\n", i);
+    }
+
+    fclose(inc);
+  }
+
+  fprintf(f, "@macro twice {\n  #{body}\n  #{body}\n}\n\n");
+
+  for (size_t i = 0; i < size; i++) {
+    fprintf(f, "@include \"included.bb8\"\n");
+  }
+}
+
+static const compile_shape_t compile_shapes[] = {
+  { "labels", "labels", 1, compile_labels },
+  { "strings", "strings", 1, compile_strings },
+  { "macros", "expansions", 1, compile_macros },
+  { "includes", "@includes", 8, compile_includes }
+};
+
+// ===== runner =====
+
+static int compile_compare(const void *a, const void *b) {
+  uint64_t l = *(const uint64_t*)a, r = *(const uint64_t*)b;
+
+  return l < r ? -1 : (l > r);
+}
+
+// compiles `in` once, its output thrown away. false if bcparse failed.
+static bool compile_once(const char *bcparse, const char *in, const char *out, uint64_t *nanos, long *maxRssKb) {
+  struct rusage usage;
+  uint64_t start = compile_nowNs();
+  int status;
+  pid_t pid = fork();
+
+  if (pid < 0) {
+    return false;
+  }
+
+  if (pid == 0) {
+    int null = open("/dev/null", O_WRONLY);
+
+    if (null >= 0) {
+      dup2(null, STDOUT_FILENO);
+      dup2(null, STDERR_FILENO);
+    }
+
+    execl(bcparse, bcparse, "-o", out, "-c", in, (char*)NULL);
+    _exit(127);
+  }
+
+  if (wait4(pid, &status, 0, &usage) != pid) {
+    return false;
+  }
+
+  *nanos = compile_nowNs() - start;
+  *maxRssKb = usage.ru_maxrss;
+
+  return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+static bool compile_shape(const char *bcparse, const char *dir, const compile_shape_t *shape,
+                          const size_t *sizes, size_t numSizes, size_t runs) {
+  double lastMs = 0;
+  size_t lastSize = 0;
+  bool ok = true;
+
+  printf("%s\n", shape->name);
+
+  for (size_t s = 0; s < numSizes; s++) {
+    char in[4096], out[4096];
+    uint64_t nanos[COMPILE_MAX_RUNS];
+    long maxRssKb = 0;
+    size_t size = sizes[s] / shape->divisor > 0 ? sizes[s] / shape->divisor : 1;
+    double ms;
+    FILE *f;
+
+    snprintf(in, sizeof(in), "%s/%s_%zu.bb8", dir, shape->name, size);
+    snprintf(out, sizeof(out), "%s/%s_%zu.bin", dir, shape->name, size);
+
+    if ((f = fopen(in, "w")) == NULL) {
+      fprintf(stderr, "%s: cannot write\n", in);
+
+      return false;
+    }
+
+    shape->generate(f, dir, size);
+    fclose(f);
+
+    for (size_t r = 0; r < runs; r++) {
+      long rss = 0;
+
+      if (!compile_once(bcparse, in, out, &nanos[r], &rss)) {
+        fprintf(stderr, "%s: bcparse failed\n", in);
+        ok = false;
+        break;
+      }
+
+      if (rss > maxRssKb) {
+        maxRssKb = rss;
+      }
+    }
+
+    if (!ok) {
+      break;
+    }
+
+    qsort(nanos, runs, sizeof(uint64_t), compile_compare);
+    ms = (double)nanos[runs / 2] / 1e6;
+
+    printf("  %10zu %-10s %10.2f ms %10.2f MB %10.3f us/%s",
+      size, shape->unit, ms, (double)maxRssKb / 1024.0,
+      ms * 1000.0 / (double)size, shape->unit);
+
+    if (lastSize != 0 && lastMs > 0) {
+      printf("   exponent %.2f", log(ms / lastMs) / log((double)size / (double)lastSize));
+    }
+
+    printf("\n");
+    fflush(stdout);
+
+    lastMs = ms;
+    lastSize = size;
+  }
+
+  return ok;
+}
+
+// "1000,4000" into `sizes`, the count of them, or 0 if malformed
+static size_t compile_parseSizes(const char *str, size_t *sizes) {
+  size_t count = 0;
+
+  while (*str != '\0' && count < COMPILE_MAX_SIZES) {
+    char *end;
+    unsigned long long n = strtoull(str, &end, 10);
+
+    if (end == str || n == 0 || (*end != ',' && *end != '\0')) {
+      return 0;
+    }
+
+    sizes[count++] = (size_t)n;
+    str = *end == ',' ? end + 1 : end;
+  }
+
+  return count;
+}
+
+int main(int argc, char *argv[]) {
+  size_t sizes[COMPILE_MAX_SIZES] = { 1000, 2000, 4000, 8000 };
+  size_t numSizes = 4;
+  size_t runs = COMPILE_DEFAULT_RUNS;
+  const char *dir = ".";
+  bool ok = true;
+  int first = 1;
+
+  for (; first < argc && strncmp(argv[first], "--", 2) == 0; first++) {
+    if (strcmp(argv[first], "--runs") == 0 && first + 1 < argc && atoi(argv[first + 1]) > 0) {
+      runs = (size_t)atoi(argv[++first]);
+    } else if (strcmp(argv[first], "--sizes") == 0 && first + 1 < argc) {
+      if ((numSizes = compile_parseSizes(argv[++first], sizes)) == 0) {
+        break;
+      }
+    } else if (strcmp(argv[first], "--dir") == 0 && first + 1 < argc) {
+      dir = argv[++first];
+    } else {
+      break;
+    }
+  }
+
+  if (first + 1 != argc || numSizes == 0 || runs > COMPILE_MAX_RUNS) {
+    fprintf(stderr, "Arguments: %s [--runs <n>] [--sizes <n>,<n>...] [--dir <dir>] <bcparse>\n", argv[0]);
+
+    return EXIT_FAILURE;
+  }
+
+  for (size_t i = 0; i < sizeof(compile_shapes) / sizeof(compile_shapes[0]); i++) {
+    ok = compile_shape(argv[first], dir, &compile_shapes[i], sizes, numSizes, runs) && ok;
+  }
+
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,381 @@
+// the runner of the `microbench` target: times the runtime's primitives
+// on their own, below the interpreter.
+//
+//   vmmicro [<filter>]
+//
+// each case is a function that does its setup, then `n` operations
+// between micro_start and micro_stop. n is doubled until a batch takes
+// MICRO_MIN_NS, and the median of MICRO_BATCHES batches of that size is
+// reported, per operation. only the cases whose name contains `filter`
+// run.
+
+#include <vm/runtime.h>
+#include <vm/value.h>
+#include <vm/datatable.h>
+#include <vm/object.h>
+#include <vm/map.h>
+#include <vm/heap.h>
+#include <vm/rc.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#define MICRO_MIN_NS 20000000 // 20 ms
+#define MICRO_BATCHES 5
+
+typedef struct micro {
+  runtime_t *rt;
+  uint64_t start;
+  uint64_t nanos; // between micro_start and micro_stop
+} micro_t;
+
+typedef struct micro_case {
+  const char *name;
+  void (*run)(micro_t *m, size_t n, size_t arg);
+  size_t arg; // the size of the table or object, for the cases that take one
+} micro_case_t;
+
+// read after every case, so that its results are not optimized away
+static volatile uint64_t micro_sink;
+
+static inline void micro_start(micro_t *m) {
+  m->start = runtime_nowNs();
+}
+
+static inline void micro_stop(micro_t *m) {
+  m->nanos = runtime_nowNs() - m->start;
+}
+
+// ===== value =====
+
+static void micro_copyInt(micro_t *m, size_t n, size_t arg) {
+  value_t src = value_fromInt(42), dst = value_fromInt(0);
+
+  (void)arg;
+  micro_start(m);
+
+  for (size_t i = 0; i < n; i++) {
+    src.data.i64 = (int64_t)i;
+    value_copyValue(m->rt, &dst, &src);
+  }
+
+  micro_stop(m);
+  micro_sink += (uint64_t)dst.data.i64;
+}
+
+// a claim of the buffer and a release of the one it replaces
+static void micro_copyRefCounted(micro_t *m, size_t n, size_t arg) {
+  value_t a = value_fromInt(0), b = value_fromInt(0), dst = value_fromInt(0);
+  static const char text[] = "a refcounted payload, past the inline size";
+
+  (void)arg;
+  value_setData(m->rt, &a, text, sizeof(text));
+  value_setData(m->rt, &b, text, sizeof(text));
+
+  micro_start(m);
+
+  for (size_t i = 0; i < n; i++) {
+    value_copyValue(m->rt, &dst, (i & 1) ? &a : &b);
+  }
+
+  micro_stop(m);
+  micro_sink += (uint64_t)(uintptr_t)dst.data.raw;
+
+  value_release(m->rt, &dst);
+  value_release(m->rt, &a);
+  value_release(m->rt, &b);
+}
+
+static void micro_setInt(micro_t *m, size_t n, size_t arg) {
+  value_t v = value_fromInt(0);
+
+  (void)arg;
+  micro_start(m);
+
+  for (size_t i = 0; i < n; i++) {
+    value_setInt(m->rt, &v, (int64_t)i);
+  }
+
+  micro_stop(m);
+  micro_sink += (uint64_t)v.data.i64;
+}
+
+static void micro_setDouble(micro_t *m, size_t n, size_t arg) {
+  value_t v = value_fromInt(0);
+
+  (void)arg;
+  micro_start(m);
+
+  for (size_t i = 0; i < n; i++) {
+    value_setDouble(m->rt, &v, (double)i);
+  }
+
+  micro_stop(m);
+  micro_sink += (uint64_t)v.data.dbl;
+}
+
+// ===== map =====
+
+// "key<i>" for i < count, each NUL terminated in a buffer of its own
+static char **micro_keys(size_t count) {
+  char **keys = (char**)malloc(sizeof(char*) * count);
+
+  for (size_t i = 0; i < count; i++) {
+    keys[i] = (char*)malloc(24);
+    snprintf(keys[i], 24, "key%zu", i);
+  }
+
+  return keys;
+}
+
+static void micro_freeKeys(char **keys, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    free(keys[i]);
+  }
+
+  free(keys);
+}
+
+// a map of `size` entries, at whatever load factor that leaves it
+static map_t *micro_map(micro_t *m, char **keys, size_t size) {
+  map_t *map = map_create(m->rt->heap);
+
+  for (size_t i = 0; i < size; i++) {
+    value_t v = value_fromInt((int64_t)i);
+
+    map_set(m->rt, map, keys[i], strlen(keys[i]), &v);
+  }
+
+  return map;
+}
+
+static void micro_mapGet(micro_t *m, size_t n, size_t size) {
+  char **keys = micro_keys(size);
+  map_t *map = micro_map(m, keys, size);
+  uint64_t sum = 0;
+
+  micro_start(m);
+
+  for (size_t i = 0; i < n; i++) {
+    const char *key = keys[i & (size - 1)];
+    value_t *v = map_get(map, key, strlen(key));
+
+    sum += (uint64_t)v->data.i64;
+  }
+
+  micro_stop(m);
+  micro_sink += sum;
+
+  map_destroy(map);
+  micro_freeKeys(keys, size);
+}
+
+// overwrites of keys already there
+static void micro_mapSet(micro_t *m, size_t n, size_t size) {
+  char **keys = micro_keys(size);
+  map_t *map = micro_map(m, keys, size);
+
+  micro_start(m);
+
+  for (size_t i = 0; i < n; i++) {
+    const char *key = keys[i & (size - 1)];
+    value_t v = value_fromInt((int64_t)i);
+
+    map_set(m->rt, map, key, strlen(key), &v);
+  }
+
+  micro_stop(m);
+  micro_sink += map->size;
+
+  map_destroy(map);
+  micro_freeKeys(keys, size);
+}
+
+// ===== object =====
+
+// an object of `size` members, keyed by interned strings as the builtins key them
+static object_t *micro_object(micro_t *m, object_key_t *keys, size_t size) {
+  object_t *object = object_create(m->rt->heap);
+
+  for (size_t i = 0; i < size; i++) {
+    char name[24];
+    value_t v = value_fromInt((int64_t)i);
+
+    snprintf(name, sizeof(name), "member%zu", i);
+    keys[i] = (object_key_t)runtime_intern(m->rt, name, strlen(name));
+    object_put(object, keys[i], &v);
+  }
+
+  return object;
+}
+
+static void micro_objectGetPtr(micro_t *m, size_t n, size_t size) {
+  object_key_t *keys = (object_key_t*)malloc(sizeof(object_key_t) * size);
+  object_t *object = micro_object(m, keys, size);
+  uint64_t sum = 0;
+
+  micro_start(m);
+
+  for (size_t i = 0; i < n; i++) {
+    value_t *v = NULL;
+
+    object_getPtr(object, keys[i & (size - 1)], &v);
+    sum += (uint64_t)v->data.i64;
+  }
+
+  micro_stop(m);
+  micro_sink += sum;
+
+  object_destroy(object);
+  free(keys);
+}
+
+static void micro_objectPut(micro_t *m, size_t n, size_t size) {
+  object_key_t *keys = (object_key_t*)malloc(sizeof(object_key_t) * size);
+  object_t *object = micro_object(m, keys, size);
+
+  micro_start(m);
+
+  for (size_t i = 0; i < n; i++) {
+    value_t v = value_fromInt((int64_t)i);
+
+    object_put(object, keys[i & (size - 1)], &v);
+  }
+
+  micro_stop(m);
+  micro_sink += object->size;
+
+  object_destroy(object);
+  free(keys);
+}
+
+// ===== heap =====
+
+// objects allocated and, none of them reachable, swept and finalized,
+// as a collection would: the cost of a short-lived object
+static void micro_allocSweep(micro_t *m, size_t n, size_t arg) {
+  heap_t *heap = m->rt->heap;
+
+  (void)arg;
+  micro_start(m);
+
+  for (size_t i = 0; i < n; i++) {
+    value_t v = value_createObject(m->rt, heap);
+
+    micro_sink += (uint64_t)(uintptr_t)v.data.hv;
+  }
+
+  heap_flush(heap);
+  heap_lock(heap);
+  heap_sweep(m->rt, heap);
+  heap_unlock(heap);
+  heap_finalize(m->rt, heap);
+
+  micro_stop(m);
+}
+
+// ===== datatable =====
+
+static void micro_getValue(micro_t *m, size_t n, size_t at) {
+  datatable_t *dt = m->rt->dt;
+  uint64_t sum = 0;
+
+  // a few live slots, for the relative ones
+  *dt->storage[AT_LOCAL].lenVal = 8;
+
+  micro_start(m);
+
+  for (size_t i = 0; i < n; i++) {
+    value_t *v = datatable_getValue(dt, (loc_28_t)(i & 3) + (at == (AT_LOCAL | AT_REL) ? 1 : 0), (archtype_t)at);
+
+    sum += (uint64_t)(uintptr_t)v;
+  }
+
+  micro_stop(m);
+  micro_sink += sum;
+
+  *dt->storage[AT_LOCAL].lenVal = 0;
+}
+
+static const micro_case_t micro_cases[] = {
+  { "value_copyValue/int", micro_copyInt, 0 },
+  { "value_copyValue/refcounted", micro_copyRefCounted, 0 },
+  { "value_setInt", micro_setInt, 0 },
+  { "value_setDouble", micro_setDouble, 0 },
+
+  { "map_get/16", micro_mapGet, 16 },
+  { "map_get/1024", micro_mapGet, 1024 },
+  { "map_get/65536", micro_mapGet, 65536 },
+  { "map_set/16", micro_mapSet, 16 },
+  { "map_set/1024", micro_mapSet, 1024 },
+  { "map_set/65536", micro_mapSet, 65536 },
+
+  { "object_getPtr/4", micro_objectGetPtr, 4 },
+  { "object_getPtr/32", micro_objectGetPtr, 32 },
+  { "object_getPtr/256", micro_objectGetPtr, 256 },
+  { "object_put/4", micro_objectPut, 4 },
+  { "object_put/32", micro_objectPut, 32 },
+  { "object_put/256", micro_objectPut, 256 },
+
+  { "heap_alloc+sweep", micro_allocSweep, 0 },
+
+  { "datatable_getValue/reg", micro_getValue, AT_REG | AT_ABS },
+  { "datatable_getValue/data", micro_getValue, AT_DATA | AT_ABS },
+  { "datatable_getValue/local", micro_getValue, AT_LOCAL | AT_REL }
+};
+
+static int micro_compare(const void *a, const void *b) {
+  double l = *(const double*)a, r = *(const double*)b;
+
+  return l < r ? -1 : (l > r);
+}
+
+// ns per operation of `c`, the median of the batches
+static double micro_time(micro_t *m, const micro_case_t *c, size_t *iterations) {
+  double perOp[MICRO_BATCHES];
+  size_t n = 1;
+
+  do {
+    n *= 2;
+    c->run(m, n, c->arg);
+  } while (m->nanos < MICRO_MIN_NS && n < ((size_t)1 << 40));
+
+  for (size_t i = 0; i < MICRO_BATCHES; i++) {
+    c->run(m, n, c->arg);
+    perOp[i] = (double)m->nanos / (double)n;
+  }
+
+  qsort(perOp, MICRO_BATCHES, sizeof(double), micro_compare);
+  *iterations = n;
+
+  return perOp[MICRO_BATCHES / 2];
+}
+
+int main(int argc, char *argv[]) {
+  const char *filter = argc > 1 ? argv[1] : NULL;
+  micro_t m;
+
+  m.rt = runtime_create();
+
+  printf("  %-32s %14s %12s\n", "case", "iterations", "ns/op");
+
+  for (size_t i = 0; i < sizeof(micro_cases) / sizeof(micro_cases[0]); i++) {
+    const micro_case_t *c = &micro_cases[i];
+    size_t iterations;
+    double ns;
+
+    if (filter != NULL && strstr(c->name, filter) == NULL) {
+      continue;
+    }
+
+    ns = micro_time(&m, c, &iterations);
+    printf("  %-32s %14zu %12.2f\n", c->name, iterations, ns);
+    fflush(stdout);
+  }
+
+  runtime_destroy(m.rt);
+
+  return micro_sink == 0x5eed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -6,7 +6,12 @@ SourceLocation::SourceLocation(int line, int column,
   const std::string &filename)
   : m_line(line),
     m_column(column),
-    m_filename(filename) {
+    m_filename(SymbolTable::intern(filename)) {
+}
+
+const std::string &SourceLocation::noFileName() {
+  static const std::string empty;
+  return empty;
 }
 
 SourceLocation::SourceLocation(const SourceLocation &other)
@@ -24,22 +29,22 @@ bool SourceLocation::operator<(const SourceLocation &other) const {
     return m_line < other.m_line;
   }
 
-  return m_filename < other.m_filename;
+  return getFileName() < other.getFileName();
 }
 
 bool SourceLocation::operator==(const SourceLocation &other) const {
   return m_line == other.m_line &&
     m_column == other.m_column &&
-    m_filename == other.m_filename &&
-    m_line == other.m_line;
+    m_filename == other.m_filename;
 }
 
 SourceLocation SourceLocation::operator+(const SourceLocation &other) {
-  return SourceLocation(
-    m_line + other.getLine(),
-    m_column + other.getColumn(),
-    m_filename
-  );
+  SourceLocation res(*this);
+
+  res.m_line += other.getLine();
+  res.m_column += other.getColumn();
+
+  return res;
 }
 
 SourceLocation &SourceLocation::operator+=(const SourceLocation &other) {
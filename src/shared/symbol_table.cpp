@@ -0,0 +1,23 @@
+#include <shared/symbol_table.hpp>
+
+#include <unordered_set>
+#include <mutex>
+
+// made on first use, as static SourceLocations and Tokens intern before
+// main, in whatever order their files initialize
+static std::unordered_set<std::string> &symbols() {
+  static std::unordered_set<std::string> set;
+  return set;
+}
+
+static std::mutex &symbolsLock() {
+  static std::mutex lock;
+  return lock;
+}
+
+const std::string *SymbolTable::intern(const std::string &value) {
+  std::lock_guard<std::mutex> guard(symbolsLock());
+
+  // elements of an unordered_set stay where they are when it grows
+  return &*symbols().insert(value).first;
+}
@@ -0,0 +1,76 @@
+// a client of vm --serve, for the tests: `request <socket> <line>` sends
+// the line to the server at the Unix socket and copies the reply to
+// stdout. the server may still be starting, so connecting is retried for
+// a few seconds.
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define REQUEST_ATTEMPTS 100
+#define REQUEST_RETRY_US 50000
+
+static int request_connect(const char *path) {
+  struct sockaddr_un un = { 0 };
+
+  if (strlen(path) >= sizeof(un.sun_path)) {
+    return -1;
+  }
+
+  un.sun_family = AF_UNIX;
+  strcpy(un.sun_path, path);
+
+  for (int i = 0; i < REQUEST_ATTEMPTS; i++) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (fd == -1) {
+      return -1;
+    }
+
+    if (connect(fd, (struct sockaddr*)&un, sizeof(un)) == 0) {
+      return fd;
+    }
+
+    close(fd);
+    usleep(REQUEST_RETRY_US);
+  }
+
+  return -1;
+}
+
+int main(int argc, char *argv[]) {
+  char buf[4096];
+  ssize_t n;
+  int fd;
+
+  if (argc != 3) {
+    fprintf(stderr, "usage: %s <socket> <line>\n", argv[0]);
+    return 2;
+  }
+
+  if ((fd = request_connect(argv[1])) == -1) {
+    perror(argv[1]);
+    return 1;
+  }
+
+  snprintf(buf, sizeof(buf), "%s\n", argv[2]);
+
+  if (write(fd, buf, strlen(buf)) != (ssize_t)strlen(buf)) {
+    perror("write");
+    return 1;
+  }
+
+  while ((n = read(fd, buf, sizeof(buf))) > 0 || (n < 0 && errno == EINTR)) {
+    if (n > 0) {
+      fwrite(buf, 1, (size_t)n, stdout);
+    }
+  }
+
+  close(fd);
+
+  return 0;
+}
@@ -0,0 +1,108 @@
+#!/bin/sh
+# one vm --serve test, as src/tests/CMakeLists.txt adds them:
+#
+#   run_serve.sh <bcparse> <vm> <request> <tests dir> <work dir> <case>
+#
+# starts a server on a Unix socket in <work dir>, with one worker and
+# <work dir>/root for its --root, runs <case> against it with `request`
+# (see request.c) and stops it. the cases:
+#
+#   fail: requests whose runs end on a runtime error, an uncaught
+#   exception and `exit`, each followed by one that succeeds, which the
+#   same worker has to serve
+#
+#   reload: a program whose file is replaced, by a rename as a deploy
+#   would, runs the new one from the next request on; one replaced with
+#   a file that cannot be loaded, an empty one, keeps running the old.
+#   (any bytes are a flat program, so only an empty file is no image.)
+#
+#   nodes: a vm --input run with --nodes sends the program and its jobs
+#   to the server, printing what they print in order, and gives none to
+#   a node that cannot be reached
+
+set -e
+
+BCPARSE=$1
+VM=$2
+REQUEST=$3
+TESTS=$4
+WORK=$5
+CASE=$6
+
+rm -rf "$WORK"
+mkdir -p "$WORK/root"
+SOCKET=$WORK/sock
+
+# compile <source in tests/> <name under the root>
+compile() {
+  "$BCPARSE" -o "$WORK/root/$2" -c "$TESTS/$1" > /dev/null
+}
+
+# expect <request> <pattern>: the reply has to match the shell pattern
+expect() {
+  reply=$("$REQUEST" "$SOCKET" "$1")
+
+  case $reply in
+    $2) ;;
+    *)
+      printf '%s replied\n%s\ninstead of\n%s\n' "$1" "$reply" "$2"
+      exit 1
+      ;;
+  esac
+}
+
+compile serve_ok.bb8 ok.bin
+
+"$VM" --serve "$SOCKET" --root "$WORK/root" --workers 1 &
+SERVER=$!
+# the script's status, not that of the server killed
+trap 'status=$?; kill $SERVER 2> /dev/null; wait $SERVER 2> /dev/null || true; exit $status' EXIT
+
+case $CASE in
+  fail)
+    compile serve_fail.bb8 fail.bin
+    compile serve_throw.bb8 throw.bin
+    compile serve_exit.bb8 exit.bin
+
+    expect ok.bin "42"
+    expect fail.bin "error: fail.bin: runtime error at offset * stack underflow"
+    expect ok.bin "42"
+    expect throw.bin "error: throw.bin: uncaught exception: boom"
+    expect ok.bin "42"
+    expect exit.bin "error: exit.bin: exit status 3"
+    expect ok.bin "42"
+    ;;
+  reload)
+    expect ok.bin "42"
+
+    "$BCPARSE" -o "$WORK/next.bin" -c "$TESTS/serve_reload.bb8" > /dev/null
+    mv "$WORK/next.bin" "$WORK/root/ok.bin"
+    expect ok.bin "43"
+
+    : > "$WORK/next.bin"
+    mv "$WORK/next.bin" "$WORK/root/ok.bin"
+    expect ok.bin "43"
+    ;;
+  nodes)
+    "$BCPARSE" -o "$WORK/double.bin" -c "$TESTS/serve_double.bb8" > /dev/null
+    printf '1\n2\n3\n' > "$WORK/jobs"
+
+    for nodes in "$SOCKET" "$WORK/none,$SOCKET"; do
+      # the connect retries of `request` wait for the server to listen
+      expect ok.bin "42"
+      out=$("$VM" "$WORK/double.bin" --input "$WORK/jobs" --nodes "$nodes")
+
+      case $out in
+        246*) ;;
+        *)
+          printf 'with --nodes %s printed\n%s\ninstead of 246\n' "$nodes" "$out"
+          exit 1
+          ;;
+      esac
+    done
+    ;;
+  *)
+    echo "no such case: $CASE"
+    exit 1
+    ;;
+esac
@@ -0,0 +1,43 @@
+# one test, as src/tests/CMakeLists.txt adds them: compiles SOURCE with
+# BCPARSE and FLAGS, runs it on VM with ENV set, and compares what it
+# prints, less the vm's timing line, with EXPECTED. FLAGS and ENV are
+# space separated. the run fails too if the vm says anything about the
+# jit on stderr, which it only does with BB8_JIT_TRACE set, for a region
+# it could not compile.
+
+separate_arguments(flags UNIX_COMMAND "${FLAGS}")
+separate_arguments(env UNIX_COMMAND "${ENV}")
+
+execute_process(
+  COMMAND ${BCPARSE} ${flags} -o ${OUTPUT} -c ${SOURCE}
+  RESULT_VARIABLE result
+  OUTPUT_VARIABLE output
+  ERROR_VARIABLE output)
+
+if(NOT result EQUAL 0)
+  message(FATAL_ERROR "bcparse failed on ${SOURCE}:\n${output}")
+endif()
+
+execute_process(
+  COMMAND ${CMAKE_COMMAND} -E env ${env} ${VM} ${OUTPUT}
+  RESULT_VARIABLE result
+  OUTPUT_VARIABLE output
+  ERROR_VARIABLE errors
+  TIMEOUT 60)
+
+if(NOT result EQUAL 0)
+  message(FATAL_ERROR "the vm failed on ${OUTPUT} (${result}):\n${output}${errors}")
+endif()
+
+string(REGEX REPLACE "Execution time: [0-9.]+\n?" "" output "${output}")
+string(STRIP "${output}" output)
+file(READ ${EXPECTED} expected)
+string(STRIP "${expected}" expected)
+
+if(NOT output STREQUAL expected)
+  message(FATAL_ERROR "${SOURCE} printed\n${output}\ninstead of\n${expected}")
+endif()
+
+if(errors MATCHES "jit:")
+  message(FATAL_ERROR "${errors}")
+endif()
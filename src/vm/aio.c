@@ -0,0 +1,422 @@
+#include <vm/aio.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+  #include <unistd.h>
+#endif
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+  #include <linux/io_uring.h>
+  #include <sys/syscall.h>
+  #include <sys/mman.h>
+  #define AIO_URING 1
+#endif
+
+#if AIO_URING
+// the parts of an io_uring this uses, mapped from the kernel
+typedef struct {
+  int fd;
+  unsigned *sqHead, *sqTail, *sqMask, *sqArray;
+  unsigned *cqHead, *cqTail, *cqMask;
+  struct io_uring_sqe *sqes;
+  struct io_uring_cqe *cqes;
+  void *sqRing, *cqRing;
+  size_t sqRingSize, cqRingSize, sqesSize;
+  unsigned inFlight; // kept below the CQ size, so completions never overflow
+} aio_uring_t;
+#endif
+
+struct aio {
+  pthread_mutex_t lock; // guards the ring or the queue
+  pthread_cond_t cond; // the queue changed, or a request is done
+
+#if AIO_URING
+  aio_uring_t *uring; // NULL if the thread pool is in use
+#endif
+
+  aio_request_t *head; // the thread pool's queue, oldest first
+  aio_request_t *tail;
+  bool stop;
+  pthread_t threads[AIO_THREADS];
+  int numThreads;
+};
+
+static void aio_finish(aio_request_t *req, int64_t result) {
+  req->result = result < 0 ? -1 : result;
+  atomic_store_explicit(&req->done, true, memory_order_release);
+}
+
+// ===== io_uring =====
+
+#if AIO_URING
+static aio_uring_t *aio_uringCreate() {
+  struct io_uring_params p;
+  aio_uring_t *u;
+  int fd;
+
+  memset(&p, 0, sizeof(p));
+
+  if ((fd = (int)syscall(__NR_io_uring_setup, AIO_RING_ENTRIES, &p)) < 0) {
+    return NULL; // too old a kernel, or not allowed
+  }
+
+  u = (aio_uring_t*)calloc(1, sizeof(aio_uring_t));
+  u->fd = fd;
+  u->sqRingSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+  u->cqRingSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+  u->sqesSize = p.sq_entries * sizeof(struct io_uring_sqe);
+
+  u->sqRing = mmap(NULL, u->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+  u->cqRing = mmap(NULL, u->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+  u->sqes = (struct io_uring_sqe*)mmap(NULL, u->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                       fd, IORING_OFF_SQES);
+
+  if (u->sqRing == MAP_FAILED || u->cqRing == MAP_FAILED || u->sqes == MAP_FAILED) {
+    if (u->sqRing != MAP_FAILED) munmap(u->sqRing, u->sqRingSize);
+    if (u->cqRing != MAP_FAILED) munmap(u->cqRing, u->cqRingSize);
+    if (u->sqes != MAP_FAILED) munmap(u->sqes, u->sqesSize);
+    close(fd);
+    free(u);
+    return NULL;
+  }
+
+  u->sqHead = (unsigned*)((char*)u->sqRing + p.sq_off.head);
+  u->sqTail = (unsigned*)((char*)u->sqRing + p.sq_off.tail);
+  u->sqMask = (unsigned*)((char*)u->sqRing + p.sq_off.ring_mask);
+  u->sqArray = (unsigned*)((char*)u->sqRing + p.sq_off.array);
+  u->cqHead = (unsigned*)((char*)u->cqRing + p.cq_off.head);
+  u->cqTail = (unsigned*)((char*)u->cqRing + p.cq_off.tail);
+  u->cqMask = (unsigned*)((char*)u->cqRing + p.cq_off.ring_mask);
+  u->cqes = (struct io_uring_cqe*)((char*)u->cqRing + p.cq_off.cqes);
+
+  return u;
+}
+
+static void aio_uringDestroy(aio_uring_t *u) {
+  munmap(u->sqes, u->sqesSize);
+  munmap(u->cqRing, u->cqRingSize);
+  munmap(u->sqRing, u->sqRingSize);
+  close(u->fd);
+  free(u);
+}
+
+static int aio_uringEnter(aio_uring_t *u, unsigned toSubmit, unsigned minComplete) {
+  int result;
+
+  do {
+    result = (int)syscall(__NR_io_uring_enter, u->fd, toSubmit, minComplete,
+                          minComplete != 0 ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+  } while (result < 0 && errno == EINTR);
+
+  return result;
+}
+
+// marks every completed request done. with the lock held.
+static void aio_uringReap(aio_uring_t *u) {
+  unsigned head = *u->cqHead;
+  unsigned tail = __atomic_load_n(u->cqTail, __ATOMIC_ACQUIRE);
+
+  while (head != tail) {
+    struct io_uring_cqe *cqe = &u->cqes[head & *u->cqMask];
+
+    aio_finish((aio_request_t*)(uintptr_t)cqe->user_data, cqe->res);
+    --u->inFlight;
+    ++head;
+  }
+
+  __atomic_store_n(u->cqHead, head, __ATOMIC_RELEASE);
+}
+
+// with the lock held
+static void aio_uringSubmit(aio_uring_t *u, aio_request_t *req) {
+  unsigned tail, index;
+  struct io_uring_sqe *sqe;
+
+  // the kernel consumes each entry within the enter below, so the SQ is
+  // never full; completions are bounded instead
+  while (u->inFlight >= AIO_RING_ENTRIES) {
+    aio_uringReap(u);
+
+    if (u->inFlight >= AIO_RING_ENTRIES) {
+      aio_uringEnter(u, 0, 1);
+    }
+  }
+
+  tail = *u->sqTail;
+  index = tail & *u->sqMask;
+  sqe = &u->sqes[index];
+
+  req->iov.iov_base = req->data;
+  req->iov.iov_len = req->size;
+
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = req->op == AIO_READ ? IORING_OP_READV : IORING_OP_WRITEV;
+  sqe->fd = req->fd;
+  sqe->addr = (uint64_t)(uintptr_t)&req->iov;
+  sqe->len = 1;
+  sqe->off = (uint64_t)req->position;
+  sqe->user_data = (uint64_t)(uintptr_t)req;
+
+  u->sqArray[index] = index;
+  __atomic_store_n(u->sqTail, tail + 1, __ATOMIC_RELEASE);
+
+  if (aio_uringEnter(u, 1, 0) < 1) {
+    // not taken: take the entry back
+    __atomic_store_n(u->sqTail, tail, __ATOMIC_RELEASE);
+    aio_finish(req, -1);
+    return;
+  }
+
+  ++u->inFlight;
+}
+#endif
+
+// ===== thread pool =====
+
+// the whole transfer, unless the file ends or fails first
+static int64_t aio_transfer(aio_request_t *req) {
+#if defined(__unix__) || defined(__APPLE__)
+  size_t done = 0;
+
+  while (done < req->size) {
+    ssize_t n = req->op == AIO_READ
+      ? pread(req->fd, (char*)req->data + done, req->size - done, (off_t)(req->position + done))
+      : pwrite(req->fd, (const char*)req->data + done, req->size - done, (off_t)(req->position + done));
+
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+
+    if (n < 0) {
+      return done != 0 ? (int64_t)done : -1;
+    }
+
+    if (n == 0) {
+      break;
+    }
+
+    done += (size_t)n;
+  }
+
+  return (int64_t)done;
+#else
+  return -1;
+#endif
+}
+
+static void *aio_worker(void *arg) {
+  aio_t *aio = (aio_t*)arg;
+
+  pthread_mutex_lock(&aio->lock);
+
+  for (;;) {
+    aio_request_t *req;
+
+    while (aio->head == NULL && !aio->stop) {
+      pthread_cond_wait(&aio->cond, &aio->lock);
+    }
+
+    if (aio->head == NULL) {
+      break; // stopping, and the queue is drained
+    }
+
+    req = aio->head;
+    aio->head = req->next;
+
+    if (aio->head == NULL) {
+      aio->tail = NULL;
+    }
+
+    pthread_mutex_unlock(&aio->lock);
+    aio_finish(req, aio_transfer(req));
+    pthread_mutex_lock(&aio->lock);
+
+    pthread_cond_broadcast(&aio->cond);
+  }
+
+  pthread_mutex_unlock(&aio->lock);
+
+  return NULL;
+}
+
+// ===== requests =====
+
+aio_t *aio_create() {
+  aio_t *aio = (aio_t*)calloc(1, sizeof(aio_t));
+  const char *mode = getenv("BB8_AIO");
+
+  pthread_mutex_init(&aio->lock, NULL);
+  pthread_cond_init(&aio->cond, NULL);
+
+#if AIO_URING
+  if (mode == NULL || strcmp(mode, "threads") != 0) {
+    aio->uring = aio_uringCreate();
+  }
+
+  if (aio->uring != NULL) {
+    return aio;
+  }
+#endif
+
+  for (int i = 0; i < AIO_THREADS; i++) {
+    if (pthread_create(&aio->threads[aio->numThreads], NULL, aio_worker, aio) == 0) {
+      ++aio->numThreads;
+    }
+  }
+
+  if (aio->numThreads == 0) {
+    pthread_cond_destroy(&aio->cond);
+    pthread_mutex_destroy(&aio->lock);
+    free(aio);
+    return NULL;
+  }
+
+  return aio;
+}
+
+void aio_destroy(aio_t *aio) {
+#if AIO_URING
+  if (aio->uring != NULL) {
+    pthread_mutex_lock(&aio->lock);
+
+    while (aio->uring->inFlight != 0) {
+      aio_uringEnter(aio->uring, 0, 1);
+      aio_uringReap(aio->uring);
+    }
+
+    pthread_mutex_unlock(&aio->lock);
+    aio_uringDestroy(aio->uring);
+  }
+#endif
+
+  pthread_mutex_lock(&aio->lock);
+  aio->stop = true;
+  pthread_cond_broadcast(&aio->cond);
+  pthread_mutex_unlock(&aio->lock);
+
+  for (int i = 0; i < aio->numThreads; i++) {
+    pthread_join(aio->threads[i], NULL);
+  }
+
+  pthread_cond_destroy(&aio->cond);
+  pthread_mutex_destroy(&aio->lock);
+  free(aio);
+}
+
+const char *aio_backend(aio_t *aio) {
+#if AIO_URING
+  if (aio->uring != NULL) {
+    return "io_uring";
+  }
+#endif
+
+  return "threads";
+}
+
+aio_request_t *aio_request(aio_t *aio, aio_op_t op, int fd, void *data, size_t size, int64_t position,
+                           refcounted_t claim) {
+  aio_request_t *req = (aio_request_t*)malloc(sizeof(aio_request_t));
+
+  req->aio = aio;
+  req->op = op;
+  req->fd = fd;
+  req->data = data;
+  req->size = size;
+  req->position = position;
+  req->claim = claim != NULL ? rc_claim(claim) : NULL;
+  atomic_init(&req->done, false);
+  req->result = -1;
+  req->next = NULL;
+
+  return req;
+}
+
+void aio_requestDestroy(aio_request_t *req) {
+  // the kernel or a worker may still be writing to `data`
+  aio_wait(req);
+
+  if (req->claim != NULL) {
+    rc_release(req->claim);
+  }
+
+  free(req);
+}
+
+void aio_submit(aio_request_t *req) {
+  aio_t *aio = req->aio;
+
+  pthread_mutex_lock(&aio->lock);
+
+#if AIO_URING
+  if (aio->uring != NULL) {
+    aio_uringSubmit(aio->uring, req);
+    pthread_mutex_unlock(&aio->lock);
+    return;
+  }
+#endif
+
+  if (aio->tail != NULL) {
+    aio->tail->next = req;
+  } else {
+    aio->head = req;
+  }
+
+  aio->tail = req;
+  pthread_cond_broadcast(&aio->cond);
+  pthread_mutex_unlock(&aio->lock);
+}
+
+bool aio_poll(aio_request_t *req) {
+  if (atomic_load_explicit(&req->done, memory_order_acquire)) {
+    return true;
+  }
+
+#if AIO_URING
+  // completions are only picked up by reaping; skip it if another thread is
+  if (req->aio->uring != NULL && pthread_mutex_trylock(&req->aio->lock) == 0) {
+    aio_uringReap(req->aio->uring);
+    pthread_mutex_unlock(&req->aio->lock);
+  }
+#endif
+
+  return atomic_load_explicit(&req->done, memory_order_acquire);
+}
+
+int64_t aio_wait(aio_request_t *req) {
+  aio_t *aio = req->aio;
+
+  if (atomic_load_explicit(&req->done, memory_order_acquire)) {
+    return req->result;
+  }
+
+  pthread_mutex_lock(&aio->lock);
+
+  while (!atomic_load_explicit(&req->done, memory_order_acquire)) {
+#if AIO_URING
+    if (aio->uring != NULL) {
+      aio_uringReap(aio->uring);
+
+      if (!atomic_load_explicit(&req->done, memory_order_acquire)) {
+        aio_uringEnter(aio->uring, 0, 1);
+      }
+
+      continue;
+    }
+#endif
+
+    pthread_cond_wait(&aio->cond, &aio->lock);
+  }
+
+  pthread_mutex_unlock(&aio->lock);
+
+  return req->result;
+}
+
+void aio_destructor(runtime_t *rt, args_t *args) {
+  if (args->_rawData != NULL) {
+    aio_requestDestroy((aio_request_t*)args->_rawData);
+  }
+}
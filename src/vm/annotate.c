@@ -0,0 +1,453 @@
+#include <vm/annotate.h>
+#include <vm/program.h>
+#include <vm/builtins.h>
+#include <vm/value.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+// what the profile says of each instruction, by index
+typedef struct annotate_counts {
+  uint64_t *counts;
+  uint64_t *taken;
+  uint64_t *nanos;
+  uint64_t total; // instructions run
+  uint64_t totalNanos;
+} annotate_counts_t;
+
+// a named label of BIN_SECTION_DEBUG
+typedef struct annotate_label {
+  uint64_t offset;
+  const char *name;
+  uint32_t nameLen;
+} annotate_label_t;
+
+// a source file the lines section names, read once
+typedef struct annotate_source {
+  const char *path; // into the section
+  char *text; // NULL if it could not be read
+  size_t *lines; // offset into `text` of each line, from line 1
+  size_t numLines;
+  struct annotate_source *next;
+} annotate_source_t;
+
+static bool annotate_readCounts(interpreter_t *it, const char *path, annotate_counts_t *out) {
+  code_t *code = it->code;
+  unsigned long long len, offset, count, taken, nanos;
+  char line[256];
+  FILE *f;
+
+  if ((f = fopen(path, "r")) == NULL) {
+    fprintf(stderr, "could not read instruction profile %s\n", path);
+    return false;
+  }
+
+  if (fgets(line, sizeof(line), f) == NULL || sscanf(line, INTERPRETER_INSTRUCTIONS_HEADER " %llu", &len) != 1) {
+    fprintf(stderr, "%s is not an instruction profile (vm --profile-instructions)\n", path);
+    fclose(f);
+    return false;
+  }
+
+  if (len != code->len) {
+    fprintf(stderr, "%s was taken of other code: %llu bytes, not %zu\n", path, len, code->len);
+    fclose(f);
+    return false;
+  }
+
+  out->counts = (uint64_t*)calloc(code->count, sizeof(uint64_t));
+  out->taken = (uint64_t*)calloc(code->count, sizeof(uint64_t));
+  out->nanos = (uint64_t*)calloc(code->count, sizeof(uint64_t));
+  out->total = 0;
+  out->totalNanos = 0;
+
+  while (fgets(line, sizeof(line), f) != NULL) {
+    uint32_t index;
+
+    if (sscanf(line, "%llu %llu %llu %llu", &offset, &count, &taken, &nanos) != 4) {
+      continue;
+    }
+
+    if ((index = code_decodedIndexAt(code, offset)) == CODE_INVALID_INDEX) {
+      fprintf(stderr, "%s was taken of other code: no instruction at %llu\n", path, offset);
+      free(out->counts);
+      free(out->taken);
+      free(out->nanos);
+      fclose(f);
+      return false;
+    }
+
+    out->counts[index] += count;
+    out->taken[index] += taken;
+    out->nanos[index] += nanos;
+    out->total += count;
+    out->totalNanos += nanos;
+  }
+
+  fclose(f);
+
+  return true;
+}
+
+// by offset
+static int annotate_compareLabels(const void *a, const void *b) {
+  const annotate_label_t *l = (const annotate_label_t*)a;
+  const annotate_label_t *r = (const annotate_label_t*)b;
+
+  return l->offset < r->offset ? -1 : (l->offset > r->offset);
+}
+
+// the named labels, in order of offset
+static annotate_label_t *annotate_labels(const image_t *image, size_t *numLabels) {
+  annotate_label_t *labels = NULL;
+  size_t capLabels = 0, pos = 0;
+  uint64_t offset;
+  const char *name;
+  uint32_t nameLen;
+
+  *numLabels = 0;
+
+  while (image_debugLabel(image, &pos, &offset, &name, &nameLen)) {
+    if (*numLabels == capLabels) {
+      capLabels = capLabels != 0 ? capLabels * 2 : 64;
+      labels = (annotate_label_t*)realloc(labels, sizeof(annotate_label_t) * capLabels);
+    }
+
+    labels[*numLabels].offset = offset;
+    labels[*numLabels].name = name;
+    labels[*numLabels].nameLen = nameLen;
+    (*numLabels)++;
+  }
+
+  if (*numLabels != 0) {
+    qsort(labels, *numLabels, sizeof(annotate_label_t), annotate_compareLabels);
+  }
+
+  return labels;
+}
+
+// the first label at `offset`, NULL if there is none
+static const annotate_label_t *annotate_labelAt(const annotate_label_t *labels, size_t numLabels, uint64_t offset) {
+  size_t lo = 0, hi = numLabels;
+
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+
+    if (labels[mid].offset < offset) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  return lo < numLabels && labels[lo].offset == offset ? &labels[lo] : NULL;
+}
+
+static annotate_source_t *annotate_source(annotate_source_t **sources, const char *path) {
+  annotate_source_t *source;
+  FILE *f;
+  long size;
+
+  for (source = *sources; source != NULL; source = source->next) {
+    if (strcmp(source->path, path) == 0) {
+      return source;
+    }
+  }
+
+  source = (annotate_source_t*)calloc(1, sizeof(annotate_source_t));
+  source->path = path;
+  source->next = *sources;
+  *sources = source;
+
+  if ((f = fopen(path, "rb")) == NULL) {
+    return source;
+  }
+
+  if (fseek(f, 0, SEEK_END) == 0 && (size = ftell(f)) >= 0 && fseek(f, 0, SEEK_SET) == 0) {
+    size_t capLines = 64;
+
+    source->text = (char*)malloc((size_t)size + 1);
+    size = (long)fread(source->text, 1, (size_t)size, f);
+    source->text[size] = '\0';
+
+    source->lines = (size_t*)malloc(sizeof(size_t) * capLines);
+    source->lines[source->numLines++] = 0;
+
+    for (long i = 0; i < size; i++) {
+      if (source->text[i] == '\n') {
+        source->text[i] = '\0';
+
+        if (source->numLines == capLines) {
+          capLines *= 2;
+          source->lines = (size_t*)realloc(source->lines, sizeof(size_t) * capLines);
+        }
+
+        source->lines[source->numLines++] = (size_t)i + 1;
+      }
+    }
+  }
+
+  fclose(f);
+
+  return source;
+}
+
+static void annotate_freeSources(annotate_source_t *sources) {
+  while (sources != NULL) {
+    annotate_source_t *next = sources->next;
+
+    free(sources->text);
+    free(sources->lines);
+    free(sources);
+    sources = next;
+  }
+}
+
+// the operand as the source writes it, $r[0], $l[-1], $f[2], or the
+// offset a direct jump goes to, with the label there
+static int annotate_formatOperand(const operand_t *o, const annotate_label_t *labels, size_t numLabels,
+  char *buf, size_t size) {
+  static const char *const storages[] = { "$vm", "$d", "$l", "$r" };
+
+  if (o->at == AT_CODE) {
+    const annotate_label_t *label = annotate_labelAt(labels, numLabels, o->loc);
+
+    return label != NULL
+      ? snprintf(buf, size, "@%u (%.*s)", o->loc, (int)label->nameLen, label->name)
+      : snprintf(buf, size, "@%u", o->loc);
+  }
+
+  if (o->at == AT_FRAME) {
+    return snprintf(buf, size, "$f[%lld]", (long long)CODE_FRAME_SLOT(o->loc));
+  }
+
+  if ((o->at & AT_ABS) == AT_ABS) {
+    return snprintf(buf, size, "%s[%u]", storages[o->at & 0x3], o->loc);
+  }
+
+  return snprintf(buf, size, "%s[-%u]", storages[o->at & 0x3], o->loc);
+}
+
+// `sep` and the operand, after the `*len` bytes of `buf`, truncated to `size`
+static void annotate_appendOperand(char *buf, size_t size, size_t *len, const char *sep, const operand_t *o,
+  const annotate_label_t *labels, size_t numLabels) {
+  int n = snprintf(buf + *len, size - *len, "%s", sep);
+
+  if (n < 0 || (size_t)n >= size - *len) {
+    *len = size - 1;
+    return;
+  }
+
+  *len += (size_t)n;
+  n = annotate_formatOperand(o, labels, numLabels, buf + *len, size - *len);
+  *len = n >= 0 && (size_t)n < size - *len ? *len + (size_t)n : size - 1;
+}
+
+// an inline 8 byte immediate, read as a double for CMP_FLAG_F64_R but
+// for cmpj, whose flags are its condition
+static bool annotate_hasImmediate(const instruction_t *ins) {
+  if (ins->opcode >= CODE_OP_ADD_I64 && ins->opcode < CODE_OP_MOD_I64) {
+    return ((ins->opcode - CODE_OP_ADD_I64) & 0x7) >= 4;
+  }
+
+  switch (ins->opcode) {
+    case OP_CMPJ_IMM: case CODE_OP_MOD_I64_IMM: case CODE_OP_CMP_IMM: case CODE_OP_XOR_IMM:
+    case CODE_OP_AND_IMM: case CODE_OP_OR_IMM: case CODE_OP_SHL_IMM: case CODE_OP_SHR_IMM:
+      return true;
+    default:
+      return false;
+  }
+}
+
+static int annotate_formatImmediate(const instruction_t *ins, char *buf, size_t size) {
+  if (ins->opcode == OP_LOAD) {
+    switch (ins->flags) {
+      case CONST_FLAGS_NULL: return snprintf(buf, size, "null");
+      case CONST_FLAGS_I64: return snprintf(buf, size, "%lld", (long long)ins->imm.i64);
+      case CONST_FLAGS_U64: return snprintf(buf, size, "%llu", (unsigned long long)ins->imm.u64);
+      case CONST_FLAGS_F64: return snprintf(buf, size, "%g", ins->imm.dbl);
+      case CONST_FLAGS_BOOL: return snprintf(buf, size, "%s", ins->imm.b ? "true" : "false");
+      case CONST_FLAGS_POOL: case CONST_FLAGS_RAWDATA:
+        if (ins->imm.raw.data == NULL) {
+          return snprintf(buf, size, "\"\"");
+        }
+
+        return snprintf(buf, size, "\"%.*s\"%s", ins->imm.raw.size > 24 ? 24 : (int)ins->imm.raw.size,
+          (const char*)ins->imm.raw.data, ins->imm.raw.size > 24 ? "..." : "");
+      default: return 0;
+    }
+  }
+
+  if (ins->opcode == OP_POP || ins->opcode == OP_RET) {
+    return snprintf(buf, size, "%llu", (unsigned long long)ins->imm.u64);
+  }
+
+  if (annotate_hasImmediate(ins)) {
+    return ins->opcode != OP_CMPJ_IMM && (ins->flags & CMP_FLAG_F64_R)
+      ? snprintf(buf, size, "%g", ins->imm.dbl)
+      : snprintf(buf, size, "%lld", (long long)ins->imm.i64);
+  }
+
+  return 0;
+}
+
+// a conditional jump, whose taken ratio is worth showing
+static bool annotate_isBranch(const instruction_t *ins) {
+  return (ins->opcode == OP_JMP && ins->flags != JUMP_FLAGS_NONE)
+    || ins->opcode == OP_CMPJ || ins->opcode == OP_CMPJ_IMM;
+}
+
+// the mnemonic, and each operand and immediate after it, separated by spaces
+static void annotate_formatInstruction(const instruction_t *ins, const annotate_label_t *labels, size_t numLabels,
+  char *buf, size_t size) {
+  static const char *const conditions[] = { "", "je", "jne", "jg", "jge" };
+  const operand_t *operands[] = { &ins->left, &ins->right, &ins->target };
+  size_t len;
+  int n;
+
+  if (ins->opcode == OP_JMP && ins->flags <= JUMP_FLAGS_JGE) {
+    n = snprintf(buf, size, "%-12s", ins->flags != JUMP_FLAGS_NONE ? conditions[ins->flags] : "jmp");
+  } else if ((ins->opcode == OP_CMPJ || ins->opcode == OP_CMPJ_IMM) && ins->flags <= JUMP_FLAGS_JGE) {
+    char name[24];
+
+    snprintf(name, sizeof(name), "%s.%s", interpreter_opcodeName(ins->opcode), conditions[ins->flags]);
+    n = snprintf(buf, size, "%-12s", name);
+  } else if ((ins->opcode == CODE_OP_SETCC || ins->opcode == CODE_OP_SELECT) && ins->flags <= JUMP_FLAGS_JGE) {
+    char name[24];
+
+    // the condition without its `j`, negated for a setcc of MOV_FLAGS_NOT
+    snprintf(name, sizeof(name), "%s.%s%s", interpreter_opcodeName(ins->opcode),
+      ins->opcode == CODE_OP_SETCC && ins->imm.b ? "!" : "", conditions[ins->flags] + 1);
+    n = snprintf(buf, size, "%-12s", name);
+  } else {
+    n = snprintf(buf, size, "%-12s", interpreter_opcodeName(ins->opcode));
+  }
+
+  len = n > 0 && (size_t)n < size ? (size_t)n : size - 1;
+
+  for (size_t i = 0; i < 3; i++) {
+    const operand_t *o = operands[i];
+
+    // a call's result goes last, after its arguments
+    if ((o->base == NULL && o->at != AT_CODE) || (i == 1 && CODE_IS_CALL(ins->opcode))) {
+      continue;
+    }
+
+    annotate_appendOperand(buf, size, &len, " ", o, labels, numLabels);
+
+    // the builtin a call goes to, from $d as the program stored it
+    if (i == 0 && CODE_IS_CALL(ins->opcode) && (o->at & AT_ABS) == AT_ABS && o->cap != 0) {
+      const value_t *callee = CODE_OPERAND_VALUE(*o);
+      const char *name = VALUE_TYPE_OF(callee) == TYPE_FUNCTION ? builtins_name(callee->data.fn) : NULL;
+
+      if (name != NULL && len < size) {
+        n = snprintf(buf + len, size - len, " (%s)", name);
+        len = n > 0 && (size_t)n < size - len ? len + (size_t)n : size - 1;
+      }
+    }
+  }
+
+  if (CODE_IS_CALL(ins->opcode)) {
+    if (ins->flags & CALL_FLAGS_OPERANDS) {
+      for (uint64_t i = 0; i < ins->imm.call.count; i++) {
+        annotate_appendOperand(buf, size, &len, " ", &ins->imm.call.args[i], labels, numLabels);
+      }
+    }
+
+    if (ins->flags & CALL_FLAGS_RESULT) {
+      annotate_appendOperand(buf, size, &len, " -> ", &ins->right, labels, numLabels);
+    }
+  } else if (ins->opcode == CODE_OP_SWITCH) {
+    // after the default, the value of the first case, and the cases
+    n = len < size ? snprintf(buf + len, size - len, " %lld:", (long long)ins->imm.table->low) : -1;
+    len = n > 0 && (size_t)n < size - len ? len + (size_t)n : size - 1;
+
+    for (uint32_t i = 0; i < ins->imm.table->count; i++) {
+      operand_t c = { .at = AT_CODE, .loc = ins->imm.table->offsets[i] };
+
+      annotate_appendOperand(buf, size, &len, " ", &c, labels, numLabels);
+    }
+  } else if (len + 1 < size) {
+    buf[len] = ' ';
+
+    if (annotate_formatImmediate(ins, buf + len + 1, size - len - 1) <= 0) {
+      buf[len] = '\0';
+    }
+  }
+
+  // the padding after a mnemonic with nothing following it
+  for (len = strlen(buf); len > 0 && buf[len - 1] == ' '; len--) {
+    buf[len - 1] = '\0';
+  }
+}
+
+bool annotate_write(interpreter_t *it, const char *path, FILE *f) {
+  code_t *code = it->code;
+  annotate_counts_t counts;
+  annotate_label_t *labels;
+  annotate_source_t *sources = NULL;
+  size_t numLabels, nextLabel = 0;
+  const char *lastFile = NULL;
+  uint32_t lastLine = 0;
+  char text[512];
+
+  // the profile's offsets are looked up in the code as a whole
+  code_ensure(code, 0, (uint32_t)code->count);
+
+  if (!annotate_readCounts(it, path, &counts)) {
+    return false;
+  }
+
+  labels = annotate_labels(it->image, &numLabels);
+
+  fprintf(f, "%llu instructions run, %.3f ms\n", (unsigned long long)counts.total, counts.totalNanos / 1e6);
+  fprintf(f, "%12s %7s %7s %10s  %s\n", "count", "time%", "taken%", "offset", "instruction");
+
+  for (size_t i = 0; i < code->count; i++) {
+    const instruction_t *ins = &code->instructions[i];
+    const char *file;
+    uint32_t line;
+
+    // the terminating halt is not in the code
+    if (ins->offset >= code->len) {
+      break;
+    }
+
+    for (; nextLabel < numLabels && labels[nextLabel].offset <= ins->offset; nextLabel++) {
+      fprintf(f, "%.*s:\n", (int)labels[nextLabel].nameLen, labels[nextLabel].name);
+    }
+
+    if (image_sourceLine(it->image, ins->offset, &file, &line) && (line != lastLine || lastFile == NULL || strcmp(file, lastFile) != 0)) {
+      const annotate_source_t *source = annotate_source(&sources, file);
+
+      fprintf(f, "%41s%s:%u  %s\n", "", file, line,
+        source->text != NULL && line >= 1 && line <= source->numLines ? source->text + source->lines[line - 1] : "");
+
+      lastFile = file;
+      lastLine = line;
+    }
+
+    annotate_formatInstruction(ins, labels, numLabels, text, sizeof(text));
+
+    if (counts.counts[i] == 0) {
+      fprintf(f, "%12s %7s %7s %10u  %s\n", "", "", "", ins->offset, text);
+    } else {
+      char taken[16] = "";
+
+      if (annotate_isBranch(ins)) {
+        snprintf(taken, sizeof(taken), "%.2f", 100.0 * (double)counts.taken[i] / (double)counts.counts[i]);
+      }
+
+      fprintf(f, "%12llu %7.2f %7s %10u  %s\n", (unsigned long long)counts.counts[i],
+        counts.totalNanos != 0 ? 100.0 * (double)counts.nanos[i] / (double)counts.totalNanos : 0.0, taken,
+        ins->offset, text);
+    }
+  }
+
+  annotate_freeSources(sources);
+  free(labels);
+  free(counts.counts);
+  free(counts.taken);
+  free(counts.nanos);
+
+  return true;
+}
@@ -0,0 +1,131 @@
+#include <vm/arena.h>
+#include <vm/runtime.h>
+#include <vm/fiber.h>
+#include <vm/value.h>
+#include <vm/events.h>
+
+#include <stdlib.h>
+
+void arena_init(arena_t *arena) {
+  arena->nodes = NULL;
+  arena->len = 0;
+  arena->size = 0;
+  arena->depth = 0;
+}
+
+void arena_destroy(runtime_t *rt, arena_t *arena) {
+  arena_clear(rt, arena);
+
+  free(arena->nodes);
+  arena_init(arena);
+}
+
+bool arena_begin(arena_t *arena) {
+  if (arena->depth == ARENA_MAX_DEPTH) {
+    return false;
+  }
+
+  arena->starts[arena->depth++] = arena->len;
+
+  return true;
+}
+
+heap_value_t *arena_alloc(arena_t *arena, heap_t *heap) {
+  heap_node_t *node = heap_node_create(heap);
+
+  if (arena->len == arena->size) {
+    arena->size = arena->size == 0 ? 64 : arena->size * 2;
+    arena->nodes = (heap_node_t**)realloc(arena->nodes, arena->size * sizeof(heap_node_t*));
+  }
+
+  arena->nodes[arena->len++] = node;
+
+  // not allocated marked while marking: it is not swept, and is marked
+  // through from the roots, or by the barrier, like a young node
+  node->hv.flags = 0;
+  node->hv.arena = arena->depth;
+
+  if (events_enabled) {
+    events_instant(EVENTS_ALLOC, 0);
+  }
+
+  return &node->hv;
+}
+
+size_t arena_end(runtime_t *rt, arena_t *arena) {
+  heap_t *heap = rt->heap;
+  uint8_t depth = arena->depth;
+  size_t start, kept, freed = 0;
+
+  if (depth == 0) {
+    return 0;
+  }
+
+  start = arena->starts[depth - 1];
+  kept = start;
+
+  heap_lock(heap);
+
+  // what the roots hold goes on in the enclosing arena
+  heap_escapeBegin(heap, depth - 1);
+  datatable_mark(rt->dt, heap);
+
+  if (rt->fibers != NULL) {
+    fibers_mark(rt->fibers, heap);
+  }
+
+  heap_escapeEnd(heap);
+
+  // what incremental marking reached may be on its stack, see heap_markStep
+  if (heap->marking) {
+    heap_escapeBegin(heap, 0);
+
+    for (size_t i = start; i < arena->len; i++) {
+      value_t v;
+
+      v.data.hv = &arena->nodes[i]->hv;
+      VALUE_SET_META(&v, TYPE_POINTER, FLAG_OBJECT);
+
+      if (v.data.hv->arena == depth && (v.data.hv->flags & FLAG_MARKED)) {
+        heap_mark(heap, &v);
+      }
+    }
+
+    heap_escapeEnd(heap);
+  }
+
+  for (size_t i = start; i < arena->len; i++) {
+    heap_node_t *node = arena->nodes[i];
+
+    if (node->hv.arena == depth) {
+      heap_node_destroy(rt, heap, node);
+      ++freed;
+    } else if (node->hv.arena == 0) {
+      heap_adopt(heap, node);
+    } else {
+      arena->nodes[kept++] = node;
+    }
+  }
+
+  arena->len = kept;
+  --arena->depth;
+
+  heap_unlock(heap);
+
+  return freed;
+}
+
+void arena_clear(runtime_t *rt, arena_t *arena) {
+  for (size_t i = 0; i < arena->len; i++) {
+    heap_node_destroy(rt, rt->heap, arena->nodes[i]);
+  }
+
+  arena->len = 0;
+  arena->depth = 0;
+}
+
+void arena_unmark(arena_t *arena) {
+  for (size_t i = 0; i < arena->len; i++) {
+    arena->nodes[i]->hv.flags &= ~FLAG_MARKED;
+  }
+}
@@ -0,0 +1,152 @@
+#include <vm/array.h>
+#include <vm/heap.h>
+
+#include <string.h>
+
+size_t array_elementSize(ARRAY_KIND kind) {
+  switch (kind) {
+    case ARRAY_I64: return sizeof(int64_t);
+    case ARRAY_F64: return sizeof(double);
+    case ARRAY_BYTES: return sizeof(uint8_t);
+    default: return sizeof(value_t);
+  }
+}
+
+array_t *array_create(heap_t *heap, ARRAY_KIND kind, size_t capacity) {
+  array_t *array = (array_t*)heap_allocBlock(heap, sizeof(array_t));
+  array->kind = kind;
+  array->size = 0;
+  array->capacity = capacity > ARRAY_INITIAL_CAPACITY ? capacity : ARRAY_INITIAL_CAPACITY;
+  array->heap = heap;
+  array->data = heap_allocBlock(heap, array->capacity * array_elementSize(kind));
+
+  if (array->data == NULL) {
+    array->capacity = 0;
+  }
+
+  return array;
+}
+
+void array_destroy(array_t *array) {
+  heap_t *heap = array->heap;
+
+  heap_freeBlock(heap, array->data, array->capacity * array_elementSize(array->kind));
+  heap_freeBlock(heap, array, sizeof(array_t));
+}
+
+void array_mark(array_t *array, heap_t *heap) {
+  value_t *values = (value_t*)array->data;
+
+  if (array->kind != ARRAY_VALUES) {
+    return; // numbers only
+  }
+
+  for (size_t i = 0; i < array->size; i++) {
+    heap_mark(heap, &values[i]);
+  }
+}
+
+void array_destructor(runtime_t *rt, args_t *args) {
+  if (args->_rawData != NULL) {
+    array_destroy((array_t*)args->_rawData);
+  }
+}
+
+bool array_resize(array_t *array, size_t size) {
+  size_t elementSize = array_elementSize(array->kind);
+
+  if (size > SIZE_MAX / 2 / elementSize) {
+    return false;
+  }
+
+  if (size > array->capacity) {
+    size_t capacity = array->capacity ? array->capacity : ARRAY_INITIAL_CAPACITY;
+    void *data;
+
+    while (capacity < size) {
+      capacity *= 2;
+    }
+
+    if ((data = heap_allocBlock(array->heap, capacity * elementSize)) == NULL) {
+      return false;
+    }
+
+    memcpy(data, array->data, array->size * elementSize);
+    heap_freeBlock(array->heap, array->data, array->capacity * elementSize);
+
+    array->data = data;
+    array->capacity = capacity;
+  }
+
+  if (size > array->size) {
+    memset((char*)array->data + array->size * elementSize, 0, (size - array->size) * elementSize);
+    array->size = size;
+  }
+
+  return true;
+}
+
+bool array_append(array_t *array, const void *elements, size_t count) {
+  size_t size = array->size;
+  size_t elementSize = array_elementSize(array->kind);
+
+  if (count > SIZE_MAX / 2 / elementSize - size || !array_resize(array, size + count)) {
+    return false;
+  }
+
+  memcpy((char*)array->data + size * elementSize, elements, count * elementSize);
+
+  return true;
+}
+
+bool array_get(runtime_t *rt, array_t *array, size_t index, value_t *out) {
+  if (index >= array->size) {
+    return false;
+  }
+
+  switch (array->kind) {
+    case ARRAY_I64:
+      value_setInt(rt, out, ((int64_t*)array->data)[index]);
+      break;
+    case ARRAY_F64:
+      value_setDouble(rt, out, ((double*)array->data)[index]);
+      break;
+    case ARRAY_BYTES:
+      value_setInt(rt, out, ((uint8_t*)array->data)[index]);
+      break;
+    default:
+      value_copyValue(rt, out, &((value_t*)array->data)[index]);
+      break;
+  }
+
+  return true;
+}
+
+bool array_set(runtime_t *rt, array_t *array, size_t index, value_t *value) {
+  if (index >= array->size && !array_resize(array, index + 1)) {
+    return false;
+  }
+
+  switch (array->kind) {
+    case ARRAY_I64:
+      ((int64_t*)array->data)[index] = VALUE_TYPE_OF(value) == TYPE_DOUBLE
+        ? (int64_t)value->data.dbl
+        : value->data.i64;
+      break;
+    case ARRAY_F64:
+      ((double*)array->data)[index] = VALUE_TYPE_OF(value) == TYPE_INT
+        ? (double)value->data.i64
+        : VALUE_TYPE_OF(value) == TYPE_UINT ? (double)value->data.u64 : value->data.dbl;
+      break;
+    case ARRAY_BYTES:
+      ((uint8_t*)array->data)[index] = (uint8_t)(VALUE_TYPE_OF(value) == TYPE_DOUBLE
+        ? (int64_t)value->data.dbl
+        : value->data.i64);
+      break;
+    default:
+      value_copyValue(rt, &((value_t*)array->data)[index], value);
+      break;
+  }
+
+  return true;
+}
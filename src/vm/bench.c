@@ -0,0 +1,132 @@
+#include <vm/bench.h>
+#include <vm/runtime.h>
+#include <vm/output.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// what the last call of bench_step began
+enum {
+  BENCH_START,
+  BENCH_COUNTED1, // the first batch, counted, which lines the count up
+  BENCH_COUNTED2, // the second, counted
+  BENCH_COUNTED3, // the third, counted
+  BENCH_WARMUP, // a batch of the warmup
+  BENCH_TIMED, // a round
+  BENCH_DONE
+};
+
+static uint64_t bench_targetNs() {
+  const char *env = getenv("BB8_BENCH_MS");
+  long ms = BENCH_DEFAULT_MS;
+
+  if (env != NULL && env[0] != '\0') {
+    ms = strtol(env, NULL, 10);
+  }
+
+  return (uint64_t)(ms < 1 ? 1 : ms) * 1000000u;
+}
+
+void bench_init(bench_t *b, const char *name, size_t len) {
+  memset(b, 0, sizeof(*b));
+  b->magic = BENCH_MAGIC;
+  b->phase = BENCH_START;
+  b->targetNs = bench_targetNs();
+  b->instructions = -1;
+  b->nameLen = (uint32_t)len;
+  memcpy(b->name, name, len);
+}
+
+static void bench_report(runtime_t *rt, bench_t *b) {
+  char line[256];
+  int len;
+
+  output_write(&rt->output, "bench ", 6);
+  output_write(&rt->output, b->name, b->nameLen);
+
+  len = snprintf(line, sizeof(line), ": %.2f ns/run (best %.2f)", (double)b->timedNs / (double)b->runs, b->bestNs);
+  output_write(&rt->output, line, (size_t)len);
+
+  if (b->instructions >= 0) {
+    len = snprintf(line, sizeof(line), ", %lld instructions/run", (long long)b->instructions);
+    output_write(&rt->output, line, (size_t)len);
+  }
+
+  len = snprintf(line, sizeof(line), ", %llu runs\n", (unsigned long long)b->runs);
+  output_write(&rt->output, line, (size_t)len);
+}
+
+uint64_t bench_step(runtime_t *rt, bench_t *b) {
+  uint64_t now = runtime_nowNs();
+  uint64_t elapsed = now - b->started;
+
+  switch (b->phase) {
+    case BENCH_START:
+      runtime_countBegin(rt);
+      b->batch = 1;
+      break;
+    case BENCH_COUNTED1:
+      b->counted[0] = rt->counted;
+      b->batch = 1;
+      break;
+    case BENCH_COUNTED2:
+      b->counted[1] = rt->counted;
+      b->batch = 2;
+      break;
+    case BENCH_COUNTED3: {
+      // the third batch, of two runs, against the second, of one.
+      // compiled code does not tick, so none counted is unknown.
+      uint64_t two = rt->counted - b->counted[1];
+      uint64_t one = b->counted[1] - b->counted[0];
+
+      runtime_countEnd(rt);
+      b->instructions = two > one ? (int64_t)(two - one) : -1;
+      b->batch = 1;
+      break;
+    }
+    case BENCH_WARMUP:
+      b->warmupNs += elapsed;
+
+      if (b->warmupNs < b->targetNs / BENCH_WARMUP_PART) {
+        b->batch *= 2;
+        b->started = runtime_nowNs();
+        return b->batch;
+      } else {
+        // the runs a round takes, from the last batch's time
+        double perRun = (double)(elapsed != 0 ? elapsed : 1) / (double)b->batch;
+        double runs = (double)b->targetNs / BENCH_ROUNDS / perRun;
+
+        b->batch = runs < 1 ? 1 : runs > (double)(UINT64_MAX / BENCH_ROUNDS) ? UINT64_MAX / BENCH_ROUNDS : (uint64_t)runs;
+        b->round = 0;
+      }
+
+      break;
+    case BENCH_TIMED: {
+      double perRun = (double)elapsed / (double)b->batch;
+
+      b->timedNs += elapsed;
+      b->runs += b->batch;
+
+      if (b->round == 0 || perRun < b->bestNs) {
+        b->bestNs = perRun;
+      }
+
+      if (++b->round < BENCH_ROUNDS) {
+        b->started = runtime_nowNs();
+        return b->batch;
+      }
+
+      bench_report(rt, b);
+      b->phase = BENCH_DONE;
+      return 0;
+    }
+    default:
+      return 0;
+  }
+
+  b->phase++;
+  b->started = runtime_nowNs();
+
+  return b->batch;
+}
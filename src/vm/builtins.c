@@ -0,0 +1,2876 @@
+#include <vm/builtins.h>
+#include <vm/object.h>
+#include <vm/heap.h>
+#include <vm/scan.h>
+#include <vm/vector.h>
+#include <vm/map.h>
+#include <vm/cache.h>
+#include <vm/net.h>
+#include <vm/fiber.h>
+#include <vm/stream.h>
+#include <vm/aio.h>
+#include <vm/task.h>
+#include <vm/channel.h>
+#include <vm/snapshot.h>
+#include <vm/serial.h>
+#include <vm/json.h>
+#include <vm/regex.h>
+#include <vm/sort.h>
+#include <vm/util.h>
+#include <vm/bench.h>
+#include <vm/interpreter.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// ===== Builtin bindings =====
+value_t _System_createObject(runtime_t *r, args_t *args) {
+  return value_createObject(r, r->heap);
+}
+
+value_t _System_createObjectSized(runtime_t *r, args_t *args) {
+  int64_t capacity = value_getInt(args_getArg(args, 0));
+
+  // a hint: an unreasonable one is ignored
+  return value_createObjectWithCapacity(r, r->heap, capacity > 0 && capacity <= UINT16_MAX ? (uint32_t)capacity : 0);
+}
+
+value_t _System_createScratchObject(runtime_t *r, args_t *args) {
+  // a fiber switch may come between the object's block and its release
+  if (r->fibers != NULL) {
+    return value_createObject(r, r->heap);
+  }
+
+  return scratch_alloc(&r->scratch, r->heap);
+}
+
+// called where $r[0] may still be live, so it gives that back as its result
+value_t _System_scratchRelease(runtime_t *r, args_t *args) {
+  scratch_release(&r->scratch);
+
+  return r->dt->storage[AT_REG].data[0];
+}
+
+// a string argument and its length. strings the program builds at runtime
+// are refcounted buffers, and slices of them, that need not be
+// terminated, so those are bounded by their size.
+static const char *builtins_string(value_t *v, size_t *len) {
+  const char *str = (const char*)value_getRawPointer(v);
+
+  if (VALUE_IS_SLICE(v)) {
+    *len = strnlen(str, VALUE_SLICE_LENGTH(v));
+  } else {
+    *len = (value_getFlags(v) & FLAG_REFCOUNTED) ? strnlen(str, rc_size((void*)str)) : strlen(str);
+  }
+
+  return str;
+}
+
+// `length` bytes at `offset` into a raw data argument, NULL if the range is
+// invalid. refcounted and inline data are bounds checked; a plain pointer
+// or a constant has no size to check against, and is trusted as strlen
+// trusts it. only refcounted buffers and plain pointers can be written:
+// constants, slices and shared buffers are shared, and inline data lives
+// in the argument slot.
+static uint8_t *builtins_range(value_t *v, int64_t offset, int64_t length, bool write) {
+  VALUE_FLAGS flags = value_getFlags(v);
+  size_t size = SIZE_MAX;
+
+  if (value_getType(v) != TYPE_POINTER || (flags & FLAG_OBJECT) || offset < 0 || length < 0) {
+    return NULL;
+  }
+
+  if (write && ((flags & (FLAG_CONST | FLAG_INLINE | FLAG_SLICE)) || ((flags & FLAG_REFCOUNTED) && rc_isShared(v->data.rc)))) {
+    return NULL;
+  }
+
+  if (flags & FLAG_SLICE) {
+    size = VALUE_SLICE_LENGTH(v);
+  } else if (flags & FLAG_REFCOUNTED) {
+    size = rc_size(v->data.rc);
+  } else if (flags & FLAG_INLINE) {
+    size = VALUE_INLINE_SIZE;
+  }
+
+  if ((uint64_t)offset > size || (uint64_t)length > size - (uint64_t)offset) {
+    return NULL;
+  }
+
+  return (uint8_t*)value_getRawPointer(v) + offset;
+}
+
+// a failure of a builtin, as a constant string, thrown where a try region
+// catches it. otherwise the builtin goes on to return none, or whatever it
+// returned before there were exceptions.
+static void builtins_throw(runtime_t *r, const char *message) {
+  value_t argument = value_fromRawPointer((void*)message, FLAG_CONST);
+  exception_t e = exception_fromValue(&argument);
+
+  runtime_throwException(r, &e);
+}
+
+// arenaBegin and arenaEnd leave $r[0] as it was, as scratchRelease
+value_t _System_arenaBegin(runtime_t *r, args_t *args) {
+  if (!arena_begin(&r->arena)) {
+    builtins_throw(r, "arenaBegin: too many arenas open");
+  }
+
+  return r->dt->storage[AT_REG].data[0];
+}
+
+value_t _System_arenaEnd(runtime_t *r, args_t *args) {
+  // memoized results may be keyed by what was freed
+  if (arena_end(r, &r->arena) != 0) {
+    ++r->epoch;
+  }
+
+  return r->dt->storage[AT_REG].data[0];
+}
+
+// the interned form of an OP_CALL's member key argument
+static object_key_t builtins_memberKey(runtime_t *rt, value_t *key) {
+  size_t len;
+  const char *str = builtins_string(key, &len);
+
+  return (object_key_t)runtime_intern(rt, str, len);
+}
+
+value_t _System_getObjectMember(runtime_t *r, args_t *args) {
+  value_t result;
+  VALUE_SET_META(&result, TYPE_NONE, FLAG_NONE);
+
+  value_t *target = args_getArg(args, 0);
+  value_t *member_key = args_getArg(args, 1);
+
+  if (!VALUE_IS(target, TYPE_POINTER, FLAG_OBJECT)) {
+    builtins_throw(r, "getObjectMember: not an object");
+    return result;
+  }
+
+  heap_value_t *hv = value_getHeapNode(target);
+
+  object_t *object = (object_t*)hv->ptr;
+  value_t *member_ptr = NULL;
+
+  if (object_getPtr(object, builtins_memberKey(r, member_key), &member_ptr) != OBJECT_OK) {
+    builtins_throw(r, "getObjectMember: no such member");
+    return result;
+  }
+
+  value_copyValue(r, &result, member_ptr);
+
+  return result;
+}
+
+value_t _System_setObjectMember(runtime_t *r, args_t *args) {
+  value_t result;
+  VALUE_SET_META(&result, TYPE_NONE, FLAG_NONE);
+
+  value_t *target = args_getArg(args, 0);
+  value_t *member_key = args_getArg(args, 1);
+  value_t *member_value = args_getArg(args, 2);
+
+  if (!VALUE_IS(target, TYPE_POINTER, FLAG_OBJECT)) {
+    builtins_throw(r, "setObjectMember: not an object");
+    return result;
+  }
+
+  heap_value_t *hv = value_getHeapNode(target);
+
+  object_t *object = (object_t*)hv->ptr;
+
+  int result_code;
+
+  // memoized results that took this object as an argument are stale now
+  ++r->epoch;
+
+  value_copyValue(r, &result, member_value);
+
+  if ((result_code = object_put(object, builtins_memberKey(r, member_key), &result)) != OBJECT_OK) {
+    value_setInt(r, &result, result_code);
+    builtins_throw(r, "setObjectMember: could not set the member");
+
+    return result;
+  }
+
+  heap_writeBarrier(r->heap, hv, &result);
+
+  return result;
+}
+
+// argument `index` of an array builtin, NULL if it is not an array
+static array_t *builtins_array(args_t *args, size_t index) {
+  value_t *target = args_getArg(args, index);
+
+  if (!VALUE_IS(target, TYPE_POINTER, FLAG_OBJECT | FLAG_ARRAY)) {
+    return NULL;
+  }
+
+  return (array_t*)value_getHeapNode(target)->ptr;
+}
+
+value_t _System_arrayCreate(runtime_t *r, args_t *args) {
+  return value_createArray(r, r->heap, ARRAY_VALUES, (size_t)value_getInt(args_getArg(args, 0)));
+}
+
+value_t _System_arrayCreateInt(runtime_t *r, args_t *args) {
+  return value_createArray(r, r->heap, ARRAY_I64, (size_t)value_getInt(args_getArg(args, 0)));
+}
+
+value_t _System_arrayCreateFloat(runtime_t *r, args_t *args) {
+  return value_createArray(r, r->heap, ARRAY_F64, (size_t)value_getInt(args_getArg(args, 0)));
+}
+
+value_t _System_arrayGetIndex(runtime_t *r, args_t *args) {
+  value_t result;
+  VALUE_SET_META(&result, TYPE_NONE, FLAG_NONE);
+
+  array_t *array = builtins_array(args, 0);
+
+  if (array == NULL || !array_get(r, array, value_getUint(args_getArg(args, 1)), &result)) {
+    builtins_throw(r, array == NULL ? "arrayGetIndex: not an array" : "arrayGetIndex: index out of range");
+    return result;
+  }
+
+  return result;
+}
+
+value_t _System_arraySetIndex(runtime_t *r, args_t *args) {
+  value_t result;
+  VALUE_SET_META(&result, TYPE_NONE, FLAG_NONE);
+
+  array_t *array = builtins_array(args, 0);
+  value_t *value = args_getArg(args, 2);
+
+  if (array == NULL) {
+    builtins_throw(r, "arraySetIndex: not an array");
+    return result;
+  }
+
+  // as with objects, memoized results that took the array are stale now
+  ++r->epoch;
+
+  if (!array_set(r, array, value_getUint(args_getArg(args, 1)), value)) {
+    builtins_throw(r, "arraySetIndex: could not grow the array");
+    return result;
+  }
+
+  heap_writeBarrier(r->heap, value_getHeapNode(args_getArg(args, 0)), value);
+  value_copyValue(r, &result, value);
+
+  return result;
+}
+
+// appends an element, returning the new size
+value_t _System_arrayPush(runtime_t *r, args_t *args) {
+  array_t *array = builtins_array(args, 0);
+  value_t *value = args_getArg(args, 1);
+
+  if (array == NULL) {
+    builtins_throw(r, "arrayPush: not an array");
+    return value_fromInt(0);
+  }
+
+  ++r->epoch;
+
+  if (!array_set(r, array, array->size, value)) {
+    builtins_throw(r, "arrayPush: could not grow the array");
+    return value_fromInt((int64_t)array->size);
+  }
+
+  heap_writeBarrier(r->heap, value_getHeapNode(args_getArg(args, 0)), value);
+
+  return value_fromInt((int64_t)array->size);
+}
+
+value_t _System_arraySize(runtime_t *r, args_t *args) {
+  array_t *array = builtins_array(args, 0);
+
+  return value_fromInt(array != NULL ? (int64_t)array->size : 0);
+}
+
+value_t _System_structCreate(runtime_t *r, args_t *args) {
+  const int64_t size = value_getInt(args_getArg(args, 0));
+  value_t result = value_createArray(r, r->heap, ARRAY_VALUES, size > 0 ? (size_t)size : 0);
+
+  if (size > 0 && !array_resize((array_t*)result.data.hv->ptr, (size_t)size)) {
+    builtins_throw(r, "structCreate: out of memory");
+  }
+
+  return result;
+}
+
+value_t _System_getSlot(runtime_t *r, args_t *args) {
+  value_t result;
+  VALUE_SET_META(&result, TYPE_NONE, FLAG_NONE);
+
+  array_t *array = builtins_array(args, 0);
+
+  if (array == NULL || !array_get(r, array, value_getUint(args_getArg(args, 1)), &result)) {
+    builtins_throw(r, array == NULL ? "getSlot: not a record" : "getSlot: slot out of range");
+  }
+
+  return result;
+}
+
+value_t _System_setSlot(runtime_t *r, args_t *args) {
+  value_t result;
+  VALUE_SET_META(&result, TYPE_NONE, FLAG_NONE);
+
+  array_t *array = builtins_array(args, 0);
+  value_t *value = args_getArg(args, 2);
+  const uint64_t slot = value_getUint(args_getArg(args, 1));
+
+  if (array == NULL || slot >= array->size) {
+    builtins_throw(r, array == NULL ? "setSlot: not a record" : "setSlot: slot out of range");
+    return result;
+  }
+
+  // as arraySetIndex
+  ++r->epoch;
+
+  array_set(r, array, slot, value);
+  heap_writeBarrier(r->heap, value_getHeapNode(args_getArg(args, 0)), value);
+  value_copyValue(r, &result, value);
+
+  return result;
+}
+
+// ===== Numeric vectors =====
+
+// the result of a builtin that has none to give
+static value_t builtins_none() {
+  value_t v;
+  v.data.u64 = 0;
+  VALUE_SET_META(&v, TYPE_NONE, FLAG_NONE);
+  return v;
+}
+
+// the typed arrays `count` arguments from `first` on, all of one kind and
+// of the same size; false if any is not
+static bool builtins_vectors(args_t *args, size_t first, size_t count, array_t **out) {
+  for (size_t i = 0; i < count; i++) {
+    out[i] = builtins_array(args, first + i);
+
+    if (out[i] == NULL || (out[i]->kind != ARRAY_I64 && out[i]->kind != ARRAY_F64)
+        || out[i]->kind != out[0]->kind || out[i]->size != out[0]->size) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// the destination and the `count` operands of vecAdd / vecMul / vecFma
+// into `out`, with the destination resized to the operands' size; false
+// if the arrays do not match
+static bool builtins_elementwise(runtime_t *r, args_t *args, size_t count, array_t **out) {
+  if ((out[0] = builtins_array(args, 0)) == NULL || !builtins_vectors(args, 1, count, out + 1)
+      || out[0]->kind != out[1]->kind || !array_resize(out[0], out[1]->size)) {
+    return false;
+  }
+
+  out[0]->size = out[1]->size;
+
+  // memoized results that took the array are stale now
+  ++r->epoch;
+
+  return true;
+}
+
+value_t _System_vecAdd(runtime_t *r, args_t *args) {
+  array_t *v[3];
+
+  if (!builtins_elementwise(r, args, 2, v)) {
+    return value_fromInt(-1);
+  }
+
+  if (v[0]->kind == ARRAY_I64) {
+    vector_addI64(v[0]->data, v[1]->data, v[2]->data, v[0]->size);
+  } else {
+    vector_addF64(v[0]->data, v[1]->data, v[2]->data, v[0]->size);
+  }
+
+  return value_fromInt((int64_t)v[0]->size);
+}
+
+value_t _System_vecMul(runtime_t *r, args_t *args) {
+  array_t *v[3];
+
+  if (!builtins_elementwise(r, args, 2, v)) {
+    return value_fromInt(-1);
+  }
+
+  if (v[0]->kind == ARRAY_I64) {
+    vector_mulI64(v[0]->data, v[1]->data, v[2]->data, v[0]->size);
+  } else {
+    vector_mulF64(v[0]->data, v[1]->data, v[2]->data, v[0]->size);
+  }
+
+  return value_fromInt((int64_t)v[0]->size);
+}
+
+value_t _System_vecFma(runtime_t *r, args_t *args) {
+  array_t *v[4];
+
+  if (!builtins_elementwise(r, args, 3, v)) {
+    return value_fromInt(-1);
+  }
+
+  if (v[0]->kind == ARRAY_I64) {
+    vector_fmaI64(v[0]->data, v[1]->data, v[2]->data, v[3]->data, v[0]->size);
+  } else {
+    vector_fmaF64(v[0]->data, v[1]->data, v[2]->data, v[3]->data, v[0]->size);
+  }
+
+  return value_fromInt((int64_t)v[0]->size);
+}
+
+value_t _System_vecDot(runtime_t *r, args_t *args) {
+  array_t *v[2];
+
+  if (!builtins_vectors(args, 0, 2, v)) {
+    return builtins_none();
+  }
+
+  return v[0]->kind == ARRAY_I64
+    ? value_fromInt(vector_dotI64(v[0]->data, v[1]->data, v[0]->size))
+    : value_fromDouble(vector_dotF64(v[0]->data, v[1]->data, v[0]->size));
+}
+
+value_t _System_vecSum(runtime_t *r, args_t *args) {
+  array_t *v[1];
+
+  if (!builtins_vectors(args, 0, 1, v)) {
+    return builtins_none();
+  }
+
+  return v[0]->kind == ARRAY_I64
+    ? value_fromInt(vector_sumI64(v[0]->data, v[0]->size))
+    : value_fromDouble(vector_sumF64(v[0]->data, v[0]->size));
+}
+
+value_t _System_vecMin(runtime_t *r, args_t *args) {
+  array_t *v[1];
+
+  if (!builtins_vectors(args, 0, 1, v) || v[0]->size == 0) {
+    return builtins_none();
+  }
+
+  return v[0]->kind == ARRAY_I64
+    ? value_fromInt(vector_minI64(v[0]->data, v[0]->size))
+    : value_fromDouble(vector_minF64(v[0]->data, v[0]->size));
+}
+
+value_t _System_vecMax(runtime_t *r, args_t *args) {
+  array_t *v[1];
+
+  if (!builtins_vectors(args, 0, 1, v) || v[0]->size == 0) {
+    return builtins_none();
+  }
+
+  return v[0]->kind == ARRAY_I64
+    ? value_fromInt(vector_maxI64(v[0]->data, v[0]->size))
+    : value_fromDouble(vector_maxF64(v[0]->data, v[0]->size));
+}
+
+// ===== String builders =====
+
+// argument `index` of a string builder builtin, NULL if it is not one
+static array_t *builtins_builder(args_t *args, size_t index) {
+  array_t *array = builtins_array(args, index);
+
+  return array != NULL && array->kind == ARRAY_BYTES ? array : NULL;
+}
+
+value_t _System_strBuilder(runtime_t *r, args_t *args) {
+  value_t *capacity = args_hasArg(args, 0) ? args_getArg(args, 0) : NULL;
+  int64_t reserve = BUILTINS_BUILDER_CAPACITY;
+
+  if (capacity != NULL && (VALUE_TYPE_OF(capacity) == TYPE_INT || VALUE_TYPE_OF(capacity) == TYPE_UINT)
+      && capacity->data.i64 >= 0) {
+    reserve = capacity->data.i64 < BUILTINS_BUILDER_CAPACITY_MAX ? capacity->data.i64 : BUILTINS_BUILDER_CAPACITY_MAX;
+  }
+
+  return value_createArray(r, r->heap, ARRAY_BYTES, (size_t)reserve);
+}
+
+value_t _System_strAppend(runtime_t *r, args_t *args) {
+  array_t *builder = builtins_builder(args, 0);
+  value_t *value = args_getArg(args, 1);
+  array_t *other;
+  const char *str;
+  size_t len;
+
+  if (builder == NULL) {
+    return value_fromInt(0);
+  }
+
+  ++r->epoch;
+
+  if (value_getType(value) != TYPE_POINTER) {
+    // as OP_PRINT writes it
+    char buf[OUTPUT_NUMBER_MAX];
+
+    array_append(builder, buf, output_formatScalar(buf, value));
+  } else if (!(value_getFlags(value) & FLAG_OBJECT) && value_getRawPointer(value) != NULL) {
+    str = builtins_string(value, &len);
+    array_append(builder, str, len);
+  } else if (value_getHeapNode(value) == value_getHeapNode(args_getArg(args, 0))) {
+    // from itself, which the growth may move
+    len = builder->size;
+
+    if (array_resize(builder, 2 * len)) {
+      memcpy((char*)builder->data + len, builder->data, len);
+    }
+  } else if ((other = builtins_builder(args, 1)) != NULL) {
+    array_append(builder, other->data, other->size);
+  }
+
+  return value_fromInt((int64_t)builder->size);
+}
+
+value_t _System_strBuild(runtime_t *r, args_t *args) {
+  array_t *builder = builtins_builder(args, 0);
+  value_t v;
+  char *copy;
+
+  VALUE_SET_META(&v, TYPE_NONE, FLAG_NONE);
+
+  if (builder == NULL) {
+    return v;
+  }
+
+  if (builder->size < VALUE_INLINE_SIZE) {
+    value_setData(r, &v, builder->data, builder->size);
+    return v;
+  }
+
+  // NUL terminated, for strlen and the C functions
+  if ((copy = (char*)rc_alloc(r->quota, builder->size + 1, runtime_site(r))) == NULL) {
+    builtins_throw(r, "strBuild: out of memory");
+    return v;
+  }
+
+  memcpy(copy, builder->data, builder->size);
+  copy[builder->size] = '\0';
+  value_setRefCounted(r, &v, copy);
+
+  return v;
+}
+
+value_t _System_strSlice(runtime_t *r, args_t *args) {
+  value_t *str = args_getArg(args, 0);
+  int64_t offset = value_getInt(args_getArg(args, 1));
+  int64_t length = value_getInt(args_getArg(args, 2));
+  const uint8_t *data = builtins_range(str, offset, length, false);
+  uint64_t start;
+  value_t v;
+
+  VALUE_SET_META(&v, TYPE_NONE, FLAG_NONE);
+
+  if (data == NULL) {
+    return v;
+  }
+
+  start = (VALUE_IS_SLICE(str) ? VALUE_SLICE_OFFSET(str) : 0) + (uint64_t)offset;
+
+  // inline if there is room, as any string; a copy if there is no buffer
+  // to hold, or the slice would not fit in the value
+  if (length < VALUE_INLINE_SIZE || length > VALUE_SLICE_MAX
+      || !(value_getFlags(str) & FLAG_REFCOUNTED) || start > UINT32_MAX) {
+    value_setData(r, &v, data, (size_t)length);
+  } else {
+    value_setSlice(r, &v, str->data.rc, (uint32_t)start, (size_t)length);
+  }
+
+  return v;
+}
+
+value_t _System_strCopy(runtime_t *r, args_t *args) {
+  value_t *str = args_getArg(args, 0);
+  size_t length;
+  char *copy;
+  value_t v;
+
+  VALUE_SET_META(&v, TYPE_NONE, FLAG_NONE);
+
+  if (!VALUE_IS_SLICE(str)) {
+    value_copyValue(r, &v, str);
+    return v;
+  }
+
+  // NUL terminated, as strBuild's
+  length = VALUE_SLICE_LENGTH(str);
+  if ((copy = (char*)rc_alloc(r->quota, length + 1, runtime_site(r))) == NULL) {
+    builtins_throw(r, "strCopy: out of memory");
+    return v;
+  }
+
+  memcpy(copy, value_getRawPointer(str), length);
+  copy[length] = '\0';
+  value_setRefCounted(r, &v, copy);
+
+  return v;
+}
+
+// whether the value is a string, as builtins_string takes it
+static bool builtins_isString(value_t *v) {
+  return value_getType(v) == TYPE_POINTER && !(value_getFlags(v) & FLAG_OBJECT) && v->data.raw != NULL;
+}
+
+value_t _System_strIntern(runtime_t *r, args_t *args) {
+  value_t *str = args_getArg(args, 0);
+  const char *data;
+  size_t len;
+
+  if (!builtins_isString(str)) {
+    return builtins_none();
+  }
+
+  data = builtins_string(str, &len);
+
+  // the table's, which lives as long as the runtime does
+  return value_fromRawPointer((void*)runtime_intern(r, data, len), FLAG_CONST);
+}
+
+value_t _System_streq(runtime_t *r, args_t *args) {
+  value_t *a = args_getArg(args, 0);
+  value_t *b = args_getArg(args, 1);
+  const char *pa, *pb;
+  size_t la, lb;
+
+  if (!builtins_isString(a) || !builtins_isString(b)) {
+    return value_fromBoolean(false);
+  }
+
+  pa = (const char*)value_getRawPointer(a);
+  pb = (const char*)value_getRawPointer(b);
+
+  // the same copy: one string, or literals the compiler merged. a slice
+  // may be shorter than what its pointer starts.
+  if (pa == pb && !VALUE_IS_SLICE(a) && !VALUE_IS_SLICE(b)) {
+    return value_fromBoolean(true);
+  }
+
+  // two canonical copies, and not the same one
+  if (intern_owns(&r->interned, pa) && intern_owns(&r->interned, pb)) {
+    return value_fromBoolean(false);
+  }
+
+  pa = builtins_string(a, &la);
+  pb = builtins_string(b, &lb);
+
+  return value_fromBoolean(la == lb && memcmp(pa, pb, la) == 0);
+}
+
+// ===== Maps =====
+
+// argument `index` of a map builtin, NULL if it is not a map
+static map_t *builtins_map(args_t *args, size_t index) {
+  value_t *target = args_getArg(args, index);
+
+  if (!VALUE_IS(target, TYPE_POINTER, FLAG_OBJECT | FLAG_MAP)) {
+    return NULL;
+  }
+
+  return (map_t*)value_getHeapNode(target)->ptr;
+}
+
+// the key argument of a map builtin, NULL if it is not a string
+static const char *builtins_mapKey(args_t *args, size_t *len) {
+  value_t *key = args_getArg(args, 1);
+
+  if (value_getType(key) != TYPE_POINTER || (value_getFlags(key) & FLAG_OBJECT) || key->data.raw == NULL) {
+    return NULL;
+  }
+
+  return builtins_string(key, len);
+}
+
+value_t _System_mapCreate(runtime_t *r, args_t *args) {
+  return value_createMap(r, r->heap);
+}
+
+value_t _System_mapGet(runtime_t *r, args_t *args) {
+  value_t result = builtins_none();
+  map_t *map = builtins_map(args, 0);
+  const char *key;
+  size_t len;
+  value_t *found;
+
+  if (map == NULL || (key = builtins_mapKey(args, &len)) == NULL
+      || (found = map_get(map, key, len)) == NULL) {
+    builtins_throw(r, map == NULL ? "mapGet: not a map" : "mapGet: no such key");
+    return result;
+  }
+
+  value_copyValue(r, &result, found);
+
+  return result;
+}
+
+value_t _System_mapSet(runtime_t *r, args_t *args) {
+  value_t result = builtins_none();
+  map_t *map = builtins_map(args, 0);
+  value_t *value = args_getArg(args, 2);
+  const char *key;
+  size_t len;
+
+  if (map == NULL || (key = builtins_mapKey(args, &len)) == NULL) {
+    builtins_throw(r, map == NULL ? "mapSet: not a map" : "mapSet: the key is not a string");
+    return result;
+  }
+
+  // as with objects, memoized results that took the map are stale now
+  ++r->epoch;
+
+  if (!map_set(r, map, key, len, value)) {
+    builtins_throw(r, "mapSet: could not grow the map");
+    return result;
+  }
+
+  heap_writeBarrier(r->heap, value_getHeapNode(args_getArg(args, 0)), value);
+  value_copyValue(r, &result, value);
+
+  return result;
+}
+
+value_t _System_mapHas(runtime_t *r, args_t *args) {
+  map_t *map = builtins_map(args, 0);
+  const char *key;
+  size_t len;
+
+  return value_fromBoolean(map != NULL && (key = builtins_mapKey(args, &len)) != NULL
+    && map_get(map, key, len) != NULL);
+}
+
+value_t _System_mapRemove(runtime_t *r, args_t *args) {
+  map_t *map = builtins_map(args, 0);
+  const char *key;
+  size_t len;
+
+  if (map == NULL || (key = builtins_mapKey(args, &len)) == NULL) {
+    return value_fromBoolean(false);
+  }
+
+  ++r->epoch;
+
+  return value_fromBoolean(map_remove(r, map, key, len));
+}
+
+value_t _System_mapSize(runtime_t *r, args_t *args) {
+  map_t *map = builtins_map(args, 0);
+
+  return value_fromInt(map != NULL ? (int64_t)map->size : 0);
+}
+
+// a new array of the keys, in no particular order
+value_t _System_mapKeys(runtime_t *r, args_t *args) {
+  map_t *map = builtins_map(args, 0);
+  value_t result = value_createArray(r, r->heap, ARRAY_VALUES, map != NULL ? map->size : 0);
+  array_t *keys = (array_t*)value_getHeapNode(&result)->ptr;
+
+  for (size_t i = 0; map != NULL && i < map->capacity; i++) {
+    map_entry_t *e = &map->entries[i];
+    value_t key = builtins_none();
+
+    if (map->ctrl[i] & 0x80) {
+      continue; // empty or deleted
+    }
+
+    // with the NUL, so the key can be passed to strlen and the like
+    value_setData(r, &key, e->key, e->len + 1);
+    array_set(r, keys, keys->size, &key);
+    value_release(r, &key);
+  }
+
+  return result;
+}
+
+// ===== Object members =====
+
+// argument `index` as an object, NULL if it is not one
+static object_t *builtins_object(args_t *args, size_t index) {
+  value_t *target = args_getArg(args, index);
+
+  if (!VALUE_IS(target, TYPE_POINTER, FLAG_OBJECT) || (value_getFlags(target) & FLAG_ARRAY)
+      || value_getHeapNode(target)->kind != HEAP_KIND_OBJECT) {
+    return NULL;
+  }
+
+  return (object_t*)value_getHeapNode(target)->ptr;
+}
+
+// an array of the keys, in the order they were put; interned, so they are
+// the runtime's and not copied
+value_t _System_objectKeys(runtime_t *r, args_t *args) {
+  object_t *object = builtins_object(args, 0);
+  size_t n = object != NULL ? object_size(object) : 0;
+  value_t result = value_createArray(r, r->heap, ARRAY_VALUES, n);
+  array_t *array = (array_t*)value_getHeapNode(&result)->ptr;
+  object_key_t *keys;
+
+  if (n == 0) {
+    return result;
+  }
+
+  if ((keys = (object_key_t*)malloc(n * sizeof(object_key_t))) == NULL) {
+    builtins_throw(r, "objectKeys: out of memory");
+    return result;
+  }
+
+  object_entries(object, keys, NULL);
+
+  for (size_t i = 0; i < n; i++) {
+    value_t key = value_fromRawPointer(keys[i], FLAG_CONST);
+    array_set(r, array, i, &key);
+  }
+
+  free(keys);
+
+  return result;
+}
+
+// an array of the values, in the same order as objectKeys'
+value_t _System_objectValues(runtime_t *r, args_t *args) {
+  object_t *object = builtins_object(args, 0);
+  size_t n = object != NULL ? object_size(object) : 0;
+  value_t result = value_createArray(r, r->heap, ARRAY_VALUES, n);
+  array_t *array = (array_t*)value_getHeapNode(&result)->ptr;
+  value_t *values;
+
+  if (n == 0) {
+    return result;
+  }
+
+  if ((values = (value_t*)malloc(n * sizeof(value_t))) == NULL) {
+    builtins_throw(r, "objectValues: out of memory");
+    return result;
+  }
+
+  object_entries(object, NULL, values);
+
+  // copied, so the array holds what it refers to as an element does
+  for (size_t i = 0; i < n; i++) {
+    array_set(r, array, i, &values[i]);
+  }
+
+  free(values);
+
+  return result;
+}
+
+value_t _System_objectForEach(runtime_t *r, args_t *args) {
+  object_t *object = builtins_object(args, 0);
+  value_t *fn = args_getArg(args, 1);
+  size_t n;
+  object_key_t *keys;
+  value_t *values;
+
+  if (object == NULL) {
+    builtins_throw(r, "objectForEach: not an object");
+    return builtins_none();
+  }
+
+  if (VALUE_TYPE_OF(fn) != TYPE_FUNCTION) {
+    builtins_throw(r, "objectForEach: not a native function");
+    return builtins_none();
+  }
+
+  if ((n = object_size(object)) == 0) {
+    return *args_getArg(args, 0);
+  }
+
+  // taken first: the function may change the object
+  keys = (object_key_t*)malloc(n * (sizeof(object_key_t) + sizeof(value_t)));
+
+  if (keys == NULL) {
+    builtins_throw(r, "objectForEach: out of memory");
+    return builtins_none();
+  }
+
+  values = (value_t*)(keys + n);
+  object_entries(object, keys, values);
+
+  for (size_t i = 0; i < n; i++) {
+    value_t regs[2];
+    value_t result;
+    args_t a;
+
+    regs[0] = value_fromRawPointer(keys[i], FLAG_CONST);
+    regs[1] = values[i];
+
+    a._stack = NULL;
+    a._registers = regs;
+    a._rawData = NULL;
+    a._operands = NULL;
+
+    result = fn->data.fn(r, &a);
+    value_release(r, &result);
+  }
+
+  free(keys);
+
+  return *args_getArg(args, 0);
+}
+
+// what a copy of the members of `object` owes them: a claim on each of
+// their buffers, as value_copyValue takes, and, stored into `owner`, the
+// write barrier; into a new object, only the shading while marking
+static void builtins_copiedMembers(runtime_t *r, object_t *object, heap_value_t *owner) {
+  size_t n = object->shape != NULL ? object->shape->count : object->numMembers;
+
+  for (size_t i = 0; i < n; i++) {
+    value_t *v;
+
+    if (object->shape != NULL) {
+      v = &object->slots[i];
+    } else if (object->members[i].used) {
+      v = &object->members[i].value;
+    } else {
+      continue;
+    }
+
+    if (VALUE_HAS(v, TYPE_POINTER, FLAG_REFCOUNTED)) {
+      rc_claim(v->data.rc);
+    }
+
+    if (owner != NULL) {
+      heap_writeBarrier(r->heap, owner, v);
+    } else if (r->heap->marking) {
+      heap_shade(r->heap, v);
+    }
+  }
+}
+
+value_t _System_objectClone(runtime_t *r, args_t *args) {
+  object_t *object = builtins_object(args, 0);
+  value_t result;
+
+  if (object == NULL) {
+    builtins_throw(r, "objectClone: not an object");
+    return builtins_none();
+  }
+
+  result = value_createObjectClone(r, r->heap, object);
+  builtins_copiedMembers(r, (object_t*)result.data.hv->ptr, NULL);
+
+  return result;
+}
+
+value_t _System_objectAssign(runtime_t *r, args_t *args) {
+  object_t *object = builtins_object(args, 0);
+  object_t *src = builtins_object(args, 1);
+
+  if (object == NULL || src == NULL) {
+    builtins_throw(r, "objectAssign: not an object");
+    return builtins_none();
+  }
+
+  if (object == src) {
+    return *args_getArg(args, 0);
+  }
+
+  // memoized results that took this object as an argument are stale now
+  ++r->epoch;
+
+  if (object_assign(object, src) != OBJECT_OK) {
+    builtins_throw(r, "objectAssign: could not set the members");
+    return builtins_none();
+  }
+
+  builtins_copiedMembers(r, src, value_getHeapNode(args_getArg(args, 0)));
+
+  return *args_getArg(args, 0);
+}
+
+// ===== Caches =====
+
+// argument `index` of a cache builtin, NULL if it is not a cache
+static cache_t *builtins_cache(args_t *args, size_t index) {
+  value_t *target = args_getArg(args, index);
+
+  if (!VALUE_IS(target, TYPE_POINTER, FLAG_OBJECT | FLAG_CACHE)) {
+    return NULL;
+  }
+
+  return (cache_t*)value_getHeapNode(target)->ptr;
+}
+
+// argument `index` as a limit: a non-negative int, -1 if it is not one
+static int64_t builtins_limit(args_t *args, size_t index) {
+  value_t *limit = args_getArg(args, index);
+
+  if ((VALUE_TYPE_OF(limit) != TYPE_INT && VALUE_TYPE_OF(limit) != TYPE_UINT) || limit->data.i64 < 0) {
+    return -1;
+  }
+
+  return limit->data.i64;
+}
+
+value_t _System_cacheCreate(runtime_t *r, args_t *args) {
+  int64_t maxEntries = builtins_limit(args, 0);
+  int64_t maxBytes = builtins_limit(args, 1);
+  value_t *weak = args_getArg(args, 2);
+  value_t result;
+
+  if (maxEntries < 0 || maxBytes < 0 || (maxEntries == 0 && maxBytes == 0)) {
+    builtins_throw(r, "cacheCreate: the limits must be ints, not both 0");
+    return builtins_none();
+  }
+
+  result = value_createCache(r, r->heap, (size_t)maxEntries, (size_t)maxBytes,
+    (VALUE_TYPE_OF(weak) == TYPE_BOOLEAN && weak->data.b)
+    || ((VALUE_TYPE_OF(weak) == TYPE_INT || VALUE_TYPE_OF(weak) == TYPE_UINT) && weak->data.i64 != 0));
+
+  if (value_getHeapNode(&result)->ptr == NULL) {
+    builtins_throw(r, "cacheCreate: out of memory");
+  }
+
+  return result;
+}
+
+value_t _System_cacheGet(runtime_t *r, args_t *args) {
+  value_t result = builtins_none();
+  cache_t *cache = builtins_cache(args, 0);
+  const char *key;
+  size_t len;
+  value_t *found;
+
+  if (cache == NULL) {
+    builtins_throw(r, "cacheGet: not a cache");
+    return result;
+  }
+
+  // unlike mapGet, a miss is not an error
+  if ((key = builtins_mapKey(args, &len)) != NULL && (found = cache_get(cache, key, len)) != NULL) {
+    value_copyValue(r, &result, found);
+  }
+
+  return result;
+}
+
+value_t _System_cacheSet(runtime_t *r, args_t *args) {
+  value_t result = builtins_none();
+  cache_t *cache = builtins_cache(args, 0);
+  value_t *value = args_getArg(args, 2);
+  const char *key;
+  size_t len;
+
+  if (cache == NULL || (key = builtins_mapKey(args, &len)) == NULL) {
+    builtins_throw(r, cache == NULL ? "cacheSet: not a cache" : "cacheSet: the key is not a string");
+    return result;
+  }
+
+  // as with maps; evictions change what the cache holds too
+  ++r->epoch;
+
+  if (!cache_put(r, cache, key, len, value)) {
+    builtins_throw(r, "cacheSet: could not grow the cache");
+    return result;
+  }
+
+  heap_writeBarrier(r->heap, value_getHeapNode(args_getArg(args, 0)), value);
+  value_copyValue(r, &result, value);
+
+  return result;
+}
+
+value_t _System_cacheRemove(runtime_t *r, args_t *args) {
+  cache_t *cache = builtins_cache(args, 0);
+  const char *key;
+  size_t len;
+
+  if (cache == NULL || (key = builtins_mapKey(args, &len)) == NULL) {
+    return value_fromBoolean(false);
+  }
+
+  ++r->epoch;
+
+  return value_fromBoolean(cache_remove(r, cache, key, len));
+}
+
+value_t _System_cacheSize(runtime_t *r, args_t *args) {
+  cache_t *cache = builtins_cache(args, 0);
+
+  return value_fromInt(cache != NULL ? (int64_t)cache->size : 0);
+}
+
+value_t _System_cacheEvictions(runtime_t *r, args_t *args) {
+  cache_t *cache = builtins_cache(args, 0);
+
+  return value_fromInt(cache != NULL ? (int64_t)cache->evictions : 0);
+}
+
+// ===== Record tables =====
+
+// argument `index` as a shaped object, NULL if it is not one
+static object_t *builtins_shaped(args_t *args, size_t index) {
+  value_t *target = args_getArg(args, index);
+  object_t *object;
+
+  if (!VALUE_IS(target, TYPE_POINTER, FLAG_OBJECT) || (value_getFlags(target) & FLAG_ARRAY)
+      || value_getHeapNode(target)->kind != HEAP_KIND_OBJECT) {
+    return NULL;
+  }
+
+  object = (object_t*)value_getHeapNode(target)->ptr;
+
+  return object->shape != NULL && object->shape->count > 0 ? object : NULL;
+}
+
+// the column of `table` at `slot`, NULL if it is not an array
+static array_t *builtins_column(object_t *table, int32_t slot) {
+  value_t *column;
+
+  if (slot < 0 || (uint32_t)slot >= table->shape->count) {
+    return NULL;
+  }
+
+  column = &table->slots[slot];
+
+  if (!VALUE_IS(column, TYPE_POINTER, FLAG_OBJECT | FLAG_ARRAY)) {
+    return NULL;
+  }
+
+  return (array_t*)value_getHeapNode(column)->ptr;
+}
+
+// the column of the table argument 0 for the key argument 2, NULL after
+// throwing `notTable` or `noColumn` if there is none
+static array_t *builtins_tableColumn(runtime_t *r, args_t *args, const char *notTable, const char *noColumn) {
+  object_t *table = builtins_shaped(args, 0);
+  array_t *column;
+
+  if (table == NULL) {
+    builtins_throw(r, notTable);
+    return NULL;
+  }
+
+  if ((column = builtins_column(table, shape_lookup(table->shape, builtins_memberKey(r, args_getArg(args, 2))))) == NULL) {
+    builtins_throw(r, noColumn);
+  }
+
+  return column;
+}
+
+value_t _System_tableCreate(runtime_t *r, args_t *args) {
+  object_t *record = builtins_shaped(args, 0);
+  size_t capacity = (size_t)value_getInt(args_getArg(args, 1));
+  object_t *table;
+  value_t result;
+
+  if (record == NULL) {
+    builtins_throw(r, "tableCreate: the record is not an object of a shape");
+    return builtins_none();
+  }
+
+  result = value_createShapedObject(r, r->heap, record->shape);
+  table = (object_t*)value_getHeapNode(&result)->ptr;
+
+  // the table is new, so no write barrier but incremental marking's
+  for (uint32_t i = 0; i < record->shape->count; i++) {
+    VALUE_TYPE type = value_getType(&record->slots[i]);
+    ARRAY_KIND kind = type == TYPE_INT ? ARRAY_I64 : type == TYPE_DOUBLE ? ARRAY_F64 : ARRAY_VALUES;
+
+    table->slots[i] = value_createArray(r, r->heap, kind, capacity);
+
+    if (r->heap->marking) {
+      heap_shade(r->heap, &table->slots[i]);
+    }
+  }
+
+  return result;
+}
+
+value_t _System_tableAppend(runtime_t *r, args_t *args) {
+  object_t *table = builtins_shaped(args, 0);
+  value_t *target = args_getArg(args, 1);
+  object_t *record;
+  size_t row;
+
+  if (table == NULL || builtins_column(table, 0) == NULL) {
+    builtins_throw(r, "tableAppend: not a table");
+    return value_fromInt(0);
+  }
+
+  if (!VALUE_IS(target, TYPE_POINTER, FLAG_OBJECT) || (value_getFlags(target) & FLAG_ARRAY)
+      || value_getHeapNode(target)->kind != HEAP_KIND_OBJECT) {
+    builtins_throw(r, "tableAppend: the record is not an object");
+    return value_fromInt(0);
+  }
+
+  record = (object_t*)value_getHeapNode(target)->ptr;
+  row = builtins_column(table, 0)->size;
+
+  ++r->epoch;
+
+  // a member at a time from the last, the way the shape chain runs. a
+  // record of the table's shape has its members in the same slots.
+  for (shape_t *s = table->shape; s->parent != NULL; s = s->parent) {
+    array_t *column = builtins_column(table, (int32_t)s->slot);
+    value_t *value = NULL;
+    value_t none = builtins_none();
+
+    if (column == NULL) {
+      builtins_throw(r, "tableAppend: not a table");
+      return value_fromInt((int64_t)row);
+    }
+
+    if (record->shape == table->shape) {
+      value = &record->slots[s->slot];
+    } else if (object_getPtr(record, s->key, &value) != OBJECT_OK) {
+      value = &none;
+    }
+
+    if (!array_set(r, column, row, value)) {
+      builtins_throw(r, "tableAppend: could not grow the table");
+      return value_fromInt((int64_t)row);
+    }
+
+    heap_writeBarrier(r->heap, value_getHeapNode(&table->slots[s->slot]), value);
+  }
+
+  return value_fromInt((int64_t)row + 1);
+}
+
+value_t _System_tableGet(runtime_t *r, args_t *args) {
+  value_t result = builtins_none();
+  array_t *column = builtins_tableColumn(r, args, "tableGet: not a table", "tableGet: no such column");
+
+  if (column != NULL && !array_get(r, column, value_getUint(args_getArg(args, 1)), &result)) {
+    builtins_throw(r, "tableGet: row out of range");
+  }
+
+  return result;
+}
+
+value_t _System_tableSet(runtime_t *r, args_t *args) {
+  value_t result = builtins_none();
+  array_t *column = builtins_tableColumn(r, args, "tableSet: not a table", "tableSet: no such column");
+  size_t row = value_getUint(args_getArg(args, 1));
+  value_t *value = args_getArg(args, 3);
+
+  if (column == NULL) {
+    return result;
+  }
+
+  // a row past the end would leave the other columns short of it
+  if (row >= column->size) {
+    builtins_throw(r, "tableSet: row out of range");
+    return result;
+  }
+
+  ++r->epoch;
+
+  array_set(r, column, row, value);
+  heap_writeBarrier(r->heap, value_getHeapNode(args_getArg(args, 0)), value);
+  value_copyValue(r, &result, value);
+
+  return result;
+}
+
+value_t _System_tableRow(runtime_t *r, args_t *args) {
+  object_t *table = builtins_shaped(args, 0);
+  size_t row = value_getUint(args_getArg(args, 1));
+  object_t *record;
+  value_t result;
+
+  if (table == NULL) {
+    builtins_throw(r, "tableRow: not a table");
+    return builtins_none();
+  }
+
+  for (uint32_t i = 0; i < table->shape->count; i++) {
+    array_t *column = builtins_column(table, (int32_t)i);
+
+    if (column == NULL || row >= column->size) {
+      builtins_throw(r, column == NULL ? "tableRow: not a table" : "tableRow: row out of range");
+      return builtins_none();
+    }
+  }
+
+  result = value_createShapedObject(r, r->heap, table->shape);
+  record = (object_t*)value_getHeapNode(&result)->ptr;
+
+  for (uint32_t i = 0; i < table->shape->count; i++) {
+    VALUE_SET_META(&record->slots[i], TYPE_NONE, FLAG_NONE);
+    array_get(r, builtins_column(table, (int32_t)i), row, &record->slots[i]);
+
+    if (r->heap->marking) {
+      heap_shade(r->heap, &record->slots[i]);
+    }
+  }
+
+  return result;
+}
+
+value_t _System_tableSize(runtime_t *r, args_t *args) {
+  object_t *table = builtins_shaped(args, 0);
+  array_t *column = table != NULL ? builtins_column(table, 0) : NULL;
+
+  return value_fromInt(column != NULL ? (int64_t)column->size : 0);
+}
+
+// ===== Regular expressions =====
+
+// the compiled pattern argument, NULL after throwing if it is malformed
+static regexp_t *builtins_regex(runtime_t *r, value_t *pattern) {
+  const char *error = "regex: not a string";
+  regexp_t *re = NULL;
+  size_t len;
+
+  if (value_getType(pattern) == TYPE_POINTER && !(value_getFlags(pattern) & FLAG_OBJECT)
+      && (pattern->data.raw != NULL || (value_getFlags(pattern) & FLAG_INLINE))) {
+    const char *str = builtins_string(pattern, &len);
+
+    re = regex_get(r, str, len, &error);
+  }
+
+  if (re == NULL) {
+    builtins_throw(r, error);
+  }
+
+  return re;
+}
+
+static value_t builtins_regexRun(runtime_t *r, args_t *args, bool find) {
+  regexp_t *re = builtins_regex(r, args_getArg(args, 0));
+  int64_t offset = value_getInt(args_getArg(args, 2));
+  int64_t length = value_getInt(args_getArg(args, 3));
+  uint8_t *src;
+  int64_t result;
+
+  if (re == NULL || (src = builtins_range(args_getArg(args, 1), offset, length, false)) == NULL) {
+    return value_fromInt(-1);
+  }
+
+  if (find) {
+    result = regex_find(re, src, (size_t)length);
+    return value_fromInt(result < 0 ? -1 : offset + result);
+  }
+
+  return value_fromInt(regex_match(re, src, (size_t)length));
+}
+
+value_t _System_regexCompile(runtime_t *r, args_t *args) {
+  regexp_t *re = builtins_regex(r, args_getArg(args, 0));
+
+  if (re == NULL) {
+    return builtins_none();
+  }
+
+  return value_fromRawPointer((void*)regex_pattern(re), FLAG_CONST);
+}
+
+value_t _System_regexMatch(runtime_t *r, args_t *args) {
+  return builtins_regexRun(r, args, false);
+}
+
+value_t _System_regexFind(runtime_t *r, args_t *args) {
+  return builtins_regexRun(r, args, true);
+}
+
+// ===== Serialization and JSON =====
+
+value_t _System_serialize(runtime_t *r, args_t *args) {
+  refcounted_t rc = serial_write(r, args_getArg(args, 0));
+  value_t v = builtins_none();
+
+  if (rc == NULL) {
+    builtins_throw(r, "serialize: out of memory");
+    return v;
+  }
+
+  value_setRefCounted(r, &v, rc);
+
+  return v;
+}
+
+value_t _System_deserialize(runtime_t *r, args_t *args) {
+  value_t *buffer = args_getArg(args, 0);
+  value_t result;
+
+  if (!VALUE_HAS(buffer, TYPE_POINTER, FLAG_REFCOUNTED) || (value_getFlags(buffer) & FLAG_OBJECT)) {
+    builtins_throw(r, "deserialize: not a buffer");
+    return builtins_none();
+  }
+
+  if (!serial_read(r, (const ubyte_t*)value_getRawPointer(buffer),
+                   VALUE_IS_SLICE(buffer) ? VALUE_SLICE_LENGTH(buffer) : rc_size(buffer->data.rc), &result)) {
+    builtins_throw(r, "deserialize: not data serialize made, or cut short");
+    return builtins_none();
+  }
+
+  return result;
+}
+
+value_t _System_parseJson(runtime_t *r, args_t *args) {
+  value_t *text = args_getArg(args, 0);
+  refcounted_t rc = NULL;
+  uint32_t base = 0;
+  value_t result;
+  const char *str;
+  size_t len;
+
+  if (value_getType(text) != TYPE_POINTER || (value_getFlags(text) & FLAG_OBJECT) || text->data.raw == NULL) {
+    builtins_throw(r, "parseJson: not a string");
+    return builtins_none();
+  }
+
+  str = builtins_string(text, &len);
+
+  // inline data lives in the argument slot, so its strings are copied
+  if (VALUE_HAS(text, TYPE_POINTER, FLAG_REFCOUNTED)) {
+    rc = text->data.rc;
+    base = VALUE_IS_SLICE(text) ? VALUE_SLICE_OFFSET(text) : 0;
+  }
+
+  if (!json_parse(r, (const uint8_t*)str, len, rc, base, &result)) {
+    builtins_throw(r, "parseJson: not valid JSON, or nested too deep");
+    return builtins_none();
+  }
+
+  return result;
+}
+
+value_t _System_stringifyJson(runtime_t *r, args_t *args) {
+  array_t *builder = builtins_builder(args, 0);
+
+  if (builder == NULL) {
+    builtins_throw(r, "stringifyJson: not a string builder");
+    return value_fromInt(-1);
+  }
+
+  ++r->epoch;
+
+  if (!json_write(r, builder, args_getArg(args, 1))) {
+    builtins_throw(r, "stringifyJson: nested too deep, or out of memory");
+    return value_fromInt(-1);
+  }
+
+  return value_fromInt((int64_t)builder->size);
+}
+
+value_t _System_snapshot(runtime_t *r, args_t *args) {
+  const char *error;
+
+  if (r->snapshot == NULL) {
+    return value_fromBoolean(false);
+  }
+
+  if (r->snapshot->fork != NULL) {
+    r->snapshot->fork(r);
+    return value_fromBoolean(true);
+  }
+
+  if (!snapshot_write(r, r->snapshot, &error)) {
+    fprintf(stderr, "snapshot: %s: %s\n", r->snapshot->path, error);
+    exit(EXIT_FAILURE);
+  }
+
+  exit(0);
+}
+
+value_t _System_flush(runtime_t *r, args_t *args) {
+  output_flush(&r->output);
+
+  return value_fromRawPointer(NULL, 0);
+}
+
+value_t _System_traceDump(runtime_t *r, args_t *args) {
+  if (r->traced == NULL) {
+    return value_fromBoolean(false);
+  }
+
+  // what was printed comes before
+  output_flush(&r->output);
+  interpreter_writeRing(r->traced, stderr);
+
+  return value_fromBoolean(true);
+}
+
+value_t _System_heapCensus(runtime_t *r, args_t *args) {
+  value_t *arg = args_getArg(args, 0);
+  char *path = NULL;
+  const char *str;
+  size_t len;
+  bool written;
+
+  if (value_getType(arg) == TYPE_POINTER && !(value_getFlags(arg) & FLAG_OBJECT) && arg->data.raw != NULL) {
+    // a runtime string need not be terminated
+    str = builtins_string(arg, &len);
+    path = (char*)malloc(len + 1);
+    memcpy(path, str, len);
+    path[len] = '\0';
+  }
+
+  // what was printed comes before
+  output_flush(&r->output);
+  written = runtime_heapCensus(r, stderr, path, false);
+  free(path);
+
+  return value_fromBoolean(written);
+}
+
+value_t _System_input(runtime_t *r, args_t *args) {
+  if (r->input == NULL) {
+    return builtins_none();
+  }
+
+  return value_fromRawPointer((void*)r->input, FLAG_CONST);
+}
+
+// a cache hit compares the key argument's pointer, not its interned
+// form, so only keys from static data are cached: a string built at
+// runtime may be freed, and its memory reused for a different name.
+static void builtins_fillCache(instruction_t *ins, value_t *key, shape_t *shape, shape_t *next, uint32_t slot) {
+  if (!(value_getFlags(key) & FLAG_CONST)) {
+    return;
+  }
+
+  ins->member.shape = shape;
+  ins->member.key = (object_key_t)value_getRawPointer(key);
+  ins->member.next = next;
+  ins->member.slot = slot;
+}
+
+// createFromTemplate: the object, member by member as setObjectMember
+// would store them. none for a template that is not static data, or that
+// names a slot past it.
+static value_t builtins_templateObject(runtime_t *r, value_t *tmpl) {
+  storage_t *data = &r->dt->storage[AT_DATA];
+  const void *raw;
+  uint32_t count;
+  value_t result, v;
+
+  if (!VALUE_IS(tmpl, TYPE_POINTER, FLAG_CONST)) {
+    return builtins_none();
+  }
+
+  raw = value_getRawPointer(tmpl);
+  count = builtins_templateWord(raw, 0);
+
+  if (count > BUILTIN_TEMPLATE_MAX) {
+    return builtins_none();
+  }
+
+  for (uint32_t i = 0; i < 2 * count; i++) {
+    if (builtins_templateWord(raw, 1 + i) >= data->count) {
+      return builtins_none();
+    }
+  }
+
+  result = value_createObject(r, r->heap);
+
+  for (uint32_t i = 0; i < count; i++) {
+    VALUE_SET_META(&v, TYPE_NONE, FLAG_NONE);
+    value_copyValue(r, &v, &data->data[builtins_templateWord(raw, 2 + 2 * i)]);
+
+    object_put((object_t*)result.data.hv->ptr,
+      builtins_memberKey(r, &data->data[builtins_templateWord(raw, 1 + 2 * i)]), &v);
+
+    if (r->heap->marking) {
+      heap_shade(r->heap, &v);
+    }
+  }
+
+  return result;
+}
+
+value_t _System_createFromTemplate(runtime_t *r, args_t *args) {
+  return builtins_templateObject(r, args_getArg(args, 0));
+}
+
+bool builtins_templateMiss(runtime_t *rt, instruction_t *ins, bool registers, value_t **operands, value_t *result) {
+  value_t *tmpl = builtins_arg(rt, registers, operands, 0);
+  value_t v = builtins_templateObject(rt, tmpl);
+  object_t *object;
+
+  // a key named twice leaves fewer members than the template has
+  if (VALUE_IS(&v, TYPE_POINTER, FLAG_OBJECT) && (object = (object_t*)v.data.hv->ptr)->shape != NULL
+      && object->shape->count == builtins_templateWord(value_getRawPointer(tmpl), 0)) {
+    ins->member.shape = object->shape;
+    ins->member.key = (object_key_t)value_getRawPointer(tmpl);
+  }
+
+  *result = v;
+
+  return true;
+}
+
+bool builtins_getMemberMiss(runtime_t *rt, instruction_t *ins, bool registers, value_t **operands, value_t *result) {
+  object_t *object = builtins_argObject(rt, registers, operands);
+  value_t *arg = builtins_arg(rt, registers, operands, 1);
+  int32_t slot;
+  value_t v;
+
+  // hash table objects and missing members are left to the builtin
+  if (object == NULL || object->shape == NULL
+      || (slot = shape_lookup(object->shape, builtins_memberKey(rt, arg))) < 0) {
+    return false;
+  }
+
+  builtins_fillCache(ins, arg, object->shape, object->shape, (uint32_t)slot);
+
+  VALUE_SET_META(&v, TYPE_NONE, FLAG_NONE);
+  value_copyValue(rt, &v, &object->slots[slot]);
+  *result = v;
+
+  return true;
+}
+
+bool builtins_setMemberMiss(runtime_t *rt, instruction_t *ins, bool registers, value_t **operands, value_t *result) {
+  object_t *object = builtins_argObject(rt, registers, operands);
+  value_t *arg = builtins_arg(rt, registers, operands, 1);
+  object_key_t key;
+  shape_t *shape;
+  int result_code;
+  value_t v;
+
+  if (object == NULL || object->shape == NULL) {
+    return false;
+  }
+
+  key = builtins_memberKey(rt, arg);
+  shape = object->shape;
+
+  ++rt->epoch;
+
+  VALUE_SET_META(&v, TYPE_NONE, FLAG_NONE);
+  value_copyValue(rt, &v, builtins_arg(rt, registers, operands, 2));
+
+  if ((result_code = object_put(object, key, &v)) != OBJECT_OK) {
+    value_setInt(rt, &v, result_code);
+    *result = v;
+
+    return true;
+  }
+
+  // still shaped, unless this member was one too many
+  if (object->shape != NULL) {
+    builtins_fillCache(ins, arg, shape, object->shape, (uint32_t)shape_lookup(object->shape, key));
+  }
+
+  heap_writeBarrier(rt->heap, builtins_arg(rt, registers, operands, 0)->data.hv, &v);
+  *result = v;
+
+  return true;
+}
+
+// ===== C Lib functions =====
+
+value_t _System_C_exit(runtime_t *r, args_t *args) {
+  runtime_fatal(r, (int)value_getInt(args_getArg(args, 0)), NULL);
+
+  return value_fromRawPointer(NULL, 0);
+}
+
+value_t _System_C_fmod(runtime_t *r, args_t *args) {
+  double a = value_getDouble(args_getArg(args, 0));
+  double b = value_getDouble(args_getArg(args, 1));
+
+  return value_fromDouble(fmod(a, b));
+}
+
+value_t _System_C_strlen(runtime_t *r, args_t *args) {
+  return value_fromInt(builtins_strlen(args_getArg(args, 0)));
+}
+
+// a string argument as a C string: a slice, which is not terminated, is
+// copied into `*copy` for the caller to free, anything else is used as
+// it is
+static const char *builtins_cString(value_t *v, char **copy) {
+  *copy = NULL;
+
+  if (VALUE_IS_SLICE(v)) {
+    return *copy = strndup((const char*)value_getRawPointer(v), VALUE_SLICE_LENGTH(v));
+  }
+
+  return (const char*)value_getRawPointer(v);
+}
+
+value_t _System_C_fopen(runtime_t *r, args_t *args) {
+  char *copies[2];
+  const char *filename = builtins_cString(args_getArg(args, 0), &copies[0]);
+  const char *mode = builtins_cString(args_getArg(args, 1), &copies[1]);
+
+  FILE *file = fopen(filename, mode);
+
+  free(copies[0]);
+  free(copies[1]);
+
+  return value_fromRawPointer((void*)file, 0);
+}
+
+value_t _System_C_fclose(runtime_t *r, args_t *args) {
+  FILE *file = (FILE*)value_getRawPointer(args_getArg(args, 0));
+
+  return value_fromInt(fclose(file));
+}
+
+value_t _System_C_fread(runtime_t *r, args_t *args) {
+  FILE *file = (FILE*)value_getRawPointer(args_getArg(args, 0));
+  int64_t size = value_getInt(args_getArg(args, 1));
+
+  value_t v;
+  VALUE_SET_META(&v, TYPE_NONE, FLAG_NONE);
+
+  if (size < VALUE_INLINE_SIZE) {
+    char data[VALUE_INLINE_SIZE] = { 0 };
+
+    fread(data, 1, size, file);
+    value_setData(r, &v, data, size);
+
+    return v;
+  }
+
+  char *data = rc_alloc(r->quota, size, runtime_site(r));
+
+  if (data == NULL) {
+    builtins_throw(r, "fread: out of memory");
+    return v;
+  }
+
+  memset(data, 0, size);
+
+  fread(data, 1, size, file);
+
+  value_setRefCounted(r, &v, data);
+
+  return v;
+}
+
+value_t _System_C_fwrite(runtime_t *r, args_t *args) {
+  FILE *file = (FILE*)value_getRawPointer(args_getArg(args, 0));
+  int64_t size = value_getInt(args_getArg(args, 1));
+  void *raw = value_getRawPointer(args_getArg(args, 2));
+  array_t *builder = builtins_builder(args, 2);
+  size_t result;
+
+  // a string builder's text, as much of it as there is
+  if (builder != NULL) {
+    raw = builder->data;
+    size = size < (int64_t)builder->size ? size : (int64_t)builder->size;
+  }
+
+  // after what was printed before it
+  if (file == r->output.fp) {
+    output_flush(&r->output);
+  }
+
+  result = fwrite(raw, 1, size, file);
+
+  return value_fromInt(result);
+}
+
+value_t _System_C_fseek(runtime_t *r, args_t *args) {
+  FILE *file = (FILE*)value_getRawPointer(args_getArg(args, 0));
+  int64_t offset = value_getInt(args_getArg(args, 1));
+  int64_t origin = value_getInt(args_getArg(args, 2));
+
+  return value_fromInt(fseek(file, offset, origin));
+}
+
+value_t _System_C_memcpy(runtime_t *r, args_t *args) {
+  int64_t length = value_getInt(args_getArg(args, 4));
+  uint8_t *dst = builtins_range(args_getArg(args, 0), value_getInt(args_getArg(args, 1)), length, true);
+  uint8_t *src = builtins_range(args_getArg(args, 2), value_getInt(args_getArg(args, 3)), length, false);
+
+  if (dst == NULL || src == NULL) {
+    return value_fromInt(-1);
+  }
+
+  // the two may be the same buffer
+  memmove(dst, src, length);
+
+  return value_fromInt(length);
+}
+
+value_t _System_C_memset(runtime_t *r, args_t *args) {
+  int64_t length = value_getInt(args_getArg(args, 3));
+  uint8_t *dst = builtins_range(args_getArg(args, 0), value_getInt(args_getArg(args, 1)), length, true);
+
+  if (dst == NULL) {
+    return value_fromInt(-1);
+  }
+
+  memset(dst, (int)value_getInt(args_getArg(args, 2)), length);
+
+  return value_fromInt(length);
+}
+
+value_t _System_C_memchr(runtime_t *r, args_t *args) {
+  int64_t offset = value_getInt(args_getArg(args, 1));
+  int64_t length = value_getInt(args_getArg(args, 3));
+  uint8_t *src = builtins_range(args_getArg(args, 0), offset, length, false);
+  uint8_t *found;
+
+  if (src == NULL || (found = memchr(src, (int)value_getInt(args_getArg(args, 2)), length)) == NULL) {
+    return value_fromInt(-1);
+  }
+
+  return value_fromInt(offset + (found - src));
+}
+
+value_t _System_C_memcmp(runtime_t *r, args_t *args) {
+  int64_t length = value_getInt(args_getArg(args, 4));
+  uint8_t *a = builtins_range(args_getArg(args, 0), value_getInt(args_getArg(args, 1)), length, false);
+  uint8_t *b = builtins_range(args_getArg(args, 2), value_getInt(args_getArg(args, 3)), length, false);
+  int result;
+
+  if (a == NULL || b == NULL) {
+    return value_fromInt(-1);
+  }
+
+  result = memcmp(a, b, length);
+
+  return value_fromInt((result > 0) - (result < 0));
+}
+
+static value_t builtins_scan(args_t *args, bool match) {
+  int64_t offset = value_getInt(args_getArg(args, 1));
+  int64_t length = value_getInt(args_getArg(args, 2));
+  uint8_t *src = builtins_range(args_getArg(args, 0), offset, length, false);
+  size_t index;
+
+  if (src == NULL || (index = scan_find(src, length, (int)value_getInt(args_getArg(args, 3)), match)) == (size_t)length) {
+    return value_fromInt(-1);
+  }
+
+  return value_fromInt(offset + (int64_t)index);
+}
+
+value_t _System_scanFind(runtime_t *r, args_t *args) {
+  return builtins_scan(args, true);
+}
+
+value_t _System_scanSkip(runtime_t *r, args_t *args) {
+  return builtins_scan(args, false);
+}
+
+value_t _System_parseInt(runtime_t *r, args_t *args) {
+  int64_t length = value_getInt(args_getArg(args, 2));
+  uint8_t *src = builtins_range(args_getArg(args, 0), value_getInt(args_getArg(args, 1)), length, false);
+  int64_t result;
+  value_t v;
+
+  if (src == NULL || !scan_parseInt(src, (size_t)length, &result)) {
+    VALUE_SET_META(&v, TYPE_NONE, FLAG_NONE);
+    return v;
+  }
+
+  return value_fromInt(result);
+}
+
+value_t _System_parseDouble(runtime_t *r, args_t *args) {
+  int64_t length = value_getInt(args_getArg(args, 2));
+  uint8_t *src = builtins_range(args_getArg(args, 0), value_getInt(args_getArg(args, 1)), length, false);
+  double result;
+  value_t v;
+
+  if (src == NULL || !scan_parseDouble(src, (size_t)length, &result)) {
+    VALUE_SET_META(&v, TYPE_NONE, FLAG_NONE);
+    return v;
+  }
+
+  return value_fromDouble(result);
+}
+
+// the formatted number of `len` bytes into the buffer of a format builtin
+static value_t builtins_format(args_t *args, const char *buf, size_t len) {
+  uint8_t *dst = builtins_range(args_getArg(args, 0), value_getInt(args_getArg(args, 1)), (int64_t)len, true);
+
+  if (dst == NULL) {
+    return value_fromInt(-1);
+  }
+
+  memcpy(dst, buf, len);
+
+  return value_fromInt((int64_t)len);
+}
+
+value_t _System_formatInt(runtime_t *r, args_t *args) {
+  char buf[OUTPUT_NUMBER_MAX];
+
+  return builtins_format(args, buf, output_formatInt(buf, value_getInt(args_getArg(args, 2))));
+}
+
+value_t _System_formatDouble(runtime_t *r, args_t *args) {
+  char buf[OUTPUT_NUMBER_MAX];
+
+  return builtins_format(args, buf, output_formatDouble(buf, value_getDouble(args_getArg(args, 2))));
+}
+
+// ===== Exceptions =====
+
+value_t _System_throw(runtime_t *r, args_t *args) {
+  value_t argument;
+  exception_t e;
+  char buf[OUTPUT_NUMBER_MAX];
+  const char *str = buf;
+  size_t len;
+
+  VALUE_SET_META(&argument, TYPE_NONE, FLAG_NONE);
+  value_copyValue(r, &argument, args_getArg(args, 0));
+  e = exception_fromValue(&argument);
+
+  runtime_throwException(r, &e);
+
+  // nothing catches it: the program stops, as on a runtime error
+  if ((len = output_formatScalar(buf, &argument)) != 0) {
+    // a number, bool or none
+  } else if (value_getType(&argument) == TYPE_POINTER && !(value_getFlags(&argument) & FLAG_OBJECT)
+      && argument.data.raw != NULL) {
+    str = builtins_string(&argument, &len);
+  } else {
+    str = "(object)";
+    len = strlen(str);
+  }
+
+  // formatted before the value goes, which a host running on keeps no
+  // other hold on
+  char message[RUNTIME_FATAL_MESSAGE];
+
+  snprintf(message, sizeof(message), "uncaught exception: %.*s", (int)len, str);
+  value_release(r, &argument);
+  runtime_fatal(r, EXIT_FAILURE, "%s", message);
+
+  return value_fromRawPointer(NULL, 0);
+}
+
+// ===== Streams =====
+
+// argument `index` of a stream builtin, NULL if it is not a stream
+static stream_t *builtins_stream(args_t *args, size_t index) {
+  value_t *target = args_getArg(args, index);
+
+  if (!VALUE_IS(target, TYPE_POINTER, FLAG_OBJECT | FLAG_STREAM)) {
+    return NULL;
+  }
+
+  return (stream_t*)value_getHeapNode(target)->ptr;
+}
+
+// a pointer the value does not own, into memory the stream does
+static value_t builtins_borrowed(const void *data) {
+  return value_fromRawPointer((void*)data, FLAG_NONE);
+}
+
+value_t _System_streamOpen(runtime_t *r, args_t *args) {
+  value_t *arg = args_getArg(args, 0);
+  stream_t *stream;
+  const char *str;
+  char *path;
+  size_t len;
+
+  if (value_getType(arg) != TYPE_POINTER || (value_getFlags(arg) & FLAG_OBJECT) || arg->data.raw == NULL) {
+    return builtins_none();
+  }
+
+  // a runtime string need not be terminated
+  str = builtins_string(arg, &len);
+  path = (char*)malloc(len + 1);
+  memcpy(path, str, len);
+  path[len] = '\0';
+
+  stream = stream_open(path);
+  free(path);
+
+  if (stream == NULL) {
+    return builtins_none();
+  }
+
+  return value_createStream(r, r->heap, stream);
+}
+
+value_t _System_streamReadInto(runtime_t *r, args_t *args) {
+  stream_t *stream = builtins_stream(args, 0);
+  value_t *buffer = args_getArg(args, 1);
+  int64_t offset = value_getInt(args_getArg(args, 2));
+  int64_t size;
+  uint8_t *dst;
+
+  // only a refcounted buffer knows where it ends
+  if (stream == NULL || !VALUE_HAS(buffer, TYPE_POINTER, FLAG_REFCOUNTED)) {
+    return value_fromInt(-1);
+  }
+
+  size = (int64_t)rc_size(buffer->data.rc);
+
+  if ((dst = builtins_range(buffer, offset, size - offset, true)) == NULL) {
+    return value_fromInt(-1);
+  }
+
+  return value_fromInt((int64_t)stream_read(stream, dst, (size_t)(size - offset)));
+}
+
+value_t _System_streamReadLine(runtime_t *r, args_t *args) {
+  stream_t *stream = builtins_stream(args, 0);
+  const char *line;
+  size_t len;
+
+  if (stream == NULL || (line = stream_readLine(stream, &len)) == NULL) {
+    return builtins_none();
+  }
+
+  return builtins_borrowed(line);
+}
+
+value_t _System_streamMap(runtime_t *r, args_t *args) {
+  stream_t *stream = builtins_stream(args, 0);
+  const void *data;
+  size_t len;
+
+  if (stream == NULL || (data = stream_map(stream, &len)) == NULL) {
+    return builtins_none();
+  }
+
+  return builtins_borrowed(data);
+}
+
+value_t _System_streamSize(runtime_t *r, args_t *args) {
+  stream_t *stream = builtins_stream(args, 0);
+
+  return value_fromInt(stream != NULL ? stream_size(stream) : -1);
+}
+
+value_t _System_streamClose(runtime_t *r, args_t *args) {
+  stream_t *stream = builtins_stream(args, 0);
+
+  if (stream != NULL) {
+    stream_close(stream);
+  }
+
+  return builtins_none();
+}
+
+// ===== Asynchronous I/O =====
+
+// the descriptor of a FILE pointer or stream argument, -1 if it is neither
+static int builtins_fd(value_t *v) {
+  if (VALUE_IS(v, TYPE_POINTER, FLAG_OBJECT | FLAG_STREAM)) {
+    stream_t *stream = (stream_t*)value_getHeapNode(v)->ptr;
+
+    return stream->fp != NULL ? fileno(stream->fp) : -1;
+  }
+
+  if (VALUE_IS(v, TYPE_POINTER, FLAG_NONE) && v->data.raw != NULL) {
+    return fileno((FILE*)v->data.raw);
+  }
+
+  return -1;
+}
+
+// argument `index` of aioPoll or aioWait, NULL if it is not a request
+static aio_request_t *builtins_aio(args_t *args, size_t index) {
+  value_t *target = args_getArg(args, index);
+
+  if (!VALUE_IS(target, TYPE_POINTER, FLAG_OBJECT | FLAG_AIO)) {
+    return NULL;
+  }
+
+  return (aio_request_t*)value_getHeapNode(target)->ptr;
+}
+
+static value_t builtins_submit(runtime_t *r, aio_op_t op, int fd, void *data, size_t size, int64_t position,
+                               refcounted_t claim) {
+  aio_request_t *req;
+
+  if (r->aio == NULL && (r->aio = aio_create()) == NULL) {
+    return builtins_none();
+  }
+
+  req = aio_request(r->aio, op, fd, data, size, position, claim);
+  aio_submit(req);
+
+  return value_createAio(r, r->heap, req);
+}
+
+value_t _System_aioRead(runtime_t *r, args_t *args) {
+  int fd = builtins_fd(args_getArg(args, 0));
+  value_t *buffer = args_getArg(args, 1);
+  int64_t position = value_getInt(args_getArg(args, 2));
+
+  // filled while the program runs, so only a buffer the request can claim,
+  // and which is not shared or a slice
+  if (fd < 0 || position < 0 || !VALUE_HAS(buffer, TYPE_POINTER, FLAG_REFCOUNTED) || VALUE_IS_SLICE(buffer) || rc_isShared(buffer->data.rc)) {
+    return builtins_none();
+  }
+
+  return builtins_submit(r, AIO_READ, fd, buffer->data.rc, rc_size(buffer->data.rc), position, buffer->data.rc);
+}
+
+value_t _System_aioWrite(runtime_t *r, args_t *args) {
+  int fd = builtins_fd(args_getArg(args, 0));
+  value_t *buffer = args_getArg(args, 1);
+  int64_t length = value_getInt(args_getArg(args, 2));
+  int64_t position = value_getInt(args_getArg(args, 3));
+  uint8_t *data = builtins_range(buffer, 0, length, false);
+
+  // inline data lives in the argument slot, which will not stay put
+  if (fd < 0 || position < 0 || data == NULL || VALUE_HAS(buffer, TYPE_POINTER, FLAG_INLINE)) {
+    return builtins_none();
+  }
+
+  return builtins_submit(r, AIO_WRITE, fd, data, (size_t)length, position,
+    VALUE_HAS(buffer, TYPE_POINTER, FLAG_REFCOUNTED) ? buffer->data.rc : NULL);
+}
+
+value_t _System_aioPoll(runtime_t *r, args_t *args) {
+  aio_request_t *req = builtins_aio(args, 0);
+
+  return value_fromBoolean(req != NULL && aio_poll(req));
+}
+
+value_t _System_aioWait(runtime_t *r, args_t *args) {
+  aio_request_t *req = builtins_aio(args, 0);
+
+  return value_fromInt(req != NULL ? aio_wait(req) : -1);
+}
+
+// ===== Sockets =====
+
+// argument `index` of a socket builtin, NULL if it is not a socket
+static net_socket_t *builtins_socket(args_t *args, size_t index) {
+  value_t *target = args_getArg(args, index);
+
+  if (!VALUE_IS(target, TYPE_POINTER, FLAG_OBJECT | FLAG_SOCKET)) {
+    return NULL;
+  }
+
+  return (net_socket_t*)value_getHeapNode(target)->ptr;
+}
+
+// a string argument, NULL if it is not one
+static const char *builtins_text(args_t *args, size_t index, size_t *len) {
+  value_t *v = args_getArg(args, index);
+
+  if (value_getType(v) != TYPE_POINTER || (value_getFlags(v) & FLAG_OBJECT) || v->data.raw == NULL) {
+    return NULL;
+  }
+
+  return builtins_string(v, len);
+}
+
+value_t _System_sockListen(runtime_t *r, args_t *args) {
+  value_t *backlog = args_getArg(args, 1);
+  net_socket_t *s;
+  const char *addr;
+  size_t len;
+
+  if ((addr = builtins_text(args, 0, &len)) == NULL) {
+    return builtins_none();
+  }
+
+  s = net_listen(addr, len, VALUE_TYPE_OF(backlog) == TYPE_INT && backlog->data.i64 > 0
+    ? (int)backlog->data.i64 : NET_BACKLOG);
+
+  return s != NULL ? value_createSocket(r, r->heap, s) : builtins_none();
+}
+
+value_t _System_sockConnect(runtime_t *r, args_t *args) {
+  net_socket_t *s;
+  const char *addr;
+  size_t len;
+
+  if ((addr = builtins_text(args, 0, &len)) == NULL || (s = net_connect(addr, len)) == NULL) {
+    return builtins_none();
+  }
+
+  return value_createSocket(r, r->heap, s);
+}
+
+value_t _System_sockAccept(runtime_t *r, args_t *args) {
+  net_socket_t *listener = builtins_socket(args, 0);
+  net_socket_t *s;
+
+  if (listener == NULL || (s = net_accept(listener)) == NULL) {
+    return builtins_none();
+  }
+
+  return value_createSocket(r, r->heap, s);
+}
+
+value_t _System_sockRead(runtime_t *r, args_t *args) {
+  net_socket_t *s = builtins_socket(args, 0);
+  int64_t length = value_getInt(args_getArg(args, 3));
+  uint8_t *dst = builtins_range(args_getArg(args, 1), value_getInt(args_getArg(args, 2)), length, true);
+
+  if (s == NULL || dst == NULL) {
+    return value_fromInt(-1);
+  }
+
+  return value_fromInt(net_read(s, dst, (size_t)length));
+}
+
+value_t _System_sockWrite(runtime_t *r, args_t *args) {
+  net_socket_t *s = builtins_socket(args, 0);
+  array_t *builder = builtins_builder(args, 1);
+  int64_t offset = value_getInt(args_getArg(args, 2));
+  int64_t length = value_getInt(args_getArg(args, 3));
+  const uint8_t *src;
+
+  // from a string builder's bytes, as they are
+  if (builder != NULL) {
+    src = offset >= 0 && length >= 0 && (uint64_t)offset <= builder->size
+      && (uint64_t)length <= builder->size - (uint64_t)offset ? (const uint8_t*)builder->data + offset : NULL;
+  } else {
+    src = builtins_range(args_getArg(args, 1), offset, length, false);
+  }
+
+  if (s == NULL || src == NULL) {
+    return value_fromInt(-1);
+  }
+
+  return value_fromInt(net_write(s, src, (size_t)length));
+}
+
+value_t _System_sockSendFile(runtime_t *r, args_t *args) {
+  net_socket_t *s = builtins_socket(args, 0);
+  int fd = builtins_fd(args_getArg(args, 1));
+  int64_t length = value_getInt(args_getArg(args, 3));
+
+  if (s == NULL || length < 0) {
+    return value_fromInt(-1);
+  }
+
+  return value_fromInt(net_sendFile(s, fd, value_getInt(args_getArg(args, 2)), (size_t)length));
+}
+
+value_t _System_sockWait(runtime_t *r, args_t *args) {
+  net_socket_t *s = builtins_socket(args, 0);
+  const char *mode;
+  size_t len;
+  bool write;
+
+  if (s == NULL || s->fd < 0) {
+    return value_fromBoolean(false);
+  }
+
+  mode = builtins_text(args, 1, &len);
+  write = mode != NULL && len == 5 && memcmp(mode, "write", 5) == 0;
+
+  // with other fibers to run meanwhile, this one is parked, and the yield
+  // after the call goes on with them
+  if (r->fibers != NULL && r->fibers->live > 1) {
+    if (r->net == NULL) {
+      r->net = net_create();
+    }
+
+    if (net_park(r->net, r->fibers, args_getArg(args, 0), write)) {
+      return value_fromBoolean(true);
+    }
+  }
+
+  net_wait(r, s, write);
+
+  return value_fromBoolean(true);
+}
+
+value_t _System_sockClose(runtime_t *r, args_t *args) {
+  net_socket_t *s = builtins_socket(args, 0);
+
+  if (s != NULL) {
+    net_close(r, s);
+  }
+
+  return builtins_none();
+}
+
+// ===== Tasks =====
+
+// argument `index` of taskJoin or taskDone, NULL if it is not a future
+static task_t *builtins_task(args_t *args, size_t index) {
+  value_t *target = args_getArg(args, index);
+
+  if (!VALUE_IS(target, TYPE_POINTER, FLAG_OBJECT | FLAG_TASK)) {
+    return NULL;
+  }
+
+  return (task_t*)value_getHeapNode(target)->ptr;
+}
+
+value_t _System_taskSpawn(runtime_t *r, args_t *args) {
+  value_t *label = args_getArg(args, 0);
+  task_t *task;
+
+  if (VALUE_TYPE_OF(label) != TYPE_UINT || (task = tasks_spawn(r, label->data.u64, args_getArg(args, 1))) == NULL) {
+    return builtins_none();
+  }
+
+  return value_createTask(r, r->heap, task);
+}
+
+value_t _System_taskJoin(runtime_t *r, args_t *args) {
+  task_t *task = builtins_task(args, 0);
+
+  return task != NULL ? tasks_join(r, task) : builtins_none();
+}
+
+value_t _System_taskDone(runtime_t *r, args_t *args) {
+  task_t *task = builtins_task(args, 0);
+
+  return value_fromBoolean(task != NULL && tasks_done(task));
+}
+
+value_t _System_share(runtime_t *r, args_t *args) {
+  value_t *v = args_getArg(args, 0);
+
+  if (VALUE_HAS(v, TYPE_POINTER, FLAG_REFCOUNTED)) {
+    rc_share(v->data.rc);
+  }
+
+  return *v;
+}
+
+// argument `index` of parallelMap or parallelReduce, NULL if it is neither
+// a label nor a native function
+static value_t *builtins_callback(args_t *args, size_t index) {
+  value_t *fn = args_getArg(args, index);
+
+  return VALUE_TYPE_OF(fn) == TYPE_UINT || VALUE_TYPE_OF(fn) == TYPE_FUNCTION ? fn : NULL;
+}
+
+value_t _System_parallelMap(runtime_t *r, args_t *args) {
+  array_t *array = builtins_array(args, 0);
+  value_t *fn = builtins_callback(args, 1);
+  value_t out;
+
+  if (array == NULL || fn == NULL || !tasks_map(r, array, fn, &out)) {
+    return builtins_none();
+  }
+
+  return out;
+}
+
+value_t _System_parallelReduce(runtime_t *r, args_t *args) {
+  array_t *array = builtins_array(args, 0);
+  value_t *fn = builtins_callback(args, 1);
+  value_t out;
+
+  if (array == NULL || fn == NULL || !tasks_reduce(r, array, fn, args_getArg(args, 2), &out)) {
+    return builtins_none();
+  }
+
+  return out;
+}
+
+value_t _System_parallelFor(runtime_t *r, args_t *args) {
+  value_t *start = args_getArg(args, 0);
+  value_t *end = args_getArg(args, 1);
+  value_t *fn = builtins_callback(args, 2);
+  value_t *reduction = args_getArg(args, 3);
+  tasks_reduction_t kind = TASKS_REDUCE_NONE;
+  const char *name;
+  size_t len;
+  value_t out;
+
+  if ((VALUE_TYPE_OF(start) != TYPE_INT && VALUE_TYPE_OF(start) != TYPE_UINT)
+      || (VALUE_TYPE_OF(end) != TYPE_INT && VALUE_TYPE_OF(end) != TYPE_UINT) || fn == NULL) {
+    builtins_throw(r, "parallelFor: expected start, end and a callback");
+    return builtins_none();
+  }
+
+  if (VALUE_TYPE_OF(reduction) != TYPE_NONE) {
+    if ((name = builtins_string(reduction, &len)) != NULL && len == 3 && memcmp(name, "sum", 3) == 0) {
+      kind = TASKS_REDUCE_SUM;
+    } else if (name != NULL && len == 5 && memcmp(name, "count", 5) == 0) {
+      kind = TASKS_REDUCE_COUNT;
+    } else if (name == NULL || len != 4 || memcmp(name, "none", 4) != 0) {
+      builtins_throw(r, "parallelFor: the reduction is \"sum\", \"count\" or \"none\"");
+      return builtins_none();
+    }
+  }
+
+  if (!tasks_for(r, value_getInt(start), value_getInt(end), fn, kind, &out)) {
+    return builtins_none();
+  }
+
+  return out;
+}
+
+// argument `index` of chanSend, chanRecv or chanClose, NULL if it is not a channel
+static channel_t *builtins_channel(args_t *args, size_t index) {
+  value_t *target = args_getArg(args, index);
+
+  if (!VALUE_IS(target, TYPE_POINTER, FLAG_OBJECT | FLAG_CHANNEL)) {
+    return NULL;
+  }
+
+  return (channel_t*)value_getHeapNode(target)->ptr;
+}
+
+value_t _System_chanCreate(runtime_t *r, args_t *args) {
+  value_t *capacity = args_getArg(args, 0);
+
+  if ((VALUE_TYPE_OF(capacity) != TYPE_INT && VALUE_TYPE_OF(capacity) != TYPE_UINT) || capacity->data.i64 <= 0) {
+    return builtins_none();
+  }
+
+  return value_createChannel(r, r->heap, channel_create((size_t)capacity->data.u64));
+}
+
+value_t _System_chanSend(runtime_t *r, args_t *args) {
+  channel_t *ch = builtins_channel(args, 0);
+
+  return value_fromBoolean(ch != NULL && channel_send(r, ch, args_getArg(args, 1)));
+}
+
+value_t _System_chanRecv(runtime_t *r, args_t *args) {
+  channel_t *ch = builtins_channel(args, 0);
+  value_t v = builtins_none();
+
+  if (ch != NULL) {
+    channel_recv(r, ch, &v);
+  }
+
+  return v;
+}
+
+value_t _System_chanClose(runtime_t *r, args_t *args) {
+  channel_t *ch = builtins_channel(args, 0);
+
+  if (ch != NULL) {
+    channel_close(ch);
+  }
+
+  return builtins_none();
+}
+
+// ===== Sorting =====
+
+value_t _System_sort(runtime_t *r, args_t *args) {
+  array_t *array = builtins_array(args, 0);
+
+  if (array == NULL) {
+    builtins_throw(r, "sort: not an array");
+    return builtins_none();
+  }
+
+  ++r->epoch;
+  sort_array(array);
+
+  return *args_getArg(args, 0);
+}
+
+// the keys of sortBy with a member name: borrowed from the elements, none
+// for an element that is not an object or lacks the member
+static void builtins_memberKeys(runtime_t *r, array_t *array, value_t *name, value_t *keys) {
+  object_key_t key = builtins_memberKey(r, name);
+  value_t *data = (value_t*)array->data;
+
+  for (size_t i = 0; i < array->size; i++) {
+    value_t *member = NULL;
+
+    if (!VALUE_IS(&data[i], TYPE_POINTER, FLAG_OBJECT)
+        || object_getPtr((object_t*)value_getHeapNode(&data[i])->ptr, key, &member) != OBJECT_OK) {
+      keys[i] = builtins_none();
+    } else {
+      keys[i] = *member;
+    }
+  }
+}
+
+// the keys of sortBy with a native function, called here on each element
+// in turn; they are owned
+static void builtins_callKeys(runtime_t *r, array_t *array, native_function_t fn, value_t *keys) {
+  value_t *data = (value_t*)array->data;
+
+  for (size_t i = 0; i < array->size; i++) {
+    value_t arg = data[i];
+    args_t a;
+
+    a._stack = NULL;
+    a._registers = &arg;
+    a._rawData = NULL;
+    a._operands = NULL;
+
+    keys[i] = fn(r, &a);
+  }
+}
+
+value_t _System_sortBy(runtime_t *r, args_t *args) {
+  array_t *array = builtins_array(args, 0);
+  value_t *by = args_getArg(args, 1);
+  value_t *fn = builtins_callback(args, 1);
+  value_t *keys;
+  value_t mapped;
+  bool owned = false; // the keys were given by a native function
+
+  if (array == NULL || array->kind != ARRAY_VALUES) {
+    builtins_throw(r, "sortBy: not an array of values");
+    return builtins_none();
+  }
+
+  if (fn != NULL && VALUE_TYPE_OF(fn) == TYPE_UINT) {
+    // bytecode runs on the pool, once per element, in parallel
+    if (!tasks_map(r, array, fn, &mapped)) {
+      builtins_throw(r, "sortBy: the task pool cannot be used from this thread");
+      return builtins_none();
+    }
+
+    keys = (value_t*)((array_t*)value_getHeapNode(&mapped)->ptr)->data;
+  } else {
+    if (fn == NULL && (value_getType(by) != TYPE_POINTER || (value_getFlags(by) & FLAG_OBJECT))) {
+      builtins_throw(r, "sortBy: the key is not a member name or a function");
+      return builtins_none();
+    }
+
+    if ((keys = (value_t*)malloc((array->size + 1) * sizeof(value_t))) == NULL) {
+      builtins_throw(r, "sortBy: out of memory");
+      return builtins_none();
+    }
+
+    if (fn != NULL) {
+      builtins_callKeys(r, array, fn->data.fn, keys);
+      owned = true;
+    } else {
+      builtins_memberKeys(r, array, by, keys);
+    }
+  }
+
+  ++r->epoch;
+
+  if (!sort_byKeys(array, keys)) {
+    builtins_throw(r, "sortBy: out of memory");
+  }
+
+  // those from the pool are in an array the collector frees
+  if (fn == NULL || VALUE_TYPE_OF(fn) != TYPE_UINT) {
+    for (size_t i = 0; owned && i < array->size; i++) {
+      value_release(r, &keys[i]);
+    }
+
+    free(keys);
+  }
+
+  return *args_getArg(args, 0);
+}
+
+// ===== Hashing =====
+
+value_t _System_hash64(runtime_t *r, args_t *args) {
+  int64_t length = value_getInt(args_getArg(args, 2));
+  uint8_t *src = builtins_range(args_getArg(args, 0), value_getInt(args_getArg(args, 1)), length, false);
+
+  if (src == NULL) {
+    builtins_throw(r, "hash64: invalid range");
+    return builtins_none();
+  }
+
+  return value_fromInt((int64_t)hashString64(src, (size_t)length));
+}
+
+value_t _System_crc32c(runtime_t *r, args_t *args) {
+  int64_t length = value_getInt(args_getArg(args, 2));
+  uint8_t *src = builtins_range(args_getArg(args, 0), value_getInt(args_getArg(args, 1)), length, false);
+
+  if (src == NULL) {
+    builtins_throw(r, "crc32c: invalid range");
+    return builtins_none();
+  }
+
+  return value_fromInt(hashCrc32c((uint32_t)value_getInt(args_getArg(args, 3)), src, (size_t)length));
+}
+
+value_t _System_hashCreate(runtime_t *r, args_t *args) {
+  hashstream_t *h = (hashstream_t*)rc_alloc(r->quota, sizeof(hashstream_t), runtime_site(r));
+  value_t v;
+
+  if (h == NULL) {
+    builtins_throw(r, "hashCreate: out of memory");
+    return builtins_none();
+  }
+
+  hashstream_init(h);
+  value_setRefCounted(r, &v, h);
+
+  return v;
+}
+
+// argument `index` as a hasher of hashCreate, NULL if it is not one
+static hashstream_t *builtins_hasher(args_t *args, size_t index, bool write) {
+  hashstream_t *h = (hashstream_t*)builtins_range(args_getArg(args, index), 0, sizeof(hashstream_t), write);
+
+  return h != NULL && h->magic == HASHSTREAM_MAGIC ? h : NULL;
+}
+
+value_t _System_hashUpdate(runtime_t *r, args_t *args) {
+  hashstream_t *h = builtins_hasher(args, 0, true);
+  int64_t length = value_getInt(args_getArg(args, 3));
+  uint8_t *src;
+
+  if (h == NULL) {
+    builtins_throw(r, "hashUpdate: not a hasher");
+    return builtins_none();
+  }
+
+  if ((src = builtins_range(args_getArg(args, 1), value_getInt(args_getArg(args, 2)), length, false)) == NULL) {
+    builtins_throw(r, "hashUpdate: invalid range");
+    return builtins_none();
+  }
+
+  hashstream_update(h, src, (size_t)length);
+
+  return *args_getArg(args, 0);
+}
+
+value_t _System_hashDigest(runtime_t *r, args_t *args) {
+  hashstream_t *h = builtins_hasher(args, 0, false);
+
+  if (h == NULL) {
+    builtins_throw(r, "hashDigest: not a hasher");
+    return builtins_none();
+  }
+
+  return value_fromInt((int64_t)hashstream_digest(h));
+}
+
+// ===== Benchmarks =====
+
+value_t _System_clockNs(runtime_t *r, args_t *args) {
+  return value_fromInt((int64_t)runtime_nowNs());
+}
+
+value_t _System_benchBegin(runtime_t *r, args_t *args) {
+  size_t len;
+  const char *name = builtins_string(args_getArg(args, 0), &len);
+  bench_t *b;
+  value_t v;
+
+  if (name == NULL) {
+    builtins_throw(r, "benchBegin: not a string");
+    return builtins_none();
+  }
+
+  if ((b = (bench_t*)rc_alloc(r->quota, bench_size(len), runtime_site(r))) == NULL) {
+    builtins_throw(r, "benchBegin: out of memory");
+    return builtins_none();
+  }
+
+  bench_init(b, name, len);
+  value_setRefCounted(r, &v, b);
+
+  return v;
+}
+
+value_t _System_benchStep(runtime_t *r, args_t *args) {
+  bench_t *b = (bench_t*)builtins_range(args_getArg(args, 0), 0, sizeof(bench_t), true);
+
+  if (b == NULL || b->magic != BENCH_MAGIC) {
+    builtins_throw(r, "benchStep: not a bench");
+    return builtins_none();
+  }
+
+  return value_fromInt((int64_t)bench_step(r, b));
+}
+
+// the native function bound to each BUILTIN_C_FUNCTIONS slot, and the
+// name bcparse binds the slot to
+static const struct {
+  uint32_t slot;
+  native_function_t fn;
+  const char *name;
+} builtins_table[] = {
+  { BUILTIN_SYSTEM_CREATE_OBJECT, _System_createObject, "createObject" },
+  { BUILTIN_SYSTEM_CREATE_OBJECT_SIZED, _System_createObjectSized, "createObjectSized" },
+  { BUILTIN_SYSTEM_GET_OBJECT_MEMBER, _System_getObjectMember, "getObjectMember" },
+  { BUILTIN_SYSTEM_SET_OBJECT_MEMBER, _System_setObjectMember, "setObjectMember" },
+
+  { BUILTIN_SYSTEM_ARRAY_CREATE, _System_arrayCreate, "arrayCreate" },
+  { BUILTIN_SYSTEM_ARRAY_CREATE_INT, _System_arrayCreateInt, "arrayCreateInt" },
+  { BUILTIN_SYSTEM_ARRAY_CREATE_FLOAT, _System_arrayCreateFloat, "arrayCreateFloat" },
+  { BUILTIN_SYSTEM_ARRAY_GET_INDEX, _System_arrayGetIndex, "arrayGetIndex" },
+  { BUILTIN_SYSTEM_ARRAY_SET_INDEX, _System_arraySetIndex, "arraySetIndex" },
+  { BUILTIN_SYSTEM_ARRAY_PUSH, _System_arrayPush, "arrayPush" },
+  { BUILTIN_SYSTEM_ARRAY_SIZE, _System_arraySize, "arraySize" },
+
+  { BUILTIN_SYSTEM_STR_BUILDER, _System_strBuilder, "strBuilder" },
+  { BUILTIN_SYSTEM_STR_APPEND, _System_strAppend, "strAppend" },
+  { BUILTIN_SYSTEM_STR_BUILD, _System_strBuild, "strBuild" },
+  { BUILTIN_SYSTEM_STR_SLICE, _System_strSlice, "strSlice" },
+  { BUILTIN_SYSTEM_STR_COPY, _System_strCopy, "strCopy" },
+
+  { BUILTIN_SYSTEM_SCAN_FIND, _System_scanFind, "scanFind" },
+  { BUILTIN_SYSTEM_SCAN_SKIP, _System_scanSkip, "scanSkip" },
+  { BUILTIN_SYSTEM_PARSE_INT, _System_parseInt, "parseInt" },
+  { BUILTIN_SYSTEM_PARSE_DOUBLE, _System_parseDouble, "parseDouble" },
+  { BUILTIN_SYSTEM_FORMAT_INT, _System_formatInt, "formatInt" },
+  { BUILTIN_SYSTEM_FORMAT_DOUBLE, _System_formatDouble, "formatDouble" },
+  { BUILTIN_SYSTEM_THROW, _System_throw, "throw" },
+
+  { BUILTIN_SYSTEM_VEC_ADD, _System_vecAdd, "vecAdd" },
+  { BUILTIN_SYSTEM_VEC_MUL, _System_vecMul, "vecMul" },
+  { BUILTIN_SYSTEM_VEC_FMA, _System_vecFma, "vecFma" },
+  { BUILTIN_SYSTEM_VEC_DOT, _System_vecDot, "vecDot" },
+  { BUILTIN_SYSTEM_VEC_SUM, _System_vecSum, "vecSum" },
+  { BUILTIN_SYSTEM_VEC_MIN, _System_vecMin, "vecMin" },
+  { BUILTIN_SYSTEM_VEC_MAX, _System_vecMax, "vecMax" },
+
+  { BUILTIN_SYSTEM_MAP_CREATE, _System_mapCreate, "mapCreate" },
+  { BUILTIN_SYSTEM_MAP_GET, _System_mapGet, "mapGet" },
+  { BUILTIN_SYSTEM_MAP_SET, _System_mapSet, "mapSet" },
+  { BUILTIN_SYSTEM_MAP_HAS, _System_mapHas, "mapHas" },
+  { BUILTIN_SYSTEM_MAP_REMOVE, _System_mapRemove, "mapRemove" },
+  { BUILTIN_SYSTEM_MAP_SIZE, _System_mapSize, "mapSize" },
+  { BUILTIN_SYSTEM_MAP_KEYS, _System_mapKeys, "mapKeys" },
+
+  { BUILTIN_SYSTEM_TABLE_CREATE, _System_tableCreate, "tableCreate" },
+  { BUILTIN_SYSTEM_TABLE_APPEND, _System_tableAppend, "tableAppend" },
+  { BUILTIN_SYSTEM_TABLE_GET, _System_tableGet, "tableGet" },
+  { BUILTIN_SYSTEM_TABLE_SET, _System_tableSet, "tableSet" },
+  { BUILTIN_SYSTEM_TABLE_ROW, _System_tableRow, "tableRow" },
+  { BUILTIN_SYSTEM_TABLE_SIZE, _System_tableSize, "tableSize" },
+
+  { BUILTIN_SYSTEM_SERIALIZE, _System_serialize, "serialize" },
+  { BUILTIN_SYSTEM_DESERIALIZE, _System_deserialize, "deserialize" },
+  { BUILTIN_SYSTEM_PARSE_JSON, _System_parseJson, "parseJson" },
+  { BUILTIN_SYSTEM_STRINGIFY_JSON, _System_stringifyJson, "stringifyJson" },
+
+  { BUILTIN_SYSTEM_REGEX_COMPILE, _System_regexCompile, "regexCompile" },
+  { BUILTIN_SYSTEM_REGEX_MATCH, _System_regexMatch, "regexMatch" },
+  { BUILTIN_SYSTEM_REGEX_FIND, _System_regexFind, "regexFind" },
+
+  { BUILTIN_SYSTEM_SORT, _System_sort, "sort" },
+  { BUILTIN_SYSTEM_SORT_BY, _System_sortBy, "sortBy" },
+
+  { BUILTIN_SYSTEM_HASH64, _System_hash64, "hash64" },
+  { BUILTIN_SYSTEM_CRC32C, _System_crc32c, "crc32c" },
+  { BUILTIN_SYSTEM_HASH_CREATE, _System_hashCreate, "hashCreate" },
+  { BUILTIN_SYSTEM_HASH_UPDATE, _System_hashUpdate, "hashUpdate" },
+  { BUILTIN_SYSTEM_HASH_DIGEST, _System_hashDigest, "hashDigest" },
+
+  { BUILTIN_SYSTEM_CLOCK_NS, _System_clockNs, "clockNs" },
+  { BUILTIN_SYSTEM_BENCH_BEGIN, _System_benchBegin, "benchBegin" },
+  { BUILTIN_SYSTEM_BENCH_STEP, _System_benchStep, "benchStep" },
+
+  { BUILTIN_SYSTEM_PARALLEL_FOR, _System_parallelFor, "parallelFor" },
+  { BUILTIN_SYSTEM_CACHE_CREATE, _System_cacheCreate, "cacheCreate" },
+  { BUILTIN_SYSTEM_CACHE_GET, _System_cacheGet, "cacheGet" },
+  { BUILTIN_SYSTEM_CACHE_SET, _System_cacheSet, "cacheSet" },
+  { BUILTIN_SYSTEM_CACHE_REMOVE, _System_cacheRemove, "cacheRemove" },
+  { BUILTIN_SYSTEM_CACHE_SIZE, _System_cacheSize, "cacheSize" },
+  { BUILTIN_SYSTEM_CACHE_EVICTIONS, _System_cacheEvictions, "cacheEvictions" },
+  { BUILTIN_SYSTEM_SOCK_LISTEN, _System_sockListen, "sockListen" },
+  { BUILTIN_SYSTEM_SOCK_CONNECT, _System_sockConnect, "sockConnect" },
+  { BUILTIN_SYSTEM_SOCK_ACCEPT, _System_sockAccept, "sockAccept" },
+  { BUILTIN_SYSTEM_SOCK_READ, _System_sockRead, "sockRead" },
+  { BUILTIN_SYSTEM_SOCK_WRITE, _System_sockWrite, "sockWrite" },
+  { BUILTIN_SYSTEM_SOCK_SEND_FILE, _System_sockSendFile, "sockSendFile" },
+  { BUILTIN_SYSTEM_SOCK_WAIT, _System_sockWait, "sockWait" },
+  { BUILTIN_SYSTEM_SOCK_CLOSE, _System_sockClose, "sockClose" },
+  { BUILTIN_SYSTEM_STREQ, _System_streq, "streq" },
+  { BUILTIN_SYSTEM_STR_INTERN, _System_strIntern, "strIntern" },
+
+  { BUILTIN_SYSTEM_OBJECT_KEYS, _System_objectKeys, "objectKeys" },
+  { BUILTIN_SYSTEM_OBJECT_VALUES, _System_objectValues, "objectValues" },
+  { BUILTIN_SYSTEM_OBJECT_FOR_EACH, _System_objectForEach, "objectForEach" },
+  { BUILTIN_SYSTEM_OBJECT_CLONE, _System_objectClone, "objectClone" },
+  { BUILTIN_SYSTEM_OBJECT_ASSIGN, _System_objectAssign, "objectAssign" },
+
+  { BUILTIN_SYSTEM_STRUCT_CREATE, _System_structCreate, "structCreate" },
+  { BUILTIN_SYSTEM_GET_SLOT, _System_getSlot, "getSlot" },
+  { BUILTIN_SYSTEM_SET_SLOT, _System_setSlot, "setSlot" },
+
+  { BUILTIN_SYSTEM_SNAPSHOT, _System_snapshot, "snapshot" },
+  { BUILTIN_SYSTEM_FLUSH, _System_flush, "flush" },
+  { BUILTIN_SYSTEM_TRACE_DUMP, _System_traceDump, "traceDump" },
+  { BUILTIN_SYSTEM_HEAP_CENSUS, _System_heapCensus, "heapCensus" },
+
+  { BUILTIN_SYSTEM_CREATE_SCRATCH_OBJECT, _System_createScratchObject, "createScratchObject" },
+  { BUILTIN_SYSTEM_SCRATCH_RELEASE, _System_scratchRelease, "scratchRelease" },
+  { BUILTIN_SYSTEM_CREATE_FROM_TEMPLATE, _System_createFromTemplate, "createFromTemplate" },
+  { BUILTIN_SYSTEM_ARENA_BEGIN, _System_arenaBegin, "arenaBegin" },
+  { BUILTIN_SYSTEM_ARENA_END, _System_arenaEnd, "arenaEnd" },
+
+  { BUILTIN_SYSTEM_STREAM_OPEN, _System_streamOpen, "streamOpen" },
+  { BUILTIN_SYSTEM_STREAM_READ_INTO, _System_streamReadInto, "streamReadInto" },
+  { BUILTIN_SYSTEM_STREAM_READ_LINE, _System_streamReadLine, "streamReadLine" },
+  { BUILTIN_SYSTEM_STREAM_MAP, _System_streamMap, "streamMap" },
+  { BUILTIN_SYSTEM_STREAM_SIZE, _System_streamSize, "streamSize" },
+  { BUILTIN_SYSTEM_STREAM_CLOSE, _System_streamClose, "streamClose" },
+
+  { BUILTIN_SYSTEM_AIO_READ, _System_aioRead, "aioRead" },
+  { BUILTIN_SYSTEM_AIO_WRITE, _System_aioWrite, "aioWrite" },
+  { BUILTIN_SYSTEM_AIO_POLL, _System_aioPoll, "aioPoll" },
+  { BUILTIN_SYSTEM_AIO_WAIT, _System_aioWait, "aioWait" },
+
+  { BUILTIN_SYSTEM_INPUT, _System_input, "input" },
+
+  { BUILTIN_SYSTEM_TASK_SPAWN, _System_taskSpawn, "taskSpawn" },
+  { BUILTIN_SYSTEM_TASK_JOIN, _System_taskJoin, "taskJoin" },
+  { BUILTIN_SYSTEM_TASK_DONE, _System_taskDone, "taskDone" },
+
+  { BUILTIN_SYSTEM_CHAN_CREATE, _System_chanCreate, "chanCreate" },
+  { BUILTIN_SYSTEM_CHAN_SEND, _System_chanSend, "chanSend" },
+  { BUILTIN_SYSTEM_CHAN_RECV, _System_chanRecv, "chanRecv" },
+  { BUILTIN_SYSTEM_CHAN_CLOSE, _System_chanClose, "chanClose" },
+
+  { BUILTIN_SYSTEM_SHARE, _System_share, "share" },
+
+  { BUILTIN_SYSTEM_PARALLEL_MAP, _System_parallelMap, "parallelMap" },
+  { BUILTIN_SYSTEM_PARALLEL_REDUCE, _System_parallelReduce, "parallelReduce" },
+
+  { BUILTIN_SYSTEM_C_EXIT, _System_C_exit, "exit" },
+  { BUILTIN_SYSTEM_C_FMOD, _System_C_fmod, "fmod" },
+  { BUILTIN_SYSTEM_C_STRLEN, _System_C_strlen, "strlen" },
+
+  { BUILTIN_SYSTEM_C_FOPEN, _System_C_fopen, "fopen" },
+  { BUILTIN_SYSTEM_C_FCLOSE, _System_C_fclose, "fclose" },
+  { BUILTIN_SYSTEM_C_FREAD, _System_C_fread, "fread" },
+  { BUILTIN_SYSTEM_C_FWRITE, _System_C_fwrite, "fwrite" },
+  { BUILTIN_SYSTEM_C_FSEEK, _System_C_fseek, "fseek" },
+
+  { BUILTIN_SYSTEM_C_MEMCPY, _System_C_memcpy, "memcpy" },
+  { BUILTIN_SYSTEM_C_MEMSET, _System_C_memset, "memset" },
+  { BUILTIN_SYSTEM_C_MEMCHR, _System_C_memchr, "memchr" },
+  { BUILTIN_SYSTEM_C_MEMCMP, _System_C_memcmp, "memcmp" }
+};
+
+#define BUILTINS_COUNT (sizeof(builtins_table) / sizeof(builtins_table[0]))
+
+void builtins_register(runtime_t *rt) {
+  for (size_t i = 0; i < BUILTINS_COUNT; i++) {
+    rt->dt->storage[AT_DATA].data[builtins_table[i].slot] = value_fromFunction(builtins_table[i].fn);
+  }
+
+  for (size_t i = 0; i < BUILTIN_HOST_COUNT; i++) {
+    if (rt->hosts[i] != NULL) {
+      rt->dt->storage[AT_DATA].data[BUILTIN_HOST_FIRST + i] = value_fromFunction(rt->hosts[i]);
+    }
+  }
+}
+
+int builtins_slotOf(native_function_t fn) {
+  for (size_t i = 0; i < BUILTINS_COUNT; i++) {
+    if (builtins_table[i].fn == fn) {
+      return (int)builtins_table[i].slot;
+    }
+  }
+
+  return -1;
+}
+
+native_function_t builtins_function(uint32_t slot) {
+  for (size_t i = 0; i < BUILTINS_COUNT; i++) {
+    if (builtins_table[i].slot == slot) {
+      return builtins_table[i].fn;
+    }
+  }
+
+  return NULL;
+}
+
+const char *builtins_name(native_function_t fn) {
+  for (size_t i = 0; i < BUILTINS_COUNT; i++) {
+    if (builtins_table[i].fn == fn) {
+      return builtins_table[i].name;
+    }
+  }
+
+  return NULL;
+}
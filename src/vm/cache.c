@@ -0,0 +1,285 @@
+#include <vm/cache.h>
+#include <vm/heap.h>
+#include <vm/runtime.h>
+
+#include <stddef.h>
+#include <string.h>
+
+cache_t *cache_create(heap_t *heap, heap_value_t *node, size_t maxEntries, size_t maxBytes, bool weak) {
+  cache_t *cache = (cache_t*)heap_allocBlock(heap, sizeof(cache_t));
+
+  if (cache == NULL) {
+    return NULL;
+  }
+
+  memset(cache, 0, sizeof(cache_t));
+  cache->heap = heap;
+  cache->node = node;
+  cache->maxEntries = maxEntries;
+  cache->maxBytes = maxBytes;
+  cache->weak = weak;
+  cache->free = CACHE_NO_SLOT;
+
+  if ((cache->index = map_create(heap)) == NULL) {
+    heap_freeBlock(heap, cache, sizeof(cache_t));
+    return NULL;
+  }
+
+  if (weak) {
+    heap_lock(heap);
+    cache->nextWeak = heap->weak;
+    heap->weak = cache;
+    heap_unlock(heap);
+  }
+
+  return cache;
+}
+
+void cache_destroy(cache_t *cache) {
+  heap_t *heap = cache->heap;
+
+  if (cache->weak) {
+    heap_lock(heap);
+
+    for (cache_t **c = &heap->weak; *c != NULL; c = &(*c)->nextWeak) {
+      if (*c == cache) {
+        *c = cache->nextWeak;
+        break;
+      }
+    }
+
+    heap_unlock(heap);
+  }
+
+  map_destroy(cache->index);
+  heap_freeBlock(heap, cache->slots, cache->numSlots * sizeof(cache_slot_t));
+  heap_freeBlock(heap, cache, sizeof(cache_t));
+}
+
+void cache_mark(cache_t *cache, heap_t *heap) {
+  if (cache->weak) {
+    return;
+  }
+
+  for (size_t i = 0; i < cache->numSlots; i++) {
+    if (cache->slots[i].key != NULL) {
+      heap_mark(heap, &cache->slots[i].value);
+    }
+  }
+}
+
+void cache_destructor(runtime_t *rt, args_t *args) {
+  if (args->_rawData != NULL) {
+    cache_destroy((cache_t*)args->_rawData);
+  }
+}
+
+// what an entry counts against maxBytes, past its key: a refcounted
+// string's bytes, nothing for other values
+static size_t cache_valueBytes(value_t *v) {
+  if (VALUE_IS_SLICE(v)) {
+    return VALUE_SLICE_LENGTH(v);
+  }
+
+  if (VALUE_HAS(v, TYPE_POINTER, FLAG_REFCOUNTED)) {
+    return rc_size(v->data.rc);
+  }
+
+  return 0;
+}
+
+static void cache_freeSlot(runtime_t *rt, cache_t *cache, uint32_t i) {
+  cache_slot_t *slot = &cache->slots[i];
+
+  cache->size--;
+  cache->bytes -= slot->bytes;
+
+  value_release(rt, &slot->value);
+  VALUE_SET_META(&slot->value, TYPE_NONE, FLAG_NONE);
+  // frees the key the slot points to
+  map_remove(rt, cache->index, slot->key, slot->len);
+
+  slot->key = NULL;
+  slot->next = cache->free;
+  cache->free = i;
+}
+
+// the entry CLOCK picks goes; there is one
+static void cache_evict(runtime_t *rt, cache_t *cache) {
+  for (;;) {
+    cache_slot_t *slot;
+
+    if (cache->hand >= cache->numSlots) {
+      cache->hand = 0;
+    }
+
+    slot = &cache->slots[cache->hand];
+
+    if (slot->key != NULL) {
+      if (!slot->referenced) {
+        cache_freeSlot(rt, cache, (uint32_t)cache->hand++);
+        cache->evictions++;
+        return;
+      }
+
+      slot->referenced = false;
+    }
+
+    cache->hand++;
+  }
+}
+
+// twice the slots, up to maxEntries; the new ones free
+static bool cache_grow(cache_t *cache) {
+  size_t numSlots = cache->numSlots != 0 ? cache->numSlots * 2 : CACHE_INITIAL_SLOTS;
+  cache_slot_t *slots;
+
+  if (cache->maxEntries != 0 && numSlots > cache->maxEntries) {
+    numSlots = cache->maxEntries;
+  }
+
+  if (numSlots >= CACHE_NO_SLOT || (slots = (cache_slot_t*)heap_allocBlock(cache->heap, numSlots * sizeof(cache_slot_t))) == NULL) {
+    return false;
+  }
+
+  if (cache->numSlots != 0) {
+    memcpy(slots, cache->slots, cache->numSlots * sizeof(cache_slot_t));
+    heap_freeBlock(cache->heap, cache->slots, cache->numSlots * sizeof(cache_slot_t));
+  }
+
+  for (size_t i = numSlots; i-- > cache->numSlots;) {
+    slots[i].key = NULL;
+    VALUE_SET_META(&slots[i].value, TYPE_NONE, FLAG_NONE);
+    slots[i].next = cache->free;
+    cache->free = (uint32_t)i;
+  }
+
+  cache->slots = slots;
+  cache->numSlots = numSlots;
+
+  return true;
+}
+
+value_t *cache_get(cache_t *cache, const char *key, size_t len) {
+  value_t *found = map_get(cache->index, key, len);
+  cache_slot_t *slot;
+
+  if (found == NULL) {
+    return NULL;
+  }
+
+  slot = &cache->slots[found->data.i64];
+  slot->referenced = true;
+
+  return &slot->value;
+}
+
+bool cache_put(runtime_t *rt, cache_t *cache, const char *key, size_t len, value_t *value) {
+  value_t *found = map_get(cache->index, key, len);
+  size_t bytes = len + cache_valueBytes(value);
+  cache_slot_t *slot;
+  value_t number;
+  uint32_t i;
+
+  if (cache->maxBytes != 0 && bytes > cache->maxBytes) {
+    if (found != NULL) {
+      cache_freeSlot(rt, cache, (uint32_t)found->data.i64);
+    }
+
+    return true;
+  }
+
+  if (found != NULL) {
+    slot = &cache->slots[found->data.i64];
+    slot->referenced = true;
+    cache->bytes += bytes - slot->bytes;
+    slot->bytes = bytes;
+    value_copyValue(rt, &slot->value, value);
+
+    // its bit is set, so it goes last
+    while (cache->maxBytes != 0 && cache->bytes > cache->maxBytes) {
+      cache_evict(rt, cache);
+    }
+
+    return true;
+  }
+
+  while (cache->size != 0 && ((cache->maxEntries != 0 && cache->size >= cache->maxEntries)
+      || (cache->maxBytes != 0 && cache->bytes + bytes > cache->maxBytes))) {
+    cache_evict(rt, cache);
+  }
+
+  if (cache->free == CACHE_NO_SLOT && !cache_grow(cache)) {
+    return false;
+  }
+
+  i = cache->free;
+  number = value_fromInt((int64_t)i);
+
+  if (!map_set(rt, cache->index, key, len, &number)) {
+    return false;
+  }
+
+  // the slot keeps the index's copy of the key, which stays where it is
+  // while the entry does
+  found = map_get(cache->index, key, len);
+
+  slot = &cache->slots[i];
+  cache->free = slot->next;
+  slot->key = ((map_entry_t*)((char*)found - offsetof(map_entry_t, value)))->key;
+  slot->len = len;
+  slot->bytes = bytes;
+  slot->referenced = false;
+  VALUE_SET_META(&slot->value, TYPE_NONE, FLAG_NONE);
+  value_copyValue(rt, &slot->value, value);
+
+  cache->size++;
+  cache->bytes += bytes;
+
+  return true;
+}
+
+bool cache_remove(runtime_t *rt, cache_t *cache, const char *key, size_t len) {
+  value_t *found = map_get(cache->index, key, len);
+
+  if (found == NULL) {
+    return false;
+  }
+
+  cache_freeSlot(rt, cache, (uint32_t)found->data.i64);
+
+  return true;
+}
+
+// whether the node lives on past this collection: marked, or old while
+// only the nursery was marked
+static inline bool cache_isLive(heap_t *heap, heap_value_t *hv) {
+  return (hv->flags & FLAG_MARKED) || (heap->minor && (hv->flags & FLAG_OLD));
+}
+
+void cache_sweep(runtime_t *rt, heap_t *heap) {
+  bool dropped = false;
+
+  for (cache_t *cache = heap->weak; cache != NULL; cache = cache->nextWeak) {
+    // a dead cache goes as a whole
+    if (!cache_isLive(heap, cache->node)) {
+      continue;
+    }
+
+    for (size_t i = 0; i < cache->numSlots; i++) {
+      value_t *v = &cache->slots[i].value;
+
+      if (cache->slots[i].key != NULL && VALUE_HAS(v, TYPE_POINTER, FLAG_OBJECT)
+          && v->data.hv != NULL && !cache_isLive(heap, v->data.hv)) {
+        cache_freeSlot(rt, cache, (uint32_t)i);
+        cache->evictions++;
+        dropped = true;
+      }
+    }
+  }
+
+  // memoized results that took a cache may be stale now
+  if (dropped) {
+    ++rt->epoch;
+  }
+}
@@ -0,0 +1,152 @@
+#include <vm/calls.h>
+#include <vm/builtins.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+calls_t *calls_create(void) {
+  return (calls_t*)calloc(1, sizeof(calls_t));
+}
+
+void calls_destroy(calls_t *calls) {
+  free(calls);
+}
+
+// the bucket `nanos` falls in: itself below CALLS_LINEAR, then its top
+// CALLS_SUB_BITS bits below the leading one within its power of two
+static size_t calls_bucketOf(uint64_t nanos) {
+  unsigned int exponent;
+
+  if (nanos < CALLS_LINEAR) {
+    return (size_t)nanos;
+  }
+
+  exponent = 63 - (unsigned int)__builtin_clzll(nanos);
+
+  return CALLS_LINEAR + (size_t)(exponent - 4) * CALLS_SUB_BUCKETS
+    + (size_t)((nanos >> (exponent - CALLS_SUB_BITS)) & (CALLS_SUB_BUCKETS - 1));
+}
+
+// the largest value that falls in `bucket`
+static uint64_t calls_bucketMax(size_t bucket) {
+  unsigned int exponent;
+  uint64_t sub;
+
+  if (bucket < CALLS_LINEAR) {
+    return (uint64_t)bucket;
+  }
+
+  exponent = (unsigned int)((bucket - CALLS_LINEAR) / CALLS_SUB_BUCKETS) + 4;
+  sub = (bucket - CALLS_LINEAR) % CALLS_SUB_BUCKETS;
+
+  return ((CALLS_SUB_BUCKETS + sub + 1) << (exponent - CALLS_SUB_BITS)) - 1;
+}
+
+void calls_record(calls_t *calls, native_function_t fn, uint64_t nanos) {
+  size_t hash = (size_t)(((uint64_t)(uintptr_t)fn >> 4) * 0x9e3779b97f4a7c15ull >> 32);
+
+  for (size_t i = 0; i < CALLS_MAX_FUNCTIONS; i++) {
+    calls_function_t *function = &calls->functions[(hash + i) & (CALLS_MAX_FUNCTIONS - 1)];
+
+    if (function->fn == NULL) {
+      function->fn = fn;
+    } else if (function->fn != fn) {
+      continue;
+    }
+
+    function->count++;
+    function->nanos += nanos;
+    function->max = nanos > function->max ? nanos : function->max;
+    function->buckets[calls_bucketOf(nanos)]++;
+
+    return;
+  }
+
+  calls->dropped++;
+}
+
+// the value at or below which `percent` of the calls took, to within a
+// bucket, and never past the maximum
+static uint64_t calls_percentile(const calls_function_t *function, double percent) {
+  uint64_t rank = (uint64_t)((double)function->count * percent / 100.0 + 0.5), seen = 0;
+
+  if (rank == 0) {
+    rank = 1;
+  }
+
+  for (size_t i = 0; i < CALLS_BUCKETS; i++) {
+    seen += function->buckets[i];
+
+    if (seen >= rank) {
+      uint64_t max = calls_bucketMax(i);
+
+      return max < function->max ? max : function->max;
+    }
+  }
+
+  return function->max;
+}
+
+// by total time, the most first
+static int calls_compare(const void *a, const void *b) {
+  const calls_function_t *l = *(const calls_function_t *const*)a, *r = *(const calls_function_t *const*)b;
+
+  return l->nanos < r->nanos ? 1 : -(l->nanos > r->nanos);
+}
+
+void calls_write(const calls_t *calls, FILE *f, bool json) {
+  const calls_function_t *called[CALLS_MAX_FUNCTIONS];
+  size_t numCalled = 0;
+  uint64_t total = 0;
+
+  for (size_t i = 0; i < CALLS_MAX_FUNCTIONS; i++) {
+    if (calls->functions[i].fn != NULL) {
+      called[numCalled++] = &calls->functions[i];
+      total += calls->functions[i].nanos;
+    }
+  }
+
+  qsort(called, numCalled, sizeof(called[0]), calls_compare);
+
+  if (json) {
+    fprintf(f, "{\"total_ns\": %llu, \"functions\": [", (unsigned long long)total);
+  } else {
+    fprintf(f, "calls: %.3f ms\n", total / 1e6);
+    fprintf(f, "  %-20s %10s %10s %6s %10s %10s %10s %10s %10s\n",
+      "function", "calls", "ms", "%", "mean us", "p50 us", "p90 us", "p99 us", "max us");
+  }
+
+  for (size_t i = 0; i < numCalled; i++) {
+    const calls_function_t *function = called[i];
+    const char *name = builtins_name(function->fn);
+    char address[32];
+
+    if (name == NULL) {
+      snprintf(address, sizeof(address), "%p", (void*)(uintptr_t)function->fn);
+      name = address;
+    }
+
+    if (json) {
+      fprintf(f, "%s{\"function\": \"%s\", \"builtin\": %s, \"calls\": %llu, \"total_ns\": %llu, "
+        "\"p50_ns\": %llu, \"p90_ns\": %llu, \"p99_ns\": %llu, \"max_ns\": %llu}",
+        i == 0 ? "" : ", ", name, name == address ? "false" : "true",
+        (unsigned long long)function->count, (unsigned long long)function->nanos,
+        (unsigned long long)calls_percentile(function, 50), (unsigned long long)calls_percentile(function, 90),
+        (unsigned long long)calls_percentile(function, 99), (unsigned long long)function->max);
+    } else {
+      fprintf(f, "  %-20s %10llu %10.3f %6.2f %10.3f %10.3f %10.3f %10.3f %10.3f\n",
+        name, (unsigned long long)function->count, function->nanos / 1e6,
+        total != 0 ? 100.0 * (double)function->nanos / (double)total : 0.0,
+        (double)function->nanos / (double)function->count / 1e3,
+        calls_percentile(function, 50) / 1e3, calls_percentile(function, 90) / 1e3,
+        calls_percentile(function, 99) / 1e3, function->max / 1e3);
+    }
+  }
+
+  if (json) {
+    fprintf(f, "], \"dropped\": %llu}\n", (unsigned long long)calls->dropped);
+  } else if (calls->dropped != 0) {
+    fprintf(f, "  (%llu calls of functions past %d not counted)\n",
+      (unsigned long long)calls->dropped, CALLS_MAX_FUNCTIONS);
+  }
+}
@@ -0,0 +1,717 @@
+#include <vm/census.h>
+#include <vm/program.h>
+#include <vm/object.h>
+#include <vm/array.h>
+#include <vm/map.h>
+#include <vm/cache.h>
+#include <vm/fiber.h>
+#include <vm/util.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#define CENSUS_NONE UINT32_MAX
+#define CENSUS_GROUPS 30 // printed, the largest first
+#define CENSUS_SITES 20
+#define CENSUS_ROOTS 10
+
+// where a root value is, see CENSUS_ROOT_OF
+typedef enum {
+  CENSUS_ROOT_DATA = 0, // $d[index]
+  CENSUS_ROOT_LOCAL = 1, // $l[index]
+  CENSUS_ROOT_REG = 2, // $r[index]
+  CENSUS_ROOT_FIBER = 3 // the registers, stack or result of fibers->all[index]
+} CENSUS_ROOT;
+
+#define CENSUS_ROOT_OF(kind, index) ((uint32_t)(kind) << 30 | (uint32_t)(index))
+
+// a pointer -> index table, open addressed, for the nodes, the buffers,
+// the groups and the sites
+typedef struct census_entry {
+  const void *key;
+  uint32_t value;
+} census_entry_t;
+
+typedef struct census_map {
+  census_entry_t *entries;
+  size_t size; // a power of two, at most half full
+  size_t len;
+} census_map_t;
+
+typedef struct census_node {
+  heap_value_t *hv;
+  uint32_t group;
+  uint32_t parent; // the node it was found from first, CENSUS_NONE for a root's
+  uint32_t root; // the root it was found from, see CENSUS_ROOT_OF
+  bool reached;
+  uint64_t bytes; // the node and its own blocks
+  uint64_t retained; // with the buffers and nodes found from it first
+} census_node_t;
+
+typedef struct census_group {
+  uint8_t kind; // HEAP_KIND
+  uint8_t arrayKind;
+  const shape_t *shape; // of objects, NULL for dictionaries
+  size_t count;
+  size_t reached;
+  uint64_t bytes;
+  uint64_t retained; // of the nodes not found first from another of the group
+} census_group_t;
+
+typedef struct census_site {
+  uint32_t site;
+  size_t count;
+  uint64_t bytes;
+} census_site_t;
+
+typedef struct census {
+  runtime_t *r;
+  FILE *graph;
+
+  census_node_t *nodes;
+  size_t numNodes;
+  size_t capNodes;
+  census_map_t nodeMap;
+
+  // reached, in the order they were
+  uint32_t *order;
+  size_t numOrder;
+  uint32_t *stack;
+  size_t stackLen;
+
+  census_group_t *groups;
+  size_t numGroups;
+  census_map_t groupMap;
+
+  census_map_t bufferMap; // reached, to the node that reached it first
+  census_site_t *sites;
+  size_t numSites;
+  census_map_t siteMap;
+  size_t numBuffers;
+  uint64_t bufferBytes;
+  uint64_t rootBufferBytes; // held by the roots themselves
+
+  // how full the member tables are, see census_write
+  size_t shaped, slots, slotsUsed;
+  size_t dictionaries, members, membersUsed;
+  size_t maps, entries, entriesUsed;
+} census_t;
+
+// distinct keys for the groups without a shape, by kind and element kind
+static const char census_kindKeys[8][4];
+
+static void census_grow(census_map_t *map) {
+  census_entry_t *old = map->entries;
+  size_t oldSize = map->size;
+
+  map->size = oldSize != 0 ? oldSize * 2 : 1024;
+  map->entries = (census_entry_t*)calloc(map->size, sizeof(census_entry_t));
+
+  for (size_t i = 0; i < oldSize; i++) {
+    if (old[i].key != NULL) {
+      size_t j = hash6432shift((uint64_t)(uintptr_t)old[i].key) & (map->size - 1);
+
+      while (map->entries[j].key != NULL) {
+        j = (j + 1) & (map->size - 1);
+      }
+
+      map->entries[j] = old[i];
+    }
+  }
+
+  free(old);
+}
+
+// the value of `key`, added as CENSUS_NONE if it is not in the map yet
+static uint32_t *census_lookup(census_map_t *map, const void *key) {
+  size_t i;
+
+  if ((map->len + 1) * 2 > map->size) {
+    census_grow(map);
+  }
+
+  i = hash6432shift((uint64_t)(uintptr_t)key) & (map->size - 1);
+
+  while (map->entries[i].key != NULL && map->entries[i].key != key) {
+    i = (i + 1) & (map->size - 1);
+  }
+
+  if (map->entries[i].key == NULL) {
+    map->entries[i].key = key;
+    map->entries[i].value = CENSUS_NONE;
+    map->len++;
+  }
+
+  return &map->entries[i].value;
+}
+
+static void census_push(uint32_t **items, size_t len, uint32_t item) {
+  // grown at powers of two
+  if (len == 0 || (len >= 64 && (len & (len - 1)) == 0)) {
+    *items = (uint32_t*)realloc(*items, (len != 0 ? len * 2 : 64) * sizeof(uint32_t));
+  }
+
+  (*items)[len] = item;
+}
+
+// the node's own bytes, and its group; counts its member table
+static uint64_t census_measure(census_t *c, heap_value_t *hv, uint32_t *group) {
+  uint64_t bytes = sizeof(heap_node_t);
+  const void *key = &census_kindKeys[hv->kind & 7][0];
+  const shape_t *shape = NULL;
+  uint8_t arrayKind = 0;
+  uint32_t *g;
+
+  if (hv->ptr != NULL) {
+    switch (hv->kind) {
+      case HEAP_KIND_ARRAY: {
+        array_t *array = (array_t*)hv->ptr;
+
+        arrayKind = (uint8_t)array->kind;
+        key = &census_kindKeys[hv->kind & 7][arrayKind & 3];
+        bytes += sizeof(array_t) + array->capacity * array_elementSize(array->kind);
+        break;
+      }
+      case HEAP_KIND_MAP: {
+        map_t *map = (map_t*)hv->ptr;
+
+        bytes += sizeof(map_t) + map->capacity * (1 + sizeof(map_entry_t));
+
+        for (size_t i = 0; i < map->capacity; i++) {
+          if (!(map->ctrl[i] & 0x80)) {
+            bytes += map->entries[i].len + 1;
+          }
+        }
+
+        c->maps++;
+        c->entries += map->capacity;
+        c->entriesUsed += map->size;
+        break;
+      }
+      case HEAP_KIND_CACHE: {
+        cache_t *cache = (cache_t*)hv->ptr;
+
+        // the index's keys are the entries'
+        bytes += sizeof(cache_t) + sizeof(map_t) + cache->index->capacity * (1 + sizeof(map_entry_t))
+          + cache->numSlots * sizeof(cache_slot_t);
+
+        for (size_t i = 0; i < cache->numSlots; i++) {
+          if (cache->slots[i].key != NULL) {
+            bytes += cache->slots[i].len + 1;
+          }
+        }
+
+        break;
+      }
+      case HEAP_KIND_STREAM:
+      case HEAP_KIND_AIO:
+      case HEAP_KIND_TASK:
+      case HEAP_KIND_CHANNEL:
+      case HEAP_KIND_SOCKET:
+        break; // what they hold is not the heap's
+      default: {
+        object_t *object = (object_t*)hv->ptr;
+
+        bytes += OBJECT_BLOCK_SIZE + (object_slotsInline(object) ? 0 : object->numSlots * sizeof(value_t))
+          + object_tableBytes(object->tableSize);
+
+        if (object->shape != NULL) {
+          key = shape = object->shape;
+          c->shaped++;
+          c->slots += object->numSlots;
+          c->slotsUsed += object->shape->count;
+        } else {
+          c->dictionaries++;
+          c->members += object->tableSize / 2;
+          c->membersUsed += object->size;
+        }
+
+        break;
+      }
+    }
+  }
+
+  g = census_lookup(&c->groupMap, key);
+
+  if (*g == CENSUS_NONE) {
+    *g = (uint32_t)c->numGroups;
+
+    if (c->numGroups % 64 == 0) {
+      c->groups = (census_group_t*)realloc(c->groups, (c->numGroups + 64) * sizeof(census_group_t));
+    }
+
+    memset(&c->groups[c->numGroups], 0, sizeof(census_group_t));
+    c->groups[c->numGroups].kind = hv->kind;
+    c->groups[c->numGroups].arrayKind = arrayKind;
+    c->groups[c->numGroups].shape = shape;
+    c->numGroups++;
+  }
+
+  *group = *g;
+
+  return bytes;
+}
+
+// the index of the node of `hv`, added if it is not known yet
+static uint32_t census_node(census_t *c, heap_value_t *hv) {
+  uint32_t *index = census_lookup(&c->nodeMap, hv);
+  census_node_t *node;
+
+  if (*index != CENSUS_NONE) {
+    return *index;
+  }
+
+  *index = (uint32_t)c->numNodes;
+
+  if (c->numNodes == c->capNodes) {
+    c->capNodes = c->capNodes != 0 ? c->capNodes * 2 : 1024;
+    c->nodes = (census_node_t*)realloc(c->nodes, c->capNodes * sizeof(census_node_t));
+  }
+
+  node = &c->nodes[c->numNodes];
+  node->hv = hv;
+  node->parent = CENSUS_NONE;
+  node->root = 0;
+  node->reached = false;
+  node->retained = 0;
+  node->bytes = census_measure(c, hv, &node->group);
+
+  return (uint32_t)c->numNodes++;
+}
+
+static void census_formatRoot(const census_t *c, uint32_t root, char *buf, size_t size) {
+  uint32_t index = root & ((1u << 30) - 1);
+
+  switch ((CENSUS_ROOT)(root >> 30)) {
+    case CENSUS_ROOT_DATA:
+      snprintf(buf, size, "$d[%u]", index);
+      break;
+    case CENSUS_ROOT_LOCAL:
+      snprintf(buf, size, "$l[%u]", index);
+      break;
+    case CENSUS_ROOT_REG:
+      snprintf(buf, size, "$r[%u]", index);
+      break;
+    default:
+      snprintf(buf, size, "fiber %lld", (long long)c->r->fibers->all[index]->id);
+      break;
+  }
+}
+
+// a buffer or a node `v` references, from the node `from` (CENSUS_NONE
+// for a root): charged to it if this is the first reference found, and
+// a node then queued for census_trace
+static void census_visit(census_t *c, value_t *v, uint32_t from, uint32_t root) {
+  uint32_t *buffer, index;
+  census_node_t *node;
+
+  if (value_getType(v) != TYPE_POINTER) {
+    return;
+  }
+
+  if ((value_getFlags(v) & FLAG_REFCOUNTED) && v->data.rc != NULL) {
+    buffer = census_lookup(&c->bufferMap, v->data.rc);
+
+    if (*buffer == CENSUS_NONE) {
+      uint64_t bytes = sizeof(rc_header_t) + rc_size(v->data.rc);
+      uint32_t site = rc_site(v->data.rc);
+      uint32_t *s = census_lookup(&c->siteMap, (const void*)((uintptr_t)site + 1));
+
+      *buffer = from;
+      c->numBuffers++;
+      c->bufferBytes += bytes;
+
+      if (from != CENSUS_NONE) {
+        c->nodes[from].retained += bytes;
+      } else {
+        c->rootBufferBytes += bytes;
+      }
+
+      if (*s == CENSUS_NONE) {
+        *s = (uint32_t)c->numSites;
+
+        if (c->numSites % 64 == 0) {
+          c->sites = (census_site_t*)realloc(c->sites, (c->numSites + 64) * sizeof(census_site_t));
+        }
+
+        c->sites[c->numSites].site = site;
+        c->sites[c->numSites].count = 0;
+        c->sites[c->numSites].bytes = 0;
+        c->numSites++;
+      }
+
+      c->sites[*s].count++;
+      c->sites[*s].bytes += bytes;
+    }
+
+    return;
+  }
+
+  if (!(value_getFlags(v) & FLAG_OBJECT) || v->data.hv == NULL) {
+    return;
+  }
+
+  index = census_node(c, v->data.hv);
+
+  if (c->graph != NULL) {
+    if (from != CENSUS_NONE) {
+      fprintf(c->graph, "  n%u -> n%u;\n", from, index);
+    } else {
+      char name[32];
+
+      census_formatRoot(c, root, name, sizeof(name));
+      fprintf(c->graph, "  \"%s\" [shape=box];\n  \"%s\" -> n%u;\n", name, name, index);
+    }
+  }
+
+  node = &c->nodes[index];
+
+  if (node->reached) {
+    return;
+  }
+
+  node->reached = true;
+  node->parent = from;
+  node->root = root;
+
+  census_push(&c->order, c->numOrder++, index);
+  census_push(&c->stack, c->stackLen++, index);
+}
+
+// census_visit on everything the node references
+static void census_trace(census_t *c, uint32_t index) {
+  heap_value_t *hv = c->nodes[index].hv;
+  uint32_t root = c->nodes[index].root;
+
+  if (hv->ptr == NULL) {
+    return;
+  }
+
+  switch (hv->kind) {
+    case HEAP_KIND_ARRAY: {
+      array_t *array = (array_t*)hv->ptr;
+
+      if (array->kind == ARRAY_VALUES) {
+        for (size_t i = 0; i < array->size; i++) {
+          census_visit(c, &((value_t*)array->data)[i], index, root);
+        }
+      }
+
+      break;
+    }
+    case HEAP_KIND_MAP: {
+      map_t *map = (map_t*)hv->ptr;
+
+      for (size_t i = 0; i < map->capacity; i++) {
+        if (!(map->ctrl[i] & 0x80)) {
+          census_visit(c, &map->entries[i].value, index, root);
+        }
+      }
+
+      break;
+    }
+    case HEAP_KIND_CACHE: {
+      cache_t *cache = (cache_t*)hv->ptr;
+
+      // a weak cache retains nothing
+      for (size_t i = 0; !cache->weak && i < cache->numSlots; i++) {
+        if (cache->slots[i].key != NULL) {
+          census_visit(c, &cache->slots[i].value, index, root);
+        }
+      }
+
+      break;
+    }
+    case HEAP_KIND_STREAM:
+    case HEAP_KIND_AIO:
+    case HEAP_KIND_TASK:
+    case HEAP_KIND_CHANNEL:
+    case HEAP_KIND_SOCKET:
+      break; // holds no values
+    default: {
+      object_t *object = (object_t*)hv->ptr;
+
+      if (object->shape != NULL) {
+        for (uint32_t i = 0; i < object->shape->count; i++) {
+          census_visit(c, &object->slots[i], index, root);
+        }
+      } else {
+        for (size_t i = 0; i < object->numMembers; i++) {
+          if (object->members[i].used) {
+            census_visit(c, &object->members[i].value, index, root);
+          }
+        }
+      }
+
+      break;
+    }
+  }
+}
+
+static void census_visitTable(census_t *c, value_t *values, size_t len, CENSUS_ROOT kind, size_t fiber) {
+  for (size_t i = 0; i < len; i++) {
+    census_visit(c, &values[i], CENSUS_NONE, CENSUS_ROOT_OF(kind, kind == CENSUS_ROOT_FIBER ? fiber : i));
+
+    while (c->stackLen > 0) {
+      census_trace(c, c->stack[--c->stackLen]);
+    }
+  }
+}
+
+// the roots, as datatable_mark and fibers_mark have them
+static void census_walk(census_t *c) {
+  datatable_t *dt = c->r->dt;
+  fibers_t *fibers = c->r->fibers;
+
+  census_visitTable(c, dt->storage[AT_DATA].data, *dt->storage[AT_DATA].lenVal, CENSUS_ROOT_DATA, 0);
+  census_visitTable(c, dt->storage[AT_LOCAL].data, *dt->storage[AT_LOCAL].lenVal, CENSUS_ROOT_LOCAL, 0);
+  census_visitTable(c, dt->storage[AT_REG].data, NUM_REGISTERS, CENSUS_ROOT_REG, 0);
+
+  if (fibers == NULL) {
+    return;
+  }
+
+  for (size_t i = 0; i < fibers->count; i++) {
+    fiber_t *fiber = fibers->all[i];
+
+    if (fiber == NULL || fiber == fibers->current) {
+      continue;
+    }
+
+    if (fiber->state == FIBER_DONE) {
+      census_visitTable(c, &fiber->result, 1, CENSUS_ROOT_FIBER, i);
+      continue;
+    }
+
+    census_visitTable(c, fiber->regs, NUM_REGISTERS, CENSUS_ROOT_FIBER, i);
+    census_visitTable(c, fiber->stack, fiber->stackLen, CENSUS_ROOT_FIBER, i);
+
+    if (fiber->state == FIBER_IO) {
+      census_visitTable(c, &fiber->io, 1, CENSUS_ROOT_FIBER, i);
+    }
+  }
+}
+
+static void census_formatGroup(const census_group_t *g, char *buf, size_t size) {
+  static const char *arrayKinds[] = { "array", "array i64", "array f64", "array bytes" };
+  static const char *kinds[] = { "object", "array", "map", "stream", "aio", "task", "channel", "cache", "socket" };
+  const char *keys[SHAPE_MAX_MEMBERS];
+  size_t numKeys = 0, len;
+
+  if (g->kind == HEAP_KIND_ARRAY) {
+    snprintf(buf, size, "%s", arrayKinds[g->arrayKind & 3]);
+    return;
+  }
+
+  if (g->kind != HEAP_KIND_OBJECT) {
+    snprintf(buf, size, "%s", g->kind < sizeof(kinds) / sizeof(kinds[0]) ? kinds[g->kind] : "object");
+    return;
+  }
+
+  if (g->shape == NULL) {
+    snprintf(buf, size, "{...} (dictionary)");
+    return;
+  }
+
+  for (const shape_t *s = g->shape; s->parent != NULL && numKeys < SHAPE_MAX_MEMBERS; s = s->parent) {
+    keys[numKeys++] = s->key;
+  }
+
+  len = (size_t)snprintf(buf, size, "{");
+
+  for (size_t i = numKeys; i-- > 0 && len < size;) {
+    len += (size_t)snprintf(buf + len, size - len, "%s%s", keys[i], i > 0 ? ", " : "");
+  }
+
+  if (len < size) {
+    snprintf(buf + len, size - len, "}");
+  }
+}
+
+static const census_t *census_sorting; // for the comparisons of indices below
+
+static int census_compareGroups(const void *a, const void *b) {
+  const census_group_t *l = &census_sorting->groups[*(const uint32_t*)a];
+  const census_group_t *r = &census_sorting->groups[*(const uint32_t*)b];
+
+  return l->bytes > r->bytes ? -1 : (l->bytes < r->bytes);
+}
+
+static int census_compareSites(const void *a, const void *b) {
+  const census_site_t *l = (const census_site_t*)a;
+  const census_site_t *r = (const census_site_t*)b;
+
+  return l->bytes > r->bytes ? -1 : (l->bytes < r->bytes);
+}
+
+static int census_compareRetained(const void *a, const void *b) {
+  const census_node_t *l = &census_sorting->nodes[*(const uint32_t*)a];
+  const census_node_t *r = &census_sorting->nodes[*(const uint32_t*)b];
+
+  return l->retained > r->retained ? -1 : (l->retained < r->retained);
+}
+
+// a DOT string: escaped, within quotes
+static void census_writeLabel(FILE *f, const char *label) {
+  fputc('"', f);
+
+  for (const char *s = label; *s != '\0'; s++) {
+    if (*s == '"' || *s == '\\') {
+      fputc('\\', f);
+    }
+
+    fputc(*s, f);
+  }
+
+  fputc('"', f);
+}
+
+void census_write(runtime_t *r, FILE *f, FILE *graph) {
+  census_t c;
+  heap_node_t *lists[2] = { r->heap->head, r->heap->young };
+  uint32_t *tops = NULL, *groups;
+  size_t numTops = 0, reached = 0;
+  uint64_t bytes = 0, reachedBytes = 0;
+  char name[256], where[256];
+
+  memset(&c, 0, sizeof(c));
+  c.r = r;
+  c.graph = graph;
+
+  if (graph != NULL) {
+    fprintf(graph, "digraph heap {\n  node [shape=ellipse];\n");
+  }
+
+  for (size_t l = 0; l < 2; l++) {
+    for (heap_node_t *node = lists[l]; node != NULL; node = node->next) {
+      census_node(&c, &node->hv);
+    }
+  }
+
+  census_walk(&c);
+
+  // children were found after their parents
+  for (size_t i = c.numOrder; i-- > 0;) {
+    census_node_t *node = &c.nodes[c.order[i]];
+
+    node->retained += node->bytes;
+
+    if (node->parent != CENSUS_NONE) {
+      c.nodes[node->parent].retained += node->retained;
+    }
+  }
+
+  for (size_t i = 0; i < c.numNodes; i++) {
+    census_node_t *node = &c.nodes[i];
+    census_group_t *g = &c.groups[node->group];
+
+    g->count++;
+    g->bytes += node->bytes;
+    bytes += node->bytes;
+
+    if (!node->reached) {
+      continue;
+    }
+
+    g->reached++;
+    reached++;
+    reachedBytes += node->bytes;
+
+    if (node->parent == CENSUS_NONE || c.nodes[node->parent].group != node->group) {
+      g->retained += node->retained;
+    }
+
+    if (node->parent == CENSUS_NONE) {
+      census_push(&tops, numTops++, (uint32_t)i);
+    }
+
+    if (graph != NULL) {
+      census_formatGroup(g, name, sizeof(name));
+      snprintf(where, sizeof(where), "%s\n%llu B, retains %llu B", name,
+        (unsigned long long)node->bytes, (unsigned long long)node->retained);
+      fprintf(graph, "  n%zu [label=", i);
+      census_writeLabel(graph, where);
+      fprintf(graph, "];\n");
+    }
+  }
+
+  if (graph != NULL) {
+    fprintf(graph, "}\n");
+  }
+
+  fprintf(f, "heap census: %zu nodes, %.1f KB; %zu reached from the roots, %.1f KB; "
+    "%zu refcounted buffers reached, %.1f KB\n",
+    c.numNodes, bytes / 1024.0, reached, reachedBytes / 1024.0, c.numBuffers, c.bufferBytes / 1024.0);
+
+  // the groups, sorted by index as the nodes refer to them that way
+  census_sorting = &c;
+  groups = (uint32_t*)malloc((c.numGroups + 1) * sizeof(uint32_t));
+
+  for (size_t i = 0; i < c.numGroups; i++) {
+    groups[i] = (uint32_t)i;
+  }
+
+  qsort(groups, c.numGroups, sizeof(uint32_t), census_compareGroups);
+  fprintf(f, "%10s %10s %12s %12s  %s\n", "nodes", "reached", "KB", "retained KB", "group");
+
+  for (size_t i = 0; i < c.numGroups && i < CENSUS_GROUPS; i++) {
+    census_group_t *g = &c.groups[groups[i]];
+
+    census_formatGroup(g, name, sizeof(name));
+    fprintf(f, "%10zu %10zu %12.1f %12.1f  %s\n", g->count, g->reached, g->bytes / 1024.0, g->retained / 1024.0, name);
+  }
+
+  if (c.numGroups > CENSUS_GROUPS) {
+    fprintf(f, "%10s (%zu more groups)\n", "", c.numGroups - CENSUS_GROUPS);
+  }
+
+  fprintf(f, "member tables: %zu shaped objects, %zu of %zu slots used; %zu dictionaries, "
+    "%zu of %zu members used; %zu maps, %zu of %zu entries used\n",
+    c.shaped, c.slotsUsed, c.slots, c.dictionaries, c.membersUsed, c.members, c.maps, c.entriesUsed, c.entries);
+
+  // the buffers, by where they were made
+  qsort(c.sites, c.numSites, sizeof(census_site_t), census_compareSites);
+  fprintf(f, "%10s %12s  %s\n", "buffers", "KB", "made at");
+
+  for (size_t i = 0; i < c.numSites && i < CENSUS_SITES; i++) {
+    census_site_t *s = &c.sites[i];
+
+    if (s->site == 0) {
+      snprintf(where, sizeof(where), "(unknown)");
+    } else if (r->program == NULL || image_formatSource(&r->program->image, s->site - 1, where, sizeof(where)) == 0) {
+      snprintf(where, sizeof(where), "offset %u", s->site - 1);
+    }
+
+    fprintf(f, "%10zu %12.1f  %s\n", s->count, s->bytes / 1024.0, where);
+  }
+
+  if (c.numSites > CENSUS_SITES) {
+    fprintf(f, "%10s (%zu more sites)\n", "", c.numSites - CENSUS_SITES);
+  }
+
+  // the roots holding the most
+  qsort(tops, numTops, sizeof(uint32_t), census_compareRetained);
+  fprintf(f, "%12s  %-16s %s\n", "retained KB", "root", "holding");
+
+  for (size_t i = 0; i < numTops && i < CENSUS_ROOTS; i++) {
+    census_node_t *node = &c.nodes[tops[i]];
+
+    census_formatGroup(&c.groups[node->group], name, sizeof(name));
+    census_formatRoot(&c, node->root, where, sizeof(where));
+    fprintf(f, "%12.1f  %-16s %s\n", node->retained / 1024.0, where, name);
+  }
+
+  fprintf(f, "%12.1f  (buffers the roots hold themselves)\n", c.rootBufferBytes / 1024.0);
+
+  free(tops);
+  free(groups);
+  free(c.nodes);
+  free(c.nodeMap.entries);
+  free(c.order);
+  free(c.stack);
+  free(c.groups);
+  free(c.groupMap.entries);
+  free(c.bufferMap.entries);
+  free(c.sites);
+  free(c.siteMap.entries);
+}
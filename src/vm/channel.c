@@ -0,0 +1,273 @@
+#include <vm/channel.h>
+#include <vm/runtime.h>
+#include <vm/heap.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <sched.h>
+
+channel_t *channel_create(size_t capacity) {
+  // sizeof is a multiple of the alignment, as aligned_alloc wants
+  channel_t *ch = (channel_t*)aligned_alloc(_Alignof(channel_t), sizeof(channel_t));
+  // with a single cell, the number a send leaves would be the next send's turn
+  size_t cap = 2;
+
+  while (cap < capacity && cap < CHANNEL_MAX_CAP) {
+    cap <<= 1;
+  }
+
+  ch->cells = (channel_cell_t*)malloc(cap * sizeof(channel_cell_t));
+  ch->mask = cap - 1;
+
+  // a cell is the turn of the sender on lap 0 at its own index
+  for (size_t i = 0; i < cap; i++) {
+    atomic_init(&ch->cells[i].seq, i);
+  }
+
+  atomic_init(&ch->refs, 1);
+  atomic_init(&ch->sendPos, 0);
+  atomic_init(&ch->recvPos, 0);
+  atomic_init(&ch->closed, false);
+  atomic_init(&ch->moves, 0);
+  atomic_init(&ch->sleepers, 0);
+  pthread_mutex_init(&ch->lock, NULL);
+  pthread_cond_init(&ch->cond, NULL);
+
+  return ch;
+}
+
+channel_t *channel_retain(channel_t *ch) {
+  atomic_fetch_add_explicit(&ch->refs, 1, memory_order_relaxed);
+
+  return ch;
+}
+
+// releases what a cell holds, when nobody is going to receive it
+static void channel_drop(channel_cell_t *cell) {
+  if (cell->channel != NULL) {
+    channel_release(cell->channel);
+  } else if (VALUE_HAS(&cell->value, TYPE_POINTER, FLAG_REFCOUNTED)) {
+    rc_release(cell->value.data.rc);
+  }
+}
+
+void channel_release(channel_t *ch) {
+  size_t end;
+
+  // the last reference sees every write made through the others
+  if (atomic_fetch_sub_explicit(&ch->refs, 1, memory_order_acq_rel) != 1) {
+    return;
+  }
+
+  // sent and not received; a send that claimed a cell always fills it
+  end = atomic_load_explicit(&ch->sendPos, memory_order_relaxed);
+
+  for (size_t pos = atomic_load_explicit(&ch->recvPos, memory_order_relaxed); pos != end; pos++) {
+    channel_drop(&ch->cells[pos & ch->mask]);
+  }
+
+  pthread_cond_destroy(&ch->cond);
+  pthread_mutex_destroy(&ch->lock);
+  free(ch->cells);
+  free(ch);
+}
+
+void channel_destructor(runtime_t *rt, args_t *args) {
+  if (args->_rawData != NULL) {
+    channel_release((channel_t*)args->_rawData);
+  }
+}
+
+// `v` as a cell holds it, referring to nothing on the sender's runtime
+static void channel_export(channel_cell_t *msg, const value_t *v) {
+  msg->value = *v;
+  msg->channel = NULL;
+
+  if (VALUE_TYPE_OF(v) != TYPE_POINTER) {
+    return;
+  }
+
+  if (VALUE_HAS(v, TYPE_POINTER, FLAG_OBJECT | FLAG_CHANNEL)) {
+    msg->channel = channel_retain((channel_t*)v->data.hv->ptr);
+    msg->value.data.u64 = 0;
+    VALUE_SET_META(&msg->value, TYPE_NONE, FLAG_NONE);
+  } else if (VALUE_HAS(v, TYPE_POINTER, FLAG_OBJECT) || VALUE_HAS(v, TYPE_POINTER, FLAG_MALLOC)) {
+    // heap nodes are their runtime's, and so is memory it frees
+    msg->value.data.u64 = 0;
+    VALUE_SET_META(&msg->value, TYPE_NONE, FLAG_NONE);
+  } else if (VALUE_HAS(v, TYPE_POINTER, FLAG_REFCOUNTED) && rc_isShared(v->data.rc)) {
+    // handed off as it is, its count is atomic
+    msg->value.data.rc = rc_claim(v->data.rc);
+  } else if (VALUE_HAS(v, TYPE_POINTER, FLAG_REFCOUNTED)) {
+    // the count is not atomic, so the receiver gets a buffer of its own,
+    // of a slice only its part, made where the original was and charged
+    // to what the original was
+    size_t size = VALUE_IS_SLICE(v) ? VALUE_SLICE_LENGTH(v) : rc_size(v->data.rc);
+    refcounted_t copy = rc_allocOver(rc_quota(v->data.rc), size, rc_site(v->data.rc));
+
+    memcpy(copy, value_getRawPointer((value_t*)v), size);
+    msg->value.data.rc = rc_claim(copy);
+    VALUE_SET_META(&msg->value, TYPE_POINTER, FLAG_REFCOUNTED);
+  }
+}
+
+// the cell at `pos` is the turn of a sender on that lap when its sequence
+// number is `pos`, and of a receiver when it is `pos + 1`; taking it moves
+// it on a lap, to `pos + capacity`. false if the ring is full.
+static bool channel_trySend(channel_t *ch, const channel_cell_t *msg) {
+  size_t pos = atomic_load_explicit(&ch->sendPos, memory_order_relaxed);
+  channel_cell_t *cell;
+
+  for (;;) {
+    intptr_t diff;
+
+    cell = &ch->cells[pos & ch->mask];
+    diff = (intptr_t)atomic_load_explicit(&cell->seq, memory_order_acquire) - (intptr_t)pos;
+
+    if (diff == 0) {
+      if (atomic_compare_exchange_weak_explicit(&ch->sendPos, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      return false; // a lap behind: not received yet
+    } else {
+      pos = atomic_load_explicit(&ch->sendPos, memory_order_relaxed);
+    }
+  }
+
+  cell->value = msg->value;
+  cell->channel = msg->channel;
+  // publishes the value to the receiver that reads the new number
+  atomic_store_explicit(&cell->seq, pos + 1, memory_order_release);
+
+  return true;
+}
+
+// false if the ring is empty
+static bool channel_tryRecv(channel_t *ch, channel_cell_t *msg) {
+  size_t pos = atomic_load_explicit(&ch->recvPos, memory_order_relaxed);
+  channel_cell_t *cell;
+
+  for (;;) {
+    intptr_t diff;
+
+    cell = &ch->cells[pos & ch->mask];
+    diff = (intptr_t)atomic_load_explicit(&cell->seq, memory_order_acquire) - (intptr_t)(pos + 1);
+
+    if (diff == 0) {
+      if (atomic_compare_exchange_weak_explicit(&ch->recvPos, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      return false; // not sent yet
+    } else {
+      pos = atomic_load_explicit(&ch->recvPos, memory_order_relaxed);
+    }
+  }
+
+  msg->value = cell->value;
+  msg->channel = cell->channel;
+  atomic_store_explicit(&cell->seq, pos + ch->mask + 1, memory_order_release);
+
+  return true;
+}
+
+// a value moved, or the channel closed: wakes whoever sleeps on it
+static void channel_wake(channel_t *ch) {
+  atomic_fetch_add(&ch->moves, 1);
+
+  if (atomic_load(&ch->sleepers) != 0) {
+    pthread_mutex_lock(&ch->lock);
+    pthread_cond_broadcast(&ch->cond);
+    pthread_mutex_unlock(&ch->lock);
+  }
+}
+
+// after an attempt that failed, `seen` being `moves` before it
+static void channel_wait(runtime_t *rt, channel_t *ch, size_t seen, unsigned *spins) {
+  if (*spins < CHANNEL_SPINS) {
+    ++*spins;
+    sched_yield();
+  } else {
+    struct timespec deadline;
+
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_nsec += CHANNEL_SLEEP_MS * 1000000L;
+    deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+    deadline.tv_nsec %= 1000000000L;
+
+    pthread_mutex_lock(&ch->lock);
+    atomic_fetch_add(&ch->sleepers, 1);
+
+    // a move is counted before it looks for sleepers, so either it sees
+    // this one or this one sees the move
+    if (atomic_load(&ch->moves) == seen) {
+      pthread_cond_timedwait(&ch->cond, &ch->lock, &deadline);
+    }
+
+    atomic_fetch_sub(&ch->sleepers, 1);
+    pthread_mutex_unlock(&ch->lock);
+  }
+
+  // the wait is in a call, where the collector may stop the runtime
+  runtime_safepoint(rt);
+}
+
+bool channel_send(runtime_t *rt, channel_t *ch, const value_t *v) {
+  channel_cell_t msg;
+  unsigned spins = 0;
+
+  if (atomic_load(&ch->closed)) {
+    return false;
+  }
+
+  channel_export(&msg, v);
+
+  for (;;) {
+    size_t seen = atomic_load(&ch->moves);
+
+    if (atomic_load(&ch->closed)) {
+      channel_drop(&msg);
+      return false;
+    }
+
+    if (channel_trySend(ch, &msg)) {
+      channel_wake(ch);
+      return true;
+    }
+
+    channel_wait(rt, ch, seen, &spins);
+  }
+}
+
+bool channel_recv(runtime_t *rt, channel_t *ch, value_t *out) {
+  channel_cell_t msg;
+  unsigned spins = 0;
+
+  for (;;) {
+    size_t seen = atomic_load(&ch->moves);
+    // read first: what was sent before the close is in the ring by then
+    bool closed = atomic_load(&ch->closed);
+
+    if (channel_tryRecv(ch, &msg)) {
+      channel_wake(ch);
+      *out = msg.channel != NULL ? value_createChannel(rt, rt->heap, msg.channel) : msg.value;
+      return true;
+    }
+
+    if (closed) {
+      out->data.u64 = 0;
+      VALUE_SET_META(out, TYPE_NONE, FLAG_NONE);
+      return false;
+    }
+
+    channel_wait(rt, ch, seen, &spins);
+  }
+}
+
+void channel_close(channel_t *ch) {
+  atomic_store(&ch->closed, true);
+  channel_wake(ch);
+}
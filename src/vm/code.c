@@ -0,0 +1,978 @@
+#include <vm/code.h>
+#include <vm/program.h>
+#include <vm/interpreter.h>
+#include <shared/builtins.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+static bool code_readBytes(const ubyte_t *bc, size_t len, size_t *pc, size_t size, void *out) {
+  if (*pc + size > len) {
+    return false;
+  }
+
+  memcpy(out, bc + *pc, size);
+  *pc += size;
+
+  return true;
+}
+
+static bool code_readVarint(const ubyte_t *bc, size_t len, size_t *pc, uint64_t *out) {
+  uint64_t value = 0;
+
+  for (unsigned shift = 0; shift < 64; shift += 7) {
+    if (*pc >= len) {
+      return false;
+    }
+
+    uint8_t b = bc[(*pc)++];
+    value |= (uint64_t)(b & 0x7F) << shift;
+
+    if ((b & 0x80) == 0) {
+      *out = value;
+      return true;
+    }
+  }
+
+  // longer than any u64
+  return false;
+}
+
+// an unsigned field of `size` bytes; a ULEB128 in compact code,
+// see BIN_CODE_COMPACT
+static bool code_readUint(const ubyte_t *bc, size_t len, size_t *pc, bool compact, size_t size, uint64_t *out) {
+  if (compact) {
+    return code_readVarint(bc, len, pc, out);
+  }
+
+  switch (size) {
+    case sizeof(uint8_t): {
+      uint8_t u8;
+
+      if (!code_readBytes(bc, len, pc, sizeof(u8), &u8)) {
+        return false;
+      }
+
+      *out = u8;
+      return true;
+    }
+    case sizeof(uint16_t): {
+      uint16_t u16;
+
+      if (!code_readBytes(bc, len, pc, sizeof(u16), &u16)) {
+        return false;
+      }
+
+      *out = u16;
+      return true;
+    }
+    case sizeof(uint32_t): {
+      uint32_t u32;
+
+      if (!code_readBytes(bc, len, pc, sizeof(u32), &u32)) {
+        return false;
+      }
+
+      *out = u32;
+      return true;
+    }
+    default:
+      return code_readBytes(bc, len, pc, sizeof(uint64_t), out);
+  }
+}
+
+// an 8 byte immediate. in compact code those not read as a double are
+// zigzag encoded ULEB128s.
+static bool code_readImmediate(const ubyte_t *bc, size_t len, size_t *pc, bool compact, bool isDouble, uint64_t *out) {
+  uint64_t zigzag;
+
+  if (!compact || isDouble) {
+    return code_readBytes(bc, len, pc, sizeof(uint64_t), out);
+  }
+
+  if (!code_readVarint(bc, len, pc, &zigzag)) {
+    return false;
+  }
+
+  *out = (zigzag >> 1) ^ (0 - (zigzag & 1));
+
+  return true;
+}
+
+static bool code_readObjLoc(const ubyte_t *bc, size_t len, size_t *pc, bool compact, obj_loc_t *out) {
+  uint8_t b;
+  uint64_t loc;
+
+  if (!compact) {
+    return code_readBytes(bc, len, pc, sizeof(obj_loc_t), out);
+  }
+
+  if (!code_readBytes(bc, len, pc, sizeof(b), &b)) {
+    return false;
+  }
+
+  if (b & 0x80) {
+    // an absolute register
+    *out = ((obj_loc_t)(b & 0x7F) << 4) | AT_ABS | AT_REG;
+    return true;
+  }
+
+  if ((b >> 4) != 0) {
+    *out = ((obj_loc_t)((b >> 4) - 1) << 4) | (b & 0xF);
+    return true;
+  }
+
+  // the location has 28 bits
+  if (!code_readVarint(bc, len, pc, &loc) || loc > 0x0FFFFFFF) {
+    return false;
+  }
+
+  *out = ((obj_loc_t)loc << 4) | (b & 0xF);
+
+  return true;
+}
+
+// length used by absolute operands, see operand_t
+static const uint64_t code_zero = 0;
+
+static void code_resolveOperand(datatable_t *dt, obj_loc_t o, operand_t *out) {
+  obj_loc_parse(o, &out->loc, &out->at);
+
+  // storage buffers are allocated once in datatable_create and never move
+  storage_t *s = &dt->storage[out->at & 0x3];
+  size_t count = s->count;
+
+  if ((out->at & AT_ABS) == AT_ABS) {
+    // out of range locations are never formed into a pointer;
+    // cap = 0 lets the checked interpreter reject them
+    bool inRange = out->loc < count;
+
+    out->base = inRange ? &s->data[out->loc] : s->data;
+    out->len = &code_zero;
+    out->off = 0;
+    out->cap = inRange ? 1 : 0;
+  } else if (out->at == AT_FRAME) {
+    // `off` is the distance below the frame pointer, as for a relative
+    // operand; a slot above it moves `base` up instead
+    int64_t k = CODE_FRAME_SLOT(out->loc);
+    bool above = k >= 0 && (uint64_t)k < count;
+
+    out->base = above ? &s->data[k] : s->data;
+    out->len = &VM_FRAME_POINTER(dt);
+    out->off = k < 0 ? (uint32_t)-k : 0;
+    out->cap = above ? (uint32_t)(count - k) : k < 0 ? (uint32_t)count : 0;
+  } else {
+    out->base = s->data;
+    out->len = s->lenVal;
+    out->off = out->loc;
+    out->cap = count;
+  }
+}
+
+static bool code_readOperand(datatable_t *dt, const ubyte_t *bc, size_t len, size_t *pc, bool compact, operand_t *out) {
+  obj_loc_t o;
+
+  // only a jump's target may be a code offset, see code_readTarget
+  if (!code_readObjLoc(bc, len, pc, compact, &o) || (o & 0xF) == AT_CODE) {
+    return false;
+  }
+
+  code_resolveOperand(dt, o, out);
+
+  return true;
+}
+
+// a jump's target operand. a direct one (AT_CODE) is left without a
+// value: `loc` is the byte offset it goes to, see CODE_DIRECT_JUMP.
+static bool code_readTarget(datatable_t *dt, const ubyte_t *bc, size_t len, size_t *pc, bool compact,
+                            instruction_t *ins) {
+  obj_loc_t o;
+  loc_28_t loc;
+  archtype_t at;
+  int64_t offset;
+
+  if (!code_readObjLoc(bc, len, pc, compact, &o)) {
+    return false;
+  }
+
+  obj_loc_parse(o, &loc, &at);
+
+  if (at != AT_CODE) {
+    code_resolveOperand(dt, o, &ins->target);
+    return true;
+  }
+
+  // zigzag, as a compact immediate
+  offset = (int64_t)ins->offset + (int64_t)(((uint64_t)loc >> 1) ^ (0 - ((uint64_t)loc & 1)));
+
+  // before the code is not anywhere in it either, and maps to the halt
+  ins->target.at = AT_CODE;
+  ins->target.loc = offset < 0 ? UINT32_MAX : (loc_28_t)offset;
+
+  return true;
+}
+
+// what the decoder allocated for `ins`: the argument operands of an
+// OP_CALL with CALL_FLAGS_OPERANDS, or the cases of a switch
+static void code_freeOwned(instruction_t *ins) {
+  if (CODE_IS_CALL(ins->opcode) && (ins->flags & CALL_FLAGS_OPERANDS)) {
+    free(ins->imm.call.args);
+    ins->imm.call.args = NULL;
+  } else if (ins->opcode == CODE_OP_SWITCH) {
+    free(ins->imm.table);
+    ins->imm.table = NULL;
+  }
+}
+
+// a switch's default (the target) and its table of cases, each of which
+// must be a direct jump
+static bool code_readSwitch(datatable_t *dt, const ubyte_t *bc, size_t len, size_t *pc, bool compact,
+                            instruction_t *ins) {
+  uint64_t low;
+  uint64_t count;
+  code_table_t *table;
+
+  if (!code_readOperand(dt, bc, len, pc, compact, &ins->left)
+      || !code_readImmediate(bc, len, pc, compact, false, &low)
+      || !code_readUint(bc, len, pc, compact, sizeof(uint16_t), &count)
+      || !code_readTarget(dt, bc, len, pc, compact, ins)) {
+    return false;
+  }
+
+  table = (code_table_t*)malloc(sizeof(code_table_t) + count * sizeof(uint32_t));
+  table->low = (int64_t)low;
+  table->count = (uint32_t)count;
+
+  ins->opcode = CODE_OP_SWITCH;
+  ins->flags = 0;
+  ins->imm.table = table;
+
+  for (uint64_t i = 0; i < count; i++) {
+    instruction_t c = { .offset = ins->offset };
+
+    if (!code_readTarget(dt, bc, len, pc, compact, &c) || c.target.at != AT_CODE) {
+      code_freeOwned(ins);
+      return false;
+    }
+
+    table->offsets[i] = c.target.loc;
+  }
+
+  return true;
+}
+
+// decodes the instruction at `*pc` into `ins` and advances `*pc`.
+// returns false if the instruction runs past the end of the buffer.
+// `compact` is for code with BIN_CODE_COMPACT.
+
+static bool code_decodeFields(datatable_t *dt, const ubyte_t *bc, size_t len, size_t *pc, bool compact,
+                              instruction_t *ins) {
+  uint8_t data;
+
+  memset(ins, 0, sizeof(instruction_t));
+  ins->offset = *pc;
+  ins->cache.index = CODE_INVALID_INDEX;
+
+  if (!code_readBytes(bc, len, pc, sizeof(data), &data)) {
+    return false;
+  }
+
+  ins->opcode = data >> 3;
+  ins->flags = data & 0x7;
+
+  switch (ins->opcode) {
+    case OP_LOAD:
+    case OP_PUSH: {
+      if (ins->opcode == OP_LOAD || ins->flags == CONST_FLAGS_NONE) {
+        if (!code_readOperand(dt, bc, len, pc, compact, &ins->left)) {
+          return false;
+        }
+      }
+
+      switch (ins->flags) {
+        case CONST_FLAGS_POOL:
+          // resolved to a code_const_t once the pool is built
+          return code_readUint(bc, len, pc, compact, sizeof(uint32_t), &ins->imm.u64);
+        case CONST_FLAGS_I64:
+        case CONST_FLAGS_U64:
+          return code_readImmediate(bc, len, pc, compact, false, &ins->imm.u64);
+        case CONST_FLAGS_F64:
+          return code_readImmediate(bc, len, pc, compact, true, &ins->imm.u64);
+        case CONST_FLAGS_BOOL: {
+          uint8_t b;
+
+          if (!code_readBytes(bc, len, pc, sizeof(b), &b)) {
+            return false;
+          }
+
+          ins->imm.b = (bool)b;
+
+          return true;
+        }
+        case CONST_FLAGS_RAWDATA: {
+          uint64_t sz;
+
+          if (!code_readUint(bc, len, pc, compact, sizeof(sz), &sz) || sz > len - *pc) {
+            return false;
+          }
+
+          ins->imm.raw.data = bc + *pc;
+          ins->imm.raw.size = sz;
+          *pc += sz;
+
+          return true;
+        }
+      }
+
+      return true;
+    }
+
+    case OP_ADD:
+    case OP_SUB:
+    case OP_MUL:
+    case OP_DIV:
+    case OP_MOD: {
+      static const uint8_t variants[] = {
+        [OP_ADD] = CODE_OP_ADD_I64,
+        [OP_SUB] = CODE_OP_SUB_I64,
+        [OP_MUL] = CODE_OP_MUL_I64,
+        [OP_DIV] = CODE_OP_DIV_I64
+      };
+
+      if (!code_readOperand(dt, bc, len, pc, compact, &ins->left)) {
+        return false;
+      }
+
+      // mod is integer only; the float flags are ignored for it
+      if (ins->opcode == OP_MOD) {
+        ins->opcode = (ins->flags & CMP_FLAG_IMM_R) ? CODE_OP_MOD_I64_IMM : CODE_OP_MOD_I64;
+      } else {
+        ins->opcode = variants[ins->opcode] + ins->flags;
+      }
+
+      if (ins->flags & CMP_FLAG_IMM_R) {
+        // read as .i64 or .dbl depending on CMP_FLAG_F64_R
+        return code_readImmediate(bc, len, pc, compact, (ins->flags & CMP_FLAG_F64_R) != 0, &ins->imm.u64);
+      }
+
+      return code_readOperand(dt, bc, len, pc, compact, &ins->right);
+    }
+
+    case OP_CMP:
+    case OP_XOR:
+    case OP_AND:
+    case OP_OR:
+    case OP_SHL:
+    case OP_SHR: {
+      static const uint8_t immediates[] = {
+        [OP_CMP] = CODE_OP_CMP_IMM,
+        [OP_XOR] = CODE_OP_XOR_IMM,
+        [OP_AND] = CODE_OP_AND_IMM,
+        [OP_OR] = CODE_OP_OR_IMM,
+        [OP_SHL] = CODE_OP_SHL_IMM,
+        [OP_SHR] = CODE_OP_SHR_IMM
+      };
+
+      if (!code_readOperand(dt, bc, len, pc, compact, &ins->left)) {
+        return false;
+      }
+
+      if (ins->flags & CMP_FLAG_IMM_R) {
+        ins->opcode = immediates[ins->opcode];
+        return code_readImmediate(bc, len, pc, compact, (ins->flags & CMP_FLAG_F64_R) != 0, &ins->imm.u64);
+      }
+
+      return code_readOperand(dt, bc, len, pc, compact, &ins->right);
+    }
+
+    case OP_MOV: {
+      uint8_t cond;
+
+      if (ins->flags == MOV_FLAGS_NONE) {
+        return code_readOperand(dt, bc, len, pc, compact, &ins->left)
+          && code_readOperand(dt, bc, len, pc, compact, &ins->right);
+      }
+
+      if (!code_readBytes(bc, len, pc, sizeof(cond), &cond)
+          || cond < JUMP_FLAGS_JE || cond > JUMP_FLAGS_JGE
+          || !code_readOperand(dt, bc, len, pc, compact, &ins->left)) {
+        return false;
+      }
+
+      if ((ins->flags & (MOV_FLAGS_SET | MOV_FLAGS_SELECT)) == MOV_FLAGS_SET) {
+        ins->opcode = CODE_OP_SETCC;
+        ins->imm.b = (ins->flags & MOV_FLAGS_NOT) != 0;
+        ins->flags = cond;
+
+        return true;
+      }
+
+      if (ins->flags & MOV_FLAGS_SET) {
+        return false;
+      }
+
+      // the operand taken when the condition holds goes to `right`
+      ins->opcode = CODE_OP_SELECT;
+
+      if (!code_readOperand(dt, bc, len, pc, compact, (ins->flags & MOV_FLAGS_NOT) ? &ins->target : &ins->right)
+          || !code_readOperand(dt, bc, len, pc, compact, (ins->flags & MOV_FLAGS_NOT) ? &ins->right : &ins->target)) {
+        return false;
+      }
+
+      ins->flags = cond;
+
+      return true;
+    }
+
+    case OP_TAKE:
+      if (ins->flags != TAKE_FLAGS_PUSH && !code_readOperand(dt, bc, len, pc, compact, &ins->left)) {
+        return false;
+      }
+
+      if (!code_readOperand(dt, bc, len, pc, compact, &ins->right)) {
+        return false;
+      }
+
+      // only from a register or the stack: $vm[] slots hold no references,
+      // and a $d one may be a label, which verify_written counts the
+      // writes of. anything else decodes as the plain mov or push.
+      if ((ins->flags != TAKE_FLAGS_PUSH && (ins->left.at & 0x3) == AT_VM)
+          || ((ins->right.at & 0x3) != AT_REG && (ins->right.at & 0x3) != AT_LOCAL)) {
+        if (ins->flags == TAKE_FLAGS_PUSH) {
+          ins->left = ins->right;
+          memset(&ins->right, 0, sizeof(ins->right));
+        }
+
+        ins->opcode = ins->flags == TAKE_FLAGS_PUSH ? OP_PUSH : OP_MOV;
+        ins->flags = ins->flags == TAKE_FLAGS_PUSH ? CONST_FLAGS_NONE : 0;
+      }
+
+      return true;
+
+    case OP_JMP:
+      if (ins->flags == JUMP_FLAGS_TABLE) {
+        return code_readSwitch(dt, bc, len, pc, compact, ins);
+      }
+
+      return code_readTarget(dt, bc, len, pc, compact, ins);
+
+    case OP_CMPJ:
+      return code_readOperand(dt, bc, len, pc, compact, &ins->left)
+        && code_readOperand(dt, bc, len, pc, compact, &ins->right)
+        && code_readTarget(dt, bc, len, pc, compact, ins);
+
+    case OP_CMPJ_IMM:
+      return code_readOperand(dt, bc, len, pc, compact, &ins->left)
+        && code_readImmediate(bc, len, pc, compact, false, &ins->imm.u64)
+        && code_readTarget(dt, bc, len, pc, compact, ins);
+
+    case OP_POP:
+    case OP_RET:
+      return code_readUint(bc, len, pc, compact, sizeof(uint16_t), &ins->imm.u64);
+
+    case OP_FCALL:
+      if (!code_readTarget(dt, bc, len, pc, compact, ins)) {
+        return false;
+      }
+
+      // where OP_RET comes back to
+      ins->imm.u64 = *pc;
+      return true;
+
+    case OP_CALL: {
+      uint64_t count = 0;
+
+      // the member cache shares its bytes with the jump cache set above
+      memset(&ins->member, 0, sizeof(ins->member));
+
+      if (!code_readOperand(dt, bc, len, pc, compact, &ins->left)) {
+        return false;
+      }
+
+      // both would put the arguments in two places
+      if (ins->flags & CALL_FLAGS_OPERANDS) {
+        if ((ins->flags & CALL_FLAGS_REGISTER_ARGS)
+            || !code_readUint(bc, len, pc, compact, sizeof(uint8_t), &count) || count > CALL_MAX_OPERANDS) {
+          return false;
+        }
+
+        ins->imm.call.args = (operand_t*)calloc(count != 0 ? count : 1, sizeof(operand_t));
+        ins->imm.call.count = count;
+
+        for (uint64_t i = 0; i < count; i++) {
+          if (!code_readOperand(dt, bc, len, pc, compact, &ins->imm.call.args[i])) {
+            code_freeOwned(ins);
+            return false;
+          }
+        }
+      }
+
+      if ((ins->flags & CALL_FLAGS_RESULT) && !code_readOperand(dt, bc, len, pc, compact, &ins->right)) {
+        code_freeOwned(ins);
+        return false;
+      }
+
+      // a member access through the builtin's own slot. the handler still
+      // checks that the slot holds the builtin, as a program may store to it.
+      if ((ins->flags & CALL_FLAGS_OPERANDS) && ins->left.at == (AT_DATA | AT_ABS)) {
+        if (ins->left.loc == BUILTIN_SYSTEM_GET_OBJECT_MEMBER && count == 2) {
+          ins->opcode = CODE_OP_GETFIELD;
+        } else if (ins->left.loc == BUILTIN_SYSTEM_SET_OBJECT_MEMBER && count == 3) {
+          ins->opcode = CODE_OP_SETFIELD;
+        }
+      }
+
+      return true;
+    }
+
+    case OP_NEG:
+    case OP_NOT:
+    case OP_PRINT:
+    case OP_JOIN:
+      return code_readOperand(dt, bc, len, pc, compact, &ins->left);
+
+    case OP_SPAWN:
+      return code_readOperand(dt, bc, len, pc, compact, &ins->left)
+        && code_readOperand(dt, bc, len, pc, compact, &ins->target);
+
+    case OP_CONST: {
+      uint64_t sz;
+
+      if (!code_readUint(bc, len, pc, compact, sizeof(sz), &sz) || sz > len - *pc) {
+        return false;
+      }
+
+      ins->imm.raw.data = bc + *pc;
+      ins->imm.raw.size = sz;
+      *pc += sz;
+
+      return true;
+    }
+
+    case OP_JIT:
+      if ((ins->flags & JIT_FLAG_MEMOIZE)
+          && !code_readUint(bc, len, pc, compact, sizeof(uint8_t), &ins->imm.u64)) {
+        return false;
+      }
+
+      if (ins->flags & JIT_FLAG_BEGIN) {
+        return code_readOperand(dt, bc, len, pc, compact, &ins->left);
+      }
+
+      return true;
+
+    case OP_NOOP:
+    case OP_YIELD:
+    case OP_HALT:
+      return true;
+
+    default:
+      // unassigned opcodes execute as a no-op
+      ins->opcode = OP_NOOP;
+      return true;
+  }
+}
+
+// dispatched on as decoded, until the interpreter quickens it
+static bool code_decodeOne(datatable_t *dt, const ubyte_t *bc, size_t len, size_t *pc, bool compact,
+                           instruction_t *ins) {
+  bool ok = code_decodeFields(dt, bc, len, pc, compact, ins);
+
+  ins->handler = ins->opcode;
+
+  // `add $sp, n` / `sub $sp, n`, as @locals does
+  if ((ins->opcode == CODE_OP_ADD_I64_IMM || ins->opcode == CODE_OP_SUB_I64_IMM)
+      && ins->left.at == (AT_VM | AT_ABS) && ins->left.loc == 1 + AT_LOCAL) {
+    ins->handler = CODE_OP_STACK_IMM;
+  }
+
+  return ok;
+}
+
+// a loaddata or pushdata, whose bytes are an immediate in the bytecode
+static bool code_isRawData(const instruction_t *ins) {
+  return (ins->opcode == OP_LOAD || ins->opcode == OP_PUSH) && ins->flags == CONST_FLAGS_RAWDATA;
+}
+
+// a halt that returns from interpreter_run, at `offset`
+static void code_setHalt(instruction_t *ins, uint64_t offset) {
+  memset(ins, 0, sizeof(instruction_t));
+  ins->opcode = OP_HALT;
+  ins->handler = OP_HALT;
+  ins->flags = HALT_FLAGS_RETURN;
+  ins->offset = offset;
+  ins->cache.index = CODE_INVALID_INDEX;
+}
+
+// resolves CONST_FLAGS_POOL loads and pushes in [first, end) to their entry
+static void code_resolvePool(code_t *code, uint32_t first, uint32_t end) {
+  for (uint32_t i = first; i < end; i++) {
+    instruction_t *ins = &code->instructions[i];
+
+    if ((ins->opcode == OP_LOAD || ins->opcode == OP_PUSH) && ins->flags == CONST_FLAGS_POOL) {
+      uint64_t index = ins->imm.u64;
+
+      ins->imm.raw.data = index < code->numConstants ? code->constants[index].data : NULL;
+      ins->imm.raw.size = index < code->numConstants ? code->constants[index].size : 0;
+    }
+  }
+}
+
+// the instructions of the SEGMENTS table, if it covers the code in order
+// and no segment claims more instructions than it has bytes. otherwise
+// the table is ignored, and the code decoded up front.
+static bool code_countSegments(const image_t *image, size_t *count) {
+  *count = 0;
+
+  for (size_t i = 0; i < image->numSegments; i++) {
+    bin_segment_t seg = image_segment(image, i);
+    uint64_t end = i + 1 < image->numSegments ? image_segment(image, i + 1).offset : image->codeLen;
+
+    if ((i == 0 && seg.offset != 0) || seg.offset > end || end > image->codeLen || seg.count > end - seg.offset) {
+      return false;
+    }
+
+    *count += seg.count;
+  }
+
+  return image->numSegments != 0;
+}
+
+static void code_initSegments(code_t *code, const image_t *image) {
+  uint32_t first = 0;
+
+  code->numSegments = image->numSegments;
+  code->segments = (code_segment_t*)malloc(sizeof(code_segment_t) * code->numSegments);
+
+  for (size_t i = 0; i < code->numSegments; i++) {
+    bin_segment_t entry = image_segment(image, i);
+    code_segment_t *seg = &code->segments[i];
+
+    seg->offset = entry.offset;
+    seg->end = i + 1 < code->numSegments ? image_segment(image, i + 1).offset : image->codeLen;
+    seg->first = first;
+    seg->count = entry.count;
+    seg->loaded = entry.count == 0;
+    seg->pool = NULL;
+    seg->poolSize = 0;
+
+    // falling through into the segment decodes it, see CODE_OP_SEGMENT
+    if (!seg->loaded) {
+      instruction_t *ins = &code->instructions[first];
+
+      ins->opcode = CODE_OP_SEGMENT;
+      ins->handler = CODE_OP_SEGMENT;
+      ins->offset = seg->offset;
+      ins->cache.index = CODE_INVALID_INDEX;
+    }
+
+    first += entry.count;
+  }
+}
+
+static void code_loadSegment(code_t *code, code_segment_t *seg) {
+  size_t pc = seg->offset, poolSize = 0, poolOffset = 0;
+  uint32_t i;
+
+  seg->loaded = true;
+
+  for (i = 0; i < seg->count; i++) {
+    instruction_t *ins = &code->instructions[seg->first + i];
+    size_t at = pc;
+
+    if (pc >= seg->end || !code_decodeOne(code->dt, code->bc, seg->end, &pc, code->compact, ins)) {
+      break;
+    }
+
+    code->offsetMap[at] = seg->first + i + 1;
+
+    if (code_isRawData(ins)) {
+      poolSize += ins->imm.raw.size + 1;
+    }
+  }
+
+  // a malformed segment halts where it stops decoding
+  for (uint32_t rest = i; rest < seg->count; rest++) {
+    code_setHalt(&code->instructions[seg->first + rest], pc);
+  }
+
+  if (poolSize != 0) {
+    seg->pool = (ubyte_t*)malloc(poolSize);
+    seg->poolSize = poolSize;
+
+    for (uint32_t j = 0; j < i; j++) {
+      instruction_t *ins = &code->instructions[seg->first + j];
+
+      if (code_isRawData(ins)) {
+        ubyte_t *data = seg->pool + poolOffset;
+
+        memcpy(data, ins->imm.raw.data, ins->imm.raw.size);
+        data[ins->imm.raw.size] = '\0';
+
+        ins->imm.raw.data = data;
+        poolOffset += ins->imm.raw.size + 1;
+      }
+    }
+  }
+
+  code_resolvePool(code, seg->first, seg->first + i);
+}
+
+// the last segment whose first instruction is at most `index`
+static code_segment_t *code_segmentOf(code_t *code, uint32_t index) {
+  size_t lo = 0, hi = code->numSegments;
+
+  while (hi - lo > 1) {
+    size_t mid = lo + (hi - lo) / 2;
+
+    if (code->segments[mid].first <= index) {
+      lo = mid;
+    } else {
+      hi = mid;
+    }
+  }
+
+  return &code->segments[lo];
+}
+
+// the last segment starting at or before the byte `offset`
+static code_segment_t *code_segmentAt(const code_t *code, uint64_t offset) {
+  size_t lo = 0, hi = code->numSegments;
+
+  while (hi - lo > 1) {
+    size_t mid = lo + (hi - lo) / 2;
+
+    if (code->segments[mid].offset <= offset) {
+      lo = mid;
+    } else {
+      hi = mid;
+    }
+  }
+
+  return &code->segments[lo];
+}
+
+code_t *code_decode(datatable_t *dt, const program_t *program) {
+  code_t *code = (code_t*)calloc(1, sizeof(code_t));
+  const image_t *image = &program->image;
+  const ubyte_t *bc = image->code;
+  size_t len = image->codeLen;
+  instruction_t scratch;
+  size_t pc = 0, count = 0, poolSize = 0;
+  uint32_t numConstants = program->numConstants;
+  bool lazy;
+
+  // first pass: count instructions and constants so each array is allocated once.
+  // segmented code is counted by its table, and has no OP_CONST.
+  lazy = code_countSegments(image, &count);
+
+  while (!lazy && pc < len && code_decodeOne(dt, bc, len, &pc, image->compact, &scratch)) {
+    if (scratch.opcode == OP_CONST) {
+      poolSize += scratch.imm.raw.size + 1;
+      ++numConstants;
+    } else if (code_isRawData(&scratch)) {
+      poolSize += scratch.imm.raw.size + 1;
+    }
+
+    code_freeOwned(&scratch);
+    ++count;
+  }
+
+  code->count = count + 1;
+  code->len = len;
+  code->bc = bc;
+  code->compact = image->compact;
+  code->dt = dt;
+  code->program = program;
+
+  for (int i = 0; i < 4; i++) {
+    code->storageCount[i] = dt->storage[i].count;
+  }
+
+  // zeroed, so with segments only those decoded are touched
+  code->instructions = (instruction_t*)calloc(code->count, sizeof(instruction_t));
+  code->offsetMap = (uint32_t*)calloc(len + 1, sizeof(uint32_t));
+
+  code->pool = (ubyte_t*)malloc(poolSize != 0 ? poolSize : 1);
+  code->poolSize = poolSize;
+
+  // the program's entries are shared, unless OP_CONST adds to them
+  if (numConstants == program->numConstants) {
+    code->constants = program->constants;
+  } else {
+    code->constants = (code_const_t*)malloc(sizeof(code_const_t) * numConstants);
+    memcpy(code->constants, program->constants, sizeof(code_const_t) * program->numConstants);
+  }
+
+  code->numConstants = program->numConstants;
+  code->labels = program->labels;
+  code->numLabels = program->numLabels;
+
+  size_t poolOffset = 0;
+
+  if (lazy) {
+    code_initSegments(code, image);
+  }
+
+  pc = 0;
+
+  for (size_t i = 0; !lazy && i < count; i++) {
+    instruction_t *ins = &code->instructions[i];
+
+    code->offsetMap[pc] = i + 1;
+    code_decodeOne(dt, bc, len, &pc, image->compact, ins);
+
+    if (ins->opcode == OP_CONST) {
+      code_const_t *c = &code->constants[code->numConstants++];
+      ubyte_t *data = code->pool + poolOffset;
+
+      memcpy(data, ins->imm.raw.data, ins->imm.raw.size);
+      data[ins->imm.raw.size] = '\0';
+
+      c->data = data;
+      c->size = ins->imm.raw.size;
+
+      poolOffset += c->size + 1;
+    } else if (code_isRawData(ins)) {
+      // terminated in the pool like a constant, so it can be loaded by reference
+      ubyte_t *data = code->pool + poolOffset;
+
+      memcpy(data, ins->imm.raw.data, ins->imm.raw.size);
+      data[ins->imm.raw.size] = '\0';
+
+      ins->imm.raw.data = data;
+      poolOffset += ins->imm.raw.size + 1;
+    }
+  }
+
+  // pool references may come before their entry, so resolve them last
+  if (!lazy) {
+    code_resolvePool(code, 0, count);
+  }
+
+  // terminating halt, which returns from interpreter_run instead of exiting.
+  // a truncated trailing instruction is dropped in its favor.
+  code_setHalt(&code->instructions[count], len);
+  code->offsetMap[len] = count + 1;
+
+  return code;
+}
+
+void code_destroy(code_t *code) {
+  // those of segments not decoded are zeroed
+  for (size_t i = 0; i < code->count; i++) {
+    code_freeOwned(&code->instructions[i]);
+  }
+
+  for (size_t i = 0; i < code->numSegments; i++) {
+    free(code->segments[i].pool);
+  }
+
+  free(code->segments);
+
+  if (code->constants != code->program->constants) {
+    free(code->constants);
+  }
+
+  free(code->pool);
+  free(code->instructions);
+  free(code->offsetMap);
+  free(code);
+}
+
+void code_ensure(code_t *code, uint32_t first, uint32_t end) {
+  if (code->numSegments == 0 || first >= end) {
+    return;
+  }
+
+  for (code_segment_t *seg = code_segmentOf(code, first);
+       seg < code->segments + code->numSegments && seg->first < end; seg++) {
+    if (!seg->loaded) {
+      code_loadSegment(code, seg);
+    }
+  }
+}
+
+uint32_t code_indexAt(code_t *code, uint64_t offset) {
+  uint32_t index = code_decodedIndexAt(code, offset);
+
+  if (index == CODE_INVALID_INDEX && offset < code->len && code->numSegments != 0) {
+    code_segment_t *seg = code_segmentAt(code, offset);
+
+    if (!seg->loaded) {
+      code_loadSegment(code, seg);
+      index = code_decodedIndexAt(code, offset);
+    }
+  }
+
+  return index;
+}
+
+uint32_t code_indexOf(code_t *code, uint64_t offset) {
+  uint32_t index = code_indexAt(code, offset);
+
+  if (index == CODE_INVALID_INDEX) {
+    // past the end, or not an instruction boundary -- fail safe by halting
+    return code->count - 1;
+  }
+
+  return index;
+}
+
+// positions are in the program's pool, then the code's, then those of
+// the segments: a segment's pool is no larger than its code, so it is at
+// its offset in the code plus the one in its own pool
+bool code_poolOffset(const code_t *code, const ubyte_t *data, uint64_t *offset) {
+  const program_t *program = code->program;
+  uint64_t base = program->poolSize + code->poolSize;
+
+  if (data >= program->pool && data < program->pool + program->poolSize) {
+    *offset = (uint64_t)(data - program->pool);
+    return true;
+  }
+
+  if (data >= code->pool && data < code->pool + code->poolSize) {
+    *offset = program->poolSize + (uint64_t)(data - code->pool);
+    return true;
+  }
+
+  for (size_t i = 0; i < code->numSegments; i++) {
+    const code_segment_t *seg = &code->segments[i];
+
+    if (seg->pool != NULL && data >= seg->pool && data < seg->pool + seg->poolSize) {
+      *offset = base + seg->offset + (uint64_t)(data - seg->pool);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+const ubyte_t *code_poolData(code_t *code, uint64_t offset) {
+  const program_t *program = code->program;
+  code_segment_t *seg;
+
+  if (offset < program->poolSize) {
+    return program->pool + offset;
+  }
+
+  offset -= program->poolSize;
+
+  if (offset < code->poolSize) {
+    return code->pool + offset;
+  }
+
+  offset -= code->poolSize;
+
+  if (code->numSegments == 0 || offset >= code->len) {
+    return NULL;
+  }
+
+  seg = code_segmentAt(code, offset);
+
+  if (!seg->loaded) {
+    code_loadSegment(code, seg);
+  }
+
+  return offset - seg->offset < seg->poolSize ? seg->pool + (offset - seg->offset) : NULL;
+}
@@ -4,31 +4,77 @@
 
 #include <string.h>
 
-datatable_t *datatable_create() {
+#if defined(__unix__) || defined(__APPLE__)
+  #define DATATABLE_MMAP 1
+  #include <sys/mman.h>
+  #include <unistd.h>
+#else
+  #define DATATABLE_MMAP 0
+#endif
+
+#if DATATABLE_MMAP
+// bytes mapped for `count` slots: whole pages, plus the guard page
+static size_t datatable_mapSize(size_t count) {
+  size_t page = (size_t)sysconf(_SC_PAGESIZE);
+
+  return (count * sizeof(value_t) + page - 1) / page * page + page;
+}
+#endif
+
+// `count` zeroed slots
+static value_t *datatable_map(size_t count) {
+#if DATATABLE_MMAP
+  size_t size = datatable_mapSize(count);
+  size_t page = (size_t)sysconf(_SC_PAGESIZE);
+  void *mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+  if (mem == MAP_FAILED) {
+    return NULL;
+  }
+
+  mprotect((char*)mem + size - page, page, PROT_NONE);
+
+  return (value_t*)mem;
+#else
+  return (value_t*)calloc(count, sizeof(value_t));
+#endif
+}
+
+static void datatable_unmap(value_t *data, size_t count) {
+#if DATATABLE_MMAP
+  munmap(data, datatable_mapSize(count));
+#else
+  free(data);
+#endif
+}
+
+datatable_t *datatable_create(size_t staticDataCount, size_t stackCount) {
   datatable_t *dt = (datatable_t*)malloc(sizeof(datatable_t));
 
-  dt->storage[0].data = (value_t*)malloc(sizeof(value_t) * 32);
-  for (int i = 0; i < 32; i++) {
+  dt->storage[0].data = (value_t*)malloc(sizeof(value_t) * VM_DATA_COUNT);
+  for (int i = 0; i < VM_DATA_COUNT; i++) {
     dt->storage[0].data[i].data.u64 = 0;
-    dt->storage[0].data[i].metadata = TYPE_UINT;
+    VALUE_SET_META(&dt->storage[0].data[i], TYPE_UINT, FLAG_NONE);
   }
   dt->storage[AT_VM].lenVal = &VM_DATA_POINTER(dt);
+  dt->storage[AT_VM].count = VM_DATA_COUNT;
 
-  dt->storage[AT_DATA].data = (value_t*)malloc(STATIC_DATA_SIZE_BYTES);
-  memset(dt->storage[AT_DATA].data, 0, STATIC_DATA_SIZE_BYTES);
+  dt->storage[AT_DATA].data = datatable_map(staticDataCount);
   // dt->storage[AT_DATA].len = 0;
   dt->storage[AT_DATA].lenVal = &VM_STATIC_DATA_POINTER(dt);
-  *dt->storage[AT_DATA].lenVal = 128; // reserve 128 spaces for builtin functions
+  dt->storage[AT_DATA].count = staticDataCount;
+  *dt->storage[AT_DATA].lenVal = STATIC_DATA_RESERVED; // reserve spaces for builtin functions
 
-  dt->storage[AT_LOCAL].data = (value_t*)malloc(STACK_SIZE_BYTES);
-  memset(dt->storage[AT_LOCAL].data, 0, STACK_SIZE_BYTES);
+  dt->storage[AT_LOCAL].data = datatable_map(stackCount);
   // dt->storage[AT_LOCAL].len = 0;
   dt->storage[AT_LOCAL].lenVal = &VM_STACK_POINTER(dt);
+  dt->storage[AT_LOCAL].count = stackCount;
 
   dt->storage[AT_REG].data = (value_t*)malloc(sizeof(value_t) * NUM_REGISTERS);
   memset(dt->storage[AT_REG].data, 0, sizeof(value_t) * NUM_REGISTERS);
   // dt->storage[AT_REG].len = 0;
   dt->storage[AT_REG].lenVal = &VM_REG_POINTER(dt);
+  dt->storage[AT_REG].count = NUM_REGISTERS;
 
   return dt;
 }
@@ -36,14 +82,20 @@ datatable_t *datatable_create() {
 void datatable_destroy(runtime_t *rt, datatable_t *dt) {
   int i;
 
-  for (i = 0; i < 4; i++) {
+  // AT_VM last: the other stores' lengths are kept in it
+  for (i = 3; i >= 0; i--) {
     while (*dt->storage[i].lenVal) {
       value_destroy(rt, &dt->storage[i].data[*dt->storage[i].lenVal - 1]);
       --*dt->storage[i].lenVal;
     }
 
     if (dt->storage[i].data != NULL) {
-      free(dt->storage[i].data);
+      if (i == AT_DATA || i == AT_LOCAL) {
+        datatable_unmap(dt->storage[i].data, dt->storage[i].count);
+      } else {
+        free(dt->storage[i].data);
+      }
+
       dt->storage[i].data = NULL;
     }
   }
@@ -51,22 +103,119 @@ void datatable_destroy(runtime_t *rt, datatable_t *dt) {
   free(dt);
 }
 
-void datatable_markTable(storage_t *s) {
-  while (*s->lenVal) {
-    value_t *v = &s->data[*s->lenVal - 1];
+// zeroes `count` slots from datatable_map. of a mapping, the pages in
+// its first DATATABLE_KEEP_BYTES that were touched are zeroed in place,
+// so the next run does not fault them in again; the rest are given back,
+// and read as zero once touched again.
+static void datatable_clear(value_t *data, size_t count) {
+#if DATATABLE_MMAP
+  size_t page = (size_t)sysconf(_SC_PAGESIZE);
+  size_t size = datatable_mapSize(count) - page; // not the guard page
+  size_t keep = DATATABLE_KEEP_BYTES / page * page < size ? DATATABLE_KEEP_BYTES / page * page : size;
+  unsigned char vec[DATATABLE_KEEP_BYTES / 4096 + 1]; // pages are 4 KB or more
+
+  if (keep / page <= sizeof(vec) && mincore(data, keep, vec) == 0) {
+    for (size_t i = 0; i < keep / page; i++) {
+      if (vec[i] & 1) {
+        memset((char*)data + i * page, 0, page);
+      }
+    }
+
+    if (keep == size || madvise((char*)data + keep, size - keep, MADV_DONTNEED) == 0) {
+      return;
+    }
+  }
+
+  if (madvise(data, size, MADV_DONTNEED) == 0) {
+    return;
+  }
+#endif
+
+  memset(data, 0, sizeof(value_t) * count);
+}
+
+void datatable_reset(runtime_t *rt, datatable_t *dt) {
+  int i;
+
+  for (i = 3; i > 0; i--) {
+    while (*dt->storage[i].lenVal) {
+      value_destroy(rt, &dt->storage[i].data[*dt->storage[i].lenVal - 1]);
+      --*dt->storage[i].lenVal;
+    }
+
+    if (i == AT_DATA || i == AT_LOCAL) {
+      datatable_clear(dt->storage[i].data, dt->storage[i].count);
+    } else {
+      memset(dt->storage[i].data, 0, sizeof(value_t) * dt->storage[i].count);
+    }
+  }
+
+  for (i = 0; i < VM_DATA_COUNT; i++) {
+    dt->storage[AT_VM].data[i].data.u64 = 0;
+    VALUE_SET_META(&dt->storage[AT_VM].data[i], TYPE_UINT, FLAG_NONE);
+  }
+
+  *dt->storage[AT_DATA].lenVal = STATIC_DATA_RESERVED;
+}
+
+size_t datatable_residentBytes(const datatable_t *dt, archtype_t at) {
+  const storage_t *s = &dt->storage[at & 0x3];
+
+#if DATATABLE_MMAP
+  if ((at & 0x3) == AT_DATA || (at & 0x3) == AT_LOCAL) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t numPages = datatable_mapSize(s->count) / page - 1; // not the guard page
+    size_t resident = 0;
+    unsigned char *vec = (unsigned char*)malloc(numPages);
 
-    // @TODO partitioning to prevent branch prediction misses?
-    if (v->metadata & (TYPE_POINTER | (FLAG_OBJECT << 8)) == (TYPE_POINTER | (FLAG_OBJECT << 8))) {
-      v->data.hv->flags |= FLAG_MARKED;
+    if (vec != NULL && mincore(s->data, numPages * page, vec) == 0) {
+      for (size_t i = 0; i < numPages; i++) {
+        resident += vec[i] & 1;
+      }
     }
 
-    --*s->lenVal;
+    free(vec);
+
+    return resident * page;
+  }
+#endif
+
+  return s->count * sizeof(value_t);
+}
+
+bool datatable_useHugePages(datatable_t *dt) {
+#if DATATABLE_MMAP && defined(MADV_HUGEPAGE)
+  size_t page = (size_t)sysconf(_SC_PAGESIZE);
+  bool ok = true;
+
+  for (int i = AT_DATA; i <= AT_LOCAL; i++) {
+    // not the guard page
+    size_t size = datatable_mapSize(dt->storage[i].count) - page;
+
+    ok = madvise(dt->storage[i].data, size, MADV_HUGEPAGE) == 0 && ok;
+  }
+
+  return ok;
+#else
+  (void)dt;
+
+  return false;
+#endif
+}
+
+void datatable_markTable(storage_t *s, size_t len, heap_t *heap) {
+  for (size_t i = 0; i < len; i++) {
+    heap_mark(heap, &s->data[i]);
   }
 }
 
-void datatable_mark(datatable_t *dt) {
-  datatable_markTable(&dt->storage[AT_DATA]);
-  datatable_markTable(&dt->storage[AT_LOCAL]);
+void datatable_mark(datatable_t *dt, heap_t *heap) {
+  datatable_markTable(&dt->storage[AT_DATA], *dt->storage[AT_DATA].lenVal, heap);
+  datatable_markTable(&dt->storage[AT_LOCAL], *dt->storage[AT_LOCAL].lenVal, heap);
+  // registers are addressed absolutely, all of them are live
+  datatable_markTable(&dt->storage[AT_REG], NUM_REGISTERS, heap);
+
+  heap_markDrain(heap);
 }
 
 /* address [00000000 00000000 00000000 0000] abs/rel [00] storage [00] */
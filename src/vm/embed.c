@@ -0,0 +1,121 @@
+#include <vm/embed.h>
+#include <vm/builtins.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+static void *embed_collector(void *arg) {
+  runtime_collector((runtime_t*)arg);
+
+  return NULL;
+}
+
+embed_t *embed_create(program_t *program) {
+  embed_t *e = (embed_t*)malloc(sizeof(embed_t));
+
+  e->rt = runtime_create();
+  builtins_register(e->rt);
+
+  runtime_attach(e->rt);
+  pthread_create(&e->gcThread, NULL, embed_collector, (void*)e->rt);
+
+  e->it = interpreter_createShared(e->rt, program);
+  e->it->haltExits = false; // back to the host
+
+  return e;
+}
+
+void embed_destroy(embed_t *e) {
+  output_flush(&e->rt->output);
+  interpreter_destroy(e->it);
+
+  runtime_detach(e->rt);
+  runtime_stopCollector(e->rt);
+  pthread_join(e->gcThread, NULL);
+
+  runtime_gc(e->rt);
+  runtime_destroy(e->rt);
+  free(e);
+}
+
+void embed_reset(embed_t *e) {
+  interpreter_reset(e->it);
+}
+
+bool embed_register(embed_t *e, uint32_t index, native_function_t fn) {
+  if (index >= BUILTIN_HOST_COUNT) {
+    return false;
+  }
+
+  e->rt->hosts[index] = fn;
+  e->rt->dt->storage[AT_DATA].data[BUILTIN_HOST_FIRST + index] = value_fromFunction(fn);
+
+  return true;
+}
+
+bool embed_entry(const program_t *program, const char *name, uint64_t *offset) {
+  const size_t len = strlen(name);
+  const char *labelName;
+  uint32_t labelLen;
+  bin_symbol_t symbol;
+  size_t pos = 0;
+
+  while (image_symbol(&program->image, &pos, &symbol, &labelName)) {
+    if ((symbol.flags & BIN_SYMBOL_EXPORT) && symbol.nameLength == len && memcmp(labelName, name, len) == 0) {
+      *offset = symbol.offset;
+      return true;
+    }
+  }
+
+  pos = 0;
+
+  while (image_debugLabel(&program->image, &pos, offset, &labelName, &labelLen)) {
+    if (labelLen == len && memcmp(labelName, name, len) == 0) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// what the entry point left on the stack, released
+static void embed_clearStack(runtime_t *rt) {
+  storage_t *stack = &rt->dt->storage[AT_LOCAL];
+
+  while (*stack->lenVal) {
+    value_t *v = &stack->data[--*stack->lenVal];
+
+    value_destroy(rt, v);
+    VALUE_SET_META(v, TYPE_NONE, FLAG_NONE);
+  }
+}
+
+void embed_run(embed_t *e) {
+  // wherever the last call left off
+  embed_clearStack(e->rt);
+  interpreter_seek(e->it, 0);
+  e->it->flags = 0;
+
+  interpreter_run(e->it);
+}
+
+value_t embed_call(embed_t *e, uint64_t offset, const value_t *args, size_t count) {
+  value_t *regs = e->rt->dt->storage[AT_REG].data;
+
+  if (count > NUM_REGISTERS - 1) {
+    count = NUM_REGISTERS - 1;
+  }
+
+  embed_clearStack(e->rt);
+
+  for (size_t i = 0; i < NUM_REGISTERS; i++) {
+    regs[i].data.u64 = 0;
+    VALUE_SET_META(&regs[i], TYPE_NONE, FLAG_NONE);
+  }
+
+  memcpy(&regs[1], args, count * sizeof(value_t));
+  interpreter_runEntry(e->it, offset);
+  embed_clearStack(e->rt);
+
+  return regs[0];
+}
@@ -0,0 +1,200 @@
+#include <vm/events.h>
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+bool events_enabled = false;
+
+typedef struct events_ring {
+  events_event_t events[EVENTS_RING_SIZE];
+  atomic_size_t head; // events recorded, the last EVENTS_RING_SIZE of them kept
+  uint32_t thread; // numbered from 1, in the order of their first event
+  const char *name;
+  struct events_ring *next;
+} events_ring_t;
+
+static _Thread_local events_ring_t *events_self = NULL;
+static _Atomic(events_ring_t*) events_rings = NULL; // pushed onto, never removed from
+static atomic_uint events_numThreads;
+static uint64_t events_epoch; // events_start
+
+static uint64_t events_now() {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+void events_start(void) {
+  events_epoch = events_now();
+  events_enabled = true;
+}
+
+// the calling thread's ring, NULL if it cannot be made
+static events_ring_t *events_ring() {
+  events_ring_t *ring = events_self;
+
+  if (ring != NULL) {
+    return ring;
+  }
+
+  if ((ring = (events_ring_t*)calloc(1, sizeof(events_ring_t))) == NULL) {
+    return NULL;
+  }
+
+  ring->thread = atomic_fetch_add(&events_numThreads, 1) + 1;
+  ring->next = atomic_load(&events_rings);
+
+  while (!atomic_compare_exchange_weak(&events_rings, &ring->next, ring));
+
+  return events_self = ring;
+}
+
+void events_record(events_kind_t kind, uint64_t start, uint64_t nanos, uint64_t value) {
+  events_ring_t *ring = events_ring();
+  size_t head;
+
+  if (ring == NULL) {
+    return;
+  }
+
+  head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  ring->events[head & (EVENTS_RING_SIZE - 1)] = (events_event_t){ start, nanos, value, kind };
+  atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+void events_instant(events_kind_t kind, uint64_t value) {
+  events_record(kind, events_now(), 0, value);
+}
+
+void events_nameThread(const char *name) {
+  events_ring_t *ring = events_ring();
+
+  if (ring != NULL) {
+    ring->name = name;
+  }
+}
+
+// microseconds since events_start, as chrome://tracing takes them
+static double events_us(uint64_t ns) {
+  return ns >= events_epoch ? (double)(ns - events_epoch) / 1e3 : 0.0;
+}
+
+// a "C" event: what the counter `name` of `ring` was from `window` on
+static void events_writeCount(FILE *f, const events_ring_t *ring, const char *name, const char *unit,
+  uint64_t window, uint64_t count, const char **sep) {
+  fprintf(f, "%s{\"name\": \"%s (thread %u)\", \"ph\": \"C\", \"ts\": %.3f, \"pid\": 1, \"tid\": %u, \"args\": {\"%s\": %llu}}",
+    *sep, name, ring->thread, events_us(window * EVENTS_WINDOW_NS), ring->thread, unit, (unsigned long long)count);
+  *sep = ",\n";
+}
+
+// the allocation events of one kind in `ring`, as counts per window. a
+// window without any drops the count back to 0.
+static void events_writeCounts(FILE *f, const events_ring_t *ring, size_t first, size_t head, events_kind_t kind,
+  const char *name, const char *unit, const char **sep) {
+  uint64_t window = 0, count = 0;
+  bool open = false;
+
+  for (size_t i = first; i < head; i++) {
+    const events_event_t *event = &ring->events[i & (EVENTS_RING_SIZE - 1)];
+    uint64_t at = event->start / EVENTS_WINDOW_NS;
+
+    if (event->kind != kind) {
+      continue;
+    }
+
+    if (open && at != window) {
+      events_writeCount(f, ring, name, unit, window, count, sep);
+
+      if (at > window + 1) {
+        events_writeCount(f, ring, name, unit, window + 1, 0, sep);
+      }
+
+      count = 0;
+    }
+
+    window = at;
+    open = true;
+    count += kind == EVENTS_ALLOC ? 1 : event->value;
+  }
+
+  if (open) {
+    events_writeCount(f, ring, name, unit, window, count, sep);
+    events_writeCount(f, ring, name, unit, window + 1, 0, sep);
+  }
+}
+
+bool events_write(const char *path) {
+  static const char *const names[] = {
+    [EVENTS_GC_WAIT] = "stop mutators",
+    [EVENTS_GC_MARK_STEP] = "mark (incremental)",
+    [EVENTS_GC_SWEEP] = "sweep",
+    [EVENTS_GC_FINALIZE] = "finalize",
+    [EVENTS_GC_COMPACT] = "compact"
+  };
+  const char *sep = "";
+  FILE *f = fopen(path, "w");
+
+  if (f == NULL) {
+    fprintf(stderr, "could not open %s for writing\n", path);
+    return false;
+  }
+
+  fprintf(f, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+
+  for (const events_ring_t *ring = atomic_load(&events_rings); ring != NULL; ring = ring->next) {
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    size_t first = head > EVENTS_RING_SIZE ? head - EVENTS_RING_SIZE : 0;
+
+    if (ring->name != NULL) {
+      fprintf(f, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %u, \"args\": {\"name\": \"%s\"}}",
+        sep, ring->thread, ring->name);
+      sep = ",\n";
+    }
+
+    if (first != 0) {
+      fprintf(f, "%s{\"name\": \"%llu older events dropped\", \"ph\": \"i\", \"s\": \"t\", \"ts\": %.3f, \"pid\": 1, \"tid\": %u}",
+        sep, (unsigned long long)first, events_us(ring->events[first & (EVENTS_RING_SIZE - 1)].start), ring->thread);
+      sep = ",\n";
+    }
+
+    events_writeCounts(f, ring, first, head, EVENTS_ALLOC, "heap nodes allocated", "nodes", &sep);
+    events_writeCounts(f, ring, first, head, EVENTS_RC_ALLOC, "buffer bytes allocated", "bytes", &sep);
+
+    for (size_t i = first; i < head; i++) {
+      const events_event_t *event = &ring->events[i & (EVENTS_RING_SIZE - 1)];
+      const char *name;
+
+      switch (event->kind) {
+        case EVENTS_ALLOC:
+        case EVENTS_RC_ALLOC:
+          continue;
+        case EVENTS_GC_MARK:
+          name = event->value ? "mark (full)" : "mark (minor)";
+          break;
+        default:
+          name = names[event->kind];
+          break;
+      }
+
+      fprintf(f, "%s{\"name\": \"%s\", \"cat\": \"gc\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, \"pid\": 1, \"tid\": %u",
+        sep, name, events_us(event->start), event->nanos / 1e3, ring->thread);
+
+      if (event->kind == EVENTS_GC_SWEEP || event->kind == EVENTS_GC_FINALIZE || event->kind == EVENTS_GC_MARK_STEP) {
+        fprintf(f, ", \"args\": {\"nodes\": %llu}", (unsigned long long)event->value);
+      } else if (event->kind == EVENTS_GC_COMPACT) {
+        fprintf(f, ", \"args\": {\"objects\": %llu}", (unsigned long long)event->value);
+      }
+
+      fputc('}', f);
+      sep = ",\n";
+    }
+  }
+
+  fprintf(f, "\n]}\n");
+
+  return fclose(f) == 0;
+}
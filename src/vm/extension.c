@@ -0,0 +1,98 @@
+#include <vm/extension.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <dlfcn.h>
+
+typedef struct extension_module {
+  void *handle;
+  const bb8_extension_t *table;
+  struct extension_module *next;
+} extension_module_t;
+
+// an embedding host may load them from any thread
+static pthread_mutex_t extension_lock = PTHREAD_MUTEX_INITIALIZER;
+static extension_module_t *extension_modules = NULL;
+
+static bool extension_is(const char *str, const char *bytes, size_t len) {
+  return str != NULL && strncmp(str, bytes, len) == 0 && str[len] == '\0';
+}
+
+bool extension_load(const char *path, const char **error) {
+  void *handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+  bb8_extension_entry_t entry;
+  const bb8_extension_t *table;
+  extension_module_t *m;
+  bool ok = true, added = false;
+
+  if (handle == NULL) {
+    *error = dlerror();
+    return false;
+  }
+
+  entry = (bb8_extension_entry_t)dlsym(handle, BB8_EXTENSION_SYMBOL);
+  table = entry != NULL ? entry() : NULL;
+
+  if (table == NULL || table->version != BB8_EXTENSION_VERSION || table->name == NULL) {
+    *error = "not an extension of this version";
+    dlclose(handle);
+    return false;
+  }
+
+  pthread_mutex_lock(&extension_lock);
+
+  for (m = extension_modules; m != NULL; m = m->next) {
+    if (strcmp(m->table->name, table->name) == 0) {
+      break;
+    }
+  }
+
+  if (m == NULL) {
+    m = (extension_module_t*)malloc(sizeof(extension_module_t));
+    m->handle = handle;
+    m->table = table;
+    m->next = extension_modules;
+    extension_modules = m;
+    added = true;
+  } else if (m->handle != handle) {
+    *error = "an extension of that name is loaded already";
+    ok = false;
+  }
+
+  pthread_mutex_unlock(&extension_lock);
+
+  // dlopen counted a reference to one loaded before, or to one not kept
+  if (!added) {
+    dlclose(handle);
+  }
+
+  return ok;
+}
+
+native_function_t extension_find(const char *module, size_t moduleLen, const char *name, size_t nameLen,
+    const char **signature) {
+  native_function_t fn = NULL;
+
+  pthread_mutex_lock(&extension_lock);
+
+  for (extension_module_t *m = extension_modules; m != NULL && fn == NULL; m = m->next) {
+    if (!extension_is(m->table->name, module, moduleLen)) {
+      continue;
+    }
+
+    for (uint32_t i = 0; i < m->table->numFunctions; i++) {
+      const bb8_extension_function_t *f = &m->table->functions[i];
+
+      if (extension_is(f->name, name, nameLen)) {
+        fn = (native_function_t)f->fn;
+        *signature = f->signature != NULL ? f->signature : "";
+        break;
+      }
+    }
+  }
+
+  pthread_mutex_unlock(&extension_lock);
+
+  return fn;
+}
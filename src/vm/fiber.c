@@ -0,0 +1,214 @@
+#include <vm/fiber.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#define FIBERS_INITIAL_CAP 16
+
+fibers_t *fibers_create() {
+  fibers_t *fibers = (fibers_t*)calloc(1, sizeof(fibers_t));
+  fiber_t *first = (fiber_t*)calloc(1, sizeof(fiber_t));
+
+  fibers->all = (fiber_t**)malloc(sizeof(fiber_t*) * FIBERS_INITIAL_CAP);
+  fibers->cap = FIBERS_INITIAL_CAP;
+
+  first->id = FIBERS_MAIN;
+  fibers->all[fibers->count++] = first;
+  fibers->live = 1;
+  fibers->current = first;
+
+  return fibers;
+}
+
+// the stack of a fiber that is not running; its registers own nothing
+static void fibers_release(runtime_t *rt, fiber_t *fiber) {
+  for (size_t i = 0; i < fiber->stackLen; i++) {
+    value_destroy(rt, &fiber->stack[i]);
+  }
+
+  free(fiber->stack);
+  fiber->stack = NULL;
+  fiber->stackLen = 0;
+  fiber->stackCap = 0;
+}
+
+void fibers_destroy(runtime_t *rt, fibers_t *fibers) {
+  for (size_t i = 0; i < fibers->count; i++) {
+    fiber_t *fiber = fibers->all[i];
+
+    if (fiber == NULL) {
+      continue;
+    }
+
+    // the running fiber's values are in the datatable, and its segment
+    // was emptied when it switched in
+    fibers_release(rt, fiber);
+    free(fiber);
+  }
+
+  free(fibers->all);
+  free(fibers);
+}
+
+fiber_t *fibers_spawn(fibers_t *fibers, const value_t *regs, uint64_t pc) {
+  fiber_t *fiber = (fiber_t*)calloc(1, sizeof(fiber_t));
+
+  if (fibers->count == fibers->cap) {
+    fibers->cap *= 2;
+    fibers->all = (fiber_t**)realloc(fibers->all, sizeof(fiber_t*) * fibers->cap);
+  }
+
+  fiber->id = (int64_t)fibers->count;
+  fiber->state = FIBER_RUNNABLE;
+  fiber->pc = pc;
+  memcpy(fiber->regs, regs, sizeof(fiber->regs));
+
+  fibers->all[fibers->count++] = fiber;
+  ++fibers->live;
+  fibers_enqueue(fibers, fiber);
+
+  return fiber;
+}
+
+fiber_t *fibers_get(fibers_t *fibers, int64_t id) {
+  if (id < 0 || (uint64_t)id >= fibers->count) {
+    return NULL;
+  }
+
+  return fibers->all[id];
+}
+
+void fibers_free(fibers_t *fibers, fiber_t *fiber) {
+  fibers->all[fiber->id] = NULL;
+  --fibers->live;
+
+  free(fiber->stack);
+  free(fiber);
+}
+
+void fibers_enqueue(fibers_t *fibers, fiber_t *fiber) {
+  fiber->next = NULL;
+
+  if (fibers->tail != NULL) {
+    fibers->tail->next = fiber;
+  } else {
+    fibers->head = fiber;
+  }
+
+  fibers->tail = fiber;
+}
+
+fiber_t *fibers_dequeue(fibers_t *fibers) {
+  fiber_t *fiber = fibers->head;
+
+  if (fiber != NULL) {
+    fibers->head = fiber->next;
+    fiber->next = NULL;
+
+    if (fibers->head == NULL) {
+      fibers->tail = NULL;
+    }
+  }
+
+  return fiber;
+}
+
+void fibers_switch(fibers_t *fibers, datatable_t *dt, fiber_t *next, uint64_t pc, uint8_t flags) {
+  fiber_t *current = fibers->current;
+  storage_t *stack = &dt->storage[AT_LOCAL];
+  value_t *regs = dt->storage[AT_REG].data;
+  size_t len = *stack->lenVal;
+
+  if (current->state != FIBER_DONE) {
+    if (len > current->stackCap) {
+      current->stackCap = len > 2 * current->stackCap ? len : 2 * current->stackCap;
+      current->stack = (value_t*)realloc(current->stack, sizeof(value_t) * current->stackCap);
+    }
+
+    // the values move: the slots past the length are left owning nothing,
+    // as OP_POP leaves them. an empty stack may have no buffer, which
+    // memcpy may not be given even for no bytes
+    if (len > 0) {
+      memcpy(current->stack, stack->data, sizeof(value_t) * len);
+    }
+
+    current->stackLen = len;
+    current->framePointer = VM_FRAME_POINTER(dt);
+
+    for (size_t i = 0; i < len; i++) {
+      VALUE_SET_META(&stack->data[i], TYPE_NONE, FLAG_NONE);
+    }
+
+    memcpy(current->regs, regs, sizeof(current->regs));
+    current->pc = pc;
+    current->flags = flags;
+  }
+
+  if (next->stackLen > 0) {
+    memcpy(stack->data, next->stack, sizeof(value_t) * next->stackLen);
+  }
+
+  *stack->lenVal = next->stackLen;
+  next->stackLen = 0;
+  VM_FRAME_POINTER(dt) = next->framePointer;
+
+  memcpy(regs, next->regs, sizeof(next->regs));
+
+  fibers->current = next;
+}
+
+void fibers_finish(runtime_t *rt, fibers_t *fibers, datatable_t *dt) {
+  fiber_t *fiber = fibers->current;
+  storage_t *stack = &dt->storage[AT_LOCAL];
+
+  while (*stack->lenVal) {
+    value_t *v = &stack->data[--*stack->lenVal];
+
+    value_destroy(rt, v);
+    VALUE_SET_META(v, TYPE_NONE, FLAG_NONE);
+  }
+
+  fiber->result = dt->storage[AT_REG].data[0];
+  fiber->state = FIBER_DONE;
+
+  free(fiber->stack);
+  fiber->stack = NULL;
+  fiber->stackCap = 0;
+
+  while (fiber->waiters != NULL) {
+    fiber_t *waiter = fiber->waiters;
+
+    fiber->waiters = waiter->next;
+    waiter->state = FIBER_RUNNABLE;
+    fibers_enqueue(fibers, waiter);
+  }
+}
+
+void fibers_mark(fibers_t *fibers, heap_t *heap) {
+  for (size_t i = 0; i < fibers->count; i++) {
+    fiber_t *fiber = fibers->all[i];
+
+    if (fiber == NULL || fiber == fibers->current) {
+      continue;
+    }
+
+    if (fiber->state == FIBER_DONE) {
+      heap_mark(heap, &fiber->result);
+      continue;
+    }
+
+    for (size_t r = 0; r < NUM_REGISTERS; r++) {
+      heap_mark(heap, &fiber->regs[r]);
+    }
+
+    for (size_t s = 0; s < fiber->stackLen; s++) {
+      heap_mark(heap, &fiber->stack[s]);
+    }
+
+    if (fiber->state == FIBER_IO) {
+      heap_mark(heap, &fiber->io);
+    }
+  }
+
+  heap_markDrain(heap);
+}
@@ -1,115 +1,1312 @@
 #include <vm/heap.h>
 #include <vm/value.h>
 #include <vm/runtime.h>
+#include <vm/object.h>
+#include <vm/array.h>
+#include <vm/map.h>
+#include <vm/cache.h>
+#include <vm/events.h>
 
 #include <stdlib.h>
+#include <stdatomic.h>
+#include <sched.h>
+#include <unistd.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
 
-#include <pthread.h>
-pthread_mutex_t heapMutex = PTHREAD_MUTEX_INITIALIZER;
+#include <string.h>
 
-heap_node_t *heap_node_create() {
-  heap_node_t *node = (heap_node_t*)malloc(sizeof(heap_node_t));
+// the buffer's list of nodes, after those of each class of the heap's
+// slab, then those of each pool class, see HEAP_POOL_CLASSES
+#define HEAP_TLAB_NODES SLAB_CLASSES
+#define HEAP_TLAB_POOL (SLAB_CLASSES + 1)
+#define HEAP_TLAB_LISTS (SLAB_CLASSES + 1 + HEAP_POOL_CLASSES)
+
+// the calling thread's allocation buffer, see HEAP_TLAB_BATCH
+typedef struct heap_tlab {
+  heap_t *heap; // NULL when not buffering for any heap
+  void *free[HEAP_TLAB_LISTS]; // blocks taken from the heap's slabs or pool, linked through their first word
+  uint32_t numFree[HEAP_TLAB_LISTS];
+  heap_node_t *newest; // nodes not linked into the heap yet
+  heap_node_t *oldest;
+  size_t numNodes;
+} heap_tlab_t;
+
+static _Thread_local heap_tlab_t heap_tlab;
+
+static void heap_markersDestroy(struct heap_markers *markers);
+
+// links the list from `newest` back to `oldest` in front of `*head`
+static void heap_splice(heap_node_t **head, heap_node_t *newest, heap_node_t *oldest) {
+  oldest->prev = *head;
+
+  if (*head != NULL) {
+    (*head)->next = oldest;
+  }
+
+  *head = newest;
+}
+
+// with the heap locked: links the buffered nodes into the nursery, or,
+// allocated while marking, the old generation (see heap_node_create)
+static void heap_tlabPublish(heap_tlab_t *tlab) {
+  heap_t *heap = tlab->heap;
+
+  if (tlab->newest == NULL) {
+    return;
+  }
+
+  if (heap->marking) {
+    heap_splice(&heap->head, tlab->newest, tlab->oldest);
+  } else {
+    heap_splice(&heap->young, tlab->newest, tlab->oldest);
+    heap->youngSize += tlab->numNodes;
+  }
+
+  heap->size += tlab->numNodes;
+  heap->allocated += tlab->numNodes;
+
+  tlab->newest = NULL;
+  tlab->oldest = NULL;
+  tlab->numNodes = 0;
+}
+
+// starts buffering for `heap`, flushing whatever heap was buffered for
+static void heap_tlabBind(heap_tlab_t *tlab, heap_t *heap) {
+  if (tlab->heap != NULL) {
+    heap_flush(tlab->heap);
+  }
+
+  tlab->heap = heap;
+}
+
+// the pool class of a block of `size`, above SLAB_MAX_SIZE; HEAP_POOL_CLASSES
+// if it is too big
+static inline unsigned heap_poolClassOf(size_t size) {
+  unsigned p = 0;
+  size_t blockSize = (size_t)SLAB_MAX_SIZE << 1;
+
+  while (p < HEAP_POOL_CLASSES && blockSize < size) {
+    blockSize <<= 1;
+    ++p;
+  }
+
+  return p;
+}
+
+static inline size_t heap_poolClassSize(unsigned p) {
+  return (size_t)SLAB_MAX_SIZE << (p + 1);
+}
+
+// with the heap locked: `block`, of pool class `p`, onto the heap's list,
+// or freed if that holds enough
+static void heap_poolPut(heap_t *heap, unsigned p, void *block) {
+  if (heap->numPooled[p] >= HEAP_POOL_HELD) {
+    free(block);
+    quota_credit(heap->slab.quota, heap_poolClassSize(p));
+    return;
+  }
+
+  *(void**)block = heap->pool[p];
+  heap->pool[p] = block;
+  ++heap->numPooled[p];
+}
+
+// with the heap locked: frees what the heap's lists hold
+static void heap_poolRelease(heap_t *heap) {
+  for (unsigned p = 0; p < HEAP_POOL_CLASSES; p++) {
+    while (heap->pool[p] != NULL) {
+      void *block = heap->pool[p];
+
+      heap->pool[p] = *(void**)block;
+      free(block);
+      quota_credit(heap->slab.quota, heap_poolClassSize(p));
+    }
+
+    heap->numPooled[p] = 0;
+  }
+}
+
+// a block of pool class `p` the heap had none of
+static void *heap_poolAlloc(heap_t *heap, unsigned p) {
+  void *block = malloc(heap_poolClassSize(p));
+
+  if (block != NULL) {
+    quota_force(heap->slab.quota, heap_poolClassSize(p));
+  }
+
+  return block;
+}
+
+// the slab the buffer's list `c` takes from, and the size of its blocks;
+// not for the pool's lists
+static slab_allocator_t *heap_tlabSlab(heap_t *heap, unsigned c, size_t *size) {
+  if (c == HEAP_TLAB_NODES) {
+    *size = sizeof(heap_node_t);
+    return &heap->nodes;
+  }
+
+  *size = slab_classSize(c);
+  return &heap->slab;
+}
+
+// takes a batch for the list `c` from its slab, or the heap's pool, and
+// publishes the nodes
+static void heap_tlabRefill(heap_tlab_t *tlab, unsigned c) {
+  heap_t *heap = tlab->heap;
+  size_t size;
+  slab_allocator_t *slab = c < HEAP_TLAB_POOL ? heap_tlabSlab(heap, c, &size) : NULL;
+
+  heap_lock(heap);
+
+  heap_tlabPublish(tlab);
+
+  if (c >= HEAP_TLAB_POOL) {
+    unsigned p = c - HEAP_TLAB_POOL;
+
+    while (tlab->numFree[c] < HEAP_POOL_BATCH && heap->pool[p] != NULL) {
+      void *block = heap->pool[p];
+
+      heap->pool[p] = *(void**)block;
+      --heap->numPooled[p];
+
+      *(void**)block = tlab->free[c];
+      tlab->free[c] = block;
+      ++tlab->numFree[c];
+    }
+
+    heap_unlock(heap);
+    return;
+  }
+
+  while (tlab->numFree[c] < HEAP_TLAB_BATCH) {
+    void *block = slab_alloc(slab, size);
+
+    if (block == NULL) {
+      break;
+    }
+
+    *(void**)block = tlab->free[c];
+    tlab->free[c] = block;
+    ++tlab->numFree[c];
+  }
+
+  heap_unlock(heap);
+}
+
+// a block from the buffer's list `c`
+static void *heap_tlabTake(heap_t *heap, unsigned c) {
+  heap_tlab_t *tlab = &heap_tlab;
+  void *block;
+
+  if (tlab->heap != heap) {
+    heap_tlabBind(tlab, heap);
+  }
+
+  if (tlab->free[c] == NULL) {
+    heap_tlabRefill(tlab, c);
+
+    // a pool class the heap held none of
+    if (tlab->free[c] == NULL) {
+      return c >= HEAP_TLAB_POOL ? heap_poolAlloc(heap, c - HEAP_TLAB_POOL) : NULL;
+    }
+  }
+
+  block = tlab->free[c];
+  tlab->free[c] = *(void**)block;
+  --tlab->numFree[c];
+
+  return block;
+}
+
+// gives `ptr` back to the buffer's list `c`
+static void heap_tlabGive(heap_t *heap, unsigned c, void *ptr) {
+  heap_tlab_t *tlab = &heap_tlab;
+
+  // another heap's buffer, or a full one: straight back to the pool
+  if (c >= HEAP_TLAB_POOL && (tlab->heap != heap || tlab->numFree[c] >= 2 * HEAP_POOL_BATCH)) {
+    heap_lock(heap);
+    heap_poolPut(heap, c - HEAP_TLAB_POOL, ptr);
+    heap_unlock(heap);
+    return;
+  }
+
+  // or to the slab
+  if (tlab->heap != heap || tlab->numFree[c] >= 2 * HEAP_TLAB_BATCH) {
+    size_t size;
+    slab_allocator_t *slab = heap_tlabSlab(heap, c, &size);
+
+    heap_lock(heap);
+    slab_free(slab, ptr, size);
+    heap_unlock(heap);
+    return;
+  }
+
+  *(void**)ptr = tlab->free[c];
+  tlab->free[c] = ptr;
+  ++tlab->numFree[c];
+}
+
+void *heap_allocBlock(heap_t *heap, size_t size) {
+  unsigned c = slab_classOf(size);
+
+  if (c == SLAB_CLASSES) {
+    unsigned p = heap_poolClassOf(size);
+    void *block;
+
+    if (p != HEAP_POOL_CLASSES) {
+      return heap_tlabTake(heap, HEAP_TLAB_POOL + p);
+    }
+
+    if ((block = malloc(size)) != NULL) {
+      quota_force(heap->slab.quota, size);
+    }
+
+    return block;
+  }
+
+  return heap_tlabTake(heap, c);
+}
+
+void heap_freeBlock(heap_t *heap, void *ptr, size_t size) {
+  unsigned c = slab_classOf(size);
+
+  if (ptr == NULL) {
+    return;
+  }
+
+  if (c == SLAB_CLASSES) {
+    unsigned p = heap_poolClassOf(size);
+
+    if (p != HEAP_POOL_CLASSES) {
+      heap_tlabGive(heap, HEAP_TLAB_POOL + p, ptr);
+      return;
+    }
+
+    free(ptr);
+    quota_credit(heap->slab.quota, size);
+    return;
+  }
+
+  heap_tlabGive(heap, c, ptr);
+}
+
+void heap_flush(heap_t *heap) {
+  heap_tlab_t *tlab = &heap_tlab;
+
+  if (tlab->heap != heap) {
+    return;
+  }
+
+  heap_lock(heap);
+
+  heap_tlabPublish(tlab);
+
+  for (unsigned c = HEAP_TLAB_POOL; c < HEAP_TLAB_LISTS; c++) {
+    while (tlab->free[c] != NULL) {
+      void *block = tlab->free[c];
+
+      tlab->free[c] = *(void**)block;
+      heap_poolPut(heap, c - HEAP_TLAB_POOL, block);
+    }
+
+    tlab->numFree[c] = 0;
+  }
+
+  for (unsigned c = 0; c < HEAP_TLAB_POOL; c++) {
+    size_t size;
+    slab_allocator_t *slab = heap_tlabSlab(heap, c, &size);
+
+    while (tlab->free[c] != NULL) {
+      void *block = tlab->free[c];
+
+      tlab->free[c] = *(void**)block;
+      slab_free(slab, block, size);
+    }
+
+    tlab->numFree[c] = 0;
+  }
+
+  heap_unlock(heap);
+
+  tlab->heap = NULL;
+}
+
+heap_node_t *heap_node_create(heap_t *heap) {
+  heap_node_t *node = (heap_node_t*)heap_tlabTake(heap, HEAP_TLAB_NODES);
   node->hv.ptr = NULL;
-  node->hv.flags = 0;
+  // what is allocated while marking is live for that collection, and
+  // old, so the nursery does not grow with it until the collection ends
+  node->hv.flags = heap->marking ? FLAG_MARKED | FLAG_OLD : 0;
+  node->hv.kind = HEAP_KIND_OBJECT;
+  node->hv.arena = 0;
   node->hv.dtor_ptr = NULL;
   node->prev = NULL;
   node->next = NULL;
   return node;
 }
 
-void heap_node_destroy(runtime_t *rt, heap_node_t *node) {
+void heap_node_destroy(runtime_t *rt, heap_t *heap, heap_node_t *node) {
   if (node->hv.dtor_ptr != NULL) {
     args_t args;
     args._stack = &rt->dt->storage[AT_LOCAL];
+    args._registers = NULL;
     args._rawData = node->hv.ptr; // 'this' object
+    args._operands = NULL;
 
     node->hv.dtor_ptr(rt, &args);
   }
 
-  free(node);
+  // back onto a free list, for the next heap_alloc
+  heap_tlabGive(heap, HEAP_TLAB_NODES, node);
 }
 
 heap_t *heap_create() {
   heap_t *heap = (heap_t*)malloc(sizeof(heap_t));
   heap->head = NULL;
+  heap->young = NULL;
   heap->size = 0;
+  heap->youngSize = 0;
+  slab_init(&heap->slab);
+  slab_init(&heap->nodes);
+
+  for (unsigned p = 0; p < HEAP_POOL_CLASSES; p++) {
+    heap->pool[p] = NULL;
+    heap->numPooled[p] = 0;
+  }
+
+  heap->markStack = NULL;
+  heap->markLen = 0;
+  heap->markSize = 0;
+  heap->minor = false;
+  heap->marking = false;
+  heap->markArray = NULL;
+  heap->markArrayAt = 0;
+  heap->markers = NULL;
+  heap->escaping = false;
+  heap->escapeDepth = 0;
+  heap->escapeBase = 0;
+
+  heap->remembered = NULL;
+  heap->rememberedLen = 0;
+  heap->rememberedSize = 0;
+
+  heap->shapes = shape_createRoot();
+  heap->weak = NULL;
+
+  heap->sweeping = NULL;
+  heap->sweepingYoung = NULL;
+  heap->dead = NULL;
+  heap->deadSize = 0;
+
+  heap->allocated = 0;
+  heap->finalized = 0;
+
+  pthread_mutexattr_t attr;
+  pthread_mutexattr_init(&attr);
+  // sweeping frees objects through heap_freeBlock, with the lock held
+  pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+  pthread_mutex_init(&heap->lock, &attr);
+  pthread_mutexattr_destroy(&attr);
+
   return heap;
 }
 
 void heap_destroy(runtime_t *rt, heap_t *heap) {
+  if (heap->markers != NULL) {
+    heap_markersDestroy(heap->markers);
+  }
+
+  heap_flush(heap);
+
+  // everything is old once the nursery is promoted
+  heap_sweepYoung(rt, heap);
+  heap_finalize(rt, heap);
+
   while (heap->head) {
     heap_node_t *tmp = heap->head;
     heap->head = tmp->prev;
 
-    heap_node_destroy(rt, tmp);
+    heap_node_destroy(rt, heap, tmp);
 
     --heap->size;
   }
+
+  // nodes were freed into this thread's buffer again
+  heap_flush(heap);
+
+  heap_poolRelease(heap);
+  slab_destroy(&heap->slab);
+  slab_destroy(&heap->nodes);
+  free(heap->markStack);
+  free(heap->remembered);
+  shape_destroyTree(heap->shapes);
+  pthread_mutex_destroy(&heap->lock);
+  free(heap);
+}
+
+// destroys the list from `head` through `prev`, returning how many nodes it held
+static size_t heap_destroyList(runtime_t *rt, heap_t *heap, heap_node_t *head) {
+  size_t count = 0;
+
+  while (head != NULL) {
+    heap_node_t *prev = head->prev;
+
+    heap_node_destroy(rt, heap, head);
+    head = prev;
+    ++count;
+  }
+
+  return count;
+}
+
+void heap_clear(runtime_t *rt, heap_t *heap) {
+  size_t count;
+
+  heap_flush(heap);
+  heap_lock(heap);
+
+  // swept earlier, and not finalized yet
+  heap_finalize(rt, heap);
+
+  count = heap_destroyList(rt, heap, heap->young) + heap_destroyList(rt, heap, heap->head);
+  heap->young = NULL;
+  heap->head = NULL;
+  heap->size = 0;
+  heap->youngSize = 0;
+  heap->finalized += count;
+  heap->rememberedLen = 0;
+
+  // a collection under way has nothing left to mark or sweep
+  heap->markLen = 0;
+  heap->marking = false;
+  heap->markArray = NULL;
+  heap->sweeping = NULL;
+  heap->sweepingYoung = NULL;
+
+  heap_unlock(heap);
+
+  // nodes were freed into this thread's buffer
+  heap_flush(heap);
+}
+
+void heap_setQuota(heap_t *heap, quota_t *quota) {
+  heap->slab.quota = quota;
+  heap->nodes.quota = quota;
 }
 
 heap_value_t *heap_alloc(runtime_t *rt, heap_t *heap) {
-  heap_lock();
+  heap_node_t *node = heap_node_create(heap);
+  heap_tlab_t *tlab = &heap_tlab; // bound to `heap` by heap_node_create
 
-  heap_node_t *node = heap_node_create();
+  // the buffered list is ordered like the heap's, newest first
+  node->prev = tlab->newest;
 
-  if (heap->head != NULL) {
-    heap->head->next = node;
+  if (tlab->newest != NULL) {
+    tlab->newest->next = node;
+  } else {
+    tlab->oldest = node;
   }
 
-  // swap
-  node->prev = heap->head;
-  heap->head = node;
+  tlab->newest = node;
+  ++tlab->numNodes;
 
-  ++heap->size;
+  if (events_enabled) {
+    events_instant(EVENTS_ALLOC, 0);
+  }
+
+  return &node->hv;
+}
+
+// a thread's part of a parallel drain, see HEAP_MARK_PARALLEL_MIN
+typedef struct heap_marker {
+  struct heap_markers *markers;
+
+  heap_value_t **stack; // only this marker pushes and pops
+  size_t len;
+  size_t size;
+
+  pthread_mutex_t lock; // guards `shared`
+  heap_value_t **shared; // given up for the others to take
+  atomic_size_t sharedLen;
+  size_t sharedSize;
+
+  uint64_t seed; // for picking a victim to steal from
+  pthread_t thread; // a helper's; the first marker is the collecting thread
+} heap_marker_t;
 
-  heap_unlock();
+typedef struct heap_markers {
+  heap_t *heap;
+  heap_marker_t *all;
+  size_t count;
 
-  return &heap->head->hv;
+  atomic_size_t idle; // markers out of work, the drain ends when it is all of them
+  pthread_mutex_t lock; // for `round`, `running` and `stop`
+  pthread_cond_t cond;
+  uint64_t round; // a drain; helpers start when it changes
+  size_t running; // helpers not done with this round
+  bool stop;
+} heap_markers_t;
+
+// the calling thread's marker, while it takes part in a parallel drain
+static _Thread_local heap_marker_t *heap_markerSelf;
+
+static void heap_push(heap_value_t ***stack, size_t *len, size_t *size, heap_value_t *hv) {
+  if (*len == *size) {
+    // kept between collections, it is freed by heap_destroy
+    *size = *size ? *size * 2 : 64;
+    *stack = (heap_value_t**)realloc(*stack, *size * sizeof(heap_value_t*));
+  }
+
+  (*stack)[(*len)++] = hv;
 }
 
-void heap_sweep(runtime_t *rt, heap_t *heap) {
-  heap_node_t *last = heap->head;
+void heap_mark(heap_t *heap, value_t *value) {
+  heap_marker_t *marker = heap_markerSelf;
+  heap_value_t *hv;
+  uint8_t flags;
+
+  if (value_getType(value) != TYPE_POINTER || !(value_getFlags(value) & FLAG_OBJECT)) {
+    return;
+  }
+
+  hv = value->data.hv;
+
+  if (heap->escaping) {
+    if (hv->arena > heap->escapeDepth) {
+      hv->arena = heap->escapeDepth;
+      heap_push(&heap->markStack, &heap->markLen, &heap->markSize, hv);
+    }
+
+    return;
+  }
+
+  // other markers may be setting them meanwhile
+  flags = marker != NULL ? __atomic_load_n(&hv->flags, __ATOMIC_RELAXED) : hv->flags;
+
+  if (flags & FLAG_MARKED) {
+    return; // already visited, objects may reference each other
+  }
+
+  if (heap->minor && (flags & FLAG_OLD)) {
+    return; // live for a minor collection, see heap_markRemembered
+  }
+
+  if (marker != NULL) {
+    if (__atomic_fetch_or(&hv->flags, FLAG_MARKED, __ATOMIC_RELAXED) & FLAG_MARKED) {
+      return; // another marker got to it first
+    }
+
+    heap_push(&marker->stack, &marker->len, &marker->size, hv);
+    return;
+  }
+
+  hv->flags |= FLAG_MARKED;
+  heap_push(&heap->markStack, &heap->markLen, &heap->markSize, hv);
+}
+
+// heap_mark on everything the node references
+static void heap_trace(heap_t *heap, heap_value_t *hv) {
+  if (hv->ptr == NULL) {
+    return;
+  }
+
+  switch (hv->kind) {
+    case HEAP_KIND_ARRAY:
+      array_mark((array_t*)hv->ptr, heap);
+      break;
+    case HEAP_KIND_MAP:
+      map_mark((map_t*)hv->ptr, heap);
+      break;
+    case HEAP_KIND_CACHE:
+      cache_mark((cache_t*)hv->ptr, heap);
+      break;
+    case HEAP_KIND_STREAM:
+    case HEAP_KIND_AIO:
+    case HEAP_KIND_TASK:
+    case HEAP_KIND_CHANNEL:
+    case HEAP_KIND_SOCKET:
+      break; // holds no values
+    default:
+      object_mark((object_t*)hv->ptr, heap);
+      break;
+  }
+}
+
+// ===== parallel marking =====
+
+static uint64_t heap_markerRandom(heap_marker_t *m) {
+  // xorshift64
+  m->seed ^= m->seed << 13;
+  m->seed ^= m->seed >> 7;
+  m->seed ^= m->seed << 17;
+
+  return m->seed;
+}
+
+// moves the bottom half of the marker's stack to `shared`, unless what it
+// shared before was not taken yet
+static void heap_markerShare(heap_marker_t *m) {
+  size_t n = m->len / 2;
+
+  pthread_mutex_lock(&m->lock);
+
+  if (atomic_load_explicit(&m->sharedLen, memory_order_relaxed) == 0) {
+    if (n > m->sharedSize) {
+      m->sharedSize = n;
+      m->shared = (heap_value_t**)realloc(m->shared, n * sizeof(heap_value_t*));
+    }
+
+    memcpy(m->shared, m->stack, n * sizeof(heap_value_t*));
+    memmove(m->stack, m->stack + n, (m->len - n) * sizeof(heap_value_t*));
+    m->len -= n;
+    atomic_store_explicit(&m->sharedLen, n, memory_order_relaxed);
+  }
+
+  pthread_mutex_unlock(&m->lock);
+}
+
+// moves what `victim` shared onto the stack of `m`, false if there was
+// nothing. an idle marker stops counting as one before it takes anything,
+// so the idle count only reaches all markers once no work is left.
+static bool heap_markerTake(heap_marker_t *m, heap_marker_t *victim, bool idle) {
+  size_t n;
+
+  if (atomic_load_explicit(&victim->sharedLen, memory_order_relaxed) == 0) {
+    return false;
+  }
+
+  pthread_mutex_lock(&victim->lock);
+
+  if ((n = atomic_load_explicit(&victim->sharedLen, memory_order_relaxed)) != 0) {
+    if (idle) {
+      atomic_fetch_sub(&m->markers->idle, 1);
+    }
+
+    for (size_t i = 0; i < n; i++) {
+      heap_push(&m->stack, &m->len, &m->size, victim->shared[i]);
+    }
+
+    atomic_store_explicit(&victim->sharedLen, 0, memory_order_relaxed);
+  }
+
+  pthread_mutex_unlock(&victim->lock);
+
+  return n != 0;
+}
+
+// with `m` idle: steals from random markers until it gets some work, or
+// every marker is idle, false
+static bool heap_markerSteal(heap_marker_t *m) {
+  heap_markers_t *markers = m->markers;
+
+  while (atomic_load(&markers->idle) != markers->count) {
+    for (size_t i = 0; i < markers->count; i++) {
+      heap_marker_t *victim = &markers->all[heap_markerRandom(m) % markers->count];
+
+      if (victim != m && heap_markerTake(m, victim, true)) {
+        return true;
+      }
+    }
+
+    sched_yield();
+  }
+
+  return false;
+}
+
+// traces with `m` until the drain ends
+static void heap_markerRun(heap_marker_t *m) {
+  heap_markers_t *markers = m->markers;
+
+  heap_markerSelf = m;
+
+  do {
+    // what it shared is its own again once its stack is empty
+    while (m->len != 0 || heap_markerTake(m, m, false)) {
+      heap_trace(markers->heap, m->stack[--m->len]);
+
+      if (m->len >= 2 * HEAP_MARK_SHARE && atomic_load_explicit(&markers->idle, memory_order_relaxed) != 0
+          && atomic_load_explicit(&m->sharedLen, memory_order_relaxed) == 0) {
+        heap_markerShare(m);
+      }
+    }
+
+    atomic_fetch_add(&markers->idle, 1);
+  } while (heap_markerSteal(m));
+
+  heap_markerSelf = NULL;
+}
+
+static void *heap_markerThread(void *arg) {
+  heap_marker_t *m = (heap_marker_t*)arg;
+  heap_markers_t *markers = m->markers;
+  uint64_t round = 0;
+
+  pthread_mutex_lock(&markers->lock);
+
+  for (;;) {
+    while (!markers->stop && markers->round == round) {
+      pthread_cond_wait(&markers->cond, &markers->lock);
+    }
+
+    if (markers->stop) {
+      break;
+    }
+
+    round = markers->round;
+    pthread_mutex_unlock(&markers->lock);
+
+    heap_markerRun(m);
+
+    pthread_mutex_lock(&markers->lock);
+
+    if (--markers->running == 0) {
+      pthread_cond_broadcast(&markers->cond);
+    }
+  }
+
+  pthread_mutex_unlock(&markers->lock);
+
+  return NULL;
+}
+
+// BB8_GC_MARKERS, or the number of online cpus up to HEAP_MAX_MARKERS
+static size_t heap_markerCount() {
+  const char *env = getenv("BB8_GC_MARKERS");
+  long count = sysconf(_SC_NPROCESSORS_ONLN);
+
+  if (env != NULL && env[0] != '\0') {
+    count = strtol(env, NULL, 10);
+  } else if (count > HEAP_MAX_MARKERS) {
+    count = HEAP_MAX_MARKERS;
+  }
+
+  return count < 1 ? 1 : (size_t)count;
+}
+
+// starts the helpers; with a single marker there are none, and
+// heap_markDrain stays serial
+static heap_markers_t *heap_markersCreate(heap_t *heap) {
+  heap_markers_t *markers = (heap_markers_t*)malloc(sizeof(heap_markers_t));
+
+  markers->heap = heap;
+  markers->count = heap_markerCount();
+  markers->all = (heap_marker_t*)calloc(markers->count, sizeof(heap_marker_t));
+
+  atomic_init(&markers->idle, 0);
+  pthread_mutex_init(&markers->lock, NULL);
+  pthread_cond_init(&markers->cond, NULL);
+  markers->round = 0;
+  markers->running = 0;
+  markers->stop = false;
+
+  for (size_t i = 0; i < markers->count; i++) {
+    heap_marker_t *m = &markers->all[i];
+
+    m->markers = markers;
+    m->seed = 0x9E3779B97F4A7C15ull * (i + 1);
+    atomic_init(&m->sharedLen, 0);
+    pthread_mutex_init(&m->lock, NULL);
+  }
+
+  for (size_t i = 1; i < markers->count; i++) {
+    pthread_create(&markers->all[i].thread, NULL, heap_markerThread, (void*)&markers->all[i]);
+  }
+
+  return markers;
+}
+
+static void heap_markersDestroy(heap_markers_t *markers) {
+  pthread_mutex_lock(&markers->lock);
+  markers->stop = true;
+  pthread_cond_broadcast(&markers->cond);
+  pthread_mutex_unlock(&markers->lock);
+
+  for (size_t i = 0; i < markers->count; i++) {
+    heap_marker_t *m = &markers->all[i];
+
+    if (i != 0) {
+      pthread_join(m->thread, NULL);
+    }
+
+    free(m->stack);
+    free(m->shared);
+    pthread_mutex_destroy(&m->lock);
+  }
+
+  pthread_mutex_destroy(&markers->lock);
+  pthread_cond_destroy(&markers->cond);
+  free(markers->all);
+  free(markers);
+}
+
+void heap_afterFork(heap_t *heap) {
+  heap_markers_t *markers = heap->markers;
+
+  if (markers == NULL) {
+    return;
+  }
+
+  // nothing to join: only the forking thread is left
+  for (size_t i = 0; i < markers->count; i++) {
+    free(markers->all[i].stack);
+    free(markers->all[i].shared);
+  }
+
+  free(markers->all);
+  free(markers);
+  heap->markers = NULL;
+}
+
+// heap_markDrain on every marker: the mark stack is dealt out between
+// them, as if each had shared a part, and the helpers are released
+static void heap_markParallel(heap_t *heap) {
+  heap_markers_t *markers = heap->markers;
+
+  for (size_t i = 0; i < heap->markLen; i++) {
+    heap_marker_t *m = &markers->all[i % markers->count];
+    size_t n = atomic_load_explicit(&m->sharedLen, memory_order_relaxed);
+
+    heap_push(&m->shared, &n, &m->sharedSize, heap->markStack[i]);
+    atomic_store_explicit(&m->sharedLen, n, memory_order_relaxed);
+  }
+
+  heap->markLen = 0;
+  atomic_store(&markers->idle, 0);
+
+  pthread_mutex_lock(&markers->lock);
+  ++markers->round;
+  markers->running = markers->count - 1;
+  pthread_cond_broadcast(&markers->cond);
+  pthread_mutex_unlock(&markers->lock);
+
+  heap_markerRun(&markers->all[0]);
+
+  // the marks they set are seen once they are done
+  pthread_mutex_lock(&markers->lock);
+
+  while (markers->running != 0) {
+    pthread_cond_wait(&markers->cond, &markers->lock);
+  }
+
+  pthread_mutex_unlock(&markers->lock);
+}
+
+void heap_markDrain(heap_t *heap) {
+  if (heap->escaping) {
+    while (heap->markLen > heap->escapeBase) {
+      heap_trace(heap, heap->markStack[--heap->markLen]);
+    }
+
+    return;
+  }
+
+  if (heap->marking) {
+    return; // left to heap_markStep
+  }
+
+  if (heap->markLen != 0 && (heap->minor ? heap->youngSize : heap->size) >= HEAP_MARK_PARALLEL_MIN) {
+    if (heap->markers == NULL) {
+      heap->markers = heap_markersCreate(heap);
+    }
+
+    if (heap->markers->count > 1) {
+      heap_markParallel(heap);
+      return;
+    }
+  }
+
+  while (heap->markLen != 0) {
+    heap_trace(heap, heap->markStack[--heap->markLen]);
+  }
+}
+
+// moves `node` from the list `*head` onto the dead list
+static void heap_unlink(heap_t *heap, heap_node_t **head, heap_node_t *node) {
+  heap_node_t *prev = node->prev;
+  heap_node_t *next = node->next;
+
+  if (prev) {
+    prev->next = next;
+  }
+
+  if (next) {
+    // removing an item from the middle, so
+    // make the nodes to the other sides now
+    // point to each other
+    next->prev = prev;
+  } else {
+    // since there are no nodes after this,
+    // set the head to be this node here
+    *head = prev;
+  }
+
+  node->prev = heap->dead;
+  heap->dead = node;
+  ++heap->deadSize;
+
+  --heap->size;
+}
+
+// unlinks the nodes in `*head` that are not marked onto the dead list;
+// the rest are unmarked and become old. returns the oldest survivor, NULL
+// if there is none.
+static heap_node_t *heap_sweepList(runtime_t *rt, heap_t *heap, heap_node_t **head, size_t *count) {
+  heap_node_t *last = *head;
+  heap_node_t *oldest = NULL;
 
   while (last) {
+    heap_node_t *prev = last->prev;
+
     if (last->hv.flags & FLAG_MARKED) {
       // unmark
       last->hv.flags &= ~FLAG_MARKED;
-      last = last->prev;
+      last->hv.flags |= FLAG_OLD;
+      oldest = last;
+    } else {
+      heap_unlink(heap, head, last);
+      --*count;
+    }
+
+    last = prev;
+  }
+
+  return oldest;
+}
+
+// every remembered object is old, so only a full sweep can free one;
+// the flags are cleared before that happens
+static void heap_forgetRemembered(heap_t *heap) {
+  for (size_t i = 0; i < heap->rememberedLen; i++) {
+    heap->remembered[i]->flags &= ~FLAG_REMEMBERED;
+  }
+
+  heap->rememberedLen = 0;
+}
+
+void heap_sweep(runtime_t *rt, heap_t *heap) {
+  size_t oldSize = heap->size - heap->youngSize;
+
+  cache_sweep(rt, heap);
+  heap_forgetRemembered(heap);
+  heap_sweepList(rt, heap, &heap->head, &oldSize);
+  heap_sweepYoung(rt, heap);
+}
+
+void heap_markBegin(heap_t *heap) {
+  heap->marking = true;
+}
+
+// the next HEAP_MARK_CHUNK values of the array heap_markStep is tracing.
+// arrays only grow, and what is stored meanwhile is marked by the barrier.
+static void heap_markChunk(heap_t *heap) {
+  array_t *array = (array_t*)heap->markArray->ptr;
+  value_t *values = (value_t*)array->data;
+  size_t end = heap->markArrayAt + HEAP_MARK_CHUNK;
+
+  if (end >= array->size) {
+    end = array->size;
+    heap->markArray = NULL;
+  }
+
+  for (size_t i = heap->markArrayAt; i < end; i++) {
+    heap_mark(heap, &values[i]);
+  }
+
+  heap->markArrayAt = end;
+}
+
+bool heap_markStep(heap_t *heap, size_t count) {
+  for (; count != 0; count--) {
+    heap_value_t *hv;
+
+    if (heap->markArray != NULL) {
+      heap_markChunk(heap);
       continue;
     }
 
-    // not marked; delete
-    heap_node_t *prev = last->prev;
-    heap_node_t *next = last->next;
+    if (heap->markLen == 0) {
+      break;
+    }
 
-    if (prev) {
-      prev->next = next;
+    hv = heap->markStack[--heap->markLen];
+
+    if (hv->kind == HEAP_KIND_ARRAY && hv->ptr != NULL && ((array_t*)hv->ptr)->kind == ARRAY_VALUES
+        && ((array_t*)hv->ptr)->size > HEAP_MARK_CHUNK) {
+      heap->markArray = hv;
+      heap->markArrayAt = 0;
+      continue;
     }
 
-    if (next) {
-      // removing an item from the middle, so
-      // make the nodes to the other sides now
-      // point to each other
-      next->prev = prev;
+    heap_trace(heap, hv);
+  }
+
+  return heap->markLen != 0 || heap->markArray != NULL;
+}
+
+void heap_markEnd(heap_t *heap) {
+  // traced whole by the drain, the part done already again
+  if (heap->markArray != NULL) {
+    heap_push(&heap->markStack, &heap->markLen, &heap->markSize, heap->markArray);
+    heap->markArray = NULL;
+  }
+
+  heap->marking = false;
+}
+
+void heap_shade(heap_t *heap, value_t *value) {
+  if (value_getType(value) != TYPE_POINTER || !(value_getFlags(value) & FLAG_OBJECT)
+      || (value->data.hv->flags & FLAG_MARKED)) {
+    return;
+  }
+
+  heap_lock(heap);
+
+  // the collector may have ended marking in the meantime
+  if (heap->marking) {
+    heap_mark(heap, value);
+  }
+
+  heap_unlock(heap);
+}
+
+void heap_sweepBegin(runtime_t *rt, heap_t *heap) {
+  size_t kept = 0;
+
+  cache_sweep(rt, heap);
+
+  // the nursery stays, and so does what the live old objects remember of it
+  for (size_t i = 0; i < heap->rememberedLen; i++) {
+    heap_value_t *owner = heap->remembered[i];
+
+    if (owner->flags & FLAG_MARKED) {
+      heap->remembered[kept++] = owner;
     } else {
-      // since there are no nodes after this,
-      // set the head to be this node here
-      heap->head = prev;
+      owner->flags &= ~FLAG_REMEMBERED;
     }
+  }
 
-    heap_node_destroy(rt, last);
-    last = prev;
+  heap->rememberedLen = kept;
+  heap->sweeping = heap->head;
+  heap->sweepingYoung = heap->young;
+}
 
-    --heap->size;
+// heap_sweepStep on the list `*head`, from `*from`
+static size_t heap_sweepFrom(heap_t *heap, heap_node_t **head, heap_node_t **from, size_t *count, size_t budget) {
+  heap_node_t *node = *from;
+
+  for (; node != NULL && budget != 0; budget--) {
+    heap_node_t *prev = node->prev;
+
+    if (node->hv.flags & FLAG_MARKED) {
+      node->hv.flags &= ~FLAG_MARKED;
+    } else {
+      heap_unlink(heap, head, node);
+      --*count;
+    }
+
+    node = prev;
+  }
+
+  *from = node;
+
+  return budget;
+}
+
+bool heap_sweepStep(runtime_t *rt, heap_t *heap, size_t count) {
+  size_t oldSize = heap->size - heap->youngSize;
+
+  // nodes allocated since are newer than either, and not marked
+  count = heap_sweepFrom(heap, &heap->head, &heap->sweeping, &oldSize, count);
+  heap_sweepFrom(heap, &heap->young, &heap->sweepingYoung, &heap->youngSize, count);
+
+  return heap->sweeping != NULL || heap->sweepingYoung != NULL;
+}
+
+void heap_finalize(runtime_t *rt, heap_t *heap) {
+  for (;;) {
+    heap_node_t *batch, *last;
+    size_t n = 1;
+
+    heap_lock(heap);
+
+    if ((batch = heap->dead) == NULL) {
+      heap_unlock(heap);
+      break;
+    }
+
+    for (last = batch; n < HEAP_FINALIZE_BATCH && last->prev != NULL; last = last->prev) {
+      ++n;
+    }
+
+    heap->dead = last->prev;
+    heap->deadSize -= n;
+    heap->finalized += n;
+    last->prev = NULL;
+
+    heap_unlock(heap);
+
+    while (batch != NULL) {
+      heap_node_t *next = batch->prev;
+
+      heap_node_destroy(rt, heap, batch);
+      batch = next;
+    }
+  }
+}
+
+bool heap_shouldCompact(heap_t *heap) {
+  return heap->slab.numSlabs >= HEAP_COMPACT_MIN_SLABS
+    && slab_freePercent(&heap->slab) >= HEAP_COMPACT_FREE_PERCENT;
+}
+
+void *heap_relocateBlock(heap_t *heap, void *ptr, size_t size) {
+  void *moved;
+
+  if (!slab_isEvacuating(ptr, size) || (moved = slab_alloc(&heap->slab, size)) == NULL) {
+    return ptr;
+  }
+
+  memcpy(moved, ptr, size);
+  slab_free(&heap->slab, ptr, size);
+
+  return moved;
+}
+
+size_t heap_compact(heap_t *heap) {
+  heap_node_t *node = heap->head;
+  size_t moved = 0;
+
+  // whether or not anything moves
+  heap_poolRelease(heap);
+
+  if (!heap_shouldCompact(heap)) {
+    return 0;
+  }
+
+  slab_beginEvacuation(&heap->slab);
+
+  // from the oldest, so the objects end up in the order they were allocated.
+  // the nursery is empty after a full sweep.
+  while (node != NULL && node->prev != NULL) {
+    node = node->prev;
+  }
+
+  for (; node != NULL; node = node->next) {
+    heap_value_t *hv = &node->hv;
+    object_t *object;
+
+    if (hv->kind != HEAP_KIND_OBJECT || hv->ptr == NULL) {
+      continue;
+    }
+
+    object = object_relocate((object_t*)hv->ptr);
+    moved += object != hv->ptr;
+    hv->ptr = object;
+  }
+
+  if (slab_endEvacuation(&heap->slab) != 0) {
+#ifdef __GLIBC__
+    // the freed slabs are in the middle of the malloc heap, more often than not
+    malloc_trim(0);
+#endif
+  }
+
+  return moved;
+}
+
+void heap_markRemembered(heap_t *heap) {
+  heap->minor = true;
+
+  for (size_t i = 0; i < heap->rememberedLen; i++) {
+    heap_trace(heap, heap->remembered[i]);
+  }
+}
+
+void heap_sweepYoung(runtime_t *rt, heap_t *heap) {
+  heap_node_t *oldest;
+
+  // a full sweep dropped the weak entries before the old nodes
+  if (heap->minor) {
+    cache_sweep(rt, heap);
+  }
+
+  heap_forgetRemembered(heap);
+  oldest = heap_sweepList(rt, heap, &heap->young, &heap->youngSize);
+
+  // what is left of the nursery is promoted, its nodes are newer than any old one
+  if (oldest != NULL) {
+    heap_splice(&heap->head, heap->young, oldest);
+  }
+
+  heap->young = NULL;
+  heap->youngSize = 0;
+  heap->minor = false;
+}
+
+void heap_writeBarrier(heap_t *heap, heap_value_t *owner, value_t *value) {
+  if (heap->marking) {
+    heap_shade(heap, value);
+  }
+
+  if (value_getType(value) != TYPE_POINTER || !(value_getFlags(value) & FLAG_OBJECT)) {
+    return;
+  }
+
+  if (value->data.hv->arena > owner->arena) {
+    heap_lock(heap);
+    heap_escapeBegin(heap, owner->arena);
+    heap_mark(heap, value);
+    heap_escapeEnd(heap);
+    heap_unlock(heap);
+  }
+
+  if (!(owner->flags & FLAG_OLD) || (owner->flags & FLAG_REMEMBERED) || (value->data.hv->flags & FLAG_OLD)) {
+    return;
   }
+
+  heap_lock(heap);
+
+  // another thread may have remembered it in the meantime
+  if (!(owner->flags & FLAG_REMEMBERED)) {
+    if (heap->rememberedLen == heap->rememberedSize) {
+      heap->rememberedSize = heap->rememberedSize ? heap->rememberedSize * 2 : 64;
+      heap->remembered = (heap_value_t**)realloc(heap->remembered, heap->rememberedSize * sizeof(heap_value_t*));
+    }
+
+    owner->flags |= FLAG_REMEMBERED;
+    heap->remembered[heap->rememberedLen++] = owner;
+  }
+
+  heap_unlock(heap);
+}
+
+void heap_escapeBegin(heap_t *heap, uint8_t depth) {
+  heap->escaping = true;
+  heap->escapeDepth = depth;
+  heap->escapeBase = heap->markLen;
+}
+
+void heap_escapeEnd(heap_t *heap) {
+  heap_markDrain(heap);
+  heap->escaping = false;
 }
 
-// TODO: make heap lock()/unlock() per heap so we can have multiple
+void heap_adopt(heap_t *heap, heap_node_t *node) {
+  node->next = NULL;
+  heap_splice(&heap->young, node, node);
+
+  ++heap->youngSize;
+  ++heap->size;
+  ++heap->allocated;
+}
 
-void heap_lock() {
-  pthread_mutex_lock(&heapMutex);
+void heap_lock(heap_t *heap) {
+  pthread_mutex_lock(&heap->lock);
 }
 
-void heap_unlock() {
-  pthread_mutex_unlock(&heapMutex);
+void heap_unlock(heap_t *heap) {
+  pthread_mutex_unlock(&heap->lock);
 }
@@ -0,0 +1,480 @@
+#include <vm/image.h>
+#include <vm/lz4.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static bool image_isContainer(const ubyte_t *file, size_t len) {
+  return len >= BIN_MAGIC_SIZE && memcmp(file, BIN_MAGIC, BIN_MAGIC_SIZE) == 0;
+}
+
+// the blocks of a BIN_CODE_LZ4 section, one at a time into the one buffer
+// for the code: the compressed bytes are read once, in order, from the file
+static bool image_decompressCode(const ubyte_t *data, size_t size, image_t *out, const char **error) {
+  uint64_t codeLen;
+  size_t pos = sizeof(codeLen), done = 0;
+
+  if (size < sizeof(codeLen)) {
+    *error = "truncated code";
+    return false;
+  }
+
+  memcpy(&codeLen, data, sizeof(codeLen));
+
+  // every block is at least its header
+  if (codeLen / BIN_LZ4_BLOCK_SIZE > size / sizeof(uint32_t)) {
+    *error = "truncated code";
+    return false;
+  }
+
+  out->codeBuffer = (ubyte_t*)malloc(codeLen != 0 ? codeLen : 1);
+
+  while (done < codeLen) {
+    size_t blockLen = codeLen - done < BIN_LZ4_BLOCK_SIZE ? codeLen - done : BIN_LZ4_BLOCK_SIZE;
+    size_t written = 0;
+    uint32_t header, n;
+
+    if (size - pos < sizeof(header)) {
+      *error = "truncated code";
+      return false;
+    }
+
+    memcpy(&header, data + pos, sizeof(header));
+    pos += sizeof(header);
+    n = header & ~BIN_LZ4_STORED;
+
+    if (n > size - pos) {
+      *error = "truncated code";
+      return false;
+    }
+
+    if (header & BIN_LZ4_STORED) {
+      if (n != blockLen) {
+        *error = "malformed code block";
+        return false;
+      }
+
+      memcpy(out->codeBuffer + done, data + pos, n);
+      written = n;
+    } else if (!lz4_decompressBlock(data + pos, n, out->codeBuffer + done, blockLen, &written)
+               || written != blockLen) {
+      *error = "malformed code block";
+      return false;
+    }
+
+    pos += n;
+    done += written;
+  }
+
+  out->code = out->codeBuffer;
+  out->codeLen = codeLen;
+
+  return true;
+}
+
+bool image_open(const ubyte_t *file, size_t len, image_t *out, const char **error) {
+  bin_header_t header;
+
+  memset(out, 0, sizeof(image_t));
+  out->file = file;
+  out->fileLen = len;
+
+  if (!image_isContainer(file, len)) {
+    out->code = file;
+    out->codeLen = len;
+
+    return true;
+  }
+
+  if (len < sizeof(header)) {
+    *error = "truncated header";
+    return false;
+  }
+
+  memcpy(&header, file, sizeof(header));
+
+  if (header.version == 0 || header.version > BIN_VERSION) {
+    *error = "unsupported version";
+    return false;
+  }
+
+  if ((len - sizeof(header)) / sizeof(bin_section_t) < header.numSections) {
+    *error = "truncated section table";
+    return false;
+  }
+
+  for (uint16_t i = 0; i < header.numSections; i++) {
+    bin_section_t s;
+    const ubyte_t *data;
+
+    memcpy(&s, file + sizeof(header) + i * sizeof(bin_section_t), sizeof(s));
+
+    if (s.offset > len || s.size > len - s.offset) {
+      *error = "section out of range";
+      image_close(out);
+      return false;
+    }
+
+    data = file + s.offset;
+
+    switch (s.kind) {
+      case BIN_SECTION_CODE:
+        // a version 1 section has 0 there
+        out->compact = (s.flags & BIN_CODE_COMPACT) != 0;
+
+        // a later code section replaces an earlier one
+        image_close(out);
+
+        if (!(s.flags & BIN_CODE_LZ4)) {
+          out->code = data;
+          out->codeLen = s.size;
+        } else if (!image_decompressCode(data, s.size, out, error)) {
+          image_close(out);
+          return false;
+        }
+        break;
+      case BIN_SECTION_CONST:
+        out->constants = data;
+        out->constantsLen = s.size;
+        out->constantsInPlace = (s.flags & BIN_CONST_IN_PLACE) != 0;
+        break;
+      case BIN_SECTION_DATA:
+        out->data = data;
+        out->numData = s.size / sizeof(bin_data_t);
+        break;
+      case BIN_SECTION_LABELS:
+        out->labels = data;
+        out->numLabels = s.size / sizeof(bin_label_t);
+        break;
+      case BIN_SECTION_DEBUG:
+        out->debug = data;
+        out->debugLen = s.size;
+        break;
+      case BIN_SECTION_SEGMENTS:
+        out->segments = data;
+        out->numSegments = s.size / sizeof(bin_segment_t);
+        break;
+      case BIN_SECTION_SITES:
+        out->sites = data;
+        out->numSites = s.size / sizeof(bin_site_t);
+        break;
+      case BIN_SECTION_LINES:
+        out->lines = data;
+        out->linesLen = s.size;
+        break;
+      case BIN_SECTION_SYMBOLS:
+        out->symbols = data;
+        out->symbolsLen = s.size;
+        break;
+      case BIN_SECTION_IMPORTS:
+        out->imports = data;
+        out->importsLen = s.size;
+        break;
+      case BIN_SECTION_TRIES:
+        out->tries = data;
+        out->numTries = s.size / sizeof(bin_try_t);
+        break;
+    }
+  }
+
+  return true;
+}
+
+void image_close(image_t *image) {
+  free(image->codeBuffer);
+  image->codeBuffer = NULL;
+}
+
+bin_data_t image_data(const image_t *image, size_t i) {
+  bin_data_t entry;
+
+  memcpy(&entry, image->data + i * sizeof(bin_data_t), sizeof(entry));
+
+  return entry;
+}
+
+bin_label_t image_label(const image_t *image, size_t i) {
+  bin_label_t entry;
+
+  memcpy(&entry, image->labels + i * sizeof(bin_label_t), sizeof(entry));
+
+  return entry;
+}
+
+bool image_debugLabel(const image_t *image, size_t *pos, uint64_t *offset, const char **name, uint32_t *nameLen) {
+  uint32_t len;
+
+  if (image->debug == NULL || *pos + sizeof(*offset) + sizeof(len) > image->debugLen) {
+    return false;
+  }
+
+  memcpy(offset, image->debug + *pos, sizeof(*offset));
+  memcpy(&len, image->debug + *pos + sizeof(*offset), sizeof(len));
+
+  if (len > image->debugLen - *pos - sizeof(*offset) - sizeof(len)) {
+    return false;
+  }
+
+  *name = (const char*)image->debug + *pos + sizeof(*offset) + sizeof(len);
+  *nameLen = len;
+  *pos += sizeof(*offset) + sizeof(len) + len;
+
+  return true;
+}
+
+bool image_symbol(const image_t *image, size_t *pos, bin_symbol_t *entry, const char **name) {
+  if (image->symbols == NULL || *pos + sizeof(*entry) > image->symbolsLen) {
+    return false;
+  }
+
+  memcpy(entry, image->symbols + *pos, sizeof(*entry));
+
+  if (entry->nameLength > image->symbolsLen - *pos - sizeof(*entry)) {
+    return false;
+  }
+
+  *name = (const char*)image->symbols + *pos + sizeof(*entry);
+  *pos += sizeof(*entry) + entry->nameLength;
+
+  return true;
+}
+
+bool image_import(const image_t *image, size_t *pos, bin_import_t *entry, const char **module, const char **name,
+    const char **signature) {
+  size_t len;
+
+  if (image->imports == NULL || *pos + sizeof(*entry) > image->importsLen) {
+    return false;
+  }
+
+  memcpy(entry, image->imports + *pos, sizeof(*entry));
+  len = (size_t)entry->moduleLength + entry->nameLength + entry->signatureLength;
+
+  if (len > image->importsLen - *pos - sizeof(*entry)) {
+    return false;
+  }
+
+  *module = (const char*)image->imports + *pos + sizeof(*entry);
+  *name = *module + entry->moduleLength;
+  *signature = *name + entry->nameLength;
+  *pos += sizeof(*entry) + len;
+
+  return true;
+}
+
+bin_segment_t image_segment(const image_t *image, size_t i) {
+  bin_segment_t entry;
+
+  memcpy(&entry, image->segments + i * sizeof(bin_segment_t), sizeof(entry));
+
+  return entry;
+}
+
+bin_site_t image_site(const image_t *image, size_t i) {
+  bin_site_t entry;
+
+  memcpy(&entry, image->sites + i * sizeof(bin_site_t), sizeof(entry));
+
+  return entry;
+}
+
+bin_try_t image_try(const image_t *image, size_t i) {
+  bin_try_t entry;
+
+  memcpy(&entry, image->tries + i * sizeof(bin_try_t), sizeof(entry));
+
+  return entry;
+}
+
+bool image_findTry(const image_t *image, uint64_t offset, bin_try_t *out) {
+  for (size_t i = 0; i < image->numTries; i++) {
+    *out = image_try(image, i);
+
+    if (out->start < offset && offset <= out->end) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// the NUL terminated string at `offset` into the strings of a lines
+// section, or NULL if it runs past them
+static const char *image_traceString(const ubyte_t *strings, size_t len, uint32_t offset) {
+  if (offset >= len || memchr(strings + offset, '\0', len - offset) == NULL) {
+    return NULL;
+  }
+
+  return (const char*)strings + offset;
+}
+
+// a lines section, split into its tables
+typedef struct image_lines {
+  bin_lines_t header;
+  const ubyte_t *ranges;
+  const ubyte_t *traces;
+  const ubyte_t *strings;
+  size_t stringsLen;
+} image_lines_t;
+
+// false without a lines section, or with one too short for its tables
+static bool image_openLines(const image_t *image, image_lines_t *out) {
+  bin_lines_t header;
+
+  if (image->lines == NULL || image->linesLen < sizeof(header)) {
+    return false;
+  }
+
+  memcpy(&header, image->lines, sizeof(header));
+
+  if ((image->linesLen - sizeof(header)) / sizeof(bin_line_t) < header.numRanges
+      || (image->linesLen - sizeof(header) - header.numRanges * sizeof(bin_line_t)) / sizeof(bin_trace_t) < header.numTraces) {
+    return false;
+  }
+
+  out->header = header;
+  out->ranges = image->lines + sizeof(header);
+  out->traces = out->ranges + header.numRanges * sizeof(bin_line_t);
+  out->strings = out->traces + header.numTraces * sizeof(bin_trace_t);
+  out->stringsLen = image->linesLen - (size_t)(out->strings - image->lines);
+
+  return true;
+}
+
+// the trace of the code at `offset`, the one of the last range starting
+// at or before it; numTraces or more for none
+static uint32_t image_traceAt(const image_lines_t *lines, uint64_t offset) {
+  size_t lo = 0, hi = lines->header.numRanges;
+  bin_line_t range;
+
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+
+    memcpy(&range, lines->ranges + mid * sizeof(bin_line_t), sizeof(range));
+
+    if (range.offset <= offset) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  if (lo == 0) {
+    return BIN_LINE_UNKNOWN;
+  }
+
+  memcpy(&range, lines->ranges + (lo - 1) * sizeof(bin_line_t), sizeof(range));
+
+  return range.trace;
+}
+
+// the trace at `index`, with its strings. false past the last one, or
+// if its strings are not in the section.
+static bool image_trace(const image_lines_t *lines, uint32_t index, bin_trace_t *trace,
+  const char **file, const char **directive) {
+  if (index >= lines->header.numTraces) {
+    return false;
+  }
+
+  memcpy(trace, lines->traces + index * sizeof(bin_trace_t), sizeof(*trace));
+
+  return (*file = image_traceString(lines->strings, lines->stringsLen, trace->file)) != NULL
+    && (*directive = image_traceString(lines->strings, lines->stringsLen, trace->directive)) != NULL;
+}
+
+size_t image_formatSource(const image_t *image, uint64_t offset, char *buf, size_t size) {
+  image_lines_t lines;
+  size_t len = 0;
+  uint32_t index, depth = 0;
+  bin_trace_t trace;
+  const char *file, *directive;
+
+  if (size != 0) {
+    buf[0] = '\0';
+  }
+
+  if (!image_openLines(image, &lines)) {
+    return 0;
+  }
+
+  index = image_traceAt(&lines, offset);
+
+  // a chain holds each trace at most once, unless the section is broken
+  while (depth++ < lines.header.numTraces && image_trace(&lines, index, &trace, &file, &directive)) {
+    int n;
+
+    if (depth == 1) {
+      n = snprintf(buf + len, size - len, "%s:%u:%u", file, trace.line, trace.column);
+    } else if (*directive != '\0') {
+      n = snprintf(buf + len, size - len, ", from @%s at %s:%u:%u", directive, file, trace.line, trace.column);
+    } else {
+      n = snprintf(buf + len, size - len, ", from %s:%u:%u", file, trace.line, trace.column);
+    }
+
+    if (n < 0 || (size_t)n >= size - len) {
+      return size == 0 ? 0 : size - 1;
+    }
+
+    len += (size_t)n;
+    index = trace.caller - 1; // 0, for none, wraps around past the end
+  }
+
+  return len;
+}
+
+size_t image_formatSourceFrames(const image_t *image, uint64_t offset, char *buf, size_t size) {
+  image_lines_t lines;
+  uint32_t chain[IMAGE_MAX_FRAMES];
+  size_t len = 0, depth = 0;
+  uint32_t index;
+  bin_trace_t trace;
+  const char *file, *directive;
+
+  if (size != 0) {
+    buf[0] = '\0';
+  }
+
+  if (!image_openLines(image, &lines)) {
+    return 0;
+  }
+
+  // innermost first, as the callers link them
+  for (index = image_traceAt(&lines, offset);
+       depth < IMAGE_MAX_FRAMES && depth < lines.header.numTraces && image_trace(&lines, index, &trace, &file, &directive);
+       index = trace.caller - 1) {
+    chain[depth++] = index;
+  }
+
+  while (depth-- > 0) {
+    int n;
+
+    image_trace(&lines, chain[depth], &trace, &file, &directive);
+
+    n = snprintf(buf + len, size - len, *directive != '\0' ? "%s@%s %s:%u" : "%s%s%s:%u",
+      len == 0 ? "" : ";", directive, file, trace.line);
+
+    if (n < 0 || (size_t)n >= size - len) {
+      return size == 0 ? 0 : size - 1;
+    }
+
+    len += (size_t)n;
+  }
+
+  return len;
+}
+
+bool image_sourceLine(const image_t *image, uint64_t offset, const char **file, uint32_t *line) {
+  image_lines_t lines;
+  bin_trace_t trace;
+  const char *traceFile, *directive;
+
+  if (!image_openLines(image, &lines) || !image_trace(&lines, image_traceAt(&lines, offset), &trace, &traceFile, &directive)) {
+    return false;
+  }
+
+  *file = traceFile;
+  *line = trace.line;
+
+  return true;
+}
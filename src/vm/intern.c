@@ -0,0 +1,131 @@
+#include <vm/intern.h>
+#include <vm/util.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+void intern_init(intern_table_t *table) {
+  table->entries = (intern_entry_t*)calloc(INTERN_INITIAL_SIZE, sizeof(intern_entry_t));
+  table->tableSize = INTERN_INITIAL_SIZE;
+  table->size = 0;
+  atomic_init(&table->numChunks, 0);
+  table->chunkUsed = 0;
+}
+
+void intern_destroy(intern_table_t *table) {
+  size_t numChunks = atomic_load(&table->numChunks);
+
+  for (size_t i = 0; i < table->tableSize; i++) {
+    if (!table->entries[i].chunked) {
+      free((void*)table->entries[i].str);
+    }
+  }
+
+  for (size_t i = 0; i < numChunks; i++) {
+    free(table->chunks[i]);
+  }
+
+  atomic_store(&table->numChunks, 0);
+  table->chunkUsed = 0;
+  free(table->entries);
+  table->entries = NULL;
+  table->tableSize = 0;
+  table->size = 0;
+}
+
+// the entry holding `str`, or the free one it would go into
+static intern_entry_t *intern_find(intern_entry_t *entries, size_t tableSize, uint64_t hash,
+                                   const char *str, size_t len) {
+  size_t mask = tableSize - 1;
+
+  for (size_t i = hash & mask; ; i = (i + 1) & mask) {
+    intern_entry_t *e = &entries[i];
+
+    if (e->str == NULL
+        || (e->hash == hash && e->len == len && memcmp(e->str, str, len) == 0)) {
+      return e;
+    }
+  }
+}
+
+// doubles the table, keeping it at most half full
+static void intern_grow(intern_table_t *table) {
+  size_t tableSize = table->tableSize * 2;
+  intern_entry_t *entries = (intern_entry_t*)calloc(tableSize, sizeof(intern_entry_t));
+
+  for (size_t i = 0; i < table->tableSize; i++) {
+    intern_entry_t *e = &table->entries[i];
+
+    if (e->str != NULL) {
+      *intern_find(entries, tableSize, e->hash, e->str, e->len) = *e;
+    }
+  }
+
+  free(table->entries);
+  table->entries = entries;
+  table->tableSize = tableSize;
+}
+
+// `size` bytes from the last chunk, or a new one; NULL past the last
+static char *intern_carve(intern_table_t *table, size_t size) {
+  size_t numChunks = atomic_load_explicit(&table->numChunks, memory_order_relaxed);
+  char *copy;
+
+  if (numChunks == 0 || table->chunkUsed + size > INTERN_CHUNK_SIZE) {
+    if (numChunks == INTERN_MAX_CHUNKS) {
+      return NULL;
+    }
+
+    table->chunks[numChunks] = (char*)malloc(INTERN_CHUNK_SIZE);
+    table->chunkUsed = 0;
+    atomic_store_explicit(&table->numChunks, ++numChunks, memory_order_release);
+  }
+
+  copy = table->chunks[numChunks - 1] + table->chunkUsed;
+  table->chunkUsed += size;
+
+  return copy;
+}
+
+bool intern_owns(const intern_table_t *table, const char *str) {
+  size_t numChunks = atomic_load_explicit(&table->numChunks, memory_order_acquire);
+
+  for (size_t i = numChunks; i-- > 0;) {
+    if (str >= table->chunks[i] && str < table->chunks[i] + INTERN_CHUNK_SIZE) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+const char *intern_get(intern_table_t *table, const char *str, size_t len) {
+  uint64_t hash = hashString64(str, len);
+  intern_entry_t *e = intern_find(table->entries, table->tableSize, hash, str, len);
+  char *copy;
+
+  if (e->str != NULL) {
+    return e->str;
+  }
+
+  if (table->size + 1 > table->tableSize / 2) {
+    intern_grow(table);
+    e = intern_find(table->entries, table->tableSize, hash, str, len);
+  }
+
+  e->chunked = len + 1 <= INTERN_CHUNKED_MAX && (copy = intern_carve(table, len + 1)) != NULL;
+
+  if (!e->chunked) {
+    copy = (char*)malloc(len + 1);
+  }
+
+  memcpy(copy, str, len);
+  copy[len] = '\0';
+
+  e->hash = hash;
+  e->str = copy;
+  e->len = len;
+  ++table->size;
+
+  return copy;
+}
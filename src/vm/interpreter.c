@@ -1,29 +1,131 @@
 #include <vm/interpreter.h>
+#include <vm/program.h>
+#include <vm/jit.h>
+#include <vm/builtins.h>
+#include <vm/fiber.h>
+#include <vm/net.h>
+#include <vm/calls.h>
 
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
 #include <stdlib.h>
+#include <setjmp.h>
+
+// labels-as-values dispatch, enabled with -DBB8_COMPUTED_GOTO=ON.
+// the portable `switch` loop is used on compilers without the extension.
+#if defined(BB8_COMPUTED_GOTO) && (defined(__GNUC__) || defined(__clang__))
+  #define INTERPRETER_THREADED 1
+#else
+  #define INTERPRETER_THREADED 0
+#endif
+
+interpreter_t *interpreter_create(runtime_t *rt, const ubyte_t *data, size_t len) {
+  interpreter_t *it;
+  program_t *program;
+  const char *error;
+
+  if ((program = program_create(data, len, &error)) == NULL) {
+    fprintf(stderr, "invalid bytecode file: %s\n", error);
+    return NULL;
+  }
+
+  it = interpreter_createShared(rt, program);
+  program_release(program);
+
+  return it;
+}
 
-interpreter_t *interpreter_create(runtime_t *rt, ubyte_t *data, size_t len) {
+interpreter_t *interpreter_createShared(runtime_t *rt, program_t *program) {
   interpreter_t *it = (interpreter_t*)malloc(sizeof(interpreter_t));
+
   it->pc = 0;
-  it->len = len;
   it->flags = 0;
 
   it->rt = rt;
 
-  it->bc = malloc(sizeof(ubyte_t) * len);
-  memcpy(it->bc, data, it->len);
+  it->program = program_retain(program);
+  it->image = &program->image;
+  it->bc = it->image->code;
+  it->len = it->image->codeLen;
+
+  // decode once up front; interpreter_run executes the decoded stream
+  it->code = code_decode(rt->dt, program);
+
+  // static data is in place before anything runs, so the verifier can
+  // rely on the label slots (see verify_code)
+  program_load(program, rt);
+
+  // verified code runs without bounds checks, see interpreter_run
+  it->verify = verify_code(it->code, &it->verifyOffset);
+
+  // OP_JIT regions are compiled on first use, loops once they are hot
+  it->jit = jit_create(it->code);
+  it->hotLoop = jit_hotThreshold();
+  it->tracing = jit_tracing();
+  it->trace = NULL;
+  it->haltExits = true;
+  it->entries = NULL;
+  it->numEntries = 0;
+  it->profile = NULL;
+  it->opcodes = NULL;
+  it->blocks = NULL;
+  it->samples = NULL;
+  it->ring = NULL;
+  it->instructions = NULL;
+  it->sampleAt = NULL;
+  it->remeter = false;
+  it->sampleFn = NULL;
+  it->sampleNative = false;
+
+  // tasks spawned on the runtime run the same program, see vm/task.h
+  rt->program = program;
 
   return it;
 }
 
+// defined below, with interpreter_profileBlocks
+static void interpreter_freeBlocks(interpreter_blocks_t *blocks);
+
 void interpreter_destroy(interpreter_t *it) {
-  free(it->bc);
+  jit_destroy(it->jit);
+  code_destroy(it->code);
+  program_release(it->program);
+  free(it->entries);
+  free(it->profile);
+  free(it->opcodes);
+  interpreter_freeBlocks(it->blocks);
+  free(it->samples);
+
+  if (it->instructions != NULL) {
+    free(it->instructions->counts);
+    free(it->instructions->nanos);
+    free(it->instructions);
+  }
+
+  if (it->ring != NULL) {
+    free(it->ring->entries);
+    free(it->ring);
+  }
+
+  if (it->rt->traced == it) {
+    it->rt->traced = NULL;
+  }
+
   free(it);
 }
 
+void interpreter_reset(interpreter_t *it) {
+  runtime_t *rt = it->rt;
+
+  // before the heap is cleared: the memo tables claim values
+  jit_reset(it->jit, rt);
+  runtime_reset(rt, it->program);
+
+  it->pc = 0;
+  it->flags = 0;
+}
+
 void interpreter_peek(interpreter_t *it, size_t size, void *out) {
   size_t pc = VM_PROGRAM_COUNTER(it->rt->dt);
 
@@ -45,579 +147,1503 @@ bool interpreter_atEnd(interpreter_t *it) {
   return VM_PROGRAM_COUNTER(it->rt->dt) >= it->len;
 }
 
-void interpreter_run(interpreter_t *it) {
-  runtime_t *rt = it->rt;
+// resolves the byte offset `offset` to an instruction, through the
+// jump site's cache so repeated jumps skip the offset map.
+static inline instruction_t *interpreter_jumpTarget(interpreter_t *it, instruction_t *ins, uint64_t offset) {
+  if (ins->cache.index == CODE_INVALID_INDEX || ins->cache.offset != offset) {
+    ins->cache.offset = offset;
+    ins->cache.index = code_indexOf(it->code, offset);
+  }
+
+  return &it->code->instructions[ins->cache.index];
+}
+
+// sets the compare flags like `cmp`, so a following jcc may test them again,
+// and returns whether the fused JUMP_FLAGS condition `cond` holds.
+static inline bool interpreter_compareJump(interpreter_t *it, int64_t l, int64_t r, uint8_t cond) {
+  it->flags = ((l > r) - (l < r)) + 1;
+
+  switch (cond) {
+    case JUMP_FLAGS_JE: return l == r;
+    case JUMP_FLAGS_JNE: return l != r;
+    case JUMP_FLAGS_JG: return l > r;
+    case JUMP_FLAGS_JGE: return l >= r;
+    default: return true;
+  }
+}
+
+// whether the JUMP_FLAGS condition `cond` holds for the compare flags
+// `flags`, as OP_JMP, cmpj, setcc and select all take it: `jge` is
+// either flag set
+static inline bool interpreter_condition(uint8_t flags, uint8_t cond) {
+  switch (cond) {
+    case JUMP_FLAGS_JE: return (flags & INTERPRETER_FLAGS_EQUAL) != 0;
+    case JUMP_FLAGS_JNE: return (flags & INTERPRETER_FLAGS_EQUAL) == 0;
+    case JUMP_FLAGS_JG: return (flags & INTERPRETER_FLAGS_GREATER) != 0;
+    case JUMP_FLAGS_JGE: return (flags & (INTERPRETER_FLAGS_GREATER | INTERPRETER_FLAGS_EQUAL)) != 0;
+    default: return true;
+  }
+}
+
+// calls a compiled region or loop, sharing the compare flags with it,
+// and returns the instruction it left off at
+static instruction_t *interpreter_runNative(interpreter_t *it, native_function_t fn) {
+  jit_frame_t frame = { .flags = it->flags };
+  args_t args = { &it->rt->dt->storage[AT_LOCAL], NULL, &frame, NULL };
+  value_t next;
 
-  uint8_t data, opcode, flags, cache[64];
+  it->sampleNative = true;
+  next = fn(it->rt, &args);
+  it->sampleNative = false;
 
-  while (!interpreter_atEnd(it)) {
-    size_t pcBefore = VM_PROGRAM_COUNTER(rt->dt);
+  it->flags = frame.flags;
 
-    interpreter_read(it, sizeof(data), &data);
+  return &it->code->instructions[code_indexOf(it->code, next.data.u64)];
+}
 
-    opcode = data >> 3;
-    flags = data & 0x7;
+// a JIT_FLAG_MEMOIZE region: on a hit, only $r[0] is set and the region
+// is skipped; on a miss it runs, and its $r[0] is recorded
+static instruction_t *interpreter_runMemoized(interpreter_t *it, instruction_t *begin, native_function_t fn) {
+  value_t *result = &it->rt->dt->storage[AT_REG].data[0];
+  instruction_t *next = jit_memoLookup(it->jit, it->rt, begin, result);
 
-    // printf("stack len : %zu\n", VM_STACK_POINTER(rt->dt));
+  if (next == NULL) {
+    next = interpreter_runNative(it, fn);
+    jit_memoStore(it->jit, it->rt, begin, next, result);
+  }
 
-    switch (opcode) {
-      case OP_NOOP: break;
-      case OP_LOAD: { // load
-        obj_loc_t o;
-        interpreter_read(it, sizeof(o), &o);
+  return next;
+}
 
-        loc_28_t loc;
-        archtype_t at;
-        obj_loc_parse(o, &loc, &at);
+// defined below, by the INTERPRETER_RECORDING instance of interpreter_loop.h
+void interpreter_runRecording(interpreter_t *it);
 
-        value_t *v = datatable_getValue(rt->dt, loc, at);
+// runs one iteration of the loop at `header` while recording it, then
+// compiles the trace and enters it if the iteration came back round
+static instruction_t *interpreter_recordTrace(interpreter_t *it, instruction_t *header) {
+  jit_trace_t trace;
+  native_function_t fn;
+  instruction_t *next;
 
-        switch (flags) {
-          case CONST_FLAGS_NONE: // ??
-            v->data.i64 = 0;
-            v->metadata = TYPE_NONE; // just zero out i guess
+  trace.header = header - it->code->instructions;
+  trace.len = 0;
+  trace.complete = false;
 
-            break;
-          case CONST_FLAGS_NULL: // loadnull
-            v->data.raw = NULL;
-            v->metadata = TYPE_POINTER;
+  it->trace = &trace;
+  VM_PROGRAM_COUNTER(it->rt->dt) = header->offset;
+  interpreter_runRecording(it);
+  it->trace = NULL;
 
-            break;
-          case CONST_FLAGS_I64: { // loadi4
-            interpreter_read(it, sizeof(int64_t), cache);
-            value_setInt(rt, v, *((int64_t*)cache));
+  fn = jit_traceCompile(it->jit, &trace);
+  next = &it->code->instructions[code_indexOf(it->code, VM_PROGRAM_COUNTER(it->rt->dt))];
 
-            break;
-          }
-          case CONST_FLAGS_U64: { // loadu4
-            interpreter_read(it, sizeof(uint64_t), cache);
-            value_setUint(rt, v, *((uint64_t*)cache));
+  return (fn != NULL && next == header) ? interpreter_runNative(it, fn) : next;
+}
 
-            break;
-          }
-          case CONST_FLAGS_F64: { // loadd
-            interpreter_read(it, sizeof(double), cache);
-            value_setDouble(rt, v, *((double*)cache));
+// a taken backward jump from `latch` to `header`, once the loop is hot.
+// runs the compiled loop if there is one, counting again from zero if not.
+// when tracing, the loop is recorded first, and its code range only
+// compiled if that fails.
+static instruction_t *interpreter_enterLoop(interpreter_t *it, instruction_t *latch, instruction_t *header) {
+  native_function_t fn = NULL;
+  bool record = false;
+
+  // see runtime_compiles
+  if (!runtime_compiles(it->rt)) {
+    header->hits = 0;
+    return header;
+  }
 
-            break;
-          }
-          case CONST_FLAGS_BOOL: { // loadb
-            interpreter_read(it, sizeof(uint8_t), cache);
-            value_setBoolean(rt, v, (bool)cache[0]);
+  if (it->tracing && (fn = jit_traceLookup(it->jit, header, &record)) == NULL && record) {
+    return interpreter_recordTrace(it, header);
+  }
 
-            break;
-          }
-          case CONST_FLAGS_RAWDATA: { // loaddata
-            interpreter_read(it, sizeof(uint64_t), cache);
-            uint64_t sz = *((uint64_t*)cache);
+  if (fn == NULL) {
+    fn = jit_loop(it->jit, header, latch);
+  }
 
-            void *data = malloc(sz); // managed by refcounter
+  if (fn == NULL) {
+    header->hits = 0;
+    return header;
+  }
 
-            interpreter_read(it, sz, data);
+  return interpreter_runNative(it, fn);
+}
 
-            value_setRefCounted(rt, v, data);
+// the instruction pointer lives in a local of interpreter_run;
+// VM_PROGRAM_COUNTER is only written back at calls, at halt and at
+// safepoints, so `$pc` read from bytecode is the value at the last sync.
+// it always holds a byte offset, so label values stay valid.
+#define INTERPRETER_SYNC_PC() \
+  do { \
+    it->pc = ip->offset; \
+    VM_PROGRAM_COUNTER(rt->dt) = ip->offset; \
+  } while (0)
+
+#if INTERPRETER_THREADED
+  #define INTERPRETER_DISPATCH() \
+    do { \
+      ins = ip++; \
+      INTERPRETER_RECORD(); \
+      INTERPRETER_COUNT(); \
+      goto *dispatchTable[ins->handler]; \
+    } while (0)
+  #define INTERPRETER_CASE(op) lbl_##op
+  #define INTERPRETER_NEXT() INTERPRETER_DISPATCH()
+#else
+  #define INTERPRETER_CASE(op) case op
+  #define INTERPRETER_NEXT() continue
+#endif
 
-            break;
-          }
-        }
+// one handler per CMP_FLAG operand pairing of a binop, plus the
+// immediate-right forms (CMP_FLAG_IMM_R), see CODE_OPS. the integer ones
+// quicken.
+#define INTERPRETER_BINOP(name, op) \
+  INTERPRETER_CASE(name##_I64): { \
+    value_t *left = OPERAND(ins->left); \
+    value_t *right = OPERAND(ins->right); \
+    INTERPRETER_QUICKEN(left, right); \
+    left->data.i64 = left->data.i64 op right->data.i64; \
+    INTERPRETER_NEXT(); \
+  } \
+  INTERPRETER_CASE(name##_F64_L): { \
+    value_t *left = OPERAND(ins->left); \
+    left->data.dbl = left->data.dbl op OPERAND(ins->right)->data.i64; \
+    INTERPRETER_NEXT(); \
+  } \
+  INTERPRETER_CASE(name##_F64_R): { \
+    value_t *left = OPERAND(ins->left); \
+    left->data.i64 = left->data.i64 op OPERAND(ins->right)->data.dbl; \
+    INTERPRETER_NEXT(); \
+  } \
+  INTERPRETER_CASE(name##_F64_LR): { \
+    value_t *left = OPERAND(ins->left); \
+    left->data.dbl = left->data.dbl op OPERAND(ins->right)->data.dbl; \
+    INTERPRETER_NEXT(); \
+  } \
+  INTERPRETER_CASE(name##_I64_IMM): { \
+    value_t *left = OPERAND(ins->left); \
+    INTERPRETER_QUICKEN(left, NULL); \
+    left->data.i64 = left->data.i64 op ins->imm.i64; \
+    INTERPRETER_NEXT(); \
+  } \
+  INTERPRETER_CASE(name##_F64_L_IMM): { \
+    value_t *left = OPERAND(ins->left); \
+    left->data.dbl = left->data.dbl op ins->imm.i64; \
+    INTERPRETER_NEXT(); \
+  } \
+  INTERPRETER_CASE(name##_F64_R_IMM): { \
+    value_t *left = OPERAND(ins->left); \
+    left->data.i64 = left->data.i64 op ins->imm.dbl; \
+    INTERPRETER_NEXT(); \
+  } \
+  INTERPRETER_CASE(name##_F64_LR_IMM): { \
+    value_t *left = OPERAND(ins->left); \
+    left->data.dbl = left->data.dbl op ins->imm.dbl; \
+    INTERPRETER_NEXT(); \
+  }
 
-        break;
+// the quickened forms of an integer binop, see interpreter_quicken
+#define INTERPRETER_BINOP_ABS(name, op) \
+  INTERPRETER_CASE(name##_I64_ABS): { \
+    ins->left.base->data.i64 = ins->left.base->data.i64 op ins->right.base->data.i64; \
+    INTERPRETER_NEXT(); \
+  } \
+  INTERPRETER_CASE(name##_I64_ABS_IMM): { \
+    ins->left.base->data.i64 = ins->left.base->data.i64 op ins->imm.i64; \
+    INTERPRETER_NEXT(); \
+  }
+
+#define INTERPRETER_BINOP_ABS_LABELS(name) \
+  [name##_I64_ABS] = &&lbl_##name##_I64_ABS, \
+  [name##_I64_ABS_IMM] = &&lbl_##name##_I64_ABS_IMM
+
+#define INTERPRETER_BINOP_LABELS(name) \
+  [name##_I64] = &&lbl_##name##_I64, \
+  [name##_F64_L] = &&lbl_##name##_F64_L, \
+  [name##_F64_R] = &&lbl_##name##_F64_R, \
+  [name##_F64_LR] = &&lbl_##name##_F64_LR, \
+  [name##_I64_IMM] = &&lbl_##name##_I64_IMM, \
+  [name##_F64_L_IMM] = &&lbl_##name##_F64_L_IMM, \
+  [name##_F64_R_IMM] = &&lbl_##name##_F64_R_IMM, \
+  [name##_F64_LR_IMM] = &&lbl_##name##_F64_LR_IMM
+
+// the first run of an instruction by its generic handler, with the values
+// of its operands (`right` NULL for an immediate): points its `handler` at
+// a form specialized for them, if there is one. operand kinds never change
+// once decoded, so the _ABS forms need no guard; the _SCALAR ones guard
+// the values, see CODE_OPS. it is still the generic handler that runs it
+// this time.
+static void interpreter_quicken(instruction_t *ins, const value_t *left, const value_t *right) {
+  const bool abs = CODE_OPERAND_ABSOLUTE(ins->left) && (right == NULL || CODE_OPERAND_ABSOLUTE(ins->right));
+  const bool scalar = !VALUE_OWNS(left) && (right == NULL || !VALUE_OWNS(right));
+
+  ins->quickened = true;
+
+  switch (ins->opcode) {
+    case CODE_OP_ADD_I64: case CODE_OP_ADD_I64_IMM:
+    case CODE_OP_SUB_I64: case CODE_OP_SUB_I64_IMM:
+    case CODE_OP_MUL_I64: case CODE_OP_MUL_I64_IMM:
+    case CODE_OP_DIV_I64: case CODE_OP_DIV_I64_IMM:
+      if (abs) {
+        // the register and immediate forms are in pairs, in op order
+        const uint8_t op = (uint8_t)((ins->opcode - CODE_OP_ADD_I64) / (CODE_OP_SUB_I64 - CODE_OP_ADD_I64));
+
+        ins->handler = (uint8_t)(CODE_OP_ADD_I64_ABS + op * 2 + (right == NULL));
+      }
+      break;
+    case OP_CMP:
+    case CODE_OP_CMP_IMM:
+      if (abs && (ins->flags & CMP_FLAG_F64_LR) == 0) {
+        ins->handler = right == NULL ? CODE_OP_CMP_I64_ABS_IMM : CODE_OP_CMP_I64_ABS;
+      }
+      break;
+    case OP_CMPJ:
+    case OP_CMPJ_IMM:
+      if (abs) {
+        ins->handler = right == NULL ? CODE_OP_CMPJ_ABS_IMM : CODE_OP_CMPJ_ABS;
+      }
+      break;
+    case OP_MOV:
+      if ((ins->left.at & 0x3) == AT_REG && abs) {
+        ins->handler = CODE_OP_MOV_ABS;
+      } else if ((ins->left.at & 0x3) != AT_REG && scalar) {
+        ins->handler = CODE_OP_MOV_SCALAR;
+      }
+      break;
+    case OP_LOAD:
+      if (ins->flags == CONST_FLAGS_I64 && scalar) {
+        ins->handler = CODE_OP_LOAD_I64_SCALAR;
       }
+      break;
+  }
+}
 
-      case OP_MOV: { // mov
-        value_t *left, *right;
+#define INTERPRETER_QUICKEN(left, right) \
+  do { \
+    if (!ins->quickened) { \
+      interpreter_quicken(ins, (left), (right)); \
+    } \
+  } while (0)
+
+// stops the program on a bounds violation in the checked interpreter
+static void interpreter_fail(interpreter_t *it, instruction_t *ins, const char *msg) {
+  char source[512];
+
+  // with -g, where in the source it was; only looked up now
+  if (it->image != NULL && image_formatSource(it->image, ins->offset, source, sizeof(source)) != 0) {
+    runtime_fatal(it->rt, EXIT_FAILURE, "runtime error at offset %u (%s): %s", ins->offset, source, msg);
+  } else {
+    runtime_fatal(it->rt, EXIT_FAILURE, "runtime error at offset %u: %s", ins->offset, msg);
+  }
+}
 
-        obj_loc_t o;
-        loc_28_t locLeft;
-        archtype_t atLeft;
-        loc_28_t locRight;
-        archtype_t atRight;
+// ===== fibers =====
 
-        interpreter_read(it, sizeof(o), &o);
-        obj_loc_parse(o, &locLeft, &atLeft);
+static fibers_t *interpreter_fibers(interpreter_t *it) {
+  if (it->rt->fibers == NULL) {
+    it->rt->fibers = fibers_create();
+  }
 
-        left = datatable_getValue(rt->dt, locLeft, atLeft);
+  return it->rt->fibers;
+}
 
-        interpreter_read(it, sizeof(o), &o);
-        obj_loc_parse(o, &locRight, &atRight);
+// switches from the running fiber, to go on at `resume` later, to the one
+// at the front of the run queue, and returns where that one goes on. with
+// nothing to run, the thread waits for a fiber parked on a socket to be
+// ready; with none parked either, the fibers wait for each other: the
+// program is stopped.
+static instruction_t *interpreter_switchFiber(interpreter_t *it, instruction_t *ins, uint64_t resume) {
+  fibers_t *fibers = it->rt->fibers;
+  net_t *net = it->rt->net;
+  fiber_t *next = fibers_dequeue(fibers);
+
+  while (next == NULL && net != NULL && net->numParked != 0) {
+    net_poll(it->rt, net, fibers, -1);
+    next = fibers_dequeue(fibers);
+  }
 
-        right = datatable_getValue(rt->dt, locRight, atRight);
+  if (next == NULL) {
+    interpreter_fail(it, ins, "deadlock, every fiber is waiting in join");
+  }
 
-        if (atLeft & AT_REG) {
-          // optimization
-          *left = *right;
-        } else {
-          value_copyValue(rt, left, right);
-        }
+  fibers_switch(fibers, it->rt->dt, next, resume, it->flags);
+  it->flags = next->flags;
 
-        break;
-      }
+  return &it->code->instructions[code_indexOf(it->code, next->pc)];
+}
 
-      case OP_CMP: { // cmp
-        value_t *left, *right;
+// OP_SPAWN: the new fiber first runs when the running one yields or waits
+static void interpreter_spawn(interpreter_t *it, value_t *id, value_t *target) {
+  fiber_t *fiber = fibers_spawn(interpreter_fibers(it), it->rt->dt->storage[AT_REG].data, value_getUint(target));
 
-        obj_loc_t o;
-        loc_28_t loc;
-        archtype_t at;
+  value_setInt(it->rt, id, fiber->id);
+}
 
-        interpreter_read(it, sizeof(o), &o);
-        obj_loc_parse(o, &loc, &at);
+// OP_YIELD: goes to the back of the run queue, if anything else is in it,
+// or, parked by sockWait, leaves it until its socket is ready. otherwise
+// the fibers whose sockets are ready by now join the queue first.
+static instruction_t *interpreter_yield(interpreter_t *it, instruction_t *ins, instruction_t *next) {
+  fibers_t *fibers = it->rt->fibers;
+  net_t *net = it->rt->net;
 
-        left = datatable_getValue(rt->dt, loc, at);
+  if (fibers == NULL) {
+    return next;
+  }
 
-        interpreter_read(it, sizeof(o), &o);
-        obj_loc_parse(o, &loc, &at);
+  if (fibers->current->state == FIBER_IO) {
+    return interpreter_switchFiber(it, ins, next->offset);
+  }
 
-        right = datatable_getValue(rt->dt, loc, at);
+  if (net != NULL && net->numParked != 0) {
+    net_poll(it->rt, net, fibers, 0);
+  }
 
-        union { int i; double d; } cacheval;
+  if (fibers->head == NULL) {
+    return next;
+  }
 
-        switch (flags) {
-          case CMP_FLAG_F64_L: // cmpdl
-            cacheval.d = left->data.dbl - right->data.i64;
-            goto setDouble;
-          case CMP_FLAG_F64_R: // cmpdr
-            cacheval.d = left->data.i64 - right->data.dbl;
-            goto setDouble;
-          case CMP_FLAG_F64_LR: // cmpd
-            cacheval.d = left->data.dbl - right->data.dbl;
-            goto setDouble;
-          default: // cmp
-            cacheval.i = left->data.i64 - right->data.i64;
-            goto setInt;
-        }
+  fibers_enqueue(fibers, fibers->current);
 
-      setDouble:
-        it->flags = ((0 < cacheval.d) - (cacheval.d < 0)) + 1;
-        break;
-      setInt:
-        it->flags = ((0 < cacheval.i) - (cacheval.i < 0)) + 1; // 0, 1, or 2. gets sign() of `val` and adds 1.
-        break;
-      }
+  return interpreter_switchFiber(it, ins, next->offset);
+}
 
-      case OP_JMP: { // jmp
-        value_t *v;
-
-        obj_loc_t o;
-        loc_28_t loc;
-        archtype_t at;
-
-        interpreter_read(it, sizeof(o), &o);
-        obj_loc_parse(o, &loc, &at);
-
-        v = datatable_getValue(rt->dt, loc, at);
-
-        switch (flags) {
-          case JUMP_FLAGS_JE: // je
-            if (~it->flags & INTERPRETER_FLAGS_EQUAL) {
-              goto noSeek;
-            }
-            break;
-          case JUMP_FLAGS_JNE: // jne
-            if (it->flags & INTERPRETER_FLAGS_EQUAL) {
-              goto noSeek;
-            }
-            break;
-          case JUMP_FLAGS_JG: // jg
-            if (~it->flags & INTERPRETER_FLAGS_GREATER) {
-              goto noSeek;
-            }
-            break;
-          case JUMP_FLAGS_JGE: // jge
-            if (~it->flags & (INTERPRETER_FLAGS_GREATER | INTERPRETER_FLAGS_EQUAL)) {
-              goto noSeek;
-            }
-            break;
-        }
+// OP_JOIN: a fiber that waits resumes at the join itself, which then finds
+// the other one done. the result is taken by the first join; joining a
+// fiber again, or one that does not exist, gives none.
+static instruction_t *interpreter_join(interpreter_t *it, instruction_t *ins, instruction_t *next, value_t *id) {
+  fibers_t *fibers = it->rt->fibers;
+  value_t *result = &it->rt->dt->storage[AT_REG].data[0];
+  fiber_t *fiber = fibers != NULL ? fibers_get(fibers, value_getInt(id)) : NULL;
 
-        interpreter_seek(it, value_getUint(v));
+  if (fiber == NULL || fiber == fibers->current) {
+    result->data.i64 = 0;
+    VALUE_SET_META(result, TYPE_NONE, FLAG_NONE);
 
-      noSeek:
-        break;
-      }
+    return next;
+  }
 
-      case OP_PUSH: { // push
-        storage_t *stack = &rt->dt->storage[AT_LOCAL];
-        size_t stackLen = *stack->lenVal;
-
-        switch (flags) {
-          case CONST_FLAGS_NONE: { // push -- load value_t to push to stack
-            obj_loc_t o;
-            loc_28_t loc;
-            archtype_t at;
-
-            interpreter_read(it, sizeof(o), &o);
-            obj_loc_parse(o, &loc, &at);
-
-            value_copyValue(rt, &stack->data[stackLen], datatable_getValue(rt->dt, loc, at));
-
-            break;
-          }
-          // shortcuts for pushing constants directly, rather than using multiple instructions
-          // @TODO: make these values be copied from a constant pool, rather than by recreating.
-          case CONST_FLAGS_NULL: { // pushnull
-            value_t *v = &stack->data[stackLen];
-            value_destroy(rt, v);
-
-            v->data.raw = NULL;
-            v->metadata = TYPE_POINTER;
-
-            break;
-          }
-          case CONST_FLAGS_I64: { // pushi4
-            interpreter_read(it, sizeof(int64_t), cache);
-            value_setInt(rt, &stack->data[stackLen], *((int64_t*)cache));
-
-            break;
-          }
-          case CONST_FLAGS_U64: { // pushu4
-            interpreter_read(it, sizeof(uint64_t), cache);
-            value_setUint(rt, &stack->data[stackLen], *((uint64_t*)cache));
-
-            break;
-          }
-          case CONST_FLAGS_F64: { // pushd
-            interpreter_read(it, sizeof(double), cache);
-            value_setDouble(rt, &stack->data[stackLen], *((double*)cache));
-
-            break;
-          }
-          case CONST_FLAGS_BOOL: { // pushb
-            interpreter_read(it, sizeof(uint8_t), cache);
-            value_setBoolean(rt, &stack->data[stackLen], (bool)cache[0]);
-
-            break;
-          }
-          case CONST_FLAGS_RAWDATA: { // pushdata
-            interpreter_read(it, sizeof(uint64_t), cache);
-            uint64_t sz = *((uint64_t*)cache);
-
-            void *data = malloc(sz); // managed by refcounter
-
-            interpreter_read(it, sz, data);
-
-            value_setRefCounted(rt, &stack->data[stackLen], data);
-
-            break;
-          }
-        }
+  if (fiber->state == FIBER_DONE) {
+    *result = fiber->result;
+    fibers_free(fibers, fiber);
 
-        // TODO: make stack size dynamic?
-        assert(((stackLen + 1) * sizeof(value_t) < STACK_SIZE_BYTES) && "stack overflow");
+    return next;
+  }
 
-        ++*stack->lenVal;
-        //++stack->len;
+  fibers->current->state = FIBER_WAITING;
+  fibers->current->next = fiber->waiters;
+  fiber->waiters = fibers->current;
 
-        break;
-      }
+  return interpreter_switchFiber(it, ins, ins->offset);
+}
 
-      case OP_POP: {
-        // assert(stack.len != 0);
+// OP_HALT on a fiber other than the main one ends just that fiber. NULL on
+// the main fiber, whose halt ends the program with any others still there.
+static instruction_t *interpreter_endFiber(interpreter_t *it, instruction_t *ins) {
+  fibers_t *fibers = it->rt->fibers;
 
-        storage_t *s = &rt->dt->storage[AT_LOCAL];
+  if (fibers->current->id == FIBERS_MAIN) {
+    return NULL;
+  }
 
-        interpreter_read(it, sizeof(uint16_t), cache);
-        uint16_t sz = *((uint16_t*)cache);
+  fibers_finish(it->rt, fibers, it->rt->dt);
 
-        while (sz--) { // required to call free() on malloc'd objects
-          value_t *ptr = &s->data[--*s->lenVal];
+  return interpreter_switchFiber(it, ins, ins->offset);
+}
 
-          value_destroy(rt, ptr);
+// the runtime's fuel ran out at a taken jump or after a call, see
+// runtime_setBudget; `*ip` is where the program goes on. if only the slice
+// was used up, the fiber yields. with a hard memory limit, the quota is
+// looked at first, see runtime_checkMemory. false if the run stops there.
+// while counting (see runtime_countBegin), at a tick of `ins`: it and
+// those from where the interpreter went on at the last tick ran, one
+// after the other, and it goes on at `next`
+static void interpreter_count(interpreter_t *it, instruction_t *ins, instruction_t *next) {
+  runtime_t *rt = it->rt;
+  const instruction_t *from = (const instruction_t*)rt->countFrom;
 
-          ptr->metadata = TYPE_NONE;
-        }
+  // not after a switch of fibers or a nested run, which start elsewhere
+  if (from != NULL && from <= ins && ins < it->code->instructions + it->code->count) {
+    rt->counted += (uint64_t)(ins - from) + 1;
+  }
 
-        break;
-      }
+  rt->countFrom = next;
+}
 
-      case OP_ADD:
-      case OP_SUB:
-      case OP_MUL:
-      case OP_DIV:
-      case OP_MOD: {
-        value_t *left, *right;
-
-        obj_loc_t o;
-        loc_28_t loc;
-        archtype_t at;
-
-        interpreter_read(it, sizeof(o), &o);
-        obj_loc_parse(o, &loc, &at);
-
-        left = datatable_getValue(rt->dt, loc, at);
-
-        interpreter_read(it, sizeof(o), &o);
-        obj_loc_parse(o, &loc, &at);
-
-        right = datatable_getValue(rt->dt, loc, at);
-
-        switch (opcode) {
-          case OP_ADD:
-            switch (flags) {
-              case CMP_FLAG_F64_L:  left->data.dbl = left->data.dbl + right->data.i64; break;
-              case CMP_FLAG_F64_R:  left->data.i64 = left->data.i64 + right->data.dbl; break;
-              case CMP_FLAG_F64_LR: left->data.dbl = left->data.dbl + right->data.dbl; break;
-              default:              left->data.i64 = left->data.i64 + right->data.i64; break;
-            }
-            break;
-          case OP_SUB:
-            switch (flags) {
-              case CMP_FLAG_F64_L:  left->data.dbl = left->data.dbl - right->data.i64; break;
-              case CMP_FLAG_F64_R:  left->data.i64 = left->data.i64 - right->data.dbl; break;
-              case CMP_FLAG_F64_LR: left->data.dbl = left->data.dbl - right->data.dbl; break;
-              default:              left->data.i64 = left->data.i64 - right->data.i64; break;
-            }
-            break;
-          case OP_MUL:
-            switch (flags) {
-              case CMP_FLAG_F64_L:  left->data.dbl = left->data.dbl * right->data.i64; break;
-              case CMP_FLAG_F64_R:  left->data.i64 = left->data.i64 * right->data.dbl; break;
-              case CMP_FLAG_F64_LR: left->data.dbl = left->data.dbl * right->data.dbl; break;
-              default:              left->data.i64 = left->data.i64 * right->data.i64; break;
-            }
-            break;
-          // @TODO: div by zero catch?
-          case OP_DIV:
-            switch (flags) {
-              case CMP_FLAG_F64_L:  left->data.dbl = left->data.dbl / right->data.i64; break;
-              case CMP_FLAG_F64_R:  left->data.i64 = left->data.i64 / right->data.dbl; break;
-              case CMP_FLAG_F64_LR: left->data.dbl = left->data.dbl / right->data.dbl; break;
-              default:              left->data.i64 = left->data.i64 / right->data.i64; break;
-            }
-            break;
-          case OP_MOD:
-            left->data.i64 = left->data.i64 % right->data.i64;
-            break;
-        }
+static bool interpreter_outOfFuel(interpreter_t *it, instruction_t *ins, instruction_t **ip) {
+  if (it->rt->counting != 0) {
+    interpreter_count(it, ins, *ip);
+  }
 
-        break;
-      }
+  // thrown from `ins`, inside whatever region it is in
+  if (runtime_isMemoryLimited(it->rt) && atomic_load_explicit(&it->rt->quota->exceeded, memory_order_relaxed)) {
+    it->pc = ins->offset;
+    VM_PROGRAM_COUNTER(it->rt->dt) = ins->offset;
+    runtime_checkMemory(it->rt);
+
+    if (it->haltExits) {
+      interpreter_fail(it, ins, "memory limit exceeded");
+    }
 
-      case OP_XOR:
-      case OP_AND:
-      case OP_OR:
-      case OP_SHL:
-      case OP_SHR: {
-        value_t *left, *right;
+    return false;
+  }
+
+  if (!runtime_refuel(it->rt)) {
+    if (it->haltExits) {
+      interpreter_fail(it, ins, "execution budget exhausted");
+    }
 
-        obj_loc_t o;
-        loc_28_t loc;
-        archtype_t at;
+    return false;
+  }
 
-        interpreter_read(it, sizeof(o), &o);
-        obj_loc_parse(o, &loc, &at);
+  *ip = interpreter_yield(it, ins, *ip);
 
-        left = datatable_getValue(rt->dt, loc, at);
+  return true;
+}
 
-        interpreter_read(it, sizeof(o), &o);
-        obj_loc_parse(o, &loc, &at);
+static inline value_t *interpreter_checkedOperand(interpreter_t *it, instruction_t *ins, operand_t *o) {
+  uint64_t index = *o->len - o->off;
 
-        right = datatable_getValue(rt->dt, loc, at);
+  if (index >= o->cap) {
+    interpreter_fail(it, ins, "operand out of range");
+  }
 
-        switch (opcode) {
-          case OP_XOR: left->data.i64 = left->data.i64 ^ right->data.i64; break;
-          case OP_AND: left->data.i64 = left->data.i64 & right->data.i64; break;
-          case OP_OR:  left->data.i64 = left->data.i64 | right->data.i64; break;
-          case OP_SHL: left->data.i64 = left->data.i64 << right->data.i64; break;
-          case OP_SHR: left->data.i64 = left->data.i64 >> right->data.i64; break;
-        }
+  return &o->base[index];
+}
 
-        break;
+// the profiled loop moved to another block, or back to the start of the
+// one it is in, at `offset`: charges the time since the last change to
+// the block it left
+static void interpreter_enterBlock(interpreter_t *it, uint64_t offset) {
+  interpreter_blocks_t *blocks = it->blocks;
+  uint64_t now = runtime_nowNs();
+  size_t lo = 0, hi = blocks->numBlocks;
+
+  if (blocks->current != NULL) {
+    blocks->current->nanos += now - blocks->since;
+  }
+
+  // the last block starting at or before `offset`; the first starts at 0
+  while (hi - lo > 1) {
+    size_t mid = lo + (hi - lo) / 2;
+
+    if (blocks->blocks[mid].offset <= offset) {
+      lo = mid;
+    } else {
+      hi = mid;
+    }
+  }
+
+  blocks->current = &blocks->blocks[lo];
+  blocks->current->entries++;
+  blocks->since = now;
+}
+
+// the profiled loop is at `ins`: charges the time since the last
+// instruction started to it
+static inline void interpreter_countInstruction(interpreter_t *it, const instruction_t *ins) {
+  interpreter_instructions_t *instructions = it->instructions;
+  uint32_t index = (uint32_t)(ins - it->code->instructions);
+  uint64_t now = runtime_nowNs();
+
+  if (instructions->last != CODE_INVALID_INDEX) {
+    instructions->nanos[instructions->last] += now - instructions->since;
+  }
+
+  instructions->counts[index]++;
+  instructions->last = index;
+  instructions->since = now;
+}
+
+// whether OP_CALL is timed, for vm --trace-calls or
+// interpreter_profileBlocks(it, true)
+static inline bool interpreter_timesCalls(interpreter_t *it) {
+  return it->rt->calls != NULL || (it->blocks != NULL && it->blocks->calls);
+}
+
+// whether the unchecked loop must tick, time calls or note where the
+// program went: with a budget or slices, while counting, with vm
+// --trace-calls or --profile-samples. otherwise interpreter_runUnmetered
+// does without.
+static inline bool interpreter_isMetered(interpreter_t *it) {
+  return !runtime_compiles(it->rt) || it->samples != NULL;
+}
+
+// an OP_CALL of `fn`, made at `start`
+static void interpreter_countCall(interpreter_t *it, native_function_t fn, uint64_t start) {
+  uint64_t nanos = runtime_nowNs() - start;
+  interpreter_block_t *block;
+
+  if (it->rt->calls != NULL) {
+    calls_record(it->rt->calls, fn, nanos);
+  }
+
+  if (it->blocks == NULL || !it->blocks->calls) {
+    return;
+  }
+
+  block = it->blocks->current;
+  interpreter_block_call_t *call = block->calls;
+
+  while (call != NULL && call->fn != fn) {
+    call = call->next;
+  }
+
+  if (call == NULL) {
+    call = (interpreter_block_call_t*)calloc(1, sizeof(interpreter_block_call_t));
+    call->fn = fn;
+    call->next = block->calls;
+    block->calls = call;
+  }
+
+  call->count++;
+  call->nanos += nanos;
+}
+
+#define INTERPRETER_CHECKED 0
+#define INTERPRETER_RECORDING 0
+#define INTERPRETER_PROFILED 0
+#define INTERPRETER_METERED 1
+#define INTERPRETER_RUN interpreter_runUnchecked
+#include "interpreter_loop.h"
+#undef INTERPRETER_RUN
+#undef INTERPRETER_METERED
+#undef INTERPRETER_PROFILED
+#undef INTERPRETER_RECORDING
+#undef INTERPRETER_CHECKED
+
+#define INTERPRETER_CHECKED 0
+#define INTERPRETER_RECORDING 0
+#define INTERPRETER_PROFILED 0
+#define INTERPRETER_METERED 0
+#define INTERPRETER_RUN interpreter_runUnmetered
+#include "interpreter_loop.h"
+#undef INTERPRETER_RUN
+#undef INTERPRETER_METERED
+#undef INTERPRETER_PROFILED
+#undef INTERPRETER_RECORDING
+#undef INTERPRETER_CHECKED
+
+#define INTERPRETER_CHECKED 0
+#define INTERPRETER_RECORDING 1
+#define INTERPRETER_PROFILED 0
+#define INTERPRETER_METERED 1
+#define INTERPRETER_RUN interpreter_runRecording
+#include "interpreter_loop.h"
+#undef INTERPRETER_RUN
+#undef INTERPRETER_METERED
+#undef INTERPRETER_PROFILED
+#undef INTERPRETER_RECORDING
+#undef INTERPRETER_CHECKED
+
+#define INTERPRETER_CHECKED 1
+#define INTERPRETER_RECORDING 0
+#define INTERPRETER_PROFILED 0
+#define INTERPRETER_METERED 1
+#define INTERPRETER_RUN interpreter_runChecked
+#include "interpreter_loop.h"
+#undef INTERPRETER_RUN
+#undef INTERPRETER_METERED
+#undef INTERPRETER_PROFILED
+#undef INTERPRETER_RECORDING
+#undef INTERPRETER_CHECKED
+
+#define INTERPRETER_CHECKED 1
+#define INTERPRETER_RECORDING 0
+#define INTERPRETER_PROFILED 1
+#define INTERPRETER_METERED 1
+#define INTERPRETER_RUN interpreter_runProfiled
+#include "interpreter_loop.h"
+#undef INTERPRETER_RUN
+#undef INTERPRETER_METERED
+#undef INTERPRETER_PROFILED
+#undef INTERPRETER_RECORDING
+#undef INTERPRETER_CHECKED
+
+// code that runs unchecked must pass the verifier, and not be counted
+static inline bool interpreter_isCounted(interpreter_t *it) {
+  return it->profile != NULL || it->opcodes != NULL || it->blocks != NULL || it->ring != NULL
+    || it->instructions != NULL;
+}
+
+// where unchecked code can run. the unmetered loop leaves off for the
+// metered one when a call began counting; nothing ends metering mid-run.
+static void interpreter_runFast(interpreter_t *it) {
+  if (!interpreter_isMetered(it)) {
+    interpreter_runUnmetered(it);
+
+    if (!it->remeter) {
+      return;
+    }
+
+    it->remeter = false;
+  }
+
+  interpreter_runUnchecked(it);
+}
+
+// where unchecked code cannot run
+static void interpreter_runSlow(interpreter_t *it) {
+  if (it->opcodes != NULL || it->blocks != NULL || it->ring != NULL || it->instructions != NULL) {
+    interpreter_runProfiled(it);
+  } else {
+    interpreter_runChecked(it);
+  }
+}
+
+// ===== exceptions =====
+
+// the byte offset a jump or OP_FCALL goes to, as the loop reads it
+static uint64_t interpreter_jumpOffset(instruction_t *ins) {
+  return CODE_DIRECT_JUMP(ins) ? (uint64_t)ins->target.loc : value_getUint(CODE_OPERAND_VALUE(ins->target));
+}
+
+// an instruction's stack effect, as verify_from counts it. an OP_FCALL
+// pops the arguments its function's first OP_RET does.
+static int64_t interpreter_stackEffect(interpreter_t *it, instruction_t *ins) {
+  code_t *code = it->code;
+
+  switch (ins->opcode) {
+    case OP_PUSH:
+      return 1;
+    case OP_TAKE:
+      return ins->flags == TAKE_FLAGS_PUSH ? 1 : 0;
+    case OP_POP:
+      return -(int64_t)ins->imm.u64;
+    case CODE_OP_ADD_I64_IMM:
+    case CODE_OP_SUB_I64_IMM:
+      if (ins->left.base != NULL && CODE_OPERAND_VALUE(ins->left) == &VM_DATA(it->rt->dt, 1 + AT_LOCAL)) {
+        return ins->opcode == CODE_OP_ADD_I64_IMM ? ins->imm.i64 : -ins->imm.i64;
+      }
+
+      return 0;
+    case OP_FCALL:
+      for (uint32_t i = code_indexOf(code, interpreter_jumpOffset(ins)); i < code->count; i++) {
+        code_ensure(code, i, i + 1);
+
+        if (code->instructions[i].opcode == OP_RET) {
+          return -(int64_t)code->instructions[i].imm.u64;
+        }
       }
 
-      case OP_NEG: {
-        value_t *left;
+      return 0;
+    default:
+      return 0;
+  }
+}
 
-        obj_loc_t o;
-        loc_28_t loc;
-        archtype_t at;
+// the stack depth on entry to `region`, which is `top` on entry to the
+// instruction ending at `pc`: the stack effects of the instructions in the
+// region are followed from its start to that one. -1 if that does not
+// tell, as when paths reach it with different depths.
+static int64_t interpreter_regionDepth(interpreter_t *it, const bin_try_t *region, uint64_t pc, uint64_t top) {
+  code_t *code = it->code;
+  uint32_t first = code_indexAt(code, region->start);
+  uint32_t end = code_indexOf(code, region->end);
+  uint32_t at = code_indexOf(code, pc);
+  int64_t *depths, depth = -1;
+  uint32_t *work;
+  size_t n, numWork = 0;
+  bool same = true;
+
+  if (first == CODE_INVALID_INDEX || first >= end || at <= first || at > end) {
+    return -1;
+  }
 
-        interpreter_read(it, sizeof(o), &o);
-        obj_loc_parse(o, &loc, &at);
+  n = end - first;
+  depths = (int64_t*)malloc(sizeof(int64_t) * n);
+  work = (uint32_t*)malloc(sizeof(uint32_t) * n);
+  code_ensure(code, first, end);
 
-        left = datatable_getValue(rt->dt, loc, at);
+  for (size_t i = 0; i < n; i++) {
+    depths[i] = INT64_MIN;
+  }
 
-        switch (flags) {
-          case CMP_FLAG_F64_L:  left->data.dbl = -left->data.dbl; break;
-          default:              left->data.i64 = -left->data.i64; break;
+  depths[0] = 0;
+  work[numWork++] = 0;
+
+  while (numWork != 0 && same) {
+    uint32_t i = work[--numWork];
+    instruction_t *ins = &code->instructions[first + i];
+    int64_t next = depths[i] + interpreter_stackEffect(it, ins);
+    uint32_t succ[2] = { i + 1, UINT32_MAX };
+    // a switch's cases come after its default
+    uint32_t numSucc = ins->opcode == CODE_OP_SWITCH ? 2 + ins->imm.table->count : 2;
+
+    switch (ins->opcode) {
+      case OP_JMP:
+      case OP_CMPJ:
+      case OP_CMPJ_IMM:
+      case CODE_OP_SWITCH:
+        if ((ins->opcode == OP_JMP && ins->flags == JUMP_FLAGS_NONE) || ins->opcode == CODE_OP_SWITCH) {
+          succ[0] = UINT32_MAX;
         }
 
+        succ[1] = code_indexOf(code, interpreter_jumpOffset(ins)) - first;
+        break;
+      case OP_HALT:
+      case OP_RET:
+        succ[0] = UINT32_MAX;
         break;
+    }
+
+    for (uint32_t k = 0; k < numSucc; k++) {
+      uint32_t to = k < 2 ? succ[k] : code_indexOf(code, ins->imm.table->offsets[k - 2]) - first;
+
+      // only the code in the region; a jump out of it leaves it
+      if (to >= n) {
+        continue;
+      }
+
+      if (depths[to] == INT64_MIN) {
+        depths[to] = next;
+        work[numWork++] = to;
+      } else {
+        same = same && depths[to] == next;
       }
+    }
+  }
 
-      case OP_NOT: {
-        value_t *left;
+  // what the region popped of the stack it was entered with is gone
+  if (same && depths[at - 1 - first] >= 0 && depths[at - 1 - first] <= (int64_t)top) {
+    depth = (int64_t)top - depths[at - 1 - first];
+  }
 
-        obj_loc_t o;
-        loc_28_t loc;
-        archtype_t at;
+  free(work);
+  free(depths);
 
-        interpreter_read(it, sizeof(o), &o);
-        obj_loc_parse(o, &loc, &at);
+  return depth;
+}
 
-        left = datatable_getValue(rt->dt, loc, at);
-        left->data.i64 = ~left->data.i64;
+// runtime_throwException found the handler in `c` and came back to
+// interpreter_runCatching: pops the frames above the region's, and its
+// stack back to where the region was entered, releasing the values, and
+// goes on at the handler with the exception's argument in $r[0]. false if
+// the depth was not known, the stack being left at the call.
+static bool interpreter_catch(interpreter_t *it, runtime_catch_t *c) {
+  runtime_t *rt = it->rt;
+  storage_t *s = &rt->dt->storage[AT_LOCAL];
+  int64_t depth = interpreter_regionDepth(it, &c->region, c->pc, c->top);
+  uint64_t bottom = depth != -1 ? (uint64_t)depth : c->top;
 
-        break;
-      }
+  // the throw left compiled code, or a trace being recorded, where it was
+  it->sampleNative = false;
+  it->sampleFn = NULL;
+  it->trace = NULL;
+
+  while (*s->lenVal > bottom) { // as OP_POP
+    value_t *ptr = &s->data[--*s->lenVal];
 
-      case OP_CALL: {
-        obj_loc_t o;
-        loc_28_t loc;
-        archtype_t at;
+    if (VALUE_OWNS(ptr)) {
+      value_destroy(rt, ptr);
 
-        interpreter_read(it, sizeof(o), &o);
-        obj_loc_parse(o, &loc, &at);
+      VALUE_SET_META(ptr, TYPE_NONE, FLAG_NONE);
+    }
+  }
 
-        value_t result = value_invoke(rt, datatable_getValue(rt->dt, loc, at));
+  VM_FRAME_POINTER(rt->dt) = c->fp;
+  VM_PROGRAM_COUNTER(rt->dt) = c->region.handler;
+  rt->dt->storage[AT_REG].data[0] = c->exception.argument;
 
-        rt->dt->storage[AT_REG].data[0] = result;
+  return depth != -1;
+}
 
-        // @NOTE: reason we are NOT doing value_copyValue() here, is because we want the register value to inherit
-        // all responsibilities of `result` here ... including refcounts, free() obligations...
+// runs `run` from VM_PROGRAM_COUNTER, going on at the handler of whatever
+// is caught. the handler's depth being what the verifier proved it to be,
+// unchecked code stays unchecked.
+static void interpreter_runCatching(interpreter_t *it, void (*run)(interpreter_t*)) {
+  runtime_catch_t c;
+  void (*volatile next)(interpreter_t*) = run;
 
-        break;
+  c.previous = it->rt->catcher;
+  c.image = it->image;
+  it->rt->catcher = &c;
+
+  if (setjmp(c.env) != 0 && !interpreter_catch(it, &c)) {
+    next = interpreter_runSlow;
+  }
+
+  next(it);
+
+  it->rt->catcher = c.previous;
+}
+
+// the verifier's proof assumes a fresh start: offset `pc`, empty stack
+// and the initial storage lengths
+static bool interpreter_atEntry(interpreter_t *it, uint64_t pc) {
+  datatable_t *dt = it->rt->dt;
+
+  return VM_PROGRAM_COUNTER(dt) == pc
+    && VM_DATA_POINTER(dt) == 0
+    && VM_STATIC_DATA_POINTER(dt) == STATIC_DATA_RESERVED
+    && VM_STACK_POINTER(dt) == 0
+    && VM_REG_POINTER(dt) == 0;
+}
+
+void interpreter_run(interpreter_t *it) {
+  if (it->verify == VERIFY_OK && !interpreter_isCounted(it) && interpreter_atEntry(it, 0)) {
+    interpreter_runCatching(it, interpreter_runFast);
+  } else {
+    interpreter_runCatching(it, interpreter_runSlow);
+  }
+}
+
+void interpreter_resume(interpreter_t *it) {
+  if (it->verify == VERIFY_OK && !interpreter_isCounted(it)) {
+    interpreter_runCatching(it, interpreter_runFast);
+  } else {
+    interpreter_runCatching(it, interpreter_runSlow);
+  }
+}
+
+void interpreter_runEntry(interpreter_t *it, uint64_t pc) {
+  interpreter_entry_t *entry = NULL;
+
+  // the few task bodies of a program are looked up linearly
+  for (size_t i = 0; i < it->numEntries && entry == NULL; i++) {
+    if (it->entries[i].pc == pc) {
+      entry = &it->entries[i];
+    }
+  }
+
+  if (entry == NULL) {
+    it->entries = (interpreter_entry_t*)realloc(it->entries, sizeof(interpreter_entry_t) * (it->numEntries + 1));
+    entry = &it->entries[it->numEntries++];
+    entry->pc = pc;
+    entry->verify = verify_entry(it->code, pc, NULL);
+  }
+
+  it->flags = 0;
+  VM_PROGRAM_COUNTER(it->rt->dt) = pc;
+  VM_FRAME_POINTER(it->rt->dt) = 0;
+
+  if (entry->verify == VERIFY_OK && !interpreter_isCounted(it) && interpreter_atEntry(it, pc)) {
+    interpreter_runCatching(it, interpreter_runFast);
+  } else {
+    interpreter_runCatching(it, interpreter_runSlow);
+  }
+}
+
+void interpreter_profile(interpreter_t *it) {
+  if (it->profile == NULL) {
+    it->profile = (uint64_t*)calloc(2 * it->code->count, sizeof(uint64_t));
+  }
+}
+
+bool interpreter_writeProfile(interpreter_t *it, const char *path) {
+  const image_t *image = it->image;
+  uint32_t numSites = 0;
+  uint64_t *counts;
+  FILE *f;
+
+  // -g writes the sites along with the debug section, even if there are none
+  if (image->debug == NULL) {
+    fprintf(stderr, "no profile written: the program has no sites, compile it with -g\n");
+    return false;
+  }
+
+  for (size_t i = 0; i < image->numSites; i++) {
+    bin_site_t site = image_site(image, i);
+
+    if (site.site >= numSites) {
+      numSites = site.site + 1;
+    }
+  }
+
+  // copies of a site add up
+  counts = (uint64_t*)calloc(2 * (size_t)numSites, sizeof(uint64_t));
+
+  for (size_t i = 0; i < image->numSites; i++) {
+    bin_site_t site = image_site(image, i);
+    // a segment never decoded never ran
+    uint32_t index = code_decodedIndexAt(it->code, site.offset);
+
+    if (index != CODE_INVALID_INDEX && it->profile != NULL) {
+      uint64_t ran = it->profile[2 * index];
+      uint64_t taken = it->profile[2 * index + 1];
+
+      counts[2 * site.site] += ran;
+      counts[2 * site.site + 1] += (site.flags & BIN_SITE_INVERTED) ? ran - taken : taken;
+    }
+  }
+
+  if ((f = fopen(path, "w")) == NULL) {
+    fprintf(stderr, "could not write profile to %s\n", path);
+    free(counts);
+    return false;
+  }
+
+  fprintf(f, "%s\n", PROFILE_HEADER);
+
+  for (uint32_t i = 0; i < numSites; i++) {
+    if (counts[2 * i] != 0) {
+      fprintf(f, "%u %llu %llu\n", i, (unsigned long long)counts[2 * i], (unsigned long long)counts[2 * i + 1]);
+    }
+  }
+
+  fclose(f);
+  free(counts);
+
+  return true;
+}
+
+void interpreter_profileInstructions(interpreter_t *it) {
+  if (it->instructions == NULL) {
+    it->instructions = (interpreter_instructions_t*)calloc(1, sizeof(interpreter_instructions_t));
+    it->instructions->counts = (uint64_t*)calloc(it->code->count, sizeof(uint64_t));
+    it->instructions->nanos = (uint64_t*)calloc(it->code->count, sizeof(uint64_t));
+    it->instructions->last = CODE_INVALID_INDEX;
+  }
+
+  // for the jumps taken
+  interpreter_profile(it);
+}
+
+bool interpreter_writeInstructions(interpreter_t *it, const char *path) {
+  interpreter_instructions_t *instructions = it->instructions;
+  FILE *f;
+
+  if (instructions == NULL) {
+    return false;
+  }
+
+  // up to now, to the instruction the program is at
+  if (instructions->last != CODE_INVALID_INDEX) {
+    uint64_t now = runtime_nowNs();
+
+    instructions->nanos[instructions->last] += now - instructions->since;
+    instructions->since = now;
+  }
+
+  if ((f = fopen(path, "w")) == NULL) {
+    fprintf(stderr, "could not write instruction profile to %s\n", path);
+    return false;
+  }
+
+  fprintf(f, "%s %llu\n", INTERPRETER_INSTRUCTIONS_HEADER, (unsigned long long)it->code->len);
+
+  for (size_t i = 0; i < it->code->count; i++) {
+    if (instructions->counts[i] != 0) {
+      fprintf(f, "%u %llu %llu %llu\n", it->code->instructions[i].offset, (unsigned long long)instructions->counts[i],
+        (unsigned long long)it->profile[2 * i + 1], (unsigned long long)instructions->nanos[i]);
+    }
+  }
+
+  fclose(f);
+
+  return true;
+}
+
+void interpreter_profileOpcodes(interpreter_t *it) {
+  if (it->opcodes == NULL) {
+    it->opcodes = (interpreter_opcodes_t*)calloc(1, sizeof(interpreter_opcodes_t));
+    it->opcodes->last = CODE_OP_COUNT;
+  }
+}
+
+// for interpreter_writeOpcodes, by their names in the source, lowercase
+#define INTERPRETER_BINOP_NAMES(name, op) \
+  [CODE_OP_##op##_I64] = name, \
+  [CODE_OP_##op##_F64_L] = name ".f64_l", \
+  [CODE_OP_##op##_F64_R] = name ".f64_r", \
+  [CODE_OP_##op##_F64_LR] = name ".f64_lr", \
+  [CODE_OP_##op##_I64_IMM] = name ".imm", \
+  [CODE_OP_##op##_F64_L_IMM] = name ".f64_l.imm", \
+  [CODE_OP_##op##_F64_R_IMM] = name ".f64_r.imm", \
+  [CODE_OP_##op##_F64_LR_IMM] = name ".f64_lr.imm"
+
+static const char *const interpreter_opcodeNames[CODE_OP_COUNT] = {
+  [OP_NOOP] = "noop",
+  [OP_LOAD] = "load",
+  [OP_MOV] = "mov",
+  [OP_TAKE] = "take",
+  [OP_CMP] = "cmp",
+  [OP_JMP] = "jmp",
+  [OP_PUSH] = "push",
+  [OP_POP] = "pop",
+  [OP_ADD] = "add",
+  [OP_SUB] = "sub",
+  [OP_MUL] = "mul",
+  [OP_DIV] = "div",
+  [OP_MOD] = "mod",
+  [OP_XOR] = "xor",
+  [OP_AND] = "and",
+  [OP_OR] = "or",
+  [OP_SHL] = "shl",
+  [OP_SHR] = "shr",
+  [OP_NEG] = "neg",
+  [OP_NOT] = "not",
+  [OP_CALL] = "call",
+  [OP_PRINT] = "print",
+  [OP_CMPJ] = "cmpj",
+  [OP_CMPJ_IMM] = "cmpj.imm",
+  [OP_CONST] = "const",
+  [OP_SPAWN] = "spawn",
+  [OP_YIELD] = "yield",
+  [OP_JOIN] = "join",
+  [OP_FCALL] = "fcall",
+  [OP_RET] = "ret",
+  [OP_JIT] = "jit",
+  [OP_HALT] = "halt",
+  INTERPRETER_BINOP_NAMES("add", ADD),
+  INTERPRETER_BINOP_NAMES("sub", SUB),
+  INTERPRETER_BINOP_NAMES("mul", MUL),
+  INTERPRETER_BINOP_NAMES("div", DIV),
+  [CODE_OP_MOD_I64] = "mod",
+  [CODE_OP_MOD_I64_IMM] = "mod.imm",
+  [CODE_OP_CMP_IMM] = "cmp.imm",
+  [CODE_OP_XOR_IMM] = "xor.imm",
+  [CODE_OP_AND_IMM] = "and.imm",
+  [CODE_OP_OR_IMM] = "or.imm",
+  [CODE_OP_SHL_IMM] = "shl.imm",
+  [CODE_OP_SHR_IMM] = "shr.imm",
+  [CODE_OP_GETFIELD] = "getfield",
+  [CODE_OP_SETFIELD] = "setfield",
+  [CODE_OP_SETCC] = "setcc",
+  [CODE_OP_SELECT] = "select",
+  [CODE_OP_SWITCH] = "switch",
+  [CODE_OP_SEGMENT] = "segment"
+};
+
+#undef INTERPRETER_BINOP_NAMES
+
+const char *interpreter_opcodeName(uint16_t opcode) {
+  return opcode < CODE_OP_COUNT && interpreter_opcodeNames[opcode] != NULL ? interpreter_opcodeNames[opcode] : "?";
+}
+
+// a count of interpreter_writeOpcodes, with what it counts: an opcode and
+// its flags, or the opcodes of a pair
+typedef struct interpreter_opcode_count {
+  uint64_t count;
+  uint16_t first;
+  uint16_t second;
+} interpreter_opcode_count_t;
+
+// most first, then in opcode order
+static int interpreter_compareOpcodeCounts(const void *a, const void *b) {
+  const interpreter_opcode_count_t *l = (const interpreter_opcode_count_t*)a;
+  const interpreter_opcode_count_t *r = (const interpreter_opcode_count_t*)b;
+
+  if (l->count != r->count) {
+    return l->count < r->count ? 1 : -1;
+  }
+
+  if (l->first != r->first) {
+    return l->first < r->first ? -1 : 1;
+  }
+
+  return l->second < r->second ? -1 : (l->second > r->second);
+}
+
+void interpreter_writeOpcodes(interpreter_t *it, FILE *f) {
+  const interpreter_opcodes_t *opcodes = it->opcodes;
+  interpreter_opcode_count_t *counts;
+  size_t numCounts = 0, numPairs = 0;
+  uint64_t total = 0, totalPairs = 0;
+
+  if (opcodes == NULL) {
+    return;
+  }
+
+  // the larger of the two tables
+  counts = (interpreter_opcode_count_t*)malloc(sizeof(interpreter_opcode_count_t) * CODE_OP_COUNT * 256);
+
+  for (uint16_t op = 0; op < CODE_OP_COUNT; op++) {
+    for (uint16_t flags = 0; flags < 256; flags++) {
+      if (opcodes->counts[op][flags] != 0) {
+        counts[numCounts++] = (interpreter_opcode_count_t) { opcodes->counts[op][flags], op, flags };
+        total += opcodes->counts[op][flags];
       }
+    }
+  }
 
-      case OP_PRINT: {
-        obj_loc_t o;
-        loc_28_t loc;
-        archtype_t at;
-
-        interpreter_read(it, sizeof(o), &o);
-        obj_loc_parse(o, &loc, &at);
-
-        value_t *v = datatable_getValue(rt->dt, loc, at);
-
-        switch (value_getType(v)) {
-          case TYPE_NONE:
-            printf("none");
-            break;
-          case TYPE_INT:
-            printf("%d", value_getInt(v));
-            break;
-          case TYPE_UINT:
-            printf("%zu", value_getUint(v));
-            break;
-          case TYPE_DOUBLE:
-            printf("%0.f", value_getDouble(v));
-            break;
-          case TYPE_BOOLEAN:
-            printf(value_getBoolean(v) ? "true" : "false");
-            break;
-          default:
-            printf("%p", value_getRawPointer(v));
-            break;
-        }
+  qsort(counts, numCounts, sizeof(interpreter_opcode_count_t), interpreter_compareOpcodeCounts);
 
-        break;
+  fprintf(f, "opcodes: %llu instructions run\n", (unsigned long long)total);
+
+  for (size_t i = 0; i < numCounts; i++) {
+    fprintf(f, "  %-20s flags 0x%02x %16llu %6.2f%%\n", interpreter_opcodeName(counts[i].first), counts[i].second,
+      (unsigned long long)counts[i].count, 100.0 * (double)counts[i].count / (double)total);
+  }
+
+  for (uint16_t first = 0; first < CODE_OP_COUNT; first++) {
+    for (uint16_t second = 0; second < CODE_OP_COUNT; second++) {
+      if (opcodes->pairs[first][second] != 0) {
+        counts[numPairs++] = (interpreter_opcode_count_t) { opcodes->pairs[first][second], first, second };
+        totalPairs += opcodes->pairs[first][second];
       }
+    }
+  }
+
+  qsort(counts, numPairs, sizeof(interpreter_opcode_count_t), interpreter_compareOpcodeCounts);
+
+  fprintf(f, "pairs: %llu\n", (unsigned long long)totalPairs);
+
+  for (size_t i = 0; i < numPairs; i++) {
+    fprintf(f, "  %-20s %-20s %16llu %6.2f%%\n", interpreter_opcodeName(counts[i].first), interpreter_opcodeName(counts[i].second),
+      (unsigned long long)counts[i].count, 100.0 * (double)counts[i].count / (double)totalPairs);
+  }
+
+  free(counts);
+}
+
+// by offset, for interpreter_profileBlocks
+static int interpreter_compareOffsets(const void *a, const void *b) {
+  uint64_t l = *(const uint64_t*)a, r = *(const uint64_t*)b;
+
+  return l < r ? -1 : (l > r);
+}
+
+void interpreter_profileBlocks(interpreter_t *it, bool calls) {
+  const image_t *image = it->image;
+  interpreter_blocks_t *blocks;
+  uint64_t *offsets, offset;
+  size_t numOffsets = 0, pos = 0;
+  const char *name;
+  uint32_t nameLen;
+
+  if (it->blocks != NULL) {
+    it->blocks->calls |= calls;
+    return;
+  }
+
+  // every label, named or not, and the start of the code
+  offsets = (uint64_t*)malloc(sizeof(uint64_t) * (image->numLabels + 1));
+  offsets[numOffsets++] = 0;
+
+  for (size_t i = 0; i < image->numLabels; i++) {
+    offsets[numOffsets++] = image_label(image, i).offset;
+  }
+
+  while (image_debugLabel(image, &pos, &offset, &name, &nameLen)) {
+    offsets = (uint64_t*)realloc(offsets, sizeof(uint64_t) * (numOffsets + 1));
+    offsets[numOffsets++] = offset;
+  }
 
-      // ...
+  // a direct jump's target has no label left, as with a rotated loop.
+  // the whole code is decoded for it, segments or not.
+  code_ensure(it->code, 0, (uint32_t)it->code->count);
 
-      case OP_JIT: {
-        assert(false && "JIT unimplemented");
-#if 0
-        // @jit_begin("sum", memoized=true, args=1)
-        // ... some instructions
-        // @jit_end ; internally -- tags `sum` as $d6
+  for (size_t i = 0; i < it->code->count; i++) {
+    const instruction_t *ins = &it->code->instructions[i];
 
-        // -> OP_JIT JIT_FLAG_BEGIN | JIT_FLAG_MEMOIZE ; memoize for when fn is called ?? idk
-        // ->   1 ; args to hash for memoize
-        // ->   $d6 ; location of native fn to store at
-        // -> ... some instructions
-        // -> OP_JIT JIT_FLAG_END
+    if (CODE_DIRECT_JUMP(ins)) {
+      offsets = (uint64_t*)realloc(offsets, sizeof(uint64_t) * (numOffsets + 1));
+      offsets[numOffsets++] = ins->target.loc;
+    }
+  }
 
-        // ; raw, unoptimized code
+  qsort(offsets, numOffsets, sizeof(uint64_t), interpreter_compareOffsets);
 
-        // -> OP_CALL #{_System_arrayCreate} ; construct an array -- now stored in $r0
-        // -> OP_PUSH $r0 ; push new array to stack -- stored as local variable
+  blocks = (interpreter_blocks_t*)calloc(1, sizeof(interpreter_blocks_t));
+  blocks->blocks = (interpreter_block_t*)calloc(numOffsets, sizeof(interpreter_block_t));
+  blocks->calls = calls;
 
-        // -> OP_PUSH $s[-1] ; push last stack item to top, duplicating
-        // -> OP_LOAD | CONST_FLAG_U64 $r0 0
-        // -> OP_PUSH $r0 ; push 0 to stack
-        // -> OP_LOAD | CONST_FLAG_F64 $r0 3.5
-        // -> OP_PUSH $r0 ; push 3.5 to stack
-        // -> OP_CALL #{_System_arraySetIndex} ; set array[0] to 3.5
-        // -> OP_POP 3
+  for (size_t i = 0; i < numOffsets; i++) {
+    if (blocks->numBlocks == 0 || blocks->blocks[blocks->numBlocks - 1].offset != offsets[i]) {
+      blocks->blocks[blocks->numBlocks++].offset = offsets[i];
+    }
+  }
 
-        // -> OP_PUSH $s[-1] ; push last stack item to top, duplicating
-        // -> OP_LOAD | CONST_FLAG_U64 $r0 0
-        // -> OP_PUSH $r0 ; push 0 to stack
-        // -> OP_LOAD | CONST_FLAG_F64 $r0 4.6
-        // -> OP_PUSH $r0 ; push 4.6 to stack
-        // -> OP_CALL #{_System_arraySetIndex} ; set array[0] to 4.6
-        // -> OP_POP 3
+  for (size_t i = 0; i < blocks->numBlocks; i++) {
+    blocks->blocks[i].end = i + 1 < blocks->numBlocks ? blocks->blocks[i + 1].offset : UINT64_MAX;
+  }
 
-        // -> OP_CALL #{sum} ; call native fn
+  // the first name given to a block's offset. a block starts with its
+  // offset, so the offsets' comparison finds it
+  pos = 0;
 
-        // =====
-        // ; optimized, first pass
+  while (image_debugLabel(image, &pos, &offset, &name, &nameLen)) {
+    interpreter_block_t *block = (interpreter_block_t*)bsearch(&offset, blocks->blocks, blocks->numBlocks,
+      sizeof(interpreter_block_t), interpreter_compareOffsets);
 
-        // -> OP_CALL #{_System_arrayCreate} ; construct an array -- now stored in $r0
-        // -> OP_PUSH $r0 ; push new array to stack -- stored as local variable
+    if (block != NULL && block->name == NULL) {
+      block->name = name;
+      block->nameLen = nameLen;
+    }
+  }
 
-        // -> OP_PUSH $s[-1] ; push last stack item to top, duplicating
-        // -> OP_PUSH | CONST_FLAG_U64 0
-        // -> OP_PUSH | CONST_FLAG_F64 3.5 ; push 3.5 to stack
-        // -> OP_CALL #{_System_arraySetIndex} ; set array[0] to 3.5
-        // -> OP_POP 3
+  free(offsets);
+  it->blocks = blocks;
+}
 
-        // -> OP_PUSH $s[-1] ; push last stack item to top, duplicating
-        // -> OP_PUSH | CONST_FLAG_U64 0 ; push 0 to stack
-        // -> OP_PUSH | CONST_FLAG_F64 4.6 ; push 4.6 to stack
-        // -> OP_CALL #{_System_arraySetIndex} ; set array[0] to 4.6
-        // -> OP_POP 3
+static void interpreter_freeBlocks(interpreter_blocks_t *blocks) {
+  if (blocks == NULL) {
+    return;
+  }
 
-        // -> OP_CALL #{sum} ; call native fn
+  for (size_t i = 0; i < blocks->numBlocks; i++) {
+    interpreter_block_call_t *call = blocks->blocks[i].calls;
 
+    while (call != NULL) {
+      interpreter_block_call_t *next = call->next;
 
-        // built a native_function_t jitFunction_<addr>
-        // @todo: function memoization? maybe have an argument for X number of stack parameters
-        // to take a hash of and lookup a memoized function based on this?
+      free(call);
+      call = next;
+    }
+  }
 
-        native_function_t jitFunction;
+  free(blocks->blocks);
+  free(blocks);
+}
 
-        if (flags & JIT_FLAG_BEGIN) { // begin
-          char *buf; // C source code buffer?
-          uint8_t jitOp = OP_JIT;
-          uint8_t jitFlags = flags;
+// most time first, then in order of offset
+static int interpreter_compareBlocks(const void *a, const void *b) {
+  const interpreter_block_t *l = *(const interpreter_block_t *const*)a;
+  const interpreter_block_t *r = *(const interpreter_block_t *const*)b;
 
+  if (l->nanos != r->nanos) {
+    return l->nanos < r->nanos ? 1 : -1;
+  }
 
-          // set hash to be hash of (it->pc)
-          // as well as hashcode of X number of stack items
-          // this could be useful for memoizing function arguments
-          //char hash[64];
+  return l->offset < r->offset ? -1 : (l->offset > r->offset);
+}
 
-          // while (!interpreter_atEnd(it)) {
-          //   interpreter_read(it, &jitOp, &jitFlags);
+void interpreter_writeBlocks(interpreter_t *it, FILE *f) {
+  interpreter_blocks_t *blocks = it->blocks;
+  interpreter_block_t **ran;
+  size_t numRan = 0;
+  uint64_t total = 0;
+  char source[512];
 
-          //   if (flags & JIT_FLAG_MEMOIZE) {
-          //     jit_buildMemoized(rt->jit, jitOp, jitFlags, &buf);
-          //   } else {
-          //     // default -- does not expand CMP and conditionals
-          //     jit_build(rt->jit, jitOp, jitFlags, &buf);
-          //   }
-          // }
+  if (blocks == NULL) {
+    return;
+  }
 
-          // interpreter_runJit(it);
+  // up to now, in the block the program is in
+  if (blocks->current != NULL) {
+    uint64_t now = runtime_nowNs();
 
-          // first pass, run C compiler, load obj file, lookup function `jitFunction_<hash>`
+    blocks->current->nanos += now - blocks->since;
+    blocks->since = now;
+  }
 
+  ran = (interpreter_block_t**)malloc(sizeof(interpreter_block_t*) * blocks->numBlocks);
 
-          // jitmap_set(rt->jit->map, )
-        }
+  for (size_t i = 0; i < blocks->numBlocks; i++) {
+    if (blocks->blocks[i].entries != 0) {
+      ran[numRan++] = &blocks->blocks[i];
+      total += blocks->blocks[i].nanos;
+    }
+  }
 
-        // move value_t to static data that holds jitFunction
+  qsort(ran, numRan, sizeof(interpreter_block_t*), interpreter_compareBlocks);
 
-#endif
+  fprintf(f, "blocks: %.3f ms\n", total / 1e6);
+  fprintf(f, "  %10s %6s %12s  %-24s %s\n", "ms", "%", "entries", "block", "source");
 
-        break;
+  for (size_t i = 0; i < numRan; i++) {
+    const interpreter_block_t *block = ran[i];
+    char label[32];
+
+    if (block->name == NULL) {
+      snprintf(label, sizeof(label), "@%llu", (unsigned long long)block->offset);
+    }
+
+    if (image_formatSource(it->image, block->offset, source, sizeof(source)) == 0) {
+      source[0] = '\0';
+    }
+
+    fprintf(f, "  %10.3f %6.2f %12llu  %-24.*s %s\n", block->nanos / 1e6,
+      total != 0 ? 100.0 * (double)block->nanos / (double)total : 0.0, (unsigned long long)block->entries,
+      block->name != NULL ? (int)block->nameLen : (int)strlen(label), block->name != NULL ? block->name : label, source);
+
+    for (const interpreter_block_call_t *call = block->calls; call != NULL; call = call->next) {
+      const char *callName = builtins_name(call->fn);
+
+      fprintf(f, "  %10.3f %6.2f %12llu    -> %s\n", call->nanos / 1e6,
+        total != 0 ? 100.0 * (double)call->nanos / (double)total : 0.0, (unsigned long long)call->count,
+        callName != NULL ? callName : "<native>");
+    }
+  }
+
+  free(ran);
+}
+
+void interpreter_profileSamples(interpreter_t *it) {
+  if (it->samples == NULL) {
+    it->samples = (interpreter_samples_t*)calloc(1, sizeof(interpreter_samples_t));
+  }
+}
+
+void interpreter_sample(interpreter_t *it) {
+  interpreter_samples_t *samples = it->samples;
+  instruction_t *at = it->sampleAt;
+  native_function_t fn = it->sampleFn;
+  bool native = it->sampleNative;
+  uint64_t offset, hash;
+
+  if (samples == NULL || at == NULL) {
+    return;
+  }
+
+  offset = at->offset + 1;
+  hash = (offset ^ ((uint64_t)(uintptr_t)fn >> 4) ^ (native ? 0x9e3779b97f4a7c15ull : 0)) * 0x9e3779b97f4a7c15ull;
+
+  for (size_t i = 0; i < INTERPRETER_MAX_SAMPLES; i++) {
+    interpreter_sample_t *sample = &samples->entries[(hash + i) & (INTERPRETER_MAX_SAMPLES - 1)];
+
+    if (sample->offset == 0) {
+      sample->offset = offset;
+      sample->fn = fn;
+      sample->native = native;
+    } else if (sample->offset != offset || sample->fn != fn || sample->native != native) {
+      continue;
+    }
+
+    sample->count++;
+    return;
+  }
+
+  samples->dropped++;
+}
+
+void interpreter_writeSamples(interpreter_t *it, FILE *f) {
+  interpreter_samples_t *samples = it->samples;
+  char frames[1024];
+
+  if (samples == NULL) {
+    return;
+  }
+
+  for (size_t i = 0; i < INTERPRETER_MAX_SAMPLES; i++) {
+    const interpreter_sample_t *sample = &samples->entries[i];
+    uint64_t offset = sample->offset - 1;
+
+    if (sample->offset == 0) {
+      continue;
+    }
+
+    if (image_formatSourceFrames(it->image, offset, frames, sizeof(frames)) == 0) {
+      snprintf(frames, sizeof(frames), "@%llu", (unsigned long long)offset);
+    }
+
+    fputs(frames, f);
+
+    if (sample->native) {
+      fputs(";[compiled]", f);
+    } else if (sample->fn != NULL) {
+      const char *name = builtins_name(sample->fn);
+
+      fprintf(f, ";%s", name != NULL ? name : "<native>");
+    }
+
+    fprintf(f, " %llu\n", (unsigned long long)sample->count);
+  }
+
+  if (samples->dropped != 0) {
+    fprintf(stderr, "warning: %llu samples dropped, past %d places\n",
+      (unsigned long long)samples->dropped, INTERPRETER_MAX_SAMPLES);
+  }
+}
+
+void interpreter_traceRing(interpreter_t *it, size_t size) {
+  uint64_t capacity = 1;
+
+  if (it->ring != NULL) {
+    return;
+  }
+
+  while (capacity < size) {
+    capacity <<= 1;
+  }
+
+  it->ring = (interpreter_ring_t*)calloc(1, sizeof(interpreter_ring_t));
+  it->ring->entries = (uint64_t*)calloc(capacity, sizeof(uint64_t));
+  it->ring->mask = capacity - 1;
+  it->rt->traced = it;
+}
+
+// a named label, for interpreter_writeRing; by offset, first, as
+// interpreter_compareOffsets compares
+typedef struct interpreter_ring_label {
+  uint64_t offset;
+  const char *name;
+  uint32_t nameLen;
+} interpreter_ring_label_t;
+
+// for interpreter_writeRing
+static const char *interpreter_archtypeName(archtype_t at) {
+  switch (at) {
+    case 0: return "-";
+    case AT_REG | AT_ABS: case AT_REG | AT_REL: case AT_REG: return "reg";
+    case AT_LOCAL | AT_ABS: case AT_LOCAL: return "local";
+    case AT_LOCAL | AT_REL: return "stack";
+    case AT_FRAME: return "frame";
+    case AT_DATA | AT_ABS: case AT_DATA | AT_REL: case AT_DATA: return "data";
+    case AT_CODE: return "code";
+    default: return "?";
+  }
+}
+
+void interpreter_writeRing(const interpreter_t *it, FILE *f) {
+  const interpreter_ring_t *ring = it->ring;
+  interpreter_ring_label_t *labels = NULL;
+  size_t numLabels = 0, capLabels = 0, pos = 0;
+  uint64_t first, offset;
+  const char *name;
+  uint32_t nameLen;
+  char source[512];
+
+  if (ring == NULL) {
+    return;
+  }
+
+  // the named labels, in order of offset, for the one each instruction is under
+  while (image_debugLabel(it->image, &pos, &offset, &name, &nameLen)) {
+    if (numLabels == capLabels) {
+      capLabels = capLabels != 0 ? capLabels * 2 : 64;
+      labels = (interpreter_ring_label_t*)realloc(labels, sizeof(interpreter_ring_label_t) * capLabels);
+    }
+
+    labels[numLabels].offset = offset;
+    labels[numLabels].name = name;
+    labels[numLabels].nameLen = nameLen;
+    numLabels++;
+  }
+
+  if (numLabels != 0) {
+    qsort(labels, numLabels, sizeof(interpreter_ring_label_t), interpreter_compareOffsets);
+  }
+
+  first = ring->next > ring->mask + 1 ? ring->next - (ring->mask + 1) : 0;
+
+  fprintf(f, "last %llu of %llu instructions, oldest first:\n",
+    (unsigned long long)(ring->next - first), (unsigned long long)ring->next);
+  fprintf(f, "  %10s  %-16s %5s  %-6s %-6s  %-24s %s\n", "offset", "opcode", "flags", "left", "right", "label", "source");
+
+  for (uint64_t i = first; i < ring->next; i++) {
+    const uint64_t entry = ring->entries[i & ring->mask];
+    const uint32_t at = (uint32_t)entry;
+    const uint8_t opcode = (uint8_t)(entry >> 32);
+    const char *opName = opcode < CODE_OP_COUNT ? interpreter_opcodeNames[opcode] : NULL;
+    const interpreter_ring_label_t *label = NULL;
+    size_t lo = 0, hi = numLabels;
+
+    // the last label at or before it
+    while (lo < hi) {
+      size_t mid = lo + (hi - lo) / 2;
+
+      if (labels[mid].offset <= at) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
       }
+    }
 
-      case OP_HALT:
-        exit(0);
-        break;
+    if (lo != 0) {
+      label = &labels[lo - 1];
+    }
+
+    if (image_formatSource(it->image, at, source, sizeof(source)) == 0) {
+      source[0] = '\0';
     }
+
+    fprintf(f, "  %10u  %-16s  0x%02x  %-6s %-6s  %-24.*s %s\n", at, opName != NULL ? opName : "?",
+      (unsigned int)(uint8_t)(entry >> 40),
+      interpreter_archtypeName((archtype_t)(entry >> 48)), interpreter_archtypeName((archtype_t)(entry >> 56)),
+      label != NULL ? (int)label->nameLen : 0, label != NULL ? label->name : "", source);
   }
+
+  free(labels);
 }
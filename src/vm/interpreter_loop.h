@@ -0,0 +1,1028 @@
+// body of interpreter_run, included five times by interpreter.c:
+// INTERPRETER_CHECKED 0 -- for code that passed verify_code; operands,
+//   push and pop are trusted to stay in bounds.
+// INTERPRETER_CHECKED 1 -- bounds checked; a violation stops the
+//   program through interpreter_fail.
+// INTERPRETER_RECORDING 1 -- unchecked, and appends every instruction
+//   to it->trace until a jump returns to its header, see
+//   interpreter_recordTrace. returns instead of running a halt, OP_JIT or
+//   entering an undecoded segment.
+// INTERPRETER_PROFILED 1 -- checked, and counts each instruction's opcode
+//   and flags, and the opcode before it, see interpreter_profileOpcodes,
+//   times the blocks it runs, see interpreter_profileBlocks, records it
+//   in the ring, see interpreter_traceRing, and times it on its own, see
+//   interpreter_profileInstructions.
+// INTERPRETER_METERED 0 -- unchecked, and neither ticks, times calls
+//   nor notes where the program went, for a runtime that has no use for
+//   it, see interpreter_isMetered. returns with it->remeter set, for the
+//   metered loop to go on, once a call made it of use.
+// INTERPRETER_RUN names the function being defined.
+// every mode stops at runtime_safepoint on taken jumps, OP_CALL, OP_FCALL
+// and OP_RET, and all metered ones but recording tick there, see
+// runtime_setBudget, and note where the program went for
+// interpreter_sample. checked code also counts jumps and calls, with
+// interpreter_profile, and every metered mode times OP_CALL for vm
+// --trace-calls, see vm/calls.h.
+
+#undef OPERAND
+#undef INTERPRETER_JUMP_OFFSET
+#undef INTERPRETER_DEPTH
+#undef INTERPRETER_SET_DEPTH
+#undef INTERPRETER_FILL
+
+#undef INTERPRETER_BACK_EDGE
+#undef INTERPRETER_SEEN
+#undef INTERPRETER_RECORD
+#undef INTERPRETER_TICK
+#undef INTERPRETER_PROFILE
+#undef INTERPRETER_COUNT
+#undef INTERPRETER_TIMES_CALLS
+#undef INTERPRETER_SAMPLE
+
+// the byte offset a jump goes to, held in the instruction itself for a
+// direct jump (see CODE_DIRECT_JUMP)
+#define INTERPRETER_JUMP_OFFSET() \
+  (CODE_DIRECT_JUMP(ins) ? (uint64_t)ins->target.loc : value_getUint(OPERAND(ins->target)))
+
+#if INTERPRETER_CHECKED
+  // the stack's length, in memory alone: checked code may write $sp as
+  // any other operand
+  #define INTERPRETER_DEPTH (*stackLen)
+  #define INTERPRETER_SET_DEPTH(n) (*stackLen = (n))
+  #define INTERPRETER_FILL()
+#else
+  // the stack's length, kept in `depth` as well as at *stackLen: set
+  // through both, so that operands, the collector and builtins see it in
+  // memory, and read from the register. read back (filled) after what may
+  // push or pop behind the loop's back: calls, compiled code and switches
+  // of fibers. verified code changes $sp only through CODE_OP_STACK_IMM.
+  #define INTERPRETER_DEPTH depth
+  #define INTERPRETER_SET_DEPTH(n) (*stackLen = depth = (n))
+  #define INTERPRETER_FILL() (depth = *stackLen)
+#endif
+
+#if INTERPRETER_METERED
+  #define INTERPRETER_TIMES_CALLS() interpreter_timesCalls(it)
+  #define INTERPRETER_SAMPLE(field, value) (it->field = (value))
+#else
+  #define INTERPRETER_TIMES_CALLS() false
+  #define INTERPRETER_SAMPLE(field, value)
+#endif
+
+#if INTERPRETER_RECORDING || !INTERPRETER_METERED
+  // bounded by JIT_TRACE_MAX, and a budgeted runtime never records; nor
+  // does an unmetered loop run one
+  #define INTERPRETER_TICK()
+#else
+  // after a taken jump or a call, `ip` being where the program goes on
+  #define INTERPRETER_TICK() \
+    do { \
+      if (--rt->fuel <= 0) { \
+        if (!interpreter_outOfFuel(it, ins, &ip)) { \
+          INTERPRETER_SYNC_PC(); \
+          return; \
+        } \
+        INTERPRETER_FILL(); \
+      } \
+      it->sampleAt = ip; \
+    } while (0)
+#endif
+
+#if INTERPRETER_CHECKED
+  #define OPERAND(o) interpreter_checkedOperand(it, ins, &(o))
+  #define INTERPRETER_BACK_EDGE()
+  #define INTERPRETER_SEEN(i, v)
+  // with interpreter_profile: `ins` ran, and jumped if `taken`
+  #define INTERPRETER_PROFILE(taken) \
+    do { \
+      if (it->profile != NULL) { \
+        uint64_t *counts = &it->profile[2 * (ins - it->code->instructions)]; \
+        counts[0]++; \
+        counts[1] += (taken) ? 1 : 0; \
+      } \
+    } while (0)
+#elif INTERPRETER_RECORDING
+  #define OPERAND(o) CODE_OPERAND_VALUE(o)
+  // the trace is complete once a taken jump goes back to its header
+  #define INTERPRETER_BACK_EDGE() \
+    do { \
+      if (ip == &it->code->instructions[it->trace->header]) { \
+        it->trace->complete = true; \
+        INTERPRETER_SYNC_PC(); \
+        return; \
+      } \
+    } while (0)
+  #define INTERPRETER_SEEN(i, v) (ins->seen[i] |= code_seen(v))
+#else
+  #define OPERAND(o) CODE_OPERAND_VALUE(o)
+  // after a taken jump: counts backward jumps to their target, and enters
+  // the compiled loop at its header once it is hot
+  #define INTERPRETER_BACK_EDGE() \
+    do { \
+      if (ip <= ins && ++ip->hits >= it->hotLoop && it->hotLoop != 0) { \
+        INTERPRETER_SYNC_PC(); \
+        ip = interpreter_enterLoop(it, ins, ip); \
+        INTERPRETER_FILL(); \
+      } \
+    } while (0)
+  // type feedback for the JIT, only unchecked code is compiled
+  #define INTERPRETER_SEEN(i, v) (ins->seen[i] |= code_seen(v))
+#endif
+
+#if !INTERPRETER_CHECKED
+  #define INTERPRETER_PROFILE(taken)
+#endif
+
+#if INTERPRETER_PROFILED
+  // before each instruction
+  #define INTERPRETER_COUNT() \
+    do { \
+      interpreter_opcodes_t *opcodes = it->opcodes; \
+      interpreter_block_t *block = it->blocks != NULL ? it->blocks->current : NULL; \
+      interpreter_ring_t *ring = it->ring; \
+      if (ring != NULL) { \
+        ring->entries[ring->next++ & ring->mask] = INTERPRETER_RING_ENTRY(ins); \
+      } \
+      if (opcodes != NULL) { \
+        opcodes->counts[ins->opcode][ins->flags]++; \
+        if (opcodes->last != CODE_OP_COUNT) { \
+          opcodes->pairs[opcodes->last][ins->opcode]++; \
+        } \
+        opcodes->last = ins->opcode; \
+      } \
+      if (it->instructions != NULL) { \
+        interpreter_countInstruction(it, ins); \
+      } \
+      if (it->blocks != NULL && (block == NULL || ins->offset == block->offset \
+          || ins->offset < block->offset || ins->offset >= block->end)) { \
+        interpreter_enterBlock(it, ins->offset); \
+      } \
+    } while (0)
+#else
+  #define INTERPRETER_COUNT()
+#endif
+
+#if INTERPRETER_RECORDING
+  // before each instruction: gives up, leaving `ins` to the caller, where
+  // a trace cannot continue
+  #define INTERPRETER_RECORD() \
+    do { \
+      if (ins->opcode == OP_HALT || ins->opcode == OP_JIT || ins->opcode == CODE_OP_SEGMENT \
+          || ins->opcode == OP_SPAWN || ins->opcode == OP_YIELD || ins->opcode == OP_JOIN \
+          || ins->opcode == OP_FCALL || ins->opcode == OP_RET \
+          || it->trace->len == JIT_TRACE_MAX) { \
+        ip = ins; \
+        INTERPRETER_SYNC_PC(); \
+        return; \
+      } \
+      it->trace->path[it->trace->len++] = (uint32_t)(ins - it->code->instructions); \
+    } while (0)
+#else
+  #define INTERPRETER_RECORD()
+#endif
+
+void INTERPRETER_RUN(interpreter_t *it) {
+  runtime_t *rt = it->rt;
+
+  // the stack's storage never moves, see datatable_create. its length is
+  // INTERPRETER_DEPTH; the values stay in their slots, where operands
+  // address them.
+  value_t *const stackData = rt->dt->storage[AT_LOCAL].data;
+  uint64_t *const stackLen = rt->dt->storage[AT_LOCAL].lenVal;
+#if INTERPRETER_CHECKED
+  const size_t stackCount = rt->dt->storage[AT_LOCAL].count;
+#else
+  uint64_t depth = *stackLen;
+#endif
+
+  // `ins` is the instruction being executed, `ip` the next one
+  instruction_t *ins;
+  instruction_t *ip = &it->code->instructions[code_indexOf(it->code, VM_PROGRAM_COUNTER(rt->dt))];
+
+  INTERPRETER_SAMPLE(sampleAt, ip);
+
+#if INTERPRETER_THREADED
+  static void *dispatchTable[CODE_OP_COUNT] = {
+    [0 ... CODE_OP_COUNT - 1] = &&lbl_OP_NOOP,
+    [OP_LOAD] = &&lbl_OP_LOAD,
+    [OP_MOV] = &&lbl_OP_MOV,
+    [OP_TAKE] = &&lbl_OP_TAKE,
+    [OP_CMP] = &&lbl_OP_CMP,
+    [OP_JMP] = &&lbl_OP_JMP,
+    [OP_PUSH] = &&lbl_OP_PUSH,
+    [OP_POP] = &&lbl_OP_POP,
+    [OP_XOR] = &&lbl_OP_XOR,
+    [OP_AND] = &&lbl_OP_AND,
+    [OP_OR] = &&lbl_OP_OR,
+    [OP_SHL] = &&lbl_OP_SHL,
+    [OP_SHR] = &&lbl_OP_SHR,
+    [OP_NEG] = &&lbl_OP_NEG,
+    [OP_NOT] = &&lbl_OP_NOT,
+    [OP_CALL] = &&lbl_OP_CALL,
+    [OP_PRINT] = &&lbl_OP_PRINT,
+    [OP_CMPJ] = &&lbl_OP_CMPJ,
+    [OP_CMPJ_IMM] = &&lbl_OP_CMPJ_IMM,
+    [OP_JIT] = &&lbl_OP_JIT,
+    [OP_SPAWN] = &&lbl_OP_SPAWN,
+    [OP_YIELD] = &&lbl_OP_YIELD,
+    [OP_JOIN] = &&lbl_OP_JOIN,
+    [OP_FCALL] = &&lbl_OP_FCALL,
+    [OP_RET] = &&lbl_OP_RET,
+    [OP_HALT] = &&lbl_OP_HALT,
+
+    INTERPRETER_BINOP_LABELS(CODE_OP_ADD),
+    INTERPRETER_BINOP_LABELS(CODE_OP_SUB),
+    INTERPRETER_BINOP_LABELS(CODE_OP_MUL),
+    INTERPRETER_BINOP_LABELS(CODE_OP_DIV),
+    [CODE_OP_MOD_I64] = &&lbl_CODE_OP_MOD_I64,
+    [CODE_OP_MOD_I64_IMM] = &&lbl_CODE_OP_MOD_I64_IMM,
+    [CODE_OP_CMP_IMM] = &&lbl_CODE_OP_CMP_IMM,
+    [CODE_OP_XOR_IMM] = &&lbl_CODE_OP_XOR_IMM,
+    [CODE_OP_AND_IMM] = &&lbl_CODE_OP_AND_IMM,
+    [CODE_OP_OR_IMM] = &&lbl_CODE_OP_OR_IMM,
+    [CODE_OP_SHL_IMM] = &&lbl_CODE_OP_SHL_IMM,
+    [CODE_OP_SHR_IMM] = &&lbl_CODE_OP_SHR_IMM,
+    [CODE_OP_GETFIELD] = &&lbl_CODE_OP_GETFIELD,
+    [CODE_OP_SETFIELD] = &&lbl_CODE_OP_SETFIELD,
+    [CODE_OP_SETCC] = &&lbl_CODE_OP_SETCC,
+    [CODE_OP_SELECT] = &&lbl_CODE_OP_SELECT,
+    [CODE_OP_SWITCH] = &&lbl_CODE_OP_SWITCH,
+    [CODE_OP_SEGMENT] = &&lbl_CODE_OP_SEGMENT,
+
+    INTERPRETER_BINOP_ABS_LABELS(CODE_OP_ADD),
+    INTERPRETER_BINOP_ABS_LABELS(CODE_OP_SUB),
+    INTERPRETER_BINOP_ABS_LABELS(CODE_OP_MUL),
+    INTERPRETER_BINOP_ABS_LABELS(CODE_OP_DIV),
+    [CODE_OP_CMP_I64_ABS] = &&lbl_CODE_OP_CMP_I64_ABS,
+    [CODE_OP_CMP_I64_ABS_IMM] = &&lbl_CODE_OP_CMP_I64_ABS_IMM,
+    [CODE_OP_CMPJ_ABS] = &&lbl_CODE_OP_CMPJ_ABS,
+    [CODE_OP_CMPJ_ABS_IMM] = &&lbl_CODE_OP_CMPJ_ABS_IMM,
+    [CODE_OP_MOV_ABS] = &&lbl_CODE_OP_MOV_ABS,
+    [CODE_OP_MOV_SCALAR] = &&lbl_CODE_OP_MOV_SCALAR,
+    [CODE_OP_LOAD_I64_SCALAR] = &&lbl_CODE_OP_LOAD_I64_SCALAR,
+    [CODE_OP_STACK_IMM] = &&lbl_CODE_OP_STACK_IMM
+  };
+
+  INTERPRETER_DISPATCH();
+
+  {
+    {
+#else
+  for (;;) {
+    ins = ip++;
+    INTERPRETER_RECORD();
+    INTERPRETER_COUNT();
+
+    switch (ins->handler) {
+      default:
+#endif
+      INTERPRETER_CASE(OP_NOOP): INTERPRETER_NEXT();
+      INTERPRETER_CASE(OP_LOAD): { // load
+        value_t *v = OPERAND(ins->left);
+
+        INTERPRETER_SEEN(0, v);
+        INTERPRETER_QUICKEN(v, NULL);
+
+        switch (ins->flags) {
+          case CONST_FLAGS_NONE: // ??
+            v->data.i64 = 0;
+            VALUE_SET_META(v, TYPE_NONE, FLAG_NONE); // just zero out i guess
+
+            break;
+          case CONST_FLAGS_NULL: // loadnull
+            v->data.raw = NULL;
+            VALUE_SET_META(v, TYPE_POINTER, FLAG_NONE);
+
+            break;
+          case CONST_FLAGS_I64: // loadi4
+            value_setInt(rt, v, ins->imm.i64);
+
+            break;
+          case CONST_FLAGS_U64: // loadu4
+            value_setUint(rt, v, ins->imm.u64);
+
+            break;
+          case CONST_FLAGS_F64: // loadd
+            value_setDouble(rt, v, ins->imm.dbl);
+
+            break;
+          case CONST_FLAGS_BOOL: // loadb
+            value_setBoolean(rt, v, ins->imm.b);
+
+            break;
+          case CONST_FLAGS_POOL: // loadconst -- shares the pool entry, no copy
+          case CONST_FLAGS_RAWDATA: // loaddata -- the same, see code_decode
+            value_setRawPointer(rt, v, (void*)ins->imm.raw.data, FLAG_CONST);
+
+            break;
+        }
+
+        INTERPRETER_NEXT();
+      }
+
+      INTERPRETER_CASE(OP_MOV): { // mov
+        value_t *left = OPERAND(ins->left);
+        value_t *right = OPERAND(ins->right);
+
+        INTERPRETER_SEEN(0, left);
+        INTERPRETER_SEEN(1, right);
+        INTERPRETER_QUICKEN(left, right);
+
+        if ((ins->left.at & 0x3) == AT_REG) {
+          // optimization
+          *left = *right;
+        } else {
+          value_copyValue(rt, left, right);
+        }
+
+        INTERPRETER_NEXT();
+      }
+
+      INTERPRETER_CASE(CODE_OP_SETCC): { // setcc
+        value_t *left = OPERAND(ins->left);
+
+        INTERPRETER_SEEN(0, left);
+        value_setInt(rt, left, interpreter_condition(it->flags, ins->flags) != ins->imm.b);
+
+        INTERPRETER_NEXT();
+      }
+
+      INTERPRETER_CASE(CODE_OP_SELECT): { // select -- a mov of one of two operands, without a jump
+        value_t *left = OPERAND(ins->left);
+        value_t *right = interpreter_condition(it->flags, ins->flags) ? OPERAND(ins->right) : OPERAND(ins->target);
+
+        INTERPRETER_SEEN(0, left);
+        INTERPRETER_SEEN(1, right);
+
+        // the left operand is commonly one of the two, kept as it is
+        if ((ins->left.at & 0x3) == AT_REG) {
+          *left = *right;
+        } else if (left != right) {
+          value_copyValue(rt, left, right);
+        }
+
+        INTERPRETER_NEXT();
+      }
+
+      INTERPRETER_CASE(OP_TAKE): { // take -- mov or push, handing the reference over
+        value_t *right = OPERAND(ins->right);
+
+        if (ins->flags == TAKE_FLAGS_PUSH) {
+          uint64_t sp = INTERPRETER_DEPTH;
+
+#if INTERPRETER_CHECKED
+          if (sp + 1 >= stackCount) {
+            interpreter_fail(it, ins, "stack overflow");
+          }
+#endif
+
+          value_moveValue(rt, &stackData[sp], right);
+          INTERPRETER_SET_DEPTH(sp + 1);
+        } else {
+          value_moveValue(rt, OPERAND(ins->left), right);
+        }
+
+        INTERPRETER_NEXT();
+      }
+
+      INTERPRETER_CASE(OP_CMP): { // cmp
+        value_t *left = OPERAND(ins->left);
+        value_t *right = OPERAND(ins->right);
+
+        double cacheval;
+
+        INTERPRETER_QUICKEN(left, right);
+
+        switch (ins->flags) {
+          case CMP_FLAG_F64_L: // cmpdl
+            cacheval = left->data.dbl - right->data.i64;
+            goto setDouble;
+          case CMP_FLAG_F64_R: // cmpdr
+            cacheval = left->data.i64 - right->data.dbl;
+            goto setDouble;
+          case CMP_FLAG_F64_LR: // cmpd
+            cacheval = left->data.dbl - right->data.dbl;
+            goto setDouble;
+          default: { // cmp
+            int64_t l = left->data.i64, r = right->data.i64;
+
+            // 0, 1, or 2: sign() of l - r, plus 1, over all 64 bits, as
+            // cmpj has it
+            it->flags = ((l > r) - (l < r)) + 1;
+            INTERPRETER_NEXT();
+          }
+        }
+
+      setDouble:
+        it->flags = ((0 < cacheval) - (cacheval < 0)) + 1;
+        INTERPRETER_NEXT();
+      }
+
+      INTERPRETER_CASE(CODE_OP_CMP_IMM): { // cmp, immediate right operand
+        value_t *left = OPERAND(ins->left);
+
+        double cacheval;
+
+        INTERPRETER_QUICKEN(left, NULL);
+
+        switch (ins->flags & CMP_FLAG_F64_LR) {
+          case CMP_FLAG_F64_L: // cmpdl
+            cacheval = left->data.dbl - ins->imm.i64;
+            goto setDoubleImm;
+          case CMP_FLAG_F64_R: // cmpdr
+            cacheval = left->data.i64 - ins->imm.dbl;
+            goto setDoubleImm;
+          case CMP_FLAG_F64_LR: // cmpd
+            cacheval = left->data.dbl - ins->imm.dbl;
+            goto setDoubleImm;
+          default: { // cmp
+            int64_t l = left->data.i64, r = ins->imm.i64;
+
+            it->flags = ((l > r) - (l < r)) + 1;
+            INTERPRETER_NEXT();
+          }
+        }
+
+      setDoubleImm:
+        it->flags = ((0 < cacheval) - (cacheval < 0)) + 1;
+        INTERPRETER_NEXT();
+      }
+
+      INTERPRETER_CASE(OP_JMP): { // jmp
+        switch (ins->flags) {
+          case JUMP_FLAGS_JE: // je
+            if (~it->flags & INTERPRETER_FLAGS_EQUAL) {
+              goto noSeek;
+            }
+            break;
+          case JUMP_FLAGS_JNE: // jne
+            if (it->flags & INTERPRETER_FLAGS_EQUAL) {
+              goto noSeek;
+            }
+            break;
+          case JUMP_FLAGS_JG: // jg
+            if (~it->flags & INTERPRETER_FLAGS_GREATER) {
+              goto noSeek;
+            }
+            break;
+          case JUMP_FLAGS_JGE: // jge
+            if (!(it->flags & (INTERPRETER_FLAGS_GREATER | INTERPRETER_FLAGS_EQUAL))) {
+              goto noSeek;
+            }
+            break;
+        }
+
+        INTERPRETER_PROFILE(true);
+        ip = interpreter_jumpTarget(it, ins, INTERPRETER_JUMP_OFFSET());
+        runtime_safepoint(rt);
+        INTERPRETER_TICK();
+        INTERPRETER_BACK_EDGE();
+        INTERPRETER_NEXT();
+
+      noSeek:
+        INTERPRETER_PROFILE(false);
+        INTERPRETER_NEXT();
+      }
+
+      INTERPRETER_CASE(OP_CMPJ): { // cmp + je/jne/jg/jge
+        value_t *left = OPERAND(ins->left);
+        value_t *right = OPERAND(ins->right);
+        bool taken;
+
+        INTERPRETER_QUICKEN(left, right);
+        taken = interpreter_compareJump(it, left->data.i64, right->data.i64, ins->flags);
+
+        INTERPRETER_PROFILE(taken);
+
+        if (taken) {
+          ip = interpreter_jumpTarget(it, ins, INTERPRETER_JUMP_OFFSET());
+          runtime_safepoint(rt);
+          INTERPRETER_TICK();
+          INTERPRETER_BACK_EDGE();
+        }
+
+        INTERPRETER_NEXT();
+      }
+
+      INTERPRETER_CASE(OP_CMPJ_IMM): { // cmp + je/jne/jg/jge, immediate right operand
+        value_t *left = OPERAND(ins->left);
+        bool taken;
+
+        INTERPRETER_QUICKEN(left, NULL);
+        taken = interpreter_compareJump(it, left->data.i64, ins->imm.i64, ins->flags);
+
+        INTERPRETER_PROFILE(taken);
+
+        if (taken) {
+          ip = interpreter_jumpTarget(it, ins, INTERPRETER_JUMP_OFFSET());
+          runtime_safepoint(rt);
+          INTERPRETER_TICK();
+          INTERPRETER_BACK_EDGE();
+        }
+
+        INTERPRETER_NEXT();
+      }
+
+      INTERPRETER_CASE(CODE_OP_SWITCH): { // switch -- a jump to case `v - low`, or the default
+        const code_table_t *table = ins->imm.table;
+        uint64_t i = (uint64_t)OPERAND(ins->left)->data.i64 - (uint64_t)table->low;
+
+        INTERPRETER_PROFILE(true);
+        ip = interpreter_jumpTarget(it, ins, i < table->count ? table->offsets[i] : INTERPRETER_JUMP_OFFSET());
+        runtime_safepoint(rt);
+        INTERPRETER_TICK();
+        INTERPRETER_BACK_EDGE();
+        INTERPRETER_NEXT();
+      }
+
+      INTERPRETER_CASE(OP_PUSH): { // push
+        uint64_t sp = INTERPRETER_DEPTH;
+        value_t *top = &stackData[sp];
+
+#if INTERPRETER_CHECKED
+        if (sp + 1 >= stackCount) {
+          interpreter_fail(it, ins, "stack overflow");
+        }
+#endif
+
+        INTERPRETER_SEEN(1, top);
+
+        switch (ins->flags) {
+          case CONST_FLAGS_NONE: // push -- load value_t to push to stack
+            INTERPRETER_SEEN(0, OPERAND(ins->left));
+
+            value_copyValue(rt, top, OPERAND(ins->left));
+
+            break;
+          // shortcuts for pushing constants directly, rather than using multiple instructions
+          case CONST_FLAGS_NULL: // pushnull
+            value_release(rt, top);
+
+            top->data.raw = NULL;
+            VALUE_SET_META(top, TYPE_POINTER, FLAG_NONE);
+
+            break;
+          case CONST_FLAGS_I64: // pushi4
+            value_setInt(rt, top, ins->imm.i64);
+
+            break;
+          case CONST_FLAGS_U64: // pushu4
+            value_setUint(rt, top, ins->imm.u64);
+
+            break;
+          case CONST_FLAGS_F64: // pushd
+            value_setDouble(rt, top, ins->imm.dbl);
+
+            break;
+          case CONST_FLAGS_BOOL: // pushb
+            value_setBoolean(rt, top, ins->imm.b);
+
+            break;
+          case CONST_FLAGS_POOL: // pushconst -- shares the pool entry, no copy
+          case CONST_FLAGS_RAWDATA: // pushdata -- the same, see code_decode
+            value_setRawPointer(rt, top, (void*)ins->imm.raw.data, FLAG_CONST);
+
+            break;
+        }
+
+        INTERPRETER_SET_DEPTH(sp + 1);
+
+        INTERPRETER_NEXT();
+      }
+
+      INTERPRETER_CASE(OP_POP): {
+        uint16_t sz = (uint16_t)ins->imm.u64;
+        uint64_t sp = INTERPRETER_DEPTH;
+
+#if INTERPRETER_CHECKED
+        if (sz > sp) {
+          interpreter_fail(it, ins, "stack underflow");
+        }
+#endif
+
+        // the slots are past the length before any is destroyed
+        INTERPRETER_SET_DEPTH(sp - sz);
+
+        while (sz--) { // required to call free() on malloc'd objects
+          value_t *ptr = &stackData[--sp];
+
+          // anything else is left as it is: nothing reads past the length,
+          // and the next store into the slot has nothing to release
+          if (VALUE_OWNS(ptr)) {
+            value_destroy(rt, ptr);
+
+            VALUE_SET_META(ptr, TYPE_NONE, FLAG_NONE);
+          }
+        }
+
+        INTERPRETER_NEXT();
+      }
+
+      INTERPRETER_CASE(OP_FCALL): { // fcall
+        uint64_t sp = INTERPRETER_DEPTH;
+
+#if INTERPRETER_CHECKED
+        if (sp + 2 >= stackCount) {
+          interpreter_fail(it, ins, "stack overflow");
+        }
+#endif
+
+        // $f[-2] and $f[-1] of the callee
+        value_setUint(rt, &stackData[sp], ins->imm.u64);
+        value_setUint(rt, &stackData[sp + 1], VM_FRAME_POINTER(rt->dt));
+
+        INTERPRETER_SET_DEPTH(sp + 2);
+        VM_FRAME_POINTER(rt->dt) = sp + 2;
+
+        INTERPRETER_PROFILE(false);
+        ip = interpreter_jumpTarget(it, ins, INTERPRETER_JUMP_OFFSET());
+        runtime_safepoint(rt);
+        INTERPRETER_TICK();
+
+        INTERPRETER_NEXT();
+      }
+
+      INTERPRETER_CASE(OP_RET): { // ret
+        uint64_t fp = VM_FRAME_POINTER(rt->dt);
+        uint64_t bottom = fp - 2 - ins->imm.u64; // the first argument
+        uint64_t sp = INTERPRETER_DEPTH;
+        uint64_t offset;
+
+#if INTERPRETER_CHECKED
+        if (fp < 2 + ins->imm.u64 || fp > sp) {
+          interpreter_fail(it, ins, "ret without a frame");
+        }
+#endif
+
+        offset = stackData[fp - 2].data.u64;
+        VM_FRAME_POINTER(rt->dt) = stackData[fp - 1].data.u64;
+        INTERPRETER_SET_DEPTH(bottom);
+
+        while (sp > bottom) { // as OP_POP
+          value_t *ptr = &stackData[--sp];
+
+          if (VALUE_OWNS(ptr)) {
+            value_destroy(rt, ptr);
+
+            VALUE_SET_META(ptr, TYPE_NONE, FLAG_NONE);
+          }
+        }
+
+        ip = interpreter_jumpTarget(it, ins, offset);
+        runtime_safepoint(rt);
+        INTERPRETER_TICK();
+
+        INTERPRETER_NEXT();
+      }
+
+      INTERPRETER_BINOP(CODE_OP_ADD, +)
+      INTERPRETER_BINOP(CODE_OP_SUB, -)
+      INTERPRETER_BINOP(CODE_OP_MUL, *)
+      // @TODO: div by zero catch?
+      INTERPRETER_BINOP(CODE_OP_DIV, /)
+
+      // quickened, see interpreter_quicken
+      INTERPRETER_BINOP_ABS(CODE_OP_ADD, +)
+      INTERPRETER_BINOP_ABS(CODE_OP_SUB, -)
+      INTERPRETER_BINOP_ABS(CODE_OP_MUL, *)
+      INTERPRETER_BINOP_ABS(CODE_OP_DIV, /)
+
+      INTERPRETER_CASE(CODE_OP_CMP_I64_ABS): {
+        int64_t l = ins->left.base->data.i64, r = ins->right.base->data.i64;
+
+        // as OP_CMP, over all 64 bits
+        it->flags = ((l > r) - (l < r)) + 1;
+        INTERPRETER_NEXT();
+      }
+
+      INTERPRETER_CASE(CODE_OP_CMP_I64_ABS_IMM): {
+        int64_t l = ins->left.base->data.i64, r = ins->imm.i64;
+
+        it->flags = ((l > r) - (l < r)) + 1;
+        INTERPRETER_NEXT();
+      }
+
+      INTERPRETER_CASE(CODE_OP_CMPJ_ABS): {
+        bool taken = interpreter_compareJump(it, ins->left.base->data.i64, ins->right.base->data.i64, ins->flags);
+
+        INTERPRETER_PROFILE(taken);
+
+        if (taken) {
+          ip = interpreter_jumpTarget(it, ins, INTERPRETER_JUMP_OFFSET());
+          runtime_safepoint(rt);
+          INTERPRETER_TICK();
+          INTERPRETER_BACK_EDGE();
+        }
+
+        INTERPRETER_NEXT();
+      }
+
+      INTERPRETER_CASE(CODE_OP_CMPJ_ABS_IMM): {
+        bool taken = interpreter_compareJump(it, ins->left.base->data.i64, ins->imm.i64, ins->flags);
+
+        INTERPRETER_PROFILE(taken);
+
+        if (taken) {
+          ip = interpreter_jumpTarget(it, ins, INTERPRETER_JUMP_OFFSET());
+          runtime_safepoint(rt);
+          INTERPRETER_TICK();
+          INTERPRETER_BACK_EDGE();
+        }
+
+        INTERPRETER_NEXT();
+      }
+
+      INTERPRETER_CASE(CODE_OP_MOV_ABS): {
+        INTERPRETER_SEEN(0, ins->left.base);
+        INTERPRETER_SEEN(1, ins->right.base);
+
+        *ins->left.base = *ins->right.base;
+        INTERPRETER_NEXT();
+      }
+
+      INTERPRETER_CASE(CODE_OP_MOV_SCALAR): {
+        value_t *left = OPERAND(ins->left);
+        value_t *right = OPERAND(ins->right);
+
+        INTERPRETER_SEEN(0, left);
+        INTERPRETER_SEEN(1, right);
+
+        if (!((VALUE_META(left) | VALUE_META(right)) & VALUE_OWNING_FLAGS)) {
+          *left = *right;
+        } else {
+          ins->handler = ins->opcode;
+          value_copyValue(rt, left, right);
+        }
+
+        INTERPRETER_NEXT();
+      }
+
+      INTERPRETER_CASE(CODE_OP_LOAD_I64_SCALAR): {
+        value_t *v = OPERAND(ins->left);
+
+        INTERPRETER_SEEN(0, v);
+
+        if (!VALUE_OWNS(v)) {
+          v->data.i64 = ins->imm.i64;
+          VALUE_SET_META(v, TYPE_INT, FLAG_NONE);
+        } else {
+          ins->handler = ins->opcode;
+          value_setInt(rt, v, ins->imm.i64);
+        }
+
+        INTERPRETER_NEXT();
+      }
+
+      INTERPRETER_CASE(CODE_OP_STACK_IMM): { // add $sp / sub $sp, immediate
+        INTERPRETER_SET_DEPTH(ins->opcode == CODE_OP_ADD_I64_IMM
+          ? INTERPRETER_DEPTH + ins->imm.u64
+          : INTERPRETER_DEPTH - ins->imm.u64);
+        INTERPRETER_NEXT();
+      }
+
+      INTERPRETER_CASE(CODE_OP_MOD_I64): {
+        value_t *left = OPERAND(ins->left);
+        left->data.i64 = left->data.i64 % OPERAND(ins->right)->data.i64;
+        INTERPRETER_NEXT();
+      }
+
+      INTERPRETER_CASE(CODE_OP_MOD_I64_IMM): {
+        value_t *left = OPERAND(ins->left);
+        left->data.i64 = left->data.i64 % ins->imm.i64;
+        INTERPRETER_NEXT();
+      }
+
+      INTERPRETER_CASE(OP_XOR): {
+        value_t *left = OPERAND(ins->left);
+        left->data.i64 = left->data.i64 ^ OPERAND(ins->right)->data.i64;
+        INTERPRETER_NEXT();
+      }
+
+      INTERPRETER_CASE(CODE_OP_XOR_IMM): {
+        value_t *left = OPERAND(ins->left);
+        left->data.i64 = left->data.i64 ^ ins->imm.i64;
+        INTERPRETER_NEXT();
+      }
+
+      INTERPRETER_CASE(OP_AND): {
+        value_t *left = OPERAND(ins->left);
+        left->data.i64 = left->data.i64 & OPERAND(ins->right)->data.i64;
+        INTERPRETER_NEXT();
+      }
+
+      INTERPRETER_CASE(CODE_OP_AND_IMM): {
+        value_t *left = OPERAND(ins->left);
+        left->data.i64 = left->data.i64 & ins->imm.i64;
+        INTERPRETER_NEXT();
+      }
+
+      INTERPRETER_CASE(OP_OR): {
+        value_t *left = OPERAND(ins->left);
+        left->data.i64 = left->data.i64 | OPERAND(ins->right)->data.i64;
+        INTERPRETER_NEXT();
+      }
+
+      INTERPRETER_CASE(CODE_OP_OR_IMM): {
+        value_t *left = OPERAND(ins->left);
+        left->data.i64 = left->data.i64 | ins->imm.i64;
+        INTERPRETER_NEXT();
+      }
+
+      INTERPRETER_CASE(OP_SHL): {
+        value_t *left = OPERAND(ins->left);
+        left->data.i64 = left->data.i64 << OPERAND(ins->right)->data.i64;
+        INTERPRETER_NEXT();
+      }
+
+      INTERPRETER_CASE(CODE_OP_SHL_IMM): {
+        value_t *left = OPERAND(ins->left);
+        left->data.i64 = left->data.i64 << ins->imm.i64;
+        INTERPRETER_NEXT();
+      }
+
+      INTERPRETER_CASE(OP_SHR): {
+        value_t *left = OPERAND(ins->left);
+        left->data.i64 = left->data.i64 >> OPERAND(ins->right)->data.i64;
+        INTERPRETER_NEXT();
+      }
+
+      INTERPRETER_CASE(CODE_OP_SHR_IMM): {
+        value_t *left = OPERAND(ins->left);
+        left->data.i64 = left->data.i64 >> ins->imm.i64;
+        INTERPRETER_NEXT();
+      }
+
+      INTERPRETER_CASE(OP_NEG): {
+        value_t *left = OPERAND(ins->left);
+
+        switch (ins->flags) {
+          case CMP_FLAG_F64_L:  left->data.dbl = -left->data.dbl; break;
+          default:              left->data.i64 = -left->data.i64; break;
+        }
+
+        INTERPRETER_NEXT();
+      }
+
+      INTERPRETER_CASE(OP_NOT): {
+        value_t *left = OPERAND(ins->left);
+        left->data.i64 = ~left->data.i64;
+
+        INTERPRETER_NEXT();
+      }
+
+      INTERPRETER_CASE(CODE_OP_GETFIELD):
+      INTERPRETER_CASE(CODE_OP_SETFIELD): {
+        // a call whose time is taken is left to OP_CALL, to be counted
+        if (!INTERPRETER_TIMES_CALLS()) {
+          value_t *operands[3] = {
+            OPERAND(ins->imm.call.args[0]),
+            OPERAND(ins->imm.call.args[1]),
+            ins->opcode == CODE_OP_SETFIELD ? OPERAND(ins->imm.call.args[2]) : NULL
+          };
+
+          if (builtins_field(rt, ins, OPERAND(ins->left), operands,
+              (ins->flags & CALL_FLAGS_RESULT) ? OPERAND(ins->right) : &rt->dt->storage[AT_REG].data[0])) {
+            INTERPRETER_NEXT();
+          }
+        }
+      }
+      // a miss runs as the call it was decoded from
+      // fallthrough
+
+      INTERPRETER_CASE(OP_CALL): {
+        INTERPRETER_SYNC_PC();
+        runtime_safepoint(rt);
+
+        value_t *callee = OPERAND(ins->left);
+        bool registers = (ins->flags & CALL_FLAGS_REGISTER_ARGS) != 0;
+
+        // the call may overwrite `callee`
+        native_function_t calledFn = VALUE_TYPE_OF(callee) == TYPE_FUNCTION ? callee->data.fn : NULL;
+        uint64_t calledAt = INTERPRETER_TIMES_CALLS() ? runtime_nowNs() : 0;
+
+        INTERPRETER_SAMPLE(sampleFn, calledFn);
+
+        if (ins->flags & (CALL_FLAGS_OPERANDS | CALL_FLAGS_RESULT)) {
+          // arguments past those passed read as none, see builtins_callResolved
+          value_t none, *operands[CALL_MAX_OPERANDS];
+
+          VALUE_SET_META(&none, TYPE_NONE, FLAG_NONE);
+
+          for (uint64_t i = 0; i < CALL_MAX_OPERANDS; i++) {
+            operands[i] = i < ins->imm.call.count ? OPERAND(ins->imm.call.args[i]) : &none;
+          }
+
+          builtins_callOperands(rt, ins, callee, (ins->flags & CALL_FLAGS_OPERANDS) ? operands : NULL,
+            (ins->flags & CALL_FLAGS_RESULT) ? OPERAND(ins->right) : &rt->dt->storage[AT_REG].data[0]);
+        } else if (!builtins_callDirect(rt, ins, callee, registers, NULL, &rt->dt->storage[AT_REG].data[0])) {
+          value_t result = registers
+            ? value_invokeWithRegisters(rt, callee)
+            : value_invoke(rt, callee);
+
+          rt->dt->storage[AT_REG].data[0] = result;
+        }
+
+        // the callee may have taken its arguments off the stack
+        INTERPRETER_FILL();
+        INTERPRETER_SAMPLE(sampleFn, NULL);
+
+        if (calledAt != 0) {
+          interpreter_countCall(it, calledFn, calledAt);
+        }
+
+#if !INTERPRETER_METERED
+        // the call began counting, see runtime_countBegin
+        if (interpreter_isMetered(it)) {
+          INTERPRETER_SYNC_PC();
+          it->remeter = true;
+          return;
+        }
+#endif
+
+        // @NOTE: reason we are NOT doing value_copyValue() here, is because we want the register value to inherit
+        // all responsibilities of `result` here ... including refcounts, free() obligations...
+
+        INTERPRETER_TICK();
+        INTERPRETER_NEXT();
+      }
+
+      INTERPRETER_CASE(OP_PRINT): {
+        output_writeValue(&rt->output, OPERAND(ins->left));
+
+        INTERPRETER_NEXT();
+      }
+
+      // ...
+
+      INTERPRETER_CASE(OP_JIT): { // region marker, see vm/jit.h
+#if !INTERPRETER_CHECKED
+        // only verified code is compiled, and not on a budget or with calls
+        // timed, see runtime_compiles. otherwise, and if compiling fails, the
+        // instructions between the markers are interpreted as usual.
+        native_function_t fn = (ins->flags & JIT_FLAG_BEGIN) && runtime_compiles(rt) ? jit_region(it->jit, ins) : NULL;
+
+        if (fn != NULL) {
+          INTERPRETER_SYNC_PC();
+
+          // exposes the region to bytecode as a callable value
+          value_setFunction(rt, OPERAND(ins->left), fn);
+
+          ip = (ins->flags & JIT_FLAG_MEMOIZE)
+            ? interpreter_runMemoized(it, ins, fn)
+            : interpreter_runNative(it, fn);
+          INTERPRETER_FILL();
+        }
+#endif
+
+        INTERPRETER_NEXT();
+      }
+
+      INTERPRETER_CASE(CODE_OP_SEGMENT): { // fell through into code not yet decoded
+        uint32_t index = (uint32_t)(ins - it->code->instructions);
+
+        code_ensure(it->code, index, index + 1);
+        ip = ins;
+        INTERPRETER_NEXT();
+      }
+
+      INTERPRETER_CASE(OP_SPAWN):
+        interpreter_spawn(it, OPERAND(ins->left), OPERAND(ins->target));
+        INTERPRETER_NEXT();
+
+      // a switch of fibers swaps the stack's contents and length
+      INTERPRETER_CASE(OP_YIELD):
+        ip = interpreter_yield(it, ins, ip);
+        INTERPRETER_FILL();
+        runtime_safepoint(rt);
+        INTERPRETER_NEXT();
+
+      INTERPRETER_CASE(OP_JOIN):
+        ip = interpreter_join(it, ins, ip, OPERAND(ins->left));
+        INTERPRETER_FILL();
+        runtime_safepoint(rt);
+        INTERPRETER_NEXT();
+
+      INTERPRETER_CASE(OP_HALT):
+        if (rt->fibers != NULL) {
+          instruction_t *next = interpreter_endFiber(it, ins);
+
+          if (next != NULL) {
+            ip = next;
+            INTERPRETER_FILL();
+            INTERPRETER_NEXT();
+          }
+        }
+
+        ip = ins;
+        INTERPRETER_SYNC_PC();
+
+        if ((ins->flags & HALT_FLAGS_RETURN) || !it->haltExits) {
+          // implicit halt at the end of the bytecode buffer, or the end of a job
+          return;
+        }
+
+        output_flush(&rt->output);
+        exit(0);
+    }
+  }
+}
@@ -0,0 +1,1575 @@
+#include <vm/jit.h>
+#include <vm/jit_native.h>
+#include <vm/util.h>
+#include <vm/builtins.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <inttypes.h>
+#include <errno.h>
+
+#if defined(BB8_JIT)
+  #include <dlfcn.h>
+  #include <unistd.h>
+  #include <sys/stat.h>
+#endif
+
+// ===== C source generation =====
+
+// generated C, appended in amortized constant time. with `out` set,
+// it is written straight to that file instead of being buffered.
+typedef struct jit_source {
+  char *data;
+  size_t len;
+  size_t cap;
+  FILE *out;
+} jit_source_t;
+
+static void jit_emit(jit_source_t *src, const char *fmt, ...) {
+  va_list args;
+  int n;
+
+  va_start(args, fmt);
+
+  if (src->out != NULL) {
+    vfprintf(src->out, fmt, args);
+    va_end(args);
+    return;
+  }
+
+  n = vsnprintf(NULL, 0, fmt, args);
+  va_end(args);
+
+  if (src->len + n + 1 > src->cap) {
+    while (src->len + n + 1 > src->cap) {
+      src->cap = src->cap ? src->cap * 2 : 4096;
+    }
+
+    src->data = (char*)realloc(src->data, src->cap);
+  }
+
+  va_start(args, fmt);
+  vsnprintf(src->data + src->len, n + 1, fmt, args);
+  va_end(args);
+
+  src->len += n;
+}
+
+// C expression for the value_t* an operand refers to, see CODE_OPERAND_VALUE
+static const char *jit_operand(char *buf, size_t size, const operand_t *o) {
+  unsigned storage = o->at & 0x3;
+
+  if ((o->at & AT_ABS) == AT_ABS) {
+    snprintf(buf, size, "(&s[%u].data[%u])", storage, (unsigned)o->loc);
+  } else if (o->at == AT_FRAME) {
+    snprintf(buf, size, "(&s[%u].data[s[%u].data[%u].data.u64 + %lld])",
+      storage, AT_VM, VM_FRAME_POINTER_SLOT, (long long)CODE_FRAME_SLOT(o->loc));
+  } else {
+    snprintf(buf, size, "(&s[%u].data[*s[%u].lenVal - %u])", storage, storage, (unsigned)o->loc);
+  }
+
+  return buf;
+}
+
+// a $r slot the region only uses as an i64, or only as a dbl, lives in a C
+// local `u<slot>` for the length of the region and is stored back on exit.
+// arithmetic never looks at or changes the tag, so such a slot needs no
+// checks -- unless the region also loads a constant into it, which is only
+// done if that load has seen nothing but the same type (see code_seen),
+// and the tag is then guarded on entry.
+enum JIT_UNBOXED {
+  JIT_UNBOXED_NONE = 0, // not used in the region
+  JIT_UNBOXED_I64,
+  JIT_UNBOXED_F64,
+  JIT_UNBOXED_NO // used some other way, stays in the register file
+};
+
+typedef struct jit_unboxed {
+  uint8_t kind; // JIT_UNBOXED
+  bool typed; // loaded in the region, tag checked on entry
+} jit_unboxed_t;
+
+#define JIT_IS_UNBOXED(u) ((u).kind == JIT_UNBOXED_I64 || (u).kind == JIT_UNBOXED_F64)
+
+static bool jit_isRegister(const operand_t *o) {
+  return o->base != NULL && (o->at & 0x3) == AT_REG && (o->at & AT_ABS) == AT_ABS && o->loc < NUM_REGISTERS;
+}
+
+static void jit_unboxUse(jit_unboxed_t *regs, bool *aliased, const operand_t *o, uint8_t kind) {
+  jit_unboxed_t *u;
+
+  if (o->base == NULL || (o->at & 0x3) != AT_REG) {
+    return;
+  }
+
+  if (!jit_isRegister(o)) {
+    *aliased = true; // relative, could be any slot
+    return;
+  }
+
+  u = &regs[o->loc];
+
+  if (u->kind == JIT_UNBOXED_NONE) {
+    u->kind = kind;
+  } else if (u->kind != kind) {
+    u->kind = JIT_UNBOXED_NO;
+  }
+}
+
+// fills `regs` (NUM_REGISTERS entries) for instructions [first, end)
+static void jit_findUnboxed(const code_t *code, uint32_t first, uint32_t end, jit_unboxed_t *regs) {
+  bool aliased = false;
+
+  memset(regs, 0, sizeof(jit_unboxed_t) * NUM_REGISTERS);
+
+  for (uint32_t i = first; i < end; i++) {
+    const instruction_t *ins = &code->instructions[i];
+    uint8_t left = JIT_UNBOXED_NO, right = JIT_UNBOXED_NO;
+
+    if (ins->opcode >= CODE_OP_ADD_I64 && ins->opcode <= CODE_OP_DIV_F64_LR_IMM) {
+      unsigned variant = (ins->opcode - CODE_OP_ADD_I64) % 8;
+
+      left = (variant & CMP_FLAG_F64_L) ? JIT_UNBOXED_F64 : JIT_UNBOXED_I64;
+      right = (variant & CMP_FLAG_F64_R) ? JIT_UNBOXED_F64 : JIT_UNBOXED_I64;
+    } else {
+      switch (ins->opcode) {
+        case CODE_OP_MOD_I64:
+        case OP_XOR:
+        case OP_AND:
+        case OP_OR:
+        case OP_SHL:
+        case OP_SHR:
+        case CODE_OP_MOD_I64_IMM:
+        case CODE_OP_XOR_IMM:
+        case CODE_OP_AND_IMM:
+        case CODE_OP_OR_IMM:
+        case CODE_OP_SHL_IMM:
+        case CODE_OP_SHR_IMM:
+        case OP_NOT:
+        case OP_CMPJ:
+        case OP_CMPJ_IMM:
+        case CODE_OP_SWITCH:
+          left = right = JIT_UNBOXED_I64;
+          break;
+        case CODE_OP_SETCC:
+          // as a load of an int
+          if ((ins->seen[0] & ~(1 << TYPE_NONE)) == (1 << TYPE_INT)) {
+            left = JIT_UNBOXED_I64;
+
+            if (jit_isRegister(&ins->left)) {
+              regs[ins->left.loc].typed = true;
+            }
+          }
+          break;
+        case OP_NEG:
+          left = ins->flags == CMP_FLAG_F64_L ? JIT_UNBOXED_F64 : JIT_UNBOXED_I64;
+          break;
+        case OP_CMP:
+        case CODE_OP_CMP_IMM:
+          left = (ins->flags & CMP_FLAG_F64_L) ? JIT_UNBOXED_F64 : JIT_UNBOXED_I64;
+          right = (ins->flags & CMP_FLAG_F64_R) ? JIT_UNBOXED_F64 : JIT_UNBOXED_I64;
+          break;
+        case OP_LOAD: {
+          // the first run commonly finds the slot still empty
+          uint8_t seen = ins->seen[0] & ~(1 << TYPE_NONE);
+
+          if (ins->flags == CONST_FLAGS_I64 && seen == (1 << TYPE_INT)) {
+            left = JIT_UNBOXED_I64;
+          } else if (ins->flags == CONST_FLAGS_F64 && seen == (1 << TYPE_DOUBLE)) {
+            left = JIT_UNBOXED_F64;
+          }
+
+          if (left != JIT_UNBOXED_NO && jit_isRegister(&ins->left)) {
+            regs[ins->left.loc].typed = true;
+          }
+          break;
+        }
+        case OP_CALL: // the callee sees the register file
+        case CODE_OP_GETFIELD:
+        case CODE_OP_SETFIELD:
+          aliased = true;
+          break;
+      }
+    }
+
+    jit_unboxUse(regs, &aliased, &ins->left, left);
+    jit_unboxUse(regs, &aliased, &ins->right, right);
+    jit_unboxUse(regs, &aliased, &ins->target, JIT_UNBOXED_NO);
+  }
+
+  if (aliased) {
+    memset(regs, 0, sizeof(jit_unboxed_t) * NUM_REGISTERS);
+  }
+}
+
+// C expression for the byte offset a jump goes to
+static const char *jit_target(char *buf, size_t size, const instruction_t *ins) {
+  char v[64];
+
+  if (CODE_DIRECT_JUMP(ins)) {
+    snprintf(buf, size, "%uu", (unsigned)ins->target.loc);
+  } else {
+    snprintf(buf, size, "value_getUint(%s)", jit_operand(v, sizeof(v), &ins->target));
+  }
+
+  return buf;
+}
+
+// C lvalue for the i64 or dbl of an operand, its local if it is unboxed
+static const char *jit_data(char *buf, size_t size, const operand_t *o, uint8_t kind, const jit_unboxed_t *regs) {
+  char v[64];
+
+  if (jit_isRegister(o) && regs[o->loc].kind == kind) {
+    snprintf(buf, size, "u%u", (unsigned)o->loc);
+  } else {
+    snprintf(buf, size, "%s->data.%s", jit_operand(v, sizeof(v), o), kind == JIT_UNBOXED_F64 ? "dbl" : "i64");
+  }
+
+  return buf;
+}
+
+#define JIT_L jit_operand(l, sizeof(l), &ins->left)
+#define JIT_R jit_operand(r, sizeof(r), &ins->right)
+#define JIT_T jit_target(t, sizeof(t), ins)
+
+#define JIT_LD(kind) jit_data(l, sizeof(l), &ins->left, kind, regs)
+#define JIT_RD(kind) jit_data(r, sizeof(r), &ins->right, kind, regs)
+
+static const char *JIT_SRC_HEADER =
+  "#include <vm/value.h>\n"
+  "#include <vm/datatable.h>\n"
+  "#include <vm/runtime.h>\n"
+  "#include <vm/interpreter.h>\n"
+  "#include <vm/jit.h>\n"
+  "#include <vm/builtins.h>\n\n"
+  "#include <stdio.h>\n"
+  "#include <stdlib.h>\n"
+  "#include <string.h>\n\n"
+  "const instruction_t *bb8_instructions; // set by the vm after loading\n\n"
+  "static inline double jit_f64(uint64_t bits) {\n"
+  "  double d;\n"
+  "  memcpy(&d, &bits, sizeof(d));\n"
+  "  return d;\n"
+  "}\n\n"
+  "value_t bb8_region(runtime_t *rt, args_t *args) {\n"
+  "  storage_t *s = rt->dt->storage;\n"
+  "  jit_frame_t *frame = (jit_frame_t*)args->_rawData;\n"
+  "  uint8_t flags = frame != NULL ? frame->flags : 0;\n"
+  "  uint64_t target;\n\n";
+
+// deoptimization: when `cond` holds, the value_t no longer matches the
+// feedback the code was specialized on, so the region is left for the
+// interpreter, which runs `ins` itself
+static void jit_emitGuard(jit_source_t *src, const instruction_t *ins, const char *cond) {
+  jit_emit(src, "  if (%s) { target = %u; goto _exit; }\n", cond, ins->offset);
+}
+
+// emits a constant into a value_t* `v`, for the CONST_FLAGS of load and push.
+// `seen` is the feedback for `v`: if it never owned memory, scalars are
+// stored in place, instead of through value_destroy.
+static void jit_emitConstant(jit_source_t *src, const code_t *code, const instruction_t *ins, const char *v, uint8_t seen) {
+  uint32_t index = ins - code->instructions;
+  bool unowned = seen != 0 && !(seen & CODE_SEEN_OWNED);
+  char cond[96];
+
+  snprintf(cond, sizeof(cond), "CODE_VALUE_OWNED(%s)", v);
+
+  switch (ins->flags) {
+    case CONST_FLAGS_NONE:
+      jit_emit(src, "  %s->data.i64 = 0; VALUE_SET_META(%s, TYPE_NONE, FLAG_NONE);\n", v, v);
+      break;
+    case CONST_FLAGS_NULL:
+      jit_emit(src, "  %s->data.raw = NULL; VALUE_SET_META(%s, TYPE_POINTER, FLAG_NONE);\n", v, v);
+      break;
+    case CONST_FLAGS_I64:
+      if (unowned) {
+        jit_emitGuard(src, ins, cond);
+        jit_emit(src, "  %s->data.i64 = (int64_t)%" PRIu64 "ULL; VALUE_SET_META(%s, TYPE_INT, FLAG_NONE);\n", v, ins->imm.u64, v);
+      } else {
+        jit_emit(src, "  value_setInt(rt, %s, (int64_t)%" PRIu64 "ULL);\n", v, ins->imm.u64);
+      }
+      break;
+    case CONST_FLAGS_U64:
+      if (unowned) {
+        jit_emitGuard(src, ins, cond);
+        jit_emit(src, "  %s->data.u64 = %" PRIu64 "ULL; VALUE_SET_META(%s, TYPE_UINT, FLAG_NONE);\n", v, ins->imm.u64, v);
+      } else {
+        jit_emit(src, "  value_setUint(rt, %s, %" PRIu64 "ULL);\n", v, ins->imm.u64);
+      }
+      break;
+    case CONST_FLAGS_F64:
+      if (unowned) {
+        jit_emitGuard(src, ins, cond);
+        jit_emit(src, "  %s->data.dbl = jit_f64(%" PRIu64 "ULL); VALUE_SET_META(%s, TYPE_DOUBLE, FLAG_NONE);\n", v, ins->imm.u64, v);
+      } else {
+        jit_emit(src, "  value_setDouble(rt, %s, jit_f64(%" PRIu64 "ULL));\n", v, ins->imm.u64);
+      }
+      break;
+    case CONST_FLAGS_BOOL:
+      if (unowned) {
+        jit_emitGuard(src, ins, cond);
+        jit_emit(src, "  %s->data.b = %d; VALUE_SET_META(%s, TYPE_BOOLEAN, FLAG_NONE);\n", v, ins->imm.b ? 1 : 0, v);
+      } else {
+        jit_emit(src, "  value_setBoolean(rt, %s, %d);\n", v, ins->imm.b ? 1 : 0);
+      }
+      break;
+    case CONST_FLAGS_POOL:
+    case CONST_FLAGS_RAWDATA:
+      jit_emit(src, "  value_setRawPointer(rt, %s, (void*)bb8_instructions[%u].imm.raw.data, FLAG_CONST);\n", v, index);
+      break;
+  }
+}
+
+// value_copyValue(rt, dst, src), as a plain copy if neither side has been
+// seen owning memory -- there is then nothing to release or claim
+static void jit_emitCopy(jit_source_t *src, const instruction_t *ins, const char *dst, const char *from) {
+  char cond[160];
+
+  if (ins->seen[0] != 0 && ins->seen[1] != 0 && !((ins->seen[0] | ins->seen[1]) & CODE_SEEN_OWNED)) {
+    snprintf(cond, sizeof(cond), "CODE_VALUE_OWNED(%s) || CODE_VALUE_OWNED(%s)", dst, from);
+    jit_emitGuard(src, ins, cond);
+    jit_emit(src, "  *%s = *%s;\n", dst, from);
+  } else {
+    jit_emit(src, "  value_copyValue(rt, %s, %s);\n", dst, from);
+  }
+}
+
+// C condition under which a setcc or select takes the JUMP_FLAGS
+// condition `cond` to hold, see interpreter_condition
+static const char *jit_flagsCondition(uint8_t cond) {
+  switch (cond) {
+    case JUMP_FLAGS_JE: return "(flags & INTERPRETER_FLAGS_EQUAL)";
+    case JUMP_FLAGS_JNE: return "!(flags & INTERPRETER_FLAGS_EQUAL)";
+    case JUMP_FLAGS_JG: return "(flags & INTERPRETER_FLAGS_GREATER)";
+    case JUMP_FLAGS_JGE: return "(flags & (INTERPRETER_FLAGS_GREATER | INTERPRETER_FLAGS_EQUAL))";
+    default: return "1";
+  }
+}
+
+// for a jump: computes its operands, and the compare flags for cmpj,
+// and returns the C condition under which it is taken
+static const char *jit_emitCondition(jit_source_t *src, const instruction_t *ins, const jit_unboxed_t *regs) {
+  char l[64], r[64];
+
+  if (ins->opcode == OP_JMP) {
+    switch (ins->flags) {
+      case JUMP_FLAGS_JE: return "flags & INTERPRETER_FLAGS_EQUAL";
+      case JUMP_FLAGS_JNE: return "!(flags & INTERPRETER_FLAGS_EQUAL)";
+      case JUMP_FLAGS_JG: return "flags & INTERPRETER_FLAGS_GREATER";
+      case JUMP_FLAGS_JGE: return "(flags & (INTERPRETER_FLAGS_GREATER | INTERPRETER_FLAGS_EQUAL))";
+      default: return "1";
+    }
+  }
+
+  jit_emit(src, "  int64_t l = %s;\n", JIT_LD(JIT_UNBOXED_I64));
+
+  if (ins->opcode == OP_CMPJ_IMM) {
+    jit_emit(src, "  int64_t r = (int64_t)%" PRIu64 "ULL;\n", ins->imm.u64);
+  } else {
+    jit_emit(src, "  int64_t r = %s;\n", JIT_RD(JIT_UNBOXED_I64));
+  }
+
+  jit_emit(src, "  flags = ((l > r) - (l < r)) + 1;\n");
+
+  switch (ins->flags) {
+    case JUMP_FLAGS_JE: return "l == r";
+    case JUMP_FLAGS_JNE: return "l != r";
+    case JUMP_FLAGS_JG: return "l > r";
+    case JUMP_FLAGS_JGE: return "l >= r";
+    default: return "1";
+  }
+}
+
+// for a switch: sets `target` to the byte offset it goes to, its table
+// a C array with the default past the end
+static void jit_emitSwitchTarget(jit_source_t *src, const instruction_t *ins, const jit_unboxed_t *regs) {
+  const code_table_t *table = ins->imm.table;
+  char l[64], t[64];
+
+  jit_emit(src, "  static const uint32_t cases[] = {");
+
+  for (uint32_t i = 0; i < table->count; i++) {
+    jit_emit(src, " %uu,", table->offsets[i]);
+  }
+
+  jit_emit(src, " 0 };\n");
+  jit_emit(src, "  uint64_t i = (uint64_t)%s - %" PRIu64 "ULL;\n", JIT_LD(JIT_UNBOXED_I64), (uint64_t)table->low);
+  jit_emit(src, "  target = i < %uu ? cases[i] : %s;\n", table->count, JIT_T);
+}
+
+static bool jit_emitInstruction(jit_source_t *src, const code_t *code, const instruction_t *ins, const jit_unboxed_t *regs) {
+  static const char binops[] = { '+', '-', '*', '/' };
+  char l[64], r[64], t[64];
+
+  jit_emit(src, "{\n");
+
+  if (ins->opcode >= CODE_OP_ADD_I64 && ins->opcode <= CODE_OP_DIV_F64_LR_IMM) {
+    unsigned variant = (ins->opcode - CODE_OP_ADD_I64) % 8;
+    char op = binops[(ins->opcode - CODE_OP_ADD_I64) / 8];
+    uint8_t right = (variant & CMP_FLAG_F64_R) ? JIT_UNBOXED_F64 : JIT_UNBOXED_I64;
+    const char *left = JIT_LD((variant & CMP_FLAG_F64_L) ? JIT_UNBOXED_F64 : JIT_UNBOXED_I64);
+
+    if (variant & CMP_FLAG_IMM_R) {
+      jit_emit(src, (variant & CMP_FLAG_F64_R)
+        ? "  %s = %s %c jit_f64(%" PRIu64 "ULL);\n"
+        : "  %s = %s %c (int64_t)%" PRIu64 "ULL;\n",
+        left, left, op, ins->imm.u64);
+    } else {
+      jit_emit(src, "  %s = %s %c %s;\n", left, left, op, JIT_RD(right));
+    }
+
+    jit_emit(src, "}\n");
+
+    return true;
+  }
+
+  switch (ins->opcode) {
+    case OP_NOOP:
+    case OP_CONST:
+      break;
+
+    case OP_JIT:
+      // nested regions run as part of this one, except memoized ones,
+      // which the interpreter looks up
+      if ((ins->flags & JIT_FLAG_BEGIN) && (ins->flags & JIT_FLAG_MEMOIZE)) {
+        jit_emit(src, "  target = %u; goto _exit;\n", ins->offset);
+      }
+      break;
+
+    case OP_LOAD:
+      if (jit_isRegister(&ins->left) && JIT_IS_UNBOXED(regs[ins->left.loc])) {
+        jit_emit(src, ins->flags == CONST_FLAGS_F64
+          ? "  u%u = jit_f64(%" PRIu64 "ULL);\n"
+          : "  u%u = (int64_t)%" PRIu64 "ULL;\n", (unsigned)ins->left.loc, ins->imm.u64);
+        break;
+      }
+
+      jit_emit(src, "  value_t *v = %s;\n", JIT_L);
+      jit_emitConstant(src, code, ins, "v", ins->seen[0]);
+      break;
+
+    case OP_MOV:
+      if ((ins->left.at & 0x3) == AT_REG) {
+        jit_emit(src, "  *%s = *%s;\n", JIT_L, JIT_R);
+      } else {
+        jit_emitCopy(src, ins, JIT_L, JIT_R);
+      }
+      break;
+
+    case CODE_OP_SETCC:
+      if (jit_isRegister(&ins->left) && regs[ins->left.loc].kind == JIT_UNBOXED_I64) {
+        jit_emit(src, "  u%u = %s ? %d : %d;\n", (unsigned)ins->left.loc, jit_flagsCondition(ins->flags), !ins->imm.b, ins->imm.b);
+      } else {
+        jit_emit(src, "  value_setInt(rt, %s, %s ? %d : %d);\n", JIT_L, jit_flagsCondition(ins->flags), !ins->imm.b, ins->imm.b);
+      }
+      break;
+
+    case CODE_OP_SELECT:
+      jit_emit(src, "  value_t *from = %s ? %s : %s;\n", jit_flagsCondition(ins->flags), JIT_R,
+        jit_operand(t, sizeof(t), &ins->target));
+
+      if ((ins->left.at & 0x3) == AT_REG) {
+        jit_emit(src, "  *%s = *from;\n", JIT_L);
+      } else {
+        jit_emit(src, "  if (from != %s) {\n", JIT_L);
+        jit_emitCopy(src, ins, JIT_L, "from");
+        jit_emit(src, "  }\n");
+      }
+      break;
+
+    case OP_TAKE:
+      if (ins->flags == TAKE_FLAGS_PUSH) {
+        jit_emit(src, "  storage_t *stack = &s[AT_LOCAL];\n");
+        jit_emit(src, "  value_moveValue(rt, &stack->data[*stack->lenVal], %s);\n", JIT_R);
+        jit_emit(src, "  ++*stack->lenVal;\n");
+      } else {
+        jit_emit(src, "  value_moveValue(rt, %s, %s);\n", JIT_L, JIT_R);
+      }
+      break;
+
+    case OP_CMP:
+    case CODE_OP_CMP_IMM: {
+      const char *right = r;
+
+      if (ins->opcode == CODE_OP_CMP_IMM) {
+        snprintf(r, sizeof(r), (ins->flags & CMP_FLAG_F64_R) ? "jit_f64(%" PRIu64 "ULL)" : "(int64_t)%" PRIu64 "ULL", ins->imm.u64);
+      } else {
+        JIT_RD((ins->flags & CMP_FLAG_F64_R) ? JIT_UNBOXED_F64 : JIT_UNBOXED_I64);
+      }
+
+      // as the interpreter: the difference of doubles, the ints compared
+      // over all 64 bits
+      if (ins->flags & CMP_FLAG_F64_LR) {
+        jit_emit(src, "  double c = %s - %s;\n", JIT_LD((ins->flags & CMP_FLAG_F64_L) ? JIT_UNBOXED_F64 : JIT_UNBOXED_I64), right);
+        jit_emit(src, "  flags = ((0 < c) - (c < 0)) + 1;\n");
+      } else {
+        jit_emit(src, "  int64_t l = %s, r = %s;\n", JIT_LD(JIT_UNBOXED_I64), right);
+        jit_emit(src, "  flags = ((l > r) - (l < r)) + 1;\n");
+      }
+      break;
+    }
+
+    case OP_JMP:
+    case OP_CMPJ:
+    case OP_CMPJ_IMM:
+      jit_emit(src, "  if (%s) { target = %s; goto _dispatch; }\n", jit_emitCondition(src, ins, regs), JIT_T);
+      break;
+
+    case CODE_OP_SWITCH:
+      jit_emitSwitchTarget(src, ins, regs);
+      jit_emit(src, "  goto _dispatch;\n");
+      break;
+
+    case OP_PUSH:
+      jit_emit(src, "  storage_t *stack = &s[AT_LOCAL];\n");
+      jit_emit(src, "  value_t *top = &stack->data[*stack->lenVal];\n");
+
+      if (ins->flags == CONST_FLAGS_NONE) {
+        jit_emitCopy(src, ins, "top", JIT_L);
+      } else {
+        if (ins->flags == CONST_FLAGS_NULL) {
+          jit_emit(src, "  value_release(rt, top);\n");
+        }
+
+        jit_emitConstant(src, code, ins, "top", ins->seen[1]);
+      }
+
+      jit_emit(src, "  ++*stack->lenVal;\n");
+      break;
+
+    case OP_POP:
+      jit_emit(src, "  storage_t *stack = &s[AT_LOCAL];\n");
+      jit_emit(src, "  uint16_t sz = %u;\n", (unsigned)(uint16_t)ins->imm.u64);
+      jit_emit(src, "  while (sz--) { value_t *p = &stack->data[--*stack->lenVal]; if (VALUE_OWNS(p)) { value_destroy(rt, p); VALUE_SET_META(p, TYPE_NONE, FLAG_NONE); } }\n");
+      break;
+
+    case CODE_OP_MOD_I64:
+    case OP_XOR:
+    case OP_AND:
+    case OP_OR:
+    case OP_SHL:
+    case OP_SHR:
+    case CODE_OP_MOD_I64_IMM:
+    case CODE_OP_XOR_IMM:
+    case CODE_OP_AND_IMM:
+    case CODE_OP_OR_IMM:
+    case CODE_OP_SHL_IMM:
+    case CODE_OP_SHR_IMM: {
+      bool imm = ins->opcode >= CODE_OP_MOD_I64_IMM;
+      const char *left = JIT_LD(JIT_UNBOXED_I64);
+      const char *op;
+
+      switch (ins->opcode) {
+        case CODE_OP_MOD_I64: case CODE_OP_MOD_I64_IMM: op = "%"; break;
+        case OP_XOR: case CODE_OP_XOR_IMM: op = "^"; break;
+        case OP_AND: case CODE_OP_AND_IMM: op = "&"; break;
+        case OP_OR: case CODE_OP_OR_IMM: op = "|"; break;
+        case OP_SHL: case CODE_OP_SHL_IMM: op = "<<"; break;
+        default: op = ">>"; break;
+      }
+
+      if (imm) {
+        jit_emit(src, "  %s = %s %s (int64_t)%" PRIu64 "ULL;\n", left, left, op, ins->imm.u64);
+      } else {
+        jit_emit(src, "  %s = %s %s %s;\n", left, left, op, JIT_RD(JIT_UNBOXED_I64));
+      }
+      break;
+    }
+
+    case OP_NEG: {
+      const char *left = JIT_LD(ins->flags == CMP_FLAG_F64_L ? JIT_UNBOXED_F64 : JIT_UNBOXED_I64);
+
+      jit_emit(src, "  %s = -%s;\n", left, left);
+      break;
+    }
+
+    case OP_NOT: {
+      const char *left = JIT_LD(JIT_UNBOXED_I64);
+
+      jit_emit(src, "  %s = ~%s;\n", left, left);
+      break;
+    }
+
+    case OP_CALL:
+    case CODE_OP_GETFIELD:
+    case CODE_OP_SETFIELD:
+      // no $r slot is unboxed in a region that calls, see jit_findUnboxed
+      // the offset after the call, as INTERPRETER_SYNC_PC stores
+      jit_emit(src, "  VM_PROGRAM_COUNTER(rt->dt) = %u;\n  runtime_safepoint(rt);\n", ins[1].offset);
+
+      if (ins->flags & (CALL_FLAGS_OPERANDS | CALL_FLAGS_RESULT)) {
+        jit_emit(src, "  builtins_callResolved(rt, (instruction_t*)&bb8_instructions[%u]);\n", (uint32_t)(ins - code->instructions));
+        break;
+      }
+
+      // the member cache is written to, the instructions are only const to generated code
+      jit_emit(src, "  if (!builtins_callDirect(rt, (instruction_t*)&bb8_instructions[%u], %s, %d, NULL, &s[AT_REG].data[0])) {\n",
+        (uint32_t)(ins - code->instructions), JIT_L, (ins->flags & CALL_FLAGS_REGISTER_ARGS) != 0);
+      jit_emit(src, "    s[AT_REG].data[0] = %s(rt, %s);\n  }\n",
+        (ins->flags & CALL_FLAGS_REGISTER_ARGS) ? "value_invokeWithRegisters" : "value_invoke", JIT_L);
+      break;
+
+    case OP_PRINT:
+      jit_emit(src, "  output_writeValue(&rt->output, %s);\n", JIT_L);
+      break;
+
+    case OP_HALT:
+      // the interpreter executes the halt itself
+      jit_emit(src, "  target = %u; goto _exit;\n", ins->offset);
+      break;
+
+    default:
+      return false;
+  }
+
+  jit_emit(src, "}\n");
+
+  return true;
+}
+
+// the start of `bb8_region`, up to its first instruction: the type checks
+// and locals of the unboxed registers. returns `entryOffset` (nothing has
+// run yet) if a typed register does not hold its type.
+static void jit_emitPrologue(jit_source_t *src, const jit_unboxed_t *regs, uint32_t entryOffset) {
+  jit_emit(src, "%s", JIT_SRC_HEADER);
+
+  for (unsigned i = 0; i < NUM_REGISTERS; i++) {
+    if (JIT_IS_UNBOXED(regs[i]) && regs[i].typed) {
+      // nothing has run yet, the interpreter can take the whole region
+      jit_emit(src, "  if (!VALUE_IS(&s[AT_REG].data[%u], %s, FLAG_NONE)) {\n    return value_fromUint(%u);\n  }\n\n",
+        i, regs[i].kind == JIT_UNBOXED_F64 ? "TYPE_DOUBLE" : "TYPE_INT", entryOffset);
+    }
+  }
+
+  for (unsigned i = 0; i < NUM_REGISTERS; i++) {
+    if (JIT_IS_UNBOXED(regs[i])) {
+      jit_emit(src, regs[i].kind == JIT_UNBOXED_F64
+        ? "  double u%u = s[AT_REG].data[%u].data.dbl;\n"
+        : "  int64_t u%u = s[AT_REG].data[%u].data.i64;\n", i, i);
+    }
+  }
+}
+
+// `_exit`, which every way out of the region goes through: stores the
+// unboxed registers and compare flags back and returns `target`
+static void jit_emitEpilogue(jit_source_t *src, const jit_unboxed_t *regs) {
+  jit_emit(src, "_exit:\n");
+
+  for (unsigned i = 0; i < NUM_REGISTERS; i++) {
+    if (JIT_IS_UNBOXED(regs[i])) {
+      jit_emit(src, "  s[AT_REG].data[%u].data.%s = u%u;\n", i, regs[i].kind == JIT_UNBOXED_F64 ? "dbl" : "i64", i);
+    }
+  }
+
+  jit_emit(src, "  if (frame != NULL) {\n"
+    "    frame->flags = flags;\n"
+    "  }\n\n"
+    "  return value_fromUint(target);\n\n");
+}
+
+// translates instructions [first, end) of `code` into `bb8_region`.
+// falling off the end resumes the interpreter at `exitOffset`.
+static bool jit_generate(jit_source_t *src, const code_t *code, uint32_t first, uint32_t end, uint32_t exitOffset) {
+  jit_unboxed_t regs[NUM_REGISTERS];
+
+  jit_findUnboxed(code, first, end, regs);
+  jit_emitPrologue(src, regs, code->instructions[first].offset);
+
+  for (uint32_t i = first; i < end; i++) {
+    jit_emit(src, "_lbl_%u: ; ", code->instructions[i].offset);
+
+    if (!jit_emitInstruction(src, code, &code->instructions[i], regs)) {
+      return false;
+    }
+  }
+
+  jit_emit(src, "\n  target = %u;\n\n", exitOffset);
+  jit_emitEpilogue(src, regs);
+
+  // jumps resolve their byte offset here; offsets outside of the region
+  // (or not on an instruction boundary) go back to the interpreter
+  jit_emit(src, "_dispatch:\n  switch (target) {\n");
+
+  for (uint32_t i = first; i < end; i++) {
+    jit_emit(src, "    case %u: goto _lbl_%u;\n", code->instructions[i].offset, code->instructions[i].offset);
+  }
+
+  jit_emit(src, "    default: goto _exit;\n  }\n}\n");
+
+  return true;
+}
+
+// ===== traces =====
+
+// a call on a trace to a leaf builtin, inlined behind a check that the
+// callee is still that builtin. false for any other call.
+static bool jit_emitTraceCall(jit_source_t *src, const instruction_t *ins) {
+  value_t *callee = CODE_OPERAND_VALUE(ins->left);
+  const char *arg = (ins->flags & CALL_FLAGS_REGISTER_ARGS) ? "builtins_arg(rt, 1, NULL, %u)" : "builtins_arg(rt, 0, NULL, %u)";
+  const char *name;
+  char a0[64], a1[64], l[64], d[64];
+  uint64_t numArgs;
+
+  if (!VALUE_IS(callee, TYPE_FUNCTION, FLAG_NONE)) {
+    return false;
+  } else if (callee->data.fn == _System_C_fmod) {
+    name = "_System_C_fmod";
+    numArgs = 2;
+  } else if (callee->data.fn == _System_C_strlen) {
+    name = "_System_C_strlen";
+    numArgs = 1;
+  } else {
+    return false;
+  }
+
+  if (!(ins->flags & CALL_FLAGS_OPERANDS)) {
+    snprintf(a0, sizeof(a0), arg, 0u);
+    snprintf(a1, sizeof(a1), arg, 1u);
+  } else if (ins->imm.call.count >= numArgs) {
+    jit_operand(a0, sizeof(a0), &ins->imm.call.args[0]);
+    jit_operand(a1, sizeof(a1), &ins->imm.call.args[numArgs - 1]);
+  } else {
+    return false;
+  }
+
+  if (ins->flags & CALL_FLAGS_RESULT) {
+    jit_operand(d, sizeof(d), &ins->right);
+  } else {
+    snprintf(d, sizeof(d), "(&s[AT_REG].data[0])");
+  }
+
+  jit_emit(src, "{\n  value_t *fn = %s;\n  value_t *res = %s;\n", JIT_L, d);
+  jit_emit(src, "  if (!VALUE_IS(fn, TYPE_FUNCTION, FLAG_NONE) || fn->data.fn != %s) { target = %u; goto _exit; }\n", name, ins->offset);
+
+  // over what was there, as builtins_callOperands
+  if ((ins->flags & CALL_FLAGS_RESULT) && (ins->right.at & 0x3) != AT_REG) {
+    jit_emit(src, "  value_release(rt, res);\n");
+  }
+
+  if (callee->data.fn == _System_C_fmod) {
+    jit_emit(src, "  res->data.dbl = fmod(%s->data.dbl, %s->data.dbl);\n", a0, a1);
+    jit_emit(src, "  VALUE_SET_META(res, TYPE_DOUBLE, FLAG_NONE);\n");
+  } else {
+    jit_emit(src, "  res->data.i64 = builtins_strlen(%s);\n", a0);
+    jit_emit(src, "  VALUE_SET_META(res, TYPE_INT, FLAG_NONE);\n");
+  }
+
+  jit_emit(src, "}\n");
+
+  return true;
+}
+
+// a jump on a trace, guarded to go the way it went while recording:
+// taken to `next`, or not taken. either way, leaving the trace returns
+// to the interpreter at the instruction the jump really goes to.
+static void jit_emitTraceJump(jit_source_t *src, const code_t *code, const instruction_t *ins,
+                              const instruction_t *next, const jit_unboxed_t *regs) {
+  char t[64];
+  const char *cond;
+
+  jit_emit(src, "{\n");
+  cond = jit_emitCondition(src, ins, regs);
+
+  if (next == ins + 1) {
+    jit_emit(src, "  if (%s) { target = %s; goto _exit; }\n", cond, JIT_T);
+  } else {
+    if (strcmp(cond, "1") != 0) {
+      jit_emit(src, "  if (!(%s)) { target = %u; goto _exit; }\n", cond, (ins + 1)->offset);
+    }
+
+    jit_emit(src, "  target = %s;\n", JIT_T);
+    jit_emit(src, "  if (target != %u) { goto _exit; }\n", next->offset);
+  }
+
+  jit_emit(src, "}\n");
+}
+
+// translates a recorded trace into `bb8_region`, as a loop over its path
+static bool jit_generateTrace(jit_source_t *src, const code_t *code, const jit_trace_t *trace) {
+  jit_unboxed_t regs[NUM_REGISTERS];
+  uint32_t first = trace->header, end = trace->header + 1;
+
+  // unboxing is decided over a code range; the trace's own is
+  // conservative, as the path runs a subset of it
+  for (uint32_t i = 0; i < trace->len; i++) {
+    if (trace->path[i] < first) {
+      first = trace->path[i];
+    } else if (trace->path[i] >= end) {
+      end = trace->path[i] + 1;
+    }
+  }
+
+  jit_findUnboxed(code, first, end, regs);
+  jit_emitPrologue(src, regs, code->instructions[trace->header].offset);
+  jit_emit(src, "_loop: ;\n");
+
+  for (uint32_t i = 0; i < trace->len; i++) {
+    const instruction_t *ins = &code->instructions[trace->path[i]];
+    const instruction_t *next = &code->instructions[i + 1 < trace->len ? trace->path[i + 1] : trace->header];
+
+    switch (ins->opcode) {
+      case OP_JMP:
+      case OP_CMPJ:
+      case OP_CMPJ_IMM:
+        jit_emitTraceJump(src, code, ins, next, regs);
+        break;
+      case CODE_OP_SWITCH:
+        // guarded to go to the case it went to while recording
+        jit_emit(src, "{\n");
+        jit_emitSwitchTarget(src, ins, regs);
+        jit_emit(src, "  if (target != %u) { goto _exit; }\n}\n", next->offset);
+        break;
+      case OP_CALL:
+      case CODE_OP_GETFIELD:
+      case CODE_OP_SETFIELD:
+        if (jit_emitTraceCall(src, ins)) {
+          break;
+        }
+        // fallthrough
+      default:
+        if (!jit_emitInstruction(src, code, ins, regs)) {
+          return false;
+        }
+    }
+  }
+
+  jit_emit(src, "  goto _loop;\n\n");
+  jit_emitEpilogue(src, regs);
+  jit_emit(src, "}\n");
+
+  return true;
+}
+
+// ===== in-process compilation =====
+
+enum JIT_REGION_STATE {
+  JIT_REGION_NEW = 0,
+  JIT_REGION_COMPILED,
+  JIT_REGION_FAILED
+};
+
+// compiled functions of one kind of entry, per instruction index.
+// allocated on first use.
+typedef struct jit_entries {
+  native_function_t *fns;
+  uint8_t *states; // JIT_REGION_STATE
+} jit_entries_t;
+
+// what a memo key compares for one argument: its type, and its contents
+// or identity
+typedef struct jit_memo_id {
+  uint64_t bits;
+  uint64_t type;
+} jit_memo_id_t;
+
+typedef struct jit_memo_entry {
+  uint64_t hash;
+  uint64_t used; // jit_memo_t.clock at the last hit, 0 = empty
+  uint32_t epoch; // runtime_t.epoch when stored
+  bool pointers; // an argument is a pointer, so the epoch is checked
+  jit_memo_id_t ids[JIT_MEMO_MAX_ARGS];
+  value_t args[JIT_MEMO_MAX_ARGS]; // claimed, keeps refcounted ids from being reused
+  value_t result; // claimed
+} jit_memo_entry_t;
+
+// the memo table of one region, allocated on its first lookup
+typedef struct jit_memo {
+  uint32_t numArgs; // 0 if the region cannot be memoized
+  uint32_t end; // index of its JIT_FLAG_END
+  uint64_t clock;
+
+  // the arguments of the last miss, until jit_memoStore takes them
+  jit_memo_entry_t pending;
+  bool hasPending;
+
+  jit_memo_entry_t entries[JIT_MEMO_SETS * JIT_MEMO_WAYS];
+} jit_memo_t;
+
+struct jit {
+  code_t *code;
+
+  jit_entries_t regions; // OP_JIT regions, by their JIT_FLAG_BEGIN
+  jit_entries_t loops; // hot loops, by their header
+  jit_entries_t traces; // recorded hot loops, by their header
+  jit_memo_t **memos; // JIT_FLAG_MEMOIZE regions, by their JIT_FLAG_BEGIN
+
+  void **handles; // dlopen'd regions
+  size_t numHandles;
+
+  jit_native_region_t *native; // machine code regions
+  size_t numNative;
+};
+
+jit_t *jit_create(code_t *code) {
+  jit_t *jit = (jit_t*)calloc(1, sizeof(jit_t));
+
+  jit->code = code;
+
+  return jit;
+}
+
+uint32_t jit_hotThreshold(void) {
+  const char *mode = getenv("BB8_JIT");
+  const char *hot = getenv("BB8_JIT_HOT");
+
+  if (mode != NULL && strcmp(mode, "0") == 0) {
+    return 0;
+  }
+
+  return (hot != NULL && hot[0] != '\0') ? (uint32_t)strtoul(hot, NULL, 10) : JIT_HOT_THRESHOLD;
+}
+
+bool jit_tracing(void) {
+#if defined(BB8_JIT)
+  const char *mode = getenv("BB8_JIT");
+  const char *trace = getenv("BB8_JIT_TRACE");
+
+  // traces are only built by the C backend
+  if (mode != NULL && (strcmp(mode, "0") == 0 || strcmp(mode, "native") == 0)) {
+    return false;
+  }
+
+  return trace != NULL && trace[0] != '\0' && strcmp(trace, "0") != 0;
+#else
+  return false;
+#endif
+}
+
+#if defined(BB8_JIT)
+
+// a fresh directory per region, removed again once the object is loaded
+static bool jit_makeDir(char *dir, size_t size) {
+  const char *tmp = getenv("TMPDIR");
+
+  snprintf(dir, size, "%s/bb8-jit-XXXXXX", (tmp != NULL && tmp[0] != '\0') ? tmp : "/tmp");
+
+  return mkdtemp(dir) != NULL;
+}
+
+static bool jit_writeFile(const char *path, const jit_source_t *src) {
+  FILE *fp = fopen(path, "w");
+
+  if (fp == NULL) {
+    return false;
+  }
+
+  bool ok = fwrite(src->data, 1, src->len, fp) == src->len;
+
+  return fclose(fp) == 0 && ok;
+}
+
+// changes whenever the vm is rebuilt, so cached objects built against
+// other headers or runtime functions are never loaded
+#define JIT_BUILD_ID __FILE__ " " __DATE__ " " __TIME__
+
+// the persistent cache: BB8_JIT_CACHE, or $XDG_CACHE_HOME/bb8-jit,
+// or ~/.cache/bb8-jit. BB8_JIT_CACHE=0 turns it off.
+static bool jit_cacheDir(char *dir, size_t size) {
+  const char *env = getenv("BB8_JIT_CACHE");
+  const char *base;
+
+  if (env != NULL && strcmp(env, "0") == 0) {
+    return false;
+  }
+
+  if (env != NULL && env[0] != '\0') {
+    snprintf(dir, size, "%s", env);
+  } else if ((base = getenv("XDG_CACHE_HOME")) != NULL && base[0] != '\0') {
+    snprintf(dir, size, "%s/bb8-jit", base);
+  } else if ((base = getenv("HOME")) != NULL && base[0] != '\0') {
+    char parent[256];
+
+    snprintf(parent, sizeof(parent), "%s/.cache", base);
+    mkdir(parent, 0755);
+    snprintf(dir, size, "%s/bb8-jit", parent);
+  } else {
+    return false;
+  }
+
+  return mkdir(dir, 0755) == 0 || errno == EEXIST;
+}
+
+// dlopens a region object and points its bb8_instructions at our code
+static native_function_t jit_load(jit_t *jit, const char *soPath) {
+  native_function_t fn = NULL;
+  void *handle, *sym;
+
+  if ((handle = dlopen(soPath, RTLD_NOW | RTLD_LOCAL)) == NULL) {
+    return NULL;
+  }
+
+  if ((sym = dlsym(handle, "bb8_instructions")) != NULL) {
+    *(const instruction_t**)sym = jit->code->instructions;
+
+    if ((sym = dlsym(handle, "bb8_region")) != NULL) {
+      *(void**)(&fn) = sym;
+    }
+  }
+
+  if (fn == NULL) {
+    dlclose(handle);
+    return NULL;
+  }
+
+  jit->handles = (void**)realloc(jit->handles, sizeof(void*) * (jit->numHandles + 1));
+  jit->handles[jit->numHandles++] = handle;
+
+  return fn;
+}
+
+// generated code holds no process addresses (see bb8_instructions), so an
+// object built for the same source by the same vm can be reused by later
+// runs. it is cached under the hash of both.
+static native_function_t jit_compile(jit_t *jit, const jit_source_t *src) {
+  char dir[256], cacheDir[256], cPath[320], soPath[320], cachePath[320], cmd[1024];
+  const char *cc = getenv("BB8_JIT_CC");
+  bool cached = jit_cacheDir(cacheDir, sizeof(cacheDir));
+  native_function_t fn = NULL;
+  uint64_t key = HASH_BYTES_INIT;
+
+  if (cc == NULL || cc[0] == '\0') {
+    cc = "cc";
+  }
+
+  key = hashBytes64(JIT_BUILD_ID, sizeof(JIT_BUILD_ID), key);
+  key = hashBytes64(cc, strlen(cc) + 1, key);
+  key = hashBytes64(src->data, src->len, key);
+
+  if (cached) {
+    snprintf(cachePath, sizeof(cachePath), "%s/%016" PRIx64 ".so", cacheDir, key);
+
+    if ((fn = jit_load(jit, cachePath)) != NULL) {
+      return fn;
+    }
+  }
+
+  if (!jit_makeDir(dir, sizeof(dir))) {
+    return NULL;
+  }
+
+  snprintf(cPath, sizeof(cPath), "%s/region.c", dir);
+
+  // built next to its final name, so concurrent runs only ever see a
+  // complete object there: rename() replaces it atomically
+  if (cached) {
+    snprintf(soPath, sizeof(soPath), "%s/%016" PRIx64 ".%ld.tmp", cacheDir, key, (long)getpid());
+  } else {
+    snprintf(soPath, sizeof(soPath), "%s/region.so", dir);
+  }
+
+  snprintf(cmd, sizeof(cmd), "%s -O2 -shared -fPIC -w -I%s -DNUM_REGISTERS=%d -o %s %s",
+    cc, BB8_JIT_INCLUDE_DIR, NUM_REGISTERS, soPath, cPath);
+
+  if (jit_writeFile(cPath, src) && system(cmd) == 0) {
+    if (cached && rename(soPath, cachePath) == 0) {
+      fn = jit_load(jit, cachePath);
+    } else {
+      fn = jit_load(jit, soPath);
+    }
+
+    if (fn == NULL) {
+      fprintf(stderr, "jit: %s\n", dlerror());
+    }
+  }
+
+  // a loaded object stays mapped, so only the cache is left on disk.
+  // the program may end in a halt, which never reaches jit_destroy.
+  unlink(soPath);
+  unlink(cPath);
+  rmdir(dir);
+
+  return fn;
+}
+
+#endif
+
+void jit_destroy(jit_t *jit) {
+#if defined(BB8_JIT)
+  for (size_t i = 0; i < jit->numHandles; i++) {
+    dlclose(jit->handles[i]);
+  }
+
+#endif
+
+  for (size_t i = 0; i < jit->numNative; i++) {
+    jit_native_free(&jit->native[i]);
+  }
+
+  free(jit->native);
+  free(jit->handles);
+  free(jit->regions.fns);
+  free(jit->regions.states);
+  free(jit->loops.fns);
+  free(jit->loops.states);
+  free(jit->traces.fns);
+  free(jit->traces.states);
+
+  // claims held by memo tables go away with the runtime
+  for (size_t i = 0; jit->memos != NULL && i < jit->code->count; i++) {
+    free(jit->memos[i]);
+  }
+
+  free(jit->memos);
+  free(jit);
+}
+
+// returns the entry for instruction `index` if it was tried before,
+// otherwise marks it as failed (so it is not retried) and returns false
+static bool jit_lookup(const code_t *code, jit_entries_t *entries, uint32_t index, native_function_t *fn) {
+  if (entries->states == NULL) {
+    entries->fns = (native_function_t*)calloc(code->count, sizeof(native_function_t));
+    entries->states = (uint8_t*)calloc(code->count, sizeof(uint8_t));
+  }
+
+  if (entries->states[index] != JIT_REGION_NEW) {
+    *fn = entries->fns[index];
+    return true;
+  }
+
+  entries->states[index] = JIT_REGION_FAILED;
+
+  return false;
+}
+
+static void jit_store(jit_entries_t *entries, uint32_t index, native_function_t fn) {
+  if (fn != NULL) {
+    entries->fns[index] = fn;
+    entries->states[index] = JIT_REGION_COMPILED;
+  }
+}
+
+// compiles instructions [first, end), with the machine code templates
+// first and the C compiler for what they do not cover
+static native_function_t jit_compileRange(jit_t *jit, uint32_t first, uint32_t end, uint32_t exitOffset) {
+  const char *mode = getenv("BB8_JIT");
+  const jit_native_backend_t *backend = jit_native_backend();
+  native_function_t fn = NULL;
+  jit_native_region_t native;
+
+  if (mode != NULL && strcmp(mode, "0") == 0) {
+    return NULL;
+  }
+
+  if (backend != NULL && (mode == NULL || strcmp(mode, "c") != 0)) {
+    fn = backend->compile(jit->code, first, end, exitOffset, &native);
+
+    if (fn != NULL) {
+      jit->native = (jit_native_region_t*)realloc(jit->native, sizeof(jit_native_region_t) * (jit->numNative + 1));
+      jit->native[jit->numNative++] = native;
+    }
+  }
+
+#if defined(BB8_JIT)
+  if (fn == NULL && (mode == NULL || strcmp(mode, "native") != 0)) {
+    jit_source_t src = { NULL, 0, 0, NULL };
+
+    if (jit_generate(&src, jit->code, first, end, exitOffset)) {
+      fn = jit_compile(jit, &src);
+    }
+
+    free(src.data);
+  }
+#endif
+
+  return fn;
+}
+
+// index of the JIT_FLAG_END closing the region opened at `index`,
+// or code->count if there is none. decodes the region and the
+// instruction after it.
+static uint32_t jit_regionEnd(code_t *code, uint32_t index) {
+  uint32_t end = index + 1;
+
+  code_ensure(code, end, end + 1);
+
+  while (end < code->count && !(code->instructions[end].opcode == OP_JIT
+      && (code->instructions[end].flags & JIT_FLAG_END))) {
+    ++end;
+    code_ensure(code, end, end + 1);
+  }
+
+  code_ensure(code, end + 1, end + 2);
+
+  return end;
+}
+
+// whether BB8_JIT_TRACE asks for the regions that fail to compile
+static bool jit_reporting(void) {
+  const char *trace = getenv("BB8_JIT_TRACE");
+
+  return trace != NULL && trace[0] != '\0' && strcmp(trace, "0") != 0;
+}
+
+native_function_t jit_region(jit_t *jit, const instruction_t *begin) {
+  code_t *code = jit->code;
+  uint32_t index = begin - code->instructions;
+  const char *mode = getenv("BB8_JIT");
+  uint32_t end;
+  native_function_t fn;
+
+  // turned off on purpose: interpreted, and nothing to say
+  if (mode != NULL && strcmp(mode, "0") == 0) {
+    return NULL;
+  }
+
+  if (jit_lookup(code, &jit->regions, index, &fn)) {
+    return fn;
+  }
+
+  if ((end = jit_regionEnd(code, index)) == code->count) {
+    fprintf(stderr, "jit: region at offset %u has no end, interpreting it\n", begin->offset);
+    return NULL;
+  }
+
+  if ((fn = jit_compileRange(jit, index + 1, end, code->instructions[end + 1].offset)) == NULL) {
+    if (jit_reporting()) {
+      fprintf(stderr, "jit: could not compile region at offset %u, interpreting it\n", begin->offset);
+    }
+
+    return NULL;
+  }
+
+  jit_store(&jit->regions, index, fn);
+
+  return fn;
+}
+
+native_function_t jit_loop(jit_t *jit, const instruction_t *header, const instruction_t *latch) {
+  code_t *code = jit->code;
+  uint32_t index = header - code->instructions;
+  uint32_t end = (latch - code->instructions) + 1;
+  native_function_t fn;
+
+  if (jit_lookup(code, &jit->loops, index, &fn)) {
+    return fn;
+  }
+
+  // the last instruction is the terminating halt, so a jump always has one after it.
+  // failures are silent: the loop just stays interpreted.
+  code_ensure(code, index, end + 1);
+  jit_store(&jit->loops, index, fn = jit_compileRange(jit, index, end, code->instructions[end].offset));
+
+  return fn;
+}
+
+// ===== memoized regions =====
+
+static jit_memo_id_t jit_memoId(value_t *v) {
+  jit_memo_id_t id = { 0, VALUE_TYPE_OF(v) };
+
+  switch (id.type) {
+    case TYPE_NONE: break;
+    case TYPE_BOOLEAN: id.bits = v->data.b; break; // only the bool is set
+    case TYPE_POINTER: id.bits = value_getID(v); break;
+    default: id.bits = v->data.u64; break;
+  }
+
+  return id;
+}
+
+static void jit_memoClear(runtime_t *rt, jit_memo_t *memo, jit_memo_entry_t *e) {
+  for (uint32_t i = 0; i < memo->numArgs; i++) {
+    value_destroy(rt, &e->args[i]);
+    VALUE_SET_META(&e->args[i], TYPE_NONE, FLAG_NONE);
+  }
+
+  value_destroy(rt, &e->result);
+  VALUE_SET_META(&e->result, TYPE_NONE, FLAG_NONE);
+  e->used = 0;
+}
+
+void jit_reset(jit_t *jit, runtime_t *rt) {
+  for (size_t i = 0; jit->memos != NULL && i < jit->code->count; i++) {
+    jit_memo_t *memo = jit->memos[i];
+
+    if (memo == NULL || memo->numArgs == 0) {
+      continue;
+    }
+
+    if (memo->hasPending) {
+      jit_memoClear(rt, memo, &memo->pending);
+      memo->hasPending = false;
+    }
+
+    for (size_t e = 0; e < JIT_MEMO_SETS * JIT_MEMO_WAYS; e++) {
+      if (memo->entries[e].used != 0) {
+        jit_memoClear(rt, memo, &memo->entries[e]);
+      }
+    }
+  }
+}
+
+// the memo table of the region opened by `begin`, created on first use
+static jit_memo_t *jit_memo(jit_t *jit, const instruction_t *begin) {
+  code_t *code = jit->code;
+  uint32_t index = begin - code->instructions;
+  jit_memo_t *memo;
+
+  if (jit->memos == NULL) {
+    jit->memos = (jit_memo_t**)calloc(code->count, sizeof(jit_memo_t*));
+  }
+
+  if ((memo = jit->memos[index]) == NULL) {
+    uint32_t end = jit_regionEnd(code, index);
+
+    // zeroed values are TYPE_NONE, so every entry starts out empty
+    memo = jit->memos[index] = (jit_memo_t*)calloc(1, sizeof(jit_memo_t));
+
+    if (end < code->count && begin->imm.u64 <= JIT_MEMO_MAX_ARGS) {
+      memo->numArgs = (uint32_t)begin->imm.u64;
+      memo->end = end;
+    }
+  }
+
+  return memo->numArgs != 0 ? memo : NULL;
+}
+
+instruction_t *jit_memoLookup(jit_t *jit, runtime_t *rt, const instruction_t *begin, value_t *result) {
+  jit_memo_t *memo = jit_memo(jit, begin);
+  storage_t *stack = &rt->dt->storage[AT_LOCAL];
+  jit_memo_entry_t *set, *key;
+
+  if (memo == NULL) {
+    return NULL;
+  }
+
+  key = &memo->pending;
+
+  if (memo->hasPending) {
+    jit_memoClear(rt, memo, key); // the region never reached its end last time
+    memo->hasPending = false;
+  }
+
+  key->hash = HASH_BYTES_INIT;
+  key->pointers = false;
+
+  // argument 0 is the top of the stack, as in args_getArg
+  for (uint32_t i = 0; i < memo->numArgs; i++) {
+    key->ids[i] = jit_memoId(&stack->data[*stack->lenVal - 1 - i]);
+    key->hash = hashBytes64(&key->ids[i], sizeof(jit_memo_id_t), key->hash);
+    key->pointers |= key->ids[i].type == TYPE_POINTER;
+  }
+
+  set = &memo->entries[(key->hash % JIT_MEMO_SETS) * JIT_MEMO_WAYS];
+  ++memo->clock;
+
+  for (uint32_t w = 0; w < JIT_MEMO_WAYS; w++) {
+    jit_memo_entry_t *e = &set[w];
+
+    if (e->used == 0 || e->hash != key->hash
+        || memcmp(e->ids, key->ids, sizeof(jit_memo_id_t) * memo->numArgs) != 0) {
+      continue;
+    }
+
+    if (e->pointers && e->epoch != rt->epoch) {
+      jit_memoClear(rt, memo, e);
+      break;
+    }
+
+    e->used = memo->clock;
+    *result = e->result;
+
+    return &jit->code->instructions[memo->end + 1];
+  }
+
+  // hold on to the arguments, the region may pop them
+  for (uint32_t i = 0; i < memo->numArgs; i++) {
+    value_copyValue(rt, &key->args[i], &stack->data[*stack->lenVal - 1 - i]);
+  }
+
+  memo->hasPending = true;
+
+  return NULL;
+}
+
+void jit_memoStore(jit_t *jit, runtime_t *rt, const instruction_t *begin, const instruction_t *next, value_t *result) {
+  jit_memo_t *memo = jit_memo(jit, begin);
+  jit_memo_entry_t *set, *victim;
+
+  if (memo == NULL || !memo->hasPending) {
+    return;
+  }
+
+  memo->hasPending = false;
+
+  // a jump to the label just before the end marker leaves at the marker
+  if (next != &jit->code->instructions[memo->end] && next != &jit->code->instructions[memo->end + 1]) {
+    jit_memoClear(rt, memo, &memo->pending);
+    return;
+  }
+
+  set = &memo->entries[(memo->pending.hash % JIT_MEMO_SETS) * JIT_MEMO_WAYS];
+  victim = &set[0];
+
+  for (uint32_t w = 1; w < JIT_MEMO_WAYS && victim->used != 0; w++) {
+    if (set[w].used < victim->used) {
+      victim = &set[w];
+    }
+  }
+
+  jit_memoClear(rt, memo, victim);
+
+  // the pending claims move into the entry
+  *victim = memo->pending;
+  victim->epoch = rt->epoch;
+  victim->used = memo->clock;
+  value_copyValue(rt, &victim->result, result);
+
+  for (uint32_t i = 0; i < memo->numArgs; i++) {
+    VALUE_SET_META(&memo->pending.args[i], TYPE_NONE, FLAG_NONE);
+  }
+}
+
+native_function_t jit_traceLookup(jit_t *jit, const instruction_t *header, bool *record) {
+  native_function_t fn = NULL;
+
+  *record = !jit_lookup(jit->code, &jit->traces, header - jit->code->instructions, &fn);
+
+  return fn;
+}
+
+native_function_t jit_traceCompile(jit_t *jit, const jit_trace_t *trace) {
+  native_function_t fn = NULL;
+
+  // jit_traceLookup marked the header as failed, storing a result undoes that
+  if (!trace->complete) {
+    return NULL;
+  }
+
+#if defined(BB8_JIT)
+  {
+    jit_source_t src = { NULL, 0, 0, NULL };
+
+    if (jit_generateTrace(&src, jit->code, trace)) {
+      fn = jit_compile(jit, &src);
+    }
+
+    free(src.data);
+  }
+#endif
+
+  jit_store(&jit->traces, trace->header, fn);
+
+  return fn;
+}
+
+// ===== ahead-of-time compilation =====
+
+// the whole .bin, for jit_aotMain to load, and the entry point.
+// without `region` the program is only interpreted.
+static void jit_emitAotMain(jit_source_t *src, const image_t *image, bool region) {
+  jit_emit(src, "\nstatic const ubyte_t bb8_bytecode[%zu] = {", image->fileLen != 0 ? image->fileLen : 1);
+
+  for (size_t i = 0; i < image->fileLen; i++) {
+    jit_emit(src, "%s0x%02x,", (i % 16) == 0 ? "\n  " : " ", image->file[i]);
+  }
+
+  jit_emit(src, "\n};\n\n"
+    "int main(void) {\n"
+    "  return jit_aotMain(%s, bb8_bytecode, %zu);\n"
+    "}\n", region ? "bb8_region, &bb8_instructions" : "NULL, NULL", image->fileLen);
+}
+
+bool jit_aot(interpreter_t *it, const char *cPath, const char *exePath) {
+  jit_source_t src = { NULL, 0, 0, NULL };
+  code_t *code = it->code;
+  bool ok = true;
+
+  if ((src.out = fopen(cPath, "w")) == NULL) {
+    fprintf(stderr, "aot: could not open %s\n", cPath);
+    return false;
+  }
+
+  // as with regions, the generated code does no bounds checking
+  if (it->verify == VERIFY_OK) {
+    // the interpreter's halt ends the program, at the end of the bytecode
+    code_ensure(code, 0, code->count);
+    ok = jit_generate(&src, code, 0, code->count, code->len);
+
+    if (ok) {
+      jit_emitAotMain(&src, it->image, true);
+    }
+  } else {
+    fprintf(stderr, "aot: bytecode does not verify (%s at offset %u), it will be interpreted\n",
+      verify_resultString(it->verify), it->verifyOffset);
+
+    jit_emit(&src, "#include <vm/jit.h>\n");
+    jit_emitAotMain(&src, it->image, false);
+  }
+
+  if (fclose(src.out) != 0 || !ok) {
+    fprintf(stderr, "aot: failed to translate bytecode\n");
+    return false;
+  }
+
+  if (exePath == NULL) {
+    return true;
+  }
+
+#if defined(BB8_JIT)
+  {
+    char cmd[1024];
+    const char *cc = getenv("BB8_JIT_CC");
+
+    if (cc == NULL || cc[0] == '\0') {
+      cc = "cc";
+    }
+
+    // exported symbols, so regions the executable compiles at run time
+    // (OP_JIT, hot loops) can still call back into it. BB8_AOT_CFLAGS
+    // optimizes the program together with the library, see BB8_AOT_LTO.
+    snprintf(cmd, sizeof(cmd), "%s -O2 %s -w -rdynamic -I%s -DNUM_REGISTERS=%d -o %s %s %s %s",
+      cc, BB8_AOT_CFLAGS, BB8_JIT_INCLUDE_DIR, NUM_REGISTERS, exePath, cPath, BB8_AOT_LIBRARY, BB8_AOT_LIBS);
+
+    if (system(cmd) != 0) {
+      fprintf(stderr, "aot: compiling %s failed\n", cPath);
+      return false;
+    }
+
+    return true;
+  }
+#else
+  fprintf(stderr, "aot: built without BB8_JIT, compile %s against libvm by hand\n", cPath);
+  return false;
+#endif
+}
+
+int jit_aotMain(native_function_t region, const instruction_t **instructions, const ubyte_t *bc, size_t len) {
+  runtime_t *rt = runtime_create();
+  interpreter_t *it;
+  jit_frame_t frame = { .flags = 0 };
+  args_t args;
+  value_t next;
+
+  builtins_register(rt);
+
+  if ((it = interpreter_create(rt, bc, len)) == NULL) {
+    runtime_destroy(rt);
+    return 1;
+  }
+
+  if (region != NULL) {
+    *instructions = it->code->instructions;
+
+    args._stack = &rt->dt->storage[AT_LOCAL];
+    args._registers = NULL;
+    args._rawData = &frame;
+    args._operands = NULL;
+
+    next = region(rt, &args);
+
+    it->flags = frame.flags;
+    VM_PROGRAM_COUNTER(rt->dt) = next.data.u64;
+    interpreter_resume(it);
+  } else {
+    interpreter_run(it);
+  }
+
+  interpreter_destroy(it);
+  runtime_gc(rt);
+  runtime_destroy(rt);
+
+  return 0;
+}
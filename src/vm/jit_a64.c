@@ -0,0 +1,673 @@
+#include <vm/jit_a64.h>
+#include <vm/jit.h>
+#include <vm/runtime.h>
+#include <vm/interpreter.h>
+#include <vm/builtins.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+
+#if JIT_A64
+
+// ===== instruction encoding =====
+
+// x19 - x23 are callee-saved, so they hold their values across the calls
+// into the runtime; x16 and x17 are the intra-procedure-call scratch
+// registers, free for anything between two instructions
+enum A64_REG {
+  A64_X0 = 0,
+  A64_X1 = 1,
+  A64_X2 = 2,
+  A64_X9 = 9,
+  A64_X10 = 10,
+  A64_X11 = 11,
+  A64_X12 = 12,
+  A64_X16 = 16, // scratch for operand addresses
+  A64_X17 = 17, // scratch for immediates and call targets
+  A64_X19 = 19, // datatable
+  A64_X20 = 20, // runtime_t *rt
+  A64_X21 = 21, // jit_frame_t *frame, may be NULL
+  A64_X22 = 22, // compare flags
+  A64_X23 = 23, // block entry table
+  A64_FP = 29,
+  A64_LR = 30,
+  A64_ZR = 31 // xzr, or sp as the base of a load or store
+};
+
+// condition codes, for b.cond and cset
+enum A64_COND {
+  A64_EQ = 0x0,
+  A64_NE = 0x1,
+  A64_HI = 0x8,
+  A64_LT = 0xB,
+  A64_GT = 0xC
+};
+
+// data processing (shifted register): <op> rd, rn, rm
+enum A64_ALU {
+  A64_ADD = 0x8B000000,
+  A64_SUB = 0xCB000000,
+  A64_SUBS = 0xEB000000,
+  A64_AND = 0x8A000000,
+  A64_ANDS = 0xEA000000,
+  A64_ORR = 0xAA000000,
+  A64_ORN = 0xAA200000,
+  A64_EOR = 0xCA000000,
+  A64_MUL = 0x9B007C00, // madd rd, rn, rm, xzr
+  A64_SDIV = 0x9AC00C00,
+  A64_LSLV = 0x9AC02000,
+  A64_ASRV = 0x9AC02800
+};
+
+// loads and stores (unsigned offset), by the log2 of their size
+enum A64_MEM {
+  A64_LDRB = 0x39400000,
+  A64_STRB = 0x39000000,
+  A64_LDRW = 0xB9400000,
+  A64_STRW = 0xB9000000,
+  A64_LDR = 0xF9400000,
+  A64_STR = 0xF9000000
+};
+
+typedef struct a64_buf {
+  uint8_t *data;
+  size_t len;
+  size_t cap;
+
+  uint32_t *exits; // branch sites that jump to the exit stub
+  size_t numExits;
+  bool overflow; // a branch does not reach its target
+} a64_buf_t;
+
+// instructions are little-endian, whatever the data is
+static void a64_emit(a64_buf_t *b, uint32_t word) {
+  if (b->len + 4 > b->cap) {
+    b->cap = b->cap ? b->cap * 2 : 4096;
+    b->data = (uint8_t*)realloc(b->data, b->cap);
+  }
+
+  for (int i = 0; i < 4; i++) {
+    b->data[b->len++] = (uint8_t)(word >> (i * 8));
+  }
+}
+
+// movz, then a movk for each other 16 bits that are set
+static void a64_movImm(a64_buf_t *b, int reg, uint64_t imm) {
+  bool first = true;
+
+  if (imm == 0) {
+    a64_emit(b, 0xD2800000 | reg);
+    return;
+  }
+
+  for (int hw = 0; hw < 4; hw++) {
+    uint32_t part = (uint32_t)(imm >> (hw * 16)) & 0xFFFF;
+
+    if (part != 0) {
+      a64_emit(b, (first ? 0xD2800000 : 0xF2800000) | (hw << 21) | (part << 5) | reg);
+      first = false;
+    }
+  }
+}
+
+static void a64_alu(a64_buf_t *b, uint32_t op, int rd, int rn, int rm) {
+  a64_emit(b, op | (rm << 16) | (rn << 5) | rd);
+}
+
+// rd = rn + (rm << shift)
+static void a64_addShifted(a64_buf_t *b, int rd, int rn, int rm, int shift) {
+  a64_emit(b, A64_ADD | (rm << 16) | (shift << 10) | (rn << 5) | rd);
+}
+
+static void a64_mov(a64_buf_t *b, int rd, int rm) {
+  a64_alu(b, A64_ORR, rd, A64_ZR, rm);
+}
+
+// rd = ra - rn * rm
+static void a64_msub(a64_buf_t *b, int rd, int rn, int rm, int ra) {
+  a64_emit(b, 0x9B008000 | (rm << 16) | (ra << 10) | (rn << 5) | rd);
+}
+
+// add 0x91000000, sub 0xD1000000, subs 0xF1000000 (cmp with rd xzr) rd, rn, #imm12
+static void a64_aluImm(a64_buf_t *b, uint32_t op, int rd, int rn, uint32_t imm) {
+  a64_emit(b, op | (imm << 10) | (rn << 5) | rd);
+}
+
+// cset rd, cond -- csinc rd, xzr, xzr, !cond
+static void a64_cset(a64_buf_t *b, int rd, int cond) {
+  a64_emit(b, 0x9A9F07E0 | ((cond ^ 1) << 12) | rd);
+}
+
+// <op> reg, [base + disp]; disp is a multiple of the size, below 4096 of them
+static void a64_mem(a64_buf_t *b, uint32_t op, int reg, int base, size_t disp) {
+  int scale = op >> 30;
+
+  a64_emit(b, op | ((uint32_t)(disp >> scale) << 10) | (base << 5) | reg);
+}
+
+static void a64_load(a64_buf_t *b, int reg, int base, size_t disp) {
+  a64_mem(b, A64_LDR, reg, base, disp);
+}
+
+static void a64_store(a64_buf_t *b, int base, size_t disp, int reg) {
+  a64_mem(b, A64_STR, reg, base, disp);
+}
+
+static void a64_call(a64_buf_t *b, const void *fn) {
+  a64_movImm(b, A64_X17, (uint64_t)(uintptr_t)fn);
+  a64_emit(b, 0xD63F0000 | (A64_X17 << 5)); // blr x17
+}
+
+// b.cond (or b if `cond` < 0), returns the site to patch
+static uint32_t a64_jump(a64_buf_t *b, int cond) {
+  a64_emit(b, cond < 0 ? 0x14000000 : 0x54000000 | cond);
+
+  return (uint32_t)(b->len - 4);
+}
+
+static void a64_patch(a64_buf_t *b, uint32_t site, size_t target) {
+  int64_t rel = ((int64_t)target - (int64_t)site) / 4;
+  uint32_t word = 0;
+
+  for (int i = 0; i < 4; i++) {
+    word |= (uint32_t)b->data[site + i] << (i * 8);
+  }
+
+  if ((word & 0xFC000000) == 0x14000000) {
+    b->overflow |= rel < -(1 << 25) || rel >= (1 << 25);
+    word |= (uint32_t)rel & 0x3FFFFFF;
+  } else {
+    // b.cond reaches 1MB either way
+    b->overflow |= rel < -(1 << 18) || rel >= (1 << 18);
+    word |= ((uint32_t)rel & 0x7FFFF) << 5;
+  }
+
+  for (int i = 0; i < 4; i++) {
+    b->data[site + i] = (uint8_t)(word >> (i * 8));
+  }
+}
+
+static void a64_jumpExit(a64_buf_t *b, int cond) {
+  b->exits = (uint32_t*)realloc(b->exits, sizeof(uint32_t) * (b->numExits + 1));
+  b->exits[b->numExits++] = a64_jump(b, cond);
+}
+
+// ===== templates =====
+
+// reg = CODE_OPERAND_VALUE(*o). clobbers x16 and x17.
+static void a64_operand(a64_buf_t *b, int reg, const operand_t *o) {
+  if ((o->at & AT_ABS) == AT_ABS) {
+    a64_movImm(b, reg, (uint64_t)(uintptr_t)o->base);
+    return;
+  }
+
+  a64_movImm(b, reg, (uint64_t)(uintptr_t)o->len);
+  a64_load(b, reg, reg, 0);
+
+  if (o->off != 0 && o->off < 4096) {
+    a64_aluImm(b, 0xD1000000, reg, reg, o->off);
+  } else if (o->off != 0) {
+    a64_movImm(b, A64_X17, o->off);
+    a64_alu(b, A64_SUB, reg, reg, A64_X17);
+  }
+
+  a64_movImm(b, A64_X16, (uint64_t)(uintptr_t)o->base);
+  a64_addShifted(b, reg, A64_X16, reg, VALUE_SIZE_LOG2);
+}
+
+// x10 = the right hand i64, from the operand or the immediate
+static void a64_right(a64_buf_t *b, const instruction_t *ins, bool imm) {
+  if (imm) {
+    a64_movImm(b, A64_X10, ins->imm.u64);
+  } else {
+    a64_operand(b, A64_X10, &ins->right);
+    a64_load(b, A64_X10, A64_X10, VALUE_DATA_OFFSET);
+  }
+}
+
+// reg = &rt->dt->storage[AT_LOCAL].data[*lenVal]. clobbers x16.
+static void a64_stackTop(a64_buf_t *b, int reg) {
+  size_t stack = AT_LOCAL * sizeof(storage_t);
+
+  a64_load(b, reg, A64_X19, stack + offsetof(storage_t, lenVal));
+  a64_load(b, reg, reg, 0);
+  a64_load(b, A64_X16, A64_X19, stack + offsetof(storage_t, data));
+  a64_addShifted(b, reg, A64_X16, reg, VALUE_SIZE_LOG2);
+}
+
+// ++*lenVal, after a push
+static void a64_pushed(a64_buf_t *b) {
+  a64_load(b, A64_X9, A64_X19, AT_LOCAL * sizeof(storage_t) + offsetof(storage_t, lenVal));
+  a64_load(b, A64_X10, A64_X9, 0);
+  a64_aluImm(b, 0x91000000, A64_X10, A64_X10, 1);
+  a64_store(b, A64_X9, 0, A64_X10);
+}
+
+// x22 = ((c > 0) - (c < 0)) + 1, from the flags of a preceding cmp
+static void a64_setCompareFlags(a64_buf_t *b) {
+  a64_cset(b, A64_X11, A64_GT);
+  a64_cset(b, A64_X12, A64_LT);
+  a64_alu(b, A64_SUB, A64_X11, A64_X11, A64_X12);
+  a64_aluImm(b, 0x91000000, A64_X22, A64_X11, 1);
+}
+
+// tst reg, #mask. clobbers x10.
+static void a64_testFlags(a64_buf_t *b, int reg, uint32_t mask) {
+  a64_movImm(b, A64_X10, mask);
+  a64_alu(b, A64_ANDS, A64_ZR, reg, A64_X10);
+}
+
+// jumps to the byte offset held in the target operand, or that of a
+// direct jump: a block entry of this region, or back to the interpreter
+static void a64_dispatch(a64_buf_t *b, const code_t *code, const instruction_t *ins) {
+  if (CODE_DIRECT_JUMP(ins)) {
+    a64_movImm(b, A64_X0, ins->target.loc);
+  } else {
+    a64_operand(b, A64_X0, &ins->target);
+    a64_load(b, A64_X0, A64_X0, VALUE_DATA_OFFSET);
+  }
+  a64_movImm(b, A64_X9, code->len);
+  a64_alu(b, A64_SUBS, A64_ZR, A64_X0, A64_X9); // cmp x0, x9
+  a64_jumpExit(b, A64_HI);
+
+  a64_emit(b, 0xF8607800 | (A64_X0 << 16) | (A64_X23 << 5) | A64_X16); // ldr x16, [x23, x0, lsl #3]
+  a64_emit(b, 0xD61F0000 | (A64_X16 << 5)); // br x16
+}
+
+// leaves for the interpreter at `ins` if the value_t at `reg` may own
+// memory -- conservatively, if it has FLAG_REFCOUNTED or FLAG_MALLOC.
+// clobbers x0, x16 and x17.
+static void a64_guardUnowned(a64_buf_t *b, int reg, const instruction_t *ins) {
+  a64_movImm(b, A64_X0, ins->offset);
+  a64_mem(b, A64_LDRW, A64_X16, reg, VALUE_META_OFFSET);
+  a64_movImm(b, A64_X17, VALUE_METADATA(TYPE_NONE, FLAG_REFCOUNTED | FLAG_MALLOC));
+  a64_alu(b, A64_ANDS, A64_ZR, A64_X16, A64_X17);
+  a64_jumpExit(b, A64_NE);
+}
+
+static bool a64_unowned(uint8_t seen) {
+  return seen != 0 && !(seen & CODE_SEEN_OWNED);
+}
+
+// value_setInt / value_setUint / value_setBoolean(rt, x1, imm). if the
+// slot has never been seen owning memory (`seen`, see code_seen), the
+// value is stored in place behind a64_guardUnowned instead.
+static bool a64_setConstant(a64_buf_t *b, const instruction_t *ins, uint8_t seen) {
+  uint64_t imm = ins->flags == CONST_FLAGS_BOOL ? (uint64_t)ins->imm.b : ins->imm.u64;
+  uint32_t type;
+  const void *fn;
+
+  switch (ins->flags) {
+    case CONST_FLAGS_I64: type = TYPE_INT; fn = (const void*)&value_setInt; break;
+    case CONST_FLAGS_U64: type = TYPE_UINT; fn = (const void*)&value_setUint; break;
+    case CONST_FLAGS_BOOL: type = TYPE_BOOLEAN; fn = (const void*)&value_setBoolean; break;
+    default: return false;
+  }
+
+  if (a64_unowned(seen)) {
+    a64_guardUnowned(b, A64_X1, ins);
+    a64_movImm(b, A64_X10, imm);
+    a64_store(b, A64_X1, VALUE_DATA_OFFSET, A64_X10);
+    a64_movImm(b, A64_X10, type);
+    a64_mem(b, A64_STRW, A64_X10, A64_X1, VALUE_META_OFFSET);
+    return true;
+  }
+
+  a64_mov(b, A64_X0, A64_X20);
+  a64_movImm(b, A64_X2, imm);
+  a64_call(b, fn);
+
+  return true;
+}
+
+// *x1 = *x2, the 16 byte value_t
+static void a64_copy(a64_buf_t *b) {
+  a64_load(b, A64_X9, A64_X2, 0);
+  a64_store(b, A64_X1, 0, A64_X9);
+  a64_load(b, A64_X9, A64_X2, 8);
+  a64_store(b, A64_X1, 8, A64_X9);
+}
+
+// value_copyValue(rt, x1, x2), or a plain copy if neither side has been
+// seen owning memory
+static void a64_copyValue(a64_buf_t *b, const instruction_t *ins) {
+  if (a64_unowned(ins->seen[0]) && a64_unowned(ins->seen[1])) {
+    a64_guardUnowned(b, A64_X1, ins);
+    a64_guardUnowned(b, A64_X2, ins);
+    a64_copy(b);
+  } else {
+    a64_mov(b, A64_X0, A64_X20);
+    a64_call(b, (const void*)&value_copyValue);
+  }
+}
+
+static bool a64_emitInstruction(a64_buf_t *b, const code_t *code, const instruction_t *ins) {
+  uint32_t skip;
+
+  switch (ins->opcode) {
+    case OP_NOOP:
+    case OP_CONST:
+      return true;
+
+    case OP_JIT:
+      // a memoized region is left to the interpreter, see jit.c
+      if ((ins->flags & JIT_FLAG_BEGIN) && (ins->flags & JIT_FLAG_MEMOIZE)) {
+        a64_movImm(b, A64_X0, ins->offset);
+        a64_jumpExit(b, -1);
+      }
+      return true;
+
+    case OP_LOAD:
+      if (ins->flags == CONST_FLAGS_NONE || ins->flags == CONST_FLAGS_NULL) {
+        a64_operand(b, A64_X9, &ins->left);
+        a64_store(b, A64_X9, VALUE_DATA_OFFSET, A64_ZR);
+        a64_movImm(b, A64_X10, ins->flags == CONST_FLAGS_NONE ? TYPE_NONE : TYPE_POINTER);
+        a64_mem(b, A64_STRW, A64_X10, A64_X9, VALUE_META_OFFSET);
+        return true;
+      }
+
+      a64_operand(b, A64_X1, &ins->left);
+
+      return a64_setConstant(b, ins, ins->seen[0]);
+
+    case OP_MOV:
+      a64_operand(b, A64_X1, &ins->left);
+      a64_operand(b, A64_X2, &ins->right);
+
+      if ((ins->left.at & 0x3) == AT_REG) {
+        a64_copy(b);
+      } else {
+        a64_copyValue(b, ins);
+      }
+      return true;
+
+    case OP_TAKE:
+      a64_operand(b, A64_X2, &ins->right);
+
+      if (ins->flags == TAKE_FLAGS_PUSH) {
+        a64_stackTop(b, A64_X1);
+      } else {
+        a64_operand(b, A64_X1, &ins->left);
+      }
+
+      a64_mov(b, A64_X0, A64_X20);
+      a64_call(b, (const void*)&value_moveValue);
+
+      if (ins->flags == TAKE_FLAGS_PUSH) {
+        a64_pushed(b);
+      }
+      return true;
+
+    case OP_PUSH:
+      if (ins->flags == CONST_FLAGS_NONE) {
+        a64_operand(b, A64_X2, &ins->left);
+        a64_stackTop(b, A64_X1);
+        a64_copyValue(b, ins);
+      } else {
+        a64_stackTop(b, A64_X1);
+
+        if (!a64_setConstant(b, ins, ins->seen[1])) {
+          return false;
+        }
+      }
+
+      a64_pushed(b);
+      return true;
+
+    case OP_POP:
+      a64_mov(b, A64_X0, A64_X20);
+      a64_movImm(b, A64_X1, (uint16_t)ins->imm.u64);
+      a64_call(b, (const void*)&jit_native_pop);
+      return true;
+
+    case OP_CALL:
+    case CODE_OP_GETFIELD:
+    case CODE_OP_SETFIELD:
+      a64_mov(b, A64_X0, A64_X20);
+      a64_movImm(b, A64_X1, (uint64_t)(uintptr_t)ins);
+      a64_call(b, (const void*)&jit_native_call);
+      return true;
+
+    case OP_CMP:
+    case CODE_OP_CMP_IMM:
+      if (ins->flags & CMP_FLAG_F64_LR) {
+        return false;
+      }
+
+      // over all 64 bits, as the interpreter
+      a64_operand(b, A64_X9, &ins->left);
+      a64_load(b, A64_X9, A64_X9, VALUE_DATA_OFFSET);
+      a64_right(b, ins, ins->opcode == CODE_OP_CMP_IMM);
+      a64_alu(b, A64_SUBS, A64_ZR, A64_X9, A64_X10); // cmp x9, x10
+      a64_setCompareFlags(b);
+      return true;
+
+    case OP_JMP:
+      switch (ins->flags) {
+        case JUMP_FLAGS_JE:
+        case JUMP_FLAGS_JNE:
+          a64_testFlags(b, A64_X22, INTERPRETER_FLAGS_EQUAL);
+          skip = a64_jump(b, ins->flags == JUMP_FLAGS_JE ? A64_EQ : A64_NE);
+          break;
+        case JUMP_FLAGS_JG:
+          a64_testFlags(b, A64_X22, INTERPRETER_FLAGS_GREATER);
+          skip = a64_jump(b, A64_EQ);
+          break;
+        case JUMP_FLAGS_JGE: // either flag set
+          a64_testFlags(b, A64_X22, INTERPRETER_FLAGS_GREATER | INTERPRETER_FLAGS_EQUAL);
+          skip = a64_jump(b, A64_EQ);
+          break;
+        default:
+          a64_dispatch(b, code, ins);
+          return true;
+      }
+
+      a64_dispatch(b, code, ins);
+      a64_patch(b, skip, b->len);
+      return true;
+
+    case OP_CMPJ:
+    case OP_CMPJ_IMM:
+      a64_operand(b, A64_X9, &ins->left);
+      a64_load(b, A64_X9, A64_X9, VALUE_DATA_OFFSET);
+      a64_right(b, ins, ins->opcode == OP_CMPJ_IMM);
+      a64_alu(b, A64_SUBS, A64_ZR, A64_X9, A64_X10); // cmp x9, x10
+      a64_setCompareFlags(b);
+
+      // x22 is 0, 1 or 2 for less, equal, greater
+      switch (ins->flags) {
+        case JUMP_FLAGS_JE:
+          a64_aluImm(b, 0xF1000000, A64_ZR, A64_X22, INTERPRETER_FLAGS_EQUAL);
+          skip = a64_jump(b, A64_NE);
+          break;
+        case JUMP_FLAGS_JNE:
+          a64_aluImm(b, 0xF1000000, A64_ZR, A64_X22, INTERPRETER_FLAGS_EQUAL);
+          skip = a64_jump(b, A64_EQ);
+          break;
+        case JUMP_FLAGS_JG:
+          a64_aluImm(b, 0xF1000000, A64_ZR, A64_X22, INTERPRETER_FLAGS_GREATER);
+          skip = a64_jump(b, A64_NE);
+          break;
+        case JUMP_FLAGS_JGE:
+          a64_aluImm(b, 0xF1000000, A64_ZR, A64_X22, INTERPRETER_FLAGS_EQUAL);
+          skip = a64_jump(b, A64_LT);
+          break;
+        default:
+          a64_dispatch(b, code, ins);
+          return true;
+      }
+
+      a64_dispatch(b, code, ins);
+      a64_patch(b, skip, b->len);
+      return true;
+
+    case CODE_OP_ADD_I64:
+    case CODE_OP_ADD_I64_IMM:
+    case CODE_OP_SUB_I64:
+    case CODE_OP_SUB_I64_IMM:
+    case CODE_OP_MUL_I64:
+    case CODE_OP_MUL_I64_IMM:
+    case OP_XOR:
+    case OP_AND:
+    case OP_OR:
+    case CODE_OP_XOR_IMM:
+    case CODE_OP_AND_IMM:
+    case CODE_OP_OR_IMM:
+    case OP_SHL:
+    case OP_SHR:
+    case CODE_OP_SHL_IMM:
+    case CODE_OP_SHR_IMM: {
+      bool imm = ins->opcode == CODE_OP_ADD_I64_IMM || ins->opcode == CODE_OP_SUB_I64_IMM
+        || ins->opcode == CODE_OP_MUL_I64_IMM || ins->opcode == CODE_OP_XOR_IMM
+        || ins->opcode == CODE_OP_AND_IMM || ins->opcode == CODE_OP_OR_IMM
+        || ins->opcode == CODE_OP_SHL_IMM || ins->opcode == CODE_OP_SHR_IMM;
+      uint32_t op;
+
+      switch (ins->opcode) {
+        case CODE_OP_ADD_I64: case CODE_OP_ADD_I64_IMM: op = A64_ADD; break;
+        case CODE_OP_SUB_I64: case CODE_OP_SUB_I64_IMM: op = A64_SUB; break;
+        case CODE_OP_MUL_I64: case CODE_OP_MUL_I64_IMM: op = A64_MUL; break;
+        case OP_XOR: case CODE_OP_XOR_IMM: op = A64_EOR; break;
+        case OP_AND: case CODE_OP_AND_IMM: op = A64_AND; break;
+        case OP_OR: case CODE_OP_OR_IMM: op = A64_ORR; break;
+        // the shift is taken modulo 64, as x86-64 does
+        case OP_SHL: case CODE_OP_SHL_IMM: op = A64_LSLV; break;
+        default: op = A64_ASRV; break;
+      }
+
+      a64_operand(b, A64_X9, &ins->left);
+      a64_right(b, ins, imm);
+      a64_load(b, A64_X11, A64_X9, VALUE_DATA_OFFSET);
+      a64_alu(b, op, A64_X11, A64_X11, A64_X10);
+      a64_store(b, A64_X9, VALUE_DATA_OFFSET, A64_X11);
+      return true;
+    }
+
+    case CODE_OP_DIV_I64:
+    case CODE_OP_DIV_I64_IMM:
+    case CODE_OP_MOD_I64:
+    case CODE_OP_MOD_I64_IMM: {
+      bool div = ins->opcode == CODE_OP_DIV_I64 || ins->opcode == CODE_OP_DIV_I64_IMM;
+
+      // sdiv does not trap: a division by zero gives 0, as the
+      // interpreter's does on AArch64
+      a64_operand(b, A64_X9, &ins->left);
+      a64_right(b, ins, ins->opcode == CODE_OP_DIV_I64_IMM || ins->opcode == CODE_OP_MOD_I64_IMM);
+      a64_load(b, A64_X11, A64_X9, VALUE_DATA_OFFSET);
+      a64_alu(b, A64_SDIV, A64_X12, A64_X11, A64_X10);
+
+      if (!div) {
+        a64_msub(b, A64_X12, A64_X12, A64_X10, A64_X11);
+      }
+
+      a64_store(b, A64_X9, VALUE_DATA_OFFSET, A64_X12);
+      return true;
+    }
+
+    case OP_NEG:
+    case OP_NOT:
+      if (ins->opcode == OP_NEG && ins->flags == CMP_FLAG_F64_L) {
+        return false;
+      }
+
+      a64_operand(b, A64_X9, &ins->left);
+      a64_load(b, A64_X11, A64_X9, VALUE_DATA_OFFSET);
+      a64_alu(b, ins->opcode == OP_NEG ? A64_SUB : A64_ORN, A64_X11, A64_ZR, A64_X11);
+      a64_store(b, A64_X9, VALUE_DATA_OFFSET, A64_X11);
+      return true;
+
+    case OP_HALT:
+      // the interpreter executes the halt itself
+      a64_movImm(b, A64_X0, ins->offset);
+      a64_jumpExit(b, -1);
+      return true;
+
+    default:
+      return false; // no template (floating point, print, ...)
+  }
+}
+
+static void a64_prologue(a64_buf_t *b, void **table) {
+  a64_emit(b, 0xA9BC7BFD); // stp x29, x30, [sp, #-64]!
+  a64_emit(b, 0x910003FD); // mov x29, sp
+  a64_emit(b, 0xA90153F3); // stp x19, x20, [sp, #16]
+  a64_emit(b, 0xA9025BF5); // stp x21, x22, [sp, #32]
+  a64_store(b, A64_ZR, 48, A64_X23);
+
+  a64_mov(b, A64_X20, A64_X0);
+  a64_load(b, A64_X21, A64_X1, offsetof(args_t, _rawData));
+  a64_mov(b, A64_X22, A64_ZR);
+  a64_emit(b, 0xB4000040 | A64_X21); // cbz x21, +8
+  a64_mem(b, A64_LDRB, A64_X22, A64_X21, offsetof(jit_frame_t, flags));
+
+  a64_load(b, A64_X19, A64_X20, offsetof(runtime_t, dt));
+  a64_movImm(b, A64_X23, (uint64_t)(uintptr_t)table);
+}
+
+// x0 holds the offset the interpreter resumes at
+static void a64_epilogue(a64_buf_t *b) {
+  a64_emit(b, 0xB4000040 | A64_X21); // cbz x21, +8
+  a64_mem(b, A64_STRB, A64_X22, A64_X21, offsetof(jit_frame_t, flags));
+  a64_movImm(b, A64_X1, TYPE_UINT); // value_fromUint(x0)
+
+  a64_emit(b, 0xA94153F3); // ldp x19, x20, [sp, #16]
+  a64_emit(b, 0xA9425BF5); // ldp x21, x22, [sp, #32]
+  a64_load(b, A64_X23, A64_ZR, 48);
+  a64_emit(b, 0xA8C47BFD); // ldp x29, x30, [sp], #64
+  a64_emit(b, 0xD65F03C0); // ret
+}
+
+native_function_t jit_a64_compile(const code_t *code, uint32_t first, uint32_t end,
+                                  uint32_t exitOffset, jit_native_region_t *out) {
+  a64_buf_t b = { NULL, 0, 0, NULL, 0, false };
+  void **table = (void**)malloc(sizeof(void*) * (code->len + 1));
+  uint32_t *native = (uint32_t*)malloc(sizeof(uint32_t) * (end - first));
+  bool *blocks = jit_native_findBlocks(code, first, end);
+  native_function_t fn = NULL;
+  size_t exitAt;
+  bool ok = true;
+
+  a64_prologue(&b, table);
+
+  for (uint32_t i = first; i < end && ok; i++) {
+    native[i - first] = (uint32_t)b.len;
+    ok = a64_emitInstruction(&b, code, &code->instructions[i]);
+  }
+
+  if (ok) {
+    a64_movImm(&b, A64_X0, exitOffset);
+    a64_jumpExit(&b, -1);
+
+    exitAt = b.len;
+    a64_epilogue(&b);
+
+    for (size_t i = 0; i < b.numExits; i++) {
+      a64_patch(&b, b.exits[i], exitAt);
+    }
+
+    if (!b.overflow && jit_native_install(code, first, end, b.data, b.len, native, blocks, exitAt, table, out)) {
+      *(void**)(&fn) = out->mem;
+    }
+  }
+
+  if (fn == NULL) {
+    free(table);
+  }
+
+  free(blocks);
+  free(native);
+  free(b.exits);
+  free(b.data);
+
+  return fn;
+}
+
+#else
+
+native_function_t jit_a64_compile(const code_t *code, uint32_t first, uint32_t end,
+                                  uint32_t exitOffset, jit_native_region_t *out) {
+  return NULL;
+}
+
+#endif
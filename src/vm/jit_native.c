@@ -0,0 +1,156 @@
+#include <vm/jit_native.h>
+#include <vm/jit_x64.h>
+#include <vm/jit_a64.h>
+#include <vm/runtime.h>
+#include <vm/interpreter.h>
+#include <vm/builtins.h>
+#include <vm/value.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#if JIT_X64 || JIT_A64
+#include <sys/mman.h>
+#endif
+
+static const jit_native_backend_t backends[] = {
+#if JIT_X64
+  { "x64", jit_x64_compile },
+#endif
+#if JIT_A64
+  { "a64", jit_a64_compile },
+#endif
+  { NULL, NULL }
+};
+
+const jit_native_backend_t *jit_native_backend(void) {
+  return backends[0].name != NULL ? &backends[0] : NULL;
+}
+
+bool *jit_native_findBlocks(const code_t *code, uint32_t first, uint32_t end) {
+  bool *blocks = (bool*)calloc(end - first, sizeof(bool));
+
+  blocks[0] = true;
+
+  // labels that verified code may jump through are all decoded by now
+  for (size_t i = 0; i < code->numLabels; i++) {
+    if (code->labels[i].offset <= code->len) {
+      uint32_t index = code_decodedIndexAt(code, code->labels[i].offset);
+
+      if (index != CODE_INVALID_INDEX && index >= first && index < end) {
+        blocks[index - first] = true;
+      }
+    }
+  }
+
+  for (size_t i = 0; i < code->count; i++) {
+    const instruction_t *ins = &code->instructions[i];
+    uint64_t offset;
+
+    if (ins->opcode == OP_LOAD && ins->flags == CONST_FLAGS_U64) {
+      offset = ins->imm.u64;
+    } else if (CODE_DIRECT_JUMP(ins)) {
+      offset = ins->target.loc;
+    } else {
+      continue;
+    }
+
+    if (offset <= code->len) {
+      uint32_t index = code_decodedIndexAt(code, offset);
+
+      if (index != CODE_INVALID_INDEX && index >= first && index < end) {
+        blocks[index - first] = true;
+      }
+    }
+  }
+
+  return blocks;
+}
+
+#if JIT_X64 || JIT_A64
+
+bool jit_native_install(const code_t *code, uint32_t first, uint32_t end,
+                        const uint8_t *data, size_t len, const uint32_t *native,
+                        const bool *blocks, size_t exitAt, void **table, jit_native_region_t *out) {
+  void *mem = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+  if (mem == MAP_FAILED) {
+    return false;
+  }
+
+  memcpy(mem, data, len);
+  // a no-op on x86-64; elsewhere the instruction cache does not see the
+  // stores on its own
+  __builtin___clear_cache((char*)mem, (char*)mem + len);
+
+  if (mprotect(mem, len, PROT_READ | PROT_EXEC) != 0) {
+    munmap(mem, len);
+    return false;
+  }
+
+  for (size_t i = 0; i <= code->len; i++) {
+    table[i] = (uint8_t*)mem + exitAt;
+  }
+
+  for (uint32_t i = first; i < end; i++) {
+    if (blocks[i - first]) {
+      table[code->instructions[i].offset] = (uint8_t*)mem + native[i - first];
+    }
+  }
+
+  out->mem = mem;
+  out->size = len;
+  out->table = table;
+
+  return true;
+}
+
+void jit_native_free(jit_native_region_t *region) {
+  munmap(region->mem, region->size);
+  free(region->table);
+}
+
+#else
+
+bool jit_native_install(const code_t *code, uint32_t first, uint32_t end,
+                        const uint8_t *data, size_t len, const uint32_t *native,
+                        const bool *blocks, size_t exitAt, void **table, jit_native_region_t *out) {
+  return false;
+}
+
+void jit_native_free(jit_native_region_t *region) {
+}
+
+#endif
+
+void jit_native_pop(runtime_t *rt, uint64_t sz) {
+  storage_t *s = &rt->dt->storage[AT_LOCAL];
+
+  while (sz--) {
+    value_t *ptr = &s->data[--*s->lenVal];
+
+    // as in the interpreter's OP_POP
+    if (VALUE_OWNS(ptr)) {
+      value_destroy(rt, ptr);
+
+      VALUE_SET_META(ptr, TYPE_NONE, FLAG_NONE);
+    }
+  }
+}
+
+void jit_native_call(runtime_t *rt, const instruction_t *ins) {
+  // the offset after the call, as INTERPRETER_SYNC_PC stores
+  VM_PROGRAM_COUNTER(rt->dt) = ins[1].offset;
+  runtime_safepoint(rt);
+
+  value_t *callee = CODE_OPERAND_VALUE(ins->left);
+  bool registers = (ins->flags & CALL_FLAGS_REGISTER_ARGS) != 0;
+
+  if (ins->flags & (CALL_FLAGS_OPERANDS | CALL_FLAGS_RESULT)) {
+    builtins_callResolved(rt, (instruction_t*)ins);
+  } else if (!builtins_callDirect(rt, (instruction_t*)ins, callee, registers, NULL, &rt->dt->storage[AT_REG].data[0])) {
+    rt->dt->storage[AT_REG].data[0] = registers
+      ? value_invokeWithRegisters(rt, callee)
+      : value_invoke(rt, callee);
+  }
+}
@@ -0,0 +1,693 @@
+#include <vm/jit_x64.h>
+#include <vm/jit.h>
+#include <vm/runtime.h>
+#include <vm/interpreter.h>
+#include <vm/builtins.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+
+#if JIT_X64
+
+// ===== instruction encoding =====
+
+enum X64_REG {
+  X64_RAX = 0,
+  X64_RCX = 1,
+  X64_RDX = 2,
+  X64_RBX = 3, // datatable
+  X64_RSI = 6,
+  X64_RDI = 7,
+  X64_R8 = 8,
+  X64_R11 = 11, // scratch for operand addresses
+  X64_R12 = 12, // runtime_t *rt
+  X64_R13 = 13, // jit_frame_t *frame, may be NULL
+  X64_R14 = 14, // compare flags
+  X64_R15 = 15 // block entry table
+};
+
+// condition codes, for jcc (0x0F 0x80 + cc) and setcc (0x0F 0x90 + cc)
+enum X64_CC {
+  X64_CC_A = 0x7,
+  X64_CC_E = 0x4,
+  X64_CC_NE = 0x5,
+  X64_CC_L = 0xC
+};
+
+typedef struct x64_buf {
+  uint8_t *data;
+  size_t len;
+  size_t cap;
+
+  uint32_t *exits; // rel32 sites that jump to the exit stub
+  size_t numExits;
+} x64_buf_t;
+
+static void x64_byte(x64_buf_t *b, uint8_t byte) {
+  if (b->len == b->cap) {
+    b->cap = b->cap ? b->cap * 2 : 4096;
+    b->data = (uint8_t*)realloc(b->data, b->cap);
+  }
+
+  b->data[b->len++] = byte;
+}
+
+static void x64_u32(x64_buf_t *b, uint32_t v) {
+  for (int i = 0; i < 4; i++) {
+    x64_byte(b, (uint8_t)(v >> (i * 8)));
+  }
+}
+
+static void x64_u64(x64_buf_t *b, uint64_t v) {
+  for (int i = 0; i < 8; i++) {
+    x64_byte(b, (uint8_t)(v >> (i * 8)));
+  }
+}
+
+static void x64_rex(x64_buf_t *b, bool w, int reg, int rm) {
+  uint8_t rex = 0x40 | (w << 3) | ((reg >> 3) << 2) | (rm >> 3);
+
+  if (rex != 0x40) {
+    x64_byte(b, rex);
+  }
+}
+
+static void x64_modrmReg(x64_buf_t *b, int reg, int rm) {
+  x64_byte(b, 0xC0 | ((reg & 7) << 3) | (rm & 7));
+}
+
+// [base + disp]; base must not be rsp / r12, which need a SIB byte
+static void x64_modrmMem(x64_buf_t *b, int reg, int base, int32_t disp) {
+  if (disp >= -128 && disp <= 127) {
+    x64_byte(b, 0x40 | ((reg & 7) << 3) | (base & 7));
+    x64_byte(b, (uint8_t)disp);
+  } else {
+    x64_byte(b, 0x80 | ((reg & 7) << 3) | (base & 7));
+    x64_u32(b, (uint32_t)disp);
+  }
+}
+
+// mov reg, imm64
+static void x64_movImm(x64_buf_t *b, int reg, uint64_t imm) {
+  x64_rex(b, true, 0, reg);
+  x64_byte(b, 0xB8 + (reg & 7));
+  x64_u64(b, imm);
+}
+
+// <op> rm, reg -- add 0x01, or 0x09, and 0x21, sub 0x29, xor 0x31, cmp 0x39, mov 0x89
+static void x64_alu(x64_buf_t *b, uint8_t op, int rm, int reg) {
+  x64_rex(b, true, reg, rm);
+  x64_byte(b, op);
+  x64_modrmReg(b, reg, rm);
+}
+
+// <op> rm, imm8 -- 0x83 /ext
+static void x64_aluImm8(x64_buf_t *b, int ext, int rm, int8_t imm) {
+  x64_rex(b, true, 0, rm);
+  x64_byte(b, 0x83);
+  x64_modrmReg(b, ext, rm);
+  x64_byte(b, (uint8_t)imm);
+}
+
+// <op> rm, imm32 -- 0x81 /ext, or test (0xF7 /0)
+static void x64_aluImm32(x64_buf_t *b, uint8_t op, int ext, int rm, uint32_t imm) {
+  x64_rex(b, true, 0, rm);
+  x64_byte(b, op);
+  x64_modrmReg(b, ext, rm);
+  x64_u32(b, imm);
+}
+
+// 0xF7 /ext: not 2, neg 3, idiv 7. 0xD3 /ext (shift by cl): shl 4, sar 7
+static void x64_unary(x64_buf_t *b, uint8_t op, int ext, int rm) {
+  x64_rex(b, true, 0, rm);
+  x64_byte(b, op);
+  x64_modrmReg(b, ext, rm);
+}
+
+static void x64_imul(x64_buf_t *b, int reg, int rm) {
+  x64_rex(b, true, reg, rm);
+  x64_byte(b, 0x0F);
+  x64_byte(b, 0xAF);
+  x64_modrmReg(b, reg, rm);
+}
+
+// mov reg, [base + disp]
+static void x64_load(x64_buf_t *b, int reg, int base, int32_t disp) {
+  x64_rex(b, true, reg, base);
+  x64_byte(b, 0x8B);
+  x64_modrmMem(b, reg, base, disp);
+}
+
+// mov [base + disp], reg
+static void x64_store(x64_buf_t *b, int base, int32_t disp, int reg) {
+  x64_rex(b, true, reg, base);
+  x64_byte(b, 0x89);
+  x64_modrmMem(b, reg, base, disp);
+}
+
+// mov dword [base + disp], imm32
+static void x64_storeImm32(x64_buf_t *b, int base, int32_t disp, uint32_t imm) {
+  x64_rex(b, false, 0, base);
+  x64_byte(b, 0xC7);
+  x64_modrmMem(b, 0, base, disp);
+  x64_u32(b, imm);
+}
+
+static void x64_call(x64_buf_t *b, const void *fn) {
+  x64_movImm(b, X64_RAX, (uint64_t)(uintptr_t)fn);
+  x64_byte(b, 0xFF); // call rax
+  x64_byte(b, 0xD0);
+}
+
+// jcc rel32 (or jmp rel32 if `cc` < 0), returns the rel32 site to patch
+static uint32_t x64_jump(x64_buf_t *b, int cc) {
+  if (cc < 0) {
+    x64_byte(b, 0xE9);
+  } else {
+    x64_byte(b, 0x0F);
+    x64_byte(b, 0x80 + cc);
+  }
+
+  x64_u32(b, 0);
+
+  return (uint32_t)(b->len - 4);
+}
+
+static void x64_patch(x64_buf_t *b, uint32_t site, size_t target) {
+  uint32_t rel = (uint32_t)(target - (site + 4));
+
+  memcpy(&b->data[site], &rel, sizeof(rel));
+}
+
+static void x64_jumpExit(x64_buf_t *b, int cc) {
+  b->exits = (uint32_t*)realloc(b->exits, sizeof(uint32_t) * (b->numExits + 1));
+  b->exits[b->numExits++] = x64_jump(b, cc);
+}
+
+// ===== templates =====
+
+// reg = CODE_OPERAND_VALUE(*o). clobbers r11.
+static void x64_operand(x64_buf_t *b, int reg, const operand_t *o) {
+  if ((o->at & AT_ABS) == AT_ABS) {
+    x64_movImm(b, reg, (uint64_t)(uintptr_t)o->base);
+    return;
+  }
+
+  x64_movImm(b, reg, (uint64_t)(uintptr_t)o->len);
+  x64_load(b, reg, reg, 0);
+
+  if (o->off != 0) {
+    x64_aluImm32(b, 0x81, 5, reg, o->off); // sub
+  }
+
+  x64_rex(b, true, 0, reg);
+  x64_byte(b, 0xC1); // shl reg, VALUE_SIZE_LOG2
+  x64_modrmReg(b, 4, reg);
+  x64_byte(b, VALUE_SIZE_LOG2);
+
+  x64_movImm(b, X64_R11, (uint64_t)(uintptr_t)o->base);
+  x64_alu(b, 0x01, reg, X64_R11);
+}
+
+// rcx = the right hand i64, from the operand or the immediate
+static void x64_right(x64_buf_t *b, const instruction_t *ins, bool imm) {
+  if (imm) {
+    x64_movImm(b, X64_RCX, ins->imm.u64);
+  } else {
+    x64_operand(b, X64_RCX, &ins->right);
+    x64_load(b, X64_RCX, X64_RCX, VALUE_DATA_OFFSET);
+  }
+}
+
+// reg = &rt->dt->storage[AT_LOCAL].data[*lenVal]
+static void x64_stackTop(x64_buf_t *b, int reg) {
+  int32_t stack = AT_LOCAL * sizeof(storage_t);
+
+  x64_load(b, reg, X64_RBX, stack + offsetof(storage_t, lenVal));
+  x64_load(b, reg, reg, 0);
+  x64_rex(b, true, 0, reg);
+  x64_byte(b, 0xC1); // shl reg, VALUE_SIZE_LOG2
+  x64_modrmReg(b, 4, reg);
+  x64_byte(b, VALUE_SIZE_LOG2);
+  x64_load(b, X64_R11, X64_RBX, stack + offsetof(storage_t, data));
+  x64_alu(b, 0x01, reg, X64_R11);
+}
+
+// r14 = ((c > 0) - (c < 0)) + 1, from the flags of a preceding cmp / test.
+// rdx must have been zeroed before that instruction.
+static void x64_setCompareFlags(x64_buf_t *b) {
+  static const uint8_t seq[] = {
+    0x0F, 0x9F, 0xC2, // setg dl
+    0x0F, 0x9C, 0xC1, // setl cl
+    0x0F, 0xB6, 0xC9, // movzx ecx, cl
+    0x29, 0xCA, // sub edx, ecx
+    0x44, 0x8D, 0x72, 0x01 // lea r14d, [rdx + 1] -- edx is -1 for less, so not rdx
+  };
+
+  for (size_t i = 0; i < sizeof(seq); i++) {
+    x64_byte(b, seq[i]);
+  }
+}
+
+// jumps to the byte offset held in the target operand, or that of a
+// direct jump: a block entry of this region, or back to the interpreter
+static void x64_dispatch(x64_buf_t *b, const code_t *code, const instruction_t *ins) {
+  if (CODE_DIRECT_JUMP(ins)) {
+    x64_movImm(b, X64_RAX, ins->target.loc);
+  } else {
+    x64_operand(b, X64_RAX, &ins->target);
+    x64_load(b, X64_RAX, X64_RAX, VALUE_DATA_OFFSET);
+  }
+  x64_aluImm32(b, 0x81, 7, X64_RAX, (uint32_t)code->len); // cmp rax, len
+  x64_jumpExit(b, X64_CC_A);
+
+  x64_byte(b, 0x41); // jmp [r15 + rax * 8]
+  x64_byte(b, 0xFF);
+  x64_byte(b, 0x24);
+  x64_byte(b, 0xC7);
+}
+
+// leaves for the interpreter at `ins` if the value_t at `reg` may own
+// memory -- conservatively, if it has FLAG_REFCOUNTED or FLAG_MALLOC.
+// clobbers rax.
+static void x64_guardUnowned(x64_buf_t *b, int reg, const instruction_t *ins) {
+  x64_movImm(b, X64_RAX, ins->offset);
+  x64_rex(b, false, 0, reg);
+  x64_byte(b, 0xF7); // test dword [reg + metadata], imm32
+  x64_modrmMem(b, 0, reg, VALUE_META_OFFSET);
+  x64_u32(b, VALUE_METADATA(TYPE_NONE, FLAG_REFCOUNTED | FLAG_MALLOC));
+  x64_jumpExit(b, X64_CC_NE);
+}
+
+static bool x64_unowned(uint8_t seen) {
+  return seen != 0 && !(seen & CODE_SEEN_OWNED);
+}
+
+// value_setInt / value_setUint / value_setBoolean(rt, rsi, imm). if the
+// slot has never been seen owning memory (`seen`, see code_seen), the
+// value is stored in place behind x64_guardUnowned instead.
+static bool x64_setConstant(x64_buf_t *b, const instruction_t *ins, uint8_t seen) {
+  uint64_t imm = ins->flags == CONST_FLAGS_BOOL ? (uint64_t)ins->imm.b : ins->imm.u64;
+  uint32_t type;
+  const void *fn;
+
+  switch (ins->flags) {
+    case CONST_FLAGS_I64: type = TYPE_INT; fn = (const void*)&value_setInt; break;
+    case CONST_FLAGS_U64: type = TYPE_UINT; fn = (const void*)&value_setUint; break;
+    case CONST_FLAGS_BOOL: type = TYPE_BOOLEAN; fn = (const void*)&value_setBoolean; break;
+    default: return false;
+  }
+
+  if (x64_unowned(seen)) {
+    x64_guardUnowned(b, X64_RSI, ins);
+    x64_movImm(b, X64_RCX, imm);
+    x64_store(b, X64_RSI, VALUE_DATA_OFFSET, X64_RCX);
+    x64_storeImm32(b, X64_RSI, VALUE_META_OFFSET, type);
+    return true;
+  }
+
+  x64_alu(b, 0x89, X64_RDI, X64_R12);
+  x64_movImm(b, X64_RDX, imm);
+  x64_call(b, fn);
+
+  return true;
+}
+
+// *rsi = *rdx, the 16 byte value_t
+static void x64_copy(x64_buf_t *b) {
+  x64_load(b, X64_RAX, X64_RDX, 0);
+  x64_store(b, X64_RSI, 0, X64_RAX);
+  x64_load(b, X64_RAX, X64_RDX, 8);
+  x64_store(b, X64_RSI, 8, X64_RAX);
+}
+
+// value_copyValue(rt, rsi, rdx), or a plain copy if neither side has been
+// seen owning memory
+static void x64_copyValue(x64_buf_t *b, const instruction_t *ins) {
+  if (x64_unowned(ins->seen[0]) && x64_unowned(ins->seen[1])) {
+    x64_guardUnowned(b, X64_RSI, ins);
+    x64_guardUnowned(b, X64_RDX, ins);
+    x64_copy(b);
+  } else {
+    x64_alu(b, 0x89, X64_RDI, X64_R12);
+    x64_call(b, (const void*)&value_copyValue);
+  }
+}
+
+static bool x64_emitInstruction(x64_buf_t *b, const code_t *code, const instruction_t *ins) {
+  uint32_t skip;
+
+  switch (ins->opcode) {
+    case OP_NOOP:
+    case OP_CONST:
+      return true;
+
+    case OP_JIT:
+      // a memoized region is left to the interpreter, see jit.c
+      if ((ins->flags & JIT_FLAG_BEGIN) && (ins->flags & JIT_FLAG_MEMOIZE)) {
+        x64_movImm(b, X64_RAX, ins->offset);
+        x64_jumpExit(b, -1);
+      }
+      return true;
+
+    case OP_LOAD:
+      if (ins->flags == CONST_FLAGS_NONE || ins->flags == CONST_FLAGS_NULL) {
+        x64_operand(b, X64_RAX, &ins->left);
+        x64_alu(b, 0x31, X64_RCX, X64_RCX); // xor rcx, rcx
+        x64_store(b, X64_RAX, VALUE_DATA_OFFSET, X64_RCX);
+        x64_storeImm32(b, X64_RAX, VALUE_META_OFFSET,
+          ins->flags == CONST_FLAGS_NONE ? TYPE_NONE : TYPE_POINTER);
+        return true;
+      }
+
+      x64_operand(b, X64_RSI, &ins->left);
+
+      return x64_setConstant(b, ins, ins->seen[0]);
+
+    case OP_MOV:
+      x64_operand(b, X64_RSI, &ins->left);
+      x64_operand(b, X64_RDX, &ins->right);
+
+      if ((ins->left.at & 0x3) == AT_REG) {
+        x64_copy(b);
+      } else {
+        x64_copyValue(b, ins);
+      }
+      return true;
+
+    case OP_TAKE:
+      x64_operand(b, X64_RDX, &ins->right);
+
+      if (ins->flags == TAKE_FLAGS_PUSH) {
+        x64_stackTop(b, X64_RSI);
+      } else {
+        x64_operand(b, X64_RSI, &ins->left);
+      }
+
+      x64_alu(b, 0x89, X64_RDI, X64_R12);
+      x64_call(b, (const void*)&value_moveValue);
+
+      if (ins->flags == TAKE_FLAGS_PUSH) {
+        // ++*lenVal
+        x64_load(b, X64_RAX, X64_RBX, AT_LOCAL * sizeof(storage_t) + offsetof(storage_t, lenVal));
+        x64_rex(b, true, 0, X64_RAX);
+        x64_byte(b, 0xFF); // inc qword [rax]
+        x64_modrmMem(b, 0, X64_RAX, 0);
+      }
+      return true;
+
+    case OP_PUSH:
+      if (ins->flags == CONST_FLAGS_NONE) {
+        x64_operand(b, X64_RDX, &ins->left);
+        x64_stackTop(b, X64_RSI);
+        x64_copyValue(b, ins);
+      } else {
+        x64_stackTop(b, X64_RSI);
+
+        if (!x64_setConstant(b, ins, ins->seen[1])) {
+          return false;
+        }
+      }
+
+      // ++*lenVal
+      x64_load(b, X64_RAX, X64_RBX, AT_LOCAL * sizeof(storage_t) + offsetof(storage_t, lenVal));
+      x64_rex(b, true, 0, X64_RAX);
+      x64_byte(b, 0xFF); // inc qword [rax]
+      x64_modrmMem(b, 0, X64_RAX, 0);
+      return true;
+
+    case OP_POP:
+      x64_alu(b, 0x89, X64_RDI, X64_R12);
+      x64_movImm(b, X64_RSI, (uint16_t)ins->imm.u64);
+      x64_call(b, (const void*)&jit_native_pop);
+      return true;
+
+    case OP_CALL:
+    case CODE_OP_GETFIELD:
+    case CODE_OP_SETFIELD:
+      x64_alu(b, 0x89, X64_RDI, X64_R12);
+      x64_movImm(b, X64_RSI, (uint64_t)(uintptr_t)ins);
+      x64_call(b, (const void*)&jit_native_call);
+      return true;
+
+    case OP_CMP:
+    case CODE_OP_CMP_IMM:
+      if (ins->flags & CMP_FLAG_F64_LR) {
+        return false;
+      }
+
+      // over all 64 bits, as the interpreter
+      x64_operand(b, X64_RAX, &ins->left);
+      x64_load(b, X64_RAX, X64_RAX, VALUE_DATA_OFFSET);
+      x64_right(b, ins, ins->opcode == CODE_OP_CMP_IMM);
+      x64_alu(b, 0x31, X64_RDX, X64_RDX); // xor rdx, rdx
+      x64_alu(b, 0x39, X64_RAX, X64_RCX); // cmp rax, rcx
+      x64_setCompareFlags(b);
+      return true;
+
+    case OP_JMP:
+      switch (ins->flags) {
+        case JUMP_FLAGS_JE:
+        case JUMP_FLAGS_JNE:
+          x64_aluImm32(b, 0xF7, 0, X64_R14, INTERPRETER_FLAGS_EQUAL); // test
+          skip = x64_jump(b, ins->flags == JUMP_FLAGS_JE ? X64_CC_E : X64_CC_NE);
+          break;
+        case JUMP_FLAGS_JG:
+          x64_aluImm32(b, 0xF7, 0, X64_R14, INTERPRETER_FLAGS_GREATER);
+          skip = x64_jump(b, X64_CC_E);
+          break;
+        case JUMP_FLAGS_JGE: // either flag set
+          x64_aluImm32(b, 0xF7, 0, X64_R14, INTERPRETER_FLAGS_GREATER | INTERPRETER_FLAGS_EQUAL);
+          skip = x64_jump(b, X64_CC_E);
+          break;
+        default:
+          x64_dispatch(b, code, ins);
+          return true;
+      }
+
+      x64_dispatch(b, code, ins);
+      x64_patch(b, skip, b->len);
+      return true;
+
+    case OP_CMPJ:
+    case OP_CMPJ_IMM:
+      x64_operand(b, X64_RAX, &ins->left);
+      x64_load(b, X64_RAX, X64_RAX, VALUE_DATA_OFFSET);
+      x64_right(b, ins, ins->opcode == OP_CMPJ_IMM);
+      x64_alu(b, 0x31, X64_RDX, X64_RDX);
+      x64_alu(b, 0x39, X64_RAX, X64_RCX); // cmp rax, rcx
+      x64_setCompareFlags(b);
+
+      // r14 is 0, 1 or 2 for less, equal, greater
+      switch (ins->flags) {
+        case JUMP_FLAGS_JE:
+          x64_aluImm8(b, 7, X64_R14, INTERPRETER_FLAGS_EQUAL);
+          skip = x64_jump(b, X64_CC_NE);
+          break;
+        case JUMP_FLAGS_JNE:
+          x64_aluImm8(b, 7, X64_R14, INTERPRETER_FLAGS_EQUAL);
+          skip = x64_jump(b, X64_CC_E);
+          break;
+        case JUMP_FLAGS_JG:
+          x64_aluImm8(b, 7, X64_R14, INTERPRETER_FLAGS_GREATER);
+          skip = x64_jump(b, X64_CC_NE);
+          break;
+        case JUMP_FLAGS_JGE:
+          x64_aluImm8(b, 7, X64_R14, INTERPRETER_FLAGS_EQUAL);
+          skip = x64_jump(b, X64_CC_L);
+          break;
+        default:
+          x64_dispatch(b, code, ins);
+          return true;
+      }
+
+      x64_dispatch(b, code, ins);
+      x64_patch(b, skip, b->len);
+      return true;
+
+    case CODE_OP_ADD_I64:
+    case CODE_OP_ADD_I64_IMM:
+    case CODE_OP_SUB_I64:
+    case CODE_OP_SUB_I64_IMM:
+    case CODE_OP_MUL_I64:
+    case CODE_OP_MUL_I64_IMM:
+    case OP_XOR:
+    case OP_AND:
+    case OP_OR:
+    case CODE_OP_XOR_IMM:
+    case CODE_OP_AND_IMM:
+    case CODE_OP_OR_IMM: {
+      bool imm = ins->opcode == CODE_OP_ADD_I64_IMM || ins->opcode == CODE_OP_SUB_I64_IMM
+        || ins->opcode == CODE_OP_MUL_I64_IMM || ins->opcode == CODE_OP_XOR_IMM
+        || ins->opcode == CODE_OP_AND_IMM || ins->opcode == CODE_OP_OR_IMM;
+
+      x64_operand(b, X64_RAX, &ins->left);
+      x64_right(b, ins, imm);
+      x64_load(b, X64_RDX, X64_RAX, VALUE_DATA_OFFSET);
+
+      switch (ins->opcode) {
+        case CODE_OP_ADD_I64: case CODE_OP_ADD_I64_IMM: x64_alu(b, 0x01, X64_RDX, X64_RCX); break;
+        case CODE_OP_SUB_I64: case CODE_OP_SUB_I64_IMM: x64_alu(b, 0x29, X64_RDX, X64_RCX); break;
+        case CODE_OP_MUL_I64: case CODE_OP_MUL_I64_IMM: x64_imul(b, X64_RDX, X64_RCX); break;
+        case OP_XOR: case CODE_OP_XOR_IMM: x64_alu(b, 0x31, X64_RDX, X64_RCX); break;
+        case OP_AND: case CODE_OP_AND_IMM: x64_alu(b, 0x21, X64_RDX, X64_RCX); break;
+        default: x64_alu(b, 0x09, X64_RDX, X64_RCX); break;
+      }
+
+      x64_store(b, X64_RAX, VALUE_DATA_OFFSET, X64_RDX);
+      return true;
+    }
+
+    case CODE_OP_DIV_I64:
+    case CODE_OP_DIV_I64_IMM:
+    case CODE_OP_MOD_I64:
+    case CODE_OP_MOD_I64_IMM: {
+      bool div = ins->opcode == CODE_OP_DIV_I64 || ins->opcode == CODE_OP_DIV_I64_IMM;
+
+      x64_operand(b, X64_R8, &ins->left);
+      x64_right(b, ins, ins->opcode == CODE_OP_DIV_I64_IMM || ins->opcode == CODE_OP_MOD_I64_IMM);
+      x64_load(b, X64_RAX, X64_R8, VALUE_DATA_OFFSET);
+      x64_byte(b, 0x48); // cqo
+      x64_byte(b, 0x99);
+      x64_unary(b, 0xF7, 7, X64_RCX); // idiv rcx
+      x64_store(b, X64_R8, VALUE_DATA_OFFSET, div ? X64_RAX : X64_RDX);
+      return true;
+    }
+
+    case OP_SHL:
+    case OP_SHR:
+    case CODE_OP_SHL_IMM:
+    case CODE_OP_SHR_IMM:
+      x64_operand(b, X64_RAX, &ins->left);
+      x64_right(b, ins, ins->opcode == CODE_OP_SHL_IMM || ins->opcode == CODE_OP_SHR_IMM);
+      x64_load(b, X64_RDX, X64_RAX, VALUE_DATA_OFFSET);
+      x64_unary(b, 0xD3, (ins->opcode == OP_SHL || ins->opcode == CODE_OP_SHL_IMM) ? 4 : 7, X64_RDX);
+      x64_store(b, X64_RAX, VALUE_DATA_OFFSET, X64_RDX);
+      return true;
+
+    case OP_NEG:
+    case OP_NOT:
+      if (ins->opcode == OP_NEG && ins->flags == CMP_FLAG_F64_L) {
+        return false;
+      }
+
+      x64_operand(b, X64_RAX, &ins->left);
+      x64_load(b, X64_RDX, X64_RAX, VALUE_DATA_OFFSET);
+      x64_unary(b, 0xF7, ins->opcode == OP_NEG ? 3 : 2, X64_RDX);
+      x64_store(b, X64_RAX, VALUE_DATA_OFFSET, X64_RDX);
+      return true;
+
+    case OP_HALT:
+      // the interpreter executes the halt itself
+      x64_movImm(b, X64_RAX, ins->offset);
+      x64_jumpExit(b, -1);
+      return true;
+
+    default:
+      return false; // no template (floating point, print, ...)
+  }
+}
+
+static void x64_prologue(x64_buf_t *b, void **table) {
+  static const uint8_t seq[] = {
+    0x53, // push rbx
+    0x41, 0x54, // push r12
+    0x41, 0x55, // push r13
+    0x41, 0x56, // push r14
+    0x41, 0x57, // push r15 -- rsp is 16 byte aligned again
+    0x49, 0x89, 0xFC, // mov r12, rdi
+    0x4C, 0x8B, 0x6E, offsetof(args_t, _rawData), // mov r13, [rsi + _rawData]
+    0x45, 0x31, 0xF6, // xor r14d, r14d
+    0x4D, 0x85, 0xED, // test r13, r13
+    0x74, 0x05, // jz +5
+    0x45, 0x0F, 0xB6, 0x75, offsetof(jit_frame_t, flags) // movzx r14d, byte [r13 + flags]
+  };
+
+  for (size_t i = 0; i < sizeof(seq); i++) {
+    x64_byte(b, seq[i]);
+  }
+
+  // mov rbx, [r12 + dt] -- r12 as a base needs a SIB byte
+  x64_byte(b, 0x49);
+  x64_byte(b, 0x8B);
+  x64_byte(b, 0x5C);
+  x64_byte(b, 0x24);
+  x64_byte(b, offsetof(runtime_t, dt));
+
+  x64_movImm(b, X64_R15, (uint64_t)(uintptr_t)table);
+}
+
+// rax holds the offset the interpreter resumes at
+static void x64_epilogue(x64_buf_t *b) {
+  static const uint8_t seq[] = {
+    0x4D, 0x85, 0xED, // test r13, r13
+    0x74, 0x04, // jz +4
+    0x45, 0x88, 0x75, offsetof(jit_frame_t, flags), // mov [r13 + flags], r14b
+    0xBA, TYPE_UINT, 0x00, 0x00, 0x00, // mov edx, TYPE_UINT -- value_fromUint(rax)
+    0x41, 0x5F, // pop r15
+    0x41, 0x5E, // pop r14
+    0x41, 0x5D, // pop r13
+    0x41, 0x5C, // pop r12
+    0x5B, // pop rbx
+    0xC3 // ret
+  };
+
+  for (size_t i = 0; i < sizeof(seq); i++) {
+    x64_byte(b, seq[i]);
+  }
+}
+
+native_function_t jit_x64_compile(const code_t *code, uint32_t first, uint32_t end,
+                                  uint32_t exitOffset, jit_native_region_t *out) {
+  x64_buf_t b = { NULL, 0, 0, NULL, 0 };
+  void **table = (void**)malloc(sizeof(void*) * (code->len + 1));
+  uint32_t *native = (uint32_t*)malloc(sizeof(uint32_t) * (end - first));
+  bool *blocks = jit_native_findBlocks(code, first, end);
+  native_function_t fn = NULL;
+  size_t exitAt;
+  bool ok = true;
+
+  x64_prologue(&b, table);
+
+  for (uint32_t i = first; i < end && ok; i++) {
+    native[i - first] = (uint32_t)b.len;
+    ok = x64_emitInstruction(&b, code, &code->instructions[i]);
+  }
+
+  if (ok) {
+    x64_movImm(&b, X64_RAX, exitOffset);
+    x64_jumpExit(&b, -1);
+
+    exitAt = b.len;
+    x64_epilogue(&b);
+
+    for (size_t i = 0; i < b.numExits; i++) {
+      x64_patch(&b, b.exits[i], exitAt);
+    }
+
+    if (jit_native_install(code, first, end, b.data, b.len, native, blocks, exitAt, table, out)) {
+      *(void**)(&fn) = out->mem;
+    }
+  }
+
+  if (fn == NULL) {
+    free(table);
+  }
+
+  free(blocks);
+  free(native);
+  free(b.exits);
+  free(b.data);
+
+  return fn;
+}
+
+#else
+
+native_function_t jit_x64_compile(const code_t *code, uint32_t first, uint32_t end,
+                                  uint32_t exitOffset, jit_native_region_t *out) {
+  return NULL;
+}
+
+#endif
@@ -0,0 +1,868 @@
+#include <vm/json.h>
+#include <vm/runtime.h>
+#include <vm/heap.h>
+#include <vm/object.h>
+#include <vm/map.h>
+#include <vm/scan.h>
+#include <vm/output.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(__SSE2__)
+  #include <emmintrin.h>
+  #define JSON_SSE2 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  #include <arm_neon.h>
+  #define JSON_NEON 1
+#endif
+
+// ===== stage 1: the structural index =====
+
+// the bytes of a 64 byte block that are each of these, a bit to a byte
+typedef struct json_block {
+  uint64_t quote;
+  uint64_t backslash;
+  uint64_t op; // { } [ ] : ,
+  uint64_t space;
+} json_block_t;
+
+#if JSON_SSE2
+
+static inline uint64_t json_eq(const __m128i v[4], char c) {
+  const __m128i m = _mm_set1_epi8(c);
+  uint64_t bits = 0;
+
+  for (int i = 0; i < 4; i++) {
+    bits |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v[i], m)) << (16 * i);
+  }
+
+  return bits;
+}
+
+static void json_classify(const uint8_t *data, json_block_t *b) {
+  __m128i v[4];
+  __m128i lower[4];
+
+  for (int i = 0; i < 4; i++) {
+    v[i] = _mm_loadu_si128((const __m128i*)(data + 16 * i));
+    // '[' and ']' are '{' and '}' with 0x20 clear
+    lower[i] = _mm_or_si128(v[i], _mm_set1_epi8(0x20));
+  }
+
+  b->quote = json_eq(v, '"');
+  b->backslash = json_eq(v, '\\');
+  b->op = json_eq(lower, '{') | json_eq(lower, '}') | json_eq(v, ':') | json_eq(v, ',');
+  b->space = json_eq(v, ' ') | json_eq(v, '\t') | json_eq(v, '\n') | json_eq(v, '\r');
+}
+
+#elif JSON_NEON
+
+// a bit for each lane of the four, as movemask would give them
+static inline uint64_t json_bits(const uint8x16_t m[4]) {
+  static const uint8_t weights[16] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+  const uint8x16_t w = vld1q_u8(weights);
+  uint8x16_t s0 = vpaddq_u8(vandq_u8(m[0], w), vandq_u8(m[1], w));
+  uint8x16_t s1 = vpaddq_u8(vandq_u8(m[2], w), vandq_u8(m[3], w));
+
+  s0 = vpaddq_u8(s0, s1);
+  s0 = vpaddq_u8(s0, s0);
+
+  return vgetq_lane_u64(vreinterpretq_u64_u8(s0), 0);
+}
+
+static inline uint64_t json_eq(const uint8x16_t v[4], uint8_t c) {
+  const uint8x16_t d = vdupq_n_u8(c);
+  uint8x16_t m[4];
+
+  for (int i = 0; i < 4; i++) {
+    m[i] = vceqq_u8(v[i], d);
+  }
+
+  return json_bits(m);
+}
+
+static void json_classify(const uint8_t *data, json_block_t *b) {
+  uint8x16_t v[4];
+  uint8x16_t lower[4];
+
+  for (int i = 0; i < 4; i++) {
+    v[i] = vld1q_u8(data + 16 * i);
+    lower[i] = vorrq_u8(v[i], vdupq_n_u8(0x20));
+  }
+
+  b->quote = json_eq(v, '"');
+  b->backslash = json_eq(v, '\\');
+  b->op = json_eq(lower, '{') | json_eq(lower, '}') | json_eq(v, ':') | json_eq(v, ',');
+  b->space = json_eq(v, ' ') | json_eq(v, '\t') | json_eq(v, '\n') | json_eq(v, '\r');
+}
+
+#else
+
+static void json_classify(const uint8_t *data, json_block_t *b) {
+  memset(b, 0, sizeof(*b));
+
+  for (int i = 0; i < 64; i++) {
+    const uint8_t c = data[i];
+    const uint64_t bit = (uint64_t)1 << i;
+
+    b->quote |= c == '"' ? bit : 0;
+    b->backslash |= c == '\\' ? bit : 0;
+    b->op |= (c | 0x20) == '{' || (c | 0x20) == '}' || c == ':' || c == ',' ? bit : 0;
+    b->space |= c == ' ' || c == '\t' || c == '\n' || c == '\r' ? bit : 0;
+  }
+}
+
+#endif
+
+// the bytes escaped by a backslash: those after a run of an odd number of
+// them. `*carry` is whether the last block ended in such a run, and is
+// set for the next. the paper's (Langdale and Lemire): runs starting on an
+// even bit end on an odd one after an odd length, and the other way round,
+// which adding the starts to the runs carries to.
+static inline uint64_t json_escaped(uint64_t backslash, uint64_t *carry) {
+  const uint64_t even = 0x5555555555555555ULL;
+  const uint64_t starts = backslash & ~(backslash << 1);
+  const uint64_t evenStartMask = even ^ *carry;
+  const uint64_t evenStarts = starts & evenStartMask;
+  const uint64_t oddStarts = starts & ~evenStartMask;
+  const uint64_t evenCarries = backslash + evenStarts;
+  uint64_t oddCarries;
+  const bool overflow = __builtin_add_overflow(backslash, oddStarts, &oddCarries);
+
+  oddCarries |= *carry;
+  *carry = overflow ? 1 : 0;
+
+  return ((evenCarries & ~backslash) & ~even) | ((oddCarries & ~backslash) & even);
+}
+
+// each bit the xor of itself and those below: between quotes, counting
+// the opening one
+static inline uint64_t json_prefixXor(uint64_t bits) {
+  bits ^= bits << 1;
+  bits ^= bits << 2;
+  bits ^= bits << 4;
+  bits ^= bits << 8;
+  bits ^= bits << 16;
+  bits ^= bits << 32;
+
+  return bits;
+}
+
+// the offsets of the quotes, the brackets, colons and commas outside
+// strings, and the first byte of each number and literal, into `index`
+// (room for len + 1), followed by `len`. SIZE_MAX if a string is not
+// closed.
+static size_t json_index(const uint8_t *data, size_t len, uint32_t *index) {
+  uint64_t escapeCarry = 0;
+  uint64_t inString = 0; // all ones while a string goes on into the next block
+  uint64_t scalarCarry = 0; // the last block ended in a number or literal
+  size_t count = 0;
+
+  for (size_t at = 0; at < len; at += 64) {
+    uint8_t tail[64];
+    const uint8_t *block = data + at;
+    json_block_t b;
+    uint64_t strings;
+    uint64_t scalars;
+    uint64_t bits;
+
+    // the last part, padded with spaces
+    if (len - at < 64) {
+      memset(tail, ' ', sizeof(tail));
+      memcpy(tail, block, len - at);
+      block = tail;
+    }
+
+    json_classify(block, &b);
+
+    b.quote &= ~json_escaped(b.backslash, &escapeCarry);
+    strings = json_prefixXor(b.quote) ^ inString;
+    inString = (uint64_t)((int64_t)strings >> 63);
+
+    // a string's bytes have the opening quote set and the closing one clear
+    b.op &= ~strings;
+    scalars = ~(b.op | b.space | b.quote | strings);
+    bits = b.op | b.quote | (scalars & ~((scalars << 1) | scalarCarry));
+    scalarCarry = scalars >> 63;
+
+    while (bits != 0) {
+      index[count++] = (uint32_t)(at + (size_t)__builtin_ctzll(bits));
+      bits &= bits - 1;
+    }
+  }
+
+  if (inString != 0) {
+    return SIZE_MAX;
+  }
+
+  index[count] = (uint32_t)len;
+
+  return count;
+}
+
+// ===== stage 2: building the values =====
+
+typedef struct json_frame {
+  value_t container;
+  bool object;
+  object_key_t key; // of the member being parsed
+  size_t next; // the next element's index, in an array
+} json_frame_t;
+
+typedef struct json_parser {
+  runtime_t *rt;
+  const uint8_t *data;
+  size_t len;
+  refcounted_t rc;
+  uint32_t base;
+  uint32_t *index;
+  uint32_t *counts; // members or elements, at the index of each { and [
+  size_t numIndex;
+  size_t pos; // in `index`
+  char *scratch; // for unescaping, `len` bytes
+  shape_t *path[SHAPE_MAX_MEMBERS]; // the shapes the last object went through
+} json_parser_t;
+
+static inline uint8_t json_peek(const json_parser_t *p) {
+  return p->pos < p->numIndex ? p->data[p->index[p->pos]] : 0;
+}
+
+// the elements of each array and the members of each object, from the
+// commas at their depth, and whether the brackets match
+static bool json_count(json_parser_t *p) {
+  uint32_t *stack = (uint32_t*)malloc(JSON_MAX_DEPTH * sizeof(uint32_t));
+  uint32_t *commas = (uint32_t*)malloc(JSON_MAX_DEPTH * sizeof(uint32_t));
+  size_t depth = 0;
+  bool ok = true;
+
+  for (size_t i = 0; ok && i < p->numIndex; i++) {
+    const uint8_t c = p->data[p->index[i]];
+
+    switch (c) {
+      case '{':
+      case '[':
+        if (depth == JSON_MAX_DEPTH) {
+          ok = false;
+          break;
+        }
+
+        stack[depth] = (uint32_t)i;
+        commas[depth++] = 0;
+        break;
+      case ',':
+        if (depth != 0) {
+          commas[depth - 1]++;
+        }
+
+        break;
+      case '}':
+      case ']':
+        // ']' and '}' are two after '[' and '{'
+        if (depth == 0 || p->data[p->index[stack[depth - 1]]] + 2 != c) {
+          ok = false;
+          break;
+        }
+
+        --depth;
+        p->counts[stack[depth]] = stack[depth] + 1 == i ? 0 : commas[depth] + 1;
+        break;
+      default:
+        break;
+    }
+  }
+
+  free(stack);
+  free(commas);
+
+  return ok && depth == 0;
+}
+
+// \u escapes: the code point of four hex digits, -1 if they are not
+static int32_t json_hex4(const uint8_t *s) {
+  int32_t v = 0;
+
+  for (int i = 0; i < 4; i++) {
+    const uint8_t c = s[i];
+    int32_t d;
+
+    if ((uint8_t)(c - '0') <= 9) {
+      d = c - '0';
+    } else if ((uint8_t)((c | 0x20) - 'a') <= 5) {
+      d = (c | 0x20) - 'a' + 10;
+    } else {
+      return -1;
+    }
+
+    v = v * 16 + d;
+  }
+
+  return v;
+}
+
+// the `len` bytes of a string's text at `s` unescaped into p->scratch;
+// the bytes written, or SIZE_MAX if an escape is malformed
+static size_t json_unescape(json_parser_t *p, const uint8_t *s, size_t len) {
+  char *out = p->scratch;
+  size_t i = 0;
+
+  while (i < len) {
+    const uint8_t *backslash = (const uint8_t*)memchr(s + i, '\\', len - i);
+    const size_t run = backslash != NULL ? (size_t)(backslash - s) - i : len - i;
+    int32_t cp;
+
+    memcpy(out, s + i, run);
+    out += run;
+    i += run;
+
+    if (i == len) {
+      break;
+    }
+
+    if (i + 1 == len) {
+      return SIZE_MAX;
+    }
+
+    switch (s[i + 1]) {
+      case '"': *out++ = '"'; break;
+      case '\\': *out++ = '\\'; break;
+      case '/': *out++ = '/'; break;
+      case 'b': *out++ = '\b'; break;
+      case 'f': *out++ = '\f'; break;
+      case 'n': *out++ = '\n'; break;
+      case 'r': *out++ = '\r'; break;
+      case 't': *out++ = '\t'; break;
+      case 'u':
+        if (i + 6 > len || (cp = json_hex4(s + i + 2)) < 0) {
+          return SIZE_MAX;
+        }
+
+        // a surrogate pair, in two escapes
+        if (cp >= 0xD800 && cp < 0xDC00 && i + 12 <= len && s[i + 6] == '\\' && s[i + 7] == 'u') {
+          const int32_t low = json_hex4(s + i + 8);
+
+          if (low >= 0xDC00 && low < 0xE000) {
+            cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+            i += 6;
+          }
+        }
+
+        // utf-8; no longer than the escape it replaces
+        if (cp < 0x80) {
+          *out++ = (char)cp;
+        } else if (cp < 0x800) {
+          *out++ = (char)(0xC0 | (cp >> 6));
+          *out++ = (char)(0x80 | (cp & 0x3F));
+        } else if (cp < 0x10000) {
+          *out++ = (char)(0xE0 | (cp >> 12));
+          *out++ = (char)(0x80 | ((cp >> 6) & 0x3F));
+          *out++ = (char)(0x80 | (cp & 0x3F));
+        } else {
+          *out++ = (char)(0xF0 | (cp >> 18));
+          *out++ = (char)(0x80 | ((cp >> 12) & 0x3F));
+          *out++ = (char)(0x80 | ((cp >> 6) & 0x3F));
+          *out++ = (char)(0x80 | (cp & 0x3F));
+        }
+
+        i += 4;
+        break;
+      default:
+        return SIZE_MAX;
+    }
+
+    i += 2;
+  }
+
+  return (size_t)(out - p->scratch);
+}
+
+// the string at p->pos, its opening quote, into `out`; the quotes are
+// passed
+static bool json_string(json_parser_t *p, value_t *out) {
+  const uint32_t start = p->index[p->pos] + 1;
+  const uint32_t end = p->index[p->pos + 1]; // its closing quote
+  const uint8_t *s = p->data + start;
+  const size_t len = end - start;
+  size_t n;
+
+  p->pos += 2;
+
+  if (memchr(s, '\\', len) == NULL) {
+    if (p->rc != NULL && len >= VALUE_INLINE_SIZE && len <= VALUE_SLICE_MAX) {
+      value_setSlice(p->rt, out, p->rc, p->base + start, len);
+    } else {
+      value_setData(p->rt, out, s, len);
+    }
+
+    return true;
+  }
+
+  if ((n = json_unescape(p, s, len)) == SIZE_MAX) {
+    return false;
+  }
+
+  value_setData(p->rt, out, p->scratch, n);
+
+  return true;
+}
+
+// the key at p->pos and the colon after it, interned unless it is the
+// one the last object of the same members had there
+static object_key_t json_key(json_parser_t *p, object_t *object) {
+  const uint32_t member = object->shape != NULL ? object->shape->count : SHAPE_MAX_MEMBERS;
+  const shape_t *next = member < SHAPE_MAX_MEMBERS ? p->path[member] : NULL;
+  const char *s;
+  size_t len;
+  bool escaped;
+
+  if (json_peek(p) != '"') {
+    return NULL;
+  }
+
+  s = (const char*)p->data + p->index[p->pos] + 1;
+  len = (const char*)p->data + p->index[p->pos + 1] - s;
+  escaped = memchr(s, '\\', len) != NULL;
+  p->pos += 2;
+
+  if (json_peek(p) != ':') {
+    return NULL;
+  }
+
+  p->pos++;
+
+  if (!escaped && next != NULL && next->parent == object->shape && strncmp(next->key, s, len) == 0
+      && next->key[len] == '\0') {
+    return next->key;
+  }
+
+  if (escaped) {
+    if ((len = json_unescape(p, (const uint8_t*)s, len)) == SIZE_MAX) {
+      return NULL;
+    }
+
+    s = p->scratch;
+  }
+
+  return (object_key_t)runtime_intern(p->rt, s, len);
+}
+
+// the number or literal at p->pos, up to the next structural byte
+static bool json_scalar(json_parser_t *p, value_t *out) {
+  const uint8_t *s = p->data + p->index[p->pos];
+  size_t len = p->index[p->pos + 1] - p->index[p->pos];
+  int64_t i64;
+  double dbl;
+
+  p->pos++;
+
+  while (len != 0 && (s[len - 1] == ' ' || s[len - 1] == '\t' || s[len - 1] == '\n' || s[len - 1] == '\r')) {
+    --len;
+  }
+
+  switch (s[0]) {
+    case 't':
+      if (len == 4 && memcmp(s, "true", 4) == 0) {
+        *out = value_fromBoolean(true);
+        return true;
+      }
+
+      return false;
+    case 'f':
+      if (len == 5 && memcmp(s, "false", 5) == 0) {
+        *out = value_fromBoolean(false);
+        return true;
+      }
+
+      return false;
+    case 'n':
+      if (len == 4 && memcmp(s, "null", 4) == 0) {
+        VALUE_SET_META(out, TYPE_NONE, FLAG_NONE);
+        out->data.u64 = 0;
+        return true;
+      }
+
+      return false;
+    default:
+      break;
+  }
+
+  if (s[0] != '-' && (uint8_t)(s[0] - '0') > 9) {
+    return false;
+  }
+
+  // an integer too large for an int is read as a double
+  if (scan_parseInt(s, len, &i64)) {
+    *out = value_fromInt(i64);
+    return true;
+  }
+
+  if (scan_parseDouble(s, len, &dbl) && isfinite(dbl)) {
+    *out = value_fromDouble(dbl);
+    return true;
+  }
+
+  return false;
+}
+
+// a container for the { or [ at p->pos, made at its size
+static value_t json_container(json_parser_t *p, bool object) {
+  const uint32_t count = p->counts[p->pos];
+  value_t v;
+
+  if (object) {
+    return value_createObjectWithCapacity(p->rt, p->rt->heap, count);
+  }
+
+  v = value_createArray(p->rt, p->rt->heap, ARRAY_VALUES, count);
+  array_resize((array_t*)v.data.hv->ptr, count);
+
+  return v;
+}
+
+// `v` into the container of `frame`, which takes over its reference;
+// released if it cannot
+static bool json_store(json_parser_t *p, json_frame_t *frame, value_t *v) {
+  heap_value_t *hv = frame->container.data.hv;
+
+  if (frame->object) {
+    object_t *object = (object_t*)hv->ptr;
+    const uint32_t member = object->shape != NULL ? object->shape->count : SHAPE_MAX_MEMBERS;
+    shape_t *next = member < SHAPE_MAX_MEMBERS ? p->path[member] : NULL;
+
+    // the next shape is most often the one the last object went to
+    if (next != NULL && next->parent == object->shape && next->key == frame->key) {
+      object_addSlot(object, next, v);
+    } else if (object_put(object, frame->key, v) != OBJECT_OK) {
+      value_release(p->rt, v);
+      return false;
+    } else if (member < SHAPE_MAX_MEMBERS && object->shape != NULL && object->shape->count == member + 1) {
+      p->path[member] = object->shape;
+    }
+  } else {
+    array_t *array = (array_t*)hv->ptr;
+
+    if (frame->next == array->size) {
+      value_release(p->rt, v);
+      return false;
+    }
+
+    ((value_t*)array->data)[frame->next++] = *v;
+  }
+
+  heap_writeBarrier(p->rt->heap, hv, v);
+
+  return true;
+}
+
+// the value the index describes, built without recursion: a frame for
+// each object or array that is open
+static bool json_build(json_parser_t *p, value_t *out) {
+  json_frame_t *frames = (json_frame_t*)malloc(JSON_MAX_DEPTH * sizeof(json_frame_t));
+  size_t depth = 0;
+  value_t v;
+  uint8_t c;
+  bool ok = false;
+
+  VALUE_SET_META(&v, TYPE_NONE, FLAG_NONE);
+  v.data.u64 = 0;
+
+value:
+  c = json_peek(p);
+
+  if (c == '{' || c == '[') {
+    json_frame_t *frame = &frames[depth++];
+
+    frame->object = c == '{';
+    frame->container = json_container(p, frame->object);
+    frame->next = 0;
+    p->pos++;
+
+    if (json_peek(p) == (frame->object ? '}' : ']')) {
+      p->pos++;
+      v = frame->container;
+      --depth;
+      goto done;
+    }
+
+    if (frame->object) {
+      goto member;
+    }
+
+    goto value;
+  }
+
+  if (c == '"' ? !json_string(p, &v) : p->pos == p->numIndex || !json_scalar(p, &v)) {
+    goto fail;
+  }
+
+done:
+  // `v` is complete: the result, or the next member or element
+  if (depth == 0) {
+    *out = v;
+    ok = p->pos == p->numIndex;
+    goto end;
+  }
+
+  // the container has the reference now, or it was released
+  ok = json_store(p, &frames[depth - 1], &v);
+  VALUE_SET_META(&v, TYPE_NONE, FLAG_NONE);
+
+  if (!ok) {
+    goto fail;
+  }
+
+  c = json_peek(p);
+  p->pos++;
+
+  if (c == ',') {
+    if (frames[depth - 1].object) {
+      goto member;
+    }
+
+    goto value;
+  }
+
+  if (c == (frames[depth - 1].object ? '}' : ']')) {
+    v = frames[--depth].container;
+    goto done;
+  }
+
+  goto fail;
+
+member:
+  if ((frames[depth - 1].key = json_key(p, (object_t*)frames[depth - 1].container.data.hv->ptr)) == NULL) {
+    goto fail;
+  }
+
+  goto value;
+
+fail:
+  // the nodes made are garbage now; a buffer `v` holds is not
+  value_release(p->rt, &v);
+  ok = false;
+
+end:
+  free(frames);
+
+  return ok;
+}
+
+bool json_parse(runtime_t *rt, const uint8_t *data, size_t len, refcounted_t rc, uint32_t base, value_t *out) {
+  json_parser_t p = { .rt = rt, .data = data, .len = len, .rc = rc, .base = base };
+  bool ok = false;
+
+  VALUE_SET_META(out, TYPE_NONE, FLAG_NONE);
+  out->data.u64 = 0;
+
+  // offsets are 32 bits, as slices' are
+  if (len >= UINT32_MAX || (uint64_t)base + len >= UINT32_MAX) {
+    return false;
+  }
+
+  p.index = (uint32_t*)malloc((len + 1) * sizeof(uint32_t));
+  p.counts = (uint32_t*)malloc((len + 1) * sizeof(uint32_t));
+  p.scratch = (char*)malloc(len + 1);
+
+  if (p.index != NULL && p.counts != NULL && p.scratch != NULL
+      && (p.numIndex = json_index(data, len, p.index)) != SIZE_MAX && p.numIndex != 0
+      && json_count(&p)) {
+    ok = json_build(&p, out);
+  }
+
+  if (!ok) {
+    value_release(rt, out);
+    VALUE_SET_META(out, TYPE_NONE, FLAG_NONE);
+  }
+
+  free(p.index);
+  free(p.counts);
+  free(p.scratch);
+
+  return ok;
+}
+
+// ===== writing =====
+
+static bool json_append(array_t *builder, const char *s, size_t len) {
+  return array_append(builder, s, len);
+}
+
+// `len` bytes as a quoted string, escaping what JSON requires
+static bool json_writeString(array_t *builder, const char *s, size_t len) {
+  static const char hex[] = "0123456789abcdef";
+  size_t from = 0;
+  bool ok = json_append(builder, "\"", 1);
+
+  for (size_t i = 0; ok && i < len; i++) {
+    const uint8_t c = (uint8_t)s[i];
+    char escape[6] = { '\\', 0, 0, 0, 0, 0 };
+    size_t n = 2;
+
+    if (c >= 0x20 && c != '"' && c != '\\') {
+      continue;
+    }
+
+    switch (c) {
+      case '"': escape[1] = '"'; break;
+      case '\\': escape[1] = '\\'; break;
+      case '\n': escape[1] = 'n'; break;
+      case '\r': escape[1] = 'r'; break;
+      case '\t': escape[1] = 't'; break;
+      case '\b': escape[1] = 'b'; break;
+      case '\f': escape[1] = 'f'; break;
+      default:
+        memcpy(escape + 1, "u00", 3);
+        escape[4] = hex[c >> 4];
+        escape[5] = hex[c & 0xF];
+        n = 6;
+        break;
+    }
+
+    ok = json_append(builder, s + from, i - from) && json_append(builder, escape, n);
+    from = i + 1;
+  }
+
+  return ok && json_append(builder, s + from, len - from) && json_append(builder, "\"", 1);
+}
+
+static bool json_writeValue(runtime_t *rt, array_t *builder, value_t *v, size_t depth);
+
+// a member or an entry: the key, a colon and the value, after a comma
+// but for the first
+static bool json_writeMember(runtime_t *rt, array_t *builder, const char *key, size_t len, value_t *v,
+                             bool first, size_t depth) {
+  return (first || json_append(builder, ",", 1)) && json_writeString(builder, key, len)
+    && json_append(builder, ":", 1) && json_writeValue(rt, builder, v, depth);
+}
+
+static bool json_writeNode(runtime_t *rt, array_t *builder, heap_value_t *hv, size_t depth) {
+  char buf[OUTPUT_NUMBER_MAX];
+  bool ok = true;
+
+  switch (hv->kind) {
+    case HEAP_KIND_ARRAY: {
+      array_t *array = (array_t*)hv->ptr;
+
+      if (array == builder || array->kind == ARRAY_BYTES) {
+        // a string builder is text; the builder itself is, up to here
+        return array != builder ? json_writeString(builder, (const char*)array->data, array->size)
+          : json_append(builder, "null", 4);
+      }
+
+      ok = json_append(builder, "[", 1);
+
+      for (size_t i = 0; ok && i < array->size; i++) {
+        ok = i == 0 || json_append(builder, ",", 1);
+
+        if (array->kind == ARRAY_VALUES) {
+          ok = ok && json_writeValue(rt, builder, &((value_t*)array->data)[i], depth);
+        } else if (array->kind == ARRAY_I64) {
+          ok = ok && json_append(builder, buf, output_formatInt(buf, ((int64_t*)array->data)[i]));
+        } else {
+          const double dbl = ((double*)array->data)[i];
+
+          ok = ok && (isfinite(dbl) ? json_append(builder, buf, output_formatDouble(buf, dbl))
+                                    : json_append(builder, "null", 4));
+        }
+      }
+
+      return ok && json_append(builder, "]", 1);
+    }
+    case HEAP_KIND_MAP: {
+      map_t *map = (map_t*)hv->ptr;
+      bool first = true;
+
+      ok = json_append(builder, "{", 1);
+
+      for (size_t i = 0; ok && i < map->capacity; i++) {
+        if (!(map->ctrl[i] & 0x80)) {
+          ok = json_writeMember(rt, builder, map->entries[i].key, map->entries[i].len, &map->entries[i].value, first, depth);
+          first = false;
+        }
+      }
+
+      return ok && json_append(builder, "}", 1);
+    }
+    case HEAP_KIND_OBJECT: {
+      object_t *object = (object_t*)hv->ptr;
+
+      ok = json_append(builder, "{", 1);
+
+      if (object->shape != NULL) {
+        // in slot order, the order they were set in
+        object_key_t keys[SHAPE_MAX_MEMBERS];
+
+        for (const shape_t *s = object->shape; s->parent != NULL; s = s->parent) {
+          keys[s->slot] = s->key;
+        }
+
+        for (uint32_t i = 0; ok && i < object->shape->count; i++) {
+          ok = json_writeMember(rt, builder, keys[i], strlen(keys[i]), &object->slots[i], i == 0, depth);
+        }
+      } else {
+        bool first = true;
+
+        for (size_t i = 0; ok && i < object->numMembers; i++) {
+          if (object->members[i].used) {
+            ok = json_writeMember(rt, builder, object->members[i].key, strlen(object->members[i].key),
+                                  &object->members[i].value, first, depth);
+            first = false;
+          }
+        }
+      }
+
+      return ok && json_append(builder, "}", 1);
+    }
+    default:
+      return json_append(builder, "null", 4);
+  }
+}
+
+static bool json_writeValue(runtime_t *rt, array_t *builder, value_t *v, size_t depth) {
+  char buf[OUTPUT_NUMBER_MAX];
+  const char *str;
+  size_t len;
+
+  if (depth == JSON_MAX_DEPTH) {
+    return false;
+  }
+
+  switch (VALUE_TYPE_OF(v)) {
+    case TYPE_INT:
+    case TYPE_UINT:
+    case TYPE_BOOLEAN:
+      return json_append(builder, buf, output_formatScalar(buf, v));
+    case TYPE_DOUBLE:
+      return isfinite(value_getDouble(v)) ? json_append(builder, buf, output_formatScalar(buf, v))
+                                          : json_append(builder, "null", 4);
+    case TYPE_POINTER:
+      // an empty inline string is all zeros too
+      if (v->data.raw == NULL && !(value_getFlags(v) & FLAG_INLINE)) {
+        break;
+      }
+
+      if (value_getFlags(v) & FLAG_OBJECT) {
+        return json_writeNode(rt, builder, v->data.hv, depth + 1);
+      }
+
+      // a string, as builtins_string reads it
+      str = (const char*)value_getRawPointer(v);
+
+      if (VALUE_IS_SLICE(v)) {
+        len = strnlen(str, VALUE_SLICE_LENGTH(v));
+      } else {
+        len = (value_getFlags(v) & FLAG_REFCOUNTED) ? strnlen(str, rc_size(v->data.rc)) : strlen(str);
+      }
+
+      return json_writeString(builder, str, len);
+    default:
+      break;
+  }
+
+  return json_append(builder, "null", 4);
+}
+
+bool json_write(runtime_t *rt, array_t *builder, value_t *v) {
+  return json_writeValue(rt, builder, v, 0);
+}
@@ -0,0 +1,87 @@
+#include <vm/lz4.h>
+
+#include <string.h>
+
+// a literal or match length: the token's nibble, and while that is 15,
+// the following bytes, the last one less than 255
+static bool lz4_readLength(const uint8_t **src, const uint8_t *end, size_t *len) {
+  uint8_t b;
+
+  if (*len != 15) {
+    return true;
+  }
+
+  do {
+    if (*src == end) {
+      return false;
+    }
+
+    b = *(*src)++;
+    *len += b;
+  } while (b == 255);
+
+  return true;
+}
+
+bool lz4_decompressBlock(const uint8_t *src, size_t srcLen, uint8_t *dst, size_t dstCap, size_t *dstLen) {
+  const uint8_t *end = src + srcLen;
+  size_t d = 0;
+
+  for (;;) {
+    uint8_t token;
+    size_t literals, match, offset;
+
+    if (src == end) {
+      return false;
+    }
+
+    token = *src++;
+    literals = token >> 4;
+
+    if (!lz4_readLength(&src, end, &literals)
+        || literals > (size_t)(end - src) || literals > dstCap - d) {
+      return false;
+    }
+
+    memcpy(dst + d, src, literals);
+    src += literals;
+    d += literals;
+
+    // the last sequence is only literals
+    if (src == end) {
+      break;
+    }
+
+    if (end - src < 2) {
+      return false;
+    }
+
+    offset = (size_t)src[0] | ((size_t)src[1] << 8);
+    src += 2;
+    match = token & 0xF;
+
+    if (offset == 0 || offset > d || !lz4_readLength(&src, end, &match)) {
+      return false;
+    }
+
+    match += 4;
+
+    if (match > dstCap - d) {
+      return false;
+    }
+
+    if (offset >= match) {
+      memcpy(dst + d, dst + d - offset, match);
+      d += match;
+    } else {
+      // a byte at a time: the match overlaps what it writes
+      for (size_t i = 0; i < match; i++, d++) {
+        dst[d] = dst[d - offset];
+      }
+    }
+  }
+
+  *dstLen = d;
+
+  return true;
+}
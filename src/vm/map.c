@@ -0,0 +1,266 @@
+#include <vm/map.h>
+#include <vm/heap.h>
+#include <vm/util.h>
+
+#include <string.h>
+
+#if defined(__SSE2__)
+  #include <emmintrin.h>
+  #define MAP_SSE2 1
+#elif defined(__ARM_NEON) && defined(__aarch64__) // vaddv is A64 only
+  #include <arm_neon.h>
+  #define MAP_NEON 1
+#endif
+
+#define MAP_H2(hash) ((uint8_t)((hash) & 0x7F))
+#define MAP_H1(hash) ((hash) >> 7)
+
+// bit i set where control byte i of the group equals `c`
+static inline uint32_t map_match(const uint8_t *group, uint8_t c) {
+#if MAP_SSE2
+  __m128i v = _mm_loadu_si128((const __m128i*)group);
+
+  return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8((char)c)));
+#elif MAP_NEON
+  uint8x16_t m = vceqq_u8(vld1q_u8(group), vdupq_n_u8(c));
+  // one bit per lane, weighted 1 .. 128 in each half, then added up
+  static const uint8_t weights[16] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+  uint8x16_t bits = vandq_u8(m, vld1q_u8(weights));
+
+  return (uint32_t)vaddv_u8(vget_low_u8(bits)) | ((uint32_t)vaddv_u8(vget_high_u8(bits)) << 8);
+#else
+  uint32_t mask = 0;
+
+  for (unsigned i = 0; i < MAP_GROUP; i++) {
+    mask |= (uint32_t)(group[i] == c) << i;
+  }
+
+  return mask;
+#endif
+}
+
+// empty and deleted entries, which are the control bytes with the top bit set
+static inline uint32_t map_matchFree(const uint8_t *group) {
+#if MAP_SSE2
+  return (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)group));
+#else
+  return map_match(group, MAP_EMPTY) | map_match(group, MAP_DELETED);
+#endif
+}
+
+static inline unsigned map_firstBit(uint32_t mask) {
+  return (unsigned)__builtin_ctz(mask);
+}
+
+// the index of `key`'s entry, or SIZE_MAX
+static size_t map_find(map_t *map, uint64_t hash, const char *key, size_t len) {
+  size_t mask = map->capacity / MAP_GROUP - 1;
+  size_t group = MAP_H1(hash) & mask;
+
+  for (size_t probe = 1; ; probe++) {
+    const uint8_t *ctrl = map->ctrl + group * MAP_GROUP;
+
+    for (uint32_t m = map_match(ctrl, MAP_H2(hash)); m != 0; m &= m - 1) {
+      size_t index = group * MAP_GROUP + map_firstBit(m);
+      map_entry_t *e = &map->entries[index];
+
+      if (e->hash == hash && e->len == len && memcmp(e->key, key, len) == 0) {
+        return index;
+      }
+    }
+
+    if (map_match(ctrl, MAP_EMPTY) != 0 || probe > mask) {
+      return SIZE_MAX; // an insert would have stopped here
+    }
+
+    group = (group + probe) & mask;
+  }
+}
+
+// the first empty or deleted entry on `hash`'s probe sequence; the table
+// is never full, so there always is one
+static size_t map_findFree(uint8_t *ctrl, size_t capacity, uint64_t hash) {
+  size_t mask = capacity / MAP_GROUP - 1;
+  size_t group = MAP_H1(hash) & mask;
+
+  for (size_t probe = 1; ; probe++) {
+    uint32_t m = map_matchFree(ctrl + group * MAP_GROUP);
+
+    if (m != 0) {
+      return group * MAP_GROUP + map_firstBit(m);
+    }
+
+    group = (group + probe) & mask;
+  }
+}
+
+static bool map_alloc(map_t *map, size_t capacity) {
+  uint8_t *ctrl = (uint8_t*)heap_allocBlock(map->heap, capacity);
+  map_entry_t *entries = (map_entry_t*)heap_allocBlock(map->heap, capacity * sizeof(map_entry_t));
+
+  if (ctrl == NULL || entries == NULL) {
+    heap_freeBlock(map->heap, ctrl, capacity);
+    heap_freeBlock(map->heap, entries, capacity * sizeof(map_entry_t));
+    return false;
+  }
+
+  memset(ctrl, MAP_EMPTY, capacity);
+
+  map->ctrl = ctrl;
+  map->entries = entries;
+  map->capacity = capacity;
+  map->used = map->size;
+
+  return true;
+}
+
+// moves the live entries into a new table: twice the size if it is more
+// than half full, else the same size without the deleted entries
+static bool map_rebuild(map_t *map) {
+  uint8_t *ctrl = map->ctrl;
+  map_entry_t *entries = map->entries;
+  size_t capacity = map->capacity;
+
+  if (!map_alloc(map, map->size * 2 >= capacity ? capacity * 2 : capacity)) {
+    return false;
+  }
+
+  for (size_t i = 0; i < capacity; i++) {
+    if (!(ctrl[i] & 0x80)) {
+      size_t index = map_findFree(map->ctrl, map->capacity, entries[i].hash);
+
+      map->ctrl[index] = ctrl[i];
+      map->entries[index] = entries[i];
+    }
+  }
+
+  heap_freeBlock(map->heap, ctrl, capacity);
+  heap_freeBlock(map->heap, entries, capacity * sizeof(map_entry_t));
+
+  return true;
+}
+
+map_t *map_create(heap_t *heap) {
+  map_t *map = (map_t*)heap_allocBlock(heap, sizeof(map_t));
+  map->heap = heap;
+  map->size = 0;
+
+  if (!map_alloc(map, MAP_INITIAL_CAPACITY)) {
+    map->ctrl = NULL;
+    map->entries = NULL;
+    map->capacity = 0;
+    map->used = 0;
+  }
+
+  return map;
+}
+
+void map_destroy(map_t *map) {
+  heap_t *heap = map->heap;
+
+  for (size_t i = 0; i < map->capacity; i++) {
+    if (!(map->ctrl[i] & 0x80)) {
+      heap_freeBlock(heap, map->entries[i].key, map->entries[i].len + 1);
+    }
+  }
+
+  heap_freeBlock(heap, map->ctrl, map->capacity);
+  heap_freeBlock(heap, map->entries, map->capacity * sizeof(map_entry_t));
+  heap_freeBlock(heap, map, sizeof(map_t));
+}
+
+void map_mark(map_t *map, heap_t *heap) {
+  for (size_t i = 0; i < map->capacity; i++) {
+    if (!(map->ctrl[i] & 0x80)) {
+      heap_mark(heap, &map->entries[i].value);
+    }
+  }
+}
+
+void map_destructor(runtime_t *rt, args_t *args) {
+  if (args->_rawData != NULL) {
+    map_destroy((map_t*)args->_rawData);
+  }
+}
+
+value_t *map_get(map_t *map, const char *key, size_t len) {
+  size_t index;
+
+  if (map->capacity == 0) {
+    return NULL;
+  }
+
+  index = map_find(map, hashString64(key, len), key, len);
+
+  return index != SIZE_MAX ? &map->entries[index].value : NULL;
+}
+
+bool map_set(runtime_t *rt, map_t *map, const char *key, size_t len, value_t *value) {
+  uint64_t hash = hashString64(key, len);
+  size_t index = map->capacity != 0 ? map_find(map, hash, key, len) : SIZE_MAX;
+  map_entry_t *e;
+  char *copy;
+
+  if (index != SIZE_MAX) {
+    value_copyValue(rt, &map->entries[index].value, value);
+    return true;
+  }
+
+  if (map->capacity == 0) {
+    if (!map_alloc(map, MAP_INITIAL_CAPACITY)) {
+      return false;
+    }
+  } else if ((map->used + 1) * 8 > map->capacity * 7 && !map_rebuild(map)) {
+    return false;
+  }
+
+  if ((copy = (char*)heap_allocBlock(map->heap, len + 1)) == NULL) {
+    return false;
+  }
+
+  memcpy(copy, key, len);
+  copy[len] = '\0';
+
+  index = map_findFree(map->ctrl, map->capacity, hash);
+
+  if (map->ctrl[index] == MAP_EMPTY) {
+    ++map->used;
+  }
+
+  map->ctrl[index] = MAP_H2(hash);
+  ++map->size;
+
+  e = &map->entries[index];
+  e->hash = hash;
+  e->key = copy;
+  e->len = len;
+  VALUE_SET_META(&e->value, TYPE_NONE, FLAG_NONE);
+  value_copyValue(rt, &e->value, value);
+
+  return true;
+}
+
+bool map_remove(runtime_t *rt, map_t *map, const char *key, size_t len) {
+  size_t index;
+
+  if (map->capacity == 0
+      || (index = map_find(map, hashString64(key, len), key, len)) == SIZE_MAX) {
+    return false;
+  }
+
+  value_release(rt, &map->entries[index].value);
+  heap_freeBlock(map->heap, map->entries[index].key, map->entries[index].len + 1);
+
+  // a group with an empty entry was never full, so no probe went past it
+  // and the entry can be empty again rather than deleted
+  if (map_match(map->ctrl + index / MAP_GROUP * MAP_GROUP, MAP_EMPTY) != 0) {
+    map->ctrl[index] = MAP_EMPTY;
+    --map->used;
+  } else {
+    map->ctrl[index] = MAP_DELETED;
+  }
+
+  --map->size;
+
+  return true;
+}
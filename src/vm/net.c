@@ -0,0 +1,500 @@
+#if defined(__linux__)
+  #define _GNU_SOURCE // for accept4
+#endif
+
+#include <vm/net.h>
+#include <vm/fiber.h>
+#include <vm/runtime.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#if defined(__linux__)
+  #include <sys/epoll.h>
+  #include <sys/sendfile.h>
+  #define NET_EPOLL 1
+#endif
+
+static net_socket_t *net_socket(int fd, bool listening) {
+  net_socket_t *s = (net_socket_t*)malloc(sizeof(net_socket_t));
+
+  s->fd = fd;
+  s->listening = listening;
+  s->waitWrite = false;
+  s->waiter = NULL;
+
+  return s;
+}
+
+static bool net_nonBlocking(int fd) {
+  int flags = fcntl(fd, F_GETFL, 0);
+
+  return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0 && fcntl(fd, F_SETFD, FD_CLOEXEC) == 0;
+}
+
+static bool net_again() {
+  return errno == EAGAIN || errno == EWOULDBLOCK;
+}
+
+// ===== addresses =====
+
+// `addr` as a Unix socket's, false if it is not "unix:path" or too long
+static bool net_unixAddress(const char *addr, size_t len, struct sockaddr_un *out) {
+  if (len < 5 || memcmp(addr, "unix:", 5) != 0) {
+    return false;
+  }
+
+  addr += 5;
+  len -= 5;
+
+  if (len == 0 || len >= sizeof(out->sun_path)) {
+    return false;
+  }
+
+  memset(out, 0, sizeof(*out));
+  out->sun_family = AF_UNIX;
+  memcpy(out->sun_path, addr, len);
+
+  return true;
+}
+
+// "host:port" resolved, the host being the part before the last ':'; NULL
+// if it does not resolve. freed with freeaddrinfo.
+static struct addrinfo *net_resolve(const char *addr, size_t len, bool passive) {
+  struct addrinfo hints, *result = NULL;
+  char host[256], port[16];
+  const char *colon = NULL;
+  size_t hostLen;
+
+  for (size_t i = len; i-- > 0;) {
+    if (addr[i] == ':') {
+      colon = addr + i;
+      break;
+    }
+  }
+
+  if (colon == NULL || (hostLen = (size_t)(colon - addr)) >= sizeof(host)
+      || len - hostLen - 1 == 0 || len - hostLen - 1 >= sizeof(port)) {
+    return NULL;
+  }
+
+  // "[::1]:80": the brackets are not the host's
+  if (hostLen >= 2 && addr[0] == '[' && addr[hostLen - 1] == ']') {
+    memcpy(host, addr + 1, hostLen - 2);
+    host[hostLen - 2] = '\0';
+  } else {
+    memcpy(host, addr, hostLen);
+    host[hostLen] = '\0';
+  }
+
+  memcpy(port, colon + 1, len - hostLen - 1);
+  port[len - hostLen - 1] = '\0';
+
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = passive ? AI_PASSIVE : 0;
+
+  if (getaddrinfo(host[0] == '\0' || strcmp(host, "*") == 0 ? NULL : host, port, &hints, &result) != 0) {
+    return NULL;
+  }
+
+  return result;
+}
+
+// ===== sockets =====
+
+net_socket_t *net_listen(const char *addr, size_t len, int backlog) {
+  struct sockaddr_un sun;
+  struct addrinfo *ai, *list;
+  int fd = -1;
+
+  if (net_unixAddress(addr, len, &sun)) {
+    if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+      return NULL;
+    }
+
+    // a socket file left by an earlier run would fail the bind
+    unlink(sun.sun_path);
+
+    if (!net_nonBlocking(fd) || bind(fd, (struct sockaddr*)&sun, sizeof(sun)) != 0 || listen(fd, backlog) != 0) {
+      close(fd);
+      return NULL;
+    }
+
+    return net_socket(fd, true);
+  }
+
+  if ((list = net_resolve(addr, len, true)) == NULL) {
+    return NULL;
+  }
+
+  for (ai = list; ai != NULL; ai = ai->ai_next) {
+    int one = 1;
+
+    if ((fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol)) < 0) {
+      continue;
+    }
+
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    if (net_nonBlocking(fd) && bind(fd, ai->ai_addr, ai->ai_addrlen) == 0 && listen(fd, backlog) == 0) {
+      break;
+    }
+
+    close(fd);
+    fd = -1;
+  }
+
+  freeaddrinfo(list);
+
+  return fd >= 0 ? net_socket(fd, true) : NULL;
+}
+
+net_socket_t *net_connect(const char *addr, size_t len) {
+  struct sockaddr_un sun;
+  struct addrinfo *ai, *list;
+  int fd = -1;
+
+  if (net_unixAddress(addr, len, &sun)) {
+    if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+      return NULL;
+    }
+
+    if (!net_nonBlocking(fd) || (connect(fd, (struct sockaddr*)&sun, sizeof(sun)) != 0 && errno != EINPROGRESS && !net_again())) {
+      close(fd);
+      return NULL;
+    }
+
+    return net_socket(fd, false);
+  }
+
+  if ((list = net_resolve(addr, len, false)) == NULL) {
+    return NULL;
+  }
+
+  for (ai = list; ai != NULL; ai = ai->ai_next) {
+    if ((fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol)) < 0) {
+      continue;
+    }
+
+    if (net_nonBlocking(fd) && (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0 || errno == EINPROGRESS)) {
+      break;
+    }
+
+    close(fd);
+    fd = -1;
+  }
+
+  freeaddrinfo(list);
+
+  return fd >= 0 ? net_socket(fd, false) : NULL;
+}
+
+net_socket_t *net_accept(net_socket_t *listener) {
+  int fd;
+
+  if (listener->fd < 0 || !listener->listening) {
+    return NULL;
+  }
+
+  do {
+#if defined(__linux__)
+    fd = accept4(listener->fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+    fd = accept(listener->fd, NULL, NULL);
+#endif
+  } while (fd < 0 && errno == EINTR);
+
+  if (fd < 0) {
+    return NULL;
+  }
+
+#if !defined(__linux__)
+  if (!net_nonBlocking(fd)) {
+    close(fd);
+    return NULL;
+  }
+#endif
+
+  return net_socket(fd, false);
+}
+
+int64_t net_read(net_socket_t *s, void *dst, size_t size) {
+  ssize_t n;
+
+  if (s->fd < 0 || s->listening) {
+    return -1;
+  }
+
+  do {
+    n = recv(s->fd, dst, size, 0);
+  } while (n < 0 && errno == EINTR);
+
+  return n >= 0 ? (int64_t)n : net_again() ? NET_AGAIN : -1;
+}
+
+int64_t net_write(net_socket_t *s, const void *src, size_t size) {
+  ssize_t n;
+
+  if (s->fd < 0 || s->listening) {
+    return -1;
+  }
+
+  do {
+#if defined(MSG_NOSIGNAL)
+    n = send(s->fd, src, size, MSG_NOSIGNAL);
+#else
+    n = send(s->fd, src, size, 0);
+#endif
+  } while (n < 0 && errno == EINTR);
+
+  return n >= 0 ? (int64_t)n : net_again() ? NET_AGAIN : -1;
+}
+
+int64_t net_sendFile(net_socket_t *s, int fd, int64_t offset, size_t size) {
+  if (s->fd < 0 || s->listening || fd < 0 || offset < 0) {
+    return -1;
+  }
+
+#if NET_EPOLL
+  {
+    off_t position = (off_t)offset;
+    ssize_t n;
+
+    do {
+      n = sendfile(s->fd, fd, &position, size);
+    } while (n < 0 && errno == EINTR);
+
+    if (n >= 0) {
+      return (int64_t)n;
+    }
+
+    if (net_again()) {
+      return NET_AGAIN;
+    }
+
+    // not a file sendfile takes, e.g a pipe: through a buffer, below
+    if (errno != EINVAL && errno != ENOSYS) {
+      return -1;
+    }
+  }
+#endif
+
+  {
+    char buf[16 * 1024];
+    ssize_t n;
+
+    do {
+      n = pread(fd, buf, size < sizeof(buf) ? size : sizeof(buf), (off_t)offset);
+    } while (n < 0 && errno == EINTR);
+
+    if (n <= 0) {
+      return n == 0 ? 0 : -1;
+    }
+
+    // what the socket does not take now is read again next time
+    return net_write(s, buf, (size_t)n);
+  }
+}
+
+// wakes the fiber parked on `s`
+static void net_wake(net_t *net, fibers_t *fibers, net_socket_t *s) {
+  fiber_t *fiber = s->waiter;
+
+#if NET_EPOLL
+  if (net->epfd >= 0) {
+    epoll_ctl(net->epfd, EPOLL_CTL_DEL, s->fd, NULL);
+  } else
+#endif
+  {
+    for (fiber_t **f = &net->parked; *f != NULL; f = &(*f)->next) {
+      if (*f == fiber) {
+        *f = fiber->next;
+        break;
+      }
+    }
+  }
+
+  s->waiter = NULL;
+  --net->numParked;
+
+  fiber->state = FIBER_RUNNABLE;
+  VALUE_SET_META(&fiber->io, TYPE_NONE, FLAG_NONE);
+  fibers_enqueue(fibers, fiber);
+}
+
+void net_close(runtime_t *rt, net_socket_t *s) {
+  if (s->fd < 0) {
+    return;
+  }
+
+  if (s->waiter != NULL && rt->net != NULL && rt->fibers != NULL) {
+    net_wake(rt->net, rt->fibers, s);
+  }
+
+  close(s->fd);
+  s->fd = -1;
+}
+
+void net_destructor(runtime_t *rt, args_t *args) {
+  net_socket_t *s = (net_socket_t*)args->_rawData;
+
+  // a parked fiber keeps its socket alive, so there is none waiting here
+  if (s != NULL) {
+    if (s->fd >= 0) {
+      close(s->fd);
+    }
+
+    free(s);
+  }
+}
+
+// ===== waiting =====
+
+void net_wait(runtime_t *rt, net_socket_t *s, bool write) {
+  struct pollfd p;
+
+  p.fd = s->fd;
+  p.events = write ? POLLOUT : POLLIN;
+
+  while (s->fd >= 0) {
+    p.revents = 0;
+
+    if (poll(&p, 1, NET_WAIT_MS) != 0 && (p.revents != 0 || errno != EINTR)) {
+      return;
+    }
+
+    // the wait is in a call, where the collector may stop the runtime
+    runtime_safepoint(rt);
+  }
+}
+
+net_t *net_create() {
+  net_t *net = (net_t*)calloc(1, sizeof(net_t));
+
+#if NET_EPOLL
+  net->epfd = epoll_create1(EPOLL_CLOEXEC);
+#else
+  net->epfd = -1;
+#endif
+
+  return net;
+}
+
+void net_destroy(net_t *net) {
+  if (net->epfd >= 0) {
+    close(net->epfd);
+  }
+
+  free(net);
+}
+
+bool net_park(net_t *net, fibers_t *fibers, value_t *socket, bool write) {
+  net_socket_t *s = (net_socket_t*)value_getHeapNode(socket)->ptr;
+  fiber_t *fiber = fibers->current;
+
+  if (s->fd < 0 || s->waiter != NULL) {
+    return false;
+  }
+
+#if NET_EPOLL
+  if (net->epfd >= 0) {
+    struct epoll_event ev;
+
+    ev.events = (write ? EPOLLOUT : EPOLLIN) | EPOLLONESHOT;
+    ev.data.ptr = s;
+
+    if (epoll_ctl(net->epfd, EPOLL_CTL_ADD, s->fd, &ev) != 0) {
+      return false;
+    }
+  } else
+#endif
+  {
+    fiber->next = net->parked;
+    net->parked = fiber;
+  }
+
+  s->waitWrite = write;
+  s->waiter = fiber;
+  ++net->numParked;
+
+  fiber->state = FIBER_IO;
+  fiber->io = *socket;
+
+  return true;
+}
+
+// the fibers parked without epoll, polled at once
+static size_t net_pollParked(net_t *net, fibers_t *fibers, int timeoutMs) {
+  struct pollfd *p = (struct pollfd*)malloc(sizeof(struct pollfd) * net->numParked);
+  net_socket_t **sockets = (net_socket_t**)malloc(sizeof(net_socket_t*) * net->numParked);
+  size_t count = 0, woken = 0;
+
+  for (fiber_t *f = net->parked; f != NULL; f = f->next) {
+    sockets[count] = (net_socket_t*)value_getHeapNode(&f->io)->ptr;
+    p[count].fd = sockets[count]->fd;
+    p[count].events = sockets[count]->waitWrite ? POLLOUT : POLLIN;
+    p[count].revents = 0;
+    count++;
+  }
+
+  if (poll(p, (nfds_t)count, timeoutMs) > 0) {
+    for (size_t i = 0; i < count; i++) {
+      if (p[i].revents != 0) {
+        net_wake(net, fibers, sockets[i]);
+        woken++;
+      }
+    }
+  }
+
+  free(sockets);
+  free(p);
+
+  return woken;
+}
+
+size_t net_poll(runtime_t *rt, net_t *net, fibers_t *fibers, int timeoutMs) {
+  for (;;) {
+    int slice = timeoutMs < 0 || timeoutMs > NET_WAIT_MS ? NET_WAIT_MS : timeoutMs;
+    size_t woken = 0;
+
+    if (net->numParked == 0) {
+      return 0;
+    }
+
+#if NET_EPOLL
+    if (net->epfd >= 0) {
+      struct epoll_event events[64];
+      int n = epoll_wait(net->epfd, events, 64, slice);
+
+      for (int i = 0; i < n; i++) {
+        net_wake(net, fibers, (net_socket_t*)events[i].data.ptr);
+      }
+
+      woken = n > 0 ? (size_t)n : 0;
+    } else
+#endif
+    {
+      woken = net_pollParked(net, fibers, slice);
+    }
+
+    if (woken != 0 || timeoutMs == 0) {
+      return woken;
+    }
+
+    if (timeoutMs > 0 && (timeoutMs -= slice) <= 0) {
+      return 0;
+    }
+
+    runtime_safepoint(rt);
+  }
+}
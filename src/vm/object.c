@@ -1,19 +1,130 @@
 #include <vm/object.h>
 #include <vm/util.h>
+#include <vm/heap.h>
 
+#include <stdio.h>
 #include <stdlib.h>
 
-object_t *object_create() {
-  object_t *object = (object_t*)malloc(sizeof(object_t));
-  object->members = (object_member_t*)calloc(OBJECT_INITIAL_SIZE, sizeof(object_member_t));
-  object->tableSize = OBJECT_INITIAL_SIZE;
+// a member table with no members: its index all OBJECT_EMPTY
+static object_member_t *object_allocMembers(heap_t *heap, size_t tableSize) {
+  object_member_t *members = (object_member_t*)heap_allocBlock(heap, object_tableBytes(tableSize));
+  memset(members + tableSize / 2, 0xff, tableSize * sizeof(int32_t));
+  return members;
+}
+
+// slots for `numSlots`, the object's inline ones if they fit
+static value_t *object_allocSlots(object_t *object, uint32_t numSlots) {
+  if (numSlots <= OBJECT_INLINE_SLOTS && object->slots == NULL) {
+    return (value_t*)(object + 1);
+  }
+
+  return (value_t*)heap_allocBlock(object->heap, numSlots * sizeof(value_t));
+}
+
+// frees the slots, unless they are inline
+static void object_freeSlots(object_t *object) {
+  if (!object_slotsInline(object)) {
+    heap_freeBlock(object->heap, object->slots, object->numSlots * sizeof(value_t));
+  }
+}
+
+object_t *object_create(heap_t *heap) {
+  object_t *object = (object_t*)heap_allocBlock(heap, OBJECT_BLOCK_SIZE);
+  object->members = NULL;
+  object->tableSize = 0;
   object->size = 0;
+  object->numMembers = 0;
+  object->heap = heap;
+  object->shape = heap->shapes;
+  object->slots = NULL; // allocated with the first member
+  object->numSlots = 0;
+  object->capacity = 0;
+  return object;
+}
+
+// the table size that holds `count` members below the load factor
+// object_hash allows, so that putting them never rehashes
+static size_t object_tableSizeFor(size_t count) {
+  size_t tableSize = OBJECT_INITIAL_SIZE;
+
+  while (tableSize / 2 <= count) {
+    tableSize *= 2;
+  }
+
+  return tableSize;
+}
+
+object_t *object_createWithCapacity(heap_t *heap, uint32_t capacity) {
+  object_t *object = object_create(heap);
+  uint32_t numSlots = OBJECT_INITIAL_SLOTS;
+
+  // past SHAPE_MAX_MEMBERS, object_toTable sizes the table for the rest
+  object->capacity = capacity;
+
+  if (capacity != 0) {
+    while (numSlots < capacity && numSlots < SHAPE_MAX_MEMBERS) {
+      numSlots *= 2;
+    }
+
+    object->slots = object_allocSlots(object, numSlots);
+    object->numSlots = numSlots;
+  }
+
+  return object;
+}
+
+object_t *object_createShaped(heap_t *heap, shape_t *shape) {
+  object_t *object = object_create(heap);
+  uint32_t numSlots = OBJECT_INITIAL_SLOTS;
+
+  // as many as object_addSlot would have grown to
+  while (numSlots < shape->count) {
+    numSlots *= 2;
+  }
+
+  object->shape = shape;
+  object->slots = shape->count != 0 ? object_allocSlots(object, numSlots) : NULL;
+  object->numSlots = shape->count != 0 ? numSlots : 0;
   return object;
 }
 
 void object_destroy(object_t *object) {
-  free(object->members);
-  free(object);
+  heap_t *heap = object->heap;
+
+  object_freeSlots(object);
+  heap_freeBlock(heap, object->members, object_tableBytes(object->tableSize));
+  heap_freeBlock(heap, object, OBJECT_BLOCK_SIZE);
+}
+
+object_t *object_relocate(object_t *object) {
+  heap_t *heap = object->heap;
+
+  bool inlined = object_slotsInline(object);
+
+  // inline slots move with it
+  object = (object_t*)heap_relocateBlock(heap, object, OBJECT_BLOCK_SIZE);
+  object->slots = inlined ? (value_t*)(object + 1)
+    : (value_t*)heap_relocateBlock(heap, object->slots, object->numSlots * sizeof(value_t));
+  object->members = (object_member_t*)heap_relocateBlock(heap, object->members,
+    object_tableBytes(object->tableSize));
+
+  return object;
+}
+
+void object_mark(object_t *object, heap_t *heap) {
+  if (object->shape != NULL) {
+    for (uint32_t i = 0; i < object->shape->count; i++) {
+      heap_mark(heap, &object->slots[i]);
+    }
+
+    return;
+  }
+
+  for (size_t i = 0; i < object->numMembers; i++) {
+    if (object->members[i].used) {
+      heap_mark(heap, &object->members[i].value);
+    }
+  }
 }
 
 void object_destructor(runtime_t *rt, args_t *args) {
@@ -37,47 +148,116 @@ void object_destructor(runtime_t *rt, args_t *args) {
   object_destroy(object);
 }
 
+// moves the members of a shaped object into a hash table
+static void object_toTable(object_t *object) {
+  shape_t *shape = object->shape;
+  value_t *slots = object->slots;
+  object_key_t keys[SHAPE_MAX_MEMBERS];
+
+  // room for the member being added, or as many as were expected
+  object->tableSize = object_tableSizeFor(shape->count + 1 > object->capacity ? shape->count + 1 : object->capacity);
+  object->members = object_allocMembers(object->heap, object->tableSize);
+  object->size = 0;
+  object->numMembers = 0;
+  object->shape = NULL;
+
+  // in slot order, the order they were set in
+  for (const shape_t *s = shape; s->parent != NULL; s = s->parent) {
+    keys[s->slot] = s->key;
+  }
+
+  for (uint32_t i = 0; i < shape->count; i++) {
+    object_put(object, keys[i], &slots[i]);
+  }
+
+  object_freeSlots(object);
+  object->slots = NULL;
+  object->numSlots = 0;
+}
+
+void object_addSlot(object_t *object, shape_t *next, value_t *value) {
+  if (next->slot >= object->numSlots) {
+    uint32_t numSlots = object->numSlots ? object->numSlots * 2 : OBJECT_INITIAL_SLOTS;
+    value_t *slots = object_allocSlots(object, numSlots);
+
+    if (object->numSlots != 0) {
+      memcpy(slots, object->slots, object->numSlots * sizeof(value_t));
+      object_freeSlots(object);
+    }
+
+    object->slots = slots;
+    object->numSlots = numSlots;
+  }
+
+  object->slots[next->slot] = *value;
+  object->shape = next;
+}
+
+// the shape `object` gets by adding `key`, created if no object had it yet
+static shape_t *object_nextShape(object_t *object, object_key_t key) {
+  shape_t *next = shape_findChild(object->shape, key);
+
+  if (next == NULL) {
+    heap_lock(object->heap);
+
+    // another thread may have added it in the meantime
+    if ((next = shape_findChild(object->shape, key)) == NULL) {
+      next = shape_addChild(object->shape, key);
+    }
+
+    heap_unlock(object->heap);
+  }
+
+  return next;
+}
+
 uint32_t object_hashInt(object_t *object, object_key_t key) {
   return hash6432shift((uint64_t)key) % object->tableSize;
 }
 
+// the index position of `key`, or the first empty one in its chain to put
+// it at; OBJECT_FULL if there is neither, or no room left in `members`
 int object_hash(object_t *object, object_key_t key) {
-  int curr, i;
+  int32_t *index = object_index(object);
+  int curr, i, empty = OBJECT_FULL;
 
-  if (object->size >= (object->tableSize / 2)) {
+  if (object->numMembers >= object->tableSize / 2) {
     return OBJECT_FULL;
   }
 
   curr = object_hashInt(object, key);
 
   for (i = 0; i < OBJECT_MAX_CHAIN_LENGTH; i++) {
-    if (!object->members[curr].used) {
-      return curr;
-    }
-
-    if (object->members[curr].used && object->members[curr].key == key) {
+    if (index[curr] == OBJECT_EMPTY) {
+      if (empty == OBJECT_FULL) {
+        empty = curr;
+      }
+    } else if (object->members[index[curr]].key == key) {
       return curr;
     }
 
     curr = (curr + 1) % object->tableSize;
   }
 
-  return OBJECT_FULL;
+  return empty;
 }
 
+// a new table, with the members in the order they were put and without the
+// holes: of the same size when those make up most of it, else twice that
 int object_rehash(object_t *object) {
-  int i, oldSize;
-  object_member_t *curr, *tmp;
+  object_member_t *curr = object->members;
+  size_t oldSize = object->tableSize;
+  size_t numMembers = object->numMembers;
 
-  tmp = (object_member_t*)calloc(2 * object->tableSize, sizeof(object_member_t));
-  curr = object->members;
-  object->members = tmp;
+  if (numMembers < oldSize / 2 || object->size >= oldSize / 4) {
+    object->tableSize *= 2;
+  }
 
-  oldSize = object->tableSize;
-  object->tableSize *= 2;
+  object->members = object_allocMembers(object->heap, object->tableSize);
   object->size = 0;
+  object->numMembers = 0;
 
-  for (i = 0; i < oldSize; i++) {
+  for (size_t i = 0; i < numMembers; i++) {
     int status;
 
     if (!curr[i].used) {
@@ -91,12 +271,28 @@ int object_rehash(object_t *object) {
     }
   }
 
-  free(curr);
+  heap_freeBlock(object->heap, curr, object_tableBytes(oldSize));
 
   return OBJECT_OK;
 }
 
 int object_put(object_t *object, object_key_t key, value_t *value) {
+  if (object->shape != NULL) {
+    int32_t slot = shape_lookup(object->shape, key);
+
+    if (slot >= 0) {
+      object->slots[slot] = *value;
+      return OBJECT_OK;
+    }
+
+    if (object->shape->count < SHAPE_MAX_MEMBERS) {
+      object_addSlot(object, object_nextShape(object, key), value);
+      return OBJECT_OK;
+    }
+
+    object_toTable(object);
+  }
+
   int index = object_hash(object, key);
 
   while (index == OBJECT_FULL) {
@@ -107,26 +303,42 @@ int object_put(object_t *object, object_key_t key, value_t *value) {
     index = object_hash(object, key);
   }
 
-  object->members[index].key = key;
-  object->members[index].value = *value; // TODO: use value_copyValue maybe?
-  object->members[index].used = true;
+  int32_t *slot = &object_index(object)[index];
+
+  if (*slot != OBJECT_EMPTY) {
+    object->members[*slot].value = *value;
+    return OBJECT_OK;
+  }
+
+  *slot = (int32_t)object->numMembers++;
+  object->members[*slot].key = key;
+  object->members[*slot].value = *value; // TODO: use value_copyValue maybe?
+  object->members[*slot].used = true;
   object->size++;
 
   return OBJECT_OK;
 }
 
 int object_getPtr(object_t *object, object_key_t key, value_t **out) {
+  int32_t *index;
   int curr, i;
 
+  if (object->shape != NULL) {
+    int32_t slot = shape_lookup(object->shape, key);
+
+    *out = slot >= 0 ? &object->slots[slot] : NULL;
+
+    return slot >= 0 ? OBJECT_OK : OBJECT_MISSING;
+  }
+
+  index = object_index(object);
   curr = object_hashInt(object, key);
 
   for (i = 0; i < OBJECT_MAX_CHAIN_LENGTH; i++) {
-    if (object->members[curr].used) {
-      if (object->members[curr].key == key) {
-        *out = &object->members[curr].value;
+    if (index[curr] != OBJECT_EMPTY && object->members[index[curr]].key == key) {
+      *out = &object->members[index[curr]].value;
 
-        return OBJECT_OK;
-      }
+      return OBJECT_OK;
     }
 
     curr = (curr + 1) % object->tableSize;
@@ -149,18 +361,29 @@ int object_get(object_t *object, object_key_t key, value_t *out) {
 }
 
 int object_remove(object_t *object, object_key_t key) {
+  int32_t *index;
   int curr, i;
 
+  if (object->shape != NULL) {
+    if (shape_lookup(object->shape, key) < 0) {
+      return OBJECT_MISSING;
+    }
+
+    // shapes only ever add members
+    object_toTable(object);
+  }
+
+  index = object_index(object);
   curr = object_hashInt(object, key);
 
   for (i = 0; i < OBJECT_MAX_CHAIN_LENGTH; i++) {
-    if (object->members[curr].used) {
-      if (object->members[curr].key == key) {
-        memset(&object->members[curr], 0, sizeof(object_member_t));
-        --object->size;
+    if (index[curr] != OBJECT_EMPTY && object->members[index[curr]].key == key) {
+      // a hole, until the next rehash
+      memset(&object->members[index[curr]], 0, sizeof(object_member_t));
+      index[curr] = OBJECT_EMPTY;
+      --object->size;
 
-        return OBJECT_OK;
-      }
+      return OBJECT_OK;
     }
 
     curr = (curr + 1) % object->tableSize;
@@ -168,3 +391,102 @@ int object_remove(object_t *object, object_key_t key) {
 
   return OBJECT_MISSING;
 }
+
+void object_entries(object_t *object, object_key_t *keys, value_t *values) {
+  size_t n = 0;
+
+  if (object->shape != NULL) {
+    for (const shape_t *s = object->shape; keys != NULL && s->parent != NULL; s = s->parent) {
+      keys[s->slot] = s->key;
+    }
+
+    if (values != NULL && object->shape->count != 0) {
+      memcpy(values, object->slots, object->shape->count * sizeof(value_t));
+    }
+
+    return;
+  }
+
+  for (size_t i = 0; i < object->numMembers; i++) {
+    if (!object->members[i].used) {
+      continue;
+    }
+
+    if (keys != NULL) {
+      keys[n] = object->members[i].key;
+    }
+
+    if (values != NULL) {
+      values[n] = object->members[i].value;
+    }
+
+    n++;
+  }
+}
+
+object_t *object_clone(heap_t *heap, object_t *object) {
+  object_t *clone;
+
+  if (object->shape != NULL && heap == object->heap) {
+    clone = object_createShaped(heap, object->shape);
+
+    if (object->shape->count != 0) {
+      memcpy(clone->slots, object->slots, object->shape->count * sizeof(value_t));
+    }
+
+    return clone;
+  }
+
+  if (object->shape != NULL) {
+    // the shape is of another heap's tree: this one's is found by putting
+    clone = object_createWithCapacity(heap, object->shape->count);
+    object_assign(clone, object);
+    return clone;
+  }
+
+  clone = object_create(heap);
+  clone->shape = NULL;
+  clone->tableSize = object->tableSize;
+  clone->size = object->size;
+  clone->numMembers = object->numMembers;
+  clone->capacity = object->capacity;
+  clone->members = (object_member_t*)heap_allocBlock(heap, object_tableBytes(object->tableSize));
+  memcpy(clone->members, object->members, object_tableBytes(object->tableSize));
+
+  return clone;
+}
+
+int object_assign(object_t *object, object_t *src) {
+  object_key_t keys[SHAPE_MAX_MEMBERS];
+  int status = OBJECT_OK;
+
+  if (object == src) {
+    return OBJECT_OK;
+  }
+
+  if (src->shape != NULL && object->shape == src->shape) {
+    if (src->shape->count != 0) {
+      memcpy(object->slots, src->slots, src->shape->count * sizeof(value_t));
+    }
+
+    return OBJECT_OK;
+  }
+
+  if (src->shape != NULL) {
+    object_entries(src, keys, NULL);
+
+    for (uint32_t i = 0; status == OBJECT_OK && i < src->shape->count; i++) {
+      status = object_put(object, keys[i], &src->slots[i]);
+    }
+
+    return status;
+  }
+
+  for (size_t i = 0; status == OBJECT_OK && i < src->numMembers; i++) {
+    if (src->members[i].used) {
+      status = object_put(object, src->members[i].key, &src->members[i].value);
+    }
+  }
+
+  return status;
+}
@@ -0,0 +1,248 @@
+#include <vm/output.h>
+#include <vm/value.h>
+#include <vm/array.h>
+#include <vm/heap.h>
+#include <vm/scan.h>
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+  #include <unistd.h>
+  #define OUTPUT_ISATTY(fp) isatty(fileno(fp))
+#else
+  #define OUTPUT_ISATTY(fp) 0
+#endif
+
+// every live output, flushed by output_flushAll when the process exits --
+// OP_HALT and the C exit builtin end it without unwinding to main
+static pthread_mutex_t output_listLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t output_atexitOnce = PTHREAD_ONCE_INIT;
+static output_t *output_list = NULL;
+
+static void output_flushAll() {
+  pthread_mutex_lock(&output_listLock);
+
+  for (output_t *out = output_list; out != NULL; out = out->next) {
+    output_flush(out);
+  }
+
+  pthread_mutex_unlock(&output_listLock);
+}
+
+static void output_registerAtexit() {
+  atexit(output_flushAll);
+}
+
+void output_init(output_t *out, FILE *fp) {
+  out->fp = fp;
+  out->mode = OUTPUT_ISATTY(fp) ? OUTPUT_MODE_LINE : OUTPUT_MODE_BLOCK;
+  out->buf = (char*)malloc(OUTPUT_BUFFER_SIZE);
+  out->len = 0;
+
+  pthread_once(&output_atexitOnce, output_registerAtexit);
+
+  pthread_mutex_lock(&output_listLock);
+  out->next = output_list;
+  output_list = out;
+  pthread_mutex_unlock(&output_listLock);
+}
+
+void output_destroy(output_t *out) {
+  output_flush(out);
+
+  pthread_mutex_lock(&output_listLock);
+
+  for (output_t **link = &output_list; *link != NULL; link = &(*link)->next) {
+    if (*link == out) {
+      *link = out->next;
+      break;
+    }
+  }
+
+  pthread_mutex_unlock(&output_listLock);
+
+  free(out->buf);
+  out->buf = NULL;
+}
+
+void output_flush(output_t *out) {
+  if (out->len != 0) {
+    fwrite(out->buf, 1, out->len, out->fp);
+    out->len = 0;
+  }
+
+  fflush(out->fp);
+}
+
+void output_write(output_t *out, const char *str, size_t len) {
+  if (len > OUTPUT_BUFFER_SIZE - out->len) {
+    output_flush(out);
+
+    if (len > OUTPUT_BUFFER_SIZE) {
+      fwrite(str, 1, len, out->fp);
+      return;
+    }
+  }
+
+  memcpy(out->buf + out->len, str, len);
+  out->len += len;
+}
+
+// the decimal digits of `u64`, written backwards from `end`
+static char *output_digits(char *end, uint64_t u64) {
+  do {
+    *--end = (char)('0' + u64 % 10);
+    u64 /= 10;
+  } while (u64 != 0);
+
+  return end;
+}
+
+size_t output_formatUint(char *buf, uint64_t u64) {
+  char digits[20];
+  char *end = digits + sizeof(digits);
+  char *start = output_digits(end, u64);
+
+  memcpy(buf, start, (size_t)(end - start));
+
+  return (size_t)(end - start);
+}
+
+size_t output_formatInt(char *buf, int64_t i64) {
+  if (i64 < 0) {
+    *buf = '-';
+    // negated as unsigned, so INT64_MIN does not overflow
+    return 1 + output_formatUint(buf + 1, 0 - (uint64_t)i64);
+  }
+
+  return output_formatUint(buf, (uint64_t)i64);
+}
+
+size_t output_formatDouble(char *buf, double dbl) {
+  size_t sign = 0;
+  double back;
+  int len;
+
+  if (isnan(dbl)) {
+    memcpy(buf, "nan", 3);
+    return 3;
+  }
+
+  if (signbit(dbl)) {
+    *buf++ = '-';
+    sign = 1;
+    dbl = -dbl;
+  }
+
+  if (isinf(dbl)) {
+    memcpy(buf, "inf", 3);
+    return sign + 3;
+  }
+
+  // the common case, and exact: below 2^53 every integral double is
+  // an integer the uint formatting reproduces
+  if (dbl < 9007199254740992.0 && dbl == (double)(uint64_t)dbl) {
+    return sign + output_formatUint(buf, (uint64_t)dbl);
+  }
+
+  // otherwise the fewest significant digits that read back the same. a
+  // normal double holds any 15 digits (DBL_DIG), so if there are at most
+  // 15 the %g rounding to 15 is those, with the zeros after them dropped;
+  // 16 or 17 digits are only tried after that. subnormals hold fewer.
+  for (int precision = dbl < DBL_MIN ? 1 : DBL_DIG; ; precision++) {
+    len = snprintf(buf, OUTPUT_NUMBER_MAX - sign, "%.*g", precision, dbl);
+
+    if (precision == 17 || (scan_parseDouble((const uint8_t*)buf, (size_t)len, &back) && back == dbl)) {
+      break;
+    }
+  }
+
+  return sign + (size_t)len;
+}
+
+size_t output_formatScalar(char *buf, value_t *v) {
+  switch (value_getType(v)) {
+    case TYPE_NONE:
+      memcpy(buf, "none", 4);
+      return 4;
+    case TYPE_INT:
+      return output_formatInt(buf, value_getInt(v));
+    case TYPE_UINT:
+      return output_formatUint(buf, value_getUint(v));
+    case TYPE_DOUBLE:
+      return output_formatDouble(buf, value_getDouble(v));
+    case TYPE_BOOLEAN:
+      if (value_getBoolean(v)) {
+        memcpy(buf, "true", 4);
+        return 4;
+      }
+
+      memcpy(buf, "false", 5);
+      return 5;
+    default:
+      return 0;
+  }
+}
+
+void output_writeUint(output_t *out, uint64_t u64) {
+  char buf[OUTPUT_NUMBER_MAX];
+
+  output_write(out, buf, output_formatUint(buf, u64));
+}
+
+void output_writeInt(output_t *out, int64_t i64) {
+  char buf[OUTPUT_NUMBER_MAX];
+
+  output_write(out, buf, output_formatInt(buf, i64));
+}
+
+void output_writeDouble(output_t *out, double dbl) {
+  char buf[OUTPUT_NUMBER_MAX];
+
+  output_write(out, buf, output_formatDouble(buf, dbl));
+}
+
+void output_writePointer(output_t *out, const void *ptr) {
+  static const char hex[] = "0123456789abcdef";
+  char digits[2 + sizeof(uintptr_t) * 2];
+  char *end = digits + sizeof(digits);
+  char *start = end;
+  uintptr_t bits = (uintptr_t)ptr;
+
+  if (ptr == NULL) {
+    output_write(out, "null", 4);
+    return;
+  }
+
+  do {
+    *--start = hex[bits & 0xF];
+    bits >>= 4;
+  } while (bits != 0);
+
+  *--start = 'x';
+  *--start = '0';
+
+  output_write(out, start, (size_t)(end - start));
+}
+
+void output_writeValue(output_t *out, value_t *v) {
+  char buf[OUTPUT_NUMBER_MAX];
+  size_t len;
+
+  if ((len = output_formatScalar(buf, v)) != 0) {
+    output_write(out, buf, len);
+  } else if (VALUE_IS(v, TYPE_POINTER, FLAG_OBJECT | FLAG_ARRAY) && ((array_t*)v->data.hv->ptr)->kind == ARRAY_BYTES) {
+    // a string builder's text, see strBuilder
+    output_write(out, (const char*)((array_t*)v->data.hv->ptr)->data, ((array_t*)v->data.hv->ptr)->size);
+  } else {
+    output_writePointer(out, value_getRawPointer(v));
+  }
+
+  if (out->mode == OUTPUT_MODE_LINE) {
+    output_flush(out);
+  }
+}
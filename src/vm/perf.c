@@ -0,0 +1,167 @@
+#include <vm/perf.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__linux__)
+  #include <unistd.h>
+  #include <errno.h>
+  #include <sys/ioctl.h>
+  #include <sys/syscall.h>
+  #include <linux/perf_event.h>
+  #define PERF_SUPPORTED 1
+#else
+  #define PERF_SUPPORTED 0
+#endif
+
+static const char *const perf_names[PERF_COUNTERS] = {
+  [PERF_CYCLES] = "cycles",
+  [PERF_INSTRUCTIONS] = "instructions",
+  [PERF_BRANCH_MISSES] = "branch-misses",
+  [PERF_L1D_MISSES] = "L1d-load-misses",
+  [PERF_LLC_MISSES] = "LLC-misses"
+};
+
+#if PERF_SUPPORTED
+static int perf_openCounter(uint32_t type, uint64_t config) {
+  struct perf_event_attr attr;
+
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+  return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+perf_t *perf_open(void) {
+  perf_t *perf = (perf_t*)calloc(1, sizeof(perf_t));
+  int opened = 0, error = 0;
+
+  perf->fds[PERF_CYCLES] = perf_openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+  perf->fds[PERF_INSTRUCTIONS] = perf_openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+  perf->fds[PERF_BRANCH_MISSES] = perf_openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+  perf->fds[PERF_L1D_MISSES] = perf_openCounter(PERF_TYPE_HW_CACHE,
+    PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+  perf->fds[PERF_LLC_MISSES] = perf_openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+
+  for (int i = 0; i < PERF_COUNTERS; i++) {
+    if (perf->fds[i] >= 0) {
+      opened++;
+    } else if (error == 0) {
+      error = errno;
+    }
+  }
+
+  if (opened == 0) {
+    fprintf(stderr, "perf counters unavailable: %s%s\n", strerror(error),
+      error == EACCES || error == EPERM ? " (see /proc/sys/kernel/perf_event_paranoid)"
+        : error == ENOENT || error == ENODEV ? " (no hardware counters, e.g. in a virtual machine)" : "");
+    free(perf);
+    return NULL;
+  }
+
+  return perf;
+}
+
+void perf_close(perf_t *perf) {
+  if (perf == NULL) {
+    return;
+  }
+
+  for (int i = 0; i < PERF_COUNTERS; i++) {
+    if (perf->fds[i] >= 0) {
+      close(perf->fds[i]);
+    }
+  }
+
+  free(perf);
+}
+
+void perf_start(perf_t *perf) {
+  for (int i = 0; i < PERF_COUNTERS; i++) {
+    if (perf->fds[i] >= 0) {
+      ioctl(perf->fds[i], PERF_EVENT_IOC_RESET, 0);
+      ioctl(perf->fds[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+}
+
+void perf_stop(perf_t *perf) {
+  for (int i = 0; i < PERF_COUNTERS; i++) {
+    uint64_t values[3]; // the count, the time enabled and the time running
+
+    if (perf->fds[i] < 0) {
+      continue;
+    }
+
+    ioctl(perf->fds[i], PERF_EVENT_IOC_DISABLE, 0);
+
+    if (read(perf->fds[i], values, sizeof(values)) != (ssize_t)sizeof(values)) {
+      continue;
+    }
+
+    if (values[2] != 0 && values[2] < values[1]) {
+      values[0] = (uint64_t)((double)values[0] * ((double)values[1] / (double)values[2]));
+    }
+
+    perf->counts[i] += values[0];
+  }
+}
+#else
+perf_t *perf_open(void) {
+  fprintf(stderr, "perf counters are not supported on this platform\n");
+  return NULL;
+}
+
+void perf_close(perf_t *perf) {
+  (void)perf;
+}
+
+void perf_start(perf_t *perf) {
+  (void)perf;
+}
+
+void perf_stop(perf_t *perf) {
+  (void)perf;
+}
+#endif
+
+void perf_write(const perf_t *perf, FILE *f, uint64_t bytecodes) {
+  const uint64_t instructions = perf->fds[PERF_INSTRUCTIONS] >= 0 ? perf->counts[PERF_INSTRUCTIONS] : 0;
+
+  fprintf(f, "%-18s %16s %14s%s\n", "counter", "count", "per 1k instr", bytecodes != 0 ? "   per bytecode" : "");
+
+  for (int i = 0; i < PERF_COUNTERS; i++) {
+    if (perf->fds[i] < 0) {
+      fprintf(f, "%-18s %16s\n", perf_names[i], "n/a");
+      continue;
+    }
+
+    fprintf(f, "%-18s %16llu", perf_names[i], (unsigned long long)perf->counts[i]);
+
+    if (instructions != 0 && i != PERF_INSTRUCTIONS && i != PERF_CYCLES) {
+      fprintf(f, " %14.3f", (double)perf->counts[i] * 1000.0 / (double)instructions);
+    } else {
+      fprintf(f, " %14s", "");
+    }
+
+    if (bytecodes != 0) {
+      fprintf(f, " %15.3f", (double)perf->counts[i] / (double)bytecodes);
+    }
+
+    fprintf(f, "\n");
+  }
+
+  if (instructions != 0 && perf->fds[PERF_CYCLES] >= 0 && perf->counts[PERF_CYCLES] != 0) {
+    fprintf(f, "IPC %.3f\n", (double)instructions / (double)perf->counts[PERF_CYCLES]);
+  }
+
+  if (bytecodes != 0) {
+    fprintf(f, "bytecode instructions %llu\n", (unsigned long long)bytecodes);
+  }
+}
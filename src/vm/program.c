@@ -0,0 +1,254 @@
+#include <vm/program.h>
+#include <vm/runtime.h>
+#include <vm/interpreter.h>
+#include <vm/extension.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// the error of a program_create that failed on this thread, naming what it failed on
+static _Thread_local char program_error[256];
+
+// the size of the next BIN_SECTION_CONST entry at `*pc`, moving `*pc` to
+// its bytes. false at the end of the section, or on an entry that runs
+// past it -- with BIN_CONST_IN_PLACE, counting its NUL, which must be one.
+static bool program_nextConst(const image_t *image, size_t *pc, uint64_t *size) {
+  bin_const_t entry;
+
+  if (!image->constantsInPlace) {
+    if (image->constantsLen - *pc < sizeof(*size)) {
+      return false;
+    }
+
+    memcpy(size, image->constants + *pc, sizeof(*size));
+    *pc += sizeof(*size);
+
+    return *size <= image->constantsLen - *pc;
+  }
+
+  if (image->constantsLen - *pc < sizeof(entry)) {
+    return false;
+  }
+
+  memcpy(&entry, image->constants + *pc, sizeof(entry));
+  *pc += sizeof(entry);
+
+  if (entry.padding > image->constantsLen - *pc) {
+    return false;
+  }
+
+  *pc += entry.padding;
+  *size = entry.size;
+
+  return entry.size < image->constantsLen - *pc && image->constants[*pc + entry.size] == '\0';
+}
+
+static void program_addConstants(program_t *program) {
+  const image_t *image = &program->image;
+  const bool inPlace = image->constantsInPlace;
+  size_t pc = 0, poolOffset = 0;
+  uint64_t size;
+
+  // first pass: count them, so the pool is allocated once
+  while (program_nextConst(image, &pc, &size)) {
+    program->poolSize += size + 1;
+    program->numConstants++;
+    pc += inPlace ? size + 1 : size;
+  }
+
+  // entries laid out in place are their own pool, NUL and all: nothing is
+  // copied, and the pages of those the program never reads are never read
+  // from the file. the pool is then the whole section, so that
+  // code_poolOffset has the same offsets for them in every process.
+  if (inPlace) {
+    program->pool = (ubyte_t*)image->constants;
+    program->poolSize = image->constantsLen;
+  } else {
+    program->pool = (ubyte_t*)malloc(program->poolSize != 0 ? program->poolSize : 1);
+  }
+
+  program->constants = (code_const_t*)malloc(sizeof(code_const_t) * (program->numConstants != 0 ? program->numConstants : 1));
+  pc = 0;
+
+  for (uint32_t i = 0; i < program->numConstants && program_nextConst(image, &pc, &size); i++) {
+    ubyte_t *data = inPlace ? program->pool + pc : program->pool + poolOffset;
+
+    if (!inPlace) {
+      memcpy(data, image->constants + pc, size);
+      data[size] = '\0';
+    }
+
+    program->constants[i].data = data;
+    program->constants[i].size = size;
+
+    pc += inPlace ? size + 1 : size;
+    poolOffset += size + 1;
+  }
+}
+
+// the value a load with the flags and immediate of `entry` stores, as
+// OP_LOAD does. false for a pool index out of range.
+static bool program_staticValue(const program_t *program, bin_data_t entry, value_t *out) {
+  switch (entry.type) {
+    case CONST_FLAGS_NULL:
+      *out = value_fromRawPointer(NULL, FLAG_NONE);
+      return true;
+    case CONST_FLAGS_I64:
+      *out = value_fromInt((int64_t)entry.data);
+      return true;
+    case CONST_FLAGS_U64:
+      *out = value_fromUint(entry.data);
+      return true;
+    case CONST_FLAGS_F64: {
+      double dbl;
+
+      memcpy(&dbl, &entry.data, sizeof(dbl));
+      *out = value_fromDouble(dbl);
+      return true;
+    }
+    case CONST_FLAGS_BOOL:
+      *out = value_fromBoolean(entry.data != 0);
+      return true;
+    case CONST_FLAGS_POOL:
+      if (entry.data >= program->numConstants) {
+        return false;
+      }
+
+      *out = value_fromRawPointer((void*)program->constants[entry.data].data, FLAG_CONST);
+      return true;
+    default:
+      out->data.i64 = 0;
+      VALUE_SET_META(out, TYPE_NONE, FLAG_NONE);
+      return true;
+  }
+}
+
+// the number of entries of BIN_SECTION_IMPORTS
+static size_t program_countImports(const image_t *image) {
+  const char *module, *name, *signature;
+  bin_import_t entry;
+  size_t pos = 0, count = 0;
+
+  while (image_import(image, &pos, &entry, &module, &name, &signature)) {
+    count++;
+  }
+
+  return count;
+}
+
+// the functions of extension modules the program imports, after the
+// static data. false, with `*error` set, for one that no loaded module
+// has, or has with another signature.
+static bool program_addImports(program_t *program, const char **error) {
+  const image_t *image = &program->image;
+  const char *module, *name, *signature, *loaded;
+  bin_import_t entry;
+  size_t pos = 0;
+
+  while (image_import(image, &pos, &entry, &module, &name, &signature)) {
+    native_function_t fn = extension_find(module, entry.moduleLength, name, entry.nameLength, &loaded);
+    program_static_t *s;
+
+    if (fn == NULL || strlen(loaded) != entry.signatureLength || memcmp(loaded, signature, entry.signatureLength) != 0) {
+      snprintf(program_error, sizeof(program_error), "%s import %.*s.%.*s%s%.*s",
+        fn == NULL ? "unresolved" : "mismatched signature of",
+        (int)entry.moduleLength, module, (int)entry.nameLength, name,
+        fn == NULL ? "" : ", compiled for ", fn == NULL ? 0 : (int)entry.signatureLength, signature);
+      *error = program_error;
+      return false;
+    }
+
+    s = &program->statics[program->numStatics++];
+    s->slot = entry.slot;
+    s->value = value_fromFunction(fn);
+  }
+
+  return true;
+}
+
+static void program_addStatics(program_t *program) {
+  const image_t *image = &program->image;
+
+  program->statics = (program_static_t*)malloc(sizeof(program_static_t)
+    * (image->numData + image->numLabels + program_countImports(image) + 1));
+
+  for (size_t i = 0; i < image->numData; i++) {
+    bin_data_t entry = image_data(image, i);
+    program_static_t *s = &program->statics[program->numStatics];
+
+    if (program_staticValue(program, entry, &s->value)) {
+      s->slot = entry.slot;
+      program->numStatics++;
+    }
+  }
+
+  program->labels = (bin_label_t*)malloc(sizeof(bin_label_t) * (image->numLabels != 0 ? image->numLabels : 1));
+  program->numLabels = image->numLabels;
+
+  for (size_t i = 0; i < image->numLabels; i++) {
+    bin_label_t entry = image_label(image, i);
+    program_static_t *s = &program->statics[program->numStatics++];
+
+    program->labels[i] = entry;
+    s->slot = entry.slot;
+    s->value = value_fromUint(entry.offset);
+  }
+}
+
+program_t *program_create(const ubyte_t *file, size_t len, const char **error) {
+  program_t *program = (program_t*)calloc(1, sizeof(program_t));
+
+  if (!image_open(file, len, &program->image, error)) {
+    free(program);
+    return NULL;
+  }
+
+  atomic_init(&program->refs, 1);
+
+  program_addConstants(program);
+  program_addStatics(program);
+
+  if (!program_addImports(program, error)) {
+    program_release(program);
+    return NULL;
+  }
+
+  return program;
+}
+
+program_t *program_retain(program_t *program) {
+  atomic_fetch_add_explicit(&program->refs, 1, memory_order_relaxed);
+
+  return program;
+}
+
+void program_release(program_t *program) {
+  // the last reference sees every write made through the others
+  if (atomic_fetch_sub_explicit(&program->refs, 1, memory_order_acq_rel) != 1) {
+    return;
+  }
+
+  free(program->statics);
+  free(program->labels);
+  free(program->constants);
+
+  if (!program->image.constantsInPlace) {
+    free(program->pool);
+  }
+  image_close(&program->image);
+  free(program);
+}
+
+void program_load(const program_t *program, runtime_t *rt) {
+  storage_t *s = &rt->dt->storage[AT_DATA];
+
+  for (size_t i = 0; i < program->numStatics; i++) {
+    const program_static_t *entry = &program->statics[i];
+
+    if (entry->slot < s->count) {
+      value_release(rt, &s->data[entry->slot]);
+      s->data[entry->slot] = entry->value;
+    }
+  }
+}
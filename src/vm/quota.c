@@ -0,0 +1,42 @@
+#include <vm/quota.h>
+
+#include <pthread.h>
+
+quota_t quotas[QUOTA_MAX];
+
+static pthread_mutex_t quota_lock = PTHREAD_MUTEX_INITIALIZER;
+
+quota_t *quota_acquire() {
+  quota_t *q = NULL;
+
+  pthread_mutex_lock(&quota_lock);
+
+  for (size_t i = 1; i < QUOTA_MAX; i++) {
+    if (!quotas[i].live && quota_used(&quotas[i]) == 0) {
+      q = &quotas[i];
+      break;
+    }
+  }
+
+  if (q != NULL) {
+    q->live = true;
+    q->soft = 0;
+    q->hard = 0;
+    atomic_store(&q->pressed, false);
+    atomic_store(&q->exceeded, false);
+  }
+
+  pthread_mutex_unlock(&quota_lock);
+
+  return q;
+}
+
+void quota_release(quota_t *q) {
+  if (q == NULL) {
+    return;
+  }
+
+  pthread_mutex_lock(&quota_lock);
+  q->live = false;
+  pthread_mutex_unlock(&quota_lock);
+}
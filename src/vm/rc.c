@@ -1,149 +1,48 @@
 #include <vm/rc.h>
-#include <vm/util.h>
+#include <vm/events.h>
 
-rcmap_t *rcmap_create() {
-  rcmap_t *map = (rcmap_t*)malloc(sizeof(rcmap_t));
-  map->data = (rcentry_t*)calloc(RC_INITIAL_SIZE, sizeof(rcentry_t));
-  map->tableSize = RC_INITIAL_SIZE;
-  map->size = 0;
-  return map;
-}
-
-void rcmap_destroy(rcmap_t *map) {
-  free(map->data);
-  free(map);
-}
-
-uint32_t rcmap_hashInt(rcmap_t *map, rcmap_key_t key) {
-  return hash6432shift((uint64_t)key) % map->tableSize;
-}
-
-int rcmap_hash(rcmap_t *map, rcmap_key_t key) {
-  int curr, i;
-
-  if (map->size >= (map->tableSize / 2)) {
-    return RC_MAP_FULL;
-  }
-
-  curr = rcmap_hashInt(map, key);
-
-  for (i = 0; i < RC_MAX_CHAIN_LENGTH; i++) {
-    if (!map->data[curr].used) {
-      return curr;
-    }
-
-    if (map->data[curr].used && map->data[curr].key == key) {
-      return curr;
-    }
-
-    curr = (curr + 1) % map->tableSize;
-  }
-
-  return RC_MAP_FULL;
-}
-
-int rcmap_rehash(rcmap_t *map) {
-  int i, oldSize;
-  rcentry_t *curr, *tmp;
-
-  tmp = (rcentry_t*)calloc(2 * map->tableSize, sizeof(rcentry_t));
-  curr = map->data;
-  map->data = tmp;
-
-  oldSize = map->tableSize;
-  map->tableSize *= 2;
-  map->size = 0;
+#include <stdatomic.h>
 
-  for (i = 0; i < oldSize; i++) {
-    int status;
+static atomic_size_t rc_numAllocated;
 
-    if (!curr[i].used) {
-      continue;
-    }
+// with the header charged already
+static refcounted_t rc_make(quota_t *quota, size_t size, uint32_t site) {
+  rc_header_t *header = (rc_header_t*)malloc(sizeof(rc_header_t) + size);
 
-    status = rcmap_put(map, curr[i].key, curr[i].count);
-
-    if (status != RC_MAP_OK) {
-      return status;
-    }
+  if (header == NULL) {
+    quota_credit(quota, sizeof(rc_header_t) + size);
+    return NULL;
   }
 
-  free(curr);
-
-  return RC_MAP_OK;
-}
+  header->count = 0;
+  header->site = site;
+  header->size = size;
+  header->quota = quota_id(quota);
+  header->shared = 0;
 
-int rcmap_put(rcmap_t *map, rcmap_key_t key, size_t count) {
-  int index = rcmap_hash(map, key);
+  atomic_fetch_add_explicit(&rc_numAllocated, 1, memory_order_relaxed);
 
-  while (index == RC_MAP_FULL) {
-    if (rcmap_rehash(map) == RC_MAP_OMEM) {
-      return RC_MAP_OMEM;
-    }
-
-    index = rcmap_hash(map, key);
+  if (events_enabled) {
+    events_instant(EVENTS_RC_ALLOC, size);
   }
 
-  map->data[index].key = key;
-  map->data[index].count = count;
-  map->data[index].used = true;
-  map->size++;
-
-  return RC_MAP_OK;
+  return header + 1;
 }
 
-int rcmap_getPtr(rcmap_t *map, rcmap_key_t key, size_t **out) {
-  int curr, i;
-
-  curr = rcmap_hashInt(map, key);
-
-  for (i = 0; i < RC_MAX_CHAIN_LENGTH; i++) {
-    if (map->data[curr].used) {
-      if (map->data[curr].key == key) {
-        *out = &map->data[curr].count;
-
-        return RC_MAP_OK;
-      }
-    }
-
-    curr = (curr + 1) % map->tableSize;
+refcounted_t rc_alloc(quota_t *quota, size_t size, uint32_t site) {
+  if (!quota_charge(quota, sizeof(rc_header_t) + size)) {
+    return NULL;
   }
 
-  *out = NULL;
-
-  return RC_MAP_MISSING;
+  return rc_make(quota, size, site);
 }
 
-int rcmap_get(rcmap_t *map, rcmap_key_t key, size_t *out) {
-  size_t *ptr = NULL;
-  int result = rcmap_getPtr(map, key, &ptr);
-
-  if (result == RC_MAP_OK) {
-    *out = *ptr;
-  } else {
-    *out = 0;
-  }
+refcounted_t rc_allocOver(quota_t *quota, size_t size, uint32_t site) {
+  quota_force(quota, sizeof(rc_header_t) + size);
 
-  return result;
+  return rc_make(quota, size, site);
 }
 
-int rcmap_remove(rcmap_t *map, rcmap_key_t key) {
-  int curr, i;
-
-  curr = rcmap_hashInt(map, key);
-
-  for (i = 0; i < RC_MAX_CHAIN_LENGTH; i++) {
-    if (map->data[curr].used) {
-      if (map->data[curr].key == key) {
-        memset(&map->data[curr], 0, sizeof(rcentry_t));
-        --map->size;
-
-        return RC_MAP_OK;
-      }
-    }
-
-    curr = (curr + 1) % map->tableSize;
-  }
-
-  return RC_MAP_MISSING;
+size_t rc_allocated() {
+  return atomic_load_explicit(&rc_numAllocated, memory_order_relaxed);
 }
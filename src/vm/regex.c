@@ -0,0 +1,1258 @@
+#include <vm/regex.h>
+#include <vm/runtime.h>
+#include <vm/util.h>
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+// ===== the NFA =====
+
+typedef enum {
+  REGEX_CLASS = 0, // a byte of classes[x]
+  REGEX_SPLIT = 1, // on to x and to y
+  REGEX_JMP = 2, // on to x
+  REGEX_BOL = 3, // at the start of the text
+  REGEX_EOL = 4, // at its end
+  REGEX_MATCH = 5
+} REGEX_OP;
+
+typedef struct regex_inst {
+  uint32_t op;
+  uint32_t x;
+  uint32_t y;
+} regex_inst_t;
+
+typedef struct regex_class {
+  uint64_t bits[4];
+} regex_class_t;
+
+static inline bool regex_has(const regex_class_t *c, uint8_t b) {
+  return (c->bits[b >> 6] >> (b & 63)) & 1;
+}
+
+static inline void regex_add(regex_class_t *c, uint8_t b) {
+  c->bits[b >> 6] |= (uint64_t)1 << (b & 63);
+}
+
+static void regex_addRange(regex_class_t *c, uint8_t lo, uint8_t hi) {
+  for (uint32_t b = lo; b <= hi; b++) {
+    regex_add(c, (uint8_t)b);
+  }
+}
+
+// ===== the DFA =====
+
+#define REGEX_UNKNOWN (-1)
+// in a state's instructions, between those of threads that started at
+// different bytes, earliest first
+#define REGEX_MARK UINT32_MAX
+
+typedef struct regex_state {
+  uint32_t first; // its instructions: pcs[first, first + count)
+  uint32_t count; // 0 for the dead state
+  uint64_t hash;
+  bool matched; // a match was seen: no more threads are started
+  bool match; // a match ends before the next byte
+  bool matchAtEnd; // or would if the text ended here
+} regex_state_t;
+
+typedef struct regex_dfa {
+  const regex_inst_t *insts; // of the program it runs
+  bool unanchored; // a thread is started at each byte until there is a match
+  regex_state_t *states;
+  uint32_t numStates;
+  uint32_t capStates;
+  uint32_t *pcs;
+  size_t numPcs;
+  size_t capPcs;
+  int32_t *next; // a row of numByteClasses to a state: the state after a byte of each
+  int32_t *table; // the states by hash, 2 * REGEX_MAX_STATES of them, -1 for free
+  int32_t start[2]; // at the start of the text, and not; or REGEX_UNKNOWN
+  uint32_t flushes; // times the states were dropped, see regex_flush
+} regex_dfa_t;
+
+struct regexp {
+  const char *pattern;
+  pthread_mutex_t lock; // matching builds the DFAs and uses the scratch below
+
+  regex_inst_t *insts;
+  regex_inst_t *reversed; // the pattern backwards, ^ and $ swapped
+  uint32_t numInsts; // of each
+  regex_class_t *classes;
+  // bytes no class tells apart share a byte class, a column of the DFAs
+  uint8_t byteClass[256];
+  uint8_t representative[256]; // a byte of each byte class
+  uint32_t numByteClasses;
+
+  regex_dfa_t anchored;
+  regex_dfa_t unanchored;
+  regex_dfa_t backward; // anchored, of `reversed`
+
+  uint32_t *marks; // the instructions seen in this closure: == mark
+  uint32_t mark;
+  uint32_t *stack; // twice numInsts
+  uint32_t *set; // a state's instructions, with REGEX_MARKs: twice numInsts
+};
+
+// ===== parsing =====
+
+typedef enum {
+  REGEX_NODE_EMPTY = 0,
+  REGEX_NODE_CLASS = 1, // classes[a]
+  REGEX_NODE_BOL = 2,
+  REGEX_NODE_EOL = 3,
+  REGEX_NODE_CAT = 4, // kids[a, a + count) one after another
+  REGEX_NODE_ALT = 5, // or one of them
+  REGEX_NODE_REPEAT = 6 // nodes[a], min to max times
+} REGEX_NODE;
+
+#define REGEX_INFINITE UINT32_MAX
+#define REGEX_NONE UINT32_MAX // no node: the pattern is malformed
+
+typedef struct regex_node {
+  uint32_t kind;
+  uint32_t a;
+  uint32_t count;
+  uint32_t min;
+  uint32_t max;
+} regex_node_t;
+
+// a growable array of `size` byte items
+typedef struct regex_vec {
+  void *data;
+  uint32_t count;
+  uint32_t cap;
+} regex_vec_t;
+
+typedef struct regex_parser {
+  const uint8_t *s;
+  size_t len;
+  size_t at;
+  uint32_t depth;
+  const char *error;
+
+  regex_vec_t nodes; // regex_node_t
+  regex_vec_t kids; // node indices, for CATs and ALTs
+  regex_vec_t pending; // the kids of those being parsed
+  regex_vec_t classes; // regex_class_t
+} regex_parser_t;
+
+// room for one more item, its index; REGEX_NONE if out of memory
+static uint32_t regex_push(regex_parser_t *p, regex_vec_t *v, size_t size) {
+  if (v->count == v->cap) {
+    const uint32_t cap = v->cap == 0 ? 16 : v->cap * 2;
+    void *data = realloc(v->data, cap * size);
+
+    if (data == NULL) {
+      p->error = "regex: out of memory";
+      return REGEX_NONE;
+    }
+
+    v->data = data;
+    v->cap = cap;
+  }
+
+  return v->count++;
+}
+
+static uint32_t regex_node(regex_parser_t *p, uint32_t kind, uint32_t a, uint32_t count, uint32_t min, uint32_t max) {
+  const uint32_t i = regex_push(p, &p->nodes, sizeof(regex_node_t));
+
+  if (i != REGEX_NONE) {
+    ((regex_node_t*)p->nodes.data)[i] = (regex_node_t){ kind, a, count, min, max };
+  }
+
+  return i;
+}
+
+static uint32_t regex_classNode(regex_parser_t *p, const regex_class_t *c) {
+  const uint32_t i = regex_push(p, &p->classes, sizeof(regex_class_t));
+
+  if (i == REGEX_NONE) {
+    return REGEX_NONE;
+  }
+
+  ((regex_class_t*)p->classes.data)[i] = *c;
+
+  return regex_node(p, REGEX_NODE_CLASS, i, 0, 0, 0);
+}
+
+static bool regex_pending(regex_parser_t *p, uint32_t node) {
+  const uint32_t i = regex_push(p, &p->pending, sizeof(uint32_t));
+
+  if (i == REGEX_NONE) {
+    return false;
+  }
+
+  ((uint32_t*)p->pending.data)[i] = node;
+
+  return true;
+}
+
+// a `kind` node of the kids pending from `base` on, which are taken off;
+// the one kid itself if there is one, an empty node if none
+static uint32_t regex_collect(regex_parser_t *p, uint32_t kind, uint32_t base) {
+  const uint32_t count = p->pending.count - base;
+  uint32_t first = p->kids.count;
+
+  if (count == 0) {
+    return regex_node(p, REGEX_NODE_EMPTY, 0, 0, 0, 0);
+  }
+
+  if (count == 1) {
+    p->pending.count = base;
+    return ((uint32_t*)p->pending.data)[base];
+  }
+
+  for (uint32_t i = 0; i < count; i++) {
+    const uint32_t k = regex_push(p, &p->kids, sizeof(uint32_t));
+
+    if (k == REGEX_NONE) {
+      return REGEX_NONE;
+    }
+
+    ((uint32_t*)p->kids.data)[k] = ((uint32_t*)p->pending.data)[base + i];
+  }
+
+  p->pending.count = base;
+
+  return regex_node(p, kind, first, count, 0, 0);
+}
+
+static uint32_t regex_alt(regex_parser_t *p);
+
+// after a backslash: its byte, or -1 with `c` set for the classes \d \w
+// \s and their negations, or -2 if it is not an escape
+static int regex_escape(regex_parser_t *p, regex_class_t *c) {
+  uint8_t e;
+  bool negate = false;
+
+  if (p->at == p->len) {
+    p->error = "regex: trailing backslash";
+    return -2;
+  }
+
+  e = p->s[p->at++];
+  memset(c, 0, sizeof(*c));
+
+  switch (e) {
+    case 't': return '\t';
+    case 'n': return '\n';
+    case 'r': return '\r';
+    case 'f': return '\f';
+    case 'v': return '\v';
+    case 'x': {
+      int v = 0;
+
+      for (int i = 0; i < 2; i++) {
+        const uint8_t h = p->at < p->len ? p->s[p->at++] : 0;
+
+        if ((uint8_t)(h - '0') <= 9) {
+          v = v * 16 + (h - '0');
+        } else if ((uint8_t)((h | 0x20) - 'a') <= 5) {
+          v = v * 16 + ((h | 0x20) - 'a' + 10);
+        } else {
+          p->error = "regex: \\x takes two hex digits";
+          return -2;
+        }
+      }
+
+      return v;
+    }
+    case 'D':
+    case 'W':
+    case 'S':
+      negate = true;
+      e |= 0x20;
+      // fall through
+    case 'd':
+    case 'w':
+    case 's':
+      if (e == 'd' || e == 'w') {
+        regex_addRange(c, '0', '9');
+      }
+
+      if (e == 'w') {
+        regex_addRange(c, 'a', 'z');
+        regex_addRange(c, 'A', 'Z');
+        regex_add(c, '_');
+      }
+
+      if (e == 's') {
+        regex_add(c, ' ');
+        regex_addRange(c, '\t', '\r');
+      }
+
+      if (negate) {
+        for (int i = 0; i < 4; i++) {
+          c->bits[i] = ~c->bits[i];
+        }
+      }
+
+      return -1;
+    default:
+      break;
+  }
+
+  // punctuation stands for itself; letters and digits may mean something
+  // one day
+  if ((uint8_t)((e | 0x20) - 'a') <= 25 || (uint8_t)(e - '0') <= 9) {
+    p->error = "regex: unknown escape";
+    return -2;
+  }
+
+  return e;
+}
+
+// after the [
+static uint32_t regex_bracket(regex_parser_t *p) {
+  regex_class_t c = { { 0, 0, 0, 0 } };
+  regex_class_t escaped;
+  bool negate = false;
+  bool first = true;
+
+  if (p->at < p->len && p->s[p->at] == '^') {
+    negate = true;
+    p->at++;
+  }
+
+  for (;;) {
+    int lo;
+    int hi;
+
+    if (p->at == p->len) {
+      p->error = "regex: missing ]";
+      return REGEX_NONE;
+    }
+
+    // a ] first is one
+    if (p->s[p->at] == ']' && !first) {
+      p->at++;
+      break;
+    }
+
+    first = false;
+
+    if (p->s[p->at++] == '\\') {
+      if ((lo = regex_escape(p, &escaped)) == -2) {
+        return REGEX_NONE;
+      }
+
+      if (lo == -1) {
+        for (int i = 0; i < 4; i++) {
+          c.bits[i] |= escaped.bits[i];
+        }
+
+        continue;
+      }
+    } else {
+      lo = p->s[p->at - 1];
+    }
+
+    hi = lo;
+
+    // a - last is one
+    if (p->at + 1 < p->len && p->s[p->at] == '-' && p->s[p->at + 1] != ']') {
+      p->at++;
+
+      if (p->s[p->at++] == '\\') {
+        if ((hi = regex_escape(p, &escaped)) == -2) {
+          return REGEX_NONE;
+        }
+      } else {
+        hi = p->s[p->at - 1];
+      }
+
+      if (hi < lo) {
+        p->error = "regex: bad range in []";
+        return REGEX_NONE;
+      }
+    }
+
+    regex_addRange(&c, (uint8_t)lo, (uint8_t)hi);
+  }
+
+  if (negate) {
+    for (int i = 0; i < 4; i++) {
+      c.bits[i] = ~c.bits[i];
+    }
+  }
+
+  return regex_classNode(p, &c);
+}
+
+static uint32_t regex_atom(regex_parser_t *p) {
+  regex_class_t c = { { 0, 0, 0, 0 } };
+  const uint8_t b = p->s[p->at++];
+  uint32_t node;
+  int e;
+
+  switch (b) {
+    case '(':
+      if (p->at + 1 < p->len && p->s[p->at] == '?' && p->s[p->at + 1] == ':') {
+        p->at += 2;
+      }
+
+      if (++p->depth > REGEX_MAX_DEPTH) {
+        p->error = "regex: nested too deep";
+        return REGEX_NONE;
+      }
+
+      if ((node = regex_alt(p)) == REGEX_NONE) {
+        return REGEX_NONE;
+      }
+
+      --p->depth;
+
+      if (p->at == p->len || p->s[p->at] != ')') {
+        p->error = "regex: missing )";
+        return REGEX_NONE;
+      }
+
+      p->at++;
+
+      return node;
+    case '[':
+      return regex_bracket(p);
+    case '.':
+      for (int i = 0; i < 4; i++) {
+        c.bits[i] = ~(uint64_t)0;
+      }
+
+      c.bits[0] &= ~((uint64_t)1 << '\n');
+
+      return regex_classNode(p, &c);
+    case '^':
+      return regex_node(p, REGEX_NODE_BOL, 0, 0, 0, 0);
+    case '$':
+      return regex_node(p, REGEX_NODE_EOL, 0, 0, 0, 0);
+    case '*':
+    case '+':
+    case '?':
+    case '{':
+      p->error = "regex: nothing to repeat";
+      return REGEX_NONE;
+    case '\\':
+      if ((e = regex_escape(p, &c)) == -2) {
+        return REGEX_NONE;
+      }
+
+      if (e >= 0) {
+        regex_add(&c, (uint8_t)e);
+      }
+
+      return regex_classNode(p, &c);
+    default:
+      regex_add(&c, b);
+      return regex_classNode(p, &c);
+  }
+}
+
+// a count of a {m,n}, at most REGEX_MAX_REPEAT; -1 if there is none
+static int64_t regex_count(regex_parser_t *p) {
+  int64_t n = 0;
+  const size_t from = p->at;
+
+  while (p->at < p->len && (uint8_t)(p->s[p->at] - '0') <= 9 && n <= REGEX_MAX_REPEAT) {
+    n = n * 10 + (p->s[p->at++] - '0');
+  }
+
+  return p->at == from ? -1 : n;
+}
+
+// an atom and the quantifiers after it
+static uint32_t regex_repeat(regex_parser_t *p) {
+  uint32_t node = regex_atom(p);
+  const uint32_t depth = p->depth;
+
+  while (node != REGEX_NONE && p->at < p->len) {
+    int64_t min;
+    int64_t max;
+
+    switch (p->s[p->at]) {
+      case '*': min = 0; max = REGEX_INFINITE; break;
+      case '+': min = 1; max = REGEX_INFINITE; break;
+      case '?': min = 0; max = 1; break;
+      case '{':
+        p->at++;
+
+        if ((min = max = regex_count(p)) < 0) {
+          p->error = "regex: bad {m,n}";
+          return REGEX_NONE;
+        }
+
+        if (p->at < p->len && p->s[p->at] == ',') {
+          p->at++;
+
+          if ((max = regex_count(p)) < 0) {
+            max = REGEX_INFINITE;
+          }
+        }
+
+        if (p->at == p->len || p->s[p->at] != '}' || max < min
+            || min > REGEX_MAX_REPEAT || (max != REGEX_INFINITE && max > REGEX_MAX_REPEAT)) {
+          p->error = "regex: bad {m,n}";
+          return REGEX_NONE;
+        }
+
+        break;
+      default:
+        p->depth = depth;
+        return node;
+    }
+
+    p->at++;
+
+    // matches are the longest, lazy or not
+    if (p->at < p->len && p->s[p->at] == '?') {
+      p->at++;
+    }
+
+    if (++p->depth > REGEX_MAX_DEPTH) {
+      p->error = "regex: nested too deep";
+      return REGEX_NONE;
+    }
+
+    node = regex_node(p, REGEX_NODE_REPEAT, node, 0, (uint32_t)min, (uint32_t)max);
+  }
+
+  p->depth = depth;
+
+  return node;
+}
+
+static uint32_t regex_cat(regex_parser_t *p) {
+  const uint32_t base = p->pending.count;
+
+  while (p->at < p->len && p->s[p->at] != '|' && p->s[p->at] != ')') {
+    const uint32_t node = regex_repeat(p);
+
+    if (node == REGEX_NONE || !regex_pending(p, node)) {
+      return REGEX_NONE;
+    }
+  }
+
+  return regex_collect(p, REGEX_NODE_CAT, base);
+}
+
+static uint32_t regex_alt(regex_parser_t *p) {
+  const uint32_t base = p->pending.count;
+
+  for (;;) {
+    const uint32_t node = regex_cat(p);
+
+    if (node == REGEX_NONE || !regex_pending(p, node)) {
+      return REGEX_NONE;
+    }
+
+    if (p->at == p->len || p->s[p->at] != '|') {
+      break;
+    }
+
+    p->at++;
+  }
+
+  return regex_collect(p, REGEX_NODE_ALT, base);
+}
+
+// ===== compiling =====
+
+typedef struct regex_emitter {
+  const regex_parser_t *p;
+  bool reverse; // the pattern backwards, for regex_find to find where a match starts
+  regex_inst_t *insts;
+  uint32_t count;
+  uint32_t cap;
+} regex_emitter_t;
+
+// the index of a new instruction, REGEX_NONE if there are too many
+static uint32_t regex_inst(regex_emitter_t *e, uint32_t op, uint32_t x, uint32_t y) {
+  if (e->count == e->cap) {
+    const uint32_t cap = e->cap == 0 ? 64 : e->cap * 2;
+    regex_inst_t *insts;
+
+    if (e->count == REGEX_MAX_INSTRUCTIONS
+        || (insts = (regex_inst_t*)realloc(e->insts, cap * sizeof(regex_inst_t))) == NULL) {
+      return REGEX_NONE;
+    }
+
+    e->insts = insts;
+    e->cap = cap;
+  }
+
+  e->insts[e->count] = (regex_inst_t){ op, x, y };
+
+  return e->count++;
+}
+
+// the instructions of `node`, Thompson's construction; false if there
+// are too many
+static bool regex_emit(regex_emitter_t *e, uint32_t node) {
+  const regex_node_t *n = &((const regex_node_t*)e->p->nodes.data)[node];
+  const uint32_t *kids = (const uint32_t*)e->p->kids.data;
+  uint32_t at = 0;
+  uint32_t jumps;
+
+  switch (n->kind) {
+    case REGEX_NODE_EMPTY:
+      return true;
+    case REGEX_NODE_CLASS:
+      return regex_inst(e, REGEX_CLASS, n->a, 0) != REGEX_NONE;
+    case REGEX_NODE_BOL:
+      return regex_inst(e, e->reverse ? REGEX_EOL : REGEX_BOL, 0, 0) != REGEX_NONE;
+    case REGEX_NODE_EOL:
+      return regex_inst(e, e->reverse ? REGEX_BOL : REGEX_EOL, 0, 0) != REGEX_NONE;
+    case REGEX_NODE_CAT:
+      for (uint32_t i = 0; i < n->count; i++) {
+        if (!regex_emit(e, kids[n->a + (e->reverse ? n->count - 1 - i : i)])) {
+          return false;
+        }
+      }
+
+      return true;
+    case REGEX_NODE_ALT:
+      // split to each but the last, which jumps past the rest; the jumps
+      // are a list through their x until they are patched
+      jumps = REGEX_NONE;
+
+      for (uint32_t i = 0; i + 1 < n->count; i++) {
+        if ((at = regex_inst(e, REGEX_SPLIT, e->count + 1, 0)) == REGEX_NONE || !regex_emit(e, kids[n->a + i])
+            || regex_inst(e, REGEX_JMP, jumps, 0) == REGEX_NONE) {
+          return false;
+        }
+
+        jumps = e->count - 1;
+        e->insts[at].y = e->count;
+      }
+
+      if (!regex_emit(e, kids[n->a + n->count - 1])) {
+        return false;
+      }
+
+      while (jumps != REGEX_NONE) {
+        const uint32_t next = e->insts[jumps].x;
+
+        e->insts[jumps].x = e->count;
+        jumps = next;
+      }
+
+      return true;
+    case REGEX_NODE_REPEAT:
+      if (n->max == REGEX_INFINITE) {
+        // x{m,}: m - 1 of them, then x+; x*: split around x and back
+        for (uint32_t i = 1; i < n->min; i++) {
+          if (!regex_emit(e, n->a)) {
+            return false;
+          }
+        }
+
+        if (n->min == 0) {
+          if ((at = regex_inst(e, REGEX_SPLIT, e->count + 1, 0)) == REGEX_NONE || !regex_emit(e, n->a)
+              || regex_inst(e, REGEX_JMP, at, 0) == REGEX_NONE) {
+            return false;
+          }
+
+          e->insts[at].y = e->count;
+
+          return true;
+        }
+
+        at = e->count;
+
+        return regex_emit(e, n->a) && regex_inst(e, REGEX_SPLIT, at, e->count + 1) != REGEX_NONE;
+      }
+
+      // x{m,n}: m of them, then n - m of x?
+      for (uint32_t i = 0; i < n->max; i++) {
+        if (i >= n->min && (at = regex_inst(e, REGEX_SPLIT, e->count + 1, 0)) == REGEX_NONE) {
+          return false;
+        }
+
+        if (!regex_emit(e, n->a)) {
+          return false;
+        }
+
+        if (i >= n->min) {
+          e->insts[at].y = e->count;
+        }
+      }
+
+      return true;
+    default:
+      return false;
+  }
+}
+
+// the program of the tree at `root`, ending in MATCH; NULL if it is too long
+static regex_inst_t *regex_program(const regex_parser_t *p, uint32_t root, bool reverse, uint32_t *count) {
+  regex_emitter_t e = { .p = p, .reverse = reverse };
+
+  if (!regex_emit(&e, root) || regex_inst(&e, REGEX_MATCH, 0, 0) == REGEX_NONE) {
+    free(e.insts);
+    return NULL;
+  }
+
+  *count = e.count;
+
+  return e.insts;
+}
+
+static void regex_dfaInit(regex_dfa_t *dfa, const regex_inst_t *insts, bool unanchored) {
+  memset(dfa, 0, sizeof(*dfa));
+  dfa->insts = insts;
+  dfa->unanchored = unanchored;
+  dfa->start[0] = dfa->start[1] = REGEX_UNKNOWN;
+}
+
+static void regex_dfaDestroy(regex_dfa_t *dfa) {
+  free(dfa->states);
+  free(dfa->pcs);
+  free(dfa->next);
+  free(dfa->table);
+}
+
+static void regex_free(regexp_t *re) {
+  regex_dfaDestroy(&re->anchored);
+  regex_dfaDestroy(&re->unanchored);
+  regex_dfaDestroy(&re->backward);
+  pthread_mutex_destroy(&re->lock);
+  free(re->insts);
+  free(re->reversed);
+  free(re->classes);
+  free(re->marks);
+  free(re->stack);
+  free(re->set);
+  free(re);
+}
+
+// the `len` bytes of `pattern` compiled, or NULL with `*error` set
+static regexp_t *regex_compile(const char *pattern, size_t len, const char **error) {
+  regex_parser_t p;
+  regexp_t *re;
+  uint32_t root;
+  bool boundary[256];
+  uint32_t id = 0;
+
+  memset(&p, 0, sizeof(p));
+  p.s = (const uint8_t*)pattern;
+  p.len = len;
+
+  if ((root = regex_alt(&p)) != REGEX_NONE && p.at != p.len) {
+    p.error = "regex: unmatched )";
+    root = REGEX_NONE;
+  }
+
+  if (root == REGEX_NONE || (re = (regexp_t*)calloc(1, sizeof(regexp_t))) == NULL) {
+    free(p.nodes.data);
+    free(p.kids.data);
+    free(p.pending.data);
+    free(p.classes.data);
+    *error = root == REGEX_NONE ? p.error : "regex: out of memory";
+
+    return NULL;
+  }
+
+  pthread_mutex_init(&re->lock, NULL);
+  re->classes = (regex_class_t*)p.classes.data;
+  re->insts = regex_program(&p, root, false, &re->numInsts);
+  re->reversed = regex_program(&p, root, true, &re->numInsts);
+
+  free(p.nodes.data);
+  free(p.kids.data);
+  free(p.pending.data);
+
+  if (re->insts == NULL || re->reversed == NULL) {
+    regex_free(re);
+    *error = "regex: too long once repeats are expanded";
+
+    return NULL;
+  }
+
+  // a new byte class wherever any class starts or stops including bytes
+  memset(boundary, 0, sizeof(boundary));
+
+  for (uint32_t i = 0; i < p.classes.count; i++) {
+    for (uint32_t b = 1; b < 256; b++) {
+      boundary[b] |= regex_has(&re->classes[i], (uint8_t)b) != regex_has(&re->classes[i], (uint8_t)(b - 1));
+    }
+  }
+
+  for (uint32_t b = 0; b < 256; b++) {
+    if (b != 0 && boundary[b]) {
+      re->representative[++id] = (uint8_t)b;
+    }
+
+    re->byteClass[b] = (uint8_t)id;
+  }
+
+  re->numByteClasses = id + 1;
+
+  regex_dfaInit(&re->anchored, re->insts, false);
+  regex_dfaInit(&re->unanchored, re->insts, true);
+  regex_dfaInit(&re->backward, re->reversed, false);
+
+  re->marks = (uint32_t*)calloc(re->numInsts, sizeof(uint32_t));
+  re->stack = (uint32_t*)malloc(2 * re->numInsts * sizeof(uint32_t));
+  re->set = (uint32_t*)malloc(2 * re->numInsts * sizeof(uint32_t));
+
+  if (re->marks == NULL || re->stack == NULL || re->set == NULL) {
+    regex_free(re);
+    *error = "regex: out of memory";
+
+    return NULL;
+  }
+
+  return re;
+}
+
+// ===== running =====
+
+// a new closure: no instruction seen yet
+static void regex_newMark(regexp_t *re) {
+  if (++re->mark == 0) {
+    memset(re->marks, 0, re->numInsts * sizeof(uint32_t));
+    re->mark = 1;
+  }
+}
+
+// the instructions of `insts` that `pc` leads to without reading a byte,
+// and not seen yet since regex_newMark, appended to `out`: those that read
+// one, and MATCH. ^ is passed at the start of the text, `bol`, and $ at
+// its end, `eol`; otherwise, if `pending`, $ is kept to be tried there
+static uint32_t regex_closure(regexp_t *re, const regex_inst_t *insts, uint32_t pc, bool bol, bool eol, bool pending,
+                              uint32_t *out, uint32_t count) {
+  uint32_t top = 0;
+
+  re->stack[top++] = pc;
+
+  while (top != 0) {
+    const regex_inst_t *inst;
+
+    pc = re->stack[--top];
+
+    if (re->marks[pc] == re->mark) {
+      continue;
+    }
+
+    re->marks[pc] = re->mark;
+    inst = &insts[pc];
+
+    switch (inst->op) {
+      case REGEX_SPLIT:
+        re->stack[top++] = inst->y;
+        re->stack[top++] = inst->x;
+        break;
+      case REGEX_JMP:
+        re->stack[top++] = inst->x;
+        break;
+      case REGEX_BOL:
+        if (bol) {
+          re->stack[top++] = pc + 1;
+        }
+
+        break;
+      case REGEX_EOL:
+        if (eol) {
+          re->stack[top++] = pc + 1;
+        } else if (pending) {
+          out[count++] = pc;
+        }
+
+        break;
+      default:
+        out[count++] = pc;
+        break;
+    }
+  }
+
+  return count;
+}
+
+static int regex_comparePcs(const void *a, const void *b) {
+  const uint32_t x = *(const uint32_t*)a;
+  const uint32_t y = *(const uint32_t*)b;
+
+  return (x > y) - (x < y);
+}
+
+// the threads started at one byte, from `from` in re->set, as a group:
+// sorted, a REGEX_MARK before it unless it is the first, and dropped if
+// it is empty. re->set's new length.
+static uint32_t regex_group(regexp_t *re, uint32_t from, uint32_t count) {
+  if (count == from) {
+    return from == 0 ? 0 : from - 1;
+  }
+
+  qsort(re->set + from, count - from, sizeof(uint32_t), regex_comparePcs);
+
+  return count;
+}
+
+// drops every state, for the table to fill again
+static void regex_flush(regex_dfa_t *dfa) {
+  dfa->numStates = 0;
+  dfa->numPcs = 0;
+  dfa->start[0] = dfa->start[1] = REGEX_UNKNOWN;
+  dfa->flushes++;
+  memset(dfa->table, 0xFF, 2 * REGEX_MAX_STATES * sizeof(int32_t));
+}
+
+// the state of the `count` instructions in re->set, made if it is new;
+// REGEX_UNKNOWN if out of memory. the groups after the first to match
+// are dropped: they started later.
+static int32_t regex_state(regexp_t *re, regex_dfa_t *dfa, uint32_t count, bool matched) {
+  const uint32_t mask = 2 * REGEX_MAX_STATES - 1;
+  uint32_t *pcs = re->set;
+  regex_state_t *state;
+  bool match = false;
+  uint64_t hash;
+  uint32_t slot;
+  int32_t index;
+
+  for (uint32_t i = 0; i < count; i++) {
+    if (pcs[i] == REGEX_MARK && match) {
+      count = i;
+      break;
+    }
+
+    match |= pcs[i] != REGEX_MARK && dfa->insts[pcs[i]].op == REGEX_MATCH;
+  }
+
+  matched |= match;
+  hash = hashBytes64(pcs, count * sizeof(uint32_t), HASH_BYTES_INIT) ^ matched;
+
+  if (dfa->table == NULL) {
+    if ((dfa->table = (int32_t*)malloc(2 * REGEX_MAX_STATES * sizeof(int32_t))) == NULL) {
+      return REGEX_UNKNOWN;
+    }
+
+    memset(dfa->table, 0xFF, 2 * REGEX_MAX_STATES * sizeof(int32_t));
+  }
+
+  for (slot = (uint32_t)hash & mask; (index = dfa->table[slot]) >= 0; slot = (slot + 1) & mask) {
+    state = &dfa->states[index];
+
+    if (state->hash == hash && state->count == count && state->matched == matched
+        && memcmp(dfa->pcs + state->first, pcs, count * sizeof(uint32_t)) == 0) {
+      return index;
+    }
+  }
+
+  if (dfa->numStates == REGEX_MAX_STATES) {
+    regex_flush(dfa);
+
+    for (slot = (uint32_t)hash & mask; dfa->table[slot] >= 0; slot = (slot + 1) & mask) {
+    }
+  }
+
+  if (dfa->numStates == dfa->capStates) {
+    const uint32_t cap = dfa->capStates == 0 ? 16 : dfa->capStates * 2;
+    regex_state_t *states = (regex_state_t*)realloc(dfa->states, cap * sizeof(regex_state_t));
+    int32_t *next;
+
+    if (states == NULL) {
+      return REGEX_UNKNOWN;
+    }
+
+    dfa->states = states;
+
+    if ((next = (int32_t*)realloc(dfa->next, (size_t)cap * re->numByteClasses * sizeof(int32_t))) == NULL) {
+      return REGEX_UNKNOWN;
+    }
+
+    dfa->next = next;
+    dfa->capStates = cap;
+  }
+
+  if (dfa->numPcs + count > dfa->capPcs) {
+    const size_t cap = (dfa->numPcs + count) * 2;
+    uint32_t *grown = (uint32_t*)realloc(dfa->pcs, cap * sizeof(uint32_t));
+
+    if (grown == NULL) {
+      return REGEX_UNKNOWN;
+    }
+
+    dfa->pcs = grown;
+    dfa->capPcs = cap;
+  }
+
+  index = (int32_t)dfa->numStates++;
+  state = &dfa->states[index];
+  state->first = (uint32_t)dfa->numPcs;
+  state->count = count;
+  state->hash = hash;
+  state->matched = matched;
+  state->match = state->matchAtEnd = match;
+  memcpy(dfa->pcs + dfa->numPcs, pcs, count * sizeof(uint32_t));
+  dfa->numPcs += count;
+  dfa->table[slot] = index;
+
+  for (uint32_t i = 0; i < re->numByteClasses; i++) {
+    dfa->next[(size_t)index * re->numByteClasses + i] = REGEX_UNKNOWN;
+  }
+
+  // whether a match would end here if the text did, through a $ pending.
+  // any would be leftmost, or as far left and longer; re->set is free
+  // to use again
+  regex_newMark(re);
+
+  for (uint32_t i = 0; i < count && !state->matchAtEnd; i++) {
+    const uint32_t pc = dfa->pcs[state->first + i];
+
+    if (pc != REGEX_MARK && dfa->insts[pc].op == REGEX_EOL) {
+      const uint32_t n = regex_closure(re, dfa->insts, pc + 1, false, true, false, re->set, 0);
+
+      for (uint32_t j = 0; j < n; j++) {
+        state->matchAtEnd |= dfa->insts[re->set[j]].op == REGEX_MATCH;
+      }
+    }
+  }
+
+  return index;
+}
+
+// the state before the first byte, at the start of the text or not
+static int32_t regex_start(regexp_t *re, regex_dfa_t *dfa, bool bol) {
+  if (dfa->start[bol] == REGEX_UNKNOWN) {
+    uint32_t n;
+
+    regex_newMark(re);
+    n = regex_group(re, 0, regex_closure(re, dfa->insts, 0, bol, false, true, re->set, 0));
+    dfa->start[bol] = regex_state(re, dfa, n, false);
+  }
+
+  return dfa->start[bol];
+}
+
+// the state after `from` reads a byte of `byteClass`, made and kept as
+// its transition if it is new: each group's threads go on, in order, and
+// one is started after them in the unanchored DFA until there is a match
+static int32_t regex_step(regexp_t *re, regex_dfa_t *dfa, int32_t from, uint32_t byteClass) {
+  const uint8_t b = re->representative[byteClass];
+  const uint32_t first = dfa->states[from].first;
+  const uint32_t count = dfa->states[from].count;
+  const bool matched = dfa->states[from].matched;
+  const uint32_t flushes = dfa->flushes;
+  uint32_t group = 0;
+  uint32_t n = 0;
+  int32_t to;
+
+  regex_newMark(re);
+
+  for (uint32_t i = 0; i <= count; i++) {
+    const uint32_t pc = i < count ? dfa->pcs[first + i] : REGEX_MARK;
+
+    if (pc == REGEX_MARK) {
+      n = regex_group(re, group, n);
+      group = n != 0 ? n + 1 : 0;
+      re->set[n] = REGEX_MARK;
+      n = group;
+    } else if (dfa->insts[pc].op == REGEX_CLASS && regex_has(&re->classes[dfa->insts[pc].x], b)) {
+      n = regex_closure(re, dfa->insts, pc + 1, false, false, true, re->set, n);
+    }
+  }
+
+  if (dfa->unanchored && !matched) {
+    n = regex_closure(re, dfa->insts, 0, false, false, true, re->set, n);
+  }
+
+  to = regex_state(re, dfa, regex_group(re, group, n), matched);
+
+  // `from` is gone if the states were dropped for it
+  if (to != REGEX_UNKNOWN && dfa->flushes == flushes) {
+    dfa->next[(size_t)from * re->numByteClasses + byteClass] = to;
+  }
+
+  return to;
+}
+
+// the end of the leftmost-longest match in the `len` bytes at `s`, read
+// from the last back if `backward`; -1 if there is none, -2 if out of
+// memory. `bol` is whether they start the text, for ^.
+static int64_t regex_run(regexp_t *re, regex_dfa_t *dfa, const uint8_t *s, size_t len, bool backward, bool bol) {
+  int32_t state;
+  int64_t last;
+  size_t i;
+
+  // the start is the end too, which a state does not know: ^$ matches
+  if (len == 0) {
+    regex_newMark(re);
+    last = -1;
+
+    for (uint32_t n = regex_closure(re, dfa->insts, 0, bol, true, false, re->set, 0); n != 0; n--) {
+      last = dfa->insts[re->set[n - 1]].op == REGEX_MATCH ? 0 : last;
+    }
+
+    return last;
+  }
+
+  if ((state = regex_start(re, dfa, bol)) == REGEX_UNKNOWN) {
+    return -2;
+  }
+
+  last = dfa->states[state].match ? 0 : -1;
+
+  for (i = 0; i < len && dfa->states[state].count != 0; i++) {
+    const uint32_t byteClass = re->byteClass[s[backward ? len - 1 - i : i]];
+    int32_t next = dfa->next[(size_t)state * re->numByteClasses + byteClass];
+
+    if (next == REGEX_UNKNOWN && (next = regex_step(re, dfa, state, byteClass)) == REGEX_UNKNOWN) {
+      return -2;
+    }
+
+    state = next;
+
+    if (dfa->states[state].match) {
+      last = (int64_t)i + 1;
+    }
+  }
+
+  if (i == len && dfa->states[state].matchAtEnd) {
+    last = (int64_t)len;
+  }
+
+  return last;
+}
+
+int64_t regex_match(regexp_t *re, const uint8_t *s, size_t len) {
+  int64_t result;
+
+  pthread_mutex_lock(&re->lock);
+  result = regex_run(re, &re->anchored, s, len, false, true);
+  pthread_mutex_unlock(&re->lock);
+
+  return result < 0 ? -1 : result;
+}
+
+int64_t regex_find(regexp_t *re, const uint8_t *s, size_t len) {
+  int64_t end;
+  int64_t length;
+
+  pthread_mutex_lock(&re->lock);
+
+  // where the leftmost-longest match ends, then its longest match back
+  // from there is it
+  if ((end = regex_run(re, &re->unanchored, s, len, false, true)) > 0) {
+    length = regex_run(re, &re->backward, s, (size_t)end, true, (size_t)end == len);
+    end = length < 0 ? -1 : end - length;
+  }
+
+  pthread_mutex_unlock(&re->lock);
+
+  return end < 0 ? -1 : end;
+}
+
+const char *regex_pattern(const regexp_t *re) {
+  return re->pattern;
+}
+
+// ===== the cache =====
+
+typedef struct regex_entry {
+  const char *key; // interned, NULL if the entry is free
+  size_t len;
+  regexp_t *re; // NULL if the pattern is malformed
+  const char *error; // then, why
+} regex_entry_t;
+
+struct regexes {
+  pthread_mutex_t lock;
+  regex_entry_t *entries;
+  size_t size; // a power of two
+  size_t count;
+};
+
+regexes_t *regex_createCache() {
+  regexes_t *cache = (regexes_t*)calloc(1, sizeof(regexes_t));
+
+  pthread_mutex_init(&cache->lock, NULL);
+  cache->size = 16;
+  cache->entries = (regex_entry_t*)calloc(cache->size, sizeof(regex_entry_t));
+
+  return cache;
+}
+
+void regex_destroyCache(regexes_t *cache) {
+  for (size_t i = 0; i < cache->size; i++) {
+    if (cache->entries[i].re != NULL) {
+      regex_free(cache->entries[i].re);
+    }
+  }
+
+  free(cache->entries);
+  pthread_mutex_destroy(&cache->lock);
+  free(cache);
+}
+
+// the entry of `key`, or the free one it would go in
+static regex_entry_t *regex_entry(regexes_t *cache, const char *key) {
+  size_t i = hash6432shift((uint64_t)(uintptr_t)key) & (cache->size - 1);
+
+  while (cache->entries[i].key != NULL && cache->entries[i].key != key) {
+    i = (i + 1) & (cache->size - 1);
+  }
+
+  return &cache->entries[i];
+}
+
+static void regex_grow(regexes_t *cache) {
+  regex_entry_t *entries = cache->entries;
+  const size_t size = cache->size;
+
+  cache->size *= 2;
+  cache->entries = (regex_entry_t*)calloc(cache->size, sizeof(regex_entry_t));
+
+  for (size_t i = 0; i < size; i++) {
+    if (entries[i].key != NULL) {
+      *regex_entry(cache, entries[i].key) = entries[i];
+    }
+  }
+
+  free(entries);
+}
+
+regexp_t *regex_get(runtime_t *rt, const char *pattern, size_t len, const char **error) {
+  regexes_t *cache = rt->regexes;
+  regex_entry_t *entry;
+
+  if (cache == NULL) {
+    // the first pattern makes it, under the lock any mutator may take
+    pthread_mutex_lock(&rt->internLock);
+
+    if ((cache = rt->regexes) == NULL) {
+      cache = rt->regexes = regex_createCache();
+    }
+
+    pthread_mutex_unlock(&rt->internLock);
+  }
+
+  pthread_mutex_lock(&cache->lock);
+
+  // the interned text, as regexCompile gives it, is found by its address
+  entry = regex_entry(cache, pattern);
+
+  if (entry->key == NULL || entry->len != len) {
+    const char *key = runtime_intern(rt, pattern, len);
+
+    if ((entry = regex_entry(cache, key))->key == NULL) {
+      entry->key = key;
+      entry->len = len;
+      entry->error = NULL;
+
+      if ((entry->re = regex_compile(key, len, &entry->error)) != NULL) {
+        entry->re->pattern = key;
+      }
+
+      if (++cache->count * 2 > cache->size) {
+        regex_grow(cache);
+        entry = regex_entry(cache, key);
+      }
+    }
+  }
+
+  *error = entry->error;
+  pthread_mutex_unlock(&cache->lock);
+
+  return entry->re;
+}
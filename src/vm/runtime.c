@@ -1,78 +1,787 @@
 #include <vm/runtime.h>
+#include <vm/aio.h>
+#include <vm/regex.h>
+#include <vm/fiber.h>
+#include <vm/net.h>
+#include <vm/task.h>
+#include <vm/program.h>
+#include <vm/builtins.h>
+#include <vm/calls.h>
+#include <vm/events.h>
+#include <vm/census.h>
 
 #include <assert.h>
+#include <time.h>
+#include <errno.h>
+#include <string.h>
+#include <stdarg.h>
 
 runtime_t *runtime_create() {
+  return runtime_createSized(STATIC_DATA_COUNT, STACK_COUNT);
+}
+
+runtime_t *runtime_createSized(size_t staticDataCount, size_t stackCount) {
   runtime_t *r = (runtime_t*)malloc(sizeof(runtime_t));
 
   r->heap = heap_create();
-  r->dt = datatable_create();
-  r->rc = rcmap_create();
+  r->quota = quota_acquire();
+  r->overLimit = false;
+  heap_setQuota(r->heap, r->quota);
+  r->dt = datatable_create(staticDataCount, stackCount);
+  r->epoch = 0;
+
+  pthread_mutex_init(&r->gcLock, NULL);
+  pthread_cond_init(&r->gcCond, NULL);
+  atomic_init(&r->gcRequested, false);
+  r->gcStop = false;
+  r->gcMutators = 0;
+  r->gcParked = 0;
+  r->gcThreshold = RUNTIME_GC_MIN_NODES;
+  r->gcBudgetNs = 0;
+
+  pthread_mutex_init(&r->internLock, NULL);
+  intern_init(&r->interned);
+
+  r->snapshot = NULL;
+  r->input = NULL;
+
+  output_init(&r->output, stdout);
+  r->aio = NULL;
+  r->fibers = NULL;
+  r->net = NULL;
+  r->program = NULL;
+  scratch_init(&r->scratch);
+  arena_init(&r->arena);
+  r->tasks = NULL;
+  r->regexes = NULL;
+  r->calls = NULL;
+  r->traced = NULL;
+  r->catcher = NULL;
+  r->fatal = NULL;
+  memset(r->hosts, 0, sizeof(r->hosts));
+
+  r->counting = 0;
+  r->counted = 0;
+  r->countFrom = NULL;
+  runtime_setBudget(r, 0, 0);
+
+  r->gcFullCount = 0;
+  r->gcMinorCount = 0;
+  r->gcPauseTotalNs = 0;
+  r->gcPauseMaxNs = 0;
 
   return r;
 }
 
 void runtime_destroy(runtime_t *r) {
-  rcmap_destroy(r->rc);
+  // first: the pool's threads run on runtimes of their own, and hold
+  // values the heap's futures refer to
+  if (r->tasks != NULL) {
+    tasks_destroy(r->tasks);
+  }
+
+  output_destroy(&r->output);
+
+  if (r->fibers != NULL) {
+    fibers_destroy(r, r->fibers);
+  }
+
+  if (r->net != NULL) {
+    net_destroy(r->net);
+  }
+
   datatable_destroy(r, r->dt);
+  // their objects are blocks of the heap
+  scratch_destroy(&r->scratch);
+  arena_destroy(r, &r->arena);
   heap_destroy(r, r->heap);
+
+  // after the heap: destroying a request waits for it
+  if (r->aio != NULL) {
+    aio_destroy(r->aio);
+  }
+
+  calls_destroy(r->calls);
+
+  if (r->regexes != NULL) {
+    regex_destroyCache(r->regexes);
+  }
+
+  pthread_cond_destroy(&r->gcCond);
+  pthread_mutex_destroy(&r->gcLock);
+  // after the heap: objects still hold interned keys until they are freed
+  intern_destroy(&r->interned);
+  pthread_mutex_destroy(&r->internLock);
+  // after the heap and the datatable: buffers still out, shared ones,
+  // are credited to it as they go
+  quota_release(r->quota);
   free(r);
 }
 
-void runtime_gc(runtime_t *r) {
-  heap_lock();
+void runtime_setBudget(runtime_t *r, uint64_t budget, uint64_t slice) {
+  r->budget = budget;
+  r->slice = slice;
+  r->used = 0;
+  r->exhausted = false;
+  r->fuel = 0;
+  r->fuelStart = 0;
+
+  runtime_refuel(r);
+}
+
+bool runtime_refuel(runtime_t *r) {
+  uint64_t left;
+  uint64_t next;
+
+  // ticks past zero were taken too, by the time the interpreter checked
+  r->used += (uint64_t)(r->fuelStart - r->fuel);
+
+  if (r->budget != 0 && r->used >= r->budget) {
+    r->exhausted = true;
+    r->fuel = 0;
+    r->fuelStart = 0;
+
+    return false;
+  }
+
+  left = r->budget != 0 ? r->budget - r->used : (uint64_t)INT64_MAX;
+  next = r->slice != 0 && r->slice < left ? r->slice : left;
+
+  // for the interpreter to look at the quota, see runtime_checkMemory
+  if (runtime_isMemoryLimited(r) && next > RUNTIME_MEMORY_SLICE) {
+    next = RUNTIME_MEMORY_SLICE;
+  }
+  r->fuel = next > (uint64_t)INT64_MAX ? INT64_MAX : (int64_t)next;
+
+  if (r->counting != 0) {
+    r->fuel = 1;
+  }
+
+  r->fuelStart = r->fuel;
+
+  return true;
+}
+
+bool runtime_setMemoryLimit(runtime_t *r, size_t soft, size_t hard) {
+  if (r->quota == NULL) {
+    return false;
+  }
+
+  r->quota->soft = soft;
+  r->quota->hard = hard;
+  atomic_store(&r->quota->pressed, soft != 0 && quota_used(r->quota) >= soft);
+  atomic_store(&r->quota->exceeded, false);
+  r->overLimit = false;
+  // the slices shorten, or lengthen
+  runtime_setBudget(r, r->budget, r->slice);
+
+  return true;
+}
 
-  datatable_mark(r->dt);
-  heap_sweep(r, r->heap);
+void runtime_checkMemory(runtime_t *r) {
+  value_t argument = value_fromRawPointer((void*)"memory limit exceeded", FLAG_CONST);
+  exception_t e = exception_fromValue(&argument);
 
-  heap_unlock();
+  // the handler may free what it needs to; the heap going past the limit
+  // again throws again
+  atomic_store_explicit(&r->quota->exceeded, false, memory_order_relaxed);
+
+  runtime_throwException(r, &e);
+
+  // nothing caught it
+  r->overLimit = true;
 }
 
-void runtime_throwException(runtime_t *r, exception_t *e) {
-  // @TODO internal VM handling.
+void runtime_countBegin(runtime_t *r) {
+  if (r->counting++ != 0) {
+    return;
+  }
 
+  // the fuel left is given back at the next tick, which refuels
+  r->used += (uint64_t)(r->fuelStart - r->fuel);
+  r->fuel = 1;
+  r->fuelStart = 1;
+  r->countFrom = NULL;
 }
 
-refcounted_t runtime_claim(runtime_t *rt, rcmap_key_t key) {
-  size_t *cnt = NULL;
+void runtime_countEnd(runtime_t *r) {
+  if (r->counting > 0) {
+    r->counting--;
+  }
+}
 
-  int result = rcmap_getPtr(rt->rc, key, &cnt);
+void runtime_reset(runtime_t *r, const struct program *program) {
+  // the datatable has the running fiber's values, and releases them
+  if (r->fibers != NULL) {
+    fibers_destroy(r, r->fibers);
+    r->fibers = NULL;
+  }
 
-  if (result == RC_MAP_OK) {
-    ++(*cnt);
-    return (refcounted_t)key;
-  } else if (result == RC_MAP_MISSING) {
-    result = rcmap_put(rt->rc, key, 1);
+  // with the fibers parked on it
+  if (r->net != NULL) {
+    net_destroy(r->net);
+    r->net = NULL;
   }
 
-  if (result == RC_MAP_OK) {
-    return (refcounted_t)key;
+  datatable_reset(r, r->dt);
+  scratch_release(&r->scratch);
+  arena_clear(r, &r->arena);
+  heap_clear(r, r->heap);
+  r->gcThreshold = RUNTIME_GC_MIN_NODES;
+  r->counting = 0;
+  r->overLimit = false;
+
+  if (r->quota != NULL) {
+    atomic_store(&r->quota->exceeded, false);
   }
 
-  // uh oh. throw exception?
-  return NULL;
+  runtime_setBudget(r, r->budget, r->slice);
+
+  builtins_register(r);
+
+  if (program != NULL) {
+    program_load(program, r);
+  }
 }
 
-void runtime_release(runtime_t *rt, refcounted_t rc) {
-  size_t *cnt = NULL;
+const char *runtime_intern(runtime_t *r, const char *str, size_t len) {
+  const char *result;
 
-  int result = rcmap_getPtr(rt->rc, rc, &cnt);
+  pthread_mutex_lock(&r->internLock);
+  result = intern_get(&r->interned, str, len);
+  pthread_mutex_unlock(&r->internLock);
 
-  if (result != RC_MAP_OK) {
-    // throw exception?
-    return;
+  return result;
+}
+
+uint64_t runtime_nowNs() {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// counts a pause of the mutators, from `start`, when they were asked to
+// stop, until now; with the heap locked
+static uint64_t runtime_countPause(runtime_t *r, uint64_t start) {
+  uint64_t pause = runtime_nowNs() - start;
+
+  r->gcPauseTotalNs += pause;
+  r->gcPauseMaxNs = pause > r->gcPauseMaxNs ? pause : r->gcPauseMaxNs;
+
+  return pause;
+}
+
+// the part of a collection that needs the mutators stopped: marking, and
+// unlinking the dead nodes for heap_finalize. the pause is counted from
+// `start`, when the mutators were asked to stop. with incremental marking
+// under way this ends it, as a full collection: the roots are marked again
+// and what is left traced, and the sweep is left to runtime_sweep.
+static void runtime_collect(runtime_t *r, bool full, uint64_t start) {
+  uint64_t pause, marked = 0, swept = 0;
+  size_t live = 0;
+  bool incremental;
+
+  // this thread's own allocations have to be linked in to be swept
+  heap_flush(r->heap);
+  heap_lock(r->heap);
+
+  incremental = r->heap->marking;
+  full = full || incremental;
+
+  if (incremental) {
+    heap_markEnd(r->heap);
+  } else {
+    // the marks an incremental collection left on nodes not swept yet
+    while (heap_sweepStep(r, r->heap, SIZE_MAX));
+  }
+
+  if (events_enabled) {
+    marked = runtime_nowNs();
+  }
+
+  if (!full) {
+    heap_markRemembered(r->heap);
+  }
+
+  datatable_mark(r->dt, r->heap);
+
+  if (r->fibers != NULL) {
+    fibers_mark(r->fibers, r->heap);
+  }
+
+  if (events_enabled) {
+    swept = runtime_nowNs();
+    live = r->heap->size;
+    events_record(EVENTS_GC_MARK, marked, swept - marked, full);
+  }
+
+  if (incremental) {
+    heap_sweepBegin(r, r->heap);
+  } else if (full) {
+    heap_sweep(r, r->heap);
+  } else {
+    heap_sweepYoung(r, r->heap);
   }
 
-  assert(*cnt > 0);
+  scratch_unmark(&r->scratch);
+  arena_unmark(&r->arena);
 
-  if (--(*cnt) == 0) {
-    free(rc);
+  pause = runtime_countPause(r, start);
 
-    result = rcmap_remove(rt->rc, rc);
+  if (events_enabled) {
+    events_record(EVENTS_GC_SWEEP, swept, start + pause - swept, live - r->heap->size);
   }
 
-  if (result != RC_MAP_OK) {
-    // throw
+  ++*(full ? &r->gcFullCount : &r->gcMinorCount);
+
+  heap_unlock(r->heap);
+}
+
+// starts incremental marking, with the mutators stopped: the roots are
+// pushed, and traced by runtime_markStep
+static void runtime_markBegin(runtime_t *r, uint64_t start) {
+  uint64_t marked;
+
+  // young, as allocated before marking
+  heap_flush(r->heap);
+  heap_lock(r->heap);
+  marked = runtime_nowNs();
+
+  heap_markBegin(r->heap);
+  datatable_mark(r->dt, r->heap);
+
+  if (r->fibers != NULL) {
+    fibers_mark(r->fibers, r->heap);
+  }
+
+  if (events_enabled) {
+    events_record(EVENTS_GC_MARK_STEP, marked, runtime_nowNs() - marked, r->heap->markLen);
+  }
+
+  runtime_countPause(r, start);
+  heap_unlock(r->heap);
+}
+
+// a slice of incremental marking, with the mutators stopped, until
+// `gcBudgetNs` after `start`. false, having traced nothing, if the stack
+// was empty: marking can end, see runtime_collect.
+static bool runtime_markStep(runtime_t *r, uint64_t start) {
+  uint64_t marked, deadline = start + r->gcBudgetNs;
+  size_t batches = 0;
+  bool more;
+
+  heap_lock(r->heap);
+
+  if (!heap_markStep(r->heap, 0)) {
+    heap_unlock(r->heap);
+    return false;
+  }
+
+  marked = runtime_nowNs();
+
+  // at least one batch, however long the mutators took to stop
+  do {
+    more = heap_markStep(r->heap, RUNTIME_GC_MARK_BATCH);
+    ++batches;
+  } while (more && runtime_nowNs() < deadline);
+
+  if (events_enabled) {
+    events_record(EVENTS_GC_MARK_STEP, marked, runtime_nowNs() - marked, batches * RUNTIME_GC_MARK_BATCH);
+  }
+
+  runtime_countPause(r, start);
+  heap_unlock(r->heap);
+
+  return true;
+}
+
+// what runtime_collect left to sweep, with the mutators running
+static void runtime_sweep(runtime_t *r) {
+  uint64_t start = runtime_nowNs();
+  size_t swept = 0;
+  bool more;
+
+  do {
+    size_t live;
+
+    heap_lock(r->heap);
+    live = r->heap->size;
+    more = heap_sweepStep(r, r->heap, HEAP_SWEEP_BATCH);
+    swept += live - r->heap->size;
+    heap_unlock(r->heap);
+  } while (more);
+
+  if (events_enabled && swept != 0) {
+    events_record(EVENTS_GC_SWEEP, start, runtime_nowNs() - start, swept);
+  }
+}
+
+// heap_finalize, on the thread that collected
+static void runtime_finalize(runtime_t *r) {
+  uint64_t start;
+  size_t finalized;
+
+  if (!events_enabled) {
+    heap_finalize(r, r->heap);
     return;
   }
+
+  start = runtime_nowNs();
+  finalized = r->heap->finalized;
+  heap_finalize(r, r->heap);
+  events_record(EVENTS_GC_FINALIZE, start, runtime_nowNs() - start, r->heap->finalized - finalized);
+}
+
+// whether a pause for heap_compact is worth it, once a full collection's
+// dead nodes are finalized and their blocks back in the slabs
+static bool runtime_shouldCompact(runtime_t *r) {
+  bool compact;
+
+  heap_lock(r->heap);
+  compact = heap_shouldCompact(r->heap);
+  heap_unlock(r->heap);
+
+  return compact;
+}
+
+// heap_compact, with the mutators stopped; the pause is counted from
+// `start`, as for runtime_collect
+static void runtime_compact(runtime_t *r, uint64_t start) {
+  uint64_t compacting, pause;
+  size_t moved;
+
+  // blocks this thread holds would keep their slabs
+  heap_flush(r->heap);
+  heap_lock(r->heap);
+
+  compacting = runtime_nowNs();
+  moved = heap_compact(r->heap);
+  pause = runtime_countPause(r, start);
+
+  if (events_enabled) {
+    events_record(EVENTS_GC_COMPACT, compacting, start + pause - compacting, moved);
+  }
+
+  heap_unlock(r->heap);
+}
+
+void runtime_gc(runtime_t *r) {
+  runtime_collect(r, true, runtime_nowNs());
+  runtime_sweep(r);
+  runtime_finalize(r);
+}
+
+void runtime_gcMinor(runtime_t *r) {
+  runtime_collect(r, false, runtime_nowNs());
+  runtime_sweep(r);
+  runtime_finalize(r);
+}
+
+void runtime_setGcBudget(runtime_t *r, uint64_t budgetNs) {
+  pthread_mutex_lock(&r->gcLock);
+  r->gcBudgetNs = budgetNs;
+  pthread_mutex_unlock(&r->gcLock);
+}
+
+void runtime_attach(runtime_t *r) {
+  pthread_mutex_lock(&r->gcLock);
+
+  // one started while no mutator was attached
+  while (atomic_load(&r->gcRequested)) {
+    pthread_cond_wait(&r->gcCond, &r->gcLock);
+  }
+
+  ++r->gcMutators;
+  pthread_mutex_unlock(&r->gcLock);
+}
+
+void runtime_detach(runtime_t *r) {
+  // the collector sweeps from its own thread
+  heap_flush(r->heap);
+
+  pthread_mutex_lock(&r->gcLock);
+  --r->gcMutators;
+  pthread_cond_broadcast(&r->gcCond);
+  pthread_mutex_unlock(&r->gcLock);
+}
+
+void runtime_park(runtime_t *r) {
+  heap_flush(r->heap);
+
+  pthread_mutex_lock(&r->gcLock);
+  ++r->gcParked;
+  pthread_cond_broadcast(&r->gcCond);
+
+  while (atomic_load(&r->gcRequested)) {
+    pthread_cond_wait(&r->gcCond, &r->gcLock);
+  }
+
+  --r->gcParked;
+  pthread_mutex_unlock(&r->gcLock);
+}
+
+// the node counts of both generations
+static void runtime_heapSize(runtime_t *r, size_t *old, size_t *young) {
+  heap_lock(r->heap);
+  *old = r->heap->size - r->heap->youngSize;
+  *young = r->heap->youngSize;
+  heap_unlock(r->heap);
+}
+
+// with gcLock held: requests a collection and waits for every mutator to
+// park. returns when it was requested, for the pause to be counted from.
+static uint64_t runtime_stopMutators(runtime_t *r) {
+  uint64_t start = runtime_nowNs();
+
+  atomic_store(&r->gcRequested, true);
+
+  while (r->gcParked < r->gcMutators) {
+    pthread_cond_wait(&r->gcCond, &r->gcLock);
+  }
+
+  if (events_enabled) {
+    events_record(EVENTS_GC_WAIT, start, runtime_nowNs() - start, 0);
+  }
+
+  return start;
+}
+
+// with gcLock held: lets the parked mutators run again
+static void runtime_resumeMutators(runtime_t *r) {
+  atomic_store(&r->gcRequested, false);
+  pthread_cond_broadcast(&r->gcCond);
+}
+
+// whether incremental marking is under way, see runtime_markBegin
+static bool runtime_marking(runtime_t *r) {
+  bool marking;
+
+  heap_lock(r->heap);
+  marking = r->heap->marking;
+  heap_unlock(r->heap);
+
+  return marking;
+}
+
+void runtime_collector(runtime_t *r) {
+  if (events_enabled) {
+    events_nameThread("collector");
+  }
+
+  pthread_mutex_lock(&r->gcLock);
+
+  while (!r->gcStop) {
+    struct timespec deadline;
+    size_t old, young;
+    uint64_t start;
+    bool full, marking, pressed, compact;
+
+    // between slices, the mutators run for at least as long as one takes
+    marking = runtime_marking(r);
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_nsec += marking ? (long)r->gcBudgetNs : RUNTIME_GC_INTERVAL_MS * 1000000L;
+    deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+    deadline.tv_nsec %= 1000000000L;
+
+    while (!r->gcStop && pthread_cond_timedwait(&r->gcCond, &r->gcLock, &deadline) != ETIMEDOUT);
+
+    if (r->gcStop) {
+      continue;
+    }
+
+    runtime_heapSize(r, &old, &young);
+    // past the soft memory limit, what can be given back is
+    pressed = r->quota != NULL && atomic_exchange(&r->quota->pressed, false);
+    full = marking || pressed || old >= r->gcThreshold;
+
+    if (!full && young < RUNTIME_GC_NURSERY_NODES) {
+      continue;
+    }
+
+    start = runtime_stopMutators(r);
+
+    if (!marking && full && r->gcBudgetNs != 0) {
+      runtime_markBegin(r, start);
+      runtime_resumeMutators(r);
+      continue;
+    }
+
+    if (marking && runtime_markStep(r, start)) {
+      runtime_resumeMutators(r);
+      continue;
+    }
+
+    runtime_collect(r, full, start);
+    runtime_resumeMutators(r);
+
+    // the mutators are running again by now
+    pthread_mutex_unlock(&r->gcLock);
+    runtime_sweep(r);
+    runtime_finalize(r);
+    heap_flush(r->heap);
+    runtime_heapSize(r, &old, &young);
+    // the pause it takes grows with the heap, not to be fit into a budget
+    compact = full && r->gcBudgetNs == 0 && (pressed || runtime_shouldCompact(r));
+    pthread_mutex_lock(&r->gcLock);
+
+    if (full) {
+      r->gcThreshold = old * 2 > RUNTIME_GC_MIN_NODES ? old * 2 : RUNTIME_GC_MIN_NODES;
+    }
+
+    // a pause of its own, as the finalized blocks tell whether it is needed
+    if (compact && !r->gcStop) {
+      runtime_compact(r, runtime_stopMutators(r));
+      runtime_resumeMutators(r);
+    }
+  }
+
+  pthread_mutex_unlock(&r->gcLock);
+}
+
+void runtime_stopCollector(runtime_t *r) {
+  pthread_mutex_lock(&r->gcLock);
+  r->gcStop = true;
+  pthread_cond_broadcast(&r->gcCond);
+  pthread_mutex_unlock(&r->gcLock);
+}
+
+void runtime_afterFork(runtime_t *r) {
+  size_t old, young;
+
+  runtime_heapSize(r, &old, &young);
+  heap_afterFork(r->heap);
+
+  r->gcStop = false;
+  r->gcMutators = 0;
+  r->gcParked = 0;
+  atomic_store(&r->gcRequested, false);
+  r->gcThreshold = old * 2 > RUNTIME_GC_MIN_NODES ? old * 2 : RUNTIME_GC_MIN_NODES;
+}
+
+void runtime_getStats(runtime_t *r, runtime_stats_t *out) {
+  heap_t *heap = r->heap;
+
+  heap_lock(heap);
+  out->nodesAllocated = heap->allocated;
+  out->nodesLive = heap->size;
+  out->nodesYoung = heap->youngSize;
+  out->nodesFinalized = heap->finalized;
+  out->nodesPending = heap->deadSize;
+  out->slabBytes = (heap->slab.numSlabs + heap->nodes.numSlabs) * SLAB_BYTES;
+
+  out->gcFullCount = r->gcFullCount;
+  out->gcMinorCount = r->gcMinorCount;
+  out->gcPauseTotalNs = r->gcPauseTotalNs;
+  out->gcPauseMaxNs = r->gcPauseMaxNs;
+  heap_unlock(heap);
+
+  out->stackResidentBytes = datatable_residentBytes(r->dt, AT_LOCAL);
+  out->staticDataResidentBytes = datatable_residentBytes(r->dt, AT_DATA);
+
+  out->memoryUsed = quota_used(r->quota);
+  out->memorySoft = r->quota != NULL ? r->quota->soft : 0;
+  out->memoryHard = r->quota != NULL ? r->quota->hard : 0;
+
+  out->rcAllocated = rc_allocated();
+
+  pthread_mutex_lock(&r->internLock);
+  out->internedStrings = r->interned.size;
+  out->internTableSize = r->interned.tableSize;
+  pthread_mutex_unlock(&r->internLock);
+}
+
+bool runtime_heapCensus(runtime_t *r, FILE *f, const char *graphPath, bool stop) {
+  FILE *graph = NULL;
+
+  if (graphPath != NULL && (graph = fopen(graphPath, "w")) == NULL) {
+    fprintf(stderr, "could not write %s\n", graphPath);
+    return false;
+  }
+
+  if (stop) {
+    pthread_mutex_lock(&r->gcLock);
+    runtime_stopMutators(r);
+  } else {
+    heap_flush(r->heap);
+  }
+
+  heap_lock(r->heap);
+  census_write(r, f, graph);
+  heap_unlock(r->heap);
+
+  if (stop) {
+    runtime_resumeMutators(r);
+    pthread_mutex_unlock(&r->gcLock);
+  }
+
+  if (graph != NULL) {
+    fclose(graph);
+  }
+
+  return true;
+}
+
+bool runtime_throwException(runtime_t *r, exception_t *e) {
+  runtime_catch_t *c = r->catcher;
+  storage_t *stack = &r->dt->storage[AT_LOCAL];
+  uint64_t pc = VM_PROGRAM_COUNTER(r->dt);
+  uint64_t fp = VM_FRAME_POINTER(r->dt);
+  uint64_t top = *stack->lenVal;
+
+  // a program without regions pays nothing more than this
+  if (c == NULL || c->image->numTries == 0) {
+    return false;
+  }
+
+  // nothing is unwound before a handler is known to be there. a frame's
+  // $f[-2] is where its call returns to, $f[-1] the caller's frame pointer.
+  while (!image_findTry(c->image, pc, &c->region)) {
+    if (fp < 2 || fp > top) {
+      return false; // the outermost frame
+    }
+
+    top = fp - 2;
+    pc = stack->data[fp - 2].data.u64;
+    fp = stack->data[fp - 1].data.u64;
+  }
+
+  c->exception = *e;
+  c->fp = fp;
+  c->top = top;
+  c->pc = pc;
+
+  longjmp(c->env, 1);
+}
+
+void runtime_fatal(runtime_t *r, int status, const char *fmt, ...) {
+  runtime_fatal_t *f = r->fatal;
+  va_list ap;
+
+  output_flush(&r->output);
+
+  if (f == NULL) {
+    if (fmt != NULL) {
+      va_start(ap, fmt);
+      vfprintf(stderr, fmt, ap);
+      va_end(ap);
+      fputc('\n', stderr);
+    }
+
+    exit(status);
+  }
+
+  f->status = status;
+  f->message[0] = '\0';
+
+  if (fmt != NULL) {
+    va_start(ap, fmt);
+    vsnprintf(f->message, sizeof(f->message), fmt, ap);
+    va_end(ap);
+  }
+
+  // the frames of the run are gone
+  r->catcher = NULL;
+  longjmp(f->env, 1);
 }
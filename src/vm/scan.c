@@ -0,0 +1,352 @@
+#include <vm/scan.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(__SSE2__)
+  #include <emmintrin.h>
+  #define SCAN_SSE2 1
+#elif defined(__ARM_NEON)
+  #include <arm_neon.h>
+  #define SCAN_NEON 1
+#endif
+
+#if SCAN_SSE2
+
+// 0xFF in each lane where lo <= v <= lo + n, wrapping so that a byte below
+// `lo` compares as a large one
+static inline __m128i scan_range(__m128i v, char lo, char n) {
+  __m128i t = _mm_sub_epi8(v, _mm_set1_epi8(lo));
+
+  return _mm_cmpeq_epi8(_mm_min_epu8(t, _mm_set1_epi8(n)), t);
+}
+
+static inline __m128i scan_eq(__m128i v, char c) {
+  return _mm_cmpeq_epi8(v, _mm_set1_epi8(c));
+}
+
+// the lanes of `v` in the class, as scan_inClass
+static inline __m128i scan_classify(__m128i v, int cls) {
+  switch (cls) {
+    case BUILTIN_SCAN_SPACE:
+      return _mm_or_si128(scan_eq(v, ' '), scan_range(v, '\t', '\r' - '\t'));
+    case BUILTIN_SCAN_DIGIT:
+      return scan_range(v, '0', 9);
+    case BUILTIN_SCAN_IDENT:
+      return _mm_or_si128(_mm_or_si128(scan_range(v, '0', 9), scan_eq(v, '_')),
+                          scan_range(_mm_or_si128(v, _mm_set1_epi8(0x20)), 'a', 25));
+    case BUILTIN_SCAN_STRING_END:
+      return _mm_or_si128(_mm_or_si128(scan_eq(v, '"'), scan_eq(v, '\\')), scan_eq(v, '\n'));
+    default:
+      return _mm_setzero_si128();
+  }
+}
+
+#elif SCAN_NEON
+
+static inline uint8x16_t scan_range(uint8x16_t v, uint8_t lo, uint8_t n) {
+  return vcleq_u8(vsubq_u8(v, vdupq_n_u8(lo)), vdupq_n_u8(n));
+}
+
+static inline uint8x16_t scan_eq(uint8x16_t v, uint8_t c) {
+  return vceqq_u8(v, vdupq_n_u8(c));
+}
+
+static inline uint8x16_t scan_classify(uint8x16_t v, int cls) {
+  switch (cls) {
+    case BUILTIN_SCAN_SPACE:
+      return vorrq_u8(scan_eq(v, ' '), scan_range(v, '\t', '\r' - '\t'));
+    case BUILTIN_SCAN_DIGIT:
+      return scan_range(v, '0', 9);
+    case BUILTIN_SCAN_IDENT:
+      return vorrq_u8(vorrq_u8(scan_range(v, '0', 9), scan_eq(v, '_')),
+                      scan_range(vorrq_u8(v, vdupq_n_u8(0x20)), 'a', 25));
+    case BUILTIN_SCAN_STRING_END:
+      return vorrq_u8(vorrq_u8(scan_eq(v, '"'), scan_eq(v, '\\')), scan_eq(v, '\n'));
+    default:
+      return vdupq_n_u8(0);
+  }
+}
+
+#endif
+
+size_t scan_find(const uint8_t *data, size_t len, int cls, bool match) {
+  size_t i = 0;
+
+#if SCAN_SSE2
+  for (; i + 16 <= len; i += 16) {
+    unsigned mask = (unsigned)_mm_movemask_epi8(scan_classify(_mm_loadu_si128((const __m128i*)(data + i)), cls));
+
+    if (!match) {
+      mask = ~mask & 0xFFFF;
+    }
+
+    if (mask != 0) {
+      return i + (size_t)__builtin_ctz(mask);
+    }
+  }
+#elif SCAN_NEON
+  for (; i + 16 <= len; i += 16) {
+    uint8x16_t m = scan_classify(vld1q_u8(data + i), cls);
+    uint64_t mask;
+
+    if (!match) {
+      m = vmvnq_u8(m);
+    }
+
+    // narrowed to 4 bits per lane, as there is no movemask
+    mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(m), 4)), 0);
+
+    if (mask != 0) {
+      return i + (size_t)(__builtin_ctzll(mask) >> 2);
+    }
+  }
+#endif
+
+  for (; i < len; i++) {
+    if (scan_inClass(data[i], cls) == match) {
+      return i;
+    }
+  }
+
+  return len;
+}
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  #define SCAN_SWAR 1
+#endif
+
+// the value of eight ascii digits at `data`, false if they are not all
+// digits. fast_float's conversion: pairs, then quads, then the two halves.
+static inline bool scan_eightDigits(const uint8_t *data, uint64_t *out) {
+#if SCAN_SWAR
+  uint64_t v;
+
+  memcpy(&v, data, sizeof(v));
+
+  if (((v & 0xF0F0F0F0F0F0F0F0) | (((v + 0x0606060606060606) & 0xF0F0F0F0F0F0F0F0) >> 4)) != 0x3333333333333333) {
+    return false;
+  }
+
+  v -= 0x3030303030303030;
+  v = v * 10 + (v >> 8);
+  *out = (((v & 0x000000FF000000FF) * (100 + (1000000ULL << 32))) +
+          (((v >> 16) & 0x000000FF000000FF) * (1 + (10000ULL << 32)))) >> 32;
+
+  return true;
+#else
+  (void)data;
+  (void)out;
+  return false;
+#endif
+}
+
+bool scan_parseInt(const uint8_t *data, size_t len, int64_t *out) {
+  size_t i = 0;
+  bool negative = false;
+  uint64_t value = 0;
+  uint64_t chunk;
+
+  if (len != 0 && (data[0] == '-' || data[0] == '+')) {
+    negative = data[0] == '-';
+    i = 1;
+  }
+
+  if (i == len) {
+    return false;
+  }
+
+  // leading zeros but the last, so that 19 digits are left at most: any
+  // number of them fits in 64 bits unsigned
+  while (i + 1 < len && data[i] == '0') {
+    i++;
+  }
+
+  if (len - i > 19) {
+    return false;
+  }
+
+  while (len - i >= 8 && scan_eightDigits(data + i, &chunk)) {
+    value = value * 100000000 + chunk;
+    i += 8;
+  }
+
+  for (; i < len; i++) {
+    uint8_t digit = (uint8_t)(data[i] - '0');
+
+    if (digit > 9) {
+      return false;
+    }
+
+    value = value * 10 + digit;
+  }
+
+  if (value > (uint64_t)INT64_MAX + negative) {
+    return false;
+  }
+
+  *out = negative ? (int64_t)(0 - value) : (int64_t)value;
+
+  return true;
+}
+
+// the decimal digits from data[i] into `*mantissa` while it has fewer
+// than 19 significant ones, counting those that did not fit in `*dropped`
+// and whether any of them was not a zero in `*inexact`. the index of the
+// first byte after them.
+static size_t scan_mantissa(const uint8_t *data, size_t len, size_t i, uint64_t *mantissa, int *significant, int64_t *dropped, bool *inexact) {
+  uint64_t chunk;
+
+  for (; i < len; i++) {
+    uint8_t digit = (uint8_t)(data[i] - '0');
+
+    if (digit > 9) {
+      break;
+    }
+
+    if (*mantissa != 0 && *significant <= 11 && len - i >= 8 && scan_eightDigits(data + i, &chunk)) {
+      *mantissa = *mantissa * 100000000 + chunk;
+      *significant += 8;
+      i += 7;
+    } else if (*significant < 19) {
+      // leading zeros are not significant
+      *mantissa = *mantissa * 10 + digit;
+      *significant += *mantissa != 0;
+    } else {
+      ++*dropped;
+      *inexact |= digit != 0;
+    }
+  }
+
+  return i;
+}
+
+static bool scan_isWord(const uint8_t *data, size_t len, const char *word) {
+  for (size_t i = 0; i < len; i++) {
+    if (word[i] == '\0' || (data[i] | 0x20) != word[i]) {
+      return false;
+    }
+  }
+
+  return word[len] == '\0';
+}
+
+bool scan_parseDouble(const uint8_t *data, size_t len, double *out) {
+  // the powers of ten a double holds exactly
+  static const double powers[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+  };
+  size_t i = 0;
+  size_t start;
+  bool negative = false;
+  uint64_t mantissa = 0;
+  int significant = 0;
+  int64_t dropped = 0;
+  bool inexact = false;
+  int64_t exponent;
+  size_t digits;
+  double value;
+
+  if (len != 0 && (data[0] == '-' || data[0] == '+')) {
+    negative = data[0] == '-';
+    i = 1;
+  }
+
+  if (scan_isWord(data + i, len - i, "inf") || scan_isWord(data + i, len - i, "infinity")) {
+    *out = negative ? -HUGE_VAL : HUGE_VAL;
+    return true;
+  }
+
+  if (scan_isWord(data + i, len - i, "nan")) {
+    *out = negative ? -NAN : NAN;
+    return true;
+  }
+
+  start = i;
+  i = scan_mantissa(data, len, i, &mantissa, &significant, &dropped, &inexact);
+  digits = i - start;
+  exponent = dropped;
+
+  if (i < len && data[i] == '.') {
+    start = ++i;
+    dropped = 0;
+    i = scan_mantissa(data, len, i, &mantissa, &significant, &dropped, &inexact);
+    digits += i - start;
+    exponent -= (int64_t)(i - start) - dropped;
+  }
+
+  if (digits == 0) {
+    return false;
+  }
+
+  if (i < len && (data[i] | 0x20) == 'e') {
+    bool negativeExponent = false;
+    int64_t e = 0;
+
+    if (++i < len && (data[i] == '-' || data[i] == '+')) {
+      negativeExponent = data[i++] == '-';
+    }
+
+    start = i;
+
+    for (; i < len && (uint8_t)(data[i] - '0') <= 9; i++) {
+      // past any double's, as far as it matters
+      if (e < 100000) {
+        e = e * 10 + (data[i] - '0');
+      }
+    }
+
+    if (i == start) {
+      return false;
+    }
+
+    exponent += negativeExponent ? -e : e;
+  }
+
+  if (i != len) {
+    return false;
+  }
+
+  if (!inexact && mantissa <= (1ULL << 53)) {
+    value = (double)mantissa;
+
+    if (mantissa == 0) {
+      *out = negative ? -0.0 : 0.0;
+      return true;
+    }
+
+    // a mantissa small enough to take some of the exponent exactly
+    if (exponent > 22 && exponent <= 22 + 15 && mantissa <= (1ULL << 53) / (uint64_t)powers[exponent - 22]) {
+      value = (double)(mantissa * (uint64_t)powers[exponent - 22]);
+      exponent = 22;
+    }
+
+    if (exponent >= -22 && exponent <= 22) {
+      value = exponent < 0 ? value / powers[-exponent] : value * powers[exponent];
+      *out = negative ? -value : value;
+      return true;
+    }
+  }
+
+  // correctly rounded, of the text checked above
+  {
+    char buf[64];
+    char *str = len < sizeof(buf) ? buf : (char*)malloc(len + 1);
+
+    if (str == NULL) {
+      return false;
+    }
+
+    memcpy(str, data, len);
+    str[len] = '\0';
+    *out = strtod(str, NULL);
+
+    if (str != buf) {
+      free(str);
+    }
+  }
+
+  return true;
+}
@@ -0,0 +1,66 @@
+#include <vm/scratch.h>
+#include <vm/object.h>
+#include <vm/value.h>
+
+#include <stdlib.h>
+
+void scratch_init(scratch_t *scratch) {
+  scratch->nodes = NULL;
+  scratch->len = 0;
+  scratch->size = 0;
+}
+
+void scratch_destroy(scratch_t *scratch) {
+  scratch_release(scratch);
+
+  for (size_t i = 0; i < scratch->size; i++) {
+    free(scratch->nodes[i]);
+  }
+
+  free(scratch->nodes);
+  scratch_init(scratch);
+}
+
+value_t scratch_alloc(scratch_t *scratch, heap_t *heap) {
+  value_t v;
+
+  if (scratch->len == scratch->size) {
+    size_t size = scratch->size == 0 ? 16 : scratch->size * 2;
+
+    scratch->nodes = (heap_value_t**)realloc(scratch->nodes, size * sizeof(heap_value_t*));
+
+    for (size_t i = scratch->size; i < size; i++) {
+      scratch->nodes[i] = (heap_value_t*)calloc(1, sizeof(heap_value_t));
+    }
+
+    scratch->size = size;
+  }
+
+  v.data.hv = scratch->nodes[scratch->len++];
+  VALUE_SET_META(&v, TYPE_POINTER, FLAG_OBJECT);
+
+  v.data.hv->ptr = object_create(heap);
+  v.data.hv->dtor_ptr = (native_function_t)object_destructor;
+  v.data.hv->flags = 0;
+  v.data.hv->kind = HEAP_KIND_OBJECT;
+
+  return v;
+}
+
+void scratch_release(scratch_t *scratch) {
+  for (size_t i = 0; i < scratch->len; i++) {
+    heap_value_t *hv = scratch->nodes[i];
+
+    object_destroy((object_t*)hv->ptr);
+    hv->ptr = NULL;
+  }
+
+  scratch->len = 0;
+}
+
+void scratch_unmark(scratch_t *scratch) {
+  // released nodes too, stale values may still reach them
+  for (size_t i = 0; i < scratch->size; i++) {
+    scratch->nodes[i]->flags &= ~FLAG_MARKED;
+  }
+}
@@ -0,0 +1,617 @@
+#include <vm/serial.h>
+#include <vm/runtime.h>
+#include <vm/heap.h>
+#include <vm/builtins.h>
+#include <vm/object.h>
+#include <vm/array.h>
+#include <vm/map.h>
+#include <vm/util.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+// ===== writing =====
+
+typedef struct serial_writer {
+  runtime_t *rt;
+  ubyte_t *out; // NULL while sizing
+  size_t len;
+  idmap_t items; // buffers and nodes share the table; their pointers differ
+  idmap_t keys;
+  uint64_t numItems;
+  uint64_t numKeys;
+  const shape_t *shape; // of the last shaped object written, whose keys are all written
+  uint32_t shapeKeys[SHAPE_MAX_MEMBERS]; // their indices, in slot order
+  heap_value_t **queue; // nodes whose contents are not written yet, in the order found
+  size_t queueLen;
+  size_t queueSize;
+} serial_writer_t;
+
+static void serial_put(serial_writer_t *w, const void *data, size_t len) {
+  if (w->out != NULL) {
+    memcpy(w->out + w->len, data, len);
+  }
+
+  w->len += len;
+}
+
+static void serial_putTag(serial_writer_t *w, uint8_t tag) {
+  serial_put(w, &tag, sizeof(tag));
+}
+
+// `len` bytes after a u32 length: a map key, a member name or copied data
+static void serial_putBytes(serial_writer_t *w, const void *data, size_t len) {
+  uint32_t size = (uint32_t)len;
+
+  serial_put(w, &size, sizeof(size));
+  serial_put(w, data, size);
+}
+
+// a member name: its index, and the name the first time
+static uint32_t serial_putKey(serial_writer_t *w, object_key_t key) {
+  bool added;
+  uint32_t index = (uint32_t)idmap_id(&w->keys, key, w->numKeys, &added);
+
+  serial_put(w, &index, sizeof(index));
+
+  if (added) {
+    ++w->numKeys;
+    serial_putBytes(w, key, strlen(key));
+  }
+
+  return index;
+}
+
+// the index of `ptr`, true if it is written for the first time
+static bool serial_item(serial_writer_t *w, const void *ptr) {
+  bool added;
+  uint64_t index = idmap_id(&w->items, ptr, w->numItems, &added);
+
+  if (!added) {
+    serial_putTag(w, SERIAL_REF);
+    serial_put(w, &index, sizeof(index));
+    return false;
+  }
+
+  ++w->numItems;
+
+  return true;
+}
+
+static void serial_putNode(serial_writer_t *w, heap_value_t *hv) {
+  uint8_t kinds[2] = { (uint8_t)hv->kind, 0 };
+  uint64_t count;
+
+  if (!serial_item(w, hv)) {
+    return;
+  }
+
+  switch (hv->kind) {
+    case HEAP_KIND_ARRAY:
+      kinds[1] = (uint8_t)((array_t*)hv->ptr)->kind;
+      count = ((array_t*)hv->ptr)->size;
+      break;
+    case HEAP_KIND_MAP:
+      count = ((map_t*)hv->ptr)->size;
+      break;
+    default: {
+      object_t *object = (object_t*)hv->ptr;
+      count = object->shape != NULL ? object->shape->count : object->size;
+      break;
+    }
+  }
+
+  serial_putTag(w, SERIAL_NODE);
+  serial_put(w, kinds, sizeof(kinds));
+  serial_put(w, &count, sizeof(count));
+
+  if (w->queueLen == w->queueSize) {
+    w->queueSize = w->queueSize != 0 ? w->queueSize * 2 : 64;
+    w->queue = (heap_value_t**)realloc(w->queue, w->queueSize * sizeof(heap_value_t*));
+  }
+
+  w->queue[w->queueLen++] = hv;
+}
+
+static void serial_putValue(serial_writer_t *w, value_t *v) {
+  VALUE_TYPE type = VALUE_TYPE_OF(v);
+  VALUE_FLAGS flags = value_getFlags(v);
+
+  if (type == TYPE_FUNCTION) {
+    int slot = builtins_slotOf(v->data.fn);
+    uint32_t index = (uint32_t)slot;
+
+    if (slot < 0) {
+      serial_putTag(w, SERIAL_NONE);
+      return;
+    }
+
+    serial_putTag(w, SERIAL_BUILTIN);
+    serial_put(w, &index, sizeof(index));
+  } else if (type != TYPE_POINTER || (flags & FLAG_INLINE)) {
+    metadata_t metadata = VALUE_META(v);
+
+    serial_putTag(w, SERIAL_BITS);
+    serial_put(w, &metadata, sizeof(metadata));
+    serial_put(w, &v->data.u64, sizeof(v->data.u64));
+  } else if (v->data.raw == NULL) {
+    serial_putTag(w, SERIAL_NONE);
+  } else if (flags & FLAG_OBJECT) {
+    if (flags & (FLAG_STREAM | FLAG_AIO | FLAG_TASK | FLAG_CHANNEL | FLAG_CACHE)) {
+      serial_putTag(w, SERIAL_NONE);
+    } else {
+      serial_putNode(w, v->data.hv);
+    }
+  } else if (VALUE_IS_SLICE(v)) {
+    // bytes of its own, as in a snapshot
+    serial_putTag(w, SERIAL_BYTES);
+    serial_putBytes(w, value_getRawPointer(v), VALUE_SLICE_LENGTH(v));
+  } else if (flags & FLAG_REFCOUNTED) {
+    uint64_t size = rc_size(v->data.rc);
+
+    if (serial_item(w, v->data.raw)) {
+      serial_putTag(w, SERIAL_BUFFER);
+      serial_put(w, &size, sizeof(size));
+      serial_put(w, v->data.raw, size);
+    }
+  } else if (flags & FLAG_CONST) {
+    // with the NUL, for it to stay a string
+    serial_putTag(w, SERIAL_BYTES);
+    serial_putBytes(w, v->data.raw, strlen((const char*)v->data.raw) + 1);
+  } else {
+    serial_putTag(w, SERIAL_NONE);
+  }
+}
+
+static void serial_putContents(serial_writer_t *w, heap_value_t *hv) {
+  switch (hv->kind) {
+    case HEAP_KIND_ARRAY: {
+      array_t *array = (array_t*)hv->ptr;
+
+      if (array->kind == ARRAY_VALUES) {
+        for (size_t i = 0; i < array->size; i++) {
+          serial_putValue(w, &((value_t*)array->data)[i]);
+        }
+      } else {
+        serial_put(w, array->data, array->size * array_elementSize(array->kind));
+      }
+
+      break;
+    }
+    case HEAP_KIND_MAP: {
+      map_t *map = (map_t*)hv->ptr;
+
+      for (size_t i = 0; i < map->capacity; i++) {
+        if (!(map->ctrl[i] & 0x80)) {
+          serial_putBytes(w, map->entries[i].key, map->entries[i].len);
+          serial_putValue(w, &map->entries[i].value);
+        }
+      }
+
+      break;
+    }
+    default: {
+      object_t *object = (object_t*)hv->ptr;
+
+      if (object->shape != NULL && object->shape == w->shape) {
+        // records of one shape, the common case: their keys are known
+        for (uint32_t i = 0; i < object->shape->count; i++) {
+          serial_put(w, &w->shapeKeys[i], sizeof(uint32_t));
+          serial_putValue(w, &object->slots[i]);
+        }
+      } else if (object->shape != NULL) {
+        // in slot order, so putting them back gives the same shape
+        object_key_t keys[SHAPE_MAX_MEMBERS];
+
+        for (const shape_t *s = object->shape; s->parent != NULL; s = s->parent) {
+          keys[s->slot] = s->key;
+        }
+
+        for (uint32_t i = 0; i < object->shape->count; i++) {
+          w->shapeKeys[i] = serial_putKey(w, keys[i]);
+          serial_putValue(w, &object->slots[i]);
+        }
+
+        w->shape = object->shape;
+      } else {
+        for (size_t i = 0; i < object->numMembers; i++) {
+          if (object->members[i].used) {
+            serial_putKey(w, object->members[i].key);
+            serial_putValue(w, &object->members[i].value);
+          }
+        }
+      }
+
+      break;
+    }
+  }
+}
+
+// the whole graph from `v`, into w->out if it is set
+static void serial_walk(serial_writer_t *w, value_t *v) {
+  serial_header_t header = { .version = SERIAL_VERSION, .numItems = w->numItems, .numKeys = w->numKeys };
+
+  memcpy(header.magic, SERIAL_MAGIC, sizeof(header.magic));
+
+  w->len = 0;
+  w->queueLen = 0;
+  w->numItems = 0;
+  w->numKeys = 0;
+  w->shape = NULL;
+  idmap_clear(&w->items);
+  idmap_clear(&w->keys);
+
+  serial_put(w, &header, sizeof(header));
+  serial_putValue(w, v);
+
+  // the queue grows as the contents find new nodes
+  for (size_t i = 0; i < w->queueLen; i++) {
+    serial_putContents(w, w->queue[i]);
+  }
+}
+
+refcounted_t serial_write(runtime_t *rt, value_t *v) {
+  serial_writer_t w = { .rt = rt };
+  refcounted_t rc;
+
+  // sized first, then written in place; the second walk finds the same
+  // nodes in the same order, and puts the counts of the first in the header
+  serial_walk(&w, v);
+
+  if ((rc = rc_alloc(rt->quota, w.len, runtime_site(rt))) != NULL) {
+    w.out = (ubyte_t*)rc;
+    serial_walk(&w, v);
+  }
+
+  idmap_destroy(&w.items);
+  idmap_destroy(&w.keys);
+  free(w.queue);
+
+  return rc;
+}
+
+// ===== reading =====
+
+typedef struct serial_reader {
+  runtime_t *rt;
+  const ubyte_t *data;
+  size_t len;
+  size_t pos;
+  const serial_header_t *header;
+  value_t *items; // holding a reference to each buffer
+  uint64_t *counts; // of each node, from its record
+  uint64_t numItems;
+  object_key_t *keys;
+  uint64_t numKeys;
+  shape_t *path[SHAPE_MAX_MEMBERS]; // the shapes the last object went through
+} serial_reader_t;
+
+// the next `len` bytes, NULL if the data ends first
+static const ubyte_t *serial_get(serial_reader_t *r, size_t len) {
+  const ubyte_t *p = r->data + r->pos;
+
+  if (len > r->len - r->pos) {
+    return NULL;
+  }
+
+  r->pos += len;
+
+  return p;
+}
+
+#define SERIAL_GET(r, out) serial_getInto(r, &(out), sizeof(out))
+
+static bool serial_getInto(serial_reader_t *r, void *out, size_t len) {
+  const ubyte_t *p = serial_get(r, len);
+
+  if (p == NULL) {
+    return false;
+  }
+
+  memcpy(out, p, len);
+
+  return true;
+}
+
+static const char *serial_getBytes(serial_reader_t *r, size_t *len) {
+  uint32_t size;
+
+  if (!SERIAL_GET(r, size)) {
+    return NULL;
+  }
+
+  *len = size;
+
+  return (const char*)serial_get(r, size);
+}
+
+static object_key_t serial_getKey(serial_reader_t *r) {
+  uint32_t index;
+  const char *name;
+  size_t len;
+
+  if (!SERIAL_GET(r, index) || index > r->numKeys || index >= r->header->numKeys) {
+    return NULL;
+  }
+
+  if (index < r->numKeys) {
+    return r->keys[index];
+  }
+
+  if ((name = serial_getBytes(r, &len)) == NULL) {
+    return NULL;
+  }
+
+  return r->keys[r->numKeys++] = (object_key_t)runtime_intern(r->rt, name, len);
+}
+
+// a new item, `v`, which the reader holds
+static bool serial_addItem(serial_reader_t *r, value_t *v, uint64_t count) {
+  if (r->numItems == r->header->numItems) {
+    value_release(r->rt, v);
+    return false;
+  }
+
+  r->counts[r->numItems] = count;
+  r->items[r->numItems++] = *v;
+
+  return true;
+}
+
+// the value of a record, owning a reference to its buffer if it has one
+static bool serial_getValue(serial_reader_t *r, value_t *out) {
+  uint8_t tag;
+
+  VALUE_SET_META(out, TYPE_NONE, FLAG_NONE);
+  out->data.u64 = 0;
+
+  if (!SERIAL_GET(r, tag)) {
+    return false;
+  }
+
+  switch (tag) {
+    case SERIAL_NONE:
+      return true;
+    case SERIAL_BITS: {
+      metadata_t metadata;
+
+      if (!SERIAL_GET(r, metadata) || !SERIAL_GET(r, out->data.u64)) {
+        return false;
+      }
+
+      // no pointer but inline data, which refers to nothing
+      VALUE_META(out) = metadata;
+
+      if (VALUE_TYPE_OF(out) == TYPE_POINTER && !VALUE_IS(out, TYPE_POINTER, FLAG_INLINE)) {
+        VALUE_SET_META(out, TYPE_NONE, FLAG_NONE);
+        return false;
+      }
+
+      return VALUE_TYPE_OF(out) != TYPE_FUNCTION;
+    }
+    case SERIAL_BYTES: {
+      size_t len;
+      const char *bytes = serial_getBytes(r, &len);
+
+      if (bytes == NULL) {
+        return false;
+      }
+
+      value_setData(r->rt, out, bytes, len);
+      return true;
+    }
+    case SERIAL_BUFFER: {
+      uint64_t size;
+      const ubyte_t *bytes;
+      refcounted_t rc;
+      value_t item;
+
+      if (!SERIAL_GET(r, size) || (bytes = serial_get(r, size)) == NULL
+          || (rc = rc_alloc(r->rt->quota, size, runtime_site(r->rt))) == NULL) {
+        return false;
+      }
+
+      memcpy(rc, bytes, size);
+      VALUE_SET_META(&item, TYPE_NONE, FLAG_NONE);
+      value_setRefCounted(r->rt, &item, rc);
+
+      if (!serial_addItem(r, &item, 0)) {
+        return false;
+      }
+
+      value_copyValue(r->rt, out, &item);
+      return true;
+    }
+    case SERIAL_NODE: {
+      uint8_t kinds[2];
+      uint64_t count;
+      value_t item;
+
+      if (!SERIAL_GET(r, kinds) || !SERIAL_GET(r, count) || count > r->len) {
+        return false;
+      }
+
+      if (kinds[0] == HEAP_KIND_ARRAY && kinds[1] <= ARRAY_BYTES) {
+        item = value_createArray(r->rt, r->rt->heap, (ARRAY_KIND)kinds[1], (size_t)count);
+      } else if (kinds[0] == HEAP_KIND_MAP) {
+        item = value_createMap(r->rt, r->rt->heap);
+      } else if (kinds[0] == HEAP_KIND_OBJECT) {
+        item = value_createObjectWithCapacity(r->rt, r->rt->heap, (uint32_t)count);
+      } else {
+        return false;
+      }
+
+      if (!serial_addItem(r, &item, count)) {
+        return false;
+      }
+
+      *out = item;
+      return true;
+    }
+    case SERIAL_REF: {
+      uint64_t index;
+
+      if (!SERIAL_GET(r, index) || index >= r->numItems) {
+        return false;
+      }
+
+      value_copyValue(r->rt, out, &r->items[index]);
+      return true;
+    }
+    case SERIAL_BUILTIN: {
+      uint32_t slot;
+
+      if (!SERIAL_GET(r, slot) || (out->data.fn = builtins_function(slot)) == NULL) {
+        return false;
+      }
+
+      VALUE_SET_META(out, TYPE_FUNCTION, FLAG_NONE);
+      return true;
+    }
+    default:
+      return false;
+  }
+}
+
+// the members, elements or entries of `node`, `count` of them as its
+// record said
+static bool serial_getContents(serial_reader_t *r, value_t *node, uint64_t count) {
+  heap_value_t *hv = node->data.hv;
+  heap_t *heap = r->rt->heap;
+
+  switch (hv->kind) {
+    case HEAP_KIND_ARRAY: {
+      array_t *array = (array_t*)hv->ptr;
+      const ubyte_t *p;
+
+      if (array->kind != ARRAY_VALUES) {
+        const size_t elementSize = array_elementSize(array->kind);
+
+        if (count > SIZE_MAX / elementSize || (p = serial_get(r, count * elementSize)) == NULL
+            || !array_resize(array, count)) {
+          return false;
+        }
+
+        memcpy(array->data, p, count * elementSize);
+        return true;
+      }
+
+      if (!array_resize(array, count)) {
+        return false;
+      }
+
+      // moved in rather than copied: the array takes over the references
+      for (uint64_t i = 0; i < count; i++) {
+        if (!serial_getValue(r, &((value_t*)array->data)[i])) {
+          return false;
+        }
+
+        heap_writeBarrier(heap, hv, &((value_t*)array->data)[i]);
+      }
+
+      return true;
+    }
+    case HEAP_KIND_MAP: {
+      map_t *map = (map_t*)hv->ptr;
+
+      for (uint64_t i = 0; i < count; i++) {
+        size_t len;
+        const char *key = serial_getBytes(r, &len);
+        value_t value;
+        bool ok;
+
+        if (key == NULL || !serial_getValue(r, &value)) {
+          return false;
+        }
+
+        ok = map_set(r->rt, map, key, len, &value);
+        heap_writeBarrier(heap, hv, &value);
+        value_release(r->rt, &value);
+
+        if (!ok) {
+          return false;
+        }
+      }
+
+      return true;
+    }
+    default: {
+      object_t *object = (object_t*)hv->ptr;
+
+      for (uint64_t i = 0; i < count; i++) {
+        object_key_t key = serial_getKey(r);
+        value_t value;
+
+        if (key == NULL || !serial_getValue(r, &value)) {
+          return false;
+        }
+
+        // the object takes over the reference, as with setObjectMember.
+        // the next shape is most often the one the last object went to
+        if (i < SHAPE_MAX_MEMBERS && r->path[i] != NULL && r->path[i]->parent == object->shape
+            && r->path[i]->key == key) {
+          object_addSlot(object, r->path[i], &value);
+        } else if (object_put(object, key, &value) != OBJECT_OK) {
+          value_release(r->rt, &value);
+          return false;
+        } else if (i < SHAPE_MAX_MEMBERS) {
+          r->path[i] = object->shape;
+        }
+
+        heap_writeBarrier(heap, hv, &value);
+      }
+
+      return true;
+    }
+  }
+}
+
+bool serial_read(runtime_t *rt, const ubyte_t *data, size_t len, value_t *out) {
+  serial_reader_t r = { .rt = rt, .data = data, .len = len };
+  serial_header_t header;
+  bool ok = false;
+
+  VALUE_SET_META(out, TYPE_NONE, FLAG_NONE);
+  out->data.u64 = 0;
+
+  // every item takes up at least 9 bytes and every key 8, which bounds these
+  if (!SERIAL_GET(&r, header) || memcmp(header.magic, SERIAL_MAGIC, sizeof(header.magic)) != 0
+      || header.version != SERIAL_VERSION || header.numItems > len / 9 || header.numKeys > len / 8) {
+    return false;
+  }
+
+  r.header = &header;
+  r.items = (value_t*)calloc(header.numItems + 1, sizeof(value_t));
+  r.counts = (uint64_t*)malloc((header.numItems + 1) * sizeof(uint64_t));
+  r.keys = (object_key_t*)malloc((header.numKeys + 1) * sizeof(object_key_t));
+
+  if (!serial_getValue(&r, out)) {
+    goto done;
+  }
+
+  // the contents of the nodes follow in the order they were found, which
+  // is their index; reading them finds the rest
+  for (uint64_t i = 0; i < r.numItems; i++) {
+    if (VALUE_HAS(&r.items[i], TYPE_POINTER, FLAG_OBJECT) && !serial_getContents(&r, &r.items[i], r.counts[i])) {
+      goto done;
+    }
+  }
+
+  ok = r.pos == len;
+
+done:
+  for (uint64_t i = 0; i < r.numItems; i++) {
+    value_release(rt, &r.items[i]);
+  }
+
+  free(r.items);
+  free(r.counts);
+  free(r.keys);
+
+  if (!ok) {
+    value_release(rt, out);
+    VALUE_SET_META(out, TYPE_NONE, FLAG_NONE);
+  }
+
+  return ok;
+}
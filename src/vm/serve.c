@@ -0,0 +1,1218 @@
+#include <vm/serve.h>
+
+#if SERVE_SUPPORTED
+
+#include <vm/runtime.h>
+#include <vm/interpreter.h>
+#include <vm/builtins.h>
+#include <vm/program.h>
+#include <vm/util.h>
+
+#include <shared/bin_format.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <signal.h>
+#include <time.h>
+#include <setjmp.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <poll.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+// a program the server loaded, kept until it exits. its index is the same
+// for every worker, which keeps an interpreter for it on its runtime.
+// when the file for `name` is replaced, the new one is loaded in its place
+// (see serve_program), and the old version is retired. one a coordinator
+// sent has "#<hash>" for its name, its content hash, and is never
+// replaced, see serve_put.
+typedef struct {
+  char *name;
+  ubyte_t *data;
+  size_t len;
+  bool mapped; // `data` is a mapping of the file, else allocated
+  program_t *program; // the server's reference
+  // the file last loaded, or found not to be an image, from its stat
+  dev_t dev;
+  ino_t ino;
+  time_t mtime;
+  off_t size;
+} served_program_t;
+
+struct server {
+  int fd; // listening
+  char *path; // of the Unix socket, to unlink, or NULL for TCP
+  char *root; // resolved, or NULL
+  serve_options_t options;
+
+  pthread_mutex_t lock; // for the programs
+  served_program_t *programs;
+  size_t numPrograms;
+  size_t capPrograms;
+  // versions replaced while workers still ran them, each freed once the
+  // server holds its only reference
+  served_program_t *retired;
+  size_t numRetired;
+  size_t capRetired;
+};
+
+// ===== sockets =====
+
+// "host:port" for TCP when `addr` has a ':' and no '/', the path of a Unix
+// socket otherwise
+static bool serve_isTcp(const char *addr) {
+  return strchr(addr, ':') != NULL && strchr(addr, '/') == NULL;
+}
+
+// the addresses of "host:port", for getaddrinfo to fill in; NULL, with a
+// message, if there are none
+static struct addrinfo *serve_resolve(const char *addr, bool passive) {
+  struct addrinfo hints = { 0 }, *res = NULL;
+  const char *colon = strrchr(addr, ':');
+  char host[256];
+  size_t len = (size_t)(colon - addr);
+  int rc;
+
+  if (len >= sizeof(host)) {
+    fprintf(stderr, "%s: host name too long\n", addr);
+    return NULL;
+  }
+
+  memcpy(host, addr, len);
+  host[len] = '\0';
+
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = passive ? AI_PASSIVE : 0;
+
+  if ((rc = getaddrinfo(len == 0 || strcmp(host, "*") == 0 ? NULL : host, colon + 1, &hints, &res)) != 0) {
+    fprintf(stderr, "%s: %s\n", addr, gai_strerror(rc));
+    return NULL;
+  }
+
+  return res;
+}
+
+// 127.0.0.0/8 or ::1, or the former mapped into IPv6
+static bool serve_isLoopback(const struct sockaddr *sa) {
+  if (sa->sa_family == AF_INET) {
+    return ntohl(((const struct sockaddr_in*)sa)->sin_addr.s_addr) >> 24 == 127;
+  }
+
+  if (sa->sa_family == AF_INET6) {
+    const struct in6_addr *a = &((const struct sockaddr_in6*)sa)->sin6_addr;
+
+    return IN6_IS_ADDR_LOOPBACK(a) || (IN6_IS_ADDR_V4MAPPED(a) && a->s6_addr[12] == 127);
+  }
+
+  return false;
+}
+
+// whether every address of `res` is a loopback one; a message otherwise
+static bool serve_allLoopback(const char *addr, const struct addrinfo *res) {
+  for (const struct addrinfo *ai = res; ai != NULL; ai = ai->ai_next) {
+    if (!serve_isLoopback(ai->ai_addr)) {
+      fprintf(stderr, "%s: not a loopback address, see --allow-remote\n", addr);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// whether `addr` is a Unix socket or a loopback "host:port", for --nodes
+// without --allow-remote; a message otherwise
+static bool serve_isLocal(const char *addr) {
+  struct addrinfo *res;
+  bool local;
+
+  if (!serve_isTcp(addr)) {
+    return true;
+  }
+
+  if ((res = serve_resolve(addr, false)) == NULL) {
+    return false;
+  }
+
+  local = serve_allLoopback(addr, res);
+  freeaddrinfo(res);
+
+  return local;
+}
+
+// a socket listening on `addr`, -1 with a message if it cannot be bound.
+// a Unix socket is only for its owner to connect to.
+static int serve_listen(const char *addr, bool remote) {
+  struct sockaddr_un un = { 0 };
+  struct addrinfo *res, *ai;
+  int fd = -1, one = 1;
+
+  if (!serve_isTcp(addr)) {
+    if (strlen(addr) >= sizeof(un.sun_path)) {
+      fprintf(stderr, "socket path too long: %s\n", addr);
+      return -1;
+    }
+
+    un.sun_family = AF_UNIX;
+    strcpy(un.sun_path, addr);
+    unlink(addr);
+
+    if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1
+        || bind(fd, (struct sockaddr*)&un, sizeof(un)) != 0
+        || chmod(addr, S_IRUSR | S_IWUSR) != 0
+        || listen(fd, SERVE_BACKLOG) != 0) {
+      perror(addr);
+
+      if (fd != -1) {
+        close(fd);
+      }
+
+      return -1;
+    }
+
+    return fd;
+  }
+
+  if ((res = serve_resolve(addr, true)) == NULL) {
+    return -1;
+  }
+
+  if (!remote && !serve_allLoopback(addr, res)) {
+    freeaddrinfo(res);
+    return -1;
+  }
+
+  for (ai = res; ai != NULL; ai = ai->ai_next) {
+    if ((fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol)) == -1) {
+      continue;
+    }
+
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    if (bind(fd, ai->ai_addr, ai->ai_addrlen) == 0 && listen(fd, SERVE_BACKLOG) == 0) {
+      break;
+    }
+
+    close(fd);
+    fd = -1;
+  }
+
+  if (fd == -1) {
+    perror(addr);
+  }
+
+  freeaddrinfo(res);
+
+  return fd;
+}
+
+// a connection to a server at `addr`, -1 if it cannot be made
+static int serve_connect(const char *addr) {
+  struct sockaddr_un un = { 0 };
+  struct addrinfo *res, *ai;
+  int fd = -1, one = 1;
+
+  if (!serve_isTcp(addr)) {
+    if (strlen(addr) >= sizeof(un.sun_path)) {
+      return -1;
+    }
+
+    un.sun_family = AF_UNIX;
+    strcpy(un.sun_path, addr);
+
+    if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) != -1 && connect(fd, (struct sockaddr*)&un, sizeof(un)) != 0) {
+      close(fd);
+      fd = -1;
+    }
+
+    return fd;
+  }
+
+  if ((res = serve_resolve(addr, false)) == NULL) {
+    return -1;
+  }
+
+  for (ai = res; ai != NULL; ai = ai->ai_next) {
+    if ((fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol)) == -1) {
+      continue;
+    }
+
+    if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+      // requests are a line each, written whole
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+      break;
+    }
+
+    close(fd);
+    fd = -1;
+  }
+
+  freeaddrinfo(res);
+
+  return fd;
+}
+
+// writes all `size` bytes of `data` to `fd`; false if it cannot
+static bool serve_writeAll(int fd, const void *data, size_t size) {
+  const char *p = (const char*)data;
+
+  while (size != 0) {
+    ssize_t n = write(fd, p, size);
+
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+
+    if (n <= 0) {
+      return false;
+    }
+
+    p += n;
+    size -= (size_t)n;
+  }
+
+  return true;
+}
+
+static uint64_t serve_nanos() {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// reads all `size` bytes into `data` from `fd`; false if it ends before
+static bool serve_readAll(int fd, void *data, size_t size) {
+  char *p = (char*)data;
+
+  while (size != 0) {
+    ssize_t n = read(fd, p, size);
+
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+
+    if (n <= 0) {
+      return false;
+    }
+
+    p += n;
+    size -= (size_t)n;
+  }
+
+  return true;
+}
+
+// the line on `fd`, without its newline, NUL terminated. false if there
+// was none, it was longer than SERVE_MAX_REQUEST, or it was not all there
+// within SERVE_TIMEOUT_MS, so that a peer sending nothing, or a byte at a
+// time, holds the reader no longer than that.
+static bool serve_readLine(int fd, char *buf) {
+  const uint64_t deadline = serve_nanos() + (uint64_t)SERVE_TIMEOUT_MS * 1000000ull;
+  size_t len = 0;
+
+  while (len < SERVE_MAX_REQUEST) {
+    struct pollfd p = { fd, POLLIN, 0 };
+    uint64_t now = serve_nanos();
+    ssize_t n;
+    char *end;
+    int ready;
+
+    if (now >= deadline) {
+      break;
+    }
+
+    // rounded up, so as not to spin on the last millisecond
+    if ((ready = poll(&p, 1, (int)((deadline - now + 999999) / 1000000))) < 0 && errno == EINTR) {
+      continue;
+    }
+
+    if (ready <= 0) {
+      break;
+    }
+
+    if ((n = read(fd, buf + len, SERVE_MAX_REQUEST - len)) < 0 && errno == EINTR) {
+      continue;
+    }
+
+    if (n <= 0) {
+      break;
+    }
+
+    if ((end = (char*)memchr(buf + len, '\n', (size_t)n)) != NULL) {
+      *end = '\0';
+
+      if (end != buf && end[-1] == '\r') {
+        end[-1] = '\0';
+      }
+
+      return true;
+    }
+
+    len += (size_t)n;
+  }
+
+  buf[len < SERVE_MAX_REQUEST ? len : 0] = '\0';
+
+  return len != 0 && len < SERVE_MAX_REQUEST;
+}
+
+// ===== programs =====
+
+static bool serve_sameFile(const served_program_t *p, const struct stat *st) {
+  return p->dev == st->st_dev && p->ino == st->st_ino && p->mtime == st->st_mtime && p->size == st->st_size;
+}
+
+static void serve_setFile(served_program_t *p, const struct stat *st) {
+  p->dev = st->st_dev;
+  p->ino = st->st_ino;
+  p->mtime = st->st_mtime;
+  p->size = st->st_size;
+}
+
+// maps the file at `path` into `p`, read-only; false if it cannot
+static bool serve_map(const char *path, served_program_t *p) {
+  int fd = open(path, O_RDONLY);
+  struct stat st;
+  void *mem = MAP_FAILED;
+
+  if (fd != -1 && fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+    mem = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+
+  if (fd != -1) {
+    close(fd);
+  }
+
+  if (mem == MAP_FAILED) {
+    return false;
+  }
+
+  p->data = (ubyte_t*)mem;
+  p->len = (size_t)st.st_size;
+  p->mapped = true;
+
+  return true;
+}
+
+static void serve_unmap(served_program_t *p) {
+  if (p->mapped) {
+    munmap(p->data, p->len);
+  } else {
+    free(p->data);
+  }
+}
+
+// the file `name` runs, under the root, into `out`, PATH_MAX bytes. false
+// if there is no root, or `name` is absolute or, through ".." or a
+// symbolic link, leaves it
+static bool serve_file(server_t *server, const char *name, char *out) {
+  char joined[PATH_MAX];
+  size_t rootLen;
+
+  if (server->root == NULL || name[0] == '\0' || name[0] == '/'
+      || snprintf(joined, sizeof(joined), "%s/%s", server->root, name) >= (int)sizeof(joined)
+      || realpath(joined, out) == NULL) {
+    return false;
+  }
+
+  rootLen = strlen(server->root);
+
+  return strncmp(out, server->root, rootLen) == 0 && (rootLen == 1 || out[rootLen] == '/');
+}
+
+// with the lock held: frees the retired versions no worker runs any more.
+// a retired program is not handed out again, so its count only drops.
+static void serve_sweepRetired(server_t *server) {
+  size_t kept = 0;
+
+  for (size_t i = 0; i < server->numRetired; i++) {
+    served_program_t *r = &server->retired[i];
+
+    if (atomic_load(&r->program->refs) == 1) {
+      program_release(r->program);
+      serve_unmap(r);
+    } else {
+      server->retired[kept++] = *r;
+    }
+  }
+
+  server->numRetired = kept;
+}
+
+// with the lock held: the index of the program `name`, or -1
+static long serve_find(server_t *server, const char *name) {
+  for (size_t i = 0; i < server->numPrograms; i++) {
+    if (strcmp(server->programs[i].name, name) == 0) {
+      return (long)i;
+    }
+  }
+
+  return -1;
+}
+
+// with the lock held: room for one more program, at numPrograms
+static served_program_t *serve_grow(server_t *server) {
+  if (server->numPrograms == server->capPrograms) {
+    server->capPrograms = server->capPrograms != 0 ? 2 * server->capPrograms : 8;
+    server->programs = (served_program_t*)realloc(server->programs, sizeof(served_program_t) * server->capPrograms);
+  }
+
+  return &server->programs[server->numPrograms];
+}
+
+// the index of the program `name`, loading it the first time, and again
+// whenever its file is another one -- as a deploy that renames a new .bin
+// over the old one makes it. `*program` is set to its current version,
+// with a reference for the caller. -1, with `*error` set, if it is not a
+// readable image under the root; a replacement that is not keeps the
+// version before it running.
+static long serve_program(server_t *server, const char *name, program_t **program, const char **error) {
+  char path[PATH_MAX];
+  struct stat st;
+  served_program_t *p;
+  long index = -1;
+  bool readable;
+
+  // sent by a coordinator, so only ever looked up
+  if (name[0] == '#') {
+    pthread_mutex_lock(&server->lock);
+
+    if ((index = serve_find(server, name)) == -1) {
+      *error = "unknown program";
+    } else {
+      *program = program_retain(server->programs[index].program);
+    }
+
+    pthread_mutex_unlock(&server->lock);
+
+    return index;
+  }
+
+  if (server->root == NULL) {
+    *error = "no such program: the server has no --root";
+    return -1;
+  }
+
+  readable = serve_file(server, name, path) && stat(path, &st) == 0 && S_ISREG(st.st_mode);
+
+  pthread_mutex_lock(&server->lock);
+
+  index = serve_find(server, name);
+
+  if (index == -1 && !readable) {
+    *error = "no such file";
+  } else if (index == -1) {
+    p = serve_grow(server);
+    memset(p, 0, sizeof(*p));
+
+    if (!serve_map(path, p)) {
+      *error = "no such file";
+    } else if ((p->program = program_create(p->data, p->len, error)) == NULL) {
+      serve_unmap(p);
+    } else {
+      p->name = strdup(name);
+      serve_setFile(p, &st);
+      index = (long)server->numPrograms++;
+    }
+  } else if (readable && !serve_sameFile(&server->programs[index], &st)) {
+    served_program_t next = { 0 };
+    const char *reloadError = "not readable";
+
+    p = &server->programs[index];
+    serve_setFile(p, &st);
+
+    if (!serve_map(path, &next) || (next.program = program_create(next.data, next.len, &reloadError)) == NULL) {
+      fprintf(stderr, "%s: not reloaded: %s\n", name, reloadError);
+
+      if (next.data != NULL) {
+        serve_unmap(&next);
+      }
+    } else {
+      // the runs on it go on; the workers take the new one for their next
+      if (server->numRetired == server->capRetired) {
+        server->capRetired = server->capRetired != 0 ? 2 * server->capRetired : 8;
+        server->retired = (served_program_t*)realloc(server->retired, sizeof(served_program_t) * server->capRetired);
+      }
+
+      server->retired[server->numRetired++] = *p;
+      p->data = next.data;
+      p->len = next.len;
+      p->mapped = next.mapped;
+      p->program = next.program;
+    }
+  }
+
+  if (index != -1) {
+    *program = program_retain(server->programs[index].program);
+  }
+
+  serve_sweepRetired(server);
+  pthread_mutex_unlock(&server->lock);
+
+  return index;
+}
+
+// "put <hash> <size>": a program a coordinator sends, to be run as
+// "#<hash>" (16 hex digits). the reply is "have" if the server has it
+// already, or "send", after which the client sends its <size> bytes, and
+// then "ok" once it is loaded, or an error. the bytes must hash to <hash>
+// (hashString64). kept until the server exits, so a program is sent to
+// each server once, whatever the jobs run on it.
+static void serve_put(server_t *server, int fd, FILE *fp, const char *args) {
+  unsigned long long hash, size;
+  char name[32];
+  served_program_t sent = { 0 };
+  const char *error;
+  served_program_t *p;
+  bool have;
+
+  if (sscanf(args, "%llx %llu", &hash, &size) != 2 || size == 0 || size > SERVE_MAX_PROGRAM) {
+    fprintf(fp, "error: put: bad request\n");
+    return;
+  }
+
+  snprintf(name, sizeof(name), "#%016llx", hash);
+
+  pthread_mutex_lock(&server->lock);
+  have = serve_find(server, name) != -1;
+  pthread_mutex_unlock(&server->lock);
+
+  if (have) {
+    fputs("have\n", fp);
+    return;
+  }
+
+  fputs("send\n", fp);
+  fflush(fp);
+
+  // aligned as a mapping is, for the constants the vm points into
+  sent.len = (size_t)size;
+  sent.data = (ubyte_t*)aligned_alloc(BIN_CONST_ALIGN, (sent.len + BIN_CONST_ALIGN - 1) / BIN_CONST_ALIGN * BIN_CONST_ALIGN);
+
+  if (sent.data == NULL || !serve_readAll(fd, sent.data, sent.len)) {
+    free(sent.data);
+    return;
+  }
+
+  if (hashString64(sent.data, sent.len) != (uint64_t)hash) {
+    fprintf(fp, "error: %s: hash mismatch\n", name);
+    free(sent.data);
+    return;
+  }
+
+  if ((sent.program = program_create(sent.data, sent.len, &error)) == NULL) {
+    fprintf(fp, "error: %s: %s\n", name, error);
+    free(sent.data);
+    return;
+  }
+
+  pthread_mutex_lock(&server->lock);
+
+  // sent over another connection meanwhile
+  if (serve_find(server, name) != -1) {
+    program_release(sent.program);
+    serve_unmap(&sent);
+  } else {
+    p = serve_grow(server);
+    *p = sent;
+    p->name = strdup(name);
+    server->numPrograms++;
+  }
+
+  pthread_mutex_unlock(&server->lock);
+
+  fputs("ok\n", fp);
+}
+
+// ===== workers =====
+
+static void *serve_collectorThread(void *arg) {
+  runtime_collector((runtime_t*)arg);
+
+  return NULL;
+}
+
+// a worker's runtime, as the options set it up, with a collector of its
+// own and the interpreters of the programs run on it
+typedef struct {
+  runtime_t *rt;
+  pthread_t gcThread;
+  interpreter_t **its; // by program index, NULL until it first runs here
+  size_t numIts;
+  bool used; // whether a run left state on the runtime
+} serve_runtime_t;
+
+static void serve_runtimeCreate(const serve_options_t *options, serve_runtime_t *w) {
+  runtime_t *rt = runtime_create();
+
+  if (options->hugePages) {
+    datatable_useHugePages(rt->dt);
+  }
+
+  builtins_register(rt);
+  rt->output.mode = options->outputMode;
+  runtime_setMemoryLimit(rt, options->memorySoft, options->memoryHard);
+  runtime_setBudget(rt, options->budget, options->slice);
+  runtime_setGcBudget(rt, options->gcBudget);
+
+  runtime_attach(rt);
+  pthread_create(&w->gcThread, NULL, serve_collectorThread, (void*)rt);
+
+  w->rt = rt;
+  w->its = NULL;
+  w->numIts = 0;
+  w->used = false;
+}
+
+static void serve_runtimeDestroy(serve_runtime_t *w) {
+  for (size_t i = 0; i < w->numIts; i++) {
+    if (w->its[i] != NULL) {
+      interpreter_destroy(w->its[i]);
+    }
+  }
+
+  free(w->its);
+
+  runtime_detach(w->rt);
+  runtime_stopCollector(w->rt);
+  pthread_join(w->gcThread, NULL);
+
+  runtime_gc(w->rt);
+  runtime_destroy(w->rt);
+}
+
+// runs `it` for `request`, its reply going to `fp`. false if the run
+// ended on a runtime error, an uncaught exception or `exit`, which end
+// the request instead of the server (see runtime_fatal): the run is left
+// mid-way on the runtime, for the caller to replace it.
+static bool serve_run(runtime_t *rt, interpreter_t *it, FILE *fp, const char *request) {
+  runtime_fatal_t fatal;
+
+  rt->fatal = &fatal;
+
+  if (setjmp(fatal.env) != 0) {
+    rt->fatal = NULL;
+
+    // `exit` with a status of 0 ends the program, not in error
+    if (fatal.message[0] != '\0') {
+      fprintf(fp, "error: %s: %s\n", request, fatal.message);
+    } else if (fatal.status != 0) {
+      fprintf(fp, "error: %s: exit status %d\n", request, fatal.status);
+    }
+
+    return false;
+  }
+
+  interpreter_run(it);
+  output_flush(&rt->output);
+  rt->fatal = NULL;
+
+  if (rt->exhausted) {
+    fprintf(fp, "error: %s: execution budget exhausted\n", request);
+  } else if (rt->overLimit) {
+    fprintf(fp, "error: %s: memory limit exceeded\n", request);
+  }
+
+  return true;
+}
+
+// the first run of each program decodes it against the worker's runtime,
+// and every run but the runtime's first starts from interpreter_reset, so
+// the code stays warm across requests. a program whose file was replaced
+// is decoded again, on the same runtime, by the first request after (see
+// serve_program). a run that fails takes the runtime with it: the worker
+// goes on with a new one, its programs decoded again as they are asked for.
+void *serve_worker(void *arg) {
+  server_t *server = (server_t*)arg;
+  serve_runtime_t w;
+  char request[SERVE_MAX_REQUEST];
+  const struct timeval timeout = { SERVE_TIMEOUT_MS / 1000, (SERVE_TIMEOUT_MS % 1000) * 1000 };
+
+  serve_runtimeCreate(&server->options, &w);
+
+  for (;;) {
+    int fd = accept(server->fd, NULL, NULL);
+    const char *error = NULL;
+    program_t *program;
+    interpreter_t *it;
+    char *input;
+    long index;
+    FILE *fp;
+    bool ok;
+
+    if (fd == -1) {
+      if (errno == EINTR || errno == ECONNABORTED) {
+        continue;
+      }
+
+      perror("accept");
+      break;
+    }
+
+    // each read of a program sent with "put" waits as long at most
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    if (!serve_readLine(fd, request) || (fp = fdopen(fd, "w")) == NULL) {
+      close(fd);
+      continue;
+    }
+
+    if (strncmp(request, "put ", 4) == 0) {
+      serve_put(server, fd, fp, request + 4);
+      fclose(fp);
+      continue;
+    }
+
+    if ((input = strchr(request, ' ')) != NULL) {
+      *input++ = '\0';
+    }
+
+    if ((index = serve_program(server, request, &program, &error)) == -1) {
+      fprintf(fp, "error: %s: %s\n", request, error);
+      fclose(fp);
+      continue;
+    }
+
+    if ((size_t)index >= w.numIts) {
+      w.its = (interpreter_t**)realloc(w.its, sizeof(interpreter_t*) * (index + 1));
+      memset(w.its + w.numIts, 0, sizeof(interpreter_t*) * (index + 1 - w.numIts));
+      w.numIts = index + 1;
+    }
+
+    // a new version was loaded: the runtime, with its interned strings
+    // and slabs, stays; the old code goes, its memo tables' claims first
+    if (w.its[index] != NULL && w.its[index]->program != program) {
+      interpreter_reset(w.its[index]);
+      interpreter_destroy(w.its[index]);
+      w.its[index] = NULL;
+    }
+
+    if (w.its[index] == NULL) {
+      w.its[index] = interpreter_createShared(w.rt, program);
+      w.its[index]->haltExits = false;
+    }
+
+    program_release(program);
+    it = w.its[index];
+
+    // another program's static data, or this one's last run, is still there
+    if (w.used) {
+      interpreter_reset(it);
+    }
+
+    w.rt->output.fp = fp;
+    w.rt->input = input != NULL ? input : "";
+    ok = serve_run(w.rt, it, fp, request);
+    w.rt->input = NULL;
+    w.rt->output.fp = stdout;
+    w.used = true;
+    fclose(fp);
+
+    if (!ok) {
+      serve_runtimeDestroy(&w);
+      serve_runtimeCreate(&server->options, &w);
+    }
+  }
+
+  serve_runtimeDestroy(&w);
+
+  return NULL;
+}
+
+server_t *serve_open(const char *addr, const serve_options_t *options) {
+  server_t *server;
+  char root[PATH_MAX];
+  int fd;
+
+  if (options->root != NULL && realpath(options->root, root) == NULL) {
+    perror(options->root);
+    return NULL;
+  }
+
+  if ((fd = serve_listen(addr, options->remote)) == -1) {
+    return NULL;
+  }
+
+  // a client that leaves before its reply only fails a write
+  signal(SIGPIPE, SIG_IGN);
+
+  server = (server_t*)calloc(1, sizeof(server_t));
+  server->fd = fd;
+  server->path = serve_isTcp(addr) ? NULL : strdup(addr);
+  server->root = options->root != NULL ? strdup(root) : NULL;
+  server->options = *options;
+  pthread_mutex_init(&server->lock, NULL);
+
+  return server;
+}
+
+void serve_close(server_t *server) {
+  close(server->fd);
+
+  if (server->path != NULL) {
+    unlink(server->path);
+  }
+
+  for (size_t i = 0; i < server->numPrograms; i++) {
+    program_release(server->programs[i].program);
+    serve_unmap(&server->programs[i]);
+    free(server->programs[i].name);
+  }
+
+  // the workers are done, and with them their references
+  serve_sweepRetired(server);
+  free(server->programs);
+  free(server->retired);
+  free(server->path);
+  free(server->root);
+  pthread_mutex_destroy(&server->lock);
+  free(server);
+}
+
+// ===== coordinator =====
+
+// a --nodes server, as the coordinator sees it: its jobs, and what they took
+typedef struct {
+  const char *addr;
+  atomic_bool dead; // a connection failed, its jobs were given back
+  atomic_size_t jobs;
+  atomic_size_t failures; // runs that replied with an error
+  atomic_uint_least64_t nanos; // from sending a job to its reply's end
+  atomic_size_t bytes; // of replies
+} node_t;
+
+// each node has `perNode` connections at a time, each taking the next job
+// as a local worker does, with one fetch_add, so a fast node takes more of
+// them; a job whose connection failed goes on `retry`, for whichever
+// connection asks next, and its node gets no more. the program is sent to
+// each node once, by its content hash (see serve_put), and stays loaded
+// there with its interpreters, warm, across jobs and coordinators.
+typedef struct {
+  const void *data;
+  size_t len;
+  uint64_t hash;
+  const char **jobs;
+  size_t numJobs;
+  atomic_size_t next; // the first job not yet claimed
+  node_t *nodes;
+  size_t numNodes;
+
+  pthread_mutex_t lock; // for stdout and stderr, and `retry`
+  size_t *retry;
+  size_t numRetry;
+  atomic_size_t pending; // jobs not yet replied to
+} coordinator_t;
+
+typedef struct {
+  coordinator_t *c;
+  node_t *node;
+} connection_t;
+
+// sends `request` to `node`, the reply going to `out`; false if the node
+// could not be reached or closed the connection before replying in full
+static bool serve_request(node_t *node, const char *request, char **out, size_t *outLen) {
+  char *reply = NULL;
+  size_t len = 0, cap = 0;
+  ssize_t n;
+  int fd;
+
+  if ((fd = serve_connect(node->addr)) == -1) {
+    return false;
+  }
+
+  if (!serve_writeAll(fd, request, strlen(request))) {
+    close(fd);
+    return false;
+  }
+
+  for (;;) {
+    if (len == cap) {
+      cap = cap != 0 ? cap * 2 : 4096;
+      reply = (char*)realloc(reply, cap + 1);
+    }
+
+    if ((n = read(fd, reply + len, cap - len)) > 0) {
+      len += (size_t)n;
+    } else if (n == 0) {
+      break;
+    } else if (errno != EINTR) {
+      free(reply);
+      close(fd);
+      return false;
+    }
+  }
+
+  close(fd);
+  reply[len] = '\0';
+  *out = reply;
+  *outLen = len;
+
+  return true;
+}
+
+// sends the program to `node`, unless it has it already
+static bool serve_send(coordinator_t *c, node_t *node) {
+  char request[64], reply[SERVE_MAX_REQUEST];
+  bool ok = false;
+  int fd;
+
+  if ((fd = serve_connect(node->addr)) == -1) {
+    return false;
+  }
+
+  snprintf(request, sizeof(request), "put %016llx %zu\n", (unsigned long long)c->hash, c->len);
+
+  if (serve_writeAll(fd, request, strlen(request)) && serve_readLine(fd, reply)) {
+    if (strcmp(reply, "have") == 0) {
+      ok = true;
+    } else if (strcmp(reply, "send") == 0 && serve_writeAll(fd, c->data, c->len) && serve_readLine(fd, reply)) {
+      ok = strcmp(reply, "ok") == 0;
+    }
+
+    if (!ok) {
+      pthread_mutex_lock(&c->lock);
+      fprintf(stderr, "%s: %s\n", node->addr, reply);
+      pthread_mutex_unlock(&c->lock);
+    }
+  }
+
+  close(fd);
+
+  return ok;
+}
+
+// the next job for a connection to `node`: one given back first, then the
+// list's; false once none is left to take, or the node failed
+static bool serve_take(coordinator_t *c, node_t *node, size_t *index) {
+  while (!atomic_load(&node->dead)) {
+    pthread_mutex_lock(&c->lock);
+
+    if (c->numRetry != 0) {
+      *index = c->retry[--c->numRetry];
+      pthread_mutex_unlock(&c->lock);
+      return true;
+    }
+
+    pthread_mutex_unlock(&c->lock);
+
+    if ((*index = atomic_fetch_add_explicit(&c->next, 1, memory_order_relaxed)) < c->numJobs) {
+      return true;
+    }
+
+    // the jobs still running elsewhere may yet be given back
+    if (atomic_load(&c->pending) == 0) {
+      return false;
+    }
+
+    usleep(1000);
+  }
+
+  return false;
+}
+
+static void serve_giveBack(coordinator_t *c, node_t *node, size_t index) {
+  pthread_mutex_lock(&c->lock);
+  c->retry[c->numRetry++] = index;
+
+  if (!atomic_exchange(&node->dead, true)) {
+    fprintf(stderr, "%s: connection failed, not sending it more jobs\n", node->addr);
+  }
+
+  pthread_mutex_unlock(&c->lock);
+}
+
+// writes a job's reply out as a local worker would: what it printed to
+// stdout, and a failure -- what the server adds after it, "error: #<hash>:
+// ...", on the line the prints left off -- to stderr, by the job's line
+static void serve_writeReply(coordinator_t *c, node_t *node, const char *line, const char *reply, size_t len) {
+  char prefix[64];
+  const size_t prefixLen = (size_t)snprintf(prefix, sizeof(prefix), "error: #%016llx: ", (unsigned long long)c->hash);
+  const char *error = NULL;
+  size_t outLen = len;
+
+  // on the last line only
+  for (const char *p = reply + len; p > reply;) {
+    if (*--p == '\n' && p != reply + len - 1) {
+      break;
+    }
+
+    if ((size_t)(reply + len - p) >= prefixLen && memcmp(p, prefix, prefixLen) == 0) {
+      error = p;
+      outLen = (size_t)(p - reply);
+      break;
+    }
+  }
+
+  pthread_mutex_lock(&c->lock);
+  fwrite(reply, 1, outLen, stdout);
+
+  if (error != NULL) {
+    atomic_fetch_add_explicit(&node->failures, 1, memory_order_relaxed);
+    fprintf(stderr, "%s: %s", line, error + prefixLen);
+
+    if (reply[len - 1] != '\n') {
+      fputc('\n', stderr);
+    }
+  }
+
+  fflush(stdout);
+  pthread_mutex_unlock(&c->lock);
+}
+
+static void *serve_connectionThread(void *arg) {
+  connection_t *conn = (connection_t*)arg;
+  coordinator_t *c = conn->c;
+  node_t *node = conn->node;
+  char unknown[64], request[SERVE_MAX_REQUEST];
+  size_t index;
+
+  snprintf(unknown, sizeof(unknown), "error: #%016llx: unknown program\n", (unsigned long long)c->hash);
+
+  if (!serve_send(c, node)) {
+    pthread_mutex_lock(&c->lock);
+
+    if (!atomic_exchange(&node->dead, true)) {
+      fprintf(stderr, "%s: could not send the program, not sending it jobs\n", node->addr);
+    }
+
+    pthread_mutex_unlock(&c->lock);
+    return NULL;
+  }
+
+  while (serve_take(c, node, &index)) {
+    const char *line = c->jobs[index];
+    char *reply;
+    size_t len;
+    uint64_t start;
+    bool ok;
+
+    if (snprintf(request, sizeof(request), "#%016llx %s\n", (unsigned long long)c->hash, line) >= (int)sizeof(request)) {
+      pthread_mutex_lock(&c->lock);
+      fprintf(stderr, "%s: too long to send\n", line);
+      pthread_mutex_unlock(&c->lock);
+      atomic_fetch_sub(&c->pending, 1);
+      continue;
+    }
+
+    start = serve_nanos();
+    ok = serve_request(node, request, &reply, &len);
+
+    // the node was restarted since: sent again, once
+    if (ok && strcmp(reply, unknown) == 0) {
+      free(reply);
+      ok = serve_send(c, node) && serve_request(node, request, &reply, &len);
+    }
+
+    if (!ok) {
+      serve_giveBack(c, node, index);
+      break;
+    }
+
+    atomic_fetch_add_explicit(&node->jobs, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&node->nanos, serve_nanos() - start, memory_order_relaxed);
+    atomic_fetch_add_explicit(&node->bytes, len, memory_order_relaxed);
+
+    serve_writeReply(c, node, line, reply, len);
+    free(reply);
+    atomic_fetch_sub(&c->pending, 1);
+  }
+
+  return NULL;
+}
+
+bool serve_coordinate(const void *data, size_t len, const char **jobs, size_t numJobs, const serve_nodes_t *nodes) {
+  coordinator_t c = { 0 };
+  char *list = strdup(nodes->addrs), *save = NULL;
+  connection_t *conns;
+  pthread_t *threads;
+  size_t count;
+  bool ok;
+
+  // a node that goes away fails a write, not the coordinator
+  signal(SIGPIPE, SIG_IGN);
+
+  c.data = data;
+  c.len = len;
+  c.hash = hashString64(data, len);
+  c.jobs = jobs;
+  c.numJobs = numJobs;
+  atomic_init(&c.next, 0);
+  c.nodes = (node_t*)calloc(strlen(nodes->addrs) / 2 + 1, sizeof(node_t));
+  c.retry = (size_t*)malloc(sizeof(size_t) * (numJobs + 1));
+  pthread_mutex_init(&c.lock, NULL);
+  atomic_init(&c.pending, numJobs);
+
+  for (char *addr = strtok_r(list, ",", &save); addr != NULL; addr = strtok_r(NULL, ",", &save)) {
+    // nothing is sent anywhere before every node is found to be allowed
+    if (!nodes->remote && !serve_isLocal(addr)) {
+      free(c.nodes);
+      free(c.retry);
+      free(list);
+      pthread_mutex_destroy(&c.lock);
+      return false;
+    }
+
+    c.nodes[c.numNodes++].addr = addr;
+  }
+
+  count = c.numNodes * nodes->perNode;
+  conns = (connection_t*)malloc(sizeof(connection_t) * count);
+  threads = (pthread_t*)malloc(sizeof(pthread_t) * count);
+
+  for (size_t i = 0; i < count; i++) {
+    conns[i].c = &c;
+    conns[i].node = &c.nodes[i % c.numNodes];
+    pthread_create(&threads[i], NULL, serve_connectionThread, (void*)&conns[i]);
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  ok = atomic_load(&c.pending) == 0;
+
+  if (!ok) {
+    fprintf(stderr, "%zu jobs not run: no node left\n", atomic_load(&c.pending));
+  }
+
+  if (nodes->stats) {
+    fprintf(stderr, "node                            jobs  failed    avg ms   reply bytes\n");
+
+    for (size_t i = 0; i < c.numNodes; i++) {
+      node_t *node = &c.nodes[i];
+      size_t n = atomic_load(&node->jobs);
+
+      fprintf(stderr, "%-30s %5zu %7zu %9.3f %13zu%s\n", node->addr, n, atomic_load(&node->failures),
+              n != 0 ? (double)atomic_load(&node->nanos) / (double)n / 1e6 : 0.0, atomic_load(&node->bytes),
+              atomic_load(&node->dead) ? "  (failed)" : "");
+    }
+  }
+
+  free(threads);
+  free(conns);
+  free(c.retry);
+  free(c.nodes);
+  free(list);
+  pthread_mutex_destroy(&c.lock);
+
+  return ok;
+}
+
+
+#endif
@@ -0,0 +1,75 @@
+#include <vm/shape.h>
+
+#include <stdlib.h>
+
+shape_t *shape_createRoot(void) {
+  shape_t *shape = (shape_t*)malloc(sizeof(shape_t));
+  shape->parent = NULL;
+  shape->key = NULL;
+  shape->slot = 0;
+  shape->count = 0;
+  shape->children = NULL;
+  shape->sibling = NULL;
+  return shape;
+}
+
+void shape_destroyTree(shape_t *root) {
+  // depth first, through an explicit stack chained on `parent`, which is
+  // not needed anymore once a shape is reached
+  shape_t *stack = root;
+
+  root->parent = NULL;
+
+  while (stack != NULL) {
+    shape_t *shape = stack;
+    stack = shape->parent;
+
+    for (shape_t *child = shape->children; child != NULL; ) {
+      shape_t *next = child->sibling;
+
+      child->parent = stack;
+      stack = child;
+      child = next;
+    }
+
+    free(shape);
+  }
+}
+
+int32_t shape_lookup(const shape_t *shape, object_key_t key) {
+  // the newest member first, at most SHAPE_MAX_MEMBERS steps
+  for (; shape->parent != NULL; shape = shape->parent) {
+    if (shape->key == key) {
+      return (int32_t)shape->slot;
+    }
+  }
+
+  return -1;
+}
+
+shape_t *shape_findChild(shape_t *shape, object_key_t key) {
+  shape_t *child = __atomic_load_n(&shape->children, __ATOMIC_ACQUIRE);
+
+  for (; child != NULL; child = child->sibling) {
+    if (child->key == key) {
+      return child;
+    }
+  }
+
+  return NULL;
+}
+
+shape_t *shape_addChild(shape_t *shape, object_key_t key) {
+  shape_t *child = (shape_t*)malloc(sizeof(shape_t));
+  child->parent = shape;
+  child->key = key;
+  child->slot = shape->count;
+  child->count = shape->count + 1;
+  child->children = NULL;
+  child->sibling = shape->children;
+
+  // fully built before readers can see it
+  __atomic_store_n(&shape->children, child, __ATOMIC_RELEASE);
+
+  return child;
+}
@@ -0,0 +1,236 @@
+#include <vm/slab.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+struct slab {
+  slab_t *next;
+  uint32_t used; // blocks handed out
+  uint16_t c; // the class it is carved into
+  bool evacuating; // see slab_beginEvacuation
+};
+
+// the blocks of a slab start after its header, aligned for any value_t
+#define SLAB_HEADER ((sizeof(slab_t) + 15) & ~(size_t)15)
+
+static inline slab_t *slab_of(const void *block) {
+  return (slab_t*)((uintptr_t)block & ~(uintptr_t)(SLAB_BYTES - 1));
+}
+
+static inline size_t slab_capacity(unsigned c) {
+  return (SLAB_BYTES - SLAB_HEADER) / slab_classSize(c);
+}
+
+// carves a new slab into blocks of class `c`, in address order
+static bool slab_grow(slab_allocator_t *a, unsigned c) {
+  size_t blockSize = slab_classSize(c);
+  size_t count = slab_capacity(c);
+  slab_t *slab;
+  char *blocks;
+
+  if (posix_memalign((void**)&slab, SLAB_BYTES, SLAB_BYTES) != 0) {
+    return false;
+  }
+
+  quota_force(a->quota, SLAB_BYTES);
+
+  slab->next = a->slabs;
+  slab->used = 0;
+  slab->c = (uint16_t)c;
+  slab->evacuating = false;
+  a->slabs = slab;
+  ++a->numSlabs;
+
+  blocks = (char*)slab + SLAB_HEADER;
+
+  for (size_t i = count; i != 0; i--) {
+    void *block = blocks + (i - 1) * blockSize;
+
+    *(void**)block = a->free[c];
+    a->free[c] = block;
+  }
+
+  return true;
+}
+
+void slab_init(slab_allocator_t *a) {
+  for (unsigned c = 0; c < SLAB_CLASSES; c++) {
+    a->free[c] = NULL;
+    a->evacuated[c] = NULL;
+    a->kept[c] = NULL;
+  }
+
+  a->slabs = NULL;
+  a->numSlabs = 0;
+  a->usedBytes = 0;
+  a->quota = NULL;
+}
+
+void slab_destroy(slab_allocator_t *a) {
+  quota_t *quota = a->quota;
+
+  while (a->slabs != NULL) {
+    slab_t *next = a->slabs->next;
+
+    free(a->slabs);
+    quota_credit(quota, SLAB_BYTES);
+    a->slabs = next;
+  }
+
+  slab_init(a);
+  a->quota = quota;
+}
+
+void *slab_alloc(slab_allocator_t *a, size_t size) {
+  unsigned c = slab_classOf(size);
+  void *block;
+
+  if (c == SLAB_CLASSES) {
+    void *block = malloc(size);
+
+    if (block != NULL) {
+      quota_force(a->quota, size);
+    }
+
+    return block;
+  }
+
+  if (a->free[c] == NULL && !slab_grow(a, c)) {
+    return NULL;
+  }
+
+  block = a->free[c];
+  a->free[c] = *(void**)block;
+
+  ++slab_of(block)->used;
+  a->usedBytes += slab_classSize(c);
+
+  return block;
+}
+
+void *slab_calloc(slab_allocator_t *a, size_t size) {
+  void *block = slab_alloc(a, size);
+
+  if (block != NULL) {
+    memset(block, 0, size);
+  }
+
+  return block;
+}
+
+void slab_free(slab_allocator_t *a, void *ptr, size_t size) {
+  unsigned c = slab_classOf(size);
+  slab_t *slab;
+
+  if (ptr == NULL) {
+    return;
+  }
+
+  if (c == SLAB_CLASSES) {
+    free(ptr);
+    quota_credit(a->quota, size);
+    return;
+  }
+
+  slab = slab_of(ptr);
+  --slab->used;
+  a->usedBytes -= slab_classSize(c);
+
+  // not to be handed out again before the slab may be freed
+  if (slab->evacuating) {
+    *(void**)ptr = a->evacuated[c];
+    a->evacuated[c] = ptr;
+    return;
+  }
+
+  *(void**)ptr = a->free[c];
+  a->free[c] = ptr;
+}
+
+unsigned slab_freePercent(const slab_allocator_t *a) {
+  size_t total = a->numSlabs * SLAB_BYTES;
+
+  return total != 0 ? (unsigned)(100 - a->usedBytes * 100 / total) : 0;
+}
+
+void slab_beginEvacuation(slab_allocator_t *a) {
+  for (slab_t *slab = a->slabs; slab != NULL; slab = slab->next) {
+    slab->evacuating = slab->used * 2 < slab_capacity(slab->c);
+  }
+
+  for (unsigned c = 0; c < SLAB_CLASSES; c++) {
+    while (a->free[c] != NULL) {
+      void *block = a->free[c];
+      void **to = slab_of(block)->evacuating ? &a->evacuated[c] : &a->kept[c];
+
+      a->free[c] = *(void**)block;
+      *(void**)block = *to;
+      *to = block;
+    }
+  }
+}
+
+bool slab_isEvacuating(const void *ptr, size_t size) {
+  return ptr != NULL && slab_classOf(size) != SLAB_CLASSES && slab_of(ptr)->evacuating;
+}
+
+// links `list` in after the last block of `*head`
+static void slab_append(void **head, void *list) {
+  while (*head != NULL) {
+    head = (void**)*head;
+  }
+
+  *head = list;
+}
+
+size_t slab_endEvacuation(slab_allocator_t *a) {
+  slab_t **link = &a->slabs;
+  size_t freed = 0;
+
+  for (unsigned c = 0; c < SLAB_CLASSES; c++) {
+    void *survivors = NULL;
+    void *last = NULL;
+
+    // the blocks of a slab about to be freed are dropped with it
+    while (a->evacuated[c] != NULL) {
+      void *block = a->evacuated[c];
+
+      a->evacuated[c] = *(void**)block;
+
+      if (slab_of(block)->used != 0) {
+        *(void**)block = survivors;
+        survivors = block;
+        last = last != NULL ? last : block;
+      }
+    }
+
+    // after the blocks carved during the evacuation, the only ones walked
+    if (last != NULL) {
+      *(void**)last = a->kept[c];
+      slab_append(&a->free[c], survivors);
+    } else {
+      slab_append(&a->free[c], a->kept[c]);
+    }
+
+    a->kept[c] = NULL;
+  }
+
+  while (*link != NULL) {
+    slab_t *slab = *link;
+
+    if (slab->evacuating && slab->used == 0) {
+      *link = slab->next;
+      free(slab);
+      quota_credit(a->quota, SLAB_BYTES);
+      --a->numSlabs;
+      ++freed;
+      continue;
+    }
+
+    slab->evacuating = false;
+    link = &slab->next;
+  }
+
+  return freed;
+}
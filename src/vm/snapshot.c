@@ -0,0 +1,627 @@
+#include <vm/snapshot.h>
+#include <vm/runtime.h>
+#include <vm/code.h>
+#include <vm/interpreter.h>
+#include <vm/builtins.h>
+#include <vm/fiber.h>
+#include <vm/object.h>
+#include <vm/array.h>
+#include <vm/map.h>
+#include <vm/util.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// file layout, in the byte order of the machine: the header, the
+// buffers (each a u64 size and the bytes), the node table, the values of
+// the four storages, then the contents of each node in table order. every
+// item starts 8 byte aligned. nodes and buffers are referred to by index.
+typedef struct snapshot_header {
+  uint8_t magic[4];
+  uint32_t version;
+  uint64_t programHash; // hashString64 of the .bin
+  uint64_t pc; // offset after the call to `snapshot`
+  uint32_t numRegisters; // NUM_REGISTERS
+  uint32_t reserved;
+  uint64_t numBuffers;
+  uint64_t numNodes;
+  uint64_t counts[4]; // slots saved of each storage
+} snapshot_header_t;
+
+typedef struct snapshot_node {
+  uint8_t kind; // HEAP_KIND
+  uint8_t arrayKind; // ARRAY_KIND, for arrays
+  uint8_t reserved[6];
+  uint64_t count; // members, elements or entries
+} snapshot_node_t;
+
+enum SNAPSHOT_VALUES {
+  SNAPSHOT_BITS = 0, // `payload` is the value's data as it is
+  SNAPSHOT_POOL = 1, // an offset into the constant pool
+  SNAPSHOT_BUFFER = 2, // a buffer index
+  SNAPSHOT_NODE = 3, // a node index
+  SNAPSHOT_BUILTIN = 4 // a BUILTIN_C_FUNCTIONS slot
+};
+
+typedef struct snapshot_value {
+  metadata_t metadata;
+  uint32_t kind; // SNAPSHOT_VALUES
+  uint64_t payload;
+} snapshot_value_t;
+
+// ===== writing =====
+
+typedef struct snapshot_buf {
+  ubyte_t *data;
+  size_t len;
+  size_t size;
+} snapshot_buf_t;
+
+static void snapshot_append(snapshot_buf_t *b, const void *data, size_t len) {
+  size_t padded = (len + 7) & ~(size_t)7;
+
+  if (b->len + padded > b->size) {
+    b->size = b->size * 2 > b->len + padded ? b->size * 2 : b->len + padded + 4096;
+    b->data = (ubyte_t*)realloc(b->data, b->size);
+  }
+
+  memcpy(b->data + b->len, data, len);
+  memset(b->data + b->len + len, 0, padded - len);
+  b->len += padded;
+}
+
+static void snapshot_appendString(snapshot_buf_t *b, const char *str, size_t len) {
+  uint64_t size = len;
+
+  snapshot_append(b, &size, sizeof(size));
+  snapshot_append(b, str, len);
+}
+
+typedef struct snapshot_writer {
+  runtime_t *rt;
+  const code_t *code;
+  snapshot_buf_t buffers; // their contents
+  snapshot_buf_t nodes; // snapshot_node_t
+  snapshot_buf_t body; // storages, then node contents
+  idmap_t ids; // buffers and nodes share the table; their pointers differ
+  heap_value_t **queue; // nodes whose contents are not written yet, in index order
+  uint64_t numNodes;
+  uint64_t queueSize;
+  uint64_t numBuffers;
+  size_t lost; // raw pointers saved as null
+} snapshot_writer_t;
+
+static uint64_t snapshot_node(snapshot_writer_t *w, heap_value_t *hv) {
+  bool added;
+  uint64_t id = idmap_id(&w->ids, hv, w->numNodes, &added);
+
+  if (added) {
+    snapshot_node_t node = { .kind = hv->kind };
+
+    switch (hv->kind) {
+      case HEAP_KIND_ARRAY:
+        node.arrayKind = (uint8_t)((array_t*)hv->ptr)->kind;
+        node.count = ((array_t*)hv->ptr)->size;
+        break;
+      case HEAP_KIND_MAP:
+        node.count = ((map_t*)hv->ptr)->size;
+        break;
+      default: {
+        object_t *object = (object_t*)hv->ptr;
+        node.count = object->shape != NULL ? object->shape->count : object->size;
+        break;
+      }
+    }
+
+    snapshot_append(&w->nodes, &node, sizeof(node));
+
+    if (w->numNodes == w->queueSize) {
+      w->queueSize = w->queueSize != 0 ? w->queueSize * 2 : 64;
+      w->queue = (heap_value_t**)realloc(w->queue, w->queueSize * sizeof(heap_value_t*));
+    }
+
+    w->queue[w->numNodes++] = hv;
+  }
+
+  return id;
+}
+
+static void snapshot_writeValue(snapshot_writer_t *w, const value_t *v) {
+  snapshot_value_t out = { .metadata = VALUE_META(v), .kind = SNAPSHOT_BITS, .payload = v->data.u64 };
+  VALUE_TYPE type = VALUE_TYPE_OF(v);
+
+  if (type == TYPE_FUNCTION) {
+    int slot = builtins_slotOf(v->data.fn);
+
+    if (slot >= 0) {
+      out.kind = SNAPSHOT_BUILTIN;
+      out.payload = (uint64_t)slot;
+    } else {
+      out.metadata = VALUE_METADATA(TYPE_NONE, FLAG_NONE);
+      out.payload = 0;
+    }
+  } else if (type == TYPE_POINTER && v->data.raw != NULL && !VALUE_HAS(v, TYPE_POINTER, FLAG_INLINE)) {
+    const ubyte_t *raw = (const ubyte_t*)v->data.raw;
+
+    if (VALUE_HAS(v, TYPE_POINTER, FLAG_OBJECT) && (value_getFlags((value_t*)v) & (FLAG_STREAM | FLAG_AIO | FLAG_TASK | FLAG_CHANNEL | FLAG_CACHE))) {
+      // an open file, a request on one, a running task, a channel or a
+      // cache, like a raw FILE pointer
+      out.metadata = VALUE_METADATA(TYPE_POINTER, FLAG_NONE);
+      out.payload = 0;
+      ++w->lost;
+    } else if (VALUE_HAS(v, TYPE_POINTER, FLAG_OBJECT)) {
+      out.kind = SNAPSHOT_NODE;
+      out.payload = snapshot_node(w, v->data.hv);
+    } else if (VALUE_IS_SLICE(v)) {
+      // a string of its own, of the part of the buffer: never one another
+      // value refers to, which the whole buffer may be
+      uint64_t size = VALUE_SLICE_LENGTH(v);
+
+      out.metadata = VALUE_METADATA(TYPE_POINTER, FLAG_REFCOUNTED);
+      out.kind = SNAPSHOT_BUFFER;
+      out.payload = w->numBuffers++;
+
+      snapshot_append(&w->buffers, &size, sizeof(size));
+      snapshot_append(&w->buffers, value_getRawPointer((value_t*)v), size);
+    } else if (VALUE_HAS(v, TYPE_POINTER, FLAG_REFCOUNTED)) {
+      bool added;
+
+      out.kind = SNAPSHOT_BUFFER;
+      out.payload = idmap_id(&w->ids, raw, w->numBuffers, &added);
+
+      if (added) {
+        uint64_t size = rc_size(v->data.rc);
+
+        snapshot_append(&w->buffers, &size, sizeof(size));
+        snapshot_append(&w->buffers, raw, size);
+        ++w->numBuffers;
+      }
+    } else if (VALUE_HAS(v, TYPE_POINTER, FLAG_CONST) && code_poolOffset(w->code, raw, &out.payload)) {
+      out.kind = SNAPSHOT_POOL;
+    } else {
+      out.metadata = VALUE_METADATA(TYPE_POINTER, FLAG_NONE);
+      out.payload = 0;
+      ++w->lost;
+    }
+  }
+
+  snapshot_append(&w->body, &out, sizeof(out));
+}
+
+static void snapshot_writeNode(snapshot_writer_t *w, heap_value_t *hv) {
+  switch (hv->kind) {
+    case HEAP_KIND_ARRAY: {
+      array_t *array = (array_t*)hv->ptr;
+
+      if (array->kind == ARRAY_VALUES) {
+        for (size_t i = 0; i < array->size; i++) {
+          snapshot_writeValue(w, &((value_t*)array->data)[i]);
+        }
+      } else {
+        snapshot_append(&w->body, array->data, array->size * array_elementSize(array->kind));
+      }
+
+      break;
+    }
+    case HEAP_KIND_MAP: {
+      map_t *map = (map_t*)hv->ptr;
+
+      for (size_t i = 0; i < map->capacity; i++) {
+        if (!(map->ctrl[i] & 0x80)) {
+          snapshot_appendString(&w->body, map->entries[i].key, map->entries[i].len);
+          snapshot_writeValue(w, &map->entries[i].value);
+        }
+      }
+
+      break;
+    }
+    default: {
+      object_t *object = (object_t*)hv->ptr;
+
+      if (object->shape != NULL) {
+        // in slot order, so putting them back gives the same shape
+        object_key_t keys[SHAPE_MAX_MEMBERS];
+
+        for (const shape_t *s = object->shape; s->parent != NULL; s = s->parent) {
+          keys[s->slot] = s->key;
+        }
+
+        for (uint32_t i = 0; i < object->shape->count; i++) {
+          snapshot_appendString(&w->body, keys[i], strlen(keys[i]));
+          snapshot_writeValue(w, &object->slots[i]);
+        }
+      } else {
+        for (size_t i = 0; i < object->numMembers; i++) {
+          if (object->members[i].used) {
+            snapshot_appendString(&w->body, object->members[i].key, strlen(object->members[i].key));
+            snapshot_writeValue(w, &object->members[i].value);
+          }
+        }
+      }
+
+      break;
+    }
+  }
+}
+
+// slots of each storage worth saving
+static uint64_t snapshot_count(runtime_t *rt, archtype_t at) {
+  datatable_t *dt = rt->dt;
+  storage_t *s = &dt->storage[at];
+  uint64_t count;
+
+  switch (at) {
+    case AT_LOCAL:
+      return VM_STACK_POINTER(dt) < s->count ? VM_STACK_POINTER(dt) : s->count;
+    case AT_DATA:
+      // static data sits past the length, so up to the last slot set
+      count = datatable_residentBytes(dt, AT_DATA) / sizeof(value_t);
+      count = count < s->count ? count : s->count;
+
+      while (count != 0 && VALUE_META(&s->data[count - 1]) == VALUE_METADATA(TYPE_NONE, FLAG_NONE)) {
+        --count;
+      }
+
+      return count;
+    default:
+      return s->count;
+  }
+}
+
+bool snapshot_write(runtime_t *rt, const snapshot_t *snapshot, const char **error) {
+  snapshot_writer_t w = { .rt = rt, .code = snapshot->code };
+  snapshot_header_t header = { .version = SNAPSHOT_VERSION };
+  FILE *fp;
+  bool ok;
+
+  // only the running fiber's values are in the datatable
+  if (rt->fibers != NULL && rt->fibers->live > 1) {
+    *error = "the program has fibers, which are not saved";
+    return false;
+  }
+
+  memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+  header.programHash = hashString64(snapshot->image->file, snapshot->image->fileLen);
+  header.pc = VM_PROGRAM_COUNTER(rt->dt);
+  header.numRegisters = NUM_REGISTERS;
+
+  for (int at = 0; at < 4; at++) {
+    storage_t *s = &rt->dt->storage[at];
+
+    header.counts[at] = snapshot_count(rt, (archtype_t)at);
+
+    for (uint64_t i = 0; i < header.counts[at]; i++) {
+      snapshot_writeValue(&w, &s->data[i]);
+    }
+  }
+
+  // written in the order they were found, which is their index
+  for (uint64_t i = 0; i < w.numNodes; i++) {
+    snapshot_writeNode(&w, w.queue[i]);
+  }
+
+  header.numBuffers = w.numBuffers;
+  header.numNodes = w.numNodes;
+
+  if ((fp = fopen(snapshot->path, "wb")) == NULL) {
+    *error = "could not open the file";
+    ok = false;
+  } else {
+    ok = fwrite(&header, sizeof(header), 1, fp) == 1
+      && fwrite(w.buffers.data, 1, w.buffers.len, fp) == w.buffers.len
+      && fwrite(w.nodes.data, 1, w.nodes.len, fp) == w.nodes.len
+      && fwrite(w.body.data, 1, w.body.len, fp) == w.body.len;
+    ok = fclose(fp) == 0 && ok;
+
+    if (!ok) {
+      *error = "could not write the file";
+    }
+  }
+
+  if (ok && w.lost != 0) {
+    fprintf(stderr, "snapshot: %zu raw pointers (e.g open files) were saved as null\n", w.lost);
+  }
+
+  free(w.buffers.data);
+  free(w.nodes.data);
+  free(w.body.data);
+  idmap_destroy(&w.ids);
+  free(w.queue);
+
+  return ok;
+}
+
+// ===== restoring =====
+
+typedef struct snapshot_reader {
+  runtime_t *rt;
+  const code_t *code;
+  const ubyte_t *data;
+  size_t len;
+  size_t pos;
+  const snapshot_header_t *header;
+  refcounted_t *buffers;
+  value_t *nodes;
+} snapshot_reader_t;
+
+// the next `len` bytes, NULL if the file ends first
+static const ubyte_t *snapshot_read(snapshot_reader_t *r, size_t len) {
+  size_t padded = (len + 7) & ~(size_t)7;
+  const ubyte_t *p = r->data + r->pos;
+
+  if (len > r->len || padded > r->len - r->pos) {
+    return NULL;
+  }
+
+  r->pos += padded;
+
+  return p;
+}
+
+static const char *snapshot_readString(snapshot_reader_t *r, size_t *len) {
+  uint64_t size;
+  const ubyte_t *p = snapshot_read(r, sizeof(size));
+
+  if (p == NULL) {
+    return NULL;
+  }
+
+  memcpy(&size, p, sizeof(size));
+  *len = size;
+
+  return (const char*)snapshot_read(r, size);
+}
+
+// the value a record describes, owning a reference to its buffer if it has one
+static bool snapshot_readValue(snapshot_reader_t *r, value_t *out) {
+  snapshot_value_t in;
+  const ubyte_t *p = snapshot_read(r, sizeof(in));
+
+  if (p == NULL) {
+    return false;
+  }
+
+  memcpy(&in, p, sizeof(in));
+  VALUE_META(out) = in.metadata;
+  out->data.u64 = in.payload;
+
+  switch (in.kind) {
+    case SNAPSHOT_BITS:
+      return true;
+    case SNAPSHOT_POOL:
+      // in a segment's pool, which is decoded if it is not yet
+      out->data.raw = (void*)code_poolData((code_t*)r->code, in.payload);
+      return out->data.raw != NULL;
+    case SNAPSHOT_BUFFER:
+      if (in.payload >= r->header->numBuffers) {
+        return false;
+      }
+
+      out->data.rc = rc_claim(r->buffers[in.payload]);
+      return true;
+    case SNAPSHOT_NODE:
+      if (in.payload >= r->header->numNodes) {
+        return false;
+      }
+
+      out->data.hv = r->nodes[in.payload].data.hv;
+      return true;
+    case SNAPSHOT_BUILTIN:
+      out->data.fn = builtins_function((uint32_t)in.payload);
+      return out->data.fn != NULL;
+    default:
+      return false;
+  }
+}
+
+static bool snapshot_readNode(snapshot_reader_t *r, const snapshot_node_t *node, value_t *v) {
+  switch (node->kind) {
+    case HEAP_KIND_ARRAY: {
+      array_t *array = (array_t*)v->data.hv->ptr;
+      const ubyte_t *p;
+
+      if (!array_resize(array, node->count)) {
+        return false;
+      }
+
+      if (array->kind != ARRAY_VALUES) {
+        const size_t elementSize = array_elementSize(array->kind);
+
+        if (node->count > SIZE_MAX / elementSize || (p = snapshot_read(r, node->count * elementSize)) == NULL) {
+          return false;
+        }
+
+        memcpy(array->data, p, node->count * elementSize);
+        return true;
+      }
+
+      // moved in rather than copied: the array takes over the references
+      for (uint64_t i = 0; i < node->count; i++) {
+        if (!snapshot_readValue(r, &((value_t*)array->data)[i])) {
+          return false;
+        }
+      }
+
+      return true;
+    }
+    case HEAP_KIND_MAP: {
+      map_t *map = (map_t*)v->data.hv->ptr;
+
+      for (uint64_t i = 0; i < node->count; i++) {
+        size_t len;
+        const char *key = snapshot_readString(r, &len);
+        value_t value;
+        bool ok;
+
+        if (key == NULL || !snapshot_readValue(r, &value)) {
+          return false;
+        }
+
+        ok = map_set(r->rt, map, key, len, &value);
+        value_release(r->rt, &value);
+
+        if (!ok) {
+          return false;
+        }
+      }
+
+      return true;
+    }
+    default: {
+      object_t *object = (object_t*)v->data.hv->ptr;
+
+      for (uint64_t i = 0; i < node->count; i++) {
+        size_t len;
+        const char *key = snapshot_readString(r, &len);
+        value_t value;
+
+        if (key == NULL || !snapshot_readValue(r, &value)) {
+          return false;
+        }
+
+        // the object takes over the reference, as with setObjectMember
+        if (object_put(object, (object_key_t)runtime_intern(r->rt, key, len), &value) != OBJECT_OK) {
+          value_release(r->rt, &value);
+          return false;
+        }
+      }
+
+      return true;
+    }
+  }
+}
+
+static bool snapshot_fail(const char **error, const char *message) {
+  *error = message;
+  return false;
+}
+
+bool snapshot_restore(runtime_t *rt, const snapshot_t *snapshot, const ubyte_t *data, size_t len,
+                      const char **error) {
+  snapshot_reader_t r = { .rt = rt, .code = snapshot->code, .data = data, .len = len };
+  snapshot_header_t header;
+  const ubyte_t *nodeTable;
+  const ubyte_t *p;
+  bool ok = false;
+  uint32_t index;
+  const instruction_t *call;
+
+  if ((p = snapshot_read(&r, sizeof(header))) == NULL) {
+    return snapshot_fail(error, "truncated header");
+  }
+
+  memcpy(&header, p, sizeof(header));
+  r.header = &header;
+
+  if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0 || header.version != SNAPSHOT_VERSION) {
+    return snapshot_fail(error, "not a snapshot of this version");
+  }
+
+  if (header.programHash != hashString64(snapshot->image->file, snapshot->image->fileLen)) {
+    return snapshot_fail(error, "saved from another program");
+  }
+
+  if (header.numRegisters != NUM_REGISTERS) {
+    return snapshot_fail(error, "saved with another NUM_REGISTERS");
+  }
+
+  for (int at = 0; at < 4; at++) {
+    if (header.counts[at] > rt->dt->storage[at].count) {
+      return snapshot_fail(error, "storage larger than this vm's");
+    }
+  }
+
+  // every node and buffer takes up at least 8 bytes, which bounds these
+  if (header.numBuffers > len / 8 || header.numNodes > len / sizeof(snapshot_node_t)) {
+    return snapshot_fail(error, "truncated");
+  }
+
+  r.buffers = (refcounted_t*)calloc(header.numBuffers + 1, sizeof(refcounted_t));
+  r.nodes = (value_t*)calloc(header.numNodes + 1, sizeof(value_t));
+  *error = "truncated or malformed";
+
+  for (uint64_t i = 0; i < header.numBuffers; i++) {
+    size_t size;
+    const char *bytes = snapshot_readString(&r, &size);
+
+    if (bytes == NULL || (r.buffers[i] = rc_alloc(rt->quota, size, 0)) == NULL) {
+      goto done;
+    }
+
+    memcpy(r.buffers[i], bytes, size);
+    rc_claim(r.buffers[i]); // held until the end, see below
+  }
+
+  if ((nodeTable = snapshot_read(&r, header.numNodes * sizeof(snapshot_node_t))) == NULL) {
+    goto done;
+  }
+
+  // created up front, so values can refer to nodes further on
+  for (uint64_t i = 0; i < header.numNodes; i++) {
+    snapshot_node_t node;
+
+    memcpy(&node, nodeTable + i * sizeof(node), sizeof(node));
+
+    if (node.kind == HEAP_KIND_ARRAY) {
+      if (node.arrayKind > ARRAY_BYTES) {
+        goto done;
+      }
+
+      r.nodes[i] = value_createArray(rt, rt->heap, (ARRAY_KIND)node.arrayKind, ARRAY_INITIAL_CAPACITY);
+    } else if (node.kind == HEAP_KIND_MAP) {
+      r.nodes[i] = value_createMap(rt, rt->heap);
+    } else {
+      r.nodes[i] = value_createObject(rt, rt->heap);
+    }
+  }
+
+  // the storages hold nothing that needs releasing yet: static data and
+  // builtins, set up by interpreter_create
+  for (int at = 0; at < 4; at++) {
+    storage_t *s = &rt->dt->storage[at];
+
+    for (uint64_t i = 0; i < header.counts[at]; i++) {
+      if (!snapshot_readValue(&r, &s->data[i])) {
+        VALUE_SET_META(&s->data[i], TYPE_NONE, FLAG_NONE);
+        goto done;
+      }
+    }
+  }
+
+  for (uint64_t i = 0; i < header.numNodes; i++) {
+    snapshot_node_t node;
+
+    memcpy(&node, nodeTable + i * sizeof(node), sizeof(node));
+
+    if (!snapshot_readNode(&r, &node, &r.nodes[i])) {
+      goto done;
+    }
+  }
+
+  // continue after the call: its result is true this time
+  index = code_indexOf((code_t*)snapshot->code, header.pc);
+  code_ensure((code_t*)snapshot->code, index - 1, index);
+
+  if (index == 0 || snapshot->code->instructions[index].offset != header.pc
+      || snapshot->code->instructions[index - 1].opcode != OP_CALL) {
+    *error = "not saved at a call";
+    goto done;
+  }
+
+  call = &snapshot->code->instructions[index - 1];
+
+  VM_PROGRAM_COUNTER(rt->dt) = header.pc;
+  value_setBoolean(rt, (call->flags & CALL_FLAGS_RESULT) ? CODE_OPERAND_VALUE(call->right) : &rt->dt->storage[AT_REG].data[0], true);
+  ok = true;
+
+done:
+  for (uint64_t i = 0; i < header.numBuffers && r.buffers[i] != NULL; i++) {
+    rc_release(r.buffers[i]);
+  }
+
+  free(r.buffers);
+  free(r.nodes);
+
+  return ok;
+}
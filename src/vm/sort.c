@@ -0,0 +1,634 @@
+#include <vm/sort.h>
+#include <vm/rc.h>
+
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define SORT_SIGN ((uint64_t)1 << 63)
+
+// an element with its key, for sorting by keys: the key radix sorted
+// when every key is a number of the same type, else compared
+typedef struct sort_pair {
+  uint64_t key;
+  uint64_t index;
+} sort_pair_t;
+
+typedef struct sort_keyed {
+  value_t *key;
+  size_t index;
+} sort_keyed_t;
+
+// ===== the order of values =====
+
+// none, booleans, numbers, strings, the rest
+static int sort_rank(value_t *v) {
+  switch (VALUE_TYPE_OF(v)) {
+    case TYPE_NONE:
+      return 0;
+    case TYPE_BOOLEAN:
+      return 1;
+    case TYPE_INT:
+    case TYPE_UINT:
+    case TYPE_DOUBLE:
+      return 2;
+    case TYPE_POINTER:
+      return (value_getFlags(v) & FLAG_OBJECT) ? 4 : 3;
+    default:
+      return 4;
+  }
+}
+
+// as builtins_string
+static const uint8_t *sort_string(value_t *v, size_t *len) {
+  const char *str = (const char*)value_getRawPointer(v);
+
+  if (str == NULL) {
+    *len = 0;
+  } else if (VALUE_IS_SLICE(v)) {
+    *len = strnlen(str, VALUE_SLICE_LENGTH(v));
+  } else {
+    *len = (value_getFlags(v) & FLAG_REFCOUNTED) ? strnlen(str, rc_size((void*)str)) : strlen(str);
+  }
+
+  return (const uint8_t*)str;
+}
+
+// a long double holds every int64_t, uint64_t and double exactly, so
+// numbers of different types compare by their value
+static long double sort_number(value_t *v) {
+  switch (VALUE_TYPE_OF(v)) {
+    case TYPE_INT:
+      return (long double)v->data.i64;
+    case TYPE_UINT:
+      return (long double)v->data.u64;
+    default:
+      return (long double)v->data.dbl;
+  }
+}
+
+static int sort_compareNumbers(value_t *a, value_t *b) {
+  if (VALUE_TYPE_OF(a) == TYPE_INT && VALUE_TYPE_OF(b) == TYPE_INT) {
+    return (a->data.i64 > b->data.i64) - (a->data.i64 < b->data.i64);
+  }
+
+  bool nanA = VALUE_TYPE_OF(a) == TYPE_DOUBLE && isnan(a->data.dbl);
+  bool nanB = VALUE_TYPE_OF(b) == TYPE_DOUBLE && isnan(b->data.dbl);
+
+  if (nanA || nanB) {
+    return nanA - nanB;
+  }
+
+  long double x = sort_number(a);
+  long double y = sort_number(b);
+
+  return (x > y) - (x < y);
+}
+
+int sort_compare(value_t *a, value_t *b) {
+  int rankA = sort_rank(a);
+  int rankB = sort_rank(b);
+
+  if (rankA != rankB) {
+    return rankA < rankB ? -1 : 1;
+  }
+
+  switch (rankA) {
+    case 0:
+      return 0;
+    case 1:
+      return (int)a->data.b - (int)b->data.b;
+    case 2:
+      return sort_compareNumbers(a, b);
+    case 3: {
+      size_t lenA, lenB;
+      const uint8_t *strA = sort_string(a, &lenA);
+      const uint8_t *strB = sort_string(b, &lenB);
+      int c = memcmp(strA, strB, lenA < lenB ? lenA : lenB);
+
+      if (c != 0) {
+        return c < 0 ? -1 : 1;
+      }
+
+      return (lenA > lenB) - (lenA < lenB);
+    }
+    default: {
+      uintptr_t x = (uintptr_t)a->data.raw;
+      uintptr_t y = (uintptr_t)b->data.raw;
+
+      return (x > y) - (x < y);
+    }
+  }
+}
+
+// ===== pdqsort =====
+
+#define SORT_TYPE uint64_t
+#define SORT_LESS(a, b) (*(a) < *(b))
+#define SORT_PDQ sort_pdqU64
+#include "sort_pdq.h"
+#undef SORT_PDQ
+#undef SORT_LESS
+#undef SORT_TYPE
+
+#define SORT_TYPE value_t
+#define SORT_LESS(a, b) (sort_compare((a), (b)) < 0)
+#define SORT_PDQ sort_pdqValues
+#include "sort_pdq.h"
+#undef SORT_PDQ
+#undef SORT_LESS
+#undef SORT_TYPE
+
+// the index breaks ties, which makes these stable
+static inline bool sort_pairLess(const sort_pair_t *a, const sort_pair_t *b) {
+  return a->key < b->key || (a->key == b->key && a->index < b->index);
+}
+
+#define SORT_TYPE sort_pair_t
+#define SORT_LESS(a, b) sort_pairLess((a), (b))
+#define SORT_PDQ sort_pdqPairs
+#include "sort_pdq.h"
+#undef SORT_PDQ
+#undef SORT_LESS
+#undef SORT_TYPE
+
+static inline bool sort_keyedLess(sort_keyed_t *a, sort_keyed_t *b) {
+  int c = sort_compare(a->key, b->key);
+
+  return c < 0 || (c == 0 && a->index < b->index);
+}
+
+#define SORT_TYPE sort_keyed_t
+#define SORT_LESS(a, b) sort_keyedLess((a), (b))
+#define SORT_PDQ sort_pdqKeyed
+#include "sort_pdq.h"
+#undef SORT_PDQ
+#undef SORT_LESS
+#undef SORT_TYPE
+
+// ===== radix sort =====
+
+// a part of the elements, sorted by one thread: its count of each value of
+// a byte, then where the first of them goes
+typedef struct sort_part {
+  const void *src;
+  void *dst;
+  bool pairs; // sort_pair_t elements rather than uint64_t
+  size_t begin;
+  size_t end;
+  unsigned shift; // of the byte this pass sorts by
+  bool every; // counting each byte of the keys, not the pass's
+  size_t counts[8][256];
+} sort_part_t;
+
+static inline uint64_t sort_key(const void *data, bool pairs, size_t i) {
+  return pairs ? ((const sort_pair_t*)data)[i].key : ((const uint64_t*)data)[i];
+}
+
+static void *sort_count(void *arg) {
+  sort_part_t *part = (sort_part_t*)arg;
+
+  if (part->every) {
+    memset(part->counts, 0, sizeof(part->counts));
+
+    for (size_t i = part->begin; i < part->end; i++) {
+      uint64_t key = part->pairs ? ((const sort_pair_t*)part->src)[i].key : ((const uint64_t*)part->src)[i];
+
+      for (unsigned b = 0; b < 8; b++) {
+        part->counts[b][(key >> (8 * b)) & 0xFF]++;
+      }
+    }
+  } else {
+    size_t *counts = part->counts[part->shift / 8];
+    unsigned shift = part->shift;
+
+    memset(counts, 0, 256 * sizeof(size_t));
+
+    if (part->pairs) {
+      const sort_pair_t *src = (const sort_pair_t*)part->src;
+
+      for (size_t i = part->begin; i < part->end; i++) {
+        counts[(src[i].key >> shift) & 0xFF]++;
+      }
+    } else {
+      const uint64_t *src = (const uint64_t*)part->src;
+
+      for (size_t i = part->begin; i < part->end; i++) {
+        counts[(src[i] >> shift) & 0xFF]++;
+      }
+    }
+  }
+
+  return NULL;
+}
+
+static void *sort_scatter(void *arg) {
+  sort_part_t *part = (sort_part_t*)arg;
+  size_t *at = part->counts[part->shift / 8];
+  unsigned shift = part->shift;
+
+  if (part->pairs) {
+    const sort_pair_t *src = (const sort_pair_t*)part->src;
+    sort_pair_t *dst = (sort_pair_t*)part->dst;
+
+    for (size_t i = part->begin; i < part->end; i++) {
+      dst[at[(src[i].key >> shift) & 0xFF]++] = src[i];
+    }
+  } else {
+    const uint64_t *src = (const uint64_t*)part->src;
+    uint64_t *dst = (uint64_t*)part->dst;
+
+    for (size_t i = part->begin; i < part->end; i++) {
+      dst[at[(src[i] >> shift) & 0xFF]++] = src[i];
+    }
+  }
+
+  return NULL;
+}
+
+// as heap_markerCount
+static size_t sort_threadCount() {
+  const char *env = getenv("BB8_SORT_THREADS");
+  long count = sysconf(_SC_NPROCESSORS_ONLN);
+
+  if (env != NULL && env[0] != '\0') {
+    count = strtol(env, NULL, 10);
+  }
+
+  if (count > SORT_MAX_THREADS) {
+    count = SORT_MAX_THREADS;
+  }
+
+  return count < 1 ? 1 : (size_t)count;
+}
+
+// `fn` on each part, the first on this thread; a thread that cannot be
+// started has its part run here too
+static void sort_run(sort_part_t *parts, size_t count, void *(*fn)(void*)) {
+  pthread_t threads[SORT_MAX_THREADS];
+  bool started[SORT_MAX_THREADS];
+
+  for (size_t i = 1; i < count; i++) {
+    started[i] = pthread_create(&threads[i], NULL, fn, &parts[i]) == 0;
+  }
+
+  fn(&parts[0]);
+
+  for (size_t i = 1; i < count; i++) {
+    if (started[i]) {
+      pthread_join(threads[i], NULL);
+    } else {
+      fn(&parts[i]);
+    }
+  }
+}
+
+// least significant byte first, each pass stable, into `tmp` and back.
+// a byte every key has the same value of needs no pass. with one part
+// the counts of each byte are taken at once, as moving elements does not
+// change them; with more, each part's count of the pass's byte is taken
+// again before it, but for the first.
+static void sort_radix(void *data, void *tmp, size_t n, bool pairs, size_t threads) {
+  size_t count = n >= SORT_PARALLEL_MIN ? threads : 1;
+  sort_part_t *parts = (sort_part_t*)malloc(count * sizeof(sort_part_t));
+
+  if (parts == NULL) {
+    count = 1;
+    parts = (sort_part_t*)malloc(sizeof(sort_part_t));
+
+    if (parts == NULL) {
+      if (pairs) {
+        sort_pdqPairs((sort_pair_t*)data, (sort_pair_t*)data + n);
+      } else {
+        sort_pdqU64((uint64_t*)data, (uint64_t*)data + n);
+      }
+
+      return;
+    }
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    parts[i].src = data;
+    parts[i].pairs = pairs;
+    parts[i].begin = n * i / count;
+    parts[i].end = n * (i + 1) / count;
+    parts[i].every = true;
+  }
+
+  sort_run(parts, count, sort_count);
+
+  size_t elementSize = pairs ? sizeof(sort_pair_t) : sizeof(uint64_t);
+  void *src = data;
+  void *dst = tmp;
+  bool fresh = true; // the parts' counts are of the elements as they are
+
+  for (unsigned b = 0; b < 8; b++) {
+    size_t total[256] = { 0 };
+
+    for (size_t i = 0; i < count; i++) {
+      for (size_t v = 0; v < 256; v++) {
+        total[v] += parts[i].counts[b][v];
+      }
+    }
+
+    // the byte is the same in every key
+    if (total[(sort_key(src, pairs, 0) >> (8 * b)) & 0xFF] == n) {
+      continue;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+      parts[i].src = src;
+      parts[i].dst = dst;
+      parts[i].shift = 8 * b;
+      parts[i].every = false;
+    }
+
+    if (!fresh) {
+      sort_run(parts, count, sort_count);
+    }
+
+    // digit major, part minor: a part's elements of a value go after
+    // those of the parts before it, which keeps the pass stable
+    size_t at = 0;
+
+    for (size_t v = 0; v < 256; v++) {
+      for (size_t i = 0; i < count; i++) {
+        size_t c = parts[i].counts[b][v];
+
+        parts[i].counts[b][v] = at;
+        at += c;
+      }
+    }
+
+    sort_run(parts, count, sort_scatter);
+
+    void *t = src;
+    src = dst;
+    dst = t;
+    // with one part, the counts of the other bytes are still good
+    fresh = count == 1;
+  }
+
+  if (src != data) {
+    memcpy(data, src, n * elementSize);
+  }
+
+  free(parts);
+}
+
+// sorts `n` uint64_t, or sort_pair_t by their key when `pairs`
+static void sort_keys(void *data, size_t n, bool pairs) {
+  if (n < SORT_RADIX_MIN) {
+    if (pairs) {
+      sort_pdqPairs((sort_pair_t*)data, (sort_pair_t*)data + n);
+    } else {
+      sort_pdqU64((uint64_t*)data, (uint64_t*)data + n);
+    }
+
+    return;
+  }
+
+  size_t elementSize = pairs ? sizeof(sort_pair_t) : sizeof(uint64_t);
+  void *tmp = malloc(n * elementSize);
+
+  if (tmp == NULL) {
+    if (pairs) {
+      sort_pdqPairs((sort_pair_t*)data, (sort_pair_t*)data + n);
+    } else {
+      sort_pdqU64((uint64_t*)data, (uint64_t*)data + n);
+    }
+
+    return;
+  }
+
+  sort_radix(data, tmp, n, pairs, sort_threadCount());
+  free(tmp);
+}
+
+// ===== keys =====
+
+static inline uint64_t sort_fromI64(int64_t i64) {
+  return (uint64_t)i64 ^ SORT_SIGN;
+}
+
+static inline int64_t sort_toI64(uint64_t key) {
+  return (int64_t)(key ^ SORT_SIGN);
+}
+
+// a NaN loses its sign, which puts it after +inf
+static inline uint64_t sort_fromF64(double dbl) {
+  uint64_t bits;
+
+  memcpy(&bits, &dbl, sizeof(bits));
+
+  if (isnan(dbl)) {
+    return bits | SORT_SIGN;
+  }
+
+  return (bits & SORT_SIGN) ? ~bits : bits | SORT_SIGN;
+}
+
+static inline double sort_toF64(uint64_t key) {
+  uint64_t bits = (key & SORT_SIGN) ? key ^ SORT_SIGN : ~key;
+  double dbl;
+
+  memcpy(&dbl, &bits, sizeof(dbl));
+
+  return dbl;
+}
+
+// the type every one of the `n` values is of, if they are all ints, all
+// uints or all doubles; TYPE_NONE otherwise
+static VALUE_TYPE sort_numberType(value_t *values, size_t n) {
+  VALUE_TYPE type = VALUE_TYPE_OF(&values[0]);
+
+  if (type != TYPE_INT && type != TYPE_UINT && type != TYPE_DOUBLE) {
+    return TYPE_NONE;
+  }
+
+  for (size_t i = 1; i < n; i++) {
+    if (VALUE_TYPE_OF(&values[i]) != type) {
+      return TYPE_NONE;
+    }
+  }
+
+  return type;
+}
+
+static inline uint64_t sort_encode(value_t *v, VALUE_TYPE type) {
+  switch (type) {
+    case TYPE_INT:
+      return sort_fromI64(v->data.i64);
+    case TYPE_UINT:
+      return v->data.u64;
+    default:
+      return sort_fromF64(v->data.dbl);
+  }
+}
+
+// ===== arrays =====
+
+static void sort_i64(int64_t *data, size_t n) {
+  uint64_t *keys = (uint64_t*)data;
+
+  for (size_t i = 0; i < n; i++) {
+    keys[i] = sort_fromI64(data[i]);
+  }
+
+  sort_keys(keys, n, false);
+
+  for (size_t i = 0; i < n; i++) {
+    data[i] = sort_toI64(keys[i]);
+  }
+}
+
+static void sort_f64(double *data, size_t n) {
+  uint64_t *keys = (uint64_t*)data;
+
+  for (size_t i = 0; i < n; i++) {
+    keys[i] = sort_fromF64(data[i]);
+  }
+
+  sort_keys(keys, n, false);
+
+  for (size_t i = 0; i < n; i++) {
+    data[i] = sort_toF64(keys[i]);
+  }
+}
+
+static void sort_bytes(uint8_t *data, size_t n) {
+  size_t counts[256] = { 0 };
+
+  for (size_t i = 0; i < n; i++) {
+    counts[data[i]]++;
+  }
+
+  for (size_t v = 0; v < 256; v++) {
+    memset(data, (int)v, counts[v]);
+    data += counts[v];
+  }
+}
+
+// values that are all numbers of one type are radix sorted as a typed
+// array is, through a copy of their keys; the values themselves are
+// scalars, rewritten in place
+static void sort_values(value_t *data, size_t n) {
+  VALUE_TYPE type = n >= SORT_RADIX_MIN ? sort_numberType(data, n) : TYPE_NONE;
+  uint64_t *keys = type != TYPE_NONE ? (uint64_t*)malloc(n * sizeof(uint64_t)) : NULL;
+
+  if (keys == NULL) {
+    sort_pdqValues(data, data + n);
+    return;
+  }
+
+  for (size_t i = 0; i < n; i++) {
+    keys[i] = sort_encode(&data[i], type);
+  }
+
+  sort_keys(keys, n, false);
+
+  for (size_t i = 0; i < n; i++) {
+    switch (type) {
+      case TYPE_INT:
+        data[i].data.i64 = sort_toI64(keys[i]);
+        break;
+      case TYPE_UINT:
+        data[i].data.u64 = keys[i];
+        break;
+      default:
+        data[i].data.dbl = sort_toF64(keys[i]);
+        break;
+    }
+  }
+
+  free(keys);
+}
+
+void sort_array(array_t *array) {
+  if (array->size < 2) {
+    return;
+  }
+
+  switch (array->kind) {
+    case ARRAY_I64:
+      sort_i64((int64_t*)array->data, array->size);
+      break;
+    case ARRAY_F64:
+      sort_f64((double*)array->data, array->size);
+      break;
+    case ARRAY_BYTES:
+      sort_bytes((uint8_t*)array->data, array->size);
+      break;
+    default:
+      sort_values((value_t*)array->data, array->size);
+      break;
+  }
+}
+
+// the elements in the order `index` gives, moved rather than copied
+static bool sort_permute(value_t *data, size_t n, const void *order, bool pairs) {
+  value_t *tmp = (value_t*)malloc(n * sizeof(value_t));
+
+  if (tmp == NULL) {
+    return false;
+  }
+
+  for (size_t i = 0; i < n; i++) {
+    size_t index = pairs ? ((const sort_pair_t*)order)[i].index : ((const sort_keyed_t*)order)[i].index;
+
+    tmp[i] = data[index];
+  }
+
+  memcpy(data, tmp, n * sizeof(value_t));
+  free(tmp);
+
+  return true;
+}
+
+bool sort_byKeys(array_t *array, value_t *keys) {
+  size_t n = array->size;
+  value_t *data = (value_t*)array->data;
+
+  if (n < 2) {
+    return true;
+  }
+
+  VALUE_TYPE type = sort_numberType(keys, n);
+  bool done;
+
+  if (type != TYPE_NONE) {
+    sort_pair_t *pairs = (sort_pair_t*)malloc(n * sizeof(sort_pair_t));
+
+    if (pairs == NULL) {
+      return false;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+      pairs[i].key = sort_encode(&keys[i], type);
+      pairs[i].index = i;
+    }
+
+    sort_keys(pairs, n, true);
+    done = sort_permute(data, n, pairs, true);
+    free(pairs);
+  } else {
+    sort_keyed_t *keyed = (sort_keyed_t*)malloc(n * sizeof(sort_keyed_t));
+
+    if (keyed == NULL) {
+      return false;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+      keyed[i].key = &keys[i];
+      keyed[i].index = i;
+    }
+
+    sort_pdqKeyed(keyed, keyed + n);
+    done = sort_permute(data, n, keyed, false);
+    free(keyed);
+  }
+
+  return done;
+}
@@ -0,0 +1,270 @@
+// pattern-defeating quicksort, included by sort.c once for each type it
+// sorts this way:
+// SORT_TYPE -- the element type, copied by assignment
+// SORT_LESS(a, b) -- whether the element at `a` orders before the one at
+//   `b`; a strict weak order. each argument is evaluated once, and some
+//   have side effects.
+// SORT_PDQ names the function being defined, which sorts the elements
+// from `begin` up to `end`. it follows Orson Peters' pdqsort.
+
+#define SORT_PASTE2(a, b) a##_##b
+#define SORT_PASTE(a, b) SORT_PASTE2(a, b)
+#define SORT_LOCAL(name) SORT_PASTE(SORT_PDQ, name)
+
+// below this, insertion sort
+#define SORT_INSERTION_MAX 24
+// above this, the pivot is the median of nine rather than of three
+#define SORT_NINTHER_MIN 128
+// elements partial_insertion moves before giving up
+#define SORT_PARTIAL_LIMIT 8
+
+static inline void SORT_LOCAL(swap)(SORT_TYPE *a, SORT_TYPE *b) {
+  SORT_TYPE t = *a;
+
+  *a = *b;
+  *b = t;
+}
+
+static inline void SORT_LOCAL(sort2)(SORT_TYPE *a, SORT_TYPE *b) {
+  if (SORT_LESS(b, a)) {
+    SORT_LOCAL(swap)(a, b);
+  }
+}
+
+static inline void SORT_LOCAL(sort3)(SORT_TYPE *a, SORT_TYPE *b, SORT_TYPE *c) {
+  SORT_LOCAL(sort2)(a, b);
+  SORT_LOCAL(sort2)(b, c);
+  SORT_LOCAL(sort2)(a, b);
+}
+
+// `unguarded`: an element no greater than any of them is before `begin`,
+// which stops the shifting instead of the test against `begin`
+static void SORT_LOCAL(insertion)(SORT_TYPE *begin, SORT_TYPE *end, bool unguarded) {
+  for (SORT_TYPE *cur = begin + 1; cur < end; cur++) {
+    if (!SORT_LESS(cur, cur - 1)) {
+      continue;
+    }
+
+    SORT_TYPE tmp = *cur;
+    SORT_TYPE *sift = cur;
+
+    do {
+      *sift = *(sift - 1);
+      sift--;
+    } while ((unguarded || sift != begin) && SORT_LESS(&tmp, sift - 1));
+
+    *sift = tmp;
+  }
+}
+
+// insertion sort that gives up once it has moved SORT_PARTIAL_LIMIT
+// elements; whether it sorted them
+static bool SORT_LOCAL(partialInsertion)(SORT_TYPE *begin, SORT_TYPE *end) {
+  size_t moved = 0;
+
+  for (SORT_TYPE *cur = begin + 1; cur < end; cur++) {
+    if (!SORT_LESS(cur, cur - 1)) {
+      continue;
+    }
+
+    SORT_TYPE tmp = *cur;
+    SORT_TYPE *sift = cur;
+
+    do {
+      *sift = *(sift - 1);
+      sift--;
+    } while (sift != begin && SORT_LESS(&tmp, sift - 1));
+
+    *sift = tmp;
+    moved += (size_t)(cur - sift);
+
+    if (moved > SORT_PARTIAL_LIMIT) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static void SORT_LOCAL(siftDown)(SORT_TYPE *heap, size_t root, size_t size) {
+  for (size_t child; (child = 2 * root + 1) < size; root = child) {
+    if (child + 1 < size && SORT_LESS(&heap[child], &heap[child + 1])) {
+      child++;
+    }
+
+    if (!SORT_LESS(&heap[root], &heap[child])) {
+      return;
+    }
+
+    SORT_LOCAL(swap)(&heap[root], &heap[child]);
+  }
+}
+
+static void SORT_LOCAL(heapsort)(SORT_TYPE *begin, SORT_TYPE *end) {
+  size_t size = (size_t)(end - begin);
+
+  for (size_t i = size / 2; i-- > 0;) {
+    SORT_LOCAL(siftDown)(begin, i, size);
+  }
+
+  for (size_t i = size; i-- > 1;) {
+    SORT_LOCAL(swap)(&begin[0], &begin[i]);
+    SORT_LOCAL(siftDown)(begin, 0, i);
+  }
+}
+
+// partitions around the pivot at `begin`: those less than it before it,
+// the rest after. where the pivot ends up; `*partitioned` if nothing had
+// to be swapped.
+static SORT_TYPE *SORT_LOCAL(partitionRight)(SORT_TYPE *begin, SORT_TYPE *end, bool *partitioned) {
+  SORT_TYPE pivot = *begin;
+  SORT_TYPE *first = begin;
+  SORT_TYPE *last = end;
+
+  // the median of three (or nine) put an element no less than the pivot
+  // before the end, so the first scan is bounded
+  while (SORT_LESS(++first, &pivot));
+
+  if (first - 1 == begin) {
+    while (first < last && !SORT_LESS(--last, &pivot));
+  } else {
+    while (!SORT_LESS(--last, &pivot));
+  }
+
+  *partitioned = first >= last;
+
+  while (first < last) {
+    SORT_LOCAL(swap)(first, last);
+    while (SORT_LESS(++first, &pivot));
+    while (!SORT_LESS(--last, &pivot));
+  }
+
+  SORT_TYPE *at = first - 1;
+
+  *begin = *at;
+  *at = pivot;
+
+  return at;
+}
+
+// as partitionRight, but elements equal to the pivot go before it; used
+// when the pivot equals the element before the range, for then none are
+// less than it, and all those equal to it are done with at once
+static SORT_TYPE *SORT_LOCAL(partitionLeft)(SORT_TYPE *begin, SORT_TYPE *end) {
+  SORT_TYPE pivot = *begin;
+  SORT_TYPE *first = begin;
+  SORT_TYPE *last = end;
+
+  while (SORT_LESS(&pivot, --last));
+
+  if (last + 1 == end) {
+    while (first < last && !SORT_LESS(&pivot, ++first));
+  } else {
+    while (!SORT_LESS(&pivot, ++first));
+  }
+
+  while (first < last) {
+    SORT_LOCAL(swap)(first, last);
+    while (SORT_LESS(&pivot, --last));
+    while (!SORT_LESS(&pivot, ++first));
+  }
+
+  *begin = *last;
+  *last = pivot;
+
+  return last;
+}
+
+// `bad`: the unbalanced partitions still allowed before heapsort.
+// `leftmost`: nothing is before `begin`; otherwise the element there is
+// no greater than any in the range.
+static void SORT_LOCAL(loop)(SORT_TYPE *begin, SORT_TYPE *end, int bad, bool leftmost) {
+  for (;;) {
+    size_t size = (size_t)(end - begin);
+
+    if (size < SORT_INSERTION_MAX) {
+      SORT_LOCAL(insertion)(begin, end, !leftmost);
+      return;
+    }
+
+    size_t half = size / 2;
+
+    if (size > SORT_NINTHER_MIN) {
+      SORT_LOCAL(sort3)(begin, begin + half, end - 1);
+      SORT_LOCAL(sort3)(begin + 1, begin + (half - 1), end - 2);
+      SORT_LOCAL(sort3)(begin + 2, begin + (half + 1), end - 3);
+      SORT_LOCAL(sort3)(begin + (half - 1), begin + half, begin + (half + 1));
+      SORT_LOCAL(swap)(begin, begin + half);
+    } else {
+      SORT_LOCAL(sort3)(begin + half, begin, end - 1);
+    }
+
+    if (!leftmost && !SORT_LESS(begin - 1, begin)) {
+      begin = SORT_LOCAL(partitionLeft)(begin, end) + 1;
+      continue;
+    }
+
+    bool partitioned;
+    SORT_TYPE *pivot = SORT_LOCAL(partitionRight)(begin, end, &partitioned);
+    size_t left = (size_t)(pivot - begin);
+    size_t right = (size_t)(end - (pivot + 1));
+
+    if (left < size / 8 || right < size / 8) {
+      if (--bad == 0) {
+        SORT_LOCAL(heapsort)(begin, end);
+        return;
+      }
+
+      // breaks up the pattern that made the pivot bad
+      if (left >= SORT_INSERTION_MAX) {
+        SORT_LOCAL(swap)(begin, begin + left / 4);
+        SORT_LOCAL(swap)(pivot - 1, pivot - left / 4);
+
+        if (left > SORT_NINTHER_MIN) {
+          SORT_LOCAL(swap)(begin + 1, begin + (left / 4 + 1));
+          SORT_LOCAL(swap)(begin + 2, begin + (left / 4 + 2));
+          SORT_LOCAL(swap)(pivot - 2, pivot - (left / 4 + 1));
+          SORT_LOCAL(swap)(pivot - 3, pivot - (left / 4 + 2));
+        }
+      }
+
+      if (right >= SORT_INSERTION_MAX) {
+        SORT_LOCAL(swap)(pivot + 1, pivot + (1 + right / 4));
+        SORT_LOCAL(swap)(end - 1, end - right / 4);
+
+        if (right > SORT_NINTHER_MIN) {
+          SORT_LOCAL(swap)(pivot + 2, pivot + (2 + right / 4));
+          SORT_LOCAL(swap)(pivot + 3, pivot + (3 + right / 4));
+          SORT_LOCAL(swap)(end - 2, end - (1 + right / 4));
+          SORT_LOCAL(swap)(end - 3, end - (2 + right / 4));
+        }
+      }
+    } else if (partitioned
+        && SORT_LOCAL(partialInsertion)(begin, pivot)
+        && SORT_LOCAL(partialInsertion)(pivot + 1, end)) {
+      // it looked sorted, and was
+      return;
+    }
+
+    SORT_LOCAL(loop)(begin, pivot, bad, leftmost);
+    begin = pivot + 1;
+    leftmost = false;
+  }
+}
+
+static void SORT_PDQ(SORT_TYPE *begin, SORT_TYPE *end) {
+  int bad = 1;
+
+  for (size_t size = (size_t)(end - begin); size > 1; size >>= 1) {
+    bad++;
+  }
+
+  SORT_LOCAL(loop)(begin, end, bad, true);
+}
+
+#undef SORT_LOCAL
+#undef SORT_PASTE
+#undef SORT_PASTE2
+#undef SORT_INSERTION_MAX
+#undef SORT_NINTHER_MIN
+#undef SORT_PARTIAL_LIMIT
@@ -0,0 +1,196 @@
+#include <vm/stream.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #define STREAM_MMAP 1
+#endif
+
+// `size` bytes and the byte for the NUL, STREAM_ALIGN aligned.
+// aligned_alloc wants a multiple of the alignment.
+static uint8_t *stream_allocBuffer(size_t size) {
+  return (uint8_t*)aligned_alloc(STREAM_ALIGN, size + STREAM_ALIGN);
+}
+
+stream_t *stream_open(const char *path) {
+  FILE *fp = fopen(path, "rb");
+  stream_t *stream;
+
+  if (fp == NULL) {
+    return NULL;
+  }
+
+  setvbuf(fp, NULL, _IONBF, 0);
+
+  stream = (stream_t*)malloc(sizeof(stream_t));
+  stream->fp = fp;
+  stream->buf = stream_allocBuffer(STREAM_BUFFER_SIZE);
+  stream->capacity = STREAM_BUFFER_SIZE;
+  stream->pos = 0;
+  stream->len = 0;
+  stream->eof = false;
+  stream->map = NULL;
+  stream->mapLen = 0;
+
+  return stream;
+}
+
+void stream_close(stream_t *stream) {
+  if (stream->fp != NULL) {
+    fclose(stream->fp);
+    stream->fp = NULL;
+  }
+
+#if STREAM_MMAP
+  if (stream->map != NULL) {
+    munmap(stream->map, stream->mapLen);
+    stream->map = NULL;
+  }
+#endif
+
+  free(stream->buf);
+  stream->buf = NULL;
+  stream->pos = 0;
+  stream->len = 0;
+  stream->eof = true;
+}
+
+void stream_destructor(runtime_t *rt, args_t *args) {
+  if (args->_rawData != NULL) {
+    stream_close((stream_t*)args->_rawData);
+    free(args->_rawData);
+  }
+}
+
+size_t stream_read(stream_t *stream, void *dst, size_t size) {
+  size_t buffered = stream->len - stream->pos;
+  size_t n;
+
+  if (stream->fp == NULL) {
+    return 0;
+  }
+
+  if (buffered > size) {
+    buffered = size;
+  }
+
+  memcpy(dst, stream->buf + stream->pos, buffered);
+  stream->pos += buffered;
+
+  if (buffered == size || stream->eof) {
+    return buffered;
+  }
+
+  // the rest bypasses the buffer
+  n = fread((uint8_t*)dst + buffered, 1, size - buffered, stream->fp);
+
+  if (n < size - buffered) {
+    stream->eof = true;
+  }
+
+  return buffered + n;
+}
+
+const char *stream_readLine(stream_t *stream, size_t *len) {
+  if (stream->fp == NULL) {
+    return NULL;
+  }
+
+  for (;;) {
+    uint8_t *start = stream->buf + stream->pos;
+    size_t rest = stream->len - stream->pos;
+    uint8_t *nl = (uint8_t*)memchr(start, '\n', rest);
+    size_t n;
+
+    if (nl != NULL) {
+      *nl = '\0';
+      *len = (size_t)(nl - start);
+      stream->pos += *len + 1;
+
+      return (const char*)start;
+    }
+
+    if (stream->eof) {
+      if (rest == 0) {
+        return NULL;
+      }
+
+      // the last line, without a '\n'; there is always room for the NUL
+      start[rest] = '\0';
+      *len = rest;
+      stream->pos = stream->len;
+
+      return (const char*)start;
+    }
+
+    // keep the partial line, at the front, and read more after it
+    memmove(stream->buf, start, rest);
+    stream->pos = 0;
+    stream->len = rest;
+
+    if (rest == stream->capacity) {
+      uint8_t *grown = stream_allocBuffer(stream->capacity * 2);
+
+      memcpy(grown, stream->buf, rest);
+      free(stream->buf);
+
+      stream->buf = grown;
+      stream->capacity *= 2;
+    }
+
+    n = fread(stream->buf + stream->len, 1, stream->capacity - stream->len, stream->fp);
+
+    if (n == 0) {
+      stream->eof = true;
+    }
+
+    stream->len += n;
+  }
+}
+
+const void *stream_map(stream_t *stream, size_t *len) {
+#if STREAM_MMAP
+  struct stat st;
+  void *mem;
+
+  if (stream->map != NULL) {
+    *len = stream->mapLen;
+    return stream->map;
+  }
+
+  if (stream->fp == NULL || fstat(fileno(stream->fp), &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+    return NULL;
+  }
+
+  mem = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fileno(stream->fp), 0);
+
+  if (mem == MAP_FAILED) {
+    return NULL;
+  }
+
+  madvise(mem, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+  stream->map = mem;
+  stream->mapLen = (size_t)st.st_size;
+  *len = stream->mapLen;
+
+  return mem;
+#else
+  return NULL;
+#endif
+}
+
+int64_t stream_size(stream_t *stream) {
+#if STREAM_MMAP
+  struct stat st;
+
+  if (stream->fp != NULL && fstat(fileno(stream->fp), &st) == 0 && S_ISREG(st.st_mode)) {
+    return (int64_t)st.st_size;
+  }
+#endif
+
+  return -1;
+}
@@ -0,0 +1,1001 @@
+#include <vm/task.h>
+#include <vm/runtime.h>
+#include <vm/interpreter.h>
+#include <vm/program.h>
+#include <vm/builtins.h>
+#include <vm/fiber.h>
+#include <vm/channel.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <sched.h>
+#include <unistd.h>
+#include <pthread.h>
+
+// the ring of a deque; replaced by one twice the size when it fills. the
+// old ones may still be read by a thief, so they are kept until the end.
+typedef struct task_ring {
+  int64_t cap; // a power of two
+  _Atomic(task_t*) *slots;
+  struct task_ring *prev;
+} task_ring_t;
+
+// Chase and Lev's deque, with the orderings of Lê et al. for C11 atomics
+typedef struct task_deque {
+  _Atomic int64_t top; // next to steal
+  _Atomic int64_t bottom; // next to push
+  _Atomic(task_ring_t*) ring;
+} task_deque_t;
+
+// what a parallelFor slice's results add up to
+typedef struct task_total {
+  int64_t i64;
+  double f64;
+  bool isDouble; // a double was among them: the total is f64 + i64
+} task_total_t;
+
+// the elements a parallelMap or parallelReduce slice calls its callback on,
+// or the indices a parallelFor slice does
+struct task_slice {
+  bool reduce;
+  value_t fn; // a label, or a native function
+  const array_t *in; // read by the pool while the caller waits for the slice
+  const task_value_t *partials; // instead of `in`: the slices' results, for a reduce's last fold
+  size_t begin;
+  size_t end;
+
+  bool hasInit; // a reduce folds from `init`, else from its first element
+  task_value_t init;
+  task_value_t *results; // one per element for a map, a reduce's in [0]
+
+  bool range; // parallelFor's: neither `in` nor `results`
+  int64_t first; // the index of element 0
+  tasks_reduction_t reduction;
+  task_total_t total;
+};
+
+// a runtime a worker runs tasks on, at one depth
+typedef struct task_context {
+  runtime_t *rt;
+  interpreter_t *it;
+  pthread_t gcThread;
+} task_context_t;
+
+typedef struct task_worker {
+  tasks_t *tasks;
+  size_t index;
+  task_deque_t deque;
+  pthread_t thread; // not for the first worker, which is the spawning thread
+
+  // by depth, created as they are needed. the first worker's depth 0 is
+  // the runtime that started the pool, so its [0] stays NULL.
+  task_context_t *contexts[TASKS_MAX_DEPTH + 1];
+  size_t depth; // of what the worker is running
+  uint64_t seed; // for picking a victim to steal from
+} task_worker_t;
+
+struct tasks {
+  runtime_t *owner;
+  program_t *program; // referenced by the pool
+  task_worker_t *workers;
+  size_t count;
+
+  atomic_bool stop;
+  atomic_size_t queued; // tasks in TASK_QUEUED; idle workers sleep while there are none
+  atomic_size_t sleepers;
+  pthread_mutex_t lock; // for sleeping on `cond`
+  pthread_cond_t cond;
+};
+
+// the worker the calling thread is, in the pool it belongs to
+static _Thread_local task_worker_t *tasks_self = NULL;
+
+static task_ring_t *tasks_ringCreate(int64_t cap, task_ring_t *prev) {
+  task_ring_t *ring = (task_ring_t*)malloc(sizeof(task_ring_t));
+
+  ring->cap = cap;
+  ring->slots = (_Atomic(task_t*)*)calloc((size_t)cap, sizeof(_Atomic(task_t*)));
+  ring->prev = prev;
+
+  return ring;
+}
+
+static void tasks_dequeInit(task_deque_t *d) {
+  atomic_init(&d->top, 0);
+  atomic_init(&d->bottom, 0);
+  atomic_init(&d->ring, tasks_ringCreate(TASKS_DEQUE_INITIAL_CAP, NULL));
+}
+
+static void tasks_dequeDestroy(task_deque_t *d) {
+  task_ring_t *ring = atomic_load_explicit(&d->ring, memory_order_relaxed);
+
+  while (ring != NULL) {
+    task_ring_t *prev = ring->prev;
+
+    free(ring->slots);
+    free(ring);
+    ring = prev;
+  }
+}
+
+// only by the owner
+static void tasks_dequePush(task_deque_t *d, task_t *task) {
+  int64_t b = atomic_load_explicit(&d->bottom, memory_order_relaxed);
+  int64_t t = atomic_load_explicit(&d->top, memory_order_acquire);
+  task_ring_t *ring = atomic_load_explicit(&d->ring, memory_order_relaxed);
+
+  if (b - t > ring->cap - 1) {
+    task_ring_t *grown = tasks_ringCreate(ring->cap * 2, ring);
+
+    for (int64_t i = t; i < b; i++) {
+      atomic_store_explicit(&grown->slots[i & (grown->cap - 1)],
+        atomic_load_explicit(&ring->slots[i & (ring->cap - 1)], memory_order_relaxed), memory_order_relaxed);
+    }
+
+    atomic_store_explicit(&d->ring, grown, memory_order_release);
+    ring = grown;
+  }
+
+  atomic_store_explicit(&ring->slots[b & (ring->cap - 1)], task, memory_order_relaxed);
+  // publishes the task, and the slot, to a thief that reads the new bottom
+  atomic_store_explicit(&d->bottom, b + 1, memory_order_release);
+}
+
+// only by the owner: the task pushed last, or NULL
+static task_t *tasks_dequeTake(task_deque_t *d) {
+  int64_t b = atomic_load_explicit(&d->bottom, memory_order_relaxed) - 1;
+  task_ring_t *ring = atomic_load_explicit(&d->ring, memory_order_relaxed);
+  task_t *task = NULL;
+  int64_t t;
+
+  // the store and the load are ordered against a thief's, so the two
+  // agree on which of them gets the last task
+  atomic_store_explicit(&d->bottom, b, memory_order_seq_cst);
+  t = atomic_load_explicit(&d->top, memory_order_seq_cst);
+
+  if (t <= b) {
+    task = atomic_load_explicit(&ring->slots[b & (ring->cap - 1)], memory_order_relaxed);
+
+    if (t == b) {
+      // the last one: a thief may be taking it too
+      if (!atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed)) {
+        task = NULL;
+      }
+
+      atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+    }
+  } else {
+    atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+  }
+
+  return task;
+}
+
+// by anyone: the task pushed first, or NULL if there is none or another
+// thread took it meanwhile
+static task_t *tasks_dequeSteal(task_deque_t *d) {
+  int64_t t = atomic_load_explicit(&d->top, memory_order_seq_cst);
+  int64_t b = atomic_load_explicit(&d->bottom, memory_order_seq_cst);
+  task_ring_t *ring;
+  task_t *task;
+
+  if (t >= b) {
+    return NULL;
+  }
+
+  ring = atomic_load_explicit(&d->ring, memory_order_acquire);
+  task = atomic_load_explicit(&ring->slots[t & (ring->cap - 1)], memory_order_relaxed);
+
+  if (!atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed)) {
+    return NULL;
+  }
+
+  return task;
+}
+
+// ===== values =====
+
+// a copy of `v` that refers to nothing on its runtime
+static void tasks_export(task_value_t *out, const value_t *v) {
+  out->copy = NULL;
+  out->size = 0;
+  out->channel = NULL;
+  out->value = *v;
+
+  if (VALUE_TYPE_OF(v) != TYPE_POINTER) {
+    return;
+  }
+
+  if (VALUE_HAS(v, TYPE_POINTER, FLAG_OBJECT | FLAG_CHANNEL)) {
+    out->channel = channel_retain((channel_t*)v->data.hv->ptr);
+    out->value.data.u64 = 0;
+    VALUE_SET_META(&out->value, TYPE_NONE, FLAG_NONE);
+  } else if (VALUE_HAS(v, TYPE_POINTER, FLAG_OBJECT) || VALUE_HAS(v, TYPE_POINTER, FLAG_MALLOC)) {
+    // heap nodes are their runtime's, and so is memory it frees
+    out->value.data.u64 = 0;
+    VALUE_SET_META(&out->value, TYPE_NONE, FLAG_NONE);
+  } else if (VALUE_HAS(v, TYPE_POINTER, FLAG_REFCOUNTED) && rc_isShared(v->data.rc)) {
+    // referenced by the task; its count is atomic
+    rc_claim(v->data.rc);
+  } else if (VALUE_HAS(v, TYPE_POINTER, FLAG_REFCOUNTED)) {
+    // the count is not atomic, so the buffer stays with its runtime. of a
+    // slice, only its part.
+    size_t size = VALUE_IS_SLICE(v) ? VALUE_SLICE_LENGTH(v) : rc_size(v->data.rc);
+
+    out->copy = (char*)malloc(size + 1);
+    out->size = size;
+    memcpy(out->copy, value_getRawPointer((value_t*)v), size);
+    out->copy[size] = '\0';
+    out->value = value_fromRawPointer(out->copy, FLAG_NONE);
+  }
+
+  // inline data is in the value itself, constants are in the program's
+  // pool, and other raw pointers are passed as they are
+}
+
+// the exported value on the runtime `rt`
+static value_t tasks_import(runtime_t *rt, const task_value_t *in) {
+  if (in->channel != NULL) {
+    return value_createChannel(rt, rt->heap, channel_retain(in->channel));
+  }
+
+  return in->value;
+}
+
+// like tasks_import, but a value the caller releases: a string is copied
+// into a buffer of `rt`'s
+static value_t tasks_importOwned(runtime_t *rt, const task_value_t *in) {
+  value_t v = tasks_import(rt, in);
+
+  if (in->copy != NULL) {
+    v.data.u64 = 0;
+    VALUE_SET_META(&v, TYPE_NONE, FLAG_NONE);
+    value_setData(rt, &v, in->copy, in->size);
+  } else if (VALUE_HAS(&v, TYPE_POINTER, FLAG_REFCOUNTED)) {
+    rc_claim(v.data.rc); // a shared buffer
+  }
+
+  return v;
+}
+
+static void tasks_valueRelease(task_value_t *v) {
+  free(v->copy);
+
+  if (VALUE_HAS(&v->value, TYPE_POINTER, FLAG_REFCOUNTED)) {
+    rc_release(v->value.data.rc); // a shared buffer
+  }
+
+  if (v->channel != NULL) {
+    channel_release(v->channel);
+  }
+}
+
+// ===== tasks =====
+
+static void tasks_release(task_t *task) {
+  if (atomic_fetch_sub_explicit(&task->refs, 1, memory_order_acq_rel) != 1) {
+    return;
+  }
+
+  tasks_valueRelease(&task->arg);
+  tasks_valueRelease(&task->result);
+
+  if (task->slice != NULL) {
+    task_slice_t *s = task->slice;
+
+    for (size_t i = 0; !s->range && i < (s->reduce ? 1 : s->end - s->begin); i++) {
+      tasks_valueRelease(&s->results[i]);
+    }
+
+    if (s->hasInit) {
+      tasks_valueRelease(&s->init);
+    }
+
+    free(s->results);
+    free(s);
+  }
+
+  free(task);
+}
+
+// TASK_QUEUED -> TASK_RUNNING; false if another thread got there first
+static bool tasks_claim(tasks_t *tasks, task_t *task) {
+  int expected = TASK_QUEUED;
+
+  if (!atomic_compare_exchange_strong_explicit(&task->state, &expected, TASK_RUNNING,
+      memory_order_acq_rel, memory_order_relaxed)) {
+    return false;
+  }
+
+  atomic_fetch_sub_explicit(&tasks->queued, 1, memory_order_relaxed);
+
+  return true;
+}
+
+void task_destructor(runtime_t *rt, args_t *args) {
+  if (args->_rawData != NULL) {
+    tasks_release((task_t*)args->_rawData);
+  }
+}
+
+bool tasks_done(task_t *task) {
+  return atomic_load_explicit(&task->state, memory_order_acquire) == TASK_DONE;
+}
+
+// ===== workers =====
+
+static void *tasks_collectorThread(void *arg) {
+  runtime_collector((runtime_t*)arg);
+
+  return NULL;
+}
+
+static task_context_t *tasks_context(task_worker_t *w, size_t depth) {
+  tasks_t *tasks = w->tasks;
+  task_context_t *ctx = w->contexts[depth];
+
+  if (ctx != NULL) {
+    return ctx;
+  }
+
+  ctx = (task_context_t*)malloc(sizeof(task_context_t));
+  ctx->rt = runtime_create();
+  memcpy(ctx->rt->hosts, tasks->owner->hosts, sizeof(ctx->rt->hosts));
+  builtins_register(ctx->rt);
+  ctx->rt->output.mode = tasks->owner->output.mode;
+  ctx->rt->tasks = tasks;
+
+  ctx->it = interpreter_createShared(ctx->rt, tasks->program);
+  ctx->it->haltExits = false; // the task is over, not the program
+
+  // the runtime is attached only while a task runs on it, so it is
+  // collected between tasks too
+  pthread_create(&ctx->gcThread, NULL, tasks_collectorThread, (void*)ctx->rt);
+
+  w->contexts[depth] = ctx;
+
+  return ctx;
+}
+
+static void tasks_contextDestroy(task_context_t *ctx) {
+  runtime_stopCollector(ctx->rt);
+  pthread_join(ctx->gcThread, NULL);
+
+  interpreter_destroy(ctx->it);
+  ctx->rt->tasks = NULL; // the pool is not this runtime's to stop
+
+  runtime_gc(ctx->rt);
+  runtime_destroy(ctx->rt);
+  free(ctx);
+}
+
+// what a task leaves on the stack, and fibers it did not join
+static void tasks_clear(runtime_t *rt) {
+  storage_t *stack = &rt->dt->storage[AT_LOCAL];
+
+  if (rt->fibers != NULL) {
+    fibers_destroy(rt, rt->fibers);
+    rt->fibers = NULL;
+  }
+
+  while (*stack->lenVal) {
+    value_t *v = &stack->data[--*stack->lenVal];
+
+    value_destroy(rt, v);
+    VALUE_SET_META(v, TYPE_NONE, FLAG_NONE);
+  }
+}
+
+// registers own nothing, so they are simply overwritten
+static void tasks_clearRegisters(value_t *regs) {
+  for (size_t i = 0; i < NUM_REGISTERS; i++) {
+    regs[i].data.u64 = 0;
+    VALUE_SET_META(&regs[i], TYPE_NONE, FLAG_NONE);
+  }
+}
+
+// a slice's callback on `count` arguments, with the runtime of `ctx`
+static value_t tasks_call(task_context_t *ctx, const value_t *fn, value_t *args, size_t count) {
+  value_t *regs = ctx->rt->dt->storage[AT_REG].data;
+
+  if (VALUE_TYPE_OF(fn) == TYPE_FUNCTION) {
+    args_t a;
+
+    a._stack = &ctx->rt->dt->storage[AT_LOCAL];
+    a._registers = args;
+    a._rawData = NULL;
+    a._operands = NULL;
+
+    return fn->data.fn(ctx->rt, &a);
+  }
+
+  tasks_clearRegisters(regs);
+  memcpy(&regs[1], args, count * sizeof(value_t));
+  interpreter_runEntry(ctx->it, fn->data.u64);
+
+  return regs[0];
+}
+
+// element `i` of the slice's input; `tmp` holds it if it is exported here
+static const task_value_t *tasks_sliceElement(const task_slice_t *s, size_t i, task_value_t *tmp) {
+  value_t v;
+
+  if (s->partials != NULL) {
+    return &s->partials[i];
+  }
+
+  switch (s->in->kind) {
+    case ARRAY_I64:
+      v = value_fromInt(((const int64_t*)s->in->data)[i]);
+      break;
+    case ARRAY_F64:
+      v = value_fromDouble(((const double*)s->in->data)[i]);
+      break;
+    case ARRAY_BYTES:
+      v = value_fromInt(((const uint8_t*)s->in->data)[i]);
+      break;
+    default:
+      v = ((const value_t*)s->in->data)[i];
+      break;
+  }
+
+  tasks_export(tmp, &v);
+
+  return tmp;
+}
+
+static void tasks_runSlice(task_context_t *ctx, task_slice_t *s) {
+  runtime_t *rt = ctx->rt;
+  bool hasAcc = s->hasInit;
+  task_value_t acc;
+
+  if (hasAcc) {
+    acc = s->init; // moved
+    s->hasInit = false;
+  }
+
+  for (size_t i = s->begin; i < s->end; i++) {
+    task_value_t tmp = { 0 }, next;
+    const task_value_t *element = tasks_sliceElement(s, i, &tmp);
+    size_t count = s->reduce ? 2 : 1;
+    value_t args[2], result;
+
+    if (s->reduce && !hasAcc) {
+      acc = tmp; // moved, it is the slice's first element
+      hasAcc = true;
+      continue;
+    }
+
+    // the arguments are the callback's, and the result is copied out
+    // before they are released: it may be one of them
+    args[count - 1] = tasks_importOwned(rt, element);
+
+    if (s->reduce) {
+      args[0] = tasks_importOwned(rt, &acc);
+    }
+
+    result = tasks_call(ctx, &s->fn, args, count);
+    tasks_export(&next, &result);
+
+    for (size_t a = 0; a < count; a++) {
+      value_release(rt, &args[a]);
+    }
+
+    if (s->reduce) {
+      tasks_valueRelease(&acc);
+      acc = next;
+    } else {
+      s->results[i - s->begin] = next;
+    }
+
+    tasks_valueRelease(&tmp);
+    tasks_clear(rt);
+  }
+
+  if (s->reduce && hasAcc) {
+    s->results[0] = acc;
+  }
+}
+
+// a parallelFor slice: its callback on each of its indices, added up
+static void tasks_runRange(task_context_t *ctx, task_slice_t *s) {
+  task_total_t *total = &s->total;
+
+  for (size_t i = s->begin; i < s->end; i++) {
+    value_t arg = value_fromInt(s->first + (int64_t)i);
+    value_t result = tasks_call(ctx, &s->fn, &arg, 1);
+
+    switch (s->reduction) {
+      case TASKS_REDUCE_SUM:
+        if (VALUE_TYPE_OF(&result) == TYPE_DOUBLE) {
+          total->f64 += result.data.dbl;
+          total->isDouble = true;
+        } else if (VALUE_TYPE_OF(&result) == TYPE_INT || VALUE_TYPE_OF(&result) == TYPE_UINT) {
+          total->i64 = (int64_t)((uint64_t)total->i64 + result.data.u64);
+        }
+
+        break;
+      case TASKS_REDUCE_COUNT:
+        if ((VALUE_TYPE_OF(&result) == TYPE_DOUBLE && result.data.dbl != 0)
+            || (VALUE_TYPE_OF(&result) == TYPE_BOOLEAN && result.data.b)
+            || ((VALUE_TYPE_OF(&result) == TYPE_INT || VALUE_TYPE_OF(&result) == TYPE_UINT) && result.data.u64 != 0)) {
+          total->i64++;
+        }
+
+        break;
+      default:
+        break;
+    }
+
+    tasks_clear(ctx->rt);
+  }
+}
+
+// runs a task the worker claimed, on its runtime for `depth`
+static void tasks_run(task_worker_t *w, task_t *task, size_t depth) {
+  task_context_t *ctx = tasks_context(w, depth);
+  runtime_t *rt = ctx->rt;
+  value_t *regs = rt->dt->storage[AT_REG].data;
+  size_t outer = w->depth;
+
+  w->depth = depth;
+  runtime_attach(rt);
+
+  if (task->slice != NULL && task->slice->range) {
+    tasks_runRange(ctx, task->slice);
+  } else if (task->slice != NULL) {
+    tasks_runSlice(ctx, task->slice);
+  } else {
+    tasks_clearRegisters(regs);
+    regs[1] = tasks_import(rt, &task->arg);
+    interpreter_runEntry(ctx->it, task->pc);
+    tasks_export(&task->result, &regs[0]);
+  }
+
+  tasks_clear(rt);
+  output_flush(&rt->output);
+  runtime_detach(rt);
+  w->depth = outer;
+
+  atomic_store_explicit(&task->state, TASK_DONE, memory_order_release);
+}
+
+static uint64_t tasks_random(task_worker_t *w) {
+  // xorshift64
+  w->seed ^= w->seed << 13;
+  w->seed ^= w->seed >> 7;
+  w->seed ^= w->seed << 17;
+
+  return w->seed;
+}
+
+// a task claimed from the worker's own deque, or stolen from others in
+// `rounds` passes over them; NULL if none was found. the caller releases
+// the deque's reference once it ran the task.
+static task_t *tasks_find(task_worker_t *w, size_t rounds) {
+  tasks_t *tasks = w->tasks;
+  task_t *task;
+
+  while ((task = tasks_dequeTake(&w->deque)) != NULL) {
+    if (tasks_claim(tasks, task)) {
+      return task;
+    }
+
+    tasks_release(task); // a join ran it already
+  }
+
+  for (size_t round = 0; round < rounds && tasks->count > 1; round++) {
+    size_t start = (size_t)(tasks_random(w) % tasks->count);
+
+    for (size_t i = 0; i < tasks->count; i++) {
+      task_worker_t *victim = &tasks->workers[(start + i) % tasks->count];
+
+      if (victim == w || (task = tasks_dequeSteal(&victim->deque)) == NULL) {
+        continue;
+      }
+
+      if (tasks_claim(tasks, task)) {
+        return task;
+      }
+
+      tasks_release(task);
+    }
+
+    if (atomic_load_explicit(&tasks->queued, memory_order_relaxed) == 0) {
+      break;
+    }
+  }
+
+  return NULL;
+}
+
+static void tasks_sleep(tasks_t *tasks) {
+  struct timespec deadline;
+
+  clock_gettime(CLOCK_REALTIME, &deadline);
+  deadline.tv_nsec += 10 * 1000000L;
+  deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+  deadline.tv_nsec %= 1000000000L;
+
+  pthread_mutex_lock(&tasks->lock);
+  atomic_fetch_add(&tasks->sleepers, 1);
+
+  // a spawn counts the task before it looks for sleepers, so either it
+  // sees this one or this one sees the task. the timeout is a backstop.
+  if (!atomic_load(&tasks->stop) && atomic_load(&tasks->queued) == 0) {
+    pthread_cond_timedwait(&tasks->cond, &tasks->lock, &deadline);
+  }
+
+  atomic_fetch_sub(&tasks->sleepers, 1);
+  pthread_mutex_unlock(&tasks->lock);
+}
+
+static void *tasks_workerThread(void *arg) {
+  task_worker_t *w = (task_worker_t*)arg;
+  tasks_t *tasks = w->tasks;
+
+  tasks_self = w;
+
+  while (!atomic_load_explicit(&tasks->stop, memory_order_acquire)) {
+    task_t *task = tasks_find(w, TASKS_STEAL_ROUNDS);
+
+    if (task != NULL) {
+      tasks_run(w, task, 0);
+      tasks_release(task);
+    } else {
+      tasks_sleep(tasks);
+    }
+  }
+
+  return NULL;
+}
+
+// BB8_TASK_WORKERS, or the number of online cpus
+static size_t tasks_workerCount() {
+  const char *env = getenv("BB8_TASK_WORKERS");
+  long count = (env != NULL && env[0] != '\0') ? strtol(env, NULL, 10) : sysconf(_SC_NPROCESSORS_ONLN);
+
+  if (count < 1) {
+    return 1;
+  }
+
+  return count > TASKS_MAX_WORKERS ? TASKS_MAX_WORKERS : (size_t)count;
+}
+
+static tasks_t *tasks_create(runtime_t *rt) {
+  tasks_t *tasks = (tasks_t*)malloc(sizeof(tasks_t));
+
+  tasks->owner = rt;
+  tasks->program = program_retain(rt->program);
+  tasks->count = tasks_workerCount();
+  tasks->workers = (task_worker_t*)calloc(tasks->count, sizeof(task_worker_t));
+
+  atomic_init(&tasks->stop, false);
+  atomic_init(&tasks->queued, 0);
+  atomic_init(&tasks->sleepers, 0);
+  pthread_mutex_init(&tasks->lock, NULL);
+  pthread_cond_init(&tasks->cond, NULL);
+
+  for (size_t i = 0; i < tasks->count; i++) {
+    task_worker_t *w = &tasks->workers[i];
+
+    w->tasks = tasks;
+    w->index = i;
+    w->seed = 0x9E3779B97F4A7C15ull * (i + 1);
+    tasks_dequeInit(&w->deque);
+  }
+
+  // the calling thread is the first worker, running the program at depth 0
+  tasks_self = &tasks->workers[0];
+
+  for (size_t i = 1; i < tasks->count; i++) {
+    pthread_create(&tasks->workers[i].thread, NULL, tasks_workerThread, (void*)&tasks->workers[i]);
+  }
+
+  return tasks;
+}
+
+void tasks_destroy(tasks_t *tasks) {
+  pthread_mutex_lock(&tasks->lock);
+  atomic_store_explicit(&tasks->stop, true, memory_order_release);
+  pthread_cond_broadcast(&tasks->cond);
+  pthread_mutex_unlock(&tasks->lock);
+
+  for (size_t i = 1; i < tasks->count; i++) {
+    pthread_join(tasks->workers[i].thread, NULL);
+  }
+
+  for (size_t i = 0; i < tasks->count; i++) {
+    task_worker_t *w = &tasks->workers[i];
+    task_t *task;
+
+    // the deque's references; the futures keep theirs
+    while ((task = tasks_dequeTake(&w->deque)) != NULL) {
+      tasks_release(task);
+    }
+
+    for (size_t depth = 0; depth <= TASKS_MAX_DEPTH; depth++) {
+      if (w->contexts[depth] != NULL) {
+        tasks_contextDestroy(w->contexts[depth]);
+      }
+    }
+
+    tasks_dequeDestroy(&w->deque);
+  }
+
+  if (tasks_self != NULL && tasks_self->tasks == tasks) {
+    tasks_self = NULL;
+  }
+
+  pthread_cond_destroy(&tasks->cond);
+  pthread_mutex_destroy(&tasks->lock);
+  program_release(tasks->program);
+  free(tasks->workers);
+  free(tasks);
+}
+
+// the calling thread's worker in the pool of `rt`, or NULL
+static task_worker_t *tasks_worker(runtime_t *rt) {
+  return tasks_self != NULL && tasks_self->tasks == rt->tasks ? tasks_self : NULL;
+}
+
+// the calling thread's worker, starting the pool of `rt` if it has none
+static task_worker_t *tasks_start(runtime_t *rt) {
+  if (rt->tasks == NULL) {
+    if (rt->program == NULL) {
+      return NULL;
+    }
+
+    rt->tasks = tasks_create(rt);
+  }
+
+  return tasks_worker(rt);
+}
+
+// with none for its argument and result, queued by tasks_push
+static task_t *tasks_alloc(uint64_t pc) {
+  task_t *task = (task_t*)calloc(1, sizeof(task_t));
+
+  atomic_init(&task->state, TASK_QUEUED);
+  atomic_init(&task->refs, 2);
+  task->pc = pc;
+
+  return task;
+}
+
+static void tasks_push(task_worker_t *w, task_t *task) {
+  tasks_t *tasks = w->tasks;
+
+  atomic_fetch_add(&tasks->queued, 1);
+  tasks_dequePush(&w->deque, task);
+
+  if (atomic_load(&tasks->sleepers) != 0) {
+    pthread_mutex_lock(&tasks->lock);
+    pthread_cond_signal(&tasks->cond);
+    pthread_mutex_unlock(&tasks->lock);
+  }
+}
+
+task_t *tasks_spawn(runtime_t *rt, uint64_t pc, value_t *arg) {
+  task_worker_t *w = tasks_start(rt);
+  task_t *task;
+
+  if (w == NULL) {
+    return NULL;
+  }
+
+  task = tasks_alloc(pc);
+  tasks_export(&task->arg, arg);
+  tasks_push(w, task);
+
+  return task;
+}
+
+value_t tasks_join(runtime_t *rt, task_t *task) {
+  task_worker_t *w = tasks_worker(rt);
+
+  while (!tasks_done(task)) {
+    task_t *other = NULL;
+
+    if (w != NULL && w->depth < TASKS_MAX_DEPTH) {
+      // the awaited task first, if it has not started: it is run here
+      // rather than waited for
+      other = tasks_claim(w->tasks, task) ? task : tasks_find(w, 1);
+    }
+
+    if (other != NULL) {
+      tasks_run(w, other, w->depth + 1);
+
+      if (other != task) {
+        tasks_release(other);
+      }
+    } else {
+      sched_yield();
+    }
+
+    // the join is in a call, where the collector may stop the runtime
+    runtime_safepoint(rt);
+  }
+
+  return tasks_import(rt, &task->result);
+}
+
+// ===== parallelMap and parallelReduce =====
+
+// a task folding or mapping [begin, end) of `in`, or of `partials`; a
+// reduce with an `init` folds from it
+static task_t *tasks_spawnSlice(task_worker_t *w, const value_t *fn, bool reduce, const array_t *in,
+                                const task_value_t *partials, size_t begin, size_t end, const value_t *init) {
+  task_t *task = tasks_alloc(0);
+  task_slice_t *s = (task_slice_t*)calloc(1, sizeof(task_slice_t));
+
+  s->reduce = reduce;
+  s->fn = *fn;
+  s->in = in;
+  s->partials = partials;
+  s->begin = begin;
+  s->end = end;
+  s->results = (task_value_t*)calloc(reduce ? 1 : end - begin, sizeof(task_value_t));
+
+  if (init != NULL) {
+    s->hasInit = true;
+    tasks_export(&s->init, init);
+  }
+
+  task->slice = s;
+  tasks_push(w, task);
+
+  return task;
+}
+
+// enough to keep every thread busy while they finish at different times,
+// few enough that each one has `min` elements
+static size_t tasks_sliceCount(tasks_t *tasks, size_t n, size_t min) {
+  size_t count = (n + min - 1) / min;
+  size_t most = tasks->count * TASKS_SLICES_PER_WORKER;
+
+  return count < most ? count : most;
+}
+
+// the slices of `n` elements, spawned and joined; `slices` has room for
+// tasks_sliceCount of them. the joined tasks are released by the caller.
+static size_t tasks_runSlices(runtime_t *rt, task_worker_t *w, task_t **slices, const value_t *fn, bool reduce,
+                              const array_t *in, size_t n) {
+  size_t count = tasks_sliceCount(w->tasks, n, TASKS_SLICE_MIN);
+
+  for (size_t i = 0; i < count; i++) {
+    slices[i] = tasks_spawnSlice(w, fn, reduce, in, NULL, n * i / count, n * (i + 1) / count, NULL);
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    tasks_join(rt, slices[i]);
+  }
+
+  return count;
+}
+
+bool tasks_map(runtime_t *rt, array_t *in, const value_t *fn, value_t *out) {
+  task_worker_t *w = tasks_start(rt);
+  task_t *slices[TASKS_MAX_WORKERS * TASKS_SLICES_PER_WORKER];
+  size_t count;
+  array_t *array;
+
+  if (w == NULL) {
+    return false;
+  }
+
+  count = tasks_runSlices(rt, w, slices, fn, false, in, in->size);
+
+  // made once the joins are done, as they reach safepoints where the
+  // collector could free an array nothing refers to yet
+  *out = value_createArray(rt, rt->heap, in->kind, in->size);
+  array = (array_t*)out->data.hv->ptr;
+
+  for (size_t i = 0; i < count; i++) {
+    task_slice_t *s = slices[i]->slice;
+
+    for (size_t j = s->begin; j < s->end; j++) {
+      value_t v = tasks_importOwned(rt, &s->results[j - s->begin]);
+
+      array_set(rt, array, j, &v);
+      value_release(rt, &v);
+    }
+
+    tasks_release(slices[i]);
+  }
+
+  return true;
+}
+
+bool tasks_reduce(runtime_t *rt, array_t *in, const value_t *fn, const value_t *init, value_t *out) {
+  task_worker_t *w = tasks_start(rt);
+  task_t *slices[TASKS_MAX_WORKERS * TASKS_SLICES_PER_WORKER];
+  task_value_t partials[TASKS_MAX_WORKERS * TASKS_SLICES_PER_WORKER];
+  size_t count;
+  task_t *last;
+
+  if (w == NULL) {
+    return false;
+  }
+
+  count = tasks_runSlices(rt, w, slices, fn, true, in, in->size);
+
+  // borrowed from the slices, which stay referenced until the last fold
+  for (size_t i = 0; i < count; i++) {
+    partials[i] = slices[i]->slice->results[0];
+  }
+
+  // one task, so the fold keeps to its order
+  last = tasks_spawnSlice(w, fn, true, NULL, partials, 0, count, init);
+  tasks_join(rt, last);
+
+  *out = tasks_importOwned(rt, &last->slice->results[0]);
+
+  for (size_t i = 0; i < count; i++) {
+    tasks_release(slices[i]);
+  }
+
+  tasks_release(last);
+
+  return true;
+}
+
+// ===== parallelFor =====
+
+bool tasks_for(runtime_t *rt, int64_t start, int64_t end, const value_t *fn, tasks_reduction_t reduction,
+               value_t *out) {
+  task_worker_t *w = tasks_start(rt);
+  task_t *slices[TASKS_MAX_WORKERS * TASKS_SLICES_PER_WORKER];
+  task_total_t total = { 0, 0, false };
+  size_t n = end > start ? (size_t)((uint64_t)end - (uint64_t)start) : 0;
+  size_t count;
+
+  if (w == NULL) {
+    return false;
+  }
+
+  // a slice a thread, and more to even out the time they take: an index
+  // is a loop's body, which may take long
+  count = n != 0 ? tasks_sliceCount(w->tasks, n, 1) : 0;
+
+  for (size_t i = 0; i < count; i++) {
+    task_t *task = tasks_alloc(0);
+    task_slice_t *s = (task_slice_t*)calloc(1, sizeof(task_slice_t));
+
+    s->range = true;
+    s->fn = *fn;
+    s->first = start;
+    s->begin = n * i / count;
+    s->end = n * (i + 1) / count;
+    s->reduction = reduction;
+    task->slice = s;
+    tasks_push(w, task);
+    slices[i] = task;
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    const task_total_t *t = &slices[i]->slice->total;
+
+    tasks_join(rt, slices[i]);
+    total.i64 = (int64_t)((uint64_t)total.i64 + (uint64_t)t->i64);
+    total.f64 += t->f64;
+    total.isDouble |= t->isDouble;
+    tasks_release(slices[i]);
+  }
+
+  switch (reduction) {
+    case TASKS_REDUCE_SUM:
+      *out = total.isDouble ? value_fromDouble(total.f64 + (double)total.i64) : value_fromInt(total.i64);
+      break;
+    case TASKS_REDUCE_COUNT:
+      *out = value_fromInt(total.i64);
+      break;
+    default:
+      VALUE_SET_META(out, TYPE_NONE, FLAG_NONE);
+      break;
+  }
+
+  return true;
+}
@@ -1,5 +1,25 @@
 #include <vm/util.h>
 
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+// the CRC-32C instructions: SSE4.2's, used where the processor has them,
+// or ARMv8's where the compiler may assume them
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+  #include <nmmintrin.h>
+  #define HASH_CRC_TARGET __attribute__((target("sse4.2")))
+  #define HASH_CRC_WORD(crc, word) ((uint32_t)_mm_crc32_u64((crc), (word)))
+  #define HASH_CRC_BYTE(crc, byte) _mm_crc32_u8((crc), (byte))
+  #define HASH_CRC_AVAILABLE __builtin_cpu_supports("sse4.2")
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+  #include <arm_acle.h>
+  #define HASH_CRC_TARGET
+  #define HASH_CRC_WORD(crc, word) __crc32cd((crc), (word))
+  #define HASH_CRC_BYTE(crc, byte) __crc32cb((crc), (byte))
+  #define HASH_CRC_AVAILABLE 1
+#endif
+
 uint32_t hash6432shift(uint64_t key) {
   key = (~key) + (key << 18);
   key = key ^ (key >> 31);
@@ -9,3 +29,361 @@ uint32_t hash6432shift(uint64_t key) {
   key = key ^ (key >> 22);
   return key;
 }
+
+uint64_t hashBytes64(const void *data, size_t size, uint64_t hash) {
+  const uint8_t *bytes = (const uint8_t*)data;
+
+  for (size_t i = 0; i < size; i++) {
+    hash ^= bytes[i];
+    hash *= 0x100000001B3ULL;
+  }
+
+  return hash;
+}
+
+// wyhash's secret
+#define HASH_S0 0x2D358DCCAA6C78A5ULL
+#define HASH_S1 0x8BB84B93962EACC9ULL
+#define HASH_S2 0x4B33A62ED433D4A3ULL
+#define HASH_S3 0x4D5A2DA51DE1AA47ULL
+
+// the two halves of the 128-bit product of `*a` and `*b`, low into `*a`
+static inline void hashMultiply(uint64_t *a, uint64_t *b) {
+#if defined(__SIZEOF_INT128__)
+  __uint128_t r = (__uint128_t)*a * *b;
+
+  *a = (uint64_t)r;
+  *b = (uint64_t)(r >> 64);
+#else
+  uint64_t ha = *a >> 32, hb = *b >> 32, la = (uint32_t)*a, lb = (uint32_t)*b;
+  uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+  uint64_t t = rl + (rm0 << 32);
+  uint64_t lo = t + (rm1 << 32);
+
+  rh += (rm0 >> 32) + (rm1 >> 32) + (t < rl) + (lo < t);
+  *a = lo;
+  *b = rh;
+#endif
+}
+
+// the two halves of the 128-bit product, xor'd together
+static inline uint64_t hashFold64(uint64_t a, uint64_t b) {
+  hashMultiply(&a, &b);
+
+  return a ^ b;
+}
+
+static inline uint64_t hashRead8(const uint8_t *p) {
+  uint64_t word;
+
+  memcpy(&word, p, 8);
+
+  return word;
+}
+
+static inline uint64_t hashRead4(const uint8_t *p) {
+  uint32_t word;
+
+  memcpy(&word, p, 4);
+
+  return word;
+}
+
+// what every hash starts from, wyhash's for seed 0
+static inline uint64_t hashSeed() {
+  return hashFold64(HASH_S0, HASH_S1);
+}
+
+// a 48-byte block into the three lanes
+static inline void hashBlock(uint64_t lanes[3], const uint8_t *p) {
+  lanes[0] = hashFold64(hashRead8(p) ^ HASH_S1, hashRead8(p + 8) ^ lanes[0]);
+  lanes[1] = hashFold64(hashRead8(p + 16) ^ HASH_S2, hashRead8(p + 24) ^ lanes[1]);
+  lanes[2] = hashFold64(hashRead8(p + 32) ^ HASH_S3, hashRead8(p + 40) ^ lanes[2]);
+}
+
+static inline uint64_t hashFinish(uint64_t seed, uint64_t a, uint64_t b, uint64_t size) {
+  a ^= HASH_S1;
+  b ^= seed;
+  hashMultiply(&a, &b);
+
+  return hashFold64(a ^ HASH_S0 ^ size, b ^ HASH_S1);
+}
+
+// the last `i` bytes at `p`, less than 48, of an input longer than 16:
+// 16 at a time, then the last 16, which may go back before `p`
+static uint64_t hashTail(uint64_t seed, const uint8_t *p, size_t i, uint64_t size) {
+  for (; i > 16; p += 16, i -= 16) {
+    seed = hashFold64(hashRead8(p) ^ HASH_S1, hashRead8(p + 8) ^ seed);
+  }
+
+  return hashFinish(seed, hashRead8(p + i - 16), hashRead8(p + i - 8), size);
+}
+
+uint64_t hashString64(const void *data, size_t size) {
+  const uint8_t *p = (const uint8_t*)data;
+  uint64_t seed = hashSeed();
+  uint64_t a, b;
+
+  if (size <= 16) {
+    if (size >= 4) {
+      size_t mid = (size >> 3) << 2;
+
+      a = (hashRead4(p) << 32) | hashRead4(p + mid);
+      b = (hashRead4(p + size - 4) << 32) | hashRead4(p + size - 4 - mid);
+    } else if (size > 0) {
+      a = ((uint64_t)p[0] << 16) | ((uint64_t)p[size >> 1] << 8) | p[size - 1];
+      b = 0;
+    } else {
+      a = b = 0;
+    }
+
+    return hashFinish(seed, a, b, size);
+  }
+
+  size_t i = size;
+
+  if (i >= 48) {
+    uint64_t lanes[3] = { seed, seed, seed };
+
+    for (; i >= 48; p += 48, i -= 48) {
+      hashBlock(lanes, p);
+    }
+
+    seed = lanes[0] ^ lanes[1] ^ lanes[2];
+  }
+
+  return hashTail(seed, p, i, size);
+}
+
+void hashstream_init(hashstream_t *h) {
+  uint64_t seed = hashSeed();
+
+  memset(h, 0, sizeof(*h));
+  h->magic = HASHSTREAM_MAGIC;
+  h->lanes[0] = h->lanes[1] = h->lanes[2] = seed;
+}
+
+void hashstream_update(hashstream_t *h, const void *data, size_t size) {
+  const uint8_t *p = (const uint8_t*)data;
+  uint8_t *pending = h->buffer + 16;
+
+  h->size += size;
+
+  if (h->pending != 0) {
+    size_t take = 48 - h->pending < size ? 48 - h->pending : size;
+
+    memcpy(pending + h->pending, p, take);
+    h->pending += (uint32_t)take;
+    p += take;
+    size -= take;
+
+    if (h->pending < 48) {
+      return;
+    }
+
+    hashBlock(h->lanes, pending);
+    memcpy(h->buffer, pending + 32, 16);
+    h->pending = 0;
+  }
+
+  if (size >= 48) {
+    for (; size >= 48; p += 48, size -= 48) {
+      hashBlock(h->lanes, p);
+    }
+
+    memcpy(h->buffer, p - 16, 16);
+  }
+
+  memcpy(pending, p, size);
+  h->pending = (uint32_t)size;
+}
+
+uint64_t hashstream_digest(const hashstream_t *h) {
+  // no block yet: all of it is held back
+  if (h->size < 48) {
+    return hashString64(h->buffer + 16, h->pending);
+  }
+
+  return hashTail(h->lanes[0] ^ h->lanes[1] ^ h->lanes[2], h->buffer + 16, h->pending, h->size);
+}
+
+// ===== CRC-32C =====
+
+#define HASH_CRC_POLY 0x82F63B78u // reflected
+// bytes in each of the three streams the instructions take at once
+#define HASH_CRC_STRIDE 2048
+
+static uint32_t hashCrcTable[8][256];
+static uint32_t hashCrcShift; // x^(8 * HASH_CRC_STRIDE) mod the polynomial
+static pthread_once_t hashCrcOnce = PTHREAD_ONCE_INIT;
+
+// `a` times `b` mod the polynomial, both reflected, as zlib's multmodp
+static uint32_t hashCrcMultiply(uint32_t a, uint32_t b) {
+  uint32_t m = (uint32_t)1 << 31;
+  uint32_t p = 0;
+
+  for (;;) {
+    if (a & m) {
+      p ^= b;
+
+      if ((a & (m - 1)) == 0) {
+        break;
+      }
+    }
+
+    m >>= 1;
+    b = (b & 1) ? (b >> 1) ^ HASH_CRC_POLY : b >> 1;
+  }
+
+  return p;
+}
+
+static void hashCrcInit() {
+  for (uint32_t n = 0; n < 256; n++) {
+    uint32_t c = n;
+
+    for (int k = 0; k < 8; k++) {
+      c = (c & 1) ? (c >> 1) ^ HASH_CRC_POLY : c >> 1;
+    }
+
+    hashCrcTable[0][n] = c;
+  }
+
+  for (uint32_t n = 0; n < 256; n++) {
+    for (int k = 1; k < 8; k++) {
+      uint32_t c = hashCrcTable[k - 1][n];
+
+      hashCrcTable[k][n] = (c >> 8) ^ hashCrcTable[0][c & 0xFF];
+    }
+  }
+
+  // a zero byte through the register multiplies it by x^8
+  hashCrcShift = (uint32_t)1 << 31;
+
+  for (int i = 0; i < HASH_CRC_STRIDE; i++) {
+    hashCrcShift = (hashCrcShift >> 8) ^ hashCrcTable[0][hashCrcShift & 0xFF];
+  }
+}
+
+static uint32_t hashCrcSoftware(uint32_t crc, const uint8_t *p, size_t size) {
+  for (; size >= 8; p += 8, size -= 8) {
+    uint32_t lo = crc ^ ((uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24);
+    uint32_t hi = (uint32_t)p[4] | (uint32_t)p[5] << 8 | (uint32_t)p[6] << 16 | (uint32_t)p[7] << 24;
+
+    crc = hashCrcTable[7][lo & 0xFF] ^ hashCrcTable[6][(lo >> 8) & 0xFF]
+      ^ hashCrcTable[5][(lo >> 16) & 0xFF] ^ hashCrcTable[4][lo >> 24]
+      ^ hashCrcTable[3][hi & 0xFF] ^ hashCrcTable[2][(hi >> 8) & 0xFF]
+      ^ hashCrcTable[1][(hi >> 16) & 0xFF] ^ hashCrcTable[0][hi >> 24];
+  }
+
+  for (; size != 0; p++, size--) {
+    crc = (crc >> 8) ^ hashCrcTable[0][(crc ^ *p) & 0xFF];
+  }
+
+  return crc;
+}
+
+#if defined(HASH_CRC_WORD)
+// the instruction's latency is three times its throughput: three streams
+// of HASH_CRC_STRIDE bytes at once, each from zero but the first, then
+// each shifted past the next and combined
+HASH_CRC_TARGET static uint32_t hashCrcHardware(uint32_t crc, const uint8_t *p, size_t size) {
+  for (; size >= 3 * HASH_CRC_STRIDE; p += 3 * HASH_CRC_STRIDE, size -= 3 * HASH_CRC_STRIDE) {
+    uint32_t c1 = 0;
+    uint32_t c2 = 0;
+
+    for (size_t i = 0; i < HASH_CRC_STRIDE; i += 8) {
+      crc = HASH_CRC_WORD(crc, hashRead8(p + i));
+      c1 = HASH_CRC_WORD(c1, hashRead8(p + HASH_CRC_STRIDE + i));
+      c2 = HASH_CRC_WORD(c2, hashRead8(p + 2 * HASH_CRC_STRIDE + i));
+    }
+
+    crc = hashCrcMultiply(hashCrcShift, crc) ^ c1;
+    crc = hashCrcMultiply(hashCrcShift, crc) ^ c2;
+  }
+
+  for (; size >= 8; p += 8, size -= 8) {
+    crc = HASH_CRC_WORD(crc, hashRead8(p));
+  }
+
+  for (; size != 0; p++, size--) {
+    crc = HASH_CRC_BYTE(crc, *p);
+  }
+
+  return crc;
+}
+#endif
+
+uint32_t hashCrc32c(uint32_t crc, const void *data, size_t size) {
+  pthread_once(&hashCrcOnce, hashCrcInit);
+
+#if defined(HASH_CRC_WORD)
+  if (HASH_CRC_AVAILABLE) {
+    return ~hashCrcHardware(~crc, (const uint8_t*)data, size);
+  }
+#endif
+
+  return ~hashCrcSoftware(~crc, (const uint8_t*)data, size);
+}
+
+static size_t idmap_slot(const idmap_t *t, uintptr_t key) {
+  size_t i = (size_t)(((uint64_t)key >> 4) * 0x9E3779B97F4A7C15ull) & (t->size - 1);
+
+  while (t->keys[i] != 0 && t->keys[i] != key) {
+    i = (i + 1) & (t->size - 1);
+  }
+
+  return i;
+}
+
+uint64_t idmap_id(idmap_t *t, const void *ptr, uint64_t next, bool *added) {
+  size_t i;
+
+  if ((t->count + 1) * 2 > t->size) {
+    idmap_t grown = { NULL, NULL, t->size != 0 ? t->size * 2 : 256, t->count };
+
+    grown.keys = (uintptr_t*)calloc(grown.size, sizeof(uintptr_t));
+    grown.ids = (uint64_t*)malloc(grown.size * sizeof(uint64_t));
+
+    for (size_t j = 0; j < t->size; j++) {
+      if (t->keys[j] != 0) {
+        size_t k = idmap_slot(&grown, t->keys[j]);
+
+        grown.keys[k] = t->keys[j];
+        grown.ids[k] = t->ids[j];
+      }
+    }
+
+    free(t->keys);
+    free(t->ids);
+    *t = grown;
+  }
+
+  i = idmap_slot(t, (uintptr_t)ptr);
+  *added = t->keys[i] == 0;
+
+  if (*added) {
+    t->keys[i] = (uintptr_t)ptr;
+    t->ids[i] = next;
+    ++t->count;
+  }
+
+  return t->ids[i];
+}
+
+
+void idmap_clear(idmap_t *t) {
+  if (t->keys != NULL) {
+    memset(t->keys, 0, t->size * sizeof(uintptr_t));
+  }
+
+  t->count = 0;
+}
+
+void idmap_destroy(idmap_t *t) {
+  free(t->keys);
+  free(t->ids);
+  t->keys = NULL;
+  t->ids = NULL;
+  t->size = t->count = 0;
+}
@@ -1,34 +1,55 @@
 #include <vm/value.h>
 #include <vm/runtime.h>
 #include <vm/obj_loc.h>
+#include <vm/array.h>
+#include <vm/map.h>
+#include <vm/cache.h>
+#include <vm/stream.h>
+#include <vm/aio.h>
+#include <vm/task.h>
+#include <vm/channel.h>
+#include <vm/net.h>
+
+#include <string.h>
 
 void value_destroy(runtime_t *rt, value_t *value) {
   /*if (value->metadata & (TYPE_POINTER | (FLAG_OBJECT << 8))) {
     object_destroy((object_t*)value->data.ptr);
   } else*/
-  if ((value->metadata & (TYPE_POINTER | (FLAG_REFCOUNTED << 8))) == (TYPE_POINTER | (FLAG_REFCOUNTED << 8))) {
-    runtime_release(rt, value->data.rc);
-  } else if ((value->metadata & (TYPE_POINTER | (FLAG_MALLOC << 8))) == (TYPE_POINTER | (FLAG_MALLOC << 8))) {
+  if (VALUE_HAS(value, TYPE_POINTER, FLAG_REFCOUNTED)) {
+    rc_release(value->data.rc);
+  } else if (VALUE_HAS(value, TYPE_POINTER, FLAG_MALLOC)) {
     free(value->data.raw);
   }
 }
 
 void value_copyValue(runtime_t *rt, value_t *v, value_t *other) {
-  value_destroy(rt, v);
+  value_release(rt, v);
 
-  if ((other->metadata & (TYPE_POINTER | (FLAG_REFCOUNTED << 8))) == (TYPE_POINTER | (FLAG_REFCOUNTED << 8))) {
-    v->data.rc = runtime_claim(rt, (rcmap_key_t)other->data.rc);
+  if (VALUE_HAS(other, TYPE_POINTER, FLAG_REFCOUNTED)) {
+    v->data.rc = rc_claim(other->data.rc);
   } else {
     v->data = other->data;
   }
 
   v->metadata = other->metadata;
+  v->aux = other->aux;
+}
+
+void value_moveValue(runtime_t *rt, value_t *v, value_t *other) {
+  if (v == other) {
+    return;
+  }
+
+  value_release(rt, v);
+  *v = *other;
+  VALUE_SET_META(other, TYPE_NONE, FLAG_NONE);
 }
 
 void value_setInt(runtime_t *rt, value_t *v, int64_t i64) {
-  value_destroy(rt, v);
+  value_release(rt, v);
   v->data.i64 = i64;
-  v->metadata = TYPE_INT;
+  VALUE_SET_META(v, TYPE_INT, FLAG_NONE);
 }
 
 int64_t value_getInt(value_t *v) {
@@ -38,14 +59,14 @@ int64_t value_getInt(value_t *v) {
 value_t value_fromInt(int64_t i64) {
   value_t v;
   v.data.i64 = i64;
-  v.metadata = TYPE_INT;
+  VALUE_SET_META(&v, TYPE_INT, FLAG_NONE);
   return v;
 }
 
 void value_setUint(runtime_t *rt, value_t *v, uint64_t u64) {
-  value_destroy(rt, v);
+  value_release(rt, v);
   v->data.u64 = u64;
-  v->metadata = TYPE_UINT;
+  VALUE_SET_META(v, TYPE_UINT, FLAG_NONE);
 }
 
 uint64_t value_getUint(value_t *v) {
@@ -55,14 +76,14 @@ uint64_t value_getUint(value_t *v) {
 value_t value_fromUint(uint64_t u64) {
   value_t v;
   v.data.u64 = u64;
-  v.metadata = TYPE_UINT;
+  VALUE_SET_META(&v, TYPE_UINT, FLAG_NONE);
   return v;
 }
 
 void value_setDouble(runtime_t *rt, value_t *v, double dbl) {
-  value_destroy(rt, v);
+  value_release(rt, v);
   v->data.dbl = dbl;
-  v->metadata = TYPE_DOUBLE;
+  VALUE_SET_META(v, TYPE_DOUBLE, FLAG_NONE);
 }
 
 double value_getDouble(value_t *v) {
@@ -72,14 +93,14 @@ double value_getDouble(value_t *v) {
 value_t value_fromDouble(double dbl) {
   value_t v;
   v.data.dbl = dbl;
-  v.metadata = TYPE_DOUBLE;
+  VALUE_SET_META(&v, TYPE_DOUBLE, FLAG_NONE);
   return v;
 }
 
 void value_setBoolean(runtime_t *rt, value_t *v, bool b) {
-  value_destroy(rt, v);
+  value_release(rt, v);
   v->data.b = b;
-  v->metadata = TYPE_BOOLEAN;
+  VALUE_SET_META(v, TYPE_BOOLEAN, FLAG_NONE);
 }
 
 bool value_getBoolean(value_t *v) {
@@ -89,16 +110,26 @@ bool value_getBoolean(value_t *v) {
 value_t value_fromBoolean(bool b) {
   value_t v;
   v.data.b = b;
-  v.metadata = TYPE_BOOLEAN;
+  VALUE_SET_META(&v, TYPE_BOOLEAN, FLAG_NONE);
   return v;
 }
 
+// the node of a new object, array or map: in the innermost @arena of
+// `rt`, if one is open, see vm/arena.h
+static heap_value_t *value_allocNode(runtime_t *rt, heap_t *heap) {
+  if (rt != NULL && rt->arena.depth != 0 && heap == rt->heap) {
+    return arena_alloc(&rt->arena, heap);
+  }
+
+  return heap_alloc(rt, heap);
+}
+
 value_t value_createObject(runtime_t *rt, heap_t *heap) {
   value_t v;
-  v.data.hv = heap_alloc(rt, heap);
-  v.metadata = TYPE_POINTER | (FLAG_OBJECT << 8);
+  v.data.hv = value_allocNode(rt, heap);
+  VALUE_SET_META(&v, TYPE_POINTER, FLAG_OBJECT);
 
-  object_t *object = object_create();
+  object_t *object = object_create(heap);
 
   v.data.hv->ptr = object;
   v.data.hv->dtor_ptr = (native_function_t)object_destructor;
@@ -106,7 +137,144 @@ value_t value_createObject(runtime_t *rt, heap_t *heap) {
   return v;
 }
 
+value_t value_createObjectWithCapacity(runtime_t *rt, heap_t *heap, uint32_t capacity) {
+  value_t v;
+  v.data.hv = value_allocNode(rt, heap);
+  VALUE_SET_META(&v, TYPE_POINTER, FLAG_OBJECT);
+
+  v.data.hv->ptr = object_createWithCapacity(heap, capacity);
+  v.data.hv->dtor_ptr = (native_function_t)object_destructor;
+
+  return v;
+}
+
+value_t value_createShapedObject(runtime_t *rt, heap_t *heap, shape_t *shape) {
+  value_t v;
+  v.data.hv = value_allocNode(rt, heap);
+  VALUE_SET_META(&v, TYPE_POINTER, FLAG_OBJECT);
+
+  v.data.hv->ptr = object_createShaped(heap, shape);
+  v.data.hv->dtor_ptr = (native_function_t)object_destructor;
+
+  return v;
+}
+
+value_t value_createObjectClone(runtime_t *rt, heap_t *heap, object_t *object) {
+  value_t v;
+  v.data.hv = value_allocNode(rt, heap);
+  VALUE_SET_META(&v, TYPE_POINTER, FLAG_OBJECT);
+
+  v.data.hv->ptr = object_clone(heap, object);
+  v.data.hv->dtor_ptr = (native_function_t)object_destructor;
+
+  return v;
+}
+
+value_t value_createArray(runtime_t *rt, heap_t *heap, ARRAY_KIND kind, size_t capacity) {
+  value_t v;
+  v.data.hv = value_allocNode(rt, heap);
+  VALUE_SET_META(&v, TYPE_POINTER, FLAG_OBJECT | FLAG_ARRAY);
+
+  v.data.hv->ptr = array_create(heap, kind, capacity);
+  v.data.hv->dtor_ptr = (native_function_t)array_destructor;
+  v.data.hv->kind = HEAP_KIND_ARRAY;
+
+  return v;
+}
+
+value_t value_createMap(runtime_t *rt, heap_t *heap) {
+  value_t v;
+  v.data.hv = value_allocNode(rt, heap);
+  VALUE_SET_META(&v, TYPE_POINTER, FLAG_OBJECT | FLAG_MAP);
+
+  v.data.hv->ptr = map_create(heap);
+  v.data.hv->dtor_ptr = (native_function_t)map_destructor;
+  v.data.hv->kind = HEAP_KIND_MAP;
+
+  return v;
+}
+
+value_t value_createCache(runtime_t *rt, heap_t *heap, size_t maxEntries, size_t maxBytes, bool weak) {
+  value_t v;
+  v.data.hv = heap_alloc(rt, heap);
+  VALUE_SET_META(&v, TYPE_POINTER, FLAG_OBJECT | FLAG_CACHE);
+
+  v.data.hv->ptr = cache_create(heap, v.data.hv, maxEntries, maxBytes, weak);
+  v.data.hv->dtor_ptr = (native_function_t)cache_destructor;
+  v.data.hv->kind = HEAP_KIND_CACHE;
+
+  return v;
+}
+
+value_t value_createStream(runtime_t *rt, heap_t *heap, stream_t *stream) {
+  value_t v;
+  v.data.hv = heap_alloc(rt, heap);
+  VALUE_SET_META(&v, TYPE_POINTER, FLAG_OBJECT | FLAG_STREAM);
+
+  v.data.hv->ptr = stream;
+  v.data.hv->dtor_ptr = (native_function_t)stream_destructor;
+  v.data.hv->kind = HEAP_KIND_STREAM;
+
+  return v;
+}
+
+value_t value_createAio(runtime_t *rt, heap_t *heap, aio_request_t *req) {
+  value_t v;
+  v.data.hv = heap_alloc(rt, heap);
+  VALUE_SET_META(&v, TYPE_POINTER, FLAG_OBJECT | FLAG_AIO);
+
+  v.data.hv->ptr = req;
+  v.data.hv->dtor_ptr = (native_function_t)aio_destructor;
+  v.data.hv->kind = HEAP_KIND_AIO;
+
+  return v;
+}
+
+value_t value_createTask(runtime_t *rt, heap_t *heap, task_t *task) {
+  value_t v;
+  v.data.hv = heap_alloc(rt, heap);
+  VALUE_SET_META(&v, TYPE_POINTER, FLAG_OBJECT | FLAG_TASK);
+
+  v.data.hv->ptr = task;
+  v.data.hv->dtor_ptr = (native_function_t)task_destructor;
+  v.data.hv->kind = HEAP_KIND_TASK;
+
+  return v;
+}
+
+value_t value_createChannel(runtime_t *rt, heap_t *heap, channel_t *ch) {
+  value_t v;
+  v.data.hv = heap_alloc(rt, heap);
+  VALUE_SET_META(&v, TYPE_POINTER, FLAG_OBJECT | FLAG_CHANNEL);
+
+  v.data.hv->ptr = ch;
+  v.data.hv->dtor_ptr = (native_function_t)channel_destructor;
+  v.data.hv->kind = HEAP_KIND_CHANNEL;
+
+  return v;
+}
+
+value_t value_createSocket(runtime_t *rt, heap_t *heap, net_socket_t *s) {
+  value_t v;
+  v.data.hv = heap_alloc(rt, heap);
+  VALUE_SET_META(&v, TYPE_POINTER, FLAG_OBJECT | FLAG_SOCKET);
+
+  v.data.hv->ptr = s;
+  v.data.hv->dtor_ptr = (native_function_t)net_destructor;
+  v.data.hv->kind = HEAP_KIND_SOCKET;
+
+  return v;
+}
+
 void *value_getRawPointer(value_t *value) {
+  if (VALUE_HAS(value, TYPE_POINTER, FLAG_INLINE)) {
+    return &value->data;
+  }
+
+  if (VALUE_IS_SLICE(value)) {
+    return (char*)value->data.raw + value->aux;
+  }
+
   return value->data.raw;
 }
 
@@ -115,49 +283,76 @@ heap_value_t *value_getHeapNode(value_t *value) {
 }
 
 void value_setRawPointer(runtime_t *rt, value_t *v, void *raw, VALUE_FLAGS flags) {
-  value_destroy(rt, v);
+  value_release(rt, v);
   v->data.raw = raw;
-  v->metadata = TYPE_POINTER | (flags << 8);
+  VALUE_SET_META(v, TYPE_POINTER, flags);
 }
 
 value_t value_fromRawPointer(void *raw, VALUE_FLAGS flags) {
   value_t v;
   v.data.raw = raw;
-  v.metadata = TYPE_POINTER | (flags << 8);
+  VALUE_SET_META(&v, TYPE_POINTER, flags);
   return v;
 }
 
 void value_setRefCounted(runtime_t *rt, value_t *v, void *ptr) {
-  value_destroy(rt, v);
-  v->data.rc = runtime_claim(rt, (rcmap_key_t)ptr);
-  v->metadata = TYPE_POINTER | (FLAG_REFCOUNTED << 8);
+  value_release(rt, v);
+  v->data.rc = rc_claim(ptr);
+  VALUE_SET_META(v, TYPE_POINTER, FLAG_REFCOUNTED);
+}
+
+void value_setSlice(runtime_t *rt, value_t *v, refcounted_t rc, uint32_t offset, size_t length) {
+  // claimed first, as `v` may hold the last reference to it
+  rc_claim(rc);
+  value_release(rt, v);
+
+  v->data.rc = rc;
+  v->metadata = VALUE_METADATA(TYPE_POINTER, FLAG_REFCOUNTED | FLAG_SLICE) | ((metadata_t)length << 24);
+  v->aux = offset;
+}
+
+void value_setData(runtime_t *rt, value_t *v, const void *data, size_t size) {
+  void *copy;
+
+  if (size < VALUE_INLINE_SIZE) {
+    value_release(rt, v);
+    v->data.u64 = 0;
+    memcpy(&v->data, data, size);
+    VALUE_SET_META(v, TYPE_POINTER, FLAG_INLINE);
+
+    return;
+  }
+
+  // the callers cannot fail: past the hard limit, the run does, at its
+  // next tick, see runtime_checkMemory
+  copy = rc_allocOver(rt->quota, size, runtime_site(rt));
+  memcpy(copy, data, size);
+  value_setRefCounted(rt, v, copy);
 }
 
 value_t value_fromFunction(native_function_t fn) {
   value_t v;
   v.data.fn = fn;
-  v.metadata = TYPE_FUNCTION;
+  VALUE_SET_META(&v, TYPE_FUNCTION, FLAG_NONE);
   return v;
 }
 
 void value_setFunction(runtime_t *rt, value_t *v, native_function_t fn) {
-  value_destroy(rt, v);
+  value_release(rt, v);
   v->data.fn = fn;
-  v->metadata = TYPE_FUNCTION;
+  VALUE_SET_META(v, TYPE_FUNCTION, FLAG_NONE);
 }
 
 VALUE_TYPE value_getType(value_t *value) {
-  // type is stored in first 8 bits of metadata
-  return (VALUE_TYPE)(value->metadata & 0xFF);
+  return VALUE_TYPE_OF(value);
 }
 
 void value_setType(value_t *value, VALUE_TYPE type) {
-  value->metadata = (value->metadata & 0xFF00) | type;
+  value->metadata = (value->metadata & ~(metadata_t)0xFF) | type;
 }
 
 VALUE_FLAGS value_getFlags(value_t *value) {
-  // flags stored in next 8 bits of metadata
-  return (VALUE_FLAGS)(value->metadata & 0xFF00);
+  return (VALUE_FLAGS)((value->metadata >> 8) & 0xFFFF);
 }
 
 void value_setFlag(value_t *value, VALUE_FLAGS flag, int state) {
@@ -190,7 +385,39 @@ uintptr_t value_getID(value_t *value) {
 value_t value_invoke(runtime_t *r, value_t *value) {
   args_t args;
   args._stack = &r->dt->storage[AT_LOCAL];
+  args._registers = NULL;
+  args._rawData = NULL;
+  args._operands = NULL;
+
+  return value->data.fn(r, &args);
+}
+
+value_t value_invokeWithRegisters(runtime_t *r, value_t *value) {
+  args_t args;
+  args._stack = &r->dt->storage[AT_LOCAL];
+  args._registers = &r->dt->storage[AT_REG].data[1];
   args._rawData = NULL;
+  args._operands = NULL;
 
   return value->data.fn(r, &args);
 }
+
+value_t *args_getArg(args_t *args, size_t index) {
+  if (args->_operands != NULL) {
+    return args->_operands[index];
+  }
+
+  if (args->_registers != NULL) {
+    return &args->_registers[index];
+  }
+
+  return &args->_stack->data[*args->_stack->lenVal - 1 - index];
+}
+
+bool args_hasArg(args_t *args, size_t index) {
+  if (args->_operands != NULL || args->_registers != NULL) {
+    return true;
+  }
+
+  return index < *args->_stack->lenVal;
+}
@@ -0,0 +1,320 @@
+#include <vm/vector.h>
+
+#if defined(__GNUC__)
+  #define VECTOR_SIMD 1
+#else
+  #define VECTOR_SIMD 0
+#endif
+
+#if VECTOR_SIMD
+
+#define VECTOR_LANES 4
+
+// aligned like the elements, so a vector can be loaded from any index
+typedef int64_t vector_i64_t __attribute__((vector_size(32), aligned(8), may_alias));
+typedef double vector_f64_t __attribute__((vector_size(32), aligned(8), may_alias));
+
+#define VECTOR_I64(p) (*(vector_i64_t*)(p))
+#define VECTOR_F64(p) (*(vector_f64_t*)(p))
+
+// lanewise x where `x op y`, else y; comparisons give all-ones lanes
+#define VECTOR_SELECT(vtype, x, y, op) ((vtype)( \
+  ((vector_i64_t)(x) & (vector_i64_t)((x) op (y))) | ((vector_i64_t)(y) & ~(vector_i64_t)((x) op (y)))))
+
+#endif
+
+// ===== int64_t =====
+
+void vector_addI64(int64_t *dst, const int64_t *a, const int64_t *b, size_t n) {
+  size_t i = 0;
+
+#if VECTOR_SIMD
+  for (; i + VECTOR_LANES <= n; i += VECTOR_LANES) {
+    VECTOR_I64(dst + i) = VECTOR_I64(a + i) + VECTOR_I64(b + i);
+  }
+#endif
+
+  for (; i < n; i++) {
+    dst[i] = a[i] + b[i];
+  }
+}
+
+void vector_mulI64(int64_t *dst, const int64_t *a, const int64_t *b, size_t n) {
+  size_t i = 0;
+
+#if VECTOR_SIMD
+  for (; i + VECTOR_LANES <= n; i += VECTOR_LANES) {
+    VECTOR_I64(dst + i) = VECTOR_I64(a + i) * VECTOR_I64(b + i);
+  }
+#endif
+
+  for (; i < n; i++) {
+    dst[i] = a[i] * b[i];
+  }
+}
+
+void vector_fmaI64(int64_t *dst, const int64_t *a, const int64_t *b, const int64_t *c, size_t n) {
+  size_t i = 0;
+
+#if VECTOR_SIMD
+  for (; i + VECTOR_LANES <= n; i += VECTOR_LANES) {
+    VECTOR_I64(dst + i) = VECTOR_I64(a + i) * VECTOR_I64(b + i) + VECTOR_I64(c + i);
+  }
+#endif
+
+  for (; i < n; i++) {
+    dst[i] = a[i] * b[i] + c[i];
+  }
+}
+
+int64_t vector_dotI64(const int64_t *a, const int64_t *b, size_t n) {
+  int64_t result = 0;
+  size_t i = 0;
+
+#if VECTOR_SIMD
+  if (n >= VECTOR_LANES) {
+    vector_i64_t acc = VECTOR_I64(a) * VECTOR_I64(b);
+
+    for (i = VECTOR_LANES; i + VECTOR_LANES <= n; i += VECTOR_LANES) {
+      acc += VECTOR_I64(a + i) * VECTOR_I64(b + i);
+    }
+
+    for (unsigned lane = 0; lane < VECTOR_LANES; lane++) {
+      result += acc[lane];
+    }
+  }
+#endif
+
+  for (; i < n; i++) {
+    result += a[i] * b[i];
+  }
+
+  return result;
+}
+
+int64_t vector_sumI64(const int64_t *a, size_t n) {
+  int64_t result = 0;
+  size_t i = 0;
+
+#if VECTOR_SIMD
+  if (n >= VECTOR_LANES) {
+    vector_i64_t acc = VECTOR_I64(a);
+
+    for (i = VECTOR_LANES; i + VECTOR_LANES <= n; i += VECTOR_LANES) {
+      acc += VECTOR_I64(a + i);
+    }
+
+    for (unsigned lane = 0; lane < VECTOR_LANES; lane++) {
+      result += acc[lane];
+    }
+  }
+#endif
+
+  for (; i < n; i++) {
+    result += a[i];
+  }
+
+  return result;
+}
+
+int64_t vector_minI64(const int64_t *a, size_t n) {
+  int64_t result = a[0];
+  size_t i = 1;
+
+#if VECTOR_SIMD
+  if (n >= VECTOR_LANES) {
+    vector_i64_t acc = VECTOR_I64(a);
+
+    for (i = VECTOR_LANES; i + VECTOR_LANES <= n; i += VECTOR_LANES) {
+      acc = VECTOR_SELECT(vector_i64_t, VECTOR_I64(a + i), acc, <);
+    }
+
+    result = acc[0];
+
+    for (unsigned lane = 1; lane < VECTOR_LANES; lane++) {
+      result = acc[lane] < result ? acc[lane] : result;
+    }
+  }
+#endif
+
+  for (; i < n; i++) {
+    result = a[i] < result ? a[i] : result;
+  }
+
+  return result;
+}
+
+int64_t vector_maxI64(const int64_t *a, size_t n) {
+  int64_t result = a[0];
+  size_t i = 1;
+
+#if VECTOR_SIMD
+  if (n >= VECTOR_LANES) {
+    vector_i64_t acc = VECTOR_I64(a);
+
+    for (i = VECTOR_LANES; i + VECTOR_LANES <= n; i += VECTOR_LANES) {
+      acc = VECTOR_SELECT(vector_i64_t, VECTOR_I64(a + i), acc, >);
+    }
+
+    result = acc[0];
+
+    for (unsigned lane = 1; lane < VECTOR_LANES; lane++) {
+      result = acc[lane] > result ? acc[lane] : result;
+    }
+  }
+#endif
+
+  for (; i < n; i++) {
+    result = a[i] > result ? a[i] : result;
+  }
+
+  return result;
+}
+
+// ===== double =====
+
+void vector_addF64(double *dst, const double *a, const double *b, size_t n) {
+  size_t i = 0;
+
+#if VECTOR_SIMD
+  for (; i + VECTOR_LANES <= n; i += VECTOR_LANES) {
+    VECTOR_F64(dst + i) = VECTOR_F64(a + i) + VECTOR_F64(b + i);
+  }
+#endif
+
+  for (; i < n; i++) {
+    dst[i] = a[i] + b[i];
+  }
+}
+
+void vector_mulF64(double *dst, const double *a, const double *b, size_t n) {
+  size_t i = 0;
+
+#if VECTOR_SIMD
+  for (; i + VECTOR_LANES <= n; i += VECTOR_LANES) {
+    VECTOR_F64(dst + i) = VECTOR_F64(a + i) * VECTOR_F64(b + i);
+  }
+#endif
+
+  for (; i < n; i++) {
+    dst[i] = a[i] * b[i];
+  }
+}
+
+void vector_fmaF64(double *dst, const double *a, const double *b, const double *c, size_t n) {
+  size_t i = 0;
+
+#if VECTOR_SIMD
+  for (; i + VECTOR_LANES <= n; i += VECTOR_LANES) {
+    VECTOR_F64(dst + i) = VECTOR_F64(a + i) * VECTOR_F64(b + i) + VECTOR_F64(c + i);
+  }
+#endif
+
+  for (; i < n; i++) {
+    dst[i] = a[i] * b[i] + c[i];
+  }
+}
+
+double vector_dotF64(const double *a, const double *b, size_t n) {
+  double result = 0;
+  size_t i = 0;
+
+#if VECTOR_SIMD
+  if (n >= VECTOR_LANES) {
+    vector_f64_t acc = VECTOR_F64(a) * VECTOR_F64(b);
+
+    for (i = VECTOR_LANES; i + VECTOR_LANES <= n; i += VECTOR_LANES) {
+      acc += VECTOR_F64(a + i) * VECTOR_F64(b + i);
+    }
+
+    for (unsigned lane = 0; lane < VECTOR_LANES; lane++) {
+      result += acc[lane];
+    }
+  }
+#endif
+
+  for (; i < n; i++) {
+    result += a[i] * b[i];
+  }
+
+  return result;
+}
+
+double vector_sumF64(const double *a, size_t n) {
+  double result = 0;
+  size_t i = 0;
+
+#if VECTOR_SIMD
+  if (n >= VECTOR_LANES) {
+    vector_f64_t acc = VECTOR_F64(a);
+
+    for (i = VECTOR_LANES; i + VECTOR_LANES <= n; i += VECTOR_LANES) {
+      acc += VECTOR_F64(a + i);
+    }
+
+    for (unsigned lane = 0; lane < VECTOR_LANES; lane++) {
+      result += acc[lane];
+    }
+  }
+#endif
+
+  for (; i < n; i++) {
+    result += a[i];
+  }
+
+  return result;
+}
+
+double vector_minF64(const double *a, size_t n) {
+  double result = a[0];
+  size_t i = 1;
+
+#if VECTOR_SIMD
+  if (n >= VECTOR_LANES) {
+    vector_f64_t acc = VECTOR_F64(a);
+
+    for (i = VECTOR_LANES; i + VECTOR_LANES <= n; i += VECTOR_LANES) {
+      acc = VECTOR_SELECT(vector_f64_t, VECTOR_F64(a + i), acc, <);
+    }
+
+    result = acc[0];
+
+    for (unsigned lane = 1; lane < VECTOR_LANES; lane++) {
+      result = acc[lane] < result ? acc[lane] : result;
+    }
+  }
+#endif
+
+  for (; i < n; i++) {
+    result = a[i] < result ? a[i] : result;
+  }
+
+  return result;
+}
+
+double vector_maxF64(const double *a, size_t n) {
+  double result = a[0];
+  size_t i = 1;
+
+#if VECTOR_SIMD
+  if (n >= VECTOR_LANES) {
+    vector_f64_t acc = VECTOR_F64(a);
+
+    for (i = VECTOR_LANES; i + VECTOR_LANES <= n; i += VECTOR_LANES) {
+      acc = VECTOR_SELECT(vector_f64_t, VECTOR_F64(a + i), acc, >);
+    }
+
+    result = acc[0];
+
+    for (unsigned lane = 1; lane < VECTOR_LANES; lane++) {
+      result = acc[lane] > result ? acc[lane] : result;
+    }
+  }
+#endif
+
+  for (; i < n; i++) {
+    result = a[i] > result ? a[i] : result;
+  }
+
+  return result;
+}
@@ -0,0 +1,490 @@
+#include <vm/verify.h>
+#include <vm/interpreter.h>
+#include <vm/program.h>
+
+#include <stdlib.h>
+
+// VM_DATA slot holding the stack length, see VM_STACK_POINTER
+#define VERIFY_STACK_SLOT (1 + AT_LOCAL)
+
+typedef struct verify_label {
+  uint64_t slot; // $d index
+  uint64_t value; // byte offset loaded into it
+  uint32_t writes; // instructions that write the slot, including the load
+} verify_label_t;
+
+// resolves a non-stack operand to an index in its storage. their lengths
+// only change through $vm[1] .. $vm[4], which verified code never writes,
+// so relative locations are fixed too.
+static bool verify_slot(const code_t *code, const operand_t *o, uint64_t *slot) {
+  if ((o->at & AT_ABS) == AT_ABS) {
+    *slot = o->loc;
+  } else {
+    uint64_t len = (o->at & 0x3) == AT_DATA ? STATIC_DATA_RESERVED : 0;
+
+    if (o->loc > len) {
+      return false;
+    }
+
+    *slot = len - o->loc;
+  }
+
+  return *slot < code_storageCount(code, o->at);
+}
+
+static bool verify_operand(const code_t *code, const operand_t *o, int64_t depth) {
+  uint64_t slot;
+
+  if (o->base == NULL) {
+    return true; // not used by the instruction
+  }
+
+  if ((o->at & 0x3) == AT_LOCAL && (o->at & AT_ABS) != AT_ABS) {
+    // `depth - loc` may equal depth (one past the top), which is still
+    // inside the buffer since depth is below the stack's slot count
+    return o->loc <= (uint64_t)depth;
+  }
+
+  return verify_slot(code, o, &slot);
+}
+
+// the arguments of an OP_CALL with CALL_FLAGS_OPERANDS
+static VERIFY_RESULT verify_callOperands(const code_t *code, const instruction_t *ins, int64_t depth) {
+  for (uint64_t i = 0; i < ins->imm.call.count; i++) {
+    if (ins->imm.call.args[i].at == AT_FRAME) {
+      return VERIFY_DYNAMIC_STACK;
+    }
+
+    if (!verify_operand(code, &ins->imm.call.args[i], depth)) {
+      return VERIFY_BAD_OPERAND;
+    }
+  }
+
+  return VERIFY_OK;
+}
+
+// the operand an instruction stores into, if any
+static const operand_t *verify_written(const instruction_t *ins) {
+  switch (ins->opcode) {
+    case OP_LOAD:
+    case OP_MOV:
+    case OP_XOR:
+    case OP_AND:
+    case OP_OR:
+    case OP_SHL:
+    case OP_SHR:
+    case OP_NEG:
+    case OP_NOT:
+    case OP_SPAWN: // the new fiber's id
+    case CODE_OP_SETCC:
+    case CODE_OP_SELECT:
+    case CODE_OP_XOR_IMM:
+    case CODE_OP_AND_IMM:
+    case CODE_OP_OR_IMM:
+    case CODE_OP_SHL_IMM:
+    case CODE_OP_SHR_IMM:
+      return &ins->left;
+    case OP_CALL: // where CALL_FLAGS_RESULT puts the result
+    case CODE_OP_GETFIELD:
+    case CODE_OP_SETFIELD:
+      return (ins->flags & CALL_FLAGS_RESULT) ? &ins->right : NULL;
+    case OP_TAKE: // the right operand, left as none, is a register or on the stack (see code_decodeOne)
+      return ins->flags == TAKE_FLAGS_PUSH ? NULL : &ins->left;
+    case OP_JIT: // the compiled region is stored to the left operand
+      return (ins->flags & JIT_FLAG_BEGIN) ? &ins->left : NULL;
+    default:
+      if (ins->opcode >= CODE_OP_ADD_I64 && ins->opcode <= CODE_OP_MOD_I64_IMM) {
+        return &ins->left;
+      }
+
+      return NULL;
+  }
+}
+
+static int verify_compareLabels(const void *a, const void *b) {
+  uint64_t l = ((const verify_label_t*)a)->slot;
+  uint64_t r = ((const verify_label_t*)b)->slot;
+
+  return (l > r) - (l < r);
+}
+
+static verify_label_t *verify_findLabel(verify_label_t *labels, size_t numLabels, uint64_t slot) {
+  verify_label_t key = { .slot = slot };
+
+  return (verify_label_t*)bsearch(&key, labels, numLabels, sizeof(verify_label_t), verify_compareLabels);
+}
+
+// collects the label slots: those of the image's LABELS table, stored
+// before anything runs, and $d locations loaded with a u64 before the
+// first control transfer, so they hold their value whenever a jump runs.
+// the loads count only for code started at offset 0, with `prefix`.
+// returns the number found; `*out` must be freed by the caller.
+static size_t verify_collectLabels(code_t *code, bool prefix, verify_label_t **out) {
+  verify_label_t *labels = (verify_label_t*)malloc(sizeof(verify_label_t) * (code->count + code->numLabels));
+  size_t numLabels = 0;
+
+  for (size_t i = 0; i < code->numLabels; i++) {
+    if (code->labels[i].slot < code_storageCount(code, AT_DATA)) {
+      labels[numLabels].slot = code->labels[i].slot;
+      labels[numLabels].value = code->labels[i].offset;
+      labels[numLabels].writes = 1; // the store in program_load
+      ++numLabels;
+    }
+  }
+
+  for (size_t i = 0; prefix && i < code->count; i++) {
+    const instruction_t *ins = &code->instructions[i];
+    uint64_t slot;
+
+    code_ensure(code, i, i + 1);
+
+    if (ins->opcode == OP_JMP || ins->opcode == OP_CMPJ || ins->opcode == OP_CMPJ_IMM
+        || ins->opcode == CODE_OP_SWITCH || ins->opcode == OP_HALT || ins->opcode == OP_JIT
+        || ins->opcode == OP_SPAWN || ins->opcode == OP_YIELD || ins->opcode == OP_JOIN
+        || ins->opcode == OP_FCALL || ins->opcode == OP_RET) {
+      // a compiled region may jump, and a fiber switch runs other code, so
+      // they end the prefix too
+      break;
+    }
+
+    if (ins->opcode == OP_LOAD && ins->flags == CONST_FLAGS_U64
+        && (ins->left.at & 0x3) == AT_DATA && verify_slot(code, &ins->left, &slot)) {
+      labels[numLabels].slot = slot;
+      labels[numLabels].value = ins->imm.u64;
+      labels[numLabels].writes = 0;
+      ++numLabels;
+    }
+  }
+
+  qsort(labels, numLabels, sizeof(verify_label_t), verify_compareLabels);
+
+  // a slot in the table twice has two values; either one is rejected
+  for (size_t i = 1; i < numLabels; i++) {
+    if (labels[i].slot == labels[i - 1].slot) {
+      labels[i].writes = labels[i - 1].writes = 2;
+    }
+  }
+
+  *out = labels;
+
+  return numLabels;
+}
+
+// counts the writes of every reached instruction, so a slot loaded twice
+// or overwritten later is rejected. only those can run: verified code
+// leaves the reached instructions only through jumps to labels.
+static void verify_countWrites(const code_t *code, verify_label_t *labels, size_t numLabels, const int64_t *depths) {
+  for (size_t i = 0; i < code->count && numLabels != 0; i++) {
+    const operand_t *w = depths[i] != -1 ? verify_written(&code->instructions[i]) : NULL;
+    uint64_t slot;
+
+    if (w != NULL && (w->at & 0x3) == AT_DATA && verify_slot(code, w, &slot)) {
+      verify_label_t *label = verify_findLabel(labels, numLabels, slot);
+
+      if (label != NULL) {
+        ++label->writes;
+      }
+    }
+  }
+}
+
+static bool verify_jumps(const instruction_t *ins) {
+  return ins->opcode == OP_JMP || ins->opcode == OP_CMPJ || ins->opcode == OP_CMPJ_IMM
+    || ins->opcode == CODE_OP_SWITCH || ins->opcode == OP_SPAWN;
+}
+
+// the label a jump goes through, or NULL if it is not through one
+static verify_label_t *verify_jumpLabel(const code_t *code, verify_label_t *labels, size_t numLabels,
+                                        const instruction_t *ins) {
+  uint64_t slot;
+  verify_label_t *label;
+
+  if ((ins->target.at & 0x3) != AT_DATA || !verify_slot(code, &ins->target, &slot)) {
+    return NULL;
+  }
+
+  label = verify_findLabel(labels, numLabels, slot);
+
+  return label != NULL && label->value <= code->len ? label : NULL;
+}
+
+static bool verify_jumpTarget(code_t *code, verify_label_t *labels, size_t numLabels,
+                              const instruction_t *ins, uint32_t *index) {
+  verify_label_t *label;
+
+  // a direct jump only has to land on an instruction
+  if (CODE_DIRECT_JUMP(ins)) {
+    *index = code_indexAt(code, ins->target.loc);
+
+    return *index != CODE_INVALID_INDEX;
+  }
+
+  label = verify_jumpLabel(code, labels, numLabels, ins);
+
+  // before the writes are counted a load has none yet, so only a slot
+  // with two values is rejected here. see verify_code.
+  if (label == NULL || label->writes > 1) {
+    return false;
+  }
+
+  *index = code_indexAt(code, label->value);
+
+  return *index != CODE_INVALID_INDEX;
+}
+
+// records that instruction `index` is reached with `depth`, queueing it on first visit
+static bool verify_visit(int64_t *depths, uint32_t *work, size_t *numWork, uint32_t index, int64_t depth) {
+  if (depths[index] == -1) {
+    depths[index] = depth;
+    work[(*numWork)++] = index;
+
+    return true;
+  }
+
+  return depths[index] == depth;
+}
+
+// the proof for code entered at instruction `entry` with an empty stack
+static VERIFY_RESULT verify_from(code_t *code, uint32_t entry, uint32_t *failOffset) {
+  VERIFY_RESULT result = VERIFY_OK;
+  const image_t *image = &code->program->image;
+  verify_label_t *labels;
+  size_t numLabels = verify_collectLabels(code, entry == 0, &labels);
+
+  // stack depth on entry to each instruction, -1 if not reached yet.
+  // each instruction is queued at most once, so `work` needs `count` entries.
+  int64_t *depths = (int64_t*)malloc(sizeof(int64_t) * code->count);
+  uint32_t *work = (uint32_t*)malloc(sizeof(uint32_t) * code->count);
+  size_t numWork = 0;
+
+  for (size_t i = 0; i < code->count; i++) {
+    depths[i] = -1;
+  }
+
+  verify_visit(depths, work, &numWork, entry, 0);
+
+  while (numWork != 0 && result == VERIFY_OK) {
+    uint32_t index = work[--numWork];
+    const instruction_t *ins;
+    const operand_t *w;
+    int64_t depth = depths[index];
+    int64_t next = depth;
+    uint32_t target;
+    bool fallthrough = true, jumps = false, spawns = false;
+    uint64_t slot;
+
+    // segments are decoded as they are reached, so only reachable code is
+    code_ensure(code, index, index + 1);
+    ins = &code->instructions[index];
+    w = verify_written(ins);
+
+    if (failOffset != NULL) {
+      *failOffset = ins->offset;
+    }
+
+    // the depth a function runs at, and so where its frame is, depends
+    // on its caller
+    if (ins->opcode == OP_FCALL || ins->opcode == OP_RET
+        || ins->left.at == AT_FRAME || ins->right.at == AT_FRAME || ins->target.at == AT_FRAME) {
+      result = VERIFY_DYNAMIC_STACK;
+      break;
+    }
+
+    // a select has its third operand in `target`
+    if (!verify_operand(code, &ins->left, depth) || !verify_operand(code, &ins->right, depth)
+        || (ins->opcode == CODE_OP_SELECT && !verify_operand(code, &ins->target, depth))) {
+      result = VERIFY_BAD_OPERAND;
+      break;
+    }
+
+    if (CODE_IS_CALL(ins->opcode) && (ins->flags & CALL_FLAGS_OPERANDS)
+        && (result = verify_callOperands(code, ins, depth)) != VERIFY_OK) {
+      break;
+    }
+
+    if (w != NULL && (w->at & 0x3) == AT_VM && verify_slot(code, w, &slot) && slot >= 1 && slot <= 4) {
+      // `add $vm[3], n` / `sub $vm[3], n` grow or shrink the stack by a
+      // known amount, see CODE_OP_STACK_IMM
+      if (ins->handler == CODE_OP_STACK_IMM && ins->opcode == CODE_OP_ADD_I64_IMM) {
+        next = depth + ins->imm.i64;
+      } else if (ins->handler == CODE_OP_STACK_IMM && ins->opcode == CODE_OP_SUB_I64_IMM) {
+        next = depth - ins->imm.i64;
+      } else {
+        result = VERIFY_DYNAMIC_STACK;
+        break;
+      }
+    }
+
+    switch (ins->opcode) {
+      case OP_PUSH:
+        next = depth + 1;
+        break;
+      case OP_TAKE:
+        next = ins->flags == TAKE_FLAGS_PUSH ? depth + 1 : depth;
+        break;
+      case OP_POP:
+        next = depth - (int64_t)ins->imm.u64;
+        break;
+      case OP_JMP:
+        fallthrough = ins->flags != JUMP_FLAGS_NONE;
+        jumps = true;
+        break;
+      case OP_CMPJ:
+      case OP_CMPJ_IMM:
+        jumps = true;
+        break;
+      case CODE_OP_SWITCH:
+        fallthrough = false;
+        jumps = true;
+        break;
+      case OP_HALT:
+        fallthrough = false;
+        break;
+      case OP_SPAWN:
+        spawns = true;
+        break;
+      case OP_JIT:
+        // a memoized region reads its arguments off the top of the stack,
+        // which counts as an underflow if there are not enough
+        if ((ins->flags & JIT_FLAG_MEMOIZE) && (uint64_t)depth < ins->imm.u64) {
+          next = -1;
+        }
+        break;
+    }
+
+    if (next < 0) {
+      result = VERIFY_STACK_UNDERFLOW;
+      break;
+    }
+
+    if (next >= (int64_t)code_storageCount(code, AT_LOCAL)) {
+      result = VERIFY_STACK_OVERFLOW;
+      break;
+    }
+
+    // a throw in a try region goes on at its handler, with the depth the
+    // region was entered with, see interpreter_catch
+    for (size_t i = 0; i < image->numTries && result == VERIFY_OK; i++) {
+      bin_try_t region = image_try(image, i);
+
+      if (region.start != ins->offset) {
+        continue;
+      }
+
+      if ((target = code_indexAt(code, region.handler)) == CODE_INVALID_INDEX) {
+        result = VERIFY_BAD_JUMP;
+      } else if (!verify_visit(depths, work, &numWork, target, depth)) {
+        result = VERIFY_STACK_MISMATCH;
+      }
+    }
+
+    if (result != VERIFY_OK) {
+      break;
+    }
+
+    // the last instruction is always the terminating halt, so index + 1 exists
+    if (fallthrough && !verify_visit(depths, work, &numWork, index + 1, next)) {
+      result = VERIFY_STACK_MISMATCH;
+      break;
+    }
+
+    if (jumps) {
+      if (!verify_jumpTarget(code, labels, numLabels, ins, &target)) {
+        result = VERIFY_BAD_JUMP;
+        break;
+      }
+
+      if (!verify_visit(depths, work, &numWork, target, next)) {
+        result = VERIFY_STACK_MISMATCH;
+        break;
+      }
+
+      // the cases of a switch, the default being its target
+      for (uint32_t i = 0; ins->opcode == CODE_OP_SWITCH && i < ins->imm.table->count; i++) {
+        if ((target = code_indexAt(code, ins->imm.table->offsets[i])) == CODE_INVALID_INDEX) {
+          result = VERIFY_BAD_JUMP;
+        } else if (!verify_visit(depths, work, &numWork, target, next)) {
+          result = VERIFY_STACK_MISMATCH;
+        }
+
+        if (result != VERIFY_OK) {
+          break;
+        }
+      }
+
+      if (result != VERIFY_OK) {
+        break;
+      }
+    }
+
+    // a fiber starts on an empty stack of its own
+    if (spawns) {
+      if (!verify_jumpTarget(code, labels, numLabels, ins, &target)) {
+        result = VERIFY_BAD_JUMP;
+        break;
+      }
+
+      if (!verify_visit(depths, work, &numWork, target, 0)) {
+        result = VERIFY_STACK_MISMATCH;
+        break;
+      }
+    }
+  }
+
+  // with the writes known, every label jumped through must have only its
+  // load. each reached jump through a label found it above.
+  if (result == VERIFY_OK) {
+    verify_countWrites(code, labels, numLabels, depths);
+
+    for (size_t i = 0; i < code->count; i++) {
+      const instruction_t *ins = &code->instructions[i];
+
+      if (depths[i] != -1 && verify_jumps(ins) && !CODE_DIRECT_JUMP(ins)
+          && verify_jumpLabel(code, labels, numLabels, ins)->writes != 1) {
+        if (failOffset != NULL) {
+          *failOffset = ins->offset;
+        }
+
+        result = VERIFY_BAD_JUMP;
+        break;
+      }
+    }
+  }
+
+  free(work);
+  free(depths);
+  free(labels);
+
+  return result;
+}
+
+VERIFY_RESULT verify_code(code_t *code, uint32_t *failOffset) {
+  return verify_from(code, 0, failOffset);
+}
+
+VERIFY_RESULT verify_entry(code_t *code, uint64_t offset, uint32_t *failOffset) {
+  uint32_t index = code_indexAt(code, offset);
+
+  if (index == CODE_INVALID_INDEX) {
+    if (failOffset != NULL) {
+      *failOffset = (uint32_t)offset;
+    }
+
+    return VERIFY_BAD_JUMP;
+  }
+
+  return verify_from(code, index, failOffset);
+}
+
+const char *verify_resultString(VERIFY_RESULT result) {
+  switch (result) {
+    case VERIFY_OK: return "ok";
+    case VERIFY_BAD_OPERAND: return "operand out of range";
+    case VERIFY_BAD_JUMP: return "jump target is not a label";
+    case VERIFY_STACK_OVERFLOW: return "stack overflow";
+    case VERIFY_STACK_UNDERFLOW: return "stack underflow";
+    case VERIFY_STACK_MISMATCH: return "stack depth differs between paths";
+    case VERIFY_DYNAMIC_STACK: return "storage length written directly, or a frame";
+    default: return "unknown";
+  }
+}
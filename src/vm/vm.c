@@ -1,3 +1,7 @@
+#if defined(__linux__)
+  #define _GNU_SOURCE // for CPU affinity, see workerAttr
+#endif
+
 #include <stdint.h>
 #include <string.h>
 #include <stdlib.h>
@@ -6,6 +10,36 @@
 
 #include <time.h>
 #include <pthread.h>
+#include <stdatomic.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+  #define VM_MMAP 1
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <fcntl.h>
+  #include <unistd.h>
+  #define VM_SERVE 1
+  #include <signal.h>
+  #include <errno.h>
+  #define VM_SAMPLE 1
+  #include <sys/time.h>
+  #define VM_RING_SIGNAL 1
+  #define VM_FORK 1
+  #include <sys/wait.h>
+#else
+  #define VM_MMAP 0
+  #define VM_SERVE 0
+  #define VM_SAMPLE 0
+  #define VM_RING_SIGNAL 0
+  #define VM_FORK 0
+#endif
+
+#if defined(__linux__)
+  #define VM_PIN 1
+  #include <sched.h>
+#else
+  #define VM_PIN 0
+#endif
 
 // ===== Instructions =====
 
@@ -16,6 +50,16 @@
 #include <vm/types.h>
 
 #include <vm/jit.h>
+#include <vm/builtins.h>
+#include <vm/calls.h>
+#include <vm/events.h>
+#include <vm/perf.h>
+#include <vm/extension.h>
+#include <vm/annotate.h>
+#include <vm/serve.h>
+#include <vm/util.h>
+
+#include <shared/bin_format.h>
 
 #define MEASURE_EXECUTION_TIME_BEGIN clock_t begin = clock()
 #define MEASURE_EXECUTION_TIME_END clock_t end = clock()
@@ -220,197 +264,401 @@ int rcmap_remove(rcmap_t *map, rcmap_key_t key) {
 
 // ===== Interpreter =====
 #include <vm/interpreter.h>
+#include <vm/snapshot.h>
+#include <vm/program.h>
 
-// ===== Native function arguments =====
+// ===== Utility functions =====
 
-value_t *args_getArg(args_t *args, size_t index) {
-  return &args->_stack->data[*args->_stack->lenVal - 1 - index];
+uint8_t makeInstruction(enum INSTRUCTIONS opcode, uint8_t flags) {
+  uint8_t data = opcode;
+  data <<= 3;
+  data |= flags;
+  return data;
 }
 
+void showArguments(int argc, char *argv[]) {
+  printf("Arguments: %s <filename> [--genc | --aot <output> | --snapshot <image> | --restore <image> | [[--workers <n>] [--pin] | --prefork <n> | --nodes <addr,...> [--workers <n>] [--allow-remote]] --input <list>] [--huge-pages] [--output line|block] [--budget <n>] [--slice <n>] [--gc-budget <us>] [--memory-limit <bytes>] [--memory-soft <bytes>] [--stats] [--profile-out <file>] [--profile=opcodes|blocks|calls] [--profile-samples <file>] [--profile-instructions <file>] [--trace-calls[=json]] [--trace-gc <file>] [--trace-ring <n>] [--heap-census[=<graph>]] [--perf-counters] [--extension <module>]...\n"
+    "       %s --annotate <profile> <filename> [--extension <module>]...\n"
+    "       %s --serve <socket> [--root <dir>] [--allow-remote] [--workers <n>] [--pin] [--huge-pages] [--output line|block] [--budget <n>] [--slice <n>] [--gc-budget <us>] [--memory-limit <bytes>] [--memory-soft <bytes>] [--extension <module>]...\n"
+    "\t--genc: Generate C source file (_tmp_jit.c)\n"
+    "\t--aot <output>: Compile to a native executable, via <output>.c\n"
+    "\t--snapshot <image>: Save the program's state to <image> when it calls `snapshot`, then exit\n"
+    "\t--restore <image>: Continue from the state saved in <image>, just after the `snapshot` call\n"
+    "\t--input <list>: Run the program once for each line of <list>, which `input` returns\n"
+    "\t--workers <n>: Run that many of those at a time, on threads of their own (default: 1)\n"
+    "\t--nodes <addr,...>: Run those on the --serve servers at each address instead, a Unix socket or host:port, sending them the program once, <n> at a time on each with --workers, each taking the next job as it finishes one; a server that fails is given no more, its jobs going to the others. with --stats, print what each server ran and took to stderr. each must be a Unix socket or a loopback address unless --allow-remote\n"
+    "\t--prefork <n>: Run the program once up to its `snapshot` call, then fork a process for each line of <list>, <n> at a time, going on from there with what the setup built shared between them\n"
+    "\t--pin: Keep each worker, and the memory it allocates, on a CPU of its own, round robin over those the process may use (Linux)\n"
+    "\t--huge-pages: Back the static data and the stack with transparent huge pages (Linux)\n"
+    "\t--output line|block: Write printed values out after each print, or when the buffer fills (default: line on a terminal)\n"
+    "\t--budget <n>: Stop a run after <n> taken jumps and calls (with --input or --serve, only that run)\n"
+    "\t--slice <n>: Switch fibers every <n> taken jumps and calls, as if the running one yielded\n"
+    "\t--gc-budget <us>: Mark the heap for a full collection incrementally, stopping the program for about <us> microseconds at a time\n"
+    "\t--memory-limit <bytes>: Fail allocations past <bytes> of heap and strings, throwing; a run that does not catch it stops (with --input or --serve, only that run)\n"
+    "\t--memory-soft <bytes>: Collect the heap in full and compact it once it goes past <bytes>\n"
+    "\t--stats: Print heap and collector statistics to stderr on exit (not with --input)\n"
+    "\t--profile-out <file>: Count the jumps and calls of a program compiled with -g, for bcparse --profile-use (not with --input)\n"
+    "\t--profile=opcodes: Count the opcodes run, by flags, and the pairs run one after the other, and print them to stderr on exit (not with --input)\n"
+    "\t--profile=blocks: Time the code between labels, named with -g, and print it to stderr on exit (not with --input)\n"
+    "\t--profile=calls: The same, with the time each block spends in each builtin it calls\n"
+    "\t--profile-samples <file>: Sample where the program is every millisecond of CPU time, and write the samples as collapsed stacks for flamegraph.pl or speedscope (not with --input)\n"
+    "\t--profile-instructions <file>: Count and time each instruction run, and the jumps taken, and write them to <file> for --annotate (not with --input; nothing is compiled)\n"
+    "\t--trace-calls[=json]: Count and time the calls of each builtin, and print them to stderr on exit, as a table or JSON (not with --input; nothing is compiled)\n"
+    "\t--trace-gc <file>: Record allocations and collections, and write them as a Chrome trace (chrome://tracing, Perfetto) on exit\n"
+    "\t--trace-ring <n>: Keep the last <n> instructions run, and write them to stderr on exit, on SIGUSR1 or when the program calls traceDump (not with --input; nothing is compiled)\n"
+    "\t--heap-census[=<graph>]: On SIGUSR2, write what the heap holds to stderr -- objects by shape, buffers by where they were made, what the roots retain -- and the object graph to <graph>, for Graphviz (not with --input); the program can do the same by calling heapCensus\n"
+    "\t--perf-counters: Count cycles, instructions, branch misses and cache misses of the interpreter thread (Linux), and print them to stderr on exit; per bytecode instruction with --profile=opcodes (not with --input)\n"
+    "\t--extension <module>: Load a native extension module (a shared library, see shared/extension.h) the program was compiled with (not with --aot)\n"
+    "\t--annotate <profile>: List the instructions of the program, under the source lines they came from if it was compiled with -g, with the counts, share of the time and jumps taken --profile-instructions wrote to <profile>\n"
+    "\t--serve <socket>: Listen on a Unix socket, only its owner may connect to, or on TCP for host:port, on a loopback address unless --allow-remote, for lines of \"<filename> [input]\", running each and sending back what it prints; a program is loaded again when its file is replaced, the runs already going finishing on the old one; and of \"put <hash> <size>\", with which --nodes sends a program, kept to run as \"#<hash>\"\n"
+    "\t--root <dir>: The directory the <filename>s a server runs are in; they may not lead out of it. without it, only programs sent with \"put\" are run\n"
+    "\t--allow-remote: Let the server listen on an address other than a loopback one, where anyone who can reach it can run code; or --nodes send the program and its input to one\n\n",
+    argv[0], argv[0], argv[0]);
+  exit(EXIT_FAILURE);
+}
+
+// ===== statistics =====
+
+// for printStats, which runs at exit -- the program may end in OP_HALT
+static runtime_t *statsRuntime = NULL;
+
+void printStats() {
+  runtime_stats_t s;
+
+  if (statsRuntime == NULL) {
+    return; // already printed, before main destroyed the runtime
+  }
+
+  runtime_getStats(statsRuntime, &s);
+
+  fprintf(stderr, "heap: %zu nodes allocated, %zu live (%zu young), %zu finalized, %zu pending, %zu KB of slabs\n",
+    s.nodesAllocated, s.nodesLive, s.nodesYoung, s.nodesFinalized, s.nodesPending, s.slabBytes / 1024);
+  fprintf(stderr, "gc: %zu full, %zu minor, pauses %.3f ms total, %.3f ms max\n",
+    s.gcFullCount, s.gcMinorCount, s.gcPauseTotalNs / 1e6, s.gcPauseMaxNs / 1e6);
+  fprintf(stderr, "datatable: %zu KB of $l, %zu KB of $d resident\n",
+    s.stackResidentBytes / 1024, s.staticDataResidentBytes / 1024);
+  if (s.memorySoft != 0 || s.memoryHard != 0) {
+    fprintf(stderr, "memory: %zu KB charged, limits %zu KB soft, %zu KB hard\n",
+      s.memoryUsed / 1024, s.memorySoft / 1024, s.memoryHard / 1024);
+  }
+  fprintf(stderr, "strings: %zu refcounted buffers, %zu interned (load %.2f)\n",
+    s.rcAllocated, s.internedStrings, (double)s.internedStrings / (double)s.internTableSize);
 
-// ===== Builtin bindings =====
-value_t _System_createObject(runtime_t *r, args_t *args) {
-  return value_createObject(r, r->heap);
+  statsRuntime = NULL;
 }
 
-value_t _System_getObjectMember(runtime_t *r, args_t *args) {
-  value_t result;
-  result.metadata = TYPE_NONE;
+// ===== profile =====
 
-  value_t *target = args_getArg(args, 0);
-  value_t *member_key = args_getArg(args, 1);
+// for writeProfile, which also runs at exit -- the program may end in OP_HALT
+static interpreter_t *profileInterpreter = NULL;
+static const char *profilePath = NULL;
 
-  char *member_key_str = (char*)value_getRawPointer(member_key);
+void writeProfile() {
+  interpreter_t *it = profileInterpreter;
 
-  if ((target->metadata & (TYPE_POINTER | (FLAG_OBJECT << 8))) != (TYPE_POINTER | (FLAG_OBJECT << 8))) {
-    // TODO: throw exception cause its not an object
-    return result;
+  if (it == NULL) {
+    return; // already written, before the interpreter was destroyed
   }
 
-  heap_value_t *hv = value_getHeapNode(target);
+  profileInterpreter = NULL;
+  interpreter_writeProfile(it, profilePath);
+}
 
-  object_t *object = (object_t*)hv->ptr;
-  value_t *member_ptr = NULL;
+// for printProfiles, which runs at exit too
+static interpreter_t *profiledInterpreter = NULL;
+static bool profileOpcodes = false;
+static bool profileBlocks = false;
+static bool profileCalls = false;
 
-  if (object_getPtr(object, member_key_str, &member_ptr) != OBJECT_OK) {
-    // TODO throw exception cause member not found
+void printProfiles() {
+  interpreter_t *it = profiledInterpreter;
 
-    return result;
+  if (it == NULL) {
+    return; // already printed, before the interpreter was destroyed
   }
 
-  value_copyValue(r, &result, member_ptr);
+  profiledInterpreter = NULL;
+  interpreter_writeOpcodes(it, stderr);
+  interpreter_writeBlocks(it, stderr);
+}
 
-  return result;
+// for writeInstructions, which runs at exit too
+static interpreter_t *instructionsInterpreter = NULL;
+static const char *instructionsPath = NULL;
+
+void writeInstructions() {
+  interpreter_t *it = instructionsInterpreter;
+
+  if (it == NULL) {
+    return; // already written, before the interpreter was destroyed
+  }
+
+  instructionsInterpreter = NULL;
+  interpreter_writeInstructions(it, instructionsPath);
+}
+
+// ===== calls =====
+
+// for printCalls, which runs at exit as well
+static runtime_t *callsRuntime = NULL;
+static bool callsJson = false;
+
+void printCalls() {
+  if (callsRuntime == NULL) {
+    return; // already printed, before main destroyed the runtime
+  }
+
+  calls_write(callsRuntime->calls, stderr, callsJson);
+  callsRuntime = NULL;
 }
 
-value_t _System_setObjectMember(runtime_t *r, args_t *args) {
-  value_t result;
-  result.metadata = TYPE_NONE;
+// ===== events =====
 
-  value_t *target = args_getArg(args, 0);
-  value_t *member_key = args_getArg(args, 1);
-  char *member_key_str = (char*)value_getRawPointer(member_key);
+// for writeEvents, which runs at exit as well
+static const char *eventsPath = NULL;
 
-  value_t *member_value = args_getArg(args, 2);
+void writeEvents() {
+  const char *path = eventsPath;
 
-  if ((target->metadata & (TYPE_POINTER | (FLAG_OBJECT << 8))) != (TYPE_POINTER | (FLAG_OBJECT << 8))) {
-    // TODO: throw exception cause its not an object
-    return result;
+  if (path == NULL) {
+    return; // already written
   }
 
-  heap_value_t *hv = value_getHeapNode(target);
+  eventsPath = NULL;
+  events_write(path);
+}
 
-  object_t *object = (object_t*)hv->ptr;
+// ===== sampling =====
 
-  int result_code;
+// for writeSamples, which runs at exit as well. read by the SIGPROF
+// handler, on whichever thread the signal lands.
+static interpreter_t *volatile sampledInterpreter = NULL;
+static const char *samplesPath = NULL;
 
-  value_copyValue(r, &result, member_value);
+#if VM_SAMPLE
+static void onProfilingTimer(int sig) {
+  interpreter_t *it = sampledInterpreter;
 
-  if ((result_code = object_put(object, member_key_str, &result)) != OBJECT_OK) {
-    // TODO throw exception cause could not set member
-    value_setInt(r, &result, result_code);
+  (void)sig;
 
-    return result;
+  if (it != NULL) {
+    interpreter_sample(it);
   }
-
-  return result;
 }
 
-// ===== C Lib functions =====
+// the other threads are started with SIGPROF blocked, see main, so that
+// the samples are taken on the interpreter's; unblocks it on this thread
+static void startSampling(interpreter_t *it) {
+  struct sigaction action;
+  struct itimerval timer = { { 0, 1000 }, { 0, 1000 } };
+  sigset_t set;
+
+  interpreter_profileSamples(it);
+  sampledInterpreter = it;
+
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = onProfilingTimer;
+  action.sa_flags = SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGPROF, &action, NULL);
 
-value_t _System_C_exit(runtime_t *r, args_t *args) {
-  exit(value_getInt(args_getArg(args, 0)));
+  sigemptyset(&set);
+  sigaddset(&set, SIGPROF);
+  pthread_sigmask(SIG_UNBLOCK, &set, NULL);
 
-  return value_fromRawPointer(NULL, 0);
+  setitimer(ITIMER_PROF, &timer, NULL);
 }
 
-#include <math.h>
-value_t _System_C_fmod(runtime_t *r, args_t *args) {
-  double a = value_getDouble(args_getArg(args, 0));
-  double b = value_getDouble(args_getArg(args, 1));
+static void stopSampling() {
+  struct itimerval timer = { { 0, 0 }, { 0, 0 } };
 
-  return value_fromDouble(fmod(a, b));
+  setitimer(ITIMER_PROF, &timer, NULL);
+}
+#else
+static void startSampling(interpreter_t *it) {
+  (void)it;
+  fprintf(stderr, "--profile-samples is not supported on this platform\n");
+  exit(EXIT_FAILURE);
 }
 
-value_t _System_C_strlen(runtime_t *r, args_t *args) {
-  return value_fromInt(strlen((char*)value_getRawPointer(args_getArg(args, 0))));
+static void stopSampling() {
 }
+#endif
 
-value_t _System_C_fopen(runtime_t *r, args_t *args) {
-  char *filename = (char*)value_getRawPointer(args_getArg(args, 0));
-  char *mode = (char*)value_getRawPointer(args_getArg(args, 1));
+void writeSamples() {
+  interpreter_t *it = sampledInterpreter;
+  FILE *f;
 
-  FILE *file = fopen(filename, mode);
+  if (it == NULL) {
+    return; // already written, before the interpreter was destroyed
+  }
 
-  return value_fromRawPointer((void*)file, 0);
-}
+  stopSampling();
+  sampledInterpreter = NULL;
 
-value_t _System_C_fclose(runtime_t *r, args_t *args) {
-  FILE *file = (FILE*)value_getRawPointer(args_getArg(args, 0));
+  if ((f = fopen(samplesPath, "w")) == NULL) {
+    fprintf(stderr, "could not open %s for writing\n", samplesPath);
+    return;
+  }
 
-  return value_fromInt(fclose(file));
+  interpreter_writeSamples(it, f);
+  fclose(f);
 }
 
-value_t _System_C_fread(runtime_t *r, args_t *args) {
-  FILE *file = (FILE*)value_getRawPointer(args_getArg(args, 0));
-  int64_t size = value_getInt(args_getArg(args, 1));
+// ===== ring =====
 
-  char *data = malloc(size);
+// for writeRing, which runs at exit as well, and ringThread. the lock
+// keeps the interpreter from being destroyed while its ring is written.
+static size_t ringSize = 0;
+static interpreter_t *ringInterpreter = NULL;
+static pthread_mutex_t ringLock = PTHREAD_MUTEX_INITIALIZER;
 
-  memset(data, 0, size);
+void writeRing() {
+  pthread_mutex_lock(&ringLock);
 
-  fread(data, 1, size, file);
+  if (ringInterpreter != NULL) {
+    interpreter_writeRing(ringInterpreter, stderr);
+    ringInterpreter = NULL;
+  }
 
-  value_t v;
-  v.metadata = TYPE_NONE;
+  pthread_mutex_unlock(&ringLock);
+}
 
-  value_setRefCounted(r, &v, data);
+#if VM_RING_SIGNAL
+// SIGUSR1 is blocked on every thread, see main, and taken here, so that
+// the ring is written outside of a signal handler. the program goes on
+// meanwhile: the newest entries may be overwritten as they are read.
+void *ringThread(void *arg) {
+  sigset_t set;
+  int sig;
 
-  return v;
-}
+  (void)arg;
+  sigemptyset(&set);
+  sigaddset(&set, SIGUSR1);
 
-value_t _System_C_fwrite(runtime_t *r, args_t *args) {
-  FILE *file = (FILE*)value_getRawPointer(args_getArg(args, 0));
-  int64_t size = value_getInt(args_getArg(args, 1));
-  void *raw = value_getRawPointer(args_getArg(args, 2));
-  size_t result = fwrite(raw, 1, size, file);
+  while (sigwait(&set, &sig) == 0) {
+    pthread_mutex_lock(&ringLock);
 
-  return value_fromInt(result);
-}
+    if (ringInterpreter != NULL) {
+      interpreter_writeRing(ringInterpreter, stderr);
+    }
 
-value_t _System_C_fseek(runtime_t *r, args_t *args) {
-  FILE *file = (FILE*)value_getRawPointer(args_getArg(args, 0));
-  int64_t offset = value_getInt(args_getArg(args, 1));
-  int64_t origin = value_getInt(args_getArg(args, 2));
+    pthread_mutex_unlock(&ringLock);
+  }
 
-  return value_fromInt(fseek(file, offset, origin));
+  return NULL;
 }
+#endif
 
-// ===== Utility functions =====
+// ===== census =====
 
-uint8_t makeInstruction(enum INSTRUCTIONS opcode, uint8_t flags) {
-  uint8_t data = opcode;
-  data <<= 3;
-  data |= flags;
-  return data;
+// for censusThread: the runtime, until main destroys it, guarded by the
+// lock, and where the graph goes, if anywhere
+static bool censusRequested = false;
+static const char *censusGraphPath = NULL;
+static runtime_t *censusRuntime = NULL;
+static pthread_mutex_t censusLock = PTHREAD_MUTEX_INITIALIZER;
+
+#if VM_RING_SIGNAL
+// SIGUSR2, blocked on every thread as SIGUSR1 is for ringThread. the
+// mutators are stopped for the census, as for a collection.
+void *censusThread(void *arg) {
+  sigset_t set;
+  int sig;
+
+  (void)arg;
+  sigemptyset(&set);
+  sigaddset(&set, SIGUSR2);
+
+  while (sigwait(&set, &sig) == 0) {
+    pthread_mutex_lock(&censusLock);
+
+    if (censusRuntime != NULL) {
+      runtime_heapCensus(censusRuntime, stderr, censusGraphPath, true);
+    }
+
+    pthread_mutex_unlock(&censusLock);
+  }
+
+  return NULL;
 }
+#endif
 
-void showArguments(int argc, char *argv[]) {
-  printf("Arguments: %s <filename>\n\t--genc: Generate C source file\n\n", argv[0]);
-  exit(EXIT_FAILURE);
+// ===== hardware counters =====
+
+// for writeCounters, which runs at exit as well
+static bool perfRequested = false;
+static perf_t *perfCounters = NULL;
+static interpreter_t *countedInterpreter = NULL;
+
+// the bytecode instructions run are known when they were counted for
+// --profile=opcodes, which the counters then include
+void writeCounters() {
+  perf_t *perf = perfCounters;
+  uint64_t bytecodes = 0;
+
+  if (perf == NULL) {
+    return; // already written, or none could be opened
+  }
+
+  perfCounters = NULL;
+  perf_stop(perf);
+
+  if (countedInterpreter->opcodes != NULL) {
+    for (size_t op = 0; op < CODE_OP_COUNT; op++) {
+      for (size_t flags = 0; flags < 256; flags++) {
+        bytecodes += countedInterpreter->opcodes->counts[op][flags];
+      }
+    }
+  }
+
+  perf_write(perf, stderr, bytecodes);
+  perf_close(perf);
 }
 
-// ===== threading functions =====
+// ===== files =====
 
+// a file's contents, see openFile
 typedef struct {
-  runtime_t *rt;
   ubyte_t *data;
   size_t len;
-} interpreter_data_t;
+  bool mapped; // `data` is a read-only mapping of the file
+} file_data_t;
 
-void *interpreterThread(void *arg) {
-  interpreter_data_t *iData = (interpreter_data_t*)arg;
+// maps the file read-only where possible: the interpreter executes from
+// the mapping directly, and processes running the same file share its
+// pages. read into a malloc'd buffer otherwise, e.g from a pipe.
+void openFile(const char *path, file_data_t *out) {
+#if VM_MMAP
+  int fd = open(path, O_RDONLY);
+  struct stat st;
 
-  interpreter_t *it = interpreter_create(iData->rt, iData->data, iData->len);
+  if (fd != -1 && fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+    void *mem = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
 
-  // value_setFunction(iData->rt, datatable_getValue(iData->rt->dt, 0, AT_DATA | AT_ABS), _System_C_exit);
+    if (mem != MAP_FAILED) {
+      close(fd);
 
-  interpreter_run(it);
-  interpreter_destroy(it);
+      // decoding reads it front to back once, see interpreter_create
+      madvise(mem, (size_t)st.st_size, MADV_SEQUENTIAL);
+      madvise(mem, (size_t)st.st_size, MADV_WILLNEED);
 
-  return NULL;
-}
+      out->data = (ubyte_t*)mem;
+      out->len = (size_t)st.st_size;
+      out->mapped = true;
 
-void *gcThread(void *arg) {
-  runtime_t *rt = (runtime_t*)arg;
+      return;
+    }
+  }
 
-  // @TODO
+  if (fd != -1) {
+    close(fd);
+  }
+#endif
 
-  return NULL;
-}
+  FILE *fp = fopen(path, "r");
 
-void openFile(interpreter_data_t *iData, int argc, char *argv[]) {
-  FILE *fp = fopen(argv[1], "r");
+  out->mapped = false;
 
   if (fp == NULL) {
     puts("Error while opening the file.");
@@ -427,7 +675,7 @@ void openFile(interpreter_data_t *iData, int argc, char *argv[]) {
       exit(EXIT_FAILURE);
     }
 
-    iData->data = malloc(bufSize);
+    out->data = malloc(bufSize);
 
     if (fseek(fp, 0L, SEEK_SET) != 0) {
       puts("Error reading - could not seek to end");
@@ -435,10 +683,10 @@ void openFile(interpreter_data_t *iData, int argc, char *argv[]) {
     }
 
     /* Read the entire file into memory. */
-    iData->len = fread(iData->data, sizeof(ubyte_t), bufSize, fp);
+    out->len = fread(out->data, sizeof(ubyte_t), bufSize, fp);
 
-    if (iData->len != bufSize) {
-      printf("Error reading - iData->len (%zu) != bufSize (%ld)", iData->len, bufSize);
+    if (out->len != bufSize) {
+      printf("Error reading - out->len (%zu) != bufSize (%ld)", out->len, bufSize);
       exit(EXIT_FAILURE);
     }
 
@@ -451,6 +699,522 @@ void openFile(interpreter_data_t *iData, int argc, char *argv[]) {
   fclose(fp);
 }
 
+void closeFile(file_data_t *file) {
+#if VM_MMAP
+  if (file->mapped) {
+    munmap(file->data, file->len);
+    return;
+  }
+#endif
+
+  free(file->data);
+}
+
+// ===== threading functions =====
+
+typedef struct {
+  runtime_t *rt;
+  file_data_t file;
+  program_t *program; // loaded from `file`
+  snapshot_t snapshot; // with `path` set for --snapshot
+  file_data_t restore; // the snapshot for --restore, if `data` is set
+} interpreter_data_t;
+
+// --prefork: children at a time, 0 without it; set in the processes it
+// forked, see preforkRun
+static size_t preforkCount = 0;
+static bool preforkChild = false;
+
+void *interpreterThread(void *arg) {
+  interpreter_data_t *iData = (interpreter_data_t*)arg;
+
+  interpreter_t *it = interpreter_createShared(iData->rt, iData->program);
+
+  if (events_enabled) {
+    events_nameThread("interpreter");
+  }
+
+  if (profilePath != NULL) {
+    interpreter_profile(it);
+    profileInterpreter = it;
+    atexit(writeProfile);
+  }
+
+  if (profileOpcodes) {
+    interpreter_profileOpcodes(it);
+  }
+
+  if (profileBlocks) {
+    interpreter_profileBlocks(it, profileCalls);
+  }
+
+  if (profileOpcodes || profileBlocks) {
+    profiledInterpreter = it;
+    atexit(printProfiles);
+  }
+
+  if (instructionsPath != NULL) {
+    interpreter_profileInstructions(it);
+    instructionsInterpreter = it;
+    atexit(writeInstructions);
+  }
+
+  if (samplesPath != NULL) {
+    startSampling(it);
+    atexit(writeSamples);
+  }
+
+  if (ringSize != 0) {
+    interpreter_traceRing(it, ringSize);
+
+    pthread_mutex_lock(&ringLock);
+    ringInterpreter = it;
+    pthread_mutex_unlock(&ringLock);
+
+    atexit(writeRing);
+  }
+
+  // opened on this thread, which they count
+  if (perfRequested && (perfCounters = perf_open()) != NULL) {
+    countedInterpreter = it;
+    atexit(writeCounters);
+    perf_start(perfCounters);
+  }
+
+#if VM_MMAP
+  // past decoding, the mapping is only read where operands are peeked
+  if (iData->file.mapped) {
+    madvise(iData->file.data, iData->file.len, MADV_RANDOM);
+  }
+#endif
+
+  // value_setFunction(iData->rt, datatable_getValue(iData->rt->dt, 0, AT_DATA | AT_ABS), _System_C_exit);
+
+  iData->snapshot.image = it->image;
+  iData->snapshot.code = it->code;
+
+  if (iData->restore.data != NULL) {
+    const char *error = NULL;
+
+    if (!snapshot_restore(iData->rt, &iData->snapshot, iData->restore.data, iData->restore.len, &error)) {
+      fprintf(stderr, "invalid snapshot: %s\n", error);
+      exit(EXIT_FAILURE);
+    }
+
+    interpreter_resume(it);
+  } else {
+    if (iData->snapshot.path != NULL || iData->snapshot.fork != NULL) {
+      iData->rt->snapshot = &iData->snapshot;
+    }
+
+    interpreter_run(it);
+  }
+
+  writeProfile();
+  printProfiles();
+  writeInstructions();
+  writeSamples();
+  writeCounters();
+  writeRing();
+  interpreter_destroy(it);
+
+  // there is no main thread to go back to
+  if (preforkChild) {
+    exit(EXIT_SUCCESS);
+  }
+
+  // attached by main, before the collector started
+  runtime_detach(iData->rt);
+
+  return NULL;
+}
+
+void *gcThread(void *arg) {
+  runtime_t *rt = (runtime_t*)arg;
+
+  runtime_collector(rt);
+
+  return NULL;
+}
+
+// ===== workers =====
+
+// the lines of a --input list, taken by the workers in order. the queue is
+// the cursor alone: a worker claims the next job with one fetch_add, so
+// none of them ever waits on another for work.
+typedef struct {
+  char *text; // the list, with each '\n' replaced by a NUL
+  const char **lines; // into `text`, the empty lines left out
+  size_t count;
+  atomic_size_t next; // the first job not yet claimed
+} jobs_t;
+
+void readJobs(const char *path, jobs_t *jobs) {
+  file_data_t file;
+  char *line;
+
+  openFile(path, &file);
+
+  jobs->text = (char*)malloc(file.len + 1);
+  memcpy(jobs->text, file.data, file.len);
+  jobs->text[file.len] = '\0';
+  closeFile(&file);
+
+  jobs->lines = (const char**)malloc(sizeof(const char*) * (file.len / 2 + 1));
+  jobs->count = 0;
+  atomic_init(&jobs->next, 0);
+
+  for (line = jobs->text; line < jobs->text + file.len;) {
+    char *end = (char*)memchr(line, '\n', (size_t)(jobs->text + file.len - line));
+    size_t len;
+
+    if (end == NULL) {
+      end = jobs->text + file.len;
+    }
+
+    *end = '\0';
+    len = (size_t)(end - line);
+
+    if (len != 0 && line[len - 1] == '\r') {
+      line[--len] = '\0';
+    }
+
+    if (len != 0) {
+      jobs->lines[jobs->count++] = line;
+    }
+
+    line = end + 1;
+  }
+}
+
+void freeJobs(jobs_t *jobs) {
+  free(jobs->lines);
+  free(jobs->text);
+}
+
+// the --budget and --slice limits, see runtime_setBudget, the
+// --gc-budget, in nanoseconds, see runtime_setGcBudget, and the
+// --memory-soft and --memory-limit ones, see runtime_setMemoryLimit
+typedef struct {
+  uint64_t budget;
+  uint64_t slice;
+  uint64_t gc;
+  uint64_t memorySoft;
+  uint64_t memoryHard;
+} budget_t;
+
+// where the workers' memory goes: --pin and --huge-pages
+typedef struct {
+  bool pin;
+  bool hugePages;
+} placement_t;
+
+// with --pin, the attributes of the `index`th worker, which runs on the
+// index-th of the CPUs the process may use, round robin, from its start:
+// the memory it touches first, its runtime's $d and $l and its heap's
+// slabs, is then on that CPU's NUMA node, and its collector runs there
+// too. NULL otherwise, or where threads cannot be pinned.
+static pthread_attr_t *workerAttr(pthread_attr_t *attr, placement_t placement, size_t index) {
+#if VM_PIN
+  cpu_set_t allowed, cpu;
+  size_t count, n = 0;
+
+  if (!placement.pin || sched_getaffinity(0, sizeof(allowed), &allowed) != 0
+      || (count = (size_t)CPU_COUNT(&allowed)) == 0) {
+    return NULL;
+  }
+
+  index %= count;
+  CPU_ZERO(&cpu);
+
+  for (int c = 0; c < CPU_SETSIZE; c++) {
+    if (CPU_ISSET(c, &allowed) && n++ == index) {
+      CPU_SET(c, &cpu);
+      break;
+    }
+  }
+
+  pthread_attr_init(attr);
+
+  if (pthread_attr_setaffinity_np(attr, sizeof(cpu), &cpu) != 0) {
+    pthread_attr_destroy(attr);
+    return NULL;
+  }
+
+  return attr;
+#else
+  (void)attr;
+  (void)placement;
+  (void)index;
+
+  return NULL;
+#endif
+}
+
+// starts the `index`th worker, see workerAttr
+static void startWorker(pthread_t *thread, placement_t placement, size_t index, void *(*fn)(void*), void *arg) {
+  pthread_attr_t attr;
+  pthread_attr_t *pattr = workerAttr(&attr, placement, index);
+
+  pthread_create(thread, pattr, fn, arg);
+
+  if (pattr != NULL) {
+    pthread_attr_destroy(pattr);
+  }
+}
+
+typedef struct {
+  program_t *program; // shared by every worker
+  jobs_t *jobs;
+  output_mode_t outputMode;
+  budget_t budget;
+  placement_t placement;
+} worker_data_t;
+
+// runs jobs until there are none left, on a runtime of its own. the
+// program's code is decoded against it once; each job after the first
+// starts on it reset (see interpreter_reset), keeping what the code
+// learned and compiled. a job's prints are written out when it ends.
+void *workerThread(void *arg) {
+  worker_data_t *wData = (worker_data_t*)arg;
+  jobs_t *jobs = wData->jobs;
+  runtime_t *rt = runtime_create();
+  interpreter_t *it = NULL;
+  pthread_t gcThreadId;
+  size_t index;
+
+  if (events_enabled) {
+    events_nameThread("worker");
+  }
+
+  if (wData->placement.hugePages) {
+    datatable_useHugePages(rt->dt);
+  }
+
+  builtins_register(rt);
+  rt->output.mode = wData->outputMode;
+  runtime_setMemoryLimit(rt, wData->budget.memorySoft, wData->budget.memoryHard);
+  runtime_setBudget(rt, wData->budget.budget, wData->budget.slice);
+  runtime_setGcBudget(rt, wData->budget.gc);
+
+  runtime_attach(rt);
+  pthread_create(&gcThreadId, NULL, gcThread, (void*)rt);
+
+  while ((index = atomic_fetch_add_explicit(&jobs->next, 1, memory_order_relaxed)) < jobs->count) {
+    if (it == NULL) {
+      it = interpreter_createShared(rt, wData->program);
+      it->haltExits = false; // the other jobs go on
+    } else {
+      interpreter_reset(it);
+    }
+
+    rt->input = jobs->lines[index];
+    interpreter_run(it);
+    output_flush(&rt->output);
+
+    if (rt->exhausted) {
+      fprintf(stderr, "%s: execution budget exhausted\n", jobs->lines[index]);
+    } else if (rt->overLimit) {
+      fprintf(stderr, "%s: memory limit exceeded\n", jobs->lines[index]);
+    }
+  }
+
+  rt->input = NULL;
+
+  if (it != NULL) {
+    interpreter_destroy(it);
+  }
+
+  runtime_detach(rt);
+  runtime_stopCollector(rt);
+  pthread_join(gcThreadId, NULL);
+
+  runtime_gc(rt);
+  runtime_destroy(rt);
+
+  return NULL;
+}
+
+// `count` workers over the lines of `jobs`
+void runWorkers(program_t *program, jobs_t *jobs, size_t count, output_mode_t outputMode, budget_t budget, placement_t placement) {
+  pthread_t *threads = (pthread_t*)malloc(sizeof(pthread_t) * count);
+  worker_data_t wData = { program, jobs, outputMode, budget, placement };
+
+  for (size_t i = 0; i < count; i++) {
+    startWorker(&threads[i], placement, i, workerThread, (void*)&wData);
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  free(threads);
+}
+
+// ===== prefork =====
+
+#if VM_FORK
+
+static jobs_t preforkJobs;
+static pthread_t *preforkCollector; // main's, stopped before forking
+
+// the `snapshot` call under --prefork, on the interpreter thread: with
+// the setup before it done, the heap is collected once, and a child is
+// forked for each job, up to preforkCount at a time, going on from the
+// call with the job as its input. what the setup built is shared with
+// the parent, copy-on-write, until either side writes to it; so only the
+// nursery is collected in a child until its old generation doubled (see
+// runtime_afterFork). returns in the children; the parent exits once
+// they all did, with a failure if any of them failed.
+static void preforkRun(runtime_t *rt) {
+  size_t running = 0;
+  bool failed = false;
+  int status;
+
+  // their threads would not be carried over
+  if (rt->tasks != NULL || rt->aio != NULL) {
+    fprintf(stderr, "prefork: tasks or asynchronous reads and writes started before `snapshot`\n");
+    exit(EXIT_FAILURE);
+  }
+
+  runtime_detach(rt);
+  runtime_stopCollector(rt);
+  pthread_join(*preforkCollector, NULL);
+  runtime_gc(rt);
+
+  // or the children would write it out again
+  output_flush(&rt->output);
+  fflush(stdout);
+  fflush(stderr);
+
+  for (size_t i = 0; i < preforkJobs.count && !failed; i++) {
+    pid_t pid;
+
+    if (running == preforkCount) {
+      wait(&status);
+      failed = !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+      --running;
+    }
+
+    if ((pid = fork()) == 0) {
+      preforkChild = true;
+      rt->input = preforkJobs.lines[i];
+
+      runtime_afterFork(rt);
+      runtime_attach(rt);
+      pthread_create(preforkCollector, NULL, gcThread, (void*)rt);
+
+      return;
+    }
+
+    if (pid == -1) {
+      perror("prefork");
+      failed = true;
+    } else {
+      ++running;
+    }
+  }
+
+  for (; running != 0; --running) {
+    wait(&status);
+    failed = failed || !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+  }
+
+  exit(failed ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+#endif
+
+// ===== server =====
+
+#if VM_SERVE
+
+// listens on `addr` (see serve_open) with `count` workers, until the
+// process exits
+static int serve(const char *addr, size_t count, const serve_options_t *options, placement_t placement) {
+  server_t *server = serve_open(addr, options);
+  pthread_t *threads;
+
+  if (server == NULL) {
+    return 1;
+  }
+
+  threads = (pthread_t*)malloc(sizeof(pthread_t) * count);
+
+  for (size_t i = 0; i < count; i++) {
+    startWorker(&threads[i], placement, i, serve_worker, (void*)server);
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  free(threads);
+  serve_close(server);
+
+  return 1; // the workers only stop when accept fails
+}
+
+#endif
+
+// loads the module of each --extension <path> after argv[first], so that
+// the programs importing from them can be created. returns how many there
+// were; exits on one that does not load.
+static int loadExtensions(int argc, char *argv[], int first) {
+  const char *error;
+  int count = 0;
+
+  for (int i = first; i + 1 < argc; i++) {
+    if (strcmp(argv[i], "--extension") != 0) {
+      continue;
+    }
+
+    if (!extension_load(argv[++i], &error)) {
+      fprintf(stderr, "%s: %s\n", argv[i], error);
+      exit(EXIT_FAILURE);
+    }
+
+    count++;
+  }
+
+  return count;
+}
+
+// ===== annotate =====
+
+// vm --annotate: the listing of the program at `path`, with the
+// instruction profile at `profilePath`, to stdout
+static int annotate(const char *profilePath, const char *path) {
+  file_data_t file = { 0 };
+  program_t *program;
+  runtime_t *rt;
+  interpreter_t *it;
+  const char *error;
+  bool ok;
+
+  openFile(path, &file);
+
+  if ((program = program_create(file.data, file.len, &error)) == NULL) {
+    fprintf(stderr, "invalid bytecode file: %s\n", error);
+    return 1;
+  }
+
+  // for the builtins the calls go to
+  rt = runtime_create();
+  builtins_register(rt);
+
+  it = interpreter_createShared(rt, program);
+  program_release(program);
+
+  ok = annotate_write(it, profilePath, stdout);
+
+  interpreter_destroy(it);
+  runtime_destroy(rt);
+  closeFile(&file);
+
+  return ok ? 0 : 1;
+}
+
 #define BYTE_TO_BINARY_PATTERN "%c%c%c%c%c%c%c%c"
 #define BYTE_TO_BINARY(byte)  \
   (byte & 0x80 ? '1' : '0'), \
@@ -464,69 +1228,379 @@ void openFile(interpreter_data_t *iData, int argc, char *argv[]) {
 
 
 
-#define SET_BUILTIN_C_FUNCTION(enum_item, c_func) \
-  iData.rt->dt->storage[AT_DATA].data[enum_item] = value_fromFunction(c_func)
-
-#include <shared/builtins.h>
-
 #if 1
 
 // ===== Main driver =====
 int main(int argc, char *argv[]) {
   MEASURE_EXECUTION_TIME_BEGIN;
 
-  interpreter_data_t iData;
+  interpreter_data_t iData = { 0 };
+
+#if VM_SERVE
+  if (argc >= 3 && strcmp(argv[1], "--serve") == 0) {
+    long workers = 1;
+    serve_options_t options = { 0 };
+    placement_t placement = { false, false };
+
+    options.outputMode = OUTPUT_MODE_BLOCK;
+
+    for (int i = 3; i < argc; i++) {
+      if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc && (workers = strtol(argv[i + 1], NULL, 10)) > 0) {
+        i++;
+      } else if (strcmp(argv[i], "--root") == 0 && i + 1 < argc) {
+        options.root = argv[++i];
+      } else if (strcmp(argv[i], "--allow-remote") == 0) {
+        options.remote = true;
+      } else if (strcmp(argv[i], "--budget") == 0 && i + 1 < argc) {
+        options.budget = strtoull(argv[++i], NULL, 10);
+      } else if (strcmp(argv[i], "--slice") == 0 && i + 1 < argc) {
+        options.slice = strtoull(argv[++i], NULL, 10);
+      } else if (strcmp(argv[i], "--gc-budget") == 0 && i + 1 < argc) {
+        options.gcBudget = strtoull(argv[++i], NULL, 10) * 1000;
+      } else if (strcmp(argv[i], "--memory-limit") == 0 && i + 1 < argc) {
+        options.memoryHard = strtoull(argv[++i], NULL, 10);
+      } else if (strcmp(argv[i], "--memory-soft") == 0 && i + 1 < argc) {
+        options.memorySoft = strtoull(argv[++i], NULL, 10);
+      } else if (strcmp(argv[i], "--pin") == 0) {
+        placement.pin = true;
+      } else if (strcmp(argv[i], "--huge-pages") == 0) {
+        placement.hugePages = true;
+        options.hugePages = true;
+      } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc && strcmp(argv[i + 1], "line") == 0) {
+        options.outputMode = OUTPUT_MODE_LINE;
+        i++;
+      } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc && strcmp(argv[i + 1], "block") == 0) {
+        options.outputMode = OUTPUT_MODE_BLOCK;
+        i++;
+      } else if (strcmp(argv[i], "--extension") == 0 && i + 1 < argc) {
+        i++; // loaded below
+      } else {
+        showArguments(argc, argv);
+      }
+    }
+
+    loadExtensions(argc, argv, 3);
+
+    return serve(argv[2], (size_t)workers, &options, placement);
+  }
+#endif
+
+  if (argc >= 4 && strcmp(argv[1], "--annotate") == 0) {
+    for (int i = 4; i < argc; i++) {
+      if (strcmp(argv[i], "--extension") == 0 && i + 1 < argc) {
+        i++; // loaded below
+      } else {
+        showArguments(argc, argv);
+      }
+    }
+
+    loadExtensions(argc, argv, 4);
 
-  if (argc == 2 || argc == 3) {
-    openFile(&iData, argc, argv);
+    return annotate(argv[2], argv[3]);
+  }
+
+  // before the program, which may import from them
+  const int numExtensions = argc >= 2 ? loadExtensions(argc, argv, 2) : 0;
+
+  if (argc >= 2 && argc - 2 * numExtensions <= 16) {
+    openFile(argv[1], &iData.file);
   } else {
     showArguments(argc, argv);
     return 1;
   }
 
-  iData.rt = runtime_create();
-  SET_BUILTIN_C_FUNCTION(BUILTIN_SYSTEM_CREATE_OBJECT, _System_createObject);
-  SET_BUILTIN_C_FUNCTION(BUILTIN_SYSTEM_GET_OBJECT_MEMBER, _System_getObjectMember);
-  SET_BUILTIN_C_FUNCTION(BUILTIN_SYSTEM_SET_OBJECT_MEMBER, _System_setObjectMember);
+  const char *error;
 
-  SET_BUILTIN_C_FUNCTION(BUILTIN_SYSTEM_C_EXIT, _System_C_exit);
-  SET_BUILTIN_C_FUNCTION(BUILTIN_SYSTEM_C_FMOD, _System_C_fmod);
-  SET_BUILTIN_C_FUNCTION(BUILTIN_SYSTEM_C_STRLEN, _System_C_strlen);
+  if ((iData.program = program_create(iData.file.data, iData.file.len, &error)) == NULL) {
+    fprintf(stderr, "invalid bytecode file: %s\n", error);
+    return 1;
+  }
 
-  SET_BUILTIN_C_FUNCTION(BUILTIN_SYSTEM_C_FOPEN, _System_C_fopen);
-  SET_BUILTIN_C_FUNCTION(BUILTIN_SYSTEM_C_FCLOSE, _System_C_fclose);
-  SET_BUILTIN_C_FUNCTION(BUILTIN_SYSTEM_C_FREAD, _System_C_fread);
-  SET_BUILTIN_C_FUNCTION(BUILTIN_SYSTEM_C_FWRITE, _System_C_fwrite);
-  SET_BUILTIN_C_FUNCTION(BUILTIN_SYSTEM_C_FSEEK, _System_C_fseek);
+  iData.rt = runtime_create();
+  builtins_register(iData.rt);
 
   bool genc = false;
-
-  for (int i = 0; i < argc; i++) {
+  const char *aotPath = NULL;
+  const char *inputPath = NULL;
+  serve_nodes_t nodes = { NULL, 1, false, false };
+  long workers = 0;
+  bool outputSet = false;
+  budget_t budget = { 0, 0, 0, 0, 0 };
+  placement_t placement = { false, false };
+
+  for (int i = 2; i < argc; i++) {
     if (strcmp(argv[i], "--genc") == 0) {
       genc = true;
+    } else if (strcmp(argv[i], "--aot") == 0 && i + 1 < argc) {
+      aotPath = argv[++i];
+    } else if (strcmp(argv[i], "--snapshot") == 0 && i + 1 < argc && iData.restore.data == NULL) {
+      iData.snapshot.path = argv[++i];
+    } else if (strcmp(argv[i], "--restore") == 0 && i + 1 < argc && iData.snapshot.path == NULL) {
+      openFile(argv[++i], &iData.restore);
+    } else if (strcmp(argv[i], "--input") == 0 && i + 1 < argc) {
+      inputPath = argv[++i];
+    } else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc && (workers = strtol(argv[i + 1], NULL, 10)) > 0) {
+      i++;
+#if VM_SERVE
+    } else if (strcmp(argv[i], "--nodes") == 0 && i + 1 < argc) {
+      nodes.addrs = argv[++i];
+    } else if (strcmp(argv[i], "--allow-remote") == 0) {
+      nodes.remote = true;
+#endif
+#if VM_FORK
+    } else if (strcmp(argv[i], "--prefork") == 0 && i + 1 < argc && strtol(argv[i + 1], NULL, 10) > 0) {
+      preforkCount = (size_t)strtol(argv[++i], NULL, 10);
+#endif
+    } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc && strcmp(argv[i + 1], "line") == 0) {
+      iData.rt->output.mode = OUTPUT_MODE_LINE;
+      outputSet = true;
+      i++;
+    } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc && strcmp(argv[i + 1], "block") == 0) {
+      iData.rt->output.mode = OUTPUT_MODE_BLOCK;
+      outputSet = true;
+      i++;
+    } else if (strcmp(argv[i], "--budget") == 0 && i + 1 < argc) {
+      budget.budget = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--slice") == 0 && i + 1 < argc) {
+      budget.slice = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--gc-budget") == 0 && i + 1 < argc) {
+      budget.gc = strtoull(argv[++i], NULL, 10) * 1000;
+    } else if (strcmp(argv[i], "--memory-limit") == 0 && i + 1 < argc) {
+      budget.memoryHard = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--memory-soft") == 0 && i + 1 < argc) {
+      budget.memorySoft = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--pin") == 0) {
+      placement.pin = true;
+    } else if (strcmp(argv[i], "--huge-pages") == 0) {
+      placement.hugePages = true;
+    } else if (strcmp(argv[i], "--stats") == 0) {
+      statsRuntime = iData.rt;
+      atexit(printStats);
+    } else if (strcmp(argv[i], "--profile-out") == 0 && i + 1 < argc) {
+      profilePath = argv[++i];
+    } else if (strcmp(argv[i], "--profile=opcodes") == 0) {
+      profileOpcodes = true;
+    } else if (strcmp(argv[i], "--profile=blocks") == 0) {
+      profileBlocks = true;
+    } else if (strcmp(argv[i], "--profile=calls") == 0) {
+      profileBlocks = true;
+      profileCalls = true;
+    } else if (strcmp(argv[i], "--trace-calls") == 0 || strcmp(argv[i], "--trace-calls=json") == 0) {
+      if (callsRuntime == NULL) {
+        iData.rt->calls = calls_create();
+        callsRuntime = iData.rt;
+        atexit(printCalls);
+      }
+
+      callsJson = strcmp(argv[i], "--trace-calls=json") == 0;
+    } else if (strcmp(argv[i], "--trace-gc") == 0 && i + 1 < argc) {
+      if (eventsPath == NULL) {
+        events_start();
+        atexit(writeEvents);
+      }
+
+      eventsPath = argv[++i];
+    } else if (strcmp(argv[i], "--profile-instructions") == 0 && i + 1 < argc) {
+      instructionsPath = argv[++i];
+    } else if (strcmp(argv[i], "--profile-samples") == 0 && i + 1 < argc) {
+      samplesPath = argv[++i];
+    } else if (strcmp(argv[i], "--trace-ring") == 0 && i + 1 < argc && strtol(argv[i + 1], NULL, 10) > 0) {
+      ringSize = (size_t)strtol(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--heap-census") == 0 || strncmp(argv[i], "--heap-census=", 14) == 0) {
+      censusRequested = true;
+      censusGraphPath = argv[i][13] == '=' ? argv[i] + 14 : NULL;
+    } else if (strcmp(argv[i], "--perf-counters") == 0) {
+      perfRequested = true;
+    } else if (strcmp(argv[i], "--extension") == 0 && i + 1 < argc) {
+      i++; // loaded by then
+    } else {
+      showArguments(argc, argv);
     }
   }
 
-  if (genc) {
-    interpreter_t *it = interpreter_create(iData.rt, iData.data, iData.len);
-    jit_run(it);
+  runtime_setMemoryLimit(iData.rt, budget.memorySoft, budget.memoryHard);
+  runtime_setBudget(iData.rt, budget.budget, budget.slice);
+  runtime_setGcBudget(iData.rt, budget.gc);
+
+  if ((workers != 0 || placement.pin) && (inputPath == NULL || preforkCount != 0)) {
+    showArguments(argc, argv);
+  }
+
+  if (preforkCount != 0 && inputPath == NULL) {
+    showArguments(argc, argv);
+  }
+
+  // nothing runs here; --stats is the nodes'
+  if (nodes.addrs != NULL && (inputPath == NULL || preforkCount != 0 || placement.pin || placement.hugePages)) {
+    showArguments(argc, argv);
+  }
+
+  if (nodes.remote && nodes.addrs == NULL) {
+    showArguments(argc, argv);
+  }
+
+  // mapped already, but not yet touched
+  if (placement.hugePages && (inputPath == NULL || preforkCount != 0)) {
+    datatable_useHugePages(iData.rt->dt);
+  }
+
+  // an executable does not load them
+  if (numExtensions != 0 && aotPath != NULL) {
+    showArguments(argc, argv);
+  }
+
+  // nothing is run to count
+  if ((profilePath != NULL || profileOpcodes || profileBlocks || instructionsPath != NULL || samplesPath != NULL
+       || callsRuntime != NULL || perfRequested || ringSize != 0 || censusRequested) && (genc || aotPath != NULL)) {
+    showArguments(argc, argv);
+  }
+
+  if (inputPath != NULL && (genc || aotPath != NULL || iData.snapshot.path != NULL || iData.restore.data != NULL
+                            || (statsRuntime != NULL && nodes.addrs == NULL) || profilePath != NULL || profileOpcodes || profileBlocks
+                            || instructionsPath != NULL || samplesPath != NULL || callsRuntime != NULL || perfRequested || ringSize != 0
+                            || censusRequested)) {
+    showArguments(argc, argv);
+  }
+
+#if VM_SERVE
+  if (nodes.addrs != NULL) {
+    jobs_t jobs;
+    bool ok;
+
+    nodes.perNode = workers != 0 ? (size_t)workers : 1;
+    nodes.stats = statsRuntime != NULL;
+
+    readJobs(inputPath, &jobs);
+    ok = serve_coordinate(iData.file.data, iData.file.len, jobs.lines, jobs.count, &nodes);
+    freeJobs(&jobs);
+
+    if (!ok) {
+      exit(EXIT_FAILURE);
+    }
+
+    statsRuntime = NULL;
+  } else
+#endif
+  if (inputPath != NULL && preforkCount == 0) {
+    jobs_t jobs;
+
+    readJobs(inputPath, &jobs);
+
+    // with jobs running side by side, each one's prints are kept together,
+    // unless asked otherwise
+    runWorkers(iData.program, &jobs, workers != 0 ? (size_t)workers : 1,
+               outputSet || workers <= 1 ? iData.rt->output.mode : OUTPUT_MODE_BLOCK, budget, placement);
+    freeJobs(&jobs);
+  } else if (genc || aotPath != NULL) {
+    char cPath[1024];
+    interpreter_t *it = interpreter_createShared(iData.rt, iData.program);
+    bool ok;
+
+    if (aotPath != NULL) {
+      snprintf(cPath, sizeof(cPath), "%s.c", aotPath);
+    } else {
+      snprintf(cPath, sizeof(cPath), "_tmp_jit.c");
+    }
+
+    ok = jit_aot(it, cPath, aotPath);
     interpreter_destroy(it);
+
+    if (!ok) {
+      exit(EXIT_FAILURE);
+    }
   } else {
     // execution thread
     pthread_t interpreterThreadId, gcThreadId;
 
+    runtime_attach(iData.rt);
+
+#if VM_SAMPLE
+    // inherited by both threads; the interpreter's unblocks it, see startSampling
+    if (samplesPath != NULL) {
+      sigset_t set;
+
+      sigemptyset(&set);
+      sigaddset(&set, SIGPROF);
+      pthread_sigmask(SIG_BLOCK, &set, NULL);
+    }
+#endif
+
+#if VM_RING_SIGNAL
+    // likewise for SIGUSR1, which only ringThread takes; detached, it ends
+    // with the process
+    if (ringSize != 0) {
+      pthread_t ringThreadId;
+      sigset_t set;
+
+      sigemptyset(&set);
+      sigaddset(&set, SIGUSR1);
+      pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+      pthread_create(&ringThreadId, NULL, ringThread, NULL);
+      pthread_detach(ringThreadId);
+    }
+
+    if (censusRequested) {
+      pthread_t censusThreadId;
+      sigset_t set;
+
+      censusRuntime = iData.rt;
+
+      sigemptyset(&set);
+      sigaddset(&set, SIGUSR2);
+      pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+      pthread_create(&censusThreadId, NULL, censusThread, NULL);
+      pthread_detach(censusThreadId);
+    }
+#endif
+
+#if VM_FORK
+    if (preforkCount != 0) {
+      readJobs(inputPath, &preforkJobs);
+      preforkCollector = &gcThreadId;
+      iData.snapshot.fork = preforkRun;
+
+      // as for --workers
+      if (!outputSet && preforkCount > 1) {
+        iData.rt->output.mode = OUTPUT_MODE_BLOCK;
+      }
+    }
+#endif
+
+    pthread_create(&gcThreadId, NULL, gcThread, (void*)iData.rt);
     pthread_create(&interpreterThreadId, NULL, interpreterThread, (void*)&iData);
     pthread_join(interpreterThreadId, NULL);
 
-    pthread_create(&gcThreadId, NULL, gcThread, (void*)iData.rt);
+    // no census past the program's end
+    pthread_mutex_lock(&censusLock);
+    censusRuntime = NULL;
+    pthread_mutex_unlock(&censusLock);
+
+    runtime_stopCollector(iData.rt);
     pthread_join(gcThreadId, NULL);
 
     runtime_gc(iData.rt);
+
+#if VM_FORK
+    // the program ended without calling `snapshot`
+    if (preforkCount != 0) {
+      freeJobs(&preforkJobs);
+    }
+#endif
   }
 
+  printStats();
+  printCalls();
+  writeEvents();
   runtime_destroy(iData.rt);
+  program_release(iData.program);
+
+  closeFile(&iData.file);
 
-  free(iData.data);
+  if (iData.restore.data != NULL) {
+    closeFile(&iData.restore);
+  }
 
   MEASURE_EXECUTION_TIME_END;
 